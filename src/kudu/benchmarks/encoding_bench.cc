@@ -0,0 +1,554 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Micro benchmark for the block encodings of every type, and for the
+// compression codecs applied to the encoded blocks.
+//
+// For each of the types, datasets and encodings asked for, this encodes the
+// dataset into blocks of the configured size, as a CFile would, and reports:
+//  - the size of the encoded data, and its ratio to the raw size of the values
+//  - the throughput of the block builders
+//  - the bandwidth of decoding the blocks with CopyNextValues()
+//  - the average latency of seeking to a random position (and, if the
+//    decoder supports it, to a random value) within a block
+//  - for each codec, the ratio of the raw size of the values to the size of
+//    the compressed blocks, and the throughput of compression and
+//    decompression.
+//
+// The synthetic datasets are:
+//  - sorted: increasing values, spread over the range of the type
+//  - random: uniformly random values
+//  - low_cardinality: random picks among 16 distinct values
+//  - timestamp: microsecond timestamps at roughly regular intervals
+// A file of real values, one per line, may be given as an extra dataset.
+//
+// Dictionary encoding isn't covered, as its blocks can't be decoded without
+// the dictionary of a CFile.
+//
+// Usage:
+//   encoding_bench -encoding_bench_types=int32,string
+//                  -encoding_bench_datasets=sorted,timestamp
+//                  -encoding_bench_sample_file=/tmp/values.txt
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/cfile/type_encodings.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/util/compression/compression_codec.h"
+#include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/random.h"
+#include "kudu/util/stopwatch.h"
+
+DEFINE_string(encoding_bench_types, "int32,int64,double,string,bool",
+              "Comma separated list of the types to benchmark. Supported types are "
+              "bool, int8, int16, int32, int64, uint8, uint16, uint32, uint64, float, "
+              "double, string and binary.");
+DEFINE_string(encoding_bench_datasets, "sorted,random,low_cardinality,timestamp",
+              "Comma separated list of the synthetic datasets to benchmark. Supported "
+              "datasets are sorted, random, low_cardinality and timestamp.");
+DEFINE_string(encoding_bench_sample_file, "",
+              "If set, a file holding one value per line, benchmarked as an extra dataset "
+              "for each of the types.");
+DEFINE_string(encoding_bench_codecs, "snappy,lz4,zlib,zstd",
+              "Comma separated list of the compression codecs to apply to the encoded "
+              "blocks.");
+DEFINE_int32(encoding_bench_num_values, 1000000,
+             "Number of values in each synthetic dataset");
+DEFINE_int32(encoding_bench_block_size, 256 * 1024,
+             "Size of the blocks the values are encoded into");
+DEFINE_int32(encoding_bench_batch_size, 1024,
+             "Number of values added to, and decoded from, the blocks at once");
+DEFINE_int32(encoding_bench_num_seeks, 10000,
+             "Number of random seeks to time for each encoding");
+DEFINE_int32(encoding_bench_iterations, 3,
+             "Number of times to repeat each measurement. The best time is reported.");
+DEFINE_int32(encoding_bench_seed, 0,
+             "Seed of the random values. If 0, the current time is used.");
+
+using std::deque;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+const EncodingType kEncodings[] = {
+  PLAIN_ENCODING, PREFIX_ENCODING, RLE, BIT_SHUFFLE, DELTA_OF_DELTA, FLOAT_XOR
+};
+
+const int kLowCardinality = 16;
+
+// Returns the largest raw value to generate for values of type T, such that
+// the conversion by MakeValue() preserves their order.
+template<typename T>
+uint64_t MaxRawValue() {
+  return std::min<uint64_t>(std::numeric_limits<T>::max(),
+                            std::numeric_limits<int64_t>::max());
+}
+template<> uint64_t MaxRawValue<float>() { return 1ULL << 24; }
+template<> uint64_t MaxRawValue<double>() { return 1ULL << 53; }
+template<> uint64_t MaxRawValue<Slice>() { return std::numeric_limits<int64_t>::max(); }
+
+// Converts raw values of the synthetic datasets into values of a type.
+// Slices point into 'strings'.
+template<typename T>
+void MakeValue(uint64_t v, T* out, deque<string>* /* strings */) {
+  *out = static_cast<T>(v);
+}
+void MakeValue(uint64_t v, float* out, deque<string>* /* strings */) {
+  *out = v / 1000.0f;
+}
+void MakeValue(uint64_t v, double* out, deque<string>* /* strings */) {
+  *out = v / 1000.0;
+}
+void MakeValue(uint64_t v, Slice* out, deque<string>* strings) {
+  strings->push_back(StringPrintf("%016llx", static_cast<unsigned long long>(v)));
+  *out = Slice(strings->back());
+}
+
+// Parses a line of the sample file into a value of a type. Booleans are
+// read as integers.
+template<typename T>
+bool ParseValue(const string& line, T* out, deque<string>* /* strings */) {
+  int64 v;
+  if (!safe_strto64(line, &v)) {
+    return false;
+  }
+  *out = static_cast<T>(v);
+  return true;
+}
+bool ParseValue(const string& line, float* out, deque<string>* /* strings */) {
+  return safe_strtof(line, out);
+}
+bool ParseValue(const string& line, double* out, deque<string>* /* strings */) {
+  return safe_strtod(line, out);
+}
+bool ParseValue(const string& line, Slice* out, deque<string>* strings) {
+  strings->push_back(line);
+  *out = Slice(strings->back());
+  return true;
+}
+
+// Returns 'n' raw values of the synthetic dataset named 'dataset', all
+// within [0, max].
+vector<uint64_t> GenerateRawValues(const string& dataset, size_t n, uint64_t max,
+                                   Random* rng) {
+  vector<uint64_t> raw(n);
+  if (dataset == "sorted") {
+    for (size_t i = 0; i < n; i++) {
+      long double v = static_cast<long double>(i) * (static_cast<long double>(max) + 1) / n;
+      raw[i] = std::min<uint64_t>(v, max);
+    }
+  } else if (dataset == "random") {
+    for (size_t i = 0; i < n; i++) {
+      raw[i] = rng->Uniform64(max + 1);
+    }
+  } else if (dataset == "low_cardinality") {
+    uint64_t distinct[kLowCardinality];
+    for (uint64_t& v : distinct) {
+      v = rng->Uniform64(max + 1);
+    }
+    for (size_t i = 0; i < n; i++) {
+      raw[i] = distinct[rng->Uniform(kLowCardinality)];
+    }
+  } else if (dataset == "timestamp") {
+    // Roughly a millisecond apart, with some jitter, unless the type is too
+    // narrow to hold that many.
+    uint64_t base = std::min<uint64_t>(GetCurrentTimeMicros(), max / 2);
+    uint64_t step = std::max<uint64_t>(1, std::min<uint64_t>(1000, (max / 2) / n));
+    for (size_t i = 0; i < n; i++) {
+      raw[i] = std::min<uint64_t>(base + i * step + rng->Uniform64(step / 10 + 1), max);
+    }
+  } else {
+    LOG(FATAL) << "Unknown dataset: " << dataset;
+  }
+  return raw;
+}
+
+double MBPerSec(size_t bytes, double seconds) {
+  return bytes / seconds / (1024 * 1024);
+}
+
+// Runs 'f' FLAGS_encoding_bench_iterations times, and returns the shortest
+// wall time it took, in seconds.
+template<class F>
+double BestTime(const F& f) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < FLAGS_encoding_bench_iterations; i++) {
+    Stopwatch sw;
+    sw.start();
+    f();
+    sw.stop();
+    best = std::min(best, sw.elapsed().wall_seconds());
+  }
+  return best;
+}
+
+} // anonymous namespace
+
+// Benchmarks the encodings of the values of a type.
+template<DataType Type>
+class EncodingBenchmark {
+ public:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  // The type values are stored as. std::vector<bool> doesn't store plain
+  // bools, so they are stored as bytes instead.
+  typedef typename std::conditional<std::is_same<CppType, bool>::value,
+                                    uint8_t, CppType>::type StorageType;
+
+  EncodingBenchmark()
+    : type_info_(GetTypeInfo(Type)),
+      rng_(FLAGS_encoding_bench_seed != 0 ? FLAGS_encoding_bench_seed : GetCurrentTimeMicros()),
+      arena_(1024 * 1024, 256 * 1024 * 1024) {
+    opts_.storage_attributes.cfile_block_size = FLAGS_encoding_bench_block_size;
+  }
+
+  void Run(const vector<string>& datasets, const vector<const CompressionCodec*>& codecs) {
+    for (const string& dataset : datasets) {
+      GenerateDataset(dataset);
+      RunDataset(dataset, codecs);
+    }
+    if (!FLAGS_encoding_bench_sample_file.empty()) {
+      CHECK_OK(ReadSampleFile(FLAGS_encoding_bench_sample_file));
+      RunDataset("sample", codecs);
+    }
+  }
+
+ private:
+  void GenerateDataset(const string& dataset) {
+    vector<uint64_t> raw = GenerateRawValues(dataset, FLAGS_encoding_bench_num_values,
+                                             MaxRawValue<CppType>(), &rng_);
+    strings_.clear();
+    values_.resize(raw.size());
+    for (size_t i = 0; i < raw.size(); i++) {
+      MakeValue(raw[i], &values_[i], &strings_);
+    }
+  }
+
+  Status ReadSampleFile(const string& path) {
+    faststring contents;
+    RETURN_NOT_OK(ReadFileToString(Env::Default(), path, &contents));
+    vector<string> lines = strings::Split(contents.ToString(), "\n", strings::SkipEmpty());
+    strings_.clear();
+    values_.clear();
+    values_.reserve(lines.size());
+    for (const string& line : lines) {
+      StorageType v;
+      if (!ParseValue(line, &v, &strings_)) {
+        return Status::Corruption("bad value in sample file", line);
+      }
+      values_.push_back(v);
+    }
+    return Status::OK();
+  }
+
+  // Returns the size of the values, were they stored without any encoding.
+  size_t RawSize() const {
+    if (type_info_->physical_type() != BINARY) {
+      return values_.size() * sizeof(StorageType);
+    }
+    size_t size = 0;
+    for (const string& s : strings_) {
+      size += s.size();
+    }
+    return size;
+  }
+
+  void RunDataset(const string& dataset, const vector<const CompressionCodec*>& codecs) {
+    if (values_.empty()) {
+      LOG(WARNING) << "Skipping empty dataset " << dataset;
+      return;
+    }
+    for (EncodingType encoding : kEncodings) {
+      const TypeEncodingInfo* info;
+      if (!TypeEncodingInfo::Get(type_info_, encoding, &info).ok()) {
+        continue;
+      }
+      RunEncoding(dataset, info, codecs);
+    }
+  }
+
+  void RunEncoding(const string& dataset, const TypeEncodingInfo* info,
+                   const vector<const CompressionCodec*>& codecs) {
+    const string name = Substitute("$0/$1/$2", type_info_->name(), dataset,
+                                   EncodingType_Name(info->encoding_type()));
+    const size_t raw_size = RawSize();
+
+    double encode_time = BestTime([&]() { CHECK_OK(Encode(info)); });
+    size_t encoded_size = 0;
+    for (const string& block : blocks_) {
+      encoded_size += block.size();
+    }
+
+    vector<unique_ptr<BlockDecoder>> decoders;
+    CHECK_OK(CreateDecoders(info, &decoders));
+    double decode_time = BestTime([&]() { CHECK_OK(DecodeAll(&decoders)); });
+    double seek_time = BestTime([&]() { CHECK_OK(SeekToPositions(&decoders)); });
+    string value_seek = "n/a";
+    Status s = SeekToValues(&decoders);
+    if (s.ok()) {
+      double value_seek_time = BestTime([&]() { CHECK_OK(SeekToValues(&decoders)); });
+      value_seek = Substitute("$0 ns", static_cast<int64_t>(
+          value_seek_time * 1e9 / FLAGS_encoding_bench_num_seeks));
+    } else if (!s.IsNotSupported()) {
+      CHECK_OK(s);
+    }
+
+    LOG(INFO) << Substitute("$0: $1 values in $2 blocks, $3 bytes encoded (ratio $4), "
+                            "encode $5 MB/s, CopyNextValues $6 MB/s, "
+                            "seek to position $7 ns, seek to value $8",
+                            name, values_.size(), blocks_.size(), encoded_size,
+                            StringPrintf("%.2f", static_cast<double>(raw_size) / encoded_size),
+                            StringPrintf("%.1f", MBPerSec(raw_size, encode_time)),
+                            StringPrintf("%.1f", MBPerSec(raw_size, decode_time)),
+                            static_cast<int64_t>(seek_time * 1e9 / FLAGS_encoding_bench_num_seeks),
+                            value_seek);
+
+    for (const CompressionCodec* codec : codecs) {
+      RunCodec(name, raw_size, encoded_size, codec);
+    }
+  }
+
+  // Encodes the values into blocks_, adding them in batches as a CFile
+  // writer would.
+  Status Encode(const TypeEncodingInfo* info) {
+    BlockBuilder* bb_raw;
+    RETURN_NOT_OK(info->CreateBlockBuilder(&bb_raw, &opts_));
+    unique_ptr<BlockBuilder> bb(bb_raw);
+
+    blocks_.clear();
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(values_.data());
+    size_t rem = values_.size();
+    rowid_t ordinal = 0;
+    while (rem > 0) {
+      size_t n = bb->Add(ptr, std::min<size_t>(rem, FLAGS_encoding_bench_batch_size));
+      ptr += n * sizeof(StorageType);
+      rem -= n;
+      if (bb->IsBlockFull() || rem == 0) {
+        size_t count = bb->Count();
+        Slice block = bb->Finish(ordinal);
+        blocks_.push_back(block.ToString());
+        ordinal += count;
+        bb->Reset();
+      }
+    }
+    return Status::OK();
+  }
+
+  Status CreateDecoders(const TypeEncodingInfo* info,
+                        vector<unique_ptr<BlockDecoder>>* decoders) const {
+    for (const string& block : blocks_) {
+      BlockDecoder* bd;
+      RETURN_NOT_OK(info->CreateBlockDecoder(&bd, Slice(block), nullptr));
+      decoders->emplace_back(bd);
+      RETURN_NOT_OK(bd->ParseHeader());
+    }
+    return Status::OK();
+  }
+
+  // Decodes all the blocks in batches, as a scan would.
+  Status DecodeAll(vector<unique_ptr<BlockDecoder>>* decoders) {
+    vector<StorageType> decoded(FLAGS_encoding_bench_batch_size);
+    ColumnBlock cb(type_info_, nullptr, decoded.data(), decoded.size(), &arena_);
+    for (const auto& bd : *decoders) {
+      bd->SeekToPositionInBlock(0);
+      while (bd->HasNext()) {
+        ColumnDataView view(&cb);
+        size_t n = decoded.size();
+        RETURN_NOT_OK(bd->CopyNextValues(&n, &view));
+        arena_.Reset();
+      }
+    }
+    return Status::OK();
+  }
+
+  // Seeks to random positions of random blocks, reading the value there.
+  Status SeekToPositions(vector<unique_ptr<BlockDecoder>>* decoders) {
+    Random rng(1);
+    StorageType value;
+    ColumnBlock cb(type_info_, nullptr, &value, 1, &arena_);
+    for (int i = 0; i < FLAGS_encoding_bench_num_seeks; i++) {
+      BlockDecoder* bd = (*decoders)[rng.Uniform(decoders->size())].get();
+      bd->SeekToPositionInBlock(rng.Uniform(bd->Count()));
+      ColumnDataView view(&cb);
+      size_t n = 1;
+      RETURN_NOT_OK(bd->CopyNextValues(&n, &view));
+    }
+    arena_.Reset();
+    return Status::OK();
+  }
+
+  // Seeks to random values of random blocks. Returns NotSupported if the
+  // decoders can't seek by value.
+  Status SeekToValues(vector<unique_ptr<BlockDecoder>>* decoders) {
+    Random rng(1);
+    size_t block_start = 0;
+    vector<size_t> block_starts;
+    for (const auto& bd : *decoders) {
+      block_starts.push_back(block_start);
+      block_start += bd->Count();
+    }
+    for (int i = 0; i < FLAGS_encoding_bench_num_seeks; i++) {
+      size_t block = rng.Uniform(decoders->size());
+      BlockDecoder* bd = (*decoders)[block].get();
+      const StorageType& value = values_[block_starts[block] + rng.Uniform(bd->Count())];
+      bool exact;
+      Status s = bd->SeekAtOrAfterValue(&value, &exact);
+      // Unsorted values may make the decoder miss the value.
+      if (!s.ok() && !s.IsNotFound()) {
+        return s;
+      }
+    }
+    return Status::OK();
+  }
+
+  void RunCodec(const string& name, size_t raw_size, size_t encoded_size,
+                const CompressionCodec* codec) {
+    vector<string> compressed(blocks_.size());
+    double compress_time = BestTime([&]() {
+        for (size_t i = 0; i < blocks_.size(); i++) {
+          Slice block(blocks_[i]);
+          compressed[i].resize(codec->MaxCompressedLength(block.size()));
+          size_t len;
+          CHECK_OK(codec->Compress(block, reinterpret_cast<uint8_t*>(&compressed[i][0]),
+                                   &len));
+          compressed[i].resize(len);
+        }
+      });
+    size_t compressed_size = 0;
+    size_t max_block_size = 0;
+    for (size_t i = 0; i < blocks_.size(); i++) {
+      compressed_size += compressed[i].size();
+      max_block_size = std::max(max_block_size, blocks_[i].size());
+    }
+
+    faststring uncompressed;
+    uncompressed.resize(max_block_size);
+    double uncompress_time = BestTime([&]() {
+        for (size_t i = 0; i < blocks_.size(); i++) {
+          CHECK_OK(codec->Uncompress(Slice(compressed[i]), uncompressed.data(),
+                                     blocks_[i].size()));
+        }
+      });
+
+    LOG(INFO) << Substitute("$0 + $1: $2 bytes compressed (ratio $3), "
+                            "compress $4 MB/s, uncompress $5 MB/s",
+                            name, CompressionType_Name(codec->type()), compressed_size,
+                            StringPrintf("%.2f", static_cast<double>(raw_size) / compressed_size),
+                            StringPrintf("%.1f", MBPerSec(encoded_size, compress_time)),
+                            StringPrintf("%.1f", MBPerSec(encoded_size, uncompress_time)));
+  }
+
+  const TypeInfo* const type_info_;
+  Random rng_;
+  WriterOptions opts_;
+  Arena arena_;
+
+  // The values of the current dataset. Slices point into 'strings_'.
+  vector<StorageType> values_;
+  deque<string> strings_;
+
+  // The encoded blocks of the current encoding.
+  vector<string> blocks_;
+};
+
+void RunType(const string& type_name, const vector<string>& datasets,
+             const vector<const CompressionCodec*>& codecs) {
+  if (type_name == "bool") {
+    EncodingBenchmark<BOOL>().Run(datasets, codecs);
+  } else if (type_name == "int8") {
+    EncodingBenchmark<INT8>().Run(datasets, codecs);
+  } else if (type_name == "int16") {
+    EncodingBenchmark<INT16>().Run(datasets, codecs);
+  } else if (type_name == "int32") {
+    EncodingBenchmark<INT32>().Run(datasets, codecs);
+  } else if (type_name == "int64") {
+    EncodingBenchmark<INT64>().Run(datasets, codecs);
+  } else if (type_name == "uint8") {
+    EncodingBenchmark<UINT8>().Run(datasets, codecs);
+  } else if (type_name == "uint16") {
+    EncodingBenchmark<UINT16>().Run(datasets, codecs);
+  } else if (type_name == "uint32") {
+    EncodingBenchmark<UINT32>().Run(datasets, codecs);
+  } else if (type_name == "uint64") {
+    EncodingBenchmark<UINT64>().Run(datasets, codecs);
+  } else if (type_name == "float") {
+    EncodingBenchmark<FLOAT>().Run(datasets, codecs);
+  } else if (type_name == "double") {
+    EncodingBenchmark<DOUBLE>().Run(datasets, codecs);
+  } else if (type_name == "string") {
+    EncodingBenchmark<STRING>().Run(datasets, codecs);
+  } else if (type_name == "binary") {
+    EncodingBenchmark<BINARY>().Run(datasets, codecs);
+  } else {
+    LOG(FATAL) << "Unknown type: " << type_name;
+  }
+}
+
+} // namespace cfile
+} // namespace kudu
+
+int main(int argc, char** argv) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  vector<string> types = strings::Split(FLAGS_encoding_bench_types, ",", strings::SkipEmpty());
+  vector<string> datasets = strings::Split(FLAGS_encoding_bench_datasets, ",",
+                                           strings::SkipEmpty());
+  vector<string> codec_names = strings::Split(FLAGS_encoding_bench_codecs, ",",
+                                              strings::SkipEmpty());
+  vector<const kudu::CompressionCodec*> codecs;
+  for (const string& name : codec_names) {
+    const kudu::CompressionCodec* codec;
+    CHECK_OK(kudu::GetCompressionCodec(kudu::GetCompressionCodecType(name), &codec));
+    // There is no codec for NO_COMPRESSION; the encoded size is reported
+    // anyway.
+    if (codec != nullptr) {
+      codecs.push_back(codec);
+    }
+  }
+
+  for (const string& type : types) {
+    kudu::cfile::RunType(type, datasets, codecs);
+  }
+  return 0;
+}
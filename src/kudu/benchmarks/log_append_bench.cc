@@ -0,0 +1,276 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Benchmark of the write-ahead logs of many tablets appending concurrently,
+// as on a tablet server hosting many tablets.
+//
+// Unlike wal_hiccup, which times the fdatasync() of a single synthetic
+// writer, this drives a number of consensus::Log instances through the real
+// append path: batching, compression, segment roll-over and
+// pre-allocation. Each thread owns a subset of the logs, and in rounds
+// appends a batch of replicate messages to each of its logs, then waits for
+// all of them to be durable. The time from the append to its callback is
+// reported as the append latency.
+//
+// The behavior of the logs is configured with their own flags, e.g.
+// --log_force_fsync_all, --log_compression_codec, --log_segment_size_mb,
+// --log_preallocate_segments, --log_async_preallocate_segments,
+// --log_append_threads and the --log_group_commit_* flags.
+//
+// The logs are never garbage collected while the benchmark runs, so it
+// writes about num_logs * entry_bytes * appends bytes to the directory,
+// which is deleted at the end.
+//
+// Usage:
+//   log_append_bench -log_bench_dir=/data/1/log_bench
+//                    -log_bench_num_logs=2000
+//                    -log_bench_num_threads=16
+//                    -log_bench_append_interval_us=10000
+//                    -log_force_fsync_all
+
+#include <algorithm>
+#include <cinttypes>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/common/schema.h"
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/log.h"
+#include "kudu/consensus/opid_util.h"
+#include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/bind.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/random.h"
+#include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
+
+DEFINE_string(log_bench_dir, "/tmp/log_bench",
+              "Root directory of the file system the logs are written to. "
+              "It is created if it doesn't exist, and deleted at the end.");
+DEFINE_int32(log_bench_num_logs, 100,
+             "Number of logs, i.e. of tablets, appending concurrently");
+DEFINE_int32(log_bench_num_threads, 8,
+             "Number of threads appending to the logs. Each thread owns an equal "
+             "share of the logs.");
+DEFINE_int32(log_bench_runtime_seconds, 10,
+             "How long to append to the logs for");
+DEFINE_int32(log_bench_entries_per_append, 1,
+             "Number of replicate messages in each append");
+DEFINE_int32(log_bench_entry_bytes, 256,
+             "Size of the payload of each replicate message. The payloads are "
+             "decimal digits, which compress about 2:1.");
+DEFINE_int32(log_bench_append_interval_us, 0,
+             "Time each thread sleeps between its rounds of appends, to model "
+             "tablets which aren't written to as fast as possible");
+
+DECLARE_string(log_compression_codec);
+DECLARE_bool(log_force_fsync_all);
+DECLARE_int32(log_segment_size_mb);
+DECLARE_bool(log_preallocate_segments);
+DECLARE_bool(log_async_preallocate_segments);
+DECLARE_int32(log_append_threads);
+DECLARE_int32(log_group_commit_max_wait_us);
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace log {
+
+using consensus::MakeOpId;
+using consensus::NO_OP;
+using consensus::ReplicateMsg;
+using consensus::ReplicateRefPtr;
+using consensus::make_scoped_refptr_replicate;
+
+class LogAppendBenchmark {
+ public:
+  LogAppendBenchmark()
+    // Up to a minute, with 3 significant digits.
+    : latency_us_(60 * 1000 * 1000, 3),
+      failed_appends_(0),
+      stop_(1) {
+  }
+
+  Status Run() {
+    Env* env = Env::Default();
+    fs_manager_.reset(new FsManager(env, FLAGS_log_bench_dir));
+    if (!env->FileExists(FLAGS_log_bench_dir)) {
+      RETURN_NOT_OK(fs_manager_->CreateInitialFileSystemLayout());
+    }
+    RETURN_NOT_OK(fs_manager_->Open());
+
+    const Schema schema = SchemaBuilder(Schema({ ColumnSchema("key", INT32) }, 1)).Build();
+    for (int i = 0; i < FLAGS_log_bench_num_logs; i++) {
+      scoped_refptr<Log> log;
+      RETURN_NOT_OK(Log::Open(LogOptions(), fs_manager_.get(), TabletId(i), schema, 0,
+                              nullptr, &log));
+      logs_.push_back(log);
+    }
+
+    PrintConfig();
+    vector<scoped_refptr<Thread>> threads;
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < FLAGS_log_bench_num_threads; i++) {
+      scoped_refptr<Thread> thread;
+      RETURN_NOT_OK(Thread::Create("bench", Substitute("appender-$0", i),
+                                   &LogAppendBenchmark::AppenderThread, this, i, &thread));
+      threads.push_back(thread);
+    }
+    SleepFor(MonoDelta::FromSeconds(FLAGS_log_bench_runtime_seconds));
+    stop_.CountDown();
+    for (const auto& thread : threads) {
+      thread->Join();
+    }
+    sw.stop();
+
+    for (int i = 0; i < logs_.size(); i++) {
+      RETURN_NOT_OK(logs_[i]->Close());
+      RETURN_NOT_OK(Log::DeleteOnDiskData(fs_manager_.get(), TabletId(i)));
+    }
+    PrintResults(sw.elapsed().wall_seconds());
+    return env->DeleteRecursively(FLAGS_log_bench_dir);
+  }
+
+ private:
+  static string TabletId(int idx) {
+    return Substitute("bench-tablet-$0", idx);
+  }
+
+  static void AppendFinished(HdrHistogram* latency_us, CountDownLatch* latch,
+                             MicrosecondsInt64 start_us, const Status& s) {
+    CHECK_OK(s);
+    latency_us->Increment(GetMonoTimeMicros() - start_us);
+    latch->CountDown();
+  }
+
+  // Appends to the logs [thread_idx * n, (thread_idx + 1) * n), in rounds,
+  // until the benchmark is stopped.
+  void AppenderThread(int thread_idx) {
+    const int num_logs = logs_.size();
+    const int per_thread = (num_logs + FLAGS_log_bench_num_threads - 1) /
+        FLAGS_log_bench_num_threads;
+    const int begin = std::min(num_logs, thread_idx * per_thread);
+    const int end = std::min(num_logs, begin + per_thread);
+    if (begin == end) {
+      return;
+    }
+
+    Random rng(thread_idx);
+    string payload(FLAGS_log_bench_entry_bytes, '0');
+    for (char& c : payload) {
+      c = '0' + rng.Uniform(10);
+    }
+    vector<int64_t> next_index(end - begin, 1);
+    const MonoDelta interval = MonoDelta::FromMicroseconds(FLAGS_log_bench_append_interval_us);
+
+    do {
+      CountDownLatch latch(end - begin);
+      for (int i = begin; i < end; i++) {
+        vector<ReplicateRefPtr> replicates;
+        for (int j = 0; j < FLAGS_log_bench_entries_per_append; j++) {
+          ReplicateRefPtr replicate = make_scoped_refptr_replicate(new ReplicateMsg());
+          ReplicateMsg* msg = replicate->get();
+          msg->mutable_id()->CopyFrom(MakeOpId(1, next_index[i - begin]++));
+          msg->set_timestamp(next_index[i - begin]);
+          msg->set_op_type(NO_OP);
+          msg->mutable_noop_request()->set_payload_for_tests(payload);
+          replicates.push_back(replicate);
+        }
+        Status s = logs_[i]->AsyncAppendReplicates(
+            replicates, Bind(&AppendFinished, &latency_us_, &latch, GetMonoTimeMicros()));
+        if (!s.ok()) {
+          LOG(WARNING) << "append to log " << i << " failed: " << s.ToString();
+          failed_appends_.Increment();
+          latch.CountDown();
+        }
+      }
+      latch.Wait();
+    } while (!stop_.WaitFor(interval));
+  }
+
+  void PrintConfig() const {
+    LOG(INFO) << "logs: " << FLAGS_log_bench_num_logs
+              << ", threads: " << FLAGS_log_bench_num_threads
+              << ", entries per append: " << FLAGS_log_bench_entries_per_append
+              << ", entry bytes: " << FLAGS_log_bench_entry_bytes
+              << ", append interval: " << FLAGS_log_bench_append_interval_us << "us";
+    LOG(INFO) << "log_force_fsync_all: " << FLAGS_log_force_fsync_all
+              << ", log_compression_codec: " << FLAGS_log_compression_codec
+              << ", log_segment_size_mb: " << FLAGS_log_segment_size_mb
+              << ", log_preallocate_segments: " << FLAGS_log_preallocate_segments
+              << ", log_async_preallocate_segments: " << FLAGS_log_async_preallocate_segments
+              << ", log_append_threads: " << FLAGS_log_append_threads
+              << ", log_group_commit_max_wait_us: " << FLAGS_log_group_commit_max_wait_us;
+  }
+
+  void PrintResults(double seconds) const {
+    const uint64_t appends = latency_us_.TotalCount();
+    const double entry_mb = static_cast<double>(FLAGS_log_bench_entry_bytes) *
+        FLAGS_log_bench_entries_per_append / (1024 * 1024);
+    LOG(INFO) << StringPrintf("%" PRIu64 " appends in %.2fs: %.1f appends/s, %.2f MB/s "
+                              "of payload, %" PRId64 " failed",
+                              appends, seconds, appends / seconds,
+                              appends * entry_mb / seconds, failed_appends_.Load());
+    LOG(INFO) << StringPrintf("append latency (us): mean %.1f, p50 %" PRIu64 ", p95 %" PRIu64
+                              ", p99 %" PRIu64 ", p99.9 %" PRIu64 ", p99.99 %" PRIu64
+                              ", max %" PRIu64,
+                              latency_us_.MeanValue(), latency_us_.ValueAtPercentile(50),
+                              latency_us_.ValueAtPercentile(95),
+                              latency_us_.ValueAtPercentile(99),
+                              latency_us_.ValueAtPercentile(99.9),
+                              latency_us_.ValueAtPercentile(99.99),
+                              latency_us_.MaxValue());
+  }
+
+  gscoped_ptr<FsManager> fs_manager_;
+  vector<scoped_refptr<Log>> logs_;
+  HdrHistogram latency_us_;
+  AtomicInt<int64_t> failed_appends_;
+  CountDownLatch stop_;
+};
+
+} // namespace log
+} // namespace kudu
+
+int main(int argc, char** argv) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  kudu::log::LogAppendBenchmark benchmark;
+  CHECK_OK(benchmark.Run());
+  return 0;
+}
@@ -53,6 +53,7 @@ using client::KuduStatusMemberCallback;
 using client::KuduTableCreator;
 using client::KuduUpdate;
 using client::KuduValue;
+using std::string;
 using std::vector;
 
 namespace {
@@ -105,8 +106,17 @@ RpcLineItemDAO::~RpcLineItemDAO() {
 RpcLineItemDAO::RpcLineItemDAO(string master_address, string table_name,
                                int batch_op_num_max, int timeout_ms,
                                vector<const KuduPartialRow*> tablet_splits)
+    : RpcLineItemDAO(std::move(master_address), std::move(table_name),
+                     tpch::CreateLineItemSchema(), batch_op_num_max, timeout_ms,
+                     std::move(tablet_splits)) {
+}
+
+RpcLineItemDAO::RpcLineItemDAO(string master_address, string table_name,
+                               KuduSchema schema, int batch_op_num_max, int timeout_ms,
+                               vector<const KuduPartialRow*> tablet_splits)
     : master_address_(std::move(master_address)),
       table_name_(std::move(table_name)),
+      schema_(std::move(schema)),
       timeout_(MonoDelta::FromMilliseconds(timeout_ms)),
       batch_op_num_max_(batch_op_num_max),
       tablet_splits_(std::move(tablet_splits)),
@@ -115,19 +125,23 @@ RpcLineItemDAO::RpcLineItemDAO(string master_address, string table_name,
 }
 
 void RpcLineItemDAO::Init() {
-  const KuduSchema schema = tpch::CreateLineItemSchema();
-
   CHECK_OK(KuduClientBuilder()
            .add_master_server_addr(master_address_)
            .default_rpc_timeout(timeout_)
            .Build(&client_));
   Status s = client_->OpenTable(table_name_, &client_table_);
   if (s.IsNotFound()) {
+    vector<int> key_indexes;
+    schema_.GetPrimaryKeyColumnIndexes(&key_indexes);
+    vector<string> key_columns;
+    for (int idx : key_indexes) {
+      key_columns.push_back(schema_.Column(idx).name());
+    }
     gscoped_ptr<KuduTableCreator> table_creator(client_->NewTableCreator());
     CHECK_OK(table_creator->table_name(table_name_)
-             .schema(&schema)
+             .schema(&schema_)
              .num_replicas(1)
-             .set_range_partition_columns({ tpch::kOrderKeyColName, tpch::kLineNumberColName })
+             .set_range_partition_columns(key_columns)
              .split_rows(tablet_splits_)
              .Create());
     CHECK_OK(client_->OpenTable(table_name_, &client_table_));
@@ -170,6 +184,23 @@ void RpcLineItemDAO::OpenScanner(const vector<string>& columns,
   OpenScannerImpl(columns, preds, out_scanner);
 }
 
+void RpcLineItemDAO::OpenScanner(const vector<string>& columns,
+                                 const vector<KuduPredicate*>& preds,
+                                 gscoped_ptr<Scanner>* out_scanner) {
+  OpenScannerImpl(columns, preds, out_scanner);
+}
+
+KuduPredicate* RpcLineItemDAO::NewComparisonPredicate(const Slice& col_name,
+                                                      KuduPredicate::ComparisonOp op,
+                                                      KuduValue* value) {
+  return client_table_->NewComparisonPredicate(col_name, op, value);
+}
+
+KuduPredicate* RpcLineItemDAO::NewInListPredicate(const Slice& col_name,
+                                                  vector<KuduValue*>* values) {
+  return client_table_->NewInListPredicate(col_name, values);
+}
+
 void RpcLineItemDAO::OpenTpch1Scanner(gscoped_ptr<Scanner>* out_scanner) {
   vector<KuduPredicate*> preds;
   preds.push_back(client_table_->NewComparisonPredicate(
@@ -239,4 +270,8 @@ void RpcLineItemDAO::Scanner::GetNext(vector<KuduRowResult> *rows) {
   CHECK_OK(scanner_->NextBatch(rows));
 }
 
+const client::ResourceMetrics& RpcLineItemDAO::Scanner::GetResourceMetrics() const {
+  return scanner_->GetResourceMetrics();
+}
+
 } // namespace kudu
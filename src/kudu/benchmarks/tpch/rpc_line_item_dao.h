@@ -25,6 +25,7 @@
 
 #include "kudu/benchmarks/tpch/tpch-schemas.h"
 #include "kudu/client/client.h"
+#include "kudu/client/resource_metrics.h"
 #include "kudu/client/row_result.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
@@ -41,6 +42,16 @@ class RpcLineItemDAO {
                  int batch_op_num_max,
                  int timeout_ms = 5000,
                  std::vector<const KuduPartialRow*> tablet_splits = {});
+
+  // Same as above, but for a table with the given schema, such as one of
+  // the other TPC-H tables. The table is range partitioned on its primary
+  // key.
+  RpcLineItemDAO(std::string master_address,
+                 std::string table_name,
+                 client::KuduSchema schema,
+                 int batch_op_num_max,
+                 int timeout_ms = 5000,
+                 std::vector<const KuduPartialRow*> tablet_splits = {});
   ~RpcLineItemDAO();
   void Init();
   void WriteLine(boost::function<void(KuduPartialRow*)> f);
@@ -51,6 +62,20 @@ class RpcLineItemDAO {
   // Projects only those column names listed in 'columns'.
   void OpenScanner(const std::vector<std::string>& columns,
                    gscoped_ptr<Scanner>* scanner);
+  // Same as above, but also pushes the predicates in 'preds' down to the
+  // servers. Takes ownership of the predicates.
+  void OpenScanner(const std::vector<std::string>& columns,
+                   const std::vector<client::KuduPredicate*>& preds,
+                   gscoped_ptr<Scanner>* scanner);
+
+  // Creates predicates on the table, to be passed to OpenScanner(). See the
+  // methods of KuduTable of the same names.
+  client::KuduPredicate* NewComparisonPredicate(const Slice& col_name,
+                                                client::KuduPredicate::ComparisonOp op,
+                                                client::KuduValue* value);
+  client::KuduPredicate* NewInListPredicate(const Slice& col_name,
+                                            std::vector<client::KuduValue*>* values);
+
   // Calls OpenScanner with the tpch1 query parameters.
   void OpenTpch1Scanner(gscoped_ptr<Scanner>* scanner);
 
@@ -72,6 +97,9 @@ class RpcLineItemDAO {
     // Return the next batch of rows into '*rows'. Any existing data is cleared.
     void GetNext(std::vector<client::KuduRowResult> *rows);
 
+    // Return the cumulative metrics the servers reported for the scan.
+    const client::ResourceMetrics& GetResourceMetrics() const;
+
    private:
     friend class RpcLineItemDAO;
     Scanner() {}
@@ -89,6 +117,7 @@ class RpcLineItemDAO {
 
   const std::string master_address_;
   const std::string table_name_;
+  const client::KuduSchema schema_;
   const MonoDelta timeout_;
   const int batch_op_num_max_;
   const std::vector<const KuduPartialRow*> tablet_splits_;
@@ -45,6 +45,25 @@ static const char* const kShipInstructColName = "l_shipinstruct";
 static const char* const kShipModeColName = "l_shipmode";
 static const char* const kCommentColName = "l_comment";
 
+static const char* const kOrdersOrderKeyColName = "o_orderkey";
+static const char* const kOrdersOrderPriorityColName = "o_orderpriority";
+static const char* const kPartPartKeyColName = "p_partkey";
+static const char* const kPartTypeColName = "p_type";
+
+static const char* const kRegionTableName = "region";
+static const char* const kNationTableName = "nation";
+static const char* const kPartTableName = "part";
+static const char* const kSupplierTableName = "supplier";
+static const char* const kPartSuppTableName = "partsupp";
+static const char* const kCustomerTableName = "customer";
+static const char* const kOrdersTableName = "orders";
+static const char* const kLineItemTableName = "lineitem";
+
+static const char* const kTableNames[] = {
+  kRegionTableName, kNationTableName, kPartTableName, kSupplierTableName,
+  kPartSuppTableName, kCustomerTableName, kOrdersTableName, kLineItemTableName
+};
+
 static const client::KuduColumnStorageAttributes::EncodingType kPlainEncoding =
   client::KuduColumnStorageAttributes::PLAIN_ENCODING;
 
@@ -104,6 +123,147 @@ inline client::KuduSchema CreateLineItemSchema() {
   return s;
 }
 
+// The schemas of the other tables list their columns in the order of the
+// columns of the '|' separated files generated by dbgen, so that the files
+// may be loaded by TpchTsvImporter. Their primary keys happen to be their
+// leading columns.
+
+inline client::KuduSchema CreateRegionSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+
+  b.AddColumn("r_regionkey")->Type(kInt32)->NotNull();
+  b.AddColumn("r_name")->Type(kString)->NotNull();
+  b.AddColumn("r_comment")->Type(kString)->NotNull();
+
+  b.SetPrimaryKey({ "r_regionkey" });
+
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateNationSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+
+  b.AddColumn("n_nationkey")->Type(kInt32)->NotNull();
+  b.AddColumn("n_name")->Type(kString)->NotNull();
+  b.AddColumn("n_regionkey")->Type(kInt32)->NotNull();
+  b.AddColumn("n_comment")->Type(kString)->NotNull();
+
+  b.SetPrimaryKey({ "n_nationkey" });
+
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreatePartSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+
+  b.AddColumn(kPartPartKeyColName)->Type(kInt32)->NotNull();
+  b.AddColumn("p_name")->Type(kString)->NotNull();
+  b.AddColumn("p_mfgr")->Type(kString)->NotNull();
+  b.AddColumn("p_brand")->Type(kString)->NotNull();
+  b.AddColumn(kPartTypeColName)->Type(kString)->NotNull();
+  b.AddColumn("p_size")->Type(kInt32)->NotNull();
+  b.AddColumn("p_container")->Type(kString)->NotNull();
+  b.AddColumn("p_retailprice")->Type(kDouble)->NotNull();
+  b.AddColumn("p_comment")->Type(kString)->NotNull();
+
+  b.SetPrimaryKey({ kPartPartKeyColName });
+
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateSupplierSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+
+  b.AddColumn("s_suppkey")->Type(kInt32)->NotNull();
+  b.AddColumn("s_name")->Type(kString)->NotNull();
+  b.AddColumn("s_address")->Type(kString)->NotNull();
+  b.AddColumn("s_nationkey")->Type(kInt32)->NotNull();
+  b.AddColumn("s_phone")->Type(kString)->NotNull();
+  b.AddColumn("s_acctbal")->Type(kDouble)->NotNull();
+  b.AddColumn("s_comment")->Type(kString)->NotNull();
+
+  b.SetPrimaryKey({ "s_suppkey" });
+
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreatePartSuppSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+
+  b.AddColumn("ps_partkey")->Type(kInt32)->NotNull();
+  b.AddColumn("ps_suppkey")->Type(kInt32)->NotNull();
+  b.AddColumn("ps_availqty")->Type(kInt32)->NotNull();
+  b.AddColumn("ps_supplycost")->Type(kDouble)->NotNull();
+  b.AddColumn("ps_comment")->Type(kString)->NotNull();
+
+  b.SetPrimaryKey({ "ps_partkey", "ps_suppkey" });
+
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateCustomerSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+
+  b.AddColumn("c_custkey")->Type(kInt32)->NotNull();
+  b.AddColumn("c_name")->Type(kString)->NotNull();
+  b.AddColumn("c_address")->Type(kString)->NotNull();
+  b.AddColumn("c_nationkey")->Type(kInt32)->NotNull();
+  b.AddColumn("c_phone")->Type(kString)->NotNull();
+  b.AddColumn("c_acctbal")->Type(kDouble)->NotNull();
+  b.AddColumn("c_mktsegment")->Type(kString)->NotNull();
+  b.AddColumn("c_comment")->Type(kString)->NotNull();
+
+  b.SetPrimaryKey({ "c_custkey" });
+
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateOrdersSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+
+  b.AddColumn(kOrdersOrderKeyColName)->Type(kInt64)->NotNull();
+  b.AddColumn("o_custkey")->Type(kInt32)->NotNull();
+  b.AddColumn("o_orderstatus")->Type(kString)->NotNull();
+  b.AddColumn("o_totalprice")->Type(kDouble)->NotNull();
+  b.AddColumn("o_orderdate")->Type(kString)->NotNull();
+  b.AddColumn(kOrdersOrderPriorityColName)->Type(kString)->NotNull();
+  b.AddColumn("o_clerk")->Type(kString)->NotNull();
+  b.AddColumn("o_shippriority")->Type(kInt32)->NotNull();
+  b.AddColumn("o_comment")->Type(kString)->NotNull()
+      ->Compression(client::KuduColumnStorageAttributes::LZ4);
+
+  b.SetPrimaryKey({ kOrdersOrderKeyColName });
+
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+// Returns the schema of the TPC-H table named 'table_name'.
+inline client::KuduSchema CreateSchemaForTable(const std::string& table_name) {
+  if (table_name == kRegionTableName) return CreateRegionSchema();
+  if (table_name == kNationTableName) return CreateNationSchema();
+  if (table_name == kPartTableName) return CreatePartSchema();
+  if (table_name == kSupplierTableName) return CreateSupplierSchema();
+  if (table_name == kPartSuppTableName) return CreatePartSuppSchema();
+  if (table_name == kCustomerTableName) return CreateCustomerSchema();
+  if (table_name == kOrdersTableName) return CreateOrdersSchema();
+  CHECK_EQ(table_name, kLineItemTableName) << "Unknown TPC-H table";
+  return CreateLineItemSchema();
+}
+
 inline std::vector<std::string> GetTpchQ1QueryColumns() {
   return { kShipDateColName,
            kReturnFlagColName,
@@ -0,0 +1,469 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// This utility loads the eight TPC-H tables, if they are empty, from the
+// '|' separated files generated by dbgen, one loader thread per table. It
+// then runs a set of scan-heavy TPC-H queries, as many times as asked,
+// reporting the runtime of every query as well as the metrics the tablet
+// servers reported for its scans.
+//
+// Kudu can't join tables nor aggregate on the servers, so the queries push
+// their projections and every predicate they can down to the servers, and
+// join and aggregate on the client.
+//
+// Usage:
+//   tpch_queries -tpch_path_to_data_dir=/home/jdcryans/tpch-sf1
+//                -tpch_queries=1,6,12,14
+//                -tpch_num_query_iterations=3
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/tpch/line_item_tsv_importer.h"
+#include "kudu/benchmarks/tpch/rpc_line_item_dao.h"
+#include "kudu/benchmarks/tpch/tpch-schemas.h"
+#include "kudu/benchmarks/tpch/tpch_tsv_importer.h"
+#include "kudu/client/value.h"
+#include "kudu/codegen/compilation_manager.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/master/mini_master.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
+
+DEFINE_string(tpch_path_to_data_dir, "/tmp/tpch-data",
+              "The directory containing the '|' separated files of the tables, "
+              "named <table>.tbl, as generated by dbgen.");
+DEFINE_string(tpch_queries, "1,6,12,14",
+              "Comma separated list of the TPC-H queries to run. Supported queries "
+              "are 1, 6, 12 and 14.");
+DEFINE_int32(tpch_num_query_iterations, 1, "Number of times every query will be run.");
+DEFINE_bool(use_mini_cluster, true,
+            "Create a mini cluster for the work to be performed against.");
+DEFINE_string(mini_cluster_base_dir, "/tmp/tpch",
+              "If using a mini cluster, directory for master/ts data.");
+DEFINE_string(master_address, "localhost",
+              "Address of master for the cluster to operate on");
+DEFINE_int32(tpch_max_batch_size, 1000,
+             "Maximum number of inserts/updates to batch at once.  Set to 0 "
+             "to delegate the batching control to the logic of the "
+             "KuduSession running in AUTO_BACKGROUND_MODE flush mode.");
+DEFINE_int32(tpch_client_timeout_msec, 60000,
+             "Timeout that will be used for all operations and RPCs");
+
+namespace kudu {
+
+using client::KuduPredicate;
+using client::KuduRowResult;
+using client::KuduValue;
+using std::map;
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+typedef map<string, std::unique_ptr<RpcLineItemDAO>> TableMap;
+
+// The runtime of a query, and the totals over all of its scans.
+struct QueryStats {
+  int64_t rows_returned;
+  map<string, int64_t> metrics;
+
+  QueryStats() : rows_returned(0) {}
+};
+
+// Drains 'scanner', calling 'f' on every row it returns, and adds the
+// metrics the servers reported for the scan to 'stats'.
+void ScanAll(RpcLineItemDAO::Scanner* scanner,
+             const boost::function<void(const KuduRowResult&)>& f,
+             QueryStats* stats) {
+  vector<KuduRowResult> rows;
+  while (scanner->HasMore()) {
+    scanner->GetNext(&rows);
+    for (const KuduRowResult& row : rows) {
+      f(row);
+    }
+    stats->rows_returned += rows.size();
+  }
+  for (const auto& metric : scanner->GetResourceMetrics().Get()) {
+    stats->metrics[metric.first] += metric.second;
+  }
+}
+
+void LoadTable(const string& table_name, RpcLineItemDAO* dao) {
+  string path = Substitute("$0/$1.tbl", FLAGS_tpch_path_to_data_dir, table_name);
+  LOG_TIMING(INFO, Substitute("loading $0", table_name)) {
+    if (table_name == tpch::kLineItemTableName) {
+      LineItemTsvImporter importer(path);
+      while (importer.HasNextLine()) {
+        dao->WriteLine(boost::bind(&LineItemTsvImporter::GetNextLine, &importer, _1));
+      }
+    } else {
+      TpchTsvImporter importer(path, tpch::CreateSchemaForTable(table_name));
+      while (importer.HasNextLine()) {
+        dao->WriteLine(boost::bind(&TpchTsvImporter::GetNextLine, &importer, _1));
+      }
+    }
+    dao->FinishWriting();
+  }
+}
+
+// Loads the tables which are empty, in parallel.
+void LoadTables(const TableMap& tables) {
+  vector<scoped_refptr<Thread>> loaders;
+  for (const auto& table : tables) {
+    if (!table.second->IsTableEmpty()) {
+      LOG(INFO) << "Data already in place for " << table.first;
+      continue;
+    }
+    scoped_refptr<Thread> loader;
+    CHECK_OK(Thread::Create("tpch", Substitute("load-$0", table.first),
+                            &LoadTable, table.first, table.second.get(), &loader));
+    loaders.push_back(loader);
+  }
+  for (const auto& loader : loaders) {
+    CHECK_OK(ThreadJoiner(loader.get()).Join());
+  }
+}
+
+// ---- QUERY : TPCH-Q1
+// # Q1 - Pricing Summary Report Query
+// select l_returnflag, l_linestatus,
+//   sum(l_quantity), sum(l_extendedprice),
+//   sum(l_extendedprice * (1 - l_discount)),
+//   sum(l_extendedprice * (1 - l_discount) * (1 + l_tax)),
+//   avg(l_quantity), avg(l_extendedprice), avg(l_discount), count(*)
+// from lineitem
+// where l_shipdate <= '1998-09-02'
+// group by l_returnflag, l_linestatus
+void Tpch1(const TableMap& tables, QueryStats* stats) {
+  struct Result {
+    int64_t sum_qty;
+    double sum_base_price;
+    double sum_disc_price;
+    double sum_charge;
+    double sum_disc;
+    int64_t count;
+    Result()
+      : sum_qty(0), sum_base_price(0), sum_disc_price(0), sum_charge(0), sum_disc(0), count(0) {
+    }
+  };
+  map<pair<string, string>, Result> results;
+
+  gscoped_ptr<RpcLineItemDAO::Scanner> scanner;
+  FindOrDie(tables, tpch::kLineItemTableName)->OpenTpch1Scanner(&scanner);
+  ScanAll(scanner.get(), [&](const KuduRowResult& row) {
+      Slice returnflag, linestatus;
+      int32_t quantity;
+      double extendedprice, discount, tax;
+      CHECK_OK(row.GetString(1, &returnflag));
+      CHECK_OK(row.GetString(2, &linestatus));
+      CHECK_OK(row.GetInt32(3, &quantity));
+      CHECK_OK(row.GetDouble(4, &extendedprice));
+      CHECK_OK(row.GetDouble(5, &discount));
+      CHECK_OK(row.GetDouble(6, &tax));
+
+      Result& r = results[{ returnflag.ToString(), linestatus.ToString() }];
+      r.sum_qty += quantity;
+      r.sum_base_price += extendedprice;
+      r.sum_disc_price += extendedprice * (1 - discount);
+      r.sum_charge += extendedprice * (1 - discount) * (1 + tax);
+      r.sum_disc += discount;
+      r.count++;
+    }, stats);
+
+  for (const auto& result : results) {
+    const Result& r = result.second;
+    LOG(INFO) << Substitute("Q1: $0, $1, $2, $3, $4, $5, $6, $7, $8, $9",
+                            result.first.first, result.first.second, r.sum_qty,
+                            StringPrintf("%.2f", r.sum_base_price),
+                            StringPrintf("%.2f", r.sum_disc_price),
+                            StringPrintf("%.2f", r.sum_charge),
+                            StringPrintf("%.2f", static_cast<double>(r.sum_qty) / r.count),
+                            StringPrintf("%.2f", r.sum_base_price / r.count),
+                            StringPrintf("%.2f", r.sum_disc / r.count),
+                            r.count);
+  }
+}
+
+// ---- QUERY : TPCH-Q6
+// # Q6 - Forecasting Revenue Change Query
+// select sum(l_extendedprice * l_discount) as revenue
+// from lineitem
+// where l_shipdate >= '1994-01-01' and l_shipdate < '1995-01-01'
+//   and l_discount between 0.05 and 0.07 and l_quantity < 24
+//
+// Every predicate is pushed down.
+void Tpch6(const TableMap& tables, QueryStats* stats) {
+  RpcLineItemDAO* dao = FindOrDie(tables, tpch::kLineItemTableName).get();
+  vector<KuduPredicate*> preds = {
+    dao->NewComparisonPredicate(tpch::kShipDateColName, KuduPredicate::GREATER_EQUAL,
+                                KuduValue::CopyString("1994-01-01")),
+    dao->NewComparisonPredicate(tpch::kShipDateColName, KuduPredicate::LESS,
+                                KuduValue::CopyString("1995-01-01")),
+    dao->NewComparisonPredicate(tpch::kDiscountColName, KuduPredicate::GREATER_EQUAL,
+                                KuduValue::FromDouble(0.05)),
+    dao->NewComparisonPredicate(tpch::kDiscountColName, KuduPredicate::LESS_EQUAL,
+                                KuduValue::FromDouble(0.07)),
+    dao->NewComparisonPredicate(tpch::kQuantityColName, KuduPredicate::LESS,
+                                KuduValue::FromInt(24))
+  };
+
+  double revenue = 0;
+  gscoped_ptr<RpcLineItemDAO::Scanner> scanner;
+  dao->OpenScanner({ tpch::kExtendedPriceColName, tpch::kDiscountColName }, preds, &scanner);
+  ScanAll(scanner.get(), [&](const KuduRowResult& row) {
+      double extendedprice, discount;
+      CHECK_OK(row.GetDouble(0, &extendedprice));
+      CHECK_OK(row.GetDouble(1, &discount));
+      revenue += extendedprice * discount;
+    }, stats);
+
+  LOG(INFO) << "Q6: " << StringPrintf("%.2f", revenue);
+}
+
+// ---- QUERY : TPCH-Q12
+// # Q12 - Shipping Modes and Order Priority Query
+// select l_shipmode,
+//   sum(case when o_orderpriority = '1-URGENT' or o_orderpriority = '2-HIGH'
+//       then 1 else 0 end) as high_line_count,
+//   sum(case when o_orderpriority <> '1-URGENT' and o_orderpriority <> '2-HIGH'
+//       then 1 else 0 end) as low_line_count
+// from orders, lineitem
+// where o_orderkey = l_orderkey and l_shipmode in ('MAIL', 'SHIP')
+//   and l_commitdate < l_receiptdate and l_shipdate < l_commitdate
+//   and l_receiptdate >= '1994-01-01' and l_receiptdate < '1995-01-01'
+// group by l_shipmode
+//
+// The predicates comparing columns to each other are evaluated on the
+// client, as is the hash join with orders.
+void Tpch12(const TableMap& tables, QueryStats* stats) {
+  RpcLineItemDAO* lineitem = FindOrDie(tables, tpch::kLineItemTableName).get();
+  RpcLineItemDAO* orders = FindOrDie(tables, tpch::kOrdersTableName).get();
+
+  // Whether every order is of high priority.
+  unordered_map<int64_t, bool> high_priority;
+  gscoped_ptr<RpcLineItemDAO::Scanner> scanner;
+  orders->OpenScanner({ tpch::kOrdersOrderKeyColName, tpch::kOrdersOrderPriorityColName },
+                      &scanner);
+  ScanAll(scanner.get(), [&](const KuduRowResult& row) {
+      int64_t orderkey;
+      Slice priority;
+      CHECK_OK(row.GetInt64(0, &orderkey));
+      CHECK_OK(row.GetString(1, &priority));
+      high_priority[orderkey] = priority == "1-URGENT" || priority == "2-HIGH";
+    }, stats);
+
+  vector<KuduValue*> shipmodes = { KuduValue::CopyString("MAIL"),
+                                   KuduValue::CopyString("SHIP") };
+  vector<KuduPredicate*> preds = {
+    lineitem->NewInListPredicate(tpch::kShipModeColName, &shipmodes),
+    lineitem->NewComparisonPredicate(tpch::kReceiptDateColName, KuduPredicate::GREATER_EQUAL,
+                                     KuduValue::CopyString("1994-01-01")),
+    lineitem->NewComparisonPredicate(tpch::kReceiptDateColName, KuduPredicate::LESS,
+                                     KuduValue::CopyString("1995-01-01"))
+  };
+
+  // Counts of high and low priority lines by ship mode.
+  map<string, pair<int64_t, int64_t>> results;
+  lineitem->OpenScanner({ tpch::kOrderKeyColName, tpch::kShipModeColName,
+                          tpch::kShipDateColName, tpch::kCommitDateColName,
+                          tpch::kReceiptDateColName },
+                        preds, &scanner);
+  ScanAll(scanner.get(), [&](const KuduRowResult& row) {
+      int64_t orderkey;
+      Slice shipmode, shipdate, commitdate, receiptdate;
+      CHECK_OK(row.GetInt64(0, &orderkey));
+      CHECK_OK(row.GetString(1, &shipmode));
+      CHECK_OK(row.GetString(2, &shipdate));
+      CHECK_OK(row.GetString(3, &commitdate));
+      CHECK_OK(row.GetString(4, &receiptdate));
+      if (commitdate.compare(receiptdate) >= 0 || shipdate.compare(commitdate) >= 0) {
+        return;
+      }
+      pair<int64_t, int64_t>& counts = results[shipmode.ToString()];
+      if (FindOrDie(high_priority, orderkey)) {
+        counts.first++;
+      } else {
+        counts.second++;
+      }
+    }, stats);
+
+  for (const auto& result : results) {
+    LOG(INFO) << Substitute("Q12: $0, $1, $2",
+                            result.first, result.second.first, result.second.second);
+  }
+}
+
+// ---- QUERY : TPCH-Q14
+// # Q14 - Promotion Effect Query
+// select 100.00 * sum(case when p_type like 'PROMO%'
+//                     then l_extendedprice * (1 - l_discount) else 0 end)
+//        / sum(l_extendedprice * (1 - l_discount)) as promo_revenue
+// from lineitem, part
+// where l_partkey = p_partkey
+//   and l_shipdate >= '1995-09-01' and l_shipdate < '1995-10-01'
+//
+// The hash join with part, and the LIKE predicate, are evaluated on the
+// client.
+void Tpch14(const TableMap& tables, QueryStats* stats) {
+  RpcLineItemDAO* lineitem = FindOrDie(tables, tpch::kLineItemTableName).get();
+  RpcLineItemDAO* part = FindOrDie(tables, tpch::kPartTableName).get();
+
+  unordered_set<int32_t> promo_parts;
+  gscoped_ptr<RpcLineItemDAO::Scanner> scanner;
+  part->OpenScanner({ tpch::kPartPartKeyColName, tpch::kPartTypeColName }, &scanner);
+  ScanAll(scanner.get(), [&](const KuduRowResult& row) {
+      int32_t partkey;
+      Slice type;
+      CHECK_OK(row.GetInt32(0, &partkey));
+      CHECK_OK(row.GetString(1, &type));
+      if (type.starts_with("PROMO")) {
+        promo_parts.insert(partkey);
+      }
+    }, stats);
+
+  vector<KuduPredicate*> preds = {
+    lineitem->NewComparisonPredicate(tpch::kShipDateColName, KuduPredicate::GREATER_EQUAL,
+                                     KuduValue::CopyString("1995-09-01")),
+    lineitem->NewComparisonPredicate(tpch::kShipDateColName, KuduPredicate::LESS,
+                                     KuduValue::CopyString("1995-10-01"))
+  };
+
+  double promo_revenue = 0;
+  double revenue = 0;
+  lineitem->OpenScanner({ tpch::kPartKeyColName, tpch::kExtendedPriceColName,
+                          tpch::kDiscountColName },
+                        preds, &scanner);
+  ScanAll(scanner.get(), [&](const KuduRowResult& row) {
+      int32_t partkey;
+      double extendedprice, discount;
+      CHECK_OK(row.GetInt32(0, &partkey));
+      CHECK_OK(row.GetDouble(1, &extendedprice));
+      CHECK_OK(row.GetDouble(2, &discount));
+      double line_revenue = extendedprice * (1 - discount);
+      revenue += line_revenue;
+      if (ContainsKey(promo_parts, partkey)) {
+        promo_revenue += line_revenue;
+      }
+    }, stats);
+
+  LOG(INFO) << "Q14: " << StringPrintf("%.2f", revenue == 0 ? 0 : 100 * promo_revenue / revenue);
+}
+
+void RunQuery(int query, const TableMap& tables) {
+  typedef void (*QueryFunction)(const TableMap&, QueryStats*);
+  static const map<int, QueryFunction> kQueries = {
+    { 1, &Tpch1 },
+    { 6, &Tpch6 },
+    { 12, &Tpch12 },
+    { 14, &Tpch14 },
+  };
+  QueryFunction f = FindWithDefault(kQueries, query, nullptr);
+  CHECK(f != nullptr) << "Unsupported query: Q" << query;
+
+  QueryStats stats;
+  Stopwatch sw;
+  sw.start();
+  f(tables, &stats);
+  sw.stop();
+
+  LOG(INFO) << Substitute("Q$0 took $1: $2 rows returned by the servers",
+                          query, sw.elapsed().ToString(), stats.rows_returned);
+  for (const auto& metric : stats.metrics) {
+    LOG(INFO) << Substitute("Q$0 $1: $2", query, metric.first, metric.second);
+  }
+}
+
+} // namespace kudu
+
+int main(int argc, char **argv) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  std::vector<int> queries;
+  std::vector<std::string> query_strs = strings::Split(FLAGS_tpch_queries, ",",
+                                                       strings::SkipEmpty());
+  for (const std::string& query : query_strs) {
+    int32 q;
+    CHECK(safe_strto32(query, &q)) << "Bad query: " << query;
+    queries.push_back(q);
+  }
+
+  kudu::Env* env;
+  gscoped_ptr<kudu::MiniCluster> cluster;
+  std::string master_address;
+  if (FLAGS_use_mini_cluster) {
+    env = kudu::Env::Default();
+    kudu::Status s = env->CreateDir(FLAGS_mini_cluster_base_dir);
+    CHECK(s.IsAlreadyPresent() || s.ok()) << s.ToString();
+    kudu::MiniClusterOptions options;
+    options.data_root = FLAGS_mini_cluster_base_dir;
+    cluster.reset(new kudu::MiniCluster(env, options));
+    CHECK_OK(cluster->StartSync());
+    master_address = cluster->mini_master()->bound_rpc_addr_str();
+  } else {
+    master_address = FLAGS_master_address;
+  }
+
+  kudu::TableMap tables;
+  for (const char* table_name : kudu::tpch::kTableNames) {
+    std::unique_ptr<kudu::RpcLineItemDAO> dao(
+        new kudu::RpcLineItemDAO(master_address, table_name,
+                                 kudu::tpch::CreateSchemaForTable(table_name),
+                                 FLAGS_tpch_max_batch_size, FLAGS_tpch_client_timeout_msec));
+    dao->Init();
+    tables[table_name] = std::move(dao);
+  }
+
+  LOG_TIMING(INFO, "loading") {
+    kudu::LoadTables(tables);
+  }
+  kudu::codegen::CompilationManager::GetSingleton()->Wait();
+
+  for (int i = 0; i < FLAGS_tpch_num_query_iterations; i++) {
+    for (int query : queries) {
+      kudu::RunQuery(query, tables);
+    }
+  }
+
+  tables.clear();
+  if (cluster) {
+    cluster->Shutdown();
+  }
+  return 0;
+}
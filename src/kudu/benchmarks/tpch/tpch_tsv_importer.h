@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TPCH_TPCH_TSV_IMPORTER_H
+#define KUDU_TPCH_TPCH_TSV_IMPORTER_H
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/client/schema.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/stringpiece.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// Utility class used to parse the '|' separated files of the TPC-H tables
+// other than lineitem, whose schemas list their columns in the order of
+// the files.
+class TpchTsvImporter {
+ public:
+  TpchTsvImporter(const std::string& path, client::KuduSchema schema)
+    : in_(path.c_str()),
+      schema_(std::move(schema)),
+      updated_(false),
+      done_(false) {
+    CHECK(in_.is_open()) << "not able to open input file: " << path;
+  }
+
+  bool HasNextLine() {
+    if (!updated_) {
+      done_ = !getline(in_, line_);
+      updated_ = true;
+    }
+    return !done_;
+  }
+
+  // Fills the row builder with the next row from the file.
+  void GetNextLine(KuduPartialRow* row) {
+    if (!HasNextLine()) return;
+
+    // dbgen terminates every line with a separator, so there may be one
+    // more (empty) field than there are columns.
+    columns_ = strings::Split(line_, "|");
+    CHECK_GE(columns_.size(), schema_.num_columns()) << "Bad line: '" << line_ << "'";
+
+    // The row copies all indirect data from columns_, which refers to line_.
+    for (size_t i = 0; i < schema_.num_columns(); i++) {
+      const StringPiece& chars = columns_[i];
+      switch (schema_.Column(i).type()) {
+        case client::KuduColumnSchema::INT32: {
+          chars.CopyToString(&tmp_);
+          int32_t number;
+          CHECK(SimpleAtoi(tmp_.c_str(), &number))
+              << "Bad integer in column " << i << ": '" << tmp_ << "'";
+          CHECK_OK(row->SetInt32(i, number));
+          break;
+        }
+        case client::KuduColumnSchema::INT64: {
+          chars.CopyToString(&tmp_);
+          int64_t number;
+          CHECK(safe_strto64(tmp_.c_str(), &number))
+              << "Bad integer in column " << i << ": '" << tmp_ << "'";
+          CHECK_OK(row->SetInt64(i, number));
+          break;
+        }
+        case client::KuduColumnSchema::DOUBLE: {
+          chars.CopyToString(&tmp_);
+          double number;
+          CHECK(safe_strtod(tmp_.c_str(), &number))
+              << "Bad double in column " << i << ": '" << tmp_ << "'";
+          CHECK_OK(row->SetDouble(i, number));
+          break;
+        }
+        case client::KuduColumnSchema::STRING:
+          CHECK_OK(row->SetStringCopy(i, Slice(chars.data(), chars.size())));
+          break;
+        default:
+          LOG(FATAL) << "Unexpected type of column " << i;
+      }
+    }
+
+    updated_ = false;
+  }
+
+ private:
+  std::ifstream in_;
+  const client::KuduSchema schema_;
+  std::vector<StringPiece> columns_;
+  std::string line_, tmp_;
+  bool updated_, done_;
+};
+
+} // namespace kudu
+#endif
@@ -0,0 +1,729 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// A native driver for the YCSB core workloads, using the C++ client.
+//
+// The driver first loads 'ycsb_record_count' records into the table (unless
+// --ycsb_load=false), then runs 'ycsb_operation_count' operations of the
+// chosen workload from 'ycsb_threads' threads, and prints the throughput
+// and the latency percentiles of each type of operation.
+//
+// The workloads are those of YCSB's core package:
+//
+//   A: 50% reads, 50% updates, zipfian keys
+//   B: 95% reads, 5% updates, zipfian keys
+//   C: 100% reads, zipfian keys
+//   D: 95% reads, 5% inserts, reads favor the latest inserted keys
+//   E: 95% short range scans, 5% inserts, zipfian start keys
+//   F: 50% reads, 50% read-modify-writes, zipfian keys
+//
+// As in YCSB, keys are "user" followed by a hash of the record number, so
+// that inserts are spread across the table, and updates write a single
+// random field.
+//
+// Usage:
+//   ycsb -ycsb_workload=a -ycsb_record_count=1000000 -ycsb_threads=16
+//   ycsb -use_mini_cluster=false -master_address=m1,m2,m3 -ycsb_workload=e
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/ycsb-schema.h"
+#include "kudu/client/client.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/master/mini_master.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
+
+DEFINE_string(ycsb_workload, "a", "The YCSB core workload to run: one of a, b, c, d, e or f.");
+DEFINE_string(ycsb_request_distribution, "",
+              "If set, overrides the distribution of the keys chosen by the workload: "
+              "one of uniform, zipfian or latest.");
+DEFINE_int64(ycsb_record_count, 1000000, "Number of records loaded into the table.");
+DEFINE_int64(ycsb_operation_count, 1000000,
+             "Number of operations to run, across all threads.");
+DEFINE_int32(ycsb_max_execution_seconds, 0,
+             "If positive, the operations stop after this many seconds even if "
+             "fewer than --ycsb_operation_count were run.");
+DEFINE_int32(ycsb_threads, 16, "Number of threads loading records and running operations.");
+DEFINE_int32(ycsb_field_length, 100, "Length of the values of each field.");
+DEFINE_int32(ycsb_max_scan_length, 100,
+             "Maximum number of rows read by scans. The length of each scan is "
+             "uniformly distributed between 1 and this.");
+DEFINE_bool(ycsb_load, true, "Whether to load the records before running the operations.");
+DEFINE_int32(ycsb_load_batch_size, 1000, "Number of inserts flushed at once while loading.");
+DEFINE_int32(ycsb_num_tablets, 8,
+             "Number of tablets of the table, if it is created. The table is range "
+             "partitioned on the key, so that scans read the keys in order.");
+DEFINE_int32(ycsb_num_replicas, 1, "Number of replicas of the table, if it is created.");
+DEFINE_bool(use_mini_cluster, true,
+            "Create a mini cluster for the work to be performed against.");
+DEFINE_string(mini_cluster_base_dir, "/tmp/ycsb",
+              "If using a mini cluster, directory for master/ts data.");
+DEFINE_string(master_address, "localhost",
+              "Address of master for the cluster to operate on");
+DEFINE_string(table_name, "usertable", "The table name to write/read");
+
+namespace kudu {
+
+using client::KuduClient;
+using client::KuduClientBuilder;
+using client::KuduError;
+using client::KuduInsert;
+using client::KuduPredicate;
+using client::KuduScanBatch;
+using client::KuduScanner;
+using client::KuduSchema;
+using client::KuduSession;
+using client::KuduTable;
+using client::KuduTableCreator;
+using client::KuduUpdate;
+using client::KuduValue;
+using client::KuduWriteOperation;
+using client::sp::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace {
+
+const int kNumFields = 10;
+
+// YCSB's default skew of zipfian distributions.
+const double kZipfianTheta = 0.99;
+
+// As in YCSB, zipfian keys are drawn from a fixed, large number of items
+// whose hashes are then mapped onto the records, so that the popular
+// records are spread across the table and their popularity doesn't depend
+// on the number of records. This is the zeta constant of that many items.
+const uint64_t kScrambledItems = 10000000000ULL;
+const double kScrambledZetan = 26.46902820178302;
+
+// The distribution of the keys chosen by the operations.
+enum Distribution {
+  UNIFORM,
+  ZIPFIAN,
+  LATEST
+};
+
+// The types of operations, in the order they are reported.
+enum OpType {
+  READ,
+  UPDATE,
+  INSERT,
+  SCAN,
+  READ_MODIFY_WRITE,
+  kNumOpTypes
+};
+
+const char* const kOpTypeNames[] = {
+  "READ", "UPDATE", "INSERT", "SCAN", "READ-MODIFY-WRITE"
+};
+
+// The proportion of each type of operation of a workload, and the
+// distribution of its keys.
+struct Workload {
+  double proportions[kNumOpTypes];
+  Distribution distribution;
+};
+
+Status GetWorkload(const string& name, Workload* workload) {
+  //                                 read  update insert scan  rmw
+  static const Workload kA = { { 0.5,  0.5,   0,     0,    0   }, ZIPFIAN };
+  static const Workload kB = { { 0.95, 0.05,  0,     0,    0   }, ZIPFIAN };
+  static const Workload kC = { { 1,    0,     0,     0,    0   }, ZIPFIAN };
+  static const Workload kD = { { 0.95, 0,     0.05,  0,    0   }, LATEST };
+  static const Workload kE = { { 0,    0,     0.05,  0.95, 0   }, ZIPFIAN };
+  static const Workload kF = { { 0.5,  0,     0,     0,    0.5 }, ZIPFIAN };
+  if (name == "a") {
+    *workload = kA;
+  } else if (name == "b") {
+    *workload = kB;
+  } else if (name == "c") {
+    *workload = kC;
+  } else if (name == "d") {
+    *workload = kD;
+  } else if (name == "e") {
+    *workload = kE;
+  } else if (name == "f") {
+    *workload = kF;
+  } else {
+    return Status::InvalidArgument("unknown workload", name);
+  }
+
+  const string& dist = FLAGS_ycsb_request_distribution;
+  if (dist == "uniform") {
+    workload->distribution = UNIFORM;
+  } else if (dist == "zipfian") {
+    workload->distribution = ZIPFIAN;
+  } else if (dist == "latest") {
+    workload->distribution = LATEST;
+  } else if (!dist.empty()) {
+    return Status::InvalidArgument("unknown request distribution", dist);
+  }
+  return Status::OK();
+}
+
+// YCSB's 64-bit FNV-1a hash of a record number, used to scatter the keys.
+uint64_t FnvHash64(uint64_t val) {
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (int i = 0; i < 8; i++) {
+    hash ^= val & 0xff;
+    hash *= 1099511628211ULL;
+    val >>= 8;
+  }
+  return hash;
+}
+
+// Zero-padded, so that the keys of uniformly distributed hashes are
+// uniformly distributed across the range partitions.
+string KeyForRecord(uint64_t record) {
+  return StringPrintf("user%020" PRIu64, FnvHash64(record));
+}
+
+// Draws items from [0, n) following a zipfian distribution, with the
+// algorithm of Gray et al., "Quickly Generating Billion-Record Synthetic
+// Databases", as YCSB does. Item 0 is the most popular.
+//
+// The number of items may grow between draws, in which case the zeta
+// constant is updated incrementally.
+//
+// This class is not thread-safe.
+class ZipfianGenerator {
+ public:
+  // 'zetan' is the zeta constant of 'items', if known. Otherwise, it is
+  // computed, in time linear in 'items'.
+  explicit ZipfianGenerator(uint64_t items, double zetan = 0)
+    : items_(items),
+      alpha_(1.0 / (1.0 - kZipfianTheta)),
+      zeta2_(Zeta(0, 2)),
+      zetan_(zetan > 0 ? zetan : Zeta(0, items)) {
+    UpdateEta();
+  }
+
+  uint64_t Next(Random* rng) {
+    double u = rng->NextDoubleFraction();
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, kZipfianTheta)) {
+      return 1;
+    }
+    uint64_t ret = static_cast<uint64_t>(items_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return std::min(ret, items_ - 1);
+  }
+
+  // Like Next(), after growing the number of items to 'items' if it is
+  // larger.
+  uint64_t Next(Random* rng, uint64_t items) {
+    if (items > items_) {
+      zetan_ += Zeta(items_, items);
+      items_ = items;
+      UpdateEta();
+    }
+    return Next(rng);
+  }
+
+ private:
+  // Returns the sum of 1/i^theta for i in (from, to].
+  static double Zeta(uint64_t from, uint64_t to) {
+    double sum = 0;
+    for (uint64_t i = from + 1; i <= to; i++) {
+      sum += 1.0 / std::pow(i, kZipfianTheta);
+    }
+    return sum;
+  }
+
+  void UpdateEta() {
+    eta_ = (1.0 - std::pow(2.0 / items_, 1.0 - kZipfianTheta)) / (1.0 - zeta2_ / zetan_);
+  }
+
+  uint64_t items_;
+  const double alpha_;
+  const double zeta2_;
+  double zetan_;
+  double eta_;
+};
+
+// Chooses the records which operations read or update, among the records
+// inserted so far.
+//
+// This class is not thread-safe.
+class KeyChooser {
+ public:
+  // 'latest' is copied for the chooser's own use, rather than computing
+  // the zeta constant of the records again for each chooser.
+  KeyChooser(Distribution distribution, const ZipfianGenerator& latest)
+    : distribution_(distribution),
+      scrambled_(kScrambledItems, kScrambledZetan),
+      latest_(latest) {
+  }
+
+  // Returns a record among the first 'num_records'.
+  uint64_t Next(Random* rng, uint64_t num_records) {
+    switch (distribution_) {
+      case UNIFORM:
+        return rng->Uniform64(num_records);
+      case ZIPFIAN:
+        return FnvHash64(scrambled_.Next(rng)) % num_records;
+      case LATEST:
+        return num_records - 1 - latest_.Next(rng, num_records);
+    }
+    LOG(FATAL) << "unknown distribution " << distribution_;
+    return 0;
+  }
+
+ private:
+  const Distribution distribution_;
+  ZipfianGenerator scrambled_;
+  ZipfianGenerator latest_;
+};
+
+// The latencies of an operation type, in microseconds, and its failures.
+struct OpStats {
+  OpStats()
+    // Up to a minute, with 3 significant digits.
+    : latency_us(60 * 1000 * 1000, 3),
+      failures(0) {
+  }
+
+  HdrHistogram latency_us;
+  AtomicInt<int64_t> failures;
+};
+
+class YcsbRunner {
+ public:
+  YcsbRunner(const string& master_address, const Workload& workload)
+    : master_address_(master_address),
+      workload_(workload),
+      next_record_(FLAGS_ycsb_record_count),
+      inserted_records_(FLAGS_ycsb_record_count),
+      load_failures_(0),
+      ops_started_(0),
+      stopped_(false),
+      run_seconds_(0) {
+    // Random values for the fields, which are slices of this buffer at
+    // random offsets.
+    Random rng(GetRandomSeed32());
+    field_data_.resize(1024 * 1024 + FLAGS_ycsb_field_length);
+    for (char& c : field_data_) {
+      c = static_cast<char>(' ' + rng.Uniform(95));
+    }
+    for (int i = 0; i < kNumOpTypes; i++) {
+      stats_.emplace_back(new OpStats());
+    }
+  }
+
+  Status Init() {
+    RETURN_NOT_OK(KuduClientBuilder()
+                  .add_master_server_addr(master_address_)
+                  .Build(&client_));
+    Status s = client_->OpenTable(FLAGS_table_name, &table_);
+    if (s.IsNotFound()) {
+      RETURN_NOT_OK(CreateTable());
+      s = client_->OpenTable(FLAGS_table_name, &table_);
+    }
+    return s;
+  }
+
+  // Inserts the records [0, --ycsb_record_count) from all the threads.
+  Status Load() {
+    Stopwatch sw;
+    sw.start();
+    RETURN_NOT_OK(RunThreads("loader", &YcsbRunner::LoadThread));
+    sw.stop();
+    LOG(INFO) << Substitute("Loaded $0 records in $1 seconds ($2 records/s), $3 failed",
+                            FLAGS_ycsb_record_count, sw.elapsed().wall_seconds(),
+                            FLAGS_ycsb_record_count / sw.elapsed().wall_seconds(),
+                            load_failures_.Load());
+    return Status::OK();
+  }
+
+  // Runs the operations of the workload from all the threads.
+  Status Run() {
+    Stopwatch sw;
+    sw.start();
+    run_start_ = MonoTime::Now();
+    RETURN_NOT_OK(RunThreads("worker", &YcsbRunner::RunThread));
+    sw.stop();
+    run_seconds_ = sw.elapsed().wall_seconds();
+    return Status::OK();
+  }
+
+  void PrintReport() const {
+    int64_t total_ops = 0;
+    for (const auto& stats : stats_) {
+      total_ops += stats->latency_us.TotalCount();
+    }
+    std::cout << Substitute("[OVERALL] RunTime(s): $0", run_seconds_) << std::endl;
+    std::cout << Substitute("[OVERALL] Throughput(ops/s): $0", total_ops / run_seconds_)
+              << std::endl;
+    for (int i = 0; i < kNumOpTypes; i++) {
+      const HdrHistogram& hist = stats_[i]->latency_us;
+      if (hist.TotalCount() == 0) {
+        continue;
+      }
+      std::cout << Substitute("[$0] Operations: $1, Failures: $2",
+                              kOpTypeNames[i], hist.TotalCount(), stats_[i]->failures.Load())
+                << std::endl;
+      std::cout << StringPrintf("[%s] Latency(us): mean %.1f, min %" PRIu64 ", "
+                                "p50 %" PRIu64 ", p95 %" PRIu64 ", p99 %" PRIu64 ", "
+                                "p99.9 %" PRIu64 ", max %" PRIu64,
+                                kOpTypeNames[i], hist.MeanValue(), hist.MinValue(),
+                                hist.ValueAtPercentile(50), hist.ValueAtPercentile(95),
+                                hist.ValueAtPercentile(99), hist.ValueAtPercentile(99.9),
+                                hist.MaxValue())
+                << std::endl;
+    }
+  }
+
+ private:
+  typedef void (YcsbRunner::*ThreadFunc)(int thread_idx);
+
+  Status CreateTable() {
+    KuduSchema schema(CreateYCSBSchema());
+    gscoped_ptr<KuduTableCreator> table_creator(client_->NewTableCreator());
+    table_creator->table_name(FLAGS_table_name)
+        .schema(&schema)
+        .num_replicas(FLAGS_ycsb_num_replicas)
+        .set_range_partition_columns({ "key" });
+    // The hashes of the records are uniformly distributed, and so are the
+    // keys of the records across evenly spaced splits.
+    for (int i = 1; i < FLAGS_ycsb_num_tablets; i++) {
+      KuduPartialRow* split = schema.NewRow();
+      uint64_t hash = std::numeric_limits<uint64_t>::max() / FLAGS_ycsb_num_tablets * i;
+      RETURN_NOT_OK(split->SetStringCopy("key", StringPrintf("user%020" PRIu64, hash)));
+      table_creator->add_range_partition_split(split);
+    }
+    return table_creator->Create();
+  }
+
+  Status RunThreads(const string& name, ThreadFunc f) {
+    vector<scoped_refptr<Thread>> threads;
+    for (int i = 0; i < FLAGS_ycsb_threads; i++) {
+      scoped_refptr<Thread> thread;
+      RETURN_NOT_OK(Thread::Create("ycsb", Substitute("$0-$1", name, i),
+                                   f, this, i, &thread));
+      threads.push_back(thread);
+    }
+    for (const auto& thread : threads) {
+      RETURN_NOT_OK(ThreadJoiner(thread.get()).Join());
+    }
+    return Status::OK();
+  }
+
+  shared_ptr<KuduSession> NewSession(KuduSession::FlushMode mode) {
+    shared_ptr<KuduSession> session = client_->NewSession();
+    CHECK_OK(session->SetFlushMode(mode));
+    session->SetTimeoutMillis(60000);
+    return session;
+  }
+
+  // Returns a random value for a field.
+  Slice FieldValue(Random* rng) const {
+    return Slice(&field_data_[rng->Uniform(field_data_.size() - FLAGS_ycsb_field_length)],
+                 FLAGS_ycsb_field_length);
+  }
+
+  void FillRecord(uint64_t record, Random* rng, KuduInsert* insert) const {
+    KuduPartialRow* row = insert->mutable_row();
+    CHECK_OK(row->SetStringCopy("key", KeyForRecord(record)));
+    for (int i = 0; i < kNumFields; i++) {
+      // The field data outlives the session.
+      CHECK_OK(row->SetStringNoCopy(i + 1, FieldValue(rng)));
+    }
+  }
+
+  void LoadThread(int thread_idx) {
+    Random rng(GetRandomSeed32() + thread_idx);
+    shared_ptr<KuduSession> session = NewSession(KuduSession::MANUAL_FLUSH);
+    int pending = 0;
+    for (int64_t record = thread_idx; record < FLAGS_ycsb_record_count;
+         record += FLAGS_ycsb_threads) {
+      gscoped_ptr<KuduInsert> insert(table_->NewInsert());
+      FillRecord(record, &rng, insert.get());
+      CHECK_OK(session->Apply(insert.release()));
+      if (++pending == FLAGS_ycsb_load_batch_size) {
+        FlushLoad(session.get());
+        pending = 0;
+      }
+    }
+    FlushLoad(session.get());
+  }
+
+  void FlushLoad(KuduSession* session) {
+    Status s = session->Flush();
+    if (!s.ok()) {
+      vector<KuduError*> errors;
+      ElementDeleter deleter(&errors);
+      bool overflowed;
+      session->GetPendingErrors(&errors, &overflowed);
+      load_failures_.IncrementBy(errors.size());
+      if (!errors.empty()) {
+        LOG_EVERY_N(WARNING, 100) << "Failed to load record: "
+                                  << errors[0]->status().ToString();
+      }
+    }
+  }
+
+  OpType ChooseOp(Random* rng) const {
+    double r = rng->NextDoubleFraction();
+    for (int i = 0; i < kNumOpTypes - 1; i++) {
+      if (r < workload_.proportions[i]) {
+        return static_cast<OpType>(i);
+      }
+      r -= workload_.proportions[i];
+    }
+    return static_cast<OpType>(kNumOpTypes - 1);
+  }
+
+  bool ShouldStop() {
+    if (stopped_.Load()) {
+      return true;
+    }
+    if (ops_started_.Increment() > FLAGS_ycsb_operation_count ||
+        (FLAGS_ycsb_max_execution_seconds > 0 &&
+         MonoTime::Now() - run_start_ >
+         MonoDelta::FromSeconds(FLAGS_ycsb_max_execution_seconds))) {
+      stopped_.Store(true);
+      return true;
+    }
+    return false;
+  }
+
+  void RunThread(int thread_idx) {
+    Random rng(GetRandomSeed32() + thread_idx);
+    // Computing the zeta constant of the records is linear in their number,
+    // so the latest-record generator is only created for workloads which
+    // use it.
+    gscoped_ptr<KeyChooser> chooser;
+    {
+      std::lock_guard<simple_spinlock> l(latest_lock_);
+      if (workload_.distribution == LATEST && !latest_) {
+        latest_.reset(new ZipfianGenerator(std::max<int64_t>(FLAGS_ycsb_record_count, 1)));
+      }
+      chooser.reset(new KeyChooser(workload_.distribution,
+                                   latest_ ? *latest_ : ZipfianGenerator(1)));
+    }
+    shared_ptr<KuduSession> session = NewSession(KuduSession::AUTO_FLUSH_SYNC);
+
+    while (!ShouldStop()) {
+      OpType op = ChooseOp(&rng);
+      MonoTime start = MonoTime::Now();
+      Status s;
+      switch (op) {
+        case READ:
+          s = DoRead(ChooseRecord(chooser.get(), &rng));
+          break;
+        case UPDATE:
+          s = DoUpdate(session.get(), ChooseRecord(chooser.get(), &rng), &rng);
+          break;
+        case INSERT:
+          s = DoInsert(session.get(), &rng);
+          break;
+        case SCAN:
+          s = DoScan(ChooseRecord(chooser.get(), &rng),
+                     1 + rng.Uniform(FLAGS_ycsb_max_scan_length));
+          break;
+        case READ_MODIFY_WRITE: {
+          uint64_t record = ChooseRecord(chooser.get(), &rng);
+          s = DoRead(record);
+          if (s.ok()) {
+            s = DoUpdate(session.get(), record, &rng);
+          }
+          break;
+        }
+        default:
+          LOG(FATAL) << "unknown operation " << op;
+      }
+      OpStats* stats = stats_[op].get();
+      stats->latency_us.Increment((MonoTime::Now() - start).ToMicroseconds());
+      if (!s.ok()) {
+        stats->failures.Increment();
+        LOG_EVERY_N(WARNING, 1000) << kOpTypeNames[op] << " failed: " << s.ToString();
+      }
+    }
+  }
+
+  uint64_t ChooseRecord(KeyChooser* chooser, Random* rng) {
+    return chooser->Next(rng, std::max<int64_t>(inserted_records_.Load(), 1));
+  }
+
+  Status DoRead(uint64_t record) {
+    KuduScanner scanner(table_.get());
+    RETURN_NOT_OK(scanner.AddConjunctPredicate(table_->NewComparisonPredicate(
+        "key", KuduPredicate::EQUAL, KuduValue::CopyString(KeyForRecord(record)))));
+    RETURN_NOT_OK(scanner.Open());
+    int rows = 0;
+    KuduScanBatch batch;
+    while (scanner.HasMoreRows()) {
+      RETURN_NOT_OK(scanner.NextBatch(&batch));
+      rows += batch.NumRows();
+    }
+    if (rows != 1) {
+      return Status::NotFound(Substitute("record $0 read $1 rows", record, rows));
+    }
+    return Status::OK();
+  }
+
+  Status DoScan(uint64_t record, int length) {
+    KuduScanner scanner(table_.get());
+    gscoped_ptr<KuduPartialRow> start(table_->schema().NewRow());
+    RETURN_NOT_OK(start->SetStringCopy("key", KeyForRecord(record)));
+    RETURN_NOT_OK(scanner.AddLowerBound(*start));
+    RETURN_NOT_OK(scanner.Open());
+    int rows = 0;
+    KuduScanBatch batch;
+    while (rows < length && scanner.HasMoreRows()) {
+      RETURN_NOT_OK(scanner.NextBatch(&batch));
+      rows += batch.NumRows();
+    }
+    scanner.Close();
+    return Status::OK();
+  }
+
+  Status DoUpdate(KuduSession* session, uint64_t record, Random* rng) {
+    gscoped_ptr<KuduUpdate> update(table_->NewUpdate());
+    KuduPartialRow* row = update->mutable_row();
+    RETURN_NOT_OK(row->SetStringCopy("key", KeyForRecord(record)));
+    RETURN_NOT_OK(row->SetStringNoCopy(1 + rng->Uniform(kNumFields), FieldValue(rng)));
+    return Apply(session, update.release());
+  }
+
+  Status DoInsert(KuduSession* session, Random* rng) {
+    uint64_t record = next_record_.Increment() - 1;
+    gscoped_ptr<KuduInsert> insert(table_->NewInsert());
+    FillRecord(record, rng, insert.get());
+    Status s = Apply(session, insert.release());
+    if (s.ok()) {
+      // Reads only choose among the records known to be inserted. Records
+      // inserted concurrently may complete out of order, so this is
+      // approximate, as in YCSB.
+      inserted_records_.StoreMax(record + 1);
+    }
+    return s;
+  }
+
+  // Applies 'op' in an AUTO_FLUSH_SYNC session, returning the error of the
+  // operation, if any.
+  static Status Apply(KuduSession* session, KuduWriteOperation* op) {
+    Status s = session->Apply(op);
+    if (!s.ok()) {
+      vector<KuduError*> errors;
+      ElementDeleter deleter(&errors);
+      bool overflowed;
+      session->GetPendingErrors(&errors, &overflowed);
+      if (!errors.empty()) {
+        return errors[0]->status();
+      }
+    }
+    return s;
+  }
+
+  const string master_address_;
+  const Workload workload_;
+  shared_ptr<KuduClient> client_;
+  shared_ptr<KuduTable> table_;
+
+  string field_data_;
+
+  // The next record to insert, and the number of records known to be
+  // inserted.
+  AtomicInt<int64_t> next_record_;
+  AtomicInt<int64_t> inserted_records_;
+
+  AtomicInt<int64_t> load_failures_;
+  AtomicInt<int64_t> ops_started_;
+  AtomicBool stopped_;
+  MonoTime run_start_;
+  double run_seconds_;
+
+  simple_spinlock latest_lock_;
+  gscoped_ptr<ZipfianGenerator> latest_;
+
+  vector<unique_ptr<OpStats>> stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(YcsbRunner);
+};
+
+} // anonymous namespace
+} // namespace kudu
+
+int main(int argc, char** argv) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  kudu::Workload workload;
+  CHECK_OK(kudu::GetWorkload(FLAGS_ycsb_workload, &workload));
+  CHECK_GT(FLAGS_ycsb_threads, 0);
+  CHECK_GT(FLAGS_ycsb_max_scan_length, 0);
+
+  gscoped_ptr<kudu::MiniCluster> cluster;
+  string master_address;
+  if (FLAGS_use_mini_cluster) {
+    kudu::Env* env = kudu::Env::Default();
+    kudu::Status s = env->CreateDir(FLAGS_mini_cluster_base_dir);
+    CHECK(s.IsAlreadyPresent() || s.ok()) << s.ToString();
+    kudu::MiniClusterOptions options;
+    options.data_root = FLAGS_mini_cluster_base_dir;
+    cluster.reset(new kudu::MiniCluster(env, options));
+    CHECK_OK(cluster->StartSync());
+    master_address = cluster->mini_master()->bound_rpc_addr_str();
+  } else {
+    master_address = FLAGS_master_address;
+  }
+
+  kudu::YcsbRunner runner(master_address, workload);
+  CHECK_OK(runner.Init());
+  if (FLAGS_ycsb_load) {
+    CHECK_OK(runner.Load());
+  }
+  CHECK_OK(runner.Run());
+  runner.PrintReport();
+
+  if (cluster) {
+    cluster->Shutdown();
+  }
+  return 0;
+}
@@ -17,6 +17,7 @@
 
 #include "kudu/cfile/binary_dict_block.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <algorithm>
 
@@ -29,10 +30,21 @@
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/coding-inl.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/group_varint-inl.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/memory/arena.h"
 
+DEFINE_int32(cfile_dict_max_pages, 1,
+             "Maximum number of dictionary pages in a dictionary-encoded cfile. "
+             "When the dictionary of a cfile fills up, a new dictionary page is "
+             "started, until this many pages have been written, after which "
+             "the remaining data blocks of the cfile are written with plain "
+             "encoding. Files with more than one page cannot be read by "
+             "older versions.");
+TAG_FLAG(cfile_dict_max_pages, experimental);
+TAG_FLAG(cfile_dict_max_pages, runtime);
+
 namespace kudu {
 namespace cfile {
 
@@ -40,31 +52,57 @@ BinaryDictBlockBuilder::BinaryDictBlockBuilder(const WriterOptions* options)
   : options_(options),
     dict_block_(options_),
     dictionary_strings_arena_(1024, 32*1024*1024),
-    mode_(kCodeWordMode) {
+    mode_(kCodeWordMode),
+    dict_page_idx_(0),
+    max_dict_pages_(std::max(1, FLAGS_cfile_dict_max_pages)) {
   data_builder_.reset(new BShufBlockBuilder<UINT32>(options_));
   Reset();
 }
 
 void BinaryDictBlockBuilder::Reset() {
-  buffer_.clear();
-  buffer_.resize(kMaxHeaderSize);
-  buffer_.reserve(options_->storage_attributes.cfile_block_size);
-
-  if (mode_ == kCodeWordMode &&
+  if (mode_ != kPlainBinaryMode &&
       dict_block_.IsBlockFull()) {
-    mode_ = kPlainBinaryMode;
-    data_builder_.reset(new BinaryPlainBlockBuilder(options_));
+    if (dict_page_idx_ + 1 < max_dict_pages_) {
+      StartNewDictPage();
+      mode_ = kPagedCodeWordMode;
+      data_builder_->Reset();
+    } else {
+      mode_ = kPlainBinaryMode;
+      data_builder_.reset(new BinaryPlainBlockBuilder(options_));
+    }
   } else {
     data_builder_->Reset();
   }
 
+  buffer_.clear();
+  buffer_.resize(HeaderSize());
+  buffer_.reserve(options_->storage_attributes.cfile_block_size);
+
   finished_ = false;
 }
 
+void BinaryDictBlockBuilder::StartNewDictPage() {
+  Slice page = dict_block_.Finish(0);
+  finished_dict_pages_.emplace_back(page.ToString());
+
+  // The keys of the dictionary point into the arena, so must go first.
+  dictionary_.clear();
+  dictionary_strings_arena_.Reset();
+  dict_block_.Reset();
+  dict_page_idx_++;
+}
+
+size_t BinaryDictBlockBuilder::HeaderSize() const {
+  return mode_ == kPagedCodeWordMode ? sizeof(uint32_t) * 2 : sizeof(uint32_t);
+}
+
 Slice BinaryDictBlockBuilder::Finish(rowid_t ordinal_pos) {
   finished_ = true;
 
   InlineEncodeFixed32(&buffer_[0], mode_);
+  if (mode_ == kPagedCodeWordMode) {
+    InlineEncodeFixed32(&buffer_[sizeof(uint32_t)], dict_page_idx_);
+  }
 
   // TODO: if we could modify the the Finish() API a little bit, we can
   // avoid an extra memory copy (buffer_.append(..))
@@ -78,11 +116,12 @@ Slice BinaryDictBlockBuilder::Finish(rowid_t ordinal_pos) {
 // exceeds limit or when the size of dictionary block exceeds the
 // CFile block size.
 //
-// If it is the latter case, all the subsequent data blocks will switch to
-// StringPlainBlock automatically.
+// If it is the latter case, all the subsequent data blocks will either be
+// coded against a new dictionary page or switch to StringPlainBlock
+// automatically.
 bool BinaryDictBlockBuilder::IsBlockFull() const {
   if (data_builder_->IsBlockFull()) return true;
-  if (dict_block_.IsBlockFull() && (mode_ == kCodeWordMode)) return true;
+  if (dict_block_.IsBlockFull() && (mode_ != kPlainBinaryMode)) return true;
   return false;
 }
 
@@ -128,7 +167,7 @@ int BinaryDictBlockBuilder::AddCodeWords(const uint8_t* vals, size_t count) {
 }
 
 int BinaryDictBlockBuilder::Add(const uint8_t* vals, size_t count) {
-  if (mode_ == kCodeWordMode) {
+  if (mode_ != kPlainBinaryMode) {
     return AddCodeWords(vals, count);
   } else {
     DCHECK_EQ(mode_, kPlainBinaryMode);
@@ -137,18 +176,28 @@ int BinaryDictBlockBuilder::Add(const uint8_t* vals, size_t count) {
 }
 
 Status BinaryDictBlockBuilder::AppendExtraInfo(CFileWriter* c_writer, CFileFooterPB* footer) {
-  Slice dict_slice = dict_block_.Finish(0);
+  std::vector<Slice> pages(finished_dict_pages_.begin(), finished_dict_pages_.end());
+  // A page started by the last Reset() is empty and no block refers to it.
+  if (pages.empty() || dict_block_.Count() > 0) {
+    pages.push_back(dict_block_.Finish(0));
+  }
 
-  std::vector<Slice> dict_v;
-  dict_v.push_back(dict_slice);
+  for (int i = 0; i < pages.size(); i++) {
+    std::vector<Slice> dict_v;
+    dict_v.push_back(pages[i]);
 
-  BlockPointer ptr;
-  Status s = c_writer->AppendDictBlock(dict_v, &ptr, "Append dictionary block");
-  if (!s.ok()) {
-    LOG(WARNING) << "Unable to append block to file: " << s.ToString();
-    return s;
+    BlockPointer ptr;
+    Status s = c_writer->AppendDictBlock(dict_v, &ptr, "Append dictionary block");
+    if (!s.ok()) {
+      LOG(WARNING) << "Unable to append block to file: " << s.ToString();
+      return s;
+    }
+    ptr.CopyToPB(i == 0 ? footer->mutable_dict_block_ptr() : footer->add_extra_dict_block_ptrs());
+  }
+  if (pages.size() > 1) {
+    footer->set_incompatible_features(footer->incompatible_features() |
+                                      MULTIPLE_DICT_PAGES);
   }
-  ptr.CopyToPB(footer->mutable_dict_block_ptr());
   return Status::OK();
 }
 
@@ -157,7 +206,7 @@ size_t BinaryDictBlockBuilder::Count() const {
 }
 
 Status BinaryDictBlockBuilder::GetFirstKey(void* key_void) const {
-  if (mode_ == kCodeWordMode) {
+  if (mode_ != kPlainBinaryMode) {
     CHECK(finished_);
     Slice* slice = reinterpret_cast<Slice*>(key_void);
     *slice = Slice(first_key_);
@@ -169,7 +218,7 @@ Status BinaryDictBlockBuilder::GetFirstKey(void* key_void) const {
 }
 
 Status BinaryDictBlockBuilder::GetLastKey(void* key_void) const {
-  if (mode_ == kCodeWordMode) {
+  if (mode_ != kPlainBinaryMode) {
     CHECK(finished_);
     uint32_t last_codeword;
     RETURN_NOT_OK(data_builder_->GetLastKey(reinterpret_cast<void*>(&last_codeword)));
@@ -187,7 +236,8 @@ Status BinaryDictBlockBuilder::GetLastKey(void* key_void) const {
 BinaryDictBlockDecoder::BinaryDictBlockDecoder(Slice slice, CFileIterator* iter)
     : data_(std::move(slice)),
       parsed_(false),
-      dict_decoder_(iter->GetDictDecoder()),
+      dict_decoder_(nullptr),
+      dict_page_idx_(0),
       parent_cfile_iter_(iter) {
 }
 
@@ -207,7 +257,17 @@ Status BinaryDictBlockDecoder::ParseHeader() {
   }
   Slice content(data_.data() + 4, data_.size() - 4);
 
-  if (mode_ == kCodeWordMode) {
+  if (mode_ == kPagedCodeWordMode) {
+    if (PREDICT_FALSE(content.size() < sizeof(uint32_t))) {
+      return Status::Corruption("not enough bytes for dictionary page index");
+    }
+    dict_page_idx_ = DecodeFixed32(content.data());
+    content.remove_prefix(sizeof(uint32_t));
+  }
+
+  if (is_codeword_mode()) {
+    RETURN_NOT_OK_PREPEND(parent_cfile_iter_->GetDictDecoder(dict_page_idx_, &dict_decoder_),
+                          "Couldn't load dictionary page");
     data_decoder_.reset(new BShufBlockDecoder<UINT32>(content));
   } else {
     if (mode_ != kPlainBinaryMode) {
@@ -226,7 +286,7 @@ void BinaryDictBlockDecoder::SeekToPositionInBlock(uint pos) {
 }
 
 Status BinaryDictBlockDecoder::SeekAtOrAfterValue(const void* value_void, bool* exact) {
-  if (mode_ == kCodeWordMode) {
+  if (is_codeword_mode()) {
     DCHECK(value_void != nullptr);
     Status s = dict_decoder_->SeekAtOrAfterValue(value_void, exact);
     if (!s.ok()) {
@@ -247,10 +307,6 @@ Status BinaryDictBlockDecoder::SeekAtOrAfterValue(const void* value_void, bool*
   }
 }
 
-// TODO: implement CopyNextAndEval for more blocks. Eg. other blocks can
-// store their min/max values. CopyNextAndEval in these blocks could
-// short-circuit if the query can does not search for values within the
-// min/max range, or copy all and evaluate otherwise.
 Status BinaryDictBlockDecoder::CopyNextAndEval(size_t* n,
                                                ColumnMaterializationContext* ctx,
                                                SelectionVectorView* sel,
@@ -262,7 +318,8 @@ Status BinaryDictBlockDecoder::CopyNextAndEval(size_t* n,
   }
 
   // Predicates that have no matching words should return no data.
-  SelectionVector* codewords_matching_pred = parent_cfile_iter_->GetCodeWordsMatchingPredicate();
+  SelectionVector* codewords_matching_pred =
+      parent_cfile_iter_->GetCodeWordsMatchingPredicate(dict_page_idx_, *ctx->pred());
   CHECK(codewords_matching_pred != nullptr);
   if (!codewords_matching_pred->AnySelected()) {
     // If nothing is selected, move the data_decoder_ pointer forward and clear
@@ -303,7 +360,8 @@ Status BinaryDictBlockDecoder::CopyNextAndEval(size_t* n,
   return Status::OK();
 }
 
-Status BinaryDictBlockDecoder::CopyNextDecodeStrings(size_t* n, ColumnDataView* dst) {
+Status BinaryDictBlockDecoder::CopyNextDecodeStrings(size_t* n, ColumnDataView* dst,
+                                                     bool copy) {
   DCHECK(parsed_);
   CHECK_EQ(dst->type_info()->physical_type(), BINARY);
   DCHECK_LE(*n, dst->nrows());
@@ -322,14 +380,18 @@ Status BinaryDictBlockDecoder::CopyNextDecodeStrings(size_t* n, ColumnDataView*
   for (int i = 0; i < *n; i++) {
     uint32_t codeword = *reinterpret_cast<uint32_t*>(&codeword_buf_[i*sizeof(uint32_t)]);
     Slice elem = dict_decoder_->string_at_index(codeword);
-    CHECK(out_arena->RelocateSlice(elem, out));
+    if (copy) {
+      CHECK(out_arena->RelocateSlice(elem, out));
+    } else {
+      *out = elem;
+    }
     out++;
   }
   return Status::OK();
 }
 
 Status BinaryDictBlockDecoder::CopyNextValues(size_t* n, ColumnDataView* dst) {
-  if (mode_ == kCodeWordMode) {
+  if (is_codeword_mode()) {
     return CopyNextDecodeStrings(n, dst);
   } else {
     DCHECK_EQ(mode_, kPlainBinaryMode);
@@ -337,5 +399,14 @@ Status BinaryDictBlockDecoder::CopyNextValues(size_t* n, ColumnDataView* dst) {
   }
 }
 
+Status BinaryDictBlockDecoder::ReferenceNextValues(size_t* n, ColumnDataView* dst) {
+  if (is_codeword_mode()) {
+    return CopyNextDecodeStrings(n, dst, false);
+  } else {
+    DCHECK_EQ(mode_, kPlainBinaryMode);
+    return data_decoder_->ReferenceNextValues(n, dst);
+  }
+}
+
 } // namespace cfile
 } // namespace kudu
@@ -15,15 +15,23 @@
 // specific language governing permissions and limitations
 // under the License.
 //
-// Dictionary encoding for strings. There is only one dictionary block
-// for all the data blocks within a cfile.
+// Dictionary encoding for strings. By default there is only one dictionary
+// block for all the data blocks within a cfile.
 // layout for dictionary encoded block:
 // Either header + embedded codeword block, which can be encoded with any
 //        int blockbuilder, when mode_ = kCodeWordMode.
+// Or     header + page index + embedded codeword block, when
+//        mode_ = kPagedCodeWordMode.
 // Or     header + embedded StringPlainBlock, when mode_ = kPlainStringMode.
 // Data blocks start with mode_ = kCodeWordMode, when the the size of dictionary
 // block go beyond the option_->block_size, the subsequent data blocks will switch
 // to string plain block automatically.
+//
+// With --cfile_dict_max_pages greater than one, a full dictionary is instead
+// closed as a "page" and a new, empty dictionary is started, so that columns
+// whose vocabulary drifts over the file stay dictionary-coded. The data
+// blocks coded against any page but the first record the index of their page
+// in their header, and the pages are appended to the end of the cfile.
 
 // You can embed any int block builder encoding formats, such as group-varint,
 // bitshuffle. Currently, we use bitshuffle builder for codewords.
@@ -61,7 +69,8 @@ enum DictEncodingMode {
   DictEncodingMode_min = 1,
   kCodeWordMode = 1,
   kPlainBinaryMode = 2,
-  DictEncodingMode_max = 2
+  kPagedCodeWordMode = 3,
+  DictEncodingMode_max = 3
 };
 
 class BinaryDictBlockBuilder final : public BlockBuilder {
@@ -70,8 +79,8 @@ class BinaryDictBlockBuilder final : public BlockBuilder {
 
   bool IsBlockFull() const override;
 
-  // Append the dictionary block for the current cfile to the end of the cfile and set the footer
-  // accordingly.
+  // Append the dictionary block(s) for the current cfile to the end of the cfile and set the
+  // footer accordingly.
   Status AppendExtraInfo(CFileWriter* c_writer, CFileFooterPB* footer) OVERRIDE;
 
   int Add(const uint8_t* vals, size_t count) OVERRIDE;
@@ -86,11 +95,18 @@ class BinaryDictBlockBuilder final : public BlockBuilder {
 
   Status GetLastKey(void* key) const OVERRIDE;
 
-  static const size_t kMaxHeaderSize = sizeof(uint32_t) * 1;
+  static const size_t kMaxHeaderSize = sizeof(uint32_t) * 2;
 
  private:
   int AddCodeWords(const uint8_t* vals, size_t count);
 
+  // Closes the current dictionary page, keeping its encoded contents until
+  // the cfile is finished, and starts a new, empty one.
+  void StartNewDictPage();
+
+  // The size of the header of data blocks in the current mode.
+  size_t HeaderSize() const;
+
   faststring buffer_;
   bool finished_;
   const WriterOptions* options_;
@@ -98,10 +114,14 @@ class BinaryDictBlockBuilder final : public BlockBuilder {
   gscoped_ptr<BlockBuilder> data_builder_;
 
   // dict_block_, dictionary_, dictionary_strings_arena_
-  // is related to the dictionary block (one per cfile).
+  // is related to the current dictionary page (one per cfile unless
+  // --cfile_dict_max_pages is greater than one).
   // They should NOT be cleared in the Reset() method.
   BinaryPlainBlockBuilder dict_block_;
 
+  // The encoded dictionary pages which have been closed, in order.
+  std::vector<faststring> finished_dict_pages_;
+
   std::unordered_map<StringPiece, uint32_t, GoodFastHash<StringPiece> > dictionary_;
   // Memory to hold the actual content for strings in the dictionary_.
   //
@@ -113,7 +133,14 @@ class BinaryDictBlockBuilder final : public BlockBuilder {
 
   DictEncodingMode mode_;
 
-  // First key when mode_ = kCodeWordMode
+  // The index of the current dictionary page.
+  uint32_t dict_page_idx_;
+
+  // The maximum number of dictionary pages, read from the flag when the
+  // builder is created so that it is constant over the file.
+  const uint32_t max_dict_pages_;
+
+  // First key when mode_ = kCodeWordMode or kPagedCodeWordMode
   faststring first_key_;
 };
 
@@ -127,6 +154,7 @@ class BinaryDictBlockDecoder final : public BlockDecoder {
   virtual void SeekToPositionInBlock(uint pos) OVERRIDE;
   virtual Status SeekAtOrAfterValue(const void* value, bool* exact_match) OVERRIDE;
   Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE;
+  Status ReferenceNextValues(size_t* n, ColumnDataView* dst) OVERRIDE;
   Status CopyNextAndEval(size_t* n,
                          ColumnMaterializationContext* ctx,
                          SelectionVectorView* sel,
@@ -151,18 +179,28 @@ class BinaryDictBlockDecoder final : public BlockDecoder {
   static const size_t kMinHeaderSize = sizeof(uint32_t) * 1;
 
  private:
-  Status CopyNextDecodeStrings(size_t* n, ColumnDataView* dst);
+  bool is_codeword_mode() const {
+    return mode_ == kCodeWordMode || mode_ == kPagedCodeWordMode;
+  }
+
+  // Decode the next codewords into their strings. If 'copy' is false, the
+  // strings are left pointing into the dictionary block.
+  Status CopyNextDecodeStrings(size_t* n, ColumnDataView* dst, bool copy = true);
 
   Slice data_;
   bool parsed_;
 
-  // Dictionary block decoder
+  // Decoder of the dictionary page the codewords of this block refer to.
   BinaryPlainBlockDecoder* dict_decoder_;
 
+  // The index of that page.
+  uint32_t dict_page_idx_;
+
   gscoped_ptr<BlockDecoder> data_decoder_;
 
-  // Parent CFileIterator, each dictionary decoder in the same CFile will share
-  // the same vocabulary, and thus, the same set of matching codewords.
+  // Parent CFileIterator, each dictionary decoder of the same page in the same
+  // CFile will share the same vocabulary, and thus, the same set of matching
+  // codewords.
   CFileIterator* parent_cfile_iter_;
 
   DictEncodingMode mode_;
@@ -300,6 +300,13 @@ Status BinaryPlainBlockDecoder::CopyNextValues(size_t* n, ColumnDataView* dst) {
     CHECK(out_arena->RelocateSlice(elem, out));
   });
 }
+
+Status BinaryPlainBlockDecoder::ReferenceNextValues(size_t* n, ColumnDataView* dst) {
+  return HandleBatch(n, dst, [&](size_t i, Slice elem, Slice* out, Arena* out_arena) {
+    *out = elem;
+  });
+}
+
 Status BinaryPlainBlockDecoder::CopyNextAndEval(size_t* n,
                                                 ColumnMaterializationContext* ctx,
                                                 SelectionVectorView* sel,
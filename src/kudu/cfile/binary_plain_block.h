@@ -97,6 +97,7 @@ class BinaryPlainBlockDecoder final : public BlockDecoder {
   virtual Status SeekAtOrAfterValue(const void *value,
                                     bool *exact_match) OVERRIDE;
   Status CopyNextValues(size_t *n, ColumnDataView *dst) OVERRIDE;
+  Status ReferenceNextValues(size_t *n, ColumnDataView *dst) OVERRIDE;
   Status CopyNextAndEval(size_t* n,
                          ColumnMaterializationContext* ctx,
                          SelectionVectorView* sel,
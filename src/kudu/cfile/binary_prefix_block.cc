@@ -20,17 +20,28 @@
 #include <algorithm>
 #include <string>
 
+#include <gflags/gflags.h>
+
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/coding-inl.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/group_varint-inl.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/slice.h"
 
+DEFINE_bool(cfile_prefix_block_restart_heads, false,
+            "Whether to write an array of fixed-width key heads for the restart "
+            "points of prefix-encoded blocks, which lets seeks binary search the "
+            "restart points without decoding them. Blocks written with restart "
+            "heads can't be read by versions of Kudu which predate them.");
+TAG_FLAG(cfile_prefix_block_restart_heads, experimental);
+
 namespace kudu {
 namespace cfile {
 
@@ -54,12 +65,28 @@ static const uint8_t *DecodeEntryLengths(
   return ptr;
 }
 
+// Append the restart head of 'key' (its first 8 bytes, zero-padded) to 'dst'.
+static void AppendRestartHead(const Slice& key, faststring* dst) {
+  uint8_t head[BinaryPrefixBlockBuilder::kRestartHeadSize] = { 0 };
+  memcpy(head, key.data(), std::min(key.size(), sizeof(head)));
+  dst->append(head, sizeof(head));
+}
+
+// Return the restart head of 'key', with the same ordering as the key's
+// first 8 bytes.
+static uint64_t RestartHead(const Slice& key) {
+  uint8_t head[BinaryPrefixBlockBuilder::kRestartHeadSize] = { 0 };
+  memcpy(head, key.data(), std::min(key.size(), sizeof(head)));
+  return BigEndian::Load64(head);
+}
+
 ////////////////////////////////////////////////////////////
 // StringPrefixBlockBuilder encoding
 ////////////////////////////////////////////////////////////
 
 BinaryPrefixBlockBuilder::BinaryPrefixBlockBuilder(const WriterOptions *options)
-  : val_count_(0),
+  : write_restart_heads_(FLAGS_cfile_prefix_block_restart_heads),
+    val_count_(0),
     vals_since_restart_(0),
     finished_(false),
     options_(options) {
@@ -76,6 +103,7 @@ void BinaryPrefixBlockBuilder::Reset() {
   buffer_.reserve(options_->storage_attributes.cfile_block_size);
 
   restarts_.clear();
+  restart_heads_.clear();
   last_val_.clear();
 }
 
@@ -90,8 +118,10 @@ Slice BinaryPrefixBlockBuilder::Finish(rowid_t ordinal_pos) {
 
   faststring header(kHeaderReservedLength);
 
+  const bool has_restart_heads = write_restart_heads_ && val_count_ > 0;
   AppendGroupVarInt32(&header, val_count_, ordinal_pos,
-                      options_->block_restart_interval, 0);
+                      options_->block_restart_interval,
+                      has_restart_heads ? kRestartHeadsFlag : 0);
 
   int header_encoded_len = header.size();
 
@@ -103,6 +133,12 @@ Slice BinaryPrefixBlockBuilder::Finish(rowid_t ordinal_pos) {
   uint8_t *header_dst = buffer_.data() + header_offset;
   strings::memcpy_inlined(header_dst, header.data(), header_encoded_len);
 
+  // The restart heads go between the data and the restart array.
+  if (has_restart_heads) {
+    DCHECK_EQ(restart_heads_.size(), (restarts_.size() + 1) * kRestartHeadSize);
+    buffer_.append(restart_heads_.data(), restart_heads_.size());
+  }
+
   // Serialize the restart points.
   // Note that the values stored in restarts_ are relative to the
   // start of the *buffer*, which is not the same as the start of
@@ -146,6 +182,9 @@ int BinaryPrefixBlockBuilder::Add(const uint8_t *vals, size_t count) {
       restarts_.push_back(old_size);
       vals_since_restart_ = 0;
     }
+    if (write_restart_heads_ && vals_since_restart_ == 0) {
+      AppendRestartHead(val, &restart_heads_);
+    }
     const size_t non_shared = val.size() - shared;
 
     // Add "<shared><non_shared>" to buffer_
@@ -214,14 +253,16 @@ BinaryPrefixBlockDecoder::BinaryPrefixBlockDecoder(Slice slice)
       ordinal_pos_base_(0),
       num_restarts_(0),
       restarts_(nullptr),
+      restart_heads_(nullptr),
       data_start_(nullptr),
+      data_end_(nullptr),
       cur_idx_(0),
       next_ptr_(nullptr) {
 }
 
 Status BinaryPrefixBlockDecoder::ParseHeader() {
   // First parse the actual header.
-  uint32_t unused;
+  uint32_t flags;
 
   // Make sure the Slice we are referring to is at least the size of the
   // minimum possible header
@@ -249,7 +290,7 @@ Status BinaryPrefixBlockDecoder::ParseHeader() {
     coding::DecodeGroupVarInt32_SlowButSafe(
       data_.data(),
       &num_elems_, &ordinal_pos_base_,
-      &restart_interval_, &unused);
+      &restart_interval_, &flags);
 
   // Then the footer, which points us to the restarts array
   num_restarts_ = DecodeFixed32(
@@ -271,6 +312,19 @@ Status BinaryPrefixBlockDecoder::ParseHeader() {
     - sizeof(uint32_t) // rewind before the restart length
     - restarts_size);
 
+  restart_heads_ = nullptr;
+  data_end_ = reinterpret_cast<const uint8_t *>(restarts_);
+  if ((flags & BinaryPrefixBlockBuilder::kRestartHeadsFlag) && num_elems_ > 0) {
+    uint32_t heads_size = (num_restarts_ + 1) * BinaryPrefixBlockBuilder::kRestartHeadSize;
+    if (heads_size > data_end_ - data_start_) {
+      return Status::Corruption(
+        StringPrintf("restart heads for %d restarts too big to fit in block size %d",
+                     num_restarts_, static_cast<int>(data_.size())));
+    }
+    restart_heads_ = data_end_ - heads_size;
+    data_end_ = restart_heads_;
+  }
+
   SeekToStart();
   parsed_ = true;
   return Status::OK();
@@ -330,6 +384,7 @@ Status BinaryPrefixBlockDecoder::SeekAtOrAfterValue(const void *value_void,
   DCHECK(value_void != nullptr);
 
   const Slice &target = *reinterpret_cast<const Slice *>(value_void);
+  const uint64_t target_head = RestartHead(target);
 
   // Binary search in restart array to find the first restart point
   // with a key >= target
@@ -337,6 +392,19 @@ Status BinaryPrefixBlockDecoder::SeekAtOrAfterValue(const void *value_void,
   int32_t right = num_restarts_;
   while (left < right) {
     uint32_t mid = (left + right + 1) / 2;
+    if (restart_heads_ != nullptr) {
+      // If the heads differ, they order the keys without decoding the entry.
+      uint64_t mid_head = BigEndian::Load64(
+          restart_heads_ + mid * BinaryPrefixBlockBuilder::kRestartHeadSize);
+      if (mid_head < target_head) {
+        left = mid;
+        continue;
+      }
+      if (mid_head > target_head) {
+        right = mid - 1;
+        continue;
+      }
+    }
     const uint8_t *entry = GetRestartPoint(mid);
     uint32_t shared, non_shared;
     const uint8_t *key_ptr = DecodeEntryLengths(entry, &shared, &non_shared);
@@ -358,8 +426,14 @@ Status BinaryPrefixBlockDecoder::SeekAtOrAfterValue(const void *value_void,
     }
   }
 
-  // Linear search (within restart block) for first key >= target
+  // Linear search (within restart block) for first key >= target.
+  //
+  // 'matched' tracks the length of the common prefix of cur_val_ and the
+  // target. Each following entry shares 'shared' bytes with cur_val_, so
+  // only its non-shared suffix needs to be compared, and only if 'shared'
+  // doesn't already reach past where cur_val_ diverges from the target.
   SeekToRestartPoint(left);
+  size_t matched = CommonPrefixLength(Slice(cur_val_), target);
 
   while (true) {
 #ifndef NDEBUG
@@ -368,11 +442,33 @@ Status BinaryPrefixBlockDecoder::SeekAtOrAfterValue(const void *value_void,
             << "target  =" << KUDU_REDACT(target.ToDebugString()) << "\n"
             << "cur_val_=" << KUDU_REDACT(Slice(cur_val_).ToDebugString());
 #endif
-    int cmp = Slice(cur_val_).compare(target);
+    DCHECK_EQ(matched, CommonPrefixLength(Slice(cur_val_), target));
+    int cmp;
+    if (matched == cur_val_.size()) {
+      cmp = (matched == target.size()) ? 0 : -1;
+    } else if (matched == target.size()) {
+      cmp = 1;
+    } else {
+      cmp = (cur_val_[matched] < target[matched]) ? -1 : 1;
+    }
     if (cmp >= 0) {
       *exact_match = (cmp == 0);
       return Status::OK();
     }
+
+    RETURN_NOT_OK(CheckNextPtr());
+    uint32_t shared, non_shared;
+    const uint8_t *val_delta = DecodeEntryLengths(next_ptr_, &shared, &non_shared);
+    if (val_delta == nullptr) {
+      return Status::Corruption(
+        StringPrintf("Could not decode value length data at idx %d",
+                     cur_idx_ + 1));
+    }
+    if (shared <= matched) {
+      matched = shared + CommonPrefixLength(
+          Slice(val_delta, non_shared),
+          Slice(target.data() + shared, target.size() - shared));
+    }
     RETURN_NOT_OK(ParseNextValue());
     cur_idx_++;
   }
@@ -448,8 +544,7 @@ const uint8_t *BinaryPrefixBlockDecoder::DecodeEntryLengths(
   const uint8_t *ptr, uint32_t *shared, uint32_t *non_shared) const {
 
   // data ends where the restart info begins
-  const uint8_t *limit = reinterpret_cast<const uint8_t *>(restarts_);
-  return kudu::cfile::DecodeEntryLengths(ptr, limit, shared, non_shared);
+  return kudu::cfile::DecodeEntryLengths(ptr, data_end_, shared, non_shared);
 }
 
 Status BinaryPrefixBlockDecoder::SkipForward(int n) {
@@ -476,7 +571,7 @@ Status BinaryPrefixBlockDecoder::SkipForward(int n) {
 Status BinaryPrefixBlockDecoder::CheckNextPtr() {
   DCHECK(next_ptr_ != nullptr);
 
-  if (PREDICT_FALSE(next_ptr_ == reinterpret_cast<const uint8_t *>(restarts_))) {
+  if (PREDICT_FALSE(next_ptr_ == data_end_)) {
     DCHECK_EQ(cur_idx_, num_elems_ - 1);
     return Status::NotFound("Trying to parse past end of array");
   }
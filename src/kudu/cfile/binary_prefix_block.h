@@ -33,6 +33,13 @@ struct WriterOptions;
 
 // Encoding for data blocks of binary data that have common prefixes.
 // This encodes in a manner similar to LevelDB (prefix coding)
+//
+// If the kRestartHeadsFlag bit is set in the header's flags, the restart
+// array is preceded by one fixed-width 8-byte "head" per restart point
+// (including the implicit one at the start of the data): the first 8 bytes
+// of that restart's key, zero-padded. Comparing heads as big-endian integers
+// orders the restart keys correctly whenever their heads differ, so seeks
+// can usually binary search the restarts without decoding any entries.
 class BinaryPrefixBlockBuilder final : public BlockBuilder {
  public:
   explicit BinaryPrefixBlockBuilder(const WriterOptions *options);
@@ -60,6 +67,12 @@ class BinaryPrefixBlockBuilder final : public BlockBuilder {
   // key should be a Slice *
   Status GetLastKey(void *key) const OVERRIDE;
 
+  // Header flag indicating that the block contains restart heads.
+  static const uint32_t kRestartHeadsFlag = 1;
+
+  // Size of each restart head, in bytes.
+  static const size_t kRestartHeadSize = sizeof(uint64_t);
+
  private:
   faststring buffer_;
   faststring last_val_;
@@ -67,6 +80,10 @@ class BinaryPrefixBlockBuilder final : public BlockBuilder {
   // Restart points, offsets relative to start of block
   std::vector<uint32_t> restarts_;
 
+  // The heads of the restart points' keys, if 'write_restart_heads_' is set.
+  faststring restart_heads_;
+  const bool write_restart_heads_;
+
   int val_count_;
   int vals_since_restart_;
   bool finished_;
@@ -142,8 +159,16 @@ class BinaryPrefixBlockDecoder final : public BlockDecoder {
   const uint32_t *restarts_;
   uint32_t restart_interval_;
 
+  // The restart heads (num_restarts_ + 1 of them), or NULL if the block
+  // doesn't have any.
+  const uint8_t *restart_heads_;
+
   const uint8_t *data_start_;
 
+  // The end of the entries, which is where the restart heads or the restart
+  // array begins.
+  const uint8_t *data_end_;
+
   // Index of the next row to be returned by CopyNextValues, relative to
   // the block's base offset.
   // When the block is exhausted, cur_idx_ == num_elems_
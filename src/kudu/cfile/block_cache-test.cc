@@ -15,11 +15,26 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
+#include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <string>
 
 #include "kudu/cfile/block_cache.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_bool(cache_force_single_shard);
+DECLARE_string(block_cache_type);
+
+METRIC_DECLARE_entity(server);
+METRIC_DECLARE_counter(block_cache_compressed_hits);
+METRIC_DECLARE_counter(block_cache_compressed_misses);
+METRIC_DECLARE_counter(block_cache_compressed_inserts);
+METRIC_DECLARE_counter(block_cache_compressed_evictions);
 
 namespace kudu {
 namespace cfile {
@@ -60,6 +75,106 @@ TEST(TestBlockCache, TestBasics) {
   ASSERT_FALSE(cache.Lookup(key1, Cache::EXPECT_IN_CACHE, &retrieved_handle));
 }
 
+TEST(TestBlockCache, TestCompressedTier) {
+  const size_t kCompressedCapacity = 1024;
+  size_t data_size = strlen(DATA_TO_CACHE) + 1;
+  BlockCache cache(512 * 1024 * 1024, kCompressedCapacity);
+  ASSERT_TRUE(cache.has_compressed_tier());
+
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity(METRIC_ENTITY_server.Instantiate(&registry, "test"));
+  cache.StartInstrumentation(entity);
+
+  BlockCache::FileId id(1234);
+  BlockCache::CacheKey key(id, 1);
+  {
+    BlockCacheHandle handle;
+    ASSERT_FALSE(cache.LookupCompressed(key, &handle));
+    ASSERT_FALSE(handle.valid());
+  }
+  cache.InsertCompressed(key, Slice(DATA_TO_CACHE, data_size));
+
+  // The two tiers are independent.
+  {
+    BlockCacheHandle handle;
+    ASSERT_FALSE(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle));
+    ASSERT_TRUE(cache.LookupCompressed(key, &handle));
+    ASSERT_EQ(0, memcmp(handle.data().data(), DATA_TO_CACHE, data_size));
+  }
+  ASSERT_EQ(1, METRIC_block_cache_compressed_hits.Instantiate(entity)->value());
+  ASSERT_EQ(1, METRIC_block_cache_compressed_misses.Instantiate(entity)->value());
+  ASSERT_EQ(1, METRIC_block_cache_compressed_inserts.Instantiate(entity)->value());
+
+  // Filling the tier evicts the oldest entries.
+  for (int i = 2; i < 2 + kCompressedCapacity / data_size * 20; i++) {
+    cache.InsertCompressed(BlockCache::CacheKey(id, i), Slice(DATA_TO_CACHE, data_size));
+  }
+  BlockCacheHandle handle;
+  ASSERT_FALSE(cache.LookupCompressed(key, &handle));
+  ASSERT_LT(0, METRIC_block_cache_compressed_evictions.Instantiate(entity)->value());
+
+  // The compressed tier is disabled by default.
+  BlockCache no_tier(512 * 1024 * 1024);
+  ASSERT_FALSE(no_tier.has_compressed_tier());
+}
+
+// Replays a trace in which a small hot set of blocks is read repeatedly while
+// large scans stream through many blocks which are each read only once, and
+// returns the fraction of hot-set lookups which hit the cache.
+static double ReplayMixedTrace(const std::string& cache_type) {
+  FLAGS_block_cache_type = cache_type;
+  const int kBlockSize = 1024;
+  const int kNumHotBlocks = 600;
+  const int kNumScanBlocksPerRound = 2000;
+  const int kNumRounds = AllowSlowTests() ? 200 : 20;
+  BlockCache cache(1024 * 1024);
+  BlockCache::FileId hot_file(1);
+  BlockCache::FileId scan_file(2);
+
+  auto read_block = [&](const BlockCache::CacheKey& key, Cache::CacheBehavior behavior) {
+    BlockCacheHandle handle;
+    if (cache.Lookup(key, behavior, &handle)) {
+      return true;
+    }
+    if (behavior == Cache::EXPECT_IN_CACHE) {
+      BlockCache::PendingEntry entry = cache.Allocate(key, kBlockSize);
+      memset(entry.val_ptr(), 0, kBlockSize);
+      cache.Insert(&entry, &handle);
+    }
+    return false;
+  };
+
+  int64_t hot_lookups = 0;
+  int64_t hot_hits = 0;
+  int64_t next_scan_block = 0;
+  Stopwatch sw;
+  sw.start();
+  for (int round = 0; round < kNumRounds; round++) {
+    for (int pass = 0; pass < 2; pass++) {
+      for (int i = 0; i < kNumHotBlocks; i++) {
+        hot_lookups++;
+        hot_hits += read_block(BlockCache::CacheKey(hot_file, i), Cache::EXPECT_IN_CACHE);
+      }
+    }
+    // Scanned blocks are inserted on miss, as by a scan with fill_cache set.
+    for (int i = 0; i < kNumScanBlocksPerRound; i++) {
+      read_block(BlockCache::CacheKey(scan_file, next_scan_block++), Cache::EXPECT_IN_CACHE);
+    }
+  }
+  sw.stop();
+  double hit_ratio = static_cast<double>(hot_hits) / hot_lookups;
+  LOG(INFO) << cache_type << " cache: hot set hit ratio " << hit_ratio
+            << " over " << kNumRounds << " rounds in " << sw.elapsed().ToString();
+  return hit_ratio;
+}
+
+TEST(TestBlockCache, TestScanResistance) {
+  FLAGS_cache_force_single_shard = true;
+  double lru_ratio = ReplayMixedTrace("DRAM");
+  double slru_ratio = ReplayMixedTrace("SLRU");
+  ASSERT_GT(slru_ratio, lru_ratio);
+  ASSERT_GT(slru_ratio, 0.9);
+}
 
 } // namespace cfile
 } // namespace kudu
@@ -16,25 +16,58 @@
 // under the License.
 
 #include <gflags/gflags.h>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/port.h"
 #include "kudu/util/cache.h"
+#include "kudu/util/cache_metrics.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/string_case.h"
+#include "kudu/util/tiered_cache.h"
 
 DEFINE_int64(block_cache_capacity_mb, 512, "block cache capacity in MB");
 TAG_FLAG(block_cache_capacity_mb, stable);
 
 DEFINE_string(block_cache_type, "DRAM",
               "Which type of block cache to use for caching data. "
-              "Valid choices are 'DRAM' or 'NVM'. DRAM, the default, "
-              "caches data in regular memory. 'NVM' caches data "
-              "in a memory-mapped file using the NVML library.");
+              "Valid choices are 'DRAM', 'SLRU', 'CLOCK', 'NVM' or 'TIERED'. DRAM, the "
+              "default, caches data in regular memory. 'SLRU' also caches data in "
+              "regular memory, but uses a scan-resistant segmented LRU eviction "
+              "policy so that blocks read once by large scans don't evict "
+              "frequently used blocks. 'CLOCK' caches data in regular memory using "
+              "the CLOCK eviction policy, whose cache hits don't contend on a lock. "
+              "'NVM' caches data in a memory-mapped file using the NVML library. "
+              "'TIERED' caches hot data in regular memory and demotes blocks evicted "
+              "from it into an NVM tier of --block_cache_nvm_tier_capacity_mb.");
 TAG_FLAG(block_cache_type, experimental);
 
+DEFINE_int64(block_cache_nvm_tier_capacity_mb, 16 * 1024,
+             "Capacity in MB of the NVM tier of the block cache when "
+             "--block_cache_type is 'TIERED'. --block_cache_capacity_mb sets the "
+             "capacity of the DRAM tier.");
+TAG_FLAG(block_cache_nvm_tier_capacity_mb, experimental);
+
+DEFINE_int64(block_cache_compressed_capacity_mb, 0,
+             "Capacity in MB of the compressed tier of the block cache, which holds "
+             "blocks of compressed CFiles as they are stored on disk. Blocks that miss "
+             "in the block cache but hit in this tier are decompressed instead of being "
+             "read from disk. If 0, the compressed tier is disabled.");
+TAG_FLAG(block_cache_compressed_capacity_mb, experimental);
+
+DEFINE_int32(block_cache_tracked_hot_blocks, 0,
+             "Number of the blocks most recently read from the block cache to keep track "
+             "of, so that they can be persisted and read back into the cache after a "
+             "restart. If 0, hot blocks are not tracked.");
+TAG_FLAG(block_cache_tracked_hot_blocks, experimental);
+
 namespace kudu {
 
 class MetricEntity;
@@ -43,6 +76,8 @@ namespace cfile {
 
 namespace {
 
+// Only the block cache proper is NUMA-aware: the hot tier of the tiered cache
+// and the compressed tier insert entries with eviction callbacks.
 Cache* CreateCache(int64_t capacity) {
   CacheType t;
   ToUpperCase(FLAGS_block_cache_type, &FLAGS_block_cache_type);
@@ -50,21 +85,117 @@ Cache* CreateCache(int64_t capacity) {
     t = NVM_CACHE;
   } else if (FLAGS_block_cache_type == "DRAM") {
     t = DRAM_CACHE;
+  } else if (FLAGS_block_cache_type == "SLRU") {
+    return NewSLRUCache(capacity, "block_cache", /* numa_aware= */ true);
+  } else if (FLAGS_block_cache_type == "CLOCK") {
+    return NewClockCache(capacity, "block_cache", /* numa_aware= */ true);
+  } else if (FLAGS_block_cache_type == "TIERED") {
+    return NewTieredCache(
+        NewLRUCache(DRAM_CACHE, capacity, "block_cache"),
+        NewLRUCache(NVM_CACHE, FLAGS_block_cache_nvm_tier_capacity_mb * 1024 * 1024,
+                    "block_cache-nvm"));
   } else {
     LOG(FATAL) << "Unknown block cache type: '" << FLAGS_block_cache_type
-               << "' (expected 'DRAM' or 'NVM')";
+               << "' (expected 'DRAM', 'SLRU', 'CLOCK', 'NVM' or 'TIERED')";
   }
-  return NewLRUCache(t, capacity, "block_cache");
+  return NewLRUCache(t, capacity, "block_cache", /* numa_aware= */ true);
 }
 
 } // anonymous namespace
 
+// Keeps the compressed tier's usage and eviction metrics up to date.
+class BlockCache::CompressedTierEvictionCallback : public Cache::EvictionCallback {
+ public:
+  explicit CompressedTierEvictionCallback(BlockCache* cache)
+      : cache_(cache) {
+  }
+
+  void EvictedEntry(Slice key, Slice value) OVERRIDE {
+    CompressedBlockCacheMetrics* metrics = cache_->compressed_metrics_.get();
+    if (PREDICT_TRUE(metrics)) {
+      metrics->cache_usage->DecrementBy(value.size());
+      metrics->evictions->Increment();
+    }
+  }
+
+ private:
+  BlockCache* cache_;
+};
+
+// Remembers the blocks most recently read from the cache.
+//
+// The blocks are spread across a fixed number of stripes by the hash of
+// their keys, each holding a ring buffer protected by its own lock, so that
+// recording hits doesn't serialize concurrent readers.
+class BlockCache::HotBlockTracker {
+ public:
+  explicit HotBlockTracker(int capacity) {
+    for (Stripe& stripe : stripes_) {
+      stripe.ring.reserve(std::max(capacity / kNumStripes, 1));
+    }
+  }
+
+  void Record(const CacheKey& key, uint32_t size) {
+    uint64_t hash = util_hash::CityHash64(reinterpret_cast<const char*>(&key), sizeof(key));
+    Stripe& stripe = stripes_[hash % kNumStripes];
+    std::lock_guard<simple_spinlock> l(stripe.lock);
+    if (stripe.ring.size() < stripe.ring.capacity()) {
+      stripe.ring.emplace_back(key, size);
+    } else {
+      stripe.ring[stripe.next] = HotBlock(key, size);
+    }
+    stripe.next = (stripe.next + 1) % stripe.ring.capacity();
+  }
+
+  void GetBlocks(std::vector<HotBlock>* blocks) {
+    std::unordered_set<std::string> seen;
+    for (Stripe& stripe : stripes_) {
+      std::lock_guard<simple_spinlock> l(stripe.lock);
+      for (const HotBlock& block : stripe.ring) {
+        if (seen.emplace(reinterpret_cast<const char*>(&block.key), sizeof(block.key)).second) {
+          blocks->push_back(block);
+        }
+      }
+    }
+  }
+
+ private:
+  static const int kNumStripes = 16;
+
+  struct Stripe {
+    Stripe() : next(0) {}
+
+    simple_spinlock lock;
+    std::vector<HotBlock> ring;
+    size_t next;
+  };
+
+  Stripe stripes_[kNumStripes];
+};
+
 BlockCache::BlockCache()
-  : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024) {
+  : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024,
+               FLAGS_block_cache_compressed_capacity_mb * 1024 * 1024) {
 }
 
-BlockCache::BlockCache(size_t capacity)
+BlockCache::BlockCache(size_t capacity, size_t compressed_capacity)
   : cache_(CreateCache(capacity)) {
+  if (compressed_capacity > 0) {
+    // Compressed blocks are short-lived once decompressed, so the tier is
+    // always kept in DRAM.
+    compressed_cache_.reset(NewLRUCache(DRAM_CACHE, compressed_capacity,
+                                        "block_cache_compressed"));
+    compressed_eviction_cb_.reset(new CompressedTierEvictionCallback(this));
+  }
+  if (FLAGS_block_cache_tracked_hot_blocks > 0) {
+    hot_blocks_.reset(new HotBlockTracker(FLAGS_block_cache_tracked_hot_blocks));
+  }
+}
+
+BlockCache::~BlockCache() {
+  // Destroy the compressed tier first, since destroying its entries invokes
+  // the eviction callback.
+  compressed_cache_.reset();
 }
 
 BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_size) {
@@ -89,8 +220,62 @@ void BlockCache::Insert(BlockCache::PendingEntry* entry, BlockCacheHandle* inser
   inserted->SetHandle(cache_.get(), h);
 }
 
+bool BlockCache::LookupCompressed(const CacheKey& key, BlockCacheHandle* handle) {
+  DCHECK(has_compressed_tier());
+  // Only blocks which are expected to be cached consult the compressed tier.
+  Cache::Handle* h = compressed_cache_->Lookup(
+      Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)), Cache::EXPECT_IN_CACHE);
+  CompressedBlockCacheMetrics* metrics = compressed_metrics_.get();
+  if (PREDICT_TRUE(metrics)) {
+    metrics->lookups->Increment();
+    if (h != nullptr) {
+      metrics->cache_hits->Increment();
+    } else {
+      metrics->cache_misses->Increment();
+    }
+  }
+  if (h != nullptr) {
+    handle->SetHandle(compressed_cache_.get(), h);
+  }
+  return h != nullptr;
+}
+
+void BlockCache::InsertCompressed(const CacheKey& key, const Slice& data) {
+  DCHECK(has_compressed_tier());
+  Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
+  PendingEntry entry(compressed_cache_.get(),
+                     compressed_cache_->Allocate(key_slice, data.size(), data.size()));
+  if (!entry.valid()) {
+    return;
+  }
+  memcpy(entry.val_ptr(), data.data(), data.size());
+  Cache::Handle* h = compressed_cache_->Insert(entry.handle_, compressed_eviction_cb_.get());
+  entry.handle_ = nullptr;
+  CompressedBlockCacheMetrics* metrics = compressed_metrics_.get();
+  if (PREDICT_TRUE(metrics)) {
+    metrics->cache_usage->IncrementBy(data.size());
+    metrics->inserts->Increment();
+  }
+  compressed_cache_->Release(h);
+}
+
+void BlockCache::RecordHotBlock(const CacheKey& key, uint32_t size) {
+  if (hot_blocks_) {
+    hot_blocks_->Record(key, size);
+  }
+}
+
+void BlockCache::GetHotBlocks(std::vector<HotBlock>* blocks) const {
+  if (hot_blocks_) {
+    hot_blocks_->GetBlocks(blocks);
+  }
+}
+
 void BlockCache::StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity) {
   cache_->SetMetrics(metric_entity);
+  if (has_compressed_tier()) {
+    compressed_metrics_.reset(new CompressedBlockCacheMetrics(metric_entity));
+  }
 }
 
 } // namespace cfile
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <glog/logging.h>
+#include <vector>
 
 #include "kudu/fs/block_id.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -30,6 +31,7 @@ DECLARE_string(block_cache_type);
 
 namespace kudu {
 
+struct CompressedBlockCacheMetrics;
 class MetricRegistry;
 
 namespace cfile {
@@ -64,6 +66,18 @@ class BlockCache {
     uint64_t offset_;
   } PACKED;
 
+  // A block which was recently read from the cache, along with its size on
+  // disk, so that it can be read back into the cache after a restart.
+  struct HotBlock {
+    HotBlock(const CacheKey& key, uint32_t size)
+        : key(key),
+          size(size) {
+    }
+
+    CacheKey key;
+    uint32_t size;
+  };
+
   // An entry that is in the process of being inserted into the block
   // cache. See the documentation above 'Allocate' below on the block
   // cache insertion path.
@@ -109,7 +123,12 @@ class BlockCache {
     return Singleton<BlockCache>::get();
   }
 
-  explicit BlockCache(size_t capacity);
+  // Create a block cache holding up to 'capacity' bytes of decompressed
+  // blocks and, if 'compressed_capacity' is non-zero, a second tier holding
+  // up to 'compressed_capacity' bytes of blocks as they are stored on disk.
+  explicit BlockCache(size_t capacity, size_t compressed_capacity = 0);
+
+  ~BlockCache();
 
   // Lookup the given block in the cache.
   //
@@ -152,13 +171,66 @@ class BlockCache {
   // entry in the cache.
   void Insert(PendingEntry* entry, BlockCacheHandle* inserted);
 
+  // Compressed tier
+  // --------------------
+  // Compressed blocks which miss in the cache above may be found in a second
+  // tier holding their on-disk representation. Serving a block from this
+  // tier costs a decompression rather than a disk read, and the tier holds
+  // several times as many blocks per byte of memory.
+
+  // Return true if the compressed tier is enabled.
+  bool has_compressed_tier() const {
+    return compressed_cache_ != nullptr;
+  }
+
+  // Lookup the compressed representation of the given block. Behaves like
+  // Lookup() above.
+  //
+  // REQUIRES: has_compressed_tier()
+  bool LookupCompressed(const CacheKey& key, BlockCacheHandle* handle);
+
+  // Copy the compressed representation of the given block into the
+  // compressed tier. Failure to allocate space in the tier is ignored.
+  //
+  // REQUIRES: has_compressed_tier()
+  void InsertCompressed(const CacheKey& key, const Slice& data);
+
+  // Hot block tracking
+  // --------------------
+  // If --block_cache_tracked_hot_blocks is non-zero, the cache remembers
+  // that many of the blocks most recently read from it. They may be
+  // persisted and read back into the cache after a restart, so that the
+  // cache doesn't start out cold (see BlockCacheWarmer).
+
+  // Return true if hot block tracking is enabled.
+  bool tracks_hot_blocks() const {
+    return hot_blocks_ != nullptr;
+  }
+
+  // Record that the block with 'key', which is 'size' bytes on disk, was
+  // read from the cache. Does nothing unless tracks_hot_blocks().
+  void RecordHotBlock(const CacheKey& key, uint32_t size);
+
+  // Append the distinct recently recorded hot blocks to 'blocks', in no
+  // particular order.
+  void GetHotBlocks(std::vector<HotBlock>* blocks) const;
+
  private:
   friend class Singleton<BlockCache>;
   BlockCache();
 
+  class CompressedTierEvictionCallback;
+  class HotBlockTracker;
+
   DISALLOW_COPY_AND_ASSIGN(BlockCache);
 
   gscoped_ptr<Cache> cache_;
+
+  gscoped_ptr<Cache> compressed_cache_;
+  gscoped_ptr<CompressedBlockCacheMetrics> compressed_metrics_;
+  gscoped_ptr<CompressedTierEvictionCallback> compressed_eviction_cb_;
+
+  gscoped_ptr<HotBlockTracker> hot_blocks_;
 };
 
 // Scoped reference to a block from the block cache.
@@ -0,0 +1,214 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/block_cache_warmer.h"
+
+#include <algorithm>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <string>
+#include <vector>
+
+#include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/block_handle.h"
+#include "kudu/cfile/block_pointer.h"
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/pb_util.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(block_cache_hot_blocks_persist_interval_secs, 300,
+             "How often the tablet server persists the blocks most recently read from "
+             "the block cache, so that they can be read back into the cache after a "
+             "restart. Only used if --block_cache_tracked_hot_blocks is non-zero.");
+TAG_FLAG(block_cache_hot_blocks_persist_interval_secs, experimental);
+
+DEFINE_int32(block_cache_warmup_max_mb_per_sec, 32,
+             "Maximum rate, in MB per second, at which the blocks persisted by a previous "
+             "run of the tablet server are read back into the block cache on startup. "
+             "If 0, the reads are not throttled.");
+TAG_FLAG(block_cache_warmup_max_mb_per_sec, experimental);
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+BlockCacheWarmer::BlockCacheWarmer(FsManager* fs_manager)
+    : fs_manager_(fs_manager),
+      shutdown_latch_(1) {
+}
+
+BlockCacheWarmer::~BlockCacheWarmer() {
+  Shutdown();
+}
+
+Status BlockCacheWarmer::Start(std::function<Status()> wait_fn) {
+  return Thread::Create("block-cache", "warmer", &BlockCacheWarmer::Run, this,
+                        std::move(wait_fn), &thread_);
+}
+
+void BlockCacheWarmer::Shutdown() {
+  if (!thread_) {
+    return;
+  }
+  shutdown_latch_.CountDown();
+  CHECK_OK(ThreadJoiner(thread_.get()).Join());
+  thread_.reset();
+  if (BlockCache::GetSingleton()->tracks_hot_blocks()) {
+    WARN_NOT_OK(PersistHotBlocks(), "Unable to persist block cache hot blocks");
+  }
+}
+
+void BlockCacheWarmer::Run(const std::function<Status()>& wait_fn) {
+  if (wait_fn) {
+    WARN_NOT_OK(wait_fn(), "Error while waiting to warm up the block cache");
+  }
+  int num_blocks_read = 0;
+  WARN_NOT_OK(WarmUp(&num_blocks_read), "Unable to warm up the block cache");
+
+  if (!BlockCache::GetSingleton()->tracks_hot_blocks()) {
+    return;
+  }
+  while (!shutdown_latch_.WaitFor(
+      MonoDelta::FromSeconds(FLAGS_block_cache_hot_blocks_persist_interval_secs))) {
+    WARN_NOT_OK(PersistHotBlocks(), "Unable to persist block cache hot blocks");
+  }
+}
+
+Status BlockCacheWarmer::PersistHotBlocks() {
+  vector<BlockCache::HotBlock> blocks;
+  BlockCache::GetSingleton()->GetHotBlocks(&blocks);
+
+  BlockCacheHotBlocksPB pb;
+  for (const BlockCache::HotBlock& block : blocks) {
+    BlockCacheHotBlocksPB::HotBlockPB* block_pb = pb.add_blocks();
+    block_pb->set_block_id(block.key.file_id_);
+    BlockPointer(block.key.offset_, block.size).CopyToPB(block_pb->mutable_pointer());
+  }
+  // The file is only a hint, so there's no need to sync it.
+  RETURN_NOT_OK_PREPEND(pb_util::WritePBContainerToPath(
+      fs_manager_->env(), fs_manager_->GetBlockCacheHotBlocksPath(), pb,
+      pb_util::OVERWRITE, pb_util::NO_SYNC),
+      "Unable to write block cache hot blocks");
+  VLOG(1) << "Persisted " << pb.blocks_size() << " block cache hot blocks";
+  return Status::OK();
+}
+
+Status BlockCacheWarmer::WarmUp(int* num_blocks_read) {
+  int blocks_read = 0;
+  const string path = fs_manager_->GetBlockCacheHotBlocksPath();
+  if (!fs_manager_->Exists(path)) {
+    if (num_blocks_read) {
+      *num_blocks_read = 0;
+    }
+    return Status::OK();
+  }
+  BlockCacheHotBlocksPB pb;
+  RETURN_NOT_OK_PREPEND(pb_util::ReadPBContainerFromPath(fs_manager_->env(), path, &pb),
+                        "Unable to read block cache hot blocks");
+
+  // Read the blocks of each CFile together and in file order.
+  vector<const BlockCacheHotBlocksPB::HotBlockPB*> blocks;
+  blocks.reserve(pb.blocks_size());
+  for (const BlockCacheHotBlocksPB::HotBlockPB& block : pb.blocks()) {
+    blocks.push_back(&block);
+  }
+  std::sort(blocks.begin(), blocks.end(),
+            [](const BlockCacheHotBlocksPB::HotBlockPB* a,
+               const BlockCacheHotBlocksPB::HotBlockPB* b) {
+              if (a->block_id() != b->block_id()) {
+                return a->block_id() < b->block_id();
+              }
+              return a->pointer().offset() < b->pointer().offset();
+            });
+
+  BlockCache* cache = BlockCache::GetSingleton();
+  const int64_t max_bytes_per_sec =
+      static_cast<int64_t>(FLAGS_block_cache_warmup_max_mb_per_sec) * 1024 * 1024;
+  const MonoTime start = MonoTime::Now();
+  int64_t bytes_read = 0;
+  gscoped_ptr<CFileReader> reader;
+  for (const BlockCacheHotBlocksPB::HotBlockPB* block : blocks) {
+    if (shutdown_latch_.count() == 0) {
+      break;
+    }
+    BlockId block_id(block->block_id());
+    if (!reader || reader->block_id() != block_id) {
+      reader.reset();
+      gscoped_ptr<fs::ReadableBlock> rblock;
+      Status s = fs_manager_->OpenBlock(block_id, &rblock);
+      if (s.ok()) {
+        s = CFileReader::Open(std::move(rblock), ReaderOptions(), &reader);
+      }
+      if (!s.ok()) {
+        // The block was most likely deleted by a compaction since the hot
+        // blocks were persisted.
+        VLOG(1) << "Skipping block cache hot blocks of " << block_id.ToString()
+                << ": " << s.ToString();
+        continue;
+      }
+    }
+
+    BlockPointer ptr(block->pointer());
+    if (ptr.offset() == 0 || ptr.offset() + ptr.size() >= reader->file_size()) {
+      LOG(WARNING) << "Skipping invalid block cache hot block " << ptr.ToString()
+                   << " of " << block_id.ToString();
+      continue;
+    }
+    BlockCacheHandle cache_handle;
+    if (cache->Lookup(BlockCache::CacheKey(block_id, ptr.offset()),
+                      Cache::NO_EXPECT_IN_CACHE, &cache_handle)) {
+      continue;
+    }
+    BlockHandle handle;
+    Status s = reader->ReadBlock(ptr, CFileReader::CACHE_BLOCK, &handle);
+    if (!s.ok()) {
+      LOG(WARNING) << "Unable to read block cache hot block " << ptr.ToString()
+                   << " of " << block_id.ToString() << ": " << s.ToString();
+      continue;
+    }
+    blocks_read++;
+    bytes_read += ptr.size();
+
+    // Sleep for as long as needed to get back under the maximum rate.
+    if (max_bytes_per_sec > 0) {
+      MonoTime allowed = start + MonoDelta::FromSeconds(
+          static_cast<double>(bytes_read) / max_bytes_per_sec);
+      if (shutdown_latch_.WaitUntil(allowed)) {
+        break;
+      }
+    }
+  }
+  LOG(INFO) << Substitute("Read $0 of $1 persisted hot blocks ($2 bytes) into the block cache",
+                          blocks_read, blocks.size(), bytes_read);
+  if (num_blocks_read) {
+    *num_blocks_read = blocks_read;
+  }
+  return Status::OK();
+}
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,81 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_BLOCK_CACHE_WARMER_H
+#define KUDU_CFILE_BLOCK_CACHE_WARMER_H
+
+#include <functional>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class FsManager;
+class Thread;
+
+namespace cfile {
+
+// Keeps the block cache warm across restarts.
+//
+// While the server runs, the blocks most recently read from the block cache
+// (see BlockCache::RecordHotBlock()) are periodically written to a file in
+// the first data directory. When the server starts again, those blocks are
+// read back into the cache in the background, at a throttled rate so that
+// the warm-up doesn't compete too much with the server's own I/O.
+class BlockCacheWarmer {
+ public:
+  explicit BlockCacheWarmer(FsManager* fs_manager);
+  ~BlockCacheWarmer();
+
+  // Start the background thread. It first calls 'wait_fn', if set, and then
+  // warms up the cache from the persisted hot blocks. After that, if the
+  // block cache tracks hot blocks, it persists them every
+  // --block_cache_hot_blocks_persist_interval_secs until Shutdown().
+  Status Start(std::function<Status()> wait_fn);
+
+  // Stop the background thread, persisting the hot blocks one last time.
+  void Shutdown();
+
+  // Write the block cache's current hot blocks to disk, replacing any
+  // previously persisted ones.
+  Status PersistHotBlocks();
+
+  // Read the persisted hot blocks which aren't already in the block cache
+  // into it, at no more than --block_cache_warmup_max_mb_per_sec. Blocks
+  // which no longer exist are skipped. Stops early if Shutdown() is called.
+  //
+  // If 'num_blocks_read' is not NULL, sets it to the number of blocks read.
+  Status WarmUp(int* num_blocks_read);
+
+ private:
+  void Run(const std::function<Status()>& wait_fn);
+
+  FsManager* const fs_manager_;
+
+  CountDownLatch shutdown_latch_;
+
+  scoped_refptr<Thread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockCacheWarmer);
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif
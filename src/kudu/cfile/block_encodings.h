@@ -20,9 +20,11 @@
 
 #include <algorithm>
 #include <stdint.h>
+#include <vector>
 #include <glog/logging.h>
 
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/in_list_index.h"
 #include "kudu/common/rowid.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/cfile/cfile.pb.h"
@@ -154,6 +156,17 @@ class BlockDecoder {
   // allocated in the dst block's arena.
   virtual Status CopyNextValues(size_t *n, ColumnDataView *dst) = 0;
 
+  // Same as CopyNextValues(), except that values which are references to
+  // other memory (eg Slices) may be left pointing into the block's data
+  // rather than being copied into the dst block's arena. The caller must
+  // keep the block's data (and, for dictionary-encoded blocks, the
+  // dictionary's data) alive for as long as the values are in use.
+  //
+  // Decoders which don't store such values contiguously just copy them.
+  virtual Status ReferenceNextValues(size_t *n, ColumnDataView *dst) {
+    return CopyNextValues(n, dst);
+  }
+
   // Fetch the next values from the block and evaluate whether they satisfy
   // the predicate. Mark the row in the view into the selection vector. This
   // view denotes the current location in the CFile.
@@ -194,6 +207,109 @@ class BlockDecoder {
   DISALLOW_COPY_AND_ASSIGN(BlockDecoder);
 };
 
+namespace internal {
+
+// Clears the bit in 'sel' of each of the 'n' cells in 'vals' for which
+// 'matches' returns false, and returns true if any cell matched.
+//
+// The predicate is first evaluated over a chunk of cells without any
+// branching on the selection vector, which allows the compiler to vectorize
+// the comparisons, and the selection vector is then updated in a second pass.
+template <typename CppType, typename Matcher>
+bool ClearNonMatchingCells(const CppType* vals, size_t n, SelectionVectorView* sel,
+                           Matcher matches) {
+  static const size_t kChunkSize = 256;
+  uint8_t chunk_matches[kChunkSize];
+  bool any_matched = false;
+  for (size_t base = 0; base < n; base += kChunkSize) {
+    const size_t len = std::min(kChunkSize, n - base);
+    for (size_t i = 0; i < len; i++) {
+      chunk_matches[i] = matches(vals[base + i]);
+    }
+    for (size_t i = 0; i < len; i++) {
+      if (chunk_matches[i]) {
+        any_matched = true;
+      } else {
+        sel->ClearBit(base + i);
+      }
+    }
+  }
+  return any_matched;
+}
+
+} // namespace internal
+
+// Evaluates 'pred' on the 'n' contiguous, non-null cells of type 'Type'
+// starting at 'cells', which must be suitably aligned, and clears the bit in
+// 'sel' of each cell which does not match. Returns true if any cell matched.
+//
+// Used by the CopyNextAndEval() implementations of fixed-size types. The
+// comparisons are equivalent to those done by ColumnPredicate::EvaluateCell().
+template <DataType Type>
+bool EvaluatePredicateOnCells(const ColumnPredicate& pred,
+                              const void* cells,
+                              size_t n,
+                              SelectionVectorView* sel) {
+  typedef typename DataTypeTraits<Type>::cpp_type CppType;
+  const CppType* vals = reinterpret_cast<const CppType*>(cells);
+
+  switch (pred.predicate_type()) {
+    case PredicateType::None: {
+      sel->ClearBits(n);
+      return false;
+    };
+    case PredicateType::IsNotNull: {
+      return n > 0;
+    };
+    case PredicateType::Equality: {
+      const CppType value = *reinterpret_cast<const CppType*>(pred.raw_lower());
+      return internal::ClearNonMatchingCells(vals, n, sel, [value](CppType v) {
+          return !(v < value) & !(value < v);
+        });
+    };
+    case PredicateType::Range: {
+      if (pred.raw_lower() == nullptr) {
+        const CppType upper = *reinterpret_cast<const CppType*>(pred.raw_upper());
+        return internal::ClearNonMatchingCells(vals, n, sel, [upper](CppType v) {
+            return v < upper;
+          });
+      }
+      const CppType lower = *reinterpret_cast<const CppType*>(pred.raw_lower());
+      if (pred.raw_upper() == nullptr) {
+        return internal::ClearNonMatchingCells(vals, n, sel, [lower](CppType v) {
+            return !(v < lower);
+          });
+      }
+      const CppType upper = *reinterpret_cast<const CppType*>(pred.raw_upper());
+      return internal::ClearNonMatchingCells(vals, n, sel, [lower, upper](CppType v) {
+          return !(v < lower) & (v < upper);
+        });
+    };
+    case PredicateType::InList: {
+      if (pred.in_list_index() != nullptr) {
+        const InListIndex* index = pred.in_list_index();
+        return internal::ClearNonMatchingCells(vals, n, sel, [index](CppType v) {
+            return index->Contains<Type>(&v);
+          });
+      }
+      const std::vector<const void*>& values = pred.raw_values();
+      return internal::ClearNonMatchingCells(vals, n, sel, [&values](CppType v) {
+          return std::binary_search(values.begin(), values.end(), &v,
+                                    [](const void* lhs, const void* rhs) {
+                                      return *reinterpret_cast<const CppType*>(lhs) <
+                                             *reinterpret_cast<const CppType*>(rhs);
+                                    });
+        });
+    };
+    case PredicateType::InBloomFilter: {
+      return internal::ClearNonMatchingCells(vals, n, sel, [&pred](CppType v) {
+          return pred.EvaluateCell<Type>(&v);
+        });
+    };
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
 } // namespace cfile
 } // namespace kudu
 
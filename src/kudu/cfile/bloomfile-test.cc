@@ -18,7 +18,10 @@
 #include "kudu/cfile/bloomfile-test-base.h"
 #include "kudu/fs/fs-test-util.h"
 
+DECLARE_bool(bloomfile_use_blocked_layout);
+
 using std::shared_ptr;
+using std::vector;
 
 namespace kudu {
 namespace cfile {
@@ -66,7 +69,61 @@ TEST_F(BloomFileTest, TestWriteAndRead) {
   VerifyBloomFile();
 }
 
+TEST_F(BloomFileTest, TestWriteAndReadBlocked) {
+  FLAGS_bloomfile_use_blocked_layout = true;
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
+  ASSERT_OK(OpenBloomFile());
+  VerifyBloomFile();
+}
+
+// Check that probing a sorted batch of keys gives the same answers as
+// probing each key on its own.
+TEST_F(BloomFileTest, TestCheckKeysPresent) {
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
+  ASSERT_OK(OpenBloomFile());
+
+  // Interleave keys which were inserted with keys which weren't. Setting the
+  // lowest bit of a shifted key yields a key which was never inserted.
+  const int kNumProbes = FLAGS_n_keys * 2;
+  vector<uint64_t> key_bufs(kNumProbes);
+  for (uint64_t i = 0; i < FLAGS_n_keys; i++) {
+    key_bufs[i * 2] = BigEndian::FromHost64(i << kKeyShift);
+    key_bufs[i * 2 + 1] = BigEndian::FromHost64((i << kKeyShift) | 1);
+  }
+  vector<BloomKeyProbe> probes;
+  probes.reserve(kNumProbes);
+  for (const uint64_t& buf : key_bufs) {
+    probes.emplace_back(Slice(reinterpret_cast<const uint8_t*>(&buf), sizeof(buf)));
+  }
+  vector<const BloomKeyProbe*> probe_ptrs;
+  for (const BloomKeyProbe& probe : probes) {
+    probe_ptrs.push_back(&probe);
+  }
+
+  gscoped_array<bool> present(new bool[kNumProbes]);
+  ASSERT_OK(bfr_->CheckKeysPresent(probe_ptrs.data(), kNumProbes, present.get()));
+  for (int i = 0; i < kNumProbes; i++) {
+    bool expected;
+    ASSERT_OK(bfr_->CheckKeyPresent(probes[i], &expected));
+    ASSERT_EQ(expected, present[i]) << "probe " << i;
+    if (i % 2 == 0) {
+      ASSERT_TRUE(present[i]);
+    }
+  }
+}
+
 #ifdef NDEBUG
+TEST_F(BloomFileTest, BenchmarkBlocked) {
+  FLAGS_bloomfile_use_blocked_layout = true;
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
+  ASSERT_OK(OpenBloomFile());
+
+  uint64_t count_present = ReadBenchmark();
+  if (FLAGS_benchmark_should_hit) {
+    ASSERT_EQ(count_present, FLAGS_benchmark_queries);
+  }
+}
+
 TEST_F(BloomFileTest, Benchmark) {
   ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
   ASSERT_OK(OpenBloomFile());
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <mutex>
 #include <sched.h>
 #include <string>
@@ -25,12 +26,20 @@
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/sysinfo.h"
 #include "kudu/util/coding.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/pb_util.h"
 
 DECLARE_bool(cfile_lazy_open);
 
+DEFINE_bool(bloomfile_use_blocked_layout, false,
+            "Whether to write new bloom filters using the cache-line-blocked layout, "
+            "whose probes touch a single cache line, instead of the classic layout. "
+            "Bloom files written with the blocked layout can't be read by versions "
+            "of Kudu which predate it.");
+TAG_FLAG(bloomfile_use_blocked_layout, experimental);
+
 namespace kudu {
 namespace cfile {
 
@@ -44,7 +53,8 @@ using fs::WritableBlock;
 
 BloomFileWriter::BloomFileWriter(gscoped_ptr<WritableBlock> block,
                                  const BloomFilterSizing &sizing)
-  : bloom_builder_(sizing) {
+  : bloom_builder_(sizing, FLAGS_bloomfile_use_blocked_layout ?
+                   BloomFilterLayout::BLOCKED : BloomFilterLayout::CLASSIC) {
   cfile::WriterOptions opts;
   opts.write_posidx = false;
   opts.write_validx = true;
@@ -112,6 +122,8 @@ Status BloomFileWriter::FinishCurrentBloomBlock() {
   // Encode the header.
   BloomBlockHeaderPB hdr;
   hdr.set_num_hash_functions(bloom_builder_.n_hashes());
+  hdr.set_layout(bloom_builder_.layout() == BloomFilterLayout::BLOCKED ?
+                 BLOCKED_BLOOM : CLASSIC_BLOOM);
   faststring hdr_str;
   PutFixed32(&hdr_str, hdr.ByteSize());
   pb_util::AppendToString(hdr, &hdr_str);
@@ -194,6 +206,8 @@ Status BloomFileReader::InitOnce() {
   }
 
   BlockPointer validx_root = reader_->validx_root();
+  const PinnedIndexBlocks* pinned;
+  RETURN_NOT_OK(reader_->GetPinnedValIdxBlocks(&pinned));
 
   // Ugly hack: create a per-cpu iterator.
   // Instead this should be threadlocal, or allow us to just
@@ -201,7 +215,7 @@ Status BloomFileReader::InitOnce() {
   int n_cpus = base::MaxCPUIndex() + 1;
   for (int i = 0; i < n_cpus; i++) {
     index_iters_.emplace_back(
-      IndexTreeIterator::Create(reader_.get(), validx_root));
+      IndexTreeIterator::Create(reader_.get(), validx_root, true, pinned));
   }
   iter_locks_.reset(new padded_spinlock[n_cpus]);
 
@@ -236,33 +250,70 @@ Status BloomFileReader::ParseBlockHeader(const Slice &block,
   }
 
   data.remove_prefix(header_len);
+  switch (hdr->layout()) {
+    case CLASSIC_BLOOM:
+      break;
+    case BLOCKED_BLOOM:
+      if (PREDICT_FALSE(data.size() < BloomFilter::kBucketBytes)) {
+        return Status::Corruption(
+            StringPrintf("Blocked bloom filter of size %ld is smaller than a bucket",
+                         data.size()));
+      }
+      break;
+    default:
+      return Status::NotSupported("Unknown bloom filter layout",
+                                  BloomFilterLayoutPB_Name(hdr->layout()));
+  }
   *bloom_data = data;
   return Status::OK();
 }
 
-Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
-                                        bool *maybe_present) {
-  DCHECK(init_once_.initted());
-
+cfile::IndexTreeIterator* BloomFileReader::LockIndexIterator(
+    std::unique_lock<simple_spinlock>* lock) {
 #if defined(__linux__)
   int cpu = sched_getcpu();
 #else
   // Use just one lock if on OS X.
   int cpu = 0;
 #endif
+  while (true) {
+    std::unique_lock<simple_spinlock> l(iter_locks_[cpu], std::try_to_lock);
+    if (l.owns_lock()) {
+      lock->swap(l);
+      break;
+    }
+    cpu = (cpu + 1) % index_iters_.size();
+  }
+  return index_iters_[cpu].get();
+}
+
+void BloomFileReader::ReleaseIndexBlocks() {
+  if (!init_once_.initted()) {
+    return;
+  }
+  BlockPointer validx_root = reader_->validx_root();
+  const PinnedIndexBlocks* pinned;
+  if (!reader_->GetPinnedValIdxBlocks(&pinned).ok()) {
+    return;
+  }
+  for (int i = 0; i < index_iters_.size(); i++) {
+    std::lock_guard<simple_spinlock> l(iter_locks_[i]);
+    index_iters_[i].reset(IndexTreeIterator::Create(reader_.get(), validx_root, true, pinned));
+  }
+}
+
+static BloomFilterLayout LayoutFromPB(BloomFilterLayoutPB layout) {
+  return layout == BLOCKED_BLOOM ? BloomFilterLayout::BLOCKED : BloomFilterLayout::CLASSIC;
+}
+
+Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
+                                        bool *maybe_present) {
+  DCHECK(init_once_.initted());
+
   BlockPointer bblk_ptr;
   {
     std::unique_lock<simple_spinlock> lock;
-    while (true) {
-      std::unique_lock<simple_spinlock> l(iter_locks_[cpu], std::try_to_lock);
-      if (l.owns_lock()) {
-        lock.swap(l);
-        break;
-      }
-      cpu = (cpu + 1) % index_iters_.size();
-    }
-
-    cfile::IndexTreeIterator *index_iter = index_iters_[cpu].get();
+    cfile::IndexTreeIterator *index_iter = LockIndexIterator(&lock);
 
     Status s = index_iter->SeekAtOrBefore(probe.key());
     if (PREDICT_FALSE(s.IsNotFound())) {
@@ -285,11 +336,52 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
 
   // Actually check the bloom filter.
-  BloomFilter bf(bloom_data, hdr.num_hash_functions());
+  BloomFilter bf(bloom_data, hdr.num_hash_functions(), LayoutFromPB(hdr.layout()));
   *maybe_present = bf.MayContainKey(probe);
   return Status::OK();
 }
 
+Status BloomFileReader::CheckKeysPresent(const BloomKeyProbe* const* probes, int n,
+                                         bool* maybe_present) {
+  DCHECK(init_once_.initted());
+
+  std::unique_lock<simple_spinlock> lock;
+  cfile::IndexTreeIterator* index_iter = LockIndexIterator(&lock);
+
+  // The bloom block holding the previous key. Since the keys are sorted,
+  // runs of consecutive keys usually fall into the same block.
+  bool have_block = false;
+  BlockPointer cur_ptr;
+  BlockHandle cur_data;
+  BloomFilter cur_bf(Slice(), 0);
+  for (int i = 0; i < n; i++) {
+    DCHECK(i == 0 || probes[i - 1]->key().compare(probes[i]->key()) <= 0)
+        << "keys must be sorted";
+    Status s = index_iter->SeekAtOrBefore(probes[i]->key());
+    if (PREDICT_FALSE(s.IsNotFound())) {
+      // Seek to before the first entry in the file.
+      maybe_present[i] = false;
+      continue;
+    }
+    RETURN_NOT_OK(s);
+
+    BlockPointer bblk_ptr = index_iter->GetCurrentBlockPointer();
+    if (!have_block || bblk_ptr.offset() != cur_ptr.offset()) {
+      BlockHandle data;
+      RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &data));
+      BloomBlockHeaderPB hdr;
+      Slice bloom_data;
+      RETURN_NOT_OK(ParseBlockHeader(data.data(), &hdr, &bloom_data));
+      cur_bf = BloomFilter(bloom_data, hdr.num_hash_functions(), LayoutFromPB(hdr.layout()));
+      cur_data = std::move(data);
+      cur_ptr = bblk_ptr;
+      have_block = true;
+    }
+    maybe_present[i] = cur_bf.MayContainKey(*probes[i]);
+  }
+  return Status::OK();
+}
+
 size_t BloomFileReader::memory_footprint_excluding_reader() const {
   size_t size = kudu_malloc_usable_size(this);
 
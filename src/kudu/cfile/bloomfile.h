@@ -103,6 +103,19 @@ class BloomFileReader {
   Status CheckKeyPresent(const BloomKeyProbe &probe,
                          bool *maybe_present);
 
+  // Check if each of the 'n' given keys, which must be sorted, may be
+  // present in the file, setting maybe_present[i] for probes[i].
+  //
+  // Cheaper than calling CheckKeyPresent() for each key: the index is only
+  // locked once, and consecutive keys which fall into the same bloom block
+  // share a single block read and header parse.
+  Status CheckKeysPresent(const BloomKeyProbe* const* probes, int n,
+                          bool* maybe_present);
+
+  // Releases the index blocks which the per-CPU index iterators hold on to
+  // since their last seek, so that the block cache may evict them.
+  void ReleaseIndexBlocks();
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BloomFileReader);
 
@@ -117,6 +130,10 @@ class BloomFileReader {
                           BloomBlockHeaderPB *hdr,
                           Slice *bloom_data) const;
 
+  // Lock one of the per-CPU index iterators, returning it and setting
+  // *lock to hold its lock.
+  cfile::IndexTreeIterator* LockIndexIterator(std::unique_lock<simple_spinlock>* lock);
+
   // Callback used in 'init_once_' to initialize this bloom file.
   Status InitOnce();
 
@@ -316,6 +316,38 @@ class BShufBlockDecoder final : public BlockDecoder {
     return CopyNextValuesToArray(n, dst->data());
   }
 
+  // Evaluate the predicate directly on the unshuffled values, copying them
+  // out only if any of them match.
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override {
+    DCHECK(parsed_);
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    ctx->SetDecoderEvalSupported();
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    if (size_of_elem_ != size_of_type) {
+      // The values were stored narrower than the type (see the UINT32
+      // specialization of CopyNextValuesToArray()), so expand them first.
+      RETURN_NOT_OK(CopyNextValuesToArray(n, dst->data()));
+      EvaluatePredicateOnCells<Type>(*ctx->pred(), dst->data(), *n, sel);
+      return Status::OK();
+    }
+
+    size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    const uint8_t* src = &decoded_[cur_idx_ * size_of_type];
+    if (EvaluatePredicateOnCells<Type>(*ctx->pred(), src, max_fetch, sel)) {
+      memcpy(dst->data(), src, max_fetch * size_of_type);
+    }
+    *n = max_fetch;
+    cur_idx_ += max_fetch;
+    return Status::OK();
+  }
+
   // Copy the codewords to a temporary buffer.
   // This API provides a more convenient way for the dictionary decoder to copy out
   // integer codewords and then look up the strings. If we use the CopyNextValuesToArray()
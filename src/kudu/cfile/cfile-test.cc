@@ -18,24 +18,36 @@
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 #include <stdlib.h>
+#include <limits>
 #include <list>
 
+#include "kudu/cfile/block_cache_warmer.h"
 #include "kudu/cfile/cfile-test-base.h"
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/cfile/zone_map.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/random.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/stopwatch.h"
 
+DECLARE_int32(block_cache_tracked_hot_blocks);
+DECLARE_bool(cfile_adaptive_encoding);
 DECLARE_string(block_cache_type);
 DECLARE_string(cfile_do_on_finish);
+DECLARE_int32(cfile_dict_max_pages);
+DECLARE_int32(cfile_max_readahead_blocks);
+DECLARE_bool(cfile_pin_internal_index_blocks);
+DECLARE_bool(cfile_zero_copy_binary_scans);
 
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
@@ -47,6 +59,7 @@ METRIC_DECLARE_counter(block_cache_hits_caching);
 METRIC_DECLARE_entity(server);
 
 using std::shared_ptr;
+using strings::Substitute;
 
 namespace kudu {
 namespace cfile {
@@ -448,6 +461,26 @@ TEST_P(TestCFileBothCacheTypes, TestReadWriteUInt32) {
   }
 }
 
+// Test that with adaptive encoding, a file of values in a regular sequence is
+// written with an encoding more compact for them than the default, and that
+// it reads back.
+TEST_P(TestCFileBothCacheTypes, TestAdaptiveEncoding) {
+  FLAGS_cfile_adaptive_encoding = true;
+  BlockId block_id;
+  UInt32DataGenerator<false> generator;
+  WriteTestFile(&generator, AUTO_ENCODING, NO_COMPRESSION, 10000, SMALL_BLOCKSIZE, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_NE(BIT_SHUFFLE, reader->footer().encoding());
+
+  TestReadWriteFixedSizeTypes<UInt32DataGenerator<false>>(AUTO_ENCODING);
+  UInt32DataGenerator<true> nullable_generator;
+  TestNullTypes(&nullable_generator, AUTO_ENCODING, NO_COMPRESSION);
+}
+
 TEST_P(TestCFileBothCacheTypes, TestReadWriteInt32) {
   for (auto enc : { PLAIN_ENCODING, RLE }) {
     TestReadWriteFixedSizeTypes<Int32DataGenerator<false>>(enc);
@@ -748,6 +781,75 @@ TEST_P(TestCFileBothCacheTypes, TestAppendRaw) {
   TestReadWriteRawBlocks(SNAPPY, 1000);
   TestReadWriteRawBlocks(LZ4, 1000);
   TestReadWriteRawBlocks(ZLIB, 1000);
+  TestReadWriteRawBlocks(ZSTD, 1000);
+}
+
+// Test that iterators over a multi-level index find the same blocks whether
+// or not the index's internal blocks are pinned.
+TEST_P(TestCFileBothCacheTypes, TestPinnedIndexBlocks) {
+  gscoped_ptr<WritableBlock> sink;
+  ASSERT_OK(fs_manager_->CreateNewBlock(&sink));
+  BlockId id = sink->id();
+  WriterOptions opts;
+  opts.write_posidx = true;
+  // Use tiny index blocks so that the index has several levels.
+  opts.index_block_size = 64;
+  opts.storage_attributes.encoding = PLAIN_ENCODING;
+  CFileWriter w(opts, GetTypeInfo(STRING), false, std::move(sink));
+  ASSERT_OK(w.Start());
+  const int kNumBlocks = 2000;
+  for (uint32_t i = 0; i < kNumBlocks; i++) {
+    vector<Slice> slices = { Slice(reinterpret_cast<uint8_t *>(&i), 4) };
+    ASSERT_OK(w.AppendRawBlock(slices, i, nullptr, Slice(), "raw-data"));
+  }
+  ASSERT_OK(w.Finish());
+
+  gscoped_ptr<ReadableBlock> source;
+  ASSERT_OK(fs_manager_->OpenBlock(id, &source));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(source), ReaderOptions(), &reader));
+
+  const PinnedIndexBlocks* pinned;
+  ASSERT_OK(reader->GetPinnedPosIdxBlocks(&pinned));
+  ASSERT_TRUE(pinned != nullptr);
+  ASSERT_TRUE(pinned->Lookup(reader->posidx_root()) != nullptr);
+
+  gscoped_ptr<IndexTreeIterator> unpinned_iter(
+      IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
+  gscoped_ptr<IndexTreeIterator> pinned_iter(
+      IndexTreeIterator::Create(reader.get(), reader->posidx_root(), true, pinned));
+
+  // Iterate over every leaf entry.
+  vector<string> keys;
+  ASSERT_OK(unpinned_iter->SeekToFirst());
+  ASSERT_OK(pinned_iter->SeekToFirst());
+  while (true) {
+    ASSERT_EQ(unpinned_iter->GetCurrentKey(), pinned_iter->GetCurrentKey());
+    ASSERT_EQ(unpinned_iter->GetCurrentBlockPointer().offset(),
+              pinned_iter->GetCurrentBlockPointer().offset());
+    keys.push_back(unpinned_iter->GetCurrentKey().ToString());
+    ASSERT_EQ(unpinned_iter->HasNext(), pinned_iter->HasNext());
+    if (!unpinned_iter->HasNext()) break;
+    ASSERT_OK(unpinned_iter->Next());
+    ASSERT_OK(pinned_iter->Next());
+  }
+  ASSERT_EQ(kNumBlocks, keys.size());
+
+  // Seek to random keys.
+  Random rng(SeedRandom());
+  for (int i = 0; i < 1000; i++) {
+    const string& key = keys[rng.Uniform(keys.size())];
+    ASSERT_OK(unpinned_iter->SeekAtOrBefore(key));
+    ASSERT_OK(pinned_iter->SeekAtOrBefore(key));
+    ASSERT_EQ(key, pinned_iter->GetCurrentKey());
+    ASSERT_EQ(unpinned_iter->GetCurrentBlockPointer().offset(),
+              pinned_iter->GetCurrentBlockPointer().offset());
+  }
+
+  // Pinning can be disabled.
+  FLAGS_cfile_pin_internal_index_blocks = false;
+  ASSERT_OK(reader->GetPinnedPosIdxBlocks(&pinned));
+  ASSERT_TRUE(pinned == nullptr);
 }
 
 TEST_P(TestCFileBothCacheTypes, TestNullInts) {
@@ -758,6 +860,59 @@ TEST_P(TestCFileBothCacheTypes, TestNullInts) {
   TestNullTypes(&generator, BIT_SHUFFLE, LZ4);
 }
 
+// Nulls in runs of 1000 rows, like a sparse column, so that most blocks are
+// either entirely null or entirely non-null.
+class SparseUInt32DataGenerator : public UInt32DataGenerator<true> {
+ public:
+  bool TestValueShouldBeNull(size_t n) OVERRIDE {
+    return (n / 1000) % 2 == 0;
+  }
+};
+
+TEST_P(TestCFileBothCacheTypes, TestSparseNullInts) {
+  SparseUInt32DataGenerator generator;
+  TestNullTypes(&generator, PLAIN_ENCODING, NO_COMPRESSION);
+  TestNullTypes(&generator, BIT_SHUFFLE, NO_COMPRESSION);
+
+  // Only the rows of the non-null runs match an IsNotNull predicate.
+  BlockId block_id;
+  generator.Reset();
+  WriteTestFile(&generator, BIT_SHUFFLE, NO_COMPRESSION, 10000, SMALL_BLOCKSIZE, &block_id);
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+
+  ColumnPredicate pred = ColumnPredicate::IsNotNull(ColumnSchema("c", UINT32, true));
+  ScopedColumnBlock<UINT32> cb(300);
+  SelectionVector sel(cb.nrows());
+  int read_offset = 0;
+  int num_matched = 0;
+  while (iter->HasNext()) {
+    size_t n = cb.nrows();
+    sel.SetAllTrue();
+    ColumnMaterializationContext ctx(0, &pred, &cb, &sel);
+    ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+    if (ctx.DecoderEvalNotSupported()) {
+      pred.Evaluate(cb, &sel);
+    }
+    for (size_t j = 0; j < n; j++) {
+      const bool is_null = generator.TestValueShouldBeNull(read_offset + j);
+      ASSERT_EQ(!is_null, sel.IsRowSelected(j)) << "row " << read_offset + j;
+      if (!is_null) {
+        ASSERT_EQ((read_offset + j) * 10, cb[j]);
+        num_matched++;
+      }
+    }
+    read_offset += n;
+  }
+  ASSERT_EQ(10000, read_offset);
+  ASSERT_EQ(5000, num_matched);
+}
+
 TEST_P(TestCFileBothCacheTypes, TestNullFloats) {
   FPDataGenerator<FLOAT, true> generator;
   TestNullTypes(&generator, PLAIN_ENCODING, NO_COMPRESSION);
@@ -898,6 +1053,298 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
   }
 }
 
+// Tests that the blocks read from the block cache are persisted by the
+// BlockCacheWarmer and read back into a cold cache.
+TEST_P(TestCFileBothCacheTypes, TestWarmUp) {
+  FLAGS_block_cache_tracked_hot_blocks = 1000;
+  Singleton<BlockCache>::UnsafeReset();
+
+  BlockId block_id;
+  {
+    const int nrows = 1000;
+    StringDataGenerator<false> generator("hello %04d");
+    WriteTestFile(&generator, PREFIX_ENCODING, NO_COMPRESSION, nrows,
+                  SMALL_BLOCKSIZE | WRITE_VALIDX, &block_id);
+  }
+
+  // Read the index root and the first data block twice, so that the second
+  // reads hit in the cache.
+  BlockPointer data_ptr;
+  for (int i = 0; i < 2; i++) {
+    gscoped_ptr<ReadableBlock> source;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &source));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(source), ReaderOptions(), &reader));
+
+    gscoped_ptr<IndexTreeIterator> iter;
+    iter.reset(IndexTreeIterator::Create(reader.get(), reader->posidx_root()));
+    ASSERT_OK(iter->SeekToFirst());
+    data_ptr = iter->GetCurrentBlockPointer();
+
+    BlockHandle bh;
+    ASSERT_OK(reader->ReadBlock(data_ptr, CFileReader::CACHE_BLOCK, &bh));
+  }
+
+  BlockCacheWarmer warmer(fs_manager_.get());
+  ASSERT_OK(warmer.PersistHotBlocks());
+
+  // Warm up a cold cache.
+  Singleton<BlockCache>::UnsafeReset();
+  int num_blocks_read;
+  ASSERT_OK(warmer.WarmUp(&num_blocks_read));
+  ASSERT_EQ(2, num_blocks_read);
+  {
+    BlockCacheHandle handle;
+    ASSERT_TRUE(BlockCache::GetSingleton()->Lookup(
+        BlockCache::CacheKey(block_id, data_ptr.offset()), Cache::EXPECT_IN_CACHE, &handle));
+  }
+
+  // Blocks which are already cached aren't read again.
+  ASSERT_OK(warmer.WarmUp(&num_blocks_read));
+  ASSERT_EQ(0, num_blocks_read);
+
+  // Blocks which have since been deleted are skipped.
+  ASSERT_OK(fs_manager_->DeleteBlock(block_id));
+  Singleton<BlockCache>::UnsafeReset();
+  ASSERT_OK(warmer.WarmUp(&num_blocks_read));
+  ASSERT_EQ(0, num_blocks_read);
+}
+
+// Tests that enabling readahead yields the same results as a regular scan,
+// both when scanning sequentially and when seeking in the middle of a scan.
+TEST_P(TestCFileBothCacheTypes, TestReadahead) {
+  const int kNumRows = 10000;
+  BlockId block_id;
+  UInt32DataGenerator<true> generator;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                SMALL_BLOCKSIZE, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+
+  for (auto cache_control : { CFileReader::CACHE_BLOCK, CFileReader::DONT_CACHE_BLOCK }) {
+    // Depths beyond --cfile_max_readahead_blocks are reduced to it.
+    for (int depth : { 1, 4, 64, std::numeric_limits<int>::max() }) {
+      SCOPED_TRACE(Substitute("cache_control=$0 depth=$1", cache_control, depth));
+      gscoped_ptr<CFileIterator> iter;
+      ASSERT_OK(reader->NewIterator(&iter, cache_control));
+      iter->set_readahead_depth(depth);
+      ASSERT_EQ(std::min(depth, FLAGS_cfile_max_readahead_blocks), iter->readahead_depth());
+
+      ScopedColumnBlock<UINT32> cb(37);
+      SelectionVector sel(cb.nrows());
+      ColumnMaterializationContext ctx = CreateNonDecoderEvalContext(&cb, &sel);
+
+      // Scan the first half of the file, then seek back a bit and scan the
+      // rest. The seek must discard any readahead that was in flight.
+      for (int start : { 0, kNumRows / 3 }) {
+        ASSERT_OK(iter->SeekToOrdinal(start));
+        int end = start == 0 ? kNumRows / 2 : kNumRows;
+        int read_offset = start;
+        while (read_offset < end) {
+          ASSERT_TRUE(iter->HasNext());
+          size_t n = cb.nrows();
+          ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+          ASSERT_GT(n, 0);
+          generator.Build(read_offset, n);
+          for (size_t j = 0; j < n; j++) {
+            bool expected_null = generator.TestValueShouldBeNull(read_offset + j);
+            ASSERT_EQ(expected_null, cb.is_null(j));
+            if (!expected_null) {
+              ASSERT_EQ(generator[j], cb[j]);
+            }
+          }
+          read_offset += n;
+        }
+      }
+      ASSERT_FALSE(iter->HasNext());
+    }
+  }
+}
+
+// Tests that zone maps summarize each data block, and that scans with a
+// predicate use them to skip blocks which cannot match.
+TEST_P(TestCFileBothCacheTypes, TestZoneMapSkipping) {
+  const int kNumRows = 10000;
+  BlockId block_id;
+  UInt32DataGenerator<true> generator;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumRows,
+                SMALL_BLOCKSIZE | WRITE_ZONE_MAP, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_TRUE(reader->has_zone_map());
+
+  // The entries should tile the file, with bounds matching the generated data
+  // (each row's value is ten times its ordinal).
+  const ZoneMap* zone_map;
+  ASSERT_OK(reader->GetZoneMap(&zone_map));
+  int num_blocks = 0;
+  rowid_t next_row = 0;
+  for (; next_row < kNumRows; num_blocks++) {
+    const ZoneMapEntryPB* entry = zone_map->FindEntry(next_row);
+    ASSERT_TRUE(entry != nullptr) << "no entry for row " << next_row;
+    int null_count = 0;
+    for (int i = 0; i < entry->num_rows(); i++) {
+      null_count += generator.TestValueShouldBeNull(next_row + i) ? 1 : 0;
+    }
+    ASSERT_EQ(null_count, entry->null_count());
+    if (null_count < entry->num_rows()) {
+      uint32_t min;
+      uint32_t max;
+      ASSERT_EQ(sizeof(min), entry->min_value().size());
+      memcpy(&min, entry->min_value().data(), sizeof(min));
+      memcpy(&max, entry->max_value().data(), sizeof(max));
+      ASSERT_LE(next_row * 10, min);
+      ASSERT_GE((next_row + entry->num_rows() - 1) * 10, max);
+    }
+    next_row += entry->num_rows();
+  }
+  ASSERT_EQ(kNumRows, next_row);
+  ASSERT_GT(num_blocks, 10);
+
+  // Scan for values in [50000, 51000), which come from rows 5000-5099.
+  uint32_t lower = 50000;
+  uint32_t upper = 51000;
+  ColumnSchema col("c", UINT32, true);
+  ColumnPredicate pred = ColumnPredicate::Range(col, &lower, &upper);
+
+  gscoped_ptr<CFileIterator> iter;
+  ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+  ScopedColumnBlock<UINT32> cb(100);
+  SelectionVector sel(cb.nrows());
+  int num_matched = 0;
+  int read_offset = 0;
+  while (iter->HasNext()) {
+    size_t n = cb.nrows();
+    sel.SetAllTrue();
+    ColumnMaterializationContext ctx(0, &pred, &cb, &sel);
+    ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+    if (ctx.DecoderEvalNotSupported()) {
+      pred.Evaluate(cb, &sel);
+    }
+    for (size_t j = 0; j < n; j++) {
+      if (sel.IsRowSelected(j)) {
+        ASSERT_FALSE(cb.is_null(j));
+        ASSERT_EQ((read_offset + j) * 10, cb[j]);
+        num_matched++;
+      }
+    }
+    read_offset += n;
+  }
+  ASSERT_EQ(kNumRows, read_offset);
+  int expected_matched = 0;
+  for (int i = 5000; i < 5100; i++) {
+    expected_matched += generator.TestValueShouldBeNull(i) ? 0 : 1;
+  }
+  ASSERT_EQ(expected_matched, num_matched);
+
+  // Only the first block (read when seeking) and the blocks overlapping the
+  // range should have been read.
+  ASSERT_LT(iter->io_statistics().data_blocks_read_from_disk, 5);
+}
+
+// Test that binary values scanned without copying stay valid for as long as
+// the output arena, even once the iterator and reader are gone.
+TEST_P(TestCFileBothCacheTypes, TestZeroCopyStrings) {
+  const int kNumRows = 10000;
+  const int kBatchSize = 500;
+  for (EncodingType encoding : { PLAIN_ENCODING, DICT_ENCODING, PREFIX_ENCODING }) {
+    for (bool zero_copy : { false, true }) {
+      SCOPED_TRACE(Substitute("encoding $0, zero_copy $1", encoding, zero_copy));
+      FLAGS_cfile_zero_copy_binary_scans = zero_copy;
+      BlockId block_id;
+      StringDataGenerator<false> generator("hello %04d");
+      WriteTestFile(&generator, encoding, NO_COMPRESSION, kNumRows,
+                    SMALL_BLOCKSIZE, &block_id);
+
+      ScopedColumnBlock<STRING> cb(kBatchSize);
+      size_t initial_footprint = cb.arena()->memory_footprint();
+      {
+        gscoped_ptr<ReadableBlock> block;
+        ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+        gscoped_ptr<CFileReader> reader;
+        ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+        gscoped_ptr<CFileIterator> iter;
+        ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+        ASSERT_OK(iter->SeekToOrdinal(1000));
+        SelectionVector sel(kBatchSize);
+        ColumnMaterializationContext ctx(0, nullptr, &cb, &sel);
+        size_t n = kBatchSize;
+        ASSERT_OK(iter->CopyNextValues(&n, &ctx));
+        ASSERT_EQ(kBatchSize, n);
+      }
+
+      for (int i = 0; i < kBatchSize; i++) {
+        ASSERT_EQ(Substitute("hello $0", 1000 + i), cb[i].ToString());
+      }
+      // Prefix-encoded values are always reconstructed in the arena.
+      if (zero_copy && encoding != PREFIX_ENCODING) {
+        ASSERT_EQ(initial_footprint, cb.arena()->memory_footprint());
+      } else {
+        ASSERT_GT(cb.arena()->memory_footprint(), initial_footprint);
+      }
+    }
+  }
+}
+
+// Test that a dictionary-encoded file whose dictionary fills up is split into
+// several dictionary pages, rather than falling back to plain encoding, and
+// that it reads back, with and without a predicate.
+TEST_P(TestCFileBothCacheTypes, TestMultipleDictPages) {
+  const int kNumRows = 10000;
+  FLAGS_cfile_dict_max_pages = 1000;
+  BlockId block_id;
+  StringDataGenerator<false> generator("hello %zu");
+  WriteTestFile(&generator, DICT_ENCODING, NO_COMPRESSION, kNumRows,
+                SMALL_BLOCKSIZE, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_GT(reader->footer().extra_dict_block_ptrs_size(), 10);
+  ASSERT_TRUE(reader->footer().incompatible_features() & MULTIPLE_DICT_PAGES);
+
+  for (bool with_pred : { false, true }) {
+    SCOPED_TRACE(with_pred);
+    Slice value("hello 9000");
+    ColumnSchema col("c", STRING);
+    ColumnPredicate pred = ColumnPredicate::Equality(col, &value);
+
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+    ScopedColumnBlock<STRING> cb(100);
+    SelectionVector sel(cb.nrows());
+    int num_matched = 0;
+    int read_offset = 0;
+    while (iter->HasNext()) {
+      size_t n = cb.nrows();
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, with_pred ? &pred : nullptr, &cb, &sel);
+      ASSERT_OK_FAST(iter->CopyNextValues(&n, &ctx));
+      if (with_pred && ctx.DecoderEvalNotSupported()) {
+        pred.Evaluate(cb, &sel);
+      }
+      for (size_t j = 0; j < n; j++) {
+        if (sel.IsRowSelected(j)) {
+          ASSERT_EQ(Substitute("hello $0", read_offset + j), cb[j].ToString());
+          num_matched++;
+        }
+      }
+      read_offset += n;
+    }
+    ASSERT_EQ(kNumRows, read_offset);
+    ASSERT_EQ(with_pred ? 1 : kNumRows, num_matched);
+  }
+}
+
 #if defined(__linux__)
 // Inject failures in nvm allocation and ensure that we can still read a file.
 TEST_P(TestCFileBothCacheTypes, TestNvmAllocationFailure) {
@@ -912,7 +1359,7 @@ class TestCFileDifferentCodecs : public TestCFile,
 };
 
 INSTANTIATE_TEST_CASE_P(Codecs, TestCFileDifferentCodecs,
-                        ::testing::Values(NO_COMPRESSION, SNAPPY, LZ4, ZLIB));
+                        ::testing::Values(NO_COMPRESSION, SNAPPY, LZ4, ZLIB, ZSTD));
 
 // Read/write a file with uncompressible data (random int32s)
 TEST_P(TestCFileDifferentCodecs, TestUncompressible) {
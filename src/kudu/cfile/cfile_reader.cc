@@ -20,6 +20,7 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <memory>
 
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/block_cache.h"
@@ -29,13 +30,20 @@
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/cfile/zone_map.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/mathlimits.h"
+#include "kudu/gutil/singleton.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/compression/compression_codec.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/object_pool.h"
@@ -43,13 +51,43 @@
 #include "kudu/util/rle-encoding.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
 DEFINE_bool(cfile_lazy_open, true,
             "Allow lazily opening of cfiles");
 TAG_FLAG(cfile_lazy_open, hidden);
 
+DEFINE_int32(cfile_readahead_threads, 4,
+             "Maximum number of threads used to issue background readahead "
+             "for sequential cfile scans.");
+TAG_FLAG(cfile_readahead_threads, experimental);
+
+DEFINE_int32(cfile_max_readahead_blocks, 16,
+             "Maximum number of data blocks which each cfile iterator reads ahead "
+             "of a sequential scan. Larger readahead depths requested by scans are "
+             "reduced to this.");
+TAG_FLAG(cfile_max_readahead_blocks, experimental);
+TAG_FLAG(cfile_max_readahead_blocks, runtime);
+
+DEFINE_bool(cfile_zero_copy_binary_scans, true,
+            "Whether scans of binary columns may return values which point "
+            "directly into the pinned data blocks, which are then kept alive "
+            "by the scan's output arena, rather than copying each value into "
+            "the arena.");
+TAG_FLAG(cfile_zero_copy_binary_scans, advanced);
+TAG_FLAG(cfile_zero_copy_binary_scans, runtime);
+
+DEFINE_bool(cfile_pin_internal_index_blocks, true,
+            "Whether to keep the internal (non-leaf) blocks of each cfile's "
+            "indexes in memory once they are first used, so that seeks only "
+            "read leaf index blocks through the block cache.");
+TAG_FLAG(cfile_pin_internal_index_blocks, advanced);
+TAG_FLAG(cfile_pin_internal_index_blocks, runtime);
+
 using kudu::fs::ReadableBlock;
+using std::shared_ptr;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -62,6 +100,10 @@ const char* CFILE_CACHE_HIT_BYTES_METRIC_NAME = "cfile_cache_hit_bytes";
 static const size_t kMagicAndLengthSize = 12;
 static const size_t kMaxHeaderFooterPBSize = 64*1024;
 
+// Number of data blocks an iterator must advance through without seeking
+// before it is considered to be scanning sequentially and starts readahead.
+static const int kReadaheadTriggerBlocks = 2;
+
 static Status ParseMagicAndLength(const Slice &data,
                                   uint8_t* cfile_version,
                                   uint32_t *parsed_len) {
@@ -147,8 +189,7 @@ Status CFileReader::InitOnce() {
 
   RETURN_NOT_OK(ReadAndParseFooter());
 
-  if (PREDICT_FALSE(footer_->incompatible_features() != 0)) {
-    // Currently we do not support any incompatible features.
+  if (PREDICT_FALSE(footer_->incompatible_features() & ~kSupportedIncompatibleFeatures)) {
     return Status::NotSupported(Substitute(
         "cfile uses features from an incompatible version: $0",
         footer_->incompatible_features()));
@@ -175,6 +216,64 @@ Status CFileReader::Init() {
   return init_once_.Init(&CFileReader::InitOnce, this);
 }
 
+Status CFileReader::GetZoneMap(const ZoneMap** zone_map) {
+  DCHECK(has_zone_map());
+  RETURN_NOT_OK(zone_map_once_.Init(&CFileReader::ReadZoneMapOnce, this));
+  *zone_map = zone_map_.get();
+  return Status::OK();
+}
+
+Status CFileReader::ReadZoneMapOnce() {
+  BlockHandle handle;
+  RETURN_NOT_OK_PREPEND(ReadBlock(BlockPointer(footer().zone_map_block_ptr()),
+                                  CACHE_BLOCK, &handle),
+                        "couldn't read zone map");
+  RETURN_NOT_OK_PREPEND(ZoneMap::Parse(type_info_, handle.data(), &zone_map_),
+                        Substitute("couldn't parse zone map of cfile $0", ToString()));
+
+  // The zone map has been allocated; memory consumption has changed.
+  mem_consumption_.Reset(memory_footprint());
+  return Status::OK();
+}
+
+Status CFileReader::GetPinnedPosIdxBlocks(const PinnedIndexBlocks** pinned) {
+  DCHECK(has_posidx());
+  *pinned = nullptr;
+  if (FLAGS_cfile_pin_internal_index_blocks) {
+    RETURN_NOT_OK(posidx_pinned_once_.Init(&CFileReader::PinPosIdxBlocksOnce, this));
+    *pinned = posidx_pinned_.get();
+  }
+  return Status::OK();
+}
+
+Status CFileReader::GetPinnedValIdxBlocks(const PinnedIndexBlocks** pinned) {
+  DCHECK(has_validx());
+  *pinned = nullptr;
+  if (FLAGS_cfile_pin_internal_index_blocks) {
+    RETURN_NOT_OK(validx_pinned_once_.Init(&CFileReader::PinValIdxBlocksOnce, this));
+    *pinned = validx_pinned_.get();
+  }
+  return Status::OK();
+}
+
+Status CFileReader::PinPosIdxBlocksOnce() {
+  RETURN_NOT_OK_PREPEND(PinnedIndexBlocks::Load(this, posidx_root(), &posidx_pinned_),
+                        Substitute("couldn't read positional index of cfile $0", ToString()));
+
+  // The pinned blocks have been allocated; memory consumption has changed.
+  mem_consumption_.Reset(memory_footprint());
+  return Status::OK();
+}
+
+Status CFileReader::PinValIdxBlocksOnce() {
+  RETURN_NOT_OK_PREPEND(PinnedIndexBlocks::Load(this, validx_root(), &validx_pinned_),
+                        Substitute("couldn't read value index of cfile $0", ToString()));
+
+  // The pinned blocks have been allocated; memory consumption has changed.
+  mem_consumption_.Reset(memory_footprint());
+  return Status::OK();
+}
+
 Status CFileReader::ReadAndParseHeader() {
   TRACE_EVENT1("io", "CFileReader::ReadAndParseHeader",
                "cfile", ToString());
@@ -321,6 +420,28 @@ class ScratchMemory {
   int size_;
   DISALLOW_COPY_AND_ASSIGN(ScratchMemory);
 };
+
+// Process-wide pool on which CFileIterators issue readahead reads.
+class ReadaheadPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<ReadaheadPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<ReadaheadPool>;
+
+  ReadaheadPool() {
+    CHECK_OK(ThreadPoolBuilder("cfile-readahead")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_cfile_readahead_threads)
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReadaheadPool);
+};
 } // anonymous namespace
 
 Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
@@ -330,18 +451,37 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
         ptr.offset() + ptr.size() < file_size_) <<
     "bad offset " << ptr.ToString() << " in file of size "
                   << file_size_;
+  if (LookupBlock(ptr, cache_control, ret)) {
+    return Status::OK();
+  }
+  return ReadUncachedBlock(ptr, cache_control, nullptr, ret);
+}
+
+bool CFileReader::LookupBlock(const BlockPointer& ptr, CacheControl cache_control,
+                              BlockHandle* ret) const {
   BlockCacheHandle bc_handle;
   Cache::CacheBehavior cache_behavior = cache_control == CACHE_BLOCK ?
       Cache::EXPECT_IN_CACHE : Cache::NO_EXPECT_IN_CACHE;
   BlockCache* cache = BlockCache::GetSingleton();
   BlockCache::CacheKey key(block_->id(), ptr.offset());
-  if (cache->Lookup(key, cache_behavior, &bc_handle)) {
-    TRACE_COUNTER_INCREMENT("cfile_cache_hit", 1);
-    TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
-    *ret = BlockHandle::WithDataFromCache(&bc_handle);
-    // Cache hit
-    return Status::OK();
+  if (!cache->Lookup(key, cache_behavior, &bc_handle)) {
+    return false;
   }
+  TRACE_COUNTER_INCREMENT("cfile_cache_hit", 1);
+  TRACE_COUNTER_INCREMENT(CFILE_CACHE_HIT_BYTES_METRIC_NAME, ptr.size());
+  if (cache_control == CACHE_BLOCK) {
+    cache->RecordHotBlock(key, ptr.size());
+  }
+  *ret = BlockHandle::WithDataFromCache(&bc_handle);
+  return true;
+}
+
+Status CFileReader::ReadUncachedBlock(const BlockPointer& ptr, CacheControl cache_control,
+                                      const Slice* prefetched, BlockHandle* ret) const {
+  DCHECK(init_once_.initted());
+  BlockCacheHandle bc_handle;
+  BlockCache* cache = BlockCache::GetSingleton();
+  BlockCache::CacheKey key(block_->id(), ptr.offset());
 
   // Cache miss: need to read ourselves.
   // We issue trace events only in the cache miss case since we expect the
@@ -353,20 +493,39 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
   TRACE_COUNTER_INCREMENT(CFILE_CACHE_MISS_BYTES_METRIC_NAME, ptr.size());
 
   ScratchMemory scratch;
-  // If we are reading uncompressed data and plan to cache the result,
-  // then we should allocate our scratch memory directly from the cache.
-  // This avoids an extra memory copy in the case of an NVM cache.
-  if (codec_ == nullptr && cache_control == CACHE_BLOCK) {
-    scratch.TryAllocateFromCache(cache, key, ptr.size());
+  Slice block;
+
+  // A compressed block may still be cached in its on-disk form, in which
+  // case it only needs to be decompressed.
+  BlockCacheHandle compressed_handle;
+  bool use_compressed_tier = codec_ != nullptr && cache_control == CACHE_BLOCK &&
+      cache->has_compressed_tier();
+  if (use_compressed_tier && cache->LookupCompressed(key, &compressed_handle)) {
+    TRACE_COUNTER_INCREMENT("cfile_compressed_cache_hit", 1);
+    block = compressed_handle.data();
   } else {
-    scratch.AllocateFromHeap(ptr.size());
-  }
-  uint8_t* buf = scratch.get();
+    // If we are reading uncompressed data and plan to cache the result,
+    // then we should allocate our scratch memory directly from the cache.
+    // This avoids an extra memory copy in the case of an NVM cache.
+    // A prefetched compressed block is decompressed straight out of the
+    // caller's buffer and needs no scratch memory of its own.
+    if (codec_ == nullptr && cache_control == CACHE_BLOCK) {
+      scratch.TryAllocateFromCache(cache, key, ptr.size());
+    } else if (codec_ == nullptr || prefetched == nullptr) {
+      scratch.AllocateFromHeap(ptr.size());
+    }
 
-  Slice block;
-  RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, buf));
-  if (block.size() != ptr.size()) {
-    return Status::IOError("Could not read full block length");
+    if (prefetched != nullptr) {
+      block = *prefetched;
+    } else {
+      RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, scratch.get()));
+    }
+    if (block.size() != ptr.size()) {
+      return Status::IOError("Could not read full block length");
+    }
+    if (use_compressed_tier) {
+      cache->InsertCompressed(key, block);
+    }
   }
 
   // Decompress the block
@@ -398,12 +557,15 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     }
 
     // Now that we've decompressed, we don't need to keep holding onto the original
-    // scratch buffer. Instead, we have to start holding onto our decompression
-    // output buffer.
+    // scratch buffer or compressed tier entry. Instead, we have to start holding
+    // onto our decompression output buffer.
     scratch.Swap(&decompressed_scratch);
+    if (compressed_handle.valid()) {
+      compressed_handle.Release();
+    }
 
     // Set the result block to our decompressed data.
-    block = Slice(buf, uncompressed_size);
+    block = Slice(scratch.get(), uncompressed_size);
   } else {
     // Some of the File implementations from LevelDB attempt to be tricky
     // and just return a Slice into an mmapped region (or in-memory region).
@@ -424,7 +586,7 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // if the entry could not be allocated from the block cache.
     // Since we allocate memory to include the key for the cache entry
     // we must reset the block.
-    DCHECK_EQ(block.data(), buf);
+    DCHECK_EQ(block.data(), scratch.get());
     DCHECK(!scratch.IsFromCache());
     *ret = BlockHandle::WithOwnedData(scratch.as_slice());
   }
@@ -466,6 +628,9 @@ size_t CFileReader::memory_footprint() const {
   size_t size = kudu_malloc_usable_size(this);
   size += block_->memory_footprint();
   size += init_once_.memory_footprint_excluding_this();
+  size += zone_map_once_.memory_footprint_excluding_this();
+  size += posidx_pinned_once_.memory_footprint_excluding_this();
+  size += validx_pinned_once_.memory_footprint_excluding_this();
 
   // SpaceUsed() uses sizeof() instead of malloc_usable_size() to account for
   // the size of base objects (recursively too), thus not accounting for
@@ -476,6 +641,18 @@ size_t CFileReader::memory_footprint() const {
   if (footer_) {
     size += footer_->SpaceUsed();
   }
+  if (zone_map_) {
+    size += kudu_malloc_usable_size(zone_map_.get());
+    size += zone_map_->memory_footprint_excluding_this();
+  }
+  if (posidx_pinned_) {
+    size += kudu_malloc_usable_size(posidx_pinned_.get());
+    size += posidx_pinned_->memory_footprint_excluding_this();
+  }
+  if (validx_pinned_) {
+    size += kudu_malloc_usable_size(validx_pinned_.get());
+    size += validx_pinned_->memory_footprint_excluding_this();
+  }
   return size;
 }
 
@@ -526,17 +703,51 @@ Status DefaultColumnValueIterator::FinishBatch() {
 ////////////////////////////////////////////////////////////
 // Iterator
 ////////////////////////////////////////////////////////////
+struct CFileIterator::ReadaheadBlock {
+  explicit ReadaheadBlock(const BlockPointer& ptr)
+      : ptr(ptr),
+        done(1) {
+  }
+
+  const BlockPointer ptr;
+
+  // Valid only once 'done' has counted down. If 'status' is not OK, the
+  // block must be re-read synchronously.
+  BlockHandle data;
+  Status status;
+  CountDownLatch done;
+
+  // For a block read asynchronously: the buffer and request for its on-disk
+  // contents, which are decoded only when the iterator reaches the block.
+  // 'raw' is NULL otherwise.
+  gscoped_ptr<uint8_t[]> raw;
+  AsyncReadRequest read;
+};
+
 CFileIterator::CFileIterator(CFileReader* reader,
                              CFileReader::CacheControl cache_control)
   : reader_(reader),
+    zone_map_(nullptr),
+    zone_map_checked_(false),
     seeked_(nullptr),
     prepared_(false),
     cache_control_(cache_control),
     last_prepare_idx_(-1),
-    last_prepare_count_(-1) {
+    last_prepare_count_(-1),
+    readahead_depth_(0),
+    sequential_blocks_(0),
+    async_readahead_(true) {
 }
 
 CFileIterator::~CFileIterator() {
+  // In-flight readahead references the reader and our queue entries, so it
+  // must finish before we go away.
+  ResetReadahead();
+}
+
+void CFileIterator::set_readahead_depth(int depth) {
+  DCHECK_GE(depth, 0);
+  readahead_depth_ = std::min(depth, std::max(FLAGS_cfile_max_readahead_blocks, 0));
 }
 
 Status CFileIterator::SeekToOrdinal(rowid_t ord_idx) {
@@ -584,7 +795,11 @@ void CFileIterator::SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_blo
   // we need to translate from 'ord_idx' (the absolute row id)
   // to the index within the non-null entries.
   uint32_t index_within_nonnulls;
-  if (reader_->is_nullable()) {
+  if (pb->no_nulls_) {
+    index_within_nonnulls = idx_in_block;
+  } else if (pb->all_nulls_) {
+    index_within_nonnulls = 0;
+  } else if (reader_->is_nullable()) {
     if (PREDICT_TRUE(pb->idx_in_block_ <= idx_in_block)) {
       // We are seeking forward. Skip from the current position in the RLE decoder
       // instead of going back to the beginning of the block.
@@ -703,24 +918,27 @@ Status CFileIterator::PrepareForNewSeek() {
   // Create the index tree iterators if we haven't already done so.
   if (!posidx_iter_ && reader_->footer().has_posidx_info()) {
     BlockPointer bp(reader_->footer().posidx_info().root_block());
-    posidx_iter_.reset(IndexTreeIterator::Create(reader_, bp));
+    const PinnedIndexBlocks* pinned;
+    RETURN_NOT_OK(reader_->GetPinnedPosIdxBlocks(&pinned));
+    posidx_iter_.reset(IndexTreeIterator::Create(reader_, bp,
+                                                 cache_control_ == CFileReader::CACHE_BLOCK,
+                                                 pinned));
   }
   if (!validx_iter_ && reader_->footer().has_validx_info()) {
     BlockPointer bp(reader_->footer().validx_info().root_block());
-    validx_iter_.reset(IndexTreeIterator::Create(reader_, bp));
+    const PinnedIndexBlocks* pinned;
+    RETURN_NOT_OK(reader_->GetPinnedValIdxBlocks(&pinned));
+    validx_iter_.reset(IndexTreeIterator::Create(reader_, bp,
+                                                 cache_control_ == CFileReader::CACHE_BLOCK,
+                                                 pinned));
   }
 
-  // Initialize the decoder for the dictionary block
-  // in dictionary encoding mode.
-  if (!dict_decoder_ && reader_->footer().has_dict_block_ptr()) {
-    BlockPointer bp(reader_->footer().dict_block_ptr());
-
-    // Cache the dictionary for performance
-    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &dict_block_handle_),
-                          "Couldn't read dictionary block");
-
-    dict_decoder_.reset(new BinaryPlainBlockDecoder(dict_block_handle_.data()));
-    RETURN_NOT_OK_PREPEND(dict_decoder_->ParseHeader(), "Couldn't parse dictionary block header");
+  // Initialize the decoder for the first dictionary block
+  // in dictionary encoding mode. Any further pages are read
+  // when a data block which refers to them is first read.
+  if (dict_pages_.empty() && reader_->footer().has_dict_block_ptr()) {
+    BinaryPlainBlockDecoder* dict_decoder;
+    RETURN_NOT_OK(GetDictDecoder(0, &dict_decoder));
   }
 
   seeked_ = nullptr;
@@ -728,6 +946,7 @@ Status CFileIterator::PrepareForNewSeek() {
     prepared_block_pool_.Destroy(pb);
   }
   prepared_blocks_.clear();
+  ResetReadahead();
 
   return Status::OK();
 }
@@ -760,13 +979,68 @@ Status DecodeNullInfo(Slice *data_block, uint32_t *num_rows_in_block, Slice *nul
   return Status::OK();
 }
 
+Status CFileIterator::GetDictDecoder(uint32_t page_idx, BinaryPlainBlockDecoder** decoder) {
+  const CFileFooterPB& footer = reader_->footer();
+  if (PREDICT_FALSE(!footer.has_dict_block_ptr() ||
+                    page_idx > footer.extra_dict_block_ptrs_size())) {
+    return Status::Corruption(Substitute("no dictionary page $0 in cfile", page_idx));
+  }
+  if (page_idx >= dict_pages_.size()) {
+    dict_pages_.resize(footer.extra_dict_block_ptrs_size() + 1);
+  }
+  std::unique_ptr<DictPage>& page = dict_pages_[page_idx];
+  if (!page) {
+    BlockPointer bp(page_idx == 0 ? footer.dict_block_ptr() :
+                                    footer.extra_dict_block_ptrs(page_idx - 1));
+
+    // Cache the dictionary for performance
+    std::unique_ptr<DictPage> new_page(new DictPage());
+    new_page->handle = std::make_shared<BlockHandle>();
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK,
+                                             new_page->handle.get()),
+                          "Couldn't read dictionary block");
+
+    new_page->decoder.reset(new BinaryPlainBlockDecoder(new_page->handle->data()));
+    RETURN_NOT_OK_PREPEND(new_page->decoder->ParseHeader(),
+                          "Couldn't parse dictionary block header");
+    page = std::move(new_page);
+  }
+  *decoder = page->decoder.get();
+  return Status::OK();
+}
+
+SelectionVector* CFileIterator::GetCodeWordsMatchingPredicate(uint32_t page_idx,
+                                                              const ColumnPredicate& pred) {
+  DCHECK_LT(page_idx, dict_pages_.size());
+  DictPage* page = dict_pages_[page_idx].get();
+  DCHECK(page);
+  if (!page->codewords_matching_pred) {
+    size_t nwords = page->decoder->Count();
+    page->codewords_matching_pred.reset(new SelectionVector(nwords));
+    page->codewords_matching_pred->SetAllFalse();
+    for (size_t i = 0; i < nwords; i++) {
+      Slice cur_string = page->decoder->string_at_index(i);
+      if (pred.EvaluateCell<BINARY>(static_cast<const void *>(&cur_string))) {
+        BitmapSet(page->codewords_matching_pred->mutable_bitmap(), i);
+      }
+    }
+  }
+  return page->codewords_matching_pred.get();
+}
+
 Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                                            PreparedBlock *prep_block) {
   prep_block->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
-  RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_, &prep_block->dblk_data_));
+  prep_block->zone_map_entry_ = nullptr;
+  return LoadDataBlock(prep_block);
+}
+
+Status CFileIterator::LoadDataBlock(PreparedBlock *prep_block) {
+  prep_block->dblk_data_ = std::make_shared<BlockHandle>();
+  RETURN_NOT_OK(ReadDataBlock(prep_block->dblk_ptr_, prep_block->dblk_data_.get()));
 
   uint32_t num_rows_in_block = 0;
-  Slice data_block = prep_block->dblk_data_.data();
+  Slice data_block = prep_block->dblk_data_->data();
   if (reader_->is_nullable()) {
     RETURN_NOT_OK(DecodeNullInfo(&data_block, &num_rows_in_block, &(prep_block->rle_bitmap)));
     prep_block->rle_decoder_ = RleDecoder<bool>(prep_block->rle_bitmap.data(),
@@ -784,6 +1058,7 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
   if (!reader_->is_nullable()) {
     num_rows_in_block = bd->Count();
   }
+  prep_block->first_row_idx_ = bd->GetFirstRowId();
 
   io_stats_.cells_read_from_disk += num_rows_in_block;
   io_stats_.data_blocks_read_from_disk++;
@@ -794,18 +1069,240 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
   prep_block->needs_rewind_ = false;
   prep_block->rewind_idx_ = 0;
 
+  // The data block only holds the non-null values, so comparing their count
+  // with the number of rows tells whether the null bitmap is uniform.
+  prep_block->no_nulls_ = reader_->is_nullable() && bd->Count() == num_rows_in_block;
+  prep_block->all_nulls_ = reader_->is_nullable() && bd->Count() == 0 && num_rows_in_block > 0;
+
   DVLOG(2) << "Read dblk " << prep_block->ToString();
   return Status::OK();
 }
 
+Status CFileIterator::ReadDataBlock(const BlockPointer& ptr, BlockHandle* ret) {
+  while (!readahead_blocks_.empty()) {
+    shared_ptr<ReadaheadBlock> rb = readahead_blocks_.front();
+    if (rb->ptr.offset() > ptr.offset()) {
+      // Everything left in the queue lies beyond the requested block.
+      break;
+    }
+    readahead_blocks_.pop_front();
+    rb->done.Wait();
+    if (rb->ptr.offset() != ptr.offset()) {
+      continue;
+    }
+    if (rb->raw) {
+      if (rb->read.status.ok() &&
+          reader_->ReadUncachedBlock(ptr, cache_control_, &rb->read.result, ret).ok()) {
+        return Status::OK();
+      }
+    } else if (rb->status.ok()) {
+      *ret = std::move(rb->data);
+      return Status::OK();
+    }
+    // Either a stale entry, or the readahead failed. In the latter case we
+    // fall through to a synchronous read so that any error is surfaced here.
+  }
+  return reader_->ReadBlock(ptr, cache_control_, ret);
+}
+
+Status CFileIterator::IssueReadahead() {
+  if (readahead_depth_ == 0 || sequential_blocks_ < kReadaheadTriggerBlocks) {
+    return Status::OK();
+  }
+
+  if (!readahead_iter_) {
+    BlockPointer root;
+    const PinnedIndexBlocks* pinned;
+    if (seeked_ == posidx_iter_.get()) {
+      root = reader_->posidx_root();
+      RETURN_NOT_OK(reader_->GetPinnedPosIdxBlocks(&pinned));
+    } else {
+      root = reader_->validx_root();
+      RETURN_NOT_OK(reader_->GetPinnedValIdxBlocks(&pinned));
+    }
+    readahead_iter_.reset(IndexTreeIterator::Create(reader_, root,
+                                                    cache_control_ == CFileReader::CACHE_BLOCK,
+                                                    pinned));
+    RETURN_NOT_OK(readahead_iter_->SeekAtOrBefore(seeked_->GetCurrentKey()));
+  }
+
+  vector<shared_ptr<ReadaheadBlock>> issued;
+  while (static_cast<int>(readahead_blocks_.size()) < readahead_depth_ &&
+         readahead_iter_->HasNext()) {
+    RETURN_NOT_OK(readahead_iter_->Next());
+    shared_ptr<ReadaheadBlock> rb(
+        new ReadaheadBlock(readahead_iter_->GetCurrentBlockPointer()));
+    TRACE_COUNTER_INCREMENT("cfile_readahead_issued", 1);
+    readahead_blocks_.push_back(rb);
+    issued.push_back(std::move(rb));
+  }
+  if (!issued.empty()) {
+    StartReadahead(issued);
+  }
+  return Status::OK();
+}
+
+void CFileIterator::StartReadahead(const vector<shared_ptr<ReadaheadBlock>>& blocks) {
+  vector<shared_ptr<ReadaheadBlock>> to_pool;
+  if (async_readahead_) {
+    // Blocks which are already cached need no I/O at all; the rest are
+    // submitted as a single batch of asynchronous reads. The queue keeps
+    // each ReadaheadBlock alive until its read has completed.
+    vector<AsyncReadRequest*> requests;
+    for (const auto& rb : blocks) {
+      if (reader_->LookupBlock(rb->ptr, cache_control_, &rb->data)) {
+        rb->done.CountDown();
+        continue;
+      }
+      rb->raw.reset(new uint8_t[rb->ptr.size()]);
+      rb->read.offset = rb->ptr.offset();
+      rb->read.length = rb->ptr.size();
+      rb->read.scratch = rb->raw.get();
+      ReadaheadBlock* raw_rb = rb.get();
+      rb->read.callback = [raw_rb]() { raw_rb->done.CountDown(); };
+      requests.push_back(&rb->read);
+      to_pool.push_back(rb);
+    }
+    if (requests.empty()) {
+      return;
+    }
+    Status s = reader_->SubmitReads(requests);
+    if (s.ok()) {
+      TRACE_COUNTER_INCREMENT("cfile_readahead_async", requests.size());
+      return;
+    }
+    if (s.IsNotSupported()) {
+      async_readahead_ = false;
+    } else {
+      KLOG_EVERY_N(WARNING, 100) << "Unable to submit asynchronous readahead for "
+                                 << reader_->ToString() << ": " << s.ToString();
+    }
+    for (const auto& rb : to_pool) {
+      rb->raw.reset();
+      rb->read.callback = nullptr;
+    }
+  } else {
+    to_pool = blocks;
+  }
+
+  ThreadPool* pool = ReadaheadPool::Get();
+  for (const auto& rb : to_pool) {
+    const CFileReader* reader = reader_;
+    CFileReader::CacheControl cache_control = cache_control_;
+    Status s = pool->SubmitFunc([reader, cache_control, rb]() {
+        rb->status = reader->ReadBlock(rb->ptr, cache_control, &rb->data);
+        rb->done.CountDown();
+      });
+    if (PREDICT_FALSE(!s.ok())) {
+      // The block will simply be read synchronously when it is needed.
+      rb->status = s;
+      rb->done.CountDown();
+    }
+  }
+}
+
+void CFileIterator::ResetReadahead() {
+  for (const auto& rb : readahead_blocks_) {
+    rb->done.Wait();
+  }
+  readahead_blocks_.clear();
+  readahead_iter_.reset();
+  sequential_blocks_ = 0;
+}
+
 Status CFileIterator::QueueCurrentDataBlock(const IndexTreeIterator &idx_iter) {
   pblock_pool_scoped_ptr b = prepared_block_pool_.make_scoped_ptr(
     prepared_block_pool_.Construct());
-  RETURN_NOT_OK(ReadCurrentDataBlock(idx_iter, b.get()));
+
+  // Blocks located through the positional index are keyed by their first
+  // ordinal, which identifies their zone map entry.
+  const ZoneMapEntryPB* entry = nullptr;
+  if (&idx_iter == posidx_iter_.get()) {
+    if (!zone_map_checked_) {
+      if (reader_->has_zone_map()) {
+        RETURN_NOT_OK(reader_->GetZoneMap(&zone_map_));
+      }
+      zone_map_checked_ = true;
+    }
+    if (zone_map_ != nullptr) {
+      typedef KeyEncoderTraits<UINT32, faststring> OrdinalKeyTraits;
+      Slice key = idx_iter.GetCurrentKey();
+      rowid_t first_row_idx;
+      RETURN_NOT_OK(OrdinalKeyTraits::DecodeKeyPortion(
+          &key, true, nullptr, reinterpret_cast<uint8_t*>(&first_row_idx)));
+      entry = zone_map_->FindEntry(first_row_idx);
+    }
+  }
+
+  if (entry != nullptr) {
+    // Defer the read to Scan(), which may be able to skip the block.
+    b->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
+    b->dblk_.reset();
+    b->zone_map_entry_ = entry;
+    b->first_row_idx_ = entry->first_ordinal();
+    b->num_rows_in_block_ = entry->num_rows();
+    b->idx_in_block_ = 0;
+    b->needs_rewind_ = false;
+    b->rewind_idx_ = 0;
+  } else {
+    RETURN_NOT_OK(ReadCurrentDataBlock(idx_iter, b.get()));
+  }
   prepared_blocks_.push_back(b.release());
   return Status::OK();
 }
 
+Status CFileIterator::LoadQueuedDataBlock(PreparedBlock *prep_block) {
+  DCHECK(!prep_block->loaded());
+  const ZoneMapEntryPB* entry = DCHECK_NOTNULL(prep_block->zone_map_entry_);
+  uint32_t start_idx = prep_block->needs_rewind_ ? prep_block->rewind_idx_
+                                                 : prep_block->idx_in_block_;
+  RETURN_NOT_OK(LoadDataBlock(prep_block));
+  if (PREDICT_FALSE(prep_block->first_row_idx() != entry->first_ordinal() ||
+                    prep_block->num_rows_in_block_ != entry->num_rows())) {
+    return Status::Corruption(
+        Substitute("data block $0 does not match its zone map entry (rows $1-$2)",
+                   prep_block->ToString(), entry->first_ordinal(),
+                   entry->first_ordinal() + entry->num_rows() - 1));
+  }
+
+  // Have Scan() seek to the row it would have started from.
+  prep_block->needs_rewind_ = true;
+  prep_block->rewind_idx_ = start_idx;
+  return Status::OK();
+}
+
+bool CFileIterator::MaybeSkipBlock(PreparedBlock* pb,
+                                   ColumnMaterializationContext* ctx,
+                                   size_t nrows,
+                                   ColumnDataView* dst,
+                                   SelectionVectorView* sel) {
+  DCHECK(!pb->loaded());
+  if (zone_map_->MayMatch(*pb->zone_map_entry_, *ctx->pred())) {
+    return false;
+  }
+
+  // No row in the block can pass the predicate, so deselect the rows instead
+  // of reading them.
+  SkipUnloadedRows(ctx, nrows, dst, sel);
+  TRACE_COUNTER_INCREMENT("cfile_zone_map_blocks_skipped", 1);
+  return true;
+}
+
+void CFileIterator::SkipUnloadedRows(ColumnMaterializationContext* ctx,
+                                     size_t nrows,
+                                     ColumnDataView* dst,
+                                     SelectionVectorView* sel) {
+  // The cells are zeroed so that they still hold valid values for the
+  // column type.
+  sel->ClearBits(nrows);
+  memset(dst->data(), 0, dst->stride() * nrows);
+  if (ctx->block()->is_nullable()) {
+    dst->SetNullBits(nrows, false);
+  }
+  dst->Advance(nrows);
+  sel->Advance(nrows);
+}
+
 bool CFileIterator::HasNext() const {
   CHECK(seeked_) << "not seeked";
   CHECK(!prepared_) << "Cannot call HasNext() mid-batch";
@@ -832,6 +1329,8 @@ Status CFileIterator::PrepareBatch(size_t *n) {
     } else if (!s.ok()) {
       return s;
     }
+    sequential_blocks_++;
+    RETURN_NOT_OK(IssueReadahead());
     RETURN_NOT_OK(QueueCurrentDataBlock(*seeked_));
   }
 
@@ -915,22 +1414,45 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
   uint32_t rem = last_prepare_count_;
   DCHECK_LE(rem, ctx->block()->nrows());
 
-  // Determine the matching codewords for dictionary encoding if they haven't
-  // yet been determined for this CFile.
-  if (dict_decoder_ && ctx->DecoderEvalNotDisabled() && !codewords_matching_pred_) {
-    size_t nwords = dict_decoder_->Count();
-    if (nwords > 0) {
-      codewords_matching_pred_.reset(new SelectionVector(nwords));
-      codewords_matching_pred_->SetAllFalse();
-      for (size_t i = 0; i < nwords; i++) {
-        Slice cur_string = dict_decoder_->string_at_index(i);
-        if (ctx->pred()->EvaluateCell<BINARY>(static_cast<const void *>(&cur_string))) {
-          BitmapSet(codewords_matching_pred_->mutable_bitmap(), i);
+  // Binary values may be left pointing into the data blocks (and the
+  // dictionary), which the output arena then keeps alive until it is reset,
+  // instead of copying each value into the arena.
+  Arena* out_arena = ctx->block()->arena();
+  const bool reference_values = FLAGS_cfile_zero_copy_binary_scans &&
+      out_arena != nullptr &&
+      reader_->type_info()->physical_type() == BINARY;
+  // Blocks may be skipped using the zone map whenever the predicate is
+  // pushed down to the decoders. This is decided up front: a decoder which
+  // does not support evaluation disables it for the rest of the batch, but
+  // the rows deselected by skipping remain correctly deselected.
+  const bool can_skip_blocks = ctx->DecoderEvalNotDisabled();
+  // Likewise, blocks need not be read at all if the caller does not need
+  // their rows because earlier predicates deselected them all.
+  const bool can_skip_deselected = ctx->skip_deselected_rows();
+  for (PreparedBlock *pb : prepared_blocks_) {
+    if (!pb->loaded()) {
+      uint32_t start_idx = pb->needs_rewind_ ? pb->rewind_idx_ : pb->idx_in_block_;
+      size_t nrows = std::min(rem, pb->num_rows_in_block_ - start_idx);
+      bool skipped = false;
+      if (can_skip_deselected && !remaining_sel.AnySelected(nrows)) {
+        SkipUnloadedRows(ctx, nrows, &remaining_dst, &remaining_sel);
+        TRACE_COUNTER_INCREMENT("cfile_deselected_blocks_skipped", 1);
+        skipped = true;
+      } else if (can_skip_blocks) {
+        skipped = MaybeSkipBlock(pb, ctx, nrows, &remaining_dst, &remaining_sel);
+      }
+      if (skipped) {
+        rem -= nrows;
+        if (rem == 0) {
+          break;
         }
+        continue;
       }
+      RETURN_NOT_OK(LoadQueuedDataBlock(pb));
+    }
+    if (reference_values) {
+      out_arena->RetainUntilReset(pb->dblk_data_);
     }
-  }
-  for (PreparedBlock *pb : prepared_blocks_) {
     if (pb->needs_rewind_) {
       // Seek back to the saved position.
       SeekToPositionInBlock(pb, pb->rewind_idx_);
@@ -938,7 +1460,26 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
       // that might be more efficient (allowing the decoder to save internal state
       // instead of having to reconstruct it)
     }
-    if (reader_->is_nullable()) {
+    if (pb->all_nulls_) {
+      DCHECK(ctx->block()->is_nullable());
+
+      // None of the rows have values to read or evaluate.
+      size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
+#ifndef NDEBUG
+      kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst.data()),
+                                 remaining_dst.stride() * nrows,
+                                 "NULLNULLNULLNULLNULL");
+#endif
+      if (ctx->DecoderEvalNotDisabled()) {
+        remaining_sel.ClearBits(nrows);
+      }
+      remaining_dst.SetNullBits(nrows, false);
+
+      rem -= nrows;
+      pb->idx_in_block_ += nrows;
+      remaining_dst.Advance(nrows);
+      remaining_sel.Advance(nrows);
+    } else if (reader_->is_nullable() && !pb->no_nulls_) {
       DCHECK(ctx->block()->is_nullable());
 
       size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
@@ -961,7 +1502,9 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
                                                      &remaining_sel,
                                                      &remaining_dst));
           } else {
-            RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
+            RETURN_NOT_OK(reference_values ?
+                          pb->dblk_->ReferenceNextValues(&this_batch, &remaining_dst) :
+                          pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
           }
           DCHECK_EQ(nblock, this_batch);
           pb->needs_rewind_ = true;
@@ -989,10 +1532,20 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
       // Fetch as many as we can from the current datablock.
       size_t this_batch = rem;
 
-      if (ctx->DecoderEvalNotDisabled()) {
+      if (ctx->DecoderEvalNotDisabled() &&
+          ctx->pred()->predicate_type() == PredicateType::IsNotNull) {
+        // Every row of the block matches, so the values need only be copied.
+        // This leaves the evaluation status alone: the rows are correctly
+        // selected whether or not the predicate is evaluated again later.
+        RETURN_NOT_OK(reference_values ?
+                      pb->dblk_->ReferenceNextValues(&this_batch, &remaining_dst) :
+                      pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
+      } else if (ctx->DecoderEvalNotDisabled()) {
         RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, &remaining_sel, &remaining_dst));
       } else {
-        RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
+        RETURN_NOT_OK(reference_values ?
+                      pb->dblk_->ReferenceNextValues(&this_batch, &remaining_dst) :
+                      pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
       }
       pb->needs_rewind_ = true;
       DCHECK_LE(this_batch, rem);
@@ -1019,6 +1572,16 @@ Status CFileIterator::Scan(ColumnMaterializationContext* ctx) {
   }
 
   DCHECK_EQ(rem, 0) << "Should have fetched exactly the number of prepared rows";
+
+  // Retain the dictionary pages, including any read while loading the blocks
+  // above.
+  if (reference_values) {
+    for (const auto& page : dict_pages_) {
+      if (page) {
+        out_arena->RetainUntilReset(page->handle);
+      }
+    }
+  }
   return Status::OK();
 }
 
@@ -18,6 +18,8 @@
 #ifndef KUDU_CFILE_CFILE_READER_H
 #define KUDU_CFILE_CFILE_READER_H
 
+#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -30,6 +32,7 @@
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -99,6 +102,22 @@ class CFileReader {
   Status ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
                    BlockHandle *ret) const;
 
+  // The two halves of ReadBlock(), for readers which issue their own I/O.
+  //
+  // LookupBlock() returns true and sets 'ret' if the block is in the block
+  // cache. ReadUncachedBlock() reads the block from disk, or, if
+  // 'prefetched' is not NULL, from its on-disk contents read beforehand.
+  bool LookupBlock(const BlockPointer& ptr, CacheControl cache_control,
+                   BlockHandle* ret) const;
+  Status ReadUncachedBlock(const BlockPointer& ptr, CacheControl cache_control,
+                           const Slice* prefetched, BlockHandle* ret) const;
+
+  // Submit asynchronous reads of ranges of the underlying block.
+  // See fs::ReadableBlock::SubmitReads().
+  Status SubmitReads(const std::vector<AsyncReadRequest*>& requests) const {
+    return block_->SubmitReads(requests);
+  }
+
   // Return the number of rows in this cfile.
   // This is assumed to be reasonably fast (i.e does not scan
   // the data)
@@ -167,6 +186,21 @@ class CFileReader {
     return BlockPointer(footer().validx_info().root_block());
   }
 
+  // Return true if there is a zone map summarizing the data blocks of this
+  // file.
+  bool has_zone_map() const { return footer().has_zone_map_block_ptr(); }
+
+  // Return the zone map of this file in '*zone_map', reading it on first use.
+  // The zone map is owned by the reader. Requires has_zone_map().
+  Status GetZoneMap(const ZoneMap** zone_map);
+
+  // Return the pinned internal blocks of this file's positional or value
+  // index in '*pinned', reading them on first use. The blocks are owned by
+  // the reader. Sets '*pinned' to NULL if pinning is disabled by
+  // --cfile_pin_internal_index_blocks.
+  Status GetPinnedPosIdxBlocks(const PinnedIndexBlocks** pinned);
+  Status GetPinnedValIdxBlocks(const PinnedIndexBlocks** pinned);
+
   // Can be called before Init().
   std::string ToString() const { return block_->id().ToString(); }
 
@@ -184,6 +218,14 @@ class CFileReader {
   Status ReadAndParseHeader();
   Status ReadAndParseFooter();
 
+  // Callback used in 'zone_map_once_' to read and parse the zone map.
+  Status ReadZoneMapOnce();
+
+  // Callbacks used in 'posidx_pinned_once_' and 'validx_pinned_once_' to
+  // read the internal index blocks.
+  Status PinPosIdxBlocksOnce();
+  Status PinValIdxBlocksOnce();
+
   // Returns the memory usage of the object including the object itself.
   size_t memory_footprint() const;
 
@@ -203,6 +245,14 @@ class CFileReader {
 
   KuduOnceDynamic init_once_;
 
+  gscoped_ptr<ZoneMap> zone_map_;
+  KuduOnceDynamic zone_map_once_;
+
+  gscoped_ptr<PinnedIndexBlocks> posidx_pinned_;
+  KuduOnceDynamic posidx_pinned_once_;
+  gscoped_ptr<PinnedIndexBlocks> validx_pinned_;
+  KuduOnceDynamic validx_pinned_once_;
+
   ScopedTrackedConsumption mem_consumption_;
 };
 
@@ -372,30 +422,57 @@ class CFileIterator : public ColumnIterator {
     return io_stats_;
   }
 
-  // If the column is dictionary-coded, returns the decoder
-  // for the cfile's dictionary block. This is called by the
-  // BinaryDictBlockDecoder.
-  BinaryPlainBlockDecoder* GetDictDecoder() { return dict_decoder_.get(); }
+  // Enable asynchronous readahead of up to 'depth' data blocks, or of
+  // --cfile_max_readahead_blocks if that's smaller. Readahead starts once the
+  // iterator has advanced sequentially through a few blocks without seeking,
+  // so point lookups are unaffected. A depth of 0 (the default) disables
+  // readahead.
+  //
+  // Should be called before the iterator is first seeked.
+  void set_readahead_depth(int depth);
+
+  int readahead_depth() const {
+    return readahead_depth_;
+  }
+
+  // If the column is dictionary-coded, sets 'decoder' to the decoder
+  // for the given page of the cfile's dictionary, reading the page if
+  // it hasn't been read yet. This is called by the BinaryDictBlockDecoder.
+  Status GetDictDecoder(uint32_t page_idx, BinaryPlainBlockDecoder** decoder);
 
-  // If the column is dictionary-coded and a predicate on the column exists,
-  // returns the set of codewords that pass the predicate. Since a vocabulary
-  // is shared among the multiple BinaryDictBlockDecoders in a single cfile,
-  // the reader must expose an interface for all decoders to access the
-  // single set of predicate-satisfying codewords.
-  SelectionVector* GetCodeWordsMatchingPredicate() { return codewords_matching_pred_.get(); }
+  // If the column is dictionary-coded, returns the set of codewords of the
+  // given, already read, dictionary page that pass 'pred', computing it on
+  // first use. Since a vocabulary is shared among the multiple
+  // BinaryDictBlockDecoders of a page, the reader must expose an interface
+  // for all decoders to access the single set of predicate-satisfying
+  // codewords.
+  SelectionVector* GetCodeWordsMatchingPredicate(uint32_t page_idx,
+                                                 const ColumnPredicate& pred);
 
  private:
   DISALLOW_COPY_AND_ASSIGN(CFileIterator);
 
   struct PreparedBlock {
     BlockPointer dblk_ptr_;
-    BlockHandle dblk_data_;
+    // Shared so that scans may keep the data alive in their output arena
+    // (see Scan()).
+    std::shared_ptr<BlockHandle> dblk_data_;
     gscoped_ptr<BlockDecoder> dblk_;
 
+    // The zone map entry for this block, if it was queued without being read
+    // (see QueueCurrentDataBlock()). Such a block is read on first use by
+    // Scan(), which may instead skip it altogether if the entry shows that
+    // none of its rows can match the predicate being evaluated.
+    const ZoneMapEntryPB* zone_map_entry_;
+
+    // Return true if the block's data has been read and dblk_ is valid.
+    bool loaded() const { return dblk_ != nullptr; }
+
     // The rowid of the first row in this block.
     rowid_t first_row_idx() const {
-      return dblk_->GetFirstRowId();
+      return first_row_idx_;
     }
+    rowid_t first_row_idx_;
 
     // The index of the seeked position, relative to the start of the block.
     // In case of null bitmap present, dblk_->GetCurrentIndex() is not aligned
@@ -420,6 +497,12 @@ class CFileIterator : public ColumnIterator {
     Slice rle_bitmap;
     RleDecoder<bool> rle_decoder_;
 
+    // Whether the block of a nullable column has no nulls, or only nulls,
+    // as is common for sparse columns. The null bitmap of such a block is
+    // never decoded, and the values of an all-null block are never read.
+    bool no_nulls_;
+    bool all_nulls_;
+
     rowid_t last_row_idx() const {
       return first_row_idx() + num_rows_in_block_ - 1;
     }
@@ -437,25 +520,84 @@ class CFileIterator : public ColumnIterator {
   Status ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                               PreparedBlock *prep_block);
 
-  // Read the data block currently pointed to by idx_iter_, and enqueue
-  // it onto the end of the prepared_blocks_ deque.
+  // Read and parse the data block pointed to by prep_block->dblk_ptr_.
+  Status LoadDataBlock(PreparedBlock *prep_block);
+
+  // Enqueue the data block currently pointed to by idx_iter_ onto the end
+  // of the prepared_blocks_ deque. If the block is covered by the file's
+  // zone map, it is queued unloaded; otherwise it is read immediately.
   Status QueueCurrentDataBlock(const IndexTreeIterator &idx_iter);
 
+  // Read an unloaded block during Scan(), positioning it at the row from
+  // which the scan should continue.
+  Status LoadQueuedDataBlock(PreparedBlock *prep_block);
+
+  // Try to skip the 'nrows' rows of the unloaded block 'pb' that fall in the
+  // current batch, using its zone map entry and the predicate from 'ctx'.
+  // Returns true and advances 'dst' and 'sel' past those rows if the block
+  // cannot match; returns false without side effects otherwise.
+  bool MaybeSkipBlock(PreparedBlock* pb,
+                      ColumnMaterializationContext* ctx,
+                      size_t nrows,
+                      ColumnDataView* dst,
+                      SelectionVectorView* sel);
+
+  // Advance 'dst' and 'sel' past the 'nrows' rows of an unloaded block that
+  // fall in the current batch without reading the block, deselecting the
+  // rows and zeroing their cells.
+  void SkipUnloadedRows(ColumnMaterializationContext* ctx,
+                        size_t nrows,
+                        ColumnDataView* dst,
+                        SelectionVectorView* sel);
+
   // Fully initialize the underlying cfile reader if needed, and clear any
   // seek-related state.
   Status PrepareForNewSeek();
 
+  // A data block read issued in the background ahead of the iterator.
+  struct ReadaheadBlock;
+
+  // Read the data block at 'ptr' into 'ret', taking it from the readahead
+  // queue if it was read ahead. Readahead entries preceding 'ptr' are
+  // discarded.
+  Status ReadDataBlock(const BlockPointer& ptr, BlockHandle* ret);
+
+  // If the access pattern is sequential, top up the readahead queue with
+  // background reads of the data blocks following the one at which seeked_
+  // is positioned.
+  Status IssueReadahead();
+
+  // Start reading 'blocks', which were just added to the readahead queue:
+  // asynchronously if the underlying block supports it, and otherwise on
+  // the readahead thread pool.
+  void StartReadahead(const std::vector<std::shared_ptr<ReadaheadBlock>>& blocks);
+
+  // Wait for any in-flight readahead to complete and discard it.
+  void ResetReadahead();
+
   CFileReader* reader_;
 
+  // The reader's zone map, once it has been loaded, or NULL if the file has
+  // none. Set lazily on the first sequential advance past a seeked block, so
+  // point lookups never read it.
+  const ZoneMap* zone_map_;
+  bool zone_map_checked_;
+
   gscoped_ptr<IndexTreeIterator> posidx_iter_;
   gscoped_ptr<IndexTreeIterator> validx_iter_;
 
-  // Decoder for the dictionary block.
-  gscoped_ptr<BinaryPlainBlockDecoder> dict_decoder_;
-  BlockHandle dict_block_handle_;
+  // A page of the dictionary, in dictionary encoding mode.
+  struct DictPage {
+    std::shared_ptr<BlockHandle> handle;
+    gscoped_ptr<BinaryPlainBlockDecoder> decoder;
+
+    // Set containing the codewords of the page that match the predicate.
+    std::unique_ptr<SelectionVector> codewords_matching_pred;
+  };
 
-  // Set containing the codewords that match the predicate in a dictionary.
-  std::unique_ptr<SelectionVector> codewords_matching_pred_;
+  // The pages of the dictionary, indexed by page, or NULL for pages which
+  // haven't been read yet.
+  std::vector<std::unique_ptr<DictPage>> dict_pages_;
 
   // The currently in-use index iterator. This is equal to either
   // posidx_iter_.get(), validx_iter_.get(), or NULL if not seeked.
@@ -487,6 +629,25 @@ class CFileIterator : public ColumnIterator {
 
   // a temporary buffer for encoding
   faststring tmp_buf_;
+
+  // Maximum number of data blocks to read ahead, or 0 if disabled.
+  int readahead_depth_;
+
+  // Number of data blocks fetched by advancing the index since the last
+  // seek. Readahead is only issued once this indicates a sequential scan.
+  int sequential_blocks_;
+
+  // Whether readahead is issued as asynchronous reads. Cleared if the
+  // underlying block doesn't support them.
+  bool async_readahead_;
+
+  // Index iterator positioned at the last block issued for readahead.
+  // It is advanced independently of seeked_.
+  gscoped_ptr<IndexTreeIterator> readahead_iter_;
+
+  // Blocks which have been issued for readahead, in file order. Entries are
+  // consumed by ReadDataBlock().
+  std::deque<std::shared_ptr<ReadaheadBlock>> readahead_blocks_;
 };
 
 } // namespace cfile
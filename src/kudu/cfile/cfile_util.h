@@ -26,6 +26,7 @@
 #include "kudu/common/row.h"
 #include "kudu/common/encoded_key.h"
 #include "kudu/util/bloom_filter.h"
+#include "kudu/util/key_compare.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
@@ -60,6 +61,12 @@ struct WriterOptions {
   // instead of entire keys.
   bool optimize_index_keys;
 
+  // Whether to record per-data-block min/max statistics in a zone map.
+  // Only takes effect when a positional index is also written.
+  //
+  // Default: false.
+  bool write_zone_map;
+
   // Column storage attributes.
   //
   // Default: all default values as specified in the constructor in
@@ -86,8 +93,6 @@ Status DumpIterator(const CFileReader& reader,
                     int num_rows,
                     int indent);
 
-// Return the length of the common prefix shared by the two strings.
-size_t CommonPrefixLength(const Slice& a, const Slice& b);
 
 // Truncate right to give a shortest key satisfying left <= key <= right.
 void GetSeparatingKey(const Slice& left, Slice* right);
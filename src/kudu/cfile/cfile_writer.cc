@@ -18,7 +18,9 @@
 #include "kudu/cfile/cfile_writer.h"
 
 #include <glog/logging.h>
+#include <limits>
 #include <string>
+#include <unordered_set>
 #include <utility>
 
 #include "kudu/cfile/block_pointer.h"
@@ -26,14 +28,17 @@
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/cfile/zone_map.h"
 #include "kudu/common/key_encoder.h"
 #include "kudu/gutil/endian.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/memory/arena.h"
 #include "kudu/util/pb_util.h"
 
 using google::protobuf::RepeatedPtrField;
@@ -66,6 +71,15 @@ DEFINE_string(cfile_do_on_finish, "flush",
               "Possible values are 'close', 'flush', or 'nothing'.");
 TAG_FLAG(cfile_do_on_finish, experimental);
 
+DEFINE_bool(cfile_adaptive_encoding, false,
+            "Whether to choose the encoding of cfiles of columns with AUTO_ENCODING "
+            "from their data. The first block's worth of values of each cfile is "
+            "buffered and encoded with each encoding supported for the type, and "
+            "the one which encodes it most compactly is used for the file, if it "
+            "is sufficiently smaller than the default encoding for the type.");
+TAG_FLAG(cfile_adaptive_encoding, experimental);
+TAG_FLAG(cfile_adaptive_encoding, runtime);
+
 namespace kudu {
 namespace cfile {
 
@@ -75,6 +89,11 @@ const int kMagicLength = 8;
 
 static const size_t kMinBlockSize = 512;
 
+// An encoding other than the default is only chosen adaptively if it encodes
+// the sample at most this fraction of the size of the default, since the
+// defaults are also the fastest to scan.
+static const double kMinAdaptiveEncodingRatio = 0.9;
+
 static CompressionType GetDefaultCompressionCodec() {
   return GetCompressionCodecType(FLAGS_cfile_default_compression_codec);
 }
@@ -87,7 +106,8 @@ WriterOptions::WriterOptions()
     block_restart_interval(16),
     write_posidx(false),
     write_validx(false),
-    optimize_index_keys(true) {
+    optimize_index_keys(true),
+    write_zone_map(false) {
 }
 
 
@@ -107,6 +127,9 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     is_nullable_(is_nullable),
     typeinfo_(typeinfo),
     key_encoder_(nullptr),
+    sampling_(false),
+    sample_count_(0),
+    sample_bytes_(0),
     state_(kWriterInitialized) {
   EncodingType encoding = options_.storage_attributes.encoding;
   Status s = TypeEncodingInfo::Get(typeinfo_, encoding, &type_encoding_info_);
@@ -137,6 +160,9 @@ CFileWriter::CFileWriter(const WriterOptions &options,
 
   if (options.write_posidx) {
     posidx_builder_.reset(new IndexTreeBuilder(&options_, this));
+    if (options.write_zone_map) {
+      zone_map_builder_.reset(new ZoneMapBuilder(typeinfo_));
+    }
   }
 
   if (options.write_validx) {
@@ -173,10 +199,6 @@ Status CFileWriter::Start() {
   RETURN_NOT_OK_PREPEND(block_->Append(Slice(buf)), "Couldn't write header");
   off_ += buf.size();
 
-  BlockBuilder *bb;
-  RETURN_NOT_OK(type_encoding_info_->CreateBlockBuilder(&bb, &options_));
-  data_block_.reset(bb);
-
   if (is_nullable_) {
     size_t nrows = ((options_.storage_attributes.cfile_block_size + typeinfo_->size() - 1) /
                     typeinfo_->size());
@@ -185,6 +207,20 @@ Status CFileWriter::Start() {
 
   state_ = kWriterWriting;
 
+  // The data block builder is only created once the encoding has been
+  // chosen from the sample.
+  if (FLAGS_cfile_adaptive_encoding &&
+      options_.storage_attributes.encoding == AUTO_ENCODING &&
+      TypeEncodingInfo::GetSupportedEncodings(typeinfo_).size() > 1) {
+    sampling_ = true;
+    sample_arena_.reset(new Arena(1024, options_.storage_attributes.cfile_block_size * 2));
+    return Status::OK();
+  }
+
+  BlockBuilder *bb;
+  RETURN_NOT_OK(type_encoding_info_->CreateBlockBuilder(&bb, &options_));
+  data_block_.reset(bb);
+
   return Status::OK();
 }
 
@@ -200,6 +236,10 @@ Status CFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
   CHECK(state_ == kWriterWriting) <<
     "Bad state for Finish(): " << state_;
 
+  if (sampling_) {
+    RETURN_NOT_OK(ChooseEncodingFromSample());
+  }
+
   // Write out any pending values as the last data block.
   RETURN_NOT_OK(FinishCurDataBlock());
 
@@ -221,6 +261,15 @@ Status CFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
     footer.mutable_posidx_info()->CopyFrom(posidx_info);
   }
 
+  if (zone_map_builder_ != nullptr && zone_map_builder_->zone_map().entries_size() > 0) {
+    faststring buf;
+    pb_util::SerializeToString(zone_map_builder_->zone_map(), &buf);
+    BlockPointer ptr;
+    RETURN_NOT_OK_PREPEND(AddBlock({ Slice(buf) }, &ptr, "zone map"),
+                          "Couldn't write zone map");
+    ptr.CopyToPB(footer.mutable_zone_map_block_ptr());
+  }
+
   if (options_.write_validx) {
     BTreeInfoPB validx_info;
     RETURN_NOT_OK_PREPEND(validx_builder_->Finish(&validx_info), "Couldn't write value index");
@@ -285,6 +334,9 @@ void CFileWriter::FlushMetadataToPB(RepeatedPtrField<FileMetadataPairPB> *field)
 
 Status CFileWriter::AppendEntries(const void *entries, size_t count) {
   DCHECK(!is_nullable_);
+  if (sampling_) {
+    return AppendToSample(nullptr, entries, count);
+  }
 
   int rem = count;
 
@@ -293,6 +345,9 @@ Status CFileWriter::AppendEntries(const void *entries, size_t count) {
   while (rem > 0) {
     int n = data_block_->Add(ptr, rem);
     DCHECK_GE(n, 0);
+    if (zone_map_builder_ != nullptr) {
+      zone_map_builder_->AddValues(ptr, n);
+    }
 
     ptr += typeinfo_->size() * n;
     rem -= n;
@@ -311,6 +366,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
                                           const void *entries,
                                           size_t count) {
   DCHECK(is_nullable_ && bitmap != nullptr);
+  if (sampling_) {
+    return AppendToSample(bitmap, entries, count);
+  }
 
   const uint8_t *ptr = reinterpret_cast<const uint8_t *>(entries);
 
@@ -325,6 +383,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
         DCHECK_GE(n, 0);
 
         null_bitmap_builder_->AddRun(true, n);
+        if (zone_map_builder_ != nullptr) {
+          zone_map_builder_->AddValues(ptr, n);
+        }
         ptr += n * typeinfo_->size();
         value_count_ += n;
         rem -= n;
@@ -336,6 +397,9 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       } while (rem > 0);
     } else {
       null_bitmap_builder_->AddRun(false, nblock);
+      if (zone_map_builder_ != nullptr) {
+        zone_map_builder_->AddNulls(nblock);
+      }
       ptr += nblock * typeinfo_->size();
       value_count_ += nblock;
     }
@@ -344,6 +408,135 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
   return Status::OK();
 }
 
+Status CFileWriter::AppendToSample(const uint8_t* bitmap, const void* entries, size_t count) {
+  const size_t size = typeinfo_->size();
+  const uint8_t* ptr = reinterpret_cast<const uint8_t*>(entries);
+  for (size_t i = 0; i < count; i++, ptr += size) {
+    if (sample_count_ % 8 == 0) {
+      sample_non_null_.push_back(0);
+    }
+    const bool not_null = bitmap == nullptr || BitmapTest(bitmap, i);
+    if (!not_null) {
+      sample_cells_.resize(sample_cells_.size() + size);
+      sample_count_++;
+      continue;
+    }
+    BitmapSet(sample_non_null_.data(), sample_count_);
+    if (typeinfo_->physical_type() == BINARY) {
+      // The caller's values needn't outlive the call.
+      Slice copy;
+      if (PREDICT_FALSE(!sample_arena_->RelocateSlice(*reinterpret_cast<const Slice*>(ptr),
+                                                      &copy))) {
+        return Status::RuntimeError("out of memory buffering values to choose encoding");
+      }
+      sample_cells_.append(&copy, sizeof(copy));
+      sample_bytes_ += copy.size();
+    } else {
+      sample_cells_.append(ptr, size);
+      sample_bytes_ += size;
+    }
+    sample_count_++;
+  }
+
+  if (sample_bytes_ >= options_.storage_attributes.cfile_block_size) {
+    return ChooseEncodingFromSample();
+  }
+  return Status::OK();
+}
+
+double CFileWriter::SampleEncodedBytesPerValue(EncodingType encoding,
+                                               const uint8_t* values,
+                                               size_t count) {
+  const TypeEncodingInfo* info;
+  BlockBuilder* bb;
+  if (!TypeEncodingInfo::Get(typeinfo_, encoding, &info).ok() ||
+      !info->CreateBlockBuilder(&bb, &options_).ok()) {
+    return -1;
+  }
+  gscoped_ptr<BlockBuilder> builder(bb);
+
+  const size_t size = typeinfo_->size();
+  size_t added = 0;
+  while (added < count && !builder->IsBlockFull()) {
+    int n = builder->Add(values + added * size, count - added);
+    if (n <= 0) {
+      break;
+    }
+    added += n;
+  }
+  if (added == 0) {
+    return -1;
+  }
+  size_t bytes = builder->Finish(0).size();
+
+  // The dictionary is written separately at the end of the file, so account
+  // for it here: each distinct value plus its offset.
+  if (encoding == DICT_ENCODING) {
+    std::unordered_set<StringPiece, GoodFastHash<StringPiece>> distinct;
+    const Slice* slices = reinterpret_cast<const Slice*>(values);
+    for (size_t i = 0; i < added; i++) {
+      StringPiece value(reinterpret_cast<const char*>(slices[i].data()), slices[i].size());
+      if (distinct.insert(value).second) {
+        bytes += slices[i].size() + sizeof(uint32_t);
+      }
+    }
+  }
+  return static_cast<double>(bytes) / added;
+}
+
+Status CFileWriter::ChooseEncodingFromSample() {
+  DCHECK(sampling_);
+  sampling_ = false;
+
+  // Gather the non-null values, which are what the data blocks encode.
+  const size_t size = typeinfo_->size();
+  faststring values;
+  size_t num_values = 0;
+  for (size_t i = 0; i < sample_count_; i++) {
+    if (BitmapTest(sample_non_null_.data(), i)) {
+      values.append(&sample_cells_[i * size], size);
+      num_values++;
+    }
+  }
+
+  EncodingType chosen = type_encoding_info_->encoding_type();
+  if (num_values > 0) {
+    const double default_size = SampleEncodedBytesPerValue(chosen, values.data(), num_values);
+    double best_size = default_size >= 0 ? default_size * kMinAdaptiveEncodingRatio :
+                                           std::numeric_limits<double>::max();
+    for (EncodingType encoding : TypeEncodingInfo::GetSupportedEncodings(typeinfo_)) {
+      if (encoding == type_encoding_info_->encoding_type()) {
+        continue;
+      }
+      double encoded_size = SampleEncodedBytesPerValue(encoding, values.data(), num_values);
+      if (encoded_size >= 0 && encoded_size < best_size) {
+        chosen = encoding;
+        best_size = encoded_size;
+      }
+    }
+    VLOG(1) << "Chose encoding " << EncodingType_Name(chosen) << " for " << ToString()
+            << " from " << num_values << " sampled values";
+  }
+  RETURN_NOT_OK(TypeEncodingInfo::Get(typeinfo_, chosen, &type_encoding_info_));
+
+  BlockBuilder *bb;
+  RETURN_NOT_OK(type_encoding_info_->CreateBlockBuilder(&bb, &options_));
+  data_block_.reset(bb);
+
+  // Write the sampled values. The arena holding the binary values is kept
+  // until the writer is destroyed, as the builders may refer to them.
+  const size_t count = sample_count_;
+  sample_count_ = 0;
+  if (count > 0) {
+    RETURN_NOT_OK(is_nullable_ ?
+                  AppendNullableEntries(sample_non_null_.data(), sample_cells_.data(), count) :
+                  AppendEntries(sample_cells_.data(), count));
+  }
+  sample_cells_.clear();
+  sample_non_null_.clear();
+  return Status::OK();
+}
+
 Status CFileWriter::FinishCurDataBlock() {
   uint32_t num_elems_in_block = data_block_->Count();
   if (is_nullable_) {
@@ -391,6 +584,10 @@ Status CFileWriter::FinishCurDataBlock() {
     null_bitmap_builder_->Reset();
   }
 
+  if (zone_map_builder_ != nullptr) {
+    zone_map_builder_->FinishBlock(first_elem_ord, num_elems_in_block);
+  }
+
   if (validx_builder_ != nullptr) {
     RETURN_NOT_OK(data_block_->GetLastKey(key_tmp_space));
     key_encoder_->ResetAndEncode(key_tmp_space, &last_key_);
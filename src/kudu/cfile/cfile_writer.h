@@ -49,12 +49,23 @@ using std::unordered_map;
 class BlockPointer;
 class BTreeInfoPB;
 class IndexTreeBuilder;
+class ZoneMapBuilder;
 
 // Magic used in header/footer
 extern const char kMagicStringV1[];
 extern const char kMagicStringV2[];
 extern const int kMagicLength;
 
+// Bits of CFileFooterPB::incompatible_features.
+enum IncompatibleFeatures {
+  // Dictionary-encoded data blocks may be coded against dictionary pages
+  // other than the first.
+  MULTIPLE_DICT_PAGES = 1 << 0,
+};
+
+// The incompatible features which this version is able to read.
+const uint32_t kSupportedIncompatibleFeatures = MULTIPLE_DICT_PAGES;
+
 class NullBitmapBuilder {
  public:
   explicit NullBitmapBuilder(size_t initial_row_capacity)
@@ -154,7 +165,7 @@ class CFileWriter {
   // This includes NULL cells, but does not include any "raw" blocks
   // appended.
   int written_value_count() const {
-    return value_count_;
+    return value_count_ + sample_count_;
   }
 
   std::string ToString() const { return block_->id().ToString(); }
@@ -181,6 +192,20 @@ class CFileWriter {
 
   Status FinishCurDataBlock();
 
+  // Buffer values appended while choosing the encoding, and choose it once a
+  // block's worth has been buffered.
+  Status AppendToSample(const uint8_t* bitmap, const void* entries, size_t count);
+
+  // Choose the encoding of the file from the buffered values, and append
+  // them with it.
+  Status ChooseEncodingFromSample();
+
+  // Returns the size per value of the first block of 'count' non-null
+  // 'values' written with 'encoding', or a negative number if it cannot be
+  // used.
+  double SampleEncodedBytesPerValue(EncodingType encoding, const uint8_t* values,
+                                    size_t count);
+
   // Flush the current unflushed_metadata_ entries into the given protobuf
   // field, clearing the buffer.
   void FlushMetadataToPB(google::protobuf::RepeatedPtrField<FileMetadataPairPB> *field);
@@ -216,9 +241,27 @@ class CFileWriter {
   // Metadata which has been added to the writer but not yet flushed.
   vector<pair<string, string> > unflushed_metadata_;
 
+  // Whether the values appended are being buffered to choose the encoding of
+  // the file (see --cfile_adaptive_encoding). The data block builder is not
+  // created until the encoding has been chosen.
+  bool sampling_;
+
+  // The buffered cells, including those of NULLs, in the cell format of the
+  // type, with binary values copied into 'sample_arena_'.
+  faststring sample_cells_;
+
+  // Bitmap of which of the buffered cells are non-null.
+  faststring sample_non_null_;
+
+  // The number of buffered cells, and the size of their non-null values.
+  size_t sample_count_;
+  size_t sample_bytes_;
+  gscoped_ptr<Arena> sample_arena_;
+
   gscoped_ptr<BlockBuilder> data_block_;
   gscoped_ptr<IndexTreeBuilder> posidx_builder_;
   gscoped_ptr<IndexTreeBuilder> validx_builder_;
+  gscoped_ptr<ZoneMapBuilder> zone_map_builder_;
   gscoped_ptr<NullBitmapBuilder> null_bitmap_builder_;
   gscoped_ptr<CompressedBlockBuilder> block_compressor_;
 
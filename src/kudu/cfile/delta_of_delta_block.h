@@ -0,0 +1,362 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Frame-of-reference, delta-of-delta encoding for integer types.
+//
+// Each value is stored as the difference between its delta from the
+// previous value and the previous delta. For regularly spaced sequences such
+// as timestamps or counters these "delta-of-deltas" are zero or close to it.
+// The delta-of-deltas of a block are stored relative to their minimum (the
+// frame of reference) using the smallest bit width which fits them all.
+//
+// Block layout (all fixed-size fields little-endian):
+//
+//   num_elems         uint32
+//   ordinal_pos_base  uint32
+//   first_value       uint64
+//   first_delta       uint64
+//   min_dod           uint64
+//   bit_width         uint8
+//   packed data       (num_elems - 2) * bit_width bits, LSB first
+//   padding           kPaddingSize zero bytes
+//
+// All arithmetic is done modulo 2^64 on the values widened to 64 bits, so
+// arbitrary sequences round-trip exactly.
+#ifndef KUDU_CFILE_DELTA_OF_DELTA_BLOCK_H
+#define KUDU_CFILE_DELTA_OF_DELTA_BLOCK_H
+
+#include <algorithm>
+#include <stdint.h>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/endian.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+#include "kudu/util/faststring.h"
+
+namespace kudu {
+namespace cfile {
+
+namespace dod {
+
+static const size_t kHeaderSize = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 3 + 1;
+
+// Trailing bytes which let the decoder unpack any value with unaligned
+// 64-bit loads, without bounds checks.
+static const size_t kPaddingSize = 8;
+
+// The maximum number of values in a block. With a bit width of 0 the size of a
+// block doesn't depend on its number of values, so the decoder relies on this
+// bound, rather than on the size of the block, to reject corrupt counts before
+// allocating room for the decoded values.
+static const uint32_t kMaxElemsPerBlock = 1 << 20;
+
+inline size_t PackedSize(uint32_t num_elems, int bit_width) {
+  if (num_elems <= 2) {
+    return 0;
+  }
+  return (static_cast<uint64_t>(num_elems - 2) * bit_width + 7) / 8;
+}
+
+// Return the 'width'-bit value starting at bit 'bit_offset' of 'data'.
+inline uint64_t UnpackBits(const uint8_t* data, uint64_t bit_offset, int width) {
+  const uint8_t* p = data + bit_offset / 8;
+  int shift = bit_offset % 8;
+  uint64_t v = LittleEndian::Load64(p) >> shift;
+  if (shift + width > 64) {
+    v |= static_cast<uint64_t>(p[8]) << (64 - shift);
+  }
+  return width == 64 ? v : v & ((1ULL << width) - 1);
+}
+
+} // namespace dod
+
+template<DataType Type>
+class DeltaOfDeltaBlockBuilder final : public BlockBuilder {
+ public:
+  explicit DeltaOfDeltaBlockBuilder(const WriterOptions* options)
+      : options_(options) {
+    Reset();
+  }
+
+  void Reset() OVERRIDE {
+    values_.clear();
+    buffer_.clear();
+    // Like bitshuffle, bound the number of values in a block by their
+    // unencoded size, so that decoded blocks stay reasonably small.
+    max_elems_ = std::min<size_t>(
+        dod::kMaxElemsPerBlock,
+        std::max<size_t>(1, options_->storage_attributes.cfile_block_size / sizeof(CppType)));
+  }
+
+  bool IsBlockFull() const OVERRIDE {
+    return values_.size() >= max_elems_;
+  }
+
+  int Add(const uint8_t* vals_void, size_t count) OVERRIDE {
+    const CppType* vals = reinterpret_cast<const CppType*>(vals_void);
+    size_t to_add = std::min(count, max_elems_ - values_.size());
+    values_.insert(values_.end(), vals, vals + to_add);
+    return to_add;
+  }
+
+  size_t Count() const OVERRIDE {
+    return values_.size();
+  }
+
+  Status GetFirstKey(void* key) const OVERRIDE {
+    if (values_.empty()) {
+      return Status::NotFound("no keys in data block");
+    }
+    *reinterpret_cast<CppType*>(key) = values_.front();
+    return Status::OK();
+  }
+
+  Status GetLastKey(void* key) const OVERRIDE {
+    if (values_.empty()) {
+      return Status::NotFound("no keys in data block");
+    }
+    *reinterpret_cast<CppType*>(key) = values_.back();
+    return Status::OK();
+  }
+
+  Slice Finish(rowid_t ordinal_pos) OVERRIDE {
+    const uint32_t n = values_.size();
+    uint64_t first_value = n > 0 ? Widen(values_[0]) : 0;
+    uint64_t first_delta = n > 1 ? Widen(values_[1]) - first_value : 0;
+
+    // Find the frame of reference and the width of the packed values.
+    int64_t min_dod = 0;
+    uint64_t max_offset = 0;
+    if (n > 2) {
+      min_dod = DeltaOfDelta(2);
+      int64_t max_dod = min_dod;
+      for (uint32_t i = 3; i < n; i++) {
+        int64_t dod = DeltaOfDelta(i);
+        min_dod = std::min(min_dod, dod);
+        max_dod = std::max(max_dod, dod);
+      }
+      max_offset = static_cast<uint64_t>(max_dod) - static_cast<uint64_t>(min_dod);
+    }
+    const int bit_width = max_offset == 0 ? 0 : Bits::Log2FloorNonZero64(max_offset) + 1;
+
+    buffer_.resize(dod::kHeaderSize);
+    InlineEncodeFixed32(&buffer_[0], n);
+    InlineEncodeFixed32(&buffer_[4], ordinal_pos);
+    InlineEncodeFixed64(&buffer_[8], first_value);
+    InlineEncodeFixed64(&buffer_[16], first_delta);
+    InlineEncodeFixed64(&buffer_[24], static_cast<uint64_t>(min_dod));
+    buffer_[32] = bit_width;
+
+    if (bit_width > 0) {
+      uint64_t acc = 0;
+      int nbits = 0;
+      for (uint32_t i = 2; i < n; i++) {
+        uint64_t v = static_cast<uint64_t>(DeltaOfDelta(i)) - static_cast<uint64_t>(min_dod);
+        acc |= v << nbits;
+        if (nbits + bit_width >= 64) {
+          PutFixed64(&buffer_, acc);
+          acc = nbits == 0 ? 0 : v >> (64 - nbits);
+          nbits = nbits + bit_width - 64;
+        } else {
+          nbits += bit_width;
+        }
+      }
+      for (int i = 0; i < nbits; i += 8) {
+        buffer_.push_back(static_cast<uint8_t>(acc >> i));
+      }
+    }
+    DCHECK_EQ(dod::kHeaderSize + dod::PackedSize(n, bit_width), buffer_.size());
+    static const uint8_t kPadding[dod::kPaddingSize] = { 0 };
+    buffer_.append(kPadding, sizeof(kPadding));
+    return Slice(buffer_);
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+
+  // Sign- or zero-extend a value to 64 bits.
+  static uint64_t Widen(CppType v) {
+    return MathLimits<CppType>::kIsSigned ? static_cast<uint64_t>(static_cast<int64_t>(v))
+                                          : static_cast<uint64_t>(v);
+  }
+
+  int64_t DeltaOfDelta(uint32_t i) const {
+    uint64_t delta = Widen(values_[i]) - Widen(values_[i - 1]);
+    uint64_t prev_delta = Widen(values_[i - 1]) - Widen(values_[i - 2]);
+    return static_cast<int64_t>(delta - prev_delta);
+  }
+
+  std::vector<CppType> values_;
+  size_t max_elems_;
+  faststring buffer_;
+  const WriterOptions* const options_;
+};
+
+template<DataType Type>
+class DeltaOfDeltaBlockDecoder final : public BlockDecoder {
+ public:
+  explicit DeltaOfDeltaBlockDecoder(Slice slice)
+      : data_(std::move(slice)),
+        parsed_(false),
+        num_elems_(0),
+        ordinal_pos_base_(0),
+        cur_idx_(0) {
+  }
+
+  // Parse the header and decode the whole block, so that seeks and copies
+  // are simple array accesses.
+  Status ParseHeader() OVERRIDE {
+    CHECK(!parsed_);
+    if (data_.size() < dod::kHeaderSize + dod::kPaddingSize) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for header: $0", data_.size()));
+    }
+    num_elems_ = DecodeFixed32(&data_[0]);
+    if (PREDICT_FALSE(num_elems_ > dod::kMaxElemsPerBlock)) {
+      return Status::Corruption(strings::Substitute("too many values in block: $0",
+                                                    num_elems_));
+    }
+    ordinal_pos_base_ = DecodeFixed32(&data_[4]);
+    uint64_t value = DecodeFixed64(&data_[8]);
+    uint64_t delta = DecodeFixed64(&data_[16]);
+    uint64_t min_dod = DecodeFixed64(&data_[24]);
+    int bit_width = data_[32];
+    if (PREDICT_FALSE(bit_width > 64)) {
+      return Status::Corruption(strings::Substitute("invalid bit width: $0", bit_width));
+    }
+    size_t expected_size = dod::kHeaderSize + dod::PackedSize(num_elems_, bit_width) +
+        dod::kPaddingSize;
+    if (PREDICT_FALSE(data_.size() != expected_size)) {
+      return Status::Corruption(strings::Substitute(
+          "unexpected data size $0 for $1 values of width $2 (expected $3)",
+          data_.size(), num_elems_, bit_width, expected_size));
+    }
+
+    decoded_.resize(num_elems_ * sizeof(CppType));
+    CppType* out = reinterpret_cast<CppType*>(decoded_.data());
+    const uint8_t* packed = &data_[dod::kHeaderSize];
+    for (uint32_t i = 0; i < num_elems_; i++) {
+      if (i >= 2) {
+        uint64_t offset = bit_width == 0 ? 0 :
+            dod::UnpackBits(packed, static_cast<uint64_t>(i - 2) * bit_width, bit_width);
+        delta += min_dod + offset;
+      }
+      if (i >= 1) {
+        value += delta;
+      }
+      out[i] = static_cast<CppType>(value);
+    }
+
+    parsed_ = true;
+    return Status::OK();
+  }
+
+  void SeekToPositionInBlock(uint pos) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    DCHECK_LE(pos, num_elems_);
+    cur_idx_ = pos;
+  }
+
+  Status SeekAtOrAfterValue(const void* value_void, bool* exact) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    const CppType target = *reinterpret_cast<const CppType*>(value_void);
+    const CppType* begin = values();
+    const CppType* it = std::lower_bound(begin, begin + num_elems_, target);
+    cur_idx_ = it - begin;
+    if (cur_idx_ == num_elems_) {
+      return Status::NotFound("after last key in block");
+    }
+    *exact = *it == target;
+    return Status::OK();
+  }
+
+  Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+    size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    memcpy(dst->data(), values() + cur_idx_, max_fetch * sizeof(CppType));
+    cur_idx_ += max_fetch;
+    *n = max_fetch;
+    return Status::OK();
+  }
+
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override {
+    DCHECK(parsed_);
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    ctx->SetDecoderEvalSupported();
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+    size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    const CppType* src = values() + cur_idx_;
+    if (EvaluatePredicateOnCells<Type>(*ctx->pred(), src, max_fetch, sel)) {
+      memcpy(dst->data(), src, max_fetch * sizeof(CppType));
+    }
+    cur_idx_ += max_fetch;
+    *n = max_fetch;
+    return Status::OK();
+  }
+
+  bool HasNext() const OVERRIDE {
+    return cur_idx_ < num_elems_;
+  }
+
+  size_t Count() const OVERRIDE {
+    return num_elems_;
+  }
+
+  size_t GetCurrentIndex() const OVERRIDE {
+    return cur_idx_;
+  }
+
+  rowid_t GetFirstRowId() const OVERRIDE {
+    return ordinal_pos_base_;
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+
+  const CppType* values() const {
+    return reinterpret_cast<const CppType*>(decoded_.data());
+  }
+
+  Slice data_;
+  bool parsed_;
+  uint32_t num_elems_;
+  rowid_t ordinal_pos_base_;
+  size_t cur_idx_;
+  faststring decoded_;
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif
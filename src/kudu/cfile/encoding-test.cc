@@ -15,21 +15,27 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <memory>
 #include <limits>
 #include <stdlib.h>
+#include <string>
 #include <vector>
 
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/bshuf_block.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/delta_of_delta_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/rle_block.h"
+#include "kudu/cfile/xor_block.h"
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/binary_prefix_block.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
@@ -41,6 +47,8 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(cfile_prefix_block_restart_heads);
+
 using std::unique_ptr;
 using std::vector;
 
@@ -234,6 +242,56 @@ class TestEncoding : public KuduTest {
     }
   }
 
+  // Seek to random targets in a block of random keys drawn from a small
+  // alphabet, so that keys share prefixes of all lengths, and compare the
+  // results against a binary search of the sorted keys.
+  void TestBinaryPrefixSeekRandomKeys() {
+    Random r(SeedRandom());
+    const char kAlphabet[] = { '\0', 'a', 'b' };
+    auto random_key = [&]() {
+      string key;
+      int len = r.Uniform(20);
+      for (int i = 0; i < len; i++) {
+        key.push_back(kAlphabet[r.Uniform(arraysize(kAlphabet))]);
+      }
+      return key;
+    };
+
+    vector<string> keys;
+    for (int i = 0; i < 2000; i++) {
+      keys.push_back(random_key());
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    vector<Slice> slices(keys.begin(), keys.end());
+
+    gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+    BinaryPrefixBlockBuilder sbb(opts.get());
+    ASSERT_EQ(slices.size(), sbb.Add(reinterpret_cast<const uint8_t*>(slices.data()),
+                                     slices.size()));
+    Slice s = sbb.Finish(0);
+    BinaryPrefixBlockDecoder sbd(s);
+    ASSERT_OK(sbd.ParseHeader());
+
+    for (int i = 0; i < 1000; i++) {
+      string target = random_key();
+      SCOPED_TRACE(Slice(target).ToDebugString());
+      auto it = std::lower_bound(keys.begin(), keys.end(), target);
+      bool exact;
+      Status st = sbd.SeekAtOrAfterValue(&target, &exact);
+      if (it == keys.end()) {
+        ASSERT_TRUE(st.IsNotFound()) << st.ToString();
+        continue;
+      }
+      ASSERT_OK(st);
+      ASSERT_EQ(it - keys.begin(), sbd.GetCurrentIndex());
+      ASSERT_EQ(*it == target, exact);
+      Slice ret;
+      CopyOne<STRING>(&sbd, &ret);
+      ASSERT_EQ(*it, ret.ToString());
+    }
+  }
+
   template<class BuilderType, class DecoderType>
   void TestBinaryBlockRoundTrip() {
     gscoped_ptr<WriterOptions> opts(NewWriterOptions());
@@ -423,6 +481,35 @@ class TestEncoding : public KuduTest {
     }
   }
 
+  // Encode 'size' values from 'src' into a single block, then decode the
+  // block 'num_iters' times, logging the time taken. Returns the size of the
+  // encoded block.
+  template<DataType Type, class BlockBuilder, class BlockDecoder>
+  size_t BenchmarkDecode(const typename TypeTraits<Type>::cpp_type* src, uint32_t size,
+                         int num_iters) {
+    typedef typename TypeTraits<Type>::cpp_type CppType;
+    gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+    BlockBuilder bb(opts.get());
+    CHECK_EQ(size, bb.Add(reinterpret_cast<const uint8_t*>(src), size));
+    Slice s = bb.Finish(0);
+
+    vector<CppType> decoded(size);
+    ColumnBlock cb(GetTypeInfo(Type), nullptr, &decoded[0], size, &arena_);
+    LOG_TIMING(INFO, strings::Substitute("decoding $0 values $1 times from a $2 byte block",
+                                         size, num_iters, s.size())) {
+      for (int i = 0; i < num_iters; i++) {
+        BlockDecoder bd(s);
+        CHECK_OK(bd.ParseHeader());
+        ColumnDataView cdv(&cb);
+        size_t n = size;
+        CHECK_OK(bd.CopyNextValues(&n, &cdv));
+        CHECK_EQ(size, n);
+      }
+    }
+    CHECK_EQ(0, memcmp(src, &decoded[0], size * sizeof(CppType)));
+    return s.size();
+  }
+
   // Test truncation of blocks
   template<class BuilderType, class DecoderType>
   void TestBinaryBlockTruncation() {
@@ -631,6 +718,76 @@ class TestEncoding : public KuduTest {
     }
   }
 
+  // Test that evaluating predicates in the decoder yields the same selection
+  // as evaluating them on the copied-out values. The values are drawn from a
+  // small range, with runs, so that RLE blocks exercise their run handling.
+  template <class BuilderType, class DecoderType, DataType Type>
+  void TestDecoderEval() {
+    typedef typename DataTypeTraits<Type>::cpp_type CppType;
+    const int kNumValues = 10000;
+
+    vector<CppType> to_insert;
+    Random rd(SeedRandom());
+    while (to_insert.size() < kNumValues) {
+      CppType val = static_cast<CppType>(rd.Uniform(20));
+      int run = rd.OneIn(4) ? rd.Uniform(50) + 1 : 1;
+      for (int i = 0; i < run && to_insert.size() < kNumValues; i++) {
+        to_insert.push_back(val);
+      }
+    }
+
+    unique_ptr<WriterOptions> opts(NewWriterOptions());
+    BuilderType bb(opts.get());
+    ASSERT_EQ(kNumValues, bb.Add(reinterpret_cast<const uint8_t*>(&to_insert[0]),
+                                 to_insert.size()));
+    Slice s = bb.Finish(0);
+
+    ColumnSchema col("c", Type);
+    CppType five = 5;
+    CppType seven = 7;
+    CppType twelve = 12;
+    vector<const void*> in_list = { &five, &twelve };
+    vector<ColumnPredicate> preds = {
+      ColumnPredicate::Equality(col, &seven),
+      ColumnPredicate::Range(col, &five, &twelve),
+      ColumnPredicate::Range(col, nullptr, &seven),
+      ColumnPredicate::Range(col, &twelve, nullptr),
+      ColumnPredicate::InList(col, &in_list),
+      ColumnPredicate::IsNotNull(col),
+    };
+    for (const ColumnPredicate& pred : preds) {
+      SCOPED_TRACE(pred.ToString());
+      DecoderType bd(s);
+      ASSERT_OK(bd.ParseHeader());
+
+      vector<CppType> decoded(kNumValues);
+      ColumnBlock cb(GetTypeInfo(Type), nullptr, &decoded[0], kNumValues, &arena_);
+      SelectionVector sel(kNumValues);
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, &pred, &cb, &sel);
+      SelectionVectorView sel_view(&sel);
+
+      int dec_count = 0;
+      while (bd.HasNext()) {
+        size_t n = std::min<size_t>(kNumValues - dec_count, random() % 300 + 1);
+        ColumnDataView dst(&cb, dec_count);
+        ASSERT_OK_FAST(bd.CopyNextAndEval(&n, &ctx, &sel_view, &dst));
+        sel_view.Advance(n);
+        dec_count += n;
+      }
+      ASSERT_EQ(kNumValues, dec_count);
+      ASSERT_FALSE(ctx.DecoderEvalNotSupported());
+
+      for (int i = 0; i < kNumValues; i++) {
+        bool expected = pred.EvaluateCell<Type>(&to_insert[i]);
+        ASSERT_EQ(expected, sel.IsRowSelected(i)) << "row " << i;
+        if (expected) {
+          ASSERT_EQ(to_insert[i], decoded[i]) << "row " << i;
+        }
+      }
+    }
+  }
+
   Arena arena_;
 };
 
@@ -683,6 +840,93 @@ TEST_F(TestEncoding, TestBShufDoubleBlockEncoder) {
                                     BShufBlockDecoder<DOUBLE> >(doubles.get(), kSize);
 }
 
+TEST_F(TestEncoding, TestXorFloatBlockEncoder) {
+  const uint32_t kSize = 10000;
+
+  gscoped_ptr<float[]> floats(new float[kSize]);
+  for (int i = 0; i < kSize; i++) {
+    floats.get()[i] = random() + static_cast<float>(random())/INT_MAX;
+  }
+
+  TestEncodeDecodeTemplateBlockEncoder<FLOAT, XorBlockBuilder<FLOAT>,
+                                    XorBlockDecoder<FLOAT> >(floats.get(), kSize);
+}
+
+TEST_F(TestEncoding, TestXorDoubleBlockEncoder) {
+  const uint32_t kSize = 10000;
+
+  gscoped_ptr<double[]> doubles(new double[kSize]);
+  for (int i = 0; i < kSize; i++) {
+    // Include repeated values to exercise the single-bit case.
+    doubles.get()[i] = (i % 7 == 0 && i > 0) ? doubles.get()[i - 1] :
+        random() + static_cast<double>(random())/INT_MAX;
+  }
+
+  TestEncodeDecodeTemplateBlockEncoder<DOUBLE, XorBlockBuilder<DOUBLE>,
+                                    XorBlockDecoder<DOUBLE> >(doubles.get(), kSize);
+}
+
+// Special floating point values must round-trip bit for bit.
+TEST_F(TestEncoding, TestXorSpecialValues) {
+  const double kValues[] = { 0.0, -0.0, std::numeric_limits<double>::quiet_NaN(),
+                             std::numeric_limits<double>::infinity(),
+                             -std::numeric_limits<double>::infinity(),
+                             std::numeric_limits<double>::denorm_min(),
+                             std::numeric_limits<double>::max(), 1.0, 1.0 };
+  const int kNumValues = arraysize(kValues);
+  unique_ptr<WriterOptions> opts(NewWriterOptions());
+  XorBlockBuilder<DOUBLE> bb(opts.get());
+  ASSERT_EQ(kNumValues, bb.Add(reinterpret_cast<const uint8_t*>(kValues), kNumValues));
+  Slice s = bb.Finish(0);
+
+  XorBlockDecoder<DOUBLE> bd(s);
+  ASSERT_OK(bd.ParseHeader());
+  ASSERT_EQ(kNumValues, bd.Count());
+  double decoded[kNumValues];
+  ColumnBlock cb(GetTypeInfo(DOUBLE), nullptr, decoded, kNumValues, &arena_);
+  ColumnDataView cdv(&cb);
+  size_t n = kNumValues;
+  ASSERT_OK(bd.CopyNextValues(&n, &cdv));
+  ASSERT_EQ(kNumValues, n);
+  ASSERT_EQ(0, memcmp(kValues, decoded, sizeof(kValues)));
+
+  // A truncated block is reported as corrupt when decoding.
+  XorBlockDecoder<DOUBLE> truncated(Slice(s.data(), s.size() - 2));
+  ASSERT_OK(truncated.ParseHeader());
+  n = kNumValues;
+  ColumnDataView cdv2(&cb);
+  ASSERT_TRUE(truncated.CopyNextValues(&n, &cdv2).IsCorruption());
+}
+
+// Compare the size and decoding speed of XOR and bitshuffle encoding on a
+// slowly changing metric, such as a gauge sampled at regular intervals.
+TEST_F(TestEncoding, TestXorVsBitshuffleMetric) {
+  const uint32_t kSize = 10000;
+#ifdef NDEBUG
+  const int kNumIters = 1000;
+#else
+  const int kNumIters = 10;
+#endif
+  vector<double> doubles(kSize);
+  Random rd(SeedRandom());
+  double val = 100.0;
+  for (int i = 0; i < kSize; i++) {
+    // Most samples don't change; the rest move by a small amount and are
+    // rounded like a typical gauge.
+    if (rd.OneIn(4)) {
+      val = round((val + (rd.Uniform(201) - 100) / 100.0) * 100) / 100;
+    }
+    doubles[i] = val;
+  }
+
+  size_t xor_size = BenchmarkDecode<DOUBLE, XorBlockBuilder<DOUBLE>, XorBlockDecoder<DOUBLE>>(
+      &doubles[0], kSize, kNumIters);
+  size_t bshuf_size = BenchmarkDecode<DOUBLE, BShufBlockBuilder<DOUBLE>,
+                                      BShufBlockDecoder<DOUBLE>>(&doubles[0], kSize, kNumIters);
+  LOG(INFO) << "XOR encoded size: " << xor_size << ", bitshuffle encoded size: " << bshuf_size;
+  ASSERT_LT(xor_size, bshuf_size);
+}
+
 TEST_F(TestEncoding, TestRleIntBlockEncoder) {
   unique_ptr<WriterOptions> opts(NewWriterOptions());
   RleIntBlockBuilder<UINT32> ibb(opts.get());
@@ -705,6 +949,83 @@ TEST_F(TestEncoding, TestRleIntBlockEncoder) {
   ASSERT_EQ(14UL, s.size());
 }
 
+TEST_F(TestEncoding, TestDecoderEval) {
+  TestDecoderEval<PlainBlockBuilder<INT32>, PlainBlockDecoder<INT32>, INT32>();
+  TestDecoderEval<PlainBlockBuilder<DOUBLE>, PlainBlockDecoder<DOUBLE>, DOUBLE>();
+  TestDecoderEval<BShufBlockBuilder<INT64>, BShufBlockDecoder<INT64>, INT64>();
+  TestDecoderEval<BShufBlockBuilder<UINT32>, BShufBlockDecoder<UINT32>, UINT32>();
+  TestDecoderEval<BShufBlockBuilder<FLOAT>, BShufBlockDecoder<FLOAT>, FLOAT>();
+  TestDecoderEval<RleIntBlockBuilder<INT8>, RleIntBlockDecoder<INT8>, INT8>();
+  TestDecoderEval<RleIntBlockBuilder<UINT32>, RleIntBlockDecoder<UINT32>, UINT32>();
+  TestDecoderEval<DeltaOfDeltaBlockBuilder<INT64>, DeltaOfDeltaBlockDecoder<INT64>, INT64>();
+}
+
+// Test that regularly spaced timestamps with a little jitter encode compactly
+// with delta-of-delta encoding, and that the extremes of the value range
+// round-trip through the modular arithmetic.
+TEST_F(TestEncoding, TestDeltaOfDeltaTimestamps) {
+  const int kNumValues = 10000;
+  unique_ptr<WriterOptions> opts(NewWriterOptions());
+  DeltaOfDeltaBlockBuilder<INT64> bb(opts.get());
+
+  vector<int64_t> to_insert;
+  Random rd(SeedRandom());
+  int64_t ts = 1476400000000000L;
+  for (int i = 0; i < kNumValues; i++) {
+    ts += 1000000 + rd.Uniform(16);
+    to_insert.push_back(ts);
+  }
+  ASSERT_EQ(kNumValues, bb.Add(reinterpret_cast<const uint8_t*>(&to_insert[0]),
+                               to_insert.size()));
+  Slice s = bb.Finish(0);
+  LOG(INFO) << "Delta-of-delta encoded size for " << kNumValues << " timestamps: " << s.size();
+  // Each delta-of-delta fits in 5 bits.
+  ASSERT_LE(s.size(), dod::kHeaderSize + dod::kPaddingSize + kNumValues * 5 / 8 + 1);
+
+  DeltaOfDeltaBlockDecoder<INT64> bd(s);
+  ASSERT_OK(bd.ParseHeader());
+  vector<int64_t> decoded(kNumValues);
+  ColumnBlock cb(GetTypeInfo(INT64), nullptr, &decoded[0], kNumValues, &arena_);
+  ColumnDataView cdv(&cb);
+  size_t n = kNumValues;
+  ASSERT_OK(bd.CopyNextValues(&n, &cdv));
+  ASSERT_EQ(kNumValues, n);
+  ASSERT_EQ(to_insert, decoded);
+
+  bb.Reset();
+  const int64_t extremes[] = { std::numeric_limits<int64_t>::max(),
+                               std::numeric_limits<int64_t>::min(), 0,
+                               std::numeric_limits<int64_t>::max(), -1 };
+  const int kNumExtremes = arraysize(extremes);
+  ASSERT_EQ(kNumExtremes, bb.Add(reinterpret_cast<const uint8_t*>(extremes), kNumExtremes));
+  s = bb.Finish(0);
+  DeltaOfDeltaBlockDecoder<INT64> bd2(s);
+  ASSERT_OK(bd2.ParseHeader());
+  for (int i = 0; i < kNumExtremes; i++) {
+    int64_t ret;
+    CopyOne<INT64>(&bd2, &ret);
+    ASSERT_EQ(extremes[i], ret);
+  }
+
+  // Truncated blocks must be detected.
+  DeltaOfDeltaBlockDecoder<INT64> bd3(Slice(s.data(), s.size() - 1));
+  ASSERT_TRUE(bd3.ParseHeader().IsCorruption());
+
+  // So must huge counts of values of bit width 0, whose size doesn't depend
+  // on their count.
+  bb.Reset();
+  const int64_t constant[] = { 5, 5, 5 };
+  ASSERT_EQ(3, bb.Add(reinterpret_cast<const uint8_t*>(constant), 3));
+  s = bb.Finish(0);
+  faststring corrupt;
+  corrupt.append(s.data(), s.size());
+  ASSERT_EQ(0, corrupt[32]);
+  InlineEncodeFixed32(&corrupt[0], std::numeric_limits<uint32_t>::max());
+  DeltaOfDeltaBlockDecoder<INT64> bd4((Slice(corrupt)));
+  Status st = bd4.ParseHeader();
+  ASSERT_TRUE(st.IsCorruption()) << st.ToString();
+}
+
 TEST_F(TestEncoding, TestPlainBitMapRoundTrip) {
   TestBoolBlockRoundTrip<PlainBitMapBlockBuilder, PlainBitMapBlockDecoder>();
 }
@@ -761,6 +1082,21 @@ TEST_F(TestEncoding, TestBinaryPrefixBlockBuilderTruncation) {
   TestBinaryBlockTruncation<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
 }
 
+TEST_F(TestEncoding, TestBinaryPrefixSeekRandomKeys) {
+  TestBinaryPrefixSeekRandomKeys();
+}
+
+// Repeat the prefix encoding tests for blocks with restart heads.
+TEST_F(TestEncoding, TestBinaryPrefixBlockWithRestartHeads) {
+  FLAGS_cfile_prefix_block_restart_heads = true;
+  TestBinarySeekByValueSmallBlock<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
+  TestStringSeekByValueLargeBlock<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
+  TestBinaryBlockRoundTrip<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
+  TestEmptyBlockEncodeDecode<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
+  TestBinaryBlockTruncation<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
+  TestBinaryPrefixSeekRandomKeys();
+}
+
 // We have several different encodings for INT blocks.
 // The following tests use GTest's TypedTest functionality to run the tests
 // for each of the encodings.
@@ -789,7 +1125,16 @@ struct BitshuffleTestTraits {
     typedef BShufBlockDecoder<type> decoder_type;
   };
 };
-typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits> MyTestFixtures;
+
+struct DeltaOfDeltaTestTraits {
+  template<DataType type>
+  struct Classes {
+    typedef DeltaOfDeltaBlockBuilder<type> encoder_type;
+    typedef DeltaOfDeltaBlockDecoder<type> decoder_type;
+  };
+};
+typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits,
+                       DeltaOfDeltaTestTraits> MyTestFixtures;
 TYPED_TEST_CASE(IntEncodingTest, MyTestFixtures);
 
 template<class TestTraits>
@@ -128,11 +128,15 @@ IndexBlockReader::IndexBlockReader()
 void IndexBlockReader::Reset() {
   data_ = Slice();
   parsed_ = false;
+  decoded_keys_.clear();
+  decoded_ptrs_.clear();
 }
 
 Status IndexBlockReader::Parse(const Slice &data) {
   parsed_ = false;
   data_ = data;
+  decoded_keys_.clear();
+  decoded_ptrs_.clear();
 
 
   if (data_.size() < sizeof(uint32_t)) {
@@ -168,6 +172,18 @@ Status IndexBlockReader::Parse(const Slice &data) {
   return Status::OK();
 }
 
+Status IndexBlockReader::DecodeEntries() {
+  CHECK(parsed_) << "not parsed";
+  vector<Slice> keys(Count());
+  vector<BlockPointer> ptrs(Count());
+  for (size_t i = 0; i < keys.size(); i++) {
+    RETURN_NOT_OK(ReadEntry(i, &keys[i], &ptrs[i]));
+  }
+  decoded_keys_.swap(keys);
+  decoded_ptrs_.swap(ptrs);
+  return Status::OK();
+}
+
 size_t IndexBlockReader::Count() const {
   CHECK(parsed_) << "not parsed";
   return trailer_.num_entries();
@@ -178,12 +194,21 @@ IndexBlockIterator *IndexBlockReader::NewIterator() const {
   return new IndexBlockIterator(this);
 }
 
-bool IndexBlockReader::IsLeaf() {
+bool IndexBlockReader::IsLeaf() const {
   return trailer_.type() == IndexBlockTrailerPB::LEAF;
 }
 
+size_t IndexBlockReader::memory_footprint_excluding_this() const {
+  return trailer_.SpaceUsed() - sizeof(trailer_) +
+      decoded_keys_.capacity() * sizeof(Slice) +
+      decoded_ptrs_.capacity() * sizeof(BlockPointer);
+}
+
 int IndexBlockReader::CompareKey(int idx_in_block,
                                  const Slice &search_key) const {
+  if (!decoded_keys_.empty()) {
+    return decoded_keys_[idx_in_block].compare(search_key);
+  }
   const uint8_t *key_ptr, *limit;
   GetKeyPointer(idx_in_block, &key_ptr, &limit);
   Slice this_slice;
@@ -200,6 +225,12 @@ Status IndexBlockReader::ReadEntry(size_t idx, Slice *key, BlockPointer *block_p
     return Status::NotFound("Invalid index");
   }
 
+  if (!decoded_keys_.empty()) {
+    *key = decoded_keys_[idx];
+    *block_ptr = decoded_ptrs_[idx];
+    return Status::OK();
+  }
+
   // At 'ptr', data is encoded as follows:
   // <key> <block offset> <block length>
 
@@ -252,6 +283,11 @@ void IndexBlockIterator::Reset() {
   cur_idx_ = -1;
 }
 
+void IndexBlockIterator::Reset(const IndexBlockReader *reader) {
+  reader_ = reader;
+  Reset();
+}
+
 Status IndexBlockIterator::SeekAtOrBefore(const Slice &search_key) {
   size_t left = 0;
   size_t right = reader_->Count() - 1;
@@ -112,11 +112,20 @@ class IndexBlockReader {
   // remain valid for the lifetime of the reader (or until the next Parse call)
   Status Parse(const Slice &data);
 
+  // Decode all of the parsed block's entries up front, so that searching
+  // and iterating the block doesn't decode them again. The decoded keys
+  // point into the block data.
+  Status DecodeEntries();
+
   size_t Count() const;
 
   IndexBlockIterator *NewIterator() const;
 
-  bool IsLeaf();
+  bool IsLeaf() const;
+
+  // Returns the memory usage of the reader, excluding the block data and
+  // the reader itself.
+  size_t memory_footprint_excluding_this() const;
 
  private:
   friend class IndexBlockIterator;
@@ -140,6 +149,10 @@ class IndexBlockReader {
   const uint8_t *key_offsets_;
   bool parsed_;
 
+  // The entries decoded by DecodeEntries(), if it has been called.
+  vector<Slice> decoded_keys_;
+  vector<BlockPointer> decoded_ptrs_;
+
   DISALLOW_COPY_AND_ASSIGN(IndexBlockReader);
 };
 
@@ -151,6 +164,10 @@ class IndexBlockIterator {
   // after the associated 'reader' object parses a different block.
   void Reset();
 
+  // Reset the state of this iterator, and make it iterate over 'reader'
+  // instead.
+  void Reset(const IndexBlockReader *reader);
+
   // Find the highest block pointer in this index
   // block which has a value <= the given key.
   // If such a block is found, returns OK status.
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <string>
 #include <vector>
 
 #include "kudu/cfile/block_cache.h"
@@ -161,10 +162,69 @@ Status IndexTreeBuilder::FinishAndWriteBlock(size_t level, BlockPointer *written
 ////////////////////////////////////////////////////////////
 
 
+Status PinnedIndexBlocks::Load(const CFileReader *reader,
+                               const BlockPointer &root,
+                               gscoped_ptr<PinnedIndexBlocks> *pinned) {
+  gscoped_ptr<PinnedIndexBlocks> ret(new PinnedIndexBlocks());
+
+  // The tree is balanced, so the blocks of each level are either all leaves
+  // or all internal. Read the blocks level by level, stopping at the first
+  // level of leaves without reading it.
+  std::vector<BlockPointer> level = { root };
+  while (!level.empty()) {
+    std::vector<BlockPointer> next_level;
+    for (const BlockPointer &block : level) {
+      BlockHandle handle;
+      RETURN_NOT_OK(reader->ReadBlock(block, CFileReader::DONT_CACHE_BLOCK, &handle));
+
+      std::unique_ptr<PinnedBlock> pinned_block(new PinnedBlock());
+      pinned_block->data = handle.data().ToString();
+      RETURN_NOT_OK(pinned_block->reader.Parse(Slice(pinned_block->data)));
+      if (pinned_block->reader.IsLeaf()) {
+        DCHECK(next_level.empty());
+        break;
+      }
+      RETURN_NOT_OK(pinned_block->reader.DecodeEntries());
+
+      gscoped_ptr<IndexBlockIterator> iter(pinned_block->reader.NewIterator());
+      for (size_t i = 0; i < pinned_block->reader.Count(); i++) {
+        RETURN_NOT_OK(iter->SeekToIndex(i));
+        next_level.push_back(iter->GetCurrentBlockPointer());
+      }
+      ret->blocks_.emplace(block.offset(), std::move(pinned_block));
+    }
+    level.swap(next_level);
+  }
+
+  VLOG(1) << "Pinned " << ret->blocks_.size() << " internal index blocks of "
+          << reader->ToString();
+  pinned->swap(ret);
+  return Status::OK();
+}
+
+const IndexBlockReader *PinnedIndexBlocks::Lookup(const BlockPointer &block) const {
+  auto it = blocks_.find(block.offset());
+  return it == blocks_.end() ? nullptr : &it->second->reader;
+}
+
+size_t PinnedIndexBlocks::memory_footprint_excluding_this() const {
+  size_t size = blocks_.size() * (sizeof(std::pair<uint64_t, std::unique_ptr<PinnedBlock>>) +
+                                  sizeof(PinnedBlock));
+  for (const auto &entry : blocks_) {
+    size += entry.second->data.capacity();
+    size += entry.second->reader.memory_footprint_excluding_this();
+  }
+  return size;
+}
+
 IndexTreeIterator::IndexTreeIterator(const CFileReader *reader,
-                                              const BlockPointer &root_blockptr)
+                                     const BlockPointer &root_blockptr,
+                                     bool cache_blocks,
+                                     const PinnedIndexBlocks *pinned)
     : reader_(reader),
-      root_block_(root_blockptr) {
+      root_block_(root_blockptr),
+      cache_blocks_(cache_blocks),
+      pinned_(pinned) {
 }
 
 Status IndexTreeIterator::SeekAtOrBefore(const Slice &search_key) {
@@ -231,16 +291,16 @@ IndexBlockIterator *IndexTreeIterator::BottomIter() {
   return &seeked_indexes_.back()->iter;
 }
 
-IndexBlockReader *IndexTreeIterator::BottomReader() {
-  return &seeked_indexes_.back()->reader;
+const IndexBlockReader *IndexTreeIterator::BottomReader() {
+  return seeked_indexes_.back()->cur_reader;
 }
 
 IndexBlockIterator *IndexTreeIterator::seeked_iter(int depth) {
   return &seeked_indexes_[depth]->iter;
 }
 
-IndexBlockReader *IndexTreeIterator::seeked_reader(int depth) {
-  return &seeked_indexes_[depth]->reader;
+const IndexBlockReader *IndexTreeIterator::seeked_reader(int depth) {
+  return seeked_indexes_[depth]->cur_reader;
 }
 
 Status IndexTreeIterator::LoadBlock(const BlockPointer &block, int depth) {
@@ -260,14 +320,27 @@ Status IndexTreeIterator::LoadBlock(const BlockPointer &block, int depth) {
 
     // Seeked to a different block: reset the reader
     seeked->reader.Reset();
-    seeked->iter.Reset();
   } else {
     // No cached instance, make a new one.
     seeked_indexes_.emplace_back(new SeekedIndex());
     seeked = seeked_indexes_.back().get();
   }
 
-  RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data));
+  // Pinned blocks need neither a read nor a parse.
+  const IndexBlockReader *pinned_reader = pinned_ ? pinned_->Lookup(block) : nullptr;
+  if (pinned_reader != nullptr) {
+    seeked->data = BlockHandle();
+    seeked->cur_reader = pinned_reader;
+    seeked->iter.Reset(pinned_reader);
+    seeked->block_ptr = block;
+    return Status::OK();
+  }
+  seeked->cur_reader = &seeked->reader;
+  seeked->iter.Reset(&seeked->reader);
+
+  RETURN_NOT_OK(reader_->ReadBlock(
+      block, cache_blocks_ ? CFileReader::CACHE_BLOCK : CFileReader::DONT_CACHE_BLOCK,
+      &seeked->data));
   seeked->block_ptr = block;
 
   // Parse the new block.
@@ -317,8 +390,10 @@ Status IndexTreeIterator::SeekToFirstDownward(const BlockPointer &in_block, int
 
 IndexTreeIterator *IndexTreeIterator::IndexTreeIterator::Create(
     const CFileReader *reader,
-    const BlockPointer &root_blockptr) {
-  return new IndexTreeIterator(reader, root_blockptr);
+    const BlockPointer &root_blockptr,
+    bool cache_blocks,
+    const PinnedIndexBlocks *pinned) {
+  return new IndexTreeIterator(reader, root_blockptr, cache_blocks, pinned);
 }
 
 
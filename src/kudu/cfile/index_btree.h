@@ -19,11 +19,14 @@
 #define KUDU_CFILE_INDEX_BTREE_H
 
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/cfile/block_handle.h"
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/index_block.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 
 namespace kudu {
@@ -66,11 +69,53 @@ class IndexTreeBuilder {
   DISALLOW_COPY_AND_ASSIGN(IndexTreeBuilder);
 };
 
+// The internal (non-leaf) blocks of a B-tree index, read once and kept in
+// memory, so that seeks only go through the block cache for the leaf level.
+// The pinned blocks' entries are decoded up front, so searching them is a
+// binary search over an array of keys.
+class PinnedIndexBlocks {
+ public:
+  // Read and pin all of the internal blocks of the index rooted at 'root'.
+  // If the root is itself a leaf, nothing is pinned.
+  static Status Load(const CFileReader *reader,
+                     const BlockPointer &root,
+                     gscoped_ptr<PinnedIndexBlocks> *pinned);
+
+  // Return the reader for the pinned block at 'block', or NULL if the block
+  // isn't pinned.
+  const IndexBlockReader *Lookup(const BlockPointer &block) const;
+
+  size_t memory_footprint_excluding_this() const;
+
+ private:
+  PinnedIndexBlocks() {}
+
+  struct PinnedBlock {
+    // The block data, which the reader refers to.
+    std::string data;
+    IndexBlockReader reader;
+  };
+
+  // Pinned blocks, keyed by offset in the file.
+  std::unordered_map<uint64_t, std::unique_ptr<PinnedBlock>> blocks_;
+
+  DISALLOW_COPY_AND_ASSIGN(PinnedIndexBlocks);
+};
+
 class IndexTreeIterator {
  public:
-  explicit IndexTreeIterator(
+  // If 'cache_blocks' is false, index blocks read by the iterator are not
+  // inserted into the block cache, as for data blocks read by scans which
+  // set ScanSpec::cache_blocks() to false.
+  //
+  // If 'pinned' is not NULL, it must hold the pinned internal blocks of the
+  // index rooted at 'root_blockptr', and must outlive the iterator. The
+  // iterator then reads only leaf blocks from 'reader'.
+  IndexTreeIterator(
       const CFileReader *reader,
-      const BlockPointer &root_blockptr);
+      const BlockPointer &root_blockptr,
+      bool cache_blocks = true,
+      const PinnedIndexBlocks *pinned = nullptr);
 
   Status SeekToFirst();
   Status SeekAtOrBefore(const Slice &search_key);
@@ -84,13 +129,15 @@ class IndexTreeIterator {
 
   static IndexTreeIterator *Create(
     const CFileReader *reader,
-    const BlockPointer &idx_root);
+    const BlockPointer &idx_root,
+    bool cache_blocks = true,
+    const PinnedIndexBlocks *pinned = nullptr);
 
  private:
   IndexBlockIterator *BottomIter();
-  IndexBlockReader *BottomReader();
+  const IndexBlockReader *BottomReader();
   IndexBlockIterator *seeked_iter(int depth);
-  IndexBlockReader *seeked_reader(int depth);
+  const IndexBlockReader *seeked_reader(int depth);
   Status LoadBlock(const BlockPointer &block, int dept);
   Status SeekDownward(const Slice &search_key, const BlockPointer &in_block,
                       int cur_depth);
@@ -98,6 +145,7 @@ class IndexTreeIterator {
 
   struct SeekedIndex {
     SeekedIndex() :
+      cur_reader(&reader),
       iter(&reader)
     {}
 
@@ -107,6 +155,9 @@ class IndexTreeIterator {
     BlockPointer block_ptr;
     BlockHandle data;
     IndexBlockReader reader;
+
+    // The reader for the block: either 'reader', or that of a pinned block.
+    const IndexBlockReader *cur_reader;
     IndexBlockIterator iter;
   };
 
@@ -114,6 +165,10 @@ class IndexTreeIterator {
 
   BlockPointer root_block_;
 
+  const bool cache_blocks_;
+
+  const PinnedIndexBlocks *pinned_;
+
   std::vector<std::unique_ptr<SeekedIndex>> seeked_indexes_;
 
   DISALLOW_COPY_AND_ASSIGN(IndexTreeIterator);
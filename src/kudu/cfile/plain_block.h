@@ -208,6 +208,17 @@ class PlainBlockDecoder final : public BlockDecoder {
     return Status::OK();
   }
 
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override {
+    ctx->SetDecoderEvalSupported();
+    // The encoded values may be unaligned, so evaluate them once copied.
+    RETURN_NOT_OK(CopyNextValues(n, dst));
+    EvaluatePredicateOnCells<Type>(*ctx->pred(), dst->data(), *n, sel);
+    return Status::OK();
+  }
+
   virtual bool HasNext() const OVERRIDE {
     return cur_idx_ < num_elems_;
   }
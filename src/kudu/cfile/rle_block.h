@@ -168,20 +168,52 @@ class RleBitMapBlockDecoder final : public BlockDecoder {
       return Status::OK();
     }
 
+    size_t bits_to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    size_t fetched = rle_decoder_.GetValues(reinterpret_cast<bool*>(dst->data()), bits_to_fetch);
+    DCHECK_EQ(fetched, bits_to_fetch);
+
+    cur_idx_ += bits_to_fetch;
+    *n = bits_to_fetch;
+
+    return Status::OK();
+  }
+
+  // Evaluate the predicate once per run, copying out only the runs that
+  // match.
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(bool));
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
     size_t bits_to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
     size_t remaining = bits_to_fetch;
-    uint8_t* data_ptr = dst->data();
-    // TODO : do this a word/byte at a time as opposed bit at a time
+    bool* data_ptr = reinterpret_cast<bool*>(dst->data());
+    SelectionVectorView run_sel(*sel);
     while (remaining > 0) {
-      bool result = rle_decoder_.Get(reinterpret_cast<bool*>(data_ptr));
-      DCHECK(result);
-      remaining--;
-      data_ptr++;
+      bool val;
+      size_t run = rle_decoder_.GetNextRun(&val, remaining);
+      DCHECK_GT(run, 0);
+      if (ctx->pred()->EvaluateCell<BOOL>(&val)) {
+        std::fill(data_ptr, data_ptr + run, val);
+      } else {
+        run_sel.ClearBits(run);
+      }
+      run_sel.Advance(run);
+      data_ptr += run;
+      remaining -= run;
     }
 
     cur_idx_ += bits_to_fetch;
     *n = bits_to_fetch;
-
     return Status::OK();
   }
 
@@ -394,14 +426,47 @@ class RleIntBlockDecoder final : public BlockDecoder {
       return Status::OK();
     }
 
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    size_t fetched = rle_decoder_.GetValues(reinterpret_cast<CppType*>(dst->data()), to_fetch);
+    DCHECK_EQ(fetched, to_fetch);
+
+    cur_idx_ += to_fetch;
+    *n = to_fetch;
+    return Status::OK();
+  }
+
+  // Evaluate the predicate once per run, copying out only the runs that
+  // match.
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) override {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    ctx->SetDecoderEvalSupported();
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
     size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
     size_t remaining = to_fetch;
-    uint8_t* data_ptr = dst->data();
+    CppType* data_ptr = reinterpret_cast<CppType*>(dst->data());
+    SelectionVectorView run_sel(*sel);
     while (remaining > 0) {
-      bool result = rle_decoder_.Get(reinterpret_cast<CppType*>(data_ptr));
-      DCHECK(result);
-      remaining--;
-      data_ptr += kCppTypeSize;
+      CppType val;
+      size_t run = rle_decoder_.GetNextRun(&val, remaining);
+      DCHECK_GT(run, 0);
+      if (ctx->pred()->EvaluateCell<IntType>(&val)) {
+        std::fill(data_ptr, data_ptr + run, val);
+      } else {
+        run_sel.ClearBits(run);
+      }
+      run_sel.Advance(run);
+      data_ptr += run;
+      remaining -= run;
     }
 
     cur_idx_ += to_fetch;
@@ -19,13 +19,16 @@
 #include <unordered_map>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <glog/logging.h>
 
 #include "kudu/cfile/bshuf_block.h"
+#include "kudu/cfile/delta_of_delta_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/rle_block.h"
+#include "kudu/cfile/xor_block.h"
 #include "kudu/cfile/binary_dict_block.h"
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/binary_prefix_block.h"
@@ -37,6 +40,7 @@ namespace cfile {
 
 using std::unordered_map;
 using std::shared_ptr;
+using std::vector;
 
 
 template<DataType Type, EncodingType Encoding>
@@ -84,6 +88,38 @@ struct DataTypeEncodingTraits<Type, BIT_SHUFFLE> {
   }
 };
 
+// Delta-of-delta encoding for the integer types.
+template<DataType Type>
+struct DataTypeEncodingTraits<Type, DELTA_OF_DELTA> {
+
+  static Status CreateBlockBuilder(BlockBuilder **bb, const WriterOptions *options) {
+    *bb = new DeltaOfDeltaBlockBuilder<Type>(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder **bd, const Slice &slice,
+                                   CFileIterator *iter) {
+    *bd = new DeltaOfDeltaBlockDecoder<Type>(slice);
+    return Status::OK();
+  }
+};
+
+// XOR encoding for the floating point types.
+template<DataType Type>
+struct DataTypeEncodingTraits<Type, FLOAT_XOR> {
+
+  static Status CreateBlockBuilder(BlockBuilder **bb, const WriterOptions *options) {
+    *bb = new XorBlockBuilder<Type>(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder **bd, const Slice &slice,
+                                   CFileIterator *iter) {
+    *bd = new XorBlockDecoder<Type>(slice);
+    return Status::OK();
+  }
+};
+
 // Template specialization for plain encoded string as they require a
 // specific encoder/decoder.
 template<>
@@ -232,6 +268,12 @@ class TypeEncodingResolver {
     return default_mapping_[t];
   }
 
+  const vector<EncodingType>& GetSupportedEncodings(DataType t) {
+    static const vector<EncodingType> kNone;
+    const auto it = supported_encodings_.find(t);
+    return it == supported_encodings_.end() ? kNone : it->second;
+  }
+
   // Add the encoding mappings
   // the first encoder/decoder to be
   // added to the mapping becomes the default
@@ -240,31 +282,41 @@ class TypeEncodingResolver {
     AddMapping<UINT8, BIT_SHUFFLE>();
     AddMapping<UINT8, PLAIN_ENCODING>();
     AddMapping<UINT8, RLE>();
+    AddMapping<UINT8, DELTA_OF_DELTA>();
     AddMapping<INT8, BIT_SHUFFLE>();
     AddMapping<INT8, PLAIN_ENCODING>();
     AddMapping<INT8, RLE>();
+    AddMapping<INT8, DELTA_OF_DELTA>();
     AddMapping<UINT16, BIT_SHUFFLE>();
     AddMapping<UINT16, PLAIN_ENCODING>();
     AddMapping<UINT16, RLE>();
+    AddMapping<UINT16, DELTA_OF_DELTA>();
     AddMapping<INT16, BIT_SHUFFLE>();
     AddMapping<INT16, PLAIN_ENCODING>();
     AddMapping<INT16, RLE>();
+    AddMapping<INT16, DELTA_OF_DELTA>();
     AddMapping<UINT32, BIT_SHUFFLE>();
     AddMapping<UINT32, RLE>();
     AddMapping<UINT32, PLAIN_ENCODING>();
+    AddMapping<UINT32, DELTA_OF_DELTA>();
     AddMapping<INT32, BIT_SHUFFLE>();
     AddMapping<INT32, PLAIN_ENCODING>();
     AddMapping<INT32, RLE>();
+    AddMapping<INT32, DELTA_OF_DELTA>();
     AddMapping<UINT64, BIT_SHUFFLE>();
     AddMapping<UINT64, PLAIN_ENCODING>();
     AddMapping<UINT64, RLE>();
+    AddMapping<UINT64, DELTA_OF_DELTA>();
     AddMapping<INT64, BIT_SHUFFLE>();
     AddMapping<INT64, PLAIN_ENCODING>();
     AddMapping<INT64, RLE>();
+    AddMapping<INT64, DELTA_OF_DELTA>();
     AddMapping<FLOAT, BIT_SHUFFLE>();
     AddMapping<FLOAT, PLAIN_ENCODING>();
+    AddMapping<FLOAT, FLOAT_XOR>();
     AddMapping<DOUBLE, BIT_SHUFFLE>();
     AddMapping<DOUBLE, PLAIN_ENCODING>();
+    AddMapping<DOUBLE, FLOAT_XOR>();
     AddMapping<BINARY, DICT_ENCODING>();
     AddMapping<BINARY, PLAIN_ENCODING>();
     AddMapping<BINARY, PREFIX_ENCODING>();
@@ -277,6 +329,7 @@ class TypeEncodingResolver {
     pair<DataType, EncodingType> encoding_for_type = make_pair(type, encoding);
     if (mapping_.find(encoding_for_type) == mapping_.end()) {
       default_mapping_.insert(make_pair(type, encoding));
+      supported_encodings_[type].push_back(encoding);
     }
     mapping_.insert(
         make_pair(make_pair(type, encoding),
@@ -289,6 +342,8 @@ class TypeEncodingResolver {
 
   unordered_map<DataType, EncodingType, std::hash<size_t> > default_mapping_;
 
+  unordered_map<DataType, vector<EncodingType>, std::hash<size_t> > supported_encodings_;
+
   friend class Singleton<TypeEncodingResolver>;
   DISALLOW_COPY_AND_ASSIGN(TypeEncodingResolver);
 };
@@ -305,6 +360,11 @@ const EncodingType TypeEncodingInfo::GetDefaultEncoding(const TypeInfo* typeinfo
   return Singleton<TypeEncodingResolver>::get()->GetDefaultEncoding(typeinfo->physical_type());
 }
 
+const vector<EncodingType>& TypeEncodingInfo::GetSupportedEncodings(const TypeInfo* typeinfo) {
+  return Singleton<TypeEncodingResolver>::get()->GetSupportedEncodings(
+      typeinfo->physical_type());
+}
+
 }  // namespace cfile
 }  // namespace kudu
 
@@ -0,0 +1,340 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// XOR encoding for floating point types, as described in "Gorilla: A Fast,
+// Scalable, In-Memory Time Series Database" (Pelkonen et al, VLDB 2015).
+//
+// Each value is XORed bitwise with the previous value. Slowly changing
+// values share their sign, exponent and leading mantissa bits, so the
+// XOR has long runs of leading and trailing zeros and only the bits in
+// between (the "meaningful" bits) need to be stored:
+//
+//   '0'                 the value is identical to the previous value.
+//   '1' '0' <bits>      the meaningful bits fall within the window of the
+//                       previous stored XOR, and only the window is stored.
+//   '1' '1' <leading> <length - 1> <bits>
+//                       a new window: the number of leading zeros and the
+//                       number of meaningful bits are stored first.
+//
+// The first value is stored verbatim. The bit stream follows an 8-byte
+// header holding the number of elements and the first ordinal, in the same
+// layout as PlainBitMapBlockBuilder.
+//
+// Values have to be decoded sequentially, so seeking backwards within a
+// block restarts decoding from its beginning. Floating point columns can't
+// be part of a primary key, so seeking by value is not supported.
+#ifndef KUDU_CFILE_XOR_BLOCK_H
+#define KUDU_CFILE_XOR_BLOCK_H
+
+#include <algorithm>
+#include <string.h>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bit-stream-utils.inline.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+
+namespace kudu {
+namespace cfile {
+
+namespace xor_internal {
+
+// The unsigned integer type with the same width as a floating point type,
+// and the number of bits needed to store a count of leading zeros or a
+// number of meaningful bits (minus one) of a non-zero XOR of two values.
+template<DataType Type>
+struct XorTraits {};
+
+template<>
+struct XorTraits<FLOAT> {
+  typedef uint32_t UIntType;
+  static const int kCountBits = 5;
+  static int LeadingZeros(UIntType v) { return 31 - Bits::Log2FloorNonZero(v); }
+  static int TrailingZeros(UIntType v) { return Bits::FindLSBSetNonZero(v); }
+};
+
+template<>
+struct XorTraits<DOUBLE> {
+  typedef uint64_t UIntType;
+  static const int kCountBits = 6;
+  static int LeadingZeros(UIntType v) { return 63 - Bits::Log2FloorNonZero64(v); }
+  static int TrailingZeros(UIntType v) { return Bits::FindLSBSetNonZero64(v); }
+};
+
+static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+
+} // namespace xor_internal
+
+template<DataType Type>
+class XorBlockBuilder final : public BlockBuilder {
+ public:
+  explicit XorBlockBuilder(const WriterOptions* options)
+      : writer_(&buf_),
+        options_(options) {
+    Reset();
+  }
+
+  bool IsBlockFull() const OVERRIDE {
+    return writer_.bytes_written() > options_->storage_attributes.cfile_block_size;
+  }
+
+  int Add(const uint8_t* vals_void, size_t count) OVERRIDE {
+    const CppType* vals = reinterpret_cast<const CppType*>(vals_void);
+    for (size_t i = 0; i < count; i++) {
+      UIntType bits;
+      memcpy(&bits, &vals[i], sizeof(bits));
+      AddBits(bits);
+    }
+    return count;
+  }
+
+  Slice Finish(rowid_t ordinal_pos) OVERRIDE {
+    InlineEncodeFixed32(&buf_[0], count_);
+    InlineEncodeFixed32(&buf_[4], ordinal_pos);
+    writer_.Flush(false);
+    return Slice(buf_);
+  }
+
+  void Reset() OVERRIDE {
+    count_ = 0;
+    prev_bits_ = 0;
+    prev_leading_ = 0;
+    prev_trailing_ = 0;
+    have_window_ = false;
+    writer_.Clear();
+    // Reserve space for the header.
+    writer_.PutValue(0xdeadbeef, 32);
+    writer_.PutValue(0xdeadbeef, 32);
+  }
+
+  size_t Count() const OVERRIDE {
+    return count_;
+  }
+
+  Status GetFirstKey(void* key) const OVERRIDE {
+    if (count_ == 0) {
+      return Status::NotFound("no keys in data block");
+    }
+    memcpy(key, &first_bits_, sizeof(CppType));
+    return Status::OK();
+  }
+
+  Status GetLastKey(void* key) const OVERRIDE {
+    if (count_ == 0) {
+      return Status::NotFound("no keys in data block");
+    }
+    memcpy(key, &prev_bits_, sizeof(CppType));
+    return Status::OK();
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef xor_internal::XorTraits<Type> Traits;
+  typedef typename Traits::UIntType UIntType;
+  static const int kValueBits = sizeof(UIntType) * 8;
+
+  void AddBits(UIntType bits) {
+    if (PREDICT_FALSE(count_ == 0)) {
+      writer_.PutValue(bits, kValueBits);
+      first_bits_ = bits;
+    } else {
+      UIntType x = bits ^ prev_bits_;
+      if (x == 0) {
+        writer_.PutValue(0, 1);
+      } else {
+        int leading = Traits::LeadingZeros(x);
+        int trailing = Traits::TrailingZeros(x);
+        writer_.PutValue(1, 1);
+        if (have_window_ && leading >= prev_leading_ && trailing >= prev_trailing_) {
+          writer_.PutValue(0, 1);
+          writer_.PutValue(x >> prev_trailing_, kValueBits - prev_leading_ - prev_trailing_);
+        } else {
+          int length = kValueBits - leading - trailing;
+          writer_.PutValue(1, 1);
+          writer_.PutValue(leading, Traits::kCountBits);
+          writer_.PutValue(length - 1, Traits::kCountBits);
+          writer_.PutValue(x >> trailing, length);
+          prev_leading_ = leading;
+          prev_trailing_ = trailing;
+          have_window_ = true;
+        }
+      }
+    }
+    prev_bits_ = bits;
+    count_++;
+  }
+
+  faststring buf_;
+  BitWriter writer_;
+  size_t count_;
+
+  UIntType first_bits_;
+  UIntType prev_bits_;
+  int prev_leading_;
+  int prev_trailing_;
+  bool have_window_;
+
+  const WriterOptions* const options_;
+};
+
+template<DataType Type>
+class XorBlockDecoder final : public BlockDecoder {
+ public:
+  explicit XorBlockDecoder(Slice slice)
+      : data_(std::move(slice)),
+        parsed_(false),
+        num_elems_(0),
+        ordinal_pos_base_(0) {
+  }
+
+  Status ParseHeader() OVERRIDE {
+    CHECK(!parsed_);
+    if (data_.size() < xor_internal::kHeaderSize) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for header: $0", data_.size()));
+    }
+    num_elems_ = DecodeFixed32(&data_[0]);
+    ordinal_pos_base_ = DecodeFixed32(&data_[4]);
+    parsed_ = true;
+    Restart();
+    return Status::OK();
+  }
+
+  void SeekToPositionInBlock(uint pos) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    DCHECK_LE(pos, num_elems_);
+    if (pos < cur_idx_) {
+      Restart();
+    }
+    while (cur_idx_ < pos) {
+      UIntType unused;
+      if (PREDICT_FALSE(!DecodeNext(&unused))) {
+        // Corruption will be reported by the next CopyNextValues() call.
+        break;
+      }
+    }
+  }
+
+  Status SeekAtOrAfterValue(const void* value, bool* exact) OVERRIDE {
+    return Status::NotSupported("seeking by value not supported by XOR encoding");
+  }
+
+  Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+    size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    uint8_t* out = dst->data();
+    for (size_t i = 0; i < max_fetch; i++) {
+      UIntType bits;
+      if (PREDICT_FALSE(!DecodeNext(&bits))) {
+        return Status::Corruption(strings::Substitute(
+            "unable to decode value $0 of $1 in XOR block", cur_idx_, num_elems_));
+      }
+      memcpy(out, &bits, sizeof(bits));
+      out += sizeof(bits);
+    }
+    *n = max_fetch;
+    return Status::OK();
+  }
+
+  bool HasNext() const OVERRIDE {
+    return cur_idx_ < num_elems_;
+  }
+
+  size_t Count() const OVERRIDE {
+    return num_elems_;
+  }
+
+  size_t GetCurrentIndex() const OVERRIDE {
+    return cur_idx_;
+  }
+
+  rowid_t GetFirstRowId() const OVERRIDE {
+    return ordinal_pos_base_;
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef xor_internal::XorTraits<Type> Traits;
+  typedef typename Traits::UIntType UIntType;
+  static const int kValueBits = sizeof(UIntType) * 8;
+
+  // Reset the decoder to the first value in the block.
+  void Restart() {
+    reader_ = BitReader(data_.data() + xor_internal::kHeaderSize,
+                        data_.size() - xor_internal::kHeaderSize);
+    cur_idx_ = 0;
+    prev_bits_ = 0;
+    leading_ = 0;
+    trailing_ = 0;
+  }
+
+  // Decode the next value into 'bits' and advance. Returns false if the
+  // stream is truncated or malformed.
+  bool DecodeNext(UIntType* bits) {
+    if (PREDICT_FALSE(cur_idx_ == 0)) {
+      if (!reader_.GetValue(kValueBits, &prev_bits_)) return false;
+    } else {
+      uint8_t control;
+      if (!reader_.GetValue(1, &control)) return false;
+      if (control) {
+        if (!reader_.GetValue(1, &control)) return false;
+        if (control) {
+          uint8_t leading;
+          uint8_t length;
+          if (!reader_.GetValue(Traits::kCountBits, &leading) ||
+              !reader_.GetValue(Traits::kCountBits, &length)) {
+            return false;
+          }
+          length++;
+          if (PREDICT_FALSE(leading + length > kValueBits)) return false;
+          leading_ = leading;
+          trailing_ = kValueBits - leading - length;
+        }
+        UIntType meaningful;
+        if (!reader_.GetValue(kValueBits - leading_ - trailing_, &meaningful)) return false;
+        prev_bits_ ^= meaningful << trailing_;
+      }
+    }
+    *bits = prev_bits_;
+    cur_idx_++;
+    return true;
+  }
+
+  Slice data_;
+  bool parsed_;
+  uint32_t num_elems_;
+  rowid_t ordinal_pos_base_;
+
+  BitReader reader_;
+  size_t cur_idx_;
+  UIntType prev_bits_;
+  int leading_;
+  int trailing_;
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif
@@ -0,0 +1,184 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/zone_map.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/types.h"
+#include "kudu/util/logging.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/slice.h"
+
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+// Binary values longer than this are not tracked, to keep the zone map from
+// growing with the size of the data.
+static const size_t kMaxBinaryValueSize = 256;
+
+////////////////////////////////////////////////////////////
+// ZoneMapBuilder
+////////////////////////////////////////////////////////////
+
+ZoneMapBuilder::ZoneMapBuilder(const TypeInfo* type_info)
+    : type_info_(type_info) {
+  Reset();
+}
+
+void ZoneMapBuilder::Reset() {
+  min_.clear();
+  max_.clear();
+  has_values_ = false;
+  values_too_large_ = false;
+  null_count_ = 0;
+}
+
+void ZoneMapBuilder::AddValues(const void* cells, size_t count) {
+  if (count == 0 || values_too_large_) {
+    return;
+  }
+  const uint8_t* cell = reinterpret_cast<const uint8_t*>(cells);
+
+  if (type_info_->physical_type() == BINARY) {
+    for (size_t i = 0; i < count; i++, cell += sizeof(Slice)) {
+      const Slice* val = reinterpret_cast<const Slice*>(cell);
+      if (PREDICT_FALSE(val->size() > kMaxBinaryValueSize)) {
+        values_too_large_ = true;
+        return;
+      }
+      if (!has_values_ || val->compare(Slice(min_)) < 0) {
+        min_.assign_copy(val->data(), val->size());
+      }
+      if (!has_values_ || val->compare(Slice(max_)) > 0) {
+        max_.assign_copy(val->data(), val->size());
+      }
+      has_values_ = true;
+    }
+    return;
+  }
+
+  const size_t size = type_info_->size();
+  for (size_t i = 0; i < count; i++, cell += size) {
+    if (!has_values_ || type_info_->Compare(cell, min_.data()) < 0) {
+      min_.assign_copy(cell, size);
+    }
+    if (!has_values_ || type_info_->Compare(cell, max_.data()) > 0) {
+      max_.assign_copy(cell, size);
+    }
+    has_values_ = true;
+  }
+}
+
+void ZoneMapBuilder::AddNulls(size_t count) {
+  null_count_ += count;
+}
+
+void ZoneMapBuilder::FinishBlock(rowid_t first_ordinal, size_t num_rows) {
+  DCHECK_LE(null_count_, num_rows);
+  ZoneMapEntryPB* entry = zone_map_.add_entries();
+  entry->set_first_ordinal(first_ordinal);
+  entry->set_num_rows(num_rows);
+  if (null_count_ > 0) {
+    entry->set_null_count(null_count_);
+  }
+  if (has_values_ && !values_too_large_) {
+    entry->set_min_value(min_.data(), min_.size());
+    entry->set_max_value(max_.data(), max_.size());
+  }
+  Reset();
+}
+
+////////////////////////////////////////////////////////////
+// ZoneMap
+////////////////////////////////////////////////////////////
+
+ZoneMap::ZoneMap(const TypeInfo* type_info)
+    : type_info_(type_info) {
+}
+
+Status ZoneMap::Parse(const TypeInfo* type_info, const Slice& data,
+                      gscoped_ptr<ZoneMap>* zone_map) {
+  gscoped_ptr<ZoneMap> zm(new ZoneMap(type_info));
+  if (!zm->pb_.ParseFromArray(data.data(), data.size())) {
+    return Status::Corruption("unable to parse zone map");
+  }
+
+  int64_t next_ordinal = 0;
+  for (const ZoneMapEntryPB& entry : zm->pb_.entries()) {
+    if (PREDICT_FALSE(entry.first_ordinal() < next_ordinal ||
+                      entry.null_count() > entry.num_rows() ||
+                      entry.has_min_value() != entry.has_max_value())) {
+      return Status::Corruption("invalid zone map entry",
+                                KUDU_REDACT(entry.ShortDebugString()));
+    }
+    if (type_info->physical_type() != BINARY && entry.has_min_value() &&
+        PREDICT_FALSE(entry.min_value().size() != type_info->size() ||
+                      entry.max_value().size() != type_info->size())) {
+      return Status::Corruption(Substitute("zone map value has bad size for type $0",
+                                           type_info->name()));
+    }
+    next_ordinal = entry.first_ordinal() + entry.num_rows();
+  }
+
+  zone_map->reset(zm.release());
+  return Status::OK();
+}
+
+const ZoneMapEntryPB* ZoneMap::FindEntry(rowid_t first_ordinal) const {
+  const auto& entries = pb_.entries();
+  auto it = std::lower_bound(entries.begin(), entries.end(), first_ordinal,
+                             [](const ZoneMapEntryPB& entry, rowid_t ord) {
+                               return entry.first_ordinal() < ord;
+                             });
+  if (it == entries.end() || it->first_ordinal() != first_ordinal) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+bool ZoneMap::MayMatch(const ZoneMapEntryPB& entry, const ColumnPredicate& pred) const {
+  // Null cells never satisfy any of the supported predicate types.
+  if (entry.null_count() == entry.num_rows()) {
+    return false;
+  }
+  if (!entry.has_min_value()) {
+    return true;
+  }
+
+  if (type_info_->physical_type() == BINARY) {
+    Slice min(entry.min_value());
+    Slice max(entry.max_value());
+    return pred.MayMatchRange(&min, &max);
+  }
+
+  // The serialized values may not be suitably aligned for the cell type.
+  uint64_t min[2];
+  uint64_t max[2];
+  DCHECK_LE(type_info_->size(), sizeof(min));
+  memcpy(min, entry.min_value().data(), type_info_->size());
+  memcpy(max, entry.max_value().data(), type_info_->size());
+  return pred.MayMatchRange(min, max);
+}
+
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CFILE_ZONE_MAP_H
+#define KUDU_CFILE_ZONE_MAP_H
+
+#include <stddef.h>
+
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/common/rowid.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnPredicate;
+class TypeInfo;
+
+namespace cfile {
+
+// Accumulates the min/max value and null count of each data block as a
+// cfile is written, producing a ZoneMapPB.
+class ZoneMapBuilder {
+ public:
+  explicit ZoneMapBuilder(const TypeInfo* type_info);
+
+  // Account for 'count' consecutive non-null cells starting at 'cells'.
+  void AddValues(const void* cells, size_t count);
+
+  // Account for 'count' null cells.
+  void AddNulls(size_t count);
+
+  // Record an entry for the data block containing all cells added since the
+  // previous call, and reset the per-block state.
+  void FinishBlock(rowid_t first_ordinal, size_t num_rows);
+
+  const ZoneMapPB& zone_map() const { return zone_map_; }
+
+ private:
+  void Reset();
+
+  const TypeInfo* const type_info_;
+
+  // Min and max non-null values of the current block, in cell format for
+  // fixed-size types or as raw bytes for binary types. Only meaningful if
+  // 'has_values_' is true.
+  faststring min_;
+  faststring max_;
+  bool has_values_;
+
+  // Set if a binary value was too large to track; no min/max are recorded
+  // for the block in that case.
+  bool values_too_large_;
+
+  size_t null_count_;
+
+  ZoneMapPB zone_map_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZoneMapBuilder);
+};
+
+// Read-side wrapper around a ZoneMapPB.
+class ZoneMap {
+ public:
+  // Parse and validate a serialized ZoneMapPB for a column of type
+  // 'type_info'.
+  static Status Parse(const TypeInfo* type_info, const Slice& data,
+                      gscoped_ptr<ZoneMap>* zone_map);
+
+  // Return the entry for the data block whose first row is 'first_ordinal',
+  // or nullptr if there is no such entry.
+  const ZoneMapEntryPB* FindEntry(rowid_t first_ordinal) const;
+
+  // Return false if no row of the block described by 'entry' can satisfy
+  // 'pred'. A return value of true means the block may contain matches.
+  bool MayMatch(const ZoneMapEntryPB& entry, const ColumnPredicate& pred) const;
+
+  size_t memory_footprint_excluding_this() const {
+    return pb_.SpaceUsed() - sizeof(pb_);
+  }
+
+ private:
+  explicit ZoneMap(const TypeInfo* type_info);
+
+  const TypeInfo* const type_info_;
+  ZoneMapPB pb_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZoneMap);
+};
+
+} // namespace cfile
+} // namespace kudu
+
+#endif
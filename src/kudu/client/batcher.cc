@@ -27,6 +27,7 @@
 #include <vector>
 
 #include <boost/bind.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/client/callbacks.h"
@@ -51,9 +52,17 @@
 #include "kudu/rpc/rpc.h"
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/debug-util.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/pb_util.h"
 
+DEFINE_bool(client_group_writes_by_server, false,
+            "Whether the writes of a flush to the tablets led by the same tablet server "
+            "are sent in a single MultiWrite RPC, rather than in one Write RPC per "
+            "tablet.");
+TAG_FLAG(client_group_writes_by_server, experimental);
+TAG_FLAG(client_group_writes_by_server, runtime);
+
 using std::pair;
 using std::set;
 using std::shared_ptr;
@@ -72,6 +81,8 @@ using rpc::RetriableRpcStatus;
 using rpc::Rpc;
 using rpc::RpcController;
 using rpc::ServerPicker;
+using tserver::MultiWriteRequestPB;
+using tserver::MultiWriteResponsePB;
 using tserver::WriteRequestPB;
 using tserver::WriteResponsePB;
 using tserver::WriteResponsePB_PerRowErrorPB;
@@ -187,6 +198,146 @@ struct InFlightOp {
   }
 };
 
+// Groups the first attempts of the WriteRpcs of a flush by the tablet server
+// they are sent to, and sends the writes to each server in a MultiWrite RPC
+// once the flush has created all of its WriteRpcs. The response to each write
+// is dispatched to its WriteRpc as if the write had been sent on its own.
+//
+// Each write carries the request id of its WriteRpc, so that the server tracks
+// its result as it does for a Write RPC, and a retry of the write is not
+// applied again. If a MultiWrite RPC is rejected without being run, for example
+// because the server does not support it, its writes are sent again one by
+// one. If it fails otherwise, for example with a timeout or a network error,
+// its writes may have been applied, so each WriteRpc is handed the failure as
+// if its own RPC had failed with it.
+class MultiWriteCollector : public RefCountedThreadSafe<MultiWriteCollector> {
+ public:
+  struct PendingWrite {
+    WriteRequestPB* req;
+    WriteResponsePB* resp;
+    RpcController* controller;
+    // Set to the status of the MultiWrite RPC before 'callback' is called,
+    // if the RPC failed as a whole.
+    Status* rpc_status;
+    ResponseCallback callback;
+  };
+
+  MultiWriteCollector() : sent_(false) {}
+
+  // Adds 'write' to the writes sent to 'ts'. Returns false if the writes
+  // were already sent, in which case the caller must send 'write' itself.
+  bool Add(RemoteTabletServer* ts, PendingWrite write);
+
+  // Sends the writes added so far, with the given deadline.
+  void Send(const MonoTime& deadline);
+
+ private:
+  friend class RefCountedThreadSafe<MultiWriteCollector>;
+  ~MultiWriteCollector() {}
+
+  // The writes sent to a server in one MultiWrite RPC.
+  struct Batch {
+    std::vector<PendingWrite> writes;
+    MultiWriteRequestPB req;
+    MultiWriteResponsePB resp;
+    RpcController controller;
+  };
+
+  // Dispatches the responses of 'batch' to the callers of its writes.
+  static void BatchResponseReceived(RemoteTabletServer* ts, const shared_ptr<Batch>& batch);
+
+  static void SendIndividually(RemoteTabletServer* ts, const std::vector<PendingWrite>& writes);
+
+  simple_spinlock lock_;
+  bool sent_;
+  unordered_map<RemoteTabletServer*, std::vector<PendingWrite>> writes_by_server_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiWriteCollector);
+};
+
+bool MultiWriteCollector::Add(RemoteTabletServer* ts, PendingWrite write) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (sent_) {
+    return false;
+  }
+  writes_by_server_[ts].emplace_back(std::move(write));
+  return true;
+}
+
+void MultiWriteCollector::Send(const MonoTime& deadline) {
+  unordered_map<RemoteTabletServer*, std::vector<PendingWrite>> writes_by_server;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    sent_ = true;
+    writes_by_server.swap(writes_by_server_);
+  }
+  for (auto& e : writes_by_server) {
+    RemoteTabletServer* ts = e.first;
+    if (e.second.size() == 1) {
+      SendIndividually(ts, e.second);
+      continue;
+    }
+    shared_ptr<Batch> batch(new Batch());
+    batch->writes.swap(e.second);
+    // The requests are moved into the batch, and moved back before their
+    // responses are dispatched, since the WriteRpcs may retry them.
+    for (const PendingWrite& write : batch->writes) {
+      batch->req.add_requests()->Swap(write.req);
+      DCHECK(write.controller->has_request_id());
+      *batch->req.add_request_ids() = write.controller->request_id();
+    }
+    batch->controller.set_deadline(deadline);
+    VLOG(2) << "Writing batch of " << batch->writes.size() << " tablets to "
+            << ts->ToString();
+    ts->proxy()->MultiWriteAsync(batch->req, &batch->resp, &batch->controller,
+                                 boost::bind(&MultiWriteCollector::BatchResponseReceived,
+                                             ts, batch));
+  }
+}
+
+void MultiWriteCollector::BatchResponseReceived(RemoteTabletServer* ts,
+                                                const shared_ptr<Batch>& batch) {
+  for (size_t i = 0; i < batch->writes.size(); i++) {
+    batch->writes[i].req->Swap(batch->req.mutable_requests(i));
+  }
+  Status s = batch->controller.status();
+  if (PREDICT_FALSE(!s.ok())) {
+    const ErrorStatusPB* err = batch->controller.error_response();
+    if (s.IsRemoteError() && err && err->has_code() &&
+        (err->code() == ErrorStatusPB::ERROR_NO_SUCH_METHOD ||
+         err->code() == ErrorStatusPB::ERROR_NO_SUCH_SERVICE ||
+         err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY)) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << "Batch of " << batch->writes.size() << " writes to "
+                                     << ts->ToString() << " was rejected, sending them "
+                                     << "individually: " << s.ToString();
+      SendIndividually(ts, batch->writes);
+      return;
+    }
+  } else if (PREDICT_FALSE(batch->resp.responses_size() != batch->writes.size())) {
+    s = Status::RemoteError(Substitute("Got $0 responses to a batch of $1 writes",
+                                       batch->resp.responses_size(), batch->writes.size()));
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    for (const PendingWrite& write : batch->writes) {
+      *write.rpc_status = s;
+      write.callback();
+    }
+    return;
+  }
+  for (size_t i = 0; i < batch->writes.size(); i++) {
+    const PendingWrite& write = batch->writes[i];
+    write.resp->Swap(batch->resp.mutable_responses(i));
+    write.callback();
+  }
+}
+
+void MultiWriteCollector::SendIndividually(RemoteTabletServer* ts,
+                                           const std::vector<PendingWrite>& writes) {
+  for (const PendingWrite& write : writes) {
+    ts->proxy()->WriteAsync(*write.req, write.resp, write.controller, write.callback);
+  }
+}
+
 // A Write RPC which is in-flight to a tablet. Initially, the RPC is sent
 // to the leader replica, but it may be retried with another replica if the
 // leader fails.
@@ -214,6 +365,11 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
   const WriteResponsePB& resp() const { return resp_; }
   const string& tablet_id() const { return tablet_id_; }
 
+  // Makes the first attempt of the RPC go through 'collector'.
+  void set_collector(scoped_refptr<MultiWriteCollector> collector) {
+    collector_ = std::move(collector);
+  }
+
  protected:
   void Try(RemoteTabletServer* replica, const ResponseCallback& callback) override;
   RetriableRpcStatus AnalyzeResponse(const Status& rpc_cb_status) override;
@@ -230,6 +386,14 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
 
   // The id of the tablet being written to.
   string tablet_id_;
+
+  // The collector which the next attempt is sent through, if any.
+  scoped_refptr<MultiWriteCollector> collector_;
+
+  // The failure of the MultiWrite RPC which the last attempt was sent in, if
+  // any. It takes the place of the status of the RPC controller, which wasn't
+  // used to send the attempt.
+  Status multi_write_status_;
 };
 
 WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
@@ -310,6 +474,14 @@ string WriteRpc::ToString() const {
 
 void WriteRpc::Try(RemoteTabletServer* replica, const ResponseCallback& callback) {
   VLOG(2) << "Tablet " << tablet_id_ << ": Writing batch to replica " << replica->ToString();
+  if (collector_) {
+    scoped_refptr<MultiWriteCollector> collector;
+    collector.swap(collector_);
+    if (collector->Add(replica, { &req_, &resp_, mutable_retrier()->mutable_controller(),
+                                  &multi_write_status_, callback })) {
+      return;
+    }
+  }
   replica->proxy()->WriteAsync(req_, &resp_,
                                mutable_retrier()->mutable_controller(),
                                callback);
@@ -328,17 +500,34 @@ void WriteRpc::Finish(const Status& status) {
 }
 
 RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
+  Status cb_status = rpc_cb_status;
+  if (PREDICT_FALSE(!multi_write_status_.ok())) {
+    cb_status = multi_write_status_;
+    multi_write_status_ = Status::OK();
+  }
+  RetriableRpcStatus result = AnalyzeWriteRpcResponse(cb_status,
+                                                      mutable_retrier()->controller(),
+                                                      resp_);
+  if (result.result == RetriableRpcStatus::SERVER_BUSY) {
+    batcher_->server_busy_count_.Increment();
+  }
+  return result;
+}
+
+RetriableRpcStatus AnalyzeWriteRpcResponse(const Status& rpc_cb_status,
+                                           const RpcController& controller,
+                                           const WriteResponsePB& resp) {
   RetriableRpcStatus result;
   result.status = rpc_cb_status;
 
   // If we didn't fail on tablet lookup/proxy initialization, check if we failed actually performing
   // the write.
   if (rpc_cb_status.ok()) {
-    result.status = mutable_retrier()->controller().status();
+    result.status = controller.status();
   }
 
   if (result.status.IsRemoteError()) {
-    const ErrorStatusPB* err = mutable_retrier()->controller().error_response();
+    const ErrorStatusPB* err = controller.error_response();
     if (err &&
         err->has_code() &&
         err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY) {
@@ -357,12 +546,21 @@ RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
   }
 
   // Prefer controller failures over response failures.
-  if (result.status.ok() && resp_.has_error()) {
-    result.status = StatusFromPB(resp_.error().status());
+  if (result.status.ok() && resp.has_error()) {
+    result.status = StatusFromPB(resp.error().status());
+
+    // A write of a MultiWrite RPC rejected because the server is too busy
+    // carries the error which would otherwise have failed the whole RPC.
+    if (result.status.IsServiceUnavailable() &&
+        (resp.error().code() == tserver::TabletServerErrorPB::THROTTLED ||
+         resp.error().code() == tserver::TabletServerErrorPB::UNKNOWN_ERROR)) {
+      result.result = RetriableRpcStatus::SERVER_BUSY;
+      return result;
+    }
   }
 
   // If we get TABLET_NOT_FOUND, the replica we thought was leader has been deleted.
-  if (resp_.has_error() && resp_.error().code() == tserver::TabletServerErrorPB::TABLET_NOT_FOUND) {
+  if (resp.has_error() && resp.error().code() == tserver::TabletServerErrorPB::TABLET_NOT_FOUND) {
     result.result = RetriableRpcStatus::RESOURCE_NOT_FOUND;
     return result;
   }
@@ -398,6 +596,7 @@ Batcher::Batcher(KuduClient* client,
     weak_session_(std::move(session)),
     consistency_mode_(consistency_mode),
     error_collector_(std::move(error_collector)),
+    server_busy_count_(0),
     had_errors_(false),
     flush_callback_(nullptr),
     next_op_sequence_number_(0),
@@ -500,6 +699,7 @@ void Batcher::FlushAsync(KuduStatusCallback* cb) {
     state_ = kFlushing;
     flush_callback_ = cb;
     deadline_ = ComputeDeadlineUnlocked();
+    flush_start_time_ = MonoTime::Now();
   }
 
   // In the case that we have nothing buffered, just call the callback
@@ -675,6 +875,11 @@ void Batcher::FlushBuffersIfReady() {
     ops_copy.swap(per_tablet_ops_);
   }
 
+  scoped_refptr<MultiWriteCollector> collector;
+  if (FLAGS_client_group_writes_by_server && ops_copy.size() > 1) {
+    collector = new MultiWriteCollector();
+  }
+
   // Now flush the ops for each tablet.
   for (const OpsMap::value_type& e : ops_copy) {
     RemoteTablet* tablet = e.first;
@@ -682,11 +887,16 @@ void Batcher::FlushBuffersIfReady() {
 
     VLOG(3) << "FlushBuffersIfReady: already in flushing state, immediately flushing to "
             << tablet->tablet_id();
-    FlushBuffer(tablet, ops);
+    FlushBuffer(tablet, ops, collector);
+  }
+
+  if (collector) {
+    collector->Send(deadline_);
   }
 }
 
-void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops) {
+void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops,
+                          const scoped_refptr<MultiWriteCollector>& collector) {
   CHECK(!ops.empty());
 
   // Create and send an RPC that aggregates the ops. The RPC is freed when
@@ -709,6 +919,9 @@ void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops)
                                client_->data_->messenger_,
                                tablet->tablet_id(),
                                client_->data_->GetLatestObservedTimestamp());
+  if (collector) {
+    rpc->set_collector(collector);
+  }
   rpc->SendRpc();
 }
 
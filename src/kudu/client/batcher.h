@@ -25,6 +25,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/rpc/rpc.h"
 #include "kudu/util/async_util.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/debug-util.h"
@@ -32,6 +33,15 @@
 #include "kudu/util/status.h"
 
 namespace kudu {
+
+namespace rpc {
+class RpcController;
+} // namespace rpc
+
+namespace tserver {
+class WriteResponsePB;
+} // namespace tserver
+
 namespace client {
 
 class KuduClient;
@@ -44,6 +54,7 @@ namespace internal {
 struct InFlightOp;
 
 class ErrorCollector;
+class MultiWriteCollector;
 class RemoteTablet;
 class WriteRpc;
 
@@ -117,6 +128,19 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
     return first_op_time_;
   }
 
+  // Get the time when the batcher started flushing. If the batcher is not
+  // flushing yet, the returned MonoTime object is not initialized.
+  const MonoTime& flush_start_time() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return flush_start_time_;
+  }
+
+  // Return the number of times the write RPCs of this batcher were rejected
+  // because a server was too busy.
+  int32_t server_busy_count() const {
+    return server_busy_count_.Load();
+  }
+
   // Return the total size (number of bytes) of all pending write operations
   // accumulated by the batcher.
   int64_t buffer_bytes_used() const {
@@ -155,7 +179,10 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
 
   void CheckForFinishedFlush();
   void FlushBuffersIfReady();
-  void FlushBuffer(RemoteTablet* tablet, const std::vector<InFlightOp*>& ops);
+  // Sends 'ops' to 'tablet'. If 'collector' is not null, the first attempt
+  // to send them may be grouped with the writes to other tablets.
+  void FlushBuffer(RemoteTablet* tablet, const std::vector<InFlightOp*>& ops,
+                   const scoped_refptr<MultiWriteCollector>& collector);
 
   // Cleans up an RPC response, scooping out any errors and passing them up
   // to the batcher.
@@ -191,6 +218,13 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   // The time when the very first operation was added into the batcher.
   MonoTime first_op_time_;
 
+  // The time when the batcher started flushing.
+  // Protected by lock_
+  MonoTime flush_start_time_;
+
+  // The number of write RPCs rejected because a server was too busy.
+  AtomicInt<int32_t> server_busy_count_;
+
   // Set to true if there was at least one error from this Batcher.
   // Protected by lock_
   bool had_errors_;
@@ -232,6 +266,13 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
   DISALLOW_COPY_AND_ASSIGN(Batcher);
 };
 
+// Decides how to proceed with a write RPC to a tablet, given the status
+// 'rpc_cb_status' of its last attempt and the 'controller' and 'resp' of the
+// attempt.
+rpc::RetriableRpcStatus AnalyzeWriteRpcResponse(const Status& rpc_cb_status,
+                                                const rpc::RpcController& controller,
+                                                const tserver::WriteResponsePB& resp);
+
 } // namespace internal
 } // namespace client
 } // namespace kudu
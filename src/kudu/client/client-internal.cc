@@ -24,6 +24,8 @@
 #include <string>
 #include <vector>
 
+#include <gflags/gflags.h>
+
 #include "kudu/client/meta_cache.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
@@ -40,11 +42,20 @@
 #include "kudu/rpc/rpc.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/net/dns_resolver.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/thread_restrictions.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_bool(client_latency_aware_replica_selection, false,
+            "Whether scans using the CLOSEST_REPLICA selection send their requests "
+            "to the replica with the lowest observed RPC latency, rather than to a "
+            "local replica or a random one.");
+TAG_FLAG(client_latency_aware_replica_selection, experimental);
+TAG_FLAG(client_latency_aware_replica_selection, runtime);
 
 using std::set;
 using std::shared_ptr;
@@ -283,6 +294,9 @@ KuduClient::Data::~Data() {
   // fix urgently, because typically once a client is shutting down, latency
   // jitter on the reactor is not a big deal (and DNS resolutions are not in flight).
   ThreadRestrictions::ScopedAllowWait allow_wait;
+  if (async_pool_) {
+    async_pool_->Shutdown();
+  }
   dns_resolver_.reset();
 }
 
@@ -320,6 +334,12 @@ RemoteTabletServer* KuduClient::Data::SelectTServer(const scoped_refptr<RemoteTa
           ret = filtered[0];
         }
       } else if (selection == CLOSEST_REPLICA) {
+        if (FLAGS_client_latency_aware_replica_selection) {
+          if (!filtered.empty()) {
+            ret = SelectFastestTServer(filtered);
+          }
+          break;
+        }
         // Choose a local replica.
         for (RemoteTabletServer* rts : filtered) {
           if (IsTabletServerLocal(*rts)) {
@@ -343,6 +363,32 @@ RemoteTabletServer* KuduClient::Data::SelectTServer(const scoped_refptr<RemoteTa
   return ret;
 }
 
+RemoteTabletServer* KuduClient::Data::SelectFastestTServer(
+    const vector<RemoteTabletServer*>& filtered) const {
+  DCHECK(!filtered.empty());
+  // Once in a while, pick a random replica so that the latency estimates of
+  // the replicas which are not the fastest stay current, and a replica which
+  // was slow for a while gets a chance to prove it recovered.
+  if (rand() % 20 == 0) {
+    return filtered[rand() % filtered.size()];
+  }
+  RemoteTabletServer* best = nullptr;
+  int64_t best_us = std::numeric_limits<int64_t>::max();
+  bool best_local = false;
+  for (RemoteTabletServer* rts : filtered) {
+    MonoDelta mean;
+    MonoDelta deviation;
+    int64_t us = rts->GetLatencyEstimate(&mean, &deviation) ? mean.ToMicroseconds() : 0;
+    bool local = IsTabletServerLocal(*rts);
+    if (us < best_us || (us == best_us && local && !best_local)) {
+      best = rts;
+      best_us = us;
+      best_local = local;
+    }
+  }
+  return best;
+}
+
 Status KuduClient::Data::GetTabletServer(KuduClient* client,
                                          const scoped_refptr<RemoteTablet>& rt,
                                          ReplicaSelection selection,
@@ -36,6 +36,7 @@ namespace kudu {
 
 class DnsResolver;
 class HostPort;
+class ThreadPool;
 
 namespace master {
 class AlterTableRequestPB;
@@ -129,6 +130,12 @@ class KuduClient::Data {
       const std::set<std::string>& blacklist,
       std::vector<internal::RemoteTabletServer*>* candidates) const;
 
+  // Returns the replica among 'filtered' with the lowest estimated RPC
+  // latency, preferring local replicas on ties. Replicas whose latency is
+  // not known yet are tried first. 'filtered' must not be empty.
+  internal::RemoteTabletServer* SelectFastestTServer(
+      const std::vector<internal::RemoteTabletServer*>& filtered) const;
+
   // Sets 'master_proxy_' from the address specified by
   // 'leader_master_hostport_'.  Called by
   // GetLeaderMasterRpc::SendRpcCb() upon successful completion.
@@ -208,6 +215,11 @@ class KuduClient::Data {
   gscoped_ptr<DnsResolver> dns_resolver_;
   scoped_refptr<internal::MetaCache> meta_cache_;
 
+  // Runs the parts of asynchronous operations which block, such as the
+  // lookups of tablet locations when a scanner opens a tablet, so that
+  // they don't run on the reactor threads.
+  gscoped_ptr<ThreadPool> async_pool_;
+
   // Set of hostnames and IPs on the local host.
   // This is initialized at client startup.
   std::unordered_set<std::string> local_host_names_;
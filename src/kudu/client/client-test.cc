@@ -55,6 +55,8 @@
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/server/hybrid_clock.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/tserver/mini_tablet_server.h"
@@ -72,6 +74,11 @@
 DECLARE_bool(fail_dns_resolution);
 DECLARE_bool(log_inject_latency);
 DECLARE_bool(allow_unsafe_replication_factor);
+DECLARE_bool(client_group_writes_by_server);
+DECLARE_bool(multi_write_inject_failure_after_apply);
+DECLARE_bool(client_hedged_scan_open);
+DECLARE_bool(client_latency_aware_replica_selection);
+DECLARE_int32(client_hedged_scan_open_min_delay_ms);
 DECLARE_int32(heartbeat_interval_ms);
 DECLARE_int32(leader_failure_exp_backoff_max_delta_ms);
 DECLARE_int32(log_inject_latency_ms_mean);
@@ -90,6 +97,7 @@ METRIC_DECLARE_counter(rpcs_queue_overflow);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetMasterRegistration);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTableLocations);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTabletLocations);
+METRIC_DECLARE_histogram(handler_latency_kudu_tserver_TabletServerService_MultiWrite);
 
 using std::bind;
 using std::for_each;
@@ -894,6 +902,39 @@ TEST_F(ClientTest, TestScanMultiTablet) {
                                    kNoBound));
 }
 
+// Test scanning a table with multiple tablets using the asynchronous API.
+TEST_F(ClientTest, TestAsyncScan) {
+  const int kNumRows = 100;
+  {
+    shared_ptr<KuduTable> table;
+    NO_FATALS(CreateTable("async scan", 1, GenerateSplitRows(), {}, &table));
+    NO_FATALS(InsertTestRows(table.get(), kNumRows));
+  }
+
+  Synchronizer sync;
+  KuduStatusMemberCallback<Synchronizer> cb(&sync, &Synchronizer::StatusCB);
+  shared_ptr<KuduTable> table;
+  client_->OpenTableAsync("async scan", &table, &cb);
+  ASSERT_OK(sync.Wait());
+
+  KuduScanner scanner(table.get());
+  // Use small batches so that the tablets are scanned in several RPCs.
+  ASSERT_OK(scanner.SetBatchSizeBytes(100));
+  sync.Reset();
+  scanner.OpenAsync(&cb);
+  ASSERT_OK(sync.Wait());
+
+  int num_rows = 0;
+  KuduScanBatch batch;
+  while (scanner.HasMoreRows()) {
+    sync.Reset();
+    scanner.NextBatchAsync(&batch, &cb);
+    ASSERT_OK(sync.Wait());
+    num_rows += batch.NumRows();
+  }
+  ASSERT_EQ(kNumRows, num_rows);
+}
+
 TEST_F(ClientTest, TestScanEmptyTable) {
   KuduScanner scanner(client_table_.get());
   ASSERT_OK(scanner.SetProjectedColumns(vector<string>()));
@@ -1484,6 +1525,47 @@ TEST_F(ClientTest, TestMetaCacheExpiry) {
   ASSERT_FALSE(entry.stale());
 }
 
+// Looks up tablets from several threads while another thread keeps clearing
+// the meta cache, so that lookups race with the master responses that update
+// the cached tablet servers under the meta cache's write lock.
+TEST_F(ClientTest, TestConcurrentMetaCacheLookupsAndUpdates) {
+  const int kNumLookupThreads = 4;
+  const MonoDelta kRunTime = MonoDelta::FromMilliseconds(AllowSlowTests() ? 5000 : 500);
+  auto& meta_cache = client_->data_->meta_cache_;
+
+  std::atomic<bool> done(false);
+  vector<thread> threads;
+  for (int i = 0; i < kNumLookupThreads; i++) {
+    threads.emplace_back([&]() {
+      while (!done) {
+        internal::MetaCacheEntry entry;
+        if (!meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry)) {
+          scoped_refptr<internal::RemoteTablet> rt = MetaCacheLookup(client_table_.get(), "");
+          CHECK(rt.get() != nullptr);
+          CHECK_EQ("", rt->partition().partition_key_start());
+        }
+      }
+    });
+  }
+  threads.emplace_back([&]() {
+    while (!done) {
+      meta_cache->ClearCache();
+      CHECK_NOTNULL(MetaCacheLookup(client_table_.get(), "").get());
+    }
+  });
+
+  SleepFor(kRunTime);
+  done = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // The cache must still be usable once the threads are done.
+  internal::MetaCacheEntry entry;
+  CHECK_NOTNULL(MetaCacheLookup(client_table_.get(), "").get());
+  ASSERT_TRUE(meta_cache->LookupTabletByKeyFastPath(client_table_.get(), "", &entry));
+}
+
 TEST_F(ClientTest, TestGetTabletServerBlacklist) {
   shared_ptr<KuduTable> table;
   ASSERT_NO_FATAL_FAILURE(CreateTable("blacklist",
@@ -1792,6 +1874,43 @@ TEST_F(ClientTest, TestCloseScanner) {
   }
 }
 
+// Test that scans opened with hedged requests on the replica with the lowest
+// latency return all the rows, and don't leak the scanners opened by the
+// requests whose responses went unused.
+TEST_F(ClientTest, TestHedgedScanOpen) {
+  const int kNumRows = 100;
+  shared_ptr<KuduTable> table;
+  ASSERT_NO_FATAL_FAILURE(CreateTable("hedged-table", 3, {}, {}, &table));
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(table.get(), kNumRows));
+
+  FLAGS_client_latency_aware_replica_selection = true;
+  FLAGS_client_hedged_scan_open = true;
+  FLAGS_client_hedged_scan_open_min_delay_ms = 1;
+  // Slow down every scan request so that some of them are hedged.
+  FLAGS_scanner_inject_latency_on_each_batch_ms = 10;
+
+  for (int i = 0; i < 10; i++) {
+    KuduScanner scanner(table.get());
+    ASSERT_OK(scanner.SetSelection(KuduClient::CLOSEST_REPLICA));
+    ASSERT_OK(scanner.SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
+    // Keep the scanners open after the first request, so that the unused
+    // ones have to be closed.
+    ASSERT_OK(scanner.SetBatchSizeBytes(0));
+    ASSERT_OK(scanner.Open());
+    int count = 0;
+    KuduScanBatch batch;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      count += batch.NumRows();
+    }
+    ASSERT_EQ(kNumRows, count);
+  }
+
+  for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+    AssertScannersDisappear(cluster_->mini_tablet_server(i)->server()->scanner_manager());
+  }
+}
+
 TEST_F(ClientTest, TestScanTimeout) {
   // If we set the RPC timeout to be 0, we'll time out in the GetTableLocations
   // code path and not even discover where the tablet is hosted.
@@ -2118,6 +2237,114 @@ TEST_F(ClientTest, TestMultipleMultiRowManualBatches) {
             , rows[0]);
 }
 
+// Test that the writes of a flush to several tablets of the same server are
+// sent in one MultiWrite RPC when --client_group_writes_by_server is set.
+TEST_F(ClientTest, TestGroupedWritesToMultipleTablets) {
+  FLAGS_client_group_writes_by_server = true;
+
+  shared_ptr<KuduTable> table;
+  NO_FATALS(CreateTable("split table", 1, GenerateSplitRows(), {}, &table));
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  const int kNumRows = 20;
+  for (int i = 0; i < kNumRows; i++) {
+    ASSERT_OK(ApplyInsertToSession(session.get(), table, i, i * 10, "hello world"));
+  }
+  FlushSessionOrDie(session);
+  ASSERT_EQ(kNumRows, CountRowsFromClient(table.get()));
+
+  scoped_refptr<Histogram> multi_writes =
+      METRIC_handler_latency_kudu_tserver_TabletServerService_MultiWrite.Instantiate(
+          cluster_->mini_tablet_server(0)->server()->metric_entity());
+  ASSERT_EQ(1, multi_writes->TotalCount());
+}
+
+// Test that the writes of a MultiWrite RPC which fails after the server
+// applied them are not applied again when they are sent individually.
+TEST_F(ClientTest, TestGroupedWritesNotAppliedTwice) {
+  FLAGS_client_group_writes_by_server = true;
+  FLAGS_multi_write_inject_failure_after_apply = true;
+
+  shared_ptr<KuduTable> table;
+  NO_FATALS(CreateTable("split table", 1, GenerateSplitRows(), {}, &table));
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  const int kNumRows = 20;
+  for (int i = 0; i < kNumRows; i++) {
+    ASSERT_OK(ApplyInsertToSession(session.get(), table, i, i * 10, "hello world"));
+  }
+  // Had the inserts been applied twice, the flush would fail with
+  // AlreadyPresent errors.
+  FlushSessionOrDie(session);
+  ASSERT_EQ(kNumRows, CountRowsFromClient(table.get()));
+
+  scoped_refptr<Histogram> multi_writes =
+      METRIC_handler_latency_kudu_tserver_TabletServerService_MultiWrite.Instantiate(
+          cluster_->mini_tablet_server(0)->server()->metric_entity());
+  ASSERT_EQ(1, multi_writes->TotalCount());
+
+  // Each row was inserted once, and no insert was rejected as a duplicate.
+  vector<scoped_refptr<TabletPeer>> peers;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+  int64_t rows_inserted = 0;
+  int64_t duplicate_inserts = 0;
+  for (const scoped_refptr<TabletPeer>& peer : peers) {
+    if (peer->tablet_metadata()->table_name() != "split table") {
+      continue;
+    }
+    rows_inserted += peer->tablet()->metrics()->rows_inserted->value();
+    duplicate_inserts += peer->tablet()->metrics()->insertions_failed_dup_key->value();
+  }
+  ASSERT_EQ(kNumRows, rows_inserted);
+  ASSERT_EQ(0, duplicate_inserts);
+}
+
+// Test writing rows to several tablets with a KuduWriteBatch, including rows
+// which fail.
+TEST_F(ClientTest, TestWriteBatch) {
+  const int kNumRows = 1000;
+  shared_ptr<KuduSession> session = client_->NewSession();
+  KuduWriteBatch batch(client_table_);
+  batch.ReserveRowsPerTablet(kNumRows);
+  const string kValue = "hello world";
+  for (int i = 0; i < kNumRows; i++) {
+    KuduPartialRow* row = batch.mutable_row();
+    ASSERT_OK(row->SetInt32("key", i));
+    ASSERT_OK(row->SetInt32("int_val", i * 2));
+    ASSERT_OK(row->SetStringNoCopy("string_val", kValue));
+    ASSERT_OK(batch.Add(KuduWriteOperation::INSERT));
+  }
+  ASSERT_EQ(kNumRows, batch.num_rows());
+  ASSERT_OK(batch.Flush(session.get()));
+  ASSERT_EQ(0, batch.num_rows());
+  ASSERT_EQ(kNumRows, CountRowsFromClient(client_table_.get()));
+
+  // A row without its key is rejected.
+  ASSERT_OK(batch.mutable_row()->SetInt32("int_val", 0));
+  Status s = batch.Add(KuduWriteOperation::INSERT);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  ASSERT_OK(batch.mutable_row()->Unset("int_val"));
+
+  // Re-inserting rows fails for those rows only.
+  for (int i = kNumRows - 5; i < kNumRows + 5; i++) {
+    ASSERT_OK(batch.mutable_row()->SetInt32("key", i));
+    ASSERT_OK(batch.mutable_row()->SetInt32("int_val", i * 2));
+    ASSERT_OK(batch.Add(KuduWriteOperation::INSERT));
+  }
+  s = batch.Flush(session.get());
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+  vector<pair<int, Status>> errors;
+  batch.GetRowErrors(&errors);
+  ASSERT_EQ(5, errors.size());
+  for (int i = 0; i < 5; i++) {
+    ASSERT_EQ(i, errors[i].first);
+    ASSERT_TRUE(errors[i].second.IsAlreadyPresent()) << errors[i].second.ToString();
+  }
+  ASSERT_EQ(kNumRows + 5, CountRowsFromClient(client_table_.get()));
+}
+
 // Test a batch where one of the inserted rows succeeds while another
 // fails.
 TEST_F(ClientTest, TestBatchWithPartialError) {
@@ -2671,6 +2898,36 @@ TEST_F(ClientTest, TestAutoFlushBackgroundSmallOps) {
   EXPECT_EQ(kRowNum, CountRowsFromClient(client_table_.get()));
 }
 
+// A test scenario for AUTO_FLUSH_BACKGROUND mode with adaptive flushing:
+// the tuned flush parameters must not break the limit on the buffer space,
+// and all the rows must reach the table.
+TEST_F(ClientTest, TestAutoFlushBackgroundAdaptive) {
+  const size_t kBufferSizeBytes = 1024;
+  const size_t kRowNum = kBufferSizeBytes * 10;
+  shared_ptr<KuduSession> session(client_->NewSession());
+  ASSERT_OK(session->SetMutationBufferSpace(kBufferSizeBytes));
+  ASSERT_OK(session->SetMutationBufferFlushInterval(100));
+  ASSERT_OK(session->SetAdaptiveFlushing(true));
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+
+  int64_t monitor_max_buffer_size = 0;
+  CountDownLatch monitor_run_ctl(1);
+  thread monitor(bind(&ClientTest::MonitorSessionBufferSize, session.get(),
+                      &monitor_run_ctl, &monitor_max_buffer_size));
+
+  for (size_t i = 0; i < kRowNum; ++i) {
+    ASSERT_OK(ApplyInsertToSession(session.get(), client_table_, i, i, "x"));
+  }
+  EXPECT_OK(session->Flush());
+  EXPECT_EQ(0, session->CountPendingErrors());
+  EXPECT_FALSE(session->HasPendingOperations());
+
+  monitor_run_ctl.CountDown();
+  monitor.join();
+  EXPECT_GE(kBufferSizeBytes, monitor_max_buffer_size);
+  EXPECT_EQ(kRowNum, CountRowsFromClient(client_table_.get()));
+}
+
 // A test scenario for AUTO_FLUSH_BACKGROUND mode:
 // applying a bunch of rows every one of which is so big in size that
 // a couple of those do not fit into the buffer. This should be OK:
@@ -34,7 +34,9 @@
 #include "kudu/client/client_builder-internal.h"
 #include "kudu/client/error-internal.h"
 #include "kudu/client/error_collector.h"
+#include "kudu/client/merge_scanner-internal.h"
 #include "kudu/client/meta_cache.h"
+#include "kudu/client/parallel_scanner-internal.h"
 #include "kudu/client/replica-internal.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/scan_predicate-internal.h"
@@ -64,6 +66,7 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/net/dns_resolver.h"
 #include "kudu/util/oid_generator.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/version_info.h"
 
 using kudu::master::AlterTableRequestPB;
@@ -255,6 +258,8 @@ Status KuduClientBuilder::Build(shared_ptr<KuduClient>* client) {
 
   c->data_->request_tracker_ = new rpc::RequestTracker(c->data_->client_id_);
 
+  RETURN_NOT_OK(ThreadPoolBuilder("client-async").Build(&c->data_->async_pool_));
+
   client->swap(c);
   return Status::OK();
 }
@@ -399,6 +404,18 @@ Status KuduClient::OpenTable(const string& table_name,
   return Status::OK();
 }
 
+void KuduClient::OpenTableAsync(const string& table_name,
+                                shared_ptr<KuduTable>* table,
+                                KuduStatusCallback* cb) {
+  // Looking up the schema retries against the leader master synchronously.
+  Status s = data_->async_pool_->SubmitFunc([this, table_name, table, cb]() {
+      cb->Run(OpenTable(table_name, table));
+    });
+  if (!s.ok()) {
+    cb->Run(s);
+  }
+}
+
 shared_ptr<KuduSession> KuduClient::NewSession() {
   shared_ptr<KuduSession> ret(new KuduSession(shared_from_this()));
   ret->data_->Init(ret);
@@ -562,6 +579,11 @@ KuduTableCreator& KuduTableCreator::num_replicas(int num_replicas) {
   return *this;
 }
 
+KuduTableCreator& KuduTableCreator::num_read_replicas(int num_read_replicas) {
+  data_->num_read_replicas_ = num_read_replicas;
+  return *this;
+}
+
 KuduTableCreator& KuduTableCreator::timeout(const MonoDelta& timeout) {
   data_->timeout_ = timeout;
   return *this;
@@ -592,6 +614,9 @@ Status KuduTableCreator::Create() {
   if (data_->num_replicas_ != boost::none) {
     req.set_num_replicas(data_->num_replicas_.get());
   }
+  if (data_->num_read_replicas_ != boost::none) {
+    req.set_num_read_replicas(data_->num_read_replicas_.get());
+  }
   RETURN_NOT_OK_PREPEND(SchemaToPB(*data_->schema_->schema_, req.mutable_schema(),
                                    SCHEMA_PB_WITHOUT_WRITE_DEFAULT),
                         "Invalid schema");
@@ -746,6 +771,22 @@ KuduPredicate* KuduTable::NewInListPredicate(const Slice& col_name,
   return new KuduPredicate(new InListPredicateData(s->column(col_idx), values));
 }
 
+KuduPredicate* KuduTable::NewInBloomFilterPredicate(const Slice& col_name,
+                                                    const Slice& filter_data,
+                                                    int n_hashes,
+                                                    bool blocked_layout) {
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    return new KuduPredicate(new ErrorPredicateData(
+      Status::NotFound("column not found", col_name)));
+  }
+  return new KuduPredicate(new InBloomFilterPredicateData(
+      s->column(col_idx), filter_data.ToString(), n_hashes,
+      blocked_layout ? BloomFilterLayout::BLOCKED : BloomFilterLayout::CLASSIC));
+}
+
 ////////////////////////////////////////////////////////////
 // Error
 ////////////////////////////////////////////////////////////
@@ -828,6 +869,10 @@ Status KuduSession::SetMutationBufferMaxNum(unsigned int max_num) {
   return data_->SetMaxBatchersNum(max_num);
 }
 
+Status KuduSession::SetAdaptiveFlushing(bool enabled) {
+  return data_->SetAdaptiveFlush(enabled);
+}
+
 void KuduSession::SetTimeoutMillis(int timeout_ms) {
   data_->SetTimeoutMillis(timeout_ms);
 }
@@ -980,6 +1025,19 @@ KuduTableAlterer* KuduTableAlterer::timeout(const MonoDelta& timeout) {
   return this;
 }
 
+KuduTableAlterer* KuduTableAlterer::SetQuota(int64_t write_rows_per_sec,
+                                             int64_t write_bytes_per_sec,
+                                             int64_t scan_rows_per_sec,
+                                             int64_t scan_bytes_per_sec) {
+  master::TableQuotaPB quota;
+  quota.set_write_rows_per_sec(write_rows_per_sec);
+  quota.set_write_bytes_per_sec(write_bytes_per_sec);
+  quota.set_scan_rows_per_sec(scan_rows_per_sec);
+  quota.set_scan_bytes_per_sec(scan_bytes_per_sec);
+  data_->quota_ = quota;
+  return this;
+}
+
 KuduTableAlterer* KuduTableAlterer::wait(bool wait) {
   data_->wait_ = wait;
   return this;
@@ -1029,6 +1087,9 @@ Status KuduTableAlterer::Alter() {
 // KuduScanner
 ////////////////////////////////////////////////////////////
 
+const uint64_t KuduScanner::NO_FLAGS;
+const uint64_t KuduScanner::COLUMNAR_LAYOUT;
+
 KuduScanner::KuduScanner(KuduTable* table)
   : data_(new KuduScanner::Data(table)) {
 }
@@ -1106,6 +1167,17 @@ Status KuduScanner::SetSnapshotRaw(uint64_t snapshot_timestamp) {
   return Status::OK();
 }
 
+Status KuduScanner::SetMaxStalenessMillis(int millis) {
+  if (data_->open_) {
+    return Status::IllegalState("Maximum staleness must be set before Open()");
+  }
+  if (millis < 0) {
+    return Status::InvalidArgument("Maximum staleness must not be negative");
+  }
+  data_->mutable_configuration()->SetMaxStalenessMillis(millis);
+  return Status::OK();
+}
+
 Status KuduScanner::SetSelection(KuduClient::ReplicaSelection selection) {
   if (data_->open_) {
     return Status::IllegalState("Replica selection must be set before Open()");
@@ -1161,6 +1233,27 @@ Status KuduScanner::SetCacheBlocks(bool cache_blocks) {
   return data_->mutable_configuration()->SetCacheBlocks(cache_blocks);
 }
 
+Status KuduScanner::SetReadaheadBlocks(int readahead_blocks) {
+  if (data_->open_) {
+    return Status::IllegalState("Readahead must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetReadaheadBlocks(readahead_blocks);
+}
+
+Status KuduScanner::SetSampleFraction(double fraction) {
+  if (data_->open_) {
+    return Status::IllegalState("Sample fraction must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetSampleFraction(fraction);
+}
+
+Status KuduScanner::SetRowFormatFlags(uint64_t flags) {
+  if (data_->open_) {
+    return Status::IllegalState("Row format flags must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetRowFormatFlags(flags);
+}
+
 KuduSchema KuduScanner::GetProjectionSchema() const {
   return KuduSchema(*data_->configuration().projection());
 }
@@ -1199,9 +1292,8 @@ Status KuduScanner::Open() {
   CHECK(!data_->open_) << "Scanner already open";
 
   data_->mutable_configuration()->OptimizeScanSpec();
-  data_->partition_pruner_.Init(*data_->table_->schema().schema_,
-                                data_->table_->partition_schema(),
-                                data_->configuration().spec());
+  data_->table_->data_->InitPartitionPruner(data_->configuration().spec(),
+                                            &data_->partition_pruner_);
 
   if (data_->configuration().spec().CanShortCircuit() ||
       !data_->partition_pruner_.HasMorePartitionKeyRanges()) {
@@ -1222,6 +1314,16 @@ Status KuduScanner::Open() {
   return Status::OK();
 }
 
+void KuduScanner::OpenAsync(KuduStatusCallback* cb) {
+  // Opening the first tablet looks up its locations, which blocks.
+  Status s = data_->table_->client()->data_->async_pool_->SubmitFunc([this, cb]() {
+      cb->Run(Open());
+    });
+  if (!s.ok()) {
+    cb->Run(s);
+  }
+}
+
 Status KuduScanner::KeepAlive() {
   return data_->KeepAlive();
 }
@@ -1261,6 +1363,9 @@ bool KuduScanner::HasMoreRows() const {
 }
 
 Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
+  if (data_->configuration().row_format_flags() & COLUMNAR_LAYOUT) {
+    return Status::IllegalState("Columnar scans require NextBatch(KuduScanBatch*)");
+  }
   RETURN_NOT_OK(NextBatch(&data_->batch_for_old_api_));
   data_->batch_for_old_api_.data_->ExtractRows(rows);
   return Status::OK();
@@ -1284,10 +1389,7 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     // We have data from a previous scan.
     VLOG(2) << "Extracting data from " << data_->DebugString();
     data_->data_in_open_ = false;
-    return batch->data_->Reset(&data_->controller_,
-                               data_->configuration().projection(),
-                               data_->configuration().client_projection(),
-                                make_gscoped_ptr(data_->last_response_.release_data()));
+    return data_->ExtractBatch(batch);
   } else if (data_->last_response_.has_more_results()) {
     // More data is available in this tablet.
     VLOG(2) << "Continuing " << data_->DebugString();
@@ -1305,36 +1407,15 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
           data_->last_primary_key_ = data_->last_response_.last_primary_key();
         }
         data_->scan_attempts_ = 0;
-        return batch->data_->Reset(&data_->controller_,
-                                   data_->configuration().projection(),
-                                   data_->configuration().client_projection(),
-                                   make_gscoped_ptr(data_->last_response_.release_data()));
+        return data_->ExtractBatch(batch);
       }
 
-      data_->scan_attempts_++;
-
       // Error handling.
-      set<string> blacklist;
-      Status s = data_->HandleError(result, batch_deadline, &blacklist);
-      if (!s.ok()) {
-        LOG(WARNING) << "Scan at tablet server " << data_->ts_->ToString() << " of tablet "
-                     << data_->DebugString() << " failed: " << result.status.ToString();
-        return s;
-      }
-
-      if (data_->configuration().is_fault_tolerant()) {
-        LOG(WARNING) << "Attempting to retry scan of tablet " << data_->DebugString()
-                     << " elsewhere.";
-        return data_->ReopenCurrentTablet(batch_deadline, &blacklist);
-      }
-
-      if (blacklist.empty()) {
-        // If we didn't blacklist the current server, we can just retry again.
-        continue;
+      bool retry;
+      RETURN_NOT_OK(data_->HandleContinueError(result, batch_deadline, &retry));
+      if (!retry) {
+        return Status::OK();
       }
-      // If we blacklisted the current server, and it's not fault-tolerant, we can't
-      // retry anywhere, so just propagate the error.
-      return result.status;
     }
   } else if (data_->MoreTablets()) {
     // More data may be available in other tablets.
@@ -1354,6 +1435,36 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
   }
 }
 
+void KuduScanner::NextBatchAsync(KuduScanBatch* batch, KuduStatusCallback* cb) {
+  CHECK(data_->open_);
+  CHECK(data_->proxy_);
+
+  if (data_->short_circuit_ || data_->data_in_open_ ||
+      (!data_->last_response_.has_more_results() && !data_->MoreTablets())) {
+    // The batch is at hand, if there is one.
+    cb->Run(NextBatch(batch));
+    return;
+  }
+
+  if (!data_->last_response_.has_more_results()) {
+    // Opening the next tablet looks up its locations, which blocks.
+    Status s = data_->table_->client()->data_->async_pool_->SubmitFunc([this, batch, cb]() {
+        cb->Run(NextBatch(batch));
+      });
+    if (!s.ok()) {
+      cb->Run(s);
+    }
+    return;
+  }
+
+  // More data is available in this tablet.
+  VLOG(2) << "Continuing " << data_->DebugString() << " asynchronously";
+  batch->data_->Clear();
+  MonoTime batch_deadline = MonoTime::Now() + data_->configuration().timeout();
+  data_->PrepareRequest(KuduScanner::Data::CONTINUE);
+  data_->ContinueScanAsync(batch, batch_deadline, cb);
+}
+
 Status KuduScanner::GetCurrentServer(KuduTabletServer** server) {
   CHECK(data_->open_);
   internal::RemoteTabletServer* rts = data_->ts_;
@@ -1371,6 +1482,103 @@ Status KuduScanner::GetCurrentServer(KuduTabletServer** server) {
   return Status::OK();
 }
 
+////////////////////////////////////////////////////////////
+// KuduParallelScanner
+////////////////////////////////////////////////////////////
+
+KuduParallelScanner::KuduParallelScanner(const vector<KuduScanToken*>& tokens)
+    : data_(new KuduParallelScanner::Data(tokens)) {
+}
+
+KuduParallelScanner::~KuduParallelScanner() {
+  delete data_;
+}
+
+Status KuduParallelScanner::SetConcurrency(int concurrency) {
+  if (data_->open_) {
+    return Status::IllegalState("Concurrency must be set before Open()");
+  }
+  if (concurrency <= 0) {
+    return Status::InvalidArgument("Concurrency must be greater than 0");
+  }
+  data_->concurrency_ = concurrency;
+  return Status::OK();
+}
+
+Status KuduParallelScanner::SetMaxBufferedBatches(int max_batches) {
+  if (data_->open_) {
+    return Status::IllegalState("Maximum buffered batches must be set before Open()");
+  }
+  if (max_batches <= 0) {
+    return Status::InvalidArgument("Maximum buffered batches must be greater than 0");
+  }
+  data_->max_buffered_batches_ = max_batches;
+  return Status::OK();
+}
+
+Status KuduParallelScanner::SetOrdered(bool ordered) {
+  if (data_->open_) {
+    return Status::IllegalState("Ordering must be set before Open()");
+  }
+  data_->ordered_ = ordered;
+  return Status::OK();
+}
+
+Status KuduParallelScanner::Open() {
+  return data_->Open();
+}
+
+bool KuduParallelScanner::HasMoreRows() const {
+  return data_->HasMoreRows();
+}
+
+Status KuduParallelScanner::NextBatch(KuduScanBatch* batch) {
+  return data_->NextBatch(batch);
+}
+
+void KuduParallelScanner::Close() {
+  data_->Close();
+}
+
+////////////////////////////////////////////////////////////
+// KuduMergeScanner
+////////////////////////////////////////////////////////////
+
+KuduMergeScanner::KuduMergeScanner(const vector<KuduScanToken*>& tokens)
+    : data_(new KuduMergeScanner::Data(tokens)) {
+}
+
+KuduMergeScanner::~KuduMergeScanner() {
+  delete data_;
+}
+
+Status KuduMergeScanner::SetLimit(int64_t limit) {
+  if (data_->open_) {
+    return Status::IllegalState("Limit must be set before Open()");
+  }
+  if (limit < 0) {
+    return Status::InvalidArgument("Limit must not be negative");
+  }
+  data_->limit_ = limit;
+  return Status::OK();
+}
+
+Status KuduMergeScanner::Open() {
+  return data_->Open();
+}
+
+bool KuduMergeScanner::HasMoreRows() const {
+  return data_->HasMoreRows();
+}
+
+Status KuduMergeScanner::NextBatch(vector<KuduScanBatch::RowPtr>* rows) {
+  return data_->NextBatch(rows);
+}
+
+void KuduMergeScanner::Close() {
+  data_->Close();
+}
+
 ////////////////////////////////////////////////////////////
 // KuduScanToken
 ////////////////////////////////////////////////////////////
@@ -1456,6 +1664,11 @@ Status KuduScanTokenBuilder::SetTimeoutMillis(int millis) {
   return Status::OK();
 }
 
+Status KuduScanTokenBuilder::SetSplitSizeBytes(uint64_t split_size_bytes) {
+  data_->SetSplitSizeBytes(split_size_bytes);
+  return Status::OK();
+}
+
 Status KuduScanTokenBuilder::AddConjunctPredicate(KuduPredicate* pred) {
   return data_->mutable_configuration()->AddConjunctPredicate(pred);
 }
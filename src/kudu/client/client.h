@@ -340,11 +340,27 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   ///   The result table.
   /// @return Operation status.
   ///
-  /// @todo Should we offer an async version of this as well?
   /// @todo Probably should have a configurable timeout in KuduClientBuilder?
   Status OpenTable(const std::string& table_name,
                    sp::shared_ptr<KuduTable>* table);
 
+  /// Asynchronous version of OpenTable().
+  ///
+  /// @note This method is experimental and will either disappear or
+  ///   change in a future release.
+  ///
+  /// @param [in] table_name
+  ///   Name of the table.
+  /// @param [out] table
+  ///   The result table. It must remain valid until @c cb is invoked.
+  /// @param [in] cb
+  ///   The callback to invoke with the status of the operation. It is
+  ///   invoked on a thread of the client, so it should not block. The client
+  ///   must not be destroyed before @c cb is invoked.
+  void OpenTableAsync(const std::string& table_name,
+                      sp::shared_ptr<KuduTable>* table,
+                      KuduStatusCallback* cb);
+
   /// Create a new session for interacting with the cluster.
   ///
   /// This is a fully local operation (no RPCs or blocking).
@@ -471,6 +487,7 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   friend class KuduTable;
   friend class KuduTableAlterer;
   friend class KuduTableCreator;
+  friend class KuduWriteBatch;
 
   FRIEND_TEST(kudu::ClientStressTest, TestUniqueClientIds);
   FRIEND_TEST(ClientTest, TestGetTabletServerBlacklist);
@@ -731,6 +748,20 @@ class KUDU_EXPORT KuduTableCreator {
   /// @return Reference to the modified table creator.
   KuduTableCreator& num_replicas(int n_replicas);
 
+  /// Set the number of read replicas of each tablet of the table.
+  ///
+  /// Read replicas are non-voting replicas, in addition to the replicas set
+  /// with num_replicas(), which receive the table's writes asynchronously.
+  /// They serve scans, but don't take part in leader elections or in
+  /// committing writes, so they add read capacity without adding to the
+  /// latency of writes. They are placed by the master once the tablets have
+  /// leaders.
+  ///
+  /// @param [in] n_read_replicas
+  ///   Number of read replicas to set. Defaults to 0.
+  /// @return Reference to the modified table creator.
+  KuduTableCreator& num_read_replicas(int n_read_replicas);
+
   /// Set the timeout for the table creation operation.
   ///
   /// This includes any waiting after the create has been submitted
@@ -894,6 +925,40 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   KuduPredicate* NewInListPredicate(const Slice& col_name,
                                     std::vector<KuduValue*>* values);
 
+  /// Create a new IN Bloom filter predicate which can be used for scanners
+  /// on this table.
+  ///
+  /// The Bloom filter predicate is used to push a semi-join down to the
+  /// tablet servers, for example with a runtime filter built from the join
+  /// keys of the other side of a join. A row is filtered from the scan if the
+  /// value of the column is definitely not in the filter. Since Bloom filters
+  /// have false positives, some rows whose values are not in the filter may
+  /// still be returned.
+  ///
+  /// The filter must have been built with kudu::BloomFilterBuilder. Its keys
+  /// are the column values: the raw bytes of STRING and BINARY values, and
+  /// the little-endian in-memory representation of values of other types.
+  ///
+  /// @param [in] col_name
+  ///   Name of the column to which the predicate applies.
+  /// @param [in] filter_data
+  ///   The bits of the filter. The data is copied.
+  /// @param [in] n_hashes
+  ///   The number of hash functions of the filter. Ignored if
+  ///   @c blocked_layout is @c true.
+  /// @param [in] blocked_layout
+  ///   Whether the filter uses the blocked (split block) layout rather than
+  ///   the classic one.
+  /// @return Raw pointer to a Bloom filter predicate. The caller owns the
+  ///   predicate until it is passed into KuduScanner::AddConjunctPredicate().
+  ///   In the case of an error (e.g. an invalid column name), a non-NULL
+  ///   value is still returned. The error will be returned when attempting
+  ///   to add this predicate to a KuduScanner.
+  KuduPredicate* NewInBloomFilterPredicate(const Slice& col_name,
+                                           const Slice& filter_data,
+                                           int n_hashes,
+                                           bool blocked_layout);
+
   /// @return The KuduClient object associated with the table. The caller
   ///   should not free the returned pointer.
   KuduClient* client() const;
@@ -905,6 +970,8 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   class KUDU_NO_EXPORT Data;
 
   friend class KuduClient;
+  friend class KuduScanner;
+  friend class KuduScanTokenBuilder;
 
   KuduTable(const sp::shared_ptr<KuduClient>& client,
             const std::string& name,
@@ -1041,6 +1108,25 @@ class KUDU_EXPORT KuduTableAlterer {
       KuduTableCreator::RangePartitionBound lower_bound_type = KuduTableCreator::INCLUSIVE_BOUND,
       KuduTableCreator::RangePartitionBound upper_bound_type = KuduTableCreator::EXCLUSIVE_BOUND);
 
+  /// Replace the throughput quotas of the table.
+  ///
+  /// The quotas are split evenly among the tablets of the table, and each
+  /// tablet server rejects the writes and scans of a tablet which exceed its
+  /// share with a retriable error. The quotas are applied by the tablet
+  /// servers with their next heartbeats, after the alteration is complete.
+  ///
+  /// @param [in] write_rows_per_sec
+  ///   Rows written per second, or 0 for no limit.
+  /// @param [in] write_bytes_per_sec
+  ///   Bytes of write requests per second, or 0 for no limit.
+  /// @param [in] scan_rows_per_sec
+  ///   Rows returned by scans per second, or 0 for no limit.
+  /// @param [in] scan_bytes_per_sec
+  ///   Bytes returned by scans per second, or 0 for no limit.
+  /// @return Raw pointer to this alterer object.
+  KuduTableAlterer* SetQuota(int64_t write_rows_per_sec, int64_t write_bytes_per_sec,
+                             int64_t scan_rows_per_sec, int64_t scan_bytes_per_sec);
+
   /// Set a timeout for the alteration operation.
   ///
   /// This includes any waiting after the alter has been submitted
@@ -1400,6 +1486,26 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   /// @return Operation result status.
   Status SetMutationBufferMaxNum(unsigned int max_num) WARN_UNUSED_RESULT;
 
+  /// Enable or disable the adaptive flushing of the mutation buffers.
+  ///
+  /// In adaptive mode, the flush watermark and the maximum number of
+  /// mutation buffers set by SetMutationBufferFlushWatermark() and
+  /// SetMutationBufferMaxNum() are only the starting point. They are tuned
+  /// from the latency of the flushes of the session: they grow while flushes
+  /// complete in time, sending larger and more concurrent batches, and
+  /// they are halved when a flush takes much longer than usual or when
+  /// a tablet server rejects writes because it is too busy.
+  ///
+  /// @note This setting is applicable only for AUTO_FLUSH_BACKGROUND sessions.
+  ///
+  /// @note This method is experimental and will either disappear or
+  ///   change in a future release.
+  ///
+  /// @param [in] enabled
+  ///   Whether to tune the flushing adaptively.
+  /// @return Operation result status.
+  Status SetAdaptiveFlushing(bool enabled) WARN_UNUSED_RESULT;
+
   /// Set the timeout for writes made in this session.
   ///
   /// @param [in] millis
@@ -1589,6 +1695,7 @@ class KUDU_EXPORT KuduSession : public sp::enable_shared_from_this<KuduSession>
   class KUDU_NO_EXPORT Data;
 
   friend class KuduClient;
+  friend class KuduWriteBatch;
   friend class internal::Batcher;
   friend class ClientTest;
   FRIEND_TEST(ClientTest, TestAutoFlushBackgroundApplyBlocks);
@@ -1665,6 +1772,17 @@ class KUDU_EXPORT KuduScanner {
   /// KuduClientBuilder::default_rpc_timeout().
   enum { kScanTimeoutMillis = 30000 };
 
+  /// @name Row format flags for SetRowFormatFlags().
+  ///
+  ///@{
+  /// No flags: rows are returned in row-wise layout.
+  static const uint64_t NO_FLAGS = 0;
+  /// Rows are returned column by column. Batches must then be accessed
+  /// through the columnar accessors of KuduScanBatch, such as
+  /// KuduScanBatch::GetFixedLengthColumn(), rather than row by row.
+  static const uint64_t COLUMNAR_LAYOUT = 1 << 0;
+  ///@}
+
   /// Constructor for KuduScanner.
   ///
   /// @param [in] table
@@ -1784,6 +1902,47 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetCacheBlocks(bool cache_blocks);
 
+  /// Set the number of data blocks to read ahead per column.
+  ///
+  /// Once the tablet server detects that a scan is reading sequentially,
+  /// it issues reads for up to this many upcoming data blocks of each
+  /// column in the background, overlapping I/O with decoding. This benefits
+  /// large batch scans, particularly on rotational disks. The tablet server
+  /// may read ahead fewer blocks than requested.
+  ///
+  /// @param [in] readahead_blocks
+  ///   Readahead depth in blocks. Default is 0, which disables readahead.
+  /// @return Operation result status.
+  Status SetReadaheadBlocks(int readahead_blocks) WARN_UNUSED_RESULT;
+
+  /// Scan only a random sample of the rows.
+  ///
+  /// The tablet servers sample ranges of consecutive rows of their on-disk
+  /// data, and never read the rows outside of the sampled ranges, so a
+  /// sampling scan is cheaper than a full one roughly in proportion to the
+  /// fraction. Rows which have not been flushed to disk yet are always
+  /// returned, so small or recently written tables may be oversampled.
+  ///
+  /// @param [in] fraction
+  ///   The fraction of the rows to sample, in (0, 1]. Default is 1, which
+  ///   disables sampling.
+  /// @return Operation result status.
+  Status SetSampleFraction(double fraction) WARN_UNUSED_RESULT;
+
+  /// Set the format of the returned rows.
+  ///
+  /// Analytic clients which consume data column by column should use
+  /// COLUMNAR_LAYOUT, which avoids transposing the rows into row-wise layout
+  /// on the server and back into columns on the client.
+  ///
+  /// @note Scans with flags other than NO_FLAGS fail on tablet servers which
+  ///   don't support them.
+  ///
+  /// @param [in] flags
+  ///   A bitset of row format flags. Default is NO_FLAGS.
+  /// @return Operation result status.
+  Status SetRowFormatFlags(uint64_t flags) WARN_UNUSED_RESULT;
+
   /// @return Result status of the operation (begin scanning).
   Status Open();
 
@@ -1848,6 +2007,36 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status NextBatch(KuduScanBatch* batch);
 
+  /// Asynchronous version of Open().
+  ///
+  /// @note This method is experimental and will either disappear or
+  ///   change in a future release.
+  ///
+  /// @param [in] cb
+  ///   The callback to invoke with the status of the operation. It is
+  ///   invoked on a thread of the client, so it should not block. The
+  ///   scanner must not be used or destroyed before @c cb is invoked.
+  void OpenAsync(KuduStatusCallback* cb);
+
+  /// Asynchronous version of NextBatch(KuduScanBatch*).
+  ///
+  /// When more rows are available in the tablet being scanned, the batch is
+  /// fetched by the client's reactor threads without blocking any thread.
+  /// This allows a single thread to drive many concurrent scans.
+  ///
+  /// @note This method is experimental and will either disappear or
+  ///   change in a future release.
+  ///
+  /// @param [out] batch
+  ///   Placeholder for the result. It must remain valid until @c cb is
+  ///   invoked.
+  /// @param [in] cb
+  ///   The callback to invoke with the status of the operation. It may be
+  ///   invoked on a reactor thread of the client, or before this method
+  ///   returns, so it should not block. The scanner must not be used or
+  ///   destroyed before @c cb is invoked.
+  void NextBatchAsync(KuduScanBatch* batch, KuduStatusCallback* cb);
+
   /// Get the KuduTabletServer that is currently handling the scan.
   ///
   /// More concretely, this is the server that handled the most recent
@@ -1929,6 +2118,23 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetSnapshotRaw(uint64_t snapshot_timestamp) WARN_UNUSED_RESULT;
 
+  /// Allow a @c READ_AT_SNAPSHOT scan with no snapshot timestamp to read a
+  /// snapshot up to @c millis milliseconds in the past.
+  ///
+  /// Rather than waiting for the selected replica to catch up with the
+  /// current time, the replica serves the scan at the latest timestamp it
+  /// knows to be safe. If that timestamp is older than the bound, the scan is
+  /// retried on another replica. This makes follower reads, e.g. with
+  /// KuduClient::CLOSEST_REPLICA, avoid waiting on lagging replicas.
+  ///
+  /// @note This method is experimental and will either disappear or
+  ///   change in a future release.
+  ///
+  /// @param [in] millis
+  ///   The maximum staleness (in milliseconds). Must not be negative.
+  /// @return Operation result status.
+  Status SetMaxStalenessMillis(int millis) WARN_UNUSED_RESULT;
+
   /// Set the maximum time that Open() and NextBatch() are allowed to take.
   ///
   /// @param [in] millis
@@ -1949,6 +2155,7 @@ class KUDU_EXPORT KuduScanner {
  private:
   class KUDU_NO_EXPORT Data;
 
+  friend class KuduMergeScanner;
   friend class KuduScanToken;
   FRIEND_TEST(ClientTest, TestScanCloseProxy);
   FRIEND_TEST(ClientTest, TestScanFaultTolerance);
@@ -2123,6 +2330,19 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   /// @copydoc KuduScanner::SetTimeoutMillis
   Status SetTimeoutMillis(int millis) WARN_UNUSED_RESULT;
 
+  /// Set the target size of the data scanned by each token.
+  ///
+  /// By default, one token is built for each tablet. If a target size is
+  /// set, the tablet servers are asked to split the primary key range of
+  /// each tablet into chunks holding roughly that much data, and a token is
+  /// built for each chunk. The sizes are estimated from the flushed data
+  /// only. Tablets whose servers cannot split them get a single token.
+  ///
+  /// @param [in] split_size_bytes
+  ///   The target size in bytes, or 0 to build one token per tablet.
+  /// @return Operation result status.
+  Status SetSplitSizeBytes(uint64_t split_size_bytes) WARN_UNUSED_RESULT;
+
   /// Build the set of scan tokens.
   ///
   /// The builder may be reused after this call.
@@ -2142,6 +2362,153 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   DISALLOW_COPY_AND_ASSIGN(KuduScanTokenBuilder);
 };
 
+/// @brief Scans the tablets of a set of scan tokens in parallel.
+///
+/// Up to a configurable number of the tokens are scanned at once, each by
+/// its own KuduScanner, and their batches are prefetched into a bounded
+/// buffer. By default the batches are returned in the order in which they
+/// arrive. They can also be returned in the order of the tokens, which is
+/// the partition order for the tokens built by KuduScanTokenBuilder.
+///
+/// @note This class is experimental and may change in a future release.
+///
+/// @note This class is not thread-safe.
+class KUDU_EXPORT KuduParallelScanner {
+ public:
+  /// Construct an instance of the class.
+  ///
+  /// @param [in] tokens
+  ///   The tokens to scan, for example built by KuduScanTokenBuilder.
+  ///   The scanner takes ownership of the tokens.
+  explicit KuduParallelScanner(const std::vector<KuduScanToken*>& tokens);
+  ~KuduParallelScanner();
+
+  /// Set the maximum number of tokens scanned at once. The default is 4.
+  ///
+  /// @param [in] concurrency
+  ///   The number of tokens to scan at once. Must be greater than 0.
+  /// @return Operation result status.
+  Status SetConcurrency(int concurrency) WARN_UNUSED_RESULT;
+
+  /// Set the maximum number of batches which are fetched ahead of the
+  /// caller. The default is 16.
+  ///
+  /// When the batches are returned in the order of the tokens, the batches
+  /// of the token being returned are always fetched, so the buffer may hold
+  /// more batches than this.
+  ///
+  /// @param [in] max_batches
+  ///   The number of batches to buffer. Must be greater than 0.
+  /// @return Operation result status.
+  Status SetMaxBufferedBatches(int max_batches) WARN_UNUSED_RESULT;
+
+  /// Set whether the batches are returned in the order of the tokens.
+  ///
+  /// @param [in] ordered
+  ///   Whether to return the batches in the order of the tokens, rather
+  ///   than in the order in which they arrive.
+  /// @return Operation result status.
+  Status SetOrdered(bool ordered) WARN_UNUSED_RESULT;
+
+  /// Begin scanning the tokens.
+  ///
+  /// @return Operation result status.
+  Status Open() WARN_UNUSED_RESULT;
+
+  /// Check if there may be rows to be fetched from this scanner.
+  ///
+  /// @return @c true if there may be rows to be fetched from this scanner.
+  bool HasMoreRows() const;
+
+  /// Fetch the next batch of results, waiting for one to be fetched if
+  /// there is none in the buffer.
+  ///
+  /// The batch may be empty if the scan turns out to have no more rows.
+  /// If any of the tokens fails to be scanned, the whole scan fails.
+  ///
+  /// @param [out] batch
+  ///   Placeholder for the result.
+  /// @return Operation result status.
+  Status NextBatch(KuduScanBatch* batch) WARN_UNUSED_RESULT;
+
+  /// Stop scanning the tokens, waiting for the batches being fetched.
+  void Close();
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduParallelScanner);
+};
+
+/// @brief Scans the tablets of a set of scan tokens, merging their rows in
+///   primary key order.
+///
+/// The tablets are scanned in ORDERED mode (see
+/// KuduScanner::SetFaultTolerant()), and the rows of all of them are merged
+/// into a single stream ordered by primary key, whatever the partitioning of
+/// the table. This allows, for example, to fetch the first rows of a hash
+/// partitioned table in key order without sorting all of its rows. All the
+/// tablets are opened by Open().
+///
+/// The projection of the tokens must include the primary key columns.
+///
+/// @note This class is experimental and may change in a future release.
+///
+/// @note This class is not thread-safe.
+class KUDU_EXPORT KuduMergeScanner {
+ public:
+  /// Construct an instance of the class.
+  ///
+  /// @param [in] tokens
+  ///   The tokens to scan, for example built by KuduScanTokenBuilder.
+  ///   The scanner takes ownership of the tokens.
+  explicit KuduMergeScanner(const std::vector<KuduScanToken*>& tokens);
+  ~KuduMergeScanner();
+
+  /// Set the maximum number of rows returned by the scan. By default, all
+  /// the rows are returned.
+  ///
+  /// @param [in] limit
+  ///   The number of rows to return. Must not be negative.
+  /// @return Operation result status.
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
+  /// Begin scanning the tokens.
+  ///
+  /// @return Operation result status.
+  Status Open() WARN_UNUSED_RESULT;
+
+  /// Check if there may be rows to be fetched from this scanner.
+  ///
+  /// @return @c true if there may be rows to be fetched from this scanner.
+  bool HasMoreRows() const;
+
+  /// Clear 'rows' and populate it with the next rows of the scan, in
+  /// primary key order. A call to NextBatch() invalidates the rows returned
+  /// by the previous call.
+  ///
+  /// If any of the tokens fails to be scanned, the whole scan fails.
+  ///
+  /// @param [out] rows
+  ///   Placeholder for the result.
+  /// @return Operation result status.
+  Status NextBatch(std::vector<KuduScanBatch::RowPtr>* rows) WARN_UNUSED_RESULT;
+
+  /// Stop scanning the tokens.
+  void Close();
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduMergeScanner);
+};
+
 } // namespace client
 } // namespace kudu
 #endif
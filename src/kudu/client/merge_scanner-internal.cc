@@ -0,0 +1,222 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/merge_scanner-internal.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/client/scanner-internal.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/threadpool.h"
+
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace client {
+
+namespace {
+
+// The maximum number of tablets opened at once by Open().
+const int kMaxOpenConcurrency = 16;
+
+// The maximum number of merged rows returned by one call to NextBatch().
+const size_t kMaxRowsPerBatch = 1024;
+
+} // anonymous namespace
+
+KuduMergeScanner::Data::Data(const vector<KuduScanToken*>& tokens)
+    : limit_(-1),
+      open_(false),
+      tokens_(tokens.begin(), tokens.end()),
+      sources_(tokens_.size()),
+      projection_(nullptr),
+      num_rows_returned_(0) {
+}
+
+KuduMergeScanner::Data::~Data() {
+  Close();
+}
+
+Status KuduMergeScanner::Data::Open() {
+  CHECK(!open_) << "Scanner already open";
+  open_ = true;
+  const int num_tokens = tokens_.size();
+  if (num_tokens == 0) {
+    return Status::OK();
+  }
+
+  // Open all the tablets, in parallel since each takes a round trip.
+  vector<Status> statuses(num_tokens);
+  {
+    gscoped_ptr<ThreadPool> pool;
+    RETURN_NOT_OK(ThreadPoolBuilder("merge-scan-open")
+                  .set_max_threads(std::min(kMaxOpenConcurrency, num_tokens))
+                  .Build(&pool));
+    for (int i = 0; i < num_tokens; i++) {
+      Status s = pool->SubmitFunc([this, i, &statuses]() {
+          statuses[i] = this->OpenSource(i);
+        });
+      if (!s.ok()) {
+        statuses[i] = s;
+      }
+    }
+    pool->Wait();
+  }
+  for (const Status& s : statuses) {
+    if (!s.ok()) {
+      status_ = s.CloneAndPrepend("Merge scan failed");
+      return status_;
+    }
+  }
+
+  // All the tokens have the same projection, which must include the primary
+  // key of the table to order the rows by.
+  const KuduScanner::Data* scanner_data = sources_[0].scanner->data_;
+  projection_ = scanner_data->configuration().projection();
+  const Schema& table_schema = *scanner_data->table_->schema().schema_;
+  for (int i = 0; i < table_schema.num_key_columns(); i++) {
+    const std::string& name = table_schema.column(i).name();
+    int idx = projection_->find_column(name);
+    if (idx == Schema::kColumnNotFound) {
+      status_ = Status::InvalidArgument(
+          Substitute("Projection of a merge scan must include key column $0", name));
+      return status_;
+    }
+    key_indexes_.push_back(idx);
+  }
+
+  auto cmp = [this](int a, int b) { return this->CompareSources(a, b) > 0; };
+  for (int i = 0; i < num_tokens; i++) {
+    if (sources_[i].batch) {
+      heap_.push_back(i);
+    }
+  }
+  std::make_heap(heap_.begin(), heap_.end(), cmp);
+  return Status::OK();
+}
+
+Status KuduMergeScanner::Data::OpenSource(int idx) {
+  Source* source = &sources_[idx];
+  KuduScanner* scanner;
+  RETURN_NOT_OK(tokens_[idx]->IntoKuduScanner(&scanner));
+  source->scanner.reset(scanner);
+  // Each tablet returns its rows in primary key order.
+  RETURN_NOT_OK(scanner->SetFaultTolerant());
+  if (limit_ >= 0) {
+    // No tablet contributes more rows than the limit of the merged scan.
+    RETURN_NOT_OK(scanner->data_->mutable_configuration()->SetLimit(limit_));
+  }
+  RETURN_NOT_OK(scanner->Open());
+  bool has_rows;
+  return FetchBatch(source, &has_rows);
+}
+
+Status KuduMergeScanner::Data::FetchBatch(Source* source, bool* has_rows) {
+  while (source->scanner->HasMoreRows()) {
+    unique_ptr<KuduScanBatch> batch(new KuduScanBatch());
+    RETURN_NOT_OK(source->scanner->NextBatch(batch.get()));
+    if (batch->NumRows() > 0) {
+      source->batch = std::move(batch);
+      source->next_row = 0;
+      *has_rows = true;
+      return Status::OK();
+    }
+  }
+  *has_rows = false;
+  return Status::OK();
+}
+
+int KuduMergeScanner::Data::CompareSources(int a, int b) const {
+  const Source& sa = sources_[a];
+  const Source& sb = sources_[b];
+  KuduScanBatch::RowPtr row_a = sa.batch->Row(sa.next_row);
+  KuduScanBatch::RowPtr row_b = sb.batch->Row(sb.next_row);
+  for (int idx : key_indexes_) {
+    int c = projection_->column(idx).type_info()->Compare(row_a.cell(idx), row_b.cell(idx));
+    if (c != 0) {
+      return c;
+    }
+  }
+  return 0;
+}
+
+bool KuduMergeScanner::Data::HasMoreRows() const {
+  CHECK(open_);
+  return !status_.ok() ||
+      (!heap_.empty() && (limit_ < 0 || num_rows_returned_ < limit_));
+}
+
+Status KuduMergeScanner::Data::NextBatch(vector<KuduScanBatch::RowPtr>* rows) {
+  CHECK(open_);
+  RETURN_NOT_OK(status_);
+  rows->clear();
+  retired_batches_.clear();
+
+  auto cmp = [this](int a, int b) { return this->CompareSources(a, b) > 0; };
+  while (!heap_.empty() && rows->size() < kMaxRowsPerBatch &&
+         (limit_ < 0 || num_rows_returned_ < limit_)) {
+    std::pop_heap(heap_.begin(), heap_.end(), cmp);
+    int idx = heap_.back();
+    heap_.pop_back();
+
+    Source* source = &sources_[idx];
+    rows->push_back(source->batch->Row(source->next_row++));
+    num_rows_returned_++;
+    if (source->next_row == source->batch->NumRows()) {
+      // The returned rows still point into the batch.
+      retired_batches_.emplace_back(std::move(source->batch));
+      bool has_rows;
+      Status s = FetchBatch(source, &has_rows);
+      if (!s.ok()) {
+        status_ = s.CloneAndPrepend("Merge scan failed");
+        rows->clear();
+        return status_;
+      }
+      if (!has_rows) {
+        continue;
+      }
+    }
+    heap_.push_back(idx);
+    std::push_heap(heap_.begin(), heap_.end(), cmp);
+  }
+
+  if (!HasMoreRows()) {
+    // Release the scanners of the tablets which were not read to the end.
+    Close();
+  }
+  return Status::OK();
+}
+
+void KuduMergeScanner::Data::Close() {
+  heap_.clear();
+  for (Source& source : sources_) {
+    if (source.scanner) {
+      source.scanner->Close();
+    }
+  }
+}
+
+} // namespace client
+} // namespace kudu
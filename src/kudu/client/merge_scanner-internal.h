@@ -0,0 +1,98 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/client/scan_batch.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Schema;
+
+namespace client {
+
+class KuduMergeScanner::Data {
+ public:
+  explicit Data(const std::vector<KuduScanToken*>& tokens);
+  ~Data();
+
+  Status Open();
+
+  bool HasMoreRows() const;
+
+  Status NextBatch(std::vector<KuduScanBatch::RowPtr>* rows);
+
+  void Close();
+
+  // Options set before Open().
+  int64_t limit_;
+
+  bool open_;
+
+ private:
+  // The scan of one token, and the batch whose rows are being merged.
+  struct Source {
+    std::unique_ptr<KuduScanner> scanner;
+    std::unique_ptr<KuduScanBatch> batch;
+    // The index in 'batch' of the next row to merge.
+    int next_row;
+  };
+
+  // Opens the scanner of the token at 'idx' and fetches its first batch.
+  Status OpenSource(int idx);
+
+  // Fetches the next non-empty batch of 'source'. Sets 'has_rows' to false
+  // if the scan of the source is complete.
+  static Status FetchBatch(Source* source, bool* has_rows);
+
+  // Compares the primary keys of the next rows of the sources at 'a' and 'b'.
+  int CompareSources(int a, int b) const;
+
+  const std::vector<std::unique_ptr<KuduScanToken>> tokens_;
+
+  std::vector<Source> sources_;
+
+  // The projection of the scans, and the indexes in it of the primary key
+  // columns of the table.
+  const Schema* projection_;
+  std::vector<int> key_indexes_;
+
+  // A min-heap of the indexes of the sources which have rows left, ordered
+  // by the primary key of their next row.
+  std::vector<int> heap_;
+
+  // The batches which were exhausted while building the last batch of
+  // merged rows, which still refer to their data.
+  std::vector<std::unique_ptr<KuduScanBatch>> retired_batches_;
+
+  int64_t num_rows_returned_;
+
+  // The first error of the scan, which fails all later calls.
+  Status status_;
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
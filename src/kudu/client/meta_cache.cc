@@ -18,6 +18,7 @@
 #include "kudu/client/meta_cache.h"
 
 #include <boost/bind.hpp>
+#include <cstdlib>
 #include <glog/logging.h>
 #include <mutex>
 
@@ -68,7 +69,9 @@ const int MAX_RETURNED_TABLE_LOCATIONS = 10;
 ////////////////////////////////////////////////////////////
 
 RemoteTabletServer::RemoteTabletServer(const master::TSInfoPB& pb)
-  : uuid_(pb.permanent_uuid()) {
+  : uuid_(pb.permanent_uuid()),
+    latency_mean_us_(-1),
+    latency_dev_us_(-1) {
 
   Update(pb);
 }
@@ -161,6 +164,30 @@ void RemoteTabletServer::GetHostPorts(vector<HostPort>* host_ports) const {
   *host_ports = rpc_hostports_;
 }
 
+void RemoteTabletServer::RecordRpcLatency(const MonoDelta& latency) {
+  int64_t sample_us = latency.ToMicroseconds();
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (latency_mean_us_ < 0) {
+    latency_mean_us_ = sample_us;
+    latency_dev_us_ = sample_us / 2;
+    return;
+  }
+  // Same gains as TCP's smoothed round-trip time estimator (RFC 6298).
+  int64_t err_us = sample_us - latency_mean_us_;
+  latency_mean_us_ += err_us / 8;
+  latency_dev_us_ += (std::abs(err_us) - latency_dev_us_) / 4;
+}
+
+bool RemoteTabletServer::GetLatencyEstimate(MonoDelta* mean, MonoDelta* deviation) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (latency_mean_us_ < 0) {
+    return false;
+  }
+  *mean = MonoDelta::FromMicroseconds(latency_mean_us_);
+  *deviation = MonoDelta::FromMicroseconds(latency_dev_us_);
+  return true;
+}
+
 ////////////////////////////////////////////////////////////
 
 
@@ -775,7 +802,7 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
   MonoTime expiration_time = MonoTime::Now() +
       MonoDelta::FromMilliseconds(rpc.resp().ttl_millis());
 
-  std::lock_guard<rw_spinlock> l(lock_);
+  std::lock_guard<percpu_rwlock> l(lock_);
   TabletMap& tablets_by_key = LookupOrInsert(&tablets_by_table_and_key_,
                                              rpc.table_id(), TabletMap());
 
@@ -915,7 +942,7 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
 bool MetaCache::LookupTabletByKeyFastPath(const KuduTable* table,
                                           const string& partition_key,
                                           MetaCacheEntry* entry) {
-  shared_lock<rw_spinlock> l(lock_);
+  shared_lock<rw_spinlock> l(lock_.get_lock());
   const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table->id());
   if (PREDICT_FALSE(!tablets)) {
     // No cache available for this table.
@@ -943,7 +970,7 @@ bool MetaCache::LookupTabletByKeyFastPath(const KuduTable* table,
 
 void MetaCache::ClearCache() {
   VLOG(3) << "Clearing cache";
-  std::lock_guard<rw_spinlock> l(lock_);
+  std::lock_guard<percpu_rwlock> l(lock_);
   STLDeleteValues(&ts_cache_);
   tablets_by_id_.clear();
   tablets_by_table_and_key_.clear();
@@ -984,7 +1011,7 @@ void MetaCache::LookupTabletByKeyOrNext(const KuduTable* table,
 void MetaCache::MarkTSFailed(RemoteTabletServer* ts,
                              const Status& status) {
   LOG(INFO) << "Marking tablet server " << ts->ToString() << " as failed.";
-  shared_lock<rw_spinlock> l(lock_);
+  shared_lock<rw_spinlock> l(lock_.get_lock());
 
   Status ts_status = status.CloneAndPrepend("TS failed");
 
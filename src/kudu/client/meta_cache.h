@@ -94,6 +94,15 @@ class RemoteTabletServer {
   // Returns the remote server's uuid.
   const std::string& permanent_uuid() const;
 
+  // Folds the round-trip time of an RPC answered by this server into its
+  // latency estimate.
+  void RecordRpcLatency(const MonoDelta& latency);
+
+  // Returns the smoothed round-trip time of the RPCs answered by this server
+  // in 'mean', and its mean deviation in 'deviation'. Returns false if no RPC
+  // latency has been recorded yet.
+  bool GetLatencyEstimate(MonoDelta* mean, MonoDelta* deviation) const;
+
  private:
   // Internal callback for DNS resolution.
   void DnsResolutionFinished(const HostPort& hp,
@@ -108,6 +117,11 @@ class RemoteTabletServer {
   std::vector<HostPort> rpc_hostports_;
   std::shared_ptr<tserver::TabletServerServiceProxy> proxy_;
 
+  // Exponentially weighted moving averages of the RPC round-trip time and of
+  // its deviation, in microseconds, or -1 if no latency has been recorded.
+  int64_t latency_mean_us_;
+  int64_t latency_dev_us_;
+
   DISALLOW_COPY_AND_ASSIGN(RemoteTabletServer);
 };
 
@@ -420,7 +434,11 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
 
   KuduClient* client_;
 
-  rw_spinlock lock_;
+  // Every write and scan looks up its tablet in the cache, while the cache is
+  // only updated by the responses of the master. A per-CPU lock keeps the
+  // lookups of concurrent application threads from contending on the cache
+  // line of the lock.
+  percpu_rwlock lock_;
 
   // Cache of Tablet Server locations: TS UUID -> RemoteTabletServer*.
   //
@@ -0,0 +1,204 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/parallel_scanner-internal.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/client/scanner-internal.h"
+#include "kudu/util/threadpool.h"
+
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace client {
+
+KuduParallelScanner::Data::Data(const vector<KuduScanToken*>& tokens)
+    : concurrency_(4),
+      max_buffered_batches_(16),
+      ordered_(false),
+      open_(false),
+      tokens_(tokens.begin(), tokens.end()),
+      num_tokens_(tokens_.size()),
+      scanners_(num_tokens_),
+      cond_(&mutex_),
+      next_token_(0),
+      num_tokens_done_(0),
+      token_done_(num_tokens_, false),
+      buffered_(num_tokens_),
+      num_buffered_(0),
+      next_token_to_return_(0),
+      closed_(false) {
+}
+
+KuduParallelScanner::Data::~Data() {
+  Close();
+}
+
+Status KuduParallelScanner::Data::Open() {
+  CHECK(!open_) << "Scanner already open";
+  open_ = true;
+  if (num_tokens_ == 0) {
+    return Status::OK();
+  }
+
+  int num_workers = std::min(concurrency_, num_tokens_);
+  RETURN_NOT_OK(ThreadPoolBuilder("parallel-scan")
+                .set_max_threads(num_workers)
+                .Build(&pool_));
+  for (int i = 0; i < num_workers; i++) {
+    RETURN_NOT_OK(pool_->SubmitFunc([this]() { this->RunWorker(); }));
+  }
+  return Status::OK();
+}
+
+void KuduParallelScanner::Data::RunWorker() {
+  while (true) {
+    int idx;
+    {
+      MutexLock l(mutex_);
+      if (closed_ || !status_.ok() || next_token_ == num_tokens_) {
+        return;
+      }
+      idx = next_token_++;
+    }
+
+    Status s = ScanToken(idx);
+
+    MutexLock l(mutex_);
+    if (!s.ok() && status_.ok()) {
+      status_ = s.CloneAndPrepend("Parallel scan failed");
+    }
+    token_done_[idx] = true;
+    num_tokens_done_++;
+    cond_.Broadcast();
+  }
+}
+
+Status KuduParallelScanner::Data::ScanToken(int idx) {
+  KuduScanner* scanner;
+  RETURN_NOT_OK(tokens_[idx]->IntoKuduScanner(&scanner));
+  scanners_[idx].reset(scanner);
+  RETURN_NOT_OK(scanner->Open());
+  while (scanner->HasMoreRows()) {
+    unique_ptr<KuduScanBatch> batch(new KuduScanBatch());
+    RETURN_NOT_OK(scanner->NextBatch(batch.get()));
+    if (batch->NumRows() == 0) {
+      continue;
+    }
+    if (!BufferBatch(idx, std::move(batch))) {
+      // The scan ended early, release the scanner on the server.
+      scanner->Close();
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+bool KuduParallelScanner::Data::BufferBatch(int idx, unique_ptr<KuduScanBatch> batch) {
+  MutexLock l(mutex_);
+  // When the batches are returned in token order, the caller may be waiting
+  // for the batches of this very token, so it must not wait for room.
+  while (!closed_ && num_buffered_ >= max_buffered_batches_ &&
+         !(ordered_ && idx == next_token_to_return_)) {
+    cond_.Wait();
+  }
+  if (closed_) {
+    return false;
+  }
+  buffered_[idx].emplace_back(std::move(batch));
+  if (!ordered_) {
+    arrival_order_.push_back(idx);
+  }
+  num_buffered_++;
+  cond_.Broadcast();
+  return true;
+}
+
+bool KuduParallelScanner::Data::HasMoreRows() const {
+  CHECK(open_);
+  MutexLock l(mutex_);
+  return !status_.ok() || num_tokens_done_ < num_tokens_ || num_buffered_ > 0;
+}
+
+Status KuduParallelScanner::Data::NextBatch(KuduScanBatch* batch) {
+  CHECK(open_);
+  unique_ptr<KuduScanBatch> next;
+  {
+    MutexLock l(mutex_);
+    while (true) {
+      RETURN_NOT_OK(status_);
+      int idx = -1;
+      if (ordered_) {
+        // Skip the tokens whose batches were all returned.
+        while (next_token_to_return_ < num_tokens_ &&
+               token_done_[next_token_to_return_] &&
+               buffered_[next_token_to_return_].empty()) {
+          next_token_to_return_++;
+          cond_.Broadcast();
+        }
+        if (next_token_to_return_ == num_tokens_) {
+          break;
+        }
+        if (!buffered_[next_token_to_return_].empty()) {
+          idx = next_token_to_return_;
+        }
+      } else {
+        if (!arrival_order_.empty()) {
+          idx = arrival_order_.front();
+          arrival_order_.pop_front();
+        } else if (num_tokens_done_ == num_tokens_) {
+          break;
+        }
+      }
+      if (idx != -1) {
+        next = std::move(buffered_[idx].front());
+        buffered_[idx].pop_front();
+        num_buffered_--;
+        cond_.Broadcast();
+        break;
+      }
+      cond_.Wait();
+    }
+  }
+
+  if (!next) {
+    // No more data anywhere.
+    batch->data_->Clear();
+    return Status::OK();
+  }
+  std::swap(batch->data_, next->data_);
+  return Status::OK();
+}
+
+void KuduParallelScanner::Data::Close() {
+  {
+    MutexLock l(mutex_);
+    closed_ = true;
+    cond_.Broadcast();
+  }
+  if (pool_) {
+    pool_->Shutdown();
+  }
+}
+
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ThreadPool;
+
+namespace client {
+
+class KuduParallelScanner::Data {
+ public:
+  explicit Data(const std::vector<KuduScanToken*>& tokens);
+  ~Data();
+
+  Status Open();
+
+  bool HasMoreRows() const;
+
+  Status NextBatch(KuduScanBatch* batch);
+
+  void Close();
+
+  // Options set before Open().
+  int concurrency_;
+  int max_buffered_batches_;
+  bool ordered_;
+
+  bool open_;
+
+ private:
+  // Scans the tokens which are not claimed by another worker yet, one after
+  // the other, until there are none left or the scan ends.
+  void RunWorker();
+
+  // Scans the token at 'idx', buffering its batches.
+  Status ScanToken(int idx);
+
+  // Buffers 'batch' of the token at 'idx', waiting for room in the buffer.
+  // Returns false if the scanner was closed in the meantime.
+  bool BufferBatch(int idx, std::unique_ptr<KuduScanBatch> batch);
+
+  const std::vector<std::unique_ptr<KuduScanToken>> tokens_;
+  const int num_tokens_;
+
+  // The scanner of each token. The scanners are kept until the parallel
+  // scanner is destroyed, since their batches refer to their projections.
+  std::vector<std::unique_ptr<KuduScanner>> scanners_;
+
+  // The threads scanning the tokens.
+  gscoped_ptr<ThreadPool> pool_;
+
+  // Protects the members below, and is used by 'cond_'.
+  mutable Mutex mutex_;
+
+  // Signaled when a batch is buffered or returned, when a token is done,
+  // and when the scanner is closed.
+  ConditionVariable cond_;
+
+  // The index of the next token to be claimed by a worker.
+  int next_token_;
+
+  // The number of tokens which were scanned completely, or failed.
+  int num_tokens_done_;
+  std::vector<bool> token_done_;
+
+  // The buffered batches of each token.
+  std::vector<std::deque<std::unique_ptr<KuduScanBatch>>> buffered_;
+  int num_buffered_;
+
+  // The tokens of the buffered batches, in the order the batches arrived.
+  // Only used if the batches are not returned in token order.
+  std::deque<int> arrival_order_;
+
+  // The token whose batches are returned next, if the batches are returned
+  // in token order.
+  int next_token_to_return_;
+
+  // The first error of any worker, which fails the whole scan.
+  Status status_;
+
+  bool closed_;
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
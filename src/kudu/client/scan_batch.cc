@@ -54,6 +54,18 @@ const KuduSchema* KuduScanBatch::projection_schema() const {
   return data_->client_projection_;
 }
 
+Status KuduScanBatch::GetFixedLengthColumn(int idx, Slice* data) const {
+  return data_->GetFixedLengthColumn(idx, data);
+}
+
+Status KuduScanBatch::GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const {
+  return data_->GetVariableLengthColumn(idx, offsets, data);
+}
+
+Status KuduScanBatch::GetNonNullBitmapForColumn(int idx, Slice* data) const {
+  return data_->GetNonNullBitmapForColumn(idx, data);
+}
+
 ////////////////////////////////////////////////////////////
 // KuduScanBatch::RowPtr
 ////////////////////////////////////////////////////////////
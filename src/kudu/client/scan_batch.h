@@ -116,8 +116,50 @@ class KUDU_EXPORT KuduScanBatch {
   ///   to have this schema.
   const KuduSchema* projection_schema() const;
 
+  /// @name Columnar accessors.
+  ///
+  /// These methods access the batches of scanners using
+  /// KuduScanner::COLUMNAR_LAYOUT, which don't support row-wise access
+  /// through Row() or iterators. The returned data is only valid for as long
+  /// as this KuduScanBatch object is valid.
+  ///
+  ///@{
+  /// Get the cells of a fixed length column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] data
+  ///   NumRows() cells, each in the in-memory format of the column's type.
+  ///   The contents of NULL cells are undefined.
+  /// @return Operation result status.
+  Status GetFixedLengthColumn(int idx, Slice* data) const WARN_UNUSED_RESULT;
+
+  /// Get the values of a variable length (STRING or BINARY) column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] offsets
+  ///   NumRows() + 1 uint32_t offsets into @c data. The value of row @c i
+  ///   spans from @c offsets[i] to @c offsets[i + 1]. NULL values are empty.
+  /// @param [out] data
+  ///   The concatenated values.
+  /// @return Operation result status.
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const WARN_UNUSED_RESULT;
+
+  /// Get the null bitmap of a nullable column.
+  ///
+  /// @param [in] idx
+  ///   The index of the column in the projection.
+  /// @param [out] data
+  ///   A bitmap with a bit per row, least significant bit first,
+  ///   which is set if the cell is not NULL.
+  /// @return Operation result status.
+  Status GetNonNullBitmapForColumn(int idx, Slice* data) const WARN_UNUSED_RESULT;
+  ///@}
+
  private:
   class KUDU_NO_EXPORT Data;
+  friend class KuduParallelScanner;
   friend class KuduScanner;
   friend class tools::ReplicaDumper;
 
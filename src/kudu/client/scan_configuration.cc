@@ -45,6 +45,7 @@ ScanConfiguration::ScanConfiguration(KuduTable* table)
       read_mode_(KuduScanner::READ_LATEST),
       is_fault_tolerant_(false),
       snapshot_timestamp_(kNoTimestamp),
+      row_format_flags_(KuduScanner::NO_FLAGS),
       timeout_(MonoDelta::FromMilliseconds(KuduScanner::kScanTimeoutMillis)),
       arena_(1024, 1024 * 1024) {
 }
@@ -140,6 +141,39 @@ Status ScanConfiguration::SetCacheBlocks(bool cache_blocks) {
   return Status::OK();
 }
 
+Status ScanConfiguration::SetReadaheadBlocks(int readahead_blocks) {
+  if (readahead_blocks < 0) {
+    return Status::InvalidArgument("readahead depth must not be negative");
+  }
+  spec_.set_readahead_blocks(readahead_blocks);
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetSampleFraction(double fraction) {
+  if (!(fraction > 0 && fraction <= 1)) {
+    return Status::InvalidArgument("sample fraction must be in (0, 1]",
+                                   std::to_string(fraction));
+  }
+  spec_.set_sample_fraction(fraction);
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetLimit(int64_t limit) {
+  if (limit < 0) {
+    return Status::InvalidArgument("limit must not be negative");
+  }
+  spec_.set_limit(limit);
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetRowFormatFlags(uint64_t flags) {
+  if (flags & ~KuduScanner::COLUMNAR_LAYOUT) {
+    return Status::InvalidArgument(strings::Substitute("invalid row format flags: $0", flags));
+  }
+  row_format_flags_ = flags;
+  return Status::OK();
+}
+
 Status ScanConfiguration::SetBatchSizeBytes(uint32_t batch_size) {
   has_batch_size_bytes_ = true;
   batch_size_bytes_ = batch_size;
@@ -176,6 +210,10 @@ void ScanConfiguration::SetTimeoutMillis(int millis) {
   timeout_ = MonoDelta::FromMilliseconds(millis);
 }
 
+void ScanConfiguration::SetMaxStalenessMillis(int millis) {
+  max_staleness_ = MonoDelta::FromMilliseconds(millis);
+}
+
 void ScanConfiguration::OptimizeScanSpec() {
   spec_.OptimizeScan(*table_->schema().schema_,
                      &arena_,
@@ -61,6 +61,16 @@ class ScanConfiguration {
 
   Status SetCacheBlocks(bool cache_blocks);
 
+  Status SetReadaheadBlocks(int readahead_blocks) WARN_UNUSED_RESULT;
+
+  Status SetSampleFraction(double fraction) WARN_UNUSED_RESULT;
+
+  // Sets the maximum number of rows returned by the scan of each tablet.
+  // Not exposed by KuduScanner, whose scan may span several tablets.
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
+  Status SetRowFormatFlags(uint64_t flags) WARN_UNUSED_RESULT;
+
   Status SetBatchSizeBytes(uint32_t batch_size);
 
   Status SetSelection(KuduClient::ReplicaSelection selection) WARN_UNUSED_RESULT;
@@ -75,6 +85,8 @@ class ScanConfiguration {
 
   void SetTimeoutMillis(int millis);
 
+  void SetMaxStalenessMillis(int millis);
+
   void OptimizeScanSpec();
 
   const KuduTable& table() {
@@ -120,6 +132,10 @@ class ScanConfiguration {
     return is_fault_tolerant_;
   }
 
+  uint64_t row_format_flags() const {
+    return row_format_flags_;
+  }
+
   bool has_snapshot_timestamp() const {
     return snapshot_timestamp_ != kNoTimestamp;
   }
@@ -133,6 +149,14 @@ class ScanConfiguration {
     return timeout_;
   }
 
+  bool has_max_staleness() const {
+    return max_staleness_.Initialized();
+  }
+
+  const MonoDelta& max_staleness() const {
+    return max_staleness_;
+  }
+
   Arena* arena() {
     return &arena_;
   }
@@ -165,8 +189,14 @@ class ScanConfiguration {
 
   uint64_t snapshot_timestamp_;
 
+  uint64_t row_format_flags_;
+
   MonoDelta timeout_;
 
+  // The maximum staleness of bounded-staleness snapshot scans. Uninitialized
+  // if the scan should not read a stale snapshot.
+  MonoDelta max_staleness_;
+
   // Manages interior allocations for the scan spec and copied bounds.
   Arena arena_;
 
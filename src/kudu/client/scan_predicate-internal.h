@@ -17,6 +17,7 @@
 #ifndef KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 #define KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 
+#include <string>
 #include <vector>
 
 #include "kudu/client/scan_predicate.h"
@@ -24,6 +25,7 @@
 #include "kudu/client/value.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/status.h"
 
@@ -116,6 +118,27 @@ class InListPredicateData : public KuduPredicate::Data {
   std::vector<KuduValue*> vals_;
 };
 
+// A bloom filter predicate for a column and a single filter.
+class InBloomFilterPredicateData : public KuduPredicate::Data {
+ public:
+  InBloomFilterPredicateData(ColumnSchema col, std::string filter_data,
+                             int n_hashes, BloomFilterLayout layout);
+
+  virtual ~InBloomFilterPredicateData();
+
+  Status AddToScanSpec(ScanSpec* spec, Arena* arena) override;
+
+  InBloomFilterPredicateData* Clone() const override {
+    return new InBloomFilterPredicateData(col_, filter_data_, n_hashes_, layout_);
+  }
+
+ private:
+  ColumnSchema col_;
+  std::string filter_data_;
+  int n_hashes_;
+  BloomFilterLayout layout_;
+};
+
 } // namespace client
 } // namespace kudu
 #endif /* KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H */
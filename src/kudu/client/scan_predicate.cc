@@ -18,6 +18,7 @@
 #include "kudu/client/scan_predicate.h"
 
 #include <boost/optional.hpp>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -29,6 +30,7 @@
 #include "kudu/gutil/strings/substitute.h"
 
 using std::move;
+using std::string;
 using std::vector;
 using boost::optional;
 
@@ -139,5 +141,40 @@ Status InListPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
   return Status::OK();
 }
 
+InBloomFilterPredicateData::InBloomFilterPredicateData(ColumnSchema col,
+                                                       string filter_data,
+                                                       int n_hashes,
+                                                       BloomFilterLayout layout)
+    : col_(move(col)),
+      filter_data_(move(filter_data)),
+      n_hashes_(n_hashes),
+      layout_(layout) {
+}
+
+InBloomFilterPredicateData::~InBloomFilterPredicateData() {
+}
+
+Status InBloomFilterPredicateData::AddToScanSpec(ScanSpec* spec, Arena* arena) {
+  if (layout_ == BloomFilterLayout::BLOCKED) {
+    if (filter_data_.empty() || filter_data_.size() % BloomFilter::kBucketBytes != 0) {
+      return Status::InvalidArgument(
+          Substitute("Bloom filter of $0 bytes is not a whole number of buckets",
+                     filter_data_.size()));
+    }
+  } else if (filter_data_.empty() || n_hashes_ <= 0) {
+    return Status::InvalidArgument("Bloom filter must be non-empty and have hashes",
+                                   col_.name());
+  }
+
+  // The filter must outlive the scan spec, which shares the lifetime of the
+  // arena.
+  uint8_t* data = static_cast<uint8_t*>(arena->AllocateBytes(filter_data_.size()));
+  memcpy(data, filter_data_.data(), filter_data_.size());
+  const BloomFilter* filter = arena->NewObject<BloomFilter>(
+      Slice(data, filter_data_.size()), n_hashes_, layout_);
+  spec->AddPredicate(ColumnPredicate::InBloomFilter(col_, { filter }, nullptr, nullptr));
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
@@ -18,6 +18,7 @@
 #include "kudu/client/scan_token-internal.h"
 
 #include <boost/optional.hpp>
+#include <set>
 #include <vector>
 #include <string>
 #include <memory>
@@ -27,11 +28,14 @@
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/replica-internal.h"
 #include "kudu/client/scanner-internal.h"
+#include "kudu/client/table-internal.h"
 #include "kudu/client/tablet-internal.h"
 #include "kudu/client/tablet_server-internal.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 
@@ -161,8 +165,78 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
   return Status::OK();
 }
 
+Status KuduScanTokenBuilder::Data::NewClientTablet(const internal::RemoteTablet& tablet,
+                                                   unique_ptr<KuduTablet>* client_tablet) {
+  vector<internal::RemoteReplica> replicas;
+  tablet.GetRemoteReplicas(&replicas);
+
+  vector<const KuduReplica*> client_replicas;
+  ElementDeleter deleter(&client_replicas);
+  for (const auto& r : replicas) {
+    vector<HostPort> host_ports;
+    r.ts->GetHostPorts(&host_ports);
+    if (host_ports.empty()) {
+      return Status::IllegalState(Substitute(
+          "No host found for tablet server $0", r.ts->ToString()));
+    }
+    unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
+    client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
+                                                  host_ports[0]);
+    bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
+    unique_ptr<KuduReplica> client_replica(new KuduReplica);
+    client_replica->data_ = new KuduReplica::Data(is_leader,
+                                                  std::move(client_ts));
+    client_replicas.push_back(client_replica.release());
+  }
+
+  client_tablet->reset(new KuduTablet);
+  (*client_tablet)->data_ = new KuduTablet::Data(tablet.tablet_id(),
+                                                 std::move(client_replicas));
+  client_replicas.clear();
+  return Status::OK();
+}
+
 KuduScanTokenBuilder::Data::Data(KuduTable* table)
-    : configuration_(table) {
+    : configuration_(table),
+      split_size_bytes_(0) {
+}
+
+Status KuduScanTokenBuilder::Data::SplitKeyRange(
+    const scoped_refptr<internal::RemoteTablet>& tablet,
+    const string& lower_bound,
+    const string& upper_bound,
+    const MonoTime& deadline,
+    vector<tserver::KeyRangePB>* ranges) {
+  KuduClient* client = configuration_.table_->client();
+  internal::RemoteTabletServer* ts;
+  vector<internal::RemoteTabletServer*> candidates;
+  RETURN_NOT_OK(client->data_->GetTabletServer(client,
+                                               tablet,
+                                               configuration_.selection(),
+                                               std::set<string>(),
+                                               &candidates,
+                                               &ts));
+
+  tserver::SplitKeyRangeRequestPB req;
+  req.set_tablet_id(tablet->tablet_id());
+  if (!lower_bound.empty()) {
+    req.set_start_primary_key(lower_bound);
+  }
+  if (!upper_bound.empty()) {
+    req.set_stop_primary_key(upper_bound);
+  }
+  req.set_target_chunk_size_bytes(split_size_bytes_);
+
+  tserver::SplitKeyRangeResponsePB resp;
+  rpc::RpcController rpc;
+  rpc.set_deadline(deadline);
+  rpc.RequireServerFeature(tserver::TabletServerFeatures::SPLIT_KEY_RANGE);
+  RETURN_NOT_OK(ts->proxy()->SplitKeyRange(req, &resp, &rpc));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  ranges->assign(resp.ranges().begin(), resp.ranges().end());
+  return Status::OK();
 }
 
 Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
@@ -191,10 +265,6 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
     pb.clear_upper_bound_primary_key();
   }
 
-  for (const auto& predicate_pair : configuration_.spec().predicates()) {
-    ColumnPredicateToPB(predicate_pair.second, pb.add_column_predicates());
-  }
-
   const KuduScanner::ReadMode read_mode = configuration_.read_mode();
   switch (read_mode) {
     case KuduScanner::READ_LATEST:
@@ -221,7 +291,7 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
   MonoTime deadline = MonoTime::Now() + client->default_admin_operation_timeout();
 
   PartitionPruner pruner;
-  pruner.Init(*table->schema().schema_, table->partition_schema(), configuration_.spec());
+  table->data_->InitPartitionPruner(configuration_.spec(), &pruner);
   while (pruner.HasMorePartitionKeyRanges()) {
     scoped_refptr<internal::RemoteTablet> tablet;
     Synchronizer sync;
@@ -249,49 +319,64 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
       continue;
     }
 
-    vector<internal::RemoteReplica> replicas;
-    tablet->GetRemoteReplicas(&replicas);
-
-    vector<const KuduReplica*> client_replicas;
-    ElementDeleter deleter(&client_replicas);
-
-    // Convert the replicas from their internal format to something appropriate
-    // for clients.
-    for (const auto& r : replicas) {
-      vector<HostPort> host_ports;
-      r.ts->GetHostPorts(&host_ports);
-      if (host_ports.empty()) {
-        return Status::IllegalState(Substitute(
-            "No host found for tablet server $0", r.ts->ToString()));
+    // Split the tablet's scan into several tokens if requested. Otherwise,
+    // or if the tablet cannot be split, it is scanned by a single token over
+    // the primary key bounds of the scan.
+    vector<tserver::KeyRangePB> ranges;
+    if (split_size_bytes_ > 0) {
+      Status split_status = SplitKeyRange(tablet,
+                                          pb.lower_bound_primary_key(),
+                                          pb.upper_bound_primary_key(),
+                                          deadline,
+                                          &ranges);
+      if (!split_status.ok()) {
+        LOG(WARNING) << "Unable to split the key range of tablet " << tablet->tablet_id()
+                     << ", scanning it with a single token: " << split_status.ToString();
+        ranges.clear();
       }
-      unique_ptr<KuduTabletServer> client_ts(new KuduTabletServer);
-      client_ts->data_ = new KuduTabletServer::Data(r.ts->permanent_uuid(),
-                                                    host_ports[0]);
-      bool is_leader = r.role == consensus::RaftPeerPB::LEADER;
-      unique_ptr<KuduReplica> client_replica(new KuduReplica);
-      client_replica->data_ = new KuduReplica::Data(is_leader,
-                                                    std::move(client_ts));
-      client_replicas.push_back(client_replica.release());
+    }
+    if (ranges.empty()) {
+      tserver::KeyRangePB range;
+      if (pb.has_lower_bound_primary_key()) {
+        range.set_start_primary_key(pb.lower_bound_primary_key());
+      }
+      if (pb.has_upper_bound_primary_key()) {
+        range.set_stop_primary_key(pb.upper_bound_primary_key());
+      }
+      ranges.push_back(std::move(range));
     }
 
-    unique_ptr<KuduTablet> client_tablet(new KuduTablet);
-    client_tablet->data_ = new KuduTablet::Data(tablet->tablet_id(),
-                                                std::move(client_replicas));
-    client_replicas.clear();
-
-    // Create the scan token itself.
-    ScanTokenPB message;
-    message.CopyFrom(pb);
-    message.set_lower_bound_partition_key(
-        tablet->partition().partition_key_start());
-    message.set_upper_bound_partition_key(
-        tablet->partition().partition_key_end());
-    unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
-    client_scan_token->data_ =
-        new KuduScanToken::Data(table,
-                                std::move(message),
-                                std::move(client_tablet));
-    tokens->push_back(client_scan_token.release());
+    for (const tserver::KeyRangePB& range : ranges) {
+      unique_ptr<KuduTablet> client_tablet;
+      RETURN_NOT_OK(NewClientTablet(*tablet, &client_tablet));
+
+      // Create the scan token itself.
+      ScanTokenPB message;
+      message.CopyFrom(pb);
+      message.set_lower_bound_partition_key(
+          tablet->partition().partition_key_start());
+      message.set_upper_bound_partition_key(
+          tablet->partition().partition_key_end());
+      message.clear_column_predicates();
+      table->data_->PredicatesForPartitionToPB(configuration_.spec(), tablet->partition(),
+                                               message.mutable_column_predicates());
+      if (range.has_start_primary_key()) {
+        message.set_lower_bound_primary_key(range.start_primary_key());
+      } else {
+        message.clear_lower_bound_primary_key();
+      }
+      if (range.has_stop_primary_key()) {
+        message.set_upper_bound_primary_key(range.stop_primary_key());
+      } else {
+        message.clear_upper_bound_primary_key();
+      }
+      unique_ptr<KuduScanToken> client_scan_token(new KuduScanToken);
+      client_scan_token->data_ =
+          new KuduScanToken::Data(table,
+                                  std::move(message),
+                                  std::move(client_tablet));
+      tokens->push_back(client_scan_token.release());
+    }
     pruner.RemovePartitionKeyRange(tablet->partition().partition_key_end());
   }
   return Status::OK();
@@ -24,10 +24,22 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client.pb.h"
 #include "kudu/client/scan_configuration.h"
+#include "kudu/gutil/ref_counted.h"
 
 namespace kudu {
+
+class MonoTime;
+
+namespace tserver {
+class KeyRangePB;
+} // namespace tserver
+
 namespace client {
 
+namespace internal {
+class RemoteTablet;
+} // namespace internal
+
 class KuduScanToken::Data {
  public:
   explicit Data(KuduTable* table,
@@ -71,8 +83,29 @@ class KuduScanTokenBuilder::Data {
     return &configuration_;
   }
 
+  void SetSplitSizeBytes(uint64_t split_size_bytes) {
+    split_size_bytes_ = split_size_bytes;
+  }
+
  private:
+  // Convert the replicas of 'tablet' from their internal format to something
+  // appropriate for clients, returning them in a new 'client_tablet'.
+  static Status NewClientTablet(const internal::RemoteTablet& tablet,
+                                std::unique_ptr<KuduTablet>* client_tablet);
+
+  // Ask a replica of 'tablet' to split its primary keys within
+  // [lower_bound, upper_bound) into ranges of about 'split_size_bytes_' each.
+  // Empty bounds are unbounded.
+  Status SplitKeyRange(const scoped_refptr<internal::RemoteTablet>& tablet,
+                       const std::string& lower_bound,
+                       const std::string& upper_bound,
+                       const MonoTime& deadline,
+                       std::vector<tserver::KeyRangePB>* ranges);
+
   ScanConfiguration configuration_;
+
+  // The target data size of each token, or 0 for one token per tablet.
+  uint64_t split_size_bytes_;
 };
 
 } // namespace client
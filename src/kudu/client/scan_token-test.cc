@@ -26,8 +26,11 @@
 #include "kudu/client/client.pb.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/test_util.h"
 
 namespace kudu {
@@ -40,6 +43,7 @@ using std::thread;
 using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
+using tablet::TabletPeer;
 using tserver::MiniTabletServer;
 
 class ScanTokenTest : public KuduTest {
@@ -402,5 +406,214 @@ TEST_F(ScanTokenTest, TestTimestampPropagation) {
   }
 }
 
+TEST_F(ScanTokenTest, TestSplitSizeBytes) {
+  const int kNumRows = 10000;
+
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("col")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // Create a table with a single tablet.
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .set_range_partition_columns({ "col" })
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(10000);
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("col", i));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  // Only flushed data is accounted for when splitting.
+  vector<scoped_refptr<TabletPeer>> peers;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+  ASSERT_EQ(1, peers.size());
+  ASSERT_OK(peers[0]->tablet()->Flush());
+
+  { // one token per tablet by default
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    ASSERT_OK(KuduScanTokenBuilder(table.get()).Build(&tokens));
+    ASSERT_EQ(1, tokens.size());
+    ASSERT_EQ(kNumRows, CountRows(tokens));
+  }
+
+  { // small chunks
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(1024));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_GT(tokens.size(), 1);
+    ASSERT_EQ(kNumRows, CountRows(tokens));
+    for (const KuduScanToken* token : tokens) {
+      ASSERT_EQ(peers[0]->tablet_id(), token->tablet().id());
+    }
+  }
+
+  { // small chunks within primary key bounds
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    unique_ptr<KuduPartialRow> lower(schema.NewRow());
+    ASSERT_OK(lower->SetInt64("col", 1000));
+    unique_ptr<KuduPartialRow> upper(schema.NewRow());
+    ASSERT_OK(upper->SetInt64("col", 3000));
+    ASSERT_OK(builder.AddLowerBound(*lower));
+    ASSERT_OK(builder.AddUpperBound(*upper));
+    ASSERT_OK(builder.SetSplitSizeBytes(1024));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_GT(tokens.size(), 1);
+    ASSERT_EQ(2000, CountRows(tokens));
+  }
+}
+
+TEST_F(ScanTokenTest, TestParallelScanner) {
+  const int kNumRows = 1000;
+
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("col")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // Create a table with four range partitioned tablets.
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    for (int i = 1; i < 4; i++) {
+      unique_ptr<KuduPartialRow> split(schema.NewRow());
+      ASSERT_OK(split->SetInt64("col", i * kNumRows / 4));
+      table_creator->add_range_partition_split(split.release());
+    }
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .set_range_partition_columns({ "col" })
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(10000);
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("col", i));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  for (bool ordered : { false, true }) {
+    SCOPED_TRACE(ordered);
+    vector<KuduScanToken*> tokens;
+    KuduScanTokenBuilder builder(table.get());
+    // Use small batches so that the buffer fills up.
+    ASSERT_OK(builder.SetBatchSizeBytes(128));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_EQ(4, tokens.size());
+
+    KuduParallelScanner scanner(tokens);
+    ASSERT_OK(scanner.SetConcurrency(3));
+    ASSERT_OK(scanner.SetMaxBufferedBatches(2));
+    ASSERT_OK(scanner.SetOrdered(ordered));
+    ASSERT_OK(scanner.Open());
+
+    int num_rows = 0;
+    int64_t last_key = -1;
+    KuduScanBatch batch;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      for (int i = 0; i < batch.NumRows(); i++) {
+        int64_t key;
+        ASSERT_OK(batch.Row(i).GetInt64("col", &key));
+        if (ordered) {
+          ASSERT_GT(key, last_key);
+        }
+        last_key = key;
+        num_rows++;
+      }
+    }
+    ASSERT_EQ(kNumRows, num_rows);
+  }
+}
+
+TEST_F(ScanTokenTest, TestMergeScanner) {
+  const int kNumRows = 1000;
+
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("col")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // Create a table with four hash partitioned tablets.
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .add_hash_partitions({ "col" }, 4)
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(10000);
+  ASSERT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND));
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("col", i));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  for (int64_t limit : { -1, 0, 10, 500 }) {
+    SCOPED_TRACE(limit);
+    vector<KuduScanToken*> tokens;
+    KuduScanTokenBuilder builder(table.get());
+    // Use small batches so that the batches of the tablets are interleaved.
+    ASSERT_OK(builder.SetBatchSizeBytes(128));
+    ASSERT_OK(builder.Build(&tokens));
+    ASSERT_EQ(4, tokens.size());
+
+    KuduMergeScanner scanner(tokens);
+    if (limit >= 0) {
+      ASSERT_OK(scanner.SetLimit(limit));
+    }
+    ASSERT_OK(scanner.Open());
+
+    int num_rows = 0;
+    vector<KuduScanBatch::RowPtr> rows;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&rows));
+      for (const auto& row : rows) {
+        int64_t key;
+        ASSERT_OK(row.GetInt64("col", &key));
+        ASSERT_EQ(num_rows, key);
+        num_rows++;
+      }
+    }
+    ASSERT_EQ(limit >= 0 ? limit : kNumRows, num_rows);
+  }
+}
+
 } // namespace client
 } // namespace kudu
@@ -20,24 +20,51 @@
 #include <algorithm>
 #include <boost/bind.hpp>
 #include <cmath>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <gflags/gflags.h>
+
+#include "kudu/client/callbacks.h"
 #include "kudu/client/client-internal.h"
 #include "kudu/client/meta_cache.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/table-internal.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/rpc_controller.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_bool(client_hedged_scan_open, false,
+            "Whether requests opening the scan of a tablet on a replica other than "
+            "the leader are sent to a second replica as well when the first replica "
+            "does not respond within the usual latency of its RPCs. The first "
+            "successful response is used.");
+TAG_FLAG(client_hedged_scan_open, experimental);
+TAG_FLAG(client_hedged_scan_open, runtime);
+
+DEFINE_int32(client_hedged_scan_open_min_delay_ms, 5,
+             "Minimum time (in milliseconds) to wait for the response to a request "
+             "opening a scan before hedging it, when --client_hedged_scan_open is enabled.");
+TAG_FLAG(client_hedged_scan_open_min_delay_ms, experimental);
+TAG_FLAG(client_hedged_scan_open_min_delay_ms, runtime);
 
 using google::protobuf::FieldDescriptor;
 using google::protobuf::Reflection;
 
 using std::set;
+using std::shared_ptr;
 using std::string;
+using std::vector;
 
 namespace kudu {
 
@@ -45,12 +72,102 @@ using rpc::RpcController;
 using strings::Substitute;
 using strings::SubstituteAndAppend;
 using tserver::NewScanRequestPB;
+using tserver::ScanRequestPB;
+using tserver::ScanResponsePB;
 using tserver::TabletServerFeatures;
+using tserver::TabletServerServiceProxy;
 
 namespace client {
 
 using internal::RemoteTabletServer;
 
+namespace {
+
+// Folds the round-trip time of a scan RPC sent to 'ts' at 'start' into the
+// latency estimate of 'ts', if the RPC got as far as the server. Timeouts are
+// recorded too, so that a hung server looks slow rather than unknown.
+void RecordScanRpcLatency(RemoteTabletServer* ts, const MonoTime& start,
+                          const Status& rpc_status) {
+  if (rpc_status.ok() || rpc_status.IsRemoteError() || rpc_status.IsTimedOut()) {
+    ts->RecordRpcLatency(MonoTime::Now() - start);
+  }
+}
+
+// The state of a scan RPC sent to two replicas by SendHedgedScanRpc(). It is
+// shared with the callbacks of the RPCs, which may outlive the scanner.
+struct HedgedScanRpc {
+  struct Attempt {
+    RemoteTabletServer* ts = nullptr;
+    shared_ptr<TabletServerServiceProxy> proxy;
+    RpcController controller;
+    ScanResponsePB resp;
+    MonoTime start;
+    bool done = false;
+
+    bool Succeeded() const {
+      return controller.status().ok() && !resp.has_error();
+    }
+  };
+
+  HedgedScanRpc() : cond(&mutex) {}
+
+  Mutex mutex;
+  ConditionVariable cond;
+  Attempt attempts[2];
+  int num_sent = 0;
+  // The index of the attempt whose response the scanner used, or -1 while
+  // the scanner has not decided yet.
+  int winner = -1;
+};
+
+struct CloseHedgedScannerCallback {
+  RpcController controller;
+  ScanResponsePB response;
+  string scanner_id;
+  void Callback() {
+    if (!controller.status().ok()) {
+      LOG(WARNING) << "Couldn't close scanner " << scanner_id << " opened by a hedged request: "
+                   << controller.status().ToString();
+    }
+    delete this;
+  }
+};
+
+// Closes the scanner opened by the unused 'attempt' of a hedged scan RPC, if any.
+void CloseHedgedScanner(HedgedScanRpc::Attempt* attempt) {
+  if (!attempt->Succeeded() || !attempt->resp.has_more_results() ||
+      attempt->resp.scanner_id().empty()) {
+    return;
+  }
+  ScanRequestPB req;
+  req.set_scanner_id(attempt->resp.scanner_id());
+  req.set_close_scanner(true);
+  req.set_batch_size_bytes(0);
+  gscoped_ptr<CloseHedgedScannerCallback> closer(new CloseHedgedScannerCallback);
+  closer->scanner_id = attempt->resp.scanner_id();
+  closer->controller.set_timeout(MonoDelta::FromSeconds(10));
+  attempt->proxy->ScanAsync(req, &closer->response, &closer->controller,
+                            boost::bind(&CloseHedgedScannerCallback::Callback, closer.get()));
+  ignore_result(closer.release());
+}
+
+void HedgedScanAttemptDone(const shared_ptr<HedgedScanRpc>& rpc, int idx) {
+  HedgedScanRpc::Attempt* attempt = &rpc->attempts[idx];
+  RecordScanRpcLatency(attempt->ts, attempt->start, attempt->controller.status());
+  bool close;
+  {
+    MutexLock l(rpc->mutex);
+    attempt->done = true;
+    close = rpc->winner != -1 && rpc->winner != idx;
+    rpc->cond.Broadcast();
+  }
+  if (close) {
+    CloseHedgedScanner(attempt);
+  }
+}
+
+} // anonymous namespace
+
 KuduScanner::Data::Data(KuduTable* table)
   : configuration_(table),
     open_(false),
@@ -94,6 +211,7 @@ Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
     case ScanRpcStatus::SCANNER_EXPIRED:
       break;
     case ScanRpcStatus::TABLET_NOT_RUNNING:
+    case ScanRpcStatus::REPLICA_TOO_STALE:
       blacklist_location = true;
       break;
     case ScanRpcStatus::TABLET_NOT_FOUND:
@@ -202,6 +320,11 @@ ScanRpcStatus KuduScanner::Data::AnalyzeResponse(const Status& rpc_status,
       return ScanRpcStatus{ScanRpcStatus::TABLET_NOT_RUNNING, server_status};
     case tserver::TabletServerErrorPB::TABLET_NOT_FOUND:
       return ScanRpcStatus{ScanRpcStatus::TABLET_NOT_FOUND, server_status};
+    case tserver::TabletServerErrorPB::REPLICA_TOO_STALE:
+      return ScanRpcStatus{ScanRpcStatus::REPLICA_TOO_STALE, server_status};
+    case tserver::TabletServerErrorPB::THROTTLED:
+      // E.g. too many scans are running on the server; back off and retry.
+      return ScanRpcStatus{ScanRpcStatus::SERVER_BUSY, server_status};
     default:
       return ScanRpcStatus{ScanRpcStatus::OTHER_TS_ERROR, server_status};
   }
@@ -221,8 +344,8 @@ Status KuduScanner::Data::ReopenCurrentTablet(const MonoTime& deadline,
                     blacklist);
 }
 
-ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
-                                             bool allow_time_for_failover) {
+MonoTime KuduScanner::Data::PrepareScanRpc(const MonoTime& overall_deadline,
+                                           bool allow_time_for_failover) {
   // The user has specified a timeout which should apply to the total time for each call
   // to NextBatch(). However, for fault-tolerant scans, or for when we are first opening
   // a scanner, it's preferable to set a shorter timeout (the "default RPC timeout") for
@@ -241,17 +364,232 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
   if (!configuration_.spec().predicates().empty()) {
     controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
   }
-  ScanRpcStatus scan_status = AnalyzeResponse(
-      proxy_->Scan(next_req_,
-                   &last_response_,
-                   &controller_),
-      rpc_deadline, overall_deadline);
+  if (configuration_.row_format_flags() & KuduScanner::COLUMNAR_LAYOUT) {
+    controller_.RequireServerFeature(TabletServerFeatures::COLUMNAR_LAYOUT_FORMAT);
+  }
+  return rpc_deadline;
+}
+
+ScanRpcStatus KuduScanner::Data::FinishScanRpc(const Status& rpc_status,
+                                               const MonoTime& overall_deadline,
+                                               const MonoTime& rpc_deadline) {
+  ScanRpcStatus scan_status = AnalyzeResponse(rpc_status, rpc_deadline, overall_deadline);
   if (scan_status.result == ScanRpcStatus::OK) {
     UpdateResourceMetrics();
   }
   return scan_status;
 }
 
+ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
+                                             bool allow_time_for_failover) {
+  MonoTime rpc_deadline = PrepareScanRpc(overall_deadline, allow_time_for_failover);
+  MonoTime start = MonoTime::Now();
+  Status rpc_status = proxy_->Scan(next_req_, &last_response_, &controller_);
+  RecordScanRpcLatency(ts_, start, rpc_status);
+  return FinishScanRpc(rpc_status, overall_deadline, rpc_deadline);
+}
+
+void KuduScanner::Data::SendScanRpcAsync(const MonoTime& overall_deadline,
+                                         bool allow_time_for_failover,
+                                         std::function<void(const ScanRpcStatus&)> cb) {
+  MonoTime rpc_deadline = PrepareScanRpc(overall_deadline, allow_time_for_failover);
+  MonoTime start = MonoTime::Now();
+  proxy_->ScanAsync(next_req_, &last_response_, &controller_,
+                    [this, start, overall_deadline, rpc_deadline, cb]() {
+                      RecordScanRpcLatency(ts_, start, controller_.status());
+                      cb(FinishScanRpc(controller_.status(), overall_deadline, rpc_deadline));
+                    });
+}
+
+ScanRpcStatus KuduScanner::Data::SendHedgedScanRpc(const MonoTime& overall_deadline,
+                                                   bool allow_time_for_failover,
+                                                   RemoteTabletServer* hedge_ts,
+                                                   const MonoDelta& hedge_delay) {
+  MonoTime rpc_deadline = PrepareScanRpc(overall_deadline, allow_time_for_failover);
+  shared_ptr<HedgedScanRpc> rpc(new HedgedScanRpc);
+
+  // The request is serialized when it is sent, so 'next_req_' does not need
+  // to outlive the attempt which ends up unused.
+  auto send = [&](RemoteTabletServer* ts) {
+    int idx = rpc->num_sent++;
+    HedgedScanRpc::Attempt* attempt = &rpc->attempts[idx];
+    attempt->ts = ts;
+    attempt->proxy = ts->proxy();
+    attempt->controller.set_deadline(rpc_deadline);
+    for (uint32_t feature : controller_.required_server_features()) {
+      attempt->controller.RequireServerFeature(feature);
+    }
+    attempt->start = MonoTime::Now();
+    attempt->proxy->ScanAsync(next_req_, &attempt->resp, &attempt->controller,
+                              [rpc, idx]() { HedgedScanAttemptDone(rpc, idx); });
+  };
+
+  send(ts_);
+  MutexLock l(rpc->mutex);
+  MonoTime hedge_time = MonoTime::Now() + hedge_delay;
+  while (!rpc->attempts[0].done) {
+    MonoTime now = MonoTime::Now();
+    if (now >= hedge_time) {
+      break;
+    }
+    rpc->cond.TimedWait(hedge_time - now);
+  }
+  if (!rpc->attempts[0].done) {
+    VLOG(1) << "No response from " << ts_->ToString() << " within " << hedge_delay.ToString()
+            << ", hedging the scan of tablet " << remote_->tablet_id()
+            << " to " << hedge_ts->ToString();
+    // The callback of the request may run on this thread if sending fails.
+    l.Unlock();
+    send(hedge_ts);
+    l.Lock();
+  }
+
+  // Use the first successful response. If both requests fail, the failure
+  // of the first one is handled like that of an unhedged request.
+  while (rpc->winner == -1) {
+    bool all_done = true;
+    for (int i = 0; i < rpc->num_sent; i++) {
+      const HedgedScanRpc::Attempt& attempt = rpc->attempts[i];
+      if (attempt.done && attempt.Succeeded()) {
+        rpc->winner = i;
+        break;
+      }
+      all_done &= attempt.done;
+    }
+    if (rpc->winner == -1) {
+      if (all_done) {
+        rpc->winner = 0;
+      } else {
+        rpc->cond.Wait();
+      }
+    }
+  }
+  // The attempts which are done already are closed here; the others are
+  // closed by their callbacks.
+  vector<HedgedScanRpc::Attempt*> to_close;
+  for (int i = 0; i < rpc->num_sent; i++) {
+    if (i != rpc->winner && rpc->attempts[i].done) {
+      to_close.push_back(&rpc->attempts[i]);
+    }
+  }
+  l.Unlock();
+  for (HedgedScanRpc::Attempt* attempt : to_close) {
+    CloseHedgedScanner(attempt);
+  }
+
+  HedgedScanRpc::Attempt* winner = &rpc->attempts[rpc->winner];
+  ts_ = winner->ts;
+  proxy_ = winner->proxy;
+  last_response_.Swap(&winner->resp);
+  controller_.Swap(&winner->controller);
+  return FinishScanRpc(controller_.status(), overall_deadline, rpc_deadline);
+}
+
+Status KuduScanner::Data::HandleContinueError(const ScanRpcStatus& result,
+                                              const MonoTime& deadline,
+                                              bool* retry) {
+  *retry = false;
+  scan_attempts_++;
+
+  set<string> blacklist;
+  Status s = HandleError(result, deadline, &blacklist);
+  if (!s.ok()) {
+    LOG(WARNING) << "Scan at tablet server " << ts_->ToString() << " of tablet "
+                 << DebugString() << " failed: " << result.status.ToString();
+    return s;
+  }
+
+  if (configuration_.is_fault_tolerant()) {
+    LOG(WARNING) << "Attempting to retry scan of tablet " << DebugString() << " elsewhere.";
+    return ReopenCurrentTablet(deadline, &blacklist);
+  }
+
+  if (blacklist.empty()) {
+    // If we didn't blacklist the current server, we can just retry again.
+    *retry = true;
+    return Status::OK();
+  }
+  // If we blacklisted the current server, and it's not fault-tolerant, we can't
+  // retry anywhere, so just propagate the error.
+  return result.status;
+}
+
+void KuduScanner::Data::ContinueScanAsync(KuduScanBatch* batch,
+                                          const MonoTime& deadline,
+                                          KuduStatusCallback* cb) {
+  SendScanRpcAsync(deadline, configuration_.is_fault_tolerant(),
+                   [this, batch, deadline, cb](const ScanRpcStatus& result) {
+    if (result.result == ScanRpcStatus::OK) {
+      if (last_response_.has_last_primary_key()) {
+        last_primary_key_ = last_response_.last_primary_key();
+      }
+      scan_attempts_ = 0;
+      cb->Run(ExtractBatch(batch));
+      return;
+    }
+
+    // Handling the error may back off and look up the locations of the
+    // tablet, neither of which may be done on the reactor thread.
+    Status s = table_->client()->data_->async_pool_->SubmitFunc(
+        [this, batch, deadline, cb, result]() {
+          bool retry;
+          Status s = HandleContinueError(result, deadline, &retry);
+          if (s.ok() && retry) {
+            ContinueScanAsync(batch, deadline, cb);
+            return;
+          }
+          cb->Run(s);
+        });
+    if (!s.ok()) {
+      cb->Run(s);
+    }
+  });
+}
+
+Status KuduScanner::Data::ExtractBatch(KuduScanBatch* batch) {
+  if (configuration_.row_format_flags() & KuduScanner::COLUMNAR_LAYOUT) {
+    return batch->data_->ResetColumnar(&controller_,
+                                       configuration_.projection(),
+                                       configuration_.client_projection(),
+                                       make_gscoped_ptr(last_response_.release_columnar_data()));
+  }
+  return batch->data_->Reset(&controller_,
+                             configuration_.projection(),
+                             configuration_.client_projection(),
+                             make_gscoped_ptr(last_response_.release_data()));
+}
+
+RemoteTabletServer* KuduScanner::Data::SelectHedgeTServer(
+    const vector<RemoteTabletServer*>& candidates,
+    const set<string>& blacklist,
+    MonoDelta* hedge_delay) {
+  // Hedge once the request has taken longer than most requests to 'ts_' do.
+  MonoDelta mean;
+  MonoDelta deviation;
+  if (!ts_->GetLatencyEstimate(&mean, &deviation)) {
+    return nullptr;
+  }
+  vector<RemoteTabletServer*> others;
+  for (RemoteTabletServer* rts : candidates) {
+    if (rts != ts_ && !ContainsKey(blacklist, rts->permanent_uuid())) {
+      others.push_back(rts);
+    }
+  }
+  if (others.empty()) {
+    return nullptr;
+  }
+  RemoteTabletServer* hedge_ts = table_->client()->data_->SelectFastestTServer(others);
+  Synchronizer sync;
+  hedge_ts->InitProxy(table_->client(), sync.AsStatusCallback());
+  if (!sync.Wait().ok()) {
+    return nullptr;
+  }
+  *hedge_delay = MonoDelta::FromNanoseconds(std::max(
+      mean.ToNanoseconds() + 4 * deviation.ToNanoseconds(),
+      MonoDelta::FromMilliseconds(FLAGS_client_hedged_scan_open_min_delay_ms).ToNanoseconds()));
+  return hedge_ts;
+}
+
 Status KuduScanner::Data::OpenTablet(const string& partition_key,
                                      const MonoTime& deadline,
                                      set<string>* blacklist) {
@@ -272,6 +610,8 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
       scan->set_read_mode(kudu::READ_AT_SNAPSHOT);
       if (configuration_.has_snapshot_timestamp()) {
         scan->set_snap_timestamp(configuration_.snapshot_timestamp());
+      } else if (configuration_.has_max_staleness()) {
+        scan->set_max_staleness_us(configuration_.max_staleness().ToMicroseconds());
       }
       break;
     default:
@@ -291,6 +631,18 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   }
 
   scan->set_cache_blocks(configuration_.spec().cache_blocks());
+  if (configuration_.row_format_flags() != KuduScanner::NO_FLAGS) {
+    scan->set_row_format_flags(configuration_.row_format_flags());
+  }
+  if (configuration_.spec().readahead_blocks() > 0) {
+    scan->set_readahead_blocks(configuration_.spec().readahead_blocks());
+  }
+  if (configuration_.spec().sample_fraction() < 1) {
+    scan->set_sample_fraction(configuration_.spec().sample_fraction());
+  }
+  if (configuration_.spec().limit() >= 0) {
+    scan->set_limit(configuration_.spec().limit());
+  }
 
   // For consistent operations, propagate the timestamp among all operations
   // performed the context of the same client.
@@ -299,12 +651,6 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     scan->set_propagated_timestamp(lo_ts);
   }
 
-  // Set up the predicates.
-  scan->clear_column_predicates();
-  for (const auto& col_pred : configuration_.spec().predicates()) {
-    ColumnPredicateToPB(col_pred.second, scan->add_column_predicates());
-  }
-
   if (configuration_.spec().lower_bound_key()) {
     scan->mutable_start_primary_key()->assign(
       reinterpret_cast<const char*>(configuration_.spec().lower_bound_key()->encoded_key().data()),
@@ -349,6 +695,11 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
 
     scan->set_tablet_id(remote_->tablet_id());
 
+    // Set up the predicates, which may depend on the partition of the tablet.
+    scan->clear_column_predicates();
+    table_->data_->PredicatesForPartitionToPB(configuration_.spec(), remote_->partition(),
+                                              scan->mutable_column_predicates());
+
     RemoteTabletServer *ts;
     vector<RemoteTabletServer*> candidates;
     Status lookup_status = table_->client()->data_->GetTabletServer(
@@ -381,7 +732,14 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     proxy_ = ts_->proxy();
 
     bool allow_time_for_failover = static_cast<int>(candidates.size()) - blacklist->size() > 1;
-    ScanRpcStatus scan_status = SendScanRpc(deadline, allow_time_for_failover);
+    RemoteTabletServer* hedge_ts = nullptr;
+    MonoDelta hedge_delay;
+    if (FLAGS_client_hedged_scan_open && configuration_.selection() != KuduClient::LEADER_ONLY) {
+      hedge_ts = SelectHedgeTServer(candidates, *blacklist, &hedge_delay);
+    }
+    ScanRpcStatus scan_status = hedge_ts == nullptr ?
+        SendScanRpc(deadline, allow_time_for_failover) :
+        SendHedgedScanRpc(deadline, allow_time_for_failover, hedge_ts, hedge_delay);
     if (scan_status.result == ScanRpcStatus::OK) {
       last_error_ = Status::OK();
       scan_attempts_ = 0;
@@ -394,12 +752,12 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
 
   next_req_.clear_new_scan_request();
-  data_in_open_ = last_response_.has_data();
+  data_in_open_ = last_response_.has_data() || last_response_.has_columnar_data();
   if (last_response_.has_more_results()) {
     next_req_.set_scanner_id(last_response_.scanner_id());
     VLOG(2) << "Opened tablet " << remote_->tablet_id()
             << ", scanner ID " << last_response_.scanner_id();
-  } else if (last_response_.has_data()) {
+  } else if (data_in_open_) {
     VLOG(2) << "Opened tablet " << remote_->tablet_id() << ", no scanner ID assigned";
   } else {
     VLOG(2) << "Opened tablet " << remote_->tablet_id() << " (no rows), no scanner ID assigned";
@@ -483,7 +841,7 @@ void KuduScanner::Data::UpdateLastError(const Status& error) {
 // KuduScanBatch
 ////////////////////////////////////////////////////////////
 
-KuduScanBatch::Data::Data() : projection_(NULL) {}
+KuduScanBatch::Data::Data() : projection_(NULL), columnar_(false) {}
 
 KuduScanBatch::Data::~Data() {}
 
@@ -527,6 +885,121 @@ Status KuduScanBatch::Data::Reset(RpcController* controller,
   return Status::OK();
 }
 
+Status KuduScanBatch::Data::GetColumnarSidecar(int idx, int64_t expected_size,
+                                               const char* what, Slice* sidecar) {
+  Status s = controller_.GetSidecar(idx, sidecar);
+  if (!s.ok()) {
+    return Status::Corruption(Substitute("Server sent invalid response: $0 "
+                                         "sidecar index corrupt", what), s.ToString());
+  }
+  if (expected_size != -1 && sidecar->size() != static_cast<size_t>(expected_size)) {
+    return Status::Corruption(Substitute("Server sent invalid response: $0 has $1 bytes "
+                                         "but expected $2", what, sidecar->size(),
+                                         expected_size));
+  }
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::ResetColumnar(RpcController* controller,
+                                          const Schema* projection,
+                                          const KuduSchema* client_projection,
+                                          gscoped_ptr<ColumnarRowBlockPB> resp_data) {
+  CHECK(controller->finished());
+  controller_.Swap(controller);
+  projection_ = projection;
+  client_projection_ = client_projection;
+  columnar_ = true;
+  columnar_resp_data_.Swap(resp_data.get());
+
+  if (PREDICT_FALSE(!columnar_resp_data_.has_num_rows())) {
+    return Status::Corruption("Server sent invalid response: no row data");
+  }
+  int num_cols = projection_->num_columns();
+  if (PREDICT_FALSE(columnar_resp_data_.columns_size() != num_cols)) {
+    return Status::Corruption(Substitute("Server sent invalid response: $0 columns "
+                                         "but expected $1",
+                                         columnar_resp_data_.columns_size(), num_cols));
+  }
+  int64_t num_rows = columnar_resp_data_.num_rows();
+  column_data_.resize(num_cols);
+  column_varlen_data_.resize(num_cols);
+  column_non_null_bitmaps_.resize(num_cols);
+  for (int i = 0; i < num_cols; i++) {
+    const ColumnSchema& col = projection_->column(i);
+    const ColumnarRowBlockPB::Column& col_pb = columnar_resp_data_.columns(i);
+    if (col.type_info()->physical_type() == BINARY) {
+      RETURN_NOT_OK(GetColumnarSidecar(col_pb.data_sidecar(),
+                                       (num_rows + 1) * sizeof(uint32_t),
+                                       "varlen offsets", &column_data_[i]));
+      RETURN_NOT_OK(GetColumnarSidecar(col_pb.varlen_data_sidecar(), -1,
+                                       "varlen data", &column_varlen_data_[i]));
+      // Make sure that every value lies within the varlen data.
+      uint32_t prev_offset = 0;
+      for (int64_t row = 0; row <= num_rows; row++) {
+        uint32_t offset;
+        memcpy(&offset, column_data_[i].data() + row * sizeof(uint32_t), sizeof(offset));
+        if (PREDICT_FALSE(offset < prev_offset || offset > column_varlen_data_[i].size())) {
+          return Status::Corruption("Server sent invalid response: bad varlen offsets "
+                                    "for column", col.name());
+        }
+        prev_offset = offset;
+      }
+    } else {
+      RETURN_NOT_OK(GetColumnarSidecar(col_pb.data_sidecar(),
+                                       num_rows * col.type_info()->size(),
+                                       "column data", &column_data_[i]));
+    }
+    if (col.is_nullable()) {
+      RETURN_NOT_OK(GetColumnarSidecar(col_pb.non_null_bitmap_sidecar(), BitmapSize(num_rows),
+                                       "null bitmap", &column_non_null_bitmaps_[i]));
+    }
+  }
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::CheckColumnarColumn(int idx, const ColumnSchema** col) const {
+  if (PREDICT_FALSE(!columnar_)) {
+    return Status::IllegalState("batch is not in columnar layout");
+  }
+  if (PREDICT_FALSE(idx < 0 || idx >= projection_->num_columns())) {
+    return Status::InvalidArgument(Substitute("invalid column index $0", idx));
+  }
+  *col = &projection_->column(idx);
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::GetFixedLengthColumn(int idx, Slice* data) const {
+  const ColumnSchema* col;
+  RETURN_NOT_OK(CheckColumnarColumn(idx, &col));
+  if (PREDICT_FALSE(col->type_info()->physical_type() == BINARY)) {
+    return Status::InvalidArgument("column is variable length", col->name());
+  }
+  *data = column_data_[idx];
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::GetVariableLengthColumn(int idx, Slice* offsets,
+                                                    Slice* data) const {
+  const ColumnSchema* col;
+  RETURN_NOT_OK(CheckColumnarColumn(idx, &col));
+  if (PREDICT_FALSE(col->type_info()->physical_type() != BINARY)) {
+    return Status::InvalidArgument("column is fixed length", col->name());
+  }
+  *offsets = column_data_[idx];
+  *data = column_varlen_data_[idx];
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::GetNonNullBitmapForColumn(int idx, Slice* data) const {
+  const ColumnSchema* col;
+  RETURN_NOT_OK(CheckColumnarColumn(idx, &col));
+  if (PREDICT_FALSE(!col->is_nullable())) {
+    return Status::InvalidArgument("column is not nullable", col->name());
+  }
+  *data = column_non_null_bitmaps_[idx];
+  return Status::OK();
+}
+
 void KuduScanBatch::Data::ExtractRows(vector<KuduScanBatch::RowPtr>* rows) {
   int n_rows = resp_data_.num_rows();
   rows->resize(n_rows);
@@ -554,6 +1027,11 @@ void KuduScanBatch::Data::ExtractRows(vector<KuduScanBatch::RowPtr>* rows) {
 
 void KuduScanBatch::Data::Clear() {
   resp_data_.Clear();
+  columnar_ = false;
+  columnar_resp_data_.Clear();
+  column_data_.clear();
+  column_varlen_data_.clear();
+  column_non_null_bitmaps_.clear();
   controller_.Reset();
 }
 
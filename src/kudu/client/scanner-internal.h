@@ -17,6 +17,7 @@
 #ifndef KUDU_CLIENT_SCANNER_INTERNAL_H
 #define KUDU_CLIENT_SCANNER_INTERNAL_H
 
+#include <functional>
 #include <set>
 #include <string>
 #include <vector>
@@ -68,6 +69,9 @@ struct ScanRpcStatus {
     // The destination tablet does not exist (e.g. because the replica was deleted).
     TABLET_NOT_FOUND,
 
+    // The replica's safe time lagged too far behind to serve a bounded-staleness scan.
+    REPLICA_TOO_STALE,
+
     // Some other unknown tablet server error. This indicates that the TS was running
     // but some problem occurred other than the ones enumerated above.
     OTHER_TS_ERROR
@@ -92,6 +96,41 @@ class KuduScanner::Data {
   // The RPC and TS proxy should already have been prepared in next_req_, proxy_, etc.
   ScanRpcStatus SendScanRpc(const MonoTime& overall_deadline, bool allow_time_for_failover);
 
+  // Like SendScanRpc(), but sends the RPC asynchronously. 'cb' is invoked
+  // with the result of the RPC on a reactor thread, so it must not block.
+  void SendScanRpcAsync(const MonoTime& overall_deadline, bool allow_time_for_failover,
+                        std::function<void(const ScanRpcStatus&)> cb);
+
+  // Like SendScanRpc(), but if no response arrives from 'ts_' within
+  // 'hedge_delay', sends the same request to 'hedge_ts' as well, and uses the
+  // first successful response. The scanner opened by the other request, if
+  // any, is closed. On return, 'ts_' and 'proxy_' point to the server whose
+  // response was used.
+  ScanRpcStatus SendHedgedScanRpc(const MonoTime& overall_deadline,
+                                  bool allow_time_for_failover,
+                                  internal::RemoteTabletServer* hedge_ts,
+                                  const MonoDelta& hedge_delay);
+
+  // Handles the failure 'result' of an RPC continuing the scan of the current
+  // tablet. Returns a non-OK status if the scan can't go on, and otherwise sets
+  // 'retry' if the RPC should be sent again. If the scan is fault-tolerant,
+  // the tablet is reopened on another server instead.
+  //
+  // This function may block, see HandleError().
+  Status HandleContinueError(const ScanRpcStatus& result,
+                             const MonoTime& deadline,
+                             bool* retry);
+
+  // Hands the data of the last response over to 'batch'.
+  Status ExtractBatch(KuduScanBatch* batch);
+
+  // Sends the CONTINUE request prepared in 'next_req_' asynchronously, and
+  // hands the data of its response over to 'batch' before invoking 'cb'.
+  // Failed RPCs are handled and retried like KuduScanner::NextBatch() does,
+  // on the client's pool for the blocking parts of asynchronous operations.
+  void ContinueScanAsync(KuduScanBatch* batch, const MonoTime& deadline,
+                         KuduStatusCallback* cb);
+
   // Called when KuduScanner::NextBatch or KuduScanner::Data::OpenTablet result in an RPC or
   // server error.
   //
@@ -121,6 +160,16 @@ class KuduScanner::Data {
                     const MonoTime& deadline,
                     std::set<std::string>* blacklist);
 
+  // Returns the replica among 'candidates' to send a hedged request opening
+  // the scan of the current tablet to, along with the delay after which the
+  // request should be hedged in 'hedge_delay'. Returns NULL if the request
+  // should not be hedged, for example because the latency of 'ts_' is not
+  // known yet.
+  internal::RemoteTabletServer* SelectHedgeTServer(
+      const std::vector<internal::RemoteTabletServer*>& candidates,
+      const std::set<std::string>& blacklist,
+      MonoDelta* hedge_delay);
+
   Status KeepAlive();
 
   // Returns whether there may exist more tablets to scan.
@@ -245,6 +294,15 @@ class KuduScanner::Data {
 
   void UpdateResourceMetrics();
 
+  // Prepares 'controller_' for the next scan RPC, returning the deadline of
+  // the RPC. See SendScanRpc().
+  MonoTime PrepareScanRpc(const MonoTime& overall_deadline, bool allow_time_for_failover);
+
+  // Analyzes the response to the scan RPC sent with 'rpc_deadline'.
+  ScanRpcStatus FinishScanRpc(const Status& rpc_status,
+                              const MonoTime& overall_deadline,
+                              const MonoTime& rpc_deadline);
+
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
 
@@ -258,17 +316,30 @@ class KuduScanBatch::Data {
                const KuduSchema* client_projection,
                gscoped_ptr<RowwiseRowBlockPB> resp_data);
 
+  // Like Reset(), but for the columnar data of a scan using the
+  // COLUMNAR_LAYOUT row format flag.
+  Status ResetColumnar(rpc::RpcController* controller,
+                       const Schema* projection,
+                       const KuduSchema* client_projection,
+                       gscoped_ptr<ColumnarRowBlockPB> resp_data);
+
   int num_rows() const {
-    return resp_data_.num_rows();
+    return columnar_ ? columnar_resp_data_.num_rows() : resp_data_.num_rows();
   }
 
   KuduRowResult row(int idx) {
+    DCHECK(!columnar_) << "row-wise access to a columnar batch";
     DCHECK_GE(idx, 0);
     DCHECK_LT(idx, num_rows());
     int offset = idx * projected_row_size_;
     return KuduRowResult(projection_, &direct_data_[offset]);
   }
 
+  // Accessors for the columns of columnar batches. See KuduScanBatch.
+  Status GetFixedLengthColumn(int idx, Slice* data) const;
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const;
+  Status GetNonNullBitmapForColumn(int idx, Slice* data) const;
+
   void ExtractRows(vector<KuduScanBatch::RowPtr>* rows);
 
   void Clear();
@@ -295,6 +366,26 @@ class KuduScanBatch::Data {
 
   // The number of bytes of direct data for each row.
   size_t projected_row_size_;
+
+  // Whether this batch holds columnar data.
+  bool columnar_;
+
+  // The PB which describes the sidecars of the columnar data.
+  ColumnarRowBlockPB columnar_resp_data_;
+
+  // Slices into the sidecars of each column of columnar data. Slices of
+  // columns without varlen data or a null bitmap are empty.
+  std::vector<Slice> column_data_;
+  std::vector<Slice> column_varlen_data_;
+  std::vector<Slice> column_non_null_bitmaps_;
+
+ private:
+  // Returns the sidecar at 'idx' in 'sidecar', checking that it is 'expected_size'
+  // bytes long if 'expected_size' is not -1.
+  Status GetColumnarSidecar(int idx, int64_t expected_size, const char* what, Slice* sidecar);
+
+  // Returns the ColumnSchema of column 'idx' of a columnar batch.
+  Status CheckColumnarColumn(int idx, const ColumnSchema** col) const;
 };
 
 } // namespace client
@@ -48,6 +48,7 @@ class WriteRpc;
 class KuduClient;
 class KuduSchema;
 class KuduSchemaBuilder;
+class KuduWriteBatch;
 class KuduWriteOperation;
 
 /// @brief Representation of column storage attributes.
@@ -61,6 +62,10 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     RLE = 4,
     DICT_ENCODING = 5,
     BIT_SHUFFLE = 6,
+    /// Delta-of-delta encoding for integer and timestamp columns.
+    DELTA_OF_DELTA = 7,
+    /// XOR encoding for slowly changing floating point columns.
+    FLOAT_XOR = 8,
 
     /// @deprecated GROUP_VARINT is not supported for valid types, and
     /// will fall back to another encoding on the server side.
@@ -74,6 +79,7 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     SNAPPY = 2,
     LZ4 = 3,
     ZLIB = 4,
+    ZSTD = 5,
   };
 
 
@@ -491,6 +497,7 @@ class KUDU_EXPORT KuduSchema {
   friend class KuduSchemaBuilder;
   friend class KuduTable;
   friend class KuduTableCreator;
+  friend class KuduWriteBatch;
   friend class KuduWriteOperation;
   friend class ScanConfiguration;
   friend class internal::GetTableSchemaRpc;
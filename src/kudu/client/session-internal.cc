@@ -17,6 +17,7 @@
 
 #include "kudu/client/session-internal.h"
 
+#include <algorithm>
 #include <mutex>
 
 #include "kudu/client/batcher.h"
@@ -55,6 +56,9 @@ KuduSession::Data::Data(shared_ptr<KuduClient> client,
       buffer_bytes_limit_(7 * 1024 * 1024),
       buffer_watermark_pct_(50),
       buffer_bytes_used_(0),
+      adaptive_flush_(false),
+      adaptive_watermark_pct_(0),
+      adaptive_batchers_num_limit_(0),
       buffer_pre_flush_enabled_(true) {
 }
 
@@ -65,10 +69,15 @@ void KuduSession::Data::Init(weak_ptr<KuduSession> session) {
 
 void KuduSession::Data::FlushFinished(Batcher* batcher) {
   const int64_t bytes_flushed = batcher->buffer_bytes_used();
+  const MonoTime& flush_start_time = batcher->flush_start_time();
   {
     std::lock_guard<Mutex> l(mutex_);
     buffer_bytes_used_ -= bytes_flushed;
     --batchers_num_;
+    if (adaptive_flush_ && flush_start_time.Initialized()) {
+      AdaptToFlushUnlocked(MonoTime::Now() - flush_start_time,
+                           batcher->server_busy_count() > 0);
+    }
     // The logic of KuduSession::ApplyWriteOp() needs to know
     // if total number of batchers or buffer byte count decreases.
     // There can be a thread waiting on the corresponding condition
@@ -79,6 +88,74 @@ void KuduSession::Data::FlushFinished(Batcher* batcher) {
   }
 }
 
+namespace {
+// The bounds of the adaptive flush watermark and limit on batchers, and the
+// step by which they grow while flushes complete in time.
+const int32_t kAdaptiveWatermarkPctMin = 5;
+const int32_t kAdaptiveWatermarkPctMax = 90;
+const int32_t kAdaptiveWatermarkPctStep = 5;
+const size_t kAdaptiveBatchersNumMax = 8;
+
+// A flush is considered a latency spike if it takes this many times longer
+// than the baseline flush latency.
+const int kAdaptiveLatencySpikeFactor = 2;
+} // anonymous namespace
+
+int64_t KuduSession::Data::FlushWatermarkUnlocked() const {
+  mutex_.AssertAcquired();
+  const int32_t pct = adaptive_flush_ ? adaptive_watermark_pct_ : buffer_watermark_pct_;
+  return buffer_bytes_limit_ * pct / 100;
+}
+
+size_t KuduSession::Data::BatchersNumLimitUnlocked() const {
+  mutex_.AssertAcquired();
+  return adaptive_flush_ ? adaptive_batchers_num_limit_ : batchers_num_limit_;
+}
+
+void KuduSession::Data::AdaptToFlushUnlocked(const MonoDelta& latency, bool server_busy) {
+  mutex_.AssertAcquired();
+  if (!baseline_flush_latency_.Initialized() || latency < baseline_flush_latency_) {
+    baseline_flush_latency_ = latency;
+  } else {
+    // Follow slow changes of the latency, such as those due to the tuning.
+    const int64_t baseline_ns = baseline_flush_latency_.ToNanoseconds();
+    baseline_flush_latency_ = MonoDelta::FromNanoseconds(
+        baseline_ns + (latency.ToNanoseconds() - baseline_ns) / 16);
+  }
+
+  if (server_busy ||
+      latency.ToNanoseconds() >
+      baseline_flush_latency_.ToNanoseconds() * kAdaptiveLatencySpikeFactor) {
+    adaptive_watermark_pct_ = std::max(kAdaptiveWatermarkPctMin, adaptive_watermark_pct_ / 2);
+    adaptive_batchers_num_limit_ = std::max<size_t>(1, adaptive_batchers_num_limit_ / 2);
+  } else {
+    adaptive_watermark_pct_ = std::min(kAdaptiveWatermarkPctMax,
+                                       adaptive_watermark_pct_ + kAdaptiveWatermarkPctStep);
+    adaptive_batchers_num_limit_ = std::min(kAdaptiveBatchersNumMax,
+                                            adaptive_batchers_num_limit_ + 1);
+  }
+  VLOG(2) << "Flush took " << latency.ToString() << (server_busy ? " with" : " without")
+          << " backpressure, flush watermark is now " << adaptive_watermark_pct_
+          << "% and batchers limit " << adaptive_batchers_num_limit_;
+}
+
+Status KuduSession::Data::SetAdaptiveFlush(bool enabled) {
+  std::lock_guard<Mutex> l(mutex_);
+  if (HasPendingOperationsUnlocked()) {
+    // NOTE: this is an artificial restriction.
+    return Status::IllegalState(
+        "Cannot change adaptive flushing when writes are buffered.");
+  }
+  adaptive_flush_ = enabled;
+  // Start from the configured settings.
+  adaptive_watermark_pct_ = std::max(kAdaptiveWatermarkPctMin,
+                                     std::min(kAdaptiveWatermarkPctMax, buffer_watermark_pct_));
+  adaptive_batchers_num_limit_ = batchers_num_limit_ == 0 ? kAdaptiveBatchersNumMax :
+      std::min(kAdaptiveBatchersNumMax, batchers_num_limit_);
+  baseline_flush_latency_ = MonoDelta();
+  return Status::OK();
+}
+
 Status KuduSession::Data::Close(bool force) {
   std::lock_guard<Mutex> l(mutex_);
   if (!batcher_) {
@@ -338,6 +415,7 @@ Status KuduSession::Data::ApplyWriteOp(KuduWriteOperation* write_op) {
   // to get away with not protecting the flush_mode_ since it's read-only
   // access here as well, but TSAN does not like that.
   FlushMode flush_mode;
+  int64_t flush_watermark;
   {
     std::lock_guard<Mutex> l(mutex_);
     flush_mode = flush_mode_;
@@ -405,8 +483,8 @@ Status KuduSession::Data::ApplyWriteOp(KuduWriteOperation* write_op) {
     // Add the operation to the current batcher. If the current batcher
     // is not there, allocate one and set it to be current.
     if (!batcher_) {
-      while (batchers_num_limit_ != 0 &&
-             batchers_num_ >= batchers_num_limit_) {
+      while (BatchersNumLimitUnlocked() != 0 &&
+             batchers_num_ >= BatchersNumLimitUnlocked()) {
         // Wait until it's possible to add a new batcher given the limit
         // on the maximum outstanding batchers per session.
         condition_.Wait();
@@ -432,11 +510,10 @@ Status KuduSession::Data::ApplyWriteOp(KuduWriteOperation* write_op) {
     }
     // Finally, update the buffer space usage.
     buffer_bytes_used_ += required_size;
+    flush_watermark = FlushWatermarkUnlocked();
   }
 
   if (flush_mode == AUTO_FLUSH_BACKGROUND) {
-    const size_t flush_watermark =
-        buffer_bytes_limit_ * buffer_watermark_pct_ / 100;
     // In AUTO_FLUSH_BACKGROUND mode it's necessary to flush the newly added
     // operations if the flush watermark is reached. The current batcher is
     // the exclusive and the only container for the newly added operations.
@@ -85,6 +85,10 @@ class KuduSession::Data {
   // Set the limit on maximum number of batchers with pending operations.
   Status SetMaxBatchersNum(unsigned int period_ms);
 
+  // Enable or disable the tuning of the flush watermark and the limit on
+  // batchers from the observed flush latency and server backpressure.
+  Status SetAdaptiveFlush(bool enabled);
+
   // Set timeout for write operations, in milliseconds.
   void SetTimeoutMillis(int timeout_ms);
 
@@ -229,7 +233,32 @@ class KuduSession::Data {
   // The total number of bytes used by buffered write operations.
   int64_t buffer_bytes_used_;  // protected by mutex_
 
+  // Whether the flush watermark and the limit on batchers are tuned from
+  // the latency of the flushes and the backpressure of the servers,
+  // rather than taken from buffer_watermark_pct_ and batchers_num_limit_.
+  bool adaptive_flush_;  // protected by mutex_
+
+  // The tuned flush watermark, in percentage of the total buffer space, and
+  // the tuned limit on batchers. They grow additively while flushes complete
+  // in time, and are halved on latency spikes or backpressure.
+  int32_t adaptive_watermark_pct_;  // protected by mutex_
+  size_t adaptive_batchers_num_limit_;  // protected by mutex_
+
+  // The reference flush latency for detecting latency spikes: the lowest
+  // latency observed, drifting slowly towards the latencies observed since.
+  MonoDelta baseline_flush_latency_;  // protected by mutex_
+
  private:
+  // Returns the flush watermark (in bytes) and the limit on batchers in
+  // effect. Must be called with mutex_ held.
+  int64_t FlushWatermarkUnlocked() const;
+  size_t BatchersNumLimitUnlocked() const;
+
+  // Tunes the adaptive flush parameters given a flush which took 'latency',
+  // and whose RPCs were rejected by busy servers if 'server_busy' is set.
+  // Must be called with mutex_ held.
+  void AdaptToFlushUnlocked(const MonoDelta& latency, bool server_busy);
+
   FRIEND_TEST(ClientTest, TestAutoFlushBackgroundApplyBlocks);
   FRIEND_TEST(ClientTest, TestAutoFlushBackgroundAndErrorCollector);
 
@@ -17,12 +17,37 @@
 
 #include "kudu/client/table-internal.h"
 
+#include <mutex>
 #include <string>
 
+#include <gflags/gflags.h>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/scan_spec.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_bool(client_cache_partition_pruning_plans, false,
+            "Whether the partition pruning plans of scans are cached on the table, "
+            "to be reused by the later scans whose predicates constrain the same "
+            "hash components.");
+TAG_FLAG(client_cache_partition_pruning_plans, experimental);
+TAG_FLAG(client_cache_partition_pruning_plans, runtime);
+
+DEFINE_bool(client_prune_in_list_predicates, false,
+            "Whether the in-list predicates of scans on columns which are the only "
+            "column of a hash component only carry, in the request to each tablet, "
+            "the values which hash to the tablet. This shrinks the requests and the "
+            "work of evaluating the predicates on the tablet servers.");
+TAG_FLAG(client_prune_in_list_predicates, experimental);
+TAG_FLAG(client_prune_in_list_predicates, runtime);
+
 namespace kudu {
 namespace client {
 
 using sp::shared_ptr;
+using std::string;
 
 KuduTable::Data::Data(shared_ptr<KuduClient> client,
                       string name,
@@ -41,5 +66,45 @@ KuduTable::Data::Data(shared_ptr<KuduClient> client,
 KuduTable::Data::~Data() {
 }
 
+void KuduTable::Data::InitPartitionPruner(const ScanSpec& scan_spec, PartitionPruner* pruner) {
+  const Schema& schema = *schema_.schema_;
+  if (!FLAGS_client_cache_partition_pruning_plans || scan_spec.CanShortCircuit()) {
+    pruner->Init(schema, partition_schema_, scan_spec);
+    return;
+  }
+  string key = PartitionPruner::PlanKey(schema, partition_schema_, scan_spec);
+  shared_ptr<const PartitionPruner::Plan> plan;
+  {
+    std::lock_guard<simple_spinlock> l(pruning_plans_lock_);
+    const auto* cached = FindOrNull(pruning_plans_, key);
+    if (cached) {
+      plan = *cached;
+    }
+  }
+  if (!plan) {
+    // Plans for the same key are identical, so a plan created concurrently
+    // by another scan may be kept instead of this one.
+    plan = PartitionPruner::CreatePlan(schema, partition_schema_, scan_spec);
+    std::lock_guard<simple_spinlock> l(pruning_plans_lock_);
+    plan = LookupOrInsert(&pruning_plans_, key, plan);
+  }
+  pruner->Init(schema, partition_schema_, scan_spec, *plan);
+}
+
+void KuduTable::Data::PredicatesForPartitionToPB(
+    const ScanSpec& scan_spec,
+    const Partition& partition,
+    google::protobuf::RepeatedPtrField<ColumnPredicatePB>* pbs) const {
+  const bool prune = FLAGS_client_prune_in_list_predicates;
+  for (const auto& col_pred : scan_spec.predicates()) {
+    if (prune) {
+      ColumnPredicateToPB(PartitionPruner::PredicateForPartition(
+          *schema_.schema_, partition_schema_, partition, col_pred.second), pbs->Add());
+    } else {
+      ColumnPredicateToPB(col_pred.second, pbs->Add());
+    }
+  }
+}
+
 } // namespace client
 } // namespace kudu
@@ -17,13 +17,22 @@
 #ifndef KUDU_CLIENT_TABLE_INTERNAL_H
 #define KUDU_CLIENT_TABLE_INTERNAL_H
 
+#include <memory>
 #include <string>
+#include <unordered_map>
+
+#include <google/protobuf/repeated_field.h>
 
 #include "kudu/common/partition.h"
+#include "kudu/common/partition_pruner.h"
 #include "kudu/client/client.h"
+#include "kudu/util/locks.h"
 
 namespace kudu {
 
+class ColumnPredicatePB;
+class ScanSpec;
+
 namespace client {
 
 class KuduTable::Data {
@@ -36,6 +45,20 @@ class KuduTable::Data {
        PartitionSchema partition_schema);
   ~Data();
 
+  // Initializes 'pruner' for a scan of this table with 'scan_spec'. With
+  // --client_cache_partition_pruning_plans, the pruning plan is shared with
+  // the previous scans whose predicates constrain the same hash components.
+  void InitPartitionPruner(const ScanSpec& scan_spec, PartitionPruner* pruner);
+
+  // Adds the predicates of 'scan_spec' to 'pbs', for the scan of the tablet
+  // of 'partition'. With --client_prune_in_list_predicates, the in-list
+  // predicates on hash-partitioned columns only carry the values which hash
+  // to the tablet.
+  void PredicatesForPartitionToPB(
+      const ScanSpec& scan_spec,
+      const Partition& partition,
+      google::protobuf::RepeatedPtrField<ColumnPredicatePB>* pbs) const;
+
   sp::shared_ptr<KuduClient> client_;
 
   const std::string name_;
@@ -48,6 +71,12 @@ class KuduTable::Data {
   const KuduSchema schema_;
   const PartitionSchema partition_schema_;
 
+  // The partition pruning plans of the scans of this table, keyed by
+  // PartitionPruner::PlanKey(). There is at most one plan per subset of the
+  // hash components, so the cache is not bounded.
+  simple_spinlock pruning_plans_lock_;
+  std::unordered_map<std::string, std::shared_ptr<const PartitionPruner::Plan>> pruning_plans_;
+
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
 
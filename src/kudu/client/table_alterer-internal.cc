@@ -51,7 +51,7 @@ Status KuduTableAlterer::Data::ToRequest(AlterTableRequestPB* req) {
     return status_;
   }
 
-  if (!rename_to_.is_initialized() && steps_.empty()) {
+  if (!rename_to_.is_initialized() && !quota_.is_initialized() && steps_.empty()) {
     return Status::InvalidArgument("No alter steps provided");
   }
 
@@ -60,6 +60,9 @@ Status KuduTableAlterer::Data::ToRequest(AlterTableRequestPB* req) {
   if (rename_to_.is_initialized()) {
     req->set_new_table_name(rename_to_.get());
   }
+  if (quota_.is_initialized()) {
+    req->mutable_quota()->CopyFrom(quota_.get());
+  }
 
   if (schema_ != nullptr) {
     RETURN_NOT_OK(SchemaToPB(*schema_, req->mutable_schema(),
@@ -69,6 +69,8 @@ class KuduTableAlterer::Data {
 
   boost::optional<std::string> rename_to_;
 
+  boost::optional<master::TableQuotaPB> quota_;
+
   // Set to true if there are alter partition steps.
   bool has_alter_partitioning_steps = false;
 
@@ -0,0 +1,321 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/write_batch-internal.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <glog/logging.h>
+
+#include "kudu/client/batcher.h"
+#include "kudu/client/client-internal.h"
+#include "kudu/client/meta_cache.h"
+#include "kudu/client/session-internal.h"
+#include "kudu/client/write_op-internal.h"
+#include "kudu/common/partition.h"
+#include "kudu/common/row.h"
+#include "kudu/common/row_operations.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/messenger.h"
+#include "kudu/rpc/request_tracker.h"
+#include "kudu/rpc/retriable_rpc.h"
+#include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/async_util.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/logging.h"
+
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using strings::Substitute;
+
+namespace kudu {
+
+using rpc::Messenger;
+using rpc::RequestTracker;
+using rpc::RetriableRpc;
+using rpc::RetriableRpcStatus;
+using tserver::WriteRequestPB;
+using tserver::WriteResponsePB;
+
+namespace client {
+
+using internal::MetaCacheServerPicker;
+using internal::RemoteTablet;
+using internal::RemoteTabletServer;
+using internal::WriteBatchTabletBuffer;
+
+namespace {
+
+// Writes the operations buffered for a tablet by a KuduWriteBatch. Like the
+// batcher's write RPCs, it is retried on other replicas if the leader fails.
+class BatchWriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteResponsePB> {
+ public:
+  BatchWriteRpc(const scoped_refptr<MetaCacheServerPicker>& replica_picker,
+                const scoped_refptr<RequestTracker>& request_tracker,
+                const MonoTime& deadline,
+                const shared_ptr<Messenger>& messenger,
+                const SchemaPB& schema_pb,
+                KuduSession::ExternalConsistencyMode consistency_mode,
+                uint64_t propagated_timestamp,
+                WriteBatchTabletBuffer* buffer,
+                CountDownLatch* latch)
+      : RetriableRpc(replica_picker, request_tracker, deadline, messenger),
+        buffer_(buffer),
+        latch_(latch) {
+    req_.set_tablet_id(buffer_->tablet->tablet_id());
+    switch (consistency_mode) {
+      case KuduSession::CLIENT_PROPAGATED:
+        req_.set_external_consistency_mode(kudu::CLIENT_PROPAGATED);
+        break;
+      case KuduSession::COMMIT_WAIT:
+        req_.set_external_consistency_mode(kudu::COMMIT_WAIT);
+        break;
+      default:
+        LOG(FATAL) << "Unsupported consistency mode: " << consistency_mode;
+    }
+    if (propagated_timestamp != KuduClient::kNoTimestamp) {
+      req_.set_propagated_timestamp(propagated_timestamp);
+    }
+    *req_.mutable_schema() = schema_pb;
+    // The operations are handed back to the buffer once written, so that
+    // their memory is reused by the next flush.
+    req_.mutable_row_operations()->Swap(&buffer_->ops);
+  }
+
+  string ToString() const override {
+    return Substitute("BatchWrite(tablet: $0, num_ops: $1, num_attempts: $2)",
+                      req_.tablet_id(), buffer_->row_indexes.size(), num_attempts());
+  }
+
+ protected:
+  void Try(RemoteTabletServer* replica, const rpc::ResponseCallback& callback) override {
+    VLOG(2) << "Tablet " << req_.tablet_id() << ": Writing batch to replica "
+            << replica->ToString();
+    replica->proxy()->WriteAsync(req_, &resp_, mutable_retrier()->mutable_controller(),
+                                 callback);
+  }
+
+  RetriableRpcStatus AnalyzeResponse(const Status& rpc_cb_status) override {
+    return internal::AnalyzeWriteRpcResponse(rpc_cb_status, mutable_retrier()->controller(),
+                                             resp_);
+  }
+
+  void Finish(const Status& status) override {
+    unique_ptr<BatchWriteRpc> this_instance(this);
+    buffer_->status = status;
+    if (!status.ok()) {
+      buffer_->status = status.CloneAndPrepend(
+          Substitute("Failed to write batch of $0 ops to tablet $1 after $2 attempt(s)",
+                     buffer_->row_indexes.size(), req_.tablet_id(), num_attempts()));
+      KLOG_EVERY_N_SECS(WARNING, 1) << buffer_->status.ToString();
+    }
+    buffer_->resp.Swap(&resp_);
+    buffer_->ops.Swap(req_.mutable_row_operations());
+    latch_->CountDown();
+  }
+
+ private:
+  WriteBatchTabletBuffer* const buffer_;
+  CountDownLatch* const latch_;
+};
+
+} // anonymous namespace
+
+KuduWriteBatch::Data::Data(const sp::shared_ptr<KuduTable>& table)
+    : table_(table),
+      row_(table->schema().NewRow()),
+      num_rows_(0),
+      reserved_rows_per_tablet_(0) {
+}
+
+KuduWriteBatch::Data::~Data() {
+}
+
+void KuduWriteBatch::Data::ReserveRowsPerTablet(int num_rows) {
+  reserved_rows_per_tablet_ = num_rows;
+  const Schema* schema = table_->schema().schema_;
+  // The bound used by RowOperationsPBEncoder::Add() on the size of a row.
+  const size_t row_size = 1 + schema->byte_size() + BitmapSize(schema->num_columns()) +
+      ContiguousRowHelper::null_bitmap_size(*schema);
+  for (auto& e : buffers_) {
+    e.second->ops.mutable_rows()->reserve(num_rows * row_size);
+    e.second->row_indexes.reserve(num_rows);
+  }
+}
+
+Status KuduWriteBatch::Data::FindBuffer(const string& partition_key, TabletBuffer** buffer) {
+  auto it = buffers_.upper_bound(partition_key);
+  if (it != buffers_.begin()) {
+    --it;
+    const string& end = it->second->tablet->partition().partition_key_end();
+    if (end.empty() || partition_key < end) {
+      *buffer = it->second.get();
+      return Status::OK();
+    }
+  }
+
+  KuduClient* client = table_->client();
+  scoped_refptr<RemoteTablet> tablet;
+  Synchronizer sync;
+  client->data_->meta_cache_->LookupTabletByKey(table_.get(),
+                                                partition_key,
+                                                MonoTime::Now() + client->default_rpc_timeout(),
+                                                &tablet,
+                                                sync.AsStatusCallback());
+  RETURN_NOT_OK(sync.Wait());
+  unique_ptr<TabletBuffer>& b = buffers_[tablet->partition().partition_key_start()];
+  if (!b) {
+    b.reset(new TabletBuffer);
+    b->tablet = std::move(tablet);
+  }
+  *buffer = b.get();
+  if (reserved_rows_per_tablet_ > 0 && b->row_indexes.capacity() == 0) {
+    ReserveRowsPerTablet(reserved_rows_per_tablet_);
+  }
+  return Status::OK();
+}
+
+Status KuduWriteBatch::Data::Add(KuduWriteOperation::Type type) {
+  if (PREDICT_FALSE(!row_->IsKeySet())) {
+    return Status::IllegalState("Key not specified", KUDU_REDACT(row_->ToString()));
+  }
+  partition_key_.clear();
+  RETURN_NOT_OK(table_->partition_schema().EncodeKey(*row_, &partition_key_));
+  TabletBuffer* buffer;
+  RETURN_NOT_OK(FindBuffer(partition_key_, &buffer));
+
+  RowOperationsPBEncoder enc(&buffer->ops);
+  enc.Add(ToInternalWriteType(type), *row_);
+  buffer->row_indexes.push_back(num_rows_++);
+
+  // Reset the row for the next operation.
+  const int num_columns = table_->schema().num_columns();
+  for (int i = 0; i < num_columns; i++) {
+    if (row_->IsColumnSet(i)) {
+      CHECK_OK(row_->Unset(i));
+    }
+  }
+  return Status::OK();
+}
+
+Status KuduWriteBatch::Data::Flush(KuduSession* session) {
+  row_errors_.clear();
+  KuduClient* client = table_->client();
+
+  MonoDelta timeout;
+  KuduSession::ExternalConsistencyMode consistency_mode;
+  {
+    std::lock_guard<Mutex> l(session->data_->mutex_);
+    timeout = session->data_->timeout_;
+    consistency_mode = session->data_->external_consistency_mode_;
+  }
+  if (!timeout.Initialized()) {
+    timeout = client->default_rpc_timeout();
+  }
+  const MonoTime deadline = MonoTime::Now() + timeout;
+
+  SchemaPB schema_pb;
+  RETURN_NOT_OK(SchemaToPB(*table_->schema().schema_, &schema_pb,
+                           SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES | SCHEMA_PB_WITHOUT_IDS));
+  const uint64_t propagated_timestamp = client->data_->GetLatestObservedTimestamp();
+
+  int num_tablets = 0;
+  for (const auto& e : buffers_) {
+    if (!e.second->row_indexes.empty()) {
+      num_tablets++;
+    }
+  }
+  CountDownLatch latch(num_tablets);
+  for (auto& e : buffers_) {
+    TabletBuffer* buffer = e.second.get();
+    if (buffer->row_indexes.empty()) {
+      continue;
+    }
+    scoped_refptr<MetaCacheServerPicker> server_picker(
+        new MetaCacheServerPicker(client,
+                                  client->data_->meta_cache_,
+                                  table_.get(),
+                                  buffer->tablet.get()));
+    BatchWriteRpc* rpc = new BatchWriteRpc(server_picker,
+                                           client->data_->request_tracker_,
+                                           deadline,
+                                           client->data_->messenger_,
+                                           schema_pb,
+                                           consistency_mode,
+                                           propagated_timestamp,
+                                           buffer,
+                                           &latch);
+    rpc->SendRpc();
+  }
+  latch.Wait();
+
+  for (auto it = buffers_.begin(); it != buffers_.end();) {
+    TabletBuffer* buffer = it->second.get();
+    if (buffer->row_indexes.empty()) {
+      ++it;
+      continue;
+    }
+    if (buffer->status.ok()) {
+      if (buffer->resp.has_timestamp()) {
+        client->data_->UpdateLatestObservedTimestamp(buffer->resp.timestamp());
+      }
+    } else {
+      for (int idx : buffer->row_indexes) {
+        row_errors_.emplace_back(idx, buffer->status);
+      }
+    }
+    for (const auto& err_pb : buffer->resp.per_row_errors()) {
+      if (err_pb.row_index() >= buffer->row_indexes.size()) {
+        LOG(ERROR) << "Received a per_row_error for an out-of-bound op index "
+                   << err_pb.row_index() << " (sent only "
+                   << buffer->row_indexes.size() << " ops)";
+        continue;
+      }
+      row_errors_.emplace_back(buffer->row_indexes[err_pb.row_index()],
+                               StatusFromPB(err_pb.error()));
+    }
+
+    if (!buffer->status.ok()) {
+      // The tablet may be gone: look it up again for the next operations.
+      it = buffers_.erase(it);
+      continue;
+    }
+    buffer->ops.mutable_rows()->clear();
+    buffer->ops.mutable_indirect_data()->clear();
+    buffer->row_indexes.clear();
+    buffer->resp.Clear();
+    ++it;
+  }
+
+  num_rows_ = 0;
+  if (row_errors_.empty()) {
+    return Status::OK();
+  }
+  std::sort(row_errors_.begin(), row_errors_.end(),
+            [](const std::pair<int, Status>& a, const std::pair<int, Status>& b) {
+              return a.first < b.first;
+            });
+  return Status::IOError("Some errors occurred");
+}
+
+} // namespace client
+} // namespace kudu
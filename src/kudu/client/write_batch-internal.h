@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/client/write_op.h"
+#include "kudu/common/wire_protocol.pb.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+namespace client {
+
+namespace internal {
+
+class RemoteTablet;
+
+// The operations buffered by a KuduWriteBatch for one tablet, and the
+// outcome of writing them.
+struct WriteBatchTabletBuffer {
+  scoped_refptr<RemoteTablet> tablet;
+  RowOperationsPB ops;
+  // The index of each buffered operation among the operations of the batch.
+  std::vector<int> row_indexes;
+
+  // Set once the operations are written.
+  Status status;
+  tserver::WriteResponsePB resp;
+};
+
+} // namespace internal
+
+class KuduWriteBatch::Data {
+ public:
+  explicit Data(const sp::shared_ptr<KuduTable>& table);
+  ~Data();
+
+  void ReserveRowsPerTablet(int num_rows);
+
+  Status Add(KuduWriteOperation::Type type);
+
+  Status Flush(KuduSession* session);
+
+  const sp::shared_ptr<KuduTable> table_;
+
+  // The row which the columns of the next operation are set on.
+  gscoped_ptr<KuduPartialRow> row_;
+
+  // The number of operations added since the last flush.
+  int num_rows_;
+
+  // The errors of the operations which failed in the last flush, in the
+  // order the operations were added.
+  std::vector<std::pair<int, Status>> row_errors_;
+
+ private:
+  typedef internal::WriteBatchTabletBuffer TabletBuffer;
+
+  // Sets 'buffer' to the buffer of the tablet hosting 'partition_key',
+  // looking the tablet up and creating its buffer if there is none yet.
+  Status FindBuffer(const std::string& partition_key, TabletBuffer** buffer);
+
+  // The buffers of the tablets written to, keyed by the start of the
+  // partition key range of their tablet.
+  std::map<std::string, std::unique_ptr<TabletBuffer>> buffers_;
+
+  // The number of operations to reserve space for in each buffer.
+  int reserved_rows_per_tablet_;
+
+  // Scratch space for the partition key of the row being added.
+  std::string partition_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
@@ -18,6 +18,7 @@
 #include "kudu/client/write_op.h"
 
 #include "kudu/client/client.h"
+#include "kudu/client/write_batch-internal.h"
 #include "kudu/common/encoded_key.h"
 #include "kudu/common/row.h"
 #include "kudu/common/wire_protocol.pb.h"
@@ -118,6 +119,39 @@ KuduUpsert::KuduUpsert(const shared_ptr<KuduTable>& table)
 
 KuduUpsert::~KuduUpsert() {}
 
+// WriteBatch -------------------------------------------------------------------
+
+KuduWriteBatch::KuduWriteBatch(const shared_ptr<KuduTable>& table)
+  : data_(new KuduWriteBatch::Data(table)) {
+}
+
+KuduWriteBatch::~KuduWriteBatch() {
+  delete data_;
+}
+
+void KuduWriteBatch::ReserveRowsPerTablet(int num_rows) {
+  data_->ReserveRowsPerTablet(num_rows);
+}
+
+KuduPartialRow* KuduWriteBatch::mutable_row() {
+  return data_->row_.get();
+}
+
+Status KuduWriteBatch::Add(KuduWriteOperation::Type type) {
+  return data_->Add(type);
+}
+
+int KuduWriteBatch::num_rows() const {
+  return data_->num_rows_;
+}
+
+Status KuduWriteBatch::Flush(KuduSession* session) {
+  return data_->Flush(session);
+}
+
+void KuduWriteBatch::GetRowErrors(std::vector<std::pair<int, Status>>* errors) const {
+  *errors = data_->row_errors_;
+}
 
 } // namespace client
 } // namespace kudu
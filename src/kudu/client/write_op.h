@@ -18,6 +18,8 @@
 #define KUDU_CLIENT_WRITE_OP_H
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "kudu/client/shared_ptr.h"
 #include "kudu/common/partial_row.h"
@@ -35,6 +37,7 @@ class ErrorCollector;
 class WriteRpc;
 } // namespace internal
 
+class KuduSession;
 class KuduTable;
 
 /// @brief A single-row write operation to be sent to a Kudu table.
@@ -230,6 +233,96 @@ class KUDU_EXPORT KuduDelete : public KuduWriteOperation {
   explicit KuduDelete(const sp::shared_ptr<KuduTable>& table);
 };
 
+/// @brief A batch of write operations on a table, built without allocating
+///   an object per operation.
+///
+/// Each operation is built by setting the columns of the row returned by
+/// mutable_row() and calling Add(), which encodes the row straight into the
+/// buffer of the tablet it belongs to and resets the row for the next
+/// operation. Since the row is encoded before Add() returns, the values set
+/// with the KuduPartialRow::Set*NoCopy() setters only need to remain valid
+/// until then, which avoids copying strings and binaries twice.
+///
+/// Flush() sends the operations buffered for each tablet in a single RPC.
+/// This is meant for applications writing rows at high rates, for which
+/// allocating a KuduWriteOperation per row is too costly.
+///
+/// Typical usage example:
+/// @code
+///   KuduWriteBatch batch(table);
+///   for (...) {
+///     KUDU_CHECK_OK(batch.mutable_row()->SetInt32("key", key));
+///     KUDU_CHECK_OK(batch.mutable_row()->SetStringNoCopy("foo", value));
+///     KUDU_CHECK_OK(batch.Add(KuduWriteOperation::INSERT));
+///   }
+///   KUDU_CHECK_OK(batch.Flush(session.get()));
+/// @endcode
+///
+/// This class is not thread-safe.
+class KUDU_EXPORT KuduWriteBatch {
+ public:
+  /// Create a batch of write operations on the specified table.
+  ///
+  /// @param [in] table
+  ///   Smart pointer to the target table.
+  explicit KuduWriteBatch(const sp::shared_ptr<KuduTable>& table);
+
+  ~KuduWriteBatch();
+
+  /// Reserve space in the buffer of each tablet for the given number of
+  /// operations, so that the buffers are not reallocated as they grow.
+  ///
+  /// @param [in] num_rows
+  ///   The number of operations per tablet to reserve space for.
+  void ReserveRowsPerTablet(int num_rows);
+
+  /// @return Pointer to the row to set the columns of the next operation on.
+  KuduPartialRow* mutable_row();
+
+  /// Encode the row set on mutable_row() as an operation of the given type,
+  /// and reset the row.
+  ///
+  /// The tablet of the row is looked up if it is not known yet, which may
+  /// block for a round trip to the master.
+  ///
+  /// @param [in] type
+  ///   The type of the operation.
+  /// @return Operation result status. The row is left as it is on error.
+  Status Add(KuduWriteOperation::Type type) WARN_UNUSED_RESULT;
+
+  /// @return The number of operations added since the last call to Flush().
+  int num_rows() const;
+
+  /// Write the operations added since the last call to Flush(), and wait
+  /// for them to be written.
+  ///
+  /// The operations are written with the timeout and the external
+  /// consistency mode of the given session, but independently of the
+  /// operations applied to the session.
+  ///
+  /// @param [in] session
+  ///   The session to write the operations with.
+  /// @return Operation result status. An IOError is returned if some
+  ///   operations failed; their errors are available from GetRowErrors().
+  Status Flush(KuduSession* session) WARN_UNUSED_RESULT;
+
+  /// Get the errors of the operations which failed in the last call to
+  /// Flush().
+  ///
+  /// @param [out] errors
+  ///   The index of each failed operation, in the order the operations were
+  ///   added, along with its error.
+  void GetRowErrors(std::vector<std::pair<int, Status> >* errors) const;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduWriteBatch);
+};
+
 } // namespace client
 } // namespace kudu
 
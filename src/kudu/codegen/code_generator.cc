@@ -39,8 +39,11 @@
 #include <llvm/Target/TargetRegisterInfo.h>
 #include <llvm/Target/TargetSubtargetInfo.h>
 
+#include "kudu/codegen/column_projector.h"
 #include "kudu/codegen/jit_wrapper.h"
 #include "kudu/codegen/module_builder.h"
+#include "kudu/codegen/predicate_evaluator.h"
+#include "kudu/codegen/row_comparator.h"
 #include "kudu/codegen/row_projector.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -81,6 +84,7 @@ using llvm::Target;
 using llvm::TargetMachine;
 using llvm::Triple;
 using std::string;
+using std::vector;
 
 namespace kudu {
 
@@ -229,5 +233,66 @@ Status CodeGenerator::CompileRowProjector(const Schema& base, const Schema& proj
   return Status::OK();
 }
 
+Status CodeGenerator::CompilePredicateEvaluator(const vector<ColumnPredicate>& predicates,
+                                                scoped_refptr<PredicateEvaluatorFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(PredicateEvaluatorFunctions::Create(predicates, out, &tm));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 500;
+    std::ostringstream sstr;
+    sstr << "Printing predicate evaluation function:\n";
+    int instrs = DumpAsm((*out)->evaluate(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.";
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
+Status CodeGenerator::CompileRowComparator(const Schema& schema,
+                                           scoped_refptr<RowComparatorFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(RowComparatorFunctions::Create(schema, out, &tm));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 500;
+    std::ostringstream sstr;
+    sstr << "Printing row comparison function:\n";
+    int instrs = DumpAsm((*out)->compare(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.";
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
+Status CodeGenerator::CompileColumnProjector(const Schema& projection,
+                                             scoped_refptr<ColumnProjectorFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(ColumnProjectorFunctions::Create(projection, out, &tm));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 500;
+    std::ostringstream sstr;
+    sstr << "Printing column fill functions:\n";
+    for (size_t i = 0; i < projection.num_columns(); i++) {
+      if ((*out)->fill(i) != nullptr) {
+        int instrs = DumpAsm((*out)->fill(i), *tm, &sstr, kInstrMax);
+        sstr << "Printed " << instrs << " instructions for column " << i << ".\n";
+      }
+    }
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
 } // namespace codegen
 } // namespace kudu
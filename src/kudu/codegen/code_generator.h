@@ -18,6 +18,8 @@
 #ifndef KUDU_CODEGEN_CODE_GENERATOR_H
 #define KUDU_CODEGEN_CODE_GENERATOR_H
 
+#include <vector>
+
 #include "kudu/codegen/row_projector.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -30,10 +32,14 @@ class LLVMContext;
 
 namespace kudu {
 
+class ColumnPredicate;
 class Schema;
 
 namespace codegen {
 
+class ColumnProjectorFunctions;
+class PredicateEvaluatorFunctions;
+class RowComparatorFunctions;
 class RowProjectorFunctions;
 
 // CodeGenerator is a top-level class that manages a per-module
@@ -71,6 +77,24 @@ class CodeGenerator {
   Status CompileRowProjector(const Schema& base, const Schema& proj,
                              scoped_refptr<RowProjectorFunctions>* out);
 
+  // Attempts to initialize a predicate evaluation function by compiling
+  // code for the shape of the parameter predicates. Writes to 'out' upon
+  // success.
+  Status CompilePredicateEvaluator(const std::vector<ColumnPredicate>& predicates,
+                                   scoped_refptr<PredicateEvaluatorFunctions>* out);
+
+  // Attempts to initialize key comparison and row copy functions by
+  // compiling code for the signature of the parameter schema. Writes to
+  // 'out' upon success.
+  Status CompileRowComparator(const Schema& schema,
+                              scoped_refptr<RowComparatorFunctions>* out);
+
+  // Attempts to initialize functions which fill columns with the read
+  // defaults of the parameter projection by compiling code for them.
+  // Writes to 'out' upon success.
+  Status CompileColumnProjector(const Schema& projection,
+                                scoped_refptr<ColumnProjectorFunctions>* out);
+
  private:
   static void GlobalInit();
 
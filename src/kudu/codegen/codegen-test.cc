@@ -24,14 +24,20 @@
 #include <gmock/gmock.h>
 
 #include "kudu/codegen/code_generator.h"
+#include "kudu/codegen/column_projector.h"
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/predicate_evaluator.h"
+#include "kudu/codegen/row_comparator.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/strings/util.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/env.h"
 #include "kudu/util/logging_test_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
@@ -41,6 +47,7 @@ using std::string;
 using std::vector;
 
 DECLARE_bool(codegen_dump_mc);
+DECLARE_string(codegen_object_cache_dir);
 DECLARE_int32(codegen_cache_capacity);
 
 namespace kudu {
@@ -407,4 +414,210 @@ TEST_F(CodegenTest, TestCodeCache) {
   }
 }
 
+// Tests that the compiled evaluation of a conjunction of predicates selects
+// the same rows as evaluating each predicate in turn, including for a number
+// of rows which is not a multiple of 8.
+TEST_F(CodegenTest, TestPredicateEvaluator) {
+  Schema schema({ ColumnSchema("i32", INT32, true),
+                  ColumnSchema("u64", UINT64, false),
+                  ColumnSchema("dbl", DOUBLE, true) },
+                1);
+  const size_t kNumRows = 1027;
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema, kNumRows, &arena);
+  for (size_t i = 0; i < kNumRows; i++) {
+    int32_t i32 = static_cast<int32_t>(random_.Uniform(200)) - 100;
+    uint64_t u64 = random_.Uniform(4);
+    double dbl = random_.NextDoubleFraction();
+    block.column_block(0).SetCellValue(i, &i32);
+    block.column_block(0).SetCellIsNull(i, random_.OneIn(10));
+    block.column_block(1).SetCellValue(i, &u64);
+    block.column_block(2).SetCellValue(i, &dbl);
+    block.column_block(2).SetCellIsNull(i, random_.OneIn(10));
+  }
+
+  int32_t i32_lower = -50;
+  int32_t i32_upper = 50;
+  uint64_t u64_value = 2;
+  double dbl_lower = 0.25;
+  vector<vector<ColumnPredicate>> conjunctions = {
+    { ColumnPredicate::Range(schema.column(0), &i32_lower, &i32_upper) },
+    { ColumnPredicate::Range(schema.column(0), nullptr, &i32_upper),
+      ColumnPredicate::Equality(schema.column(1), &u64_value) },
+    { ColumnPredicate::IsNotNull(schema.column(0)),
+      ColumnPredicate::Range(schema.column(2), &dbl_lower, nullptr) },
+    { ColumnPredicate::Range(schema.column(0), &i32_lower, nullptr),
+      ColumnPredicate::Equality(schema.column(1), &u64_value),
+      ColumnPredicate::Range(schema.column(2), &dbl_lower, nullptr) },
+    { ColumnPredicate::None(schema.column(1)) },
+  };
+
+  for (const vector<ColumnPredicate>& predicates : conjunctions) {
+    scoped_refptr<codegen::PredicateEvaluatorFunctions> functions;
+    ASSERT_OK(generator_.CompilePredicateEvaluator(predicates, &functions));
+    codegen::PredicateEvaluator evaluator(&schema, predicates, functions);
+    ASSERT_OK(evaluator.Init());
+
+    // Start from a selection with some rows already filtered out, which the
+    // evaluator must leave unselected.
+    SelectionVector expected(kNumRows);
+    expected.SetAllTrue();
+    block.selection_vector()->SetAllTrue();
+    for (size_t i = 0; i < kNumRows; i += 7) {
+      expected.SetRowUnselected(i);
+      block.selection_vector()->SetRowUnselected(i);
+    }
+
+    evaluator.Evaluate(&block);
+    for (const ColumnPredicate& pred : predicates) {
+      pred.Evaluate(block.column_block(schema.find_column(pred.column().name())),
+                    &expected);
+    }
+    for (size_t i = 0; i < kNumRows; i++) {
+      ASSERT_EQ(expected.IsRowSelected(i), block.selection_vector()->IsRowSelected(i))
+          << "row " << i << " for " << predicates.front().ToString();
+    }
+  }
+}
+
+// Tests that the compiled comparison and copy of rows agree with
+// Schema::Compare() and CopyRow(), for keys of several types and for
+// nullable and indirect cells.
+TEST_F(CodegenTest, TestRowComparator) {
+  Schema schema({ ColumnSchema("k_i8", INT8),
+                  ColumnSchema("k_str", STRING),
+                  ColumnSchema("k_u32", UINT32),
+                  ColumnSchema("v_str", STRING, true),
+                  ColumnSchema("v_dbl", DOUBLE, true) },
+                3);
+  const size_t kNumRows = 500;
+  const char* kStrings[] = { "", "a", "ab", "b" };
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema, kNumRows, &arena);
+  for (size_t i = 0; i < kNumRows; i++) {
+    // Small domains, so that many rows share prefixes of their keys.
+    int8_t i8 = static_cast<int8_t>(random_.Uniform(3)) - 1;
+    Slice str(kStrings[random_.Uniform(arraysize(kStrings))]);
+    uint32_t u32 = random_.OneIn(2) ? 0 : 0xffffffff;
+    double dbl = random_.NextDoubleFraction();
+    block.column_block(0).SetCellValue(i, &i8);
+    block.column_block(1).SetCellValue(i, &str);
+    block.column_block(2).SetCellValue(i, &u32);
+    block.column_block(3).SetCellValue(i, &str);
+    block.column_block(3).SetCellIsNull(i, random_.OneIn(3));
+    block.column_block(4).SetCellValue(i, &dbl);
+    block.column_block(4).SetCellIsNull(i, random_.OneIn(3));
+  }
+
+  scoped_refptr<codegen::RowComparatorFunctions> functions;
+  ASSERT_OK(generator_.CompileRowComparator(schema, &functions));
+  codegen::RowComparator comparator(functions);
+
+  for (size_t i = 0; i < kNumRows; i++) {
+    for (size_t j = i; j < std::min(kNumRows, i + 20); j++) {
+      int expected = schema.Compare(block.row(i), block.row(j));
+      int actual = comparator.Compare(block.row(i), block.row(j));
+      ASSERT_EQ(expected < 0, actual < 0) << i << " vs. " << j;
+      ASSERT_EQ(expected > 0, actual > 0) << i << " vs. " << j;
+    }
+  }
+
+  Arena copy_arena(1024, 1024 * 1024);
+  RowBlock copy(schema, kNumRows, &copy_arena);
+  for (size_t i = 0; i < kNumRows; i++) {
+    RowBlockRow dst = copy.row(i);
+    ASSERT_OK(comparator.CopyRow(block.row(i), &dst, &copy_arena));
+  }
+  for (size_t i = 0; i < kNumRows; i++) {
+    ASSERT_EQ(schema.DebugRow(block.row(i)), schema.DebugRow(copy.row(i)));
+    Slice src = *reinterpret_cast<const Slice*>(block.row(i).cell_ptr(3));
+    Slice dst = *reinterpret_cast<const Slice*>(copy.row(i).cell_ptr(3));
+    if (!block.row(i).is_null(3) && !src.empty()) {
+      // The indirect data was relocated to the arena.
+      ASSERT_NE(src.data(), dst.data());
+    }
+  }
+}
+
+// Tests that the compiled fills of columns with their read defaults agree
+// with the defaults, for cells of several sizes, nullable columns, and
+// columns without a default.
+TEST_F(CodegenTest, TestColumnProjector) {
+  const int8_t kI8 = -3;
+  const double kDbl = 1.5;
+  Schema projection({ ColumnSchema("i8", INT8, false, &kI8, nullptr),
+                      ColumnSchema("i32", INT32, true, kI32R, nullptr),
+                      ColumnSchema("dbl", DOUBLE, false, &kDbl, nullptr),
+                      ColumnSchema("str", STRING, true, kStrR, nullptr),
+                      ColumnSchema("null", INT64, true) },
+                    0);
+  scoped_refptr<codegen::ColumnProjectorFunctions> functions;
+  ASSERT_OK(generator_.CompileColumnProjector(projection, &functions));
+  ASSERT_TRUE(functions->fill(4) == nullptr);
+  codegen::ColumnProjector projector(&projection, functions);
+
+  // An odd number of rows, so that vectorized fills have a remainder.
+  const size_t kNumRows = 77;
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(projection, kNumRows, &arena);
+  for (size_t col = 0; col < projection.num_columns(); col++) {
+    ColumnBlock cblock = block.column_block(col);
+    ASSERT_OK(projector.FillDefaults(col, &cblock));
+  }
+  for (size_t i = 0; i < kNumRows; i++) {
+    RowBlockRow row = block.row(i);
+    ASSERT_EQ(kI8, *reinterpret_cast<const int8_t*>(row.cell_ptr(0)));
+    ASSERT_FALSE(row.is_null(1));
+    ASSERT_EQ(kI32RValue, *reinterpret_cast<const int32_t*>(row.cell_ptr(1)));
+    ASSERT_EQ(kDbl, *reinterpret_cast<const double*>(row.cell_ptr(2)));
+    ASSERT_FALSE(row.is_null(3));
+    ASSERT_EQ(kStrRValue, *reinterpret_cast<const Slice*>(row.cell_ptr(3)));
+    ASSERT_TRUE(row.is_null(4));
+  }
+  // The string default was copied to the arena.
+  const Slice* str_default =
+      reinterpret_cast<const Slice*>(projection.column(3).read_default_value());
+  ASSERT_NE(str_default->data(),
+            reinterpret_cast<const Slice*>(block.row(0).cell_ptr(3))->data());
+
+  // Filling an empty block does nothing.
+  ColumnBlock empty = block.column_block(0, 0);
+  ASSERT_OK(projector.FillDefaults(0, &empty));
+}
+
+// Tests that compiled code is written to the object cache directory, and
+// that code loaded from it works like freshly compiled code.
+TEST_F(CodegenTest, TestObjectCache) {
+  FLAGS_codegen_object_cache_dir = GetTestPath("jit");
+  Schema schema({ ColumnSchema("key", INT32),
+                  ColumnSchema("val", STRING, true) },
+                1);
+  Arena arena(1024, 1024);
+  RowBlock block(schema, 2, &arena);
+  for (int32_t i = 0; i < 2; i++) {
+    Slice str("val");
+    block.column_block(0).SetCellValue(i, &i);
+    block.column_block(1).SetCellValue(i, &str);
+    block.column_block(1).SetCellIsNull(i, false);
+  }
+
+  vector<string> children;
+  for (int i = 0; i < 2; i++) {
+    scoped_refptr<codegen::RowComparatorFunctions> functions;
+    ASSERT_OK(generator_.CompileRowComparator(schema, &functions));
+    codegen::RowComparator comparator(functions);
+    ASSERT_LT(comparator.Compare(block.row(0), block.row(1)), 0);
+    ASSERT_GT(comparator.Compare(block.row(1), block.row(0)), 0);
+    ASSERT_EQ(0, comparator.Compare(block.row(1), block.row(1)));
+
+    // The first compilation wrote the single object file; the second one
+    // loaded it.
+    children.clear();
+    ASSERT_OK(env_->GetChildren(FLAGS_codegen_object_cache_dir, &children));
+    ASSERT_EQ(1, std::count_if(children.begin(), children.end(), [](const string& c) {
+        return HasSuffixString(c, ".o");
+      })) << children;
+  }
+}
+
 } // namespace kudu
@@ -0,0 +1,254 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/column_projector.h"
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PHINode;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// Generates a function of the form described by
+// ColumnProjectorFunctions::FillFunction for column 'col':
+//
+// define void @name(i8* noalias %data, i64 %nrows, i8* noalias %value)
+// entry:
+//   %cells = bitcast i8* %data to iN*    ; N = 8 * <cell size>
+//   <if the cells are Slices>
+//     %default = load i128, (bitcast i8* %value to i128*)
+//   <otherwise>
+//     %default = <the read default of the column, as an iN constant>
+//   br <%nrows == 0>, label %done, label %loop
+// loop:
+//   %idx = phi i64 [ 0, %entry ], [ %next, %loop ]
+//   store iN %default, (getelementptr %cells, %idx)
+//   %next = add i64 %idx, 1
+//   br <%next == %nrows>, label %done, label %loop
+// done:
+//   ret void
+//
+// The cells are stored as plain integers of their size, which the
+// optimizer is free to widen into vector stores or a memset.
+Function* MakeFill(const string& name, ModuleBuilder* mbuilder, const ColumnSchema& col) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  const size_t size = col.type_info()->size();
+  Type* cell_type = Type::getIntNTy(context, size * 8);
+  Type* i8_ptr = Type::getInt8PtrTy(context);
+  vector<Type*> argtypes = { i8_ptr, Type::getInt64Ty(context), i8_ptr };
+  FunctionType* fty = FunctionType::get(Type::getVoidTy(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* data = &*it++;
+  Argument* nrows = &*it++;
+  Argument* value = &*it++;
+  DCHECK(it == f->arg_end());
+  data->setName("data");
+  nrows->setName("nrows");
+  value->setName("value");
+  // The default value never lives in the block being filled, so it may be
+  // loaded once, outside the loop. Note that these are 1-based indexes.
+  f->setDoesNotAlias(1);
+  f->setDoesNotAlias(3);
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  BasicBlock* loop = BasicBlock::Create(context, "loop", f);
+  BasicBlock* done = BasicBlock::Create(context, "done", f);
+
+  builder->SetInsertPoint(entry);
+  Value* cells = builder->CreateBitCast(data, PointerType::getUnqual(cell_type), "cells");
+  Value* default_value;
+  if (col.type_info()->physical_type() == BINARY) {
+    DCHECK_EQ(sizeof(Slice), size);
+    default_value = builder->CreateLoad(
+        builder->CreateBitCast(value, PointerType::getUnqual(cell_type)), "default");
+  } else {
+    // Kudu only runs on little-endian machines, so copying the value into
+    // the low-order bytes of an integer preserves its representation.
+    DCHECK_LE(size, sizeof(uint64_t));
+    uint64_t bits = 0;
+    memcpy(&bits, col.read_default_value(), size);
+    default_value = builder->getIntN(size * 8, bits);
+  }
+  builder->CreateCondBr(builder->CreateICmpEQ(nrows, builder->getInt64(0)), done, loop);
+
+  builder->SetInsertPoint(loop);
+  PHINode* idx = builder->CreatePHI(Type::getInt64Ty(context), 2, "idx");
+  idx->addIncoming(builder->getInt64(0), entry);
+  builder->CreateStore(default_value, builder->CreateGEP(cells, idx));
+  Value* next = builder->CreateAdd(idx, builder->getInt64(1), "next");
+  idx->addIncoming(next, loop);
+  builder->CreateCondBr(builder->CreateICmpEQ(next, nrows), done, loop);
+
+  builder->SetInsertPoint(done);
+  builder->CreateRetVoid();
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping fill of column " << col.name() << ":";
+    f->dump();
+  }
+
+  return f;
+}
+
+// Convenience method which appends to a faststring
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+} // anonymous namespace
+
+ColumnProjectorFunctions::ColumnProjectorFunctions(string key,
+                                                   vector<FillFunction> fill_fs,
+                                                   unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    key_(std::move(key)),
+    fill_fs_(std::move(fill_fs)) {
+}
+
+Status ColumnProjectorFunctions::Create(const Schema& projection,
+                                        scoped_refptr<ColumnProjectorFunctions>* out,
+                                        llvm::TargetMachine** tm) {
+  faststring key;
+  RETURN_NOT_OK(EncodeKey(projection, &key));
+
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+  builder.set_object_cache_key(key.ToString());
+
+  // The promises point into 'fill_fs', so it must not be resized below.
+  vector<FillFunction> fill_fs(projection.num_columns(), nullptr);
+  for (size_t i = 0; i < projection.num_columns(); i++) {
+    const ColumnSchema& col = projection.column(i);
+    if (col.read_default_value() == nullptr) {
+      continue;
+    }
+    Function* fill = MakeFill(StrCat("ColumnFill", i), &builder, col);
+    builder.AddJITPromise(fill, &fill_fs[i]);
+  }
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new ColumnProjectorFunctions(key.ToString(), std::move(fill_fs),
+                                          std::move(owner)));
+  return Status::OK();
+}
+
+Status ColumnProjectorFunctions::EncodeOwnKey(faststring* out) {
+  out->append(key_);
+  return Status::OK();
+}
+
+// Generates a key for the read defaults of a projection, encoded as
+// follows, in sequence.
+//
+// (1 byte) unique type identifier for ColumnProjectorFunctions
+// (8 bytes) number, as unsigned long, of columns
+// (variable size) the columns, in order
+//   4 bytes for the column's physical type
+//   1 byte for whether the column has a non-NULL read default
+//   <if it does, and the cells are not Slices>
+//     the bytes of the read default, as many as the cell size
+//
+// The defaults of Slice columns are passed in at run time, so they aren't
+// part of the key.
+Status ColumnProjectorFunctions::EncodeKey(const Schema& projection, faststring* out) {
+  AddNext(out, JITWrapper::COLUMN_PROJECTOR);
+  AddNext(out, projection.num_columns());
+  for (const ColumnSchema& col : projection.columns()) {
+    DataType type = col.type_info()->physical_type();
+    const void* value = col.read_default_value();
+    AddNext(out, type);
+    AddNext(out, value != nullptr);
+    if (value != nullptr && type != BINARY) {
+      out->append(value, col.type_info()->size());
+    }
+  }
+  return Status::OK();
+}
+
+Status ColumnProjector::FillDefaults(size_t col_idx, ColumnBlock* dst) const {
+  const ColumnSchema& col = projection_->column(col_idx);
+  const void* value = col.read_default_value();
+  if (dst->is_nullable()) {
+    ColumnDataView dst_view(dst);
+    dst_view.SetNullBits(dst->nrows(), value != nullptr);
+  }
+  if (value == nullptr) {
+    return Status::OK();
+  }
+
+  Slice dst_slice;
+  if (col.type_info()->physical_type() == BINARY) {
+    // Relocate the default once; all the cells point to the same copy.
+    const Slice* src_slice = reinterpret_cast<const Slice*>(value);
+    if (PREDICT_FALSE(!dst->arena()->RelocateSlice(*src_slice, &dst_slice))) {
+      return Status::IOError("out of memory copying slice", src_slice->ToString());
+    }
+  }
+  functions_->fill(col_idx)(dst->data(), dst->nrows(), &dst_slice);
+  return Status::OK();
+}
+
+} // namespace codegen
+} // namespace kudu
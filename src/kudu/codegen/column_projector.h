@@ -0,0 +1,112 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_COLUMN_PROJECTOR_H
+#define KUDU_CODEGEN_COLUMN_PROJECTOR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+
+class ColumnBlock;
+class Schema;
+class Slice;
+
+namespace codegen {
+
+// The JITWrapper for the columnar projection functions of a projection.
+//
+// The columns of a projection which a rowset has data for are decoded
+// straight into the ColumnBlocks of a scan. The compiled functions fill
+// the other columns, which were added after the rowset was written, with
+// their read defaults. Each function is specialized for the size of the
+// cells of its column and, unless they are Slices, for its default value.
+class ColumnProjectorFunctions : public JITWrapper {
+ public:
+  // Fills 'nrows' cells starting at 'data' with the default value of a
+  // column. If the cells are Slices, 'value' is the default value, already
+  // relocated to the arena of the block. Otherwise it is unused.
+  typedef void(*FillFunction)(uint8_t* data, uint64_t nrows, const Slice* value);
+
+  // Compiles the fill functions of the columns of 'projection' which have
+  // a non-NULL read default.
+  // Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the functions to 'out' upon success.
+  static Status Create(const Schema& projection,
+                       scoped_refptr<ColumnProjectorFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  // Returns the function which fills column 'col_idx' of the projection
+  // with its read default, or NULL if the column has no read default.
+  FillFunction fill(size_t col_idx) const { return fill_fs_[col_idx]; }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE;
+
+  static Status EncodeKey(const Schema& projection, faststring* out);
+
+ private:
+  ColumnProjectorFunctions(std::string key, std::vector<FillFunction> fill_fs,
+                           std::unique_ptr<JITCodeOwner> owner);
+
+  const std::string key_;
+  const std::vector<FillFunction> fill_fs_;
+};
+
+// Fills the columns of a projection which have no data in a rowset with
+// their read defaults using compiled code, in place of filling them cell
+// by cell.
+class ColumnProjector {
+ public:
+  // Requires that 'projection' remains valid for the lifetime of this
+  // object, and that 'functions' were compiled for a projection with the
+  // same key.
+  ColumnProjector(const Schema* projection,
+                  const scoped_refptr<ColumnProjectorFunctions>& functions)
+    : projection_(projection),
+      functions_(functions) {
+  }
+
+  // Fills all the cells of 'dst', a block of column 'col_idx' of the
+  // projection, with the read default of the column. Cells of columns
+  // whose read default is NULL are only marked as null.
+  Status FillDefaults(size_t col_idx, ColumnBlock* dst) const;
+
+  const Schema* projection() const { return projection_; }
+
+ private:
+  const Schema* const projection_;
+  const scoped_refptr<ColumnProjectorFunctions> functions_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnProjector);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
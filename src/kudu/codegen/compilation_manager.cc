@@ -23,11 +23,17 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "kudu/codegen/code_cache.h"
 #include "kudu/codegen/code_generator.h"
+#include "kudu/codegen/column_projector.h"
 #include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/predicate_evaluator.h"
+#include "kudu/codegen/row_comparator.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -43,6 +49,7 @@
 #include "kudu/util/threadpool.h"
 
 using std::shared_ptr;
+using std::vector;
 
 DEFINE_bool(codegen_time_compilation, false, "Whether to print time that each code "
             "generation request took.");
@@ -119,6 +126,136 @@ class CompilationTask : public Runnable {
   DISALLOW_COPY_AND_ASSIGN(CompilationTask);
 };
 
+// A PredicateCompilationTask is like a CompilationTask, but generates the
+// evaluation function for the shape of a conjunction of predicates.
+//
+// Compilation only depends on the types and bounds present in the
+// predicates, so the task never dereferences their values, which may no
+// longer be valid by the time it runs.
+class PredicateCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  PredicateCompilationTask(vector<ColumnPredicate> predicates, CodeCache* cache,
+                           CodeGenerator* generator)
+    : predicates_(std::move(predicates)),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(), "Failed compilation of predicate evaluator");
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(PredicateEvaluatorFunctions::EncodeKey(predicates_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<PredicateEvaluatorFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating predicate evaluator") {
+      RETURN_NOT_OK(generator_->CompilePredicateEvaluator(predicates_, &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  const vector<ColumnPredicate> predicates_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(PredicateCompilationTask);
+};
+
+// A RowComparatorCompilationTask is like a CompilationTask, but generates
+// the key comparison and row copy functions for the signature of a schema.
+class RowComparatorCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  RowComparatorCompilationTask(const Schema& schema, CodeCache* cache,
+                               CodeGenerator* generator)
+    : schema_(schema),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(),
+                "Failed compilation of row comparator for schema " + schema_.ToString());
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(RowComparatorFunctions::EncodeKey(schema_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<RowComparatorFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating row comparator") {
+      RETURN_NOT_OK(generator_->CompileRowComparator(schema_, &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  const Schema schema_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowComparatorCompilationTask);
+};
+
+// A ColumnProjectorCompilationTask is like a CompilationTask, but generates
+// the functions which fill columns with the read defaults of a projection.
+class ColumnProjectorCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  ColumnProjectorCompilationTask(const Schema& projection, CodeCache* cache,
+                                 CodeGenerator* generator)
+    : projection_(projection),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(),
+                "Failed compilation of column projector for projection " +
+                projection_.ToString());
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(ColumnProjectorFunctions::EncodeKey(projection_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<ColumnProjectorFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating column projector") {
+      RETURN_NOT_OK(generator_->CompileColumnProjector(projection_, &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  const Schema projection_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnProjectorCompilationTask);
+};
+
 } // anonymous namespace
 
 CompilationManager::CompilationManager()
@@ -196,5 +333,99 @@ bool CompilationManager::RequestRowProjector(const Schema* base_schema,
   return true;
 }
 
+void CompilationManager::Precompile(const Schema& schema) {
+  // The tasks skip code which is already cached, and the requests aren't
+  // queries, so they don't count towards the cache metrics.
+  shared_ptr<Runnable> projector_task(
+    new CompilationTask(schema, schema, &cache_, &generator_));
+  WARN_NOT_OK(pool_->Submit(projector_task), "RowProjector precompilation request failed");
+  shared_ptr<Runnable> comparator_task(
+    new RowComparatorCompilationTask(schema, &cache_, &generator_));
+  WARN_NOT_OK(pool_->Submit(comparator_task), "RowComparator precompilation request failed");
+}
+
+bool CompilationManager::RequestPredicateEvaluator(const Schema* schema,
+                                                   const vector<ColumnPredicate>& predicates,
+                                                   gscoped_ptr<PredicateEvaluator>* out) {
+  faststring key;
+  Status s = PredicateEvaluatorFunctions::EncodeKey(predicates, &key);
+  WARN_NOT_OK(s, "PredicateEvaluator compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<PredicateEvaluatorFunctions> cached(
+    down_cast<PredicateEvaluatorFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(
+      new PredicateCompilationTask(predicates, &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "PredicateEvaluator compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  gscoped_ptr<PredicateEvaluator> evaluator(new PredicateEvaluator(schema, predicates, cached));
+  s = evaluator->Init();
+  WARN_NOT_OK(s, "PredicateEvaluator initialization failed");
+  if (!s.ok()) return false;
+  out->swap(evaluator);
+  return true;
+}
+
+bool CompilationManager::RequestRowComparator(const Schema* schema,
+                                              gscoped_ptr<RowComparator>* out) {
+  faststring key;
+  Status s = RowComparatorFunctions::EncodeKey(*schema, &key);
+  WARN_NOT_OK(s, "RowComparator compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<RowComparatorFunctions> cached(
+    down_cast<RowComparatorFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(
+      new RowComparatorCompilationTask(*schema, &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "RowComparator compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  out->reset(new RowComparator(cached));
+  return true;
+}
+
+bool CompilationManager::RequestColumnProjector(const Schema* projection,
+                                                gscoped_ptr<ColumnProjector>* out) {
+  faststring key;
+  Status s = ColumnProjectorFunctions::EncodeKey(*projection, &key);
+  WARN_NOT_OK(s, "ColumnProjector compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<ColumnProjectorFunctions> cached(
+    down_cast<ColumnProjectorFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(
+      new ColumnProjectorCompilationTask(*projection, &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "ColumnProjector compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  out->reset(new ColumnProjector(projection, cached));
+  return true;
+}
+
 } // namespace codegen
 } // namespace kudu
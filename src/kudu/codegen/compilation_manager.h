@@ -18,6 +18,8 @@
 #ifndef KUDU_CODEGEN_COMPILATION_MANAGER_H
 #define KUDU_CODEGEN_COMPILATION_MANAGER_H
 
+#include <vector>
+
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/code_cache.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -28,6 +30,7 @@
 
 namespace kudu {
 
+class ColumnPredicate;
 class Counter;
 class MetricEntity;
 class MetricRegistry;
@@ -35,6 +38,9 @@ class ThreadPool;
 
 namespace codegen {
 
+class ColumnProjector;
+class PredicateEvaluator;
+class RowComparator;
 class RowProjector;
 
 // The compilation manager is a top-level class which manages the actual
@@ -76,6 +82,35 @@ class CompilationManager {
                            const Schema* projection,
                            gscoped_ptr<RowProjector>* out);
 
+  // Like RequestRowProjector, but for a compiled evaluator of the
+  // conjunction of 'predicates' over rows of 'schema'. The predicates must
+  // all satisfy PredicateEvaluatorFunctions::IsSupported. The evaluator
+  // written to 'out' is initialized and refers to 'schema' and to the values
+  // of 'predicates'.
+  bool RequestPredicateEvaluator(const Schema* schema,
+                                 const std::vector<ColumnPredicate>& predicates,
+                                 gscoped_ptr<PredicateEvaluator>* out);
+
+  // Like RequestRowProjector, but for a compiled comparator of the keys of
+  // rows of 'schema', which also copies the rows. The comparator only
+  // depends on the signature of 'schema', not on 'schema' itself.
+  bool RequestRowComparator(const Schema* schema,
+                            gscoped_ptr<RowComparator>* out);
+
+  // Like RequestRowProjector, but for compiled functions which fill the
+  // columns of 'projection' with their read defaults. The projector written
+  // to 'out' refers to 'projection'.
+  bool RequestColumnProjector(const Schema* projection,
+                              gscoped_ptr<ColumnProjector>* out);
+
+  // Enqueues compilation of the code which scans and compactions of rows
+  // of 'schema' are likely to request: the row projector from the schema to
+  // itself, and the row comparator of the schema. Meant to be called when a
+  // tablet is opened, so that the code is compiled, or loaded from the
+  // object cache, before the first scans need it. Like the requested
+  // compilations, these run on the single compilation thread.
+  void Precompile(const Schema& schema);
+
   // Waits for all asynchronous compilation tasks to finish.
   void Wait();
 
@@ -43,10 +43,15 @@
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
+#include "kudu/codegen/object_cache.h"
 #include "kudu/codegen/precompiled.ll.h"
+#include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/status.h"
 
 #ifndef CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS
@@ -57,6 +62,12 @@
 #endif
 #endif
 
+DEFINE_string(codegen_object_cache_dir, "",
+              "Directory in which the object code of generated functions is "
+              "kept, so that it is loaded rather than compiled again after a "
+              "restart. Code is only compiled in memory if empty.");
+TAG_FLAG(codegen_object_cache_dir, experimental);
+
 using llvm::CodeGenOpt::Level;
 using llvm::ConstantExpr;
 using llvm::ConstantInt;
@@ -126,7 +137,9 @@ bool ModuleContains(const Module& m, const Function* fptr) {
 ModuleBuilder::ModuleBuilder()
   : state_(kUninitialized),
     context_(new LLVMContext()),
-    builder_(*context_) {}
+    builder_(*context_),
+    target_(nullptr),
+    embeds_pointers_(false) {}
 
 ModuleBuilder::~ModuleBuilder() {}
 
@@ -184,8 +197,9 @@ Type* ModuleBuilder::GetType(const string& name) {
   return CHECK_NOTNULL(module_->getTypeByName(name));
 }
 
-Value* ModuleBuilder::GetPointerValue(void* ptr) const {
+Value* ModuleBuilder::GetPointerValue(void* ptr) {
   CHECK_EQ(state_, kBuilding);
+  embeds_pointers_ = true;
   // No direct way of creating constant pointer values in LLVM, so
   // first a constant int has to be created and then casted to a pointer
   IntegerType* llvm_uintptr_t = Type::getIntNTy(*context_, 8 * sizeof(ptr));
@@ -288,12 +302,32 @@ Status ModuleBuilder::Compile(unique_ptr<ExecutionEngine>* out) {
   }
   module->setDataLayout(target_->createDataLayout());
 
+  // The object code depends on the module and on everything which goes into
+  // compiling it, so all of it is part of the key of the object cache.
+  unique_ptr<DiskObjectCache> object_cache;
+  if (!FLAGS_codegen_object_cache_dir.empty() && !object_cache_key_.empty() &&
+      !embeds_pointers_) {
+    string key = object_cache_key_;
+    StrAppend(&key, "\n", util_hash::CityHash64(precompiled_ll_data, precompiled_ll_len),
+              "\n", llvm::sys::getHostCPUName().str(),
+              "\n", JoinStrings(GetHostCPUAttrs(), ","),
+              "\n", static_cast<int>(opt_level), CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS);
+    object_cache.reset(new DiskObjectCache(FLAGS_codegen_object_cache_dir, std::move(key)));
+    local_engine->setObjectCache(object_cache.get());
+  }
+
 #if CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS
-  DoOptimizations(local_engine.get(), module, GetFunctionNames());
+  // Cached object code was compiled from the optimized module already.
+  if (!object_cache || !object_cache->HasObject()) {
+    DoOptimizations(local_engine.get(), module, GetFunctionNames());
+  }
 #endif
 
-  // Compile the module
+  // Compile the module, or load its cached object code
   local_engine->finalizeObject();
+  if (object_cache) {
+    local_engine->setObjectCache(nullptr);
+  }
 
   // Satisfy the promises
   for (JITFuture& fut : futures_) {
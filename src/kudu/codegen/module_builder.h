@@ -21,6 +21,7 @@
 #include <memory>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <llvm/IR/IRBuilder.h>
@@ -84,8 +85,17 @@ class ModuleBuilder {
   llvm::Type* GetType(const std::string& name);
   // Retrieve a precompiled function
   llvm::Function* GetFunction(const std::string& name);
-  // Get the LLVM wrapper for a constant pointer value of type i8*
-  llvm::Value* GetPointerValue(void* ptr) const;
+  // Get the LLVM wrapper for a constant pointer value of type i8*.
+  // Modules which embed pointers are never cached on disk, since the
+  // pointers are only valid in this process.
+  llvm::Value* GetPointerValue(void* ptr);
+
+  // Sets the key which identifies the code of the module, typically the
+  // key of its JITWrapper. If --codegen_object_cache_dir is set, modules
+  // with a key are compiled at most once across restarts: their object code
+  // is written to the directory, and loaded by later compilations with the
+  // same key, the same precompiled IR and the same target.
+  void set_object_cache_key(std::string key) { object_cache_key_ = std::move(key); }
 
   LLVMBuilder* builder() { return &builder_; }
 
@@ -143,6 +153,9 @@ class ModuleBuilder {
   LLVMBuilder builder_;
   llvm::TargetMachine* target_; // not owned
 
+  std::string object_cache_key_;
+  bool embeds_pointers_;
+
   DISALLOW_COPY_AND_ASSIGN(ModuleBuilder);
 };
 
@@ -0,0 +1,140 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/object_cache.h"
+
+#include <cinttypes>
+#include <cstring>
+#include <utility>
+
+#include <glog/logging.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/env.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/slice.h"
+
+using std::string;
+using std::unique_ptr;
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// The files are laid out as follows:
+//
+// (8 bytes) kMagic
+// (8 bytes) length of the key, as a little-endian unsigned long
+// (variable size) the key
+// (remainder) the object code
+const char kMagic[] = "kudujit1";
+const size_t kMagicLen = sizeof(kMagic) - 1;
+
+} // anonymous namespace
+
+DiskObjectCache::DiskObjectCache(const string& dir, string key)
+  : dir_(dir),
+    key_(std::move(key)),
+    path_(JoinPathSegments(dir, StringPrintf(
+        "%016" PRIx64 ".o", util_hash::CityHash64(key_.data(), key_.size())))) {
+}
+
+bool DiskObjectCache::HasObject() {
+  if (object_) {
+    return true;
+  }
+  unique_ptr<faststring> obj(new faststring());
+  Status s = ReadObject(obj.get());
+  if (!s.ok()) {
+    if (!s.IsNotFound()) {
+      LOG(WARNING) << "Unable to read cached object code from " << path_ << ": "
+                   << s.ToString();
+    }
+    return false;
+  }
+  object_ = std::move(obj);
+  return true;
+}
+
+void DiskObjectCache::notifyObjectCompiled(const llvm::Module* /* module */,
+                                           llvm::MemoryBufferRef obj) {
+  Status s = WriteObject(Slice(obj.getBufferStart(), obj.getBufferSize()));
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to cache object code in " << path_ << ": " << s.ToString();
+  }
+}
+
+unique_ptr<llvm::MemoryBuffer> DiskObjectCache::getObject(const llvm::Module* /* module */) {
+  if (!HasObject()) {
+    return nullptr;
+  }
+  unique_ptr<faststring> obj = std::move(object_);
+  return unique_ptr<llvm::MemoryBuffer>(llvm::MemoryBuffer::getMemBufferCopy(
+      llvm::StringRef(reinterpret_cast<const char*>(obj->data()), obj->size())));
+}
+
+Status DiskObjectCache::ReadObject(faststring* obj) const {
+  Env* env = Env::Default();
+  if (!env->FileExists(path_)) {
+    return Status::NotFound("no cached object code", path_);
+  }
+  faststring contents;
+  RETURN_NOT_OK(ReadFileToString(env, path_, &contents));
+
+  Slice rest(contents);
+  if (rest.size() < kMagicLen + sizeof(uint64_t) ||
+      memcmp(rest.data(), kMagic, kMagicLen) != 0) {
+    return Status::Corruption("bad header in cached object code", path_);
+  }
+  rest.remove_prefix(kMagicLen);
+  uint64_t key_len = DecodeFixed64(rest.data());
+  rest.remove_prefix(sizeof(uint64_t));
+  if (key_len > rest.size()) {
+    return Status::Corruption("truncated cached object code", path_);
+  }
+  if (Slice(rest.data(), key_len) != Slice(key_)) {
+    // Another key with the same hash.
+    return Status::NotFound("cached object code is for a different key", path_);
+  }
+  rest.remove_prefix(key_len);
+  obj->assign_copy(rest.data(), rest.size());
+  return Status::OK();
+}
+
+Status DiskObjectCache::WriteObject(const Slice& obj) const {
+  Env* env = Env::Default();
+  RETURN_NOT_OK(env_util::CreateDirIfMissing(env, dir_));
+
+  faststring contents;
+  contents.append(kMagic, kMagicLen);
+  PutFixed64(&contents, key_.size());
+  contents.append(key_);
+  contents.append(obj.data(), obj.size());
+
+  string tmp_path = path_ + ".tmp";
+  RETURN_NOT_OK(WriteStringToFile(env, Slice(contents), tmp_path));
+  return env->RenameFile(tmp_path, path_);
+}
+
+} // namespace codegen
+} // namespace kudu
@@ -0,0 +1,87 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_OBJECT_CACHE_H
+#define KUDU_CODEGEN_OBJECT_CACHE_H
+
+#include <memory>
+#include <string>
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class MemoryBuffer;
+class MemoryBufferRef;
+class Module;
+} // namespace llvm
+
+namespace kudu {
+
+class Slice;
+
+namespace codegen {
+
+// An llvm::ObjectCache which keeps the object code of a single module in a
+// file in a directory, so that code compiled by an earlier process for the
+// same key may be loaded in place of compiling the module again.
+//
+// The key must identify the generated code completely: the JIT key of the
+// module, as well as everything else the object code depends on, such as
+// the precompiled IR and the target. Files are named after a hash of the
+// key, and store the key itself, so that files for colliding keys are
+// never loaded.
+//
+// The object code of the module is written to a temporary file which is
+// then renamed, so that concurrent readers never see partial files. Errors
+// reading or writing the files are logged, and the module is compiled as
+// if it wasn't cached.
+class DiskObjectCache : public llvm::ObjectCache {
+ public:
+  DiskObjectCache(const std::string& dir, std::string key);
+
+  // Returns whether the directory holds object code for the key.
+  bool HasObject();
+
+  void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef obj) override;
+
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+ private:
+  // Reads the object code for the key into 'obj'. Returns NotFound if there
+  // is no valid file for the key.
+  Status ReadObject(faststring* obj) const;
+
+  Status WriteObject(const Slice& obj) const;
+
+  const std::string dir_;
+  const std::string key_;
+  const std::string path_;
+
+  // The object code read by HasObject(), returned by the next getObject().
+  std::unique_ptr<faststring> object_;
+
+  DISALLOW_COPY_AND_ASSIGN(DiskObjectCache);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
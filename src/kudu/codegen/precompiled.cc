@@ -160,5 +160,45 @@ IR_ALWAYS_INLINE void _PrecompiledCopyCellToRowBlockSetNull(
   dst->cell(col).set_null(is_null);
 }
 
+// declare i8* @_PrecompiledRowBlockCellPtr(
+//   RowBlockRow* row, i64 col, i64 size)
+//
+//   Returns a pointer to the cell of column col in the row pointed to by
+//   row, where size is the size of the column type. As in
+//   _PrecompiledCopyCellToRowBlock, passing the size statically avoids
+//   loading it from the column's type info.
+IR_ALWAYS_INLINE uint8_t* _PrecompiledRowBlockCellPtr(
+    RowBlockRow* row, uint64_t col, uint64_t size) {
+  return row->row_block()->column_data_base_ptr(col) + row->row_index() * size;
+}
+
+// declare i32 @_PrecompiledCompareSlices(i8* lhs, i8* rhs)
+//
+//   Compares the Slices pointed to by lhs and rhs, as Slice::compare() does.
+IR_ALWAYS_INLINE int _PrecompiledCompareSlices(uint8_t* lhs, uint8_t* rhs) {
+  return reinterpret_cast<Slice*>(lhs)->compare(*reinterpret_cast<Slice*>(rhs));
+}
+
+// declare i1 @_PrecompiledCopyRowBlockCell(
+//   i64 size, RowBlockRow* src, RowBlockRow* dst, i64 col, i1 is_string,
+//   i1 is_nullable, Arena* arena)
+//
+//   Performs the same function as CopyCell, copying the cell of column col
+//   from the row pointed to by src to the same column of the row pointed to
+//   by dst, including its null state if is_nullable is true. The rows must
+//   have the same schema. Arguments are otherwise as for
+//   _PrecompiledCopyCellToRowBlock.
+IR_ALWAYS_INLINE bool _PrecompiledCopyRowBlockCell(
+    uint64_t size, RowBlockRow* src, RowBlockRow* dst, uint64_t col,
+    bool is_string, bool is_nullable, Arena* arena) {
+  if (is_nullable) {
+    bool is_null = src->is_null(col);
+    dst->cell(col).set_null(is_null);
+    if (is_null) return true;
+  }
+  return _PrecompiledCopyCellToRowBlock(
+      size, _PrecompiledRowBlockCellPtr(src, col, size), dst, col, is_string, arena);
+}
+
 } // extern "C"
 } // namespace kudu
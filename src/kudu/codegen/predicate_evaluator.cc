@@ -0,0 +1,486 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/predicate_evaluator.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PHINode;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// Returns the LLVM type of the cells of 'type', or NULL if the cells cannot
+// be compared by the compiled code.
+Type* GetCellType(DataType type, LLVMContext* context) {
+  switch (type) {
+    case BOOL:
+    case INT8:
+    case UINT8:
+      return Type::getInt8Ty(*context);
+    case INT16:
+    case UINT16:
+      return Type::getInt16Ty(*context);
+    case INT32:
+    case UINT32:
+      return Type::getInt32Ty(*context);
+    case INT64:
+    case UINT64:
+      return Type::getInt64Ty(*context);
+    case FLOAT:
+      return Type::getFloatTy(*context);
+    case DOUBLE:
+      return Type::getDoubleTy(*context);
+    default:
+      return nullptr;
+  }
+}
+
+bool IsSigned(DataType type) {
+  return type == INT8 || type == INT16 || type == INT32 || type == INT64;
+}
+
+bool IsFloatingPoint(DataType type) {
+  return type == FLOAT || type == DOUBLE;
+}
+
+// The values which the compiled code of one predicate refers to.
+struct PredicateValues {
+  const ColumnPredicate* pred;
+  DataType type;
+  Type* cell_type;
+  // The column's cells, as a pointer to 'cell_type'.
+  Value* data;
+  // The column's non-null bitmap, if it is nullable.
+  Value* non_null_bitmap;
+  // The bounds, if the predicate has them.
+  Value* lower;
+  Value* upper;
+};
+
+// Returns an i1 which is true if 'cell' satisfies the bounds of 'pv'.
+// Does not take nullability into account.
+Value* EmitCompare(ModuleBuilder::LLVMBuilder* builder, const PredicateValues& pv,
+                   Value* cell) {
+  switch (pv.pred->predicate_type()) {
+    case PredicateType::None:
+      return builder->getInt1(false);
+    case PredicateType::IsNotNull:
+      return builder->getInt1(true);
+    case PredicateType::Equality:
+      return IsFloatingPoint(pv.type) ? builder->CreateFCmpOEQ(cell, pv.lower)
+                                      : builder->CreateICmpEQ(cell, pv.lower);
+    case PredicateType::Range: {
+      Value* result = builder->getInt1(true);
+      if (pv.lower != nullptr) {
+        Value* ge;
+        if (IsFloatingPoint(pv.type)) {
+          ge = builder->CreateFCmpOGE(cell, pv.lower);
+        } else if (IsSigned(pv.type)) {
+          ge = builder->CreateICmpSGE(cell, pv.lower);
+        } else {
+          ge = builder->CreateICmpUGE(cell, pv.lower);
+        }
+        result = builder->CreateAnd(result, ge);
+      }
+      if (pv.upper != nullptr) {
+        Value* lt;
+        if (IsFloatingPoint(pv.type)) {
+          lt = builder->CreateFCmpOLT(cell, pv.upper);
+        } else if (IsSigned(pv.type)) {
+          lt = builder->CreateICmpSLT(cell, pv.upper);
+        } else {
+          lt = builder->CreateICmpULT(cell, pv.upper);
+        }
+        result = builder->CreateAnd(result, lt);
+      }
+      return result;
+    }
+    default:
+      LOG(FATAL) << "Unsupported predicate: " << pv.pred->ToString();
+  }
+  return nullptr;
+}
+
+// Returns whether the compiled code needs to load the cells of 'pred'.
+bool NeedsCells(const ColumnPredicate& pred) {
+  return pred.predicate_type() == PredicateType::Equality ||
+      pred.predicate_type() == PredicateType::Range;
+}
+
+// Generates a function of the form described by
+// PredicateEvaluatorFunctions::EvaluationFunction:
+//
+// define void @name(i8** %col_data, i8** %non_null_bitmaps, i8** %bounds,
+//                   i64 %nrows, i8* %sel)
+// entry:
+//   <for each predicate: load its column pointers and bounds>
+//   %nbytes = lshr i64 %nrows, 3
+//   br <%nbytes == 0>, label %tail_check, label %byte_loop
+// byte_loop:
+//   <for each predicate, for each of the 8 rows of the selection byte:
+//    load the cell and compare it to the bounds, setting the row's bit in
+//    the predicate's mask; AND the mask with the non-null byte if nullable>
+//   %sel[byte] = and %sel[byte], <AND of all masks>
+//   <loop until %nbytes are done>
+// tail_check, tail_loop:
+//   <for each of the remaining rows, clear its selection bit unless it
+//    satisfies every predicate>
+// exit:
+//   ret void
+//
+// The body of the byte loop has no branches, so that LLVM may vectorize the
+// comparisons of the 8 rows of each byte.
+Function* MakeEvaluation(const string& name,
+                         ModuleBuilder* mbuilder,
+                         const vector<ColumnPredicate>& predicates) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  Type* i8 = Type::getInt8Ty(context);
+  Type* i8_ptr = Type::getInt8PtrTy(context);
+  Type* i8_ptr_ptr = PointerType::getUnqual(i8_ptr);
+  Type* i64 = Type::getInt64Ty(context);
+  vector<Type*> argtypes = { i8_ptr_ptr, i8_ptr_ptr, i8_ptr_ptr, i64, i8_ptr };
+  FunctionType* fty = FunctionType::get(Type::getVoidTy(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* col_data = &*it++;
+  Argument* non_null_bitmaps = &*it++;
+  Argument* bounds = &*it++;
+  Argument* nrows = &*it++;
+  Argument* sel = &*it++;
+  DCHECK(it == f->arg_end());
+  col_data->setName("col_data");
+  non_null_bitmaps->setName("non_null_bitmaps");
+  bounds->setName("bounds");
+  nrows->setName("nrows");
+  sel->setName("sel");
+  // Note that these arguments are 1-based indexes.
+  f->setDoesNotAlias(1);
+  f->setDoesNotAlias(2);
+  f->setDoesNotAlias(3);
+  f->setDoesNotAlias(5);
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  BasicBlock* byte_loop = BasicBlock::Create(context, "byte_loop", f);
+  BasicBlock* tail_check = BasicBlock::Create(context, "tail_check", f);
+  BasicBlock* tail_loop = BasicBlock::Create(context, "tail_loop", f);
+  BasicBlock* exit = BasicBlock::Create(context, "exit", f);
+
+  // Load the pointers and bounds of each predicate up front.
+  builder->SetInsertPoint(entry);
+  vector<PredicateValues> values;
+  for (int i = 0; i < predicates.size(); i++) {
+    const ColumnPredicate& pred = predicates[i];
+    PredicateValues pv;
+    pv.pred = &pred;
+    pv.type = pred.column().type_info()->physical_type();
+    pv.cell_type = GetCellType(pv.type, &context);
+    CHECK(pv.cell_type != nullptr) << "Unsupported predicate: " << pred.ToString();
+    pv.data = nullptr;
+    pv.non_null_bitmap = nullptr;
+    pv.lower = nullptr;
+    pv.upper = nullptr;
+    if (NeedsCells(pred)) {
+      Value* data = builder->CreateLoad(builder->CreateConstGEP1_64(col_data, i));
+      pv.data = builder->CreateBitCast(data, PointerType::getUnqual(pv.cell_type));
+      pv.data->setName(StrCat("data", i));
+      Type* bound_ptr_type = PointerType::getUnqual(pv.cell_type);
+      if (pred.raw_lower() != nullptr) {
+        Value* lower = builder->CreateLoad(builder->CreateConstGEP1_64(bounds, 2 * i));
+        pv.lower = builder->CreateLoad(builder->CreateBitCast(lower, bound_ptr_type));
+        pv.lower->setName(StrCat("lower", i));
+      }
+      if (pred.raw_upper() != nullptr) {
+        Value* upper = builder->CreateLoad(builder->CreateConstGEP1_64(bounds, 2 * i + 1));
+        pv.upper = builder->CreateLoad(builder->CreateBitCast(upper, bound_ptr_type));
+        pv.upper->setName(StrCat("upper", i));
+      }
+    }
+    if (pred.column().is_nullable()) {
+      pv.non_null_bitmap = builder->CreateLoad(
+          builder->CreateConstGEP1_64(non_null_bitmaps, i));
+      pv.non_null_bitmap->setName(StrCat("non_null", i));
+    }
+    values.push_back(pv);
+  }
+  Value* nbytes = builder->CreateLShr(nrows, 3, "nbytes");
+  builder->CreateCondBr(builder->CreateICmpEQ(nbytes, builder->getInt64(0)),
+                        tail_check, byte_loop);
+
+  // Evaluate the predicates 8 rows at a time, one byte of the selection
+  // bitmap per iteration.
+  builder->SetInsertPoint(byte_loop);
+  PHINode* byte_idx = builder->CreatePHI(i64, 2, "byte_idx");
+  byte_idx->addIncoming(builder->getInt64(0), entry);
+  Value* first_row = builder->CreateShl(byte_idx, 3, "first_row");
+  Value* mask = builder->getInt8(0xff);
+  for (const PredicateValues& pv : values) {
+    Value* pred_mask;
+    if (pv.data != nullptr) {
+      pred_mask = builder->getInt8(0);
+      for (int bit = 0; bit < 8; bit++) {
+        Value* row = builder->CreateAdd(first_row, builder->getInt64(bit));
+        Value* cell = builder->CreateLoad(builder->CreateGEP(pv.data, row));
+        Value* passed = builder->CreateZExt(EmitCompare(builder, pv, cell), i8);
+        pred_mask = builder->CreateOr(pred_mask, builder->CreateShl(passed, bit));
+      }
+    } else {
+      pred_mask = builder->CreateSExt(EmitCompare(builder, pv, nullptr), i8);
+    }
+    if (pv.non_null_bitmap != nullptr) {
+      Value* non_null = builder->CreateLoad(builder->CreateGEP(pv.non_null_bitmap, byte_idx));
+      pred_mask = builder->CreateAnd(pred_mask, non_null);
+    }
+    mask = builder->CreateAnd(mask, pred_mask);
+  }
+  Value* sel_byte_ptr = builder->CreateGEP(sel, byte_idx);
+  builder->CreateStore(builder->CreateAnd(builder->CreateLoad(sel_byte_ptr), mask),
+                       sel_byte_ptr);
+  Value* next_byte_idx = builder->CreateAdd(byte_idx, builder->getInt64(1));
+  byte_idx->addIncoming(next_byte_idx, byte_loop);
+  builder->CreateCondBr(builder->CreateICmpEQ(next_byte_idx, nbytes), tail_check, byte_loop);
+
+  // Evaluate the predicates for the rows of the last, partial byte.
+  builder->SetInsertPoint(tail_check);
+  Value* tail_start = builder->CreateShl(nbytes, 3, "tail_start");
+  builder->CreateCondBr(builder->CreateICmpULT(tail_start, nrows), tail_loop, exit);
+
+  builder->SetInsertPoint(tail_loop);
+  PHINode* row = builder->CreatePHI(i64, 2, "row");
+  row->addIncoming(tail_start, tail_check);
+  Value* row_byte_idx = builder->CreateLShr(row, 3);
+  Value* row_bit = builder->CreateShl(builder->getInt8(1),
+                                      builder->CreateTrunc(builder->CreateAnd(row, 7), i8));
+  Value* passed = builder->getInt1(true);
+  for (const PredicateValues& pv : values) {
+    Value* cell = nullptr;
+    if (pv.data != nullptr) {
+      cell = builder->CreateLoad(builder->CreateGEP(pv.data, row));
+    }
+    passed = builder->CreateAnd(passed, EmitCompare(builder, pv, cell));
+    if (pv.non_null_bitmap != nullptr) {
+      Value* non_null = builder->CreateLoad(builder->CreateGEP(pv.non_null_bitmap, row_byte_idx));
+      passed = builder->CreateAnd(passed, builder->CreateICmpNE(
+          builder->CreateAnd(non_null, row_bit), builder->getInt8(0)));
+    }
+  }
+  Value* tail_sel_ptr = builder->CreateGEP(sel, row_byte_idx);
+  Value* tail_sel = builder->CreateLoad(tail_sel_ptr);
+  builder->CreateStore(
+      builder->CreateSelect(passed, tail_sel,
+                            builder->CreateAnd(tail_sel, builder->CreateNot(row_bit))),
+      tail_sel_ptr);
+  Value* next_row = builder->CreateAdd(row, builder->getInt64(1));
+  row->addIncoming(next_row, tail_loop);
+  builder->CreateCondBr(builder->CreateICmpEQ(next_row, nrows), exit, tail_loop);
+
+  builder->SetInsertPoint(exit);
+  builder->CreateRetVoid();
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping predicate evaluation:";
+    f->dump();
+  }
+
+  return f;
+}
+
+// Convenience method which appends to a faststring
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+} // anonymous namespace
+
+PredicateEvaluatorFunctions::PredicateEvaluatorFunctions(string key,
+                                                         EvaluationFunction evaluate_f,
+                                                         unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    key_(std::move(key)),
+    evaluate_f_(evaluate_f) {
+  CHECK(evaluate_f != nullptr)
+    << "Promise to compile evaluation function not fulfilled by ModuleBuilder";
+}
+
+bool PredicateEvaluatorFunctions::IsSupported(const ColumnPredicate& pred) {
+  switch (pred.predicate_type()) {
+    case PredicateType::None:
+    case PredicateType::Equality:
+    case PredicateType::Range:
+    case PredicateType::IsNotNull:
+      break;
+    default:
+      return false;
+  }
+  switch (pred.column().type_info()->physical_type()) {
+    case BOOL:
+    case INT8:
+    case UINT8:
+    case INT16:
+    case UINT16:
+    case INT32:
+    case UINT32:
+    case INT64:
+    case UINT64:
+    case FLOAT:
+    case DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+Status PredicateEvaluatorFunctions::Create(const vector<ColumnPredicate>& predicates,
+                                           scoped_refptr<PredicateEvaluatorFunctions>* out,
+                                           llvm::TargetMachine** tm) {
+  for (const ColumnPredicate& pred : predicates) {
+    if (!IsSupported(pred)) {
+      return Status::NotSupported("Cannot compile predicate", pred.ToString());
+    }
+  }
+  faststring key;
+  RETURN_NOT_OK(EncodeKey(predicates, &key));
+
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+  builder.set_object_cache_key(key.ToString());
+
+  Function* evaluate = MakeEvaluation("PredEval", &builder, predicates);
+
+  EvaluationFunction evaluate_f;
+  builder.AddJITPromise(evaluate, &evaluate_f);
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new PredicateEvaluatorFunctions(key.ToString(), evaluate_f, std::move(owner)));
+  return Status::OK();
+}
+
+Status PredicateEvaluatorFunctions::EncodeOwnKey(faststring* out) {
+  out->append(key_);
+  return Status::OK();
+}
+
+// Generates a key for the shape of a conjunction of predicates, encoded as
+// follows, in sequence.
+//
+// (1 byte) unique type identifier for PredicateEvaluatorFunctions
+// (8 bytes) number, as unsigned long, of predicates
+// (11 bytes each) the predicates, in order
+//   4 bytes for the predicate type
+//   4 bytes for the column's physical type
+//   1 byte for the column's nullability
+//   1 byte for whether the predicate has a lower bound
+//   1 byte for whether the predicate has an upper bound
+Status PredicateEvaluatorFunctions::EncodeKey(const vector<ColumnPredicate>& predicates,
+                                              faststring* out) {
+  AddNext(out, JITWrapper::PREDICATE_EVALUATOR);
+  AddNext(out, predicates.size());
+  for (const ColumnPredicate& pred : predicates) {
+    AddNext(out, pred.predicate_type());
+    AddNext(out, pred.column().type_info()->physical_type());
+    AddNext(out, pred.column().is_nullable());
+    AddNext(out, pred.raw_lower() != nullptr);
+    AddNext(out, pred.raw_upper() != nullptr);
+  }
+  return Status::OK();
+}
+
+PredicateEvaluator::PredicateEvaluator(const Schema* schema,
+                                       vector<ColumnPredicate> predicates,
+                                       const scoped_refptr<PredicateEvaluatorFunctions>& functions)
+  : schema_(schema),
+    predicates_(std::move(predicates)),
+    functions_(functions) {
+}
+
+Status PredicateEvaluator::Init() {
+  col_idxs_.clear();
+  bounds_.clear();
+  for (const ColumnPredicate& pred : predicates_) {
+    int col_idx = schema_->find_column(pred.column().name());
+    if (col_idx == Schema::kColumnNotFound) {
+      return Status::InvalidArgument("Unknown column in predicate", pred.ToString());
+    }
+    if (!schema_->column(col_idx).EqualsPhysicalType(pred.column())) {
+      return Status::InvalidArgument("Predicate does not match the column type",
+                                     pred.ToString());
+    }
+    col_idxs_.push_back(col_idx);
+    bounds_.push_back(pred.raw_lower());
+    bounds_.push_back(pred.raw_upper());
+  }
+  col_data_.resize(col_idxs_.size());
+  non_null_bitmaps_.resize(col_idxs_.size());
+  return Status::OK();
+}
+
+void PredicateEvaluator::Evaluate(RowBlock* block) const {
+  DCHECK_SCHEMA_EQ(*schema_, block->schema());
+  for (size_t i = 0; i < col_idxs_.size(); i++) {
+    ColumnBlock col = block->column_block(col_idxs_[i]);
+    col_data_[i] = col.data();
+    non_null_bitmaps_[i] = col.null_bitmap();
+  }
+  functions_->evaluate()(col_data_.data(), non_null_bitmaps_.data(), bounds_.data(),
+                         block->nrows(), block->selection_vector()->mutable_bitmap());
+}
+
+} // namespace codegen
+} // namespace kudu
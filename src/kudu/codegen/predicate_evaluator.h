@@ -0,0 +1,125 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CODEGEN_PREDICATE_EVALUATOR_H
+#define KUDU_CODEGEN_PREDICATE_EVALUATOR_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+
+class RowBlock;
+class Schema;
+
+namespace codegen {
+
+// The JITWrapper for a compiled conjunction of column predicates.
+//
+// The compiled function only depends on the shape of the predicates (their
+// types, the physical types and nullability of their columns, and which
+// bounds they have), not on their columns or values, so one function serves
+// every scan whose predicates have the same shape.
+class PredicateEvaluatorFunctions : public JITWrapper {
+ public:
+  // Evaluates the conjunction over 'nrows' rows, clearing the bits of
+  // 'sel_bitmap' for the rows which fail any predicate. The i-th predicate
+  // reads its column from 'col_data[i]' and, if the column is nullable,
+  // 'non_null_bitmaps[i]'. Its lower and upper bounds, if any, are pointed to
+  // by 'bounds[2 * i]' and 'bounds[2 * i + 1]'.
+  typedef void(*EvaluationFunction)(const uint8_t* const* col_data,
+                                    const uint8_t* const* non_null_bitmaps,
+                                    const void* const* bounds,
+                                    uint64_t nrows,
+                                    uint8_t* sel_bitmap);
+
+  // Returns whether 'pred' may be part of a compiled conjunction. IN-list
+  // predicates and predicates over variable length columns are not.
+  static bool IsSupported(const ColumnPredicate& pred);
+
+  // Compiles the evaluation function for the shape of 'predicates', which
+  // must all be supported.
+  // Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the function to 'out' upon success.
+  static Status Create(const std::vector<ColumnPredicate>& predicates,
+                       scoped_refptr<PredicateEvaluatorFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  EvaluationFunction evaluate() const { return evaluate_f_; }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE;
+
+  static Status EncodeKey(const std::vector<ColumnPredicate>& predicates,
+                          faststring* out);
+
+ private:
+  PredicateEvaluatorFunctions(std::string key, EvaluationFunction evaluate_f,
+                              std::unique_ptr<JITCodeOwner> owner);
+
+  const std::string key_;
+  const EvaluationFunction evaluate_f_;
+};
+
+// Evaluates a conjunction of column predicates over row blocks using compiled
+// code, in place of evaluating each ColumnPredicate in turn.
+class PredicateEvaluator {
+ public:
+  // Requires that 'schema' remains valid for the lifetime of this object,
+  // and that 'functions' were compiled for predicates of the same shape.
+  PredicateEvaluator(const Schema* schema,
+                     std::vector<ColumnPredicate> predicates,
+                     const scoped_refptr<PredicateEvaluatorFunctions>& functions);
+
+  // Resolves the columns of the predicates in the schema.
+  Status Init();
+
+  // Clears the selection bits of the rows of 'block' which fail any of the
+  // predicates. 'block' must have the schema passed to the constructor.
+  // Not thread-safe.
+  void Evaluate(RowBlock* block) const;
+
+  const std::vector<ColumnPredicate>& predicates() const { return predicates_; }
+
+ private:
+  const Schema* const schema_;
+  const std::vector<ColumnPredicate> predicates_;
+  const scoped_refptr<PredicateEvaluatorFunctions> functions_;
+
+  // The index in 'schema_' of the column of each predicate.
+  std::vector<int> col_idxs_;
+  // The bounds of each predicate, see EvaluationFunction.
+  std::vector<const void*> bounds_;
+  // Scratch space for the column pointers passed to the compiled function.
+  mutable std::vector<const uint8_t*> col_data_;
+  mutable std::vector<const uint8_t*> non_null_bitmaps_;
+
+  DISALLOW_COPY_AND_ASSIGN(PredicateEvaluator);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
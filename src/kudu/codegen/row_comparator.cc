@@ -0,0 +1,366 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/row_comparator.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// Returns the LLVM type of the cells of 'type', or NULL if they are
+// Slices.
+Type* GetCellType(DataType type, LLVMContext* context) {
+  switch (type) {
+    case BOOL:
+    case INT8:
+    case UINT8:
+      return Type::getInt8Ty(*context);
+    case INT16:
+    case UINT16:
+      return Type::getInt16Ty(*context);
+    case INT32:
+    case UINT32:
+      return Type::getInt32Ty(*context);
+    case INT64:
+    case UINT64:
+      return Type::getInt64Ty(*context);
+    case FLOAT:
+      return Type::getFloatTy(*context);
+    case DOUBLE:
+      return Type::getDoubleTy(*context);
+    case BINARY:
+      return nullptr;
+    default:
+      LOG(FATAL) << "Unexpected physical type: " << type;
+  }
+  return nullptr;
+}
+
+bool IsSigned(DataType type) {
+  return type == INT8 || type == INT16 || type == INT32 || type == INT64;
+}
+
+bool IsFloatingPoint(DataType type) {
+  return type == FLOAT || type == DOUBLE;
+}
+
+// Generates a function of the form described by
+// RowComparatorFunctions::CompareFunction:
+//
+// define i32 @name(RowBlockRow* %lhs, RowBlockRow* %rhs)
+// entry:
+//   br label %key0
+// <for each key column i>
+// key<i>:
+//   %lhs_cell<i> = call i8* @_PrecompiledRowBlockCellPtr(
+//     RowBlockRow* %lhs, i64 <i>, i64 <type size>)
+//   %rhs_cell<i> = <same, for %rhs>
+//   <if the column is a Slice>
+//     %cmp<i> = call i32 @_PrecompiledCompareSlices(i8* %lhs_cell<i>, i8* %rhs_cell<i>)
+//     br <%cmp<i> != 0>, label %differ<i>, label %key<i+1>
+//   differ<i>:
+//     ret i32 %cmp<i>
+//   <otherwise>
+//     <load the cells as their type>
+//     br <lhs < rhs>, label %less, label %gt<i>
+//   gt<i>:
+//     br <lhs > rhs>, label %greater, label %key<i+1>
+// <end implicit for each>
+// key<num key columns>:
+//   ret i32 0
+// less:
+//   ret i32 -1
+// greater:
+//   ret i32 1
+//
+// The comparisons of floating point cells are ordered, as in GenericCompare.
+Function* MakeCompare(const string& name, ModuleBuilder* mbuilder, const Schema& schema) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  Type* row_ptr = PointerType::getUnqual(mbuilder->GetType("class.kudu::RowBlockRow"));
+  vector<Type*> argtypes = { row_ptr, row_ptr };
+  FunctionType* fty = FunctionType::get(Type::getInt32Ty(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* lhs = &*it++;
+  Argument* rhs = &*it++;
+  DCHECK(it == f->arg_end());
+  lhs->setName("lhs");
+  rhs->setName("rhs");
+
+  Function* cell_ptr = mbuilder->GetFunction("_PrecompiledRowBlockCellPtr");
+  Function* compare_slices = mbuilder->GetFunction("_PrecompiledCompareSlices");
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  BasicBlock* less = BasicBlock::Create(context, "less", f);
+  BasicBlock* greater = BasicBlock::Create(context, "greater", f);
+
+  builder->SetInsertPoint(entry);
+  BasicBlock* key = BasicBlock::Create(context, "key0", f);
+  builder->CreateBr(key);
+
+  for (size_t i = 0; i < schema.num_key_columns(); i++) {
+    const ColumnSchema& col = schema.column(i);
+    DataType type = col.type_info()->physical_type();
+    BasicBlock* next_key = BasicBlock::Create(context, StrCat("key", i + 1), f);
+
+    builder->SetInsertPoint(key);
+    Value* col_idx = builder->getInt64(i);
+    Value* size = builder->getInt64(col.type_info()->size());
+    Value* lhs_cell = builder->CreateCall(cell_ptr, vector<Value*>({ lhs, col_idx, size }));
+    lhs_cell->setName(StrCat("lhs_cell", i));
+    Value* rhs_cell = builder->CreateCall(cell_ptr, vector<Value*>({ rhs, col_idx, size }));
+    rhs_cell->setName(StrCat("rhs_cell", i));
+
+    Type* cell_type = GetCellType(type, &context);
+    if (cell_type == nullptr) {
+      Value* cmp = builder->CreateCall(compare_slices, vector<Value*>({ lhs_cell, rhs_cell }));
+      cmp->setName(StrCat("cmp", i));
+      BasicBlock* differ = BasicBlock::Create(context, StrCat("differ", i), f);
+      builder->CreateCondBr(builder->CreateICmpNE(cmp, builder->getInt32(0)), differ, next_key);
+      builder->SetInsertPoint(differ);
+      builder->CreateRet(cmp);
+    } else {
+      Type* cell_ptr_type = PointerType::getUnqual(cell_type);
+      Value* l = builder->CreateLoad(builder->CreateBitCast(lhs_cell, cell_ptr_type));
+      Value* r = builder->CreateLoad(builder->CreateBitCast(rhs_cell, cell_ptr_type));
+      Value* lt;
+      Value* gt;
+      if (IsFloatingPoint(type)) {
+        lt = builder->CreateFCmpOLT(l, r);
+        gt = builder->CreateFCmpOGT(l, r);
+      } else if (IsSigned(type)) {
+        lt = builder->CreateICmpSLT(l, r);
+        gt = builder->CreateICmpSGT(l, r);
+      } else {
+        lt = builder->CreateICmpULT(l, r);
+        gt = builder->CreateICmpUGT(l, r);
+      }
+      BasicBlock* check_gt = BasicBlock::Create(context, StrCat("gt", i), f);
+      builder->CreateCondBr(lt, less, check_gt);
+      builder->SetInsertPoint(check_gt);
+      builder->CreateCondBr(gt, greater, next_key);
+    }
+    key = next_key;
+  }
+
+  builder->SetInsertPoint(key);
+  builder->CreateRet(builder->getInt32(0));
+  builder->SetInsertPoint(less);
+  builder->CreateRet(builder->getInt32(-1));
+  builder->SetInsertPoint(greater);
+  builder->CreateRet(builder->getInt32(1));
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping row comparison:";
+    f->dump();
+  }
+
+  return f;
+}
+
+// Generates a function of the form described by
+// RowComparatorFunctions::CopyFunction:
+//
+// define i1 @name(RowBlockRow* noalias %src, RowBlockRow* noalias %dst,
+//                 Arena* noalias %arena)
+// entry:
+//   <for each column>
+//     %result = call i1 @_PrecompiledCopyRowBlockCell(
+//       i64 <type size>, RowBlockRow* %src, RowBlockRow* %dst,
+//       i64 <column index>, i1 <is binary>, i1 <is nullable>, Arena* %arena)
+//     %success = and %success, %result
+//   <end implicit for each>
+//   ret i1 %success
+Function* MakeCopy(const string& name, ModuleBuilder* mbuilder, const Schema& schema) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  Type* row_ptr = PointerType::getUnqual(mbuilder->GetType("class.kudu::RowBlockRow"));
+  vector<Type*> argtypes = { row_ptr, row_ptr,
+                             PointerType::getUnqual(mbuilder->GetType("class.kudu::Arena")) };
+  FunctionType* fty = FunctionType::get(Type::getInt1Ty(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  Function::arg_iterator it = f->arg_begin();
+  Argument* src = &*it++;
+  Argument* dst = &*it++;
+  Argument* arena = &*it++;
+  DCHECK(it == f->arg_end());
+  src->setName("src");
+  dst->setName("dst");
+  arena->setName("arena");
+  // As in the row projector, this eliminates redundant loads of the row
+  // blocks and row indexes for each column. Note that these arguments are
+  // 1-based indexes.
+  f->setDoesNotAlias(1);
+  f->setDoesNotAlias(2);
+  f->setDoesNotAlias(3);
+
+  Function* copy_cell = mbuilder->GetFunction("_PrecompiledCopyRowBlockCell");
+
+  builder->SetInsertPoint(BasicBlock::Create(context, "entry", f));
+  Value* success = builder->getInt1(true);
+  for (size_t i = 0; i < schema.num_columns(); i++) {
+    const ColumnSchema& col = schema.column(i);
+    vector<Value*> args = {
+      builder->getInt64(col.type_info()->size()),
+      src,
+      dst,
+      builder->getInt64(i),
+      builder->getInt1(col.type_info()->physical_type() == BINARY),
+      builder->getInt1(col.is_nullable()),
+      arena
+    };
+    Value* result = builder->CreateCall(copy_cell, args);
+    result->setName(StrCat("result", i));
+    success = builder->CreateAnd(success, result);
+    success->setName(StrCat("success", i));
+  }
+  builder->CreateRet(success);
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping row copy:";
+    f->dump();
+  }
+
+  return f;
+}
+
+// Convenience method which appends to a faststring
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+} // anonymous namespace
+
+RowComparatorFunctions::RowComparatorFunctions(string key,
+                                               CompareFunction compare_f,
+                                               CopyFunction copy_f,
+                                               unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    key_(std::move(key)),
+    compare_f_(compare_f),
+    copy_f_(copy_f) {
+  CHECK(compare_f != nullptr)
+    << "Promise to compile comparison function not fulfilled by ModuleBuilder";
+  CHECK(copy_f != nullptr)
+    << "Promise to compile copy function not fulfilled by ModuleBuilder";
+}
+
+Status RowComparatorFunctions::Create(const Schema& schema,
+                                      scoped_refptr<RowComparatorFunctions>* out,
+                                      llvm::TargetMachine** tm) {
+  faststring key;
+  RETURN_NOT_OK(EncodeKey(schema, &key));
+
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+  builder.set_object_cache_key(key.ToString());
+
+  Function* compare = MakeCompare("RowCompare", &builder, schema);
+  Function* copy = MakeCopy("RowCopy", &builder, schema);
+
+  CompareFunction compare_f;
+  CopyFunction copy_f;
+  builder.AddJITPromise(compare, &compare_f);
+  builder.AddJITPromise(copy, &copy_f);
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new RowComparatorFunctions(key.ToString(), compare_f, copy_f, std::move(owner)));
+  return Status::OK();
+}
+
+Status RowComparatorFunctions::EncodeOwnKey(faststring* out) {
+  out->append(key_);
+  return Status::OK();
+}
+
+// Generates a key for the signature of a schema, encoded as follows, in
+// sequence.
+//
+// (1 byte) unique type identifier for RowComparatorFunctions
+// (8 bytes) number, as unsigned long, of key columns
+// (8 bytes) number, as unsigned long, of columns
+// (5 bytes each) the columns, in order
+//   4 bytes for the column's physical type
+//   1 byte for the column's nullability
+Status RowComparatorFunctions::EncodeKey(const Schema& schema, faststring* out) {
+  AddNext(out, JITWrapper::ROW_COMPARATOR);
+  AddNext(out, schema.num_key_columns());
+  AddNext(out, schema.num_columns());
+  for (const ColumnSchema& col : schema.columns()) {
+    AddNext(out, col.type_info()->physical_type());
+    AddNext(out, col.is_nullable());
+  }
+  return Status::OK();
+}
+
+Status RowComparator::CopyRow(const RowBlockRow& src, RowBlockRow* dst,
+                              Arena* dst_arena) const {
+  if (PREDICT_FALSE(!functions_->copy()(&src, dst, dst_arena))) {
+    return Status::IOError("out of memory copying row");
+  }
+  return Status::OK();
+}
+
+} // namespace codegen
+} // namespace kudu
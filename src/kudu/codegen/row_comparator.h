@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_ROW_COMPARATOR_H
+#define KUDU_CODEGEN_ROW_COMPARATOR_H
+
+#include <memory>
+#include <string>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/row_comparator.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+
+class Arena;
+class RowBlockRow;
+class Schema;
+
+namespace codegen {
+
+// The JITWrapper for the key comparison and row copy functions of a schema.
+//
+// The compiled functions only depend on the physical types and nullability
+// of the columns of the schema and on which of them are keys, so one pair of
+// functions serves every schema with the same signature.
+class RowComparatorFunctions : public JITWrapper {
+ public:
+  // Compares the keys of two rows as Schema::Compare() does.
+  typedef int(*CompareFunction)(const RowBlockRow* lhs, const RowBlockRow* rhs);
+
+  // Copies a row as CopyRow() does, relocating indirect data to the arena if
+  // it isn't NULL. Returns false if the arena is out of memory.
+  typedef bool(*CopyFunction)(const RowBlockRow* src, RowBlockRow* dst, Arena* arena);
+
+  // Compiles the functions for the signature of 'schema'.
+  // Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the functions to 'out' upon success.
+  static Status Create(const Schema& schema,
+                       scoped_refptr<RowComparatorFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  CompareFunction compare() const { return compare_f_; }
+  CopyFunction copy() const { return copy_f_; }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE;
+
+  static Status EncodeKey(const Schema& schema, faststring* out);
+
+ private:
+  RowComparatorFunctions(std::string key, CompareFunction compare_f, CopyFunction copy_f,
+                         std::unique_ptr<JITCodeOwner> owner);
+
+  const std::string key_;
+  const CompareFunction compare_f_;
+  const CopyFunction copy_f_;
+};
+
+// Compares and copies rows of a schema using compiled code, in place of
+// Schema::Compare() and CopyRow().
+class RowComparator : public kudu::RowComparator {
+ public:
+  // Requires that 'functions' were compiled for a schema with the same
+  // signature as the rows which are compared and copied.
+  explicit RowComparator(const scoped_refptr<RowComparatorFunctions>& functions)
+    : functions_(functions) {
+  }
+
+  int Compare(const RowBlockRow& lhs, const RowBlockRow& rhs) const OVERRIDE {
+    return functions_->compare()(&lhs, &rhs);
+  }
+
+  Status CopyRow(const RowBlockRow& src, RowBlockRow* dst, Arena* dst_arena) const OVERRIDE;
+
+ private:
+  const scoped_refptr<RowComparatorFunctions> functions_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowComparator);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
@@ -270,6 +270,12 @@ Status RowProjectorFunctions::Create(const Schema& base_schema,
   ModuleBuilder builder;
   RETURN_NOT_OK(builder.Init());
 
+  // Projections with default columns embed pointers to the defaults, and
+  // are not cached on disk regardless of the key.
+  faststring key;
+  RETURN_NOT_OK(EncodeKey(base_schema, projection, &key));
+  builder.set_object_cache_key(key.ToString());
+
   // Use a no-codegen row projector to check validity and to build
   // the codegen functions.
   kudu::RowProjector no_codegen(&base_schema, &projection);
@@ -38,7 +38,8 @@ class ColumnMaterializationContext {
       pred_(pred),
       block_(block),
       sel_(sel),
-      decoder_eval_status_(kNotSet) {
+      decoder_eval_status_(kNotSet),
+      skip_deselected_rows_(false) {
       if (!pred_ || !sel || !block) {
         decoder_eval_status_ = kDecoderEvalNotSupported;
       }
@@ -104,6 +105,19 @@ class ColumnMaterializationContext {
     decoder_eval_status_ = kDecoderEvalNotSupported;
   }
 
+  // Allows the column iterator to skip reading and decoding data blocks
+  // whose rows are all deselected in sel(), leaving their cells zeroed.
+  // Should only be called if sel() is initialized and its deselected rows
+  // are never read from the block.
+  void SetSkipDeselectedRows() {
+    DCHECK(sel_ != nullptr);
+    skip_deselected_rows_ = true;
+  }
+
+  // Checked by CFileIterator::Scan() to determine whether data blocks with
+  // no selected rows may be skipped.
+  bool skip_deselected_rows() const { return skip_deselected_rows_; }
+
  private:
   enum DecoderEvalStatus {
     // During scan, will try to evaluate with the decoder, after which the
@@ -132,6 +146,8 @@ class ColumnMaterializationContext {
   SelectionVector* const sel_;
 
   DecoderEvalStatus decoder_eval_status_;
+
+  bool skip_deselected_rows_;
 };
 
 } // namespace kudu
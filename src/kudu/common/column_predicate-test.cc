@@ -17,16 +17,21 @@
 
 #include "kudu/common/column_predicate.h"
 
+#include <string>
 #include <vector>
 
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(in_list_predicate_index);
 DECLARE_bool(log_redact_user_data);
 
 namespace kudu {
@@ -965,6 +970,275 @@ TEST_F(TestColumnPredicate, TestInList) {
   }
 }
 
+// Test that evaluating InList predicates with an index of their values
+// selects the same rows as the binary search, for both short and long lists.
+TEST_F(TestColumnPredicate, TestInListIndex) {
+  FLAGS_in_list_predicate_index = true;
+  const size_t kNumRows = 1000;
+  for (int num_values : { 3, 15, 16, 100 }) {
+    SCOPED_TRACE(num_values);
+    {
+      ColumnSchema column("c", INT32, true);
+      // Every seventh value, some of them negative.
+      vector<int32_t> ints;
+      for (int i = 0; i < num_values; i++) {
+        ints.push_back(i * 7 - 50);
+      }
+      vector<const void*> values;
+      for (const auto& v : ints) {
+        values.push_back(&v);
+      }
+      ColumnPredicate pred = ColumnPredicate::InList(column, &values);
+      ColumnPredicate indexed = pred;
+      indexed.BuildInListIndex();
+      ASSERT_TRUE(pred.in_list_index() == nullptr);
+      ASSERT_TRUE(indexed.in_list_index() != nullptr);
+
+      ScopedColumnBlock<INT32> block(kNumRows);
+      for (size_t i = 0; i < kNumRows; i++) {
+        block[i] = static_cast<int32_t>(i) - 100;
+        block.SetCellIsNull(i, i % 10 == 0);
+      }
+      SelectionVector sel(kNumRows);
+      SelectionVector indexed_sel(kNumRows);
+      sel.SetAllTrue();
+      indexed_sel.SetAllTrue();
+      pred.Evaluate(block, &sel);
+      indexed.Evaluate(block, &indexed_sel);
+      ASSERT_GT(sel.CountSelected(), 0);
+      for (size_t i = 0; i < kNumRows; i++) {
+        ASSERT_EQ(sel.IsRowSelected(i), indexed_sel.IsRowSelected(i)) << i;
+        ASSERT_EQ(pred.EvaluateCell<INT32>(&block[i]),
+                  indexed.EvaluateCell<INT32>(&block[i])) << i;
+      }
+    }
+    {
+      ColumnSchema column("c", STRING);
+      vector<string> strings;
+      for (int i = 0; i < num_values; i++) {
+        strings.push_back(std::to_string(i * 7));
+      }
+      vector<Slice> slices(strings.begin(), strings.end());
+      vector<const void*> values;
+      for (const auto& s : slices) {
+        values.push_back(&s);
+      }
+      ColumnPredicate pred = ColumnPredicate::InList(column, &values);
+      ColumnPredicate indexed = pred;
+      indexed.BuildInListIndex();
+
+      vector<string> cells;
+      for (size_t i = 0; i < kNumRows; i++) {
+        cells.push_back(std::to_string(i));
+      }
+      ScopedColumnBlock<STRING> block(kNumRows);
+      for (size_t i = 0; i < kNumRows; i++) {
+        block[i] = Slice(cells[i]);
+        block.SetCellIsNull(i, false);
+      }
+      SelectionVector sel(kNumRows);
+      SelectionVector indexed_sel(kNumRows);
+      sel.SetAllTrue();
+      indexed_sel.SetAllTrue();
+      pred.Evaluate(block, &sel);
+      indexed.Evaluate(block, &indexed_sel);
+      ASSERT_EQ(num_values, sel.CountSelected());
+      for (size_t i = 0; i < kNumRows; i++) {
+        ASSERT_EQ(sel.IsRowSelected(i), indexed_sel.IsRowSelected(i)) << i;
+      }
+    }
+  }
+
+  // A merge drops the index.
+  ColumnSchema column("c", INT32);
+  int32_t five = 5;
+  int32_t six = 6;
+  int32_t ten = 10;
+  vector<const void*> values = { &five, &six, &ten };
+  ColumnPredicate pred = ColumnPredicate::InList(column, &values);
+  pred.BuildInListIndex();
+  ASSERT_TRUE(pred.in_list_index() != nullptr);
+  pred.Merge(ColumnPredicate::Range(column, &five, &ten));
+  ASSERT_TRUE(pred.in_list_index() == nullptr);
+  ASSERT_EQ(PredicateType::InList, pred.predicate_type());
+}
+
+// Test the InBloomFilter constructor, evaluation and merges.
+TEST_F(TestColumnPredicate, TestInBloomFilter) {
+  ColumnSchema column("c", INT32, true);
+
+  // A filter containing the even numbers in [0, 100).
+  BloomFilterBuilder builder(BloomFilterSizing::ByCountAndFPRate(50, 0.01),
+                             BloomFilterLayout::BLOCKED);
+  for (int32_t i = 0; i < 100; i += 2) {
+    builder.AddKey(BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(&i), sizeof(i))));
+  }
+  BloomFilter filter(builder.slice(), builder.n_hashes(), BloomFilterLayout::BLOCKED);
+
+  int32_t four = 4;
+  int32_t six = 6;
+  int32_t ten = 10;
+  int32_t twenty = 20;
+
+  ColumnPredicate bf = ColumnPredicate::InBloomFilter(column, { &filter }, nullptr, nullptr);
+  ASSERT_EQ(PredicateType::InBloomFilter, bf.predicate_type());
+  ASSERT_EQ(PredicateType::None,
+            ColumnPredicate::InBloomFilter(column, { &filter }, &twenty, &ten).predicate_type());
+
+  // Every value in the filter is selected, along with few others, and a null
+  // is never selected.
+  const size_t kNumRows = 200;
+  ScopedColumnBlock<INT32> block(kNumRows);
+  for (size_t i = 0; i < kNumRows; i++) {
+    block[i] = i;
+    block.SetCellIsNull(i, i == 0);
+  }
+  SelectionVector sel(kNumRows);
+  sel.SetAllTrue();
+  bf.Evaluate(block, &sel);
+  ASSERT_FALSE(sel.IsRowSelected(0));
+  for (size_t i = 2; i < 100; i += 2) {
+    ASSERT_TRUE(sel.IsRowSelected(i)) << i;
+  }
+  ASSERT_LT(sel.CountSelected(), 49 + 20);
+
+  // With bounds, only values within them are selected.
+  ColumnPredicate bounded = ColumnPredicate::InBloomFilter(column, { &filter }, &ten, &twenty);
+  sel.SetAllTrue();
+  bounded.Evaluate(block, &sel);
+  for (size_t i = 0; i < kNumRows; i++) {
+    ASSERT_EQ(i >= 10 && i < 20 && (i % 2 == 0 || bounded.EvaluateCell<INT32>(&block[i])),
+              sel.IsRowSelected(i)) << i;
+  }
+
+  // Merges.
+  ColumnPredicate merged = bf;
+  merged.Merge(ColumnPredicate::Equality(column, &four));
+  ASSERT_EQ(ColumnPredicate::Equality(column, &four), merged);
+
+  merged = ColumnPredicate::Equality(column, &four);
+  merged.Merge(bounded);
+  ASSERT_EQ(PredicateType::None, merged.predicate_type());
+
+  merged = bf;
+  merged.Merge(ColumnPredicate::Range(column, &ten, &twenty));
+  ASSERT_EQ(bounded, merged);
+
+  merged = ColumnPredicate::Range(column, &ten, &twenty);
+  merged.Merge(bf);
+  ASSERT_EQ(bounded, merged);
+
+  merged = ColumnPredicate::IsNotNull(column);
+  merged.Merge(bf);
+  ASSERT_EQ(bf, merged);
+
+  vector<const void*> values = { &four, &six, &twenty };
+  merged = bf;
+  merged.Merge(ColumnPredicate::InList(column, &values));
+  ASSERT_EQ(PredicateType::InList, merged.predicate_type());
+  ASSERT_EQ(3, merged.raw_values().size());
+
+  values = { &four, &six, &twenty };
+  merged = bounded;
+  merged.Merge(ColumnPredicate::InList(column, &values));
+  ASSERT_EQ(PredicateType::None, merged.predicate_type());
+
+  merged = bf;
+  merged.Merge(bounded);
+  ASSERT_EQ(PredicateType::InBloomFilter, merged.predicate_type());
+  ASSERT_EQ(2, merged.bloom_filters().size());
+  ASSERT_EQ(&ten, merged.raw_lower());
+  ASSERT_EQ(&twenty, merged.raw_upper());
+}
+
+// Test evaluating predicates on nullable blocks which are entirely null,
+// entirely non-null, or mixed.
+TEST_F(TestColumnPredicate, TestEvaluateNullBlocks) {
+  ColumnSchema column("c", INT32, true);
+  int32_t ten = 10;
+  const ColumnPredicate range = ColumnPredicate::Range(column, &ten, nullptr);
+  const ColumnPredicate not_null = ColumnPredicate::IsNotNull(column);
+
+  // 'kNumRows' is not a multiple of eight, to cover the partial last byte.
+  const size_t kNumRows = 203;
+  ScopedColumnBlock<INT32> block(kNumRows);
+  for (int pattern = 0; pattern < 3; pattern++) {
+    SCOPED_TRACE(pattern);
+    auto is_null = [&] (size_t i) {
+      return pattern == 0 || (pattern == 2 && i % 3 == 0);
+    };
+    for (size_t i = 0; i < kNumRows; i++) {
+      block[i] = i;
+      block.SetCellIsNull(i, is_null(i));
+    }
+    for (const ColumnPredicate* pred : { &range, &not_null }) {
+      SelectionVector sel(kNumRows);
+      sel.SetAllTrue();
+      // A deselected row stays deselected.
+      BitmapClear(sel.mutable_bitmap(), 11);
+      pred->Evaluate(block, &sel);
+      for (size_t i = 0; i < kNumRows; i++) {
+        bool expected = !is_null(i) && i != 11 && (pred == &not_null || i >= 10);
+        ASSERT_EQ(expected, sel.IsRowSelected(i)) << i;
+      }
+    }
+  }
+}
+
+// Test checking predicates against a [min, max] range of values.
+TEST_F(TestColumnPredicate, TestMayMatchRange) {
+  {
+    ColumnSchema column("c", INT32, true);
+    int32_t zero = 0;
+    int32_t five = 5;
+    int32_t ten = 10;
+    int32_t twenty = 20;
+    int32_t thirty = 30;
+
+    // Range predicates, with lower bound inclusive and upper bound exclusive.
+    ColumnPredicate range = ColumnPredicate::Range(column, &ten, &twenty);
+    ASSERT_FALSE(range.MayMatchRange(&zero, &five));
+    ASSERT_TRUE(range.MayMatchRange(&zero, &ten));
+    ASSERT_TRUE(range.MayMatchRange(&five, &thirty));
+    ASSERT_FALSE(range.MayMatchRange(&twenty, &thirty));
+    ASSERT_TRUE(ColumnPredicate::Range(column, nullptr, &five).MayMatchRange(&zero, &ten));
+    ASSERT_FALSE(ColumnPredicate::Range(column, nullptr, &five).MayMatchRange(&ten, &ten));
+    ASSERT_TRUE(ColumnPredicate::Range(column, &twenty, nullptr).MayMatchRange(&ten, &twenty));
+    ASSERT_FALSE(ColumnPredicate::Range(column, &thirty, nullptr).MayMatchRange(&ten, &twenty));
+
+    // Equality predicates.
+    ASSERT_TRUE(ColumnPredicate::Equality(column, &ten).MayMatchRange(&ten, &ten));
+    ASSERT_TRUE(ColumnPredicate::Equality(column, &ten).MayMatchRange(&five, &twenty));
+    ASSERT_FALSE(ColumnPredicate::Equality(column, &ten).MayMatchRange(&twenty, &thirty));
+
+    // InList predicates match if any value falls within the range.
+    vector<const void*> values = { &five, &thirty };
+    ColumnPredicate in_list = ColumnPredicate::InList(column, &values);
+    ASSERT_EQ(PredicateType::InList, in_list.predicate_type());
+    ASSERT_FALSE(in_list.MayMatchRange(&ten, &twenty));
+    ASSERT_TRUE(in_list.MayMatchRange(&zero, &ten));
+    ASSERT_TRUE(in_list.MayMatchRange(&twenty, &thirty));
+
+    ASSERT_TRUE(ColumnPredicate::IsNotNull(column).MayMatchRange(&zero, &zero));
+    values = {};
+    ColumnPredicate none = ColumnPredicate::InList(column, &values);
+    ASSERT_EQ(PredicateType::None, none.predicate_type());
+    ASSERT_FALSE(none.MayMatchRange(&zero, &thirty));
+  }
+  {
+    ColumnSchema column("c", STRING);
+    Slice a("a");
+    Slice b("b");
+    Slice c("c");
+    Slice d("d");
+
+    ASSERT_TRUE(ColumnPredicate::Range(column, &b, &d).MayMatchRange(&a, &b));
+    ASSERT_FALSE(ColumnPredicate::Range(column, &c, &d).MayMatchRange(&a, &b));
+    ASSERT_TRUE(ColumnPredicate::Equality(column, &b).MayMatchRange(&a, &c));
+    ASSERT_FALSE(ColumnPredicate::Equality(column, &d).MayMatchRange(&a, &c));
+  }
+}
+
 // Test that column predicate comparison works correctly: ordered by predicate
 // type first, then size of the column type.
 TEST_F(TestColumnPredicate, TestSelectivity) {
@@ -20,12 +20,24 @@
 #include <algorithm>
 #include <utility>
 
+#include <gflags/gflags.h>
+
 #include "kudu/common/key_util.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/arena.h"
 
+DEFINE_bool(in_list_predicate_index, false,
+            "Whether scans evaluate IN-list predicates with an index of their "
+            "values: a hash table for long lists of integers and for lists of "
+            "binary values, or a contiguous sorted array for other lists. "
+            "Otherwise, the list is binary searched for each cell.");
+TAG_FLAG(in_list_predicate_index, experimental);
+TAG_FLAG(in_list_predicate_index, runtime);
+
 using std::move;
 using std::vector;
 
@@ -65,6 +77,17 @@ ColumnPredicate ColumnPredicate::Range(ColumnSchema column,
   return pred;
 }
 
+ColumnPredicate ColumnPredicate::InBloomFilter(ColumnSchema column,
+                                               vector<const BloomFilter*> bloom_filters,
+                                               const void* lower,
+                                               const void* upper) {
+  CHECK(!bloom_filters.empty());
+  ColumnPredicate pred(PredicateType::InBloomFilter, move(column), lower, upper);
+  pred.bloom_filters_ = move(bloom_filters);
+  pred.Simplify();
+  return pred;
+}
+
 ColumnPredicate ColumnPredicate::InList(ColumnSchema column,
                                         vector<const void*>* values) {
   CHECK(values != nullptr);
@@ -149,8 +172,10 @@ ColumnPredicate ColumnPredicate::None(ColumnSchema column) {
 
 void ColumnPredicate::SetToNone() {
   predicate_type_ = PredicateType::None;
+  in_list_index_.reset();
   lower_ = nullptr;
   upper_ = nullptr;
+  bloom_filters_.clear();
 }
 
 void ColumnPredicate::Simplify() {
@@ -212,12 +237,22 @@ void ColumnPredicate::Simplify() {
       }
       return;
     };
+    case PredicateType::InBloomFilter: {
+      DCHECK(!bloom_filters_.empty());
+      if (lower_ != nullptr && upper_ != nullptr &&
+          type_info->Compare(lower_, upper_) >= 0) {
+        // If the range bounds are empty then no results can be returned.
+        SetToNone();
+      }
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
 
 void ColumnPredicate::Merge(const ColumnPredicate& other) {
   CHECK(column_.Equals(other.column_, false));
+  in_list_index_.reset();
   switch (predicate_type_) {
     case PredicateType::None: return;
     case PredicateType::Range: {
@@ -239,12 +274,17 @@ void ColumnPredicate::Merge(const ColumnPredicate& other) {
       lower_ = other.lower_;
       upper_ = other.upper_;
       values_ = other.values_;
+      bloom_filters_ = other.bloom_filters_;
       return;
     };
     case PredicateType::InList: {
       MergeIntoInList(other);
       return;
     };
+    case PredicateType::InBloomFilter: {
+      MergeIntoBloomFilter(other);
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -259,18 +299,7 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
     };
 
     case PredicateType::Range: {
-      // Set the lower bound to the larger of the two.
-      if (other.lower_ != nullptr &&
-          (lower_ == nullptr || column_.type_info()->Compare(lower_, other.lower_) < 0)) {
-        lower_ = other.lower_;
-      }
-
-      // Set the upper bound to the smaller of the two.
-      if (other.upper_ != nullptr &&
-          (upper_ == nullptr || column_.type_info()->Compare(upper_, other.upper_) > 0)) {
-        upper_ = other.upper_;
-      }
-
+      MergeBounds(other);
       Simplify();
       return;
     };
@@ -307,10 +336,36 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
       Simplify();
       return;
     };
+    case PredicateType::InBloomFilter: {
+      // The bloom filter predicate is more selective, so take on its filters
+      // along with the intersection of the ranges.
+      MergeBounds(other);
+      predicate_type_ = PredicateType::InBloomFilter;
+      bloom_filters_ = other.bloom_filters_;
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
 
+void ColumnPredicate::MergeBounds(const ColumnPredicate& other) {
+  DCHECK(other.predicate_type_ == PredicateType::Range ||
+         other.predicate_type_ == PredicateType::InBloomFilter);
+
+  // Set the lower bound to the larger of the two.
+  if (other.lower_ != nullptr &&
+      (lower_ == nullptr || column_.type_info()->Compare(lower_, other.lower_) < 0)) {
+    lower_ = other.lower_;
+  }
+
+  // Set the upper bound to the smaller of the two.
+  if (other.upper_ != nullptr &&
+      (upper_ == nullptr || column_.type_info()->Compare(upper_, other.upper_) > 0)) {
+    upper_ = other.upper_;
+  }
+}
+
 void ColumnPredicate::MergeIntoEquality(const ColumnPredicate& other) {
   CHECK(predicate_type_ == PredicateType::Equality);
 
@@ -340,6 +395,12 @@ void ColumnPredicate::MergeIntoEquality(const ColumnPredicate& other) {
       }
       return;
     };
+    case PredicateType::InBloomFilter: {
+      if (!other.CheckValueInBloomFilterPredicate(lower_)) {
+        SetToNone();
+      }
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -440,28 +501,103 @@ void ColumnPredicate::MergeIntoInList(const ColumnPredicate &other) {
       Simplify();
       return;
     };
+    case PredicateType::InBloomFilter: {
+      // Only values which may pass the filters should be retained.
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [&other] (const void* v) {
+                                     return !other.CheckValueInBloomFilterPredicate(v);
+                                   }), values_.end());
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
 
+void ColumnPredicate::MergeIntoBloomFilter(const ColumnPredicate& other) {
+  CHECK(predicate_type_ == PredicateType::InBloomFilter);
+
+  switch (other.predicate_type()) {
+    case PredicateType::None: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::Range: {
+      MergeBounds(other);
+      Simplify();
+      return;
+    };
+    case PredicateType::Equality: {
+      if (CheckValueInBloomFilterPredicate(other.lower_)) {
+        predicate_type_ = PredicateType::Equality;
+        lower_ = other.lower_;
+        upper_ = nullptr;
+        bloom_filters_.clear();
+      } else {
+        SetToNone();
+      }
+      return;
+    };
+    case PredicateType::IsNotNull: return;
+    case PredicateType::InList: {
+      // The IN list is more selective, so retain only its values which may
+      // pass this predicate.
+      values_ = other.values_;
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [this] (const void* v) {
+                                     return !CheckValueInBloomFilterPredicate(v);
+                                   }), values_.end());
+      predicate_type_ = PredicateType::InList;
+      lower_ = nullptr;
+      upper_ = nullptr;
+      bloom_filters_.clear();
+      Simplify();
+      return;
+    };
+    case PredicateType::InBloomFilter: {
+      MergeBounds(other);
+      bloom_filters_.insert(bloom_filters_.end(),
+                            other.bloom_filters_.begin(), other.bloom_filters_.end());
+      Simplify();
+      return;
+    };
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
+void ColumnPredicate::BuildInListIndex() {
+  if (predicate_type_ != PredicateType::InList || !FLAGS_in_list_predicate_index) {
+    return;
+  }
+  in_list_index_ = std::make_shared<const InListIndex>(column_.type_info(), values_);
+}
+
 namespace {
 template <typename P>
 void ApplyPredicate(const ColumnBlock& block, SelectionVector* sel, P p) {
-  if (block.is_nullable()) {
-    for (size_t i = 0; i < block.nrows(); i++) {
-      if (!sel->IsRowSelected(i)) continue;
-      const void* cell = block.nullable_cell_ptr(i);
-      if (cell == nullptr || !p(cell)) {
-        BitmapClear(sel->mutable_bitmap(), i);
-      }
+  // Blocks of sparse columns are often entirely null or entirely non-null,
+  // in which case the null bitmap needn't be consulted for every cell.
+  if (block.is_nullable() && block.nrows() > 0) {
+    if (BitmapIsAllZero(block.null_bitmap(), 0, block.nrows())) {
+      BitmapChangeBits(sel->mutable_bitmap(), 0, block.nrows(), false);
+      return;
     }
-  } else {
-    for (size_t i = 0; i < block.nrows(); i++) {
-      if (!sel->IsRowSelected(i)) continue;
-      const void* cell = block.cell_ptr(i);
-      if (!p(cell)) {
-        BitmapClear(sel->mutable_bitmap(), i);
+    if (!BitMapIsAllSet(block.null_bitmap(), 0, block.nrows())) {
+      for (size_t i = 0; i < block.nrows(); i++) {
+        if (!sel->IsRowSelected(i)) continue;
+        const void* cell = block.nullable_cell_ptr(i);
+        if (cell == nullptr || !p(cell)) {
+          BitmapClear(sel->mutable_bitmap(), i);
+        }
       }
+      return;
+    }
+  }
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (!sel->IsRowSelected(i)) continue;
+    const void* cell = block.cell_ptr(i);
+    if (!p(cell)) {
+      BitmapClear(sel->mutable_bitmap(), i);
     }
   }
 }
@@ -496,16 +632,28 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
     };
     case PredicateType::IsNotNull: {
       if (!block.is_nullable()) return;
-      // TODO: make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
-        if (sel->IsRowSelected(i) && block.is_null(i)) {
-          BitmapClear(sel->mutable_bitmap(), i);
+      // The non-null bits of the block select the rows, a byte at a time.
+      uint8_t* sel_bitmap = sel->mutable_bitmap();
+      const uint8_t* non_null = block.null_bitmap();
+      const size_t full_bytes = block.nrows() / 8;
+      for (size_t i = 0; i < full_bytes; i++) {
+        sel_bitmap[i] &= non_null[i];
+      }
+      for (size_t i = full_bytes * 8; i < block.nrows(); i++) {
+        if (!BitmapTest(non_null, i)) {
+          BitmapClear(sel_bitmap, i);
         }
       }
       return;
     };
     case PredicateType::InList: {
+      if (in_list_index_) {
+        const InListIndex* index = in_list_index_.get();
+        ApplyPredicate(block, sel, [index] (const void* cell) {
+          return index->Contains<PhysicalType>(cell);
+        });
+        return;
+      }
       ApplyPredicate(block, sel, [this] (const void* cell) {
         return std::binary_search(values_.begin(), values_.end(), cell,
                                   [] (const void* lhs, const void* rhs) {
@@ -514,6 +662,12 @@ void ColumnPredicate::EvaluateForPhysicalType(const ColumnBlock& block,
       });
       return;
     };
+    case PredicateType::InBloomFilter: {
+      ApplyPredicate(block, sel, [this] (const void* cell) {
+        return this->EvaluateCell<PhysicalType>(cell);
+      });
+      return;
+    };
     case PredicateType::None: LOG(FATAL) << "NONE predicate evaluation";
   }
   LOG(FATAL) << "unknown predicate type";
@@ -538,6 +692,33 @@ void ColumnPredicate::Evaluate(const ColumnBlock& block, SelectionVector* sel) c
   }
 }
 
+bool ColumnPredicate::MayMatchRange(const void* min, const void* max) const {
+  const TypeInfo* type_info = column_.type_info();
+  DCHECK_LE(type_info->Compare(min, max), 0);
+  switch (predicate_type()) {
+    case PredicateType::None: return false;
+    case PredicateType::Range:
+    case PredicateType::InBloomFilter: {
+      return (lower_ == nullptr || type_info->Compare(max, lower_) >= 0) &&
+             (upper_ == nullptr || type_info->Compare(min, upper_) < 0);
+    };
+    case PredicateType::Equality: {
+      return type_info->Compare(min, lower_) <= 0 &&
+             type_info->Compare(max, lower_) >= 0;
+    };
+    case PredicateType::IsNotNull: return true;
+    case PredicateType::InList: {
+      // The values are sorted, so check the smallest value not less than 'min'.
+      auto it = std::lower_bound(values_.begin(), values_.end(), min,
+                                 [type_info](const void* lhs, const void* rhs) {
+                                   return type_info->Compare(lhs, rhs) < 0;
+                                 });
+      return it != values_.end() && type_info->Compare(*it, max) <= 0;
+    };
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
 string ColumnPredicate::ToString() const {
   switch (predicate_type()) {
     case PredicateType::None: return strings::Substitute("`$0` NONE", column_.name());
@@ -575,6 +756,19 @@ string ColumnPredicate::ToString() const {
       ss.append(")");
       return ss;
     };
+    case PredicateType::InBloomFilter: {
+      string ss = strings::Substitute("`$0` IN $1 BLOOM FILTER(S)",
+                                      column_.name(), bloom_filters_.size());
+      if (lower_ != nullptr) {
+        ss.append(strings::Substitute(" AND `$0` >= $1",
+                                      column_.name(), column_.Stringify(lower_)));
+      }
+      if (upper_ != nullptr) {
+        ss.append(strings::Substitute(" AND `$0` < $1",
+                                      column_.name(), column_.Stringify(upper_)));
+      }
+      return ss;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -586,6 +780,18 @@ bool ColumnPredicate::operator==(const ColumnPredicate& other) const {
   }
   switch (predicate_type_) {
     case PredicateType::Equality: return column_.type_info()->Compare(lower_, other.lower_) == 0;
+    case PredicateType::InBloomFilter: {
+      if (bloom_filters_.size() != other.bloom_filters_.size()) return false;
+      for (int i = 0; i < bloom_filters_.size(); i++) {
+        const BloomFilter* a = bloom_filters_[i];
+        const BloomFilter* b = other.bloom_filters_[i];
+        if (a->layout() != b->layout() || a->n_hashes() != b->n_hashes() ||
+            a->data() != b->data()) {
+          return false;
+        }
+      }
+      // Fall through to compare the bounds.
+    };
     case PredicateType::Range: {
       return (lower_ == other.lower_ ||
               (lower_ != nullptr && other.lower_ != nullptr &&
@@ -613,6 +819,20 @@ bool ColumnPredicate::CheckValueInRange(const void* value) const {
           (upper_ == nullptr || column_.type_info()->Compare(upper_, value) > 0));
 }
 
+bool ColumnPredicate::CheckValueInBloomFilterPredicate(const void* value) const {
+  CHECK(predicate_type_ == PredicateType::InBloomFilter);
+  const TypeInfo* type_info = column_.type_info();
+  if ((lower_ != nullptr && type_info->Compare(lower_, value) > 0) ||
+      (upper_ != nullptr && type_info->Compare(upper_, value) <= 0)) {
+    return false;
+  }
+  if (type_info->physical_type() == BINARY) {
+    return CheckValueInBloomFilters(*reinterpret_cast<const Slice*>(value));
+  }
+  return CheckValueInBloomFilters(Slice(reinterpret_cast<const uint8_t*>(value),
+                                        type_info->size()));
+}
+
 bool ColumnPredicate::CheckValueInList(const void* value) const {
   return std::binary_search(values_.begin(), values_.end(), value,
                             [this](const void* lhs, const void* rhs) {
@@ -627,8 +847,9 @@ int SelectivityRank(const ColumnPredicate& predicate) {
     case PredicateType::None: rank = 0; break;
     case PredicateType::Equality: rank = 1; break;
     case PredicateType::InList: rank = 2; break;
-    case PredicateType::Range: rank = 3; break;
-    case PredicateType::IsNotNull: rank = 4; break;
+    case PredicateType::InBloomFilter: rank = 3; break;
+    case PredicateType::Range: rank = 4; break;
+    case PredicateType::IsNotNull: rank = 5; break;
     default: LOG(FATAL) << "unknown predicate type";
   }
   return rank * (kLargestTypeSize + 1) + predicate.column().type_info()->size();
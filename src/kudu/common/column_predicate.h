@@ -18,10 +18,14 @@
 #pragma once
 
 #include <boost/optional.hpp>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "kudu/common/in_list_index.h"
 #include "kudu/common/schema.h"
+#include "kudu/util/bloom_filter.h"
+#include "kudu/util/slice.h"
 
 namespace kudu {
 
@@ -49,6 +53,12 @@ enum class PredicateType {
   // A predicate which evaluates to true if the column value is present in
   // a value list.
   InList,
+
+  // A predicate which evaluates to true if the column value may be present
+  // in each of a set of bloom filters, and falls within an optional range.
+  // Used for semi-join (runtime filter) pushdown, where the filters are built
+  // from the join keys of the other side of a join.
+  InBloomFilter,
 };
 
 // A predicate which can be evaluated over a block of column values.
@@ -118,6 +128,20 @@ class ColumnPredicate {
   // The InList will be simplified into an Equality, Range or None if possible.
   static ColumnPredicate InList(ColumnSchema column, std::vector<const void*>* values);
 
+  // Create a new IN BLOOM FILTER predicate for the column.
+  //
+  // The keys of the filters are the cell values, encoded like the bounds of
+  // ColumnPredicatePB: the raw bytes of STRING and BINARY values, and the
+  // little-endian in-memory representation of other types.
+  //
+  // The filters are not copied, and must outlive the returned predicate.
+  // Either bound may be a nullptr, like for Range. The predicate will be
+  // simplified into a None if the range is empty.
+  static ColumnPredicate InBloomFilter(ColumnSchema column,
+                                       std::vector<const BloomFilter*> bloom_filters,
+                                       const void* lower,
+                                       const void* upper);
+
   // Returns the type of this predicate.
   PredicateType predicate_type() const {
     return predicate_type_;
@@ -134,6 +158,12 @@ class ColumnPredicate {
   // outlive the merged predicate.
   void Merge(const ColumnPredicate& other);
 
+  // If this is an InList predicate and --in_list_predicate_index is set,
+  // builds an index of its values, which is used in place of a binary
+  // search by all the evaluations of this predicate and of its copies. The
+  // index is dropped by any merge.
+  void BuildInListIndex();
+
   // Evaluate the predicate on every row in the column block.
   //
   // This is evaluated as an 'AND' with the current contents of *sel:
@@ -149,6 +179,12 @@ class ColumnPredicate {
   // same vector as block->selection_vector().
   void Evaluate(const ColumnBlock& block, SelectionVector* sel) const;
 
+  // Returns false if no non-null value in the inclusive range ['min', 'max']
+  // can satisfy the predicate, for example when checking a block of cells
+  // against its min/max summary. A return value of true means some value in
+  // the range may match.
+  bool MayMatchRange(const void* min, const void* max) const;
+
   // Evaluate the predicate on a single cell.
   template <DataType PhysicalType>
   bool EvaluateCell(const void* cell) const {
@@ -173,15 +209,46 @@ class ColumnPredicate {
         return true;
       };
       case PredicateType::InList: {
+        if (in_list_index_) {
+          return in_list_index_->Contains<PhysicalType>(cell);
+        }
         return std::binary_search(values_.begin(), values_.end(), cell,
                                   [] (const void* lhs, const void* rhs) {
                                     return DataTypeTraits<PhysicalType>::Compare(lhs, rhs) < 0;
                                   });
       };
+      case PredicateType::InBloomFilter: {
+        if (lower_ != nullptr && DataTypeTraits<PhysicalType>::Compare(cell, lower_) < 0) {
+          return false;
+        }
+        if (upper_ != nullptr && DataTypeTraits<PhysicalType>::Compare(cell, upper_) >= 0) {
+          return false;
+        }
+        return CheckValueInBloomFilters(BloomFilterKey<PhysicalType>(cell));
+      };
     }
     LOG(FATAL) << "unknown predicate type";
   }
 
+  // Returns the bloom filter key of a cell of type 'PhysicalType'.
+  template <DataType PhysicalType>
+  static Slice BloomFilterKey(const void* cell) {
+    if (PhysicalType == BINARY) {
+      return *reinterpret_cast<const Slice*>(cell);
+    }
+    return Slice(reinterpret_cast<const uint8_t*>(cell), DataTypeTraits<PhysicalType>::size);
+  }
+
+  // Returns true if 'key' may be present in every bloom filter of this
+  // InBloomFilter predicate.
+  bool CheckValueInBloomFilters(const Slice& key) const {
+    BloomKeyProbe probe(key);
+    for (const BloomFilter* filter : bloom_filters_) {
+      if (!filter->MayContainKey(probe)) return false;
+    }
+    return true;
+  }
+
   // Print the predicate for debugging.
   std::string ToString() const;
 
@@ -190,13 +257,13 @@ class ColumnPredicate {
   // Predicates over different columns are not equal.
   bool operator==(const ColumnPredicate& other) const;
 
-  // Returns the raw lower bound value if this is a range predicate, or the
-  // equality value if this is an equality predicate.
+  // Returns the raw lower bound value if this is a range or bloom filter
+  // predicate, or the equality value if this is an equality predicate.
   const void* raw_lower() const {
     return lower_;
   }
 
-  // Returns the raw upper bound if this is a range predicate.
+  // Returns the raw upper bound if this is a range or bloom filter predicate.
   const void* raw_upper() const {
     return upper_;
   }
@@ -212,6 +279,17 @@ class ColumnPredicate {
     return values_;
   }
 
+  // Returns the index of the values if this is an in-list predicate whose
+  // values were indexed by BuildInListIndex(), or NULL.
+  const InListIndex* in_list_index() const {
+    return in_list_index_.get();
+  }
+
+  // Returns the bloom filters if this is a bloom filter predicate.
+  const std::vector<const BloomFilter*>& bloom_filters() const {
+    return bloom_filters_;
+  }
+
  private:
 
   friend class TestColumnPredicate;
@@ -251,6 +329,13 @@ class ColumnPredicate {
   // Merge another predicate into this InList predicate.
   void MergeIntoInList(const ColumnPredicate& other);
 
+  // Merge another predicate into this InBloomFilter predicate.
+  void MergeIntoBloomFilter(const ColumnPredicate& other);
+
+  // Narrows the range bounds of this predicate to those of 'other', which
+  // must be a Range or InBloomFilter predicate.
+  void MergeBounds(const ColumnPredicate& other);
+
   // For a Range type predicate, this helper function checks
   // whether a given value is in the range.
   bool CheckValueInRange(const void* value) const;
@@ -259,21 +344,33 @@ class ColumnPredicate {
   // whether a given value is in the list.
   bool CheckValueInList(const void* value) const;
 
+  // For an InBloomFilter type predicate, this helper function checks
+  // whether a given value is in the range and may be in the filters.
+  bool CheckValueInBloomFilterPredicate(const void* value) const;
+
   // The type of this predicate.
   PredicateType predicate_type_;
 
   // The data type of the column. TypeInfo instances have a static lifetime.
   ColumnSchema column_;
 
-  // The inclusive lower bound value if this is a Range predicate, or the
-  // equality value if this is an Equality predicate.
+  // The inclusive lower bound value if this is a Range or InBloomFilter
+  // predicate, or the equality value if this is an Equality predicate.
   const void* lower_;
 
-  // The exclusive upper bound value if this is a Range predicate.
+  // The exclusive upper bound value if this is a Range or InBloomFilter
+  // predicate.
   const void* upper_;
 
   // The list of values to check column against if this is an InList predicate.
   std::vector<const void*> values_;
+
+  // The index of 'values_', if built. Shared by the copies of the predicate.
+  std::shared_ptr<const InListIndex> in_list_index_;
+
+  // The filters which the column value must pass if this is an InBloomFilter
+  // predicate.
+  std::vector<const BloomFilter*> bloom_filters_;
 };
 
 // Compares predicates according to selectivity. Predicates that match fewer
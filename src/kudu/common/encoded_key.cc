@@ -41,6 +41,15 @@ EncodedKey::EncodedKey(faststring* data,
   raw_keys_.swap(*raw_keys);
 }
 
+EncodedKey::EncodedKey(const Slice& encoded_key,
+                       vector<const void *> *raw_keys,
+                       size_t num_key_cols)
+  : num_key_cols_(num_key_cols),
+    encoded_key_(encoded_key) {
+  DCHECK_LE(raw_keys->size(), num_key_cols);
+  raw_keys_.swap(*raw_keys);
+}
+
 gscoped_ptr<EncodedKey> EncodedKey::FromContiguousRow(const ConstContiguousRow& row) {
   EncodedKeyBuilder kb(row.schema());
   for (int i = 0; i < row.schema()->num_key_columns(); i++) {
@@ -39,6 +39,14 @@ class EncodedKey {
              vector<const void *> *raw_keys,
              size_t num_key_cols);
 
+  // Constructs a new EncodedKey which refers to 'encoded_key' rather than
+  // owning a copy of it, e.g. one of the keys encoded by
+  // Schema::EncodeComparableKeys(). The data of 'encoded_key' must outlive
+  // the EncodedKey.
+  EncodedKey(const Slice& encoded_key,
+             vector<const void *> *raw_keys,
+             size_t num_key_cols);
+
   static gscoped_ptr<EncodedKey> FromContiguousRow(const ConstContiguousRow& row);
 
   // Decode the encoded key specified in 'encoded', which must correspond to the
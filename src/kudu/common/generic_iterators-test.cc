@@ -16,6 +16,7 @@
 // under the License.
 
 #include <algorithm>
+#include <deque>
 #include <glog/logging.h>
 #include <glog/stl_logging.h>
 #include <gtest/gtest.h>
@@ -23,12 +24,14 @@
 
 #include "kudu/common/iterator.h"
 #include "kudu/common/generic_iterators.h"
+#include "kudu/common/row.h"
 #include "kudu/common/column_materialization_context.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/mathlimits.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
@@ -50,7 +53,8 @@ class VectorIterator : public ColumnwiseIterator {
   explicit VectorIterator(vector<uint32_t> ints)
       : ints_(std::move(ints)),
         cur_idx_(0),
-        block_size_(ints_.size()) {
+        block_size_(ints_.size()),
+        initted_(nullptr) {
   }
 
   // Set the number of rows that will be returned in each
@@ -59,7 +63,15 @@ class VectorIterator : public ColumnwiseIterator {
     block_size_ = block_size;
   }
 
+  // Set a flag to raise when the iterator is initialized.
+  void set_initted_flag(bool* initted) {
+    initted_ = initted;
+  }
+
   Status Init(ScanSpec *spec) OVERRIDE {
+    if (initted_ != nullptr) {
+      *initted_ = true;
+    }
     return Status::OK();
   }
 
@@ -115,6 +127,7 @@ class VectorIterator : public ColumnwiseIterator {
   int cur_idx_;
   int block_size_;
   size_t prepared_;
+  bool* initted_;
 };
 
 // Test that empty input to a merger behaves correctly.
@@ -133,6 +146,79 @@ TEST(TestMergeIterator, TestMergeEmpty) {
 }
 
 
+static string EncodeIntKey(uint32_t val) {
+  faststring buf;
+  ConstContiguousRow row(&kIntSchema, reinterpret_cast<const uint8_t*>(&val));
+  return kIntSchema.EncodeComparableKey(row, &buf).ToString();
+}
+
+// Test that sub-iterators with key bounds are only initialized once the
+// merge reaches their min keys, and that the merge still yields every row
+// in order when the bounded ranges overlap each other and unbounded inputs.
+TEST(TestMergeIterator, TestMergeWithBounds) {
+  const int kNumLists = 10;
+  const int kRowsPerList = 100;
+  std::deque<bool> initted(kNumLists, false);
+  vector<IterWithBounds> to_merge;
+  vector<uint32_t> expected;
+
+  // List i holds [i * 80, i * 80 + 100), so that neighbouring lists overlap.
+  for (int i = 0; i < kNumLists; i++) {
+    vector<uint32_t> ints;
+    for (int j = 0; j < kRowsPerList; j++) {
+      ints.push_back(i * 80 + j);
+    }
+    expected.insert(expected.end(), ints.begin(), ints.end());
+    shared_ptr<VectorIterator> it(new VectorIterator(ints));
+    it->set_block_size(10);
+    it->set_initted_flag(&initted[i]);
+    IterWithBounds iter;
+    iter.iter.reset(new MaterializingIterator(it));
+    iter.encoded_min_key = EncodeIntKey(ints.front());
+    iter.encoded_max_key = EncodeIntKey(ints.back());
+    to_merge.push_back(std::move(iter));
+  }
+  // One unbounded list spans all of the others.
+  vector<uint32_t> sparse = { 5, 505, 1005 };
+  expected.insert(expected.end(), sparse.begin(), sparse.end());
+  IterWithBounds unbounded;
+  unbounded.iter.reset(new MaterializingIterator(
+      shared_ptr<ColumnwiseIterator>(new VectorIterator(sparse))));
+  to_merge.push_back(std::move(unbounded));
+  std::sort(expected.begin(), expected.end());
+
+  // Merge in reverse order of the lists, to check the pending lists are
+  // ordered by their min keys.
+  std::reverse(to_merge.begin(), to_merge.end());
+  MergeIterator merger(kIntSchema, std::move(to_merge));
+  ASSERT_OK(merger.Init(nullptr));
+  ASSERT_TRUE(initted[0]);
+  ASSERT_FALSE(initted[1]);
+
+  RowBlock dst(kIntSchema, 50, nullptr);
+  size_t total_idx = 0;
+  while (merger.HasNext()) {
+    ASSERT_OK(merger.NextBlock(&dst));
+    ASSERT_GT(dst.nrows(), 0) << "if HasNext() returns true, must return some rows";
+    for (int i = 0; i < dst.nrows(); i++) {
+      uint32_t this_row = *kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0);
+      ASSERT_LT(total_idx, expected.size());
+      ASSERT_EQ(expected[total_idx], this_row) << "Yielded out of order at idx " << total_idx;
+      total_idx++;
+    }
+    // A list is only initialized once the merge has reached its min key.
+    for (int i = 0; i < kNumLists; i++) {
+      if (initted[i]) {
+        ASSERT_GE(expected[total_idx - 1] + 1, i * 80) << "list " << i << " initialized early";
+      }
+    }
+  }
+  ASSERT_EQ(expected.size(), total_idx);
+  for (int i = 0; i < kNumLists; i++) {
+    ASSERT_TRUE(initted[i]);
+  }
+}
+
 class TestIntRangePredicate {
  public:
   TestIntRangePredicate(uint32_t lower, uint32_t upper) :
@@ -49,6 +49,18 @@ DEFINE_bool(materializing_iterator_decoder_eval, true,
             "Should MaterializingIterator do decoder-level evaluation");
 TAG_FLAG(materializing_iterator_decoder_eval, hidden);
 TAG_FLAG(materializing_iterator_decoder_eval, runtime);
+DEFINE_bool(materializing_iterator_skip_deselected_blocks, false,
+            "Whether MaterializingIterator lets columns skip reading and decoding "
+            "the data blocks whose rows were all filtered out by the predicates "
+            "evaluated before them");
+TAG_FLAG(materializing_iterator_skip_deselected_blocks, experimental);
+TAG_FLAG(materializing_iterator_skip_deselected_blocks, runtime);
+DEFINE_bool(materializing_iterator_adaptive_predicate_order, false,
+            "Whether MaterializingIterator periodically reorders its predicates "
+            "so that those which filtered out the most rows so far are evaluated "
+            "first");
+TAG_FLAG(materializing_iterator_adaptive_predicate_order, experimental);
+TAG_FLAG(materializing_iterator_adaptive_predicate_order, runtime);
 
 namespace kudu {
 
@@ -64,8 +76,15 @@ static const int kMergeRowBuffer = 1000;
 // such that all returned rows are valid.
 class MergeIterState {
  public:
-  explicit MergeIterState(const shared_ptr<RowwiseIterator> &iter) :
+  // If 'max_key' is non-null, it is the decoded key, in 'key_schema', of the
+  // last row 'iter' may yield.
+  MergeIterState(const shared_ptr<RowwiseIterator> &iter,
+                 const Schema* key_schema,
+                 const uint8_t* max_key) :
     iter_(iter),
+    key_schema_(key_schema),
+    max_key_(max_key),
+    passed_max_key_(false),
     arena_(1024, 256*1024),
     read_block_(iter->schema(), kMergeRowBuffer, &arena_),
     next_row_idx_(0),
@@ -73,7 +92,7 @@ class MergeIterState {
     num_valid_(0)
   {}
 
-  const RowBlockRow& next_row() {
+  const RowBlockRow& next_row() const {
     DCHECK_LT(num_advanced_, num_valid_);
     return next_row_;
   }
@@ -81,6 +100,15 @@ class MergeIterState {
   Status Advance() {
     num_advanced_++;
     if (IsBlockExhausted()) {
+      // If the last row of the block was the max key, there are no more rows
+      // to yield, so skip reading the rest of the iterator.
+      if (max_key_ != nullptr &&
+          key_schema_->Compare(next_row_, ConstContiguousRow(key_schema_, max_key_)) >= 0) {
+        passed_max_key_ = true;
+        num_advanced_ = 0;
+        num_valid_ = 0;
+        return Status::OK();
+      }
       arena_.Reset();
       return PullNextBlock();
     } else {
@@ -102,7 +130,7 @@ class MergeIterState {
   }
 
   bool IsFullyExhausted() const {
-    return num_valid_ == 0 && !iter_->HasNext();
+    return num_valid_ == 0 && (passed_max_key_ || !iter_->HasNext());
   }
 
   Status PullNextBlock() {
@@ -144,6 +172,10 @@ class MergeIterState {
   }
 
   shared_ptr<RowwiseIterator> iter_;
+  const Schema* key_schema_;
+  const uint8_t* max_key_;
+  // Whether the iterator has yielded its max key.
+  bool passed_max_key_;
   Arena arena_;
   RowBlock read_block_;
   // The row currently pointed to by the iterator.
@@ -156,37 +188,68 @@ class MergeIterState {
   size_t num_valid_;
 };
 
+namespace {
+
+// Orders the heap of MergeIterStates so that the one with the smallest next
+// row is at the front.
+struct MergeIterStateGreater {
+  MergeIterStateGreater(const Schema* schema, const RowComparator* comparator)
+    : schema(schema),
+      comparator(comparator) {
+  }
+
+  bool operator()(const unique_ptr<MergeIterState>& a,
+                  const unique_ptr<MergeIterState>& b) const {
+    if (comparator != nullptr) {
+      return comparator->Compare(a->next_row(), b->next_row()) > 0;
+    }
+    return schema->Compare(a->next_row(), b->next_row()) > 0;
+  }
+
+  const Schema* schema;
+  // May be null.
+  const RowComparator* comparator;
+};
+
+vector<IterWithBounds> WithoutBounds(const vector<shared_ptr<RowwiseIterator> >& iters) {
+  vector<IterWithBounds> ret(iters.size());
+  for (size_t i = 0; i < iters.size(); i++) {
+    ret[i].iter = iters[i];
+  }
+  return ret;
+}
+
+} // anonymous namespace
 
 MergeIterator::MergeIterator(
   const Schema &schema,
   const vector<shared_ptr<RowwiseIterator> > &iters)
+  : MergeIterator(schema, WithoutBounds(iters)) {
+}
+
+MergeIterator::MergeIterator(const Schema &schema, vector<IterWithBounds> iters)
   : schema_(schema),
-    initted_(false) {
-  CHECK_GT(iters.size(), 0);
+    key_schema_(schema.CreateKeyProjection()),
+    initted_(false),
+    orig_iters_(std::move(iters)),
+    key_arena_(new Arena(1024, 1024 * 1024)) {
+  CHECK_GT(orig_iters_.size(), 0);
   CHECK_GT(schema.num_key_columns(), 0);
-  orig_iters_.assign(iters.begin(), iters.end());
 }
 
 MergeIterator::~MergeIterator() {}
 
+void MergeIterator::SetRowComparator(unique_ptr<RowComparator> comparator) {
+  CHECK(!initted_);
+  comparator_ = std::move(comparator);
+}
+
 Status MergeIterator::Init(ScanSpec *spec) {
   CHECK(!initted_);
   // TODO: check that schemas match up!
 
   RETURN_NOT_OK(InitSubIterators(spec));
-
-  for (unique_ptr<MergeIterState> &state : iters_) {
-    RETURN_NOT_OK(state->PullNextBlock());
-  }
-
-  // Before we copy any rows, clean up any iterators which were empty
-  // to start with. Otherwise, HasNext() won't properly return false
-  // if we were passed only empty iterators.
-  iters_.erase(
-      remove_if(iters_.begin(), iters_.end(), [] (const unique_ptr<MergeIterState>& iter) {
-        return PREDICT_FALSE(iter->IsFullyExhausted());
-      }),
-      iters_.end());
+  RETURN_NOT_OK(InitPendingSubIterators());
 
   initted_ = true;
   return Status::OK();
@@ -198,12 +261,37 @@ bool MergeIterator::HasNext() const {
 }
 
 Status MergeIterator::InitSubIterators(ScanSpec *spec) {
-  // Initialize all the sub iterators.
-  for (shared_ptr<RowwiseIterator> &iter : orig_iters_) {
-    ScanSpec *spec_copy = spec != nullptr ? scan_spec_copies_.Construct(*spec) : nullptr;
-    RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&iter, spec_copy));
-    iters_.push_back(unique_ptr<MergeIterState>(new MergeIterState(iter)));
+  iter_initted_.assign(orig_iters_.size(), false);
+  min_keys_.assign(orig_iters_.size(), nullptr);
+  max_keys_.assign(orig_iters_.size(), nullptr);
+  for (size_t i = 0; i < orig_iters_.size(); i++) {
+    iter_specs_.push_back(spec != nullptr ? scan_spec_copies_.Construct(*spec) : nullptr);
+
+    const IterWithBounds& iter = orig_iters_[i];
+    if (iter.encoded_min_key.empty() || iter.encoded_max_key.empty()) {
+      continue;
+    }
+    uint8_t* min_key = static_cast<uint8_t*>(key_arena_->AllocateBytes(
+        key_schema_.key_byte_size()));
+    uint8_t* max_key = static_cast<uint8_t*>(key_arena_->AllocateBytes(
+        key_schema_.key_byte_size()));
+    RETURN_NOT_OK(key_schema_.DecodeRowKey(iter.encoded_min_key, min_key, key_arena_.get()));
+    RETURN_NOT_OK(key_schema_.DecodeRowKey(iter.encoded_max_key, max_key, key_arena_.get()));
+    min_keys_[i] = min_key;
+    max_keys_[i] = max_key;
+    pending_iters_.push_back(i);
+  }
+
+  // Initialize the sub-iterators whose bounds are unknown right away. The
+  // others are initialized in increasing order of their min keys.
+  for (size_t i = 0; i < orig_iters_.size(); i++) {
+    if (min_keys_[i] == nullptr) {
+      RETURN_NOT_OK(InitSubIterator(i));
+    }
   }
+  sort(pending_iters_.begin(), pending_iters_.end(), [&](size_t a, size_t b) {
+    return orig_iters_[a].encoded_min_key > orig_iters_[b].encoded_min_key;
+  });
 
   // Since we handle predicates in all the wrapped iterators, we can clear
   // them here.
@@ -213,6 +301,40 @@ Status MergeIterator::InitSubIterators(ScanSpec *spec) {
   return Status::OK();
 }
 
+Status MergeIterator::InitSubIterator(size_t idx) {
+  DCHECK(!iter_initted_[idx]);
+  shared_ptr<RowwiseIterator>* iter = &orig_iters_[idx].iter;
+  RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(iter, iter_specs_[idx]));
+  iter_initted_[idx] = true;
+
+  unique_ptr<MergeIterState> state(new MergeIterState(*iter, &key_schema_, max_keys_[idx]));
+  RETURN_NOT_OK(state->PullNextBlock());
+
+  // Don't add iterators which are empty to start with. Otherwise, HasNext()
+  // won't properly return false if we were passed only empty iterators.
+  if (PREDICT_FALSE(state->IsFullyExhausted())) {
+    return Status::OK();
+  }
+  iters_.push_back(std::move(state));
+  std::push_heap(iters_.begin(), iters_.end(),
+                 MergeIterStateGreater(&schema_, comparator_.get()));
+  return Status::OK();
+}
+
+Status MergeIterator::InitPendingSubIterators() {
+  while (!pending_iters_.empty()) {
+    size_t idx = pending_iters_.back();
+    if (!iters_.empty() &&
+        schema_.Compare(iters_.front()->next_row(),
+                        ConstContiguousRow(&key_schema_, min_keys_[idx])) < 0) {
+      break;
+    }
+    pending_iters_.pop_back();
+    RETURN_NOT_OK(InitSubIterator(idx));
+  }
+  return Status::OK();
+}
+
 Status MergeIterator::NextBlock(RowBlock* dst) {
   CHECK(initted_);
   DCHECK_SCHEMA_EQ(dst->schema(), schema());
@@ -238,44 +360,46 @@ void MergeIterator::PrepareBatch(RowBlock* dst) {
   dst->Resize(std::min(dst->row_capacity(), available));
 }
 
-// TODO: this is an obvious spot to add codegen - there's a ton of branching
-// and such around the comparisons. A simple experiment indicated there's some
-// 2x to be gained.
 Status MergeIterator::MaterializeBlock(RowBlock *dst) {
   // Initialize the selection vector.
   // MergeIterState only returns selected rows.
   dst->selection_vector()->SetAllTrue();
+  MergeIterStateGreater greater(&schema_, comparator_.get());
   for (size_t dst_row_idx = 0; dst_row_idx < dst->nrows(); dst_row_idx++) {
     RowBlockRow dst_row = dst->row(dst_row_idx);
 
-    // Find the sub-iterator which is currently smallest
-    MergeIterState *smallest = nullptr;
-    ssize_t smallest_idx = -1;
-
-    // Typically the number of iters_ is not that large, so using a priority
-    // queue is not worth it
-    for (size_t i = 0; i < iters_.size(); i++) {
-      unique_ptr<MergeIterState> &state = iters_[i];
-
-      if (smallest == nullptr ||
-          schema_.Compare(state->next_row(), smallest->next_row()) < 0) {
-        smallest = state.get();
-        smallest_idx = i;
-      }
+    // Any sub-iterator which may yield the next row must be in the heap.
+    if (!pending_iters_.empty()) {
+      RETURN_NOT_OK(InitPendingSubIterators());
     }
 
     // If no iterators had any row left, then we're done iterating.
-    if (PREDICT_FALSE(smallest == nullptr)) break;
+    if (PREDICT_FALSE(iters_.empty())) {
+      dst->Resize(dst_row_idx);
+      break;
+    }
 
     // Otherwise, copy the row from the smallest one, and advance it
-    RETURN_NOT_OK(CopyRow(smallest->next_row(), &dst_row, dst->arena()));
+    std::pop_heap(iters_.begin(), iters_.end(), greater);
+    MergeIterState* smallest = iters_.back().get();
+    if (comparator_) {
+      RETURN_NOT_OK(comparator_->CopyRow(smallest->next_row(), &dst_row, dst->arena()));
+    } else {
+      RETURN_NOT_OK(CopyRow(smallest->next_row(), &dst_row, dst->arena()));
+    }
     RETURN_NOT_OK(smallest->Advance());
 
     if (smallest->IsFullyExhausted()) {
-      iters_.erase(iters_.begin() + smallest_idx);
+      iters_.pop_back();
+    } else {
+      std::push_heap(iters_.begin(), iters_.end(), greater);
     }
   }
 
+  // Make sure HasNext() is only false once every sub-iterator is done.
+  if (iters_.empty() && !pending_iters_.empty()) {
+    RETURN_NOT_OK(InitPendingSubIterators());
+  }
   return Status::OK();
 }
 
@@ -283,8 +407,8 @@ string MergeIterator::ToString() const {
   string s;
   s.append("Merge(");
   bool first = true;
-  for (const shared_ptr<RowwiseIterator> &iter : orig_iters_) {
-    s.append(iter->ToString());
+  for (const IterWithBounds &iter : orig_iters_) {
+    s.append(iter.iter->ToString());
     if (!first) {
       s.append(", ");
     }
@@ -302,9 +426,13 @@ const Schema& MergeIterator::schema() const {
 void MergeIterator::GetIteratorStats(vector<IteratorStats>* stats) const {
   CHECK(initted_);
   vector<vector<IteratorStats> > stats_by_iter;
-  for (const shared_ptr<RowwiseIterator>& iter : orig_iters_) {
+  for (size_t i = 0; i < orig_iters_.size(); i++) {
+    // Sub-iterators which were never initialized read nothing.
+    if (!iter_initted_[i]) {
+      continue;
+    }
     vector<IteratorStats> stats_for_iter;
-    iter->GetIteratorStats(&stats_for_iter);
+    orig_iters_[i].iter->GetIteratorStats(&stats_for_iter);
     stats_by_iter.push_back(stats_for_iter);
   }
   for (size_t idx = 0; idx < schema_.num_columns(); ++idx) {
@@ -440,10 +568,17 @@ void UnionIterator::GetIteratorStats(std::vector<IteratorStats>* stats) const {
 // Materializing iterator
 ////////////////////////////////////////////////////////////
 
+// The number of blocks after which MaterializingIterator reorders its
+// predicates, if adaptive ordering is enabled.
+static const int kPredicateReorderInterval = 16;
+
 MaterializingIterator::MaterializingIterator(shared_ptr<ColumnwiseIterator> iter)
     : iter_(move(iter)),
+      blocks_since_reorder_(0),
       disallow_pushdown_for_tests_(!FLAGS_materializing_iterator_do_pushdown),
-      disallow_decoder_eval_(!FLAGS_materializing_iterator_decoder_eval) {
+      disallow_decoder_eval_(!FLAGS_materializing_iterator_decoder_eval),
+      skip_deselected_blocks_(FLAGS_materializing_iterator_skip_deselected_blocks),
+      adapt_predicate_order_(FLAGS_materializing_iterator_adaptive_predicate_order) {
 }
 
 Status MaterializingIterator::Init(ScanSpec *spec) {
@@ -490,6 +625,13 @@ Status MaterializingIterator::Init(ScanSpec *spec) {
          return SelectivityComparator(get<1>(left), get<1>(right));
        });
 
+  predicate_order_.clear();
+  for (int i = 0; i < col_idx_predicates_.size(); i++) {
+    predicate_order_.push_back(i);
+  }
+  predicate_stats_.assign(col_idx_predicates_.size(), PredicateStats{0, 0});
+  blocks_since_reorder_ = 0;
+
   return Status::OK();
 }
 
@@ -516,7 +658,17 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
   // been deleted.
   RETURN_NOT_OK(iter_->InitializeSelectionVector(dst->selection_vector()));
 
-  for (const auto& col_pred : col_idx_predicates_) {
+  if (adapt_predicate_order_ && ++blocks_since_reorder_ >= kPredicateReorderInterval) {
+    ReorderPredicates();
+  }
+
+  for (int pred_idx : predicate_order_) {
+    const auto& col_pred = col_idx_predicates_[pred_idx];
+    int64_t rows_before = 0;
+    if (adapt_predicate_order_) {
+      rows_before = dst->selection_vector()->CountSelected();
+    }
+
     // Materialize the column itself into the row block.
     ColumnBlock dst_col(dst->column_block(get<0>(col_pred)));
     ColumnMaterializationContext ctx(get<0>(col_pred),
@@ -528,11 +680,20 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
     if (disallow_decoder_eval_) {
       ctx.SetDecoderEvalNotSupported();
     }
+    if (skip_deselected_blocks_) {
+      ctx.SetSkipDeselectedRows();
+    }
     RETURN_NOT_OK(iter_->MaterializeColumn(&ctx));
     if (ctx.DecoderEvalNotSupported()) {
       get<1>(col_pred).Evaluate(dst_col, dst->selection_vector());
     }
 
+    if (adapt_predicate_order_) {
+      PredicateStats* stats = &predicate_stats_[pred_idx];
+      stats->rows_evaluated += rows_before;
+      stats->rows_passed += dst->selection_vector()->CountSelected();
+    }
+
     // If after evaluating this predicate the entire row block has been filtered
     // out, we don't need to materialize other columns at all.
     if (!dst->selection_vector()->AnySelected()) {
@@ -548,6 +709,9 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
                                      nullptr,
                                      &dst_col,
                                      dst->selection_vector());
+    if (skip_deselected_blocks_) {
+      ctx.SetSkipDeselectedRows();
+    }
     RETURN_NOT_OK(iter_->MaterializeColumn(&ctx));
   }
 
@@ -556,6 +720,26 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
   return Status::OK();
 }
 
+void MaterializingIterator::ReorderPredicates() {
+  // Predicates which have not been evaluated since the last reordering are
+  // treated as passing every row, and the relative order of predicates with
+  // the same pass rate is kept.
+  auto pass_rate_less = [&](int left, int right) {
+    const PredicateStats& l = predicate_stats_[left];
+    const PredicateStats& r = predicate_stats_[right];
+    int64_t l_evaluated = l.rows_evaluated > 0 ? l.rows_evaluated : 1;
+    int64_t l_passed = l.rows_evaluated > 0 ? l.rows_passed : 1;
+    int64_t r_evaluated = r.rows_evaluated > 0 ? r.rows_evaluated : 1;
+    int64_t r_passed = r.rows_evaluated > 0 ? r.rows_passed : 1;
+    return l_passed * r_evaluated < r_passed * l_evaluated;
+  };
+  std::stable_sort(predicate_order_.begin(), predicate_order_.end(), pass_rate_less);
+  for (PredicateStats& stats : predicate_stats_) {
+    stats = PredicateStats{0, 0};
+  }
+  blocks_since_reorder_ = 0;
+}
+
 string MaterializingIterator::ToString() const {
   string s;
   s.append("Materializing(").append(iter_->ToString()).append(")");
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/row_comparator.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/util/object_pool.h"
 
@@ -34,8 +35,23 @@ namespace kudu {
 class Arena;
 class MergeIterState;
 
+// A sub-iterator of a MergeIterator, along with the encoded keys which
+// inclusively bound the rows it may yield. Both bounds are empty if they are
+// not known.
+struct IterWithBounds {
+  std::shared_ptr<RowwiseIterator> iter;
+  std::string encoded_min_key;
+  std::string encoded_max_key;
+};
+
 // An iterator which merges the results of other iterators, comparing
 // based on keys.
+//
+// The sub-iterators are kept in a heap ordered by their next rows. A
+// sub-iterator with known key bounds is not initialized until the merge
+// reaches its min key, and is dropped once it has yielded its max key, so
+// that ordered scans of many mostly-disjoint rowsets only keep a few of
+// them open at a time.
 class MergeIterator : public RowwiseIterator {
  public:
   // TODO: clarify whether schema is just the projection, or must include the merge
@@ -43,8 +59,17 @@ class MergeIterator : public RowwiseIterator {
   // a subset of the columns in 'iters'.
   MergeIterator(const Schema &schema,
                 const std::vector<std::shared_ptr<RowwiseIterator> > &iters);
+
+  // As above, but with the key bounds of the sub-iterators. The bounds must
+  // be encoded with the key columns of 'schema'.
+  MergeIterator(const Schema &schema, std::vector<IterWithBounds> iters);
   virtual ~MergeIterator();
 
+  // Compare and copy the rows of the sub-iterators with 'comparator', which
+  // must be for 'schema', rather than with Schema::Compare() and CopyRow().
+  // Must be called before Init().
+  void SetRowComparator(std::unique_ptr<RowComparator> comparator);
+
   // The passed-in iterators should be already initialized.
   Status Init(ScanSpec *spec) OVERRIDE;
 
@@ -63,13 +88,45 @@ class MergeIterator : public RowwiseIterator {
   Status MaterializeBlock(RowBlock* dst);
   Status InitSubIterators(ScanSpec *spec);
 
+  // Initialize orig_iters_[idx], pull its first block, and add it to the
+  // heap unless it is empty.
+  Status InitSubIterator(size_t idx);
+
+  // Initialize the pending sub-iterators whose min keys are no greater than
+  // the next row of the merge, or, if no sub-iterators remain in the heap,
+  // the pending sub-iterators up to the first non-empty one.
+  Status InitPendingSubIterators();
+
   const Schema schema_;
+  const Schema key_schema_;
+
+  // If set, compares and copies the rows of the sub-iterators.
+  std::unique_ptr<RowComparator> comparator_;
 
   bool initted_;
 
-  // Holds the subiterators until Init is called.
-  // This is required because we can't create a MergeIterState of an uninitialized iterator.
-  std::deque<std::shared_ptr<RowwiseIterator> > orig_iters_;
+  // The sub-iterators, as passed in. Their iterators are replaced with
+  // predicate-evaluating wrappers as they are initialized.
+  std::vector<IterWithBounds> orig_iters_;
+
+  // Whether each of orig_iters_ has been initialized.
+  std::vector<bool> iter_initted_;
+
+  // The scan spec copies the sub-iterators are initialized with.
+  std::vector<ScanSpec*> iter_specs_;
+
+  // The decoded min and max keys of each of orig_iters_, in key_arena_, or
+  // null if the sub-iterator's bounds are unknown.
+  std::vector<const uint8_t*> min_keys_;
+  std::vector<const uint8_t*> max_keys_;
+  std::unique_ptr<Arena> key_arena_;
+
+  // Indexes into orig_iters_ of the sub-iterators which have yet to be
+  // initialized, in decreasing order of their min keys.
+  std::vector<size_t> pending_iters_;
+
+  // The initialized sub-iterators which have more rows, as a min-heap on
+  // their next rows.
   std::vector<std::unique_ptr<MergeIterState> > iters_;
 
   // When the underlying iterators are initialized, each needs its own
@@ -165,17 +222,45 @@ class MaterializingIterator : public RowwiseIterator {
 
   Status MaterializeBlock(RowBlock *dst);
 
+  // Reorders 'predicate_order_' by the fraction of rows which passed each
+  // predicate since the last reordering, most selective first.
+  void ReorderPredicates();
+
+  // The rows seen by a predicate since the last reordering.
+  struct PredicateStats {
+    int64_t rows_evaluated;
+    int64_t rows_passed;
+  };
+
   std::shared_ptr<ColumnwiseIterator> iter_;
 
   // List of (column index, predicate) in order of most to least selective.
   std::vector<std::tuple<int32_t, ColumnPredicate>> col_idx_predicates_;
 
+  // The order in which the predicates are evaluated, as indexes into
+  // 'col_idx_predicates_'. Unless 'adapt_predicate_order_' is set, this is
+  // the order of 'col_idx_predicates_' itself.
+  std::vector<int> predicate_order_;
+
+  // Per-predicate statistics, parallel to 'col_idx_predicates_'. Only
+  // maintained if 'adapt_predicate_order_' is set.
+  std::vector<PredicateStats> predicate_stats_;
+  int blocks_since_reorder_;
+
   // List of column indexes without predicates to materialize.
   std::vector<int32_t> non_predicate_column_indexes_;
 
   // Set only by test code to disallow pushdown.
   bool disallow_pushdown_for_tests_;
   bool disallow_decoder_eval_;
+
+  // Whether columns may skip reading the data blocks whose rows were all
+  // deselected by the predicates evaluated before them.
+  const bool skip_deselected_blocks_;
+
+  // Whether to periodically reorder the predicates by their observed
+  // selectivity.
+  const bool adapt_predicate_order_;
 };
 
 // An iterator which wraps another iterator and evaluates any predicates that the
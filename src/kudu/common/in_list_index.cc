@@ -0,0 +1,78 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/in_list_index.h"
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/bits.h"
+
+using std::vector;
+
+namespace kudu {
+
+InListIndex::InListIndex(const TypeInfo* type_info, const vector<const void*>& values)
+    : num_values_(values.size()),
+      mask_(0),
+      shift_(0) {
+  CHECK(!values.empty());
+  const DataType type = type_info->physical_type();
+  const size_t size = type_info->size();
+
+  if (type == BINARY) {
+    slice_values_.reserve(values.size());
+    for (const void* value : values) {
+      slice_values_.push_back(*reinterpret_cast<const Slice*>(value));
+    }
+    BuildHashTable([this](int i) { return this->HashSlice(slice_values_[i]); });
+    return;
+  }
+
+  DCHECK_LE(size, sizeof(uint64_t));
+  if (type != FLOAT && type != DOUBLE && values.size() >= kMinValuesToHash) {
+    int_values_.resize(values.size(), 0);
+    for (int i = 0; i < values.size(); i++) {
+      memcpy(&int_values_[i], values[i], size);
+    }
+    BuildHashTable([this](int i) { return this->HashBits(int_values_[i]); });
+    return;
+  }
+
+  int_values_.resize((values.size() * size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+  uint8_t* dst = reinterpret_cast<uint8_t*>(int_values_.data());
+  for (const void* value : values) {
+    memcpy(dst, value, size);
+    dst += size;
+  }
+}
+
+template <typename HashFunc>
+void InListIndex::BuildHashTable(HashFunc hash) {
+  const int log_capacity = Bits::Log2Ceiling64(num_values_ * 2);
+  shift_ = 64 - log_capacity;
+  mask_ = (1ULL << log_capacity) - 1;
+  slots_.assign(mask_ + 1, -1);
+  for (int i = 0; i < num_values_; i++) {
+    size_t slot = hash(i);
+    while (slots_[slot] >= 0) {
+      slot = (slot + 1) & mask_;
+    }
+    slots_[slot] = i;
+  }
+}
+
+} // namespace kudu
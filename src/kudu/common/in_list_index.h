@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/hash_util.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+
+// An index of the values of an InList predicate, which checks whether a
+// cell is one of the values faster than a binary search over the pointers
+// to them.
+//
+// Short lists of fixed-size values are copied into a contiguous sorted
+// array, which is searched without branching on the comparisons. Longer
+// lists of integers, and lists of binary values, are kept in an
+// open-addressing hash table with linear probing. Floating point values
+// are never hashed, since values which compare equal, such as 0.0 and
+// -0.0, may differ in their bits.
+class InListIndex {
+ public:
+  // Lists of integers with at least this many values are hashed.
+  static const size_t kMinValuesToHash = 16;
+
+  // 'values' must be sorted and unique, and of the physical type of
+  // 'type_info'. Binary values are not copied, so must outlive the index.
+  InListIndex(const TypeInfo* type_info, const std::vector<const void*>& values);
+
+  // Returns true if 'cell', of type 'PhysicalType', is one of the values.
+  template <DataType PhysicalType>
+  bool Contains(const void* cell) const {
+    typedef typename DataTypeTraits<PhysicalType>::cpp_type CppType;
+    if (!slots_.empty()) {
+      uint64_t bits = 0;
+      memcpy(&bits, cell, sizeof(CppType));
+      for (size_t slot = HashBits(bits); ; slot = (slot + 1) & mask_) {
+        const int32_t idx = slots_[slot];
+        if (idx < 0) return false;
+        if (int_values_[idx] == bits) return true;
+      }
+    }
+
+    // Branch-free lower bound: the comparison only selects the next base,
+    // which compiles to a conditional move.
+    const CppType v = *reinterpret_cast<const CppType*>(cell);
+    const CppType* base = reinterpret_cast<const CppType*>(int_values_.data());
+    size_t n = num_values_;
+    while (n > 1) {
+      const size_t half = n / 2;
+      base = (base[half] < v) ? base + half : base;
+      n -= half;
+    }
+    base += (*base < v);
+    return base < reinterpret_cast<const CppType*>(int_values_.data()) + num_values_ &&
+           !(v < *base);
+  }
+
+ private:
+  size_t HashBits(uint64_t bits) const {
+    // Fibonacci hashing: the high bits of the product are well mixed.
+    return (bits * 0x9E3779B97F4A7C15ULL) >> shift_;
+  }
+
+  size_t HashSlice(const Slice& s) const {
+    return HashUtil::MurmurHash2_64(s.data(), s.size(), 0) >> shift_;
+  }
+
+  // Sizes the hash table for the values, and inserts their indexes into it.
+  template <typename HashFunc>
+  void BuildHashTable(HashFunc hash);
+
+  const size_t num_values_;
+
+  // The fixed-size values. If they are hashed, each is zero-extended to a
+  // word of its own; otherwise they are packed in order into the words, so
+  // that they are suitably aligned for the search.
+  std::vector<uint64_t> int_values_;
+
+  // The binary values.
+  std::vector<Slice> slice_values_;
+
+  // The hash table, of the indexes of the values or -1 for empty slots. Its
+  // size is a power of two, at least twice the number of values. Empty if
+  // the values are searched rather than hashed.
+  std::vector<int32_t> slots_;
+  size_t mask_;
+  int shift_;
+
+  DISALLOW_COPY_AND_ASSIGN(InListIndex);
+};
+
+template <>
+inline bool InListIndex::Contains<BINARY>(const void* cell) const {
+  const Slice& s = *reinterpret_cast<const Slice*>(cell);
+  for (size_t slot = HashSlice(s); ; slot = (slot + 1) & mask_) {
+    const int32_t idx = slots_[slot];
+    if (idx < 0) return false;
+    if (slice_values_[idx] == s) return true;
+  }
+}
+
+} // namespace kudu
@@ -77,14 +77,7 @@ struct KeyEncoderTraits<Type,
   }
 
   static void Encode(const void* key_ptr, Buffer* dst) {
-    unsigned_cpp_type key_unsigned;
-    memcpy(&key_unsigned, key_ptr, sizeof(key_unsigned));
-
-    // To encode signed integers, swap the MSB.
-    if (MathLimits<cpp_type>::kIsSigned) {
-      key_unsigned ^= 1UL << (sizeof(key_unsigned) * CHAR_BIT - 1);
-    }
-    key_unsigned = SwapEndian(key_unsigned);
+    unsigned_cpp_type key_unsigned = EncodeBits(key_ptr);
     dst->append(reinterpret_cast<const char*>(&key_unsigned), sizeof(key_unsigned));
   }
 
@@ -92,6 +85,22 @@ struct KeyEncoderTraits<Type,
     Encode(key, dst);
   }
 
+  static void AddMaxEncodedSizes(const void* const* keys, size_t n, bool /*is_last*/,
+                                 size_t* sizes) {
+    for (size_t i = 0; i < n; i++) {
+      sizes[i] += sizeof(cpp_type);
+    }
+  }
+
+  static void EncodeBatch(const void* const* keys, size_t n, bool /*is_last*/,
+                          uint8_t** dsts) {
+    for (size_t i = 0; i < n; i++) {
+      unsigned_cpp_type key_unsigned = EncodeBits(keys[i]);
+      memcpy(dsts[i], &key_unsigned, sizeof(key_unsigned));
+      dsts[i] += sizeof(key_unsigned);
+    }
+  }
+
   static Status DecodeKeyPortion(Slice* encoded_key,
                                  bool /*is_last*/,
                                  Arena* /*arena*/,
@@ -110,6 +119,20 @@ struct KeyEncoderTraits<Type,
     encoded_key->remove_prefix(sizeof(cpp_type));
     return Status::OK();
   }
+
+ private:
+  // Returns the bits of the encoding of the key at 'key_ptr', in the order
+  // in which they're stored.
+  static unsigned_cpp_type EncodeBits(const void* key_ptr) {
+    unsigned_cpp_type key_unsigned;
+    memcpy(&key_unsigned, key_ptr, sizeof(key_unsigned));
+
+    // To encode signed integers, swap the MSB.
+    if (MathLimits<cpp_type>::kIsSigned) {
+      key_unsigned ^= 1UL << (sizeof(key_unsigned) * CHAR_BIT - 1);
+    }
+    return SwapEndian(key_unsigned);
+  }
 };
 
 template<typename Buffer>
@@ -139,53 +162,33 @@ struct KeyEncoderTraits<BINARY, Buffer> {
     if (is_last) {
       dst->append(reinterpret_cast<const char*>(s.data()), s.size());
     } else {
-      // If we're a middle component of a composite key, we need to add a \x00
-      // at the end in order to separate this component from the next one. However,
-      // if we just did that, we'd have issues where a key that actually has
-      // \x00 in it would compare wrong, so we have to instead add \x00\x00, and
-      // encode \x00 as \x00\x01.
       int old_size = dst->size();
       dst->resize(old_size + s.size() * 2 + 2);
+      uint8_t* dstp = EncodeWithSeparatorsTo(s, reinterpret_cast<uint8_t*>(&(*dst)[old_size]));
+      dst->resize(dstp - reinterpret_cast<uint8_t*>(&(*dst)[0]));
+    }
+  }
 
-      const uint8_t* srcp = s.data();
-      uint8_t* dstp = reinterpret_cast<uint8_t*>(&(*dst)[old_size]);
-      int len = s.size();
-      int rem = len;
+  static void AddMaxEncodedSizes(const void* const* keys, size_t n, bool is_last,
+                                 size_t* sizes) {
+    for (size_t i = 0; i < n; i++) {
+      size_t size = reinterpret_cast<const Slice*>(keys[i])->size();
+      sizes[i] += is_last ? size : size * 2 + 2;
+    }
+  }
 
-      while (rem >= 16) {
-        if (!SSEEncodeChunk<16>(&srcp, &dstp)) {
-          goto slow_path;
-        }
-        rem -= 16;
-      }
-      while (rem >= 8) {
-        if (!SSEEncodeChunk<8>(&srcp, &dstp)) {
-          goto slow_path;
-        }
-        rem -= 8;
+  static void EncodeBatch(const void* const* keys, size_t n, bool is_last,
+                          uint8_t** dsts) {
+    if (is_last) {
+      for (size_t i = 0; i < n; i++) {
+        const Slice* s = reinterpret_cast<const Slice*>(keys[i]);
+        memcpy(dsts[i], s->data(), s->size());
+        dsts[i] += s->size();
       }
-      // Roll back to operate in 8 bytes at a time.
-      if (len > 8 && rem > 0) {
-        dstp -= 8 - rem;
-        srcp -= 8 - rem;
-        if (!SSEEncodeChunk<8>(&srcp, &dstp)) {
-          // TODO: optimize for the case where the input slice has '\0'
-          // bytes. (e.g. move the pointer to the first zero byte.)
-          dstp += 8 - rem;
-          srcp += 8 - rem;
-          goto slow_path;
-        }
-        rem = 0;
-        goto done;
+    } else {
+      for (size_t i = 0; i < n; i++) {
+        dsts[i] = EncodeWithSeparatorsTo(*reinterpret_cast<const Slice*>(keys[i]), dsts[i]);
       }
-
-      slow_path:
-      EncodeChunkLoop(&srcp, &dstp, rem);
-
-      done:
-      *dstp++ = 0;
-      *dstp++ = 0;
-      dst->resize(dstp - reinterpret_cast<uint8_t*>(&(*dst)[0]));
     }
   }
 
@@ -229,6 +232,56 @@ struct KeyEncoderTraits<BINARY, Buffer> {
   }
 
  private:
+  // Encodes 's' as a middle component of a composite key at 'dstp', which
+  // must have room for s.size() * 2 + 2 bytes, and returns the end of the
+  // encoding.
+  //
+  // If we're a middle component of a composite key, we need to add a \x00
+  // at the end in order to separate this component from the next one. However,
+  // if we just did that, we'd have issues where a key that actually has
+  // \x00 in it would compare wrong, so we have to instead add \x00\x00, and
+  // encode \x00 as \x00\x01.
+  static uint8_t* EncodeWithSeparatorsTo(const Slice& s, uint8_t* dstp) {
+    const uint8_t* srcp = s.data();
+    int len = s.size();
+    int rem = len;
+
+    while (rem >= 16) {
+      if (!SSEEncodeChunk<16>(&srcp, &dstp)) {
+        goto slow_path;
+      }
+      rem -= 16;
+    }
+    while (rem >= 8) {
+      if (!SSEEncodeChunk<8>(&srcp, &dstp)) {
+        goto slow_path;
+      }
+      rem -= 8;
+    }
+    // Roll back to operate in 8 bytes at a time.
+    if (len > 8 && rem > 0) {
+      dstp -= 8 - rem;
+      srcp -= 8 - rem;
+      if (!SSEEncodeChunk<8>(&srcp, &dstp)) {
+        // TODO: optimize for the case where the input slice has '\0'
+        // bytes. (e.g. move the pointer to the first zero byte.)
+        dstp += 8 - rem;
+        srcp += 8 - rem;
+        goto slow_path;
+      }
+      rem = 0;
+      goto done;
+    }
+
+    slow_path:
+    EncodeChunkLoop(&srcp, &dstp, rem);
+
+    done:
+    *dstp++ = 0;
+    *dstp++ = 0;
+    return dstp;
+  }
+
   // Encode a chunk of 'len' bytes from '*srcp' into '*dstp', incrementing
   // the pointers upon return.
   //
@@ -317,6 +370,21 @@ class KeyEncoder {
     Encode(key, dst);
   }
 
+  // Adds to sizes[i] an upper bound on the size of the encoding of the
+  // key at keys[i] as a component of a composite key, for each of the 'n'
+  // keys.
+  void AddMaxEncodedSizes(const void* const* keys, size_t n, bool is_last,
+                          size_t* sizes) const {
+    add_max_encoded_sizes_func_(keys, n, is_last, sizes);
+  }
+
+  // Encodes each of the 'n' keys at keys[i] like Encode(keys[i], is_last, ...)
+  // at dsts[i], and advances dsts[i] past the encoding. Each dsts[i] must have
+  // room for the size added by AddMaxEncodedSizes().
+  void EncodeBatch(const void* const* keys, size_t n, bool is_last, uint8_t** dsts) const {
+    encode_batch_func_(keys, n, is_last, dsts);
+  }
+
   // Decode the next component out of the composite key pointed to by '*encoded_key'
   // into *cell_ptr.
   // After decoding encoded_key is advanced forward such that it contains the remainder
@@ -337,6 +405,8 @@ class KeyEncoder {
   explicit KeyEncoder(EncoderTraitsClass t)
     : encode_func_(EncoderTraitsClass::Encode),
       encode_with_separators_func_(EncoderTraitsClass::EncodeWithSeparators),
+      add_max_encoded_sizes_func_(EncoderTraitsClass::AddMaxEncodedSizes),
+      encode_batch_func_(EncoderTraitsClass::EncodeBatch),
       decode_key_portion_func_(EncoderTraitsClass::DecodeKeyPortion) {
   }
 
@@ -344,6 +414,12 @@ class KeyEncoder {
   const EncodeFunc encode_func_;
   typedef void (*EncodeWithSeparatorsFunc)(const void* key, bool is_last, Buffer* dst);
   const EncodeWithSeparatorsFunc encode_with_separators_func_;
+  typedef void (*AddMaxEncodedSizesFunc)(const void* const* keys, size_t n, bool is_last,
+                                         size_t* sizes);
+  const AddMaxEncodedSizesFunc add_max_encoded_sizes_func_;
+  typedef void (*EncodeBatchFunc)(const void* const* keys, size_t n, bool is_last,
+                                  uint8_t** dsts);
+  const EncodeBatchFunc encode_batch_func_;
 
   typedef Status (*DecodeKeyPortionFunc)(Slice* enc_key, bool is_last,
                                        Arena* arena, uint8_t* cell_ptr);
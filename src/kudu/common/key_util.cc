@@ -233,6 +233,7 @@ int PushUpperBoundKeyPredicates(ColIdxIter first,
         }
         break;
       case PredicateType::IsNotNull:
+      case PredicateType::InBloomFilter:
         break_loop = true;
         break;
       case PredicateType::InList:
@@ -294,6 +295,7 @@ int PushLowerBoundKeyPredicates(ColIdxIter first,
         pushed_predicates++;
         break;
       case PredicateType::IsNotNull:
+      case PredicateType::InBloomFilter:
         break_loop = true;
         break;
       case PredicateType::InList:
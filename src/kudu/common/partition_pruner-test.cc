@@ -63,6 +63,20 @@ void CheckPrunedPartitions(const Schema& schema,
                                      return pruner.ShouldPrune(partition);
                                    });
   ASSERT_EQ(remaining_tablets, partitions.size() - pruned_partitions);
+
+  // A pruner initialized from a cached plan must match the one above.
+  if (spec.CanShortCircuit()) {
+    return;
+  }
+  std::shared_ptr<const PartitionPruner::Plan> plan =
+      PartitionPruner::CreatePlan(schema, partition_schema, spec);
+  PartitionPruner plan_pruner;
+  plan_pruner.Init(schema, partition_schema, spec, *plan);
+  ASSERT_EQ(pruner.ToString(schema, partition_schema),
+            plan_pruner.ToString(schema, partition_schema));
+  for (const Partition& partition : partitions) {
+    ASSERT_EQ(pruner.ShouldPrune(partition), plan_pruner.ShouldPrune(partition));
+  }
 }
 
 TEST(TestPartitionPruner, TestPrimaryKeyRangePruning) {
@@ -626,6 +640,76 @@ TEST(TestPartitionPruner, TestInListHashPruning) {
         8);
 }
 
+TEST(TestPartitionPruner, TestPredicateForPartition) {
+  // CREATE TABLE t
+  // (a INT8, b INT8)
+  // PRIMARY KEY (a, b)
+  // DISTRIBUTE BY HASH(a) INTO 3 BUCKETS;
+  Schema schema({ ColumnSchema("a", INT8),
+                  ColumnSchema("b", INT8) },
+                { ColumnId(0), ColumnId(1) },
+                2);
+
+  PartitionSchema partition_schema;
+  auto pb = PartitionSchemaPB();
+  auto hash_component = pb.add_hash_bucket_schemas();
+  hash_component->add_columns()->set_name("a");
+  hash_component->set_num_buckets(3);
+  hash_component->set_seed(0);
+
+  ASSERT_OK(PartitionSchema::FromPB(pb, schema, &partition_schema));
+
+  vector<Partition> partitions;
+  ASSERT_OK(partition_schema.CreatePartitions(vector<KuduPartialRow>(), {}, schema, &partitions));
+  ASSERT_EQ(3, partitions.size());
+
+  // zero, one, eight are in different buckets when bucket number is 3 and seed is 0.
+  int8_t zero = 0;
+  int8_t one = 1;
+  int8_t eight = 8;
+
+  // a in [0, 1, 8]: each partition is left with the one value in its bucket.
+  vector<const void*> a_values = { &zero, &one, &eight };
+  ColumnPredicate a_in = ColumnPredicate::InList(schema.column(0), &a_values);
+  vector<int8_t> remaining;
+  for (const auto& partition : partitions) {
+    ColumnPredicate pred = PartitionPruner::PredicateForPartition(schema, partition_schema,
+                                                                  partition, a_in);
+    ASSERT_EQ(PredicateType::Equality, pred.predicate_type());
+    remaining.push_back(*static_cast<const int8_t*>(pred.raw_lower()));
+  }
+  std::sort(remaining.begin(), remaining.end());
+  ASSERT_EQ(vector<int8_t>({ 0, 1, 8 }), remaining);
+
+  // a in [0, 1]: the partition of the bucket of 8 has no values left.
+  a_values = { &zero, &one };
+  a_in = ColumnPredicate::InList(schema.column(0), &a_values);
+  int num_none = 0;
+  for (const auto& partition : partitions) {
+    ColumnPredicate pred = PartitionPruner::PredicateForPartition(schema, partition_schema,
+                                                                  partition, a_in);
+    if (pred.predicate_type() == PredicateType::None) {
+      num_none++;
+    }
+  }
+  ASSERT_EQ(1, num_none);
+
+  // b in [0, 1, 8]: b isn't hashed, so the predicate is unchanged.
+  vector<const void*> b_values = { &zero, &one, &eight };
+  ColumnPredicate b_in = ColumnPredicate::InList(schema.column(1), &b_values);
+  for (const auto& partition : partitions) {
+    ASSERT_EQ(b_in, PartitionPruner::PredicateForPartition(schema, partition_schema,
+                                                           partition, b_in));
+  }
+
+  // a = 0: only in-list predicates are rewritten.
+  ColumnPredicate a_eq = ColumnPredicate::Equality(schema.column(0), &zero);
+  for (const auto& partition : partitions) {
+    ASSERT_EQ(a_eq, PartitionPruner::PredicateForPartition(schema, partition_schema,
+                                                           partition, a_eq));
+  }
+}
+
 TEST(TestPartitionPruner, TestMultiColumnInListHashPruning) {
   // CREATE TABLE t
   // (a INT8, b INT8, c INT8)
@@ -151,6 +151,91 @@ void EncodeRangeKeysFromPredicates(const Schema& schema,
 }
 } // anonymous namespace
 
+bool PartitionPruner::IsHashComponentPrunable(
+    const Schema& schema,
+    const PartitionSchema::HashBucketSchema& hash_bucket_schema,
+    const ScanSpec& scan_spec) {
+  for (const ColumnId& column_id : hash_bucket_schema.column_ids) {
+    const ColumnSchema& column = schema.column_by_id(column_id);
+    const ColumnPredicate *predicate = FindOrNull(scan_spec.predicates(), column.name());
+    if (predicate == nullptr ||
+        (predicate->predicate_type() != PredicateType::Equality &&
+         predicate->predicate_type() != PredicateType::InList)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+string PartitionPruner::PlanKey(const Schema& schema,
+                                const PartitionSchema& partition_schema,
+                                const ScanSpec& scan_spec) {
+  string key;
+  key.reserve(partition_schema.hash_bucket_schemas_.size());
+  for (const auto& hash_bucket_schema : partition_schema.hash_bucket_schemas_) {
+    key.push_back(IsHashComponentPrunable(schema, hash_bucket_schema, scan_spec) ? '1' : '0');
+  }
+  return key;
+}
+
+void PartitionPruner::BuildPlan(const Schema& schema,
+                                const PartitionSchema& partition_schema,
+                                const ScanSpec& scan_spec,
+                                Plan* plan) {
+  const vector<ColumnId>& range_columns = partition_schema.range_schema_.column_ids;
+  plan->range_columns_are_pk_prefix = !range_columns.empty() &&
+      AreRangeColumnsPrefixOfPrimaryKey(schema, range_columns);
+  plan->prunable_hash_components.reserve(partition_schema.hash_bucket_schemas_.size());
+  for (const auto& hash_bucket_schema : partition_schema.hash_bucket_schemas_) {
+    plan->prunable_hash_components.push_back(
+        IsHashComponentPrunable(schema, hash_bucket_schema, scan_spec));
+  }
+}
+
+std::shared_ptr<const PartitionPruner::Plan> PartitionPruner::CreatePlan(
+    const Schema& schema,
+    const PartitionSchema& partition_schema,
+    const ScanSpec& scan_spec) {
+  std::shared_ptr<Plan> plan(new Plan());
+  BuildPlan(schema, partition_schema, scan_spec, plan.get());
+
+  // Enumerate the buckets of the leading hash components which can't be
+  // pruned: every scan using the plan scans all of them.
+  const int num_hash_components = partition_schema.hash_bucket_schemas_.size();
+  int num_leading = 0;
+  while (num_leading < num_hash_components && !plan->prunable_hash_components[num_leading]) {
+    num_leading++;
+  }
+  if (num_leading == 0) {
+    return plan;
+  }
+  const KeyEncoder<string>& hash_encoder = GetKeyEncoder<string>(GetTypeInfo(UINT32));
+  vector<string> prefixes(1);
+  for (int hash_idx = 0; hash_idx < num_leading; hash_idx++) {
+    const uint32_t num_buckets = partition_schema.hash_bucket_schemas_[hash_idx].num_buckets;
+    bool is_last = hash_idx + 1 == num_leading;
+    vector<string> new_prefixes;
+    new_prefixes.reserve(prefixes.size() * num_buckets);
+    for (const string& prefix : prefixes) {
+      for (uint32_t bucket = 0; bucket < num_buckets; bucket++) {
+        string lower = prefix;
+        hash_encoder.Encode(&bucket, &lower);
+        if (is_last && num_leading == num_hash_components) {
+          string upper = prefix;
+          uint32_t bucket_upper = bucket + 1;
+          hash_encoder.Encode(&bucket_upper, &upper);
+          plan->leading_prefixes_incremented.emplace_back(move(upper));
+        }
+        new_prefixes.emplace_back(move(lower));
+      }
+    }
+    prefixes.swap(new_prefixes);
+  }
+  plan->num_leading_components = num_leading;
+  plan->leading_prefixes = move(prefixes);
+  return plan;
+}
+
 vector<bool> PartitionPruner::PruneHashComponent(
     const PartitionSchema& partition_schema,
     const PartitionSchema::HashBucketSchema& hash_bucket_schema,
@@ -196,6 +281,16 @@ vector<bool> PartitionPruner::PruneHashComponent(
 void PartitionPruner::Init(const Schema& schema,
                            const PartitionSchema& partition_schema,
                            const ScanSpec& scan_spec) {
+  if (scan_spec.CanShortCircuit()) { return; }
+  Plan plan;
+  BuildPlan(schema, partition_schema, scan_spec, &plan);
+  Init(schema, partition_schema, scan_spec, plan);
+}
+
+void PartitionPruner::Init(const Schema& schema,
+                           const PartitionSchema& partition_schema,
+                           const ScanSpec& scan_spec,
+                           const Plan& plan) {
   // If we can already short circuit the scan we don't need to bother with
   // partition pruning. This also allows us to assume some invariants of the
   // scan spec, such as no None predicates and that the lower bound PK < upper
@@ -270,7 +365,7 @@ void PartitionPruner::Init(const Schema& schema,
   string range_upper_bound;
   const vector<ColumnId>& range_columns = partition_schema.range_schema_.column_ids;
   if (!range_columns.empty()) {
-    if (AreRangeColumnsPrefixOfPrimaryKey(schema, range_columns)) {
+    if (plan.range_columns_are_pk_prefix) {
       EncodeRangeKeysFromPrimaryKeyBounds(schema,
                                           scan_spec,
                                           range_columns.size(),
@@ -292,18 +387,7 @@ void PartitionPruner::Init(const Schema& schema,
   hash_bucket_bitsets.reserve(partition_schema.hash_bucket_schemas_.size());
   for (int hash_idx = 0; hash_idx < partition_schema.hash_bucket_schemas_.size(); hash_idx++) {
     const auto& hash_bucket_schema = partition_schema.hash_bucket_schemas_[hash_idx];
-    bool can_prune = true;
-    for (const ColumnId& column_id : hash_bucket_schema.column_ids) {
-      const ColumnSchema& column = schema.column_by_id(column_id);
-      const ColumnPredicate *predicate = FindOrNull(scan_spec.predicates(), column.name());
-      if (predicate == nullptr ||
-          (predicate->predicate_type() != PredicateType::Equality &&
-           predicate->predicate_type() != PredicateType::InList)) {
-        can_prune = false;
-        break;
-      }
-    }
-    if (can_prune) {
+    if (plan.prunable_hash_components[hash_idx]) {
       auto hash_bucket_bitset = PruneHashComponent(partition_schema,
                                                    hash_bucket_schema,
                                                    schema,
@@ -337,8 +421,23 @@ void PartitionPruner::Init(const Schema& schema,
   // partition key ranges (possibly incrementing the upper bound by one bucket
   // number if this is the final constraint, see note 2 in the example above).
   vector<tuple<string, string>> partition_key_ranges(1);
+  int first_hash_idx = 0;
+  if (plan.num_leading_components > 0 && plan.num_leading_components <= constrained_index) {
+    // Start from the ranges of the leading components enumerated by the plan.
+    bool is_last = plan.num_leading_components == constrained_index && range_upper_bound.empty();
+    if (!is_last || !plan.leading_prefixes_incremented.empty()) {
+      const vector<string>& uppers = is_last ? plan.leading_prefixes_incremented
+                                             : plan.leading_prefixes;
+      partition_key_ranges.clear();
+      partition_key_ranges.reserve(plan.leading_prefixes.size());
+      for (size_t i = 0; i < plan.leading_prefixes.size(); i++) {
+        partition_key_ranges.emplace_back(plan.leading_prefixes[i], uppers[i]);
+      }
+      first_hash_idx = plan.num_leading_components;
+    }
+  }
   const KeyEncoder<string>& hash_encoder = GetKeyEncoder<string>(GetTypeInfo(UINT32));
-  for (int hash_idx = 0; hash_idx < constrained_index; hash_idx++) {
+  for (int hash_idx = first_hash_idx; hash_idx < constrained_index; hash_idx++) {
     // This is the final partition key component if this is the final constrained
     // bucket, and the range upper bound is empty. In this case we need to
     // increment the bucket on the upper bound to convert from inclusive to
@@ -439,6 +538,45 @@ bool PartitionPruner::ShouldPrune(const Partition& partition) const {
           partition.partition_key_end() <= get<0>(*range));
 }
 
+ColumnPredicate PartitionPruner::PredicateForPartition(const Schema& schema,
+                                                       const PartitionSchema& partition_schema,
+                                                       const Partition& partition,
+                                                       const ColumnPredicate& predicate) {
+  if (predicate.predicate_type() != PredicateType::InList) {
+    return predicate;
+  }
+  int32_t col_idx = schema.find_column(predicate.column().name());
+  if (col_idx == Schema::kColumnNotFound) {
+    return predicate;
+  }
+  const ColumnId column_id = schema.column_id(col_idx);
+  const KeyEncoder<string>& encoder = GetKeyEncoder<string>(predicate.column().type_info());
+
+  // The values of multi-column hash components can't be assigned to buckets
+  // column by column, so only single-column components are considered.
+  vector<const void*> values(predicate.raw_values());
+  string encoded;
+  for (int hash_idx = 0; hash_idx < partition_schema.hash_bucket_schemas_.size(); hash_idx++) {
+    const auto& hash_bucket_schema = partition_schema.hash_bucket_schemas_[hash_idx];
+    if (hash_bucket_schema.column_ids.size() != 1 ||
+        hash_bucket_schema.column_ids[0] != column_id) {
+      continue;
+    }
+    const int32_t bucket = partition.hash_buckets()[hash_idx];
+    auto end = std::remove_if(values.begin(), values.end(), [&](const void* value) {
+      encoded.clear();
+      encoder.Encode(value, true, &encoded);
+      return PartitionSchema::BucketForEncodedColumns(encoded, hash_bucket_schema) != bucket;
+    });
+    values.erase(end, values.end());
+  }
+  if (values.size() == predicate.raw_values().size()) {
+    return predicate;
+  }
+  // With no values left, this is a None predicate.
+  return ColumnPredicate::InList(predicate.column(), &values);
+}
+
 string PartitionPruner::ToString(const Schema& schema,
                                  const PartitionSchema& partition_schema) const {
   vector<string> strings;
@@ -17,11 +17,13 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <tuple>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/partition.h"
 
 namespace kudu {
@@ -41,14 +43,56 @@ class Schema;
 class PartitionPruner {
  public:
 
+  // The parts of the pruning which only depend on the schemas and on which
+  // hash components of the partition key are constrained by the predicates
+  // of the scan, not on the values of the predicates. Scans with the same
+  // PlanKey() can share a plan.
+  struct Plan {
+    // Whether the range columns are a prefix of the primary key columns.
+    bool range_columns_are_pk_prefix = false;
+
+    // For each hash component, whether there are equality or in-list
+    // predicates on all of its columns, so that its buckets can be pruned.
+    std::vector<bool> prunable_hash_components;
+
+    // The number of leading hash components which can't be pruned, and the
+    // encoded partition key prefixes made of all of their buckets, in order.
+    // Only filled in by CreatePlan().
+    int num_leading_components = 0;
+    std::vector<std::string> leading_prefixes;
+
+    // Like 'leading_prefixes', but with the bucket of the last component
+    // incremented, for use as exclusive upper bounds. Only filled in if no
+    // hash component can be pruned.
+    std::vector<std::string> leading_prefixes_incremented;
+  };
+
   PartitionPruner() = default;
 
+  // Returns the key identifying the plan for the pruning of 'scan_spec'.
+  static std::string PlanKey(const Schema& schema,
+                             const PartitionSchema& partition_schema,
+                             const ScanSpec& scan_spec);
+
+  // Creates the plan for the pruning of 'scan_spec', for scans with the
+  // same PlanKey() to share.
+  static std::shared_ptr<const Plan> CreatePlan(const Schema& schema,
+                                                const PartitionSchema& partition_schema,
+                                                const ScanSpec& scan_spec);
+
   // Initializes the partition pruner for a new scan. The scan spec should
   // already be optimized by the ScanSpec::Optimize method.
   void Init(const Schema& schema,
             const PartitionSchema& partition_schema,
             const ScanSpec& scan_spec);
 
+  // Like Init(), but with the plan created by CreatePlan() for a scan with
+  // the same PlanKey().
+  void Init(const Schema& schema,
+            const PartitionSchema& partition_schema,
+            const ScanSpec& scan_spec,
+            const Plan& plan);
+
   // Returns whether there are more partition key ranges to scan.
   bool HasMorePartitionKeyRanges() const;
 
@@ -61,11 +105,33 @@ class PartitionPruner {
   // Returns true if the provided partition should be pruned.
   bool ShouldPrune(const Partition& partition) const;
 
+  // Returns 'predicate' as it applies to the scan of the tablet of
+  // 'partition': if it is an in-list predicate on the only column of a hash
+  // component, only the values which hash to the bucket of the partition
+  // are kept. Other predicates are returned as they are.
+  static ColumnPredicate PredicateForPartition(const Schema& schema,
+                                               const PartitionSchema& partition_schema,
+                                               const Partition& partition,
+                                               const ColumnPredicate& predicate);
+
   // Returns a text description of this partition pruner suitable for debug
   // printing.
   std::string ToString(const Schema& schema, const PartitionSchema& partition_schema) const;
 
  private:
+  // Returns true if there are equality or in-list predicates on all the
+  // columns of the hash component, so that its buckets can be pruned.
+  static bool IsHashComponentPrunable(
+      const Schema& schema,
+      const PartitionSchema::HashBucketSchema& hash_bucket_schema,
+      const ScanSpec& scan_spec);
+
+  // Fills in the parts of 'plan' which don't require enumerating buckets.
+  static void BuildPlan(const Schema& schema,
+                        const PartitionSchema& partition_schema,
+                        const ScanSpec& scan_spec,
+                        Plan* plan);
+
   // Search all combination of in-list and equality predicates.
   // Return hash values bitset of these combination.
   std::vector<bool> PruneHashComponent(
@@ -0,0 +1,48 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_COMMON_ROW_COMPARATOR_H
+#define KUDU_COMMON_ROW_COMPARATOR_H
+
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Arena;
+class RowBlockRow;
+
+// Compares and copies the rows of RowBlocks of a given schema. Merges use
+// this, if they are given one, in place of Schema::Compare() and CopyRow(),
+// which dispatch on the type of each column. See codegen::RowComparator for
+// an implementation compiled for the schema.
+//
+// Implementations must be thread-safe.
+class RowComparator {
+ public:
+  virtual ~RowComparator() {}
+
+  // Compares the keys of 'lhs' and 'rhs', which must have the schema the
+  // comparator was created for. Returns the same result as Schema::Compare().
+  virtual int Compare(const RowBlockRow& lhs, const RowBlockRow& rhs) const = 0;
+
+  // Copies 'src' into 'dst', which must both have the schema the comparator
+  // was created for, as CopyRow() does.
+  virtual Status CopyRow(const RowBlockRow& src, RowBlockRow* dst, Arena* dst_arena) const = 0;
+};
+
+} // namespace kudu
+
+#endif // KUDU_COMMON_ROW_COMPARATOR_H
@@ -80,17 +80,20 @@ static void DoRandomMutation(string* s) {
 void RowOperationsTest::CheckDecodeDoesntCrash(const Schema& client_schema,
                                                const Schema& server_schema,
                                                const RowOperationsPB& pb) {
-  arena_.Reset();
-  RowOperationsPBDecoder decoder(&pb, &client_schema, &server_schema, &arena_);
-  vector<DecodedRowOperation> ops;
-  Status s = decoder.DecodeOperations(&ops);
-  if (s.ok() && !ops.empty()) {
-    // If we got an OK result, then we should be able to stringify without
-    // crashing. This ensures that any indirect data (eg strings) gets
-    // set correctly.
-    ignore_result(ops[0].ToString(server_schema));
+  for (auto mode : { RowOperationsPBDecoder::COPY_ROWS,
+                     RowOperationsPBDecoder::REFERENCE_ROWS_IN_PLACE }) {
+    arena_.Reset();
+    RowOperationsPBDecoder decoder(&pb, &client_schema, &server_schema, &arena_, mode);
+    vector<DecodedRowOperation> ops;
+    Status s = decoder.DecodeOperations(&ops);
+    if (s.ok() && !ops.empty()) {
+      // If we got an OK result, then we should be able to stringify without
+      // crashing. This ensures that any indirect data (eg strings) gets
+      // set correctly.
+      ignore_result(ops[0].ToString(server_schema));
+    }
+    // Bad Status is OK -- we expect corruptions here.
   }
-  // Bad Status is OK -- we expect corruptions here.
 }
 
 void RowOperationsTest::DoFuzzTest(const Schema& server_schema,
@@ -689,4 +692,70 @@ TEST_F(RowOperationsTest, SplitKeyRoundTrip) {
   CHECK(!row2->IsColumnSet("missing"));
 }
 
+// Test that rows and row keys already in the tablet's layout are referenced
+// in place, and that they decode to the same operations as copies.
+TEST_F(RowOperationsTest, TestDecodeRowsInPlace) {
+  int64_t default_val = 10;
+  SchemaBuilder b;
+  ASSERT_OK(b.AddKeyColumn("key", INT32));
+  ASSERT_OK(b.AddColumn("int_val", INT64, false, &default_val, &default_val));
+  Schema server_schema = b.Build();
+  Schema client_schema = b.BuildWithoutIds();
+
+  KuduPartialRow full_row(&client_schema);
+  ASSERT_OK(full_row.SetInt32("key", 1));
+  ASSERT_OK(full_row.SetInt64("int_val", 100));
+  KuduPartialRow key_only(&client_schema);
+  ASSERT_OK(key_only.SetInt32("key", 2));
+
+  RowOperationsPB pb;
+  RowOperationsPBEncoder enc(&pb);
+  enc.Add(RowOperationsPB::INSERT, full_row);
+  enc.Add(RowOperationsPB::INSERT, key_only);
+  enc.Add(RowOperationsPB::UPDATE, full_row);
+  enc.Add(RowOperationsPB::DELETE, key_only);
+
+  vector<DecodedRowOperation> copied;
+  ASSERT_OK(RowOperationsPBDecoder(&pb, &client_schema, &server_schema, &arena_)
+            .DecodeOperations(&copied));
+  vector<DecodedRowOperation> in_place;
+  ASSERT_OK(RowOperationsPBDecoder(&pb, &client_schema, &server_schema, &arena_,
+                                   RowOperationsPBDecoder::REFERENCE_ROWS_IN_PLACE)
+            .DecodeOperations(&in_place));
+  ASSERT_EQ(4, copied.size());
+  ASSERT_EQ(4, in_place.size());
+
+  const uint8_t* rows_begin = reinterpret_cast<const uint8_t*>(pb.rows().data());
+  for (int i = 0; i < in_place.size(); i++) {
+    SCOPED_TRACE(i);
+    EXPECT_EQ(copied[i].ToString(server_schema), in_place[i].ToString(server_schema));
+    // Only the insert which leaves a column to its default is projected.
+    bool referenced = in_place[i].row_data >= rows_begin &&
+        in_place[i].row_data < rows_begin + pb.rows().size();
+    EXPECT_EQ(i != 1, referenced);
+  }
+  EXPECT_EQ("INSERT (int32 key=2, int64 int_val=10)", in_place[1].ToString(server_schema));
+
+  // Keys with BINARY columns must have their pointers rewritten, so they
+  // are copied.
+  SchemaBuilder string_key_builder;
+  ASSERT_OK(string_key_builder.AddKeyColumn("key", STRING));
+  ASSERT_OK(string_key_builder.AddColumn("int_val", INT32));
+  Schema string_key_schema = string_key_builder.Build();
+  Schema string_key_client_schema = string_key_builder.BuildWithoutIds();
+  KuduPartialRow string_key(&string_key_client_schema);
+  ASSERT_OK(string_key.SetStringNoCopy("key", "hello"));
+  pb.Clear();
+  RowOperationsPBEncoder(&pb).Add(RowOperationsPB::DELETE, string_key);
+  in_place.clear();
+  ASSERT_OK(RowOperationsPBDecoder(&pb, &string_key_client_schema, &string_key_schema, &arena_,
+                                   RowOperationsPBDecoder::REFERENCE_ROWS_IN_PLACE)
+            .DecodeOperations(&in_place));
+  ASSERT_EQ(1, in_place.size());
+  rows_begin = reinterpret_cast<const uint8_t*>(pb.rows().data());
+  EXPECT_FALSE(in_place[0].row_data >= rows_begin &&
+               in_place[0].row_data < rows_begin + pb.rows().size());
+  EXPECT_EQ(R"(MUTATE (string key="hello") DELETE)", in_place[0].ToString(string_key_schema));
+}
+
 } // namespace kudu
@@ -134,14 +134,18 @@ void RowOperationsPBEncoder::Add(RowOperationsPB::Type op_type, const KuduPartia
 RowOperationsPBDecoder::RowOperationsPBDecoder(const RowOperationsPB* pb,
                                                const Schema* client_schema,
                                                const Schema* tablet_schema,
-                                               Arena* dst_arena)
+                                               Arena* dst_arena,
+                                               DecodeMode mode)
   : pb_(pb),
     client_schema_(client_schema),
     tablet_schema_(tablet_schema),
     dst_arena_(dst_arena),
+    mode_(mode),
     bm_size_(BitmapSize(client_schema_->num_columns())),
     tablet_row_size_(ContiguousRowHelper::row_size(*tablet_schema_)),
-    src_(pb->rows().data(), pb->rows().size()) {
+    src_(pb->rows().data(), pb->rows().size()),
+    keys_in_place_(false),
+    rows_in_place_(false) {
 }
 
 RowOperationsPBDecoder::~RowOperationsPBDecoder() {
@@ -326,6 +330,19 @@ Status RowOperationsPBDecoder::DecodeInsertOrUpsert(const uint8_t* prototype_row
     RETURN_NOT_OK(ReadNullBitmap(&client_null_map));
   }
 
+  // A row which sets every column is encoded exactly as the tablet lays it
+  // out, so there is nothing to project.
+  if (rows_in_place_ &&
+      BitMapIsAllSet(client_isset_map, 0, client_schema_->num_columns())) {
+    if (PREDICT_FALSE(src_.size() < tablet_row_size_)) {
+      return Status::Corruption("Not enough data for row");
+    }
+    op->row_data = src_.data();
+    op->isset_bitmap = client_isset_map;
+    src_.remove_prefix(tablet_row_size_);
+    return Status::OK();
+  }
+
   // Allocate a row with the tablet's layout.
   uint8_t* tablet_row_storage = reinterpret_cast<uint8_t*>(
       dst_arena_->AllocateBytesAligned(tablet_row_size_, 8));
@@ -399,17 +416,25 @@ Status RowOperationsPBDecoder::DecodeUpdateOrDelete(const ClientServerMapping& m
     RETURN_NOT_OK(ReadNullBitmap(&client_null_map));
   }
 
-  // Allocate space for the row key.
-  uint8_t* rowkey_storage = reinterpret_cast<uint8_t*>(
-    dst_arena_->AllocateBytesAligned(rowkey_size, 8));
-  if (PREDICT_FALSE(!rowkey_storage)) {
-    return Status::RuntimeError("Out of memory");
+  // The key columns come first and are always set, so without BINARY
+  // columns the encoded key is laid out as the tablet's row key is.
+  uint8_t* rowkey_storage = nullptr;
+  if (keys_in_place_) {
+    op->row_data = src_.data();
+  } else {
+    // Allocate space for the row key.
+    rowkey_storage = reinterpret_cast<uint8_t*>(
+      dst_arena_->AllocateBytesAligned(rowkey_size, 8));
+    if (PREDICT_FALSE(!rowkey_storage)) {
+      return Status::RuntimeError("Out of memory");
+    }
+    op->row_data = rowkey_storage;
   }
 
   // We're passing the full schema instead of the key schema here.
   // That's OK because the keys come at the bottom. We lose some bounds
   // checking in debug builds, but it avoids an extra copy of the key schema.
-  ContiguousRow rowkey(tablet_schema_, rowkey_storage);
+  ConstContiguousRow rowkey(tablet_schema_, op->row_data);
 
   // First process the key columns.
   int client_col_idx = 0;
@@ -434,9 +459,14 @@ Status RowOperationsPBDecoder::DecodeUpdateOrDelete(const ClientServerMapping& m
                                      col.ToString());
     }
 
-    RETURN_NOT_OK(ReadColumn(col, rowkey.mutable_cell_ptr(tablet_col_idx)));
+    if (keys_in_place_) {
+      Slice unused;
+      RETURN_NOT_OK(GetColumnSlice(col, &unused));
+    } else {
+      RETURN_NOT_OK(ReadColumn(col, rowkey_storage +
+                               tablet_schema_->column_offset(tablet_col_idx)));
+    }
   }
-  op->row_data = rowkey_storage;
 
   // Now we process the rest of the columns:
   // For UPDATE, we expect at least one other column to be set, indicating the
@@ -561,6 +591,23 @@ Status RowOperationsPBDecoder::DecodeOperations(vector<DecodedRowOperation>* ops
   DCHECK_EQ(mapping.num_mapped(), client_schema_->num_columns());
   RETURN_NOT_OK(mapping.CheckAllRequiredColumnsPresent());
 
+  if (mode_ == REFERENCE_ROWS_IN_PLACE) {
+    bool key_has_binary = false;
+    for (int i = 0; i < tablet_schema_->num_key_columns(); i++) {
+      key_has_binary |= tablet_schema_->column(i).type_info()->physical_type() == BINARY;
+    }
+    keys_in_place_ = !key_has_binary;
+
+    bool identity = client_schema_->num_columns() == tablet_schema_->num_columns();
+    for (int i = 0; identity && i < client_schema_->num_columns(); i++) {
+      identity = mapping.client_to_tablet_idx(i) == i &&
+          tablet_schema_->column(i).type_info()->physical_type() != BINARY;
+    }
+    rows_in_place_ = identity &&
+        !client_schema_->has_nullables() &&
+        !tablet_schema_->has_nullables();
+  }
+
   // Make a "prototype row" which has all the defaults filled in. We can copy
   // this to create a starting point for each row as we decode it, with
   // all the defaults in place without having to loop.
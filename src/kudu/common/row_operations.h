@@ -53,6 +53,8 @@ struct DecodedRowOperation {
 
   // For INSERT or UPSERT, the whole projected row.
   // For UPDATE or DELETE, the row key.
+  // Either may point into the encoded protobuf: see
+  // RowOperationsPBDecoder::REFERENCE_ROWS_IN_PLACE.
   const uint8_t* row_data;
 
   // For INSERT or UPDATE, a bitmap indicating which of the cells were
@@ -72,10 +74,26 @@ struct DecodedRowOperation {
 
 class RowOperationsPBDecoder {
  public:
+  // How the decoded operations refer to the encoded rows.
+  enum DecodeMode {
+    // Every row and row key is copied into the destination arena.
+    COPY_ROWS,
+
+    // Rows and row keys whose encoding is already the tablet's row layout
+    // are referenced in place, and only the others are copied. This is the
+    // case for row keys without BINARY columns, and for inserted rows which
+    // set every column of a schema without nullable or BINARY columns, when
+    // the client's columns are those of the tablet. The cells referenced in
+    // place may be unaligned, and the protobuf must outlive the decoded
+    // operations, as it already must for their BINARY cells.
+    REFERENCE_ROWS_IN_PLACE
+  };
+
   RowOperationsPBDecoder(const RowOperationsPB* pb,
                          const Schema* client_schema,
                          const Schema* tablet_schema,
-                         Arena* dst_arena);
+                         Arena* dst_arena,
+                         DecodeMode mode = COPY_ROWS);
   ~RowOperationsPBDecoder();
 
   Status DecodeOperations(std::vector<DecodedRowOperation>* ops);
@@ -107,11 +125,17 @@ class RowOperationsPBDecoder {
   const Schema* const client_schema_;
   const Schema* const tablet_schema_;
   Arena* const dst_arena_;
+  const DecodeMode mode_;
 
   const int bm_size_;
   const int tablet_row_size_;
   Slice src_;
 
+  // Whether row keys, and inserted rows which set every column, may be
+  // referenced in place. Set by DecodeOperations().
+  bool keys_in_place_;
+  bool rows_in_place_;
+
 
   DISALLOW_COPY_AND_ASSIGN(RowOperationsPBDecoder);
 };
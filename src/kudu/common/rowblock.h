@@ -147,6 +147,14 @@ class SelectionVectorView {
     DCHECK_LE(nrows, sel_vec_->nrows() - row_offset_);
     BitmapChangeBits(sel_vec_->mutable_bitmap(), row_offset_, nrows, false);
   }
+  // Returns true if any of the next 'nrows' rows is selected.
+  bool AnySelected(size_t nrows) const {
+    DCHECK_LE(nrows, sel_vec_->nrows() - row_offset_);
+    if (nrows == 0) {
+      return false;
+    }
+    return !BitmapIsAllZero(sel_vec_->bitmap(), row_offset_, row_offset_ + nrows);
+  }
  private:
   SelectionVector* sel_vec_;
   size_t row_offset_;
@@ -134,6 +134,10 @@ void ScanSpec::OptimizeScan(const Schema& schema,
       itr = std::next(itr);
     }
   }
+
+  for (auto& col_pred : predicates_) {
+    col_pred.second.BuildInListIndex();
+  }
 }
 
 void ScanSpec::PushPredicatesIntoPrimaryKeyBounds(const Schema& schema,
@@ -37,7 +37,11 @@ class ScanSpec {
       exclusive_upper_bound_key_(nullptr),
       lower_bound_partition_key_(),
       exclusive_upper_bound_partition_key_(),
-      cache_blocks_(true) {
+      cache_blocks_(true),
+      readahead_blocks_(0),
+      limit_(-1),
+      sample_fraction_(1.0),
+      sample_seed_(0) {
   }
 
   // Add a predicate on the column.
@@ -60,6 +64,9 @@ class ScanSpec {
   // If remove_pushed_predicates is true, then column predicates that are pushed
   // into the upper or lower primary key bounds are removed.
   //
+  // The values of the remaining in-list predicates are indexed if
+  // --in_list_predicate_index is set.
+  //
   // Idempotent.
   void OptimizeScan(const Schema& schema,
                     Arena* arena,
@@ -118,6 +125,48 @@ class ScanSpec {
     cache_blocks_ = cache_blocks;
   }
 
+  // The number of data blocks each column iterator may read ahead once it
+  // detects a sequential scan. 0 disables readahead.
+  int readahead_blocks() const {
+    return readahead_blocks_;
+  }
+
+  void set_readahead_blocks(int readahead_blocks) {
+    readahead_blocks_ = readahead_blocks;
+  }
+
+  // The maximum number of rows returned by the scan, or -1 if the scan is
+  // not limited. Iterators may stop reading once the limit is reached.
+  int64_t limit() const {
+    return limit_;
+  }
+
+  void set_limit(int64_t limit) {
+    limit_ = limit;
+  }
+
+  // The fraction of the rows to sample, in (0, 1]. Rather than sampling
+  // individual rows, the iterators over the on-disk data read a random
+  // subset of fixed-size ranges of rows, so that the other ranges are never
+  // read or decoded. 1 disables sampling.
+  double sample_fraction() const {
+    return sample_fraction_;
+  }
+
+  void set_sample_fraction(double sample_fraction) {
+    sample_fraction_ = sample_fraction;
+  }
+
+  // The seed which determines the sampled ranges of rows: scans with the
+  // same seed and fraction sample the same ranges.
+  uint64_t sample_seed() const {
+    return sample_seed_;
+  }
+
+  void set_sample_seed(uint64_t sample_seed) {
+    sample_seed_ = sample_seed;
+  }
+
   std::string ToString(const Schema& s) const;
 
  private:
@@ -148,6 +197,10 @@ class ScanSpec {
   std::string lower_bound_partition_key_;
   std::string exclusive_upper_bound_partition_key_;
   bool cache_blocks_;
+  int readahead_blocks_;
+  int64_t limit_;
+  double sample_fraction_;
+  uint64_t sample_seed_;
 };
 
 } // namespace kudu
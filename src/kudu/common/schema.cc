@@ -46,10 +46,11 @@ static const ColumnId  kFirstColumnId(10);
 #endif
 
 string ColumnStorageAttributes::ToString() const {
-  return strings::Substitute("encoding=$0, compression=$1, cfile_block_size=$2",
+  return strings::Substitute("encoding=$0, compression=$1, cfile_block_size=$2$3",
                              EncodingType_Name(encoding),
                              CompressionType_Name(compression),
-                             cfile_block_size);
+                             cfile_block_size,
+                             indexed ? ", indexed" : "");
 }
 
 // TODO: include attributes_.ToString() -- need to fix unit tests
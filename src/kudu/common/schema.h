@@ -85,13 +85,15 @@ struct ColumnStorageAttributes {
   ColumnStorageAttributes()
     : encoding(AUTO_ENCODING),
       compression(DEFAULT_COMPRESSION),
-      cfile_block_size(0) {
+      cfile_block_size(0),
+      indexed(false) {
   }
 
   ColumnStorageAttributes(EncodingType enc, CompressionType cmp)
     : encoding(enc),
       compression(cmp),
-      cfile_block_size(0) {
+      cfile_block_size(0),
+      indexed(false) {
   }
 
   string ToString() const;
@@ -102,6 +104,11 @@ struct ColumnStorageAttributes {
   // The preferred block size for cfile blocks. If 0, uses the
   // server-wide default.
   int32_t cfile_block_size;
+
+  // Whether each DiskRowSet keeps a secondary index of the column's values,
+  // which scans with a predicate on the column may use to read only the
+  // matching rows. Only applies to non-key columns of types allowed in keys.
+  bool indexed;
 };
 
 // The schema for a given column.
@@ -616,6 +623,53 @@ class Schema {
     return Slice(*dst);
   }
 
+  // Encodes the keys of the 'num_rows' rows like EncodeComparableKey(), but
+  // column by column, so that the encoder of each key column is looked up
+  // once per batch, and the loop over its cells is specialized for its type.
+  //
+  // The keys are encoded in order into 'dst', replacing its current
+  // contents, which is sized up front; keys[i] is set to the key of
+  // rows[i]. The keys may not be contiguous, since room is left for the
+  // escaping of the binary components of composite keys.
+  template <class RowType>
+  void EncodeComparableKeys(const RowType* rows, size_t num_rows,
+                            faststring* dst, Slice* keys) const {
+    dst->clear();
+    if (num_rows == 0) {
+      return;
+    }
+    DCHECK_KEY_PROJECTION_SCHEMA_EQ(*this, *rows[0].schema());
+
+    // The cells of key column i are at cells[i * num_rows, (i + 1) * num_rows).
+    std::vector<const void*> cells(num_key_columns_ * num_rows);
+    std::vector<size_t> offsets(num_rows + 1, 0);
+    for (size_t i = 0; i < num_key_columns_; i++) {
+      DCHECK(!cols_[i].is_nullable());
+      const void** col_cells = &cells[i * num_rows];
+      for (size_t j = 0; j < num_rows; j++) {
+        col_cells[j] = rows[j].cell_ptr(i);
+      }
+      GetKeyEncoder<faststring>(cols_[i].type_info()).AddMaxEncodedSizes(
+          col_cells, num_rows, i == num_key_columns_ - 1, &offsets[1]);
+    }
+    for (size_t j = 1; j <= num_rows; j++) {
+      offsets[j] += offsets[j - 1];
+    }
+    dst->resize(offsets[num_rows]);
+
+    std::vector<uint8_t*> dsts(num_rows);
+    for (size_t j = 0; j < num_rows; j++) {
+      dsts[j] = dst->data() + offsets[j];
+    }
+    for (size_t i = 0; i < num_key_columns_; i++) {
+      GetKeyEncoder<faststring>(cols_[i].type_info()).EncodeBatch(
+          &cells[i * num_rows], num_rows, i == num_key_columns_ - 1, dsts.data());
+    }
+    for (size_t j = 0; j < num_rows; j++) {
+      keys[j] = Slice(dst->data() + offsets[j], dsts[j] - (dst->data() + offsets[j]));
+    }
+  }
+
   // Stringify this Schema. This is not particularly efficient,
   // so should only be used when necessary for output.
   string ToString() const;
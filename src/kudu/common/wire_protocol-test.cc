@@ -24,6 +24,8 @@
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
@@ -227,6 +229,94 @@ TEST_F(WireProtocolTest, TestColumnarRowBlockToPB) {
   }
 }
 
+// Test serializing blocks of rows in columnar layout, appending to the same
+// column buffers.
+TEST_F(WireProtocolTest, TestRowBlockToColumnarPB) {
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema_, 10, &arena);
+  FillRowBlockWithTestRows(&block);
+  block.row(3).cell(2).set_null(true);
+  block.selection_vector()->SetRowUnselected(5);
+
+  ColumnarRowBlockPB pb;
+  vector<ColumnarColumnBuffers> columns;
+  SerializeRowBlockColumnar(block, &pb, nullptr, &columns);
+  SerializeRowBlockColumnar(block, &pb, nullptr, &columns);
+  ASSERT_EQ(18, pb.num_rows());
+  ASSERT_EQ(3, columns.size());
+
+  // Variable length columns have an offset per row plus the end offset.
+  const Slice kValue("hello world col1");
+  ASSERT_EQ(19 * sizeof(uint32_t), columns[0].data->size());
+  ASSERT_EQ(18 * kValue.size(), columns[0].varlen_data->size());
+  ASSERT_EQ(nullptr, columns[0].non_null_bitmap.get());
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(columns[0].data->data());
+  for (int i = 0; i <= 18; i++) {
+    ASSERT_EQ(i * kValue.size(), offsets[i]);
+  }
+  ASSERT_EQ(kValue, Slice(columns[0].varlen_data->data(), kValue.size()));
+
+  // Fixed length cells are stored as is, with a bit per row in the null bitmap.
+  ASSERT_EQ(18 * sizeof(uint32_t), columns[2].data->size());
+  ASSERT_EQ(nullptr, columns[2].varlen_data.get());
+  ASSERT_EQ(BitmapSize(18), columns[2].non_null_bitmap->size());
+  const uint32_t* cells = reinterpret_cast<const uint32_t*>(columns[2].data->data());
+  const uint8_t* non_null_bitmap = columns[2].non_null_bitmap->data();
+  for (int i = 0; i < 18; i++) {
+    int src_row = i % 9 < 5 ? i % 9 : i % 9 + 1;
+    SCOPED_TRACE(i);
+    ASSERT_EQ(src_row != 3, BitmapTest(non_null_bitmap, i));
+    if (src_row != 3) {
+      ASSERT_EQ(src_row, cells[i]);
+    }
+  }
+}
+
+// Test that the cells of non-nullable fixed width columns are referenced
+// rather than copied while all the rows of the blocks are selected.
+TEST_F(WireProtocolTest, TestRowBlockToColumnarPBReferencingCells) {
+  Schema schema({ ColumnSchema("key", UINT32),
+                  ColumnSchema("val", UINT32, true /* nullable */) },
+                1);
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema, 10, &arena);
+  for (int i = 0; i < block.nrows(); i++) {
+    RowBlockRow row = block.row(i);
+    *reinterpret_cast<uint32_t*>(row.mutable_cell_ptr(0)) = i;
+    *reinterpret_cast<uint32_t*>(row.mutable_cell_ptr(1)) = i;
+    row.cell(1).set_null(false);
+  }
+  block.selection_vector()->SetAllTrue();
+
+  ColumnarRowBlockPB pb;
+  vector<ColumnarColumnBuffers> columns;
+  SerializeRowBlockColumnar(block, &pb, nullptr, &columns, true);
+  SerializeRowBlockColumnar(block, &pb, nullptr, &columns, true);
+  ASSERT_EQ(20, pb.num_rows());
+
+  // The key cells are referenced in the block, the nullable ones are copied.
+  ASSERT_EQ(0, columns[0].data->size());
+  ASSERT_EQ(2, columns[0].data_slices.size());
+  ASSERT_EQ(block.column_block(0).cell_ptr(0), columns[0].data_slices[0].data());
+  ASSERT_EQ(20 * sizeof(uint32_t), columns[0].data_size());
+  ASSERT_TRUE(columns[1].data_slices.empty());
+  ASSERT_EQ(20 * sizeof(uint32_t), columns[1].data->size());
+
+  // Once a row is skipped, the referenced cells are copied along with the
+  // others.
+  block.selection_vector()->SetRowUnselected(5);
+  SerializeRowBlockColumnar(block, &pb, nullptr, &columns, true);
+  ASSERT_EQ(29, pb.num_rows());
+  ASSERT_TRUE(columns[0].data_slices.empty());
+  ASSERT_EQ(29 * sizeof(uint32_t), columns[0].data->size());
+  const uint32_t* cells = reinterpret_cast<const uint32_t*>(columns[0].data->data());
+  for (int i = 0; i < 29; i++) {
+    SCOPED_TRACE(i);
+    int expected = i < 20 ? i % 10 : (i - 20 < 5 ? i - 20 : i - 19);
+    ASSERT_EQ(expected, cells[i]);
+  }
+}
+
 #ifdef NDEBUG
 TEST_F(WireProtocolTest, TestColumnarRowBlockToPBBenchmark) {
   Arena arena(1024, 1024 * 1024);
@@ -337,6 +427,48 @@ TEST_F(WireProtocolTest, TestColumnDefaultValue) {
   ASSERT_EQ(write_default_u32, *static_cast<const uint32_t *>(col5fpb.write_default_value()));
 }
 
+TEST_F(WireProtocolTest, TestColumnPredicateInBloomFilter) {
+  ColumnSchema col1("col1", STRING);
+  Schema schema({ col1 }, 1);
+  Arena arena(1024, 1024 * 1024);
+  boost::optional<ColumnPredicate> predicate;
+
+  BloomFilterBuilder builder(BloomFilterSizing::ByCountAndFPRate(10, 0.01),
+                             BloomFilterLayout::BLOCKED);
+  builder.AddKey(BloomKeyProbe(Slice("foo")));
+  BloomFilter filter(builder.slice(), builder.n_hashes(), BloomFilterLayout::BLOCKED);
+
+  { // col1 IN BLOOM FILTER AND col1 >= "a"
+    Slice lower("a");
+    ColumnPredicate cp = ColumnPredicate::InBloomFilter(col1, { &filter }, &lower, nullptr);
+    ColumnPredicatePB pb;
+    ASSERT_NO_FATAL_FAILURE(ColumnPredicateToPB(cp, &pb));
+    ASSERT_EQ(ColumnPredicatePB::BloomFilter::BLOCKED,
+              pb.in_bloom_filter().bloom_filters(0).layout());
+
+    ASSERT_OK(ColumnPredicateFromPB(schema, &arena, pb, &predicate));
+    ASSERT_EQ(cp, *predicate);
+    Slice foo("foo");
+    ASSERT_TRUE(predicate->EvaluateCell<BINARY>(&foo));
+  }
+
+  { // Filter corruption
+    ColumnPredicatePB pb;
+    pb.set_column("col1");
+    auto* filter_pb = pb.mutable_in_bloom_filter()->add_bloom_filters();
+    filter_pb->set_layout(ColumnPredicatePB::BloomFilter::BLOCKED);
+    filter_pb->set_data(string(BloomFilter::kBucketBytes + 1, '\0'));
+    ASSERT_TRUE(ColumnPredicateFromPB(schema, &arena, pb, &predicate).IsInvalidArgument());
+  }
+
+  { // No filters
+    ColumnPredicatePB pb;
+    pb.set_column("col1");
+    pb.mutable_in_bloom_filter();
+    ASSERT_TRUE(ColumnPredicateFromPB(schema, &arena, pb, &predicate).IsInvalidArgument());
+  }
+}
+
 TEST_F(WireProtocolTest, TestColumnPredicateInList) {
   ColumnSchema col1("col1", INT32);
   vector<ColumnSchema> cols = { col1 };
@@ -27,6 +27,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/fastmem.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/net/net_util.h"
@@ -197,6 +198,9 @@ void ColumnSchemaToPB(const ColumnSchema& col_schema, ColumnSchemaPB *pb, int fl
     pb->set_encoding(col_schema.attributes().encoding);
     pb->set_compression(col_schema.attributes().compression);
     pb->set_cfile_block_size(col_schema.attributes().cfile_block_size);
+    if (col_schema.attributes().indexed) {
+      pb->set_indexed(true);
+    }
   }
   if (col_schema.has_read_default()) {
     if (col_schema.type_info()->physical_type() == BINARY) {
@@ -251,6 +255,7 @@ ColumnSchema ColumnSchemaFromPB(const ColumnSchemaPB& pb) {
   if (pb.has_cfile_block_size()) {
     attributes.cfile_block_size = pb.cfile_block_size();
   }
+  attributes.indexed = pb.indexed();
   return ColumnSchema(pb.name(), pb.type(), pb.is_nullable(),
                       read_default_ptr, write_default_ptr,
                       attributes);
@@ -392,6 +397,29 @@ void ColumnPredicateToPB(const ColumnPredicate& predicate,
       }
       return;
     };
+    case PredicateType::InBloomFilter: {
+      auto* bf_pred = pb->mutable_in_bloom_filter();
+      for (const BloomFilter* filter : predicate.bloom_filters()) {
+        auto* filter_pb = bf_pred->add_bloom_filters();
+        filter_pb->set_data(filter->data().data(), filter->data().size());
+        if (filter->layout() == BloomFilterLayout::BLOCKED) {
+          filter_pb->set_layout(ColumnPredicatePB::BloomFilter::BLOCKED);
+        } else {
+          filter_pb->set_n_hashes(filter->n_hashes());
+        }
+      }
+      if (predicate.raw_lower() != nullptr) {
+        CopyPredicateBoundToPB(predicate.column(),
+                               predicate.raw_lower(),
+                               bf_pred->mutable_lower());
+      }
+      if (predicate.raw_upper() != nullptr) {
+        CopyPredicateBoundToPB(predicate.column(),
+                               predicate.raw_upper(),
+                               bf_pred->mutable_upper());
+      }
+      return;
+    };
     case PredicateType::None: LOG(FATAL) << "None predicate may not be converted to protobuf";
   }
   LOG(FATAL) << "unknown predicate type";
@@ -453,6 +481,46 @@ Status ColumnPredicateFromPB(const Schema& schema,
       *predicate = ColumnPredicate::InList(col, &values);
       break;
     };
+    case ColumnPredicatePB::kInBloomFilter: {
+      const auto& bf_pred = pb.in_bloom_filter();
+      if (bf_pred.bloom_filters_size() == 0) {
+        return Status::InvalidArgument("Invalid bloom filter predicate on column: no filters",
+                                       col.name());
+      }
+      vector<const BloomFilter*> filters;
+      for (const auto& filter_pb : bf_pred.bloom_filters()) {
+        const string& data = filter_pb.data();
+        BloomFilterLayout layout = BloomFilterLayout::CLASSIC;
+        if (filter_pb.layout() == ColumnPredicatePB::BloomFilter::BLOCKED) {
+          layout = BloomFilterLayout::BLOCKED;
+          if (data.empty() || data.size() % BloomFilter::kBucketBytes != 0) {
+            return Status::InvalidArgument(
+                strings::Substitute("Invalid bloom filter predicate on column $0: "
+                                    "$1 bytes is not a whole number of buckets",
+                                    col.name(), data.size()));
+          }
+        } else if (data.empty() || filter_pb.n_hashes() == 0) {
+          return Status::InvalidArgument(
+              "Invalid bloom filter predicate on column: empty filter or no hashes",
+              col.name());
+        }
+        // Copy the filter into the arena, since it must outlive 'pb'.
+        uint8_t* data_copy = static_cast<uint8_t*>(arena->AllocateBytes(data.size()));
+        memcpy(data_copy, data.data(), data.size());
+        filters.push_back(arena->NewObject<BloomFilter>(Slice(data_copy, data.size()),
+                                                        filter_pb.n_hashes(), layout));
+      }
+      const void* lower = nullptr;
+      const void* upper = nullptr;
+      if (bf_pred.has_lower()) {
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, bf_pred.lower(), arena, &lower));
+      }
+      if (bf_pred.has_upper()) {
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, bf_pred.upper(), arena, &upper));
+      }
+      *predicate = ColumnPredicate::InBloomFilter(col, std::move(filters), lower, upper);
+      break;
+    };
     case ColumnPredicatePB::kIsNotNull: {
       ColumnPredicate p = ColumnPredicate::IsNotNull(col);
       *predicate = ColumnPredicate::IsNotNull(col);
@@ -619,10 +687,29 @@ static void CopyColumn(const RowBlock& block, int col_idx,
   size_t cell_size = cblock.stride();
   const uint8_t* src = cblock.cell_ptr(0);
 
-  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(),
-                                   block.nrows());
   int run_size;
   bool selected;
+  if (IS_VARLEN) {
+    // Size the indirect data up front, so that the values (which may point
+    // straight into pinned block cache memory) are each copied exactly once.
+    size_t indirect_size = 0;
+    BitmapIterator size_iter(block.selection_vector()->bitmap(), block.nrows());
+    int idx = 0;
+    while ((run_size = size_iter.Next(&selected))) {
+      if (selected) {
+        for (int i = idx; i < idx + run_size; i++) {
+          if (!IS_NULLABLE || !cblock.is_null(i)) {
+            indirect_size += reinterpret_cast<const Slice*>(cblock.cell_ptr(i))->size();
+          }
+        }
+      }
+      idx += run_size;
+    }
+    indirect_data->EnsureRoomForAppend(indirect_size);
+  }
+
+  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(),
+                                   block.nrows());
   int row_idx = 0;
   while ((run_size = selected_row_iter.Next(&selected))) {
     if (!selected) {
@@ -711,4 +798,157 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
   rowblock_pb->set_num_rows(rowblock_pb->num_rows() + num_rows);
 }
 
+ColumnarColumnBuffers::ColumnarColumnBuffers()
+    : data(new faststring()) {
+}
+
+size_t ColumnarColumnBuffers::data_size() const {
+  size_t size = data->size();
+  for (const Slice& s : data_slices) {
+    size += s.size();
+  }
+  return size;
+}
+
+// Copy a column worth of data from the given RowBlock into 'dst', appending
+// after the 'num_rows_before' rows already serialized.
+//
+// IS_NULLABLE and IS_VARLEN are template parameters for the same reason as
+// in CopyColumn().
+template<bool IS_NULLABLE, bool IS_VARLEN>
+static void CopyColumnColumnar(const RowBlock& block, int col_idx, int64_t num_rows_before,
+                               int num_rows, bool reference_cells,
+                               ColumnarColumnBuffers* dst) {
+  ColumnBlock cblock = block.column_block(col_idx);
+  size_t cell_size = cblock.stride();
+
+  if (!IS_NULLABLE && !IS_VARLEN) {
+    // The cells of the block are laid out like those of the buffer, so they
+    // may be referenced as they are if none were skipped, as long as none of
+    // the preceding cells had to be copied.
+    if (reference_cells && num_rows == block.nrows() && dst->data->size() == 0) {
+      dst->data_slices.emplace_back(cblock.cell_ptr(0), num_rows * cell_size);
+      return;
+    }
+    for (const Slice& s : dst->data_slices) {
+      dst->data->append(s.data(), s.size());
+    }
+    dst->data_slices.clear();
+  }
+
+  uint8_t* dst_cells;
+  uint32_t varlen_offset = 0;
+  if (IS_VARLEN) {
+    // The offsets start with the beginning of the first value.
+    if (dst->data->size() == 0) {
+      dst->data->append(&varlen_offset, sizeof(varlen_offset));
+    } else {
+      memcpy(&varlen_offset, dst->data->data() + dst->data->size() - sizeof(varlen_offset),
+             sizeof(varlen_offset));
+    }
+    size_t old_size = dst->data->size();
+    dst->data->resize(old_size + num_rows * sizeof(uint32_t));
+    dst_cells = dst->data->data() + old_size;
+  } else {
+    size_t old_size = dst->data->size();
+    dst->data->resize(old_size + num_rows * cell_size);
+    dst_cells = dst->data->data() + old_size;
+  }
+
+  uint8_t* non_null_bitmap = nullptr;
+  if (IS_NULLABLE) {
+    size_t old_size = dst->non_null_bitmap->size();
+    size_t new_size = BitmapSize(num_rows_before + num_rows);
+    dst->non_null_bitmap->resize(new_size);
+    non_null_bitmap = dst->non_null_bitmap->data();
+    memset(non_null_bitmap + old_size, 0, new_size - old_size);
+  }
+
+  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(), block.nrows());
+  int run_size;
+  bool selected;
+  int row_idx = 0;
+  int64_t dst_idx = num_rows_before;
+  while ((run_size = selected_row_iter.Next(&selected))) {
+    if (!selected) {
+      row_idx += run_size;
+      continue;
+    }
+    for (int i = 0; i < run_size; i++, row_idx++, dst_idx++) {
+      bool is_null = IS_NULLABLE && cblock.is_null(row_idx);
+      if (IS_NULLABLE && !is_null) {
+        BitmapSet(non_null_bitmap, dst_idx);
+      }
+      if (IS_VARLEN) {
+        if (!is_null) {
+          const Slice* slice = reinterpret_cast<const Slice*>(cblock.cell_ptr(row_idx));
+          dst->varlen_data->append(slice->data(), slice->size());
+          varlen_offset += slice->size();
+        }
+        memcpy(dst_cells, &varlen_offset, sizeof(varlen_offset));
+        dst_cells += sizeof(varlen_offset);
+      } else {
+        if (is_null) {
+          memset(dst_cells, 0, cell_size);
+        } else {
+          strings::memcpy_inlined(dst_cells, cblock.cell_ptr(row_idx), cell_size);
+        }
+        dst_cells += cell_size;
+      }
+    }
+  }
+}
+
+void SerializeRowBlockColumnar(const RowBlock& block, ColumnarRowBlockPB* rowblock_pb,
+                               const Schema* projection_schema,
+                               vector<ColumnarColumnBuffers>* columns,
+                               bool reference_cells) {
+  DCHECK_GT(block.nrows(), 0);
+  const Schema& tablet_schema = block.schema();
+
+  if (projection_schema == nullptr) {
+    projection_schema = &tablet_schema;
+  }
+
+  if (columns->empty()) {
+    columns->resize(projection_schema->num_columns());
+    for (int i = 0; i < projection_schema->num_columns(); i++) {
+      const ColumnSchema& col = projection_schema->column(i);
+      if (col.type_info()->physical_type() == BINARY) {
+        (*columns)[i].varlen_data.reset(new faststring());
+      }
+      if (col.is_nullable()) {
+        (*columns)[i].non_null_bitmap.reset(new faststring());
+      }
+    }
+  }
+  DCHECK_EQ(projection_schema->num_columns(), columns->size());
+
+  int64_t num_rows_before = rowblock_pb->num_rows();
+  int num_rows = block.selection_vector()->CountSelected();
+  for (int t_schema_idx = 0; t_schema_idx < tablet_schema.num_columns(); t_schema_idx++) {
+    const ColumnSchema& col = tablet_schema.column(t_schema_idx);
+    int proj_schema_idx = projection_schema->find_column(col.name());
+    if (proj_schema_idx == -1) {
+      continue;
+    }
+    ColumnarColumnBuffers* dst = &(*columns)[proj_schema_idx];
+    bool is_varlen = col.type_info()->physical_type() == BINARY;
+    if (col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<true, true>(block, t_schema_idx, num_rows_before, num_rows,
+                                     reference_cells, dst);
+    } else if (col.is_nullable() && !is_varlen) {
+      CopyColumnColumnar<true, false>(block, t_schema_idx, num_rows_before, num_rows,
+                                      reference_cells, dst);
+    } else if (!col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<false, true>(block, t_schema_idx, num_rows_before, num_rows,
+                                      reference_cells, dst);
+    } else {
+      CopyColumnColumnar<false, false>(block, t_schema_idx, num_rows_before, num_rows,
+                                       reference_cells, dst);
+    }
+  }
+  rowblock_pb->set_num_rows(num_rows_before + num_rows);
+}
+
 } // namespace kudu
@@ -20,9 +20,12 @@
 #define KUDU_COMMON_WIRE_PROTOCOL_H
 
 #include <boost/optional.hpp>
+#include <memory>
 #include <vector>
 
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 using boost::optional;
@@ -33,7 +36,6 @@ class Arena;
 class ColumnPredicate;
 class ColumnSchema;
 class ConstContiguousRow;
-class faststring;
 class HostPort;
 class RowBlock;
 class RowBlockRow;
@@ -128,6 +130,44 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
                        const Schema* client_projection_schema,
                        faststring* data_buf, faststring* indirect_data);
 
+// The buffers holding one column of a columnar row block. See
+// ColumnarRowBlockPB for their format.
+struct ColumnarColumnBuffers {
+  ColumnarColumnBuffers();
+
+  // Returns the size of the cell data, whether copied or referenced.
+  size_t data_size() const;
+
+  // The cell data, or the offsets of variable length values.
+  std::unique_ptr<faststring> data;
+
+  // The cell data of a fixed width column, referenced in the row blocks
+  // rather than copied into 'data'. See SerializeRowBlockColumnar().
+  std::vector<Slice> data_slices;
+
+  // The values of variable length columns; NULL for other columns.
+  std::unique_ptr<faststring> varlen_data;
+
+  // The non-null bitmap of nullable columns; NULL for other columns.
+  std::unique_ptr<faststring> non_null_bitmap;
+};
+
+// Like SerializeRowBlock(), but appends the selected rows of 'block' to the
+// per-column buffers in 'columns', which is resized to match the projection
+// on the first call.
+//
+// If 'reference_cells' is true, the cells of the non-nullable fixed width
+// columns of a block whose rows are all selected are referenced in
+// 'data_slices' rather than copied, for as long as no cells of the column
+// needed to be copied. The caller must then keep 'block' alive for as long
+// as it uses the buffers.
+//
+// Requires that block.nrows() > 0
+void SerializeRowBlockColumnar(const RowBlock& block, ColumnarRowBlockPB* rowblock_pb,
+                               const Schema* client_projection_schema,
+                               std::vector<ColumnarColumnBuffers>* columns,
+                               bool reference_cells = false);
+
 // Rewrites the data pointed-to by row data slice 'row_data_slice' by replacing
 // relative indirect data pointers with absolute ones in 'indirect_data_slice'.
 // At the time of this writing, this rewriting is only done for STRING types.
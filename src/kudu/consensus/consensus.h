@@ -254,6 +254,18 @@ class Consensus : public RefCountedThreadSafe<Consensus> {
   // Returns the current Raft role of this instance.
   virtual RaftPeerPB::Role role() const = 0;
 
+  // Returns whether this instance is the leader and holds a lease, during
+  // which no other replica can become the leader. A leader holding a lease
+  // knows of all the committed operations, so it can serve linearizable
+  // reads without a round of replication.
+  virtual bool HasLeaderLease() const {
+    return false;
+  }
+
+  // Evicts the committed operations from the cache of the log, releasing
+  // their memory. Operations which are needed later are read from the log.
+  virtual void EvictLogCache() {}
+
   // Returns the uuid of this peer.
   virtual std::string peer_uuid() const = 0;
 
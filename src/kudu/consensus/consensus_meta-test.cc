@@ -17,8 +17,10 @@
 #include "kudu/consensus/consensus_meta.h"
 
 #include <memory>
+#include <thread>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
 #include "kudu/common/wire_protocol.h"
@@ -26,6 +28,7 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/test_macros.h"
@@ -34,12 +37,16 @@
 #define ASSERT_VALUES_EQUAL(cmeta, opid_index, uuid, term) \
   ASSERT_NO_FATAL_FAILURE(AssertValuesEqual(cmeta, opid_index, uuid, term))
 
+DECLARE_bool(cmeta_group_dir_syncs);
+DECLARE_bool(log_force_fsync_all);
+
 namespace kudu {
 namespace consensus {
 
 using std::string;
 using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 const char* kTabletId = "test-consensus-metadata";
 const int64_t kInitialTerm = 3;
@@ -133,6 +140,39 @@ TEST_F(ConsensusMetadataTest, TestFlush) {
   }
 }
 
+// Check that the flushes of many tablets sharing the directory syncs are
+// all durable.
+TEST_F(ConsensusMetadataTest, TestConcurrentGroupedFlushes) {
+  FLAGS_log_force_fsync_all = true;
+  FLAGS_cmeta_group_dir_syncs = true;
+  const int kNumTablets = 16;
+  const int kNumTerms = 10;
+
+  vector<std::thread> threads;
+  for (int i = 0; i < kNumTablets; i++) {
+    threads.emplace_back([&, i]() {
+      unique_ptr<ConsensusMetadata> cmeta;
+      CHECK_OK(ConsensusMetadata::Create(&fs_manager_, Substitute("tablet-$0", i),
+                                         fs_manager_.uuid(), config_, kInitialTerm, &cmeta));
+      for (int term = kInitialTerm + 1; term <= kInitialTerm + kNumTerms; term++) {
+        cmeta->set_current_term(term);
+        CHECK_OK(cmeta->Flush());
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  for (int i = 0; i < kNumTablets; i++) {
+    unique_ptr<ConsensusMetadata> cmeta;
+    ASSERT_OK(ConsensusMetadata::Load(&fs_manager_, Substitute("tablet-$0", i),
+                                      fs_manager_.uuid(), &cmeta));
+    ASSERT_VALUES_EQUAL(*cmeta, kInvalidOpIdIndex, fs_manager_.uuid(),
+                        kInitialTerm + kNumTerms);
+  }
+}
+
 // Builds a distributed configuration of voters with the given uuids.
 RaftConfigPB BuildConfig(const vector<string>& uuids) {
   RaftConfigPB config;
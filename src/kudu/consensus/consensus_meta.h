@@ -65,6 +65,20 @@ class ConsensusMetadata {
                        int64_t current_term,
                        std::unique_ptr<ConsensusMetadata>* cmeta_out);
 
+  // Like Create(), but doesn't sync the consensus metadata directory, so
+  // that tablets created together may share a single sync. The creation of
+  // the metadata isn't durable until the caller calls SyncDir().
+  static Status CreateWithoutDirSync(FsManager* fs_manager,
+                                     const std::string& tablet_id,
+                                     const std::string& peer_uuid,
+                                     const RaftConfigPB& config,
+                                     int64_t current_term,
+                                     std::unique_ptr<ConsensusMetadata>* cmeta_out);
+
+  // Syncs the consensus metadata directory of 'fs_manager', if consensus
+  // metadata is synced at all.
+  static Status SyncDir(FsManager* fs_manager);
+
   // Load a ConsensusMetadata object from disk.
   // Returns Status::NotFound if the file could not be found. May return other
   // Status codes if unable to read the file.
@@ -148,6 +162,19 @@ class ConsensusMetadata {
 
   std::string LogPrefix() const;
 
+  // Shared implementation of Create() and CreateWithoutDirSync().
+  static Status CreateInternal(FsManager* fs_manager,
+                               const std::string& tablet_id,
+                               const std::string& peer_uuid,
+                               const RaftConfigPB& config,
+                               int64_t current_term,
+                               bool sync_dir,
+                               std::unique_ptr<ConsensusMetadata>* cmeta_out);
+
+  // Implements Flush(), syncing the directory of the metadata file only if
+  // 'sync_dir' is true.
+  Status FlushInternal(bool sync_dir);
+
   // Updates the cached active role.
   void UpdateActiveRole();
 
@@ -30,6 +30,7 @@
 #include "kudu/consensus/consensus_peers.h"
 #include "kudu/consensus/consensus_queue.h"
 #include "kudu/consensus/log.h"
+#include "kudu/consensus/multi_raft_batcher.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -53,6 +54,28 @@ DEFINE_int32(raft_get_node_instance_timeout_ms, 30000,
              "Timeout for retrieving node instance data over RPC.");
 TAG_FLAG(consensus_rpc_timeout_ms, hidden);
 
+DEFINE_int32(consensus_max_inflight_requests_per_peer, 1,
+             "Maximum number of consensus update requests which a leader may have "
+             "in flight to each follower at a time. Values greater than one let the "
+             "leader send the following batches of operations to a follower without "
+             "waiting for the responses to the previous ones.");
+TAG_FLAG(consensus_max_inflight_requests_per_peer, experimental);
+TAG_FLAG(consensus_max_inflight_requests_per_peer, runtime);
+
+DEFINE_bool(consensus_batch_heartbeats, false,
+            "Whether the heartbeats which the leader replicas of this server send to "
+            "the replicas hosted by the same server are batched into a single RPC, "
+            "rather than sent in one RPC per tablet.");
+TAG_FLAG(consensus_batch_heartbeats, experimental);
+TAG_FLAG(consensus_batch_heartbeats, runtime);
+
+DEFINE_bool(consensus_send_preserialized_ops, false,
+            "Whether the leader serializes each operation once and sends the serialized "
+            "bytes to all the followers, rather than serializing the operations again in "
+            "the request to each follower. Only supported by RPC peer proxies.");
+TAG_FLAG(consensus_send_preserialized_ops, experimental);
+TAG_FLAG(consensus_send_preserialized_ops, runtime);
+
 DECLARE_int32(raft_heartbeat_interval_ms);
 
 DEFINE_double(fault_crash_on_leader_request_fraction, 0.0,
@@ -111,6 +134,7 @@ Peer::Peer(const RaftPeerPB& peer_pb, string tablet_id, string leader_uuid,
       proxy_(std::move(proxy)),
       queue_(queue),
       failed_attempts_(0),
+      last_request_committed_index_(kMinimumOpIdIndex),
       heartbeater_(
           peer_pb.permanent_uuid(),
           MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_interval_ms),
@@ -144,8 +168,16 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
     return;
   }
 
-  // Only allow one request at a time.
-  if (request_pending_) {
+  // Only allow one request at a time, unless requests are pipelined.
+  const int max_inflight = std::max(1, FLAGS_consensus_max_inflight_requests_per_peer);
+  if (tablet_copy_pending_ || requests_pending_ >= max_inflight) {
+    return;
+  }
+
+  // Further requests are only pipelined behind the outstanding ones while
+  // the exchanges with the peer succeed.
+  const bool pipelined = requests_pending_ > 0;
+  if (pipelined && failed_attempts_ > 0) {
     return;
   }
 
@@ -171,48 +203,66 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
     return;
   }
 
-  // The peer has no pending request nor is sending: send the request.
+  UpdateRpc* rpc = nullptr;
+  for (const auto& r : rpcs_) {
+    if (!r->in_flight) {
+      rpc = r.get();
+      break;
+    }
+  }
+  if (rpc == nullptr) {
+    rpcs_.emplace_back(new UpdateRpc());
+    rpc = rpcs_.back().get();
+  }
+  ConsensusRequestPB* request = &rpc->request;
+
+  // The peer has a free request slot: send the request.
   bool needs_tablet_copy = false;
-  int64_t commit_index_before = request_.has_committed_index() ?
-      request_.committed_index() : kMinimumOpIdIndex;
-  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), &request_,
-                                    &replicate_msg_refs_, &needs_tablet_copy);
-  int64_t commit_index_after = request_.has_committed_index() ?
-      request_.committed_index() : kMinimumOpIdIndex;
+  int64_t commit_index_before = last_request_committed_index_;
+  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), request,
+                                    &rpc->replicate_msg_refs, &needs_tablet_copy);
+  int64_t commit_index_after = request->has_committed_index() ?
+      request->committed_index() : kMinimumOpIdIndex;
 
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(INFO) << "Could not obtain request from queue for peer: "
         << peer_pb_.permanent_uuid() << ". Status: " << s.ToString();
     return;
   }
+  last_request_committed_index_ = commit_index_after;
 
   if (PREDICT_FALSE(needs_tablet_copy)) {
+    // Wait for the outstanding updates, which will fail as well, before
+    // starting the tablet copy.
+    if (pipelined) {
+      return;
+    }
     Status s = PrepareTabletCopyRequest();
     if (!s.ok()) {
       LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to generate Tablet Copy request for peer: "
                                         << s.ToString();
     }
 
-    controller_.Reset();
-    request_pending_ = true;
+    tc_controller_.Reset();
+    tablet_copy_pending_ = true;
     l.unlock();
     // Capture a shared_ptr reference into the RPC callback so that we're guaranteed
     // that this object outlives the RPC.
-    proxy_->StartTabletCopy(&tc_request_, &tc_response_, &controller_,
+    proxy_->StartTabletCopy(&tc_request_, &tc_response_, &tc_controller_,
                             [s_this = shared_from_this()]() {
                               s_this->ProcessTabletCopyResponse();
                             });
     return;
   }
 
-  request_.set_tablet_id(tablet_id_);
-  request_.set_caller_uuid(leader_uuid_);
-  request_.set_dest_uuid(peer_pb_.permanent_uuid());
+  request->set_tablet_id(tablet_id_);
+  request->set_caller_uuid(leader_uuid_);
+  request->set_dest_uuid(peer_pb_.permanent_uuid());
 
-  bool req_has_ops = request_.ops_size() > 0 || (commit_index_after > commit_index_before);
+  bool req_has_ops = request->ops_size() > 0 || (commit_index_after > commit_index_before);
   // If the queue is empty, check if we were told to send a status-only
-  // message, if not just return.
-  if (PREDICT_FALSE(!req_has_ops && !even_if_queue_empty)) {
+  // message, if not just return. Status-only messages are never pipelined.
+  if (PREDICT_FALSE(!req_has_ops && (!even_if_queue_empty || pipelined))) {
     return;
   }
 
@@ -226,31 +276,58 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
 
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending to peer " << peer_pb().permanent_uuid() << ": "
-      << SecureShortDebugString(request_);
-  controller_.Reset();
+      << SecureShortDebugString(*request);
+  rpc->controller.Reset();
+
+  // When pipelining, assemble the next request from the ops following the
+  // ones in this request, without waiting for its response.
+  const bool fill_pipeline = max_inflight > 1 && request->ops_size() > 0;
+  if (fill_pipeline) {
+    queue_->AdvancePeerNextIndex(peer_pb_.permanent_uuid(), *request);
+  }
 
-  request_pending_ = true;
+  // Move the ops out of the request into payloads of the RPC, which are
+  // serialized only once for all the peers.
+  if (FLAGS_consensus_send_preserialized_ops && request->ops_size() > 0) {
+    DCHECK_EQ(request->ops_size(), rpc->replicate_msg_refs.size());
+    for (const ReplicateRefPtr& msg : rpc->replicate_msg_refs) {
+      rpc->controller.AddRequestPayload(msg->EncodedAsRequestOp());
+    }
+    request->mutable_ops()->ExtractSubrange(0, request->ops_size(), nullptr);
+  }
+
+  rpc->in_flight = true;
+  rpc->send_time = MonoTime::Now();
+  requests_pending_++;
   l.unlock();
   // Capture a shared_ptr reference into the RPC callback so that we're guaranteed
   // that this object outlives the RPC.
-  proxy_->UpdateAsync(&request_, &response_, &controller_,
-                      [s_this = shared_from_this()]() {
-                        s_this->ProcessResponse();
-                      });
+  auto callback = [s_this = shared_from_this(), rpc]() {
+    s_this->ProcessResponse(rpc);
+  };
+  if (req_has_ops) {
+    proxy_->UpdateAsync(request, &rpc->response, &rpc->controller, callback);
+  } else {
+    proxy_->HeartbeatAsync(request, &rpc->response, &rpc->controller, callback);
+  }
+  if (fill_pipeline) {
+    WARN_NOT_OK(SignalRequest(), "Unable to pipeline the next request to peer");
+  }
 }
 
-void Peer::ProcessResponse() {
+void Peer::ProcessResponse(UpdateRpc* rpc) {
   // Note: This method runs on the reactor thread.
   std::unique_lock<simple_spinlock> lock(peer_lock_);
   if (closed_) {
     return;
   }
-  CHECK(request_pending_);
+  CHECK(rpc->in_flight);
 
   MAYBE_FAULT(FLAGS_fault_crash_after_leader_request_fraction);
 
-  if (!controller_.status().ok()) {
-    if (controller_.status().IsRemoteError()) {
+  const ConsensusResponsePB& response = rpc->response;
+  if (!rpc->controller.status().ok()) {
+    if (rpc->controller.status().IsRemoteError()) {
       // Most controller errors are caused by network issues or corner cases
       // like shutdown and failure to serialize a protobuf. Therefore, we
       // generally consider these errors to indicate an unreachable peer.
@@ -259,20 +336,20 @@ void Peer::ProcessResponse() {
       // the queue know that the remote is responsive.
       queue_->NotifyPeerIsResponsiveDespiteError(peer_pb_.permanent_uuid());
     }
-    ProcessResponseError(controller_.status());
+    ProcessResponseError(rpc, rpc->controller.status());
     return;
   }
 
   // Pass through errors we can respond to, like not found, since in that case
   // we will need to start a Tablet Copy. TODO: Handle DELETED response once implemented.
-  if ((response_.has_error() &&
-      response_.error().code() != TabletServerErrorPB::TABLET_NOT_FOUND) ||
-      (response_.status().has_error() &&
-          response_.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE)) {
+  if ((response.has_error() &&
+      response.error().code() != TabletServerErrorPB::TABLET_NOT_FOUND) ||
+      (response.status().has_error() &&
+          response.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE)) {
     // Again, let the queue know that the remote is still responsive, since we
     // will not be sending this error response through to the queue.
     queue_->NotifyPeerIsResponsiveDespiteError(peer_pb_.permanent_uuid());
-    ProcessResponseError(StatusFromPB(response_.error().status()));
+    ProcessResponseError(rpc, StatusFromPB(response.error().status()));
     return;
   }
 
@@ -280,29 +357,35 @@ void Peer::ProcessResponse() {
   // the WAL) and SendNextRequest() may do the same thing. So we run the rest
   // of the response handling logic on our thread pool and not on the reactor
   // thread.
-  Status s = thread_pool_->SubmitFunc([s_this = shared_from_this()]() {
-      s_this->DoProcessResponse();
+  Status s = thread_pool_->SubmitFunc([s_this = shared_from_this(), rpc]() {
+      s_this->DoProcessResponse(rpc);
     });
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to process peer response: " << s.ToString()
-        << ": " << SecureShortDebugString(response_);
-    request_pending_ = false;
+        << ": " << SecureShortDebugString(response);
+    rpc->in_flight = false;
+    requests_pending_--;
+    queue_->RewindPeerNextIndex(peer_pb_.permanent_uuid());
   }
 }
 
-void Peer::DoProcessResponse() {
+void Peer::DoProcessResponse(UpdateRpc* rpc) {
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Response from peer " << peer_pb().permanent_uuid() << ": "
-      << SecureShortDebugString(response_);
+      << SecureShortDebugString(rpc->response);
 
   bool more_pending;
-  queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), response_, &more_pending);
+  queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), rpc->response, &more_pending);
+  if (!rpc->response.has_error() && !rpc->response.status().has_error()) {
+    queue_->RecordLeaseGrant(peer_pb_.permanent_uuid(), rpc->send_time);
+  }
 
   {
     std::unique_lock<simple_spinlock> lock(peer_lock_);
-    CHECK(request_pending_);
+    CHECK(rpc->in_flight);
     failed_attempts_ = 0;
-    request_pending_ = false;
+    rpc->in_flight = false;
+    requests_pending_--;
   }
   // We're OK to read the state_ without a lock here -- if we get a race,
   // the worst thing that could happen is that we'll make one more request before
@@ -330,11 +413,11 @@ void Peer::ProcessTabletCopyResponse() {
     if (closed_) {
       return;
     }
-    CHECK(request_pending_);
-    request_pending_ = false;
+    CHECK(tablet_copy_pending_);
+    tablet_copy_pending_ = false;
   }
 
-  if (controller_.status().ok() && tc_response_.has_error()) {
+  if (tc_controller_.status().ok() && tc_response_.has_error()) {
     // ALREADY_INPROGRESS is expected, so we do not log this error.
     if (tc_response_.error().code() ==
         TabletServerErrorPB::TabletServerErrorPB::ALREADY_INPROGRESS) {
@@ -346,13 +429,13 @@ void Peer::ProcessTabletCopyResponse() {
   }
 }
 
-void Peer::ProcessResponseError(const Status& status) {
+void Peer::ProcessResponseError(UpdateRpc* rpc, const Status& status) {
   failed_attempts_++;
   string resp_err_info;
-  if (response_.has_error()) {
+  if (rpc->response.has_error()) {
     resp_err_info = Substitute(" Error code: $0 ($1).",
-                               TabletServerErrorPB::Code_Name(response_.error().code()),
-                               response_.error().code());
+                               TabletServerErrorPB::Code_Name(rpc->response.error().code()),
+                               rpc->response.error().code());
   }
   LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Couldn't send request to peer " << peer_pb_.permanent_uuid()
       << " for tablet " << tablet_id_ << "."
@@ -360,7 +443,11 @@ void Peer::ProcessResponseError(const Status& status) {
       << " Status: " << status.ToString() << "."
       << " Retrying in the next heartbeat period."
       << " Already tried " << failed_attempts_ << " times.";
-  request_pending_ = false;
+  rpc->in_flight = false;
+  requests_pending_--;
+  // Any requests pipelined behind this one will fail to apply at the peer,
+  // so the ops must be sent again from the last one it acknowledged.
+  queue_->RewindPeerNextIndex(peer_pb_.permanent_uuid());
 }
 
 string Peer::LogPrefixUnlocked() const {
@@ -386,14 +473,18 @@ void Peer::Close() {
 Peer::~Peer() {
   Close();
   // We don't own the ops (the queue does).
-  request_.mutable_ops()->ExtractSubrange(0, request_.ops_size(), nullptr);
+  for (const auto& rpc : rpcs_) {
+    rpc->request.mutable_ops()->ExtractSubrange(0, rpc->request.ops_size(), nullptr);
+  }
 }
 
 
 RpcPeerProxy::RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy)
+                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+                           shared_ptr<MultiRaftHeartbeatBatcher> batcher)
     : hostport_(std::move(hostport)),
-      consensus_proxy_(std::move(consensus_proxy)) {
+      consensus_proxy_(std::move(consensus_proxy)),
+      batcher_(std::move(batcher)) {
 }
 
 void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
@@ -404,6 +495,17 @@ void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
   consensus_proxy_->UpdateConsensusAsync(*request, response, controller, callback);
 }
 
+void RpcPeerProxy::HeartbeatAsync(const ConsensusRequestPB* request,
+                                  ConsensusResponsePB* response,
+                                  rpc::RpcController* controller,
+                                  const rpc::ResponseCallback& callback) {
+  if (batcher_ && FLAGS_consensus_batch_heartbeats) {
+    batcher_->HeartbeatAsync(request, response, controller, callback);
+    return;
+  }
+  UpdateAsync(request, response, controller, callback);
+}
+
 void RpcPeerProxy::RequestConsensusVoteAsync(const VoteRequestPB* request,
                                              VoteResponsePB* response,
                                              rpc::RpcController* controller,
@@ -447,7 +549,9 @@ Status RpcPeerProxyFactory::NewProxy(const RaftPeerPB& peer_pb,
   RETURN_NOT_OK(HostPortFromPB(peer_pb.last_known_addr(), hostport.get()));
   gscoped_ptr<ConsensusServiceProxy> new_proxy;
   RETURN_NOT_OK(CreateConsensusServiceProxyForHost(messenger_, *hostport, &new_proxy));
-  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy)));
+  shared_ptr<MultiRaftHeartbeatBatcher> batcher;
+  RETURN_NOT_OK(MultiRaftHeartbeatBatcher::GetOrCreate(messenger_, *hostport, &batcher));
+  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy), std::move(batcher)));
   return Status::OK();
 }
 
@@ -29,6 +29,7 @@
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/resettable_heartbeater.h"
 #include "kudu/util/semaphore.h"
 #include "kudu/util/status.h"
@@ -48,6 +49,7 @@ class RpcController;
 
 namespace consensus {
 class ConsensusServiceProxy;
+class MultiRaftHeartbeatBatcher;
 class OpId;
 class PeerProxy;
 class PeerProxyFactory;
@@ -57,11 +59,17 @@ class VoteResponsePB;
 
 // A remote peer in consensus.
 //
-// Leaders use peers to update the remote replicas. Each peer
+// Leaders use peers to update the remote replicas. By default, each peer
 // may have at most one outstanding request at a time. If a
 // request is signaled when there is already one outstanding,
 // the request will be generated once the outstanding one finishes.
 //
+// If --consensus_max_inflight_requests_per_peer is greater than one, the
+// peer pipelines its requests: while the exchanges with the remote replica
+// succeed, it sends the following batches of ops without waiting for the
+// responses to the previous ones, up to that many requests at a time. The
+// queue rewinds the ops to send if a request fails or is rejected.
+//
 // Peers are owned by the consensus implementation and do not keep
 // state aside from the most recent request and response.
 //
@@ -118,16 +126,35 @@ class Peer : public std::enable_shared_from_this<Peer> {
        gscoped_ptr<PeerProxy> proxy, PeerMessageQueue* queue,
        ThreadPool* thread_pool);
 
+  // The state of a consensus update RPC to the peer.
+  struct UpdateRpc {
+    ConsensusRequestPB request;
+    ConsensusResponsePB response;
+    rpc::RpcController controller;
+
+    // Reference-counted pointers to any ReplicateMsgs which are in-flight to the peer. We
+    // may have loaded these messages from the LogCache, in which case we are potentially
+    // sharing the same object as other peers. Since the PB request itself can't hold
+    // reference counts, this holds them.
+    std::vector<ReplicateRefPtr> replicate_msg_refs;
+
+    // Whether the RPC was sent and its response has not been handled yet.
+    bool in_flight = false;
+
+    // The time at which the request was sent.
+    MonoTime send_time;
+  };
+
   void SendNextRequest(bool even_if_queue_empty);
 
-  // Signals that a response was received from the peer.
+  // Signals that a response to 'rpc' was received from the peer.
   // This method is called from the reactor thread and calls
   // DoProcessResponse() on thread_pool_ to do any work that requires IO or
   // lock-taking.
-  void ProcessResponse();
+  void ProcessResponse(UpdateRpc* rpc);
 
   // Run on 'thread_pool'. Does response handling that requires IO or may block.
-  void DoProcessResponse();
+  void DoProcessResponse(UpdateRpc* rpc);
 
   // Fetch the desired tablet copy request from the queue and set up
   // tc_request_ appropriately.
@@ -139,8 +166,8 @@ class Peer : public std::enable_shared_from_this<Peer> {
   // Handle RPC callback from initiating tablet copy.
   void ProcessTabletCopyResponse();
 
-  // Signals there was an error sending the request to the peer.
-  void ProcessResponseError(const Status& status);
+  // Signals there was an error sending the request of 'rpc' to the peer.
+  void ProcessResponseError(UpdateRpc* rpc, const Status& status);
 
   std::string LogPrefixUnlocked() const;
 
@@ -156,21 +183,17 @@ class Peer : public std::enable_shared_from_this<Peer> {
   PeerMessageQueue* queue_;
   uint64_t failed_attempts_;
 
-  // The latest consensus update request and response.
-  ConsensusRequestPB request_;
-  ConsensusResponsePB response_;
+  // The consensus update RPCs to the peer, which are reused for subsequent
+  // requests. There is more than one only if requests are pipelined.
+  std::vector<std::unique_ptr<UpdateRpc>> rpcs_;
+
+  // The committed index carried by the latest consensus update request.
+  int64_t last_request_committed_index_;
 
   // The latest tablet copy request and response.
   StartTabletCopyRequestPB tc_request_;
   StartTabletCopyResponsePB tc_response_;
-
-  // Reference-counted pointers to any ReplicateMsgs which are in-flight to the peer. We
-  // may have loaded these messages from the LogCache, in which case we are potentially
-  // sharing the same object as other peers. Since the PB request_ itself can't hold
-  // reference counts, this holds them.
-  std::vector<ReplicateRefPtr> replicate_msg_refs_;
-
-  rpc::RpcController controller_;
+  rpc::RpcController tc_controller_;
 
   // Heartbeater for remote peer implementations.
   // This will send status only requests to the remote peers
@@ -183,7 +206,9 @@ class Peer : public std::enable_shared_from_this<Peer> {
 
   // lock that protects Peer state changes, initialization, etc.
   mutable simple_spinlock peer_lock_;
-  bool request_pending_ = false;
+  // The number of consensus update RPCs in flight.
+  int requests_pending_ = 0;
+  bool tablet_copy_pending_ = false;
   bool closed_ = false;
   bool has_sent_first_request_ = false;
 
@@ -200,6 +225,16 @@ class PeerProxy {
                            rpc::RpcController* controller,
                            const rpc::ResponseCallback& callback) = 0;
 
+  // Sends a status-only request, asynchronously, to a remote peer. Unlike
+  // UpdateAsync(), the request may be delayed to be sent along with the
+  // requests to other replicas hosted by the same server.
+  virtual void HeartbeatAsync(const ConsensusRequestPB* request,
+                              ConsensusResponsePB* response,
+                              rpc::RpcController* controller,
+                              const rpc::ResponseCallback& callback) {
+    UpdateAsync(request, response, controller, callback);
+  }
+
   // Sends a RequestConsensusVote to a remote peer.
   virtual void RequestConsensusVoteAsync(const VoteRequestPB* request,
                                          VoteResponsePB* response,
@@ -231,14 +266,22 @@ class PeerProxyFactory {
 // PeerProxy implementation that does RPC calls
 class RpcPeerProxy : public PeerProxy {
  public:
+  // 'batcher' is used to batch heartbeats if --consensus_batch_heartbeats
+  // is set, and may be null.
   RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-               gscoped_ptr<ConsensusServiceProxy> consensus_proxy);
+               gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+               std::shared_ptr<MultiRaftHeartbeatBatcher> batcher = nullptr);
 
   virtual void UpdateAsync(const ConsensusRequestPB* request,
                            ConsensusResponsePB* response,
                            rpc::RpcController* controller,
                            const rpc::ResponseCallback& callback) OVERRIDE;
 
+  virtual void HeartbeatAsync(const ConsensusRequestPB* request,
+                              ConsensusResponsePB* response,
+                              rpc::RpcController* controller,
+                              const rpc::ResponseCallback& callback) OVERRIDE;
+
   virtual void RequestConsensusVoteAsync(const VoteRequestPB* request,
                                          VoteResponsePB* response,
                                          rpc::RpcController* controller,
@@ -254,6 +297,7 @@ class RpcPeerProxy : public PeerProxy {
  private:
   gscoped_ptr<HostPort> hostport_;
   gscoped_ptr<ConsensusServiceProxy> consensus_proxy_;
+  std::shared_ptr<MultiRaftHeartbeatBatcher> batcher_;
 };
 
 // PeerProxyFactory implementation that generates RPCPeerProxies
@@ -303,6 +303,109 @@ TEST_F(ConsensusQueueTest, TestGetPagedMessages) {
   request.mutable_ops()->ExtractSubrange(0, request.ops_size(), nullptr);
 }
 
+// Tests that pipelined requests to a peer carry consecutive batches of ops,
+// that out-of-order responses don't move the peer backwards, and that the
+// queue rewinds to the last acknowledged op when a request fails.
+TEST_F(ConsensusQueueTest, TestPipelinedRequests) {
+  queue_->Init(MinimumOpId(), MinimumOpId());
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(2));
+
+  ConsensusRequestPB page_size_estimator;
+  page_size_estimator.set_caller_term(14);
+  page_size_estimator.set_committed_index(0);
+  page_size_estimator.set_all_replicated_index(0);
+  page_size_estimator.mutable_preceding_id()->CopyFrom(MinimumOpId());
+  const int kOpsPerRequest = 9;
+  for (int i = 0; i < kOpsPerRequest; i++) {
+    page_size_estimator.mutable_ops()->AddAllocated(
+        CreateDummyReplicate(0, 0, clock_->Now(), 0).release());
+  }
+  google::FlagSaver saver;
+  FLAGS_consensus_max_batch_size_bytes = page_size_estimator.ByteSize();
+
+  ConsensusRequestPB request;
+  ConsensusResponsePB response;
+  response.set_responder_uuid(kPeerUuid);
+  bool more_pending = false;
+  UpdatePeerWatermarkToOp(&request, &response, MinimumOpId(), MinimumOpId(), &more_pending);
+  ASSERT_TRUE(more_pending);
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 100);
+
+  // Send two requests without waiting for their responses.
+  ConsensusRequestPB requests[2];
+  vector<ReplicateRefPtr> refs[2];
+  bool needs_tablet_copy;
+  for (int i = 0; i < 2; i++) {
+    ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &requests[i], &refs[i], &needs_tablet_copy));
+    ASSERT_FALSE(needs_tablet_copy);
+    ASSERT_EQ(kOpsPerRequest, requests[i].ops_size());
+    ASSERT_EQ(i * kOpsPerRequest + 1, requests[i].ops(0).id().index());
+    queue_->AdvancePeerNextIndex(kPeerUuid, requests[i]);
+  }
+
+  // The response to the second request arrives first.
+  SetLastReceivedAndLastCommitted(&response, requests[1].ops(kOpsPerRequest - 1).id());
+  queue_->ResponseFromPeer(response.responder_uuid(), response, &more_pending);
+  ASSERT_TRUE(more_pending);
+  PeerMessageQueue::TrackedPeer peer = queue_->GetTrackedPeerForTests(kPeerUuid);
+  ASSERT_EQ(2 * kOpsPerRequest, peer.last_received.index());
+  ASSERT_EQ(2 * kOpsPerRequest + 1, peer.next_index);
+
+  // The stale response to the first request must not move the peer backwards.
+  SetLastReceivedAndLastCommitted(&response, requests[0].ops(kOpsPerRequest - 1).id());
+  queue_->ResponseFromPeer(response.responder_uuid(), response, &more_pending);
+  peer = queue_->GetTrackedPeerForTests(kPeerUuid);
+  ASSERT_EQ(2 * kOpsPerRequest, peer.last_received.index());
+  ASSERT_EQ(2 * kOpsPerRequest + 1, peer.next_index);
+
+  // Pipeline two more requests, and fail the first one: the queue rewinds to
+  // the ops following the last acknowledged one.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &requests[i], &refs[i], &needs_tablet_copy));
+    ASSERT_EQ((i + 2) * kOpsPerRequest + 1, requests[i].ops(0).id().index());
+    queue_->AdvancePeerNextIndex(kPeerUuid, requests[i]);
+  }
+  queue_->RewindPeerNextIndex(kPeerUuid);
+  ASSERT_OK(queue_->RequestForPeer(kPeerUuid, &requests[0], &refs[0], &needs_tablet_copy));
+  ASSERT_EQ(2 * kOpsPerRequest + 1, requests[0].ops(0).id().index());
+
+  // extract the ops from the requests to avoid double free
+  for (ConsensusRequestPB& r : requests) {
+    r.mutable_ops()->ExtractSubrange(0, r.ops_size(), nullptr);
+  }
+}
+
+// Tests that the leader lease is granted from the time of the latest request
+// accepted by a majority of the voters, and is lost when the term changes.
+TEST_F(ConsensusQueueTest, TestMajorityLeaseGrantTime) {
+  queue_->Init(MinimumOpId(), MinimumOpId());
+  ASSERT_EQ(MonoTime::Min(), queue_->GetMajorityLeaseGrantTime());
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(3));
+  queue_->TrackPeer("peer-1");
+  queue_->TrackPeer("peer-2");
+
+  // The leader alone is not a majority.
+  ASSERT_EQ(MonoTime::Min(), queue_->GetMajorityLeaseGrantTime());
+
+  MonoTime t1 = MonoTime::Now();
+  MonoTime t2 = t1 + MonoDelta::FromMilliseconds(10);
+  queue_->RecordLeaseGrant("peer-1", t1);
+  ASSERT_EQ(t1, queue_->GetMajorityLeaseGrantTime());
+  queue_->RecordLeaseGrant("peer-2", t2);
+  ASSERT_EQ(t2, queue_->GetMajorityLeaseGrantTime());
+
+  // Grants never move backwards.
+  queue_->RecordLeaseGrant("peer-2", t1);
+  ASSERT_EQ(t2, queue_->GetMajorityLeaseGrantTime());
+
+  // A new term voids the grants of the previous one.
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm + 1, BuildRaftConfigPBForTests(3));
+  ASSERT_EQ(MonoTime::Min(), queue_->GetMajorityLeaseGrantTime());
+
+  queue_->SetNonLeaderMode();
+  ASSERT_EQ(MonoTime::Min(), queue_->GetMajorityLeaseGrantTime());
+}
+
 TEST_F(ConsensusQueueTest, TestPeersDontAckBeyondWatermarks) {
   queue_->Init(MinimumOpId(), MinimumOpId());
   queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, BuildRaftConfigPBForTests(3));
@@ -447,6 +550,42 @@ TEST_F(ConsensusQueueTest, TestQueueAdvancesCommittedIndex) {
   ASSERT_EQ(queue_->GetAllReplicatedIndex(), 5);
 }
 
+// Test that non-voters don't count towards the majority which replicates
+// an operation, though they do count towards the operations replicated
+// everywhere.
+TEST_F(ConsensusQueueTest, TestNonVotersDontCountTowardsMajority) {
+  queue_->Init(MinimumOpId(), MinimumOpId());
+  RaftConfigPB config = BuildRaftConfigPBForTests(4);
+  config.mutable_peers(3)->set_member_type(RaftPeerPB::NON_VOTER);
+  queue_->SetLeaderMode(kMinimumOpIdIndex, kMinimumTerm, config);
+  queue_->TrackPeer("peer-1");
+  queue_->TrackPeer("peer-2");
+  queue_->TrackPeer("peer-3");
+
+  AppendReplicateMessagesToQueue(queue_.get(), clock_, 1, 10);
+  WaitForLocalPeerToAckIndex(10);
+
+  ConsensusResponsePB response;
+  response.set_responder_term(1);
+  SetLastReceivedAndLastCommitted(&response, MakeOpId(1, 10), MinimumOpId().index());
+  bool more_pending;
+
+  // The local peer and the non-voter aren't a majority of the three voters.
+  response.set_responder_uuid("peer-3");
+  queue_->ResponseFromPeer(response.responder_uuid(), response, &more_pending);
+  ASSERT_EQ(0, queue_->GetMajorityReplicatedIndexForTests());
+
+  // With a second voter, they are.
+  response.set_responder_uuid("peer-1");
+  queue_->ResponseFromPeer(response.responder_uuid(), response, &more_pending);
+  ASSERT_EQ(10, queue_->GetMajorityReplicatedIndexForTests());
+  ASSERT_EQ(0, queue_->GetAllReplicatedIndex());
+
+  response.set_responder_uuid("peer-2");
+  queue_->ResponseFromPeer(response.responder_uuid(), response, &more_pending);
+  ASSERT_EQ(10, queue_->GetAllReplicatedIndex());
+}
+
 // In this test we append a sequence of operations to a log
 // and then start tracking a peer whose first required operation
 // is before the first operation in the queue.
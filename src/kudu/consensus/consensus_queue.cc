@@ -19,11 +19,13 @@
 #include <algorithm>
 #include <boost/optional.hpp>
 #include <boost/optional/optional_io.hpp>
+#include <functional>
 #include <gflags/gflags.h>
 #include <iostream>
 #include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/log.h"
@@ -144,6 +146,10 @@ void PeerMessageQueue::SetLeaderMode(int64_t committed_index,
     CHECK_GT(current_term, queue_state_.current_term) << "Terms should only increase";
     queue_state_.first_index_in_current_term = boost::none;
     queue_state_.current_term = current_term;
+    // Leases are only granted within a term.
+    for (const PeersMap::value_type& entry : peers_map_) {
+      entry.second->last_lease_grant_time = MonoTime::Min();
+    }
   }
 
   queue_state_.committed_index = committed_index;
@@ -505,6 +511,7 @@ void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
                                              const OpId& replicated_before,
                                              const OpId& replicated_after,
                                              int num_peers_required,
+                                             ReplicaTypes replica_types,
                                              const TrackedPeer* who_caused) {
 
   if (VLOG_IS_ON(2)) {
@@ -543,6 +550,10 @@ void PeerMessageQueue::AdvanceQueueWatermark(const char* type,
     // was an error (LMP mismatch, for example), the 'last_received' is _not_ usable
     // for watermark calculation. This could be fixed by separately storing the
     // 'match_index' on a per-peer basis and using that for watermark calculation.
+    if (replica_types == VOTER_REPLICAS &&
+        !IsRaftConfigVoter(peer.first, *queue_state_.active_config)) {
+      continue;
+    }
     if (peer.second->is_last_exchange_successful) {
       watermarks.push_back(peer.second->last_received.index());
     }
@@ -582,6 +593,36 @@ void PeerMessageQueue::UpdateFollowerWatermarks(int64_t committed_index,
   UpdateMetrics();
 }
 
+void PeerMessageQueue::RecordLeaseGrant(const string& uuid, MonoTime request_send_time) {
+  std::lock_guard<simple_spinlock> l(queue_lock_);
+  TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+  if (!peer) return;
+  if (request_send_time > peer->last_lease_grant_time) {
+    peer->last_lease_grant_time = request_send_time;
+  }
+}
+
+MonoTime PeerMessageQueue::GetMajorityLeaseGrantTime() const {
+  std::lock_guard<simple_spinlock> l(queue_lock_);
+  if (queue_state_.mode != LEADER) {
+    return MonoTime::Min();
+  }
+  vector<MonoTime> grant_times;
+  for (const PeersMap::value_type& entry : peers_map_) {
+    if (!IsRaftConfigVoter(entry.first, *queue_state_.active_config)) {
+      continue;
+    }
+    // The leader never votes for another candidate while it leads.
+    grant_times.push_back(entry.first == local_peer_pb_.permanent_uuid() ?
+                          MonoTime::Max() : entry.second->last_lease_grant_time);
+  }
+  if (static_cast<int>(grant_times.size()) < queue_state_.majority_size_) {
+    return MonoTime::Min();
+  }
+  std::sort(grant_times.begin(), grant_times.end(), std::greater<MonoTime>());
+  return grant_times[queue_state_.majority_size_ - 1];
+}
+
 void PeerMessageQueue::NotifyPeerIsResponsiveDespiteError(const std::string& peer_uuid) {
   std::lock_guard<simple_spinlock> l(queue_lock_);
   TrackedPeer* peer = FindPtrOrNull(peers_map_, peer_uuid);
@@ -589,6 +630,25 @@ void PeerMessageQueue::NotifyPeerIsResponsiveDespiteError(const std::string& pee
   peer->last_successful_communication_time = MonoTime::Now();
 }
 
+void PeerMessageQueue::AdvancePeerNextIndex(const string& uuid,
+                                            const ConsensusRequestPB& request) {
+  DCHECK_GT(request.ops_size(), 0);
+  std::lock_guard<simple_spinlock> l(queue_lock_);
+  TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+  // If the peer was rewound since the request was assembled, leave it be.
+  if (!peer || peer->is_new || request.preceding_id().index() + 1 != peer->next_index) return;
+  peer->last_pipelined_index = request.ops(request.ops_size() - 1).id().index();
+  peer->next_index = peer->last_pipelined_index + 1;
+}
+
+void PeerMessageQueue::RewindPeerNextIndex(const string& uuid) {
+  std::lock_guard<simple_spinlock> l(queue_lock_);
+  TrackedPeer* peer = FindPtrOrNull(peers_map_, uuid);
+  if (!peer || peer->last_pipelined_index == kInvalidOpIdIndex) return;
+  peer->last_pipelined_index = peer->last_received.index();
+  peer->next_index = peer->last_pipelined_index + 1;
+}
+
 void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                                         const ConsensusResponsePB& response,
                                         bool* more_pending) {
@@ -657,10 +717,23 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
     // is guaranteed by the Raft protocol to be a valid op.
 
     bool peer_has_prefix_of_log = IsOpInLog(status.last_received());
-    if (peer_has_prefix_of_log) {
+    if (peer_has_prefix_of_log && !status.has_error() &&
+        previous.last_pipelined_index != kInvalidOpIdIndex) {
+      // Requests to the peer are pipelined. Responses may be processed out of
+      // order, so a stale response must not move the peer backwards, and the
+      // ops sent after the acknowledged ones are still in flight.
+      if (status.last_received().index() >= previous.last_received.index()) {
+        peer->last_received = status.last_received();
+      }
+      peer->last_pipelined_index = std::max(previous.last_pipelined_index,
+                                            peer->last_received.index());
+      peer->next_index = peer->last_pipelined_index + 1;
+
+    } else if (peer_has_prefix_of_log) {
       // If the latest thing in their log is in our log, we are in sync.
       peer->last_received = status.last_received();
       peer->next_index = peer->last_received.index() + 1;
+      peer->last_pipelined_index = kInvalidOpIdIndex;
 
     } else if (!OpIdEquals(status.last_received_current_leader(), MinimumOpId())) {
       // Their log may have diverged from ours, however we are in the process
@@ -668,6 +741,7 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
       // will cause the divergent entry in their log to be overwritten.
       peer->last_received = status.last_received_current_leader();
       peer->next_index = peer->last_received.index() + 1;
+      peer->last_pipelined_index = kInvalidOpIdIndex;
 
     } else {
       // The peer is divergent and they have not (successfully) received
@@ -678,6 +752,7 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
       // the hope that doing so will result in a faster catch-up process.
       DCHECK_GE(peer->last_known_committed_index, 0);
       peer->next_index = peer->last_known_committed_index + 1;
+      peer->last_pipelined_index = kInvalidOpIdIndex;
       LOG_WITH_PREFIX_UNLOCKED(INFO)
           << "Peer " << peer_uuid << " log is divergent from this leader: "
           << "its last log entry " << OpIdToString(status.last_received()) << " is not in "
@@ -746,6 +821,7 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                             previous.last_received,
                             peer->last_received,
                             queue_state_.majority_size_,
+                            VOTER_REPLICAS,
                             peer);
 
       // Advance the all replicated index.
@@ -754,6 +830,7 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                             previous.last_received,
                             peer->last_received,
                             peers_map_.size(),
+                            ALL_REPLICAS,
                             peer);
 
       // If the majority-replicated index is in our current term,
@@ -884,6 +961,16 @@ void PeerMessageQueue::Close() {
   ClearUnlocked();
 }
 
+void PeerMessageQueue::EvictCommittedOps() {
+  int64_t committed_index;
+  {
+    std::lock_guard<simple_spinlock> lock(queue_lock_);
+    committed_index = queue_state_.committed_index;
+  }
+  // Ops which aren't durable yet, or are being sent to peers, are kept.
+  log_cache_.EvictThroughOp(committed_index);
+}
+
 int64_t PeerMessageQueue::GetQueuedOperationsSizeBytesForTests() const {
   return log_cache_.BytesUsed();
 }
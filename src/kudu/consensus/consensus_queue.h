@@ -63,9 +63,7 @@ extern const char kConsensusQueueParentTrackerId[];
 //
 // This class is used only on the LEADER side.
 //
-// TODO(todd): Right now this class is able to track one outstanding operation
-// per peer. If we want to have more than one outstanding RPC we need to
-// modify it.
+// Requests to a peer may be pipelined: see AdvancePeerNextIndex().
 class PeerMessageQueue {
  public:
   struct TrackedPeer {
@@ -73,10 +71,12 @@ class PeerMessageQueue {
         : uuid(std::move(uuid)),
           is_new(true),
           next_index(kInvalidOpIdIndex),
+          last_pipelined_index(kInvalidOpIdIndex),
           last_received(MinimumOpId()),
           last_known_committed_index(MinimumOpId().index()),
           is_last_exchange_successful(false),
           last_successful_communication_time(MonoTime::Now()),
+          last_lease_grant_time(MonoTime::Min()),
           needs_tablet_copy(false),
           last_seen_term_(0) {}
 
@@ -99,6 +99,11 @@ class PeerMessageQueue {
     // This corresponds to "nextIndex" as specified in Raft.
     int64_t next_index;
 
+    // The index of the last op sent to the peer in a pipelined request, or
+    // kInvalidOpIdIndex if requests to the peer are not pipelined. Reset when
+    // the peer rejects a request.
+    int64_t last_pipelined_index;
+
     // The last operation that we've sent to this peer and that
     // it acked. Used for watermark movement.
     OpId last_received;
@@ -114,6 +119,12 @@ class PeerMessageQueue {
     // successful communication ever took place.
     MonoTime last_successful_communication_time;
 
+    // The time at which the leader sent the latest request of its current
+    // term which the peer accepted. Upon accepting a request, a peer withholds
+    // its vote from other candidates for at least the minimum election
+    // timeout, which grants the leader a lease from this time on.
+    MonoTime last_lease_grant_time;
+
     // Whether the follower was detected to need tablet copy.
     bool needs_tablet_copy;
 
@@ -222,6 +233,29 @@ class PeerMessageQueue {
   Status GetTabletCopyRequestForPeer(const std::string& uuid,
                                      StartTabletCopyRequestPB* req);
 
+  // Optimistically advances the next index of the peer with 'uuid' past the
+  // ops of 'request', which was just assembled for it and carries ops, so
+  // that the next request for the peer carries the following ops without
+  // waiting for the response to this one.
+  //
+  // ResponseFromPeer() keeps the advanced index as long as the peer responds
+  // successfully, and rewinds it to the peer's last received op otherwise.
+  void AdvancePeerNextIndex(const std::string& uuid, const ConsensusRequestPB& request);
+
+  // Rewinds the next index of the peer with 'uuid' to just after the last op
+  // it is known to have received, discarding any optimistic advancement.
+  // Called when a pipelined request to the peer failed to be delivered.
+  void RewindPeerNextIndex(const std::string& uuid);
+
+  // Records that the peer with 'uuid' accepted a request of the current term
+  // which was sent at 'request_send_time'.
+  void RecordLeaseGrant(const std::string& uuid, MonoTime request_send_time);
+
+  // Returns the latest time such that a majority of the voters, including
+  // the leader itself, accepted a request sent no earlier, or MonoTime::Min()
+  // if there is no such time or the queue is not in leader mode.
+  MonoTime GetMajorityLeaseGrantTime() const;
+
   // Update the last successful communication timestamp for the given peer
   // to the current time. This should be called when a non-network related
   // error is received from the peer, indicating that it is alive, even if it
@@ -245,6 +279,9 @@ class PeerMessageQueue {
   // queued.
   void Close();
 
+  // Evicts the operations up to the committed index from the log cache.
+  void EvictCommittedOps();
+
   int64_t GetQueuedOperationsSizeBytesForTests() const;
 
   // Returns the last message replicated by all peers.
@@ -397,12 +434,20 @@ class PeerMessageQueue {
                                const StatusCallback& callback,
                                const Status& status);
 
-  // Advances 'watermark' to the smallest op that 'num_peers_required' have.
+  // The peers whose progress a watermark depends on.
+  enum ReplicaTypes {
+    ALL_REPLICAS,
+    VOTER_REPLICAS
+  };
+
+  // Advances 'watermark' to the smallest op that 'num_peers_required' of the
+  // peers of 'replica_types' have.
   void AdvanceQueueWatermark(const char* type,
                              int64_t* watermark,
                              const OpId& replicated_before,
                              const OpId& replicated_after,
                              int num_peers_required,
+                             ReplicaTypes replica_types,
                              const TrackedPeer* who_caused);
 
   std::vector<PeerMessageQueueObserver*> observers_;
@@ -157,6 +157,8 @@ LeaderElection::LeaderElection(const RaftConfigPB& config,
       highest_voter_term_(0) {
   for (const RaftPeerPB& peer : config.peers()) {
     if (request.candidate_uuid() == peer.permanent_uuid()) continue;
+    // Only voters are asked for their votes.
+    if (peer.member_type() != RaftPeerPB::VOTER) continue;
     follower_uuids_.push_back(peer.permanent_uuid());
 
     gscoped_ptr<VoterState> state(new VoterState());
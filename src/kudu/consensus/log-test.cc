@@ -37,6 +37,10 @@
 DEFINE_int32(num_batches, 10000,
              "Number of batches to write to/read from the Log in TestWriteManyBatches");
 
+DECLARE_int32(log_append_threads);
+DECLARE_int32(log_append_max_batches_per_task);
+DECLARE_bool(log_group_syncs_by_dir);
+DECLARE_int32(log_reader_read_ahead_batches);
 DECLARE_int32(log_min_segments_to_retain);
 DECLARE_int32(log_max_segments_to_retain);
 DECLARE_double(log_inject_io_error_on_preallocate_fraction);
@@ -741,6 +745,57 @@ TEST_P(LogTestOptionalCompression, TestWriteManyBatches) {
   }
 }
 
+// Test that entries appended on the shared append pool are all written
+// and synced, including those still queued when the log is closed.
+TEST_P(LogTestOptionalCompression, TestSharedAppendPool) {
+  FLAGS_log_append_threads = 2;
+  options_.force_fsync_all = true;
+  ASSERT_OK(BuildLog());
+
+  const int kNumBatches = 100;
+  AppendReplicateBatchAndCommitEntryPairsToLog(kNumBatches);
+  ASSERT_OK(log_->Close());
+
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), NULL, kTestTablet, NULL, &reader));
+  vector<scoped_refptr<ReadableLogSegment> > segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  int num_entries = 0;
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    STLDeleteElements(&entries_);
+    ASSERT_OK(segment->ReadEntries(&entries_));
+    num_entries += entries_.size();
+  }
+  ASSERT_EQ(kNumBatches * 2, num_entries);
+}
+
+// Test appending through the shared append pool when each log yields its
+// thread after a few batches and the syncs are grouped by WAL directory.
+TEST_P(LogTestOptionalCompression, TestSharedAppendPoolWithGroupedSyncs) {
+  FLAGS_log_append_threads = 2;
+  FLAGS_log_append_max_batches_per_task = 2;
+  FLAGS_log_group_syncs_by_dir = true;
+  options_.force_fsync_all = true;
+  ASSERT_OK(BuildLog());
+
+  const int kNumBatches = 100;
+  AppendReplicateBatchAndCommitEntryPairsToLog(kNumBatches, false);
+  ASSERT_OK(log_->WaitUntilAllFlushed());
+  ASSERT_OK(log_->Close());
+
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), NULL, kTestTablet, NULL, &reader));
+  vector<scoped_refptr<ReadableLogSegment> > segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  int num_entries = 0;
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    STLDeleteElements(&entries_);
+    ASSERT_OK(segment->ReadEntries(&entries_));
+    num_entries += entries_.size();
+  }
+  ASSERT_EQ(kNumBatches * 2, num_entries);
+}
+
 // This tests that querying LogReader works.
 // This sets up a reader with some segments to query which amount to the
 // following:
@@ -999,6 +1054,64 @@ TEST_P(LogTestOptionalCompression, TestReadLogWithReplacedReplicates) {
   }
 }
 
+// Test reading ranges of operations which span several batches and segments
+// when the batches are read ahead of their consumption.
+TEST_P(LogTestOptionalCompression, TestReadReplicatesWithReadAhead) {
+  FLAGS_log_reader_read_ahead_batches = 3;
+  ASSERT_OK(BuildLog());
+
+  // Write 4 segments of 5 batches of 3 operations each.
+  const int kNumSegments = 4;
+  const int kNumBatchesPerSegment = 5;
+  const int kOpsPerBatch = 3;
+  OpId op_id = MakeOpId(1, 1);
+  for (int seg = 0; seg < kNumSegments; seg++) {
+    for (int b = 0; b < kNumBatchesPerSegment; b++) {
+      ASSERT_OK(AppendNoOpsToLogSync(clock_, log_.get(), &op_id, kOpsPerBatch));
+    }
+    if (seg < kNumSegments - 1) {
+      ASSERT_OK(RollLog());
+    }
+  }
+  const int64_t max_index = op_id.index() - 1;
+
+  shared_ptr<LogReader> reader = log_->reader();
+  for (int64_t start : { 1, 2, 14, 15, 16 }) {
+    for (int64_t end : { start, start + 1, max_index - 1, max_index }) {
+      SCOPED_TRACE(Substitute("Reading $0-$1", start, end));
+      vector<ReplicateMsg*> repls;
+      ElementDeleter d(&repls);
+      ASSERT_OK(reader->ReadReplicatesInRange(start, end, LogReader::kNoSizeLimit, &repls));
+      ASSERT_EQ(end - start + 1, repls.size());
+      int64_t expected_index = start;
+      for (const ReplicateMsg* repl : repls) {
+        ASSERT_EQ(expected_index++, repl->id().index());
+      }
+    }
+  }
+
+  // An iterator which is destroyed before it is exhausted waits for the
+  // batches it is still reading ahead.
+  {
+    LogReader::ReplicateIterator iter(reader.get(), 1, max_index);
+    unique_ptr<ReplicateMsg> repl;
+    ASSERT_TRUE(iter.HasNext());
+    ASSERT_OK(iter.Next(&repl));
+    ASSERT_EQ(1, repl->id().index());
+  }
+
+  // Reading the batches inline yields the same operations.
+  FLAGS_log_reader_read_ahead_batches = 0;
+  LogReader::ReplicateIterator iter(reader.get(), 2, max_index);
+  int64_t expected_index = 2;
+  while (iter.HasNext()) {
+    unique_ptr<ReplicateMsg> repl;
+    ASSERT_OK(iter.Next(&repl));
+    ASSERT_EQ(expected_index++, repl->id().index());
+  }
+  ASSERT_EQ(max_index + 1, expected_index);
+}
+
 // Test various situations where we expect different segments depending on what the
 // min log index is.
 TEST_F(LogTest, TestGetGCableDataSize) {
@@ -18,10 +18,15 @@
 #include "kudu/consensus/log.h"
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 
+#include <boost/bind.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 
 #include "kudu/common/wire_protocol.h"
@@ -32,6 +37,7 @@
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/walltime.h"
@@ -77,11 +83,55 @@ DEFINE_int32(group_commit_queue_size_bytes, 4 * 1024 * 1024,
              "Maximum size of the group commit queue in bytes");
 TAG_FLAG(group_commit_queue_size_bytes, advanced);
 
+DEFINE_int32(log_append_threads, 0,
+             "Number of threads shared by the logs of all tablets to append and "
+             "sync their entries. If 0, each log has its own append thread.");
+TAG_FLAG(log_append_threads, experimental);
+
+DEFINE_int32(log_append_max_batches_per_task, 0,
+             "Maximum number of entry batches which a log appends and syncs at once "
+             "on the shared append pool before yielding its thread to the logs of "
+             "other tablets. If 0, a log appends all of its ready batches at once. "
+             "Only applies when --log_append_threads is positive.");
+TAG_FLAG(log_append_max_batches_per_task, experimental);
+TAG_FLAG(log_append_max_batches_per_task, runtime);
+
+DEFINE_int32(log_group_commit_max_wait_us, 0,
+             "Maximum time (in microseconds) for which a log holds back a group commit "
+             "for more entries to join it, when entries are arriving concurrently. "
+             "The wait is also bounded by --log_group_commit_wait_sync_ratio times "
+             "the recent sync latency of the log. If 0, a group is appended and "
+             "synced as soon as it is ready. Only applies to logs with their own "
+             "append thread.");
+TAG_FLAG(log_group_commit_max_wait_us, experimental);
+TAG_FLAG(log_group_commit_max_wait_us, runtime);
+
+DEFINE_double(log_group_commit_wait_sync_ratio, 0.5,
+              "Ratio of the recent sync latency of a log for which a group commit may "
+              "be held back for more entries. Higher values favor fewer, larger syncs "
+              "over append latency. See --log_group_commit_max_wait_us.");
+TAG_FLAG(log_group_commit_wait_sync_ratio, experimental);
+TAG_FLAG(log_group_commit_wait_sync_ratio, runtime);
+
+DEFINE_int32(log_group_commit_target_bytes, 1024 * 1024,
+             "Size of a group commit beyond which it is no longer held back for more "
+             "entries. See --log_group_commit_max_wait_us.");
+TAG_FLAG(log_group_commit_target_bytes, experimental);
+TAG_FLAG(log_group_commit_target_bytes, runtime);
+
+DEFINE_bool(log_group_syncs_by_dir, false,
+            "Whether the syncs of the logs in the same WAL directory are issued back "
+            "to back by one thread rather than concurrently by each log's append "
+            "thread, so that the underlying device sees one group of syncs at a time.");
+TAG_FLAG(log_group_syncs_by_dir, experimental);
+TAG_FLAG(log_group_syncs_by_dir, runtime);
+
 
 // Compression configuration.
 // -----------------------------
 DEFINE_string(log_compression_codec, "LZ4",
-              "Codec to use for compressing WAL segments.");
+              "Codec to use for compressing WAL segments. One of 'none', 'snappy', "
+              "'lz4', 'zlib' or 'zstd'.");
 TAG_FLAG(log_compression_codec, experimental);
 
 // Fault/latency injection flags.
@@ -148,13 +198,114 @@ using strings::Substitute;
 
 // This class is responsible for managing the thread that appends to
 // the log file.
+namespace {
+
+// The threads which append and sync the entries of all logs when
+// --log_append_threads is set.
+class LogAppendPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<LogAppendPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<LogAppendPool>;
+
+  LogAppendPool() {
+    CHECK_OK(ThreadPoolBuilder("log-append")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_log_append_threads)
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogAppendPool);
+};
+
+// Groups the syncs of the logs in one WAL directory. The first log to
+// request a sync while none is in progress issues the syncs of all of the
+// logs which requested one so far, one after the other, while the others
+// wait for it. This avoids having the append threads of many tablets sync
+// concurrently to the same device, and lets the filesystem commit its
+// journal once for the whole group.
+class LogSyncGroup {
+ public:
+  // Returns the group of the logs in 'wal_dir'. Groups are never freed.
+  static LogSyncGroup* Get(const string& wal_dir) {
+    static simple_spinlock lock;
+    static auto* groups = new std::unordered_map<string, LogSyncGroup*>();
+    std::lock_guard<simple_spinlock> l(lock);
+    LogSyncGroup*& group = (*groups)[wal_dir];
+    if (!group) {
+      group = new LogSyncGroup();
+    }
+    return group;
+  }
+
+  // Runs 'sync' as part of the next group of syncs and returns its result.
+  Status Sync(const std::function<Status()>& sync) {
+    Request req = { &sync, Status::OK(), false };
+    std::unique_lock<std::mutex> l(lock_);
+    pending_.push_back(&req);
+    while (!req.done) {
+      if (syncing_) {
+        cond_.wait(l);
+        continue;
+      }
+      syncing_ = true;
+      vector<Request*> group;
+      group.swap(pending_);
+      l.unlock();
+      for (Request* r : group) {
+        r->status = (*r->sync)();
+      }
+      l.lock();
+      for (Request* r : group) {
+        r->done = true;
+      }
+      syncing_ = false;
+      cond_.notify_all();
+    }
+    return req.status;
+  }
+
+ private:
+  struct Request {
+    const std::function<Status()>* sync;
+    Status status;
+    bool done;
+  };
+
+  LogSyncGroup() : syncing_(false) {}
+
+  std::mutex lock_;
+  std::condition_variable cond_;
+
+  // The requests waiting for the next group of syncs.
+  vector<Request*> pending_;
+
+  // Whether a group of syncs is being issued.
+  bool syncing_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogSyncGroup);
+};
+
+} // anonymous namespace
+
 class Log::AppendThread {
  public:
   explicit AppendThread(Log* log);
 
-  // Initializes the objects and starts the thread.
+  // Initializes the objects and starts the thread, or, if the log shares
+  // the append pool, obtains a token to submit its tasks to the pool.
   Status Init();
 
+  // Schedules the processing of the entries which are ready in the queue,
+  // if the log shares the append pool. Otherwise, the thread picks them
+  // up by itself.
+  void Wake();
+
   // Waits until the last enqueued elements are processed, sets the
   // Appender thread to closing state. If any entries are added to the
   // queue during the process, invoke their callbacks' 'OnFailure()'
@@ -164,6 +315,22 @@ class Log::AppendThread {
  private:
   void RunThread();
 
+  // Drains the queue without blocking and processes its entries, no more
+  // than --log_append_max_batches_per_task of them. Runs on the shared
+  // append pool.
+  void RunTask();
+
+  // Holds back the group of 'entry_batches' for more batches to join it,
+  // if the previous group had several batches, meaning that entries are
+  // arriving concurrently. The wait is bounded by --log_group_commit_max_wait_us
+  // and by a fraction of the recent sync latency, and ends early once the
+  // group reaches --log_group_commit_target_bytes.
+  void MaybeWaitForMoreBatches(vector<LogEntryBatch*>* entry_batches);
+
+  // Appends the drained 'entry_batches' to the log as a group, syncs the
+  // log, and runs their callbacks.
+  void ProcessBatches(vector<LogEntryBatch*>* entry_batches);
+
   string LogPrefix() const;
 
   Log* const log_;
@@ -171,21 +338,60 @@ class Log::AppendThread {
   // Lock to protect access to thread_ during shutdown.
   mutable std::mutex lock_;
   scoped_refptr<Thread> thread_;
+
+  // The token for the shared append pool, if used instead of thread_.
+  gscoped_ptr<ThreadPoolToken> token_;
+
+  // Whether a task which has yet to drain the queue is submitted to token_.
+  std::atomic<bool> task_scheduled_;
+
+  // The group of the logs in the same WAL directory.
+  LogSyncGroup* sync_group_;
+
+  // The number of batches in the previous group.
+  size_t prev_group_size_;
+
+  // Moving average of the latency of the syncs of the log, in microseconds.
+  double avg_sync_latency_us_;
 };
 
 
 Log::AppendThread::AppendThread(Log *log)
-  : log_(log) {
+  : log_(log),
+    task_scheduled_(false),
+    sync_group_(nullptr),
+    prev_group_size_(0),
+    avg_sync_latency_us_(0) {
 }
 
 Status Log::AppendThread::Init() {
-  DCHECK(!thread_) << "Already initialized";
+  DCHECK(!thread_ && !token_) << "Already initialized";
+  sync_group_ = LogSyncGroup::Get(log_->fs_manager_->GetWalsRootDir());
+  if (FLAGS_log_append_threads > 0) {
+    VLOG_WITH_PREFIX(1) << "Using the shared log append pool";
+    token_ = LogAppendPool::Get()->NewSerialToken();
+    return Status::OK();
+  }
   VLOG_WITH_PREFIX(1) << "Starting log append thread";
   RETURN_NOT_OK(kudu::Thread::Create("log", "appender",
       &AppendThread::RunThread, this, &thread_));
   return Status::OK();
 }
 
+void Log::AppendThread::Wake() {
+  if (!token_ || task_scheduled_.exchange(true)) {
+    return;
+  }
+  Status s = token_->SubmitFunc(boost::bind(&AppendThread::RunTask, this));
+  if (PREDICT_FALSE(!s.ok())) {
+    // The entries are picked up by the next successful submission, or when
+    // the log is shut down.
+    KLOG_EVERY_N(WARNING, 100) << LogPrefix() << "Unable to schedule log append: "
+                               << s.ToString();
+    task_scheduled_ = false;
+  }
+}
+
 void Log::AppendThread::RunThread() {
   bool shutting_down = false;
   while (PREDICT_TRUE(!shutting_down)) {
@@ -199,65 +405,141 @@ void Log::AppendThread::RunThread() {
     // before exiting the main RunThread() loop.
     if (PREDICT_FALSE(!log_->entry_queue()->BlockingDrainTo(&entry_batches))) {
       shutting_down = true;
+    } else {
+      MaybeWaitForMoreBatches(&entry_batches);
     }
+    ProcessBatches(&entry_batches);
+  }
+  VLOG_WITH_PREFIX(1) << "Exiting AppendThread";
+}
+
+void Log::AppendThread::RunTask() {
+  // Clear the flag before draining, so that the entries which become ready
+  // from now on schedule another task.
+  task_scheduled_ = false;
+
+  vector<LogEntryBatch*> entry_batches;
+  ElementDeleter d(&entry_batches);
+  int max_batches = std::max(0, FLAGS_log_append_max_batches_per_task);
+  if (!log_->entry_queue()->DrainTo(&entry_batches, max_batches)) {
+    return;
+  }
+  ProcessBatches(&entry_batches);
+
+  // If entries were left in the queue, process them in another task, which
+  // the pool runs after the pending tasks of the other logs.
+  if (max_batches > 0 && !log_->entry_queue()->empty()) {
+    Wake();
+  }
+}
 
-    if (log_->metrics_) {
-      log_->metrics_->entry_batches_per_group->Increment(entry_batches.size());
+void Log::AppendThread::MaybeWaitForMoreBatches(vector<LogEntryBatch*>* entry_batches) {
+  size_t prev_group_size = prev_group_size_;
+  prev_group_size_ = entry_batches->size();
+  if (FLAGS_log_group_commit_max_wait_us <= 0 || prev_group_size <= 1 ||
+      !log_->force_sync_all_ || log_->sync_disabled_) {
+    return;
+  }
+  int64_t wait_us = std::min<int64_t>(
+      FLAGS_log_group_commit_max_wait_us,
+      avg_sync_latency_us_ * FLAGS_log_group_commit_wait_sync_ratio);
+  if (wait_us <= 0) {
+    return;
+  }
+
+  size_t group_bytes = 0;
+  for (const LogEntryBatch* entry_batch : *entry_batches) {
+    group_bytes += entry_batch->total_size_bytes();
+  }
+  const size_t target_bytes = std::max(0, FLAGS_log_group_commit_target_bytes);
+  MonoTime start = MonoTime::Now();
+  MonoTime deadline = start + MonoDelta::FromMicroseconds(wait_us);
+  while (group_bytes < target_bytes) {
+    size_t prev_size = entry_batches->size();
+    if (!log_->entry_queue()->BlockingDrainTo(entry_batches, deadline)) {
+      break;
     }
-    TRACE_EVENT1("log", "batch", "batch_size", entry_batches.size());
-
-    SCOPED_LATENCY_METRIC(log_->metrics_, group_commit_latency);
-
-    bool is_all_commits = true;
-    for (LogEntryBatch* entry_batch : entry_batches) {
-      entry_batch->WaitForReady();
-      TRACE_EVENT_FLOW_END0("log", "Batch", entry_batch);
-      Status s = log_->DoAppend(entry_batch);
-      if (PREDICT_FALSE(!s.ok())) {
-        LOG_WITH_PREFIX(ERROR) << "Error appending to the log: " << s.ToString();
-        entry_batch->set_failed_to_append();
-        // TODO(af): If a single transaction fails to append, should we
-        // abort all subsequent transactions in this batch or allow
-        // them to be appended? What about transactions in future
-        // batches?
-        if (!entry_batch->callback().is_null()) {
-          entry_batch->callback().Run(s);
-        }
-      }
-      if (is_all_commits && entry_batch->type_ != COMMIT) {
-        is_all_commits = false;
-      }
+    for (size_t i = prev_size; i < entry_batches->size(); i++) {
+      group_bytes += (*entry_batches)[i]->total_size_bytes();
     }
+  }
+  prev_group_size_ = entry_batches->size();
+  if (log_->metrics_) {
+    log_->metrics_->group_commit_wait_latency->Increment(
+        (MonoTime::Now() - start).ToMicroseconds());
+  }
+}
 
-    Status s;
-    if (!is_all_commits) {
-      s = log_->Sync();
+void Log::AppendThread::ProcessBatches(vector<LogEntryBatch*>* entry_batches) {
+  if (log_->metrics_) {
+    log_->metrics_->entry_batches_per_group->Increment(entry_batches->size());
+    size_t group_bytes = 0;
+    for (const LogEntryBatch* entry_batch : *entry_batches) {
+      group_bytes += entry_batch->total_size_bytes();
     }
+    log_->metrics_->group_commit_bytes->Increment(group_bytes);
+  }
+  TRACE_EVENT1("log", "batch", "batch_size", entry_batches->size());
+
+  SCOPED_LATENCY_METRIC(log_->metrics_, group_commit_latency);
+
+  bool is_all_commits = true;
+  for (LogEntryBatch* entry_batch : *entry_batches) {
+    entry_batch->WaitForReady();
+    TRACE_EVENT_FLOW_END0("log", "Batch", entry_batch);
+    Status s = log_->DoAppend(entry_batch);
     if (PREDICT_FALSE(!s.ok())) {
-      LOG_WITH_PREFIX(ERROR) << "Error syncing log: " << s.ToString();
-      for (LogEntryBatch* entry_batch : entry_batches) {
-        if (!entry_batch->callback().is_null()) {
-          entry_batch->callback().Run(s);
-        }
+      LOG_WITH_PREFIX(ERROR) << "Error appending to the log: " << s.ToString();
+      entry_batch->set_failed_to_append();
+      // TODO(af): If a single transaction fails to append, should we
+      // abort all subsequent transactions in this batch or allow
+      // them to be appended? What about transactions in future
+      // batches?
+      if (!entry_batch->callback().is_null()) {
+        entry_batch->callback().Run(s);
       }
+    }
+    if (is_all_commits && entry_batch->type_ != COMMIT) {
+      is_all_commits = false;
+    }
+  }
+
+  Status s;
+  if (!is_all_commits) {
+    MonoTime sync_start = MonoTime::Now();
+    if (FLAGS_log_group_syncs_by_dir) {
+      s = sync_group_->Sync([this]() { return log_->Sync(); });
     } else {
-      TRACE_EVENT0("log", "Callbacks");
-      VLOG_WITH_PREFIX(2) << "Synchronized " << entry_batches.size() << " entry batches";
-      SCOPED_WATCH_STACK(100);
-      for (LogEntryBatch* entry_batch : entry_batches) {
-        if (PREDICT_TRUE(!entry_batch->failed_to_append()
-                         && !entry_batch->callback().is_null())) {
-          entry_batch->callback().Run(Status::OK());
-        }
-        // It's important to delete each batch as we see it, because
-        // deleting it may free up memory from memory trackers, and the
-        // callback of a later batch may want to use that memory.
-        delete entry_batch;
+      s = log_->Sync();
+    }
+    // Weigh the latest sync at 1/8 so that the holdback adapts to the device
+    // without following every outlier.
+    double sync_us = (MonoTime::Now() - sync_start).ToMicroseconds();
+    avg_sync_latency_us_ += (sync_us - avg_sync_latency_us_) / 8;
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG_WITH_PREFIX(ERROR) << "Error syncing log: " << s.ToString();
+    for (LogEntryBatch* entry_batch : *entry_batches) {
+      if (!entry_batch->callback().is_null()) {
+        entry_batch->callback().Run(s);
+      }
+    }
+  } else {
+    TRACE_EVENT0("log", "Callbacks");
+    VLOG_WITH_PREFIX(2) << "Synchronized " << entry_batches->size() << " entry batches";
+    SCOPED_WATCH_STACK(100);
+    for (LogEntryBatch* entry_batch : *entry_batches) {
+      if (PREDICT_TRUE(!entry_batch->failed_to_append()
+                       && !entry_batch->callback().is_null())) {
+        entry_batch->callback().Run(Status::OK());
       }
-      entry_batches.clear();
+      // It's important to delete each batch as we see it, because
+      // deleting it may free up memory from memory trackers, and the
+      // callback of a later batch may want to use that memory.
+      delete entry_batch;
     }
+    entry_batches->clear();
   }
-  VLOG_WITH_PREFIX(1) << "Exiting AppendThread";
 }
 
 void Log::AppendThread::Shutdown() {
@@ -269,6 +551,20 @@ void Log::AppendThread::Shutdown() {
     VLOG_WITH_PREFIX(1) << "Log append thread is shut down";
     thread_.reset();
   }
+  if (token_) {
+    // Process the entries left in the queue after any scheduled task, since
+    // no more can be added. If that cannot be scheduled, do so here once the
+    // scheduled tasks are done.
+    Status s = token_->SubmitFunc(boost::bind(&AppendThread::RunTask, this));
+    token_->Wait();
+    if (PREDICT_FALSE(!s.ok())) {
+      while (!log_->entry_queue()->empty()) {
+        RunTask();
+      }
+    }
+    token_->Shutdown();
+    token_.reset();
+  }
 }
 
 string Log::AppendThread::LogPrefix() const {
@@ -475,6 +771,7 @@ void Log::AsyncAppend(LogEntryBatch* entry_batch, const StatusCallback& callback
   TRACE("Serialized $0 byte log entry", entry_batch->total_size_bytes());
   TRACE_EVENT_FLOW_BEGIN0("log", "Batch", entry_batch);
   entry_batch->MarkReady();
+  append_thread_->Wake();
 }
 
 Status Log::AsyncAppendReplicates(const vector<ReplicateRefPtr>& replicates,
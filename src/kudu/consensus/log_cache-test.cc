@@ -35,6 +35,7 @@ using std::shared_ptr;
 
 DECLARE_int32(log_cache_size_limit_mb);
 DECLARE_int32(global_log_cache_size_limit_mb);
+DECLARE_bool(log_cache_global_eviction);
 
 METRIC_DECLARE_entity(tablet);
 
@@ -289,6 +290,46 @@ TEST_F(LogCacheTest, TestGlobalMemoryLimit) {
   ASSERT_LE(cache_->BytesUsed(), 1024 * 1024);
 }
 
+// Test that, with global eviction, exceeding the global limit evicts ops from
+// the tablet using most of it rather than from the tablet appending ops.
+TEST_F(LogCacheTest, TestGlobalFairEviction) {
+  FLAGS_log_cache_global_eviction = true;
+  cache_.reset();
+  FLAGS_global_log_cache_size_limit_mb = 4;
+  CloseAndReopenCache(MinimumOpId());
+
+  const char* kOtherTablet = "other-tablet";
+  scoped_refptr<log::Log> other_log;
+  ASSERT_OK(log::Log::Open(log::LogOptions(), fs_manager_.get(), kOtherTablet, schema_,
+                           0, // schema_version
+                           nullptr, &other_log));
+  LogCache other_cache(METRIC_ENTITY_tablet.Instantiate(&metric_registry_, kOtherTablet),
+                       other_log.get(), kPeerUuid, kOtherTablet);
+  other_cache.Init(MinimumOpId());
+
+  const int kPayloadSize = 768 * 1024;
+
+  // Use most of the global limit in the first tablet's cache.
+  ASSERT_OK(AppendReplicateMessagesToCache(1, 4, kPayloadSize));
+  log_->WaitUntilAllFlushed();
+  ASSERT_EQ(4, cache_->num_cached_ops());
+
+  // Exceed the global limit by appending to the other tablet's cache.
+  for (int i = 1; i <= 2; i++) {
+    vector<ReplicateRefPtr> msgs;
+    msgs.push_back(make_scoped_refptr_replicate(
+        CreateDummyReplicate(0, i, clock_->Now(), kPayloadSize).release()));
+    ASSERT_OK(other_cache.AppendOperations(msgs, Bind(&FatalOnError)));
+  }
+  other_log->WaitUntilAllFlushed();
+
+  // The first tablet, which used more than half of the limit, gave up its
+  // oldest op.
+  ASSERT_EQ(3, cache_->num_cached_ops());
+  ASSERT_EQ(2, other_cache.num_cached_ops());
+  ASSERT_LE(cache_->parent_tracker_->consumption(), 4 * 1024 * 1024);
+}
+
 // Test that the log cache properly replaces messages when an index
 // is reused. This is a regression test for a bug where the memtracker's
 // consumption wasn't properly managed when messages were replaced.
@@ -23,6 +23,7 @@
 #include <google/protobuf/wire_format_lite_inl.h>
 #include <map>
 #include <mutex>
+#include <unordered_set>
 #include <vector>
 
 #include "kudu/consensus/log.h"
@@ -53,6 +54,15 @@ DEFINE_int32(global_log_cache_size_limit_mb, 1024,
              "caching log entries across all tablets is kept under this threshold.");
 TAG_FLAG(global_log_cache_size_limit_mb, advanced);
 
+DEFINE_bool(log_cache_global_eviction, false,
+            "Whether exceeding --global_log_cache_size_limit_mb evicts ops from the log "
+            "caches of the tablets using more than an even share of the limit, favoring "
+            "those whose cached ops are read least, rather than only from the log cache "
+            "of the tablet appending ops.");
+TAG_FLAG(log_cache_global_eviction, experimental);
+TAG_FLAG(log_cache_global_eviction, runtime);
+
+using std::unordered_set;
 using strings::Substitute;
 
 namespace kudu {
@@ -64,9 +74,35 @@ METRIC_DEFINE_gauge_int64(tablet, log_cache_num_ops, "Log Cache Operation Count"
 METRIC_DEFINE_gauge_int64(tablet, log_cache_size, "Log Cache Memory Usage",
                           MetricUnit::kBytes,
                           "Amount of memory in use for caching the local log.");
+METRIC_DEFINE_counter(tablet, log_cache_hits, "Log Cache Hits",
+                      MetricUnit::kOperations,
+                      "Number of operations read by peers from the log cache.");
+METRIC_DEFINE_counter(tablet, log_cache_misses, "Log Cache Misses",
+                      MetricUnit::kOperations,
+                      "Number of operations read by peers which were not in the log "
+                      "cache and were read from the log on disk.");
 
 static const char kParentMemTrackerId[] = "log_cache";
 
+// Once this many ops were read from a cache, its recent hit and miss counts
+// are halved.
+static const int64_t kRecentReadsWindow = 1024;
+
+namespace {
+
+// The log caches of all the tablets of the server, for server-wide eviction.
+struct LogCacheRegistry {
+  std::mutex lock;
+  unordered_set<LogCache*> caches;
+};
+
+LogCacheRegistry* GetLogCacheRegistry() {
+  static LogCacheRegistry* registry = new LogCacheRegistry();
+  return registry;
+}
+
+} // anonymous namespace
+
 typedef vector<const ReplicateMsg*>::const_iterator MsgIter;
 
 LogCache::LogCache(const scoped_refptr<MetricEntity>& metric_entity,
@@ -78,6 +114,8 @@ LogCache::LogCache(const scoped_refptr<MetricEntity>& metric_entity,
     tablet_id_(tablet_id),
     next_sequential_op_index_(0),
     min_pinned_op_index_(0),
+    recent_hits_(0),
+    recent_misses_(0),
     metrics_(metric_entity) {
 
 
@@ -100,9 +138,18 @@ LogCache::LogCache(const scoped_refptr<MetricEntity>& metric_entity,
   auto zero_op = new ReplicateMsg();
   *zero_op->mutable_id() = MinimumOpId();
   InsertOrDie(&cache_, 0, make_scoped_refptr_replicate(zero_op));
+
+  LogCacheRegistry* registry = GetLogCacheRegistry();
+  std::lock_guard<std::mutex> l(registry->lock);
+  InsertOrDie(&registry->caches, this);
 }
 
 LogCache::~LogCache() {
+  {
+    LogCacheRegistry* registry = GetLogCacheRegistry();
+    std::lock_guard<std::mutex> l(registry->lock);
+    registry->caches.erase(this);
+  }
   tracker_->Release(tracker_->consumption());
   cache_.clear();
 }
@@ -162,21 +209,27 @@ Status LogCache::AppendOperations(const vector<ReplicateRefPtr>& msgs,
   bool borrowed_memory = false;
   if (!tracker_->TryConsume(mem_required)) {
     int spare = tracker_->SpareCapacity();
-    int need_to_free = mem_required - spare;
+    int64_t need_to_free = mem_required - spare;
     VLOG_WITH_PREFIX_UNLOCKED(1) << "Memory limit would be exceeded trying to append "
                         << HumanReadableNumBytes::ToString(mem_required)
                         << " to log cache (available="
                         << HumanReadableNumBytes::ToString(spare)
                         << "): attempting to evict some operations...";
 
-    // TODO: we should also try to evict from other tablets - probably better to
-    // evict really old ops from another tablet than evict recent ops from this one.
-    EvictSomeUnlocked(min_pinned_op_index_, need_to_free);
+    // With global eviction, only the ops over the per-tablet limit are evicted
+    // here. If the global limit is exceeded, the ops of the tablets with the
+    // largest share of it are evicted once this batch is logged.
+    if (FLAGS_log_cache_global_eviction) {
+      need_to_free = tracker_->consumption() + mem_required - tracker_->limit();
+    }
+    if (need_to_free > 0) {
+      EvictSomeUnlocked(min_pinned_op_index_, need_to_free);
+    }
 
     // Force consuming, so that we don't refuse appending data. We might
     // blow past our limit a little bit (as much as the number of tablets times
-    // the amount of in-flight data in the log), but until implementing the above TODO,
-    // it's difficult to solve this issue.
+    // the amount of in-flight data in the log), since in-flight ops can't be
+    // evicted.
     tracker_->Consume(mem_required);
 
     borrowed_memory = parent_tracker_->LimitExceeded();
@@ -222,19 +275,73 @@ void LogCache::LogCallback(int64_t last_idx_in_batch,
       VLOG_WITH_PREFIX_UNLOCKED(1) << "Updating pinned index to " << (last_idx_in_batch + 1);
       min_pinned_op_index_ = last_idx_in_batch + 1;
     }
+  }
 
-    // If we went over the global limit in order to log this batch, evict some to
-    // get back down under the limit.
-    if (borrowed_memory) {
+  // If we went over the global limit in order to log this batch, evict some to
+  // get back down under the limit.
+  if (log_status.ok() && borrowed_memory) {
+    if (FLAGS_log_cache_global_eviction) {
       int64_t spare_capacity = parent_tracker_->SpareCapacity();
       if (spare_capacity < 0) {
-        EvictSomeUnlocked(min_pinned_op_index_, -spare_capacity);
+        EvictFromAllCaches(-spare_capacity);
       }
     }
+    // Without global eviction, or if the other caches could not give up
+    // enough, evict from this cache.
+    std::lock_guard<simple_spinlock> l(lock_);
+    int64_t spare_capacity = parent_tracker_->SpareCapacity();
+    if (spare_capacity < 0) {
+      EvictSomeUnlocked(min_pinned_op_index_, -spare_capacity);
+    }
   }
   user_callback.Run(log_status);
 }
 
+void LogCache::EvictFromAllCaches(int64_t bytes_to_evict) {
+  LogCacheRegistry* registry = GetLogCacheRegistry();
+  std::lock_guard<std::mutex> registry_lock(registry->lock);
+  if (registry->caches.empty()) {
+    return;
+  }
+
+  struct Candidate {
+    LogCache* cache;
+    int64_t excess_bytes;
+    double score;
+  };
+  vector<Candidate> candidates;
+  const int64_t global_limit = FLAGS_global_log_cache_size_limit_mb * 1024L * 1024L;
+  const int64_t fair_share = global_limit / registry->caches.size();
+  for (LogCache* cache : registry->caches) {
+    std::lock_guard<simple_spinlock> l(cache->lock_);
+    int64_t excess_bytes = cache->tracker_->consumption() - fair_share;
+    if (excess_bytes <= 0) {
+      continue;
+    }
+    // Ops which are read from the cache are worth more than those which are
+    // not: halve the score of a cache all of whose reads hit.
+    double score = excess_bytes * (1.0 - 0.5 * cache->RecentHitRatioUnlocked());
+    candidates.push_back({ cache, excess_bytes, score });
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+
+  for (const Candidate& c : candidates) {
+    if (bytes_to_evict <= 0) {
+      break;
+    }
+    std::lock_guard<simple_spinlock> l(c.cache->lock_);
+    bytes_to_evict -= c.cache->EvictSomeUnlocked(c.cache->min_pinned_op_index_,
+                                                 std::min(c.excess_bytes, bytes_to_evict));
+  }
+}
+
+double LogCache::RecentHitRatioUnlocked() const {
+  DCHECK(lock_.is_locked());
+  int64_t reads = recent_hits_ + recent_misses_;
+  return reads == 0 ? 0 : static_cast<double>(recent_hits_) / reads;
+}
+
 bool LogCache::HasOpBeenWritten(int64_t index) const {
   std::lock_guard<simple_spinlock> l(lock_);
   return index < next_sequential_op_index_;
@@ -317,6 +424,7 @@ Status LogCache::ReadOps(int64_t after_op_index,
           << "from disk (" << next_index << ".."
           << (next_index + raw_replicate_ptrs.size() - 1) << ")";
 
+      int64_t num_read = 0;
       for (ReplicateMsg* msg : raw_replicate_ptrs) {
         CHECK_EQ(next_index, msg->id().index());
 
@@ -324,13 +432,17 @@ Status LogCache::ReadOps(int64_t after_op_index,
         if (remaining_space > 0 || messages->empty()) {
           messages->push_back(make_scoped_refptr_replicate(msg));
           next_index++;
+          num_read++;
         } else {
           delete msg;
         }
       }
+      metrics_.log_cache_misses->IncrementBy(num_read);
+      recent_misses_ += num_read;
 
     } else {
       // Pull contiguous messages from the cache until the size limit is achieved.
+      int64_t num_read = 0;
       for (; iter != cache_.end(); ++iter) {
         const ReplicateRefPtr& msg = iter->second;
         int64_t index = msg->get()->id().index();
@@ -345,9 +457,16 @@ Status LogCache::ReadOps(int64_t after_op_index,
 
         messages->push_back(msg);
         next_index++;
+        num_read++;
       }
+      metrics_.log_cache_hits->IncrementBy(num_read);
+      recent_hits_ += num_read;
     }
   }
+  if (recent_hits_ + recent_misses_ > kRecentReadsWindow) {
+    recent_hits_ /= 2;
+    recent_misses_ /= 2;
+  }
   return Status::OK();
 }
 
@@ -358,7 +477,7 @@ void LogCache::EvictThroughOp(int64_t index) {
   EvictSomeUnlocked(index, MathLimits<int64_t>::kMax);
 }
 
-void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evict) {
+int64_t LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evict) {
   DCHECK(lock_.is_locked());
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Evicting log cache index <= "
                       << stop_after_index
@@ -397,6 +516,7 @@ void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evic
     }
   }
   VLOG_WITH_PREFIX_UNLOCKED(1) << "Evicting log cache: after state: " << ToStringUnlocked();
+  return bytes_evicted;
 }
 
 void LogCache::AccountForMessageRemovalUnlocked(const ReplicateRefPtr& msg) {
@@ -484,7 +604,9 @@ void LogCache::DumpToHtml(std::ostream& out) const {
   x.Instantiate(metric_entity, 0)
 LogCache::Metrics::Metrics(const scoped_refptr<MetricEntity>& metric_entity)
   : log_cache_num_ops(INSTANTIATE_METRIC(METRIC_log_cache_num_ops)),
-    log_cache_size(INSTANTIATE_METRIC(METRIC_log_cache_size)) {
+    log_cache_size(INSTANTIATE_METRIC(METRIC_log_cache_size)),
+    log_cache_hits(METRIC_log_cache_hits.Instantiate(metric_entity)),
+    log_cache_misses(METRIC_log_cache_misses.Instantiate(metric_entity)) {
 }
 #undef INSTANTIATE_METRIC
 
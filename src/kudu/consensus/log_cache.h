@@ -152,7 +152,25 @@ class LogCache {
   // Try to evict the oldest operations from the queue, stopping either when
   // 'bytes_to_evict' bytes have been evicted, or the op with index
   // 'stop_after_index' has been evicted, whichever comes first.
-  void EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evict);
+  // Returns the number of bytes evicted.
+  int64_t EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evict);
+
+  // Evicts up to 'bytes_to_evict' bytes from the log caches of all the
+  // tablets, to bring the server-wide consumption under the global limit.
+  //
+  // The caches using more than an even share of the global limit are
+  // evicted from, starting with those whose excess is largest and whose
+  // recently read ops were least often found in the cache. The caches of
+  // tablets with a far-behind follower thus give up their oldest ops before
+  // the caches of other tablets, whose slow peers would otherwise have to
+  // read from disk.
+  //
+  // Must not be called with the lock of any cache held.
+  static void EvictFromAllCaches(int64_t bytes_to_evict);
+
+  // The fraction of the ops recently read from this cache which were found
+  // in it, or 0 if no ops were read recently.
+  double RecentHitRatioUnlocked() const;
 
   // Update metrics and MemTracker to account for the removal of the
   // given message.
@@ -210,6 +228,12 @@ class LogCache {
   // A MemTracker for this instance.
   std::shared_ptr<MemTracker> tracker_;
 
+  // The number of ops recently read from the cache and from disk by
+  // ReadOps(). Both are halved periodically so that they reflect the recent
+  // reads. Protected by lock_.
+  int64_t recent_hits_;
+  int64_t recent_misses_;
+
   struct Metrics {
     explicit Metrics(const scoped_refptr<MetricEntity>& metric_entity);
 
@@ -218,6 +242,11 @@ class LogCache {
 
     // Keeps track of the memory consumed by the cache, in bytes.
     scoped_refptr<AtomicGauge<int64_t> > log_cache_size;
+
+    // Count the ops read by peers from the cache, and those which were not
+    // in the cache and were read from the log on disk.
+    scoped_refptr<Counter> log_cache_hits;
+    scoped_refptr<Counter> log_cache_misses;
   };
   Metrics metrics_;
 
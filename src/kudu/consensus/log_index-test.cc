@@ -17,10 +17,17 @@
 
 #include "kudu/consensus/log_index.h"
 
+#include <vector>
+
+#include <gflags/gflags.h>
+
 #include "kudu/consensus/opid_util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(log_index_sparse);
+DECLARE_int32(log_index_sparse_max_runs);
+
 namespace kudu {
 namespace log {
 
@@ -109,5 +116,54 @@ TEST_F(LogIndexTest, TestMultiSegmentWithGC) {
   VerifyNotFound(2500000);
 }
 
+TEST_F(LogIndexTest, TestSparse) {
+  FLAGS_log_index_sparse = true;
+  FLAGS_log_index_sparse_max_runs = 3;
+  index_ = new LogIndex(test_dir_);
+  ASSERT_TRUE(index_->is_sparse());
+
+  // Ops 1-3 are in one batch, and 4-5 in another, in which the term changes.
+  ASSERT_OK(AddEntry(MakeOpId(1, 1), 1, 100));
+  ASSERT_OK(AddEntry(MakeOpId(1, 2), 1, 100));
+  ASSERT_OK(AddEntry(MakeOpId(1, 3), 1, 100));
+  ASSERT_OK(AddEntry(MakeOpId(1, 4), 1, 200));
+  ASSERT_OK(AddEntry(MakeOpId(2, 5), 1, 200));
+  VerifyNotFound(0);
+  VerifyEntry(MakeOpId(1, 2), 1, 100);
+  VerifyEntry(MakeOpId(1, 3), 1, 100);
+  VerifyEntry(MakeOpId(1, 4), 1, 200);
+  VerifyEntry(MakeOpId(2, 5), 1, 200);
+  VerifyNotFound(6);
+
+  // Appending op 3 again, after a change of leader, drops ops 4 and 5.
+  ASSERT_OK(AddEntry(MakeOpId(3, 3), 2, 100));
+  VerifyEntry(MakeOpId(1, 2), 1, 100);
+  VerifyEntry(MakeOpId(3, 3), 2, 100);
+  VerifyNotFound(4);
+
+  // The fourth run evicts the first.
+  ASSERT_OK(AddEntry(MakeOpId(3, 4), 2, 200));
+  ASSERT_OK(AddEntry(MakeOpId(3, 5), 2, 300));
+  VerifyNotFound(1);
+  VerifyEntry(MakeOpId(3, 3), 2, 100);
+  VerifyEntry(MakeOpId(3, 5), 2, 300);
+
+  // Restored entries are found until they're GCed.
+  std::vector<LogIndexEntry> restored(2);
+  restored[0].op_id = MakeOpId(1, 1);
+  restored[1].op_id = MakeOpId(1, 2);
+  for (LogIndexEntry& entry : restored) {
+    entry.segment_sequence_number = 1;
+    entry.offset_in_segment = 100;
+  }
+  index_->RestoreEntries(restored);
+  VerifyEntry(MakeOpId(1, 1), 1, 100);
+  VerifyEntry(MakeOpId(1, 2), 1, 100);
+  index_->GC(4);
+  VerifyNotFound(2);
+  VerifyNotFound(3);
+  VerifyEntry(MakeOpId(3, 4), 2, 200);
+}
+
 } // namespace log
 } // namespace kudu
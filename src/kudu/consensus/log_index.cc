@@ -25,10 +25,24 @@
 //
 // When the log is GCed, we remove any index chunks which are no longer needed, and
 // unmap them.
+//
+// A sparse index instead keeps a map in memory from the first index of each run of
+// ops which were appended in the same batch and term to the last index, the term and
+// the position of the batch. As most batches are of a single term, this is one entry
+// per batch, rather than per op, and no files are opened or mapped. A lookup finds
+// the run which contains the index, and the reader then scans the batch for the op.
+//
+// A sparse index holds at most --log_index_sparse_max_runs runs, evicting the runs of
+// the lowest indexes first, as followers which are catching up are usually close to
+// the end of the log. If a lookup of an evicted op misses, the reader scans the
+// segment whose footer covers the op, and restores its runs into a separate map,
+// which isn't subject to eviction so that the rest of the catch-up from that segment
+// doesn't scan it again.
 
 #include "kudu/consensus/log_index.h"
 
 #include <fcntl.h>
+#include <algorithm>
 #include <mutex>
 #include <string>
 #include <sys/mman.h>
@@ -37,14 +51,32 @@
 #include <unistd.h>
 #include <vector>
 
+#include <gflags/gflags.h>
+
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/errno.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 
+DEFINE_bool(log_index_sparse, false,
+            "Whether to index the write-ahead log of each tablet in memory, with an "
+            "entry per batch of ops rather than per op, instead of in memory-mapped "
+            "files. This saves file descriptors and mapped memory on servers with "
+            "many tablets. Only applies to logs opened after it is set.");
+TAG_FLAG(log_index_sparse, experimental);
+
+DEFINE_int32(log_index_sparse_max_runs, 100000,
+             "The maximum number of entries in the sparse index of the write-ahead "
+             "log of a tablet. The oldest are evicted first, and are restored by "
+             "scanning their log segment if they are needed again.");
+TAG_FLAG(log_index_sparse_max_runs, experimental);
+TAG_FLAG(log_index_sparse_max_runs, runtime);
+
 using std::string;
+using std::vector;
 using strings::Substitute;
 
 #define RETRY_ON_EINTR(ret, expr) do {          \
@@ -148,7 +180,10 @@ void LogIndex::IndexChunk::SetEntry(int entry_index, const PhysicalEntry& entry)
 // LogIndex
 ////////////////////////////////////////////////////////////
 
-LogIndex::LogIndex(std::string base_dir) : base_dir_(std::move(base_dir)) {}
+LogIndex::LogIndex(std::string base_dir)
+    : base_dir_(std::move(base_dir)),
+      sparse_(FLAGS_log_index_sparse) {
+}
 
 LogIndex::~LogIndex() {
 }
@@ -199,7 +234,74 @@ Status LogIndex::GetChunkForIndex(int64_t log_index, bool create,
   return Status::OK();
 }
 
+void LogIndex::AppendToRuns(const LogIndexEntry& entry, RunMap* runs) {
+  const int64_t index = entry.op_id.index();
+  if (!runs->empty() && runs->rbegin()->second.last_index >= index) {
+    runs->erase(runs->lower_bound(index), runs->end());
+    if (!runs->empty() && runs->rbegin()->second.last_index >= index) {
+      runs->rbegin()->second.last_index = index - 1;
+    }
+  }
+
+  if (!runs->empty()) {
+    SparseRun& last = runs->rbegin()->second;
+    if (last.last_index + 1 == index &&
+        last.term == entry.op_id.term() &&
+        last.segment_sequence_number == entry.segment_sequence_number &&
+        last.offset_in_segment == entry.offset_in_segment) {
+      last.last_index = index;
+      return;
+    }
+  }
+  SparseRun run;
+  run.last_index = index;
+  run.term = entry.op_id.term();
+  run.segment_sequence_number = entry.segment_sequence_number;
+  run.offset_in_segment = entry.offset_in_segment;
+  runs->emplace_hint(runs->end(), index, run);
+}
+
+bool LogIndex::FindInRuns(const RunMap& runs, int64_t index, LogIndexEntry* entry) {
+  auto it = runs.upper_bound(index);
+  if (it == runs.begin()) {
+    return false;
+  }
+  --it;
+  const SparseRun& run = it->second;
+  if (index > run.last_index) {
+    return false;
+  }
+  entry->op_id = consensus::MakeOpId(run.term, index);
+  entry->segment_sequence_number = run.segment_sequence_number;
+  entry->offset_in_segment = run.offset_in_segment;
+  return true;
+}
+
+void LogIndex::GCRuns(int64_t min_index_to_retain, RunMap* runs) {
+  auto it = runs->begin();
+  while (it != runs->end() && it->second.last_index < min_index_to_retain) {
+    it = runs->erase(it);
+  }
+}
+
 Status LogIndex::AddEntry(const LogIndexEntry& entry) {
+  if (sparse_) {
+    std::lock_guard<simple_spinlock> l(runs_lock_);
+    AppendToRuns(entry, &runs_);
+    // An op appended again after a change of leader invalidates the later
+    // ops wherever they are.
+    if (!restored_runs_.empty() &&
+        restored_runs_.rbegin()->second.last_index >= entry.op_id.index()) {
+      restored_runs_.clear();
+    }
+    const size_t max_runs = std::max(1, FLAGS_log_index_sparse_max_runs);
+    while (runs_.size() > max_runs) {
+      runs_.erase(runs_.begin());
+    }
+    VLOG(3) << "Added log index entry " << entry.ToString();
+    return Status::OK();
+  }
+
   scoped_refptr<IndexChunk> chunk;
   RETURN_NOT_OK(GetChunkForIndex(entry.op_id.index(),
                                  true /* create if not found */,
@@ -218,6 +320,14 @@ Status LogIndex::AddEntry(const LogIndexEntry& entry) {
 }
 
 Status LogIndex::GetEntry(int64_t index, LogIndexEntry* entry) {
+  if (sparse_) {
+    std::lock_guard<simple_spinlock> l(runs_lock_);
+    if (FindInRuns(runs_, index, entry) || FindInRuns(restored_runs_, index, entry)) {
+      return Status::OK();
+    }
+    return Status::NotFound("entry not found");
+  }
+
   scoped_refptr<IndexChunk> chunk;
   RETURN_NOT_OK(GetChunkForIndex(index, false /* do not create */, &chunk));
   int index_in_chunk = index % kEntriesPerIndexChunk;
@@ -237,7 +347,26 @@ Status LogIndex::GetEntry(int64_t index, LogIndexEntry* entry) {
   return Status::OK();
 }
 
+void LogIndex::RestoreEntries(const vector<LogIndexEntry>& entries) {
+  DCHECK(sparse_);
+  RunMap restored;
+  for (const LogIndexEntry& entry : entries) {
+    AppendToRuns(entry, &restored);
+  }
+  VLOG(2) << "Restored " << restored.size() << " log index runs from "
+          << entries.size() << " entries";
+  std::lock_guard<simple_spinlock> l(runs_lock_);
+  restored_runs_.swap(restored);
+}
+
 void LogIndex::GC(int64_t min_index_to_retain) {
+  if (sparse_) {
+    std::lock_guard<simple_spinlock> l(runs_lock_);
+    GCRuns(min_index_to_retain, &runs_);
+    GCRuns(min_index_to_retain, &restored_runs_);
+    return;
+  }
+
   int min_chunk_to_retain = min_index_to_retain / kEntriesPerIndexChunk;
 
   // Enumerate which chunks to delete.
@@ -19,6 +19,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/macros.h"
@@ -55,6 +56,11 @@ struct LogIndexEntry {
 // readers. In other words, if a reader is expected to see an index entry written by a
 // writer, there should be some other synchronization between them to ensure visibility.
 //
+// With --log_index_sparse, the index is instead kept in memory, with one
+// entry per run of consecutive ops in the same batch and term. The number of
+// runs is bounded, and the oldest are evicted first; the entries of a closed
+// segment may then be restored by scanning it (see LogReader).
+//
 // See .cc file for implementation notes.
 class LogIndex : public RefCountedThreadSafe<LogIndex> {
  public:
@@ -64,9 +70,19 @@ class LogIndex : public RefCountedThreadSafe<LogIndex> {
   Status AddEntry(const LogIndexEntry& entry);
 
   // Retrieve an existing entry from the index.
-  // Returns NotFound() if the given log entry was never written.
+  // Returns NotFound() if the given log entry was never written, or if it
+  // was evicted from a sparse index.
   Status GetEntry(int64_t index, LogIndexEntry* entry);
 
+  // Whether the index is sparse, so that entries which aren't found may
+  // have been evicted.
+  bool is_sparse() const { return sparse_; }
+
+  // Records the entries of a segment, in the order they were appended, which
+  // were read back from the log after they were evicted from a sparse index.
+  // They replace the entries restored by the previous call.
+  void RestoreEntries(const std::vector<LogIndexEntry>& entries);
+
   // Indicate that we no longer need to retain information about indexes lower than the
   // given index. Note that the implementation is conservative and _may_ choose to retain
   // earlier entries.
@@ -78,6 +94,26 @@ class LogIndex : public RefCountedThreadSafe<LogIndex> {
 
   class IndexChunk;
 
+  // A run of consecutive ops in the same batch and term, keyed by the index
+  // of its first op in a sparse index.
+  struct SparseRun {
+    int64_t last_index;
+    int64_t term;
+    int64_t segment_sequence_number;
+    int64_t offset_in_segment;
+  };
+  typedef std::map<int64_t, SparseRun> RunMap;
+
+  // Appends 'entry' to 'runs', first dropping any ops at or after its index,
+  // which were appended before a change of leader.
+  static void AppendToRuns(const LogIndexEntry& entry, RunMap* runs);
+
+  // Finds the run of 'runs' which contains 'index', if any.
+  static bool FindInRuns(const RunMap& runs, int64_t index, LogIndexEntry* entry);
+
+  // Removes the runs of 'runs' which end before 'min_index_to_retain'.
+  static void GCRuns(int64_t min_index_to_retain, RunMap* runs);
+
   // Open the on-disk chunk with the given index.
   // Note: 'chunk_idx' is the index of the index chunk, not the index of a log _entry_.
   Status OpenChunk(int64_t chunk_idx, scoped_refptr<IndexChunk>* chunk);
@@ -102,6 +138,16 @@ class LogIndex : public RefCountedThreadSafe<LogIndex> {
   typedef std::map<int64_t, scoped_refptr<IndexChunk> > ChunkMap;
   ChunkMap open_chunks_;
 
+  // Whether the index is sparse. If so, no chunks are ever opened.
+  const bool sparse_;
+
+  simple_spinlock runs_lock_;
+
+  // The runs of a sparse index, and those restored by RestoreEntries().
+  // Protected by runs_lock_.
+  RunMap runs_;
+  RunMap restored_runs_;
+
   DISALLOW_COPY_AND_ASSIGN(LogIndex);
 };
 
@@ -20,18 +20,38 @@
 #include <algorithm>
 #include <mutex>
 
+#include <gflags/gflags.h>
+
 #include "kudu/consensus/log_index.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/coding.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(log_reader_read_ahead_batches, 0,
+             "Number of log entry batches which are read and decoded ahead of their "
+             "consumption when reading a range of operations from the log, for "
+             "instance to catch up a lagging follower. If 0, each batch is read on "
+             "the consuming thread once it is needed.");
+TAG_FLAG(log_reader_read_ahead_batches, experimental);
+TAG_FLAG(log_reader_read_ahead_batches, runtime);
+
+DEFINE_int32(log_reader_read_ahead_threads, 4,
+             "Maximum number of threads, shared by the log readers of all tablets, "
+             "which read and decode log entry batches ahead of their consumption. "
+             "See --log_reader_read_ahead_batches.");
+TAG_FLAG(log_reader_read_ahead_threads, experimental);
 
 METRIC_DEFINE_counter(tablet, log_reader_bytes_read, "Bytes Read From Log",
                       kudu::MetricUnit::kBytes,
@@ -56,11 +76,35 @@ struct LogSegmentSeqnoComparator {
     return a->header().sequence_number() < b->header().sequence_number();
   }
 };
-}
+
+// Thread pool shared by all log readers for reading entry batches ahead of
+// their consumption.
+class LogReadAheadPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<LogReadAheadPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<LogReadAheadPool>;
+
+  LogReadAheadPool() {
+    CHECK_OK(ThreadPoolBuilder("log-reader")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_log_reader_read_ahead_threads)
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogReadAheadPool);
+};
+} // anonymous namespace
 
 using consensus::OpId;
 using consensus::ReplicateMsg;
 using std::shared_ptr;
+using std::unique_ptr;
 using strings::Substitute;
 
 const int LogReader::kNoSizeLimit = -1;
@@ -266,6 +310,46 @@ Status LogReader::ReadBatchUsingIndexEntry(const LogIndexEntry& index_entry,
   return Status::OK();
 }
 
+Status LogReader::LookupIndexEntry(int64_t index, LogIndexEntry* entry) const {
+  Status s = log_index_->GetEntry(index, entry);
+  if (!s.IsNotFound() || !log_index_->is_sparse()) {
+    return s;
+  }
+
+  scoped_refptr<ReadableLogSegment> segment;
+  {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    for (const auto& seg : segments_) {
+      if (seg->HasFooter() && !seg->footer_was_rebuilt_ &&
+          seg->footer().min_replicate_index() <= index &&
+          index <= seg->footer().max_replicate_index()) {
+        segment = seg;
+        break;
+      }
+    }
+  }
+  if (!segment) {
+    return s;
+  }
+
+  vector<LogIndexEntry> entries;
+  RETURN_NOT_OK_PREPEND(segment->ReadIndexEntries(&entries),
+                        Substitute("Failed to restore log index from segment $0",
+                                   segment->path()));
+  log_index_->RestoreEntries(entries);
+
+  // Another reader may restore another segment in the meantime, so the entry
+  // is taken from those read rather than looked up again. If the op was
+  // appended more than once, the last time is the valid one.
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    if (it->op_id.index() == index) {
+      *entry = *it;
+      return Status::OK();
+    }
+  }
+  return s;
+}
+
 Status LogReader::ReadReplicatesInRange(int64_t starting_at,
                                         int64_t up_to,
                                         int64_t max_bytes_to_read,
@@ -276,76 +360,178 @@ Status LogReader::ReadReplicatesInRange(int64_t starting_at,
 
   vector<ReplicateMsg*> replicates_tmp;
   ElementDeleter d(&replicates_tmp);
-  LogIndexEntry prev_index_entry;
 
   int64_t total_size = 0;
-  bool limit_exceeded = false;
+  ReplicateIterator iter(this, starting_at, up_to);
+  while (iter.HasNext()) {
+    unique_ptr<ReplicateMsg> replicate;
+    RETURN_NOT_OK(iter.Next(&replicate));
+
+    int64_t space_required = replicate->SpaceUsed();
+    if (!replicates_tmp.empty() &&
+        max_bytes_to_read > 0 &&
+        total_size + space_required >= max_bytes_to_read) {
+      break;
+    }
+    total_size += space_required;
+    replicates_tmp.push_back(replicate.release());
+  }
+
+  replicates->swap(replicates_tmp);
+  return Status::OK();
+}
+
+struct LogReader::ReplicateIterator::PendingBatch {
+  PendingBatch()
+      : last_index(0),
+        next_entry(0),
+        checked(false),
+        done(1) {
+  }
+
+  // Read and decode the batch, then count down 'done'.
+  void Read(const LogReader* reader) {
+    status = reader->ReadBatchUsingIndexEntry(index_entry, &tmp_buf, &batch);
+    done.CountDown();
+  }
+
+  // The index entry of the first message to be consumed from the batch.
+  LogIndexEntry index_entry;
+
+  // The index of the last message to be consumed from the batch.
+  int64_t last_index;
+
+  // The position in 'batch' from which to look for the next message.
+  int next_entry;
+
+  // Whether the indexes in 'batch' were checked to be increasing.
+  bool checked;
+
   faststring tmp_buf;
   gscoped_ptr<LogEntryBatchPB> batch;
-  for (int index = starting_at; index <= up_to && !limit_exceeded; index++) {
+  Status status;
+  CountDownLatch done;
+};
+
+LogReader::ReplicateIterator::ReplicateIterator(const LogReader* reader,
+                                                int64_t starting_at,
+                                                int64_t up_to)
+    : reader_(reader),
+      up_to_(up_to),
+      next_index_(starting_at),
+      next_lookup_index_(starting_at) {
+  DCHECK_GT(starting_at, 0);
+  DCHECK(reader_->log_index_) << "Require an index to random-read logs";
+}
+
+LogReader::ReplicateIterator::~ReplicateIterator() {
+  for (const auto& pending : batches_) {
+    pending->done.Wait();
+  }
+}
+
+void LogReader::ReplicateIterator::ReadAhead() {
+  ThreadPool* pool = nullptr;
+  int max_batches = 1;
+  if (FLAGS_log_reader_read_ahead_batches > 0) {
+    pool = LogReadAheadPool::Get();
+    max_batches += FLAGS_log_reader_read_ahead_batches;
+  }
+
+  while (next_lookup_index_ <= up_to_) {
     LogIndexEntry index_entry;
-    RETURN_NOT_OK_PREPEND(log_index_->GetEntry(index, &index_entry),
-                          Substitute("Failed to read log index for op $0", index));
+    Status s = reader_->LookupIndexEntry(next_lookup_index_, &index_entry);
+    if (PREDICT_FALSE(!s.ok())) {
+      // Report the failure once the consumer gets to this index, and don't
+      // look any further.
+      shared_ptr<PendingBatch> failed(new PendingBatch());
+      failed->last_index = next_lookup_index_;
+      failed->status = s.CloneAndPrepend(
+          Substitute("Failed to read log index for op $0", next_lookup_index_));
+      failed->done.CountDown();
+      batches_.emplace_back(std::move(failed));
+      next_lookup_index_ = up_to_ + 1;
+      return;
+    }
 
     // Since a given LogEntryBatchPB may contain multiple REPLICATE messages,
     // it's likely that this index entry points to the same batch as the previous
-    // one. If that's the case, we've already read this REPLICATE and we can
-    // skip reading the batch again.
-    if (index == starting_at ||
-        index_entry.segment_sequence_number != prev_index_entry.segment_sequence_number ||
-        index_entry.offset_in_segment != prev_index_entry.offset_in_segment) {
-      RETURN_NOT_OK(ReadBatchUsingIndexEntry(index_entry, &tmp_buf, &batch));
-
-      // Sanity-check the property that a batch should only have increasing indexes.
-      int64_t prev_index = 0;
-      for (int i = 0; i < batch->entry_size(); ++i) {
-        LogEntryPB* entry = batch->mutable_entry(i);
-        if (!entry->has_replicate()) continue;
-        int64_t this_index = entry->replicate().id().index();
-        CHECK_GT(this_index, prev_index)
-          << "Expected that an entry batch should only include increasing log indexes: "
-          << index_entry.ToString()
-          << "\nBatch: " << SecureDebugString(*batch);
-        prev_index = this_index;
-      }
-    }
-
-    bool found = false;
-    for (int i = 0; i < batch->entry_size(); ++i) {
-      LogEntryPB* entry = batch->mutable_entry(i);
-      if (!entry->has_replicate()) {
+    // one. If that's the case, the batch is already being read.
+    if (!batches_.empty()) {
+      PendingBatch* prev = batches_.back().get();
+      if (index_entry.segment_sequence_number == prev->index_entry.segment_sequence_number &&
+          index_entry.offset_in_segment == prev->index_entry.offset_in_segment) {
+        prev->last_index = next_lookup_index_++;
         continue;
       }
+    }
+    if (batches_.size() >= max_batches) {
+      return;
+    }
 
-      if (entry->replicate().id().index() != index) {
-        continue;
-      }
+    shared_ptr<PendingBatch> pending(new PendingBatch());
+    pending->index_entry = index_entry;
+    pending->last_index = next_lookup_index_++;
+    batches_.push_back(pending);
 
-      int64_t space_required = entry->replicate().SpaceUsed();
-      if (replicates_tmp.empty() ||
-          max_bytes_to_read <= 0 ||
-          total_size + space_required < max_bytes_to_read) {
-        total_size += space_required;
-        replicates_tmp.push_back(entry->release_replicate());
-      } else {
-        limit_exceeded = true;
-      }
-      found = true;
-      break;
+    const LogReader* reader = reader_;
+    if (!pool || !pool->SubmitFunc([reader, pending]() { pending->Read(reader); }).ok()) {
+      pending->Read(reader);
     }
-    CHECK(found) << "Incorrect index entry didn't yield expected log entry: "
-                 << index_entry.ToString();
+  }
+}
 
-    prev_index_entry = index_entry;
+Status LogReader::ReplicateIterator::Next(unique_ptr<ReplicateMsg>* replicate) {
+  DCHECK(HasNext());
+
+  // Once ReadAhead() returns, the extent of every pending batch is known,
+  // since it only stops at the end of the range or at an index entry which
+  // points to another batch.
+  ReadAhead();
+  while (next_index_ > batches_.front()->last_index) {
+    batches_.pop_front();
+    ReadAhead();
   }
 
-  replicates->swap(replicates_tmp);
-  return Status::OK();
+  PendingBatch* pending = batches_.front().get();
+  pending->done.Wait();
+  RETURN_NOT_OK(pending->status);
+  LogEntryBatchPB* batch = pending->batch.get();
+
+  // Sanity-check the property that a batch should only have increasing indexes.
+  if (!pending->checked) {
+    int64_t prev_index = 0;
+    for (int i = 0; i < batch->entry_size(); ++i) {
+      const LogEntryPB& entry = batch->entry(i);
+      if (!entry.has_replicate()) continue;
+      int64_t this_index = entry.replicate().id().index();
+      CHECK_GT(this_index, prev_index)
+        << "Expected that an entry batch should only include increasing log indexes: "
+        << pending->index_entry.ToString()
+        << "\nBatch: " << SecureDebugString(*batch);
+      prev_index = this_index;
+    }
+    pending->checked = true;
+  }
+
+  for (; pending->next_entry < batch->entry_size(); pending->next_entry++) {
+    LogEntryPB* entry = batch->mutable_entry(pending->next_entry);
+    if (!entry->has_replicate() || entry->replicate().id().index() != next_index_) {
+      continue;
+    }
+    replicate->reset(entry->release_replicate());
+    pending->next_entry++;
+    next_index_++;
+    return Status::OK();
+  }
+  LOG(FATAL) << "Incorrect index entry didn't yield expected log entry for op "
+             << next_index_ << ": " << pending->index_entry.ToString();
+  return Status::OK(); // unreachable
 }
 
 Status LogReader::LookupOpId(int64_t op_index, OpId* op_id) const {
   LogIndexEntry index_entry;
-  RETURN_NOT_OK_PREPEND(log_index_->GetEntry(op_index, &index_entry),
+  RETURN_NOT_OK_PREPEND(LookupIndexEntry(op_index, &index_entry),
                         strings::Substitute("Failed to read log index for op $0", op_index));
   *op_id = index_entry.op_id;
   return Status::OK();
@@ -18,6 +18,7 @@
 #define KUDU_LOG_LOG_READER_H_
 
 #include <gtest/gtest.h>
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
@@ -91,6 +92,57 @@ class LogReader {
       std::vector<consensus::ReplicateMsg*>* replicates) const;
   static const int kNoSizeLimit;
 
+  // Iterates over the ReplicateMsgs from 'starting_at' to 'up_to' both
+  // inclusive, in index order.
+  //
+  // When --log_reader_read_ahead_batches is positive, the entry batches
+  // which hold the upcoming messages are read and decoded on a thread pool
+  // shared by all readers while the caller consumes the current ones, so that
+  // sequential consumers such as follower catch-up don't pay for reading,
+  // decompressing and parsing every batch on their own thread.
+  //
+  // Requires that a LogIndex was passed into LogReader::Open(). The reader
+  // must outlive the iterator. Not thread-safe.
+  class ReplicateIterator {
+   public:
+    ReplicateIterator(const LogReader* reader, int64_t starting_at, int64_t up_to);
+
+    // Waits for the batches still being read ahead.
+    ~ReplicateIterator();
+
+    // Returns whether there are messages left to read.
+    bool HasNext() const {
+      return next_index_ <= up_to_;
+    }
+
+    // Sets 'replicate' to the next message. Returns a bad Status if the
+    // batch holding it could not be read, for instance because its segment
+    // has been GCed.
+    Status Next(std::unique_ptr<consensus::ReplicateMsg>* replicate);
+
+   private:
+    struct PendingBatch;
+
+    // Looks up the index entries past the ones already looked up and starts
+    // reading the batches they point to, until enough batches are pending.
+    void ReadAhead();
+
+    const LogReader* const reader_;
+    const int64_t up_to_;
+
+    // The index of the next message to return.
+    int64_t next_index_;
+
+    // The index of the next index entry to look up.
+    int64_t next_lookup_index_;
+
+    // The batches being read or decoded and not yet consumed, in index
+    // order. The front one holds 'next_index_'.
+    std::deque<std::shared_ptr<PendingBatch>> batches_;
+
+    DISALLOW_COPY_AND_ASSIGN(ReplicateIterator);
+  };
+
   // Look up the OpId for the given operation index.
   // Returns a bad Status if the log index fails to load (eg. due to an IO error).
   Status LookupOpId(int64_t op_index, consensus::OpId* op_id) const;
@@ -154,6 +206,11 @@ class LogReader {
                                   faststring* tmp_buf,
                                   gscoped_ptr<LogEntryBatchPB>* batch) const;
 
+  // Looks up the index entry of the op with index 'index'. If a sparse index
+  // has evicted it, restores the entries of the closed segment whose footer
+  // covers the op into the index.
+  Status LookupIndexEntry(int64_t index, LogIndexEntry* entry) const;
+
   LogReader(FsManager* fs_manager, const scoped_refptr<LogIndex>& index,
             std::string tablet_id,
             const scoped_refptr<MetricEntity>& metric_entity);
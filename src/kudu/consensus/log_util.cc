@@ -25,6 +25,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/consensus/log_index.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/fs/fs_manager.h"
@@ -584,6 +585,32 @@ Status ReadableLogSegment::ReadEntries(vector<LogEntryPB*>* entries) {
   return Status::OK();
 }
 
+Status ReadableLogSegment::ReadIndexEntries(vector<LogIndexEntry>* entries) {
+  TRACE_EVENT1("log", "ReadableLogSegment::ReadIndexEntries",
+               "path", path_);
+  DCHECK(footer_.IsInitialized() && !footer_was_rebuilt_);
+  const int64_t read_up_to =
+      file_size() - footer_.ByteSize() - kLogSegmentFooterMagicAndFooterLength;
+  int64_t offset = first_entry_offset_;
+  faststring tmp_buf;
+  while (offset < read_up_to) {
+    const int64_t batch_offset = offset;
+    gscoped_ptr<LogEntryBatchPB> batch;
+    RETURN_NOT_OK(ReadEntryHeaderAndBatch(&offset, &tmp_buf, &batch));
+    for (const LogEntryPB& entry : batch->entry()) {
+      if (entry.type() != REPLICATE || !entry.has_replicate()) {
+        continue;
+      }
+      LogIndexEntry index_entry;
+      index_entry.op_id = entry.replicate().id();
+      index_entry.segment_sequence_number = header_.sequence_number();
+      index_entry.offset_in_segment = batch_offset;
+      entries->push_back(index_entry);
+    }
+  }
+  return Status::OK();
+}
+
 size_t ReadableLogSegment::entry_header_size() const {
   DCHECK(is_initialized_);
   return header_.has_deprecated_major_version() ? kEntryHeaderSizeV1 : kEntryHeaderSizeV2;
@@ -52,6 +52,7 @@ namespace log {
 extern const size_t kEntryHeaderSizeV2;
 
 class ReadableLogSegment;
+struct LogIndexEntry;
 
 // Options for the State Machine/Write Ahead Log
 struct LogOptions {
@@ -190,6 +191,11 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // vector.
   Status ReadEntries(std::vector<LogEntryPB*>* entries);
 
+  // Reads the REPLICATE messages of the segment, and appends to 'entries' the
+  // index entries of the batches which hold them, in order. Requires that the
+  // segment has a footer which was read rather than rebuilt.
+  Status ReadIndexEntries(std::vector<LogIndexEntry>* entries);
+
   // Rebuilds this segment's footer by scanning its entries.
   // This is an expensive operation as it reads and parses the whole segment
   // so it should be only used in the case of a crash, where the footer is
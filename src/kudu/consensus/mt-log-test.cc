@@ -35,6 +35,9 @@ DEFINE_int32(num_writer_threads, 4, "Number of threads writing to the log");
 DEFINE_int32(num_batches_per_thread, 2000, "Number of batches per thread");
 DEFINE_int32(num_ops_per_batch_avg, 5, "Target average number of ops per batch");
 
+DECLARE_double(log_group_commit_wait_sync_ratio);
+DECLARE_int32(log_group_commit_max_wait_us);
+
 namespace kudu {
 namespace log {
 
@@ -160,6 +163,27 @@ class MultiThreadedLogTest : public LogTestBase {
     stop_reader = true;
     reader_thread.join();
   }
+
+  // Closes the log and checks that it holds the operations appended since
+  // 'start_current_id', in order.
+  void CloseAndVerifyLog(int start_current_id) {
+    ASSERT_OK(log_->Close());
+
+    shared_ptr<LogReader> reader;
+    ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
+    SegmentSequence segments;
+    ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+
+    for (const SegmentSequence::value_type& entry : segments) {
+      ASSERT_OK(entry->ReadEntries(&entries_));
+    }
+    vector<uint32_t> ids;
+    EntriesToIdList(&ids);
+    DVLOG(1) << "Wrote total of " << current_index_ - start_current_id << " ops";
+    ASSERT_EQ(current_index_ - start_current_id, ids.size());
+    ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+  }
+
  private:
   ThreadSafeRandom random_;
   simple_spinlock lock_;
@@ -177,21 +201,21 @@ TEST_F(MultiThreadedLogTest, TestAppends) {
                                       FLAGS_num_batches_per_thread, FLAGS_num_writer_threads)) {
     ASSERT_NO_FATAL_FAILURE(Run());
   }
-  ASSERT_OK(log_->Close());
+  NO_FATALS(CloseAndVerifyLog(start_current_id));
+}
 
-  shared_ptr<LogReader> reader;
-  ASSERT_OK(LogReader::Open(fs_manager_.get(), nullptr, kTestTablet, nullptr, &reader));
-  SegmentSequence segments;
-  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+// Test concurrent appends when group commits are held back for more entries
+// to join them.
+TEST_F(MultiThreadedLogTest, TestAppendsWithGroupCommitWait) {
+  FLAGS_log_group_commit_max_wait_us = 500;
+  FLAGS_log_group_commit_wait_sync_ratio = 10;
+  FLAGS_num_batches_per_thread = std::min(FLAGS_num_batches_per_thread, 500);
+  options_.force_fsync_all = true;
 
-  for (const SegmentSequence::value_type& entry : segments) {
-    ASSERT_OK(entry->ReadEntries(&entries_));
-  }
-  vector<uint32_t> ids;
-  EntriesToIdList(&ids);
-  DVLOG(1) << "Wrote total of " << current_index_ - start_current_id << " ops";
-  ASSERT_EQ(current_index_ - start_current_id, ids.size());
-  ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+  ASSERT_OK(BuildLog());
+  int start_current_id = current_index_;
+  ASSERT_NO_FATAL_FAILURE(Run());
+  NO_FATALS(CloseAndVerifyLog(start_current_id));
 }
 
 } // namespace log
@@ -0,0 +1,211 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/multi_raft_batcher.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/consensus/consensus.proxy.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/messenger.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/net/net_util.h"
+#include "kudu/util/net/sockaddr.h"
+#include "kudu/util/pb_util.h"
+
+// This file uses C++14 'generalized lambda capture' syntax, which is supported
+// in C++11 mode both by clang and by GCC. Disable the accompanying warning.
+#pragma clang diagnostic ignored "-Wc++14-extensions"
+
+DEFINE_int32(consensus_heartbeat_batch_window_ms, 10,
+             "Maximum time (in milliseconds) for which a heartbeat is held back to be "
+             "batched with the heartbeats of other replicas sent to the same server, "
+             "when --consensus_batch_heartbeats is enabled.");
+TAG_FLAG(consensus_heartbeat_batch_window_ms, experimental);
+
+DEFINE_int32(consensus_heartbeat_max_batch_size, 1000,
+             "Maximum number of heartbeats sent to the same server in one batch, when "
+             "--consensus_batch_heartbeats is enabled.");
+TAG_FLAG(consensus_heartbeat_max_batch_size, experimental);
+
+DECLARE_int32(consensus_rpc_timeout_ms);
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::weak_ptr;
+using strings::Substitute;
+
+namespace kudu {
+namespace consensus {
+
+using rpc::ErrorStatusPB;
+using rpc::Messenger;
+using rpc::RpcController;
+
+struct MultiRaftHeartbeatBatcher::Batch {
+  vector<PendingHeartbeat> heartbeats;
+  MultiRaftConsensusRequestPB request;
+  MultiRaftConsensusResponsePB response;
+  RpcController controller;
+};
+
+Status MultiRaftHeartbeatBatcher::GetOrCreate(const shared_ptr<Messenger>& messenger,
+                                              const HostPort& hostport,
+                                              shared_ptr<MultiRaftHeartbeatBatcher>* batcher) {
+  // The batchers in use, keyed by messenger and destination. The batchers
+  // are owned by the peer proxies using them.
+  struct Registry {
+    simple_spinlock lock;
+    std::unordered_map<string, weak_ptr<MultiRaftHeartbeatBatcher>> batchers;
+  };
+  static Registry* registry = new Registry();
+
+  string key = Substitute("$0/$1", reinterpret_cast<uintptr_t>(messenger.get()),
+                          hostport.ToString());
+  std::lock_guard<simple_spinlock> l(registry->lock);
+  weak_ptr<MultiRaftHeartbeatBatcher>& entry = registry->batchers[key];
+  shared_ptr<MultiRaftHeartbeatBatcher> existing = entry.lock();
+  if (existing) {
+    *batcher = std::move(existing);
+    return Status::OK();
+  }
+
+  vector<Sockaddr> addrs;
+  RETURN_NOT_OK(hostport.ResolveAddresses(&addrs));
+  gscoped_ptr<ConsensusServiceProxy> proxy(new ConsensusServiceProxy(messenger, addrs[0]));
+  batcher->reset(new MultiRaftHeartbeatBatcher(messenger, std::move(proxy)));
+  entry = *batcher;
+  return Status::OK();
+}
+
+MultiRaftHeartbeatBatcher::MultiRaftHeartbeatBatcher(shared_ptr<Messenger> messenger,
+                                                     gscoped_ptr<ConsensusServiceProxy> proxy)
+    : messenger_(std::move(messenger)),
+      proxy_(std::move(proxy)),
+      flush_scheduled_(false),
+      batching_unsupported_(false) {
+}
+
+MultiRaftHeartbeatBatcher::~MultiRaftHeartbeatBatcher() {
+  DCHECK(pending_.empty());
+}
+
+void MultiRaftHeartbeatBatcher::HeartbeatAsync(const ConsensusRequestPB* request,
+                                               ConsensusResponsePB* response,
+                                               RpcController* controller,
+                                               const rpc::ResponseCallback& callback) {
+  DCHECK_EQ(0, request->ops_size());
+  if (batching_unsupported_) {
+    SendIndividually({ { request, response, controller, callback } });
+    return;
+  }
+
+  bool flush_now = false;
+  bool schedule_flush = false;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    pending_.push_back({ request, response, controller, callback });
+    if (pending_.size() >= std::max(1, FLAGS_consensus_heartbeat_max_batch_size)) {
+      flush_now = true;
+    } else if (!flush_scheduled_) {
+      flush_scheduled_ = true;
+      schedule_flush = true;
+    }
+  }
+  if (flush_now) {
+    Flush();
+  } else if (schedule_flush) {
+    // The flush runs even if the messenger is shutting down, so that the
+    // queued heartbeats fail rather than being dropped.
+    messenger_->ScheduleOnReactor([s_this = shared_from_this()](const Status& /* s */) {
+        {
+          std::lock_guard<simple_spinlock> l(s_this->lock_);
+          s_this->flush_scheduled_ = false;
+        }
+        s_this->Flush();
+      }, MonoDelta::FromMilliseconds(FLAGS_consensus_heartbeat_batch_window_ms));
+  }
+}
+
+void MultiRaftHeartbeatBatcher::Flush() {
+  shared_ptr<Batch> batch(new Batch());
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    batch->heartbeats.swap(pending_);
+  }
+  if (batch->heartbeats.empty()) {
+    return;
+  }
+  for (const PendingHeartbeat& hb : batch->heartbeats) {
+    *batch->request.add_requests() = *hb.request;
+  }
+  batch->controller.set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  proxy_->MultiRaftUpdateConsensusAsync(batch->request, &batch->response, &batch->controller,
+                                        [s_this = shared_from_this(), batch]() {
+                                          s_this->BatchResponseReceived(batch);
+                                        });
+}
+
+void MultiRaftHeartbeatBatcher::BatchResponseReceived(const shared_ptr<Batch>& batch) {
+  // Note: This method runs on the reactor thread.
+  const Status& s = batch->controller.status();
+  if (PREDICT_FALSE(!s.ok() || batch->response.has_error() ||
+                    batch->response.responses_size() != batch->heartbeats.size())) {
+    const ErrorStatusPB* err = batch->controller.error_response();
+    if (s.IsRemoteError() && err != nullptr && err->has_code() &&
+        (err->code() == ErrorStatusPB::ERROR_NO_SUCH_METHOD ||
+         err->code() == ErrorStatusPB::ERROR_NO_SUCH_SERVICE)) {
+      LOG(INFO) << "Server at " << proxy_->ToString() << " does not support batched "
+                << "heartbeats, sending them individually";
+      batching_unsupported_ = true;
+    } else {
+      KLOG_EVERY_N_SECS(WARNING, 60) << "Batch of " << batch->heartbeats.size()
+                                     << " heartbeats to " << proxy_->ToString()
+                                     << " failed, sending them individually: "
+                                     << (s.ok() ? SecureShortDebugString(batch->response.error())
+                                                : s.ToString());
+    }
+    SendIndividually(batch->heartbeats);
+    return;
+  }
+
+  for (size_t i = 0; i < batch->heartbeats.size(); i++) {
+    const PendingHeartbeat& hb = batch->heartbeats[i];
+    hb.response->Swap(batch->response.mutable_responses(i));
+    hb.callback();
+  }
+}
+
+void MultiRaftHeartbeatBatcher::SendIndividually(const vector<PendingHeartbeat>& heartbeats) {
+  for (const PendingHeartbeat& hb : heartbeats) {
+    hb.controller->set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+    proxy_->UpdateConsensusAsync(*hb.request, hb.response, hb.controller, hb.callback);
+  }
+}
+
+} // namespace consensus
+} // namespace kudu
@@ -0,0 +1,119 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CONSENSUS_MULTI_RAFT_BATCHER_H
+#define KUDU_CONSENSUS_MULTI_RAFT_BATCHER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/rpc/response_callback.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class HostPort;
+
+namespace rpc {
+class Messenger;
+class RpcController;
+} // namespace rpc
+
+namespace consensus {
+
+class ConsensusServiceProxy;
+
+// Coalesces the status-only consensus updates (heartbeats) which the leader
+// replicas of this server send to the replicas hosted by one other server
+// into MultiRaftUpdateConsensus RPCs, rather than sending one UpdateConsensus
+// RPC per tablet.
+//
+// Heartbeats are queued for at most --consensus_heartbeat_batch_window_ms,
+// or until --consensus_heartbeat_max_batch_size of them are queued. The
+// response to each heartbeat is dispatched to its caller as if it had been
+// sent on its own. If the batch fails as a whole, for example because the
+// remote server does not support batching, the heartbeats are sent again one
+// by one, so that each caller observes its own RPC status.
+//
+// This class is thread-safe.
+class MultiRaftHeartbeatBatcher : public std::enable_shared_from_this<MultiRaftHeartbeatBatcher> {
+ public:
+  // Returns the batcher for the heartbeats sent through 'messenger' to the
+  // consensus service at 'hostport', creating it if there is none yet. The
+  // batcher is shared by the peers of all the replicas using 'messenger'.
+  static Status GetOrCreate(const std::shared_ptr<rpc::Messenger>& messenger,
+                            const HostPort& hostport,
+                            std::shared_ptr<MultiRaftHeartbeatBatcher>* batcher);
+
+  MultiRaftHeartbeatBatcher(std::shared_ptr<rpc::Messenger> messenger,
+                            gscoped_ptr<ConsensusServiceProxy> proxy);
+  ~MultiRaftHeartbeatBatcher();
+
+  // Queues the status-only 'request' to be sent in the next batch. Like
+  // PeerProxy::UpdateAsync(), 'callback' is invoked once 'response' and
+  // 'controller' hold the outcome of the request. 'request', 'response' and
+  // 'controller' must remain valid until then.
+  void HeartbeatAsync(const ConsensusRequestPB* request,
+                      ConsensusResponsePB* response,
+                      rpc::RpcController* controller,
+                      const rpc::ResponseCallback& callback);
+
+ private:
+  struct PendingHeartbeat {
+    const ConsensusRequestPB* request;
+    ConsensusResponsePB* response;
+    rpc::RpcController* controller;
+    rpc::ResponseCallback callback;
+  };
+
+  // A batch of heartbeats sent in one RPC.
+  struct Batch;
+
+  // Sends the queued heartbeats, if any.
+  void Flush();
+
+  // Dispatches the responses of 'batch' to the callers of its heartbeats.
+  void BatchResponseReceived(const std::shared_ptr<Batch>& batch);
+
+  // Sends 'heartbeats' one by one, as UpdateConsensus RPCs.
+  void SendIndividually(const std::vector<PendingHeartbeat>& heartbeats);
+
+  const std::shared_ptr<rpc::Messenger> messenger_;
+  const gscoped_ptr<ConsensusServiceProxy> proxy_;
+
+  simple_spinlock lock_;
+  // The heartbeats waiting for the next batch.
+  std::vector<PendingHeartbeat> pending_;
+  // Whether a flush of 'pending_' is scheduled on the messenger.
+  bool flush_scheduled_;
+
+  // Set once the remote server rejected a batch because it does not support
+  // MultiRaftUpdateConsensus, after which heartbeats are sent individually.
+  std::atomic<bool> batching_unsupported_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiRaftHeartbeatBatcher);
+};
+
+} // namespace consensus
+} // namespace kudu
+
+#endif // KUDU_CONSENSUS_MULTI_RAFT_BATCHER_H
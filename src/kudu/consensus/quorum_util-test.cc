@@ -57,6 +57,27 @@ TEST(QuorumUtilTest, TestMemberExtraction) {
   ASSERT_EQ("B", peer_pb.permanent_uuid());
 }
 
+TEST(QuorumUtilTest, TestNonVoters) {
+  RaftConfigPB config;
+  SetPeerInfo("A", RaftPeerPB::VOTER, config.add_peers());
+  SetPeerInfo("B", RaftPeerPB::NON_VOTER, config.add_peers());
+  config.set_opid_index(1);
+  ASSERT_OK(VerifyRaftConfig(config, COMMITTED_QUORUM));
+  ASSERT_EQ(1, CountVoters(config));
+
+  ConsensusStatePB cstate;
+  *cstate.mutable_config() = config;
+  cstate.set_leader_uuid("A");
+  ASSERT_EQ(RaftPeerPB::LEADER, GetConsensusRole("A", cstate));
+  ASSERT_EQ(RaftPeerPB::LEARNER, GetConsensusRole("B", cstate));
+
+  // A config must have a voter to elect a leader from.
+  config.mutable_peers(0)->set_member_type(RaftPeerPB::NON_VOTER);
+  Status s = VerifyRaftConfig(config, COMMITTED_QUORUM);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  ASSERT_STR_CONTAINS(s.ToString(), "at least one voter");
+}
+
 TEST(QuorumUtilTest, TestDiffConsensusStates) {
   ConsensusStatePB old_cs;
   SetPeerInfo("A", RaftPeerPB::VOTER, old_cs.mutable_config()->add_peers());
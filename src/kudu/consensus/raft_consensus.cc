@@ -30,6 +30,7 @@
 #include "kudu/consensus/leader_election.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/metadata.pb.h"
+#include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/peer_manager.h"
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/consensus/raft_consensus_state.h"
@@ -45,6 +46,7 @@
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
+#include "kudu/util/status_callback.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 #include "kudu/util/url-coding.h"
@@ -109,6 +111,29 @@ DEFINE_bool(raft_enable_pre_election, true,
 TAG_FLAG(raft_enable_pre_election, experimental);
 TAG_FLAG(raft_enable_pre_election, runtime);
 
+DEFINE_bool(enable_leader_leases, false,
+            "Whether a leader considers itself to hold a lease, during which no other "
+            "replica can be elected, once a majority of the voters accepted one of its "
+            "requests. Reads served by a lease-holding leader are linearizable. Relies on "
+            "all the servers using the same election timeout flags, and is voided by "
+            "elections which ignore a live leader.");
+TAG_FLAG(enable_leader_leases, experimental);
+TAG_FLAG(enable_leader_leases, runtime);
+
+DEFINE_double(leader_lease_election_timeout_fraction, 0.8,
+              "Fraction of the minimum election timeout for which a leader holds its lease "
+              "after sending a request accepted by a majority of the voters. The rest of "
+              "the timeout allows for the drift between the clock rates of the servers.");
+TAG_FLAG(leader_lease_election_timeout_fraction, experimental);
+
+DEFINE_bool(raft_coalesce_write_replicates, false,
+            "Whether a leader coalesces the write operations submitted to it in quick "
+            "succession, appending them to its log and sending them to its peers together "
+            "rather than one at a time. Each write is still its own operation, with its own "
+            "OpId and response.");
+TAG_FLAG(raft_coalesce_write_replicates, experimental);
+TAG_FLAG(raft_coalesce_write_replicates, runtime);
+
 DECLARE_int32(memory_limit_warn_threshold_percentage);
 
 // Metrics
@@ -153,6 +178,7 @@ namespace consensus {
 
 using std::shared_ptr;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 using tserver::TabletServerErrorPB;
 
@@ -247,6 +273,7 @@ RaftConsensus::RaftConsensus(
       last_received_cur_leader_(MinimumOpId()),
       failed_elections_since_stable_leader_(0),
       mark_dirty_clbk_(std::move(mark_dirty_clbk)),
+      coalesced_flush_pending_(false),
       shutdown_(false),
       update_calls_for_tests_(0),
       follower_memory_pressure_rejections_(metric_entity->FindOrCreateCounter(
@@ -408,6 +435,17 @@ Status RaftConsensus::StartElection(ElectionMode mode, ElectionReason reason) {
                                   "a non-participant in the raft config",
                                   SecureShortDebugString(state_->GetActiveConfigUnlocked()));
     }
+    if (PREDICT_FALSE(active_role == RaftPeerPB::LEARNER)) {
+      // Non-voters receive the log, but never lead, so their election timer
+      // expiring is expected.
+      SnoozeFailureDetectorUnlocked();
+      if (reason == ELECTION_TIMEOUT_EXPIRED) {
+        return Status::OK();
+      }
+      return Status::IllegalState("Not starting election: Node is a non-voter "
+                                  "in the raft config",
+                                  SecureShortDebugString(state_->GetActiveConfigUnlocked()));
+    }
     LOG_WITH_PREFIX_UNLOCKED(INFO)
         << "Starting " << mode_str
         << " (" << ReasonString(reason, state_->GetLeaderUuidUnlocked()) << ")";
@@ -556,6 +594,10 @@ Status RaftConsensus::BecomeReplicaUnlocked() {
   // Now that we're a replica, we can allow voting for other nodes.
   withhold_votes_until_ = MonoTime::Min();
 
+  // Coalesced writes were replicated as leader, so append them before the
+  // queue leaves leader mode.
+  FlushCoalescedRoundsUnlocked();
+
   queue_->UnRegisterObserver(this);
   // Deregister ourselves from the queue. We don't care what get's replicated, since
   // we're stepping down.
@@ -572,6 +614,10 @@ Status RaftConsensus::Replicate(const scoped_refptr<ConsensusRound>& round) {
     ReplicaState::UniqueLock lock;
     RETURN_NOT_OK(state_->LockForReplicate(&lock, *round->replicate_msg()));
     RETURN_NOT_OK(round->CheckBoundTerm(state_->GetCurrentTermUnlocked()));
+    if (FLAGS_raft_coalesce_write_replicates &&
+        round->replicate_msg()->op_type() == WRITE_OP) {
+      return CoalesceNewRoundUnlocked(round);
+    }
     RETURN_NOT_OK(AppendNewRoundToQueueUnlocked(round));
   }
 
@@ -579,6 +625,60 @@ Status RaftConsensus::Replicate(const scoped_refptr<ConsensusRound>& round) {
   return Status::OK();
 }
 
+Status RaftConsensus::CoalesceNewRoundUnlocked(const scoped_refptr<ConsensusRound>& round) {
+  // The OpId is assigned right away, so that the operation is ordered with
+  // respect to its timestamp and to any operation appended meanwhile. The
+  // term can't change while writes are coalesced, since stepping down flushes
+  // them.
+  if (coalesced_msgs_.empty()) {
+    *round->replicate_msg()->mutable_id() = queue_->GetNextOpId();
+  } else {
+    const OpId& last_id = coalesced_msgs_.back()->get()->id();
+    *round->replicate_msg()->mutable_id() = MakeOpId(last_id.term(), last_id.index() + 1);
+  }
+  RETURN_NOT_OK(AddPendingOperationUnlocked(round));
+  coalesced_msgs_.push_back(round->replicate_scoped_refptr());
+  if (coalesced_flush_pending_) {
+    return Status::OK();
+  }
+
+  // The writes which arrive before the task runs are appended with this one.
+  coalesced_flush_pending_ = true;
+  Status s = thread_pool_->SubmitClosure(Bind(&RaftConsensus::FlushCoalescedRoundsTask, this));
+  if (PREDICT_FALSE(!s.ok())) {
+    // The pool is shutting down: the peers pick this up with the next request.
+    coalesced_flush_pending_ = false;
+    FlushCoalescedRoundsUnlocked();
+  }
+  return Status::OK();
+}
+
+void RaftConsensus::FlushCoalescedRoundsTask() {
+  {
+    std::lock_guard<simple_spinlock> lock(update_lock_);
+    ReplicaState::UniqueLock state_lock;
+    CHECK_OK(state_->LockForRead(&state_lock));
+    coalesced_flush_pending_ = false;
+    if (coalesced_msgs_.empty()) {
+      return;
+    }
+    FlushCoalescedRoundsUnlocked();
+  }
+  peer_manager_->SignalRequest();
+}
+
+void RaftConsensus::FlushCoalescedRoundsUnlocked() {
+  if (coalesced_msgs_.empty()) {
+    return;
+  }
+  vector<ReplicateRefPtr> msgs;
+  msgs.swap(coalesced_msgs_);
+  CHECK_OK_PREPEND(queue_->AppendOperations(
+                       msgs, Bind(CrashIfNotOkStatusCB,
+                                  "Enqueued replicate operations failed to write to WAL")),
+                   Substitute("$0: could not append to queue", LogPrefixUnlocked()));
+}
+
 Status RaftConsensus::CheckLeadershipAndBindTerm(const scoped_refptr<ConsensusRound>& round) {
   ReplicaState::UniqueLock lock;
   RETURN_NOT_OK(state_->LockForReplicate(&lock, *round->replicate_msg()));
@@ -587,6 +687,8 @@ Status RaftConsensus::CheckLeadershipAndBindTerm(const scoped_refptr<ConsensusRo
 }
 
 Status RaftConsensus::AppendNewRoundToQueueUnlocked(const scoped_refptr<ConsensusRound>& round) {
+  // Any coalesced writes precede this operation.
+  FlushCoalescedRoundsUnlocked();
   *round->replicate_msg()->mutable_id() = queue_->GetNextOpId();
   RETURN_NOT_OK(AddPendingOperationUnlocked(round));
 
@@ -1539,10 +1641,39 @@ Status RaftConsensus::ChangeConfig(const ChangeConfigRequestPB& req,
         }
         break;
 
-      // TODO: Support role change.
-      case CHANGE_ROLE:
+      case CHANGE_ROLE: {
+        if (!server.has_member_type()) {
+          return Status::InvalidArgument("server must have member_type specified",
+                                         SecureShortDebugString(req));
+        }
+        if (server_uuid == peer_uuid()) {
+          return Status::InvalidArgument(
+              Substitute("Cannot change the role of peer $0 because it is the leader. "
+                         "Force another leader to be elected first.", server_uuid));
+        }
+        RaftPeerPB* peer = nullptr;
+        for (RaftPeerPB& p : *new_config.mutable_peers()) {
+          if (p.permanent_uuid() == server_uuid) {
+            peer = &p;
+            break;
+          }
+        }
+        if (peer == nullptr) {
+          return Status::NotFound(
+              Substitute("Server with UUID $0 not a member of the config. RaftConfig: $1",
+                        server_uuid, SecureShortDebugString(committed_config)));
+        }
+        if (peer->member_type() == server.member_type()) {
+          return Status::InvalidArgument(
+              Substitute("Server with UUID $0 is already a $1", server_uuid,
+                         RaftPeerPB::MemberType_Name(server.member_type())));
+        }
+        peer->set_member_type(server.member_type());
+        break;
+      }
+
       default:
-        return Status::NotSupported("Role change is not yet implemented.");
+        return Status::NotSupported("Unknown config change type");
     }
 
     RETURN_NOT_OK(ReplicateConfigChangeUnlocked(committed_config, new_config,
@@ -1567,6 +1698,7 @@ void RaftConsensus::Shutdown() {
     // Transition to kShuttingDown state.
     CHECK_OK(state_->LockForShutdown(&lock));
     LOG_WITH_PREFIX_UNLOCKED(INFO) << "Raft consensus shutting down.";
+    FlushCoalescedRoundsUnlocked();
   }
 
   // Close the peer manager.
@@ -1751,12 +1883,41 @@ Status RaftConsensus::RequestVoteRespondVoteGranted(const VoteRequestPB* request
   return Status::OK();
 }
 
+void RaftConsensus::EvictLogCache() {
+  queue_->EvictCommittedOps();
+}
+
 RaftPeerPB::Role RaftConsensus::role() const {
   ReplicaState::UniqueLock lock;
   CHECK_OK(state_->LockForRead(&lock));
   return state_->GetActiveRoleUnlocked();
 }
 
+bool RaftConsensus::HasLeaderLease() const {
+  if (!FLAGS_enable_leader_leases) {
+    return false;
+  }
+  {
+    ReplicaState::UniqueLock lock;
+    CHECK_OK(state_->LockForRead(&lock));
+    if (state_->GetActiveRoleUnlocked() != RaftPeerPB::LEADER) {
+      return false;
+    }
+  }
+  // Until an op of its term is committed, the leader may not know of all the
+  // committed ops.
+  if (!queue_->IsCommittedIndexInCurrentTerm()) {
+    return false;
+  }
+  MonoTime grant_time = queue_->GetMajorityLeaseGrantTime();
+  if (grant_time == MonoTime::Min()) {
+    return false;
+  }
+  MonoDelta lease_duration = MonoDelta::FromNanoseconds(
+      MinimumElectionTimeout().ToNanoseconds() * FLAGS_leader_lease_election_timeout_fraction);
+  return MonoTime::Now() < grant_time + lease_duration;
+}
+
 std::string RaftConsensus::LogPrefixUnlocked() {
   return state_->LogPrefixUnlocked();
 }
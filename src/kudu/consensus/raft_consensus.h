@@ -129,6 +129,10 @@ class RaftConsensus : public Consensus,
 
   RaftPeerPB::Role role() const override;
 
+  bool HasLeaderLease() const override;
+
+  void EvictLogCache() override;
+
   std::string peer_uuid() const override;
 
   std::string tablet_id() const override;
@@ -430,6 +434,19 @@ class RaftConsensus : public Consensus,
   // Only virtual and protected for mocking purposes.
   Status AppendNewRoundToQueueUnlocked(const scoped_refptr<ConsensusRound>& round);
 
+  // As a leader, assign an OpId to the write 'round' and add it to the pending
+  // operations, but defer appending it to the queue to a task on the thread
+  // pool, which appends all the writes coalesced by then together.
+  // See --raft_coalesce_write_replicates.
+  Status CoalesceNewRoundUnlocked(const scoped_refptr<ConsensusRound>& round);
+
+  // Appends the coalesced writes to the queue and signals the peers.
+  void FlushCoalescedRoundsTask();
+
+  // Appends the coalesced writes, if any, to the queue. Must be called before
+  // anything else is appended, and before the queue leaves leader mode.
+  void FlushCoalescedRoundsUnlocked();
+
   // As a follower, start a consensus round not associated with a Transaction.
   // Only virtual and protected for mocking purposes.
   Status StartConsensusOnlyRoundUnlocked(const ReplicateRefPtr& msg);
@@ -495,6 +512,12 @@ class RaftConsensus : public Consensus,
   // taken, this lock must be taken first.
   mutable simple_spinlock update_lock_;
 
+  // The writes whose appends to the queue are deferred, in OpId order, and
+  // whether a task to append them is already scheduled. Protected by the
+  // ReplicaState lock.
+  std::vector<ReplicateRefPtr> coalesced_msgs_;
+  bool coalesced_flush_pending_;
+
   AtomicBool shutdown_;
 
   // The number of times Update() has been called, used for some test assertions.
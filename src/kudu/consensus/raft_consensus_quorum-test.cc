@@ -48,6 +48,7 @@
 
 DECLARE_int32(raft_heartbeat_interval_ms);
 DECLARE_bool(enable_leader_failure_detection);
+DECLARE_bool(raft_coalesce_write_replicates);
 
 METRIC_DECLARE_entity(tablet);
 
@@ -238,10 +239,15 @@ class RaftConsensusQuorumTest : public KuduTest {
   }
 
   Status AppendDummyMessage(int peer_idx,
-                            scoped_refptr<ConsensusRound>* round) {
+                            scoped_refptr<ConsensusRound>* round,
+                            OperationType op_type = NO_OP) {
     gscoped_ptr<ReplicateMsg> msg(new ReplicateMsg());
-    msg->set_op_type(NO_OP);
-    msg->mutable_noop_request();
+    msg->set_op_type(op_type);
+    if (op_type == WRITE_OP) {
+      msg->mutable_write_request()->set_tablet_id(kTestTablet);
+    } else {
+      msg->mutable_noop_request();
+    }
     msg->set_timestamp(clock_->Now().ToUint64());
 
     scoped_refptr<RaftConsensus> peer;
@@ -644,6 +650,41 @@ TEST_F(RaftConsensusQuorumTest, TestFollowersReplicateAndCommitSequence) {
   VerifyLogs(2, 0, 1);
 }
 
+// Tests that writes submitted back to back to a leader which coalesces them
+// are all replicated and committed, in order.
+TEST_F(RaftConsensusQuorumTest, TestCoalescedWritesReplicateAndCommit) {
+  FLAGS_raft_coalesce_write_replicates = true;
+  const int kFollower0Idx = 0;
+  const int kFollower1Idx = 1;
+  const int kLeaderIdx = 2;
+
+  ASSERT_OK(BuildAndStartConfig(3));
+
+  // Submit all the writes before waiting for any of them, so that they
+  // accumulate while the appends are pending.
+  vector<scoped_refptr<ConsensusRound> > rounds;
+  for (int i = 0; i < 100; i++) {
+    scoped_refptr<ConsensusRound> round;
+    ASSERT_OK(AppendDummyMessage(kLeaderIdx, &round, WRITE_OP));
+    if (!rounds.empty()) {
+      ASSERT_EQ(rounds.back()->id().index() + 1, round->id().index());
+    }
+    rounds.push_back(round);
+  }
+
+  shared_ptr<Synchronizer> commit_sync;
+  for (const scoped_refptr<ConsensusRound>& round : rounds) {
+    ASSERT_OK(WaitForReplicate(round.get()));
+    ASSERT_OK(CommitDummyMessage(kLeaderIdx, round.get(), &commit_sync));
+  }
+
+  ASSERT_OK(commit_sync->Wait());
+  const OpId& last_op_id = rounds.back()->id();
+  WaitForCommitIfNotAlreadyPresent(last_op_id.index(), kFollower0Idx, kLeaderIdx);
+  WaitForCommitIfNotAlreadyPresent(last_op_id.index(), kFollower1Idx, kLeaderIdx);
+  VerifyLogs(kLeaderIdx, kFollower0Idx, kFollower1Idx);
+}
+
 TEST_F(RaftConsensusQuorumTest, TestConsensusContinuesIfAMinorityFallsBehind) {
   // Constants with the indexes of peers with certain roles,
   // since peers don't change roles in this test.
@@ -0,0 +1,53 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/ref_counted_replicate.h"
+
+#include <string>
+
+#include <glog/logging.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+namespace kudu {
+namespace consensus {
+
+const scoped_refptr<RefCountedMemory>& RefCountedReplicate::EncodedAsRequestOp() {
+  std::call_once(encode_once_, [this]() {
+    const uint32_t tag = WireFormatLite::MakeTag(ConsensusRequestPB::kOpsFieldNumber,
+                                                 WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+    const int msg_size = msg_->ByteSize();
+    scoped_refptr<RefCountedString> encoded(new RefCountedString());
+    std::string* data = &encoded->data();
+    data->resize(CodedOutputStream::VarintSize32(tag) +
+                 CodedOutputStream::VarintSize32(msg_size) +
+                 msg_size);
+    uint8_t* dst = reinterpret_cast<uint8_t*>(&(*data)[0]);
+    dst = CodedOutputStream::WriteVarint32ToArray(tag, dst);
+    dst = CodedOutputStream::WriteVarint32ToArray(msg_size, dst);
+    dst = msg_->SerializeWithCachedSizesToArray(dst);
+    DCHECK_EQ(dst, reinterpret_cast<uint8_t*>(&(*data)[0]) + data->size());
+    encoded_ = std::move(encoded);
+  });
+  return encoded_;
+}
+
+} // namespace consensus
+} // namespace kudu
@@ -18,8 +18,11 @@
 #ifndef KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 #define KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 
+#include <mutex>
+
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/ref_counted_memory.h"
 #include "kudu/gutil/gscoped_ptr.h"
 
 namespace kudu {
@@ -34,8 +37,19 @@ class RefCountedReplicate : public RefCountedThreadSafe<RefCountedReplicate> {
     return msg_.get();
   }
 
+  // Returns the wire encoding of the message as an element of the 'ops'
+  // field of a ConsensusRequestPB, for use as an RPC request payload. The
+  // message is serialized on the first call, after which it must not be
+  // modified.
+  //
+  // Thread-safe.
+  const scoped_refptr<RefCountedMemory>& EncodedAsRequestOp();
+
  private:
   gscoped_ptr<ReplicateMsg> msg_;
+
+  std::once_flag encode_once_;
+  scoped_refptr<RefCountedMemory> encoded_;
 };
 
 typedef scoped_refptr<RefCountedReplicate> ReplicateRefPtr;
@@ -15,7 +15,10 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <memory>
+#include <set>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
@@ -26,6 +29,7 @@
 #include "kudu/fs/log_block_manager.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/util/env_util.h"
@@ -54,10 +58,15 @@ DECLARE_uint64(log_container_max_size);
 DECLARE_int64(fs_data_dirs_reserved_bytes);
 DECLARE_int64(disk_reserved_bytes_free_for_testing);
 DECLARE_int64(log_container_max_blocks);
+DECLARE_int32(log_block_manager_container_load_threads_per_dir);
+DECLARE_double(log_container_live_metadata_before_compact_ratio);
+DECLARE_string(fs_data_dirs_placement_policy);
 
 DECLARE_int32(fs_data_dirs_full_disk_cache_seconds);
 
 DECLARE_string(block_manager);
+DECLARE_bool(block_coalesce_close);
+DECLARE_int32(log_block_manager_hole_punch_interval_ms);
 
 DECLARE_double(env_inject_io_error_on_write_or_preallocate);
 
@@ -74,6 +83,10 @@ METRIC_DECLARE_gauge_uint64(log_block_manager_bytes_under_management);
 METRIC_DECLARE_gauge_uint64(log_block_manager_blocks_under_management);
 METRIC_DECLARE_counter(log_block_manager_containers);
 METRIC_DECLARE_counter(log_block_manager_full_containers);
+METRIC_DECLARE_counter(log_block_manager_metadata_compactions);
+METRIC_DECLARE_gauge_uint64(log_block_manager_startup_time_ms);
+METRIC_DECLARE_gauge_uint64(log_block_manager_pending_reclaimable_bytes);
+METRIC_DECLARE_counter(log_block_manager_holes_punched);
 
 // Data directory metrics.
 METRIC_DECLARE_gauge_uint64(data_dirs_full);
@@ -673,6 +686,46 @@ TYPED_TEST(BlockManagerTest, MultiPathTest) {
   ASSERT_NO_FATAL_FAILURE(this->RunMultipathTest(paths));
 }
 
+TYPED_TEST(BlockManagerTest, FindBlockDataDirTest) {
+  vector<string> paths;
+  for (int i = 0; i < 3; i++) {
+    paths.push_back(this->GetTestPath(Substitute("path$0", i)));
+  }
+  ASSERT_OK(this->ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                     shared_ptr<MemTracker>(),
+                                     paths,
+                                     true));
+
+  // Write the blocks concurrently, so that they're spread across all of the
+  // data dirs, and check that each is found in one of them.
+  vector<BlockId> block_ids;
+  {
+    ScopedWritableBlockCloser closer;
+    for (int i = 0; i < paths.size() * 2; i++) {
+      gscoped_ptr<WritableBlock> block;
+      ASSERT_OK(this->bm_->CreateBlock(&block));
+      ASSERT_OK(block->Append("test data"));
+      block_ids.push_back(block->id());
+      closer.AddBlock(std::move(block));
+    }
+    ASSERT_OK(closer.CloseBlocks());
+  }
+  std::set<string> dirs_seen;
+  for (const BlockId& block_id : block_ids) {
+    string dir;
+    ASSERT_OK(this->bm_->FindBlockDataDir(block_id, &dir));
+    ASSERT_NE(paths.end(), std::find(paths.begin(), paths.end(), dir)) << dir;
+    dirs_seen.insert(dir);
+  }
+  ASSERT_EQ(paths.size(), dirs_seen.size());
+
+  // Deleted blocks aren't found.
+  ASSERT_OK(this->bm_->DeleteBlock(block_ids[0]));
+  string dir;
+  Status s = this->bm_->FindBlockDataDir(block_ids[0], &dir);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+}
+
 static void CloseHelper(ReadableBlock* block) {
   CHECK_OK(block->Close());
 }
@@ -1390,5 +1443,303 @@ TEST_F(LogBlockManagerTest, TestContainerBlockLimiting) {
   NO_FATALS(AssertNumContainers(4));
 }
 
+TEST_F(LogBlockManagerTest, TestParallelContainerLoading) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  const int kNumContainers = 50;
+  const int kBlocksPerContainer = 10;
+
+  // Keep 'kNumContainers' blocks open at a time so that each goes into its
+  // own container.
+  vector<BlockId> block_ids;
+  for (int i = 0; i < kBlocksPerContainer; i++) {
+    ScopedWritableBlockCloser closer;
+    for (int j = 0; j < kNumContainers; j++) {
+      gscoped_ptr<WritableBlock> writer;
+      ASSERT_OK(bm_->CreateBlock(&writer));
+      ASSERT_OK(writer->Append(writer->id().ToString()));
+      block_ids.push_back(writer->id());
+      closer.AddBlock(std::move(writer));
+    }
+    ASSERT_OK(closer.CloseBlocks());
+  }
+  NO_FATALS(AssertNumContainers(kNumContainers));
+
+  // Delete every other block so that the DELETE records are replayed too.
+  vector<BlockId> live_ids;
+  for (int i = 0; i < block_ids.size(); i++) {
+    if (i % 2 == 0) {
+      ASSERT_OK(bm_->DeleteBlock(block_ids[i]));
+    } else {
+      live_ids.push_back(block_ids[i]);
+    }
+  }
+
+  FLAGS_log_block_manager_container_load_threads_per_dir = 8;
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(this->ReopenBlockManager(entity,
+                                     shared_ptr<MemTracker>(),
+                                     { GetTestDataDirectory() },
+                                     false));
+  ASSERT_EQ(kNumContainers, bm_->all_containers_.size());
+  ASSERT_EQ(live_ids.size(), bm_->blocks_by_block_id_.size());
+  ASSERT_TRUE(entity->FindOrNull(METRIC_log_block_manager_startup_time_ms));
+
+  // The surviving blocks should all be readable, and the deleted ones gone.
+  for (const BlockId& id : live_ids) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(bm_->OpenBlock(id, &block));
+    string expected = id.ToString();
+    uint64_t size;
+    ASSERT_OK(block->Size(&size));
+    ASSERT_EQ(expected.size(), size);
+    Slice data;
+    gscoped_ptr<uint8_t[]> scratch(new uint8_t[size]);
+    ASSERT_OK(block->Read(0, size, &data, scratch.get()));
+    ASSERT_EQ(expected, data.ToString());
+  }
+  for (int i = 0; i < block_ids.size(); i += 2) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_TRUE(bm_->OpenBlock(block_ids[i], &block).IsNotFound());
+  }
+}
+
+TEST_F(LogBlockManagerTest, TestMetadataCompaction) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  const int kNumBlocks = 20;
+
+  auto metadata_compactions = [](const scoped_refptr<MetricEntity>& entity) {
+    return down_cast<Counter*>(
+        entity->FindOrNull(METRIC_log_block_manager_metadata_compactions).get())->value();
+  };
+
+  // Fill a container with blocks and delete most of them, without compacting.
+  FLAGS_log_container_live_metadata_before_compact_ratio = 0;
+  vector<BlockId> block_ids;
+  for (int i = 0; i < kNumBlocks; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append(writer->id().ToString()));
+    ASSERT_OK(writer->Close());
+    block_ids.push_back(writer->id());
+  }
+  NO_FATALS(AssertNumContainers(1));
+  for (int i = 0; i < kNumBlocks - 5; i++) {
+    ASSERT_OK(bm_->DeleteBlock(block_ids[i]));
+  }
+  string data_file;
+  NO_FATALS(GetOnlyContainerDataFile(&data_file));
+  string metadata_file = StrCat(
+      data_file.substr(0, data_file.size() - strlen(LogBlockManager::kContainerDataFileSuffix)),
+      LogBlockManager::kContainerMetadataFileSuffix);
+  uint64_t uncompacted_size;
+  ASSERT_OK(env_->GetFileSize(metadata_file, &uncompacted_size));
+
+  // The metadata should be compacted at startup.
+  FLAGS_log_container_live_metadata_before_compact_ratio = 0.5;
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(this->ReopenBlockManager(entity,
+                                     shared_ptr<MemTracker>(),
+                                     { GetTestDataDirectory() },
+                                     false));
+  ASSERT_EQ(1, metadata_compactions(entity));
+  uint64_t compacted_size;
+  ASSERT_OK(env_->GetFileSize(metadata_file, &compacted_size));
+  ASSERT_LT(compacted_size, uncompacted_size);
+  ASSERT_EQ(5, bm_->blocks_by_block_id_.size());
+
+  // Further deletions should compact it in the background, while more blocks
+  // are being written to the container.
+  for (int i = kNumBlocks - 5; i < kNumBlocks - 1; i++) {
+    ASSERT_OK(bm_->DeleteBlock(block_ids[i]));
+  }
+  gscoped_ptr<WritableBlock> writer;
+  ASSERT_OK(bm_->CreateBlock(&writer));
+  ASSERT_OK(writer->Append(writer->id().ToString()));
+  ASSERT_OK(writer->Close());
+  vector<BlockId> live_ids = { block_ids.back(), writer->id() };
+  NO_FATALS(AssertNumContainers(1));
+
+  // Reopening waits for any compactions to finish. Everything should still
+  // be consistent, with no deleted blocks resurrected.
+  scoped_refptr<MetricEntity> new_entity = METRIC_ENTITY_server.Instantiate(&registry, "test2");
+  ASSERT_OK(this->ReopenBlockManager(new_entity,
+                                     shared_ptr<MemTracker>(),
+                                     { GetTestDataDirectory() },
+                                     false));
+  ASSERT_EQ(live_ids.size(), bm_->blocks_by_block_id_.size());
+  for (const BlockId& id : live_ids) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(bm_->OpenBlock(id, &block));
+    string expected = id.ToString();
+    Slice data;
+    gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+    ASSERT_OK(block->Read(0, expected.size(), &data, scratch.get()));
+    ASSERT_EQ(expected, data.ToString());
+  }
+  ASSERT_OK(env_->GetFileSize(metadata_file, &compacted_size));
+  ASSERT_LT(compacted_size, uncompacted_size);
+}
+
+TEST_F(LogBlockManagerTest, TestLoadAwarePlacement) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  vector<string> paths;
+  for (int i = 0; i < 3; i++) {
+    paths.push_back(GetTestPath(Substitute("path$0", i)));
+  }
+  ASSERT_OK(this->ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                     shared_ptr<MemTracker>(),
+                                     paths,
+                                     true));
+  FLAGS_fs_data_dirs_placement_policy = "load_aware";
+
+  // Make the first directory look like a degraded disk.
+  DataDir* slow_dir = bm_->dd_manager_.data_dirs()[0].get();
+  for (int i = 0; i < 100; i++) {
+    slow_dir->RecordWriteLatency(MonoDelta::FromSeconds(1));
+  }
+
+  // Write enough blocks concurrently to need several containers. None of
+  // them should land on the slow disk, since its pending writes would have
+  // to outnumber the others' a thousandfold.
+  ScopedWritableBlockCloser closer;
+  for (int i = 0; i < 12; i++) {
+    gscoped_ptr<WritableBlock> block;
+    ASSERT_OK(bm_->CreateBlock(&block));
+    ASSERT_OK(block->Append("test data"));
+    closer.AddBlock(std::move(block));
+  }
+  ASSERT_OK(closer.CloseBlocks());
+
+  // 3 children = dot, dotdot and the instance file; each container adds two.
+  vector<int> num_children;
+  for (const string& path : paths) {
+    vector<string> children;
+    ASSERT_OK(env_->GetChildren(path, &children));
+    num_children.push_back(children.size());
+  }
+  ASSERT_EQ(3, num_children[0]);
+  ASSERT_EQ(3 + 12, num_children[1]);
+  ASSERT_EQ(3 + 12, num_children[2]);
+  for (const auto& dd : bm_->dd_manager_.data_dirs()) {
+    ASSERT_EQ(0, dd->pending_block_writes());
+  }
+}
+
+// Coalesced closing of blocks, from several threads at once, must leave every
+// block durable and intact.
+TEST_F(LogBlockManagerTest, TestCoalescedCloseBlocks) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+  FLAGS_block_coalesce_close = true;
+
+  vector<string> paths;
+  for (int i = 0; i < 3; i++) {
+    paths.push_back(GetTestPath(Substitute("path$0", i)));
+  }
+  ASSERT_OK(this->ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                     shared_ptr<MemTracker>(),
+                                     paths,
+                                     true));
+
+  const int kNumThreads = 4;
+  const int kBlocksPerThread = 10;
+  vector<vector<BlockId>> ids(kNumThreads);
+  vector<Status> statuses(kNumThreads);
+  vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&, i]() {
+      ScopedWritableBlockCloser closer;
+      for (int j = 0; j < kBlocksPerThread; j++) {
+        gscoped_ptr<WritableBlock> block;
+        statuses[i] = bm_->CreateBlock(&block);
+        if (!statuses[i].ok()) return;
+        statuses[i] = block->Append(Substitute("block $0.$1", i, j));
+        if (!statuses[i].ok()) return;
+        ids[i].push_back(block->id());
+        closer.AddBlock(std::move(block));
+      }
+      statuses[i] = closer.CloseBlocks();
+    });
+  }
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  for (const Status& s : statuses) {
+    ASSERT_OK(s);
+  }
+
+  ASSERT_OK(this->ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                     shared_ptr<MemTracker>(),
+                                     paths,
+                                     false));
+  ASSERT_EQ(kNumThreads * kBlocksPerThread, bm_->CountBlocksForTests());
+  for (int i = 0; i < kNumThreads; i++) {
+    for (int j = 0; j < kBlocksPerThread; j++) {
+      string expected = Substitute("block $0.$1", i, j);
+      gscoped_ptr<ReadableBlock> block;
+      ASSERT_OK(bm_->OpenBlock(ids[i][j], &block));
+      Slice data;
+      gscoped_ptr<uint8_t[]> scratch(new uint8_t[expected.size()]);
+      ASSERT_OK(block->Read(0, expected.size(), &data, scratch.get()));
+      ASSERT_EQ(expected, data.ToString());
+    }
+  }
+}
+
+TEST_F(LogBlockManagerTest, TestDeferredHolePunching) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  // Make sure the background thread doesn't punch anything mid-test.
+  FLAGS_log_block_manager_hole_punch_interval_ms = 60 * 60 * 1000;
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  ASSERT_OK(this->ReopenBlockManager(entity,
+                                     shared_ptr<MemTracker>(),
+                                     { GetTestDataDirectory() },
+                                     false));
+
+  // Write some adjacent blocks to a single container.
+  const int kNumBlocks = 10;
+  vector<BlockId> block_ids;
+  for (int i = 0; i < kNumBlocks; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append(writer->id().ToString()));
+    ASSERT_OK(writer->Close());
+    block_ids.push_back(writer->id());
+  }
+  NO_FATALS(AssertNumContainers(1));
+
+  auto pending_bytes = [&]() {
+    return down_cast<AtomicGauge<uint64_t>*>(
+        entity->FindOrNull(METRIC_log_block_manager_pending_reclaimable_bytes).get())->value();
+  };
+  auto holes_punched = [&]() {
+    return down_cast<Counter*>(
+        entity->FindOrNull(METRIC_log_block_manager_holes_punched).get())->value();
+  };
+
+  // Deletions are queued rather than punched right away.
+  for (const BlockId& id : block_ids) {
+    ASSERT_OK(bm_->DeleteBlock(id));
+  }
+  ASSERT_GT(pending_bytes(), 0);
+  ASSERT_EQ(0, holes_punched());
+
+  // Shutting down drains the queue, and the adjacent blocks are freed with a
+  // single hole.
+  ASSERT_OK(this->ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                                     shared_ptr<MemTracker>(),
+                                     { GetTestDataDirectory() },
+                                     false));
+  ASSERT_EQ(0, pending_bytes());
+  ASSERT_EQ(1, holes_punched());
+  ASSERT_EQ(0, bm_->CountBlocksForTests());
+}
+
 } // namespace fs
 } // namespace kudu
@@ -18,6 +18,7 @@
 #include "kudu/fs/block_manager.h"
 
 #include <mutex>
+#include <vector>
 
 #include <glog/logging.h>
 
@@ -36,6 +37,15 @@ DEFINE_bool(block_manager_lock_dirs, true,
             "Note that read-only concurrent usage is still allowed.");
 TAG_FLAG(block_manager_lock_dirs, unsafe);
 
+DEFINE_bool(block_manager_direct_reads, false,
+            "Read data blocks with O_DIRECT, bypassing the operating system's "
+            "page cache, so that blocks are only cached once (in the block "
+            "cache). Falls back to buffered reads on filesystems without "
+            "O_DIRECT support. Each data file read this way holds an extra "
+            "file descriptor.");
+TAG_FLAG(block_manager_direct_reads, experimental);
+TAG_FLAG(block_manager_direct_reads, runtime);
+
 DEFINE_int64(block_manager_max_open_files, -1,
              "Maximum number of open file descriptors to be used for data "
              "blocks. If 0, there is no limit. If -1, Kudu will use half of "
@@ -48,6 +58,10 @@ using strings::Substitute;
 namespace kudu {
 namespace fs {
 
+Status ReadableBlock::SubmitReads(const std::vector<AsyncReadRequest*>& /* requests */) const {
+  return Status::NotSupported("asynchronous reads are not supported", id().ToString());
+}
+
 BlockManagerOptions::BlockManagerOptions()
   : read_only(false) {
 }
@@ -37,6 +37,7 @@ namespace kudu {
 
 class Env;
 class MemTracker;
+struct AsyncReadRequest;
 class MetricEntity;
 class Slice;
 
@@ -153,6 +154,14 @@ class ReadableBlock : public Block {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const = 0;
 
+  // Submit asynchronous reads of 'requests', whose offsets are relative to
+  // the start of the block. The block must remain open until every read has
+  // completed.
+  //
+  // Returns NotSupported, without invoking any callbacks, if the block has no
+  // asynchronous read path; see RandomAccessFile::SubmitReads().
+  virtual Status SubmitReads(const std::vector<AsyncReadRequest*>& requests) const;
+
   // Returns the memory usage of this object including the object itself.
   virtual size_t memory_footprint() const = 0;
 };
@@ -233,6 +242,11 @@ class BlockManager {
   // writer is closed.
   virtual Status DeleteBlock(const BlockId& block_id) = 0;
 
+  // Finds the root path of the data directory holding an existing block.
+  //
+  // Returns NotFound if the block does not exist.
+  virtual Status FindBlockDataDir(const BlockId& block_id, std::string* dir) = 0;
+
   // Closes (and fully synchronizes) the given blocks. Effectively like
   // Close() for each block but may be optimized for groups of blocks.
   //
@@ -17,6 +17,7 @@
 
 #include "kudu/fs/data_dirs.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <deque>
 #include <memory>
@@ -33,6 +34,7 @@
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/block_manager_util.h"
 #include "kudu/fs/fs.pb.h"
+#include "kudu/gutil/integral_types.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
@@ -43,6 +45,7 @@
 #include "kudu/util/env_util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/oid_generator.h"
@@ -62,6 +65,26 @@ DEFINE_int32(fs_data_dirs_full_disk_cache_seconds, 30,
 TAG_FLAG(fs_data_dirs_full_disk_cache_seconds, advanced);
 TAG_FLAG(fs_data_dirs_full_disk_cache_seconds, evolving);
 
+DEFINE_string(fs_data_dirs_placement_policy, "round_robin",
+              "Policy for choosing the data directory of each new block. "
+              "'round_robin' rotates through the data directories. "
+              "'load_aware' prefers directories with fewer blocks being "
+              "written, lower recent write latency and more free space, so "
+              "that a slow or busy disk receives fewer new blocks.");
+TAG_FLAG(fs_data_dirs_placement_policy, experimental);
+TAG_FLAG(fs_data_dirs_placement_policy, runtime);
+
+static bool ValidatePlacementPolicy(const char* flagname, const std::string& value) {
+  if (value == "round_robin" || value == "load_aware") {
+    return true;
+  }
+  LOG(ERROR) << flagname << " must be 'round_robin' or 'load_aware', value '"
+             << value << "' is invalid";
+  return false;
+}
+static bool dummy = google::RegisterFlagValidator(
+    &FLAGS_fs_data_dirs_placement_policy, &ValidatePlacementPolicy);
+
 METRIC_DEFINE_gauge_uint64(server, data_dirs_full,
                            "Data Directories Full",
                            kudu::MetricUnit::kDataDirectories,
@@ -149,7 +172,47 @@ DataDir::DataDir(Env* env,
       metadata_file_(std::move(metadata_file)),
       pool_(std::move(pool)),
       is_shutdown_(false),
-      is_full_(false) {
+      is_full_(false),
+      pending_block_writes_(0),
+      write_latency_us_(0),
+      bytes_free_(-1) {
+}
+
+void DataDir::RecordWriteLatency(const MonoDelta& latency) {
+  // Weight each new sample by 1/8, so that the average follows a degrading
+  // disk within a few dozen writes without being thrown by single outliers.
+  int64_t sample = std::max<int64_t>(latency.ToMicroseconds(), 1);
+  while (true) {
+    int64_t cur = write_latency_us_.Load();
+    int64_t next = cur == 0 ? sample : cur + (sample - cur) / 8;
+    if (write_latency_us_.CompareAndSet(cur, next)) {
+      return;
+    }
+  }
+}
+
+int64_t DataDir::GetBytesFree() {
+  MonoTime now = MonoTime::Now();
+  {
+    std::lock_guard<simple_spinlock> l(bytes_free_lock_);
+    if (last_check_bytes_free_.Initialized() &&
+        now < last_check_bytes_free_ + MonoDelta::FromSeconds(
+            FLAGS_fs_data_dirs_full_disk_cache_seconds)) {
+      return bytes_free_;
+    }
+    // Claim the refresh so that concurrent callers use the old value.
+    last_check_bytes_free_ = now;
+  }
+  int64_t bytes_free;
+  Status s = env_->GetBytesFree(dir_, &bytes_free);
+  if (!s.ok()) {
+    KLOG_EVERY_N(WARNING, 100) << Substitute("Could not get free space of $0: $1",
+                                             dir_, s.ToString());
+    bytes_free = -1;
+  }
+  std::lock_guard<simple_spinlock> l(bytes_free_lock_);
+  bytes_free_ = bytes_free;
+  return bytes_free_;
 }
 
 DataDir::~DataDir() {
@@ -382,6 +445,10 @@ Status DataDirManager::Open(int max_data_dirs, LockMode mode) {
 }
 
 Status DataDirManager::GetNextDataDir(DataDir** dir) {
+  if (FLAGS_fs_data_dirs_placement_policy == "load_aware") {
+    return GetLeastLoadedDataDir(dir);
+  }
+
   // Round robin through the data dirs, ignoring ones that are full.
   unordered_set<DataDir*> full_dds;
   while (true) {
@@ -403,12 +470,80 @@ Status DataDirManager::GetNextDataDir(DataDir** dir) {
     // This data dir was full. If all are full, we can't satisfy the request.
     full_dds.insert(candidate);
     if (full_dds.size() == data_dirs_.size()) {
-      return Status::IOError(
-          "All data directories are full. Please free some disk space or "
-          "consider changing the fs_data_dirs_reserved_bytes configuration "
-          "parameter", "", ENOSPC);
+      return AllDataDirsFullError();
+    }
+  }
+}
+
+Status DataDirManager::GetLeastLoadedDataDir(DataDir** dir) {
+  // Directories which have not recorded any writes yet are assumed to be
+  // fast: as fast as the fastest one which has, or 1ms if that is slower.
+  static const int64_t kDefaultLatencyUs = 1000;
+
+  struct Candidate {
+    DataDir* dir;
+    int64_t bytes_free;
+  };
+  vector<Candidate> candidates;
+  candidates.reserve(data_dirs_.size());
+  int64_t max_bytes_free = 0;
+  int64_t min_latency_us = kint64max;
+
+  // Start from the round-robin position so that ties rotate.
+  int32_t start;
+  int32_t next;
+  do {
+    start = data_dirs_next_.Load();
+    next = (start + 1) % data_dirs_.size();
+  } while (!data_dirs_next_.CompareAndSet(start, next));
+  for (int i = 0; i < data_dirs_.size(); i++) {
+    DataDir* dd = data_dirs_[(start + i) % data_dirs_.size()].get();
+    RETURN_NOT_OK(dd->RefreshIsFull(DataDir::RefreshMode::EXPIRED_ONLY));
+    if (dd->is_full()) {
+      continue;
+    }
+    int64_t bytes_free = dd->GetBytesFree();
+    candidates.push_back({ dd, bytes_free });
+    max_bytes_free = std::max(max_bytes_free, bytes_free);
+    if (dd->write_latency_us() > 0) {
+      min_latency_us = std::min(min_latency_us, dd->write_latency_us());
+    }
+  }
+  if (candidates.empty()) {
+    return AllDataDirsFullError();
+  }
+  min_latency_us = std::min(min_latency_us, kDefaultLatencyUs);
+
+  DataDir* best = nullptr;
+  double best_cost = 0;
+  for (const Candidate& c : candidates) {
+    int64_t latency_us = c.dir->write_latency_us();
+    if (latency_us == 0) {
+      latency_us = min_latency_us;
+    }
+    // The expected time for a new write to complete, given the writes
+    // already queued on the disk.
+    double cost = static_cast<double>(latency_us) * (1 + c.dir->pending_block_writes());
+
+    // Steer new blocks away from fuller disks, by up to a factor of 10.
+    if (c.bytes_free >= 0 && max_bytes_free > 0) {
+      cost *= std::min(10.0, static_cast<double>(max_bytes_free) /
+                             std::max<int64_t>(c.bytes_free, 1));
+    }
+    if (best == nullptr || cost < best_cost) {
+      best = c.dir;
+      best_cost = cost;
     }
   }
+  *dir = best;
+  return Status::OK();
+}
+
+Status DataDirManager::AllDataDirsFullError() {
+  return Status::IOError(
+      "All data directories are full. Please free some disk space or "
+      "consider changing the fs_data_dirs_reserved_bytes configuration "
+      "parameter", "", ENOSPC);
 }
 
 DataDir* DataDirManager::FindDataDirByUuidIndex(uint16_t uuid_idx) const {
@@ -23,6 +23,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/callback_forward.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/macros.h"
@@ -96,6 +97,31 @@ class DataDir {
     return is_full_;
   }
 
+  // Load statistics, used to place new blocks when
+  // --fs_data_dirs_placement_policy is 'load_aware'.
+  //
+  // Block managers bracket the writing of each block with
+  // BlockWriteStarted() and BlockWriteFinished(), and report the duration of
+  // each data write or sync with RecordWriteLatency().
+  void BlockWriteStarted() { pending_block_writes_.Increment(); }
+  void BlockWriteFinished() { pending_block_writes_.IncrementBy(-1); }
+  void RecordWriteLatency(const MonoDelta& latency);
+
+  // The number of blocks currently being written to this directory.
+  int32_t pending_block_writes() const { return pending_block_writes_.Load(); }
+
+  // An exponentially weighted moving average of recent write latencies, or 0
+  // if no writes have been recorded.
+  int64_t write_latency_us() const { return write_latency_us_.Load(); }
+
+  // The free space of the directory's filesystem, refreshing it first if it
+  // was last measured more than --fs_data_dirs_full_disk_cache_seconds ago.
+  // Returns -1 if it could not be measured.
+  int64_t GetBytesFree();
+
+  // Schedules the block I/O issued to this directory by I/O class.
+  IOScheduler* io_scheduler() { return &io_scheduler_; }
+
  private:
   Env* env_;
   DataDirMetrics* metrics_;
@@ -110,6 +136,16 @@ class DataDir {
   MonoTime last_check_is_full_;
   bool is_full_;
 
+  AtomicInt<int32_t> pending_block_writes_;
+  AtomicInt<int64_t> write_latency_us_;
+
+  // Protects 'last_check_bytes_free_' and 'bytes_free_'.
+  simple_spinlock bytes_free_lock_;
+  MonoTime last_check_bytes_free_;
+  int64_t bytes_free_;
+
+  IOScheduler io_scheduler_;
+
   DISALLOW_COPY_AND_ASSIGN(DataDir);
 };
 
@@ -147,8 +183,11 @@ class DataDirManager {
   // 'max_data_dirs', or if 'mode' is MANDATORY and locks could not be taken.
   Status Open(int max_data_dirs, LockMode mode);
 
-  // Retrieves the next data directory that isn't full. Directories are rotated
-  // via round-robin. Full directories are skipped.
+  // Retrieves the next data directory that isn't full, according to
+  // --fs_data_dirs_placement_policy. With 'round_robin', directories are
+  // rotated via round-robin. With 'load_aware', the directory expected to
+  // complete a write soonest is chosen; see GetLeastLoadedDataDir(). Full
+  // directories are skipped.
   //
   // Returns an error if all data directories are full, or upon filesystem
   // error. On success, 'dir' is guaranteed to be set.
@@ -170,6 +209,15 @@ class DataDirManager {
   }
 
  private:
+  // Picks the non-full data directory with the lowest load-aware cost: its
+  // recent write latency times one more than its number of pending block
+  // writes, scaled up by how much less free space it has than the emptiest
+  // directory. Ties are broken in round-robin order.
+  Status GetLeastLoadedDataDir(DataDir** dir);
+
+  // Returns an error for when all data directories are full.
+  static Status AllDataDirsFullError();
+
   Env* env_;
   const std::string block_manager_type_;
   const std::vector<std::string> paths_;
@@ -42,6 +42,7 @@ using strings::Substitute;
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
+DECLARE_bool(block_manager_direct_reads);
 
 namespace kudu {
 namespace fs {
@@ -297,7 +298,10 @@ Status FileWritableBlock::Append(const Slice& data) {
   DCHECK(state_ == CLEAN || state_ == DIRTY)
       << "Invalid state: " << state_;
 
-  RETURN_NOT_OK(writer_->Append(data));
+  {
+    ScopedIO io(location_.data_dir()->io_scheduler(), data.size());
+    RETURN_NOT_OK(writer_->Append(data));
+  }
   RETURN_NOT_OK(location_.data_dir()->RefreshIsFull(
       DataDir::RefreshMode::ALWAYS));
   state_ = DIRTY;
@@ -382,6 +386,8 @@ class FileReadableBlock : public ReadableBlock {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE;
 
+  virtual Status SubmitReads(const vector<AsyncReadRequest*>& requests) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
  private:
@@ -444,7 +450,21 @@ Status FileReadableBlock::Read(uint64_t offset, size_t length,
                                Slice* result, uint8_t* scratch) const {
   DCHECK(!closed_.Load());
 
-  RETURN_NOT_OK(env_util::ReadFully(reader_.get(), offset, length, result, scratch));
+  {
+    // The data directory is looked up rather than stored, to keep this
+    // class small.
+    DataDir* dir = block_manager_->dd_manager_.FindDataDirByUuidIndex(
+        FileBlockLocation::GetDataDirIdx(block_id_));
+    ScopedIO io(dir ? dir->io_scheduler() : nullptr, length);
+    Status s = Status::NotSupported("");
+    if (FLAGS_block_manager_direct_reads) {
+      s = reader_->ReadUncached(offset, length, result, scratch);
+    }
+    if (s.IsNotSupported()) {
+      s = env_util::ReadFully(reader_.get(), offset, length, result, scratch);
+    }
+    RETURN_NOT_OK(s);
+  }
   if (block_manager_->metrics_) {
     block_manager_->metrics_->total_bytes_read->IncrementBy(length);
   }
@@ -452,6 +472,20 @@ Status FileReadableBlock::Read(uint64_t offset, size_t length,
   return Status::OK();
 }
 
+Status FileReadableBlock::SubmitReads(const vector<AsyncReadRequest*>& requests) const {
+  DCHECK(!closed_.Load());
+
+  RETURN_NOT_OK(reader_->SubmitReads(requests));
+  if (block_manager_->metrics_) {
+    size_t length = 0;
+    for (const AsyncReadRequest* req : requests) {
+      length += req->length;
+    }
+    block_manager_->metrics_->total_bytes_read->IncrementBy(length);
+  }
+  return Status::OK();
+}
+
 size_t FileReadableBlock::memory_footprint() const {
   DCHECK(reader_);
   return kudu_malloc_usable_size(this) + reader_->memory_footprint();
@@ -631,6 +665,18 @@ Status FileBlockManager::OpenBlock(const BlockId& block_id,
   return Status::OK();
 }
 
+Status FileBlockManager::FindBlockDataDir(const BlockId& block_id, string* dir) {
+  DataDir* data_dir = dd_manager_.FindDataDirByUuidIndex(
+      internal::FileBlockLocation::GetDataDirIdx(block_id));
+  if (!data_dir || !env_->FileExists(internal::FileBlockLocation::FromBlockId(
+          data_dir, block_id).GetFullPath())) {
+    return Status::NotFound(
+        Substitute("Block $0 not found", block_id.ToString()));
+  }
+  *dir = data_dir->dir();
+  return Status::OK();
+}
+
 Status FileBlockManager::DeleteBlock(const BlockId& block_id) {
   CHECK(!read_only_);
 
@@ -92,6 +92,8 @@ class FileBlockManager : public BlockManager {
 
   virtual Status DeleteBlock(const BlockId& block_id) OVERRIDE;
 
+  virtual Status FindBlockDataDir(const BlockId& block_id, std::string* dir) OVERRIDE;
+
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
  private:
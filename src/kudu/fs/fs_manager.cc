@@ -36,6 +36,7 @@
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/strip.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
@@ -96,11 +97,13 @@ namespace kudu {
 const char *FsManager::kWalDirName = "wals";
 const char *FsManager::kWalFileNamePrefix = "wal";
 const char *FsManager::kWalsRecoveryDirSuffix = ".recovery";
+const char *FsManager::kTabletMetadataDeltaLogSuffix = ".delta";
 const char *FsManager::kTabletMetadataDirName = "tablet-meta";
 const char *FsManager::kDataDirName = "data";
 const char *FsManager::kCorruptedSuffix = ".corrupted";
 const char *FsManager::kInstanceMetadataFileName = "instance";
 const char *FsManager::kConsensusMetadataDirName = "consensus-meta";
+const char *FsManager::kBlockCacheHotBlocksFileName = "block-cache-hot-blocks";
 
 FsManagerOpts::FsManagerOpts()
   : wal_path(FLAGS_fs_wal_dir),
@@ -405,6 +408,10 @@ string FsManager::GetTabletMetadataPath(const string& tablet_id) const {
   return JoinPathSegments(GetTabletMetadataDir(), tablet_id);
 }
 
+string FsManager::GetTabletMetadataDeltaLogPath(const string& tablet_id) const {
+  return StrCat(GetTabletMetadataPath(tablet_id), kTabletMetadataDeltaLogSuffix);
+}
+
 namespace {
 // Return true if 'fname' is a valid tablet ID.
 bool IsValidTabletId(const string& fname) {
@@ -420,6 +427,11 @@ bool IsValidTabletId(const string& fname) {
     return false;
   }
 
+  if (HasSuffixString(fname, FsManager::kTabletMetadataDeltaLogSuffix)) {
+    // A tablet's superblock delta log.
+    return false;
+  }
+
   return true;
 }
 } // anonymous namespace
@@ -96,6 +96,7 @@ class FsManager {
  public:
   static const char *kWalFileNamePrefix;
   static const char *kWalsRecoveryDirSuffix;
+  static const char *kTabletMetadataDeltaLogSuffix;
 
   // Only for unit tests.
   FsManager(Env* env, const std::string& root_path);
@@ -163,12 +164,21 @@ class FsManager {
   // Return the path for a specific tablet's superblock.
   std::string GetTabletMetadataPath(const std::string& tablet_id) const;
 
+  // Return the path for a specific tablet's superblock delta log.
+  std::string GetTabletMetadataDeltaLogPath(const std::string& tablet_id) const;
+
   // List the tablet IDs in the metadata directory.
   Status ListTabletIds(std::vector<std::string>* tablet_ids);
 
   // Return the path where InstanceMetadataPB is stored.
   std::string GetInstanceMetadataPath(const std::string& root) const;
 
+  // Return the path where the block cache's hot blocks are persisted.
+  std::string GetBlockCacheHotBlocksPath() const {
+    DCHECK(initted_);
+    return JoinPathSegments(canonicalized_metadata_fs_root_, kBlockCacheHotBlocksFileName);
+  }
+
   // Return the directory where the consensus metadata is stored.
   std::string GetConsensusMetadataDir() const {
     DCHECK(initted_);
@@ -250,6 +260,7 @@ class FsManager {
   static const char *kInstanceMetadataMagicNumber;
   static const char *kTabletSuperBlockMagicNumber;
   static const char *kConsensusMetadataDirName;
+  static const char *kBlockCacheHotBlocksFileName;
 
   Env *env_;
 
@@ -0,0 +1,220 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <thread>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/fs/io_scheduler.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_bool(fs_io_scheduler_enabled);
+DECLARE_int32(fs_io_compaction_max_mb_per_sec);
+DECLARE_int32(fs_io_scheduler_max_background_ops_while_busy);
+DECLARE_int32(fs_io_background_max_mb_per_sec);
+DECLARE_int32(fs_io_foreground_target_latency_ms);
+
+using std::thread;
+using std::vector;
+
+namespace kudu {
+namespace fs {
+
+class IOSchedulerTest : public KuduTest {
+ public:
+  void SetUp() override {
+    KuduTest::SetUp();
+    FLAGS_fs_io_scheduler_enabled = true;
+  }
+
+ protected:
+  IOScheduler scheduler_;
+};
+
+TEST_F(IOSchedulerTest, TestScopedIOClass) {
+  ASSERT_EQ(IOClass::FOREGROUND, ScopedIOClass::Current());
+  {
+    ScopedIOClass c(IOClass::COMPACTION);
+    ASSERT_EQ(IOClass::COMPACTION, ScopedIOClass::Current());
+    {
+      ScopedIOClass f(IOClass::FLUSH);
+      ASSERT_EQ(IOClass::FLUSH, ScopedIOClass::Current());
+    }
+    ASSERT_EQ(IOClass::COMPACTION, ScopedIOClass::Current());
+
+    // The class is per-thread.
+    thread t([]() { ASSERT_EQ(IOClass::FOREGROUND, ScopedIOClass::Current()); });
+    t.join();
+  }
+  ASSERT_EQ(IOClass::FOREGROUND, ScopedIOClass::Current());
+}
+
+// Background I/O is limited while foreground I/O is in flight, and resumes
+// once it completes.
+TEST_F(IOSchedulerTest, TestForegroundPriority) {
+  FLAGS_fs_io_scheduler_max_background_ops_while_busy = 1;
+
+  scheduler_.Start(IOClass::FOREGROUND, 4096);
+  scheduler_.Start(IOClass::FLUSH, 4096);
+
+  AtomicBool started(false);
+  thread t([&]() {
+    ScopedIOClass c(IOClass::COMPACTION);
+    ScopedIO io(&scheduler_, 4096);
+    started.Store(true);
+  });
+  SleepFor(MonoDelta::FromMilliseconds(200));
+  ASSERT_FALSE(started.Load());
+
+  // Foreground I/O is never held up.
+  scheduler_.Start(IOClass::FOREGROUND, 4096);
+  scheduler_.Finish(IOClass::FOREGROUND);
+
+  scheduler_.Finish(IOClass::FOREGROUND);
+  t.join();
+  ASSERT_TRUE(started.Load());
+  scheduler_.Finish(IOClass::FLUSH);
+}
+
+// A bandwidth cap holds a class to its configured rate.
+TEST_F(IOSchedulerTest, TestBandwidthCap) {
+  FLAGS_fs_io_compaction_max_mb_per_sec = 10;
+  const int64_t kChunk = 1024 * 1024;
+
+  // The first second's worth of I/O may be issued in a burst; the following
+  // 10MB should take about a second.
+  MonoTime start;
+  for (int i = 0; i < 20; i++) {
+    if (i == 10) {
+      start = MonoTime::Now();
+    }
+    scheduler_.Start(IOClass::COMPACTION, kChunk);
+    scheduler_.Finish(IOClass::COMPACTION);
+  }
+  MonoDelta elapsed = MonoTime::Now() - start;
+  ASSERT_GT(elapsed.ToMilliseconds(), 800);
+  ASSERT_LT(elapsed.ToMilliseconds(), 5000);
+}
+
+// The server-wide cap holds the background I/O to all data directories,
+// together, to its configured rate.
+TEST_F(IOSchedulerTest, TestServerBandwidthCap) {
+  FLAGS_fs_io_background_max_mb_per_sec = 10;
+  const int64_t kChunk = 1024 * 1024;
+  IOScheduler other_scheduler;
+
+  // After the initial burst, 10MB split between the two directories should
+  // take about a second.
+  MonoTime start;
+  for (int i = 0; i < 20; i++) {
+    if (i == 10) {
+      start = MonoTime::Now();
+    }
+    IOScheduler* scheduler = i % 2 == 0 ? &scheduler_ : &other_scheduler;
+    scheduler->Start(IOClass::FLUSH, kChunk);
+    scheduler->Finish(IOClass::FLUSH);
+  }
+  MonoDelta elapsed = MonoTime::Now() - start;
+  FLAGS_fs_io_background_max_mb_per_sec = 0;
+  ASSERT_GT(elapsed.ToMilliseconds(), 800);
+  ASSERT_LT(elapsed.ToMilliseconds(), 5000);
+}
+
+// Slow foreground I/O scales the background bandwidth caps back, and they
+// recover once it's fast again.
+TEST_F(IOSchedulerTest, TestForegroundLatencyFeedback) {
+  FLAGS_fs_io_foreground_target_latency_ms = 10;
+  ASSERT_EQ(1, scheduler_.background_scale());
+
+  for (int i = 0; i < 3; i++) {
+    SleepFor(MonoDelta::FromMilliseconds(110));
+    scheduler_.Start(IOClass::FOREGROUND, 4096);
+    scheduler_.Finish(IOClass::FOREGROUND, MonoDelta::FromMilliseconds(50));
+  }
+  ASSERT_EQ(0.125, scheduler_.background_scale());
+
+  // The average latency takes a number of fast I/Os to come down.
+  for (int i = 0; i < 50; i++) {
+    scheduler_.Start(IOClass::FOREGROUND, 4096);
+    scheduler_.Finish(IOClass::FOREGROUND, MonoDelta::FromMilliseconds(1));
+  }
+  SleepFor(MonoDelta::FromMilliseconds(110));
+  scheduler_.Start(IOClass::FOREGROUND, 4096);
+  scheduler_.Finish(IOClass::FOREGROUND, MonoDelta::FromMilliseconds(1));
+  ASSERT_GT(scheduler_.background_scale(), 0.125);
+
+  FLAGS_fs_io_foreground_target_latency_ms = 0;
+}
+
+// Concurrent background classes share the device in proportion to their
+// weights.
+TEST_F(IOSchedulerTest, TestWeightedFairness) {
+  FLAGS_fs_io_scheduler_max_background_ops_while_busy = 1;
+  const int kOpsPerThread = 200;
+
+  // Hold a foreground I/O so that background I/Os are dispatched one at a
+  // time, and so compete with each other.
+  scheduler_.Start(IOClass::FOREGROUND, 0);
+  AtomicInt<int32_t> flush_ops(0);
+  AtomicInt<int32_t> tablet_copy_ops(0);
+  AtomicBool stop(false);
+  vector<thread> threads;
+  threads.emplace_back([&]() {
+    ScopedIOClass c(IOClass::FLUSH);
+    for (int i = 0; i < kOpsPerThread && !stop.Load(); i++) {
+      ScopedIO io(&scheduler_, 4096);
+      flush_ops.Increment();
+    }
+    stop.Store(true);
+  });
+  threads.emplace_back([&]() {
+    ScopedIOClass c(IOClass::TABLET_COPY);
+    for (int i = 0; i < kOpsPerThread && !stop.Load(); i++) {
+      ScopedIO io(&scheduler_, 4096);
+      tablet_copy_ops.Increment();
+    }
+    stop.Store(true);
+  });
+  for (thread& t : threads) {
+    t.join();
+  }
+  scheduler_.Finish(IOClass::FOREGROUND);
+
+  // Flushes are weighted four times as heavily as tablet copies.
+  LOG(INFO) << "flush ops: " << flush_ops.Load()
+            << ", tablet copy ops: " << tablet_copy_ops.Load();
+  ASSERT_EQ(kOpsPerThread, flush_ops.Load());
+  ASSERT_LT(tablet_copy_ops.Load(), kOpsPerThread / 2);
+}
+
+TEST_F(IOSchedulerTest, TestDisabled) {
+  FLAGS_fs_io_scheduler_enabled = false;
+  FLAGS_fs_io_compaction_max_mb_per_sec = 1;
+  ScopedIOClass c(IOClass::COMPACTION);
+  MonoTime start = MonoTime::Now();
+  for (int i = 0; i < 10; i++) {
+    ScopedIO io(&scheduler_, 1024 * 1024);
+  }
+  ASSERT_LT((MonoTime::Now() - start).ToMilliseconds(), 1000);
+}
+
+} // namespace fs
+} // namespace kudu
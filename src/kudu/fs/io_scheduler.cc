@@ -0,0 +1,304 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/fs/io_scheduler.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/trace.h"
+
+DEFINE_bool(fs_io_scheduler_enabled, false,
+            "Whether to schedule the block I/O issued to each data directory "
+            "by class, so that flushes, compactions and tablet copies can't "
+            "starve foreground reads on the same device.");
+TAG_FLAG(fs_io_scheduler_enabled, experimental);
+TAG_FLAG(fs_io_scheduler_enabled, runtime);
+
+DEFINE_int32(fs_io_scheduler_max_background_ops_while_busy, 1,
+             "The maximum number of background block I/Os that may be in "
+             "flight to a data directory while it has foreground I/O in "
+             "flight. Only takes effect with --fs_io_scheduler_enabled.");
+TAG_FLAG(fs_io_scheduler_max_background_ops_while_busy, experimental);
+TAG_FLAG(fs_io_scheduler_max_background_ops_while_busy, runtime);
+
+DEFINE_int32(fs_io_flush_max_mb_per_sec, 0,
+             "The maximum rate at which flushes may read and write each data "
+             "directory, or 0 for no limit. Only takes effect with "
+             "--fs_io_scheduler_enabled.");
+TAG_FLAG(fs_io_flush_max_mb_per_sec, experimental);
+TAG_FLAG(fs_io_flush_max_mb_per_sec, runtime);
+
+DEFINE_int32(fs_io_compaction_max_mb_per_sec, 0,
+             "The maximum rate at which compactions may read and write each "
+             "data directory, or 0 for no limit. Only takes effect with "
+             "--fs_io_scheduler_enabled.");
+TAG_FLAG(fs_io_compaction_max_mb_per_sec, experimental);
+TAG_FLAG(fs_io_compaction_max_mb_per_sec, runtime);
+
+DEFINE_int32(fs_io_tablet_copy_max_mb_per_sec, 0,
+             "The maximum rate at which tablet copies may read and write each "
+             "data directory, or 0 for no limit. Only takes effect with "
+             "--fs_io_scheduler_enabled.");
+TAG_FLAG(fs_io_tablet_copy_max_mb_per_sec, experimental);
+TAG_FLAG(fs_io_tablet_copy_max_mb_per_sec, runtime);
+
+DEFINE_int32(fs_io_background_max_mb_per_sec, 0,
+             "The maximum rate at which flushes, compactions and tablet copies "
+             "together may read and write all the data directories, or 0 for no "
+             "limit. Only takes effect with --fs_io_scheduler_enabled.");
+TAG_FLAG(fs_io_background_max_mb_per_sec, experimental);
+TAG_FLAG(fs_io_background_max_mb_per_sec, runtime);
+
+DEFINE_int32(fs_io_foreground_target_latency_ms, 0,
+             "The foreground I/O latency above which the bandwidth caps of the "
+             "background I/O to a data directory are scaled back, or 0 to always "
+             "apply them in full. Only takes effect with --fs_io_scheduler_enabled, "
+             "and on the classes with a cap.");
+TAG_FLAG(fs_io_foreground_target_latency_ms, experimental);
+TAG_FLAG(fs_io_foreground_target_latency_ms, runtime);
+
+namespace kudu {
+namespace fs {
+
+namespace {
+
+// Background I/O gets no less than this fraction of its bandwidth caps.
+const double kMinBackgroundScale = 1.0 / 64;
+
+// The step by which the fraction is raised once the foreground latency is
+// back under the target.
+const double kBackgroundScaleStep = 1.0 / 16;
+
+// The minimum time between adjustments of the fraction.
+const int kScaleAdjustmentIntervalMs = 100;
+
+} // anonymous namespace
+
+__thread IOClass ScopedIOClass::current_ = IOClass::FOREGROUND;
+
+const char* IOClassToString(IOClass io_class) {
+  switch (io_class) {
+    case IOClass::FOREGROUND: return "foreground";
+    case IOClass::FLUSH: return "flush";
+    case IOClass::COMPACTION: return "compaction";
+    case IOClass::TABLET_COPY: return "tablet copy";
+  }
+  LOG(FATAL) << "unknown I/O class " << static_cast<int>(io_class);
+  return nullptr;
+}
+
+IOScheduler::IOScheduler()
+    : cond_(&lock_),
+      foreground_inflight_(0),
+      background_inflight_(0),
+      virtual_clock_(0),
+      foreground_latency_us_(0),
+      background_scale_(1),
+      last_scale_adjustment_(MonoTime::Now()) {
+  MonoTime now = MonoTime::Now();
+  for (ClassState& c : classes_) {
+    c.last_refill = now;
+  }
+}
+
+int IOScheduler::BackgroundIndex(IOClass io_class) {
+  DCHECK(io_class != IOClass::FOREGROUND);
+  return static_cast<int>(io_class) - static_cast<int>(IOClass::FLUSH);
+}
+
+double IOScheduler::Weight(int idx) {
+  // Flushes free memory and unblock writes, so they get the largest share;
+  // tablet copies are the least urgent.
+  static const double kWeights[kNumBackgroundClasses] = { 4, 2, 1 };
+  return kWeights[idx];
+}
+
+int64_t IOScheduler::MaxBytesPerSec(int idx) {
+  int32_t mb_per_sec;
+  switch (idx) {
+    case 0: mb_per_sec = FLAGS_fs_io_flush_max_mb_per_sec; break;
+    case 1: mb_per_sec = FLAGS_fs_io_compaction_max_mb_per_sec; break;
+    default: mb_per_sec = FLAGS_fs_io_tablet_copy_max_mb_per_sec; break;
+  }
+  return std::max<int64_t>(mb_per_sec, 0) * 1024 * 1024;
+}
+
+void IOScheduler::Refill(ClassState* state, int64_t max_bytes_per_sec, MonoTime now) {
+  double elapsed_sec = (now - state->last_refill).ToSeconds();
+  state->last_refill = now;
+  // Allow bursts of up to a second's worth of I/O after an idle period.
+  state->tokens = std::min<double>(state->tokens + elapsed_sec * max_bytes_per_sec,
+                                   max_bytes_per_sec);
+}
+
+IOScheduler::ServerBudget* IOScheduler::server_budget() {
+  static ServerBudget* budget = new ServerBudget();
+  return budget;
+}
+
+double IOScheduler::RefillServerBudget(int64_t max_bytes_per_sec, MonoTime now) {
+  ServerBudget* budget = server_budget();
+  std::lock_guard<simple_spinlock> l(budget->lock);
+  Refill(&budget->bucket, max_bytes_per_sec, now);
+  return budget->bucket.tokens;
+}
+
+double IOScheduler::background_scale() const {
+  MutexLock l(lock_);
+  return background_scale_;
+}
+
+void IOScheduler::UpdateForegroundLatencyUnlocked(MonoDelta elapsed) {
+  int64_t target_us = static_cast<int64_t>(FLAGS_fs_io_foreground_target_latency_ms) * 1000;
+  if (target_us <= 0) {
+    background_scale_ = 1;
+    return;
+  }
+  double latency_us = elapsed.ToMicroseconds();
+  foreground_latency_us_ = foreground_latency_us_ == 0
+      ? latency_us : 0.9 * foreground_latency_us_ + 0.1 * latency_us;
+
+  MonoTime now = MonoTime::Now();
+  if ((now - last_scale_adjustment_).ToMilliseconds() < kScaleAdjustmentIntervalMs) {
+    return;
+  }
+  last_scale_adjustment_ = now;
+  if (foreground_latency_us_ > target_us) {
+    background_scale_ = std::max(background_scale_ / 2, kMinBackgroundScale);
+  } else {
+    background_scale_ = std::min(background_scale_ + kBackgroundScaleStep, 1.0);
+  }
+}
+
+bool IOScheduler::IsTurnUnlocked(int idx) const {
+  for (int i = 0; i < kNumBackgroundClasses; i++) {
+    if (i != idx && classes_[i].waiting > 0 &&
+        classes_[i].virtual_time < classes_[idx].virtual_time) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void IOScheduler::Start(IOClass io_class, int64_t bytes) {
+  MutexLock l(lock_);
+  if (io_class == IOClass::FOREGROUND) {
+    foreground_inflight_++;
+    return;
+  }
+
+  int idx = BackgroundIndex(io_class);
+  ClassState* state = &classes_[idx];
+  // Scaling the caps back is the same as charging each byte more tokens.
+  double scale = FLAGS_fs_io_foreground_target_latency_ms > 0 ? background_scale_ : 1;
+  double cost = bytes / scale;
+  // A class which has been idle mustn't bank credit against the others.
+  state->virtual_time = std::max(state->virtual_time, virtual_clock_);
+  state->waiting++;
+  MonoTime start = MonoTime::Now();
+  while (true) {
+    MonoTime now = MonoTime::Now();
+    int64_t max_bytes_per_sec = MaxBytesPerSec(idx);
+    bool within_cap = true;
+    if (max_bytes_per_sec > 0) {
+      Refill(state, max_bytes_per_sec, now);
+      within_cap = state->tokens > 0;
+    }
+    int64_t server_max_bytes_per_sec =
+        std::max<int64_t>(FLAGS_fs_io_background_max_mb_per_sec, 0) * 1024 * 1024;
+    double server_tokens = 0;
+    bool within_server_cap = true;
+    if (server_max_bytes_per_sec > 0) {
+      server_tokens = RefillServerBudget(server_max_bytes_per_sec, now);
+      within_server_cap = server_tokens > 0;
+    }
+    bool has_capacity = foreground_inflight_ == 0 ||
+        background_inflight_ < FLAGS_fs_io_scheduler_max_background_ops_while_busy;
+    if (within_cap && within_server_cap && has_capacity && IsTurnUnlocked(idx)) {
+      break;
+    }
+
+    // Other threads' I/O completing wakes us up; otherwise, wait for the
+    // token debt to be repaid. Waits are bounded so that changes to the
+    // bandwidth caps take effect promptly.
+    int64_t wait_us = 100 * 1000;
+    if (!within_cap) {
+      wait_us = std::min<int64_t>(wait_us,
+                                  -state->tokens * 1000000 / max_bytes_per_sec + 1);
+    }
+    if (!within_server_cap) {
+      wait_us = std::min<int64_t>(wait_us,
+                                  -server_tokens * 1000000 / server_max_bytes_per_sec + 1);
+    }
+    cond_.TimedWait(MonoDelta::FromMicroseconds(wait_us));
+  }
+  state->waiting--;
+  if (MaxBytesPerSec(idx) > 0) {
+    state->tokens -= cost;
+  }
+  if (FLAGS_fs_io_background_max_mb_per_sec > 0) {
+    ServerBudget* budget = server_budget();
+    std::lock_guard<simple_spinlock> sl(budget->lock);
+    budget->bucket.tokens -= cost;
+  }
+  virtual_clock_ = state->virtual_time;
+  state->virtual_time += bytes / Weight(idx);
+  background_inflight_++;
+
+  int64_t wait_us = (MonoTime::Now() - start).ToMicroseconds();
+  if (wait_us > 0) {
+    TRACE_COUNTER_INCREMENT("fs_io_scheduler_wait_us", wait_us);
+  }
+}
+
+void IOScheduler::Finish(IOClass io_class, MonoDelta elapsed) {
+  MutexLock l(lock_);
+  if (io_class == IOClass::FOREGROUND) {
+    DCHECK_GT(foreground_inflight_, 0);
+    foreground_inflight_--;
+    if (elapsed.Initialized()) {
+      UpdateForegroundLatencyUnlocked(elapsed);
+    }
+  } else {
+    DCHECK_GT(background_inflight_, 0);
+    background_inflight_--;
+  }
+  cond_.Broadcast();
+}
+
+ScopedIO::ScopedIO(IOScheduler* scheduler, int64_t bytes)
+    : scheduler_(FLAGS_fs_io_scheduler_enabled ? scheduler : nullptr),
+      io_class_(ScopedIOClass::Current()) {
+  if (scheduler_) {
+    scheduler_->Start(io_class_, bytes);
+    start_ = MonoTime::Now();
+  }
+}
+
+ScopedIO::~ScopedIO() {
+  if (scheduler_) {
+    scheduler_->Finish(io_class_, MonoTime::Now() - start_);
+  }
+}
+
+} // namespace fs
+} // namespace kudu
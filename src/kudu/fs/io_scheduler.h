@@ -0,0 +1,191 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#pragma once
+
+#include <cstdint>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+
+namespace kudu {
+namespace fs {
+
+// The class of work on whose behalf block I/O is performed.
+enum class IOClass {
+  // Reads serving scans and other client requests. Never delayed.
+  FOREGROUND,
+
+  // Background work, in decreasing order of weight.
+  FLUSH,
+  COMPACTION,
+  TABLET_COPY,
+};
+
+const char* IOClassToString(IOClass io_class);
+
+// Sets the I/O class of block reads and writes issued by the current thread
+// for the lifetime of the object. Threads default to IOClass::FOREGROUND.
+//
+// Example:
+//   {
+//     ScopedIOClass io_class(IOClass::COMPACTION);
+//     RETURN_NOT_OK(DoCompaction());
+//   }
+class ScopedIOClass {
+ public:
+  explicit ScopedIOClass(IOClass io_class)
+      : prev_(current_) {
+    current_ = io_class;
+  }
+
+  ~ScopedIOClass() {
+    current_ = prev_;
+  }
+
+  // Returns the current thread's I/O class.
+  static IOClass Current() { return current_; }
+
+ private:
+  const IOClass prev_;
+
+  static __thread IOClass current_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedIOClass);
+};
+
+// Schedules the block I/O issued to one data directory, so that background
+// work can't starve foreground reads on the same device.
+//
+// Foreground I/O is never delayed. Background I/O is dispatched:
+// - in weighted fair order between the background classes, by bytes;
+// - no more than --fs_io_scheduler_max_background_ops_while_busy at a time
+//   while any foreground I/O is in progress;
+// - within the class's bandwidth cap (e.g. --fs_io_compaction_max_mb_per_sec),
+//   if it has one, and within --fs_io_background_max_mb_per_sec, which is
+//   shared by the background I/O to all data directories.
+//
+// With --fs_io_foreground_target_latency_ms, the bandwidth caps of a data
+// directory are scaled back while the latency of its foreground I/O exceeds
+// the target: halved at most every 100ms, and raised again in small steps
+// once the latency recovers.
+//
+// Scheduling only takes place if --fs_io_scheduler_enabled is set.
+//
+// This class is thread-safe.
+class IOScheduler {
+ public:
+  IOScheduler();
+
+  // Blocks until I/O of 'bytes' bytes of class 'io_class' may be issued.
+  // Each call must be followed by a call to Finish() once the I/O is done,
+  // with the time it took, if known.
+  void Start(IOClass io_class, int64_t bytes);
+  void Finish(IOClass io_class, MonoDelta elapsed = MonoDelta());
+
+  // The fraction of the configured bandwidth caps which background I/O may
+  // currently use, given the latency of foreground I/O.
+  double background_scale() const;
+
+ private:
+  static const int kNumBackgroundClasses = 3;
+
+  struct ClassState {
+    ClassState() : waiting(0), virtual_time(0), tokens(0) {}
+
+    // The number of threads waiting to issue I/O of this class.
+    int waiting;
+
+    // The class's virtual time: the bytes it has dispatched, divided by its
+    // weight. The waiting class with the lowest virtual time goes next.
+    double virtual_time;
+
+    // Token bucket enforcing the class's bandwidth cap. May go negative, in
+    // which case the class must wait for the debt to be repaid.
+    double tokens;
+    MonoTime last_refill;
+  };
+
+  static int BackgroundIndex(IOClass io_class);
+  static double Weight(int idx);
+  static int64_t MaxBytesPerSec(int idx);
+
+  // Adds tokens accrued since the last refill to 'state'.
+  static void Refill(ClassState* state, int64_t max_bytes_per_sec, MonoTime now);
+
+  // The token bucket enforcing --fs_io_background_max_mb_per_sec, shared by
+  // all the schedulers of the process.
+  struct ServerBudget {
+    ServerBudget() {
+      bucket.last_refill = MonoTime::Now();
+    }
+    simple_spinlock lock;
+    ClassState bucket;
+  };
+  static ServerBudget* server_budget();
+
+  // Refills the server-wide bucket, returning its tokens.
+  static double RefillServerBudget(int64_t max_bytes_per_sec, MonoTime now);
+
+  // Folds the foreground I/O latency 'elapsed' into the average, adjusting
+  // the background scale if it's due.
+  void UpdateForegroundLatencyUnlocked(MonoDelta elapsed);
+
+  // Whether background class 'idx' has the lowest virtual time among the
+  // waiting background classes.
+  bool IsTurnUnlocked(int idx) const;
+
+  mutable Mutex lock_;
+  ConditionVariable cond_;
+
+  int foreground_inflight_;
+  int background_inflight_;
+  ClassState classes_[kNumBackgroundClasses];
+
+  // The virtual time of the most recently dispatched background I/O. Classes
+  // start no earlier than this when they become active.
+  double virtual_clock_;
+
+  // Exponentially weighted moving average of the foreground I/O latency, the
+  // resulting scale of the bandwidth caps, and when it was last adjusted.
+  double foreground_latency_us_;
+  double background_scale_;
+  MonoTime last_scale_adjustment_;
+
+  DISALLOW_COPY_AND_ASSIGN(IOScheduler);
+};
+
+// Brackets a block I/O of 'bytes' bytes, of the current thread's I/O class,
+// with IOScheduler::Start() and Finish(). 'scheduler' may be NULL, in which
+// case the I/O is not scheduled.
+class ScopedIO {
+ public:
+  ScopedIO(IOScheduler* scheduler, int64_t bytes);
+  ~ScopedIO();
+
+ private:
+  IOScheduler* scheduler_;
+  const IOClass io_class_;
+  MonoTime start_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedIO);
+};
+
+} // namespace fs
+} // namespace kudu
@@ -18,6 +18,7 @@
 #include "kudu/fs/log_block_manager.h"
 
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -27,6 +28,7 @@
 #include "kudu/fs/data_dirs.h"
 #include "kudu/fs/fs.pb.h"
 #include "kudu/gutil/callback.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/integral_types.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/numbers.h"
@@ -44,18 +46,22 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/random_util.h"
+#include "kudu/util/rw_mutex.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util_prod.h"
+#include "kudu/util/thread.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
+DECLARE_bool(block_manager_direct_reads);
 
 // TODO(unknown): How should this be configured? Should provide some guidance.
 DEFINE_uint64(log_container_max_size, 10LU * 1024 * 1024 * 1024,
@@ -78,6 +84,29 @@ DEFINE_bool(log_block_manager_test_hole_punching, true,
 TAG_FLAG(log_block_manager_test_hole_punching, advanced);
 TAG_FLAG(log_block_manager_test_hole_punching, unsafe);
 
+DEFINE_double(log_container_live_metadata_before_compact_ratio, 0.50,
+              "If the ratio of live blocks to records in a log container's "
+              "metadata file falls below this value, the metadata file is "
+              "rewritten to contain only the records of live blocks. This is "
+              "done at startup and in the background as blocks are deleted. "
+              "Use 0 to disable.");
+TAG_FLAG(log_container_live_metadata_before_compact_ratio, advanced);
+
+DEFINE_int32(log_block_manager_hole_punch_interval_ms, 1000,
+             "How often (in ms) the log block manager reclaims the disk space "
+             "of deleted blocks. Deletions are queued per container and "
+             "adjacent ranges are coalesced, so that a burst of deletions "
+             "(e.g. at the end of a compaction) is punched out of the "
+             "container in a few large holes. If 0, space is reclaimed as "
+             "soon as possible.");
+TAG_FLAG(log_block_manager_hole_punch_interval_ms, advanced);
+TAG_FLAG(log_block_manager_hole_punch_interval_ms, runtime);
+
+DEFINE_int32(log_block_manager_container_load_threads_per_dir, 4,
+             "Number of threads per data directory with which to open "
+             "containers and process their block records at startup");
+TAG_FLAG(log_block_manager_container_load_threads_per_dir, advanced);
+
 METRIC_DEFINE_gauge_uint64(server, log_block_manager_bytes_under_management,
                            "Bytes Under Management",
                            kudu::MetricUnit::kBytes,
@@ -104,6 +133,49 @@ METRIC_DEFINE_counter(server, log_block_manager_unavailable_containers,
                       "Number of non-full log block containers that are under root paths "
                       "whose disks are full");
 
+METRIC_DEFINE_counter(server, log_block_manager_metadata_compactions,
+                      "Number of Container Metadata Compactions",
+                      kudu::MetricUnit::kLogBlockContainers,
+                      "Number of times the metadata file of a log block container "
+                      "was rewritten to drop the records of deleted blocks");
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_pending_reclaimable_bytes,
+                           "Pending Reclaimable Bytes",
+                           kudu::MetricUnit::kBytes,
+                           "Number of bytes of deleted blocks whose disk space "
+                           "has yet to be reclaimed by hole punching");
+
+METRIC_DEFINE_counter(server, log_block_manager_holes_punched,
+                      "Holes Punched",
+                      kudu::MetricUnit::kUnits,
+                      "Number of holes punched in log block containers to "
+                      "reclaim the space of deleted blocks. Adjacent deleted "
+                      "blocks are reclaimed with a single hole.");
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_startup_time_ms,
+                           "Startup Time",
+                           kudu::MetricUnit::kMilliseconds,
+                           "Wall clock time spent loading the log block containers of all "
+                           "data directories at startup");
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_startup_read_metadata_time_ms,
+                           "Startup Metadata Read Time",
+                           kudu::MetricUnit::kMilliseconds,
+                           "Time spent opening log block containers and reading their "
+                           "metadata at startup, summed across loading threads");
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_startup_process_records_time_ms,
+                           "Startup Record Processing Time",
+                           kudu::MetricUnit::kMilliseconds,
+                           "Time spent processing the block records of log block containers "
+                           "at startup, summed across loading threads");
+
+METRIC_DEFINE_gauge_uint64(server, log_block_manager_startup_merge_time_ms,
+                           "Startup Block Map Merge Time",
+                           kudu::MetricUnit::kMilliseconds,
+                           "Time spent merging the blocks of loaded log block containers "
+                           "into the block map at startup, summed across data directories");
+
 namespace kudu {
 
 namespace fs {
@@ -113,6 +185,8 @@ using internal::LogBlockContainer;
 using pb_util::ReadablePBContainerFile;
 using pb_util::WritablePBContainerFile;
 using std::map;
+using std::unordered_map;
+using std::unordered_set;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -140,6 +214,16 @@ struct LogBlockManagerMetrics {
 
   scoped_refptr<Counter> containers;
   scoped_refptr<Counter> full_containers;
+  scoped_refptr<Counter> metadata_compactions;
+
+  scoped_refptr<AtomicGauge<uint64_t> > pending_reclaimable_bytes;
+  scoped_refptr<Counter> holes_punched;
+
+  // Breakdown of the time spent loading containers at startup.
+  scoped_refptr<AtomicGauge<uint64_t> > startup_time_ms;
+  scoped_refptr<AtomicGauge<uint64_t> > startup_read_metadata_time_ms;
+  scoped_refptr<AtomicGauge<uint64_t> > startup_process_records_time_ms;
+  scoped_refptr<AtomicGauge<uint64_t> > startup_merge_time_ms;
 };
 
 #define MINIT(x) x(METRIC_log_block_manager_##x.Instantiate(metric_entity))
@@ -149,7 +233,14 @@ LogBlockManagerMetrics::LogBlockManagerMetrics(const scoped_refptr<MetricEntity>
     GINIT(bytes_under_management),
     GINIT(blocks_under_management),
     MINIT(containers),
-    MINIT(full_containers) {
+    MINIT(full_containers),
+    MINIT(metadata_compactions),
+    GINIT(pending_reclaimable_bytes),
+    MINIT(holes_punched),
+    GINIT(startup_time_ms),
+    GINIT(startup_read_metadata_time_ms),
+    GINIT(startup_process_records_time_ms),
+    GINIT(startup_merge_time_ms) {
 }
 #undef GINIT
 #undef MINIT
@@ -206,6 +297,18 @@ class LogBlockContainer {
   // The on-disk effects of this call are made durable only after SyncData().
   Status DeleteBlock(int64_t offset, int64_t length);
 
+  // Queues the space of a deleted block at 'offset' and 'length' to be freed
+  // by a later call to PunchPendingHoles(), coalescing it with any adjacent
+  // queued ranges.
+  void QueueHolePunch(int64_t offset, int64_t length);
+
+  // Frees all of the space queued by QueueHolePunch(), one hole per range of
+  // adjacent deleted blocks.
+  //
+  // Failures are logged rather than returned: the worst case is orphaned
+  // data left behind to be cleaned up in the next GC.
+  void PunchPendingHoles();
+
   // Preallocate enough space to ensure that an append of 'next_append_length'
   // can be satisfied by this container. The offset of the beginning of this
   // block must be provided in 'block_start_offset' (since container
@@ -224,6 +327,10 @@ class LogBlockContainer {
   Status ReadData(int64_t offset, size_t length,
                   Slice* result, uint8_t* scratch) const;
 
+  // Submit asynchronous reads of 'requests', whose offsets are relative to
+  // the start of the data file.
+  Status SubmitDataReads(const vector<AsyncReadRequest*>& requests) const;
+
   // Appends 'pb' to this container's metadata file.
   //
   // The on-disk effects of this call are made durable only after SyncMetadata().
@@ -268,6 +375,40 @@ class LogBlockContainer {
   // returning the records.
   Status ReadContainerRecords(deque<BlockRecordPB>* records) const;
 
+  // Sets the number of records in the metadata file and the number of live
+  // blocks, once the container's records have been loaded.
+  void SetMetadataCounts(int64_t records, int64_t live_blocks) {
+    metadata_records_.Store(records);
+    live_blocks_.Store(live_blocks);
+  }
+
+  // Records that one of the container's blocks has been deleted.
+  void BlockDeleted() { live_blocks_.IncrementBy(-1); }
+
+  // Whether the proportion of live blocks among the metadata file's records
+  // has fallen below --log_container_live_metadata_before_compact_ratio.
+  bool ShouldCompactMetadata() const;
+
+  // Rewrites the metadata file to hold only the CREATE records of blocks
+  // which are still live, given the file's current 'records'.
+  //
+  // The new file is written and synced alongside the old one and then
+  // atomically renamed over it, so a crash leaves one or the other intact.
+  //
+  // The caller must ensure no metadata is appended concurrently, either by
+  // holding 'metadata_lock_' exclusively or because the container is not yet
+  // visible to other threads.
+  Status RewriteMetadata(const deque<BlockRecordPB>& records);
+
+  // Re-reads the metadata file and rewrites it with RewriteMetadata(),
+  // blocking metadata appends for the duration. Safe to call concurrently
+  // with block creation and deletion.
+  Status CompactMetadata();
+
+  // Schedules a CompactMetadata() on the data directory's thread pool if
+  // ShouldCompactMetadata() and one isn't already pending.
+  void ScheduleMetadataCompactionIfNeeded();
+
   // Updates 'total_bytes_written_' and 'total_blocks_written_', marking this
   // container as full if needed. Should only be called when a block is fully
   // written, as it will round up the container data file's position.
@@ -302,6 +443,9 @@ class LogBlockContainer {
                     unique_ptr<WritablePBContainerFile> metadata_file,
                     shared_ptr<RWFile> data_file);
 
+  // Runs a compaction scheduled by ScheduleMetadataCompactionIfNeeded().
+  void RunScheduledMetadataCompaction();
+
   // Performs sanity checks on a block record.
   Status CheckBlockRecord(const BlockRecordPB& record,
                           uint64_t data_file_size,
@@ -322,6 +466,27 @@ class LogBlockContainer {
   unique_ptr<WritablePBContainerFile> metadata_file_;
   shared_ptr<RWFile> data_file_;
 
+  // Taken in shared mode for appends, flushes and syncs of 'metadata_file_',
+  // and in exclusive mode while the metadata file is rewritten.
+  mutable RWMutex metadata_lock_;
+
+  // The number of records in the metadata file and the number of live
+  // blocks in the container. Used only to decide when to compact the
+  // metadata, so they are allowed to be momentarily inconsistent.
+  AtomicInt<int64_t> metadata_records_;
+  AtomicInt<int64_t> live_blocks_;
+
+  // Whether a background metadata compaction is pending.
+  AtomicBool compaction_scheduled_;
+
+  // Protects 'pending_holes_'.
+  simple_spinlock pending_holes_lock_;
+
+  // Ranges of deleted blocks whose space has yet to be freed, keyed by
+  // offset, with lengths rounded up to the filesystem block size. Adjacent
+  // ranges are always coalesced.
+  map<int64_t, int64_t> pending_holes_;
+
   // The amount of data written thus far in the container.
   int64_t total_bytes_written_ = 0;
 
@@ -346,6 +511,9 @@ LogBlockContainer::LogBlockContainer(
                                 data_dir)),
       metadata_file_(std::move(metadata_file)),
       data_file_(std::move(data_file)),
+      metadata_records_(0),
+      live_blocks_(0),
+      compaction_scheduled_(false),
       metrics_(block_manager->metrics()) {
 }
 
@@ -622,6 +790,125 @@ Status LogBlockContainer::CheckBlockRecord(const BlockRecordPB& record,
   return Status::OK();
 }
 
+bool LogBlockContainer::ShouldCompactMetadata() const {
+  double ratio = FLAGS_log_container_live_metadata_before_compact_ratio;
+  int64_t records = metadata_records_.Load();
+  return ratio > 0 && records > 0 &&
+      live_blocks_.Load() < ratio * records;
+}
+
+Status LogBlockContainer::RewriteMetadata(const deque<BlockRecordPB>& records) {
+  DCHECK(!block_manager_->read_only_);
+
+  // Find the CREATE records which aren't followed by a DELETE, and keep them
+  // in their original order.
+  unordered_map<uint64_t, size_t> live_record_idx;
+  for (size_t i = 0; i < records.size(); i++) {
+    const BlockRecordPB& r = records[i];
+    if (r.op_type() == CREATE) {
+      live_record_idx[r.block_id().id()] = i;
+    } else if (r.op_type() == DELETE) {
+      live_record_idx.erase(r.block_id().id());
+    }
+  }
+  vector<size_t> live_records;
+  live_records.reserve(live_record_idx.size());
+  for (const auto& e : live_record_idx) {
+    live_records.push_back(e.second);
+  }
+  std::sort(live_records.begin(), live_records.end());
+
+  Env* env = block_manager_->env();
+  string metadata_path = metadata_file_->filename();
+  string tmp_path;
+  unique_ptr<RWFile> tmp_file;
+  RETURN_NOT_OK(env->NewTempRWFile(RWFileOptions(),
+                                   StrCat(metadata_path, kTmpInfix, ".XXXXXX"),
+                                   &tmp_path, &tmp_file));
+  env_util::ScopedFileDeleter tmp_deleter(env, tmp_path);
+  {
+    WritablePBContainerFile pb_file(std::move(tmp_file));
+    RETURN_NOT_OK(pb_file.Init(BlockRecordPB()));
+    for (size_t i : live_records) {
+      RETURN_NOT_OK(pb_file.Append(records[i]));
+    }
+    if (FLAGS_enable_data_block_fsync) {
+      RETURN_NOT_OK(pb_file.Sync());
+    }
+    RETURN_NOT_OK(pb_file.Close());
+  }
+  RETURN_NOT_OK_PREPEND(env->RenameFile(tmp_path, metadata_path),
+                        Substitute("Could not replace metadata file $0", metadata_path));
+  tmp_deleter.Cancel();
+  if (FLAGS_enable_data_block_fsync) {
+    RETURN_NOT_OK(env->SyncDir(data_dir_->dir()));
+  }
+
+  // The old writer refers to the file which was just replaced; appending to
+  // it would silently lose the records, so failing to switch to the new file
+  // is fatal.
+  unique_ptr<WritablePBContainerFile> new_writer;
+  Status s;
+  if (block_manager_->file_cache_) {
+    block_manager_->file_cache_->Invalidate(metadata_path);
+    shared_ptr<RWFile> f;
+    s = block_manager_->file_cache_->OpenExistingFile(metadata_path, &f);
+    if (s.ok()) {
+      new_writer.reset(new WritablePBContainerFile(std::move(f)));
+    }
+  } else {
+    RWFileOptions opts;
+    opts.mode = Env::OPEN_EXISTING;
+    unique_ptr<RWFile> f;
+    s = env->NewRWFile(opts, metadata_path, &f);
+    if (s.ok()) {
+      new_writer.reset(new WritablePBContainerFile(std::move(f)));
+    }
+  }
+  if (s.ok()) {
+    s = new_writer->Reopen();
+  }
+  CHECK_OK_PREPEND(s, Substitute("Could not reopen rewritten metadata file $0",
+                                 metadata_path));
+  metadata_file_.swap(new_writer);
+
+  VLOG(1) << Substitute("Compacted metadata of container $0 from $1 to $2 records",
+                        ToString(), records.size(), live_records.size());
+  SetMetadataCounts(live_records.size(), live_records.size());
+  if (metrics_) {
+    metrics_->metadata_compactions->Increment();
+  }
+  return Status::OK();
+}
+
+Status LogBlockContainer::CompactMetadata() {
+  std::lock_guard<RWMutex> l(metadata_lock_);
+
+  // The live records are derived from the metadata file itself rather than
+  // the in-memory block map, so records appended by in-flight creations and
+  // deletions are accounted for correctly whichever side of the rewrite they
+  // fall on.
+  deque<BlockRecordPB> records;
+  RETURN_NOT_OK(ReadContainerRecords(&records));
+  return RewriteMetadata(records);
+}
+
+void LogBlockContainer::ScheduleMetadataCompactionIfNeeded() {
+  if (ShouldCompactMetadata() &&
+      compaction_scheduled_.CompareAndSet(false, true)) {
+    ExecClosure(Bind(&LogBlockContainer::RunScheduledMetadataCompaction,
+                     Unretained(this)));
+  }
+}
+
+void LogBlockContainer::RunScheduledMetadataCompaction() {
+  compaction_scheduled_.Store(false);
+  if (ShouldCompactMetadata()) {
+    WARN_NOT_OK(CompactMetadata(),
+                Substitute("Could not compact metadata of container $0", ToString()));
+  }
+}
+
 Status LogBlockContainer::FinishBlock(const Status& s, WritableBlock* block) {
   auto cleanup = MakeScopedCleanup([&]() {
     block_manager_->MakeContainerAvailable(this);
@@ -643,6 +930,7 @@ Status LogBlockContainer::FinishBlock(const Status& s, WritableBlock* block) {
   CHECK(block_manager()->AddLogBlock(this, block->id(),
                                      total_bytes_written_,
                                      block->BytesAppended()));
+  live_blocks_.Increment();
   UpdateBytesWrittenAndTotalBlocks(total_bytes_written_,
                                    block->BytesAppended());
 
@@ -680,10 +968,75 @@ Status LogBlockContainer::DeleteBlock(int64_t offset, int64_t length) {
   return Status::OK();
 }
 
+void LogBlockContainer::QueueHolePunch(int64_t offset, int64_t length) {
+  DCHECK_GE(offset, 0);
+  DCHECK_GE(length, 0);
+  DCHECK_EQ(0, offset % instance()->filesystem_block_size_bytes());
+
+  if (!length) {
+    return;
+  }
+  length = KUDU_ALIGN_UP(length, instance()->filesystem_block_size_bytes());
+  bool was_empty;
+  {
+    std::lock_guard<simple_spinlock> l(pending_holes_lock_);
+    was_empty = pending_holes_.empty();
+
+    // Merge with the preceding range, if it ends where this one begins.
+    auto next = pending_holes_.upper_bound(offset);
+    auto it = next;
+    if (it != pending_holes_.begin() &&
+        std::prev(it)->first + std::prev(it)->second == offset) {
+      it = std::prev(it);
+      it->second += length;
+    } else {
+      it = pending_holes_.emplace_hint(next, offset, length);
+    }
+
+    // Merge with the following range, if it begins where this one ends.
+    if (next != pending_holes_.end() && it->first + it->second == next->first) {
+      it->second += next->second;
+      pending_holes_.erase(next);
+    }
+  }
+  if (metrics_) {
+    metrics_->pending_reclaimable_bytes->IncrementBy(length);
+  }
+  if (was_empty) {
+    block_manager_->ScheduleHolePunch(this);
+  }
+}
+
+void LogBlockContainer::PunchPendingHoles() {
+  map<int64_t, int64_t> holes;
+  {
+    std::lock_guard<simple_spinlock> l(pending_holes_lock_);
+    holes.swap(pending_holes_);
+  }
+
+  // We don't call SyncData() to synchronize the deletions because it's
+  // expensive, and in the worst case, we'll just leave orphaned data
+  // behind to be cleaned up in the next GC.
+  for (const auto& hole : holes) {
+    VLOG(3) << Substitute("Freeing $0 bytes at offset $1 of container $2",
+                          hole.second, hole.first, ToString());
+    WARN_NOT_OK(DeleteBlock(hole.first, hole.second),
+                Substitute("Could not free $0 bytes at offset $1 of container $2",
+                           hole.second, hole.first, ToString()));
+    if (metrics_) {
+      metrics_->pending_reclaimable_bytes->DecrementBy(hole.second);
+      metrics_->holes_punched->Increment();
+    }
+  }
+}
+
 Status LogBlockContainer::WriteData(int64_t offset, const Slice& data) {
   DCHECK_GE(offset, total_bytes_written_);
 
+  ScopedIO io(data_dir_->io_scheduler(), data.size());
+  MonoTime start = MonoTime::Now();
   RETURN_NOT_OK(data_file_->Write(offset, data));
+  data_dir_->RecordWriteLatency(MonoTime::Now() - start);
 
   // This append may have changed the container size if:
   // 1. It was large enough that it blew out the preallocated space.
@@ -698,13 +1051,27 @@ Status LogBlockContainer::ReadData(int64_t offset, size_t length,
                                    Slice* result, uint8_t* scratch) const {
   DCHECK_GE(offset, 0);
 
+  ScopedIO io(data_dir_->io_scheduler(), length);
+  if (FLAGS_block_manager_direct_reads) {
+    Status s = data_file_->ReadUncached(offset, length, result, scratch);
+    if (!s.IsNotSupported()) {
+      return s;
+    }
+  }
   return data_file_->Read(offset, length, result, scratch);
 }
 
+Status LogBlockContainer::SubmitDataReads(const vector<AsyncReadRequest*>& requests) const {
+  return data_file_->SubmitReads(requests);
+}
+
 Status LogBlockContainer::AppendMetadata(const BlockRecordPB& pb) {
   // Note: We don't check for sufficient disk space for metadata writes in
   // order to allow for block deletion on full disks.
-  return metadata_file_->Append(pb);
+  shared_lock<RWMutex> l(metadata_lock_);
+  RETURN_NOT_OK(metadata_file_->Append(pb));
+  metadata_records_.Increment();
+  return Status::OK();
 }
 
 Status LogBlockContainer::FlushData(int64_t offset, int64_t length) {
@@ -714,18 +1081,24 @@ Status LogBlockContainer::FlushData(int64_t offset, int64_t length) {
 }
 
 Status LogBlockContainer::FlushMetadata() {
+  shared_lock<RWMutex> l(metadata_lock_);
   return metadata_file_->Flush();
 }
 
 Status LogBlockContainer::SyncData() {
   if (FLAGS_enable_data_block_fsync) {
-    return data_file_->Sync();
+    // The bytes being synced were already accounted for when written.
+    ScopedIO io(data_dir_->io_scheduler(), 0);
+    MonoTime start = MonoTime::Now();
+    RETURN_NOT_OK(data_file_->Sync());
+    data_dir_->RecordWriteLatency(MonoTime::Now() - start);
   }
   return Status::OK();
 }
 
 Status LogBlockContainer::SyncMetadata() {
   if (FLAGS_enable_data_block_fsync) {
+    shared_lock<RWMutex> l(metadata_lock_);
     return metadata_file_->Sync();
   }
   return Status::OK();
@@ -860,22 +1233,22 @@ LogBlock::LogBlock(LogBlockContainer* container, BlockId block_id,
   DCHECK_GE(length, 0);
 }
 
-static void DeleteBlockAsync(LogBlockContainer* container,
-                             BlockId block_id,
-                             int64_t offset,
-                             int64_t length) {
-  // We don't call SyncData() to synchronize the deletion because it's
-  // expensive, and in the worst case, we'll just leave orphaned data
-  // behind to be cleaned up in the next GC.
-  VLOG(3) << "Freeing space belonging to block " << block_id;
-  WARN_NOT_OK(container->DeleteBlock(offset, length),
-              Substitute("Could not delete block $0", block_id.ToString()));
+// Synchronizes the data and metadata of 'container' to disk on behalf of I/O
+// class 'io_class', storing the result in 'status'.
+static void SyncContainerFilesAsync(LogBlockContainer* container,
+                                    IOClass io_class,
+                                    Status* status) {
+  ScopedIOClass scoped_class(io_class);
+  *status = container->SyncData();
+  if (status->ok()) {
+    *status = container->SyncMetadata();
+  }
 }
 
 LogBlock::~LogBlock() {
   if (deleted_) {
-    container_->ExecClosure(Bind(&DeleteBlockAsync, container_, block_id_,
-                                 offset_, length_));
+    VLOG(3) << "Queueing the space belonging to block " << block_id_ << " to be freed";
+    container_->QueueHolePunch(offset_, length_);
   }
 }
 
@@ -929,6 +1302,8 @@ class LogWritableBlock : public WritableBlock {
   // Does not synchronize the written data; that takes place in Close().
   Status AppendMetadata();
 
+  LogBlockContainer* container() const { return container_; }
+
  private:
   // The owning container. Must outlive the block.
   LogBlockContainer* container_;
@@ -963,6 +1338,7 @@ LogWritableBlock::LogWritableBlock(LogBlockContainer* container,
     container->metrics()->generic_metrics.blocks_open_writing->Increment();
     container->metrics()->generic_metrics.total_writable_blocks->Increment();
   }
+  container->mutable_data_dir()->BlockWriteStarted();
 }
 
 LogWritableBlock::~LogWritableBlock() {
@@ -1064,6 +1440,7 @@ Status LogWritableBlock::DoClose(SyncMode mode) {
               BytesAppended());
         }
 
+        container_->mutable_data_dir()->BlockWriteFinished();
         state_ = CLOSED;
         s = container_->FinishBlock(s, this);
       });
@@ -1123,6 +1500,8 @@ class LogReadableBlock : public ReadableBlock {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE;
 
+  virtual Status SubmitReads(const vector<AsyncReadRequest*>& requests) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
  private:
@@ -1207,6 +1586,52 @@ Status LogReadableBlock::Read(uint64_t offset, size_t length,
   return Status::OK();
 }
 
+Status LogReadableBlock::SubmitReads(const vector<AsyncReadRequest*>& requests) const {
+  DCHECK(!closed_.Load());
+
+  // The requests are rebased onto the container's data file, and restored
+  // before their callbacks run.
+  const uint64_t base = log_block_->offset();
+  size_t total_length = 0;
+  for (AsyncReadRequest* req : requests) {
+    if (log_block_->length() < req->offset + req->length) {
+      return Status::IOError("Out-of-bounds read",
+                             Substitute("read of [$0-$1) in block [$2-$3)",
+                                        base + req->offset,
+                                        base + req->offset + req->length,
+                                        base,
+                                        base + log_block_->length()));
+    }
+    total_length += req->length;
+  }
+
+  vector<std::function<void()>> callbacks;
+  callbacks.reserve(requests.size());
+  for (AsyncReadRequest* req : requests) {
+    callbacks.emplace_back(std::move(req->callback));
+    std::function<void()> callback = callbacks.back();
+    req->offset += base;
+    req->callback = [req, base, callback]() {
+      req->offset -= base;
+      callback();
+    };
+  }
+  Status s = container_->SubmitDataReads(requests);
+  if (!s.ok()) {
+    for (int i = 0; i < requests.size(); i++) {
+      requests[i]->offset -= base;
+      requests[i]->callback = std::move(callbacks[i]);
+    }
+    return s;
+  }
+
+  TRACE_COUNTER_INCREMENT("lbm_async_reads", requests.size());
+  if (container_->metrics()) {
+    container_->metrics()->generic_metrics.total_bytes_read->IncrementBy(total_length);
+  }
+  return Status::OK();
+}
+
 size_t LogReadableBlock::memory_footprint() const {
   return kudu_malloc_usable_size(this);
 }
@@ -1238,10 +1663,12 @@ LogBlockManager::LogBlockManager(Env* env, const BlockManagerOptions& opts)
                         BlockMap::hasher(),
                         BlockMap::key_equal(),
                         BlockAllocator(mem_tracker_)),
+    dir_sync_cond_(&dir_sync_lock_),
     env_(DCHECK_NOTNULL(env)),
     read_only_(opts.read_only),
     buggy_el6_kernel_(IsBuggyEl6Kernel(env->GetKernelRelease())),
-    next_block_id_(1) {
+    next_block_id_(1),
+    hole_punch_thread_stop_(1) {
 
   int64_t file_cache_capacity = GetFileCacheCapacityForBlockManager(env_);
   if (file_cache_capacity != kint64max) {
@@ -1280,6 +1707,16 @@ LogBlockManager::~LogBlockManager() {
   // destroyed before their containers.
   blocks_by_block_id_.clear();
 
+  // Free the space of any deleted blocks before the containers go away; it
+  // would otherwise be leaked until the next GC.
+  hole_punch_thread_stop_.CountDown();
+  if (hole_punch_thread_) {
+    hole_punch_thread_->Join();
+  }
+  for (LogBlockContainer* container : all_containers_) {
+    container->PunchPendingHoles();
+  }
+
   // Containers may have outstanding tasks running on data directories; shut
   // them down before destroying the containers.
   dd_manager_.Shutdown();
@@ -1351,6 +1788,7 @@ Status LogBlockManager::Open() {
     InsertOrDie(&block_limits_by_data_dir_, dd.get(), limit);
   }
 
+  MonoTime start = MonoTime::Now();
   vector<Status> statuses(dd_manager_.data_dirs().size());
   int i = 0;
   for (const auto& dd : dd_manager_.data_dirs()) {
@@ -1367,6 +1805,9 @@ Status LogBlockManager::Open() {
   for (const auto& dd : dd_manager_.data_dirs()) {
     dd->WaitOnClosures();
   }
+  if (metrics_) {
+    metrics_->startup_time_ms->set_value((MonoTime::Now() - start).ToMilliseconds());
+  }
 
   // Ensure that no open failed.
   for (const auto& s : statuses) {
@@ -1375,6 +1816,12 @@ Status LogBlockManager::Open() {
     }
   }
 
+  if (!read_only_) {
+    RETURN_NOT_OK(Thread::Create("lbm", "hole punch",
+                                 &LogBlockManager::RunHolePunchThread, this,
+                                 &hole_punch_thread_));
+  }
+
   return Status::OK();
 }
 
@@ -1427,6 +1874,19 @@ Status LogBlockManager::OpenBlock(const BlockId& block_id,
   return Status::OK();
 }
 
+Status LogBlockManager::FindBlockDataDir(const BlockId& block_id, string* dir) {
+  scoped_refptr<LogBlock> lb;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    lb = FindPtrOrNull(blocks_by_block_id_, block_id);
+  }
+  if (!lb) {
+    return Status::NotFound("Can't find block", block_id.ToString());
+  }
+  *dir = lb->container()->data_dir()->dir();
+  return Status::OK();
+}
+
 Status LogBlockManager::DeleteBlock(const BlockId& block_id) {
   CHECK(!read_only_);
 
@@ -1446,6 +1906,8 @@ Status LogBlockManager::DeleteBlock(const BlockId& block_id) {
   record.set_timestamp_us(GetCurrentTimeMicros());
   RETURN_NOT_OK_PREPEND(lb->container()->AppendMetadata(record),
                         "Unable to append deletion record to block metadata");
+  lb->container()->BlockDeleted();
+  lb->container()->ScheduleMetadataCompactionIfNeeded();
 
   // We don't bother fsyncing the metadata append for deletes in order to avoid
   // the disk overhead. Even if we did fsync it, we'd still need to account for
@@ -1459,18 +1921,52 @@ Status LogBlockManager::DeleteBlock(const BlockId& block_id) {
 
 Status LogBlockManager::CloseBlocks(const std::vector<WritableBlock*>& blocks) {
   VLOG(3) << "Closing " << blocks.size() << " blocks";
-  if (FLAGS_block_coalesce_close) {
-    // Ask the kernel to begin writing out each block's dirty data. This is
-    // done up-front to give the kernel opportunities to coalesce contiguous
-    // dirty pages.
+  if (!FLAGS_block_coalesce_close) {
+    // Close each block, waiting for each to become durable.
     for (WritableBlock* block : blocks) {
-      RETURN_NOT_OK(block->FlushDataAsync());
+      RETURN_NOT_OK(block->Close());
+    }
+    return Status::OK();
+  }
+
+  // Ask the kernel to begin writing out each block's dirty data. This is
+  // done up-front to give the kernel opportunities to coalesce contiguous
+  // dirty pages.
+  for (WritableBlock* block : blocks) {
+    RETURN_NOT_OK(block->FlushDataAsync());
+  }
+
+  // Sync each container touched by the batch exactly once. The syncs are
+  // issued on the data directories' threads, so that each disk works through
+  // its own containers while the others do the same.
+  unordered_set<LogBlockContainer*> seen;
+  vector<LogBlockContainer*> containers;
+  for (WritableBlock* block : blocks) {
+    LogBlockContainer* container = down_cast<internal::LogWritableBlock*>(block)->container();
+    if (InsertIfNotPresent(&seen, container)) {
+      containers.push_back(container);
     }
   }
+  vector<Status> statuses(containers.size());
+  unordered_set<DataDir*> dirs;
+  for (int i = 0; i < containers.size(); i++) {
+    DataDir* dir = containers[i]->mutable_data_dir();
+    dir->ExecClosure(Bind(&internal::SyncContainerFilesAsync, containers[i],
+                          ScopedIOClass::Current(), &statuses[i]));
+    dirs.insert(dir);
+  }
+  for (DataDir* dir : dirs) {
+    dir->WaitOnClosures();
+  }
+  for (const Status& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
 
-  // Now close each block, waiting for each to become durable.
+  // Every block's data and metadata is now durable; the container
+  // directories are synced (at most once each) as the blocks are finished.
   for (WritableBlock* block : blocks) {
-    RETURN_NOT_OK(block->Close());
+    RETURN_NOT_OK(down_cast<internal::LogWritableBlock*>(block)->DoClose(
+        internal::LogWritableBlock::NO_SYNC));
   }
   return Status::OK();
 }
@@ -1511,9 +2007,9 @@ Status LogBlockManager::GetOrCreateContainer(LogBlockContainer** container) {
                                                   dir,
                                                   &new_container),
                         "Could not create new log block container at " + dir->dir());
+  MarkDirDirty(dir);
   {
     std::lock_guard<simple_spinlock> l(lock_);
-    dirty_dirs_.insert(dir->dir());
     AddNewContainerUnlocked(new_container.get());
   }
   *container = new_container.release();
@@ -1533,30 +2029,80 @@ void LogBlockManager::MakeContainerAvailableUnlocked(LogBlockContainer* containe
   available_containers_by_data_dir_[container->data_dir()].push_back(container);
 }
 
-Status LogBlockManager::SyncContainer(const LogBlockContainer& container) {
-  Status s;
-  bool to_sync = false;
+void LogBlockManager::ScheduleHolePunch(LogBlockContainer* container) {
+  if (FLAGS_log_block_manager_hole_punch_interval_ms <= 0) {
+    container->ExecClosure(Bind(&LogBlockContainer::PunchPendingHoles,
+                                Unretained(container)));
+    return;
+  }
+  std::lock_guard<simple_spinlock> l(lock_);
+  containers_pending_hole_punch_.insert(container);
+}
+
+void LogBlockManager::DispatchHolePunches() {
+  unordered_set<LogBlockContainer*> containers;
   {
     std::lock_guard<simple_spinlock> l(lock_);
-    to_sync = dirty_dirs_.erase(container.data_dir()->dir());
+    containers.swap(containers_pending_hole_punch_);
+  }
+  for (LogBlockContainer* container : containers) {
+    container->ExecClosure(Bind(&LogBlockContainer::PunchPendingHoles,
+                                Unretained(container)));
+  }
+}
+
+void LogBlockManager::RunHolePunchThread() {
+  while (true) {
+    int32_t interval_ms = FLAGS_log_block_manager_hole_punch_interval_ms;
+    if (hole_punch_thread_stop_.WaitFor(MonoDelta::FromMilliseconds(
+            interval_ms > 0 ? interval_ms : 1000))) {
+      return;
+    }
+    DispatchHolePunches();
   }
+}
 
-  if (to_sync && FLAGS_enable_data_block_fsync) {
-    s = env_->SyncDir(container.data_dir()->dir());
+void LogBlockManager::MarkDirDirty(const DataDir* dir) {
+  MutexLock l(dir_sync_lock_);
+  dir_sync_states_[dir->dir()].dirtied_seq++;
+}
 
-    // If SyncDir fails, the container directory must be restored to
-    // dirty_dirs_. Otherwise a future successful LogWritableBlock::Close()
-    // on this container won't call SyncDir again, and the container might
-    // be lost on crash.
-    //
-    // In the worst case (another block synced this container as we did),
-    // we'll sync it again needlessly.
-    if (!s.ok()) {
-      std::lock_guard<simple_spinlock> l(lock_);
-      dirty_dirs_.insert(container.data_dir()->dir());
+Status LogBlockManager::SyncContainer(const LogBlockContainer& container) {
+  if (!FLAGS_enable_data_block_fsync) {
+    return Status::OK();
+  }
+
+  const string& dir = container.data_dir()->dir();
+  MutexLock l(dir_sync_lock_);
+  DirSyncState* state = &dir_sync_states_[dir];
+
+  // Every change made to the directory so far must be durable before
+  // returning, whether we sync it ourselves or another thread does.
+  int64_t target_seq = state->dirtied_seq;
+  while (state->synced_seq < target_seq) {
+    if (state->syncing) {
+      dir_sync_cond_.Wait();
+      continue;
     }
+
+    // Sync on behalf of every change made up to this point, including those
+    // of any threads waiting for us.
+    int64_t seq = state->dirtied_seq;
+    state->syncing = true;
+    l.Unlock();
+    Status s = env_->SyncDir(dir);
+    l.Lock();
+    state->syncing = false;
+    if (s.ok()) {
+      state->synced_seq = std::max(state->synced_seq, seq);
+    }
+    dir_sync_cond_.Broadcast();
+
+    // If SyncDir fails, the directory remains dirty; a future successful
+    // LogWritableBlock::Close() on one of its containers will try again.
+    RETURN_NOT_OK(s);
   }
-  return s;
+  return Status::OK();
 }
 
 bool LogBlockManager::TryUseBlockId(const BlockId& block_id) {
@@ -1621,9 +2167,30 @@ scoped_refptr<LogBlock> LogBlockManager::RemoveLogBlock(const BlockId& block_id)
   return result;
 }
 
+// The outcome of loading a single container at startup.
+struct LogBlockManager::ContainerLoadResult {
+  ContainerLoadResult() : max_block_id(0) {}
+
+  // The ID of the container, i.e. its file name without suffix.
+  string id;
+
+  // NULL if the container was skipped or could not be loaded.
+  unique_ptr<LogBlockContainer> container;
+
+  // The live blocks in the container, and the largest block ID it has used.
+  UntrackedBlockMap blocks;
+  uint64_t max_block_id;
+
+  Status status;
+
+  // Time spent in each phase of loading the container.
+  MonoDelta read_metadata_time;
+  MonoDelta process_records_time;
+};
+
 void LogBlockManager::OpenDataDir(DataDir* dir,
                                   Status* result_status) {
-  // Find all containers and open them.
+  // Find all containers.
   vector<string> children;
   Status s = env_->GetChildren(dir->dir(), &children);
   if (!s.ok()) {
@@ -1631,96 +2198,161 @@ void LogBlockManager::OpenDataDir(DataDir* dir,
         "Could not list children of $0", dir->dir()));
     return;
   }
+  vector<ContainerLoadResult> results;
   for (const string& child : children) {
     string id;
     if (!TryStripSuffixString(child, LogBlockManager::kContainerMetadataFileSuffix, &id)) {
       continue;
     }
-    unique_ptr<LogBlockContainer> container;
-    s = LogBlockContainer::Open(this, dir, id, &container);
-    if (s.IsAborted()) {
-      // Skip the container. Open() already handled logging for us.
-      continue;
-    }
+    results.emplace_back();
+    results.back().id = std::move(id);
+  }
+
+  // Load the containers in parallel. Each container is loaded independently
+  // of the others, into its own container-local block map.
+  gscoped_ptr<ThreadPool> pool;
+  s = ThreadPoolBuilder(Substitute("lbm load $0", dir->dir()))
+      .set_max_threads(std::max(1, FLAGS_log_block_manager_container_load_threads_per_dir))
+      .Build(&pool);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "Could not create container loading pool for $0", dir->dir()));
+    return;
+  }
+  for (ContainerLoadResult& r : results) {
+    ContainerLoadResult* result = &r;
+    s = pool->SubmitFunc([this, dir, result]() { this->LoadContainer(dir, result); });
     if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not open container $0", id));
-      return;
+      // Load the container on this thread instead.
+      LoadContainer(dir, result);
     }
+  }
+  pool->Wait();
+  pool->Shutdown();
 
-    // Populate the in-memory block maps using each container's records.
-    deque<BlockRecordPB> records;
-    s = container->ReadContainerRecords(&records);
-    if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not read records from container $0", container->ToString()));
+  // Merge the containers' blocks into the main block map.
+  //
+  // It's important that we don't try to add blocks to the global map as we
+  // see each record, since it's possible that one container has a "CREATE <b>"
+  // while another has a "CREATE <b> ; DELETE <b>" pair. If we processed those
+  // two containers in this order, then upon processing the second container,
+  // we'd think there was a duplicate block. Building the container-local maps
+  // first ensures that we discount deleted blocks before checking for
+  // duplicate IDs.
+  //
+  // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
+  // exceedingly unlikely. However, we might have old data which still exhibits
+  // the above issue.
+  int64_t read_metadata_time_ms = 0;
+  int64_t process_records_time_ms = 0;
+  MonoTime merge_start = MonoTime::Now();
+  int num_loaded = 0;
+  for (ContainerLoadResult& r : results) {
+    read_metadata_time_ms += r.read_metadata_time.ToMilliseconds();
+    process_records_time_ms += r.process_records_time.ToMilliseconds();
+    if (!r.status.ok()) {
+      *result_status = r.status;
       return;
     }
-
-    // Process the records, building a container-local map.
-    //
-    // It's important that we don't try to add these blocks to the global map
-    // incrementally as we see each record, since it's possible that one container
-    // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
-    // If we processed those two containers in this order, then upon processing
-    // the second container, we'd think there was a duplicate block. Building
-    // the container-local map first ensures that we discount deleted blocks
-    // before checking for duplicate IDs.
-    //
-    // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
-    // exceedingly unlikely. However, we might have old data which still exhibits
-    // the above issue.
-    UntrackedBlockMap blocks_in_container;
-    uint64_t max_block_id = 0;
-    for (const BlockRecordPB& r : records) {
-      s = ProcessBlockRecord(r, container.get(), &blocks_in_container);
-      if (!s.ok()) {
-        *result_status = s.CloneAndPrepend(Substitute(
-            "Could not process record in container $0", container->ToString()));
-        return;
-      }
-      max_block_id = std::max(max_block_id, r.block_id().id());
+    if (!r.container) {
+      continue;
     }
+    num_loaded++;
+    next_block_id_.StoreMax(r.max_block_id + 1);
 
-    // Having processed the block records, it is now safe to truncate the
-    // preallocated space off of the end of the container. This is a no-op for
-    // non-full containers, where excess preallocated space is expected to be
-    // (eventually) used.
-    if (!read_only_) {
-      s = container->TruncateDataToTotalBytesWritten();
-      if (!s.ok()) {
-        *result_status = s.CloneAndPrepend(Substitute(
-            "Could not truncate container $0", container->ToString()));
-        return;
+    // Under the lock, merge this map into the main block map and add
+    // the container.
+    std::lock_guard<simple_spinlock> l(lock_);
+    // To avoid cacheline contention during startup, we aggregate all of the
+    // memory in a local and add it to the mem-tracker in a single increment
+    // at the end of this loop.
+    int64_t mem_usage = 0;
+    for (const UntrackedBlockMap::value_type& e : r.blocks) {
+      if (!AddLogBlockUnlocked(e.second)) {
+        LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
+                   << " which already is alive from another container when "
+                   << " processing container " << r.container->ToString();
       }
+      mem_usage += kudu_malloc_usable_size(e.second.get());
     }
 
-    next_block_id_.StoreMax(max_block_id + 1);
+    mem_tracker_->Consume(mem_usage);
+    AddNewContainerUnlocked(r.container.get());
+    MakeContainerAvailableUnlocked(r.container.release());
+  }
+  MonoDelta merge_time = MonoTime::Now() - merge_start;
 
-    // Under the lock, merge this map into the main block map and add
-    // the container.
-    {
-      std::lock_guard<simple_spinlock> l(lock_);
-      // To avoid cacheline contention during startup, we aggregate all of the
-      // memory in a local and add it to the mem-tracker in a single increment
-      // at the end of this loop.
-      int64_t mem_usage = 0;
-      for (const UntrackedBlockMap::value_type& e : blocks_in_container) {
-        if (!AddLogBlockUnlocked(e.second)) {
-          LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
-                     << " which already is alive from another container when "
-                     << " processing container " << container->ToString();
-        }
-        mem_usage += kudu_malloc_usable_size(e.second.get());
-      }
+  if (metrics_) {
+    metrics_->startup_read_metadata_time_ms->IncrementBy(read_metadata_time_ms);
+    metrics_->startup_process_records_time_ms->IncrementBy(process_records_time_ms);
+    metrics_->startup_merge_time_ms->IncrementBy(merge_time.ToMilliseconds());
+  }
+  LOG(INFO) << Substitute("Loaded $0 containers from data dir $1: spent $2 ms reading "
+                          "metadata and $3 ms processing records (summed across threads), "
+                          "and $4 ms merging block maps",
+                          num_loaded, dir->dir(), read_metadata_time_ms,
+                          process_records_time_ms, merge_time.ToMilliseconds());
+
+  *result_status = Status::OK();
+}
+
+void LogBlockManager::LoadContainer(DataDir* dir, ContainerLoadResult* result) {
+  MonoTime start = MonoTime::Now();
+  unique_ptr<LogBlockContainer> container;
+  Status s = LogBlockContainer::Open(this, dir, result->id, &container);
+  if (s.IsAborted()) {
+    // Skip the container. Open() already handled logging for us.
+    return;
+  }
+  if (!s.ok()) {
+    result->status = s.CloneAndPrepend(Substitute(
+        "Could not open container $0", result->id));
+    return;
+  }
 
-      mem_tracker_->Consume(mem_usage);
-      AddNewContainerUnlocked(container.get());
-      MakeContainerAvailableUnlocked(container.release());
+  // Populate the container-local block map using the container's records.
+  deque<BlockRecordPB> records;
+  s = container->ReadContainerRecords(&records);
+  MonoTime read_end = MonoTime::Now();
+  result->read_metadata_time = read_end - start;
+  if (!s.ok()) {
+    result->status = s.CloneAndPrepend(Substitute(
+        "Could not read records from container $0", container->ToString()));
+    return;
+  }
+
+  for (const BlockRecordPB& r : records) {
+    s = ProcessBlockRecord(r, container.get(), &result->blocks);
+    if (!s.ok()) {
+      result->status = s.CloneAndPrepend(Substitute(
+          "Could not process record in container $0", container->ToString()));
+      return;
     }
+    result->max_block_id = std::max(result->max_block_id, r.block_id().id());
   }
 
-  *result_status = Status::OK();
+  // Having processed the block records, it is now safe to truncate the
+  // preallocated space off of the end of the container. This is a no-op for
+  // non-full containers, where excess preallocated space is expected to be
+  // (eventually) used.
+  if (!read_only_) {
+    s = container->TruncateDataToTotalBytesWritten();
+    if (!s.ok()) {
+      result->status = s.CloneAndPrepend(Substitute(
+          "Could not truncate container $0", container->ToString()));
+      return;
+    }
+  }
+  // Drop the records of deleted blocks from the metadata if they make up
+  // too much of it, so that they needn't be replayed again next time.
+  container->SetMetadataCounts(records.size(), result->blocks.size());
+  if (!read_only_ && container->ShouldCompactMetadata()) {
+    WARN_NOT_OK(container->RewriteMetadata(records),
+                Substitute("Could not compact metadata of container $0",
+                           container->ToString()));
+  }
+  result->process_records_time = MonoTime::Now() - read_end;
+  result->container = std::move(container);
 }
 
 Status LogBlockManager::ProcessBlockRecord(const BlockRecordPB& record,
@@ -37,7 +37,10 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/mem_tracker.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/oid_generator.h"
 #include "kudu/util/random.h"
 
@@ -47,6 +50,7 @@ template <class FileType>
 class FileCache;
 class MetricEntity;
 class RWFile;
+class Thread;
 class ThreadPool;
 
 namespace fs {
@@ -178,14 +182,19 @@ class LogBlockManager : public BlockManager {
 
   virtual Status DeleteBlock(const BlockId& block_id) OVERRIDE;
 
+  virtual Status FindBlockDataDir(const BlockId& block_id, std::string* dir) OVERRIDE;
+
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
   // Return the number of blocks stored in the block manager.
   int64_t CountBlocksForTests() const;
 
  private:
+  FRIEND_TEST(LogBlockManagerTest, TestLoadAwarePlacement);
   FRIEND_TEST(LogBlockManagerTest, TestLookupBlockLimit);
+  FRIEND_TEST(LogBlockManagerTest, TestMetadataCompaction);
   FRIEND_TEST(LogBlockManagerTest, TestMetadataTruncation);
+  FRIEND_TEST(LogBlockManagerTest, TestParallelContainerLoading);
   FRIEND_TEST(LogBlockManagerTest, TestParseKernelRelease);
   FRIEND_TEST(LogBlockManagerTest, TestReuseBlockIds);
 
@@ -224,8 +233,29 @@ class LogBlockManager : public BlockManager {
   void MakeContainerAvailable(internal::LogBlockContainer* container);
   void MakeContainerAvailableUnlocked(internal::LogBlockContainer* container);
 
+  // Arranges for the space queued for deletion in 'container' to be freed,
+  // either right away or by the next pass of the hole punching thread,
+  // according to --log_block_manager_hole_punch_interval_ms.
+  void ScheduleHolePunch(internal::LogBlockContainer* container);
+
+  // Hands every container with space queued for deletion to its data
+  // directory's thread pool, to have the space freed.
+  void DispatchHolePunches();
+
+  // Calls DispatchHolePunches() periodically until the block manager is
+  // destroyed.
+  void RunHolePunchThread();
+
+  // Records that the directory of 'dir' has changed (e.g. a container was
+  // created in it) and must be synchronized before the change is relied on.
+  void MarkDirDirty(const DataDir* dir);
+
   // Synchronizes a container's dirty metadata to disk, taking care not to
-  // sync more than is necessary (using 'dirty_dirs_').
+  // sync more than is necessary (using 'dir_sync_states_').
+  //
+  // Concurrent callers for the same directory are coalesced: one of them
+  // syncs the directory on behalf of all changes made so far, and the rest
+  // wait for it to finish.
   Status SyncContainer(const internal::LogBlockContainer& container);
 
   // Attempts to claim 'block_id' for use in a new WritableBlock.
@@ -261,11 +291,20 @@ class LogBlockManager : public BlockManager {
                             internal::LogBlockContainer* container,
                             UntrackedBlockMap* block_map);
 
+  struct ContainerLoadResult;
+
   // Open a particular data directory belonging to the block manager.
   //
-  // Success or failure is set in 'result_status'.
+  // The directory's containers are loaded in parallel on a pool of
+  // --log_block_manager_container_load_threads_per_dir threads, and their
+  // blocks then merged into the block map. Success or failure is set in
+  // 'result_status'.
   void OpenDataDir(DataDir* dir, Status* result_status);
 
+  // Open the container 'result->id' in 'dir' and process its block records
+  // into 'result'. Safe to call concurrently for different containers.
+  void LoadContainer(DataDir* dir, ContainerLoadResult* result);
+
   // Perform basic initialization.
   Status Init();
 
@@ -329,10 +368,34 @@ class LogBlockManager : public BlockManager {
   std::unordered_map<const DataDir*,
                      std::deque<internal::LogBlockContainer*>> available_containers_by_data_dir_;
 
-  // Tracks dirty container directories.
+  // Containers with space queued for deletion, waiting for the next pass of
+  // 'hole_punch_thread_'.
+  //
+  // Does not own the containers.
+  std::unordered_set<internal::LogBlockContainer*> containers_pending_hole_punch_;
+
+  // Synchronization state of one container directory.
+  struct DirSyncState {
+    DirSyncState() : dirtied_seq(0), synced_seq(0), syncing(false) {}
+
+    // Incremented each time the directory is changed.
+    int64_t dirtied_seq;
+
+    // The value of 'dirtied_seq' as of the last successful sync.
+    int64_t synced_seq;
+
+    // Whether a thread is currently syncing the directory.
+    bool syncing;
+  };
+
+  // Protects 'dir_sync_states_'.
+  Mutex dir_sync_lock_;
+  ConditionVariable dir_sync_cond_;
+
+  // Tracks dirty container directories, keyed by path.
   //
-  // Synced and cleared by SyncMetadata().
-  std::unordered_set<std::string> dirty_dirs_;
+  // Synced by SyncContainer().
+  std::unordered_map<std::string, DirSyncState> dir_sync_states_;
 
   // For manipulating files.
   Env* env_;
@@ -354,6 +417,12 @@ class LogBlockManager : public BlockManager {
   // May be null if instantiated without metrics.
   gscoped_ptr<internal::LogBlockManagerMetrics> metrics_;
 
+  // Runs RunHolePunchThread(). Not started in read-only mode.
+  scoped_refptr<Thread> hole_punch_thread_;
+
+  // Counted down to stop 'hole_punch_thread_'.
+  CountDownLatch hole_punch_thread_stop_;
+
   DISALLOW_COPY_AND_ASSIGN(LogBlockManager);
 };
 
@@ -38,6 +38,9 @@
 #include <string.h>   // for memmove(), memchr(), etc.
 #include <fcntl.h>    // for open()
 #include <errno.h>    // for errno
+#if defined(__linux__)
+#include <sched.h>    // for sched_getcpu()
+#endif
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>   // for read()
 #endif
@@ -409,4 +412,13 @@ int MaxCPUIndex(void) {
   return cpuinfo_max_cpu_index;
 }
 
+int CurrentCPUIndex(void) {
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+  return cpu >= 0 ? cpu : 0;
+#else
+  return 0;
+#endif
+}
+
 } // namespace base
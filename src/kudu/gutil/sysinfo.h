@@ -45,6 +45,12 @@ extern int NumCPUs();
 // an 8-core machine, this will return '7' even if some of the CPUs have been disabled.
 extern int MaxCPUIndex();
 
+// Return the index of the CPU which the calling thread is running on, in the
+// range [0, MaxCPUIndex()]. The thread may be rescheduled to another CPU at
+// any time, so this is only useful as a hint, e.g. to pick a per-CPU shard.
+// Returns 0 if the CPU can't be determined, which is always the case on OS X.
+extern int CurrentCPUIndex();
+
 void SleepForNanoseconds(int64_t nanoseconds);
 void SleepForMilliseconds(int64_t milliseconds);
 
@@ -0,0 +1,548 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// End-to-end performance suite, run against an ExternalMiniCluster.
+//
+// Each test is a scenario: insert throughput, random point reads, ordered
+// and unordered scans, inserts while flushes and compactions run, tablet
+// copy, and restart (bootstrap) time. Each scenario emits a single line of
+// JSON with its parameters, its elapsed time and throughput, the latency
+// percentiles of its operations, and a few server metrics summed over the
+// tablet servers. The lines are logged, and appended to the file given by
+// --perf_suite_output_path if it is set, so that runs on the same hardware
+// can be compared, e.g. across release candidates.
+//
+// The scenarios are parameterized by the --perf_suite_* flags. By default
+// they are small enough to run as part of the tests; with
+// KUDU_ALLOW_SLOW_TESTS set, or with explicit sizes, they are large enough
+// to be meaningful. For example:
+//
+//   perf_suite-itest --perf_suite_num_rows=10000000 \
+//                    --perf_suite_num_threads=16 \
+//                    --perf_suite_tserver_flags="--block_cache_capacity_mb=4096" \
+//                    --perf_suite_output_path=/tmp/perf.json
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/optional.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/client/client.h"
+#include "kudu/client/scan_batch.h"
+#include "kudu/client/value.h"
+#include "kudu/client/write_op.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/integration-tests/cluster_itest_util.h"
+#include "kudu/integration-tests/external_mini_cluster-itest-base.h"
+#include "kudu/tablet/metadata.pb.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/random.h"
+#include "kudu/util/test_util.h"
+
+DEFINE_string(perf_suite_output_path, "",
+              "If set, the file to which the result of each scenario is appended, "
+              "as a line of JSON");
+DEFINE_int32(perf_suite_num_tablet_servers, 3, "Number of tablet servers");
+DEFINE_int32(perf_suite_num_replicas, 3, "Number of replicas of each tablet");
+DEFINE_int32(perf_suite_num_tablets, 4, "Number of tablets, hash-partitioned by key");
+DEFINE_int32(perf_suite_num_threads, 4, "Number of client threads in each scenario");
+DEFINE_int64(perf_suite_num_rows, -1,
+             "Number of rows loaded by each scenario. If -1, 10000, or 1000000 "
+             "if slow tests are allowed.");
+DEFINE_int32(perf_suite_batch_size, 100, "Number of rows per flush of the writers");
+DEFINE_int32(perf_suite_payload_bytes, 100, "Size of the string column of each row");
+DEFINE_int32(perf_suite_read_seconds, -1,
+             "How long the random reads run for. If -1, 2, or 30 if slow tests "
+             "are allowed.");
+DEFINE_string(perf_suite_tserver_flags, "",
+              "Space-separated extra flags for the tablet servers, e.g. to compare "
+              "configurations");
+
+METRIC_DECLARE_entity(server);
+METRIC_DECLARE_entity(tablet);
+METRIC_DECLARE_counter(block_cache_hits_caching);
+METRIC_DECLARE_counter(block_cache_misses_caching);
+METRIC_DECLARE_counter(rows_inserted);
+METRIC_DECLARE_counter(scanner_rows_scanned);
+METRIC_DECLARE_counter(scanner_bytes_returned);
+METRIC_DECLARE_gauge_size(on_disk_size);
+METRIC_DECLARE_histogram(flush_mrs_duration);
+METRIC_DECLARE_histogram(compact_rs_duration);
+METRIC_DECLARE_histogram(log_append_latency);
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+using client::KuduColumnSchema;
+using client::KuduInsert;
+using client::KuduPredicate;
+using client::KuduScanBatch;
+using client::KuduScanner;
+using client::KuduSchema;
+using client::KuduSchemaBuilder;
+using client::KuduSession;
+using client::KuduTable;
+using client::KuduTableCreator;
+using client::KuduValue;
+using itest::TServerDetails;
+using tablet::TABLET_DATA_READY;
+using tablet::TABLET_DATA_TOMBSTONED;
+
+namespace {
+
+const char* const kTableName = "perf_suite";
+const MonoDelta kTimeout = MonoDelta::FromSeconds(300);
+
+int64_t NumRows() {
+  if (FLAGS_perf_suite_num_rows >= 0) {
+    return FLAGS_perf_suite_num_rows;
+  }
+  return AllowSlowTests() ? 1000000 : 10000;
+}
+
+int ReadSeconds() {
+  if (FLAGS_perf_suite_read_seconds >= 0) {
+    return FLAGS_perf_suite_read_seconds;
+  }
+  return AllowSlowTests() ? 30 : 2;
+}
+
+// The order in which the writers insert the keys [0, num_rows).
+enum class KeyOrder {
+  // Each writer inserts increasing keys, so the tablets flush rowsets whose
+  // key ranges barely overlap.
+  SEQUENTIAL,
+  // The keys are a permutation of the range, so that every flushed rowset
+  // overlaps the others and must be compacted.
+  SCRAMBLED
+};
+
+int64_t KeyForRow(int64_t row, int64_t num_rows, KeyOrder order) {
+  if (order == KeyOrder::SEQUENTIAL) {
+    return row;
+  }
+  // Multiplying by a prime which doesn't divide the number of rows permutes
+  // the range.
+  return static_cast<int64_t>((static_cast<uint64_t>(row) * 2654435761ULL) % num_rows);
+}
+
+} // anonymous namespace
+
+class PerfSuiteITest : public ExternalMiniClusterITestBase {
+ public:
+  void SetUp() override {
+    ExternalMiniClusterITestBase::SetUp();
+    KuduSchemaBuilder b;
+    b.AddColumn("key")->Type(KuduColumnSchema::INT64)->NotNull()->PrimaryKey();
+    b.AddColumn("int_val")->Type(KuduColumnSchema::INT64)->NotNull();
+    b.AddColumn("string_val")->Type(KuduColumnSchema::STRING)->NotNull();
+    ASSERT_OK(b.Build(&schema_));
+  }
+
+ protected:
+  // Starts the cluster with --perf_suite_tserver_flags and 'extra_ts_flags',
+  // and creates the table.
+  void StartClusterAndCreateTable(const vector<string>& extra_ts_flags = {}) {
+    vector<string> ts_flags = strings::Split(FLAGS_perf_suite_tserver_flags, " ",
+                                             strings::SkipEmpty());
+    ts_flags.insert(ts_flags.end(), extra_ts_flags.begin(), extra_ts_flags.end());
+    NO_FATALS(StartCluster(ts_flags, {}, FLAGS_perf_suite_num_tablet_servers));
+
+    unique_ptr<KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name(kTableName)
+              .schema(&schema_)
+              .add_hash_partitions({ "key" }, FLAGS_perf_suite_num_tablets)
+              .num_replicas(FLAGS_perf_suite_num_replicas)
+              .Create());
+    ASSERT_OK(client_->OpenTable(kTableName, &table_));
+  }
+
+  // Inserts the rows [0, num_rows) from --perf_suite_num_threads threads,
+  // recording the latency of each flush in 'latency_us'.
+  void InsertRows(int64_t num_rows, KeyOrder order, HdrHistogram* latency_us) {
+    vector<std::thread> threads;
+    for (int i = 0; i < FLAGS_perf_suite_num_threads; i++) {
+      threads.emplace_back([this, i, num_rows, order, latency_us]() {
+        CHECK_OK(InsertThread(i, num_rows, order, latency_us));
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+
+  // Scans the whole table, recording the latency of each batch in
+  // 'latency_us'.
+  Status ScanTable(bool ordered, int64_t* num_rows, HdrHistogram* latency_us) {
+    KuduScanner scanner(table_.get());
+    if (ordered) {
+      RETURN_NOT_OK(scanner.SetFaultTolerant());
+    }
+    RETURN_NOT_OK(scanner.SetTimeoutMillis(kTimeout.ToMilliseconds()));
+    RETURN_NOT_OK(scanner.Open());
+    KuduScanBatch batch;
+    *num_rows = 0;
+    while (scanner.HasMoreRows()) {
+      MicrosecondsInt64 start_us = GetMonoTimeMicros();
+      RETURN_NOT_OK(scanner.NextBatch(&batch));
+      latency_us->Increment(GetMonoTimeMicros() - start_us);
+      *num_rows += batch.NumRows();
+    }
+    return Status::OK();
+  }
+
+  // Reads random keys of [0, num_rows) until 'seconds' have elapsed,
+  // returning the number of reads.
+  int64_t ReadRandomRows(int64_t num_rows, int seconds, HdrHistogram* latency_us) {
+    const MicrosecondsInt64 deadline_us = GetMonoTimeMicros() + seconds * 1000000L;
+    AtomicInt<int64_t> num_reads(0);
+    vector<std::thread> threads;
+    for (int i = 0; i < FLAGS_perf_suite_num_threads; i++) {
+      threads.emplace_back([this, i, num_rows, deadline_us, latency_us, &num_reads]() {
+        Random rng(SeedRandom() + i);
+        while (GetMonoTimeMicros() < deadline_us) {
+          const int64_t key = rng.Next64() % num_rows;
+          MicrosecondsInt64 start_us = GetMonoTimeMicros();
+          int64_t found;
+          CHECK_OK(ReadRow(key, &found));
+          CHECK_EQ(1, found) << "key " << key;
+          latency_us->Increment(GetMonoTimeMicros() - start_us);
+          num_reads.Increment();
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    return num_reads.Load();
+  }
+
+  // Logs the result of 'scenario' as a line of JSON, and appends it to
+  // --perf_suite_output_path. 'latency_us' may be null.
+  void Report(const string& scenario, double seconds, int64_t ops,
+              const HdrHistogram* latency_us) {
+    std::ostringstream out;
+    JsonWriter jw(&out, JsonWriter::COMPACT);
+    jw.StartObject();
+    jw.String("scenario");
+    jw.String(scenario);
+
+    jw.String("params");
+    jw.StartObject();
+    jw.String("num_tablet_servers");
+    jw.Int(FLAGS_perf_suite_num_tablet_servers);
+    jw.String("num_replicas");
+    jw.Int(FLAGS_perf_suite_num_replicas);
+    jw.String("num_tablets");
+    jw.Int(FLAGS_perf_suite_num_tablets);
+    jw.String("num_threads");
+    jw.Int(FLAGS_perf_suite_num_threads);
+    jw.String("num_rows");
+    jw.Int64(NumRows());
+    jw.String("batch_size");
+    jw.Int(FLAGS_perf_suite_batch_size);
+    jw.String("payload_bytes");
+    jw.Int(FLAGS_perf_suite_payload_bytes);
+    jw.String("tserver_flags");
+    jw.String(FLAGS_perf_suite_tserver_flags);
+    jw.EndObject();
+
+    jw.String("seconds");
+    jw.Double(seconds);
+    jw.String("ops");
+    jw.Int64(ops);
+    jw.String("ops_per_second");
+    jw.Double(seconds > 0 ? ops / seconds : 0);
+
+    if (latency_us && latency_us->TotalCount() > 0) {
+      jw.String("latency_us");
+      jw.StartObject();
+      jw.String("mean");
+      jw.Double(latency_us->MeanValue());
+      for (double p : { 50.0, 95.0, 99.0, 99.9 }) {
+        jw.String(Substitute("p$0", p));
+        jw.Uint64(latency_us->ValueAtPercentile(p));
+      }
+      jw.String("max");
+      jw.Uint64(latency_us->MaxValue());
+      jw.EndObject();
+    }
+
+    jw.String("metrics");
+    jw.StartObject();
+    for (const MetricPrototype* proto : vector<const MetricPrototype*>{
+        &METRIC_rows_inserted, &METRIC_scanner_rows_scanned, &METRIC_scanner_bytes_returned,
+        &METRIC_on_disk_size }) {
+      jw.String(proto->name());
+      jw.Int64(SumMetric(&METRIC_ENTITY_tablet, proto, "value"));
+    }
+    for (const MetricPrototype* proto : vector<const MetricPrototype*>{
+        &METRIC_flush_mrs_duration, &METRIC_compact_rs_duration,
+        &METRIC_log_append_latency }) {
+      jw.String(Substitute("$0_count", proto->name()));
+      jw.Int64(SumMetric(&METRIC_ENTITY_tablet, proto, "total_count"));
+      jw.String(Substitute("$0_sum", proto->name()));
+      jw.Int64(SumMetric(&METRIC_ENTITY_tablet, proto, "total_sum"));
+    }
+    for (const MetricPrototype* proto : vector<const MetricPrototype*>{
+        &METRIC_block_cache_hits_caching, &METRIC_block_cache_misses_caching }) {
+      jw.String(proto->name());
+      jw.Int64(SumMetric(&METRIC_ENTITY_server, proto, "value"));
+    }
+    jw.EndObject();
+    jw.EndObject();
+
+    LOG(INFO) << "Perf suite result: " << out.str();
+    if (!FLAGS_perf_suite_output_path.empty()) {
+      std::ofstream f(FLAGS_perf_suite_output_path, std::ios::app);
+      f << out.str() << std::endl;
+      CHECK(f.good()) << "Couldn't write to " << FLAGS_perf_suite_output_path;
+    }
+  }
+
+  // Returns the tablets of the table on each tablet server.
+  vector<vector<string>> TabletIdsByServer() {
+    vector<vector<string>> tablet_ids(cluster_->num_tablet_servers());
+    for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+      TServerDetails* ts = ts_map_[cluster_->tablet_server(i)->uuid()];
+      CHECK_OK(itest::ListRunningTabletIds(ts, kTimeout, &tablet_ids[i]));
+    }
+    return tablet_ids;
+  }
+
+  KuduSchema schema_;
+  client::sp::shared_ptr<KuduTable> table_;
+
+ private:
+  Status InsertThread(int thread_idx, int64_t num_rows, KeyOrder order,
+                      HdrHistogram* latency_us) {
+    client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+    session->SetTimeoutMillis(kTimeout.ToMilliseconds());
+    RETURN_NOT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+    const string payload(FLAGS_perf_suite_payload_bytes, 'x');
+    int rows_in_batch = 0;
+    for (int64_t row = thread_idx; row < num_rows; row += FLAGS_perf_suite_num_threads) {
+      unique_ptr<KuduInsert> insert(table_->NewInsert());
+      RETURN_NOT_OK(insert->mutable_row()->SetInt64("key", KeyForRow(row, num_rows, order)));
+      RETURN_NOT_OK(insert->mutable_row()->SetInt64("int_val", row));
+      RETURN_NOT_OK(insert->mutable_row()->SetStringCopy("string_val", payload));
+      RETURN_NOT_OK(session->Apply(insert.release()));
+      if (++rows_in_batch == FLAGS_perf_suite_batch_size) {
+        RETURN_NOT_OK(FlushSession(session.get(), latency_us));
+        rows_in_batch = 0;
+      }
+    }
+    if (rows_in_batch > 0) {
+      RETURN_NOT_OK(FlushSession(session.get(), latency_us));
+    }
+    return session->Close();
+  }
+
+  static Status FlushSession(KuduSession* session, HdrHistogram* latency_us) {
+    MicrosecondsInt64 start_us = GetMonoTimeMicros();
+    RETURN_NOT_OK(session->Flush());
+    latency_us->Increment(GetMonoTimeMicros() - start_us);
+    return Status::OK();
+  }
+
+  Status ReadRow(int64_t key, int64_t* found) {
+    KuduScanner scanner(table_.get());
+    RETURN_NOT_OK(scanner.AddConjunctPredicate(table_->NewComparisonPredicate(
+        "key", KuduPredicate::EQUAL, KuduValue::FromInt(key))));
+    RETURN_NOT_OK(scanner.SetTimeoutMillis(kTimeout.ToMilliseconds()));
+    RETURN_NOT_OK(scanner.Open());
+    KuduScanBatch batch;
+    *found = 0;
+    while (scanner.HasMoreRows()) {
+      RETURN_NOT_OK(scanner.NextBatch(&batch));
+      *found += batch.NumRows();
+    }
+    return Status::OK();
+  }
+
+  // Sums the metric over the tablet servers and, for tablet metrics, over
+  // the replicas of the table. Missing metrics count as zero.
+  int64_t SumMetric(const MetricEntityPrototype* entity_proto,
+                    const MetricPrototype* metric_proto,
+                    const char* value_field) {
+    vector<vector<string>> tablet_ids;
+    if (entity_proto == &METRIC_ENTITY_tablet) {
+      tablet_ids = TabletIdsByServer();
+    }
+    int64_t sum = 0;
+    for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+      ExternalTabletServer* ets = cluster_->tablet_server(i);
+      vector<const char*> entity_ids;
+      if (entity_proto == &METRIC_ENTITY_tablet) {
+        for (const string& id : tablet_ids[i]) {
+          entity_ids.push_back(id.c_str());
+        }
+      } else {
+        entity_ids.push_back(nullptr);
+      }
+      for (const char* entity_id : entity_ids) {
+        int64_t value;
+        Status s = ets->GetInt64Metric(entity_proto, entity_id, metric_proto, value_field,
+                                       &value);
+        if (s.ok()) {
+          sum += value;
+        } else if (!s.IsNotFound()) {
+          LOG(WARNING) << "Couldn't read metric " << metric_proto->name() << ": "
+                       << s.ToString();
+        }
+      }
+    }
+    return sum;
+  }
+};
+
+// Inserts rows in increasing key order.
+TEST_F(PerfSuiteITest, InsertThroughput) {
+  NO_FATALS(StartClusterAndCreateTable());
+  const int64_t num_rows = NumRows();
+  HdrHistogram latency_us(kTimeout.ToMicroseconds(), 3);
+  MicrosecondsInt64 start_us = GetMonoTimeMicros();
+  InsertRows(num_rows, KeyOrder::SEQUENTIAL, &latency_us);
+  Report("insert", (GetMonoTimeMicros() - start_us) / 1e6, num_rows, &latency_us);
+}
+
+// Reads random single rows, by a predicate on the key.
+TEST_F(PerfSuiteITest, RandomReads) {
+  NO_FATALS(StartClusterAndCreateTable());
+  const int64_t num_rows = NumRows();
+  HdrHistogram insert_latency_us(kTimeout.ToMicroseconds(), 3);
+  InsertRows(num_rows, KeyOrder::SCRAMBLED, &insert_latency_us);
+
+  HdrHistogram latency_us(kTimeout.ToMicroseconds(), 3);
+  MicrosecondsInt64 start_us = GetMonoTimeMicros();
+  int64_t num_reads = ReadRandomRows(num_rows, ReadSeconds(), &latency_us);
+  Report("random_reads", (GetMonoTimeMicros() - start_us) / 1e6, num_reads, &latency_us);
+}
+
+// Scans the whole table, first without and then with ordering by key.
+TEST_F(PerfSuiteITest, Scans) {
+  NO_FATALS(StartClusterAndCreateTable());
+  const int64_t num_rows = NumRows();
+  HdrHistogram insert_latency_us(kTimeout.ToMicroseconds(), 3);
+  InsertRows(num_rows, KeyOrder::SCRAMBLED, &insert_latency_us);
+
+  for (bool ordered : { false, true }) {
+    HdrHistogram latency_us(kTimeout.ToMicroseconds(), 3);
+    int64_t rows_scanned;
+    MicrosecondsInt64 start_us = GetMonoTimeMicros();
+    ASSERT_OK(ScanTable(ordered, &rows_scanned, &latency_us));
+    ASSERT_EQ(num_rows, rows_scanned);
+    Report(ordered ? "ordered_scan" : "unordered_scan",
+           (GetMonoTimeMicros() - start_us) / 1e6, rows_scanned, &latency_us);
+  }
+}
+
+// Inserts keys in scrambled order while the tablet servers flush often, so
+// that the inserts compete with flushes and compactions of overlapping
+// rowsets.
+TEST_F(PerfSuiteITest, CompactionUnderLoad) {
+  NO_FATALS(StartClusterAndCreateTable({ "--flush_threshold_mb=1",
+                                         "--maintenance_manager_polling_interval_ms=10" }));
+  const int64_t num_rows = NumRows();
+  HdrHistogram latency_us(kTimeout.ToMicroseconds(), 3);
+  MicrosecondsInt64 start_us = GetMonoTimeMicros();
+  InsertRows(num_rows, KeyOrder::SCRAMBLED, &latency_us);
+  Report("compaction_under_load", (GetMonoTimeMicros() - start_us) / 1e6, num_rows,
+         &latency_us);
+}
+
+// Tombstones a follower replica of a loaded tablet, and times how long the
+// leader takes to copy the tablet back to it.
+TEST_F(PerfSuiteITest, TabletCopy) {
+  if (FLAGS_perf_suite_num_replicas < 2) {
+    LOG(INFO) << "Skipping: tablet copy requires at least 2 replicas";
+    return;
+  }
+  NO_FATALS(StartClusterAndCreateTable());
+  const int64_t num_rows = NumRows();
+  HdrHistogram insert_latency_us(kTimeout.ToMicroseconds(), 3);
+  InsertRows(num_rows, KeyOrder::SEQUENTIAL, &insert_latency_us);
+
+  const string tablet_id = TabletIdsByServer()[0][0];
+  TServerDetails* leader_ts;
+  ASSERT_OK(itest::FindTabletLeader(ts_map_, tablet_id, kTimeout, &leader_ts));
+  int follower_index = -1;
+  for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+    const string& uuid = cluster_->tablet_server(i)->uuid();
+    vector<string> ids;
+    ASSERT_OK(itest::ListRunningTabletIds(ts_map_[uuid], kTimeout, &ids));
+    if (uuid != leader_ts->uuid() && std::find(ids.begin(), ids.end(), tablet_id) != ids.end()) {
+      follower_index = i;
+      break;
+    }
+  }
+  ASSERT_NE(-1, follower_index);
+  TServerDetails* follower_ts = ts_map_[cluster_->tablet_server(follower_index)->uuid()];
+
+  MicrosecondsInt64 start_us = GetMonoTimeMicros();
+  ASSERT_OK(itest::DeleteTablet(follower_ts, tablet_id, TABLET_DATA_TOMBSTONED,
+                                boost::none, kTimeout));
+  ASSERT_OK(inspect_->WaitForTabletDataStateOnTS(follower_index, tablet_id,
+                                                 { TABLET_DATA_READY }, kTimeout));
+  ASSERT_OK(itest::WaitUntilTabletRunning(follower_ts, tablet_id, kTimeout));
+  Report("tablet_copy", (GetMonoTimeMicros() - start_us) / 1e6, 1, nullptr);
+}
+
+// Restarts the loaded tablet servers, and times how long they take to
+// bootstrap all their tablets.
+TEST_F(PerfSuiteITest, RestartBootstrap) {
+  NO_FATALS(StartClusterAndCreateTable());
+  const int64_t num_rows = NumRows();
+  HdrHistogram insert_latency_us(kTimeout.ToMicroseconds(), 3);
+  InsertRows(num_rows, KeyOrder::SCRAMBLED, &insert_latency_us);
+
+  vector<vector<string>> tablet_ids = TabletIdsByServer();
+  cluster_->ShutdownNodes(ClusterNodes::TS_ONLY);
+  MicrosecondsInt64 start_us = GetMonoTimeMicros();
+  for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+    ASSERT_OK(cluster_->tablet_server(i)->Restart());
+  }
+  for (int i = 0; i < cluster_->num_tablet_servers(); i++) {
+    ASSERT_OK(cluster_->WaitForTabletsRunning(cluster_->tablet_server(i),
+                                              tablet_ids[i].size(), kTimeout));
+  }
+  int64_t num_tablets = 0;
+  for (const auto& ids : tablet_ids) {
+    num_tablets += ids.size();
+  }
+  Report("restart_bootstrap", (GetMonoTimeMicros() - start_us) / 1e6, num_tablets, nullptr);
+}
+
+} // namespace kudu
@@ -40,6 +40,8 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/version_info.h"
 
+DECLARE_bool(catalog_manager_batch_tablet_reports);
+DECLARE_int32(catalog_manager_tablet_report_batch_size);
 DECLARE_int32(heartbeat_interval_ms);
 
 namespace kudu {
@@ -199,6 +201,34 @@ TEST_F(RegistrationTest, TestTabletReports) {
   // the TS, and verifies that the master notices the issue.
 }
 
+// Test that the tablets of the reports are all handled when the changes they
+// carry are written to the sys catalog in batches.
+TEST_F(RegistrationTest, TestBatchedTabletReports) {
+  FLAGS_catalog_manager_batch_tablet_reports = true;
+  FLAGS_catalog_manager_tablet_report_batch_size = 2;
+
+  MiniTabletServer* ts = cluster_->mini_tablet_server(0);
+  const int kNumTablets = 5;
+  vector<string> tablet_ids(kNumTablets);
+  for (int i = 0; i < kNumTablets; i++) {
+    CreateTabletForTesting(cluster_->mini_master(), strings::Substitute("fake-table-$0", i),
+                           schema_, &tablet_ids[i]);
+  }
+  TabletLocationsPB locs;
+  for (const string& tablet_id : tablet_ids) {
+    ASSERT_OK(WaitForReplicaCount(tablet_id, 1, &locs));
+  }
+
+  // The full tablet report sent to the restarted master is handled in batches.
+  ts->Shutdown();
+  cluster_->mini_master()->Shutdown();
+  ASSERT_OK(cluster_->mini_master()->Restart());
+  ASSERT_OK(ts->Start());
+  for (const string& tablet_id : tablet_ids) {
+    ASSERT_OK(WaitForReplicaCount(tablet_id, 1, &locs));
+  }
+}
+
 // Check that after the tablet server registers, it gets a signed cert
 // from the master.
 TEST_F(RegistrationTest, TestTSGetsSignedX509Certificate) {
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <memory>
 #include <string>
@@ -34,6 +35,8 @@
 #include "kudu/util/pb_util.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(catalog_manager_cache_tablet_locations);
+
 using kudu::rpc::Messenger;
 using kudu::rpc::MessengerBuilder;
 using kudu::rpc::RpcController;
@@ -229,6 +232,53 @@ TEST_F(TableLocationsTest, TestGetTableLocations) {
   }
 }
 
+// Test that cached tablet locations are the same as the locations built
+// for each request.
+TEST_F(TableLocationsTest, TestGetTableLocationsCached) {
+  const string table_name = "test";
+  Schema schema({ ColumnSchema("key", STRING) }, 1);
+  KuduPartialRow row(&schema);
+
+  vector<KuduPartialRow> splits(2, row);
+  ASSERT_OK(splits[0].SetStringNoCopy(0, "b"));
+  ASSERT_OK(splits[1].SetStringNoCopy(0, "c"));
+  ASSERT_OK(CreateTable(table_name, schema, splits, {}));
+
+  // Wait for every tablet to elect a leader, so that the locations are stable.
+  GetTableLocationsRequestPB req;
+  req.mutable_table()->set_table_name(table_name);
+  GetTableLocationsResponsePB uncached_resp;
+  for (int i = 1; ; i++) {
+    if (i > 10) {
+      FAIL() << "Leader election timed out";
+    }
+    RpcController controller;
+    ASSERT_OK(proxy_->GetTableLocations(req, &uncached_resp, &controller));
+    int num_leaders = 0;
+    if (!uncached_resp.has_error()) {
+      for (const auto& locs : uncached_resp.tablet_locations()) {
+        for (const auto& replica : locs.replicas()) {
+          if (replica.role() == consensus::RaftPeerPB::LEADER) {
+            num_leaders++;
+          }
+        }
+      }
+    }
+    if (num_leaders == 3) {
+      break;
+    }
+    SleepFor(MonoDelta::FromMilliseconds(i * i * 100));
+  }
+
+  FLAGS_catalog_manager_cache_tablet_locations = true;
+  // The first request fills the cache, the second one uses it.
+  for (int i = 0; i < 2; i++) {
+    GetTableLocationsResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(proxy_->GetTableLocations(req, &resp, &controller));
+    ASSERT_EQ(SecureDebugString(uncached_resp), SecureDebugString(resp));
+  }
+}
 
 } // namespace master
 } // namespace kudu
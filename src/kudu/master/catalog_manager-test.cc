@@ -18,6 +18,7 @@
 
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/catalog_manager.h"
+#include "kudu/master/master.pb.h"
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/util/test_util.h"
 
@@ -105,5 +106,36 @@ TEST(TestTSDescriptor, TestReplicaCreationsDecay) {
   }
 }
 
+TEST(TestTSDescriptor, TestReplicaPlacementScores) {
+  TSDescriptor a("a");
+  TSDescriptor b("b");
+  a.set_num_live_replicas(10);
+  b.set_num_live_replicas(20);
+
+  // Without reported resource usage, only the replicas count.
+  double score_a, score_b;
+  ComputeReplicaPlacementScores(&a, &b, &score_a, &score_b);
+  ASSERT_LT(score_a, score_b);
+
+  // 'a' hosts fewer replicas, but they are much busier, and its disks are
+  // nearly full.
+  TSLoadPB load_a;
+  load_a.add_data_dir_free_bytes(1L << 30);
+  load_a.set_rows_written_per_sec(100000);
+  load_a.set_memory_usage_ratio(0.9);
+  a.set_load(load_a);
+  TSLoadPB load_b;
+  load_b.add_data_dir_free_bytes(100L << 30);
+  load_b.set_rows_written_per_sec(1000);
+  load_b.set_memory_usage_ratio(0.2);
+  b.set_load(load_b);
+  ComputeReplicaPlacementScores(&a, &b, &score_a, &score_b);
+  ASSERT_GT(score_a, score_b);
+
+  TSLoadPB load;
+  ASSERT_TRUE(a.GetLoad(&load));
+  ASSERT_EQ(100000, load.rows_written_per_sec());
+}
+
 } // namespace master
 } // namespace kudu
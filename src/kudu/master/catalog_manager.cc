@@ -43,8 +43,10 @@
 
 #include <algorithm>
 #include <condition_variable>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <numeric>
 #include <set>
 #include <string>
 #include <utility>
@@ -75,6 +77,7 @@
 #include "kudu/gutil/walltime.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.pb.h"
+#include "kudu/master/rebalancer.h"
 #include "kudu/master/sys_catalog.h"
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/master/ts_manager.h"
@@ -193,10 +196,99 @@ DEFINE_bool(catalog_manager_delete_orphaned_tablets, false,
             "master failures!");
 TAG_FLAG(catalog_manager_delete_orphaned_tablets, advanced);
 
+DEFINE_bool(catalog_manager_cache_tablet_locations, false,
+            "Whether the locations of each tablet are cached, and reused by "
+            "GetTableLocations and GetTabletLocations until the tablet's Raft "
+            "configuration or leader, or the set of registered tablet servers, "
+            "changes.");
+TAG_FLAG(catalog_manager_cache_tablet_locations, experimental);
+TAG_FLAG(catalog_manager_cache_tablet_locations, runtime);
+
+DEFINE_bool(master_load_aware_placement, false,
+            "Whether new tablet replicas are placed according to a weighted score of "
+            "the resource usage reported by the tablet servers (replicas, rows "
+            "written and scanned, memory usage and free disk space) rather than "
+            "only their number of replicas. See the --replica_placement_*_weight "
+            "flags.");
+TAG_FLAG(master_load_aware_placement, experimental);
+TAG_FLAG(master_load_aware_placement, runtime);
+
+DEFINE_bool(master_enable_replica_rebalancing, false,
+            "Whether the leader master continuously moves tablet replicas and "
+            "leaders between the live tablet servers to even out their number "
+            "on each server, for each table and for all tables.");
+TAG_FLAG(master_enable_replica_rebalancing, experimental);
+TAG_FLAG(master_enable_replica_rebalancing, runtime);
+
+DEFINE_int32(master_replica_rebalancing_interval_ms, 10000,
+             "Interval at which the master looks for replicas and leaders to move "
+             "when --master_enable_replica_rebalancing is set.");
+TAG_FLAG(master_replica_rebalancing_interval_ms, experimental);
+TAG_FLAG(master_replica_rebalancing_interval_ms, runtime);
+
+DEFINE_int32(master_replica_rebalancing_max_moves, 4,
+             "Maximum number of replica moves started by the rebalancer which "
+             "may be in progress at once.");
+TAG_FLAG(master_replica_rebalancing_max_moves, experimental);
+TAG_FLAG(master_replica_rebalancing_max_moves, runtime);
+
+DEFINE_int32(master_replica_rebalancing_max_leader_step_downs, 8,
+             "Maximum number of leaders the rebalancer asks to step down at each "
+             "interval.");
+TAG_FLAG(master_replica_rebalancing_max_leader_step_downs, experimental);
+TAG_FLAG(master_replica_rebalancing_max_leader_step_downs, runtime);
+
+DEFINE_int32(master_replica_rebalancing_move_timeout_ms, 30 * 60 * 1000,
+             "Time after which the rebalancer abandons a replica move whose new "
+             "replica is not running yet, and removes the new replica.");
+TAG_FLAG(master_replica_rebalancing_move_timeout_ms, experimental);
+TAG_FLAG(master_replica_rebalancing_move_timeout_ms, runtime);
+
+DEFINE_bool(catalog_manager_batch_tablet_reports, false,
+            "Whether the changes to the tablets of a tablet report are written to the "
+            "system catalog in batches rather than one tablet at a time, and the "
+            "reported tablets whose metadata didn't change are not written at all. "
+            "This speeds up absorbing the full tablet reports sent to a new leader master.");
+TAG_FLAG(catalog_manager_batch_tablet_reports, experimental);
+TAG_FLAG(catalog_manager_batch_tablet_reports, runtime);
+
+DEFINE_int32(catalog_manager_tablet_report_batch_size, 256,
+             "Maximum number of tablets whose changes are written to the system "
+             "catalog at once when --catalog_manager_batch_tablet_reports is set.");
+TAG_FLAG(catalog_manager_tablet_report_batch_size, experimental);
+TAG_FLAG(catalog_manager_tablet_report_batch_size, runtime);
+
+DEFINE_int32(catalog_manager_load_threads, 1,
+             "Number of threads used to parse and load the tablets of the system "
+             "catalog into memory when the master becomes the leader.");
+TAG_FLAG(catalog_manager_load_threads, experimental);
+
+DEFINE_bool(master_batch_create_tablets, false,
+            "Whether the master creates the replicas of new tablets with one "
+            "CreateTablets() RPC per tablet server, rather than one CreateTablet() "
+            "RPC per replica. All tablet servers must support CreateTablets().");
+TAG_FLAG(master_batch_create_tablets, experimental);
+TAG_FLAG(master_batch_create_tablets, runtime);
+
+DEFINE_int32(master_create_tablets_batch_size, 500,
+             "Maximum number of replicas created by a CreateTablets() RPC when "
+             "--master_batch_create_tablets is set.");
+TAG_FLAG(master_create_tablets_batch_size, experimental);
+TAG_FLAG(master_create_tablets_batch_size, runtime);
+
+DEFINE_double(master_hot_tablet_rows_written_per_sec, 10000,
+              "The rate of written rows from which the master lists a tablet among "
+              "the hot tablets, along with the key at which splitting the tablet "
+              "would divide its writes in half. Based on the busiest tablets "
+              "reported per --heartbeat_max_reported_busy_tablets.");
+TAG_FLAG(master_hot_tablet_rows_written_per_sec, experimental);
+TAG_FLAG(master_hot_tablet_rows_written_per_sec, runtime);
+
 using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::unordered_map;
 using std::vector;
 
 namespace kudu {
@@ -292,7 +384,10 @@ class TabletLoader : public TabletVisitor {
     l.mutable_data()->pb.CopyFrom(metadata);
 
     // Add the tablet to the tablet manager.
-    catalog_manager_->tablet_map_[tablet->tablet_id()] = tablet;
+    {
+      std::lock_guard<simple_spinlock> map_lock(tablet_map_lock_);
+      catalog_manager_->tablet_map_[tablet->tablet_id()] = tablet;
+    }
 
     // Add the tablet to the Tablet.
     bool is_deleted = l.mutable_data()->is_deleted();
@@ -310,6 +405,10 @@ class TabletLoader : public TabletVisitor {
  private:
   CatalogManager *catalog_manager_;
 
+  // Protects the catalog manager's tablet map when tablets are loaded by
+  // several threads.
+  simple_spinlock tablet_map_lock_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletLoader);
 };
 
@@ -416,6 +515,10 @@ void CatalogManagerBgTasks::Run() {
                        << s.ToString();
           }
         }
+
+        if (FLAGS_master_enable_replica_rebalancing) {
+          catalog_manager_->RebalanceReplicas();
+        }
       }
     }
 
@@ -745,8 +848,17 @@ Status CatalogManager::VisitTablesAndTablets() {
   RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTables(&table_loader),
                         "Failed while visiting tables in sys catalog");
   TabletLoader tablet_loader(this);
-  RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader),
-                        "Failed while visiting tablets in sys catalog");
+  if (FLAGS_catalog_manager_load_threads > 1) {
+    gscoped_ptr<ThreadPool> pool;
+    RETURN_NOT_OK(ThreadPoolBuilder("catalog-load")
+                  .set_max_threads(FLAGS_catalog_manager_load_threads)
+                  .Build(&pool));
+    RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader, pool.get()),
+                          "Failed while visiting tablets in sys catalog");
+  } else {
+    RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader),
+                          "Failed while visiting tablets in sys catalog");
+  }
   return Status::OK();
 }
 
@@ -899,6 +1011,12 @@ Status ValidateClientSchema(const boost::optional<string>& name,
       return s.CloneAndPrepend(
           Substitute("invalid encoding for column '$0'", col.name()));
     }
+    // The secondary index is sorted by the key encoding of the values.
+    if (col.attributes().indexed && !IsTypeAllowableInKey(col.type_info())) {
+      return Status::InvalidArgument(
+          Substitute("column '$0' of type $1 may not be indexed",
+                     col.name(), col.type_info()->name()));
+    }
   }
   return Status::OK();
 }
@@ -1034,6 +1152,14 @@ Status CatalogManager::CreateTable(const CreateTableRequestPB* orig_req,
                                            FLAGS_max_num_replicas));
     return SetError(MasterErrorPB::ILLEGAL_REPLICATION_FACTOR, s);
   }
+  if (req.num_read_replicas() < 0 ||
+      req.num_replicas() + req.num_read_replicas() > FLAGS_max_num_replicas) {
+    s = Status::InvalidArgument(Substitute("illegal number of read replicas $0 (the total "
+                                           "number of replicas may be at most $1)",
+                                           req.num_read_replicas(),
+                                           FLAGS_max_num_replicas));
+    return SetError(MasterErrorPB::REPLICATION_FACTOR_TOO_HIGH, s);
+  }
 
   // Verify that the total number of tablets is reasonable, relative to the number
   // of live tablet servers.
@@ -1187,6 +1313,9 @@ TableInfo *CatalogManager::CreateTableInfo(const CreateTableRequestPB& req,
   metadata->set_version(0);
   metadata->set_next_column_id(ColumnId(schema.max_col_id() + 1));
   metadata->set_num_replicas(req.num_replicas());
+  if (req.num_read_replicas() > 0) {
+    metadata->set_num_read_replicas(req.num_read_replicas());
+  }
   // Use the Schema object passed in, since it has the column IDs already assigned,
   // whereas the user request PB does not.
   CHECK_OK(SchemaToPB(schema, metadata->mutable_schema()));
@@ -1588,6 +1717,14 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB* req,
       }
     }
   }
+  if (req->has_quota()) {
+    const TableQuotaPB& quota = req->quota();
+    if (quota.write_rows_per_sec() < 0 || quota.write_bytes_per_sec() < 0 ||
+        quota.scan_rows_per_sec() < 0 || quota.scan_bytes_per_sec() < 0) {
+      return Status::InvalidArgument("Table quotas must not be negative",
+                                     SecureShortDebugString(quota));
+    }
+  }
 
   // 2. Lookup the table, verify if it exists, and lock it for modification.
   TRACE("Looking up table");
@@ -1708,12 +1845,19 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB* req,
   // Set to true if metadata changes need to be applied to existing tablets.
   bool has_metadata_changes_for_existing_tablets =
     has_metadata_changes && table->num_tablets() > tablets_to_drop.size();
+  // Set to true if the quotas are replaced. They only reach the tablets
+  // through heartbeats, so they don't change the table's version.
+  bool has_quota_changes = req->has_quota();
 
   // Skip empty requests...
-  if (!has_metadata_changes && !has_partitioning_changes) {
+  if (!has_metadata_changes && !has_partitioning_changes && !has_quota_changes) {
     return Status::OK();
   }
 
+  if (has_quota_changes) {
+    l.mutable_data()->pb.mutable_quota()->CopyFrom(req->quota());
+  }
+
   // 7. Serialize the schema and increment the version number.
   if (has_metadata_changes_for_existing_tablets && !l.data().pb.has_fully_applied_schema()) {
     l.mutable_data()->pb.mutable_fully_applied_schema()->CopyFrom(l.data().pb.schema());
@@ -1739,7 +1883,7 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB* req,
   TRACE("Updating metadata on disk");
   string deletion_msg = "Partition dropped at " + LocalTimeAsString();
   SysCatalogTable::Actions actions;
-  if (!tablets_to_add.empty() || has_metadata_changes) {
+  if (!tablets_to_add.empty() || has_metadata_changes || has_quota_changes) {
     // If anything modified the table's persistent metadata, then sync it to the sys catalog.
     actions.table_to_update = table.get();
   }
@@ -1811,13 +1955,15 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB* req,
   // the tablet again.
   tablets_to_drop_committer.Commit();
 
-  if (!tablets_to_add.empty() || has_metadata_changes) {
+  if (!tablets_to_add.empty() || has_metadata_changes || has_quota_changes) {
     l.Commit();
   } else {
     l.Unlock();
   }
 
-  SendAlterTableRequest(table);
+  if (has_metadata_changes || has_partitioning_changes) {
+    SendAlterTableRequest(table);
+  }
   for (const auto& tablet : tablets_to_drop) {
     TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
     SendDeleteTabletRequest(tablet, l, deletion_msg);
@@ -1920,6 +2066,38 @@ Status CatalogManager::ListTables(const ListTablesRequestPB* req,
   return Status::OK();
 }
 
+Status CatalogManager::GetTabletQuotaShares(
+    google::protobuf::RepeatedPtrField<TSHeartbeatResponsePB::TabletQuotaSharePB>* shares) {
+  leader_lock_.AssertAcquiredForReading();
+  RETURN_NOT_OK(CheckOnline());
+
+  // Splits a limit among the tablets, leaving every tablet some share of it.
+  auto split = [](int64_t limit, int num_tablets) -> int64_t {
+    if (limit <= 0) return 0;
+    return std::max<int64_t>(1, limit / std::max(1, num_tablets));
+  };
+
+  shared_lock<LockType> l(lock_);
+  for (const TableInfoMap::value_type& entry : table_ids_map_) {
+    TableMetadataLock ltm(entry.second.get(), TableMetadataLock::READ);
+    if (!ltm.data().is_running() || !ltm.data().pb.has_quota()) continue;
+
+    const TableQuotaPB& quota = ltm.data().pb.quota();
+    int num_tablets = entry.second->num_tablets();
+    TSHeartbeatResponsePB::TabletQuotaSharePB* share = shares->Add();
+    share->set_table_id(entry.first);
+    share->mutable_share()->set_write_rows_per_sec(
+        split(quota.write_rows_per_sec(), num_tablets));
+    share->mutable_share()->set_write_bytes_per_sec(
+        split(quota.write_bytes_per_sec(), num_tablets));
+    share->mutable_share()->set_scan_rows_per_sec(
+        split(quota.scan_rows_per_sec(), num_tablets));
+    share->mutable_share()->set_scan_bytes_per_sec(
+        split(quota.scan_bytes_per_sec(), num_tablets));
+  }
+  return Status::OK();
+}
+
 Status CatalogManager::GetTableInfo(const string& table_id, scoped_refptr<TableInfo> *table) {
   leader_lock_.AssertAcquiredForReading();
   RETURN_NOT_OK(CheckOnline());
@@ -1942,6 +2120,62 @@ Status CatalogManager::GetAllTables(std::vector<scoped_refptr<TableInfo>>* table
   return Status::OK();
 }
 
+Status CatalogManager::GetHotTablets(vector<HotTabletInfo>* hot_tablets) {
+  leader_lock_.AssertAcquiredForReading();
+  RETURN_NOT_OK(CheckOnline());
+  hot_tablets->clear();
+
+  // Each replica applies all the writes to the tablet, so the busiest
+  // replica stands for the tablet, but the keys sampled by all of them are
+  // pooled together.
+  unordered_map<string, HotTabletInfo> tablets_by_id;
+  unordered_map<string, vector<string>> sampled_keys;
+  TSDescriptorVector descs;
+  master_->ts_manager()->GetAllLiveDescriptors(&descs);
+  for (const auto& desc : descs) {
+    TSLoadPB load;
+    if (!desc->GetLoad(&load)) {
+      continue;
+    }
+    for (TabletLoadPB& tablet_load : *load.mutable_busiest_tablets()) {
+      if (tablet_load.rows_written_per_sec() < FLAGS_master_hot_tablet_rows_written_per_sec) {
+        continue;
+      }
+      HotTabletInfo& info = tablets_by_id[tablet_load.tablet_id()];
+      info.rows_written_per_sec = std::max(info.rows_written_per_sec,
+                                           tablet_load.rows_written_per_sec());
+      info.rows_scanned_per_sec = std::max(info.rows_scanned_per_sec,
+                                           tablet_load.rows_scanned_per_sec());
+      vector<string>& keys = sampled_keys[tablet_load.tablet_id()];
+      for (string& key : *tablet_load.mutable_sampled_write_keys()) {
+        keys.emplace_back(std::move(key));
+      }
+    }
+  }
+
+  {
+    shared_lock<LockType> l(lock_);
+    for (auto& e : tablets_by_id) {
+      if (FindCopy(tablet_map_, e.first, &e.second.tablet)) {
+        hot_tablets->emplace_back(std::move(e.second));
+      }
+    }
+  }
+  for (HotTabletInfo& info : *hot_tablets) {
+    vector<string>& keys = FindOrDie(sampled_keys, info.tablet->tablet_id());
+    if (!keys.empty()) {
+      auto median = keys.begin() + keys.size() / 2;
+      std::nth_element(keys.begin(), median, keys.end());
+      info.split_key = std::move(*median);
+    }
+  }
+  std::sort(hot_tablets->begin(), hot_tablets->end(),
+            [](const HotTabletInfo& a, const HotTabletInfo& b) {
+              return a.rows_written_per_sec > b.rows_written_per_sec;
+            });
+  return Status::OK();
+}
+
 Status CatalogManager::TableNameExists(const string& table_name, bool* exists) {
   leader_lock_.AssertAcquiredForReading();
   RETURN_NOT_OK(CheckOnline());
@@ -1977,12 +2211,51 @@ Status CatalogManager::ProcessTabletReport(TSDescriptor* ts_desc,
   // the server should have, compare vs the ones being reported, and somehow mark
   // any that have been "lost" (eg somehow the tablet metadata got corrupted or something).
 
+  const int num_tablets = report.updated_tablets_size();
   for (const ReportedTabletPB& reported : report.updated_tablets()) {
-    ReportedTabletUpdatesPB *tablet_report = report_update->add_tablets();
-    tablet_report->set_tablet_id(reported.tablet_id());
-    RETURN_NOT_OK_PREPEND(HandleReportedTablet(ts_desc, reported, tablet_report),
-                          Substitute("Error handling $0", SecureShortDebugString(reported)));
+    report_update->add_tablets()->set_tablet_id(reported.tablet_id());
+  }
+
+  // When batching, the write locks of the changed tablets are held until the
+  // batch is persisted, so the tablets must be handled in tablet ID order.
+  vector<int> order(num_tablets);
+  std::iota(order.begin(), order.end(), 0);
+  size_t max_batch_size = 1;
+  if (FLAGS_catalog_manager_batch_tablet_reports) {
+    max_batch_size = std::max(FLAGS_catalog_manager_tablet_report_batch_size, 1);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return report.updated_tablets(a).tablet_id() < report.updated_tablets(b).tablet_id();
+      });
+  }
+
+  vector<ReportedTabletMutation> batch;
+  const string* prev_tablet_id = nullptr;
+  for (int idx : order) {
+    const ReportedTabletPB& reported = report.updated_tablets(idx);
+    if (prev_tablet_id && *prev_tablet_id == reported.tablet_id()) {
+      // The tablet may be locked by the batch already.
+      RETURN_NOT_OK(PersistReportedTablets(&batch));
+    }
+    prev_tablet_id = &reported.tablet_id();
+
+    ReportedTabletMutation mutation;
+    Status s = HandleReportedTablet(ts_desc, reported, report_update->mutable_tablets(idx),
+                                    &mutation);
+    if (!s.ok()) {
+      // Persist the changes made before the error, as if the tablets were
+      // handled one at a time.
+      RETURN_NOT_OK(PersistReportedTablets(&batch));
+      return s.CloneAndPrepend(Substitute("Error handling $0",
+                                          SecureShortDebugString(reported)));
+    }
+    if (mutation.tablet) {
+      batch.emplace_back(std::move(mutation));
+    }
+    if (batch.size() >= max_batch_size) {
+      RETURN_NOT_OK(PersistReportedTablets(&batch));
+    }
   }
+  RETURN_NOT_OK(PersistReportedTablets(&batch));
 
   if (report.updated_tablets_size() > 0) {
     background_tasks_->WakeIfHasPendingUpdates();
@@ -2011,7 +2284,8 @@ bool ShouldTransitionTabletToRunning(const ReportedTabletPB& report) {
 
 Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
                                             const ReportedTabletPB& report,
-                                            ReportedTabletUpdatesPB *report_updates) {
+                                            ReportedTabletUpdatesPB *report_updates,
+                                            ReportedTabletMutation* mutation) {
   TRACE_EVENT1("master", "HandleReportedTablet",
                "tablet_id", report.tablet_id());
   scoped_refptr<TabletInfo> tablet;
@@ -2043,17 +2317,27 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
 
   VLOG(3) << "tablet report: " << SecureShortDebugString(report);
 
+  if (report.state() == tablet::RUNNING) {
+    // The new replica of a tablet being moved may now replace the old one.
+    std::lock_guard<simple_spinlock> l(pending_replica_moves_lock_);
+    PendingReplicaMove* move = FindOrNull(pending_replica_moves_, report.tablet_id());
+    if (move && move->to_uuid == ts_desc->permanent_uuid()) {
+      move->to_running = true;
+    }
+  }
+
   // TODO: we don't actually need to do the COW here until we see we're going
   // to change the state. Can we change CowedObject to lazily do the copy?
   TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
-  TabletMetadataLock tablet_lock(tablet.get(), TabletMetadataLock::WRITE);
+  unique_ptr<TabletMetadataLock> tablet_lock(
+      new TabletMetadataLock(tablet.get(), TabletMetadataLock::WRITE));
 
   // If the TS is reporting a tablet which has been deleted, or a tablet from
   // a table which has been deleted, send it an RPC to delete it.
-  if (tablet_lock.data().is_deleted() ||
+  if (tablet_lock->data().is_deleted() ||
       table_lock.data().is_deleted()) {
-    report_updates->set_state_msg(tablet_lock.data().pb.state_msg());
-    const string msg = tablet_lock.data().pb.state_msg();
+    report_updates->set_state_msg(tablet_lock->data().pb.state_msg());
+    const string msg = tablet_lock->data().pb.state_msg();
     LOG(INFO) << "Got report from deleted tablet " << tablet->ToString()
               << " (" << msg << "): Sending delete request for this tablet";
     // TODO: Cancel tablet creation, instead of deleting, in cases where
@@ -2067,11 +2351,14 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
   if (!table_lock.data().is_running()) {
     LOG(INFO) << "Got report from tablet " << tablet->tablet_id()
               << " for non-running table " << tablet->table()->ToString() << ": "
-              << tablet_lock.data().pb.state_msg();
-    report_updates->set_state_msg(tablet_lock.data().pb.state_msg());
+              << tablet_lock->data().pb.state_msg();
+    report_updates->set_state_msg(tablet_lock->data().pb.state_msg());
     return Status::OK();
   }
 
+  // Whether the persistent metadata of the tablet was changed.
+  bool tablet_changed = false;
+
   // Check if the tablet requires an "alter table" call
   bool tablet_needs_alter = false;
   if (report.has_schema_version() &&
@@ -2108,7 +2395,7 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
   // The report will not have a committed_consensus_state if it is in the
   // middle of starting up, such as during tablet bootstrap.
   if (report.has_committed_consensus_state()) {
-    const ConsensusStatePB& prev_cstate = tablet_lock.data().pb.committed_consensus_state();
+    const ConsensusStatePB& prev_cstate = tablet_lock->data().pb.committed_consensus_state();
     ConsensusStatePB cstate = report.committed_consensus_state();
 
     // Check if we got a report from a tablet that is no longer part of the raft
@@ -2136,16 +2423,15 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
     // could incorrectly consider a tablet created when only a minority of its replicas
     // were successful. In that case, the tablet would be stuck in this bad state
     // forever.
-    if (!tablet_lock.data().is_running() && ShouldTransitionTabletToRunning(report)) {
-      DCHECK_EQ(SysTabletsEntryPB::CREATING, tablet_lock.data().pb.state())
+    if (!tablet_lock->data().is_running() && ShouldTransitionTabletToRunning(report)) {
+      DCHECK_EQ(SysTabletsEntryPB::CREATING, tablet_lock->data().pb.state())
           << "Tablet in unexpected state: " << tablet->ToString()
-          << ": " << SecureShortDebugString(tablet_lock.data().pb);
+          << ": " << SecureShortDebugString(tablet_lock->data().pb);
       // Mark the tablet as running
-      // TODO: we could batch the IO onto a background thread, or at least
-      // across multiple tablets in the same report.
       VLOG(1) << "Tablet " << tablet->ToString() << " is now online";
-      tablet_lock.mutable_data()->set_state(SysTabletsEntryPB::RUNNING,
-                                            "Tablet reported with an active leader");
+      tablet_lock->mutable_data()->set_state(SysTabletsEntryPB::RUNNING,
+                                             "Tablet reported with an active leader");
+      tablet_changed = true;
     }
 
     // The Master only accepts committed consensus configurations since it needs the committed index
@@ -2209,33 +2495,58 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
               << final_report->committed_consensus_state().current_term();
 
       RETURN_NOT_OK(HandleRaftConfigChanged(*final_report, tablet,
-                                            &tablet_lock, &table_lock));
+                                            tablet_lock.get(), &table_lock));
+      tablet_changed = true;
 
     }
   }
 
   table_lock.Unlock();
-  // We update the tablets each time that someone reports it.
-  // This shouldn't be very frequent and should only happen when something in fact changed.
-  SysCatalogTable::Actions actions;
-  actions.tablets_to_update.push_back(tablet.get());
-  Status s = sys_catalog_->Write(actions);
-  if (!s.ok()) {
-    LOG(WARNING) << "Error updating tablets: " << s.ToString() << ". Tablet report was: "
-                 << SecureShortDebugString(report);
-    return s;
+  // The tablet is persisted, and its lock committed, by the caller. Unless
+  // tablet reports are batched, the tablet is updated each time that someone
+  // reports it.
+  mutation->tablet = tablet;
+  mutation->report = &report;
+  mutation->needs_alter = tablet_needs_alter;
+  if (tablet_changed || !FLAGS_catalog_manager_batch_tablet_reports) {
+    mutation->tablet_lock = std::move(tablet_lock);
   }
-  tablet_lock.Commit();
+  return Status::OK();
+}
 
-  // Need to defer the AlterTable command to after we've committed the new tablet data,
-  // since the tablet report may also be updating the raft config, and the Alter Table
-  // request needs to know who the most recent leader is.
-  if (tablet_needs_alter) {
-    SendAlterTabletRequest(tablet);
-  } else if (report.has_schema_version()) {
-    HandleTabletSchemaVersionReport(tablet.get(), report.schema_version());
+Status CatalogManager::PersistReportedTablets(vector<ReportedTabletMutation>* batch) {
+  SysCatalogTable::Actions actions;
+  for (const auto& mutation : *batch) {
+    if (mutation.tablet_lock) {
+      actions.tablets_to_update.push_back(mutation.tablet.get());
+    }
+  }
+  if (!actions.tablets_to_update.empty()) {
+    Status s = sys_catalog_->Write(actions);
+    if (!s.ok()) {
+      LOG(WARNING) << "Error updating " << actions.tablets_to_update.size() << " tablets: "
+                   << s.ToString() << ". First tablet report was: "
+                   << SecureShortDebugString(*batch->front().report);
+      batch->clear();
+      return s;
+    }
   }
 
+  for (auto& mutation : *batch) {
+    if (mutation.tablet_lock) {
+      mutation.tablet_lock->Commit();
+    }
+
+    // Need to defer the AlterTable command to after we've committed the new tablet data,
+    // since the tablet report may also be updating the raft config, and the Alter Table
+    // request needs to know who the most recent leader is.
+    if (mutation.needs_alter) {
+      SendAlterTabletRequest(mutation.tablet);
+    } else if (mutation.report->has_schema_version()) {
+      HandleTabletSchemaVersionReport(mutation.tablet.get(), mutation.report->schema_version());
+    }
+  }
+  batch->clear();
   return Status::OK();
 }
 
@@ -2268,9 +2579,16 @@ Status CatalogManager::HandleRaftConfigChanged(
   }
 
   // If the config is under-replicated, add a server to the config.
+  // Otherwise, add the missing read replicas, if the config has a leader to
+  // add them.
+  const int num_voters = CountVoters(cstate.config());
   if (FLAGS_master_add_server_when_underreplicated &&
-      CountVoters(cstate.config()) < table_lock->data().pb.num_replicas()) {
-    SendAddServerRequest(tablet, cstate);
+      num_voters < table_lock->data().pb.num_replicas()) {
+    SendAddServerRequest(tablet, cstate, "");
+  } else if (cstate.has_leader_uuid() &&
+             cstate.config().peers_size() - num_voters <
+                 table_lock->data().pb.num_read_replicas()) {
+    SendAddServerRequest(tablet, cstate, "", RaftPeerPB::NON_VOTER);
   }
 
   return Status::OK();
@@ -2611,6 +2929,27 @@ class RetrySpecificTSRpcTask : public RetryingTSRpcTask {
   const string permanent_uuid_;
 };
 
+// Fills 'req' with the request to create the replica of 'tablet' on the
+// tablet server 'permanent_uuid'.
+//
+// The tablet lock must be acquired for reading before making this call.
+static void FillCreateTabletRequest(const string& permanent_uuid,
+                                    const scoped_refptr<TabletInfo>& tablet,
+                                    const TabletMetadataLock& tablet_lock,
+                                    tserver::CreateTabletRequestPB* req) {
+  TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
+  req->set_dest_uuid(permanent_uuid);
+  req->set_table_id(tablet->table()->id());
+  req->set_tablet_id(tablet->tablet_id());
+  req->mutable_partition()->CopyFrom(tablet_lock.data().pb.partition());
+  req->set_table_name(table_lock.data().pb.name());
+  req->mutable_schema()->CopyFrom(table_lock.data().pb.schema());
+  req->mutable_partition_schema()->CopyFrom(
+      table_lock.data().pb.partition_schema());
+  req->mutable_config()->CopyFrom(
+      tablet_lock.data().pb.committed_consensus_state().config());
+}
+
 // Fire off the async create tablet.
 // This requires that the new tablet info is locked for write, and the
 // consensus configuration information has been filled into the 'dirty' data.
@@ -2625,18 +2964,7 @@ class AsyncCreateReplica : public RetrySpecificTSRpcTask {
     : RetrySpecificTSRpcTask(master, permanent_uuid, tablet->table()),
       tablet_id_(tablet->tablet_id()) {
     deadline_ = start_ts_ + MonoDelta::FromMilliseconds(FLAGS_tablet_creation_timeout_ms);
-
-    TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
-    req_.set_dest_uuid(permanent_uuid);
-    req_.set_table_id(tablet->table()->id());
-    req_.set_tablet_id(tablet->tablet_id());
-    req_.mutable_partition()->CopyFrom(tablet_lock.data().pb.partition());
-    req_.set_table_name(table_lock.data().pb.name());
-    req_.mutable_schema()->CopyFrom(table_lock.data().pb.schema());
-    req_.mutable_partition_schema()->CopyFrom(
-        table_lock.data().pb.partition_schema());
-    req_.mutable_config()->CopyFrom(
-        tablet_lock.data().pb.committed_consensus_state().config());
+    FillCreateTabletRequest(permanent_uuid, tablet, tablet_lock, &req_);
   }
 
   virtual string type_name() const OVERRIDE { return "Create Tablet"; }
@@ -2681,6 +3009,90 @@ class AsyncCreateReplica : public RetrySpecificTSRpcTask {
   tserver::CreateTabletResponsePB resp_;
 };
 
+// Send a CreateTablets() RPC request, creating the replicas of several
+// tablets of a table on one tablet server. Only the replicas which failed to
+// be created are part of the retries of the request.
+class AsyncCreateReplicas : public RetrySpecificTSRpcTask {
+ public:
+  // 'req' holds the requests to create each replica.
+  AsyncCreateReplicas(Master *master,
+                      const string& permanent_uuid,
+                      const scoped_refptr<TableInfo>& table,
+                      tserver::CreateTabletsRequestPB req)
+    : RetrySpecificTSRpcTask(master, permanent_uuid, table),
+      req_(std::move(req)) {
+    deadline_ = start_ts_ + MonoDelta::FromMilliseconds(FLAGS_tablet_creation_timeout_ms);
+    req_.set_dest_uuid(permanent_uuid);
+  }
+
+  virtual string type_name() const OVERRIDE { return "Create Tablets"; }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("CreateTablets RPC for $0 tablets on TS $1",
+                      req_.tablets_size(), permanent_uuid_);
+  }
+
+ protected:
+  virtual string tablet_id() const OVERRIDE {
+    if (req_.tablets_size() == 0) {
+      return "";
+    }
+    return Substitute("$0 (and $1 others)", req_.tablets(0).tablet_id(),
+                      req_.tablets_size() - 1);
+  }
+
+  virtual void HandleResponse(int attempt) OVERRIDE {
+    if (resp_.has_error()) {
+      LOG(WARNING) << "CreateTablets RPC on TS " << target_ts_desc_->ToString()
+                   << " failed: " << StatusFromPB(resp_.error().status()).ToString();
+      return;
+    }
+    if (resp_.tablets_size() != req_.tablets_size()) {
+      LOG(WARNING) << "CreateTablets RPC on TS " << target_ts_desc_->ToString()
+                   << " returned " << resp_.tablets_size() << " results for "
+                   << req_.tablets_size() << " tablets";
+      return;
+    }
+
+    google::protobuf::RepeatedPtrField<tserver::CreateTabletRequestPB> failed;
+    for (int i = 0; i < req_.tablets_size(); i++) {
+      const tserver::CreateTabletResponsePB& tablet_resp = resp_.tablets(i);
+      if (!tablet_resp.has_error()) {
+        continue;
+      }
+      const string& tablet_id = req_.tablets(i).tablet_id();
+      Status s = StatusFromPB(tablet_resp.error().status());
+      if (s.IsAlreadyPresent()) {
+        LOG(INFO) << "CreateTablet RPC for tablet " << tablet_id
+                  << " on TS " << target_ts_desc_->ToString() << " returned already present: "
+                  << s.ToString();
+        continue;
+      }
+      LOG(WARNING) << "CreateTablet RPC for tablet " << tablet_id
+                   << " on TS " << target_ts_desc_->ToString() << " failed: " << s.ToString();
+      failed.Add()->Swap(req_.mutable_tablets(i));
+    }
+    req_.mutable_tablets()->Swap(&failed);
+    if (req_.tablets_size() == 0) {
+      MarkComplete();
+    }
+  }
+
+  virtual bool SendRequest(int attempt) OVERRIDE {
+    VLOG(1) << "Send create tablets request to "
+            << target_ts_desc_->ToString() << ":\n"
+            << " (attempt " << attempt << "):\n"
+            << SecureDebugString(req_);
+    ts_proxy_->CreateTabletsAsync(req_, &resp_, &rpc_,
+                                  boost::bind(&AsyncCreateReplicas::RpcCallback, this));
+    return true;
+  }
+
+ private:
+  tserver::CreateTabletsRequestPB req_;
+  tserver::CreateTabletsResponsePB resp_;
+};
+
 // Send a DeleteTablet() RPC request.
 class AsyncDeleteReplica : public RetrySpecificTSRpcTask {
  public:
@@ -2884,12 +3296,16 @@ class AsyncAddServerTask : public RetryingTSRpcTask {
  public:
   AsyncAddServerTask(Master *master,
                      const scoped_refptr<TabletInfo>& tablet,
-                     const ConsensusStatePB& cstate)
+                     const ConsensusStatePB& cstate,
+                     string replacement_uuid,
+                     RaftPeerPB::MemberType member_type)
     : RetryingTSRpcTask(master,
                         gscoped_ptr<TSPicker>(new PickLeaderReplica(tablet)),
                         tablet->table()),
       tablet_(tablet),
-      cstate_(cstate) {
+      cstate_(cstate),
+      replacement_uuid_(std::move(replacement_uuid)),
+      member_type_(member_type) {
     deadline_ = MonoTime::Max(); // Never time out.
   }
 
@@ -2913,6 +3329,12 @@ class AsyncAddServerTask : public RetryingTSRpcTask {
   const scoped_refptr<TabletInfo> tablet_;
   const ConsensusStatePB cstate_;
 
+  // The server to add the replica on, or empty to pick a random one.
+  const string replacement_uuid_;
+
+  // Whether to add a voter or a read replica.
+  const RaftPeerPB::MemberType member_type_;
+
   consensus::ChangeConfigRequestPB req_;
   consensus::ChangeConfigResponsePB resp_;
 };
@@ -2938,13 +3360,24 @@ bool AsyncAddServerTask::SendRequest(int attempt) {
   for (const RaftPeerPB& peer : cstate_.config().peers()) {
     InsertOrDie(&replica_uuids, peer.permanent_uuid());
   }
-  TSDescriptorVector ts_descs;
-  master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
   shared_ptr<TSDescriptor> replacement_replica;
-  if (PREDICT_FALSE(!SelectRandomTSForReplica(ts_descs, replica_uuids, &replacement_replica))) {
-    KLOG_EVERY_N(WARNING, 100) << LogPrefix() << "No candidate replacement replica found "
-                               << "for tablet " << tablet_->ToString();
-    return false;
+  if (!replacement_uuid_.empty()) {
+    if (ContainsKey(replica_uuids, replacement_uuid_) ||
+        !master_->ts_manager()->LookupTSByUUID(replacement_uuid_, &replacement_replica)) {
+      LOG_WITH_PREFIX(WARNING) << "Cannot add a replica of tablet " << tablet_->ToString()
+                               << " on TS " << replacement_uuid_ << ". Aborting task.";
+      MarkAborted();
+      return false;
+    }
+  } else {
+    TSDescriptorVector ts_descs;
+    master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
+    if (PREDICT_FALSE(!SelectRandomTSForReplica(ts_descs, replica_uuids,
+                                                &replacement_replica))) {
+      KLOG_EVERY_N(WARNING, 100) << LogPrefix() << "No candidate replacement replica found "
+                                 << "for tablet " << tablet_->ToString();
+      return false;
+    }
   }
 
   req_.set_dest_uuid(target_ts_desc_->permanent_uuid());
@@ -2957,7 +3390,7 @@ bool AsyncAddServerTask::SendRequest(int attempt) {
   replacement_replica->GetRegistration(&peer_reg);
   CHECK_GT(peer_reg.rpc_addresses_size(), 0);
   *peer->mutable_last_known_addr() = peer_reg.rpc_addresses(0);
-  peer->set_member_type(RaftPeerPB::VOTER);
+  peer->set_member_type(member_type_);
   VLOG(1) << "Sending AddServer ChangeConfig request to "
           << target_ts_desc_->ToString() << ":\n"
           << SecureDebugString(req_);
@@ -2995,6 +3428,125 @@ void AsyncAddServerTask::HandleResponse(int attempt) {
   }
 }
 
+// Removes the voter on a given server from the config of a tablet, after its
+// replica was moved to another server. The leader can't be removed: it must
+// step down first.
+class AsyncRemoveServerTask : public RetryingTSRpcTask {
+ public:
+  AsyncRemoveServerTask(Master *master,
+                        const scoped_refptr<TabletInfo>& tablet,
+                        const ConsensusStatePB& cstate,
+                        string ts_uuid)
+    : RetryingTSRpcTask(master,
+                        gscoped_ptr<TSPicker>(new PickLeaderReplica(tablet)),
+                        tablet->table()),
+      tablet_(tablet),
+      cstate_(cstate),
+      ts_uuid_(std::move(ts_uuid)) {
+  }
+
+  virtual string type_name() const OVERRIDE { return "RemoveServer ChangeConfig"; }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("RemoveServer ChangeConfig RPC for tablet $0 on TS $1 "
+                      "removing TS $2 with cas_config_opid_index $3",
+                      tablet_->tablet_id(),
+                      target_ts_desc_->ToString(),
+                      ts_uuid_,
+                      cstate_.config().opid_index());
+  }
+
+ protected:
+  virtual bool SendRequest(int attempt) OVERRIDE {
+    req_.set_dest_uuid(target_ts_desc_->permanent_uuid());
+    req_.set_tablet_id(tablet_->tablet_id());
+    req_.set_type(consensus::REMOVE_SERVER);
+    req_.set_cas_config_opid_index(cstate_.config().opid_index());
+    req_.mutable_server()->set_permanent_uuid(ts_uuid_);
+    VLOG(1) << "Sending RemoveServer ChangeConfig request to "
+            << target_ts_desc_->ToString() << ":\n"
+            << SecureDebugString(req_);
+    consensus_proxy_->ChangeConfigAsync(req_, &resp_, &rpc_,
+                                        boost::bind(&AsyncRemoveServerTask::RpcCallback, this));
+    return true;
+  }
+
+  virtual void HandleResponse(int attempt) OVERRIDE {
+    if (!resp_.has_error()) {
+      MarkComplete();
+      LOG_WITH_PREFIX(INFO) << "Change config succeeded";
+      return;
+    }
+    // The config or leader changed since the task was started: the caller
+    // will try again with the new config.
+    LOG_WITH_PREFIX(WARNING) << "ChangeConfig() failed with leader "
+                             << target_ts_desc_->ToString() << " due to error "
+                             << TabletServerErrorPB::Code_Name(resp_.error().code())
+                             << ". No further retry: "
+                             << StatusFromPB(resp_.error().status()).ToString();
+    MarkFailed();
+  }
+
+ private:
+  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
+
+  const scoped_refptr<TabletInfo> tablet_;
+  const ConsensusStatePB cstate_;
+  const string ts_uuid_;
+
+  consensus::ChangeConfigRequestPB req_;
+  consensus::ChangeConfigResponsePB resp_;
+};
+
+// Asks the leader replica of a tablet to step down, so that another replica
+// is elected leader.
+class AsyncLeaderStepDownTask : public RetrySpecificTSRpcTask {
+ public:
+  AsyncLeaderStepDownTask(Master* master,
+                          const scoped_refptr<TabletInfo>& tablet,
+                          const string& leader_uuid)
+    : RetrySpecificTSRpcTask(master, leader_uuid, tablet->table()),
+      tablet_(tablet) {
+  }
+
+  virtual string type_name() const OVERRIDE { return "LeaderStepDown"; }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("LeaderStepDown RPC for tablet $0 on TS $1",
+                      tablet_->tablet_id(), permanent_uuid_);
+  }
+
+ protected:
+  virtual bool SendRequest(int attempt) OVERRIDE {
+    consensus::LeaderStepDownRequestPB req;
+    req.set_dest_uuid(permanent_uuid_);
+    req.set_tablet_id(tablet_->tablet_id());
+    consensus_proxy_->LeaderStepDownAsync(req, &resp_, &rpc_,
+                                          boost::bind(&AsyncLeaderStepDownTask::RpcCallback,
+                                                      this));
+    return true;
+  }
+
+  virtual void HandleResponse(int attempt) OVERRIDE {
+    if (resp_.has_error()) {
+      // Most likely the replica is no longer the leader.
+      LOG_WITH_PREFIX(WARNING) << "LeaderStepDown() failed with error "
+                               << TabletServerErrorPB::Code_Name(resp_.error().code())
+                               << ". No further retry: "
+                               << StatusFromPB(resp_.error().status()).ToString();
+      MarkFailed();
+      return;
+    }
+    MarkComplete();
+  }
+
+ private:
+  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
+
+  const scoped_refptr<TabletInfo> tablet_;
+  consensus::LeaderStepDownResponsePB resp_;
+};
+
 void CatalogManager::SendAlterTableRequest(const scoped_refptr<TableInfo>& table) {
   vector<scoped_refptr<TabletInfo> > tablets;
   table->GetAllTablets(&tablets);
@@ -3064,8 +3616,10 @@ void CatalogManager::SendDeleteReplicaRequest(
 }
 
 void CatalogManager::SendAddServerRequest(const scoped_refptr<TabletInfo>& tablet,
-                                          const ConsensusStatePB& cstate) {
-  auto task = new AsyncAddServerTask(master_, tablet, cstate);
+                                          const ConsensusStatePB& cstate,
+                                          const string& replacement_uuid,
+                                          RaftPeerPB::MemberType member_type) {
+  auto task = new AsyncAddServerTask(master_, tablet, cstate, replacement_uuid, member_type);
   tablet->table()->AddTask(task);
   WARN_NOT_OK(task->Run(), "Failed to send new AddServer request");
 
@@ -3074,6 +3628,198 @@ void CatalogManager::SendAddServerRequest(const scoped_refptr<TabletInfo>& table
   LOG(INFO) << "Started AddServer task for tablet " << tablet->tablet_id();
 }
 
+void CatalogManager::SendRemoveServerRequest(const scoped_refptr<TabletInfo>& tablet,
+                                             const ConsensusStatePB& cstate,
+                                             const string& ts_uuid) {
+  auto task = new AsyncRemoveServerTask(master_, tablet, cstate, ts_uuid);
+  tablet->table()->AddTask(task);
+  WARN_NOT_OK(task->Run(), "Failed to send new RemoveServer request");
+  LOG(INFO) << "Started RemoveServer task for tablet " << tablet->tablet_id();
+}
+
+void CatalogManager::SendLeaderStepDownRequest(const scoped_refptr<TabletInfo>& tablet,
+                                               const string& leader_uuid) {
+  auto task = new AsyncLeaderStepDownTask(master_, tablet, leader_uuid);
+  tablet->table()->AddTask(task);
+  WARN_NOT_OK(task->Run(), "Failed to send LeaderStepDown request");
+}
+
+void CatalogManager::RebalanceReplicas() {
+  MonoTime now = MonoTime::Now();
+  if (last_rebalance_time_.Initialized() &&
+      now - last_rebalance_time_ <
+      MonoDelta::FromMilliseconds(FLAGS_master_replica_rebalancing_interval_ms)) {
+    return;
+  }
+  last_rebalance_time_ = now;
+
+  TSDescriptorVector ts_descs;
+  master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
+  vector<string> ts_uuids;
+  for (const auto& ts_desc : ts_descs) {
+    ts_uuids.push_back(ts_desc->permanent_uuid());
+  }
+
+  vector<scoped_refptr<TableInfo>> tables;
+  {
+    shared_lock<LockType> l(lock_);
+    AppendValuesFromMap(table_ids_map_, &tables);
+  }
+
+  // Take a snapshot of the voters and leader of each running tablet.
+  vector<TabletReplicas> snapshot;
+  unordered_map<string, scoped_refptr<TabletInfo>> tablets_by_id;
+  for (const auto& table : tables) {
+    int num_replicas;
+    int num_read_replicas;
+    {
+      TableMetadataLock l(table.get(), TableMetadataLock::READ);
+      if (!l.data().is_running()) {
+        continue;
+      }
+      num_replicas = l.data().pb.num_replicas();
+      num_read_replicas = l.data().pb.num_read_replicas();
+    }
+    vector<scoped_refptr<TabletInfo>> tablets;
+    table->GetAllTablets(&tablets);
+    for (const auto& tablet : tablets) {
+      TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+      if (!l.data().is_running() || !l.data().pb.has_committed_consensus_state()) {
+        continue;
+      }
+      const ConsensusStatePB& cstate = l.data().pb.committed_consensus_state();
+      TabletReplicas replicas;
+      replicas.tablet_id = tablet->tablet_id();
+      replicas.table_id = table->id();
+      for (const RaftPeerPB& peer : cstate.config().peers()) {
+        if (peer.member_type() == RaftPeerPB::VOTER) {
+          replicas.replica_uuids.push_back(peer.permanent_uuid());
+        }
+      }
+      if (cstate.has_leader_uuid()) {
+        replicas.leader_uuid = cstate.leader_uuid();
+      }
+      // Tablets whose config isn't made of exactly the expected replicas are
+      // being re-replicated or moved already.
+      replicas.movable = cstate.config().peers_size() == num_replicas + num_read_replicas &&
+          CountVoters(cstate.config()) == num_replicas;
+      snapshot.emplace_back(std::move(replicas));
+      tablets_by_id.emplace(tablet->tablet_id(), tablet);
+    }
+  }
+
+  AdvanceReplicaMoves(tablets_by_id);
+
+  // Count the replicas being moved as if they had been moved already.
+  int num_pending_moves;
+  {
+    std::lock_guard<simple_spinlock> l(pending_replica_moves_lock_);
+    num_pending_moves = pending_replica_moves_.size();
+    for (TabletReplicas& replicas : snapshot) {
+      const PendingReplicaMove* move = FindOrNull(pending_replica_moves_, replicas.tablet_id);
+      if (!move) {
+        continue;
+      }
+      vector<string>& uuids = replicas.replica_uuids;
+      uuids.erase(std::remove(uuids.begin(), uuids.end(), move->from_uuid), uuids.end());
+      if (std::find(uuids.begin(), uuids.end(), move->to_uuid) == uuids.end()) {
+        uuids.push_back(move->to_uuid);
+      }
+      replicas.movable = false;
+    }
+  }
+
+  ReplicaRebalancer rebalancer(ts_uuids, std::move(snapshot));
+  vector<ReplicaMove> moves;
+  rebalancer.PlanReplicaMoves(FLAGS_master_replica_rebalancing_max_moves - num_pending_moves,
+                              &moves);
+  vector<string> step_downs;
+  rebalancer.PlanLeaderStepDowns(FLAGS_master_replica_rebalancing_max_leader_step_downs,
+                                 &step_downs);
+
+  for (const ReplicaMove& move : moves) {
+    const scoped_refptr<TabletInfo>& tablet = FindOrDie(tablets_by_id, move.tablet_id);
+    LOG(INFO) << Substitute("Moving replica of tablet $0 from TS $1 to TS $2",
+                            move.tablet_id, move.from_uuid, move.to_uuid);
+    {
+      std::lock_guard<simple_spinlock> l(pending_replica_moves_lock_);
+      InsertOrDie(&pending_replica_moves_, move.tablet_id,
+                  PendingReplicaMove{ move.from_uuid, move.to_uuid, false, now });
+    }
+    ConsensusStatePB cstate;
+    {
+      TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+      cstate = l.data().pb.committed_consensus_state();
+    }
+    SendAddServerRequest(tablet, cstate, move.to_uuid);
+  }
+
+  for (const string& tablet_id : step_downs) {
+    const scoped_refptr<TabletInfo>& tablet = FindOrDie(tablets_by_id, tablet_id);
+    string leader_uuid;
+    {
+      TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+      leader_uuid = l.data().pb.committed_consensus_state().leader_uuid();
+    }
+    LOG(INFO) << Substitute("Moving leadership of tablet $0 away from TS $1",
+                            tablet_id, leader_uuid);
+    SendLeaderStepDownRequest(tablet, leader_uuid);
+  }
+}
+
+void CatalogManager::AdvanceReplicaMoves(
+    const unordered_map<string, scoped_refptr<TabletInfo>>& tablets) {
+  vector<pair<string, PendingReplicaMove>> moves;
+  {
+    std::lock_guard<simple_spinlock> l(pending_replica_moves_lock_);
+    moves.assign(pending_replica_moves_.begin(), pending_replica_moves_.end());
+  }
+
+  const MonoTime now = MonoTime::Now();
+  const MonoDelta timeout =
+      MonoDelta::FromMilliseconds(FLAGS_master_replica_rebalancing_move_timeout_ms);
+  for (const auto& e : moves) {
+    const string& tablet_id = e.first;
+    const PendingReplicaMove& move = e.second;
+    const scoped_refptr<TabletInfo>* tablet = FindOrNull(tablets, tablet_id);
+    bool done = true;
+    if (tablet) {
+      ConsensusStatePB cstate;
+      {
+        TabletMetadataLock l(tablet->get(), TabletMetadataLock::READ);
+        cstate = l.data().pb.committed_consensus_state();
+      }
+      const bool has_from = consensus::IsRaftConfigMember(move.from_uuid, cstate.config());
+      const bool has_to = consensus::IsRaftConfigMember(move.to_uuid, cstate.config());
+      if (!has_from) {
+        LOG(INFO) << Substitute("Moved replica of tablet $0 from TS $1 to TS $2",
+                                tablet_id, move.from_uuid, move.to_uuid);
+      } else if (has_to && move.to_running) {
+        // Only a follower can be removed from the config.
+        if (cstate.leader_uuid() == move.from_uuid) {
+          SendLeaderStepDownRequest(*tablet, move.from_uuid);
+        } else if (cstate.has_leader_uuid()) {
+          SendRemoveServerRequest(*tablet, cstate, move.from_uuid);
+        }
+        done = false;
+      } else if (now - move.start_time > timeout) {
+        LOG(WARNING) << Substitute("Abandoning move of replica of tablet $0 from TS $1 "
+                                   "to TS $2: the new replica is not running",
+                                   tablet_id, move.from_uuid, move.to_uuid);
+        if (has_to && cstate.leader_uuid() != move.to_uuid) {
+          SendRemoveServerRequest(*tablet, cstate, move.to_uuid);
+        }
+      } else {
+        done = false;
+      }
+    }
+    if (done) {
+      std::lock_guard<simple_spinlock> l(pending_replica_moves_lock_);
+      pending_replica_moves_.erase(tablet_id);
+    }
+  }
+}
+
 void CatalogManager::ExtractTabletsToProcess(
     vector<scoped_refptr<TabletInfo>>* tablets_to_process) {
 
@@ -3313,9 +4059,13 @@ Status CatalogManager::ProcessPendingAssignments(
     }
   }
   // Send the CreateTablet() requests to the servers. This is asynchronous / non-blocking.
-  for (TabletInfo* tablet : deferred.needs_create_rpc) {
-    TabletMetadataLock l(tablet, TabletMetadataLock::READ);
-    SendCreateTabletRequest(tablet, l);
+  if (FLAGS_master_batch_create_tablets) {
+    SendCreateTabletsRequests(deferred.needs_create_rpc);
+  } else {
+    for (TabletInfo* tablet : deferred.needs_create_rpc) {
+      TabletMetadataLock l(tablet, TabletMetadataLock::READ);
+      SendCreateTabletRequest(tablet, l);
+    }
   }
   return Status::OK();
 }
@@ -3371,6 +4121,39 @@ void CatalogManager::SendCreateTabletRequest(const scoped_refptr<TabletInfo>& ta
   }
 }
 
+void CatalogManager::SendCreateTabletsRequests(const vector<TabletInfo*>& tablets) {
+  // Tasks are tracked by table, so the replicas are grouped by table as well
+  // as by tablet server.
+  std::map<pair<TableInfo*, string>, vector<tserver::CreateTabletRequestPB>> requests;
+  for (TabletInfo* tablet : tablets) {
+    TabletMetadataLock l(tablet, TabletMetadataLock::READ);
+    tablet->set_last_create_tablet_time(MonoTime::Now());
+    for (const RaftPeerPB& peer : l.data().pb.committed_consensus_state().config().peers()) {
+      auto& server_requests = requests[{ tablet->table().get(), peer.permanent_uuid() }];
+      server_requests.emplace_back();
+      FillCreateTabletRequest(peer.permanent_uuid(), tablet, l, &server_requests.back());
+    }
+  }
+
+  const int batch_size = std::max(1, FLAGS_master_create_tablets_batch_size);
+  for (auto& e : requests) {
+    scoped_refptr<TableInfo> table(e.first.first);
+    const string& ts_uuid = e.first.second;
+    vector<tserver::CreateTabletRequestPB>& server_requests = e.second;
+    for (int start = 0; start < server_requests.size(); start += batch_size) {
+      tserver::CreateTabletsRequestPB req;
+      int end = std::min<int>(start + batch_size, server_requests.size());
+      for (int i = start; i < end; i++) {
+        req.add_tablets()->Swap(&server_requests[i]);
+      }
+      AsyncCreateReplicas* task = new AsyncCreateReplicas(master_, ts_uuid, table,
+                                                          std::move(req));
+      table->AddTask(task);
+      WARN_NOT_OK(task->Run(), "Failed to send new tablets request");
+    }
+  }
+}
+
 shared_ptr<TSDescriptor> CatalogManager::PickBetterReplicaLocation(
     const TSDescriptorVector& two_choices) {
   DCHECK_EQ(two_choices.size(), 2);
@@ -3392,10 +4175,17 @@ shared_ptr<TSDescriptor> CatalogManager::PickBetterReplicaLocation(
   // we batch the selection process before sending any creation commands to the
   // servers themselves.
   //
-  // TODO: in the future we may want to factor in other items such as available disk space,
-  // actual request load, etc.
-  double load_a = a->RecentReplicaCreations() + a->num_live_replicas();
-  double load_b = b->RecentReplicaCreations() + b->num_live_replicas();
+  // With --master_load_aware_placement, the resource usage reported by the
+  // servers (request rates, memory usage and free disk space) is weighed in
+  // as well, so that skewed tables don't pile new replicas onto hot or
+  // nearly-full servers which happen to host few replicas.
+  double load_a, load_b;
+  if (FLAGS_master_load_aware_placement) {
+    ComputeReplicaPlacementScores(a.get(), b.get(), &load_a, &load_b);
+  } else {
+    load_a = a->RecentReplicaCreations() + a->num_live_replicas();
+    load_b = b->RecentReplicaCreations() + b->num_live_replicas();
+  }
   if (load_a < load_b) {
     return a;
   } else if (load_b < load_a) {
@@ -3497,6 +4287,26 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
   DCHECK(l_tablet.data().pb.has_committed_consensus_state());
 
   const ConsensusStatePB& cstate = l_tablet.data().pb.committed_consensus_state();
+
+  // The locations only depend on the tablet's Raft configuration and leader,
+  // and on the registrations of the tablet servers. The registration epoch is
+  // read before building the locations, so that the locations built while a
+  // tablet server registers are not reused afterwards.
+  const bool use_cache = FLAGS_catalog_manager_cache_tablet_locations;
+  int64_t ts_registration_epoch = 0;
+  if (use_cache) {
+    ts_registration_epoch = master_->ts_manager()->registration_epoch();
+    shared_ptr<const TabletInfo::CachedLocations> cached = tablet->cached_locations();
+    if (cached &&
+        cached->config_opid_index == cstate.config().opid_index() &&
+        cached->current_term == cstate.current_term() &&
+        cached->leader_uuid == cstate.leader_uuid() &&
+        cached->ts_registration_epoch == ts_registration_epoch) {
+      *locs_pb = cached->locations;
+      return Status::OK();
+    }
+  }
+
   for (const consensus::RaftPeerPB& peer : cstate.config().peers()) {
     // TODO: GetConsensusRole() iterates over all of the peers, making this an
     // O(n^2) loop. If replication counts get high, it should be optimized.
@@ -3526,6 +4336,16 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
   // No longer used; always set to false.
   locs_pb->set_deprecated_stale(false);
 
+  if (use_cache) {
+    shared_ptr<TabletInfo::CachedLocations> cached(new TabletInfo::CachedLocations());
+    cached->config_opid_index = cstate.config().opid_index();
+    cached->current_term = cstate.current_term();
+    cached->leader_uuid = cstate.leader_uuid();
+    cached->ts_registration_epoch = ts_registration_epoch;
+    cached->locations = *locs_pb;
+    tablet->set_cached_locations(std::move(cached));
+  }
+
   return Status::OK();
 }
 
@@ -3808,6 +4628,16 @@ uint32_t TabletInfo::reported_schema_version() const {
   return reported_schema_version_;
 }
 
+shared_ptr<const TabletInfo::CachedLocations> TabletInfo::cached_locations() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return cached_locations_;
+}
+
+void TabletInfo::set_cached_locations(shared_ptr<const CachedLocations> locations) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  cached_locations_ = std::move(locations);
+}
+
 std::string TabletInfo::ToString() const {
   return Substitute("$0 (table $1)", tablet_id_,
                     (table_ != nullptr ? table_->ToString() : "MISSING"));
@@ -19,6 +19,7 @@
 
 #include <boost/optional/optional_fwd.hpp>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -120,6 +121,21 @@ class TabletInfo : public RefCountedThreadSafe<TabletInfo> {
   bool set_reported_schema_version(uint32_t version);
   uint32_t reported_schema_version() const;
 
+  // The locations of the tablet last built by the catalog manager, along
+  // with the state they were built from. They may be reused as long as the
+  // state is unchanged.
+  struct CachedLocations {
+    int64_t config_opid_index;
+    int64_t current_term;
+    std::string leader_uuid;
+    int64_t ts_registration_epoch;
+    TabletLocationsPB locations;
+  };
+
+  // Accessors for the cached locations of the tablet.
+  std::shared_ptr<const CachedLocations> cached_locations() const;
+  void set_cached_locations(std::shared_ptr<const CachedLocations> locations);
+
   // No synchronization needed.
   std::string ToString() const;
 
@@ -142,6 +158,8 @@ class TabletInfo : public RefCountedThreadSafe<TabletInfo> {
   // Reported schema version (in-memory only).
   uint32_t reported_schema_version_;
 
+  std::shared_ptr<const CachedLocations> cached_locations_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletInfo);
 };
 
@@ -285,6 +303,20 @@ typedef MetadataLock<TableInfo> TableMetadataLock;
 // the state of each tablet on a given tablet-server.
 //
 // Thread-safe.
+// A tablet whose replicas report many written rows, as a candidate for
+// being split.
+struct HotTabletInfo {
+  scoped_refptr<TabletInfo> tablet;
+
+  // The highest rates reported by the replicas of the tablet.
+  double rows_written_per_sec;
+  double rows_scanned_per_sec;
+
+  // The encoded primary key which divides the keys sampled from the recent
+  // writes to the tablet in half, or empty if no keys were sampled.
+  std::string split_key;
+};
+
 class CatalogManager : public tserver::TabletPeerLookupIf {
  public:
 
@@ -438,6 +470,12 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   Status ListTables(const ListTablesRequestPB* req,
                     ListTablesResponsePB* resp);
 
+  // Adds the share of the quotas of each running table with quotas which
+  // each of its tablets enforces, i.e. the table's quotas split evenly
+  // among its tablets, to 'shares'.
+  Status GetTabletQuotaShares(
+      google::protobuf::RepeatedPtrField<TSHeartbeatResponsePB::TabletQuotaSharePB>* shares);
+
   // Lookup the tablets contained in the partition range of the request.
   // Returns an error if any of the tablets are not running.
   Status GetTableLocations(const GetTableLocationsRequestPB* req,
@@ -479,6 +517,14 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // NOTE: This should only be used by tests or web-ui
   Status GetAllTables(std::vector<scoped_refptr<TableInfo>>* tables);
 
+  // Retrieve the tablets whose replicas reported at least
+  // --master_hot_tablet_rows_written_per_sec written rows per second in their
+  // last heartbeat, by decreasing write rate. May fail if the catalog manager
+  // is not yet running. Caller must hold leader_lock_.
+  //
+  // NOTE: This should only be used by tests or web-ui
+  Status GetHotTablets(std::vector<HotTabletInfo>* hot_tablets);
+
   // Check if a table exists by name, setting 'exist' appropriately. May fail
   // if the catalog manager is not yet running. Caller must hold leader_lock_.
   //
@@ -578,11 +624,34 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   Status FindTable(const TableIdentifierPB& table_identifier,
                    scoped_refptr<TableInfo>* table_info);
 
+  // The changes made to a tablet while handling its report, which are
+  // persisted by PersistReportedTablets().
+  struct ReportedTabletMutation {
+    scoped_refptr<TabletInfo> tablet;
+    const ReportedTabletPB* report = nullptr;
+
+    // Held for writing until the changes are persisted. Null if the tablet
+    // needn't be written to the sys catalog.
+    std::unique_ptr<TabletMetadataLock> tablet_lock;
+
+    // Whether the tablet must be sent an AlterTable request once persisted.
+    bool needs_alter = false;
+  };
+
   // Handle one of the tablets in a tablet reported.
   // Requires that the lock is already held.
+  //
+  // Unless the report is rejected, sets 'mutation' to the changes to persist.
   Status HandleReportedTablet(TSDescriptor* ts_desc,
                               const ReportedTabletPB& report,
-                              ReportedTabletUpdatesPB *report_updates);
+                              ReportedTabletUpdatesPB *report_updates,
+                              ReportedTabletMutation* mutation);
+
+  // Writes the changed tablets of 'batch' to the sys catalog in one batch,
+  // commits their locks, sends them the requests which depend on their new
+  // metadata, and clears 'batch'. If the write fails, the changes are
+  // discarded.
+  Status PersistReportedTablets(std::vector<ReportedTabletMutation>* batch);
 
   Status HandleRaftConfigChanged(const ReportedTabletPB& report,
                                  const scoped_refptr<TabletInfo>& tablet,
@@ -664,6 +733,12 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   void SendCreateTabletRequest(const scoped_refptr<TabletInfo>& tablet,
                                const TabletMetadataLock& tablet_lock);
 
+  // Like SendCreateTabletRequest() for each of 'tablets', but creates the
+  // replicas hosted by each tablet server with CreateTablets() RPCs.
+  //
+  // The tablet locks must not be held when making this call.
+  void SendCreateTabletsRequests(const std::vector<TabletInfo*>& tablets);
+
   // Send the "alter table request" to all tablets of the specified table.
   void SendAlterTableRequest(const scoped_refptr<TableInfo>& table);
 
@@ -693,9 +768,38 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
                                 const std::string& reason);
 
   // Start a task to change the config to add an additional voter because the
-  // specified tablet is under-replicated.
-  void SendAddServerRequest(const scoped_refptr<TabletInfo>& tablet,
-                            const consensus::ConsensusStatePB& cstate);
+  // specified tablet is under-replicated, or because one of its replicas is
+  // being moved to the server 'replacement_uuid'. If 'replacement_uuid' is
+  // empty, the new voter is placed on a random server. With 'member_type'
+  // NON_VOTER, adds one of the table's read replicas instead.
+  void SendAddServerRequest(
+      const scoped_refptr<TabletInfo>& tablet,
+      const consensus::ConsensusStatePB& cstate,
+      const std::string& replacement_uuid,
+      consensus::RaftPeerPB::MemberType member_type = consensus::RaftPeerPB::VOTER);
+
+  // Start a task to change the config to remove the voter on the server
+  // 'ts_uuid', whose replica has been moved to another server.
+  void SendRemoveServerRequest(const scoped_refptr<TabletInfo>& tablet,
+                               const consensus::ConsensusStatePB& cstate,
+                               const std::string& ts_uuid);
+
+  // Start a task asking the leader of the tablet, on the server 'leader_uuid',
+  // to step down.
+  void SendLeaderStepDownRequest(const scoped_refptr<TabletInfo>& tablet,
+                                 const std::string& leader_uuid);
+
+  // Moves replicas and leaders between the live tablet servers to even out
+  // their distribution, if --master_enable_replica_rebalancing is set. At most
+  // runs once per --master_replica_rebalancing_interval_ms.
+  //
+  // Called by the background task thread while the master is the leader.
+  void RebalanceReplicas();
+
+  // Carries out the next step of the replica moves started by
+  // RebalanceReplicas(), or abandons them if they timed out.
+  void AdvanceReplicaMoves(
+      const std::unordered_map<std::string, scoped_refptr<TabletInfo>>& tablets);
 
   std::string GenerateId() { return oid_generator_.Next(); }
 
@@ -747,6 +851,24 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   friend class CatalogManagerBgTasks;
   gscoped_ptr<CatalogManagerBgTasks> background_tasks_;
 
+  // A replica move started by RebalanceReplicas(): a voter is added on
+  // 'to_uuid', then the voter on 'from_uuid' is removed once the new replica
+  // is running.
+  struct PendingReplicaMove {
+    std::string from_uuid;
+    std::string to_uuid;
+    // Whether 'to_uuid' reported that its replica of the tablet is running.
+    bool to_running;
+    MonoTime start_time;
+  };
+
+  // The replica moves in progress, keyed by tablet id.
+  std::unordered_map<std::string, PendingReplicaMove> pending_replica_moves_;
+  mutable simple_spinlock pending_replica_moves_lock_;
+
+  // The last time RebalanceReplicas() ran. Only used by the background thread.
+  MonoTime last_rebalance_time_;
+
   enum State {
     kConstructed,
     kStarting,
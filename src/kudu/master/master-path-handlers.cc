@@ -345,6 +345,62 @@ void MasterPathHandlers::HandleTablePage(const Webserver::WebRequest& req,
   HtmlOutputTaskList(task_list, output);
 }
 
+void MasterPathHandlers::HandleHotTablets(const Webserver::WebRequest& req,
+                                          ostringstream* output) {
+  CatalogManager::ScopedLeaderSharedLock l(master_->catalog_manager());
+  if (!l.first_failed_status().ok()) {
+    *output << "Master is not ready: " << l.first_failed_status().ToString();
+    return;
+  }
+
+  vector<HotTabletInfo> hot_tablets;
+  Status s = master_->catalog_manager()->GetHotTablets(&hot_tablets);
+  if (!s.ok()) {
+    *output << "Master is not ready: " << s.ToString();
+    return;
+  }
+
+  *output << "<h1>Hot Tablets</h1>\n";
+  *output << "<p>The tablets with the most written rows, and the primary key at which "
+          << "splitting each of them would divide its recent writes in half.</p>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << "  <tr><th>Table Name</th><th>Tablet ID</th><th>Partition</th>"
+          << "<th>Rows Written/s</th><th>Rows Scanned/s</th><th>Split Key</th></tr>\n";
+  for (const HotTabletInfo& info : hot_tablets) {
+    const scoped_refptr<TableInfo>& table = info.tablet->table();
+    Schema schema;
+    PartitionSchema partition_schema;
+    string table_name;
+    {
+      TableMetadataLock table_lock(table.get(), TableMetadataLock::READ);
+      table_name = table_lock.data().name();
+      if (!SchemaFromPB(table_lock.data().pb.schema(), &schema).ok() ||
+          !PartitionSchema::FromPB(table_lock.data().pb.partition_schema(), schema,
+                                   &partition_schema).ok()) {
+        continue;
+      }
+    }
+    Partition partition;
+    {
+      TabletMetadataLock tablet_lock(info.tablet.get(), TabletMetadataLock::READ);
+      Partition::FromPB(tablet_lock.data().pb.partition(), &partition);
+    }
+    string split_key = info.split_key.empty() ? "" :
+        schema.DebugEncodedRowKey(info.split_key, Schema::START_KEY);
+    *output << Substitute(
+        "  <tr><td><a href=\"/table?id=$0\">$1</a></td><td>$2</td><td>$3</td>"
+        "<td>$4</td><td>$5</td><td>$6</td></tr>\n",
+        EscapeForHtmlToString(table->id()),
+        EscapeForHtmlToString(table_name),
+        EscapeForHtmlToString(info.tablet->tablet_id()),
+        EscapeForHtmlToString(partition_schema.PartitionDebugString(partition, schema)),
+        StringPrintf("%.1f", info.rows_written_per_sec),
+        StringPrintf("%.1f", info.rows_scanned_per_sec),
+        EscapeForHtmlToString(split_key));
+  }
+  *output << "</table>\n";
+}
+
 void MasterPathHandlers::HandleMasters(const Webserver::WebRequest& req,
                                        ostringstream* output) {
   vector<ServerEntryPB> masters;
@@ -534,6 +590,9 @@ Status MasterPathHandlers::Register(Webserver* server) {
   server->RegisterPathHandler("/masters", "Masters",
                               boost::bind(&MasterPathHandlers::HandleMasters, this, _1, _2),
                               is_styled, is_on_nav_bar);
+  server->RegisterPathHandler("/hot-tablets", "",
+                              boost::bind(&MasterPathHandlers::HandleHotTablets, this, _1, _2),
+                              is_styled, false);
   server->RegisterPathHandler("/dump-entities", "Dump Entities",
                               boost::bind(&MasterPathHandlers::HandleDumpEntities, this, _1, _2),
                               false, false);
@@ -54,6 +54,8 @@ class MasterPathHandlers {
                        std::ostringstream *output);
   void HandleMasters(const Webserver::WebRequest& req,
                      std::ostringstream* output);
+  void HandleHotTablets(const Webserver::WebRequest& req,
+                        std::ostringstream* output);
   void HandleDumpEntities(const Webserver::WebRequest& req,
                           std::ostringstream* output);
 
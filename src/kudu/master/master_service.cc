@@ -130,6 +130,9 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
   // 4. Update tserver soft state based on the heartbeat contents.
   ts_desc->UpdateHeartbeatTime();
   ts_desc->set_num_live_replicas(req->num_live_tablets());
+  if (req->has_load()) {
+    ts_desc->set_load(req->load());
+  }
 
   // 5. Only leaders handle tablet reports.
   if (is_leader_master && req->has_tablet_report()) {
@@ -141,7 +144,18 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
     }
   }
 
-  // 6. If the heartbeat has a CSR, sign their cert.
+  // 6. Only leaders know the tables' quotas for certain, so only they
+  //    distribute them.
+  if (is_leader_master) {
+    Status s = server_->catalog_manager()->GetTabletQuotaShares(
+        resp->mutable_tablet_quota_shares());
+    if (!s.ok()) {
+      LOG(WARNING) << "Unable to get the tablet quota shares: " << s.ToString();
+      resp->clear_tablet_quota_shares();
+    }
+  }
+
+  // 7. If the heartbeat has a CSR, sign their cert.
   // TODO(PKI): should this be done only by leaders or all masters?
   if (req->has_csr_der()) {
     string cert;
@@ -154,7 +168,7 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
     resp->mutable_signed_cert_der()->swap(cert);
   }
 
-  // 7. Send any active CA certs which the TS doesn't have.
+  // 8. Send any active CA certs which the TS doesn't have.
 
   rpc->RespondSuccess();
 }
@@ -0,0 +1,166 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/master/rebalancer.h"
+#include "kudu/util/test_util.h"
+
+using std::map;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace master {
+
+class ReplicaRebalancerTest : public KuduTest {
+ protected:
+  // Adds 'num_tablets' tablets of table 'table_id', with replicas on
+  // 'replica_uuids' and their leader on the first of them.
+  void AddTablets(const string& table_id, int num_tablets,
+                  const vector<string>& replica_uuids) {
+    for (int i = 0; i < num_tablets; i++) {
+      TabletReplicas t;
+      t.tablet_id = Substitute("$0-$1", table_id, tablets_.size());
+      t.table_id = table_id;
+      t.replica_uuids = replica_uuids;
+      t.leader_uuid = replica_uuids[0];
+      t.movable = true;
+      tablets_.push_back(t);
+    }
+  }
+
+  // Applies 'moves' to the tablets, and returns the number of replicas on
+  // each server.
+  map<string, int> ApplyMoves(const vector<ReplicaMove>& moves) {
+    for (const ReplicaMove& move : moves) {
+      for (TabletReplicas& t : tablets_) {
+        if (t.tablet_id == move.tablet_id) {
+          std::replace(t.replica_uuids.begin(), t.replica_uuids.end(),
+                       move.from_uuid, move.to_uuid);
+        }
+      }
+    }
+    map<string, int> counts;
+    for (const TabletReplicas& t : tablets_) {
+      for (const string& uuid : t.replica_uuids) {
+        counts[uuid]++;
+      }
+    }
+    return counts;
+  }
+
+  vector<TabletReplicas> tablets_;
+};
+
+TEST_F(ReplicaRebalancerTest, TestMovesReplicasToNewServer) {
+  AddTablets("t", 8, { "a", "b", "c" });
+  ReplicaRebalancer rebalancer({ "a", "b", "c", "d" }, tablets_);
+  vector<ReplicaMove> moves;
+  rebalancer.PlanReplicaMoves(100, &moves);
+
+  // 24 replicas on 4 servers: 6 replicas are moved to 'd'.
+  ASSERT_EQ(6, moves.size());
+  for (const ReplicaMove& move : moves) {
+    ASSERT_EQ("d", move.to_uuid);
+  }
+  map<string, int> counts = ApplyMoves(moves);
+  for (const string& uuid : { "a", "b", "c", "d" }) {
+    ASSERT_EQ(6, counts[uuid]) << uuid;
+  }
+
+  // Nothing left to move.
+  ReplicaRebalancer balanced({ "a", "b", "c", "d" }, tablets_);
+  moves.clear();
+  balanced.PlanReplicaMoves(100, &moves);
+  ASSERT_TRUE(moves.empty());
+}
+
+TEST_F(ReplicaRebalancerTest, TestMaxMovesAndUnmovableTablets) {
+  AddTablets("t", 4, { "a", "b", "c" });
+  tablets_[0].movable = false;
+  // A replica of this tablet is on a server which isn't live.
+  AddTablets("t", 1, { "a", "b", "x" });
+
+  ReplicaRebalancer rebalancer({ "a", "b", "c", "d" }, tablets_);
+  vector<ReplicaMove> moves;
+  rebalancer.PlanReplicaMoves(2, &moves);
+  ASSERT_EQ(2, moves.size());
+  for (const ReplicaMove& move : moves) {
+    ASSERT_NE(tablets_[0].tablet_id, move.tablet_id);
+    ASSERT_NE(tablets_[4].tablet_id, move.tablet_id);
+  }
+  // Each tablet is moved at most once.
+  ASSERT_NE(moves[0].tablet_id, moves[1].tablet_id);
+}
+
+TEST_F(ReplicaRebalancerTest, TestBalancesEachTable) {
+  // The servers host as many replicas in total, but table "t1" is only on
+  // 'a', 'b' and 'c', and table "t2" only on 'b', 'c' and 'd'.
+  AddTablets("t1", 4, { "a", "b", "c" });
+  AddTablets("t2", 4, { "b", "c", "d" });
+  AddTablets("t3", 4, { "a", "d", "c" });
+  AddTablets("t3", 4, { "a", "d", "b" });
+  ReplicaRebalancer rebalancer({ "a", "b", "c", "d" }, tablets_);
+  vector<ReplicaMove> moves;
+  rebalancer.PlanReplicaMoves(100, &moves);
+  ASSERT_FALSE(moves.empty());
+  ApplyMoves(moves);
+
+  for (const string& table_id : { "t1", "t2" }) {
+    map<string, int> counts;
+    for (const TabletReplicas& t : tablets_) {
+      if (t.table_id == table_id) {
+        for (const string& uuid : t.replica_uuids) {
+          counts[uuid]++;
+        }
+      }
+    }
+    for (const string& uuid : { "a", "b", "c", "d" }) {
+      ASSERT_GE(counts[uuid], 2) << table_id << " on " << uuid;
+      ASSERT_LE(counts[uuid], 4) << table_id << " on " << uuid;
+    }
+  }
+}
+
+TEST_F(ReplicaRebalancerTest, TestLeaderStepDowns) {
+  AddTablets("t", 9, { "a", "b", "c" });
+  ReplicaRebalancer rebalancer({ "a", "b", "c" }, tablets_);
+  vector<ReplicaMove> moves;
+  rebalancer.PlanReplicaMoves(100, &moves);
+  ASSERT_TRUE(moves.empty());
+
+  // All the leaders are on 'a': 6 of them should move away.
+  vector<string> step_downs;
+  rebalancer.PlanLeaderStepDowns(100, &step_downs);
+  ASSERT_EQ(6, step_downs.size());
+
+  step_downs.clear();
+  ReplicaRebalancer limited({ "a", "b", "c" }, tablets_);
+  limited.PlanLeaderStepDowns(2, &step_downs);
+  ASSERT_EQ(2, step_downs.size());
+}
+
+} // namespace master
+} // namespace kudu
@@ -0,0 +1,200 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/master/rebalancer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+#include "kudu/gutil/map-util.h"
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace master {
+
+ReplicaRebalancer::ReplicaRebalancer(const vector<string>& ts_uuids,
+                                     vector<TabletReplicas> tablets)
+    : ts_uuids_(ts_uuids),
+      tablets_(std::move(tablets)),
+      total_replicas_(ts_uuids_.size()),
+      total_leaders_(ts_uuids_.size()) {
+  for (int i = 0; i < ts_uuids_.size(); i++) {
+    InsertOrDie(&ts_indexes_, ts_uuids_[i], i);
+  }
+
+  for (TabletReplicas& tablet : tablets_) {
+    if (!AllReplicasLive(tablet)) {
+      tablet.movable = false;
+    }
+    vector<int>& replicas = table_replicas_[tablet.table_id];
+    replicas.resize(ts_uuids_.size());
+    vector<int>& leaders = table_leaders_[tablet.table_id];
+    leaders.resize(ts_uuids_.size());
+
+    for (const string& uuid : tablet.replica_uuids) {
+      int idx = TSIndex(uuid);
+      if (idx >= 0) {
+        replicas[idx]++;
+        total_replicas_[idx]++;
+      }
+    }
+    int leader = TSIndex(tablet.leader_uuid);
+    if (leader >= 0) {
+      leaders[leader]++;
+      total_leaders_[leader]++;
+    }
+  }
+}
+
+int ReplicaRebalancer::TSIndex(const string& uuid) const {
+  const int* idx = FindOrNull(ts_indexes_, uuid);
+  return idx ? *idx : -1;
+}
+
+bool ReplicaRebalancer::AllReplicasLive(const TabletReplicas& tablet) const {
+  for (const string& uuid : tablet.replica_uuids) {
+    if (TSIndex(uuid) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ReplicaRebalancer::PlanReplicaMoves(int max_moves, vector<ReplicaMove>* moves) {
+  int num_planned = 0;
+  for (const auto& e : table_replicas_) {
+    while (num_planned < max_moves && PlanReplicaMove(e.first, moves)) {
+      num_planned++;
+    }
+  }
+  while (num_planned < max_moves && PlanReplicaMove("", moves)) {
+    num_planned++;
+  }
+}
+
+bool ReplicaRebalancer::PlanReplicaMove(const string& table_id, vector<ReplicaMove>* moves) {
+  const vector<int>& counts = table_id.empty() ? total_replicas_ :
+                                                 FindOrDie(table_replicas_, table_id);
+
+  // The servers by increasing number of replicas. Among servers with as many
+  // replicas of the table, those with the fewest replicas overall come first.
+  vector<int> order(ts_uuids_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return std::make_pair(counts[a], total_replicas_[a]) <
+          std::make_pair(counts[b], total_replicas_[b]);
+    });
+
+  for (auto from_it = order.rbegin(); from_it != order.rend(); ++from_it) {
+    const int from = *from_it;
+    const string& from_uuid = ts_uuids_[from];
+    for (int to : order) {
+      if (counts[from] - counts[to] <= 1) {
+        // Moving a replica would not reduce the skew.
+        break;
+      }
+      const string& to_uuid = ts_uuids_[to];
+      for (TabletReplicas& tablet : tablets_) {
+        if (!tablet.movable ||
+            (!table_id.empty() && tablet.table_id != table_id)) {
+          continue;
+        }
+        vector<int>& table_counts = FindOrDie(table_replicas_, tablet.table_id);
+        if (table_id.empty() && table_counts[to] >= table_counts[from]) {
+          // The move would make the distribution of the table worse.
+          continue;
+        }
+        auto replica = std::find(tablet.replica_uuids.begin(), tablet.replica_uuids.end(),
+                                 from_uuid);
+        if (replica == tablet.replica_uuids.end() ||
+            std::find(tablet.replica_uuids.begin(), tablet.replica_uuids.end(),
+                      to_uuid) != tablet.replica_uuids.end()) {
+          continue;
+        }
+
+        moves->push_back({ tablet.tablet_id, from_uuid, to_uuid });
+        *replica = to_uuid;
+        table_counts[from]--;
+        table_counts[to]++;
+        total_replicas_[from]--;
+        total_replicas_[to]++;
+        if (tablet.leader_uuid == from_uuid) {
+          // The leader steps down before its replica is removed.
+          FindOrDie(table_leaders_, tablet.table_id)[from]--;
+          total_leaders_[from]--;
+          tablet.leader_uuid.clear();
+        }
+        tablet.movable = false;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ReplicaRebalancer::PlanLeaderStepDowns(int max_step_downs, vector<string>* tablet_ids) {
+  int num_planned = 0;
+  // Even out the leaders of each table first, then the leaders of all tables.
+  for (bool per_table : { true, false }) {
+    for (TabletReplicas& tablet : tablets_) {
+      if (num_planned >= max_step_downs) {
+        return;
+      }
+      const int leader = TSIndex(tablet.leader_uuid);
+      if (!tablet.movable || leader < 0) {
+        continue;
+      }
+      vector<int>& table_leaders = FindOrDie(table_leaders_, tablet.table_id);
+      const vector<int>& counts = per_table ? table_leaders : total_leaders_;
+
+      int target = -1;
+      for (const string& uuid : tablet.replica_uuids) {
+        int idx = TSIndex(uuid);
+        if (idx == leader) {
+          continue;
+        }
+        if (target < 0 ||
+            std::make_pair(counts[idx], total_leaders_[idx]) <
+            std::make_pair(counts[target], total_leaders_[target])) {
+          target = idx;
+        }
+      }
+      if (target < 0 || counts[leader] - counts[target] <= 1) {
+        continue;
+      }
+      if (!per_table && table_leaders[target] >= table_leaders[leader]) {
+        // The transfer would make the distribution of the table worse.
+        continue;
+      }
+
+      tablet_ids->push_back(tablet.tablet_id);
+      table_leaders[leader]--;
+      table_leaders[target]++;
+      total_leaders_[leader]--;
+      total_leaders_[target]++;
+      tablet.leader_uuid = ts_uuids_[target];
+      tablet.movable = false;
+      num_planned++;
+    }
+  }
+}
+
+} // namespace master
+} // namespace kudu
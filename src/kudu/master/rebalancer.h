@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_MASTER_REBALANCER_H
+#define KUDU_MASTER_REBALANCER_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+namespace master {
+
+// The voters and leader of a tablet, as seen by the rebalancer.
+struct TabletReplicas {
+  std::string tablet_id;
+  std::string table_id;
+  std::vector<std::string> replica_uuids;
+
+  // Empty if the tablet has no known leader.
+  std::string leader_uuid;
+
+  // False if neither the replicas nor the leader of the tablet may be moved,
+  // e.g. because the tablet is under-replicated or already being moved.
+  bool movable;
+};
+
+// A move of the replica of a tablet from one tablet server to another.
+struct ReplicaMove {
+  std::string tablet_id;
+  std::string from_uuid;
+  std::string to_uuid;
+};
+
+// Plans moves of tablet replicas and leaders which even out their
+// distribution across the live tablet servers: first across the servers
+// for each table, then across the servers for all tables combined,
+// without making the distribution of any table worse.
+//
+// The planner only works on the snapshot it is constructed from: each call
+// updates the snapshot as if the planned moves had been carried out, and a
+// tablet is part of at most one planned move.
+//
+// This class is not thread-safe.
+class ReplicaRebalancer {
+ public:
+  // Replicas on servers which are not in 'ts_uuids' are not counted, and
+  // their tablets are not moved.
+  ReplicaRebalancer(const std::vector<std::string>& ts_uuids,
+                    std::vector<TabletReplicas> tablets);
+
+  // Plans up to 'max_moves' replica moves, appending them to 'moves'.
+  void PlanReplicaMoves(int max_moves, std::vector<ReplicaMove>* moves);
+
+  // Plans up to 'max_step_downs' leadership transfers, appending the ids of
+  // the tablets whose leaders should step down to 'tablet_ids'. The new
+  // leader is assumed to be the follower with the fewest leaders.
+  void PlanLeaderStepDowns(int max_step_downs, std::vector<std::string>* tablet_ids);
+
+ private:
+  typedef std::unordered_map<std::string, std::vector<int>> PerTableCounts;
+
+  // Plans a single replica move which reduces the skew of the replicas of
+  // table 'table_id' across the servers, or of the replicas of all tables if
+  // 'table_id' is empty. Returns false if there is no such move.
+  bool PlanReplicaMove(const std::string& table_id, std::vector<ReplicaMove>* moves);
+
+  // Returns the index of 'uuid' in 'ts_uuids_', or -1 if it's not live.
+  int TSIndex(const std::string& uuid) const;
+
+  // Returns whether the replicas of 'tablet' are all on live servers.
+  bool AllReplicasLive(const TabletReplicas& tablet) const;
+
+  const std::vector<std::string> ts_uuids_;
+  std::unordered_map<std::string, int> ts_indexes_;
+
+  std::vector<TabletReplicas> tablets_;
+
+  // The number of replicas and leaders on each server, for each table and
+  // for all tables.
+  PerTableCounts table_replicas_;
+  std::vector<int> total_replicas_;
+  PerTableCounts table_leaders_;
+  std::vector<int> total_leaders_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReplicaRebalancer);
+};
+
+} // namespace master
+} // namespace kudu
+
+#endif // KUDU_MASTER_REBALANCER_H
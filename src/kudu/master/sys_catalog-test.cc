@@ -19,10 +19,13 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/catalog_manager.h"
 #include "kudu/master/master.h"
 #include "kudu/master/master.proxy.h"
@@ -30,16 +33,19 @@
 #include "kudu/master/sys_catalog.h"
 #include "kudu/server/rpc_server.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 using std::string;
 using std::shared_ptr;
 using kudu::rpc::Messenger;
 using kudu::rpc::MessengerBuilder;
 using kudu::rpc::RpcController;
+using strings::Substitute;
 
 namespace kudu {
 namespace master {
@@ -222,11 +228,16 @@ class TabletLoader : public TabletVisitor {
     l.mutable_data()->pb.CopyFrom(metadata);
     l.Commit();
     tablet->AddRef();
+    std::lock_guard<simple_spinlock> lock(lock_);
     tablets.push_back(tablet);
     return Status::OK();
   }
 
   vector<TabletInfo *> tablets;
+
+ private:
+  // Protects 'tablets' when the tablets are visited by a thread pool.
+  simple_spinlock lock_;
 };
 
 // Create a new TabletInfo. The object is in uncommitted
@@ -347,6 +358,37 @@ TEST_F(SysCatalogTest, TestSysCatalogTabletsOperations) {
   }
 }
 
+// Test that visiting the tablets with a thread pool visits all of them.
+TEST_F(SysCatalogTest, TestVisitTabletsInParallel) {
+  const int kNumTablets = 2500;
+  scoped_refptr<TableInfo> table(new TableInfo("abc"));
+  vector<scoped_refptr<TabletInfo>> tablets;
+  vector<TabletInfo*> to_add;
+  for (int i = 0; i < kNumTablets; i++) {
+    tablets.emplace_back(CreateTablet(table.get(), Substitute("$0", i),
+                                      Substitute("$0", i), Substitute("$0", i + 1)));
+    to_add.push_back(tablets.back().get());
+  }
+  SysCatalogTable* sys_catalog = master_->catalog_manager()->sys_catalog();
+  SysCatalogTable::Actions actions;
+  actions.tablets_to_add = to_add;
+  ASSERT_OK(sys_catalog->Write(actions));
+
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("test-load").set_max_threads(4).Build(&pool));
+  TabletLoader loader;
+  ASSERT_OK(sys_catalog->VisitTablets(&loader, pool.get()));
+  ASSERT_EQ(kNumTablets, loader.tablets.size());
+
+  std::sort(loader.tablets.begin(), loader.tablets.end(),
+            [](const TabletInfo* a, const TabletInfo* b) {
+              return std::stoi(a->tablet_id()) < std::stoi(b->tablet_id());
+            });
+  for (int i = 0; i < kNumTablets; i++) {
+    ASSERT_TRUE(MetadatasEqual(tablets[i].get(), loader.tablets[i]));
+  }
+}
+
 // Verify that data mutations are not available from metadata() until commit.
 TEST_F(SysCatalogTest, TestTabletInfoCommit) {
   scoped_refptr<TabletInfo> tablet(new TabletInfo(nullptr, "123"));
@@ -22,7 +22,9 @@
 #include <glog/logging.h>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <utility>
 
 #include "kudu/common/partial_row.h"
 #include "kudu/common/partition.h"
@@ -49,6 +51,7 @@
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/threadpool.h"
@@ -558,10 +561,14 @@ Status SysCatalogTable::VisitTabletFromRow(const RowBlockRow& row, TabletVisitor
     schema_.ExtractColumnFromRow<STRING>(row, schema_.find_column(kSysCatalogTableColId));
   const Slice *data =
     schema_.ExtractColumnFromRow<STRING>(row, schema_.find_column(kSysCatalogTableColMetadata));
+  return VisitTabletEntry(*tablet_id, *data, visitor);
+}
 
+Status SysCatalogTable::VisitTabletEntry(const Slice& tablet_id, const Slice& data,
+                                         TabletVisitor* visitor) {
   SysTabletsEntryPB metadata;
-  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(&metadata, data->data(), data->size()),
-                        "Unable to parse metadata field for tablet " + tablet_id->ToString());
+  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(&metadata, data.data(), data.size()),
+                        "Unable to parse metadata field for tablet " + tablet_id.ToString());
 
   // Upgrade from the deprecated start/end-key fields to the 'partition' field.
   if (!metadata.has_partition()) {
@@ -573,7 +580,7 @@ Status SysCatalogTable::VisitTabletFromRow(const RowBlockRow& row, TabletVisitor
     metadata.clear_deprecated_end_key();
   }
 
-  RETURN_NOT_OK(visitor->VisitTablet(metadata.table_id(), tablet_id->ToString(), metadata));
+  RETURN_NOT_OK(visitor->VisitTablet(metadata.table_id(), tablet_id.ToString(), metadata));
   return Status::OK();
 }
 
@@ -604,6 +611,87 @@ Status SysCatalogTable::VisitTablets(TabletVisitor* visitor) {
   return Status::OK();
 }
 
+Status SysCatalogTable::VisitTablets(TabletVisitor* visitor, ThreadPool* pool) {
+  TRACE_EVENT0("master", "SysCatalogTable::VisitTablets");
+  const int8_t tablets_entry = TABLETS_ENTRY;
+  const int type_col_idx = schema_.find_column(kSysCatalogTableColType);
+  CHECK(type_col_idx != Schema::kColumnNotFound);
+  const int id_col_idx = schema_.find_column(kSysCatalogTableColId);
+  const int metadata_col_idx = schema_.find_column(kSysCatalogTableColMetadata);
+
+  auto pred_tablets = ColumnPredicate::Equality(schema_.column(type_col_idx), &tablets_entry);
+  ScanSpec spec;
+  spec.AddPredicate(pred_tablets);
+
+  gscoped_ptr<RowwiseIterator> iter;
+  RETURN_NOT_OK(tablet_peer_->tablet()->NewRowIterator(schema_, &iter));
+  RETURN_NOT_OK(iter->Init(&spec));
+
+  // The first error of the visits. The pool is waited on before returning,
+  // so the tasks may refer to it.
+  simple_spinlock status_lock;
+  Status status;
+
+  // The entries are copied out of the scanned blocks, to be parsed and
+  // visited by the pool while the scan goes on.
+  typedef std::vector<std::pair<std::string, std::string>> Chunk;
+  const int kChunkSize = 1024;
+  auto submit = [&](shared_ptr<Chunk> chunk) {
+    return pool->SubmitFunc([this, chunk, visitor, &status_lock, &status]() {
+        for (const auto& entry : *chunk) {
+          {
+            std::lock_guard<simple_spinlock> l(status_lock);
+            if (!status.ok()) {
+              return;
+            }
+          }
+          Status s = this->VisitTabletEntry(entry.first, entry.second, visitor);
+          if (!s.ok()) {
+            std::lock_guard<simple_spinlock> l(status_lock);
+            if (status.ok()) {
+              status = s;
+            }
+            return;
+          }
+        }
+      });
+  };
+
+  Status scan_status;
+  Arena arena(32 * 1024, 256 * 1024);
+  RowBlock block(iter->schema(), 512, &arena);
+  shared_ptr<Chunk> chunk(new Chunk);
+  while (scan_status.ok() && iter->HasNext()) {
+    scan_status = iter->NextBlock(&block);
+    if (!scan_status.ok()) {
+      break;
+    }
+    for (size_t i = 0; i < block.nrows(); i++) {
+      if (!block.selection_vector()->IsRowSelected(i)) continue;
+
+      RowBlockRow row = block.row(i);
+      const Slice* tablet_id = schema_.ExtractColumnFromRow<STRING>(row, id_col_idx);
+      const Slice* data = schema_.ExtractColumnFromRow<STRING>(row, metadata_col_idx);
+      chunk->emplace_back(tablet_id->ToString(), data->ToString());
+      if (chunk->size() == kChunkSize) {
+        scan_status = submit(std::move(chunk));
+        chunk.reset(new Chunk);
+        if (!scan_status.ok()) {
+          break;
+        }
+      }
+    }
+  }
+  if (scan_status.ok() && !chunk->empty()) {
+    scan_status = submit(std::move(chunk));
+  }
+  pool->Wait();
+
+  RETURN_NOT_OK(scan_status);
+  std::lock_guard<simple_spinlock> l(status_lock);
+  return status;
+}
+
 void SysCatalogTable::InitLocalRaftPeerPB() {
   local_peer_pb_.set_permanent_uuid(master_->fs_manager()->uuid());
   Sockaddr addr = master_->first_rpc_address();
@@ -29,6 +29,8 @@ namespace kudu {
 
 class Schema;
 class FsManager;
+class Slice;
+class ThreadPool;
 
 namespace tserver {
 class WriteRequestPB;
@@ -115,6 +117,11 @@ class SysCatalogTable {
   // Scan of the tablet-related entries.
   Status VisitTablets(TabletVisitor* visitor);
 
+  // Like VisitTablets(), but the entries are parsed and visited in chunks
+  // by the threads of 'pool', so 'visitor' must be thread-safe and the order
+  // in which the tablets are visited is undefined.
+  Status VisitTablets(TabletVisitor* visitor, ThreadPool* pool);
+
  private:
   FRIEND_TEST(MasterTest, TestMasterMetadataConsistentDespiteFailures);
   DISALLOW_COPY_AND_ASSIGN(SysCatalogTable);
@@ -170,6 +177,7 @@ class SysCatalogTable {
                         RowOperationsPB::Type op_type,
                         RowOperationsPB* ops) const;
   Status VisitTabletFromRow(const RowBlockRow& row, TabletVisitor* visitor);
+  Status VisitTabletEntry(const Slice& tablet_id, const Slice& data, TabletVisitor* visitor);
 
   // Initializes the RaftPeerPB for the local peer.
   // Crashes due to an invariant check if the rpc server is not running.
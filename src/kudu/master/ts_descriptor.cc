@@ -17,6 +17,7 @@
 
 #include "kudu/master/ts_descriptor.h"
 
+#include <algorithm>
 #include <math.h>
 #include <mutex>
 #include <unordered_set>
@@ -37,6 +38,31 @@ DEFINE_int32(tserver_unresponsive_timeout_ms, 60 * 1000,
              "selected when assigning replicas during table creation or re-replication.");
 TAG_FLAG(tserver_unresponsive_timeout_ms, advanced);
 
+DEFINE_double(replica_placement_replicas_weight, 1.0,
+              "Weight of the number of replicas of a tablet server in the load score used "
+              "to place new replicas. Only used with --master_load_aware_placement.");
+TAG_FLAG(replica_placement_replicas_weight, experimental);
+TAG_FLAG(replica_placement_replicas_weight, runtime);
+
+DEFINE_double(replica_placement_activity_weight, 1.0,
+              "Weight of the rate of rows written and scanned by a tablet server in the "
+              "load score used to place new replicas. Only used with "
+              "--master_load_aware_placement.");
+TAG_FLAG(replica_placement_activity_weight, experimental);
+TAG_FLAG(replica_placement_activity_weight, runtime);
+
+DEFINE_double(replica_placement_memory_weight, 1.0,
+              "Weight of the memory usage of a tablet server in the load score used to "
+              "place new replicas. Only used with --master_load_aware_placement.");
+TAG_FLAG(replica_placement_memory_weight, experimental);
+TAG_FLAG(replica_placement_memory_weight, runtime);
+
+DEFINE_double(replica_placement_disk_weight, 1.0,
+              "Weight of the lack of free disk space of a tablet server in the load score "
+              "used to place new replicas. Only used with --master_load_aware_placement.");
+TAG_FLAG(replica_placement_disk_weight, experimental);
+TAG_FLAG(replica_placement_disk_weight, runtime);
+
 using std::make_shared;
 using std::shared_ptr;
 
@@ -182,6 +208,23 @@ double TSDescriptor::RecentReplicaCreations() {
   return recent_replica_creations_;
 }
 
+void TSDescriptor::set_load(const TSLoadPB& load) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!load_) {
+    load_.reset(new TSLoadPB);
+  }
+  load_->CopyFrom(load);
+}
+
+bool TSDescriptor::GetLoad(TSLoadPB* load) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!load_) {
+    return false;
+  }
+  load->CopyFrom(*load_);
+  return true;
+}
+
 void TSDescriptor::GetRegistration(ServerRegistrationPB* reg) const {
   std::lock_guard<simple_spinlock> l(lock_);
   CHECK(registration_) << "No registration";
@@ -276,5 +319,58 @@ string TSDescriptor::ToString() const {
   return strings::Substitute("$0 ($1:$2)", permanent_uuid_, addr.host(), addr.port());
 }
 
+namespace {
+
+// Returns 'a' and 'b' divided by the larger of the two.
+void Normalize(double a, double b, double* norm_a, double* norm_b) {
+  double max = std::max(a, b);
+  *norm_a = max > 0 ? a / max : 0;
+  *norm_b = max > 0 ? b / max : 0;
+}
+
+int64_t TotalFreeBytes(const TSLoadPB& load) {
+  int64_t total = 0;
+  for (int64_t bytes : load.data_dir_free_bytes()) {
+    total += bytes;
+  }
+  return total;
+}
+
+} // anonymous namespace
+
+void ComputeReplicaPlacementScores(TSDescriptor* a, TSDescriptor* b,
+                                   double* score_a, double* score_b) {
+  double norm_a, norm_b;
+  Normalize(a->RecentReplicaCreations() + a->num_live_replicas(),
+            b->RecentReplicaCreations() + b->num_live_replicas(),
+            &norm_a, &norm_b);
+  *score_a = FLAGS_replica_placement_replicas_weight * norm_a;
+  *score_b = FLAGS_replica_placement_replicas_weight * norm_b;
+
+  // The other components are only comparable if both servers report them.
+  TSLoadPB load_a, load_b;
+  if (!a->GetLoad(&load_a) || !b->GetLoad(&load_b)) {
+    return;
+  }
+
+  Normalize(load_a.rows_written_per_sec() + load_a.rows_scanned_per_sec(),
+            load_b.rows_written_per_sec() + load_b.rows_scanned_per_sec(),
+            &norm_a, &norm_b);
+  *score_a += FLAGS_replica_placement_activity_weight * norm_a;
+  *score_b += FLAGS_replica_placement_activity_weight * norm_b;
+
+  if (load_a.has_memory_usage_ratio() && load_b.has_memory_usage_ratio()) {
+    *score_a += FLAGS_replica_placement_memory_weight * load_a.memory_usage_ratio();
+    *score_b += FLAGS_replica_placement_memory_weight * load_b.memory_usage_ratio();
+  }
+
+  if (load_a.data_dir_free_bytes_size() > 0 && load_b.data_dir_free_bytes_size() > 0) {
+    // The server with the most free space scores 0.
+    Normalize(TotalFreeBytes(load_a), TotalFreeBytes(load_b), &norm_a, &norm_b);
+    *score_a += FLAGS_replica_placement_disk_weight * (1 - norm_a);
+    *score_b += FLAGS_replica_placement_disk_weight * (1 - norm_b);
+  }
+}
+
 } // namespace master
 } // namespace kudu
@@ -47,6 +47,8 @@ class TabletServerAdminServiceProxy;
 
 namespace master {
 
+class TSLoadPB;
+
 // Master-side view of a single tablet server.
 //
 // Tracks the last heartbeat, status, instance identifier, etc.
@@ -114,6 +116,13 @@ class TSDescriptor {
     return num_live_replicas_;
   }
 
+  // Set the resource usage reported in the last heartbeat.
+  void set_load(const TSLoadPB& load);
+
+  // Copy the resource usage reported in the last heartbeat into 'load'.
+  // Returns false if the TS has not reported its resource usage.
+  bool GetLoad(TSLoadPB* load) const;
+
   // Return a string form of this TS, suitable for printing.
   // Includes the UUID as well as last known host/port.
   std::string ToString() const;
@@ -144,6 +153,9 @@ class TSDescriptor {
   // The number of live replicas on this host, from the last heartbeat.
   int num_live_replicas_;
 
+  // The resource usage of this host, from the last heartbeat which reported it.
+  gscoped_ptr<TSLoadPB> load_;
+
   gscoped_ptr<ServerRegistrationPB> registration_;
 
   std::shared_ptr<tserver::TabletServerAdminServiceProxy> ts_admin_proxy_;
@@ -153,6 +165,13 @@ class TSDescriptor {
   DISALLOW_COPY_AND_ASSIGN(TSDescriptor);
 };
 
+// Computes the weighted load scores of tablet servers 'a' and 'b' used to
+// choose which of them a new replica is placed on: the lower the score, the
+// better the candidate. Each component of the load is normalized by its
+// larger value on the two servers.
+void ComputeReplicaPlacementScores(TSDescriptor* a, TSDescriptor* b,
+                                   double* score_a, double* score_b);
+
 } // namespace master
 } // namespace kudu
 #endif /* KUDU_MASTER_TS_DESCRIPTOR_H */
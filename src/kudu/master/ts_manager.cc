@@ -34,7 +34,8 @@ using strings::Substitute;
 namespace kudu {
 namespace master {
 
-TSManager::TSManager() {
+TSManager::TSManager()
+    : registration_epoch_(0) {
 }
 
 TSManager::~TSManager() {
@@ -85,6 +86,7 @@ Status TSManager::RegisterTS(const NodeInstancePB& instance,
                             found->ToString());
     desc->swap(found);
   }
+  registration_epoch_++;
 
   return Status::OK();
 }
@@ -17,6 +17,8 @@
 #ifndef KUDU_MASTER_TS_MANAGER_H
 #define KUDU_MASTER_TS_MANAGER_H
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -84,9 +86,17 @@ class TSManager {
   // Get the TS count.
   int GetCount() const;
 
+  // Returns a number which changes whenever a tablet server registers or
+  // re-registers, possibly with new addresses.
+  int64_t registration_epoch() const {
+    return registration_epoch_.load();
+  }
+
  private:
   mutable rw_spinlock lock_;
 
+  std::atomic<int64_t> registration_epoch_;
+
   typedef std::unordered_map<
     std::string, std::shared_ptr<TSDescriptor> > TSDescriptorMap;
   TSDescriptorMap servers_by_id_;
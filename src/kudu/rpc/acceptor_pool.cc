@@ -28,12 +28,14 @@
 
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/net/socket.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 
@@ -54,6 +56,16 @@ DEFINE_int32(rpc_acceptor_listen_backlog, 128,
              "new inbound connection requests.");
 TAG_FLAG(rpc_acceptor_listen_backlog, advanced);
 
+DEFINE_bool(rpc_acceptor_reuseport, false,
+            "Whether the RPC server listens on one SO_REUSEPORT socket per reactor for "
+            "each bound address, each with its own acceptor thread handing the "
+            "connections to its reactor, rather than on a single socket whose "
+            "connections are spread across the reactors. The kernel spreads the "
+            "incoming connections across the sockets.");
+TAG_FLAG(rpc_acceptor_reuseport, experimental);
+
+DECLARE_bool(rpc_pin_reactor_threads);
+
 namespace kudu {
 namespace rpc {
 
@@ -73,19 +85,45 @@ AcceptorPool::~AcceptorPool() {
 Status AcceptorPool::Start(int num_threads) {
   RETURN_NOT_OK(socket_.Listen(FLAGS_rpc_acceptor_listen_backlog));
 
-  for (int i = 0; i < num_threads; i++) {
-    scoped_refptr<kudu::Thread> new_thread;
-    Status s = kudu::Thread::Create("acceptor pool", "acceptor",
-        &AcceptorPool::RunThread, this, &new_thread);
-    if (!s.ok()) {
-      Shutdown();
-      return s;
+  if (FLAGS_rpc_acceptor_reuseport) {
+    // Bind the sockets of the other reactors to the port actually bound,
+    // in case an ephemeral port was requested.
+    Sockaddr bound_addr;
+    RETURN_NOT_OK(socket_.GetSocketAddress(&bound_addr));
+    for (int i = 1; i < messenger_->num_reactors(); i++) {
+      std::unique_ptr<Socket> sock(new Socket());
+      RETURN_NOT_OK(sock->Init(0));
+      RETURN_NOT_OK(sock->SetReuseAddr(true));
+      RETURN_NOT_OK(sock->SetReusePort(true));
+      RETURN_NOT_OK(sock->Bind(bound_addr));
+      RETURN_NOT_OK(sock->Listen(FLAGS_rpc_acceptor_listen_backlog));
+      reactor_sockets_.emplace_back(std::move(sock));
     }
-    threads_.push_back(new_thread);
+    RETURN_NOT_OK(StartThread(&socket_, 0));
+    for (size_t i = 0; i < reactor_sockets_.size(); i++) {
+      RETURN_NOT_OK(StartThread(reactor_sockets_[i].get(), static_cast<int>(i) + 1));
+    }
+    return Status::OK();
+  }
+
+  for (int i = 0; i < num_threads; i++) {
+    RETURN_NOT_OK(StartThread(&socket_, -1));
   }
   return Status::OK();
 }
 
+Status AcceptorPool::StartThread(Socket* socket, int reactor_idx) {
+  scoped_refptr<kudu::Thread> new_thread;
+  Status s = kudu::Thread::Create("acceptor pool", "acceptor",
+      &AcceptorPool::RunThread, this, socket, reactor_idx, &new_thread);
+  if (!s.ok()) {
+    Shutdown();
+    return s;
+  }
+  threads_.push_back(new_thread);
+  return Status::OK();
+}
+
 void AcceptorPool::Shutdown() {
   if (Acquire_CompareAndSwap(&closing_, false, true) != false) {
     VLOG(2) << "Acceptor Pool on " << bind_address_.ToString()
@@ -99,6 +137,11 @@ void AcceptorPool::Shutdown() {
   WARN_NOT_OK(socket_.Shutdown(true, true),
               strings::Substitute("Could not shut down acceptor socket on $0",
                                   bind_address_.ToString()));
+  for (const auto& sock : reactor_sockets_) {
+    WARN_NOT_OK(sock->Shutdown(true, true),
+                strings::Substitute("Could not shut down acceptor socket on $0",
+                                    bind_address_.ToString()));
+  }
 #else
   // Calling shutdown on an accepting (non-connected) socket is illegal on most
   // platforms (but not Linux). Instead, the accepting threads are interrupted
@@ -122,13 +165,17 @@ Status AcceptorPool::GetBoundAddress(Sockaddr* addr) const {
   return socket_.GetSocketAddress(addr);
 }
 
-void AcceptorPool::RunThread() {
+void AcceptorPool::RunThread(Socket* socket, int reactor_idx) {
+  if (reactor_idx != -1 && FLAGS_rpc_pin_reactor_threads) {
+    WARN_NOT_OK(PinCurrentThreadToCpu(reactor_idx % base::NumCPUs()),
+                "Unable to pin acceptor thread");
+  }
   while (true) {
     Socket new_sock;
     Sockaddr remote;
-    VLOG(2) << "calling accept() on socket " << socket_.GetFd()
+    VLOG(2) << "calling accept() on socket " << socket->GetFd()
             << " listening on " << bind_address_.ToString();
-    Status s = socket_.Accept(&new_sock, &remote, Socket::FLAG_NONBLOCKING);
+    Status s = socket->Accept(&new_sock, &remote, Socket::FLAG_NONBLOCKING);
     if (!s.ok()) {
       if (Release_Load(&closing_)) {
         break;
@@ -145,7 +192,11 @@ void AcceptorPool::RunThread() {
       continue;
     }
     rpc_connections_accepted_->Increment();
-    messenger_->RegisterInboundSocket(&new_sock, remote);
+    if (reactor_idx != -1) {
+      messenger_->RegisterInboundSocket(&new_sock, remote, reactor_idx);
+    } else {
+      messenger_->RegisterInboundSocket(&new_sock, remote);
+    }
   }
   VLOG(1) << "AcceptorPool shutting down.";
 }
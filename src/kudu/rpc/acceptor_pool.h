@@ -18,6 +18,7 @@
 #ifndef KUDU_RPC_ACCEPTOR_POOL_H
 #define KUDU_RPC_ACCEPTOR_POOL_H
 
+#include <memory>
 #include <vector>
 
 #include "kudu/gutil/atomicops.h"
@@ -47,6 +48,11 @@ class AcceptorPool {
   ~AcceptorPool();
 
   // Start listening and accepting connections.
+  //
+  // With --rpc_acceptor_reuseport, the pool instead listens on one socket per
+  // reactor of the messenger, all bound to the same address, and accepts the
+  // connections of each socket with one thread which hands them to its
+  // reactor. 'num_threads' is then ignored.
   Status Start(int num_threads);
   void Shutdown();
 
@@ -60,10 +66,17 @@ class AcceptorPool {
   Status GetBoundAddress(Sockaddr* addr) const;
 
  private:
-  void RunThread();
+  // Starts a thread accepting the connections of 'socket'. If 'reactor_idx'
+  // is not -1, the connections are served by that reactor.
+  Status StartThread(Socket* socket, int reactor_idx);
+
+  void RunThread(Socket* socket, int reactor_idx);
 
   Messenger *messenger_;
   Socket socket_;
+  // With --rpc_acceptor_reuseport, the sockets of the reactors other than
+  // the first one, which uses 'socket_'.
+  std::vector<std::unique_ptr<Socket>> reactor_sockets_;
   Sockaddr bind_address_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
 
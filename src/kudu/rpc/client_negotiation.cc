@@ -165,8 +165,12 @@ Status ClientNegotiation::Negotiate() {
   // Step 3: if both ends support TLS, do a TLS handshake.
   // TODO(dan): allow the client to require TLS.
   if (tls_context_ && ContainsKey(server_features_, TLS)) {
+    // Sessions are resumed with the same server address only.
+    Sockaddr server_addr;
+    RETURN_NOT_OK(socket_->GetPeerAddress(&server_addr));
     RETURN_NOT_OK(tls_context_->InitiateHandshake(security::TlsHandshakeType::CLIENT,
-                                                  &tls_handshake_));
+                                                  &tls_handshake_,
+                                                  server_addr.ToString()));
 
     // To initiate the TLS handshake, we pretend as if the server sent us an
     // empty TLS_HANDSHAKE token.
@@ -365,8 +369,24 @@ Status ClientNegotiation::HandleTlsHandshake(const NegotiatePB& response) {
   // an Incomplete status.
   RETURN_NOT_OK(s);
 
+  if (!token.empty()) {
+    // The handshake resumed a session, so the client sends the final message,
+    // which the server answers with an empty token.
+    DCHECK(tls_handshake_.session_reused());
+    RETURN_NOT_OK(SendTlsHandshake(std::move(token)));
+    NegotiatePB ack;
+    faststring recv_buf;
+    RETURN_NOT_OK(RecvNegotiatePB(&ack, &recv_buf));
+    if (PREDICT_FALSE(ack.step() != NegotiatePB::TLS_HANDSHAKE)) {
+      return Status::NotAuthorized("expected TLS_HANDSHAKE step",
+                                   NegotiatePB::NegotiateStep_Name(ack.step()));
+    }
+    if (PREDICT_FALSE(!ack.tls_handshake().empty())) {
+      return Status::NotAuthorized("unexpected TLS handshake token after the handshake");
+    }
+  }
+
   // TLS handshake is finished.
-  DCHECK(token.empty());
   return tls_handshake_.Finish(&socket_);
 }
 
@@ -40,7 +40,9 @@
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
+#include "kudu/rpc/serialization.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
@@ -520,7 +522,8 @@ void Connection::HandleIncomingCall(gscoped_ptr<InboundTransfer> transfer) {
 void Connection::HandleCallResponse(gscoped_ptr<InboundTransfer> transfer) {
   DCHECK(reactor_thread_->IsCurrentThread());
   gscoped_ptr<CallResponse> resp(new CallResponse);
-  CHECK_OK(resp->ParseFrom(std::move(transfer)));
+  CHECK_OK(resp->ParseFrom(std::move(transfer),
+                           reactor_thread_->reactor()->messenger()->compression_time_us()));
 
   CallAwaitingResponse *car_ptr =
     EraseKeyReturnValuePtr(&awaiting_response_, resp->call_id());
@@ -592,6 +595,18 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
           continue;
         }
 
+        // Compress the call now that the server is known to support it.
+        const CompressionCodec* codec = serialization::GetBodyCompressionCodec(
+            RemoteSupportsFeature(COMPRESSION), transfer->TotalLength());
+        if (codec) {
+          Messenger* messenger = reactor_thread_->reactor()->messenger();
+          vector<Slice> slices;
+          if (car->call->CompressBody(codec, &slices, messenger->compression_bytes_saved(),
+                                      messenger->compression_time_us())) {
+            transfer->ResetPayload(slices);
+          }
+        }
+
         car->call->SetSending();
       }
     }
@@ -168,6 +168,11 @@ class Connection : public RefCountedThreadSafe<Connection> {
     remote_features_ = std::move(remote_features);
   }
 
+  // Returns whether the remote end advertised 'feature' during negotiation.
+  bool RemoteSupportsFeature(RpcFeatureFlag feature) const {
+    return remote_features_.count(feature) > 0;
+  }
+
  private:
   friend struct CallAwaitingResponse;
   friend class QueueTransferTask;
@@ -17,31 +17,122 @@
 
 #include "kudu/rpc/inbound_call.h"
 
+#include <gflags/gflags.h>
 #include <glog/stl_logging.h>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/connection.h"
+#include "kudu/rpc/messenger.h"
+#include "kudu/rpc/reactor.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/rpc/rpcz_store.h"
 #include "kudu/rpc/serialization.h"
 #include "kudu/rpc/service_if.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/trace.h"
 
+DEFINE_int32(rpc_trace_sample_percent, 100,
+             "Percentage of the inbound RPCs whose traces record messages. The "
+             "traces of the other RPCs only collect metrics, which saves formatting "
+             "the messages of most requests while still tracing some of the slow "
+             "ones. See also --rpc_trace_sample_method_percents.");
+TAG_FLAG(rpc_trace_sample_percent, experimental);
+TAG_FLAG(rpc_trace_sample_percent, runtime);
+
+DEFINE_string(rpc_trace_sample_method_percents, "",
+              "Comma-separated list of <method>=<percent> pairs which override "
+              "--rpc_trace_sample_percent for the inbound RPCs of the given methods, "
+              "e.g. 'Write=1,Scan=10'.");
+TAG_FLAG(rpc_trace_sample_method_percents, experimental);
+TAG_FLAG(rpc_trace_sample_method_percents, runtime);
+
 using google::protobuf::FieldDescriptor;
 using google::protobuf::io::CodedOutputStream;
 using google::protobuf::Message;
 using google::protobuf::MessageLite;
 using std::shared_ptr;
 using std::vector;
+using std::string;
+using std::unordered_map;
 using strings::Substitute;
 
 namespace kudu {
 namespace rpc {
 
+namespace {
+
+// Parses the value of --rpc_trace_sample_method_percents into 'percents'.
+bool ParseMethodSamplePercents(const string& value, unordered_map<string, int>* percents) {
+  for (StringPiece pair : strings::Split(value, ",", strings::SkipWhitespace())) {
+    vector<string> kv = strings::Split(pair, "=");
+    int percent;
+    if (kv.size() != 2 || kv[0].empty() || !safe_strto32(kv[1], &percent) ||
+        percent < 0 || percent > 100) {
+      return false;
+    }
+    (*percents)[kv[0]] = percent;
+  }
+  return true;
+}
+
+bool ValidateMethodSamplePercents(const char* flagname, const string& value) {
+  unordered_map<string, int> percents;
+  if (ParseMethodSamplePercents(value, &percents)) {
+    return true;
+  }
+  LOG(ERROR) << Substitute("$0 must be a comma-separated list of <method>=<percent> "
+                           "pairs with percentages between 0 and 100, value '$1' "
+                           "is invalid", flagname, value);
+  return false;
+}
+bool dummy = google::RegisterFlagValidator(
+    &FLAGS_rpc_trace_sample_method_percents, &ValidateMethodSamplePercents);
+
+// Returns the percentage of the calls of 'method' whose traces are sampled.
+int TraceSamplePercent(const string& method) {
+  // The parsed value of the per-method flag, re-parsed when it changes.
+  static simple_spinlock lock;
+  static string* parsed_value = new string();
+  static unordered_map<string, int>* method_percents = new unordered_map<string, int>();
+
+  if (PREDICT_TRUE(FLAGS_rpc_trace_sample_method_percents.empty())) {
+    return FLAGS_rpc_trace_sample_percent;
+  }
+  std::lock_guard<simple_spinlock> l(lock);
+  if (FLAGS_rpc_trace_sample_method_percents != *parsed_value) {
+    *parsed_value = FLAGS_rpc_trace_sample_method_percents;
+    method_percents->clear();
+    ParseMethodSamplePercents(*parsed_value, method_percents);
+  }
+  return FindWithDefault(*method_percents, method, FLAGS_rpc_trace_sample_percent);
+}
+
+// Returns whether the trace of the next call of 'method' handled by this
+// thread should record messages. Every thread samples the calls it parses
+// evenly, so that no state is shared between the reactor threads.
+bool ShouldSampleTrace(const string& method) {
+  static __thread uint32_t num_calls = 0;
+  int percent = TraceSamplePercent(method);
+  if (percent >= 100) {
+    return true;
+  }
+  return static_cast<int>(num_calls++ % 100) < percent;
+}
+
+} // anonymous namespace
+
 InboundCall::InboundCall(Connection* conn)
   : conn_(conn),
     sidecars_deleter_(&sidecars_),
@@ -52,10 +143,24 @@ InboundCall::InboundCall(Connection* conn)
 
 InboundCall::~InboundCall() {}
 
+Messenger* InboundCall::messenger() const {
+  return conn_ ? conn_->reactor_thread()->reactor()->messenger() : nullptr;
+}
+
 Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   TRACE_EVENT_FLOW_BEGIN0("rpc", "InboundCall", this);
   TRACE_EVENT0("rpc", "InboundCall::ParseFrom");
-  RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_, &serialized_request_));
+  Slice body;
+  RETURN_NOT_OK(serialization::ParseHeader(transfer->data(), &header_, &body));
+  if (header_.has_compression_codec()) {
+    Messenger* msgr = messenger();
+    RETURN_NOT_OK(serialization::DecompressBody(header_.compression_codec(),
+                                                header_.uncompressed_size(),
+                                                body, &decompressed_request_,
+                                                msgr ? msgr->compression_time_us() : nullptr));
+    body = Slice(decompressed_request_);
+  }
+  RETURN_NOT_OK(serialization::ParseBody(body, &serialized_request_));
 
   // Adopt the service/method info from the header as soon as it's available.
   if (PREDICT_FALSE(!header_.has_remote_method())) {
@@ -66,6 +171,7 @@ Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
                               header_.remote_method().InitializationErrorString());
   }
   remote_method_.FromPB(header_.remote_method());
+  trace_->set_sampled(ShouldSampleTrace(remote_method_.method_name()));
 
   // Retain the buffer that we have a view into.
   transfer_.swap(transfer);
@@ -153,13 +259,37 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
   uint32_t absolute_sidecar_offset = protobuf_msg_size;
   for (RpcSidecar* car : sidecars_) {
     resp_hdr.add_sidecar_offsets(absolute_sidecar_offset);
-    absolute_sidecar_offset += car->AsSlice().size();
+    absolute_sidecar_offset += car->size();
   }
 
   int additional_size = absolute_sidecar_offset - protobuf_msg_size;
   serialization::SerializeMessage(response, &response_msg_buf_,
                                   additional_size, true);
   int main_msg_size = additional_size + response_msg_buf_.size();
+
+  // Compress the response if the client negotiated support for it.
+  compressed_response_buf_.clear();
+  const CompressionCodec* codec = serialization::GetBodyCompressionCodec(
+      conn_ && conn_->RemoteSupportsFeature(COMPRESSION), main_msg_size);
+  if (codec) {
+    vector<Slice> body;
+    body.reserve(1 + sidecars_.size());
+    body.emplace_back(response_msg_buf_);
+    for (RpcSidecar* car : sidecars_) {
+      car->AppendSlices(&body);
+    }
+    Messenger* msgr = messenger();
+    if (serialization::CompressBody(codec, body, main_msg_size, &compressed_response_buf_,
+                                    msgr ? msgr->compression_bytes_saved() : nullptr,
+                                    msgr ? msgr->compression_time_us() : nullptr)) {
+      resp_hdr.set_compression_codec(codec->type());
+      resp_hdr.set_uncompressed_size(main_msg_size);
+      main_msg_size = compressed_response_buf_.size();
+    } else {
+      compressed_response_buf_.clear();
+    }
+  }
+
   serialization::SerializeHeader(resp_hdr, main_msg_size,
                                  &response_hdr_buf_);
 }
@@ -168,11 +298,17 @@ void InboundCall::SerializeResponseTo(vector<Slice>* slices) const {
   TRACE_EVENT0("rpc", "InboundCall::SerializeResponseTo");
   CHECK_GT(response_hdr_buf_.size(), 0);
   CHECK_GT(response_msg_buf_.size(), 0);
+  if (!compressed_response_buf_.empty()) {
+    // The main message and the sidecars are all part of the compressed body.
+    slices->push_back(Slice(response_hdr_buf_));
+    slices->push_back(Slice(compressed_response_buf_));
+    return;
+  }
   slices->reserve(slices->size() + 2 + sidecars_.size());
   slices->push_back(Slice(response_hdr_buf_));
   slices->push_back(Slice(response_msg_buf_));
   for (RpcSidecar* car : sidecars_) {
-    slices->push_back(car->AsSlice());
+    car->AppendSlices(slices);
   }
 }
 
@@ -254,8 +390,12 @@ void InboundCall::RecordHandlingCompleted() {
   }
 
   if (method_info_) {
-    method_info_->handler_latency_histogram->Increment(
-        (timing_.time_completed - timing_.time_handled).ToMicroseconds());
+    int64_t latency_us = (timing_.time_completed - timing_.time_handled).ToMicroseconds();
+    method_info_->handler_latency_histogram->Increment(latency_us);
+    // Racing updates may lose a sample, which doesn't matter for an average.
+    int64_t avg_us = method_info_->handler_latency_avg_us.load(std::memory_order_relaxed);
+    method_info_->handler_latency_avg_us.store(avg_us + (latency_us - avg_us) / 8,
+                                               std::memory_order_relaxed);
   }
 }
 
@@ -269,6 +409,15 @@ bool InboundCall::ClientTimedOut() const {
   return total_time > header_.timeout_millis();
 }
 
+bool InboundCall::ClientDeadlineUnreachable() const {
+  if (!method_info_ || !header_.has_timeout_millis() || header_.timeout_millis() == 0) {
+    return false;
+  }
+  MonoDelta expected_latency = MonoDelta::FromMicroseconds(
+      method_info_->handler_latency_avg_us.load(std::memory_order_relaxed));
+  return MonoTime::Now() + expected_latency > GetClientDeadline();
+}
+
 MonoTime InboundCall::GetClientDeadline() const {
   if (!header_.has_timeout_millis() || header_.timeout_millis() == 0) {
     return MonoTime::Max();
@@ -49,6 +49,7 @@ namespace rpc {
 
 class Connection;
 class DumpRunningRpcsRequestPB;
+class Messenger;
 class RpcCallInProgressPB;
 struct RpcMethodInfo;
 class RpcSidecar;
@@ -175,6 +176,10 @@ class InboundCall {
   // call response will be ignored anyway.
   bool ClientTimedOut() const;
 
+  // Return true if the client deadline is likely to elapse before the call
+  // is handled, given the average time spent handling calls of its method.
+  bool ClientDeadlineUnreachable() const;
+
   // Return an upper bound on the client timeout deadline. This does not
   // account for transmission delays between the client and the server.
   // If the client did not specify a deadline, returns MonoTime::Max().
@@ -194,6 +199,9 @@ class InboundCall {
   void Respond(const google::protobuf::MessageLite& response,
                bool is_success);
 
+  // Returns the messenger of the call's connection, or NULL if there is none.
+  Messenger* messenger() const;
+
   // Serialize a response message for either success or failure. If it is a success,
   // 'response' should be the user-defined response type for the call. If it is a
   // failure, 'response' should be an ErrorStatusPB instance.
@@ -221,9 +229,15 @@ class InboundCall {
   // by 'serialized_request_' above.
   gscoped_ptr<InboundTransfer> transfer_;
 
+  // The decompressed request body, if the request was compressed. In that
+  // case, 'serialized_request_' refers to this rather than to 'transfer_'.
+  faststring decompressed_request_;
+
   // The buffers for serialized response. Set by SerializeResponseBuffer().
   faststring response_hdr_buf_;
   faststring response_msg_buf_;
+  // The compressed main message and sidecars, if the response is compressed.
+  faststring compressed_response_buf_;
 
   // Vector of additional sidecars that are tacked on to the call's response
   // after serialization of the protobuf. See rpc/rpc_sidecar.h for more info.
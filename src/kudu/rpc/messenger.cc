@@ -70,6 +70,17 @@ DEFINE_int32(rpc_default_keepalive_time_ms, 65000,
              "If an RPC connection from a client is idle for this amount of time, the server "
              "will disconnect the client.");
 
+METRIC_DEFINE_counter(server, rpc_compression_bytes_saved,
+                      "RPC Compression Bytes Saved",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes saved by compressing the bodies of outbound "
+                      "RPC requests and responses");
+METRIC_DEFINE_counter(server, rpc_compression_time_us,
+                      "RPC Compression Time",
+                      kudu::MetricUnit::kMicroseconds,
+                      "Microseconds spent compressing and decompressing the bodies "
+                      "of RPC requests and responses");
+
 TAG_FLAG(rpc_ssl_server_certificate, experimental);
 TAG_FLAG(rpc_ssl_private_key, experimental);
 TAG_FLAG(rpc_ssl_certificate_authority, experimental);
@@ -83,6 +94,8 @@ DEFINE_bool(server_require_kerberos, false,
 // it's a useful stop-gap.
 TAG_FLAG(server_require_kerberos, experimental);
 
+DECLARE_bool(rpc_acceptor_reuseport);
+
 namespace kudu {
 namespace rpc {
 
@@ -199,6 +212,9 @@ Status Messenger::AddAcceptorPool(const Sockaddr &accept_addr,
   Socket sock;
   RETURN_NOT_OK(sock.Init(0));
   RETURN_NOT_OK(sock.SetReuseAddr(true));
+  if (FLAGS_rpc_acceptor_reuseport) {
+    RETURN_NOT_OK(sock.SetReusePort(true));
+  }
   RETURN_NOT_OK(sock.Bind(accept_addr));
   Sockaddr remote;
   RETURN_NOT_OK(sock.GetSocketAddress(&remote));
@@ -267,12 +283,21 @@ void Messenger::RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote
   reactor->RegisterInboundSocket(new_socket, remote);
 }
 
+void Messenger::RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote,
+                                      int reactor_idx) {
+  reactors_[reactor_idx % reactors_.size()]->RegisterInboundSocket(new_socket, remote);
+}
+
 Messenger::Messenger(const MessengerBuilder &bld)
   : name_(bld.name_),
     closing_(false),
     rpcz_store_(new RpczStore()),
     metric_entity_(bld.metric_entity_),
     retain_self_(this) {
+  if (metric_entity_) {
+    compression_bytes_saved_ = METRIC_rpc_compression_bytes_saved.Instantiate(metric_entity_);
+    compression_time_us_ = METRIC_rpc_compression_time_us.Instantiate(metric_entity_);
+  }
   for (int i = 0; i < bld.num_reactors_; i++) {
     reactors_.push_back(new Reactor(retain_self_, i, bld));
   }
@@ -174,6 +174,10 @@ class Messenger {
   // Take ownership of the socket via Socket::Release
   void RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote);
 
+  // Like the above, but serves the connection on the reactor numbered
+  // 'reactor_idx' rather than on the one picked by its remote address.
+  void RegisterInboundSocket(Socket *new_socket, const Sockaddr &remote, int reactor_idx);
+
   // Dump the current RPCs into the given protobuf.
   Status DumpRunningRpcs(const DumpRunningRpcsRequestPB& req,
                          DumpRunningRpcsResponsePB* resp);
@@ -206,6 +210,11 @@ class Messenger {
 
   scoped_refptr<MetricEntity> metric_entity() const { return metric_entity_.get(); }
 
+  // Counters of the compression of RPC bodies sent and received through this
+  // messenger, or NULL if it has no metric entity.
+  Counter* compression_bytes_saved() const { return compression_bytes_saved_.get(); }
+  Counter* compression_time_us() const { return compression_time_us_.get(); }
+
   const scoped_refptr<RpcService> rpc_service(const std::string& service_name) const;
 
  private:
@@ -250,6 +259,9 @@ class Messenger {
 
   scoped_refptr<MetricEntity> metric_entity_;
 
+  scoped_refptr<Counter> compression_bytes_saved_;
+  scoped_refptr<Counter> compression_time_us_;
+
   // The ownership of the Messenger object is somewhat subtle. The pointer graph
   // looks like this:
   //
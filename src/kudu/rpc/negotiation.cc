@@ -52,6 +52,14 @@ DEFINE_int32(rpc_negotiation_inject_delay_ms, 0,
              "the RPC negotiation process on the server side.");
 TAG_FLAG(rpc_negotiation_inject_delay_ms, unsafe);
 
+DEFINE_bool(rpc_skip_tls_for_loopback_connections, false,
+            "Whether RPC connections between a client and a server on the same host "
+            "skip the TLS handshake, and so are not encrypted. The client is still "
+            "authenticated through SASL. Since neither end offers TLS on such "
+            "connections, setting this on either the client or the server suffices.");
+TAG_FLAG(rpc_skip_tls_for_loopback_connections, experimental);
+TAG_FLAG(rpc_skip_tls_for_loopback_connections, runtime);
+
 DECLARE_bool(server_require_kerberos);
 
 using strings::Substitute;
@@ -154,10 +162,13 @@ static Status DoClientNegotiation(Connection* conn, MonoTime deadline) {
   }
 
   RETURN_NOT_OK(client_negotiation.EnablePlain(conn->user_credentials().real_user(), ""));
-  client_negotiation.EnableTls(&conn->reactor_thread()->reactor()->messenger()->tls_context());
   client_negotiation.set_deadline(deadline);
 
   RETURN_NOT_OK(WaitForClientConnect(client_negotiation.socket(), deadline));
+  if (!FLAGS_rpc_skip_tls_for_loopback_connections ||
+      !client_negotiation.socket()->IsLoopbackConnection()) {
+    client_negotiation.EnableTls(&conn->reactor_thread()->reactor()->messenger()->tls_context());
+  }
   RETURN_NOT_OK(client_negotiation.socket()->SetNonBlocking(false));
   RETURN_NOT_OK(client_negotiation.Negotiate());
   RETURN_NOT_OK(DisableSocketTimeouts(client_negotiation.socket()));
@@ -184,7 +195,9 @@ static Status DoServerNegotiation(Connection* conn, const MonoTime& deadline) {
   } else {
     RETURN_NOT_OK(server_negotiation.EnablePlain());
   }
-  if (conn->reactor_thread()->reactor()->messenger()->server_tls_enabled()) {
+  if (conn->reactor_thread()->reactor()->messenger()->server_tls_enabled() &&
+      (!FLAGS_rpc_skip_tls_for_loopback_connections ||
+       !server_negotiation.socket()->IsLoopbackConnection())) {
     server_negotiation.EnableTls(&conn->reactor_thread()->reactor()->messenger()->tls_context());
   }
   server_negotiation.set_deadline(deadline);
@@ -31,6 +31,7 @@
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/serialization.h"
 #include "kudu/rpc/transfer.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/kernel_stack_watchdog.h"
 
@@ -80,6 +81,7 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
   if (controller_->request_id_) {
     header_.set_allocated_request_id(controller_->request_id_.release());
   }
+  request_payloads_.swap(controller_->request_payloads_);
 }
 
 OutboundCall::~OutboundCall() {
@@ -92,6 +94,9 @@ Status OutboundCall::SerializeTo(vector<Slice>* slices) {
   if (PREDICT_FALSE(param_len == 0)) {
     return Status::InvalidArgument("Must call SetRequestParam() before SerializeTo()");
   }
+  for (const auto& payload : request_payloads_) {
+    param_len += payload->size();
+  }
 
   const MonoDelta &timeout = controller_->timeout();
   if (timeout.Initialized()) {
@@ -102,16 +107,56 @@ Status OutboundCall::SerializeTo(vector<Slice>* slices) {
     header_.add_required_feature_flags(feature);
   }
 
+  if (controller_->priority() != PRIORITY_NORMAL) {
+    header_.set_priority(controller_->priority());
+  }
+
   serialization::SerializeHeader(header_, param_len, &header_buf_);
 
   // Return the concatenated packet.
   slices->push_back(Slice(header_buf_));
   slices->push_back(Slice(request_buf_));
+  for (const auto& payload : request_payloads_) {
+    slices->emplace_back(payload->front(), payload->size());
+  }
   return Status::OK();
 }
 
+bool OutboundCall::CompressBody(const CompressionCodec* codec,
+                                vector<Slice>* slices,
+                                Counter* bytes_saved,
+                                Counter* time_us) {
+  DCHECK_GT(header_buf_.size(), 0) << "Must call SerializeTo() before CompressBody()";
+  vector<Slice> body;
+  body.reserve(1 + request_payloads_.size());
+  body.emplace_back(request_buf_);
+  size_t body_size = request_buf_.size();
+  for (const auto& payload : request_payloads_) {
+    body.emplace_back(payload->front(), payload->size());
+    body_size += payload->size();
+  }
+  if (!serialization::CompressBody(codec, body, body_size, &compressed_buf_,
+                                   bytes_saved, time_us)) {
+    return false;
+  }
+
+  header_.set_compression_codec(codec->type());
+  header_.set_uncompressed_size(body_size);
+  serialization::SerializeHeader(header_, compressed_buf_.size(), &header_buf_);
+
+  slices->clear();
+  slices->push_back(Slice(header_buf_));
+  slices->push_back(Slice(compressed_buf_));
+  return true;
+}
+
 void OutboundCall::SetRequestParam(const Message& message) {
-  serialization::SerializeMessage(message, &request_buf_);
+  // The recorded size of the request includes the payloads appended to it.
+  size_t payloads_size = 0;
+  for (const auto& payload : request_payloads_) {
+    payloads_size += payload->size();
+  }
+  serialization::SerializeMessage(message, &request_buf_, payloads_size);
 }
 
 Status OutboundCall::status() const {
@@ -465,11 +510,20 @@ Status CallResponse::GetSidecar(int idx, Slice* sidecar) const {
   return Status::OK();
 }
 
-Status CallResponse::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
+Status CallResponse::ParseFrom(gscoped_ptr<InboundTransfer> transfer,
+                               Counter* compression_time_us) {
   CHECK(!parsed_);
+  Slice body;
+  RETURN_NOT_OK(serialization::ParseHeader(transfer->data(), &header_, &body));
+  if (header_.has_compression_codec()) {
+    RETURN_NOT_OK(serialization::DecompressBody(header_.compression_codec(),
+                                                header_.uncompressed_size(),
+                                                body, &decompressed_buf_,
+                                                compression_time_us));
+    body = Slice(decompressed_buf_);
+  }
   Slice entire_message;
-  RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_,
-                                            &entire_message));
+  RETURN_NOT_OK(serialization::ParseBody(body, &entire_message));
 
   // Use information from header to extract the payload slices.
   int last = header_.sidecar_offsets_size() - 1;
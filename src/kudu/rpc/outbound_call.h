@@ -25,6 +25,8 @@
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/ref_counted_memory.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/rpc/remote_method.h"
@@ -43,6 +45,10 @@ class Message;
 } // namespace google
 
 namespace kudu {
+
+class CompressionCodec;
+class Counter;
+
 namespace rpc {
 
 class CallResponse;
@@ -152,7 +158,8 @@ class OutboundCall {
 
   ~OutboundCall();
 
-  // Serialize the given request PB into this call's internal storage.
+  // Serialize the given request PB into this call's internal storage, to be
+  // followed by the request payloads of the controller, if any.
   //
   // Because the data is fully serialized by this call, 'req' may be
   // subsequently mutated with no ill effects.
@@ -169,6 +176,17 @@ class OutboundCall {
   // is called first. This is called from the Reactor thread.
   Status SerializeTo(std::vector<Slice>* slices);
 
+  // Compress the body of the call serialized by SerializeTo() with 'codec',
+  // and set 'slices' to the compressed call for the wire. Returns false if
+  // compression doesn't save any space, in which case the call is to be sent
+  // as serialized. See serialization::CompressBody() for 'bytes_saved' and
+  // 'time_us'. This is called from the Reactor thread, once the server is
+  // known to support compression.
+  bool CompressBody(const CompressionCodec* codec,
+                    std::vector<Slice>* slices,
+                    Counter* bytes_saved,
+                    Counter* time_us);
+
   // Callback after the call has been put on the outbound connection queue.
   void SetQueued();
 
@@ -293,6 +311,13 @@ class OutboundCall {
   faststring header_buf_;
   faststring request_buf_;
 
+  // The compressed request body, if compressed. See CompressBody().
+  faststring compressed_buf_;
+
+  // The pre-serialized request fields following 'request_buf_' on the wire.
+  // See RpcController::AddRequestPayload().
+  std::vector<scoped_refptr<RefCountedMemory>> request_payloads_;
+
   // Once a response has been received for this call, contains that response.
   // Otherwise NULL.
   gscoped_ptr<CallResponse> call_response_;
@@ -313,8 +338,10 @@ class CallResponse {
   CallResponse();
 
   // Parse the response received from a call. This must be called before any
-  // other methods on this object.
-  Status ParseFrom(gscoped_ptr<InboundTransfer> transfer);
+  // other methods on this object. The time spent decompressing the response,
+  // if compressed, is added to 'compression_time_us' if it is not NULL.
+  Status ParseFrom(gscoped_ptr<InboundTransfer> transfer,
+                   Counter* compression_time_us = nullptr);
 
   // Return true if the call succeeded.
   bool is_success() const {
@@ -356,6 +383,11 @@ class CallResponse {
   // and sidecar_slices_ refer into its data.
   gscoped_ptr<InboundTransfer> transfer_;
 
+  // The decompressed response body, if the response was compressed, in
+  // which case serialized_response_ and sidecar_slices_ refer into it
+  // rather than into transfer_.
+  faststring decompressed_buf_;
+
   DISALLOW_COPY_AND_ASSIGN(CallResponse);
 };
 
@@ -467,6 +467,12 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
           "  kudu::MetricUnit::kMicroseconds,\n"
           "  \"Microseconds spent handling $rpc_full_name$() RPC requests\",\n"
           "  60000000LU, 2);\n"
+          "\n"
+          "METRIC_DEFINE_counter(server, queue_overflow_$rpc_full_name_plainchars$,\n"
+          "  \"$rpc_full_name$ RPC Queue Overflows\",\n"
+          "  kudu::MetricUnit::kRequests,\n"
+          "  \"Number of $rpc_full_name$() RPC requests dropped because the service \"\n"
+          "  \"queue handling them was full\");\n"
           "\n");
         subs->Pop();
       }
@@ -514,6 +520,8 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
               "    mi->track_result = $track_result$;\n"
               "    mi->handler_latency_histogram =\n"
               "        METRIC_handler_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
+              "    mi->queue_overflow_counter =\n"
+              "        METRIC_queue_overflow_$rpc_full_name_plainchars$.Instantiate(entity);\n"
               "    mi->func = [this](const Message* req, Message* resp, RpcContext* ctx) {\n"
               "      this->$rpc_name$(static_cast<const $request$*>(req),\n"
               "                       static_cast<$response$*>(resp),\n"
@@ -33,6 +33,7 @@
 
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/rpc/client_negotiation.h"
 #include "kudu/rpc/connection.h"
 #include "kudu/rpc/messenger.h"
@@ -47,6 +48,7 @@
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/socket.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/thread_restrictions.h"
@@ -73,6 +75,13 @@ DEFINE_int64(rpc_negotiation_timeout_ms, 15000,
 TAG_FLAG(rpc_negotiation_timeout_ms, advanced);
 TAG_FLAG(rpc_negotiation_timeout_ms, runtime);
 
+DEFINE_bool(rpc_pin_reactor_threads, false,
+            "Whether the thread of the i-th reactor of a messenger is pinned to the "
+            "i-th CPU (modulo the number of CPUs). When --rpc_acceptor_reuseport is "
+            "enabled, the acceptor threads feeding a reactor are pinned to the same "
+            "CPU, so that connections are accepted and served on the same core.");
+TAG_FLAG(rpc_pin_reactor_threads, experimental);
+
 namespace kudu {
 namespace rpc {
 
@@ -310,6 +319,10 @@ bool ReactorThread::IsCurrentThread() const {
 }
 
 void ReactorThread::RunThread() {
+  if (FLAGS_rpc_pin_reactor_threads) {
+    WARN_NOT_OK(PinCurrentThreadToCpu(reactor_->index() % base::NumCPUs()),
+                "Unable to pin reactor thread");
+  }
   ThreadRestrictions::SetWaitAllowed(false);
   ThreadRestrictions::SetIOAllowed(false);
   DVLOG(6) << "Calling ReactorThread::RunThread()...";
@@ -494,6 +507,7 @@ Reactor::Reactor(const shared_ptr<Messenger>& messenger,
                  int index, const MessengerBuilder& bld)
   : messenger_(messenger),
     name_(StringPrintf("%s_R%03d", messenger->name().c_str(), index)),
+    index_(index),
     closing_(false),
     thread_(this, bld) {
 }
@@ -640,6 +654,7 @@ void Reactor::QueueOutboundCall(const shared_ptr<OutboundCall>& call) {
 }
 
 void Reactor::ScheduleReactorTask(ReactorTask *task) {
+  bool was_empty;
   {
     std::unique_lock<LockType> l(lock_);
     if (closing_) {
@@ -648,9 +663,15 @@ void Reactor::ScheduleReactorTask(ReactorTask *task) {
       task->Abort(ShutdownError(false));
       return;
     }
+    was_empty = pending_tasks_.empty();
     pending_tasks_.push_back(*task);
   }
-  thread_.WakeThread();
+  // Only the task making the queue non-empty wakes the reactor thread up:
+  // the tasks queued after it, until the reactor drains the queue, are run
+  // by the same wakeup.
+  if (was_empty) {
+    thread_.WakeThread();
+  }
 }
 
 bool Reactor::DrainTaskQueue(boost::intrusive::list<ReactorTask> *tasks) { // NOLINT(*)
@@ -281,6 +281,9 @@ class Reactor {
 
   const std::string &name() const;
 
+  // The index of the reactor among those of its messenger.
+  int index() const { return index_; }
+
   // Collect metrics about the reactor.
   Status GetMetrics(ReactorMetrics *metrics);
 
@@ -303,6 +306,7 @@ class Reactor {
   // called.
   // Does _not_ take ownership of 'task' -- the task should take care of
   // deleting itself after running if it is allocated on the heap.
+  // Wakes the reactor thread up only if no other task is pending.
   void ScheduleReactorTask(ReactorTask *task);
 
   Status RunOnReactorThread(const boost::function<Status()>& f);
@@ -335,6 +339,8 @@ class Reactor {
 
   const std::string name_;
 
+  const int index_;
+
   // Whether the reactor is shutting down.
   // Guarded by lock_.
   bool closing_;
@@ -228,6 +228,16 @@ ResultTracker::RpcState ResultTracker::TrackRpcOrChangeDriver(const RequestIdPB&
   return RpcState::NEW;
 }
 
+ResultTracker::RpcState ResultTracker::TrackBatchedRpc(const RequestIdPB& request_id,
+                                                       Message* response) {
+  lock_guard<simple_spinlock> l(lock_);
+  RpcState state = TrackRpcUnlocked(request_id, nullptr, nullptr);
+  if (state == RpcState::COMPLETED) {
+    response->CopyFrom(*FindCompletionRecordOrDieUnlocked(request_id)->response);
+  }
+  return state;
+}
+
 bool ResultTracker::IsCurrentDriver(const RequestIdPB& request_id) {
   lock_guard<simple_spinlock> l(lock_);
   CompletionRecord* completion_record = FindCompletionRecordOrNullUnlocked(request_id);
@@ -183,6 +183,20 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   // attempt number in 'request_id' as the driver of the RPC, if it is tracked and IN_PROGRESS.
   RpcState TrackRpcOrChangeDriver(const RequestIdPB& request_id);
 
+  // Tracks a request which is carried by an RPC along with other requests, such as one of
+  // the writes of a MultiWrite RPC, and so has no RpcContext of its own, and returns its
+  // current state.
+  //
+  // If the RpcState == NEW the caller is supposed to actually execute the request, and to
+  // later call RecordCompletionAndRespond() or FailAndRespond() with its response.
+  //
+  // If the RpcState == COMPLETED the previous response is copied into 'response'.
+  //
+  // Unlike TrackRpc(), an IN_PROGRESS request can't be attached to the attempt which is
+  // executing it, so the caller should fail it with an error which makes the client retry.
+  RpcState TrackBatchedRpc(const RequestIdPB& request_id,
+                           google::protobuf::Message* response);
+
   // Checks if the attempt at an RPC identified by 'request_id' is the current driver of the
   // RPC. That is, if the attempt number in 'request_id' corresponds to the attempt marked
   // as the driver of this RPC, either by initially getting NEW from TrackRpc() or by
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <functional>
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
@@ -250,6 +251,57 @@ TEST_F(RpcBench, BenchmarkCallsAsync) {
   SummarizePerf(sw.elapsed(), total_reqs, false);
 }
 
+// Benchmark many threads submitting async calls through the single reactor
+// of a shared client messenger, which stresses the wakeups of the reactor.
+TEST_F(RpcBench, BenchmarkCallsAsyncSharedReactor) {
+  shared_ptr<Messenger> client_messenger = CreateMessenger("Client", 1);
+  CalculatorServiceProxy p(client_messenger, server_addr_);
+  const int calls_per_batch = std::max(1, FLAGS_async_call_concurrency / FLAGS_client_threads);
+
+  Stopwatch sw(Stopwatch::ALL_THREADS);
+  sw.start();
+
+  vector<thread> threads;
+  vector<int> request_counts(FLAGS_client_threads);
+  for (int i = 0; i < FLAGS_client_threads; i++) {
+    threads.emplace_back([&, i]() {
+        vector<AddRequestPB> reqs(calls_per_batch);
+        vector<AddResponsePB> resps(calls_per_batch);
+        vector<RpcController> controllers(calls_per_batch);
+        while (Acquire_Load(&should_run_)) {
+          CountDownLatch latch(calls_per_batch);
+          for (int j = 0; j < calls_per_batch; j++) {
+            controllers[j].Reset();
+            controllers[j].set_timeout(MonoDelta::FromSeconds(10));
+            reqs[j].set_x(j);
+            reqs[j].set_y(i);
+            p.AddAsync(reqs[j], &resps[j], &controllers[j],
+                       [&latch]() { latch.CountDown(); });
+          }
+          latch.Wait();
+          for (int j = 0; j < calls_per_batch; j++) {
+            CHECK_OK(controllers[j].status());
+            CHECK_EQ(j + i, resps[j].result());
+          }
+          request_counts[i] += calls_per_batch;
+        }
+      });
+  }
+
+  SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
+  Release_Store(&should_run_, false);
+
+  int total_reqs = 0;
+  for (int i = 0; i < FLAGS_client_threads; i++) {
+    threads[i].join();
+    total_reqs += request_counts[i];
+  }
+  sw.stop();
+
+  LOG(INFO) << "Client threads sharing one client reactor";
+  SummarizePerf(sw.elapsed(), total_reqs, false);
+}
+
 } // namespace rpc
 } // namespace kudu
 
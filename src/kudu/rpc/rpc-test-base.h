@@ -22,6 +22,7 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/walltime.h"
 #include "kudu/rpc/acceptor_pool.h"
@@ -503,6 +504,10 @@ class RpcTestBase : public KuduTest {
     service_name_ = service->service_name();
     scoped_refptr<MetricEntity> metric_entity = server_messenger_->metric_entity();
     service_pool_ = new ServicePool(std::move(service), metric_entity, service_queue_length_);
+    if (!isolated_methods_.empty()) {
+      ASSERT_OK(service_pool_->AddMethodQueue(isolated_methods_, n_worker_threads_,
+                                              service_queue_length_));
+    }
     server_messenger_->RegisterService(service_name_, service_pool_);
     ASSERT_OK(service_pool_->Init(n_worker_threads_));
   }
@@ -515,6 +520,8 @@ class RpcTestBase : public KuduTest {
   scoped_refptr<ResultTracker> result_tracker_;
   int n_worker_threads_;
   int service_queue_length_;
+  // The methods handled by a queue and threads of their own, if any.
+  std::vector<std::string> isolated_methods_;
   int n_server_reactor_threads_;
   int keepalive_time_ms_;
 
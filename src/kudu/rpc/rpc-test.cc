@@ -26,10 +26,12 @@
 #include <gtest/gtest.h>
 
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/ref_counted_memory.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/serialization.h"
+#include "kudu/rpc/transfer.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/env.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -37,8 +39,15 @@
 
 METRIC_DECLARE_histogram(handler_latency_kudu_rpc_test_CalculatorService_Sleep);
 METRIC_DECLARE_histogram(rpc_incoming_queue_time);
+METRIC_DECLARE_counter(rpc_compression_bytes_saved);
 
+DECLARE_bool(rpc_acceptor_reuseport);
+DECLARE_bool(rpc_pin_reactor_threads);
+DECLARE_bool(rpc_skip_tls_for_loopback_connections);
+DECLARE_int32(rpc_compression_min_size_bytes);
+DECLARE_int32(rpc_message_pool_size);
 DECLARE_int32(rpc_negotiation_inject_delay_ms);
+DECLARE_string(rpc_compression_codec);
 
 using std::shared_ptr;
 using std::string;
@@ -122,6 +131,39 @@ TEST_P(TestRpc, TestCall) {
   }
 }
 
+// Test calls to a server listening on one SO_REUSEPORT socket per reactor,
+// with pinned reactor threads.
+TEST_P(TestRpc, TestReusePortAcceptors) {
+  FLAGS_rpc_acceptor_reuseport = true;
+  FLAGS_rpc_pin_reactor_threads = true;
+  n_server_reactor_threads_ = 4;
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+
+  // Connect from several clients, so that the connections are spread across
+  // the listening sockets.
+  for (int i = 0; i < 8; i++) {
+    shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+    Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+}
+
+// Test calls over loopback connections which skip the TLS handshake.
+TEST_P(TestRpc, TestLoopbackCallsSkipTls) {
+  FLAGS_rpc_skip_tls_for_loopback_connections = true;
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServer(&server_addr, enable_ssl);
+
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+}
+
 // Test that connecting to an invalid server properly throws an error.
 TEST_P(TestRpc, TestCallToBadServer) {
   shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, GetParam()));
@@ -594,6 +636,102 @@ TEST_P(TestRpc, TestApplicationFeatureFlag) {
   }
 }
 
+// Test that request payloads are parsed by the server as fields of the
+// request, including when there are more of them than fit inline in a transfer.
+TEST_P(TestRpc, TestRequestPayloads) {
+  // Set up server.
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServerWithGeneratedCode(&server_addr, enable_ssl);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, CalculatorService::static_service_name());
+
+  for (int num_payloads : { 1, OutboundTransfer::kMaxPayloadSlices * 3 }) {
+    AddRequestPB req;
+    req.set_x(1);
+    req.set_y(1000);
+    AddResponsePB resp;
+    RpcController controller;
+    // Each payload sets 'y' (field 2, varint) again: the last one wins.
+    for (int i = 1; i <= num_payloads; i++) {
+      scoped_refptr<RefCountedString> payload(new RefCountedString());
+      payload->data() = { static_cast<char>(2 << 3), static_cast<char>(i) };
+      controller.AddRequestPayload(payload);
+    }
+    ASSERT_OK(p.SyncRequest("Add", req, &resp, &controller));
+    ASSERT_EQ(1 + num_payloads, resp.result());
+  }
+}
+
+// Test that requests and responses are compressed once both ends negotiated
+// support for it, and that small messages are left alone.
+TEST_P(TestRpc, TestCompressedCalls) {
+  FLAGS_rpc_compression_codec = "LZ4";
+  FLAGS_rpc_compression_min_size_bytes = 1024;
+
+  // Set up server.
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServerWithGeneratedCode(&server_addr, enable_ssl);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, CalculatorService::static_service_name());
+
+  scoped_refptr<Counter> bytes_saved =
+      METRIC_rpc_compression_bytes_saved.Instantiate(metric_entity_);
+  for (int size : { 10, 1024 * 1024 }) {
+    EchoRequestPB req;
+    req.set_data(string(size, 'x'));
+    EchoResponsePB resp;
+    RpcController controller;
+    int64_t saved_before = bytes_saved->value();
+    ASSERT_OK(p.SyncRequest("Echo", req, &resp, &controller));
+    ASSERT_EQ(req.data(), resp.data());
+    if (size < FLAGS_rpc_compression_min_size_bytes) {
+      ASSERT_EQ(saved_before, bytes_saved->value());
+    } else {
+      // Both the request and the response were compressed.
+      ASSERT_GT(bytes_saved->value(), saved_before + size);
+    }
+  }
+}
+
+// Test that the requests and responses reused by later calls don't carry
+// over any of the fields of the earlier ones.
+TEST_P(TestRpc, TestReusedMessages) {
+  FLAGS_rpc_message_pool_size = 1;
+
+  // Set up server.
+  Sockaddr server_addr;
+  bool enable_ssl = GetParam();
+  StartTestServerWithGeneratedCode(&server_addr, enable_ssl);
+
+  // Set up client.
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", 1, enable_ssl));
+  Proxy p(client_messenger, server_addr, CalculatorService::static_service_name());
+
+  for (int i = 0; i < 3; i++) {
+    EchoRequestPB req;
+    req.set_data(string(i % 2 == 0 ? 100 : 10, 'a' + i));
+    EchoResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(p.SyncRequest("Echo", req, &resp, &controller));
+    ASSERT_EQ(req.data(), resp.data());
+
+    // An optional field set in one request must not be seen by the next one.
+    SleepRequestPB sleep_req;
+    sleep_req.set_sleep_micros(1);
+    sleep_req.set_return_app_error(i % 2 == 0);
+    SleepResponsePB sleep_resp;
+    RpcController sleep_controller;
+    Status s = p.SyncRequest("Sleep", sleep_req, &sleep_resp, &sleep_controller);
+    ASSERT_EQ(i % 2 == 0, s.IsRemoteError()) << s.ToString();
+  }
+}
+
 TEST_P(TestRpc, TestApplicationFeatureFlagUnsupportedServer) {
   auto savedFlags = kSupportedServerRpcFeatureFlags;
   auto cleanup = MakeScopedCleanup([&] () { kSupportedServerRpcFeatureFlags = savedFlags; });
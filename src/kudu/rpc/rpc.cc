@@ -17,12 +17,29 @@
 
 #include "kudu/rpc/rpc.h"
 
-#include <boost/bind.hpp>
+#include <algorithm>
 #include <string>
 
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_bool(rpc_backoff_server_busy_retries, false,
+            "Whether RPCs rejected because the server is too busy are retried after an "
+            "exponentially growing, jittered delay, capped at "
+            "--rpc_server_busy_max_backoff_ms, rather than a linearly growing one.");
+TAG_FLAG(rpc_backoff_server_busy_retries, experimental);
+TAG_FLAG(rpc_backoff_server_busy_retries, runtime);
+
+DEFINE_int32(rpc_server_busy_max_backoff_ms, 1000,
+             "Maximum delay before retrying an RPC rejected because the server is too "
+             "busy, when --rpc_backoff_server_busy_retries is enabled.");
+TAG_FLAG(rpc_server_busy_max_backoff_ms, experimental);
+TAG_FLAG(rpc_server_busy_max_backoff_ms, runtime);
 
 using std::shared_ptr;
 using strings::Substitute;
@@ -38,20 +55,25 @@ bool RpcRetrier::HandleResponse(Rpc* rpc, Status* out_status) {
 
   // Always retry a TOO_BUSY error.
   Status controller_status = controller_.status();
-  if (controller_status.IsRemoteError()) {
-    const ErrorStatusPB* err = controller_.error_response();
-    if (err &&
-        err->has_code() &&
-        err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY) {
-      DelayedRetry(rpc, controller_status);
-      return true;
-    }
+  if (ServerTooBusy()) {
+    DelayedRetry(rpc, controller_status);
+    return true;
   }
 
   *out_status = controller_status;
   return false;
 }
 
+bool RpcRetrier::ServerTooBusy() const {
+  if (!controller_.status().IsRemoteError()) {
+    return false;
+  }
+  const ErrorStatusPB* err = controller_.error_response();
+  return err &&
+      err->has_code() &&
+      err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY;
+}
+
 void RpcRetrier::DelayedRetry(Rpc* rpc, const Status& why_status) {
   if (!why_status.ok() && (last_error_.ok() || last_error_.IsTimedOut())) {
     last_error_ = why_status;
@@ -61,6 +83,13 @@ void RpcRetrier::DelayedRetry(Rpc* rpc, const Status& why_status) {
   // If the delay causes us to miss our deadline, RetryCb will fail the
   // RPC on our behalf.
   int num_ms = ++attempt_num_ + ((rand() % 5));
+  if (FLAGS_rpc_backoff_server_busy_retries && ServerTooBusy()) {
+    // Back off exponentially from an overloaded server, with enough jitter
+    // that the clients it rejected at once don't retry at once.
+    int max_ms = std::max(2, std::min(FLAGS_rpc_server_busy_max_backoff_ms,
+                                      2 << std::min(num_busy_retries_++, 20)));
+    num_ms = max_ms / 2 + rand() % (max_ms / 2 + 1);
+  }
   messenger_->ScheduleOnReactor(boost::bind(&RpcRetrier::DelayedRetryCb,
                                             this,
                                             rpc, _1),
@@ -99,6 +99,7 @@ class RpcRetrier {
  public:
   RpcRetrier(MonoTime deadline, std::shared_ptr<rpc::Messenger> messenger)
       : attempt_num_(1),
+        num_busy_retries_(0),
         deadline_(std::move(deadline)),
         messenger_(std::move(messenger)) {
     if (deadline_.Initialized()) {
@@ -142,9 +143,17 @@ class RpcRetrier {
   void DelayedRetryCb(Rpc* rpc, const Status& status);
 
  private:
+  // Returns whether the last attempt was rejected because the server was
+  // too busy.
+  bool ServerTooBusy() const;
+
   // The next sent rpc will be the nth attempt (indexed from 1).
   int attempt_num_;
 
+  // The number of retries after the server was too busy, which determines
+  // the backoff of the next one, see --rpc_backoff_server_busy_retries.
+  int num_busy_retries_;
+
   // If the remote end is busy, the RPC will be retried (with a small
   // delay) until this deadline is reached.
   //
@@ -42,6 +42,8 @@ RpcContext::RpcContext(InboundCall *call,
   : call_(CHECK_NOTNULL(call)),
     request_pb_(request_pb),
     response_pb_(response_pb),
+    method_info_(call->method_info()),
+    request_size_(call->serialized_request().size()),
     result_tracker_(result_tracker) {
   VLOG(4) << call_->remote_method().service_name() << ": Received RPC request for "
           << call_->ToString() << ":" << std::endl << SecureDebugString(*request_pb_);
@@ -51,6 +53,10 @@ RpcContext::RpcContext(InboundCall *call,
 }
 
 RpcContext::~RpcContext() {
+  if (method_info_) {
+    method_info_->req_pool.Put(const_cast<Message*>(request_pb_.release()), request_size_);
+    method_info_->resp_pool.Put(response_pb_.release());
+  }
 }
 
 void RpcContext::RespondSuccess() {
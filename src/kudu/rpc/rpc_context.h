@@ -197,8 +197,13 @@ class RpcContext {
  private:
   friend class ResultTracker;
   InboundCall* const call_;
-  const gscoped_ptr<const google::protobuf::Message> request_pb_;
-  const gscoped_ptr<google::protobuf::Message> response_pb_;
+  gscoped_ptr<const google::protobuf::Message> request_pb_;
+  gscoped_ptr<google::protobuf::Message> response_pb_;
+  // The method of the call, whose pools take the request and response back
+  // once the call completes. The call itself may be gone by then.
+  const scoped_refptr<RpcMethodInfo> method_info_;
+  // The serialized size of the request.
+  const size_t request_size_;
   scoped_refptr<ResultTracker> result_tracker_;
 };
 
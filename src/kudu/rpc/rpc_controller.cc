@@ -26,7 +26,8 @@
 
 namespace kudu { namespace rpc {
 
-RpcController::RpcController() {
+RpcController::RpcController()
+    : priority_(PRIORITY_NORMAL) {
   DVLOG(4) << "RpcController " << this << " constructed";
 }
 
@@ -44,6 +45,7 @@ void RpcController::Swap(RpcController* other) {
   }
 
   std::swap(timeout_, other->timeout_);
+  std::swap(priority_, other->priority_);
   std::swap(call_, other->call_);
 }
 
@@ -53,6 +55,7 @@ void RpcController::Reset() {
     CHECK(finished());
   }
   call_.reset();
+  request_payloads_.clear();
 }
 
 bool RpcController::finished() const {
@@ -90,10 +93,24 @@ void RpcController::set_deadline(const MonoTime& deadline) {
   set_timeout(deadline - MonoTime::Now());
 }
 
+void RpcController::set_priority(RpcPriority priority) {
+  DCHECK(!call_ || call_->state() == OutboundCall::READY);
+  priority_ = priority;
+}
+
+RpcPriority RpcController::priority() const {
+  return priority_;
+}
+
 void RpcController::SetRequestIdPB(std::unique_ptr<RequestIdPB> request_id) {
   request_id_ = std::move(request_id);
 }
 
+void RpcController::AddRequestPayload(scoped_refptr<RefCountedMemory> payload) {
+  DCHECK(!call_ || call_->state() == OutboundCall::READY);
+  request_payloads_.emplace_back(std::move(payload));
+}
+
 bool RpcController::has_request_id() const {
   return request_id_ != nullptr;
 }
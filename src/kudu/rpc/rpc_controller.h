@@ -21,8 +21,12 @@
 #include <glog/logging.h>
 #include <memory>
 #include <unordered_set>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/ref_counted_memory.h"
+#include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
@@ -104,6 +108,13 @@ class RpcController {
   // Using an uninitialized deadline means the call won't time out.
   void set_deadline(const MonoTime& deadline);
 
+  // Sets the scheduling class of the calls sent with this controller. Calls
+  // are sent with PRIORITY_NORMAL unless set otherwise.
+  void set_priority(RpcPriority priority);
+
+  // Returns the scheduling class of the calls sent with this controller.
+  RpcPriority priority() const;
+
   // Allows settting the request id for the next request sent to the server.
   // A request id allows the server to identify each request sent by the client uniquely,
   // in some cases even when sent to multiple servers, enabling exactly once semantics.
@@ -118,6 +129,18 @@ class RpcController {
   // REQUIRES: the controller has a request ID set.
   const RequestIdPB& request_id() const;
 
+  // Appends 'payload' to the serialized request of the next call sent with
+  // this controller. 'payload' must be the wire encoding of one or more fields
+  // of the request message: since protobuf parsers merge concatenated
+  // encodings, the server parses the request as if these fields were set in
+  // it. This allows sending a field which was serialized once in several
+  // requests, without copying or serializing it again for each request.
+  //
+  // The payloads are referenced, not copied, until the call is destroyed.
+  // Like the request id, they get "moved" from the RpcController when the
+  // request is sent.
+  void AddRequestPayload(scoped_refptr<RefCountedMemory> payload);
+
   // Add a requirement that the server side must support a feature with the
   // given identifier. The set of required features is sent to the server
   // with the RPC call, and if any required feature is not supported, the
@@ -183,6 +206,7 @@ class RpcController {
   friend class Proxy;
 
   MonoDelta timeout_;
+  RpcPriority priority_;
   std::unordered_set<uint32_t> required_server_features_;
 
   mutable simple_spinlock lock_;
@@ -191,6 +215,10 @@ class RpcController {
   // Ownership is transfered to OutboundCall once the call is sent.
   std::unique_ptr<RequestIdPB> request_id_;
 
+  // The pre-serialized fields to append to the request.
+  // Ownership is transfered to OutboundCall once the call is sent.
+  std::vector<scoped_refptr<RefCountedMemory>> request_payloads_;
+
   // Once the call is sent, it is tracked here.
   std::shared_ptr<OutboundCall> call_;
 
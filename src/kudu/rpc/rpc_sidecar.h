@@ -17,6 +17,9 @@
 #ifndef KUDU_RPC_RPC_SIDECAR_H
 #define KUDU_RPC_RPC_SIDECAR_H
 
+#include <memory>
+#include <vector>
+
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/slice.h"
@@ -32,9 +35,9 @@ namespace rpc {
 // The RpcSidecar saves on an additional copy to/from the protobuf on both the
 // server and client side. The InboundCall class accepts RpcSidecars, ignorant
 // of the form that the sidecar's data is kept in, requiring only that it can
-// be represented as a Slice. Data is then immediately copied from the
-// Slice returned from AsSlice() to the socket that is responding to the original
-// RPC.
+// be represented as a list of Slices. Data is then immediately copied from the
+// Slices returned from AppendSlices() to the socket that is responding to the
+// original RPC.
 //
 // In order to distinguish between separate sidecars, whenever a sidecar is
 // added to the RPC response on the server side, an index for that sidecar is
@@ -52,13 +55,37 @@ namespace rpc {
 class RpcSidecar {
  public:
   // Generates a sidecar with the parameter faststring as its data.
-  explicit RpcSidecar(gscoped_ptr<faststring> data) : data_(std::move(data)) {}
+  explicit RpcSidecar(gscoped_ptr<faststring> data)
+      : data_(std::move(data)),
+        slices_({ Slice(*data_) }),
+        size_(data_->size()) {
+  }
+
+  // Generates a sidecar whose data is the concatenation of 'slices'. The data
+  // isn't copied: 'owner' must keep it alive, and is released along with the
+  // sidecar once the response has been sent.
+  RpcSidecar(std::vector<Slice> slices, std::shared_ptr<void> owner)
+      : slices_(std::move(slices)),
+        owner_(std::move(owner)),
+        size_(0) {
+    for (const Slice& s : slices_) {
+      size_ += s.size();
+    }
+  }
+
+  // Returns the size of the sidecar's data.
+  size_t size() const { return size_; }
 
-  // Returns a Slice representation of the sidecar's data.
-  Slice AsSlice() const { return *data_; }
+  // Appends the Slices holding the sidecar's data to 'slices'.
+  void AppendSlices(std::vector<Slice>* slices) const {
+    slices->insert(slices->end(), slices_.begin(), slices_.end());
+  }
 
  private:
   const gscoped_ptr<faststring> data_;
+  const std::vector<Slice> slices_;
+  const std::shared_ptr<void> owner_;
+  size_t size_;
 
   DISALLOW_COPY_AND_ASSIGN(RpcSidecar);
 };
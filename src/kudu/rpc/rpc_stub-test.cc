@@ -39,8 +39,16 @@
 #include "kudu/util/user.h"
 
 DEFINE_bool(is_panic_test_child, false, "Used by TestRpcPanic");
+DECLARE_bool(rpc_service_queue_by_priority);
+DECLARE_int32(rpc_admission_queue_delay_interval_ms);
+DECLARE_int32(rpc_admission_queue_delay_target_ms);
 DECLARE_bool(socket_inject_short_recvs);
 
+METRIC_DECLARE_histogram(rpc_incoming_queue_time_high_priority);
+METRIC_DECLARE_histogram(rpc_incoming_queue_time_low_priority);
+METRIC_DECLARE_counter(queue_overflow_kudu_rpc_test_CalculatorService_Add);
+METRIC_DECLARE_counter(queue_overflow_kudu_rpc_test_CalculatorService_Sleep);
+
 using std::shared_ptr;
 using std::unique_ptr;
 using std::vector;
@@ -439,6 +447,167 @@ TEST_F(RpcStubTest, TestDontHandleTimedOutCalls) {
   ASSERT_EQ(1, timed_out_in_queue->value());
 }
 
+class RpcStubPriorityTest : public RpcStubTest {
+ public:
+  virtual void SetUp() OVERRIDE {
+    FLAGS_rpc_service_queue_by_priority = true;
+    RpcStubTest::SetUp();
+  }
+};
+
+// Test that queued calls of a higher priority class are handled first, even
+// if their deadline is later.
+TEST_F(RpcStubPriorityTest, TestHigherPriorityCallsFirst) {
+  CalculatorServiceProxy p(client_messenger_, server_addr_);
+  vector<AsyncSleep*> sleeps;
+  ElementDeleter d(&sleeps);
+
+  // Occupy the worker threads, which then free up one at a time, 200ms apart.
+  for (int i = 0; i < n_worker_threads_; i++) {
+    gscoped_ptr<AsyncSleep> sleep(new AsyncSleep);
+    sleep->rpc.set_timeout(MonoDelta::FromSeconds(10));
+    sleep->req.set_sleep_micros((i + 1) * 200 * 1000);
+    p.SleepAsync(sleep->req, &sleep->resp, &sleep->rpc,
+                 boost::bind(&CountDownLatch::CountDown, &sleep->latch));
+    sleeps.push_back(sleep.release());
+  }
+  const Histogram* queue_time_metric = service_pool_->IncomingQueueTimeMetricForTests();
+  while (queue_time_metric->TotalCount() < n_worker_threads_) {
+    SleepFor(MonoDelta::FromMilliseconds(1));
+  }
+
+  // Queue a low priority call with an early deadline, then a high priority
+  // one with a later deadline.
+  AsyncSleep low;
+  low.rpc.set_timeout(MonoDelta::FromSeconds(5));
+  low.rpc.set_priority(PRIORITY_LOW);
+  low.req.set_sleep_micros(1000);
+  p.SleepAsync(low.req, &low.resp, &low.rpc,
+               boost::bind(&CountDownLatch::CountDown, &low.latch));
+  AsyncSleep high;
+  high.rpc.set_timeout(MonoDelta::FromSeconds(10));
+  high.rpc.set_priority(PRIORITY_HIGH);
+  high.req.set_sleep_micros(1000);
+  p.SleepAsync(high.req, &high.resp, &high.rpc,
+               boost::bind(&CountDownLatch::CountDown, &high.latch));
+
+  // The high priority call takes the first free worker.
+  high.latch.Wait();
+  ASSERT_EQ(1, low.latch.count());
+  low.latch.Wait();
+  ASSERT_OK(high.rpc.status());
+  ASSERT_OK(low.rpc.status());
+  for (AsyncSleep* s : sleeps) {
+    s->latch.Wait();
+  }
+
+  ASSERT_EQ(1, METRIC_rpc_incoming_queue_time_high_priority.Instantiate(
+      server_messenger_->metric_entity())->TotalCount());
+  ASSERT_EQ(1, METRIC_rpc_incoming_queue_time_low_priority.Instantiate(
+      server_messenger_->metric_entity())->TotalCount());
+}
+
+class RpcStubMethodQueueTest : public RpcStubTest {
+ public:
+  virtual void SetUp() OVERRIDE {
+    n_worker_threads_ = 1;
+    service_queue_length_ = 1;
+    isolated_methods_ = { "Add" };
+    RpcStubTest::SetUp();
+  }
+};
+
+// Test that the calls of a method with its own queue are handled while the
+// other methods of the service overflow their queue.
+TEST_F(RpcStubMethodQueueTest, TestIsolatedMethod) {
+  CalculatorServiceProxy p(client_messenger_, server_addr_);
+  vector<AsyncSleep*> sleeps;
+  ElementDeleter d(&sleeps);
+
+  // Occupy the only worker of the service queue, then fill the queue and
+  // overflow it.
+  for (int i = 0; i < 3; i++) {
+    gscoped_ptr<AsyncSleep> sleep(new AsyncSleep);
+    sleep->rpc.set_timeout(MonoDelta::FromSeconds(10 + i));
+    sleep->req.set_sleep_micros(500 * 1000);
+    p.SleepAsync(sleep->req, &sleep->resp, &sleep->rpc,
+                 boost::bind(&CountDownLatch::CountDown, &sleep->latch));
+    sleeps.push_back(sleep.release());
+    if (i == 0) {
+      const Histogram* queue_time_metric = service_pool_->IncomingQueueTimeMetricForTests();
+      while (queue_time_metric->TotalCount() < 1) {
+        SleepFor(MonoDelta::FromMilliseconds(1));
+      }
+    }
+  }
+  sleeps[2]->latch.Wait();
+  ASSERT_TRUE(sleeps[2]->rpc.status().IsRemoteError());
+
+  // Add is handled by its own worker in the meantime.
+  AddRequestPB req;
+  req.set_x(1);
+  req.set_y(2);
+  AddResponsePB resp;
+  RpcController controller;
+  ASSERT_OK(p.Add(req, &resp, &controller));
+  ASSERT_EQ(3, resp.result());
+  ASSERT_EQ(1, sleeps[0]->latch.count());
+
+  for (AsyncSleep* s : sleeps) {
+    s->latch.Wait();
+  }
+  ASSERT_OK(sleeps[0]->rpc.status());
+  ASSERT_OK(sleeps[1]->rpc.status());
+
+  // The overflow counters of the methods are instantiated by the service.
+  ASSERT_EQ(1, METRIC_queue_overflow_kudu_rpc_test_CalculatorService_Sleep.Instantiate(
+      metric_entity_)->value());
+  ASSERT_EQ(0, METRIC_queue_overflow_kudu_rpc_test_CalculatorService_Add.Instantiate(
+      metric_entity_)->value());
+}
+
+// Test that new calls are rejected once the calls wait in the service queue
+// for longer than the admission control target.
+TEST_F(RpcStubTest, TestAdmissionControl) {
+  FLAGS_rpc_admission_queue_delay_target_ms = 5;
+  FLAGS_rpc_admission_queue_delay_interval_ms = 10;
+  CalculatorServiceProxy p(client_messenger_, server_addr_);
+  vector<AsyncSleep*> sleeps;
+  ElementDeleter d(&sleeps);
+
+  // Queue enough calls that each of them waits for longer than the target.
+  const int kNumCalls = n_worker_threads_ * 10;
+  for (int i = 0; i < kNumCalls; i++) {
+    gscoped_ptr<AsyncSleep> sleep(new AsyncSleep);
+    sleep->rpc.set_timeout(MonoDelta::FromSeconds(10));
+    sleep->req.set_sleep_micros(30 * 1000);
+    p.SleepAsync(sleep->req, &sleep->resp, &sleep->rpc,
+                 boost::bind(&CountDownLatch::CountDown, &sleep->latch));
+    sleeps.push_back(sleep.release());
+  }
+  const Histogram* queue_time_metric = service_pool_->IncomingQueueTimeMetricForTests();
+  while (queue_time_metric->TotalCount() < n_worker_threads_ * 3) {
+    SleepFor(MonoDelta::FromMilliseconds(1));
+  }
+
+  // The queue is now overloaded, so a new call is rejected right away.
+  SleepRequestPB req;
+  req.set_sleep_micros(1000);
+  SleepResponsePB resp;
+  RpcController controller;
+  controller.set_timeout(MonoDelta::FromSeconds(10));
+  Status s = p.Sleep(req, &resp, &controller);
+  ASSERT_TRUE(s.IsRemoteError()) << s.ToString();
+  ASSERT_EQ(ErrorStatusPB::ERROR_SERVER_TOO_BUSY, controller.error_response()->code());
+  ASSERT_EQ(1, service_pool_->RpcsRejectedByAdmissionControlMetricForTests()->value());
+
+  // The calls admitted before are all handled.
+  for (AsyncSleep* sleep : sleeps) {
+    sleep->latch.Wait();
+    ASSERT_OK(sleep->rpc.status());
+  }
+}
+
 // Test which ensures that the RPC queue accepts requests with the earliest
 // deadline first (EDF), and upon overflow rejects requests with the latest deadlines.
 //
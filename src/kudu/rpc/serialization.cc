@@ -17,6 +17,12 @@
 
 #include "kudu/rpc/serialization.h"
 
+#include <strings.h>
+
+#include <algorithm>
+#include <string>
+
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <google/protobuf/message_lite.h>
 #include <google/protobuf/io/coded_stream.h>
@@ -25,16 +31,48 @@
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/constants.h"
+#include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
+DEFINE_string(rpc_compression_codec, "none",
+              "Codec with which to compress the bodies of the RPC requests and "
+              "responses sent to peers which support compression, e.g. LZ4 or ZSTD. "
+              "If 'none', they are sent uncompressed. Worthwhile on bandwidth-bound "
+              "links, such as between regions.");
+TAG_FLAG(rpc_compression_codec, experimental);
+TAG_FLAG(rpc_compression_codec, runtime);
+
+DEFINE_int32(rpc_compression_min_size_bytes, 8 * 1024,
+             "Minimum size of the body of an RPC request or response for it to be "
+             "compressed. See --rpc_compression_codec.");
+TAG_FLAG(rpc_compression_min_size_bytes, experimental);
+TAG_FLAG(rpc_compression_min_size_bytes, runtime);
+
 DECLARE_int32(rpc_max_message_size);
 
+// Validate that rpc_compression_codec names a known codec.
+static bool ValidateCompressionCodec(const char* flagname, const std::string& value) {
+  if (kudu::GetCompressionCodecType(value) != kudu::NO_COMPRESSION ||
+      strcasecmp(value.c_str(), "none") == 0) {
+    return true;
+  }
+  LOG(ERROR) << strings::Substitute("$0 must be 'none' or a known compression codec, "
+                                    "value $1 is invalid", flagname, value);
+  return false;
+}
+static bool dummy = google::RegisterFlagValidator(
+    &FLAGS_rpc_compression_codec, &ValidateCompressionCodec);
+
 using google::protobuf::MessageLite;
 using google::protobuf::io::CodedInputStream;
 using google::protobuf::io::CodedOutputStream;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -102,6 +140,14 @@ void SerializeHeader(const MessageLite& header,
 Status ParseMessage(const Slice& buf,
                     MessageLite* parsed_header,
                     Slice* parsed_main_message) {
+  Slice body;
+  RETURN_NOT_OK(ParseHeader(buf, parsed_header, &body));
+  return ParseBody(body, parsed_main_message);
+}
+
+Status ParseHeader(const Slice& buf,
+                   MessageLite* parsed_header,
+                   Slice* body) {
 
   // First grab the total length
   if (PREDICT_FALSE(buf.size() < kMsgLengthPrefixLength)) {
@@ -130,26 +176,109 @@ Status ParseMessage(const Slice& buf,
   }
   in.PopLimit(l);
 
+  int pos = in.CurrentPosition();
+  *body = Slice(buf.data() + pos, buf.size() - pos);
+  return Status::OK();
+}
+
+Status ParseBody(const Slice& body, Slice* parsed_main_message) {
+  CodedInputStream in(body.data(), body.size());
+
   uint32_t main_msg_len;
   if (PREDICT_FALSE(!in.ReadVarint32(&main_msg_len))) {
     return Status::Corruption("Invalid packet: missing main msg length",
-                              KUDU_REDACT(buf.ToDebugString()));
+                              KUDU_REDACT(body.ToDebugString()));
   }
 
   if (PREDICT_FALSE(!in.Skip(main_msg_len))) {
     return Status::Corruption(
         StringPrintf("Invalid packet: data too short, expected %d byte main_msg", main_msg_len),
-        KUDU_REDACT(buf.ToDebugString()));
+        KUDU_REDACT(body.ToDebugString()));
   }
 
   if (PREDICT_FALSE(in.BytesUntilLimit() > 0)) {
     return Status::Corruption(
       StringPrintf("Invalid packet: %d extra bytes at end of packet", in.BytesUntilLimit()),
-      KUDU_REDACT(buf.ToDebugString()));
+      KUDU_REDACT(body.ToDebugString()));
   }
 
-  *parsed_main_message = Slice(buf.data() + buf.size() - main_msg_len,
-                              main_msg_len);
+  *parsed_main_message = Slice(body.data() + body.size() - main_msg_len,
+                               main_msg_len);
+  return Status::OK();
+}
+
+const CompressionCodec* GetBodyCompressionCodec(bool remote_supports_compression,
+                                                size_t body_size) {
+  if (!remote_supports_compression ||
+      body_size < std::max(0, FLAGS_rpc_compression_min_size_bytes)) {
+    return nullptr;
+  }
+  CompressionType type = GetCompressionCodecType(FLAGS_rpc_compression_codec);
+  if (type == NO_COMPRESSION) {
+    return nullptr;
+  }
+  const CompressionCodec* codec;
+  Status s = GetCompressionCodec(type, &codec);
+  if (PREDICT_FALSE(!s.ok() || codec == nullptr)) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to compress RPC bodies with codec "
+                                   << FLAGS_rpc_compression_codec << ": "
+                                   << (s.ok() ? "unknown codec" : s.ToString());
+    return nullptr;
+  }
+  return codec;
+}
+
+bool CompressBody(const CompressionCodec* codec,
+                  const vector<Slice>& slices,
+                  size_t body_size,
+                  faststring* out,
+                  Counter* bytes_saved,
+                  Counter* time_us) {
+  MonoTime start = MonoTime::Now();
+  out->resize(codec->MaxCompressedLength(body_size));
+  size_t compressed_size;
+  Status s = codec->Compress(slices, out->data(), &compressed_size);
+  if (time_us) {
+    time_us->IncrementBy((MonoTime::Now() - start).ToMicroseconds());
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    KLOG_EVERY_N_SECS(WARNING, 60) << "Unable to compress RPC body: " << s.ToString();
+    out->clear();
+    return false;
+  }
+  if (compressed_size >= body_size) {
+    out->clear();
+    return false;
+  }
+  out->resize(compressed_size);
+  if (bytes_saved) {
+    bytes_saved->IncrementBy(body_size - compressed_size);
+  }
+  return true;
+}
+
+Status DecompressBody(CompressionType codec_type,
+                      uint32_t uncompressed_size,
+                      const Slice& compressed,
+                      faststring* out,
+                      Counter* time_us) {
+  if (PREDICT_FALSE(static_cast<int64_t>(uncompressed_size) > FLAGS_rpc_max_message_size)) {
+    return Status::Corruption(Substitute(
+        "Invalid packet: uncompressed body of $0 bytes is larger than the maximum "
+        "RPC message size ($1 bytes)", uncompressed_size, FLAGS_rpc_max_message_size));
+  }
+  const CompressionCodec* codec;
+  RETURN_NOT_OK(GetCompressionCodec(codec_type, &codec));
+  if (PREDICT_FALSE(codec == nullptr)) {
+    return Status::Corruption("Invalid packet: body compressed without a codec");
+  }
+  MonoTime start = MonoTime::Now();
+  out->resize(uncompressed_size);
+  RETURN_NOT_OK_PREPEND(codec->Uncompress(compressed, out->data(), uncompressed_size),
+                        "Invalid packet: unable to decompress body");
+  if (time_us) {
+    time_us->IncrementBy((MonoTime::Now() - start).ToMicroseconds());
+  }
   return Status::OK();
 }
 
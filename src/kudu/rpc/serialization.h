@@ -21,6 +21,10 @@
 #include <inttypes.h>
 #include <string.h>
 
+#include <vector>
+
+#include "kudu/util/compression/compression.pb.h"
+
 namespace google {
 namespace protobuf {
 class MessageLite;
@@ -29,6 +33,8 @@ class MessageLite;
 
 namespace kudu {
 
+class CompressionCodec;
+class Counter;
 class Status;
 class faststring;
 class Slice;
@@ -74,6 +80,48 @@ Status ParseMessage(const Slice& buf,
                     google::protobuf::MessageLite* parsed_header,
                     Slice* parsed_main_message);
 
+// Deserialize the header of a request or response.
+// In: data buffer Slice.
+// Out: parsed_header PB initialized,
+//      body pointing to the bytes following the header in the original
+//      buffer, which hold the length-prefixed main payload unless the header
+//      says that they are compressed.
+Status ParseHeader(const Slice& buf,
+                   google::protobuf::MessageLite* parsed_header,
+                   Slice* body);
+
+// Deserialize the body following the header, as returned by ParseHeader()
+// or DecompressBody().
+// Out: parsed_main_message pointing to offset in 'body' containing the main
+//      payload.
+Status ParseBody(const Slice& body, Slice* parsed_main_message);
+
+// Returns the codec with which to compress a body of 'body_size' bytes sent
+// on a connection, or NULL if it is to be sent uncompressed, because the
+// remote end doesn't support compression, compression is disabled, or the
+// body is smaller than --rpc_compression_min_size_bytes.
+const CompressionCodec* GetBodyCompressionCodec(bool remote_supports_compression,
+                                                size_t body_size);
+
+// Compress the concatenation of 'slices', 'body_size' bytes in all, with
+// 'codec' into 'out'. Returns false if that doesn't save any space, in which
+// case the body should be sent uncompressed. Adds the bytes saved and the
+// time spent to 'bytes_saved' and 'time_us' if they are not NULL.
+bool CompressBody(const CompressionCodec* codec,
+                  const std::vector<Slice>& slices,
+                  size_t body_size,
+                  faststring* out,
+                  Counter* bytes_saved,
+                  Counter* time_us);
+
+// Decompress a body compressed with 'codec_type' into 'out'. Adds the time
+// spent to 'time_us' if it is not NULL.
+Status DecompressBody(CompressionType codec_type,
+                      uint32_t uncompressed_size,
+                      const Slice& compressed,
+                      faststring* out,
+                      Counter* time_us);
+
 // Serialize the RPC connection header (magic number + flags).
 // buf must have 7 bytes available (kMagicNumberLength + kHeaderFlagsLength).
 void SerializeConnHeader(uint8_t* buf);
@@ -18,9 +18,12 @@
 #include "kudu/rpc/service_if.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <google/protobuf/descriptor.pb.h>
 
+#include "kudu/gutil/stl_util.h"
+
 #include "kudu/gutil/strings/substitute.h"
 
 #include "kudu/rpc/connection.h"
@@ -35,6 +38,20 @@
 DEFINE_bool(enable_exactly_once, true, "Whether to enable exactly once semantics.");
 TAG_FLAG(enable_exactly_once, hidden);
 
+DEFINE_int32(rpc_message_pool_size, 0,
+             "Number of request and response protobufs of each RPC method which are "
+             "kept once their call completes, to be cleared and reused by later calls "
+             "rather than allocated again. 0 disables the reuse.");
+TAG_FLAG(rpc_message_pool_size, experimental);
+TAG_FLAG(rpc_message_pool_size, runtime);
+
+DEFINE_int32(rpc_message_pool_max_message_bytes, 64 * 1024,
+             "Maximum serialized size of a request or response protobuf for it to be "
+             "kept for reuse, when --rpc_message_pool_size is set. Larger messages are "
+             "freed so that the pool doesn't retain their memory.");
+TAG_FLAG(rpc_message_pool_max_message_bytes, experimental);
+TAG_FLAG(rpc_message_pool_max_message_bytes, runtime);
+
 using google::protobuf::Message;
 using std::string;
 using std::unique_ptr;
@@ -43,6 +60,42 @@ using strings::Substitute;
 namespace kudu {
 namespace rpc {
 
+RpcMessagePool::~RpcMessagePool() {
+  STLDeleteElements(&messages_);
+}
+
+Message* RpcMessagePool::Get(const Message& prototype) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (!messages_.empty()) {
+      Message* msg = messages_.back();
+      messages_.pop_back();
+      return msg;
+    }
+  }
+  return prototype.New();
+}
+
+void RpcMessagePool::Put(Message* msg, int64_t size) {
+  unique_ptr<Message> owned(msg);
+  int pool_size = FLAGS_rpc_message_pool_size;
+  if (pool_size <= 0) {
+    return;
+  }
+  if (size < 0) {
+    size = msg->ByteSize();
+  }
+  if (size > FLAGS_rpc_message_pool_max_message_bytes) {
+    return;
+  }
+  // Clearing the message may take a while, so it's done outside the lock.
+  msg->Clear();
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (messages_.size() < static_cast<size_t>(pool_size)) {
+    messages_.push_back(owned.release());
+  }
+}
+
 ServiceIf::~ServiceIf() {
 }
 
@@ -93,11 +146,11 @@ void GeneratedServiceIf::Handle(InboundCall *call) {
     RespondBadMethod(call);
     return;
   }
-  unique_ptr<Message> req(method_info->req_prototype->New());
+  unique_ptr<Message> req(method_info->req_pool.Get(*method_info->req_prototype));
   if (PREDICT_FALSE(!ParseParam(call, req.get()))) {
     return;
   }
-  Message* resp = method_info->resp_prototype->New();
+  Message* resp = method_info->resp_pool.Get(*method_info->resp_prototype);
 
   bool track_result = call->header().has_request_id()
                       && method_info->track_result
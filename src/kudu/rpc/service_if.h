@@ -17,11 +17,14 @@
 #ifndef KUDU_RPC_SERVICE_IF_H
 #define KUDU_RPC_SERVICE_IF_H
 
+#include <atomic>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/rpc/result_tracker.h"
@@ -34,6 +37,7 @@ class Message;
 
 namespace kudu {
 
+class Counter;
 class Histogram;
 
 namespace rpc {
@@ -43,6 +47,34 @@ class RemoteMethod;
 class RpcContext;
 class ServiceIf;
 
+// A pool of the request or response protobufs of an RPC method, which are
+// cleared and reused by later calls rather than freed, when
+// --rpc_message_pool_size is set. Clearing a protobuf keeps its sub-messages,
+// repeated fields and strings allocated, so that parsing or building a
+// similar message into it mostly avoids allocations.
+//
+// This class is thread-safe.
+class RpcMessagePool {
+ public:
+  RpcMessagePool() {}
+  ~RpcMessagePool();
+
+  // Returns a cleared message from the pool, or a new one from 'prototype'.
+  google::protobuf::Message* Get(const google::protobuf::Message& prototype);
+
+  // Clears 'msg' and returns it to the pool, or frees it if the pool is full
+  // or if the serialized size of the message is larger than
+  // --rpc_message_pool_max_message_bytes. The size is computed if 'size' is
+  // negative.
+  void Put(google::protobuf::Message* msg, int64_t size = -1);
+
+ private:
+  simple_spinlock lock_;
+  std::vector<google::protobuf::Message*> messages_;
+
+  DISALLOW_COPY_AND_ASSIGN(RpcMessagePool);
+};
+
 // Generated services define an instance of this class for each
 // method that they implement. The generic server code implemented
 // by GeneratedServiceIf look up the RpcMethodInfo in order to handle
@@ -54,8 +86,20 @@ struct RpcMethodInfo : public RefCountedThreadSafe<RpcMethodInfo> {
   std::unique_ptr<google::protobuf::Message> req_prototype;
   std::unique_ptr<google::protobuf::Message> resp_prototype;
 
+  // The instances of the requests and responses kept to be reused.
+  RpcMessagePool req_pool;
+  RpcMessagePool resp_pool;
+
   scoped_refptr<Histogram> handler_latency_histogram;
 
+  // The number of the method's calls rejected because its service queue was full.
+  scoped_refptr<Counter> queue_overflow_counter;
+
+  // A moving average of the time spent handling the method's calls, in
+  // microseconds. Used to shed the queued calls which can't be handled
+  // before their deadline.
+  std::atomic<int64_t> handler_latency_avg_us{0};
+
   // Whether we should track this method's result, using ResultTracker.
   bool track_result;
 
@@ -19,23 +19,64 @@
 
 #include <glog/logging.h>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/os-util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
 
+DEFINE_bool(rpc_service_queue_by_priority, false,
+            "Whether the service queues hand out the queued calls of a higher priority "
+            "class first, and evict those of a lower class first when full. Otherwise, "
+            "calls are only ordered by deadline. Applies to the services started "
+            "afterwards.");
+TAG_FLAG(rpc_service_queue_by_priority, experimental);
+
+DEFINE_bool(rpc_shed_calls_unlikely_to_finish, false,
+            "Whether calls are rejected rather than handled once they leave the service "
+            "queue if their deadline would elapse before they are handled, given the "
+            "average handling time of their method.");
+TAG_FLAG(rpc_shed_calls_unlikely_to_finish, experimental);
+TAG_FLAG(rpc_shed_calls_unlikely_to_finish, runtime);
+
+DEFINE_int32(rpc_admission_queue_delay_target_ms, 0,
+             "Target for the time calls spend in a service queue. Once the minimum queue "
+             "time of the calls handled during an interval of "
+             "--rpc_admission_queue_delay_interval_ms exceeds it, new calls which can't be "
+             "handled by an idle worker are rejected as too busy until the queue time drops "
+             "back below it. 0 disables admission control.");
+TAG_FLAG(rpc_admission_queue_delay_target_ms, experimental);
+TAG_FLAG(rpc_admission_queue_delay_target_ms, runtime);
+
+DEFINE_int32(rpc_admission_queue_delay_interval_ms, 100,
+             "Interval over which the minimum queue time of the calls is compared to "
+             "--rpc_admission_queue_delay_target_ms.");
+TAG_FLAG(rpc_admission_queue_delay_interval_ms, experimental);
+TAG_FLAG(rpc_admission_queue_delay_interval_ms, runtime);
+
+DEFINE_bool(rpc_pin_service_threads, false,
+            "Whether the i-th worker thread of each service queue is pinned to the i-th "
+            "CPU (modulo the number of CPUs).");
+TAG_FLAG(rpc_pin_service_threads, experimental);
+
 using std::shared_ptr;
+using std::string;
+using std::vector;
 using strings::Substitute;
 
 METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
@@ -44,6 +85,33 @@ METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
                         "Number of microseconds incoming RPC requests spend in the worker queue",
                         60000000LU, 3);
 
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_high_priority,
+                        "RPC Queue Time (High Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming PRIORITY_HIGH RPC requests spend "
+                        "in the worker queue",
+                        60000000LU, 3);
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_normal_priority,
+                        "RPC Queue Time (Normal Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming PRIORITY_NORMAL RPC requests spend "
+                        "in the worker queue",
+                        60000000LU, 3);
+
+METRIC_DEFINE_histogram(server, rpc_incoming_queue_time_low_priority,
+                        "RPC Queue Time (Low Priority)",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Number of microseconds incoming PRIORITY_LOW RPC requests spend "
+                        "in the worker queue",
+                        60000000LU, 3);
+
+METRIC_DEFINE_counter(server, rpcs_shed_in_queue,
+                      "RPC Queue Sheds",
+                      kudu::MetricUnit::kRequests,
+                      "Number of RPCs rejected once out of the service queue because "
+                      "they were unlikely to be handled before their deadline.");
+
 METRIC_DEFINE_counter(server, rpcs_timed_out_in_queue,
                       "RPC Queue Timeouts",
                       kudu::MetricUnit::kRequests,
@@ -56,6 +124,12 @@ METRIC_DEFINE_counter(server, rpcs_queue_overflow,
                       "Number of RPCs dropped because the service queue "
                       "was full.");
 
+METRIC_DEFINE_counter(server, rpcs_rejected_by_admission_control,
+                      "RPC Admission Control Rejections",
+                      kudu::MetricUnit::kRequests,
+                      "Number of RPCs rejected because the time calls spent in the "
+                      "service queue stayed above --rpc_admission_queue_delay_target_ms.");
+
 namespace kudu {
 namespace rpc {
 
@@ -63,29 +137,74 @@ ServicePool::ServicePool(gscoped_ptr<ServiceIf> service,
                          const scoped_refptr<MetricEntity>& entity,
                          size_t service_queue_length)
   : service_(std::move(service)),
-    service_queue_(service_queue_length),
+    service_queue_(0, service_queue_length, FLAGS_rpc_service_queue_by_priority),
     incoming_queue_time_(METRIC_rpc_incoming_queue_time.Instantiate(entity)),
     rpcs_timed_out_in_queue_(METRIC_rpcs_timed_out_in_queue.Instantiate(entity)),
+    rpcs_shed_in_queue_(METRIC_rpcs_shed_in_queue.Instantiate(entity)),
     rpcs_queue_overflow_(METRIC_rpcs_queue_overflow.Instantiate(entity)),
+    rpcs_rejected_by_admission_control_(
+        METRIC_rpcs_rejected_by_admission_control.Instantiate(entity)),
     closing_(false) {
+  incoming_queue_time_by_priority_[PRIORITY_HIGH] =
+      METRIC_rpc_incoming_queue_time_high_priority.Instantiate(entity);
+  incoming_queue_time_by_priority_[PRIORITY_NORMAL] =
+      METRIC_rpc_incoming_queue_time_normal_priority.Instantiate(entity);
+  incoming_queue_time_by_priority_[PRIORITY_LOW] =
+      METRIC_rpc_incoming_queue_time_low_priority.Instantiate(entity);
 }
 
 ServicePool::~ServicePool() {
   Shutdown();
 }
 
-Status ServicePool::Init(int num_threads) {
-  for (int i = 0; i < num_threads; i++) {
+Status ServicePool::AddMethodQueue(const vector<string>& methods,
+                                   int num_threads,
+                                   size_t queue_length) {
+  DCHECK(threads_.empty()) << "method queues must be added before Init()";
+  if (num_threads <= 0) {
+    return Status::InvalidArgument("method queue must have at least one thread");
+  }
+  std::unique_ptr<CallQueue> mq(new CallQueue(num_threads, queue_length,
+                                              FLAGS_rpc_service_queue_by_priority));
+  for (const string& method : methods) {
+    RemoteMethod remote_method(service_->service_name(), method);
+    if (!service_->LookupMethod(remote_method)) {
+      return Status::NotFound(Substitute("no method $0 in service $1",
+                                         method, service_->service_name()));
+    }
+    if (!InsertIfNotPresent(&queues_by_method_, method, mq.get())) {
+      return Status::AlreadyPresent(Substitute("method $0 of service $1 already has a queue",
+                                               method, service_->service_name()));
+    }
+  }
+  method_queues_.emplace_back(std::move(mq));
+  return Status::OK();
+}
+
+Status ServicePool::StartThreads(CallQueue* queue) {
+  for (int i = 0; i < queue->num_threads; i++) {
     scoped_refptr<kudu::Thread> new_thread;
     CHECK_OK(kudu::Thread::Create("service pool", "rpc worker",
-        &ServicePool::RunThread, this, &new_thread));
+        &ServicePool::RunThread, this, queue, i, &new_thread));
     threads_.push_back(new_thread);
   }
   return Status::OK();
 }
 
+Status ServicePool::Init(int num_threads) {
+  service_queue_.num_threads = num_threads;
+  RETURN_NOT_OK(StartThreads(&service_queue_));
+  for (const auto& mq : method_queues_) {
+    RETURN_NOT_OK(StartThreads(mq.get()));
+  }
+  return Status::OK();
+}
+
 void ServicePool::Shutdown() {
-  service_queue_.Shutdown();
+  service_queue_.queue.Shutdown();
+  for (const auto& mq : method_queues_) {
+    mq->queue.Shutdown();
+  }
 
   MutexLock lock(shutdown_lock_);
   if (closing_) return;
@@ -95,30 +214,38 @@ void ServicePool::Shutdown() {
     CHECK_OK(ThreadJoiner(thread.get()).Join());
   }
 
-  // Now we must drain the service queue.
+  // Now we must drain the service queues.
   Status status = Status::ServiceUnavailable("Service is shutting down");
   std::unique_ptr<InboundCall> incoming;
-  while (service_queue_.BlockingGet(&incoming)) {
+  while (service_queue_.queue.BlockingGet(&incoming)) {
     incoming.release()->RespondFailure(ErrorStatusPB::FATAL_SERVER_SHUTTING_DOWN, status);
   }
+  for (const auto& mq : method_queues_) {
+    while (mq->queue.BlockingGet(&incoming)) {
+      incoming.release()->RespondFailure(ErrorStatusPB::FATAL_SERVER_SHUTTING_DOWN, status);
+    }
+  }
 
   service_->Shutdown();
 }
 
-void ServicePool::RejectTooBusy(InboundCall* c) {
+void ServicePool::RejectTooBusy(InboundCall* c, const CallQueue& queue) {
   string err_msg =
       Substitute("$0 request on $1 from $2 dropped due to backpressure. "
                  "The service queue is full; it has $3 items.",
                  c->remote_method().method_name(),
                  service_->service_name(),
                  c->remote_address().ToString(),
-                 service_queue_.max_size());
+                 queue.queue.max_size());
   rpcs_queue_overflow_->Increment();
+  if (c->method_info() && c->method_info()->queue_overflow_counter) {
+    c->method_info()->queue_overflow_counter->Increment();
+  }
   KLOG_EVERY_N_SECS(WARNING, 1) << err_msg;
   c->RespondFailure(ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
                     Status::ServiceUnavailable(err_msg));
   DLOG(INFO) << err_msg << " Contents of service queue:\n"
-             << service_queue_.ToString();
+             << queue.queue.ToString();
 }
 
 RpcMethodInfo* ServicePool::LookupMethod(const RemoteMethod& method) {
@@ -142,16 +269,36 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
 
   TRACE_TO(c->trace(), "Inserting onto call queue");
 
-  // Queue message on service queue
+  // Queue message on the queue of its method, or else on the service queue.
+  CallQueue* queue = &service_queue_;
+  if (!queues_by_method_.empty()) {
+    queue = FindWithDefault(queues_by_method_, c->remote_method().method_name(), queue);
+  }
+
+  if (PREDICT_FALSE(ShouldRejectCall(queue))) {
+    string err_msg =
+        Substitute("$0 request on $1 from $2 rejected by admission control. "
+                   "Calls wait in the service queue for longer than $3ms.",
+                   c->remote_method().method_name(),
+                   service_->service_name(),
+                   c->remote_address().ToString(),
+                   FLAGS_rpc_admission_queue_delay_target_ms);
+    rpcs_rejected_by_admission_control_->Increment();
+    KLOG_EVERY_N_SECS(WARNING, 1) << err_msg;
+    c->RespondFailure(ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
+                      Status::ServiceUnavailable(err_msg));
+    return Status::OK();
+  }
+
   boost::optional<InboundCall*> evicted;
-  auto queue_status = service_queue_.Put(c, &evicted);
+  auto queue_status = queue->queue.Put(c, &evicted);
   if (queue_status == QUEUE_FULL) {
-    RejectTooBusy(c);
+    RejectTooBusy(c, *queue);
     return Status::OK();
   }
 
   if (PREDICT_FALSE(evicted != boost::none)) {
-    RejectTooBusy(*evicted);
+    RejectTooBusy(*evicted, *queue);
   }
 
   if (PREDICT_TRUE(queue_status == QUEUE_SUCCESS)) {
@@ -172,15 +319,62 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
   return status;
 }
 
-void ServicePool::RunThread() {
+void ServicePool::RecordQueueDelay(CallQueue* queue, const MonoTime& now,
+                                   const MonoDelta& delay) {
+  std::lock_guard<simple_spinlock> l(queue->admission_lock);
+  if (!queue->interval_min_delay.Initialized() || delay < queue->interval_min_delay) {
+    queue->interval_min_delay = delay;
+  }
+  if (!queue->interval_end.Initialized() || now >= queue->interval_end) {
+    queue->overloaded = queue->interval_min_delay >
+        MonoDelta::FromMilliseconds(FLAGS_rpc_admission_queue_delay_target_ms);
+    queue->interval_min_delay = MonoDelta();
+    queue->interval_end =
+        now + MonoDelta::FromMilliseconds(FLAGS_rpc_admission_queue_delay_interval_ms);
+  }
+}
+
+bool ServicePool::ShouldRejectCall(CallQueue* queue) {
+  if (FLAGS_rpc_admission_queue_delay_target_ms <= 0 ||
+      queue->queue.estimated_idle_worker_count() > 0) {
+    return false;
+  }
+  std::lock_guard<simple_spinlock> l(queue->admission_lock);
+  if (!queue->overloaded) {
+    return false;
+  }
+  // No call was taken from the queue for a whole interval, so the queue time
+  // measured last is stale: admit calls again rather than rejecting them
+  // until the next call is handled.
+  MonoTime now = MonoTime::Now();
+  if (now >= queue->interval_end +
+      MonoDelta::FromMilliseconds(FLAGS_rpc_admission_queue_delay_interval_ms)) {
+    queue->overloaded = false;
+    return false;
+  }
+  return true;
+}
+
+void ServicePool::RunThread(CallQueue* queue, int thread_idx) {
+  if (FLAGS_rpc_pin_service_threads) {
+    WARN_NOT_OK(PinCurrentThreadToCpu(thread_idx % base::NumCPUs()),
+                "Unable to pin service thread");
+  }
   while (true) {
     std::unique_ptr<InboundCall> incoming;
-    if (!service_queue_.BlockingGet(&incoming)) {
+    if (!queue->queue.BlockingGet(&incoming)) {
       VLOG(1) << "ServicePool: messenger shutting down.";
       return;
     }
 
     incoming->RecordHandlingStarted(incoming_queue_time_);
+    const InboundCallTiming& timing = incoming->timing();
+    MonoDelta queue_time = timing.time_handled - timing.time_received;
+    incoming_queue_time_by_priority_[incoming->header().priority()]->Increment(
+        queue_time.ToMicroseconds());
+    if (FLAGS_rpc_admission_queue_delay_target_ms > 0) {
+      RecordQueueDelay(queue, timing.time_handled, queue_time);
+    }
     ADOPT_TRACE(incoming->trace());
 
     if (PREDICT_FALSE(incoming->ClientTimedOut())) {
@@ -199,6 +393,17 @@ void ServicePool::RunThread() {
       continue;
     }
 
+    if (PREDICT_FALSE(FLAGS_rpc_shed_calls_unlikely_to_finish &&
+                      incoming->ClientDeadlineUnreachable())) {
+      TRACE_TO(incoming->trace(), "Skipping call since it can't be handled before its deadline");
+      rpcs_shed_in_queue_->Increment();
+      incoming->RespondFailure(
+        ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
+        Status::TimedOut("Call would not be handled before the client deadline"));
+      ignore_result(incoming.release());
+      continue;
+    }
+
     TRACE_TO(incoming->trace(), "Handling call");
 
     // Release the InboundCall pointer -- when the call is responded to,
@@ -18,7 +18,9 @@
 #ifndef KUDU_SERVICE_POOL_H
 #define KUDU_SERVICE_POOL_H
 
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
@@ -26,6 +28,8 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/rpc/rpc_service.h"
 #include "kudu/rpc/service_queue.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/status.h"
@@ -51,7 +55,14 @@ class ServicePool : public RpcService {
               size_t service_queue_length);
   virtual ~ServicePool();
 
-  // Start up the thread pool.
+  // Handles the calls of 'methods' with their own queue of length
+  // 'queue_length' and 'num_threads' worker threads, isolated from the
+  // calls of the other methods of the service. Must be called before Init().
+  Status AddMethodQueue(const std::vector<std::string>& methods,
+                        int num_threads,
+                        size_t queue_length);
+
+  // Start up the thread pool, and those of the method queues.
   virtual Status Init(int num_threads);
 
   // Shut down the queue and the thread pool.
@@ -73,18 +84,68 @@ class ServicePool : public RpcService {
     return rpcs_queue_overflow_.get();
   }
 
+  const Counter* RpcsShedInQueueMetricForTests() const {
+    return rpcs_shed_in_queue_.get();
+  }
+
+  const Counter* RpcsRejectedByAdmissionControlMetricForTests() const {
+    return rpcs_rejected_by_admission_control_.get();
+  }
+
   const std::string service_name() const;
 
  private:
-  void RunThread();
-  void RejectTooBusy(InboundCall* c);
+  // A queue of calls and the threads handling them.
+  struct CallQueue {
+    CallQueue(int num_threads, size_t queue_length, bool order_by_priority)
+        : num_threads(num_threads),
+          queue(queue_length, order_by_priority),
+          overloaded(false) {
+    }
+
+    int num_threads;
+    LifoServiceQueue queue;
+
+    // The state of the admission control of the queue, see
+    // --rpc_admission_queue_delay_target_ms. The queue is overloaded when
+    // the minimum time spent in the queue by the calls handled during the
+    // last interval exceeded the target.
+    simple_spinlock admission_lock;
+    // The end of the current interval.
+    MonoTime interval_end;
+    // The minimum queue time of the calls handled during the current interval.
+    MonoDelta interval_min_delay;
+    bool overloaded;
+  };
+
+  Status StartThreads(CallQueue* queue);
+  // Runs the 'thread_idx'-th worker thread of 'queue'.
+  void RunThread(CallQueue* queue, int thread_idx);
+  void RejectTooBusy(InboundCall* c, const CallQueue& queue);
+
+  // Updates the admission control state of 'queue' with the queue time of a
+  // call just taken from it.
+  static void RecordQueueDelay(CallQueue* queue, const MonoTime& now,
+                               const MonoDelta& delay);
+
+  // Returns whether new calls are rejected from 'queue' because it is
+  // overloaded, and the call would not be handled by an idle worker.
+  static bool ShouldRejectCall(CallQueue* queue);
 
   gscoped_ptr<ServiceIf> service_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
-  LifoServiceQueue service_queue_;
+  // The queue of the calls of the methods without a queue of their own.
+  CallQueue service_queue_;
+  std::vector<std::unique_ptr<CallQueue>> method_queues_;
+  // The queue of each method added with AddMethodQueue(). Immutable after Init().
+  std::unordered_map<std::string, CallQueue*> queues_by_method_;
   scoped_refptr<Histogram> incoming_queue_time_;
+  // The queue time of the calls of each priority class, indexed by RpcPriority.
+  scoped_refptr<Histogram> incoming_queue_time_by_priority_[PRIORITY_LOW + 1];
   scoped_refptr<Counter> rpcs_timed_out_in_queue_;
+  scoped_refptr<Counter> rpcs_shed_in_queue_;
   scoped_refptr<Counter> rpcs_queue_overflow_;
+  scoped_refptr<Counter> rpcs_rejected_by_admission_control_;
 
   mutable Mutex shutdown_lock_;
   bool closing_;
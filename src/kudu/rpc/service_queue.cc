@@ -26,9 +26,10 @@ namespace rpc {
 
 __thread LifoServiceQueue::ConsumerState* LifoServiceQueue::tl_consumer_ = nullptr;
 
-LifoServiceQueue::LifoServiceQueue(int max_size)
+LifoServiceQueue::LifoServiceQueue(int max_size, bool order_by_priority)
    : shutdown_(false),
-     max_queue_size_(max_size) {
+     max_queue_size_(max_size),
+     queue_(DeadlineLessStruct(order_by_priority)) {
   CHECK_GT(max_queue_size_, 0);
 }
 
@@ -95,7 +96,7 @@ QueueStatus LifoServiceQueue::Put(InboundCall* call,
     DCHECK_EQ(queue_.size(), max_queue_size_);
     auto it = queue_.end();
     --it;
-    if (DeadlineLess(*it, call)) {
+    if (queue_.key_comp()(*it, call)) {
       return QUEUE_FULL;
     }
 
@@ -47,6 +47,11 @@ enum QueueStatus {
 // can evict any call that does not have a deadline. This incentivizes clients to
 // provide accurate deadlines for their calls.
 //
+// If the queue orders calls by priority, the calls of a higher priority class
+// (see RpcPriority) are dequeued first, and the calls of the lowest class are
+// evicted first, regardless of their deadlines. Within a class, calls are
+// still ordered by deadline.
+//
 // In order to improve concurrent throughput, this class uses a LIFO design:
 // Each consumer thread has its own lock and condition variable. If a
 // consumer arrives and there is no work available in the queue, it will not
@@ -67,7 +72,7 @@ enum QueueStatus {
 // must never access any other instance.
 class LifoServiceQueue {
  public:
-  explicit LifoServiceQueue(int max_size);
+  explicit LifoServiceQueue(int max_size, bool order_by_priority = false);
 
   ~LifoServiceQueue();
 
@@ -136,11 +141,24 @@ class LifoServiceQueue {
     return time_a < time_b;
   }
 
-  // Struct functor wrapper for DeadlineLess.
+  // Struct functor wrapper for DeadlineLess, which first orders calls by
+  // their priority class if 'by_priority' is set.
   struct DeadlineLessStruct {
+    explicit DeadlineLessStruct(bool by_priority = false) : by_priority(by_priority) {}
+
     bool operator()(const InboundCall* a, const InboundCall* b) const {
+      if (by_priority) {
+        // Lower values of RpcPriority are higher priorities.
+        auto priority_a = a->header().priority();
+        auto priority_b = b->header().priority();
+        if (priority_a != priority_b) {
+          return priority_a < priority_b;
+        }
+      }
       return DeadlineLess(a, b);
     }
+
+    bool by_priority;
   };
 
   // The thread-local record corresponding to a single consumer thread.
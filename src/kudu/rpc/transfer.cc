@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -57,6 +58,10 @@ using std::set;
 using std::string;
 using strings::Substitute;
 
+// The maximum number of slices written by one writev() call, which bounds the
+// size of the iovec array on the stack.
+static const int kMaxIovecsPerWrite = 64;
+
 #define RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status) \
   if (PREDICT_FALSE(!status.ok())) {                            \
     if (Socket::IsTemporarySocketError(status.posix_code())) {  \
@@ -156,12 +161,21 @@ OutboundTransfer::OutboundTransfer(int32_t call_id,
     callbacks_(callbacks),
     call_id_(call_id),
     aborted_(false) {
+  ResetPayload(payload);
+}
+
+void OutboundTransfer::ResetPayload(const std::vector<Slice>& payload) {
   CHECK(!payload.empty());
+  DCHECK(!TransferStarted());
 
   n_payload_slices_ = payload.size();
-  CHECK_LE(n_payload_slices_, arraysize(payload_slices_));
-  for (int i = 0; i < payload.size(); i++) {
-    payload_slices_[i] = payload[i];
+  if (PREDICT_TRUE(n_payload_slices_ <= arraysize(inline_slices_))) {
+    std::copy(payload.begin(), payload.end(), inline_slices_);
+    payload_slices_ = inline_slices_;
+    overflow_slices_.clear();
+  } else {
+    overflow_slices_ = payload;
+    payload_slices_ = overflow_slices_.data();
   }
 }
 
@@ -182,7 +196,7 @@ void OutboundTransfer::Abort(const Status &status) {
 Status OutboundTransfer::SendBuffer(Socket &socket) {
   CHECK_LT(cur_slice_idx_, n_payload_slices_);
 
-  int n_iovecs = n_payload_slices_ - cur_slice_idx_;
+  int n_iovecs = std::min<int>(n_payload_slices_ - cur_slice_idx_, kMaxIovecsPerWrite);
   struct iovec iovec[n_iovecs];
   {
     int offset_in_slice = cur_offset_in_slice_;
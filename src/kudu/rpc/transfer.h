@@ -105,8 +105,8 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   // memory of the slices. The slices must remain valid until the callback
   // is triggered.
   //
-  // NOTE: 'payload' is currently restricted to a maximum of kMaxPayloadSlices
-  // slices.
+  // NOTE: up to kMaxPayloadSlices slices are stored inline in the transfer;
+  // more slices require an additional allocation.
   // ------------------------------------------------------------
 
   // Create an outbound transfer for a call request.
@@ -123,6 +123,11 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   // before it has either (a) finished transferring, or (b) been Abort()ed.
   ~OutboundTransfer();
 
+  // Replace the slices to be sent with 'payload', which must remain valid
+  // until the callback is triggered. Requires that the transfer has not
+  // started.
+  void ResetPayload(const std::vector<Slice>& payload);
+
   // Abort the current transfer, with the given status.
   // This triggers TransferCallbacks::NotifyTransferAborted.
   void Abort(const Status &status);
@@ -158,8 +163,12 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
                    TransferCallbacks *callbacks);
 
   // Slices to send. Uses an array here instead of a vector to avoid an expensive
-  // vector construction (improved performance a couple percent).
-  Slice payload_slices_[kMaxPayloadSlices];
+  // vector construction (improved performance a couple percent). Only payloads
+  // with more than kMaxPayloadSlices slices are stored in 'overflow_slices_'.
+  Slice inline_slices_[kMaxPayloadSlices];
+  std::vector<Slice> overflow_slices_;
+  // Points to either of the above.
+  Slice* payload_slices_;
   size_t n_payload_slices_;
 
   // The current slice that is being sent.
@@ -17,17 +17,30 @@
 
 #include "kudu/security/tls_context.h"
 
+#include <mutex>
 #include <string>
 
+#include <gflags/gflags.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/security/openssl_util.h"
 #include "kudu/security/tls_handshake.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/status.h"
 
+DEFINE_bool(rpc_tls_session_resumption, false,
+            "Whether the client end of RPC connections offers to resume the "
+            "last TLS session established with the same server, which saves "
+            "the server's public-key operations on reconnection. Servers "
+            "which predate this flag fail such handshakes.");
+TAG_FLAG(rpc_tls_session_resumption, experimental);
+TAG_FLAG(rpc_tls_session_resumption, runtime);
+
 using strings::Substitute;
+using std::lock_guard;
 using std::string;
 
 namespace kudu {
@@ -39,6 +52,13 @@ template<> struct SslTypeTraits<SSL> {
 template<> struct SslTypeTraits<SSL_CTX> {
   static constexpr auto free = &SSL_CTX_free;
 };
+template<> struct SslTypeTraits<SSL_SESSION> {
+  static constexpr auto free = &SSL_SESSION_free;
+};
+
+// The context of the sessions of the servers, which must be set for clients
+// to resume sessions when peers are verified.
+static const unsigned char kSessionIdContext[] = "kudu-rpc";
 
 TlsContext::TlsContext() {
   security::InitializeOpenSSL();
@@ -70,6 +90,10 @@ Status TlsContext::Init() {
                       SSL_OP_NO_COMPRESSION);
   SSL_CTX_set_verify(ctx_.get(),
       SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT | SSL_VERIFY_CLIENT_ONCE, nullptr);
+  if (SSL_CTX_set_session_id_context(ctx_.get(), kSessionIdContext,
+                                     sizeof(kSessionIdContext) - 1) != 1) {
+    return Status::RuntimeError("failed to set TLS session id context", GetOpenSSLErrors());
+  }
   return Status::OK();
 }
 
@@ -105,7 +129,8 @@ Status TlsContext::LoadCertificateAuthority(const string& certificate_path) {
 }
 
 Status TlsContext::InitiateHandshake(TlsHandshakeType handshake_type,
-                                     TlsHandshake* handshake) const {
+                                     TlsHandshake* handshake,
+                                     const string& session_key) const {
   CHECK(ctx_);
   CHECK(!handshake->ssl_);
   handshake->adopt_ssl(ssl_make_unique(SSL_new(ctx_.get())));
@@ -123,11 +148,36 @@ Status TlsContext::InitiateHandshake(TlsHandshakeType handshake_type,
       break;
     case TlsHandshakeType::CLIENT:
       SSL_set_connect_state(handshake->ssl());
+      if (FLAGS_rpc_tls_session_resumption && !session_key.empty()) {
+        handshake->set_session_cache(this, session_key);
+        lock_guard<simple_spinlock> l(sessions_lock_);
+        const auto* session = FindOrNull(sessions_, session_key);
+        if (session && SSL_set_session(handshake->ssl(), session->get()) != 1) {
+          return Status::RuntimeError("failed to set TLS session", GetOpenSSLErrors());
+        }
+      }
       break;
   }
 
   return Status::OK();
 }
 
+void TlsContext::CacheSession(const string& session_key, SSL* ssl) const {
+  SSL_SESSION* session = SSL_get1_session(ssl);
+  if (!session) {
+    return;
+  }
+  lock_guard<simple_spinlock> l(sessions_lock_);
+  auto it = sessions_.find(session_key);
+  if (it != sessions_.end()) {
+    it->second = ssl_make_unique(session);
+    return;
+  }
+  if (sessions_.size() >= kMaxCachedSessions) {
+    sessions_.erase(sessions_.begin());
+  }
+  sessions_.emplace(session_key, ssl_make_unique(session));
+}
+
 } // namespace security
 } // namespace kudu
@@ -19,9 +19,11 @@
 
 #include <functional>
 #include <string>
+#include <unordered_map>
 
 #include "kudu/security/openssl_util.h"
 #include "kudu/security/tls_handshake.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -50,12 +52,31 @@ class TlsContext {
   Status LoadCertificateAuthority(const std::string& certificate_path);
 
   // Initiates a new TlsHandshake instance.
-  Status InitiateHandshake(TlsHandshakeType handshake_type, TlsHandshake* handshake) const;
+  //
+  // If --rpc_tls_session_resumption is set and this is a client handshake
+  // with a non-empty 'session_key', such as the address of the server, the
+  // handshake offers to resume the last session established with the same
+  // key, so that the server may skip the public-key operations of a full
+  // handshake. The session of a completed handshake is cached under its key.
+  Status InitiateHandshake(TlsHandshakeType handshake_type, TlsHandshake* handshake,
+                           const std::string& session_key = "") const;
 
  private:
+  friend class TlsHandshake;
+
+  // The maximum number of client sessions cached.
+  static const size_t kMaxCachedSessions = 1024;
+
+  // Caches the session of 'ssl', whose client handshake just completed,
+  // under 'session_key'.
+  void CacheSession(const std::string& session_key, SSL* ssl) const;
 
   // Owned SSL context.
   c_unique_ptr<SSL_CTX> ctx_;
+
+  // The last sessions of the client handshakes, by session key.
+  mutable simple_spinlock sessions_lock_;
+  mutable std::unordered_map<std::string, c_unique_ptr<SSL_SESSION>> sessions_;
 };
 
 } // namespace security
@@ -19,12 +19,15 @@
 
 #include <string>
 
+#include <gflags/gflags_declare.h>
 #include <gtest/gtest.h>
 
 #include "kudu/security/security-test-util.h"
 #include "kudu/security/tls_context.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(rpc_tls_session_resumption);
+
 using std::string;
 
 namespace kudu {
@@ -74,5 +77,68 @@ TEST_F(TestTlsHandshake, TestHandshake) {
   ASSERT_EQ(buf2.size(), 0);
 }
 
+TEST_F(TestTlsHandshake, TestSessionResumption) {
+  FLAGS_rpc_tls_session_resumption = true;
+  string cert_path = GetTestPath("cert.pem");
+  string key_path = GetTestPath("key.pem");
+  ASSERT_OK(CreateSSLServerCert(cert_path));
+  ASSERT_OK(CreateSSLPrivateKey(key_path));
+
+  TlsContext tls_context;
+  ASSERT_OK(tls_context.Init());
+  ASSERT_OK(tls_context.LoadCertificate(cert_path));
+  ASSERT_OK(tls_context.LoadPrivateKey(key_path));
+  ASSERT_OK(tls_context.LoadCertificateAuthority(cert_path));
+
+  string buf1;
+  string buf2;
+
+  // The first handshake is a full one, whose session is cached.
+  {
+    TlsHandshake server;
+    TlsHandshake client;
+    ASSERT_OK(tls_context.InitiateHandshake(TlsHandshakeType::SERVER, &server));
+    ASSERT_OK(tls_context.InitiateHandshake(TlsHandshakeType::CLIENT, &client, "server"));
+    buf1.clear();
+    ASSERT_TRUE(client.Continue(buf1, &buf2).IsIncomplete());
+    ASSERT_TRUE(server.Continue(buf2, &buf1).IsIncomplete());
+    ASSERT_TRUE(client.Continue(buf1, &buf2).IsIncomplete());
+    ASSERT_OK(server.Continue(buf2, &buf1));
+    ASSERT_OK(client.Continue(buf1, &buf2));
+    ASSERT_EQ(buf2.size(), 0);
+    ASSERT_FALSE(client.session_reused());
+  }
+
+  // The second handshake with the same key resumes the session: the server
+  // sends its Finished first, and the client sends the final message.
+  {
+    TlsHandshake server;
+    TlsHandshake client;
+    ASSERT_OK(tls_context.InitiateHandshake(TlsHandshakeType::SERVER, &server));
+    ASSERT_OK(tls_context.InitiateHandshake(TlsHandshakeType::CLIENT, &client, "server"));
+    buf1.clear();
+    ASSERT_TRUE(client.Continue(buf1, &buf2).IsIncomplete());
+    ASSERT_TRUE(server.Continue(buf2, &buf1).IsIncomplete());
+    ASSERT_OK(client.Continue(buf1, &buf2));
+    ASSERT_GT(buf2.size(), 0);
+    ASSERT_OK(server.Continue(buf2, &buf1));
+    ASSERT_EQ(buf1.size(), 0);
+    ASSERT_TRUE(client.session_reused());
+    ASSERT_TRUE(server.session_reused());
+  }
+
+  // A handshake with another key is a full one.
+  {
+    TlsHandshake client;
+    ASSERT_OK(tls_context.InitiateHandshake(TlsHandshakeType::CLIENT, &client, "other"));
+    TlsHandshake server;
+    ASSERT_OK(tls_context.InitiateHandshake(TlsHandshakeType::SERVER, &server));
+    buf1.clear();
+    ASSERT_TRUE(client.Continue(buf1, &buf2).IsIncomplete());
+    ASSERT_TRUE(server.Continue(buf2, &buf1).IsIncomplete());
+    ASSERT_TRUE(client.Continue(buf1, &buf2).IsIncomplete());
+  }
+}
+
 } // namespace security
 } // namespace kudu
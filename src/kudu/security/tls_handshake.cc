@@ -25,6 +25,7 @@
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 
+#include "kudu/security/tls_context.h"
 #include "kudu/security/tls_socket.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
@@ -69,15 +70,27 @@ Status TlsHandshake::Continue(const string& recv, string* send) {
   DCHECK_EQ(BIO_ctrl_pending(wbio), 0);
 
   if (rc == 1) {
-    // The handshake is done, but in the case of the server, we still need to
-    // send the final response to the client.
+    // The handshake is done, but in the case of the server, or of a client
+    // resuming a session, we still need to send the final message to the
+    // other end.
     DCHECK_GE(send->size(), 0);
+    if (session_context_) {
+      // OpenSSL verified the certificate chain of the server during the
+      // handshake. Its hostname is verified by Finish() on every connection,
+      // including those which resume the session.
+      session_context_->CacheSession(session_key_, ssl_.get());
+    }
     return Status::OK();
   }
   DCHECK_GT(send->size(), 0);
   return Status::Incomplete("TLS Handshake incomplete");
 }
 
+bool TlsHandshake::session_reused() const {
+  CHECK(ssl_);
+  return SSL_session_reused(ssl_.get());
+}
+
 Status TlsHandshake::Verify(const Socket& socket) const {
   DCHECK(SSL_is_init_finished(ssl_.get()));
   CHECK(ssl_);
@@ -19,6 +19,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "kudu/security/crypto.h"
 #include "kudu/security/openssl_util.h"
@@ -31,6 +32,8 @@ class Socket;
 
 namespace security {
 
+class TlsContext;
+
 enum class TlsHandshakeType {
   // The local endpoint is the TLS client (initiator).
   CLIENT,
@@ -74,9 +77,20 @@ class TlsHandshake {
   // calling this.
   Status Finish(std::unique_ptr<Socket>* socket);
 
+  // Returns true if the handshake resumed an earlier session. Only valid once
+  // Continue() returned OK.
+  bool session_reused() const;
+
  private:
   friend class TlsContext;
 
+  // Makes the handshake cache its session in 'context' under 'session_key'
+  // once it completes.
+  void set_session_cache(const TlsContext* context, std::string session_key) {
+    session_context_ = context;
+    session_key_ = std::move(session_key);
+  }
+
   // Set the SSL to use during the handshake. Called once by
   // TlsContext::InitiateHandshake before starting the handshake processes.
   void adopt_ssl(c_unique_ptr<SSL> ssl) {
@@ -93,6 +107,10 @@ class TlsHandshake {
 
   // Owned SSL handle.
   c_unique_ptr<SSL> ssl_;
+
+  // The context caching the session of this handshake, and its key, if any.
+  const TlsContext* session_context_ = nullptr;
+  std::string session_key_;
 };
 
 } // namespace security
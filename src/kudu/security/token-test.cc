@@ -24,6 +24,7 @@
 
 DECLARE_int32(token_signing_key_num_rsa_bits);
 DECLARE_int64(token_signing_key_validity_seconds);
+DECLARE_int32(token_verifier_cache_capacity);
 
 
 namespace kudu {
@@ -140,6 +141,48 @@ TEST_F(TokenTest, TestEndToEnd_Valid) {
   ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(token));
 }
 
+// Test that caching verified signatures doesn't change the results of
+// verification.
+TEST_F(TokenTest, TestEndToEnd_CachedVerification) {
+  FLAGS_token_verifier_cache_capacity = 2;
+  TokenSigner signer(1);
+  ASSERT_OK(signer.RotateSigningKey());
+
+  TokenVerifier verifier;
+  ASSERT_OK(verifier.ImportPublicKeys(signer.GetTokenSigningPublicKeys(0)));
+
+  SignedTokenPB token = MakeUnsignedToken(WallTime_Now() + 600);
+  ASSERT_OK(signer.SignToken(&token));
+  for (int i = 0; i < 3; i++) {
+    ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(token));
+  }
+
+  // A cached signature doesn't validate different token data, nor a
+  // different split of the same bytes between the data and the signature.
+  SignedTokenPB corrupt = token;
+  corrupt.set_signature(token.signature().substr(1));
+  ASSERT_EQ(VerificationResult::INVALID_SIGNATURE, verifier.VerifyTokenSignature(corrupt));
+  corrupt = token;
+  corrupt.set_token_data(token.token_data() + token.signature().substr(0, 1));
+  corrupt.set_signature(token.signature().substr(1));
+  ASSERT_NE(VerificationResult::VALID, verifier.VerifyTokenSignature(corrupt));
+
+  // More tokens than the cache holds are still verified.
+  for (int i = 0; i < 5; i++) {
+    SignedTokenPB other = MakeUnsignedToken(WallTime_Now() + 600 + i);
+    ASSERT_OK(signer.SignToken(&other));
+    ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(other));
+    ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(other));
+  }
+
+  // The expiration of a cached token is still checked.
+  SignedTokenPB expired = MakeUnsignedToken(WallTime_Now() + 1);
+  ASSERT_OK(signer.SignToken(&expired));
+  ASSERT_EQ(VerificationResult::VALID, verifier.VerifyTokenSignature(expired));
+  SleepFor(MonoDelta::FromSeconds(2));
+  ASSERT_EQ(VerificationResult::EXPIRED_TOKEN, verifier.VerifyTokenSignature(expired));
+}
+
 // Test all of the possible cases covered by token verification.
 // See VerificationResult.
 TEST_F(TokenTest, TestEndToEnd_InvalidCases) {
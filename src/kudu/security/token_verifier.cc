@@ -17,16 +17,30 @@
 
 #include "kudu/security/token_verifier.h"
 
+#include <algorithm>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <gflags/gflags.h>
+#include <openssl/sha.h>
+
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/security/token.pb.h"
 #include "kudu/security/token_signing_key.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 
+DEFINE_int32(token_verifier_cache_capacity, 0,
+             "Number of verified token signatures to cache, so that tokens "
+             "presented again are not verified with the public key again. "
+             "The expiration of the tokens is still checked. 0 disables "
+             "the cache.");
+TAG_FLAG(token_verifier_cache_capacity, experimental);
+TAG_FLAG(token_verifier_cache_capacity, runtime);
+
 using std::lock_guard;
 using std::string;
 using std::unique_ptr;
@@ -77,6 +91,11 @@ Status TokenVerifier::ImportPublicKeys(const vector<TokenSigningPublicKeyPB>& pu
   for (auto&& tsk_ptr : tsks) {
     keys_by_seq_.emplace(tsk_ptr->pb().key_seq_num(), std::move(tsk_ptr));
   }
+  // The imported keys may replace ones the cached signatures were verified
+  // with.
+  lock_guard<simple_spinlock> cache_l(cache_lock_);
+  verified_signatures_.clear();
+  verified_signatures_order_.clear();
   return Status::OK();
 }
 
@@ -117,14 +136,58 @@ VerificationResult TokenVerifier::VerifyTokenSignature(
     if (tsk->pb().expire_unix_epoch_seconds() < now) {
       return VerificationResult::EXPIRED_SIGNING_KEY;
     }
-    if (!tsk->VerifySignature(signed_token)) {
-      return VerificationResult::INVALID_SIGNATURE;
+    if (FLAGS_token_verifier_cache_capacity <= 0) {
+      if (!tsk->VerifySignature(signed_token)) {
+        return VerificationResult::INVALID_SIGNATURE;
+      }
+    } else {
+      string key = VerifiedSignatureKey(signed_token);
+      if (!IsVerifiedSignatureCached(key)) {
+        if (!tsk->VerifySignature(signed_token)) {
+          return VerificationResult::INVALID_SIGNATURE;
+        }
+        CacheVerifiedSignature(std::move(key));
+      }
     }
   }
 
   return VerificationResult::VALID;
 }
 
+string TokenVerifier::VerifiedSignatureKey(const SignedTokenPB& signed_token) {
+  // The length of the token data is hashed as well, so that the same bytes
+  // can't be split differently between the data and the signature.
+  const int64_t seq_num = signed_token.signing_key_seq_num();
+  const uint64_t data_len = signed_token.token_data().size();
+  SHA256_CTX ctx;
+  SHA256_Init(&ctx);
+  SHA256_Update(&ctx, &seq_num, sizeof(seq_num));
+  SHA256_Update(&ctx, &data_len, sizeof(data_len));
+  SHA256_Update(&ctx, signed_token.token_data().data(), data_len);
+  SHA256_Update(&ctx, signed_token.signature().data(), signed_token.signature().size());
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256_Final(digest, &ctx);
+  return string(reinterpret_cast<const char*>(digest), sizeof(digest));
+}
+
+bool TokenVerifier::IsVerifiedSignatureCached(const string& key) const {
+  lock_guard<simple_spinlock> l(cache_lock_);
+  return ContainsKey(verified_signatures_, key);
+}
+
+void TokenVerifier::CacheVerifiedSignature(string key) const {
+  const size_t capacity = std::max(FLAGS_token_verifier_cache_capacity, 0);
+  lock_guard<simple_spinlock> l(cache_lock_);
+  if (!verified_signatures_.insert(key).second) {
+    return;
+  }
+  verified_signatures_order_.emplace_back(std::move(key));
+  while (verified_signatures_order_.size() > capacity) {
+    verified_signatures_.erase(verified_signatures_order_.front());
+    verified_signatures_order_.pop_front();
+  }
+}
+
 } // namespace security
 } // namespace kudu
 
@@ -16,10 +16,14 @@
 // under the License.
 #pragma once
 
+#include <deque>
 #include <map>
+#include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/rw_mutex.h"
 
 namespace kudu {
@@ -47,6 +51,13 @@ enum class VerificationResult;
 // and is not yet expired. Any business rules around authorization or
 // authentication are left up to callers.
 //
+// If --token_verifier_cache_capacity is positive, the digests of the most
+// recently verified signatures are cached, so that a token presented again,
+// e.g. on each new connection of a client, is checked without a public-key
+// operation. The expiration of the token and of its signing key are still
+// checked on every verification, and the cache is cleared whenever keys are
+// imported.
+//
 // This class is thread-safe.
 class TokenVerifier {
  public:
@@ -74,10 +85,28 @@ class TokenVerifier {
   // void ExpireOldKeys();
 
  private:
+  // Returns the key under which the signature of 'signed_token' is cached.
+  static std::string VerifiedSignatureKey(const SignedTokenPB& signed_token);
+
+  // Returns true if the signature with cache key 'key' was verified before.
+  bool IsVerifiedSignatureCached(const std::string& key) const;
+
+  // Adds 'key' to the cache of verified signatures, evicting the oldest
+  // entry if the cache is full.
+  void CacheVerifiedSignature(std::string key) const;
+
   // Lock protecting keys_by_seq_
   mutable RWMutex lock_;
   std::map<int64_t, std::unique_ptr<TokenSigningPublicKey>> keys_by_seq_;
 
+  // Lock protecting the cache of verified signatures. Acquired after 'lock_'
+  // if both are held.
+  mutable simple_spinlock cache_lock_;
+  // The cache keys of the verified signatures, and the order in which they
+  // were added.
+  mutable std::unordered_set<std::string> verified_signatures_;
+  mutable std::deque<std::string> verified_signatures_order_;
+
   DISALLOW_COPY_AND_ASSIGN(TokenVerifier);
 };
 
@@ -31,6 +31,7 @@
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/human_readable.h"
+#include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/server/pprof-path-handlers.h"
@@ -144,6 +145,7 @@ static void MemTrackersHandler(const Webserver::WebRequest& req, std::ostringstr
   *output << "  <tr><th>Id</th><th>Parent</th><th>Limit</th><th>Current Consumption</th>"
       "<th>Peak consumption</th></tr>\n";
 
+  MemTracker::FlushLocalConsumption();
   vector<shared_ptr<MemTracker> > trackers;
   MemTracker::ListTrackers(&trackers);
   for (const shared_ptr<MemTracker>& tracker : trackers) {
@@ -170,12 +172,42 @@ void AddDefaultPathHandlers(Webserver* webserver) {
 }
 
 
+// Writes the metrics as JSON or, with format=prometheus, in the Prometheus
+// text format. Besides the substrings of entity IDs and metric names in
+// 'metrics', the metrics can be selected by entity type with 'types', e.g.
+// types=server,tablet, and by entity attribute with 'attributes', e.g.
+// attributes=table_name,t1,table_name,t2. With since_epoch=N, only the
+// metrics modified since the export which reported the 'metrics_epoch'
+// gauge of the server as N are written.
 static void WriteMetricsAsJson(const MetricRegistry* const metrics,
                                const Webserver::WebRequest& req, std::ostringstream* output) {
   const string* requested_metrics_param = FindOrNull(req.parsed_args, "metrics");
   vector<string> requested_metrics;
   MetricJsonOptions opts;
 
+  {
+    string arg = FindWithDefault(req.parsed_args, "types", "");
+    SplitStringUsing(arg, ",", &opts.entity_types);
+  }
+  {
+    vector<string> attrs;
+    SplitStringUsing(FindWithDefault(req.parsed_args, "attributes", ""), ",", &attrs);
+    if (attrs.size() % 2 != 0) {
+      *output << "The attributes argument must be a list of key,value pairs";
+      return;
+    }
+    for (int i = 0; i < attrs.size(); i += 2) {
+      opts.entity_attrs.emplace_back(attrs[i], attrs[i + 1]);
+    }
+  }
+  {
+    string arg = FindWithDefault(req.parsed_args, "since_epoch", "0");
+    if (!safe_strto64(arg.c_str(), &opts.only_modified_in_or_after_epoch)) {
+      *output << "Invalid since_epoch argument";
+      return;
+    }
+  }
+
   {
     string arg = FindWithDefault(req.parsed_args, "include_raw_histograms", "false");
     opts.include_raw_histograms = ParseLeadingBoolValue(arg.c_str(), false);
@@ -191,8 +223,6 @@ static void WriteMetricsAsJson(const MetricRegistry* const metrics,
       JsonWriter::COMPACT : JsonWriter::PRETTY;
   }
 
-  JsonWriter writer(output, json_mode);
-
   if (requested_metrics_param != nullptr) {
     SplitStringUsing(*requested_metrics_param, ",", &requested_metrics);
   } else {
@@ -200,6 +230,17 @@ static void WriteMetricsAsJson(const MetricRegistry* const metrics,
     requested_metrics.push_back("*");
   }
 
+  // Metrics modified from now on may or may not make it into this export,
+  // so are written by an export since the new epoch.
+  Metric::IncrementEpoch();
+
+  if (FindWithDefault(req.parsed_args, "format", "json") == "prometheus") {
+    WARN_NOT_OK(metrics->WriteAsPrometheus(output, requested_metrics, opts),
+                "Couldn't write Prometheus metrics over HTTP");
+    return;
+  }
+
+  JsonWriter writer(output, json_mode);
   WARN_NOT_OK(metrics->WriteAsJson(&writer, requested_metrics, opts),
               "Couldn't write JSON metrics over HTTP");
 }
@@ -19,6 +19,7 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
+#include "kudu/gutil/walltime.h"
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/random.h"
@@ -26,6 +27,8 @@
 #include "kudu/util/test_util.h"
 
 DECLARE_bool(use_mock_wall_clock);
+DECLARE_int32(hybrid_clock_error_refresh_interval_ms);
+DECLARE_int32(max_clock_sync_error_usec);
 
 namespace kudu {
 namespace server {
@@ -129,6 +132,24 @@ TEST_F(HybridClockTest, TestNow_ValuesIncreaseMonotonically) {
   ASSERT_LT(now1.value(), now2.value());
 }
 
+// Tests that the clock works when it only reads the error of the clock
+// from NTP periodically.
+TEST_F(HybridClockTest, TestNowWithPeriodicErrorRefresh) {
+  FLAGS_hybrid_clock_error_refresh_interval_ms = 10;
+  Timestamp prev = clock_->Now();
+  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(50);
+  while (MonoTime::Now() < deadline) {
+    Timestamp now;
+    uint64_t error;
+    clock_->NowWithError(&now, &error);
+    ASSERT_LT(prev.value(), now.value());
+    ASSERT_LE(error, FLAGS_max_clock_sync_error_usec);
+    ASSERT_NEAR(GetCurrentTimeMicros(), HybridClock::GetPhysicalValueMicros(now),
+                1000 * 1000);
+    prev = now;
+  }
+}
+
 // Tests the clock updates with the incoming value if it is higher.
 TEST_F(HybridClockTest, TestUpdate_LogicalValueIncreasesByAmount) {
   Timestamp now = clock_->Now();
@@ -42,6 +42,15 @@ DEFINE_int32(max_clock_sync_error_usec, 10 * 1000 * 1000, // 10 secs
 TAG_FLAG(max_clock_sync_error_usec, advanced);
 TAG_FLAG(max_clock_sync_error_usec, runtime);
 
+DEFINE_int32(hybrid_clock_error_refresh_interval_ms, 0,
+             "If positive, HybridClock reads the time with clock_gettime() rather than "
+             "ntp_gettime(), and only reads the maximum error of the clock from NTP "
+             "at this interval. In between, the error is bounded assuming the "
+             "maximum drift rate of the clock. A loss of clock synchronization is "
+             "only detected at the next NTP reading.");
+TAG_FLAG(hybrid_clock_error_refresh_interval_ms, experimental);
+TAG_FLAG(hybrid_clock_error_refresh_interval_ms, runtime);
+
 DEFINE_bool(use_hybrid_clock, true,
             "Whether HybridClock should be used as the default clock"
             " implementation. This should be disabled for testing purposes only.");
@@ -132,11 +141,20 @@ const uint64_t HybridClock::kNanosPerSec = 1000000;
 
 const double HybridClock::kAdjtimexScalingFactor = 65536;
 
+#if !defined(__APPLE__)
+// Without new NTP readings, the kernel increases the maximum error of the
+// clock by the maximum frequency error, 500 PPM (MAXFREQ), i.e. by 1us
+// every 2000us.
+static const int64_t kMaxDriftDivisor = 2000;
+#endif
+
 HybridClock::HybridClock()
     : mock_clock_time_usec_(0),
       mock_clock_max_error_usec_(0),
 #if !defined(__APPLE__)
       divisor_(1),
+      error_base_usec_(0),
+      error_refresh_usec_(0),
 #endif
       tolerance_adjustment_(1),
       next_timestamp_(0),
@@ -153,11 +171,6 @@ Status HybridClock::Init() {
   LOG(WARNING) << "HybridClock initialized in local mode (OS X only). "
                << "Not suitable for distributed clusters.";
 #else
-  // Read the current time. This will return an error if the clock is not synchronized.
-  uint64_t now_usec;
-  uint64_t error_usec;
-  RETURN_NOT_OK(WalltimeWithError(&now_usec, &error_usec));
-
   timex timex;
   RETURN_NOT_OK(GetClockModes(&timex));
   // read whether the STA_NANO bit is set to know whether we'll get back nanos
@@ -170,6 +183,11 @@ Status HybridClock::Init() {
     divisor_ = 1;
   }
 
+  // Read the current time. This will return an error if the clock is not synchronized.
+  uint64_t now_usec;
+  uint64_t error_usec;
+  RETURN_NOT_OK(WalltimeWithError(&now_usec, &error_usec));
+
   // Calculate the sleep skew adjustment according to the max tolerance of the clock.
   // Tolerance comes in parts per million but needs to be applied a scaling factor.
   tolerance_adjustment_ = (1 + ((timex.tolerance / kAdjtimexScalingFactor) / 1000000.0));
@@ -187,8 +205,6 @@ Status HybridClock::Init() {
 Timestamp HybridClock::Now() {
   Timestamp now;
   uint64_t error;
-
-  std::lock_guard<simple_spinlock> lock(lock_);
   NowWithError(&now, &error);
   return now;
 }
@@ -196,11 +212,7 @@ Timestamp HybridClock::Now() {
 Timestamp HybridClock::NowLatest() {
   Timestamp now;
   uint64_t error;
-
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    NowWithError(&now, &error);
-  }
+  NowWithError(&now, &error);
 
   uint64_t now_latest = GetPhysicalValueMicros(now) + error;
   uint64_t now_logical = GetLogicalValue(now);
@@ -231,9 +243,14 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
   // If the physical time from the system clock is higher than our last-returned
   // time, we should use the physical timestamp.
   uint64_t candidate_phys_timestamp = now_usec << kBitsToShift;
-  if (PREDICT_TRUE(candidate_phys_timestamp > next_timestamp_)) {
-    next_timestamp_ = candidate_phys_timestamp;
-    *timestamp = Timestamp(next_timestamp_++);
+  uint64_t next_timestamp = next_timestamp_.load(std::memory_order_relaxed);
+  uint64_t ts;
+  do {
+    ts = std::max(candidate_phys_timestamp, next_timestamp);
+  } while (!next_timestamp_.compare_exchange_weak(next_timestamp, ts + 1));
+
+  if (PREDICT_TRUE(ts == candidate_phys_timestamp)) {
+    *timestamp = Timestamp(ts);
     *max_error_usec = error_usec;
     if (PREDICT_FALSE(VLOG_IS_ON(2))) {
       VLOG(2) << "Current clock is higher than the last one. Resetting logical values."
@@ -261,8 +278,8 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
   // This broadens the error interval for both cases but always returns
   // a correct error interval.
 
-  *max_error_usec = (next_timestamp_ >> kBitsToShift) - (now_usec - error_usec);
-  *timestamp = Timestamp(next_timestamp_++);
+  *max_error_usec = (ts >> kBitsToShift) - (now_usec - error_usec);
+  *timestamp = Timestamp(ts);
   if (PREDICT_FALSE(VLOG_IS_ON(2))) {
     VLOG(2) << "Current clock is lower than the last one. Returning last read and incrementing"
         " logical values. Clock: " + Stringify(*timestamp) << " Error: " << *max_error_usec;
@@ -270,7 +287,6 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
 }
 
 Status HybridClock::Update(const Timestamp& to_update) {
-  std::lock_guard<simple_spinlock> lock(lock_);
   Timestamp now;
   uint64_t error_ignored;
   NowWithError(&now, &error_ignored);
@@ -293,7 +309,10 @@ Status HybridClock::Update(const Timestamp& to_update) {
 
   // Our next timestamp must be higher than the one that we are updating
   // from.
-  next_timestamp_ = to_update.value() + 1;
+  uint64_t next_timestamp = next_timestamp_.load(std::memory_order_relaxed);
+  while (next_timestamp <= to_update.value() &&
+         !next_timestamp_.compare_exchange_weak(next_timestamp, to_update.value() + 1)) {
+  }
   return Status::OK();
 }
 
@@ -314,10 +333,7 @@ Status HybridClock::WaitUntilAfter(const Timestamp& then,
   TRACE_EVENT0("clock", "HybridClock::WaitUntilAfter");
   Timestamp now;
   uint64_t error;
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    NowWithError(&now, &error);
-  }
+  NowWithError(&now, &error);
 
   // "unshift" the timestamps so that we can measure actual time
   uint64_t now_usec = GetPhysicalValueMicros(now);
@@ -358,10 +374,7 @@ Status HybridClock::WaitUntilAfterLocally(const Timestamp& then,
   while (true) {
     Timestamp now;
     uint64_t error;
-    {
-      std::lock_guard<simple_spinlock> lock(lock_);
-      NowWithError(&now, &error);
-    }
+    NowWithError(&now, &error);
     if (now > then) {
       return Status::OK();
     }
@@ -379,11 +392,7 @@ bool HybridClock::IsAfter(Timestamp t) {
   uint64_t error_usec;
   CHECK_OK(WalltimeWithError(&now_usec, &error_usec));
 
-  Timestamp now;
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    now = Timestamp(std::max(next_timestamp_, now_usec << kBitsToShift));
-  }
+  Timestamp now(std::max(next_timestamp_.load(), now_usec << kBitsToShift));
   return t.value() < now.value();
 }
 
@@ -400,6 +409,9 @@ kudu::Status HybridClock::WalltimeWithError(uint64_t* now_usec, uint64_t* error_
     *error_usec = 0;
   }
 #else
+    if (FLAGS_hybrid_clock_error_refresh_interval_ms > 0) {
+      return FastWalltimeWithError(now_usec, error_usec);
+    }
     // Read the time. This will return an error if the clock is not synchronized.
     ntptimeval timeval;
     RETURN_NOT_OK(GetClockTime(&timeval));
@@ -417,6 +429,47 @@ kudu::Status HybridClock::WalltimeWithError(uint64_t* now_usec, uint64_t* error_
   return kudu::Status::OK();
 }
 
+#if !defined(__APPLE__)
+kudu::Status HybridClock::FastWalltimeWithError(uint64_t* now_usec, uint64_t* error_usec) {
+  timespec ts;
+  PCHECK(clock_gettime(CLOCK_REALTIME, &ts) == 0);
+  *now_usec = ts.tv_sec * kNanosPerSec + ts.tv_nsec / 1000;
+
+  uint64_t refresh_usec = error_refresh_usec_.load(std::memory_order_acquire);
+  if (*now_usec < refresh_usec ||
+      *now_usec - refresh_usec >=
+          static_cast<uint64_t>(FLAGS_hybrid_clock_error_refresh_interval_ms) * 1000) {
+    RETURN_NOT_OK(RefreshClockError(refresh_usec));
+  }
+  // A bound from any earlier NTP reading remains valid, so the error may
+  // be computed from a reading newer or older than 'refresh_usec'.
+  int64_t error = error_base_usec_.load(std::memory_order_acquire) +
+      static_cast<int64_t>(*now_usec) / kMaxDriftDivisor + 1;
+  *error_usec = std::max<int64_t>(error, 0);
+
+  if (*error_usec > FLAGS_max_clock_sync_error_usec) {
+    return Status::ServiceUnavailable(Substitute("Error: Clock synchronized but error was"
+        "too high ($0 us).", *error_usec));
+  }
+  return kudu::Status::OK();
+}
+
+kudu::Status HybridClock::RefreshClockError(uint64_t refresh_usec) {
+  std::lock_guard<simple_spinlock> l(error_refresh_lock_);
+  if (error_refresh_usec_.load(std::memory_order_relaxed) != refresh_usec) {
+    // Another thread refreshed the error while we were waiting.
+    return Status::OK();
+  }
+  ntptimeval timeval;
+  RETURN_NOT_OK(GetClockTime(&timeval));
+  int64_t ntp_now_usec = timeval.time.tv_sec * kNanosPerSec + timeval.time.tv_usec / divisor_;
+  error_base_usec_.store(static_cast<int64_t>(timeval.maxerror) - ntp_now_usec / kMaxDriftDivisor,
+                         std::memory_order_release);
+  error_refresh_usec_.store(ntp_now_usec, std::memory_order_release);
+  return Status::OK();
+}
+#endif // !defined(__APPLE__)
+
 void HybridClock::SetMockClockWallTimeForTests(uint64_t now_usec) {
   CHECK(FLAGS_use_mock_wall_clock);
   std::lock_guard<simple_spinlock> lock(lock_);
@@ -439,8 +492,6 @@ uint64_t HybridClock::NowForMetrics() {
 uint64_t HybridClock::ErrorForMetrics() {
   Timestamp now;
   uint64_t error;
-
-  std::lock_guard<simple_spinlock> lock(lock_);
   NowWithError(&now, &error);
   return error;
 }
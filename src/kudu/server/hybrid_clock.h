@@ -18,6 +18,7 @@
 #ifndef KUDU_SERVER_HYBRID_CLOCK_H_
 #define KUDU_SERVER_HYBRID_CLOCK_H_
 
+#include <atomic>
 #include <string>
 
 #include "kudu/gutil/ref_counted.h"
@@ -170,6 +171,18 @@ class HybridClock : public Clock {
   // On OS X, the error will always be 0.
   kudu::Status WalltimeWithError(uint64_t* now_usec, uint64_t* error_usec);
 
+#if !defined(__APPLE__)
+  // Like WalltimeWithError(), but reads the time with clock_gettime(), and
+  // bounds the error from the last error reported by NTP, read at most
+  // every --hybrid_clock_error_refresh_interval_ms.
+  kudu::Status FastWalltimeWithError(uint64_t* now_usec, uint64_t* error_usec);
+
+  // Reads the maximum error of the clock from NTP into 'error_base_usec_',
+  // unless another thread did since the reading at 'refresh_usec', which the
+  // caller found to be stale.
+  kudu::Status RefreshClockError(uint64_t refresh_usec);
+#endif
+
   // Used to get the timestamp for metrics.
   uint64_t NowForMetrics();
 
@@ -178,23 +191,34 @@ class HybridClock : public Clock {
 
   // Set by calls to SetMockClockWallTimeForTests().
   // For testing purposes only.
-  uint64_t mock_clock_time_usec_;
+  std::atomic<uint64_t> mock_clock_time_usec_;
 
   // Set by calls to SetMockClockErrorForTests().
   // For testing purposes only.
-  uint64_t mock_clock_max_error_usec_;
+  std::atomic<uint64_t> mock_clock_max_error_usec_;
 
 #if !defined(__APPLE__)
   uint64_t divisor_;
+
+  // The maximum error of the clock at time t (in microseconds since the epoch)
+  // is bounded by 'error_base_usec_' + t / kMaxDriftDivisor. Set from the
+  // last NTP reading, which is at 'error_refresh_usec_'.
+  std::atomic<int64_t> error_base_usec_;
+  std::atomic<uint64_t> error_refresh_usec_;
+
+  // Serializes the NTP readings of RefreshClockError().
+  simple_spinlock error_refresh_lock_;
 #endif
 
   double tolerance_adjustment_;
 
+  // Protects the mock clock.
   mutable simple_spinlock lock_;
 
   // The next timestamp to be generated from this clock, assuming that
   // the physical clock hasn't advanced beyond the value stored here.
-  uint64_t next_timestamp_;
+  // Only ever increases.
+  std::atomic<uint64_t> next_timestamp_;
 
   // How many bits to left shift a microseconds clock read. The remainder
   // of the timestamp will be reserved for logical values.
@@ -63,6 +63,21 @@ namespace kudu {
 
 const int PPROF_DEFAULT_SAMPLE_SECS = 30; // pprof default sample time in seconds.
 
+// The default interval between samples of the stacks of all threads in a
+// wall-clock profile.
+const int kWallClockDefaultSampleIntervalMs = 100;
+
+// Appends the memory mappings of the process to a contention profile, so that
+// pprof can symbolize the addresses in shared libraries.
+static void AppendProcMaps(ostringstream* output) {
+#if defined(__linux__)
+  // procfs only exists on Linux.
+  faststring maps;
+  ReadFileToString(Env::Default(), "/proc/self/maps", &maps);
+  *output << maps.ToString();
+#endif // defined(__linux__)
+}
+
 // pprof asks for the url /pprof/cmdline to figure out what application it's profiling.
 // The server should respond by sending the executable path.
 static void PprofCmdLineHandler(const Webserver::WebRequest& req, ostringstream* output) {
@@ -163,13 +178,34 @@ static void PprofContentionHandler(const Webserver::WebRequest& req, ostringstre
   // pprof itself ignores this value, but we can at least look at it in the textual
   // output.
   *output << "discarded samples = " << discarded_samples << std::endl;
+  AppendProcMaps(output);
+}
 
-#if defined(__linux__)
-  // procfs only exists on Linux.
-  faststring maps;
-  ReadFileToString(Env::Default(), "/proc/self/maps", &maps);
-  *output << maps.ToString();
-#endif // defined(__linux__)
+// pprof asks for the url /pprof/wallclock to get a wall-clock (or "off-CPU")
+// profile: the stacks of all threads are sampled periodically, whether they are
+// running or blocked, e.g. on I/O or a condition variable. The profile is in
+// the same format as /pprof/contention, so it is read with 'pprof --contention'.
+static void PprofWallClockHandler(const Webserver::WebRequest& req, ostringstream* output) {
+  string secs_str = FindWithDefault(req.parsed_args, "seconds", "");
+  int32_t seconds = ParseLeadingInt32Value(secs_str.c_str(), PPROF_DEFAULT_SAMPLE_SECS);
+  string interval_str = FindWithDefault(req.parsed_args, "interval_ms", "");
+  int32_t interval_ms = ParseLeadingInt32Value(interval_str.c_str(),
+                                               kWallClockDefaultSampleIntervalMs);
+  if (interval_ms <= 0) {
+    interval_ms = kWallClockDefaultSampleIntervalMs;
+  }
+  int64_t discarded_samples = 0;
+
+  *output << "--- contention" << endl;
+  *output << "sampling period = 1" << endl;
+  *output << "cycles/second = " << base::CyclesPerSecond() << endl;
+
+  SampleThreadStacks(MonoDelta::FromSeconds(seconds),
+                     MonoDelta::FromMilliseconds(interval_ms),
+                     output, &discarded_samples);
+
+  *output << "discarded samples = " << discarded_samples << std::endl;
+  AppendProcMaps(output);
 }
 
 
@@ -235,6 +271,7 @@ void AddPprofPathHandlers(Webserver* webserver) {
   webserver->RegisterPathHandler("/pprof/profile", "", PprofCpuProfileHandler, false, false);
   webserver->RegisterPathHandler("/pprof/symbol", "", PprofSymbolHandler, false, false);
   webserver->RegisterPathHandler("/pprof/contention", "", PprofContentionHandler, false, false);
+  webserver->RegisterPathHandler("/pprof/wallclock", "", PprofWallClockHandler, false, false);
 }
 
 } // namespace kudu
@@ -23,6 +23,8 @@
 
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/acceptor_pool.h"
 #include "kudu/rpc/messenger.h"
@@ -59,6 +61,14 @@ DEFINE_int32(rpc_service_queue_length, 50,
              "Default length of queue for incoming RPC requests");
 TAG_FLAG(rpc_service_queue_length, advanced);
 
+DEFINE_string(rpc_service_method_queues, "",
+              "Semicolon-separated list of groups of RPC methods whose calls are handled by "
+              "a queue and worker threads of their own, isolated from the other calls of "
+              "their service. Each group is formatted as "
+              "<service>:<method>[,<method>...]:<num threads>:<queue length>, e.g. "
+              "'kudu.tserver.TabletServerService:Scan,ScannerKeepAlive:4:50'.");
+TAG_FLAG(rpc_service_method_queues, experimental);
+
 DEFINE_bool(rpc_server_allow_ephemeral_ports, false,
             "Allow binding to ephemeral ports. This can cause problems, so currently "
             "only allowed in tests.");
@@ -71,7 +81,8 @@ RpcServerOptions::RpcServerOptions()
     num_acceptors_per_address(FLAGS_rpc_num_acceptors_per_address),
     num_service_threads(FLAGS_rpc_num_service_threads),
     default_port(0),
-    service_queue_length(FLAGS_rpc_service_queue_length) {
+    service_queue_length(FLAGS_rpc_service_queue_length),
+    service_method_queues(FLAGS_rpc_service_method_queues) {
 }
 
 RpcServer::RpcServer(RpcServerOptions opts)
@@ -119,11 +130,34 @@ Status RpcServer::RegisterService(gscoped_ptr<rpc::ServiceIf> service) {
   string service_name = service->service_name();
   scoped_refptr<rpc::ServicePool> service_pool =
     new rpc::ServicePool(std::move(service), metric_entity, options_.service_queue_length);
+  RETURN_NOT_OK(AddMethodQueues(service_name, service_pool.get()));
   RETURN_NOT_OK(service_pool->Init(options_.num_service_threads));
   RETURN_NOT_OK(messenger_->RegisterService(service_name, service_pool));
   return Status::OK();
 }
 
+Status RpcServer::AddMethodQueues(const string& service_name,
+                                  rpc::ServicePool* service_pool) const {
+  for (StringPiece group : strings::Split(options_.service_method_queues, ";",
+                                          strings::SkipWhitespace())) {
+    vector<string> fields = strings::Split(group, ":");
+    uint32_t num_threads;
+    uint32_t queue_length;
+    if (fields.size() != 4 ||
+        !safe_strtou32(fields[2], &num_threads) ||
+        !safe_strtou32(fields[3], &queue_length)) {
+      return Status::InvalidArgument("invalid RPC method queue", group.ToString());
+    }
+    if (fields[0] != service_name) {
+      continue;
+    }
+    vector<string> methods = strings::Split(fields[1], ",", strings::SkipEmpty());
+    RETURN_NOT_OK_PREPEND(service_pool->AddMethodQueue(methods, num_threads, queue_length),
+                          Substitute("unable to add RPC method queue $0", group.ToString()));
+  }
+  return Status::OK();
+}
+
 Status RpcServer::Bind() {
   CHECK_EQ(server_state_, INITIALIZED);
 
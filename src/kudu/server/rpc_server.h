@@ -43,6 +43,9 @@ struct RpcServerOptions {
   uint32_t num_service_threads;
   uint16_t default_port;
   size_t service_queue_length;
+  // The groups of methods handled by their own queue and worker threads,
+  // see --rpc_service_method_queues.
+  std::string service_method_queues;
 };
 
 class RpcServer {
@@ -67,6 +70,11 @@ class RpcServer {
   const rpc::ServicePool* service_pool(const std::string& service_name) const;
 
  private:
+  // Adds the method queues of 'service_pool' configured for 'service_name'
+  // in the options.
+  Status AddMethodQueues(const std::string& service_name,
+                         rpc::ServicePool* service_pool) const;
+
   enum ServerState {
     // Default state when the rpc server is constructed.
     UNINITIALIZED,
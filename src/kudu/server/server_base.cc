@@ -70,6 +70,12 @@ TAG_FLAG(min_negotiation_threads, advanced);
 DEFINE_int32(max_negotiation_threads, 50, "Maximum number of connection negotiation threads.");
 TAG_FLAG(max_negotiation_threads, advanced);
 
+METRIC_DEFINE_gauge_int64(server, metrics_epoch, "Metrics Epoch",
+                          kudu::MetricUnit::kUnits,
+                          "The epoch of the latest export of the metrics. Passing it as "
+                          "the since_epoch argument of the next export over HTTP limits "
+                          "that export to the metrics modified since this one.");
+
 DECLARE_bool(use_hybrid_clock);
 
 using std::ostringstream;
@@ -165,6 +171,7 @@ Status ServerBase::Init() {
   glog_metrics_.reset(new ScopedGLogMetrics(metric_entity_));
   tcmalloc::RegisterMetrics(metric_entity_);
   RegisterSpinLockContentionMetrics(metric_entity_);
+  METRIC_metrics_epoch.InstantiateFunctionGauge(metric_entity_, Bind(&Metric::current_epoch));
 
   InitSpinLockContentionProfiling();
 
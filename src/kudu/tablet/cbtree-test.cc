@@ -15,6 +15,9 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
+#include <string>
+
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <thread>
@@ -35,6 +38,7 @@ namespace kudu {
 namespace tablet {
 namespace btree {
 
+using std::string;
 using std::thread;
 using std::unordered_set;
 using std::vector;
@@ -157,8 +161,8 @@ TEST_F(TestCBTree, TestLeafNodeBigKVs) {
 // splitting, etc.
 struct SmallFanoutTraits : public BTreeTraits {
 
-  static const size_t internal_node_size = 84;
-  static const size_t leaf_node_size = 92;
+  static const size_t internal_node_size = 116;
+  static const size_t leaf_node_size = 121;
 };
 
 // Enables yield() calls at interesting points of the btree
@@ -312,6 +316,42 @@ static void InsertRandomKeys(TREE *t, int n_keys,
   }
 }
 
+// Test keys which share their first 8 bytes, or are shorter than 8 bytes, so
+// that searches can't be decided by the nodes' key prefixes alone.
+TEST_F(TestCBTree, TestInsertAndVerifyCommonPrefixes) {
+  CBTree<SmallFanoutTraits> t;
+  vector<string> keys;
+  for (int i = 0; i < 1000; i++) {
+    keys.push_back(StringPrintf("common_prefix_%d", i));
+    keys.push_back(StringPrintf("%d", i));
+    keys.push_back(string("abc\0", 4) + StringPrintf("%d", i));
+  }
+  keys.push_back(string("\0", 1));
+  keys.push_back(string("\0\0\0\0\0\0\0\0\0", 9));
+  std::random_shuffle(keys.begin(), keys.end());
+
+  for (const string& key : keys) {
+    ASSERT_TRUE(t.Insert(Slice(key), Slice(key)));
+  }
+  for (const string& key : keys) {
+    ASSERT_FALSE(t.Insert(Slice(key), Slice(key)));
+    VerifyGet(t, Slice(key), Slice(key));
+  }
+
+  std::sort(keys.begin(), keys.end());
+  gscoped_ptr<CBTreeIterator<SmallFanoutTraits> > iter(t.NewIterator());
+  bool exact;
+  ASSERT_TRUE(iter->SeekAtOrAfter(Slice(""), &exact));
+  for (const string& key : keys) {
+    ASSERT_TRUE(iter->IsValid());
+    Slice k, v;
+    iter->GetCurrentEntry(&k, &v);
+    ASSERT_EQ(key, k.ToString());
+    iter->Next();
+  }
+  ASSERT_FALSE(iter->IsValid());
+}
+
 // Similar to above, but inserts in random order
 TEST_F(TestCBTree, TestInsertAndVerifyRandom) {
   CBTree<SmallFanoutTraits> t;
@@ -509,6 +549,42 @@ TEST_F(TestCBTree, TestIterator) {
   }
 }
 
+// Test that the split keys divide the tree into ranges of similar sizes.
+TEST_F(TestCBTree, TestGetSplitKeys) {
+  CBTree<SmallFanoutTraits> t;
+  vector<string> split_keys;
+  t.GetSplitKeys(7, &split_keys);
+  ASSERT_TRUE(split_keys.empty());
+
+  // A tree with only a root leaf can't be split.
+  ASSERT_TRUE(t.Insert(Slice("key1"), Slice("val")));
+  t.GetSplitKeys(7, &split_keys);
+  ASSERT_TRUE(split_keys.empty());
+
+  int n_keys = 10000;
+  unordered_set<int> inserted(n_keys);
+  InsertRandomKeys(&t, n_keys, &inserted);
+  t.GetSplitKeys(7, &split_keys);
+  ASSERT_EQ(7, split_keys.size());
+  ASSERT_TRUE(std::is_sorted(split_keys.begin(), split_keys.end()));
+  ASSERT_TRUE(std::adjacent_find(split_keys.begin(), split_keys.end()) == split_keys.end());
+
+  // Count the entries in each range.
+  vector<int> range_sizes(split_keys.size() + 1);
+  gscoped_ptr<CBTreeIterator<SmallFanoutTraits> > iter(t.NewIterator());
+  bool exact;
+  ASSERT_TRUE(iter->SeekAtOrAfter(Slice(""), &exact));
+  while (iter->IsValid()) {
+    string key = iter->GetCurrentKey().ToString();
+    range_sizes[std::upper_bound(split_keys.begin(), split_keys.end(), key) -
+                split_keys.begin()]++;
+    iter->Next();
+  }
+  for (int size : range_sizes) {
+    ASSERT_GT(size, n_keys / range_sizes.size() / 4);
+  }
+}
+
 // Test the limited "Rewind" functionality within a given leaf node.
 TEST_F(TestCBTree, TestIteratorRewind) {
   CBTree<SmallFanoutTraits> t;
@@ -26,7 +26,13 @@
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(cfile_set_secondary_index_scan);
+DECLARE_bool(cfile_set_skip_scan);
 DECLARE_int32(cfile_default_block_size);
+DECLARE_int32(cfile_set_sample_chunk_rows);
+DECLARE_int32(cfile_set_skip_scan_min_rows_per_prefix);
+DECLARE_bool(materializing_iterator_skip_deselected_blocks);
+DECLARE_bool(tablet_write_secondary_indexes);
 
 using std::shared_ptr;
 
@@ -291,6 +297,98 @@ TEST_F(TestCFileSet, TestRangeScan) {
   EXPECT_EQ(stats[2].data_blocks_read_from_disk, 1);
 }
 
+TEST_F(TestCFileSet, TestSampleScan) {
+  const int kNumRows = 10000;
+  const int kChunkRows = 500;
+  FLAGS_cfile_set_sample_chunk_rows = kChunkRows;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset;
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset));
+
+  auto scan = [&](double fraction, uint64_t seed, vector<string>* results,
+                  vector<IteratorStats>* stats) {
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ScanSpec spec;
+    spec.set_sample_fraction(fraction);
+    spec.set_sample_seed(seed);
+    ASSERT_OK(iter->Init(&spec));
+    ASSERT_OK(IterateToStringList(iter.get(), results));
+    iter->GetIteratorStats(stats);
+  };
+
+  vector<string> all_rows;
+  vector<IteratorStats> all_stats;
+  NO_FATALS(scan(1, 0, &all_rows, &all_stats));
+  ASSERT_EQ(kNumRows, all_rows.size());
+
+  // The sample is made of whole chunks of rows, and the chunks which aren't
+  // sampled are never read.
+  vector<string> sample;
+  vector<IteratorStats> sample_stats;
+  NO_FATALS(scan(0.5, 1, &sample, &sample_stats));
+  ASSERT_GT(sample.size(), 0);
+  ASSERT_LT(sample.size(), kNumRows);
+  ASSERT_EQ(0, sample.size() % kChunkRows);
+  for (int i = 0; i < sample_stats.size(); i++) {
+    EXPECT_LT(sample_stats[i].data_blocks_read_from_disk,
+              all_stats[i].data_blocks_read_from_disk);
+  }
+
+  // The same seed samples the same rows.
+  vector<string> same_sample;
+  NO_FATALS(scan(0.5, 1, &same_sample, &sample_stats));
+  ASSERT_EQ(sample, same_sample);
+}
+
+// Ensure that with a selective predicate on a non-key column, the data blocks
+// of the other columns which hold no selected rows are not read.
+TEST_F(TestCFileSet, TestSkipDeselectedBlocks) {
+  const int kNumRows = 10000;
+  WriteTestRowSet(kNumRows);
+
+  shared_ptr<CFileSet> fileset;
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset));
+
+  for (bool skip : { false, true }) {
+    FLAGS_materializing_iterator_skip_deselected_blocks = skip;
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+
+    // Select the first 100 rows, all of which fall into the first batch.
+    ScanSpec spec;
+    int32_t lower = 0;
+    int32_t upper = 1000;
+    spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), &lower, &upper));
+    ASSERT_OK(iter->Init(&spec));
+
+    Arena arena(1024, 1024 * 1024);
+    RowBlock block(schema_, kNumRows, &arena);
+    int selected = 0;
+    while (iter->HasNext()) {
+      ASSERT_OK(iter->NextBlock(&block));
+      for (size_t i = 0; i < block.nrows(); i++) {
+        if (block.selection_vector()->IsRowSelected(i)) {
+          ASSERT_EQ(selected * 2, *schema_.ExtractColumnFromRow<INT32>(block.row(i), 0));
+          ASSERT_EQ(selected * 100, *schema_.ExtractColumnFromRow<INT32>(block.row(i), 2));
+          selected++;
+        }
+      }
+    }
+    ASSERT_EQ(100, selected);
+
+    vector<IteratorStats> stats;
+    iter->GetIteratorStats(&stats);
+    LOG(INFO) << "skip=" << skip << ": " << stats[2].ToString();
+    if (skip) {
+      ASSERT_LE(stats[2].data_blocks_read_from_disk, 2);
+    } else {
+      ASSERT_GT(stats[2].data_blocks_read_from_disk, 10);
+    }
+  }
+}
+
 // Several other black-box tests for range scans. These are similar to
 // TestRangeScan above, except don't inspect internal state.
 TEST_F(TestCFileSet, TestRangePredicates2) {
@@ -318,6 +416,189 @@ TEST_F(TestCFileSet, TestRangePredicates2) {
   DoTestRangeScan(fileset, kNumRows * 10, kNoBound);
 }
 
+class TestCFileSetSkipScan : public KuduRowSetTest {
+ public:
+  TestCFileSetSkipScan() :
+    KuduRowSetTest(Schema({ ColumnSchema("host", STRING),
+                            ColumnSchema("ts", INT64),
+                            ColumnSchema("val", INT32) }, 2))
+  {}
+
+  // Write out a test rowset with 'kNumHosts' distinct hosts, each with
+  // 'kRowsPerHost' consecutive timestamps.
+  void WriteTestRowSet() {
+    DiskRowSetWriter rsw(rowset_meta_.get(), &schema_,
+                         BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f));
+    ASSERT_OK(rsw.Open());
+
+    RowBuilder rb(schema_);
+    for (int h = 0; h < kNumHosts; h++) {
+      string host = StringPrintf("host%d", h);
+      for (int64_t ts = 0; ts < kRowsPerHost; ts++) {
+        rb.Reset();
+        rb.AddString(host);
+        rb.AddInt64(ts);
+        rb.AddInt32(h);
+        ASSERT_OK_FAST(WriteRow(rb.data(), &rsw));
+      }
+    }
+    ASSERT_OK(rsw.Finish());
+  }
+
+  // Scans the rowset with 'pred', returning the results in 'rows' and whether
+  // the scan was a skip scan in 'skip_scan'.
+  void Scan(const shared_ptr<CFileSet>& fileset, const ColumnPredicate& pred,
+            vector<string>* rows, bool* skip_scan) {
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ScanSpec spec;
+    spec.AddPredicate(pred);
+    ASSERT_OK(iter->Init(&spec));
+    *skip_scan = cfile_iter->skip_scan_;
+    ASSERT_OK(IterateToStringList(iter.get(), rows));
+  }
+
+ protected:
+  static const int kNumHosts = 5;
+  static const int kRowsPerHost = 2000;
+  google::FlagSaver saver;
+};
+
+TEST_F(TestCFileSetSkipScan, TestSkipScan) {
+  FLAGS_cfile_set_skip_scan = true;
+  FLAGS_cfile_set_skip_scan_min_rows_per_prefix = 100;
+  WriteTestRowSet();
+
+  shared_ptr<CFileSet> fileset;
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset));
+
+  int64_t lower = 1000;
+  int64_t upper = 1010;
+  auto range = ColumnPredicate::Range(schema_.column(1), &lower, &upper);
+  auto equality = ColumnPredicate::Equality(schema_.column(1), &upper);
+
+  // A range on the second key column returns the matching rows of each host.
+  vector<string> rows;
+  bool skip_scan;
+  NO_FATALS(Scan(fileset, range, &rows, &skip_scan));
+  ASSERT_TRUE(skip_scan);
+  ASSERT_EQ(kNumHosts * (upper - lower), rows.size());
+  ASSERT_EQ(R"((string host="host0", int64 ts=1000, int32 val=0))", rows.front());
+  ASSERT_EQ(R"((string host="host4", int64 ts=1009, int32 val=4))", rows.back());
+
+  rows.clear();
+  NO_FATALS(Scan(fileset, equality, &rows, &skip_scan));
+  ASSERT_TRUE(skip_scan);
+  ASSERT_EQ(kNumHosts, rows.size());
+  for (int h = 0; h < kNumHosts; h++) {
+    ASSERT_EQ(StringPrintf(R"((string host="host%d", int64 ts=1010, int32 val=%d))", h, h),
+              rows[h]);
+  }
+
+  // With too few rows per host, the cost estimate picks a full scan, which
+  // returns the same results.
+  FLAGS_cfile_set_skip_scan_min_rows_per_prefix = 100000;
+  rows.clear();
+  NO_FATALS(Scan(fileset, range, &rows, &skip_scan));
+  ASSERT_FALSE(skip_scan);
+  ASSERT_EQ(kNumHosts * (upper - lower), rows.size());
+}
+
+class TestCFileSetSecondaryIndex : public KuduRowSetTest {
+ public:
+  TestCFileSetSecondaryIndex() :
+    KuduRowSetTest(Schema({ ColumnSchema("key", INT32),
+                            ColumnSchema("val", INT32, true, nullptr, nullptr,
+                                         GetIndexedStorage()) }, 1))
+  {}
+
+  // Write out a test rowset whose values repeat every 'kNumValues' rows, and
+  // are NULL in every seventh row.
+  void WriteTestRowSet() {
+    DiskRowSetWriter rsw(rowset_meta_.get(), &schema_,
+                         BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f));
+    ASSERT_OK(rsw.Open());
+
+    RowBuilder rb(schema_);
+    for (int i = 0; i < kNumRows; i++) {
+      rb.Reset();
+      rb.AddInt32(i);
+      if (i % 7 == 0) {
+        rb.AddNull();
+      } else {
+        rb.AddInt32(i % kNumValues);
+      }
+      ASSERT_OK_FAST(WriteRow(rb.data(), &rsw));
+    }
+    ASSERT_OK(rsw.Finish());
+  }
+
+  // Scans the rowset with 'pred', returning the results in 'rows' and whether
+  // the scan used the index in 'index_scan'.
+  void Scan(const shared_ptr<CFileSet>& fileset, const ColumnPredicate& pred,
+            vector<string>* rows, bool* index_scan) {
+    shared_ptr<CFileSet::Iterator> cfile_iter(fileset->NewIterator(&schema_));
+    cfile_iter->set_indexable_column_ids(fileset->indexed_column_ids());
+    gscoped_ptr<RowwiseIterator> iter(new MaterializingIterator(cfile_iter));
+    ScanSpec spec;
+    spec.AddPredicate(pred);
+    ASSERT_OK(iter->Init(&spec));
+    *index_scan = cfile_iter->index_scan_;
+    ASSERT_OK(IterateToStringList(iter.get(), rows));
+  }
+
+ protected:
+  static ColumnStorageAttributes GetIndexedStorage() {
+    ColumnStorageAttributes attributes;
+    attributes.indexed = true;
+    return attributes;
+  }
+
+  static const int kNumRows = 10000;
+  static const int kNumValues = 1000;
+  google::FlagSaver saver;
+};
+
+TEST_F(TestCFileSetSecondaryIndex, TestIndexScan) {
+  FLAGS_tablet_write_secondary_indexes = true;
+  WriteTestRowSet();
+  ASSERT_EQ(1, rowset_meta_->GetSecondaryIndexBlocksById().size());
+
+  shared_ptr<CFileSet> fileset;
+  ASSERT_OK(CFileSet::Open(rowset_meta_, MemTracker::GetRootTracker(), &fileset));
+
+  int32_t value = 42;
+  int32_t other_value = 500;
+  int32_t lower = 10;
+  int32_t upper = 13;
+  int32_t wide_upper = 600;
+  vector<const void*> values = { &value, &other_value };
+  vector<ColumnPredicate> preds = {
+    ColumnPredicate::Equality(schema_.column(1), &value),
+    ColumnPredicate::InList(schema_.column(1), &values),
+    ColumnPredicate::Range(schema_.column(1), &lower, &upper),
+    // Matches too many rows for the index to be used.
+    ColumnPredicate::Range(schema_.column(1), &lower, &wide_upper),
+  };
+  vector<bool> expect_index_scan = { true, true, true, false };
+
+  // Each scan returns the same rows as a scan without the index.
+  for (int i = 0; i < preds.size(); i++) {
+    SCOPED_TRACE(preds[i].ToString());
+    vector<string> expected;
+    bool index_scan;
+    FLAGS_cfile_set_secondary_index_scan = false;
+    NO_FATALS(Scan(fileset, preds[i], &expected, &index_scan));
+    ASSERT_FALSE(index_scan);
+    ASSERT_FALSE(expected.empty());
+
+    vector<string> rows;
+    FLAGS_cfile_set_secondary_index_scan = true;
+    NO_FATALS(Scan(fileset, preds[i], &rows, &index_scan));
+    ASSERT_EQ(expect_index_scan[i], index_scan);
+    ASSERT_EQ(expected, rows);
+  }
+}
 
 } // namespace tablet
 } // namespace kudu
@@ -24,20 +24,69 @@
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/codegen/compilation_manager.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/column_materialization_context.h"
+#include "kudu/common/encoded_key.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/key_util.h"
 #include "kudu/gutil/dynamic_annotations.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/hash_util.h"
 #include "kudu/util/logging.h"
 
 DEFINE_bool(consult_bloom_filters, true, "Whether to consult bloom filters on row presence checks");
 TAG_FLAG(consult_bloom_filters, hidden);
 
+DEFINE_bool(cfile_set_skip_scan, false,
+            "Whether scans with a predicate on the second primary key column, but "
+            "not on the first, seek to the matching rows within each distinct value "
+            "of the first key column instead of reading all the rows.");
+TAG_FLAG(cfile_set_skip_scan, experimental);
+TAG_FLAG(cfile_set_skip_scan, runtime);
+
+DEFINE_int32(cfile_set_skip_scan_min_rows_per_prefix, 1000,
+             "The minimum estimated number of rows per distinct value of the first "
+             "primary key column for a skip scan to be used in place of a full scan. "
+             "Each distinct value costs a few seeks of the key index.");
+TAG_FLAG(cfile_set_skip_scan_min_rows_per_prefix, experimental);
+TAG_FLAG(cfile_set_skip_scan_min_rows_per_prefix, runtime);
+
+DEFINE_bool(cfile_set_codegen_defaults, false,
+            "Whether scans fill the columns which a rowset has no data for, "
+            "because they were added after it was written, with their read "
+            "defaults using code generated for the projection.");
+TAG_FLAG(cfile_set_codegen_defaults, experimental);
+TAG_FLAG(cfile_set_codegen_defaults, runtime);
+
+DEFINE_int32(cfile_set_sample_chunk_rows, 16384,
+             "The number of consecutive rows which sampling scans sample or skip "
+             "together. Larger ranges skip whole data blocks more often, at the cost "
+             "of a coarser sample.");
+TAG_FLAG(cfile_set_sample_chunk_rows, advanced);
+TAG_FLAG(cfile_set_sample_chunk_rows, runtime);
+
+DEFINE_bool(cfile_set_secondary_index_scan, false,
+            "Whether scans with a predicate on an indexed column read the matching "
+            "rows found in the column's secondary index instead of reading all the "
+            "rows, in the rowsets which have an index for the column and no updates "
+            "to it.");
+TAG_FLAG(cfile_set_secondary_index_scan, experimental);
+TAG_FLAG(cfile_set_secondary_index_scan, runtime);
+
+DEFINE_double(cfile_set_secondary_index_max_selectivity, 0.1,
+              "The largest fraction of the rows of a rowset which a predicate may "
+              "match for a scan to use a secondary index. Scans matching more rows "
+              "read all of them instead, which is cheaper than seeking to each.");
+TAG_FLAG(cfile_set_secondary_index_max_selectivity, advanced);
+TAG_FLAG(cfile_set_secondary_index_max_selectivity, runtime);
+
 namespace kudu {
 namespace tablet {
 
@@ -65,6 +114,35 @@ static Status OpenReader(FsManager* fs,
                                  new_reader);
 }
 
+// Reads the value of 'iter', whose values have type 'type', at 'ordinal'
+// into 'cell'. Indirect data is allocated from 'arena'.
+static Status ReadValueAt(CFileIterator* iter, const TypeInfo* type, rowid_t ordinal,
+                          Arena* arena, uint8_t* cell) {
+  RETURN_NOT_OK(iter->SeekToOrdinal(ordinal));
+  size_t n = 1;
+  RETURN_NOT_OK(iter->PrepareBatch(&n));
+  SelectionVector sel(1);
+  sel.SetAllTrue();
+  ColumnBlock block(type, nullptr, cell, 1, arena);
+  ColumnMaterializationContext ctx(0, nullptr, &block, &sel);
+  RETURN_NOT_OK(iter->Scan(&ctx));
+  return iter->FinishBatch();
+}
+
+// Sets 'prefix' to the smallest string which sorts after every string that
+// starts with 'prefix'. Returns false if there is no such string.
+static bool IncrementPrefix(string* prefix) {
+  while (!prefix->empty()) {
+    char& last = (*prefix)[prefix->size() - 1];
+    if (static_cast<uint8_t>(last) != 0xff) {
+      last++;
+      return true;
+    }
+    prefix->resize(prefix->size() - 1);
+  }
+  return false;
+}
+
 ////////////////////////////////////////////////////////////
 // CFile Base
 ////////////////////////////////////////////////////////////
@@ -116,6 +194,15 @@ Status CFileSet::DoOpen() {
                              &ad_hoc_idx_reader_));
   }
 
+  for (const auto& e : rowset_metadata_->GetSecondaryIndexBlocksById()) {
+    gscoped_ptr<CFileReader> reader;
+    RETURN_NOT_OK(OpenReader(rowset_metadata_->fs_manager(),
+                             parent_mem_tracker_,
+                             e.second,
+                             &reader));
+    index_readers_by_col_id_[e.first] = shared_ptr<CFileReader>(reader.release());
+  }
+
   // However, the key reader should always be fully opened, so that we
   // can figure out where in the rowset tree we belong.
   RETURN_NOT_OK(key_index_reader()->Init());
@@ -174,6 +261,15 @@ CFileReader* CFileSet::key_index_reader() const {
   return FindOrDie(readers_by_col_id_, key_col_id).get();
 }
 
+vector<ColumnId> CFileSet::indexed_column_ids() const {
+  vector<ColumnId> col_ids;
+  col_ids.reserve(index_readers_by_col_id_.size());
+  for (const auto& e : index_readers_by_col_id_) {
+    col_ids.emplace_back(e.first);
+  }
+  return col_ids;
+}
+
 Status CFileSet::NewColumnIterator(ColumnId col_id, CFileReader::CacheControl cache_blocks,
                                    CFileIterator **iter) const {
   return FindOrDie(readers_by_col_id_, col_id)->NewIterator(iter, cache_blocks);
@@ -194,6 +290,41 @@ Status CFileSet::GetBounds(string* min_encoded_key,
   return Status::OK();
 }
 
+Status CFileSet::SampleKeys(int num_samples, vector<string>* encoded_keys) const {
+  encoded_keys->clear();
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  if (num_rows == 0 || num_samples <= 0) {
+    return Status::OK();
+  }
+
+  CFileIterator* tmp;
+  RETURN_NOT_OK(NewKeyIterator(&tmp));
+  gscoped_ptr<CFileIterator> key_iter(tmp);
+
+  // The ad hoc index holds encoded composite keys. Otherwise the key index is
+  // the single key column, whose cells must be encoded.
+  const Schema key_schema = tablet_schema().CreateKeyProjection();
+  const TypeInfo* type = key_index_reader()->type_info();
+  Arena arena(1024, 64 * 1024);
+  faststring cell;
+  cell.resize(type->size());
+  faststring encoded;
+  for (int i = 0; i < num_samples; i++) {
+    rowid_t ordinal = static_cast<uint64_t>(i) * num_rows / num_samples;
+    RETURN_NOT_OK(ReadValueAt(key_iter.get(), type, ordinal, &arena, cell.data()));
+
+    if (ad_hoc_idx_reader_) {
+      encoded_keys->push_back(reinterpret_cast<const Slice*>(cell.data())->ToString());
+    } else {
+      ConstContiguousRow row(&key_schema, cell.data());
+      encoded_keys->push_back(key_schema.EncodeComparableKey(row, &encoded).ToString());
+    }
+    arena.Reset();
+  }
+  return Status::OK();
+}
+
 uint64_t CFileSet::EstimateOnDiskSize() const {
   uint64_t ret = 0;
   for (const ReaderMap::value_type& e : readers_by_col_id_) {
@@ -255,6 +386,67 @@ Status CFileSet::CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
   return s;
 }
 
+void CFileSet::ReleaseCachedBlocks() {
+  if (bloom_reader_ != nullptr) {
+    bloom_reader_->ReleaseIndexBlocks();
+  }
+}
+
+Status CFileSet::CheckRowsPresent(const RowSetKeyProbe* const* probes,
+                                  ProbeStats* const* stats,
+                                  int n, bool* present, rowid_t* rowids) const {
+  // Start by assuming that every key may be present, then rule some out
+  // using the bloom filter.
+  std::fill(present, present + n, true);
+  if (bloom_reader_ != nullptr && FLAGS_consult_bloom_filters) {
+    // Fully open the BloomFileReader if it was lazily opened earlier.
+    //
+    // If it's already initialized, this is a no-op.
+    RETURN_NOT_OK(bloom_reader_->Init());
+
+    vector<const BloomKeyProbe*> bloom_probes(n);
+    for (int i = 0; i < n; i++) {
+      bloom_probes[i] = &probes[i]->bloom_probe();
+      stats[i]->blooms_consulted++;
+    }
+    Status s = bloom_reader_->CheckKeysPresent(bloom_probes.data(), n, present);
+    if (!s.ok()) {
+      LOG(WARNING) << "Unable to query bloom: " << s.ToString()
+                   << " (disabling bloom for this rowset from this point forward)";
+      const_cast<CFileSet *>(this)->bloom_reader_.reset(nullptr);
+      // Continue with the slow path
+      std::fill(present, present + n, true);
+    }
+  }
+
+  // Since the keys are sorted, the key iterator only ever seeks forward.
+  gscoped_ptr<CFileIterator> key_iter;
+  for (int i = 0; i < n; i++) {
+    if (!present[i]) {
+      continue;
+    }
+    if (!key_iter) {
+      CFileIterator* tmp = nullptr;
+      RETURN_NOT_OK(NewKeyIterator(&tmp));
+      key_iter.reset(tmp);
+    }
+    stats[i]->keys_consulted++;
+    bool exact;
+    Status s = key_iter->SeekAtOrAfter(probes[i]->encoded_key(), &exact);
+    if (s.IsNotFound()) {
+      // The key comes past the end of the file, as do all the keys after it.
+      std::fill(present + i, present + n, false);
+      break;
+    }
+    RETURN_NOT_OK(s);
+    present[i] = exact;
+    if (exact) {
+      rowids[i] = key_iter->GetCurrentOrdinal();
+    }
+  }
+  return Status::OK();
+}
+
 Status CFileSet::NewKeyIterator(CFileIterator **key_iter) const {
   return key_index_reader()->NewIterator(key_iter, CFileReader::CACHE_BLOCK);
 }
@@ -262,6 +454,33 @@ Status CFileSet::NewKeyIterator(CFileIterator **key_iter) const {
 ////////////////////////////////////////////////////////////
 // Iterator
 ////////////////////////////////////////////////////////////
+
+namespace {
+
+// Like DefaultColumnValueIterator, but fills the column using the code
+// generated for the projection.
+class CodegenDefaultColumnValueIterator : public DefaultColumnValueIterator {
+ public:
+  // 'projector' must remain valid for the lifetime of this object.
+  CodegenDefaultColumnValueIterator(const codegen::ColumnProjector* projector,
+                                    size_t col_idx)
+    : DefaultColumnValueIterator(projector->projection()->column(col_idx).type_info(),
+                                 projector->projection()->column(col_idx).read_default_value()),
+      projector_(projector),
+      col_idx_(col_idx) {
+  }
+
+  Status Scan(ColumnMaterializationContext* ctx) override {
+    return projector_->FillDefaults(col_idx_, ctx->block());
+  }
+
+ private:
+  const codegen::ColumnProjector* const projector_;
+  const size_t col_idx_;
+};
+
+} // anonymous namespace
+
 CFileSet::Iterator::~Iterator() {
   STLDeleteElements(&col_iters_);
 }
@@ -277,6 +496,10 @@ Status CFileSet::Iterator::CreateColumnIterators(const ScanSpec* spec) {
     cache_blocks = CFileReader::DONT_CACHE_BLOCK;
   }
 
+  // The compiled projector is only requested if the rowset is missing a
+  // column with a read default.
+  bool requested_projector = false;
+
   for (int proj_col_idx = 0;
        proj_col_idx < projection_->num_columns();
        proj_col_idx++) {
@@ -291,6 +514,18 @@ Status CFileSet::Iterator::CreateColumnIterators(const ScanSpec* spec) {
         return Status::Corruption(Substitute("column $0 has no data in rowset $1",
                                              col_schema.ToString(), base_data_->ToString()));
       }
+      if (FLAGS_cfile_set_codegen_defaults && col_schema.has_read_default()) {
+        if (!requested_projector) {
+          requested_projector = true;
+          codegen::CompilationManager::GetSingleton()->RequestColumnProjector(
+              projection_, &column_projector_);
+        }
+        if (column_projector_) {
+          ret_iters.push_back(new CodegenDefaultColumnValueIterator(column_projector_.get(),
+                                                                    proj_col_idx));
+          continue;
+        }
+      }
       ret_iters.push_back(new DefaultColumnValueIterator(col_schema.type_info(),
                                                          col_schema.read_default_value()));
       continue;
@@ -299,6 +534,9 @@ Status CFileSet::Iterator::CreateColumnIterators(const ScanSpec* spec) {
     RETURN_NOT_OK_PREPEND(base_data_->NewColumnIterator(col_id, cache_blocks, &iter),
                           Substitute("could not create iterator for column $0",
                                      projection_->column(proj_col_idx).ToString()));
+    if (spec) {
+      iter->set_readahead_depth(spec->readahead_blocks());
+    }
     ret_iters.push_back(iter);
   }
 
@@ -321,11 +559,24 @@ Status CFileSet::Iterator::Init(ScanSpec *spec) {
   // ordinal range.
   RETURN_NOT_OK(PushdownRangeScanPredicate(spec));
 
-  initted_ = true;
-
   // Don't actually seek -- we'll seek when we first actually read the
   // data.
   cur_idx_ = lower_bound_idx_;
+
+  // Within that range, a predicate on an indexed column or on the second
+  // key column may narrow the rows to read further, unless only a sample of
+  // them is read.
+  if (spec != nullptr && spec->sample_fraction() < 1) {
+    SetupSample(*spec);
+  } else {
+    bool index_scan;
+    RETURN_NOT_OK(SetupIndexScan(spec, &index_scan));
+    if (!index_scan) {
+      RETURN_NOT_OK(SetupSkipScan(spec));
+    }
+  }
+
+  initted_ = true;
   Unprepare(); // Reset state.
   return Status::OK();
 }
@@ -390,6 +641,392 @@ Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
   return Status::OK();
 }
 
+Status CFileSet::Iterator::SetupSkipScan(ScanSpec* spec) {
+  range_end_idx_ = upper_bound_idx_;
+
+  const Schema& tablet_schema = base_data_->tablet_schema();
+  if (!FLAGS_cfile_set_skip_scan || spec == nullptr ||
+      tablet_schema.num_key_columns() < 2 ||
+      lower_bound_idx_ >= upper_bound_idx_) {
+    return Status::OK();
+  }
+  // A predicate on the first key column is already covered by the key bounds.
+  if (ContainsKey(spec->predicates(), tablet_schema.column(0).name())) {
+    return Status::OK();
+  }
+  const ColumnSchema& col = tablet_schema.column(1);
+  const ColumnPredicate* pred = FindOrNull(spec->predicates(), col.name());
+  if (pred == nullptr) {
+    return Status::OK();
+  }
+
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(col.type_info());
+  bool is_last = tablet_schema.num_key_columns() == 2;
+  faststring buf;
+  skip_scan_lower_.clear();
+  skip_scan_upper_.clear();
+  skip_scan_has_upper_ = false;
+  switch (pred->predicate_type()) {
+    case PredicateType::Equality: {
+      encoder.Encode(pred->raw_lower(), is_last, &buf);
+      skip_scan_lower_ = buf.ToString();
+      // The exclusive upper bound is the next value, if there is one.
+      faststring cell;
+      cell.assign_copy(static_cast<const uint8_t*>(pred->raw_lower()), col.type_info()->size());
+      if (key_util::IncrementCell(col, cell.data(), &skip_scan_arena_)) {
+        buf.clear();
+        encoder.Encode(cell.data(), is_last, &buf);
+        skip_scan_upper_ = buf.ToString();
+        skip_scan_has_upper_ = true;
+      }
+      break;
+    }
+    case PredicateType::Range:
+      if (pred->raw_lower() != nullptr) {
+        encoder.Encode(pred->raw_lower(), is_last, &buf);
+        skip_scan_lower_ = buf.ToString();
+      }
+      if (pred->raw_upper() != nullptr) {
+        buf.clear();
+        encoder.Encode(pred->raw_upper(), is_last, &buf);
+        skip_scan_upper_ = buf.ToString();
+        skip_scan_has_upper_ = true;
+      }
+      break;
+    default:
+      return Status::OK();
+  }
+  skip_scan_arena_.Reset();
+
+  bool skip_scan;
+  RETURN_NOT_OK(ShouldSkipScan(&skip_scan));
+  if (!skip_scan) {
+    return Status::OK();
+  }
+  VLOG(1) << "Skip scanning " << base_data_->ToString() << " on " << pred->ToString();
+  skip_scan_ = true;
+  skip_scan_start_idx_ = lower_bound_idx_;
+  skip_scan_prefixes_ = 0;
+  return SkipToNextRange(lower_bound_idx_);
+}
+
+Status CFileSet::Iterator::ShouldSkipScan(bool* skip_scan) {
+  static const int kNumSamples = 32;
+
+  *skip_scan = false;
+  rowid_t nrows = upper_bound_idx_ - lower_bound_idx_;
+  if (nrows < 2 * FLAGS_cfile_set_skip_scan_min_rows_per_prefix) {
+    return Status::OK();
+  }
+
+  // The samples are evenly spaced, so every prefix with more than
+  // 'nrows / kNumSamples' rows is sampled.
+  int distinct = 0;
+  string last_prefix;
+  for (int i = 0; i < kNumSamples; i++) {
+    RETURN_NOT_OK(ReadKeyPrefix(lower_bound_idx_ + static_cast<uint64_t>(i) * nrows / kNumSamples));
+    if (i == 0 || skip_scan_prefix_ != last_prefix) {
+      distinct++;
+      last_prefix = skip_scan_prefix_;
+    }
+  }
+  // If every sample has a different prefix, there are likely too many
+  // prefixes for a skip scan to pay off.
+  *skip_scan = distinct < kNumSamples &&
+      nrows / distinct >= FLAGS_cfile_set_skip_scan_min_rows_per_prefix;
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::SkipToNextRange(rowid_t idx) {
+  // The number of prefixes to read before checking whether they have enough
+  // rows to be worth seeking.
+  static const int kMinPrefixesBeforeFallback = 8;
+
+  while (idx < upper_bound_idx_) {
+    if (skip_scan_prefixes_ >= kMinPrefixesBeforeFallback &&
+        (idx - skip_scan_start_idx_) / skip_scan_prefixes_ <
+        FLAGS_cfile_set_skip_scan_min_rows_per_prefix) {
+      VLOG(1) << "Falling back to a full scan of " << base_data_->ToString() << " after "
+              << skip_scan_prefixes_ << " prefixes";
+      skip_scan_ = false;
+      cur_idx_ = idx;
+      range_end_idx_ = upper_bound_idx_;
+      return Status::OK();
+    }
+
+    RETURN_NOT_OK(ReadKeyPrefix(idx));
+    skip_scan_prefixes_++;
+
+    string next_prefix = skip_scan_prefix_;
+    skip_scan_next_idx_ = row_count_;
+    if (IncrementPrefix(&next_prefix)) {
+      RETURN_NOT_OK(SeekKeyIndex(next_prefix, &skip_scan_next_idx_));
+    }
+    rowid_t start = idx;
+    if (!skip_scan_lower_.empty()) {
+      RETURN_NOT_OK(SeekKeyIndex(skip_scan_prefix_ + skip_scan_lower_, &start));
+      start = std::max(start, idx);
+    }
+    rowid_t end = skip_scan_next_idx_;
+    if (skip_scan_has_upper_) {
+      RETURN_NOT_OK(SeekKeyIndex(skip_scan_prefix_ + skip_scan_upper_, &end));
+      end = std::min(end, skip_scan_next_idx_);
+    }
+    end = std::min(end, upper_bound_idx_);
+    if (start < end) {
+      cur_idx_ = start;
+      range_end_idx_ = end;
+      return Status::OK();
+    }
+    idx = skip_scan_next_idx_;
+  }
+  cur_idx_ = upper_bound_idx_;
+  range_end_idx_ = upper_bound_idx_;
+  return Status::OK();
+}
+
+void CFileSet::Iterator::SetupSample(const ScanSpec& spec) {
+  sample_ = true;
+  sample_fraction_ = spec.sample_fraction();
+  sample_chunk_rows_ = std::max(FLAGS_cfile_set_sample_chunk_rows, 1);
+  // Each rowset samples different ranges.
+  sample_seed_ = spec.sample_seed() ^ base_data_->rowset_metadata_->id();
+  SampleNextRange(lower_bound_idx_);
+}
+
+void CFileSet::Iterator::SampleNextRange(rowid_t idx) {
+  while (idx < upper_bound_idx_) {
+    const uint64_t chunk = idx / sample_chunk_rows_;
+    const rowid_t chunk_end = std::min<uint64_t>((chunk + 1) * sample_chunk_rows_,
+                                                 upper_bound_idx_);
+    // The chunk is sampled if its hash, as a fraction of the hash space, is
+    // below the sample fraction.
+    const uint64_t hash = HashUtil::MurmurHash2_64(&chunk, sizeof(chunk), sample_seed_);
+    if (static_cast<double>(hash >> 11) / (1ULL << 53) < sample_fraction_) {
+      cur_idx_ = idx;
+      range_end_idx_ = chunk_end;
+      return;
+    }
+    idx = chunk_end;
+  }
+  cur_idx_ = upper_bound_idx_;
+  range_end_idx_ = upper_bound_idx_;
+}
+
+Status CFileSet::Iterator::SetupIndexScan(const ScanSpec* spec, bool* index_scan) {
+  *index_scan = false;
+  if (!FLAGS_cfile_set_secondary_index_scan || spec == nullptr ||
+      indexable_col_ids_.empty() || lower_bound_idx_ >= upper_bound_idx_) {
+    return Status::OK();
+  }
+
+  // Prefer a predicate on discrete values, which usually matches fewer rows,
+  // to a range.
+  const Schema& tablet_schema = base_data_->tablet_schema();
+  const ColumnPredicate* pred = nullptr;
+  ColumnId col_id;
+  for (const auto& e : spec->predicates()) {
+    const ColumnPredicate& p = e.second;
+    int idx = tablet_schema.find_column(e.first);
+    if (idx == Schema::kColumnNotFound ||
+        std::find(indexable_col_ids_.begin(), indexable_col_ids_.end(),
+                  tablet_schema.column_id(idx)) == indexable_col_ids_.end()) {
+      continue;
+    }
+    bool discrete = p.predicate_type() == PredicateType::Equality ||
+                    p.predicate_type() == PredicateType::InList;
+    if (discrete || (p.predicate_type() == PredicateType::Range && pred == nullptr)) {
+      pred = &p;
+      col_id = tablet_schema.column_id(idx);
+      if (discrete) {
+        break;
+      }
+    }
+  }
+  if (pred == nullptr) {
+    return Status::OK();
+  }
+
+  // Each value, or the range, is an interval of the index entries. The
+  // entries are the encoded value followed by a 4-byte row ID, and the value
+  // encoding is prefix-free, so the entries of a value 'v' are the ones in
+  // [enc(v), enc(v) + "\xff" * 5).
+  const ColumnSchema& col = tablet_schema.column_by_id(col_id);
+  const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(col.type_info());
+  vector<std::pair<string, string>> intervals;
+  faststring buf;
+  auto encode = [&](const void* value) {
+    buf.clear();
+    encoder.Encode(value, false, &buf);
+    return buf.ToString();
+  };
+  switch (pred->predicate_type()) {
+    case PredicateType::Equality: {
+      string lower = encode(pred->raw_lower());
+      intervals.emplace_back(lower, lower + string(sizeof(rowid_t) + 1, '\xff'));
+      break;
+    }
+    case PredicateType::InList:
+      for (const void* value : pred->raw_values()) {
+        string lower = encode(value);
+        intervals.emplace_back(lower, lower + string(sizeof(rowid_t) + 1, '\xff'));
+      }
+      break;
+    case PredicateType::Range:
+      intervals.emplace_back(pred->raw_lower() ? encode(pred->raw_lower()) : string(),
+                             pred->raw_upper() ? encode(pred->raw_upper()) : string());
+      break;
+    default:
+      LOG(FATAL) << "unexpected predicate: " << pred->ToString();
+  }
+
+  const shared_ptr<CFileReader>& reader = FindOrDie(base_data_->index_readers_by_col_id_, col_id);
+  RETURN_NOT_OK(reader->Init());
+  CFileIterator* tmp;
+  RETURN_NOT_OK(reader->NewIterator(&tmp, CFileReader::CACHE_BLOCK));
+  gscoped_ptr<CFileIterator> iter(tmp);
+
+  const size_t max_rows = FLAGS_cfile_set_secondary_index_max_selectivity *
+      (upper_bound_idx_ - lower_bound_idx_);
+  vector<rowid_t> rowids;
+  for (const auto& interval : intervals) {
+    bool too_many;
+    RETURN_NOT_OK(ReadIndexInterval(iter.get(), interval.first, interval.second,
+                                    max_rows, &rowids, &too_many));
+    if (too_many) {
+      VLOG(1) << "Too many rows of " << base_data_->ToString() << " match "
+              << pred->ToString() << " to use its secondary index";
+      return Status::OK();
+    }
+  }
+  std::sort(rowids.begin(), rowids.end());
+  rowids.erase(std::unique(rowids.begin(), rowids.end()), rowids.end());
+
+  VLOG(1) << "Scanning " << rowids.size() << " rows of " << base_data_->ToString()
+          << " found in the secondary index for " << pred->ToString();
+  *index_scan = true;
+  index_scan_ = true;
+  index_rowids_.swap(rowids);
+  index_pos_ = 0;
+  IndexNextRange();
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::ReadIndexInterval(CFileIterator* iter, const string& lower,
+                                             const string& upper, size_t max_rows,
+                                             vector<rowid_t>* rowids, bool* too_many) {
+  static const size_t kBatchSize = 1024;
+
+  *too_many = false;
+  if (lower.empty()) {
+    RETURN_NOT_OK(iter->SeekToFirst());
+  } else {
+    // The index has a single "key column" of encoded entries, so the seek
+    // compares against the raw Slice.
+    Slice lower_slice(lower);
+    vector<const void*> raw_keys = { &lower_slice };
+    faststring data;
+    data.append(lower);
+    EncodedKey key(&data, &raw_keys, 1);
+    bool exact;
+    Status s = iter->SeekAtOrAfter(key, &exact);
+    if (s.IsNotFound()) {
+      return Status::OK();
+    }
+    RETURN_NOT_OK(s);
+  }
+
+  Arena arena(32 * 1024, 1024 * 1024);
+  vector<Slice> entries(kBatchSize);
+  // Entries outside the key bounds are not scanned, but must still be read,
+  // so they count towards the limit too.
+  size_t entries_read = 0;
+  const size_t max_entries = max_rows * row_count_ / (upper_bound_idx_ - lower_bound_idx_);
+  while (iter->HasNext()) {
+    size_t n = kBatchSize;
+    RETURN_NOT_OK(iter->PrepareBatch(&n));
+    SelectionVector sel(n);
+    sel.SetAllTrue();
+    ColumnBlock block(GetTypeInfo(BINARY), nullptr, entries.data(), n, &arena);
+    ColumnMaterializationContext ctx(0, nullptr, &block, &sel);
+    RETURN_NOT_OK(iter->Scan(&ctx));
+    RETURN_NOT_OK(iter->FinishBatch());
+    for (size_t i = 0; i < n; i++) {
+      const Slice& entry = entries[i];
+      if (!upper.empty() && entry.compare(upper) >= 0) {
+        return Status::OK();
+      }
+      if (PREDICT_FALSE(entry.size() < sizeof(rowid_t))) {
+        return Status::Corruption("secondary index entry too short",
+                                  KUDU_REDACT(entry.ToDebugString()));
+      }
+      rowid_t rowid = BigEndian::Load32(entry.data() + entry.size() - sizeof(rowid_t));
+      if (rowid >= lower_bound_idx_ && rowid < upper_bound_idx_) {
+        rowids->push_back(rowid);
+      }
+      if (rowids->size() > max_rows || ++entries_read > max_entries) {
+        *too_many = true;
+        return Status::OK();
+      }
+    }
+    arena.Reset();
+  }
+  return Status::OK();
+}
+
+void CFileSet::Iterator::IndexNextRange() {
+  // Rows this close together are read in one range, rather than seeking
+  // over the rows between them, which likely share a data block.
+  static const rowid_t kMaxGapRows = 128;
+
+  if (index_pos_ >= index_rowids_.size()) {
+    cur_idx_ = upper_bound_idx_;
+    range_end_idx_ = upper_bound_idx_;
+    return;
+  }
+  cur_idx_ = index_rowids_[index_pos_];
+  range_end_idx_ = cur_idx_ + 1;
+  while (++index_pos_ < index_rowids_.size() &&
+         index_rowids_[index_pos_] - range_end_idx_ < kMaxGapRows) {
+    range_end_idx_ = index_rowids_[index_pos_] + 1;
+  }
+}
+
+Status CFileSet::Iterator::ReadKeyPrefix(rowid_t idx) {
+  // Composite keys are always read from the ad hoc index, whose values are
+  // the encoded keys.
+  Slice key;
+  RETURN_NOT_OK(ReadValueAt(key_iter_.get(), base_data_->key_index_reader()->type_info(),
+                            idx, &skip_scan_arena_, reinterpret_cast<uint8_t*>(&key)));
+
+  // Decode the first key column to find where its encoding ends.
+  const ColumnSchema& col = base_data_->tablet_schema().column(0);
+  faststring cell;
+  cell.resize(col.type_info()->size());
+  Slice rest = key;
+  RETURN_NOT_OK(GetKeyEncoder<faststring>(col.type_info()).Decode(
+      &rest, false, &skip_scan_arena_, cell.data()));
+  skip_scan_prefix_.assign(reinterpret_cast<const char*>(key.data()), key.size() - rest.size());
+  skip_scan_arena_.Reset();
+  return Status::OK();
+}
+
+Status CFileSet::Iterator::SeekKeyIndex(const string& encoded, rowid_t* idx) {
+  faststring data;
+  data.append(encoded);
+  vector<const void*> raw_keys;
+  EncodedKey key(&data, &raw_keys, base_data_->tablet_schema().num_key_columns());
+  bool exact;
+  Status s = key_iter_->SeekAtOrAfter(key, &exact);
+  if (s.IsNotFound()) {
+    *idx = row_count_;
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+  *idx = key_iter_->GetCurrentOrdinal();
+  return Status::OK();
+}
+
 void CFileSet::Iterator::Unprepare() {
   prepared_count_ = 0;
   cols_prepared_.assign(col_iters_.size(), false);
@@ -398,7 +1035,7 @@ void CFileSet::Iterator::Unprepare() {
 Status CFileSet::Iterator::PrepareBatch(size_t *n) {
   DCHECK_EQ(prepared_count_, 0) << "Already prepared";
 
-  size_t remaining = upper_bound_idx_ - cur_idx_;
+  size_t remaining = range_end_idx_ - cur_idx_;
   if (*n > remaining) {
     *n = remaining;
   }
@@ -447,7 +1084,16 @@ Status CFileSet::Iterator::PrepareColumn(ColumnMaterializationContext *ctx) {
 }
 
 Status CFileSet::Iterator::InitializeSelectionVector(SelectionVector *sel_vec) {
-  sel_vec->SetAllTrue();
+  if (!index_scan_) {
+    sel_vec->SetAllTrue();
+    return Status::OK();
+  }
+  // Only the rows found in the index are selected.
+  sel_vec->SetAllFalse();
+  auto it = std::lower_bound(index_rowids_.begin(), index_rowids_.end(), cur_idx_);
+  for (; it != index_rowids_.end() && *it < cur_idx_ + prepared_count_; ++it) {
+    sel_vec->SetRowSelected(*it - cur_idx_);
+  }
   return Status::OK();
 }
 
@@ -479,6 +1125,13 @@ Status CFileSet::Iterator::FinishBatch() {
   cur_idx_ += prepared_count_;
   Unprepare();
 
+  if (skip_scan_ && cur_idx_ >= range_end_idx_) {
+    RETURN_NOT_OK(SkipToNextRange(skip_scan_next_idx_));
+  } else if (sample_ && cur_idx_ >= range_end_idx_) {
+    SampleNextRange(cur_idx_);
+  } else if (index_scan_ && cur_idx_ >= range_end_idx_) {
+    IndexNextRange();
+  }
   return Status::OK();
 }
 
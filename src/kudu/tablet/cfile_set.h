@@ -25,9 +25,10 @@
 
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_reader.h"
-
+#include "kudu/codegen/column_projector.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/schema.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/tablet/memrowset.h"
@@ -69,6 +70,10 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
 
   uint64_t EstimateOnDiskSize() const;
 
+  // Sample the encoded keys of 'num_samples' rows at evenly spaced ordinals,
+  // in increasing order.
+  Status SampleKeys(int num_samples, std::vector<std::string>* encoded_keys) const;
+
   // Determine the index of the given row key.
   Status FindRow(const RowSetKeyProbe &probe, rowid_t *idx, ProbeStats* stats) const;
 
@@ -81,11 +86,27 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                          rowid_t *rowid, ProbeStats* stats) const;
 
+  // Batch version of CheckRowPresent() for 'n' keys, which must be sorted.
+  // Sets present[i] and, if present, rowids[i] for probes[i], and updates
+  // *stats[i].
+  //
+  // The bloom filter is probed for all of the keys at once, and the keys
+  // which may be present are then looked up with a single key iterator.
+  Status CheckRowsPresent(const RowSetKeyProbe* const* probes, ProbeStats* const* stats,
+                          int n, bool* present, rowid_t* rowids) const;
+
+  // Releases the cached blocks which the readers of the files hold on to.
+  void ReleaseCachedBlocks();
+
   // Return true if there exists a CFile for the given column ID.
   bool has_data_for_column_id(ColumnId col_id) const {
     return ContainsKey(readers_by_col_id_, col_id);
   }
 
+  // Returns the IDs of the columns which have a secondary index in this
+  // rowset.
+  std::vector<ColumnId> indexed_column_ids() const;
+
   virtual ~CFileSet();
 
  private:
@@ -127,6 +148,10 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   // index pertains to more than one column, as in the case of composite keys.
   gscoped_ptr<CFileReader> ad_hoc_idx_reader_;
   gscoped_ptr<BloomFileReader> bloom_reader_;
+
+  // Map of column ID to the reader of the column's secondary index, if it
+  // has one. Like the column readers, these are lazily initialized.
+  ReaderMap index_readers_by_col_id_;
 };
 
 
@@ -151,7 +176,7 @@ class CFileSet::Iterator : public ColumnwiseIterator {
 
   virtual bool HasNext() const OVERRIDE {
     DCHECK(initted_);
-    return cur_idx_ < upper_bound_idx_;
+    return cur_idx_ < range_end_idx_;
   }
 
   virtual string ToString() const OVERRIDE {
@@ -171,10 +196,21 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // Collect the IO statistics for each of the underlying columns.
   virtual void GetIteratorStats(vector<IteratorStats> *stats) const OVERRIDE;
 
+  // Sets the columns whose secondary indexes may be used to find the rows
+  // matching a predicate. The caller must ensure that the rows have no
+  // updates to these columns visible to the scan, since the indexes only
+  // cover the base data. Must be called before Init().
+  void set_indexable_column_ids(std::vector<ColumnId> col_ids) {
+    DCHECK(!initted_);
+    indexable_col_ids_ = std::move(col_ids);
+  }
+
   virtual ~Iterator();
  private:
   DISALLOW_COPY_AND_ASSIGN(Iterator);
   FRIEND_TEST(TestCFileSet, TestRangeScan);
+  FRIEND_TEST(TestCFileSetSkipScan, TestSkipScan);
+  FRIEND_TEST(TestCFileSetSecondaryIndex, TestIndexScan);
   friend class CFileSet;
 
   // 'projection' must remain valid for the lifetime of this object.
@@ -183,7 +219,19 @@ class CFileSet::Iterator : public ColumnwiseIterator {
         projection_(projection),
         initted_(false),
         cur_idx_(0),
-        prepared_count_(0) {
+        prepared_count_(0),
+        skip_scan_(false),
+        skip_scan_has_upper_(false),
+        skip_scan_next_idx_(0),
+        skip_scan_start_idx_(0),
+        skip_scan_prefixes_(0),
+        skip_scan_arena_(256, 64 * 1024),
+        sample_(false),
+        sample_fraction_(1),
+        sample_chunk_rows_(0),
+        sample_seed_(0),
+        index_scan_(false),
+        index_pos_(0) {
     CHECK_OK(base_data_->CountRows(&row_count_));
   }
 
@@ -195,6 +243,65 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // store it in member fields.
   Status PushdownRangeScanPredicate(ScanSpec *spec);
 
+  // If --cfile_set_skip_scan is set, the spec has a range or equality
+  // predicate on the second key column but none on the first, and the cost
+  // estimate favors it, sets up a skip scan: rather than reading every row
+  // between the key bounds, the iterator seeks the key index to the rows
+  // matching the predicate within each distinct value of the first key
+  // column.
+  Status SetupSkipScan(ScanSpec* spec);
+
+  // Estimates whether a skip scan over [lower_bound_idx_, upper_bound_idx_)
+  // is cheaper than a full scan, from the distinct values of the first key
+  // column among a sample of the keys.
+  Status ShouldSkipScan(bool* skip_scan);
+
+  // Moves 'cur_idx_' and 'range_end_idx_' to the next range of rows matching
+  // the skip scan predicate, starting with the prefix of the row at 'idx'.
+  // Falls back to scanning all the remaining rows if the prefixes turn out
+  // to have too few rows to be worth seeking.
+  Status SkipToNextRange(rowid_t idx);
+
+  // Sets up a scan of a random sample of 'spec->sample_fraction()' of the
+  // rows between the key bounds. The rows are divided into fixed-size
+  // chunks by their ordinal indexes, and each chunk is either read in full
+  // or skipped, depending on a hash of its index and the seed.
+  void SetupSample(const ScanSpec& spec);
+
+  // Moves 'cur_idx_' and 'range_end_idx_' to the next sampled range of rows
+  // at or after 'idx'.
+  void SampleNextRange(rowid_t idx);
+
+  // If --cfile_set_secondary_index_scan is set and the spec has an
+  // equality, IN list or range predicate on an indexable column, reads the
+  // IDs of the matching rows between the key bounds from the column's
+  // secondary index, and sets up a scan of just those rows. Falls back to
+  // the other scans if too many rows match for the index to pay off.
+  //
+  // The predicate is left in the spec, so the rows are still filtered by it
+  // after being read.
+  Status SetupIndexScan(const ScanSpec* spec, bool* index_scan);
+
+  // Appends the IDs of the rows between the key bounds whose entries in the
+  // secondary index read by 'iter' are in ['lower', 'upper') to 'rowids',
+  // where an empty bound is unbounded. Sets 'too_many' and stops early if
+  // the index has more than 'max_rows' entries in the interval.
+  Status ReadIndexInterval(CFileIterator* iter, const std::string& lower,
+                           const std::string& upper, size_t max_rows,
+                           std::vector<rowid_t>* rowids, bool* too_many);
+
+  // Moves 'cur_idx_' and 'range_end_idx_' to the next range of rows which
+  // holds rows found in the secondary index.
+  void IndexNextRange();
+
+  // Reads the encoded key of the row at 'idx' and stores the encoding of its
+  // first column in 'skip_scan_prefix_'.
+  Status ReadKeyPrefix(rowid_t idx);
+
+  // Seeks the key index to the first row whose key is at or after 'encoded'
+  // and stores its index in 'idx', or 'row_count_' if there is none.
+  Status SeekKeyIndex(const std::string& encoded, rowid_t* idx);
+
   void Unprepare();
 
   // Prepare the given column if not already prepared.
@@ -207,6 +314,12 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   gscoped_ptr<CFileIterator> key_iter_;
   std::vector<ColumnIterator*> col_iters_;
 
+  // Fills the columns which this rowset has no data for with their read
+  // defaults, if --cfile_set_codegen_defaults is set and the compiled code
+  // was ready when the iterator was initialized. Used by the iterators of
+  // those columns.
+  gscoped_ptr<codegen::ColumnProjector> column_projector_;
+
   bool initted_;
 
   size_t cur_idx_;
@@ -222,6 +335,42 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   rowid_t lower_bound_idx_;
   rowid_t upper_bound_idx_;
 
+  // The exclusive end of the range of rows being read. Without a skip scan,
+  // this is 'upper_bound_idx_'; with one, it's the end of the range matching
+  // the predicate within the current prefix.
+  rowid_t range_end_idx_;
+
+  // Skip scan state, see SetupSkipScan().
+  bool skip_scan_;
+  // The encoded bounds of the predicate on the second key column. The lower
+  // bound is empty if there is none.
+  std::string skip_scan_lower_;
+  std::string skip_scan_upper_;
+  bool skip_scan_has_upper_;
+  // The encoding of the first key column of the current range.
+  std::string skip_scan_prefix_;
+  // The index of the first row after the current prefix.
+  rowid_t skip_scan_next_idx_;
+  // The row at which the skip scan started, and the number of prefixes seen
+  // since, used to detect prefixes which are too small to be worth seeking.
+  rowid_t skip_scan_start_idx_;
+  int64_t skip_scan_prefixes_;
+  Arena skip_scan_arena_;
+
+  // Sampling state, see SetupSample().
+  bool sample_;
+  double sample_fraction_;
+  rowid_t sample_chunk_rows_;
+  uint64_t sample_seed_;
+
+  // Secondary index scan state, see SetupIndexScan().
+  std::vector<ColumnId> indexable_col_ids_;
+  bool index_scan_;
+  // The sorted IDs of the rows found in the index, and the position of the
+  // first one after the current range.
+  std::vector<rowid_t> index_rowids_;
+  size_t index_pos_;
+
 
   // The underlying columns are prepared lazily, so that if a column is never
   // materialized, it doesn't need to be read off disk.
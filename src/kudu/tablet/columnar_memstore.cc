@@ -0,0 +1,283 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/columnar_memstore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include <glog/logging.h>
+
+#include "kudu/common/row.h"
+#include "kudu/gutil/atomicops.h"
+#include "kudu/util/bitmap.h"
+
+using std::shared_ptr;
+
+namespace kudu {
+namespace tablet {
+
+namespace {
+
+// Presents a single row of a chunk as a row type which can be passed to
+// Schema::EncodeComparableKey().
+class ChunkRowRef {
+ public:
+  ChunkRowRef(const Schema* schema, uint8_t* const* cells, rowid_t row)
+      : schema_(schema),
+        cells_(cells),
+        row_(row) {
+  }
+
+  const Schema* schema() const { return schema_; }
+
+  const uint8_t* cell_ptr(size_t col_idx) const {
+    return cells_[col_idx] + row_ * schema_->column(col_idx).type_info()->size();
+  }
+
+ private:
+  const Schema* schema_;
+  uint8_t* const* cells_;
+  const rowid_t row_;
+};
+
+} // anonymous namespace
+
+const rowid_t ColumnarMemStore::kRowsPerChunk;
+
+ColumnarMemStore::ColumnarMemStore(const Schema* schema,
+                                   shared_ptr<ShardedMemoryTrackingArena> arena)
+    : schema_(schema),
+      arena_(std::move(arena)),
+      chunks_(nullptr),
+      chunks_capacity_(0),
+      num_rows_(0) {
+}
+
+Status ColumnarMemStore::AllocateChunk(const Slice& first_key, Chunk** chunk) {
+  size_t num_cols = schema_->num_columns();
+  auto* c = static_cast<Chunk*>(arena_->AllocateBytesAligned(
+      sizeof(Chunk), alignof(Chunk)));
+  auto** cells = static_cast<uint8_t**>(arena_->AllocateBytesAligned(
+      num_cols * sizeof(uint8_t*), alignof(uint8_t*)));
+  auto** null_bitmaps = static_cast<uint8_t**>(arena_->AllocateBytesAligned(
+      num_cols * sizeof(uint8_t*), alignof(uint8_t*)));
+  auto* timestamps = static_cast<Timestamp*>(arena_->AllocateBytesAligned(
+      kRowsPerChunk * sizeof(Timestamp), alignof(Timestamp)));
+  auto** redo_heads = static_cast<Mutation**>(arena_->AllocateBytesAligned(
+      kRowsPerChunk * sizeof(Mutation*), alignof(Mutation*)));
+  if (!c || !cells || !null_bitmaps || !timestamps || !redo_heads ||
+      !arena_->RelocateSlice(first_key, &c->first_key)) {
+    return Status::IOError("Unable to allocate columnar chunk");
+  }
+  memset(redo_heads, 0, kRowsPerChunk * sizeof(Mutation*));
+
+  for (size_t i = 0; i < num_cols; i++) {
+    const ColumnSchema& col = schema_->column(i);
+    cells[i] = static_cast<uint8_t*>(arena_->AllocateBytesAligned(
+        kRowsPerChunk * col.type_info()->size(), sizeof(uint64_t)));
+    if (!cells[i]) {
+      return Status::IOError("Unable to allocate columnar chunk");
+    }
+    null_bitmaps[i] = nullptr;
+    if (col.is_nullable()) {
+      size_t bitmap_size = BitmapSize(kRowsPerChunk);
+      null_bitmaps[i] = static_cast<uint8_t*>(arena_->AllocateBytes(bitmap_size));
+      if (!null_bitmaps[i]) {
+        return Status::IOError("Unable to allocate columnar chunk");
+      }
+      memset(null_bitmaps[i], 0, bitmap_size);
+    }
+  }
+  c->cells = cells;
+  c->null_bitmaps = null_bitmaps;
+  c->insertion_timestamps = timestamps;
+  c->redo_heads = redo_heads;
+
+  // Add the chunk to the chunk array, growing it if need be. The new chunk
+  // (and the new array) are published to readers along with the chunk's
+  // first row, when 'num_rows_' is stored.
+  size_t chunk_idx = num_rows_.Load(kMemOrderNoBarrier) / kRowsPerChunk;
+  if (chunk_idx == chunks_capacity_) {
+    size_t new_capacity = std::max<size_t>(16, chunks_capacity_ * 2);
+    auto** new_chunks = static_cast<Chunk**>(arena_->AllocateBytesAligned(
+        new_capacity * sizeof(Chunk*), alignof(Chunk*)));
+    if (!new_chunks) {
+      return Status::IOError("Unable to allocate columnar chunk");
+    }
+    if (chunks_capacity_ > 0) {
+      memcpy(new_chunks, chunks_, chunks_capacity_ * sizeof(Chunk*));
+    }
+    base::subtle::Release_Store(reinterpret_cast<AtomicWord*>(&chunks_),
+                                reinterpret_cast<AtomicWord>(new_chunks));
+    chunks_capacity_ = new_capacity;
+  }
+  chunks_[chunk_idx] = c;
+  *chunk = c;
+  return Status::OK();
+}
+
+Status ColumnarMemStore::Append(Timestamp timestamp,
+                                const ConstContiguousRow& row,
+                                const Slice& enc_key,
+                                bool* appended) {
+  DCHECK_SCHEMA_EQ(*schema_, *row.schema());
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  rowid_t idx = num_rows_.Load(kMemOrderNoBarrier);
+  if (idx > 0 && enc_key.compare(Slice(last_key_)) <= 0) {
+    *appended = false;
+    return Status::OK();
+  }
+
+  Chunk* chunk;
+  rowid_t row_in_chunk = idx % kRowsPerChunk;
+  if (row_in_chunk == 0) {
+    RETURN_NOT_OK(AllocateChunk(enc_key, &chunk));
+  } else {
+    chunk = chunks_[idx / kRowsPerChunk];
+  }
+
+  for (size_t i = 0; i < schema_->num_columns(); i++) {
+    const ColumnSchema& col = schema_->column(i);
+    if (col.is_nullable()) {
+      bool is_null = row.is_null(i);
+      BitmapChange(chunk->null_bitmaps[i], row_in_chunk, is_null);
+      if (is_null) {
+        continue;
+      }
+    }
+    size_t size = col.type_info()->size();
+    uint8_t* dst = chunk->cells[i] + row_in_chunk * size;
+    if (col.type_info()->physical_type() == BINARY) {
+      if (!arena_->RelocateSlice(*reinterpret_cast<const Slice*>(row.cell_ptr(i)),
+                                 reinterpret_cast<Slice*>(dst))) {
+        return Status::IOError("Unable to relocate slice");
+      }
+    } else {
+      memcpy(dst, row.cell_ptr(i), size);
+    }
+  }
+  chunk->insertion_timestamps[row_in_chunk] = timestamp;
+
+  last_key_.assign_copy(enc_key.data(), enc_key.size());
+  num_rows_.Store(idx + 1, kMemOrderRelease);
+  *appended = true;
+  return Status::OK();
+}
+
+const ColumnarMemStore::Chunk* ColumnarMemStore::chunk_for_row(rowid_t idx) const {
+  Chunk* const* chunks = reinterpret_cast<Chunk* const*>(base::subtle::Acquire_Load(
+      reinterpret_cast<const AtomicWord*>(&chunks_)));
+  return chunks[idx / kRowsPerChunk];
+}
+
+Slice ColumnarMemStore::EncodeKey(rowid_t idx, faststring* buf) const {
+  DCHECK_LT(idx, num_rows());
+  ChunkRowRef row(schema_, chunk_for_row(idx)->cells, idx % kRowsPerChunk);
+  return schema_->EncodeComparableKey(row, buf);
+}
+
+rowid_t ColumnarMemStore::LowerBound(const Slice& enc_key) const {
+  rowid_t n = num_rows();
+  if (n == 0) {
+    return 0;
+  }
+
+  // Find the last chunk whose first key isn't greater than 'enc_key'.
+  Chunk* const* chunks = reinterpret_cast<Chunk* const*>(base::subtle::Acquire_Load(
+      reinterpret_cast<const AtomicWord*>(&chunks_)));
+  rowid_t lo = 0;
+  rowid_t hi = (n + kRowsPerChunk - 1) / kRowsPerChunk;
+  while (lo < hi) {
+    rowid_t mid = lo + (hi - lo) / 2;
+    if (chunks[mid]->first_key.compare(enc_key) <= 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    return 0;
+  }
+
+  // Then search that chunk's rows. If they're all less than 'enc_key', this
+  // yields the first row of the next chunk.
+  rowid_t begin = (lo - 1) * kRowsPerChunk;
+  rowid_t end = std::min(n, lo * kRowsPerChunk);
+  faststring buf;
+  while (begin < end) {
+    rowid_t mid = begin + (end - begin) / 2;
+    if (EncodeKey(mid, &buf).compare(enc_key) < 0) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return begin;
+}
+
+bool ColumnarMemStore::Find(const Slice& enc_key, rowid_t* idx) const {
+  rowid_t i = LowerBound(enc_key);
+  if (i >= num_rows()) {
+    return false;
+  }
+  faststring buf;
+  if (EncodeKey(i, &buf) != enc_key) {
+    return false;
+  }
+  *idx = i;
+  return true;
+}
+
+void ColumnarMemStore::CopyRow(rowid_t idx, uint8_t* row_data) const {
+  DCHECK_LT(idx, num_rows());
+  const Chunk* chunk = chunk_for_row(idx);
+  rowid_t row_in_chunk = idx % kRowsPerChunk;
+  ContiguousRowHelper::InitNullsBitmap(*schema_, row_data,
+                                       ContiguousRowHelper::null_bitmap_size(*schema_));
+  for (size_t i = 0; i < schema_->num_columns(); i++) {
+    const ColumnSchema& col = schema_->column(i);
+    if (col.is_nullable() && BitmapTest(chunk->null_bitmaps[i], row_in_chunk)) {
+      ContiguousRowHelper::SetCellIsNull(*schema_, row_data, i, true);
+      continue;
+    }
+    size_t size = col.type_info()->size();
+    memcpy(row_data + schema_->column_offset(i),
+           chunk->cells[i] + row_in_chunk * size,
+           size);
+  }
+}
+
+Timestamp ColumnarMemStore::insertion_timestamp(rowid_t idx) const {
+  DCHECK_LT(idx, num_rows());
+  return chunk_for_row(idx)->insertion_timestamps[idx % kRowsPerChunk];
+}
+
+Mutation** ColumnarMemStore::mutable_redo_head(rowid_t idx) const {
+  DCHECK_LT(idx, num_rows());
+  return &chunk_for_row(idx)->redo_heads[idx % kRowsPerChunk];
+}
+
+Mutation* ColumnarMemStore::acquire_redo_head(rowid_t idx) const {
+  return reinterpret_cast<Mutation*>(base::subtle::Acquire_Load(
+      reinterpret_cast<AtomicWord*>(mutable_redo_head(idx))));
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,158 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_COLUMNAR_MEMSTORE_H
+#define KUDU_TABLET_COLUMNAR_MEMSTORE_H
+
+#include <memory>
+
+#include "kudu/common/rowid.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/timestamp.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ConstContiguousRow;
+
+namespace tablet {
+
+class Mutation;
+
+// Append-only, column-oriented storage for MemRowSet rows which arrive in
+// increasing key order, as is typical of time-series ingestion.
+//
+// Rows are stored in fixed-size chunks, each holding one array of cells per
+// column along with per-row insertion timestamps and mutation lists. Since
+// keys are appended in sorted order, the only index is the encoded key of
+// the first row of each chunk; lookups binary search the chunks and then the
+// rows within a chunk. Compared to the MemRowSet's b-tree, this saves the
+// per-row encoded key and b-tree node overhead.
+//
+// Rows whose keys don't sort after every key already in the store can't be
+// appended; the MemRowSet keeps those in its b-tree instead.
+//
+// As with the rest of the MemRowSet, all memory comes from the MemRowSet's
+// arena and is freed in bulk when the MemRowSet is destroyed.
+//
+// Appends are serialized internally. Reads may run concurrently with
+// appends, and see every row appended before they call num_rows().
+class ColumnarMemStore {
+ public:
+  static const rowid_t kRowsPerChunk = 1024;
+
+  ColumnarMemStore(const Schema* schema,
+                   std::shared_ptr<ShardedMemoryTrackingArena> arena);
+
+  // Append 'row', whose encoded key is 'enc_key', to the store.
+  //
+  // If 'enc_key' doesn't sort after every key in the store, the row isn't
+  // appended and 'appended' is set to false.
+  Status Append(Timestamp timestamp,
+                const ConstContiguousRow& row,
+                const Slice& enc_key,
+                bool* appended);
+
+  // The number of rows in the store.
+  rowid_t num_rows() const {
+    return num_rows_.Load(kMemOrderAcquire);
+  }
+
+  bool empty() const {
+    return num_rows() == 0;
+  }
+
+  // Return the index of the first row whose key is equal to or greater than
+  // 'enc_key', or num_rows() if there is none.
+  rowid_t LowerBound(const Slice& enc_key) const;
+
+  // Look up the row with key 'enc_key', setting 'idx' to its index.
+  // Returns false if there's no such row.
+  bool Find(const Slice& enc_key, rowid_t* idx) const;
+
+  // Encode the key of row 'idx' into 'buf'.
+  Slice EncodeKey(rowid_t idx, faststring* buf) const;
+
+  // Copy row 'idx' into 'row_data', in ContiguousRow format. Indirect data
+  // (e.g. strings) isn't copied; it remains owned by the arena.
+  void CopyRow(rowid_t idx, uint8_t* row_data) const;
+
+  Timestamp insertion_timestamp(rowid_t idx) const;
+
+  // The head of row 'idx''s mutation list. New mutations should be appended
+  // with Mutation::AppendToListAtomic().
+  Mutation** mutable_redo_head(rowid_t idx) const;
+
+  // Same as *mutable_redo_head(idx), but loaded with 'Acquire' semantics.
+  Mutation* acquire_redo_head(rowid_t idx) const;
+
+  // The number of rows at or after 'idx' which are in the same chunk.
+  rowid_t remaining_in_chunk(rowid_t idx) const {
+    return kRowsPerChunk - idx % kRowsPerChunk;
+  }
+
+ private:
+  struct Chunk {
+    // Cell data for each column, 'kRowsPerChunk' cells apiece.
+    uint8_t** cells;
+
+    // Null bitmap for each column, or NULL for non-nullable columns.
+    uint8_t** null_bitmaps;
+
+    Timestamp* insertion_timestamps;
+    Mutation** redo_heads;
+
+    // The encoded key of the chunk's first row.
+    Slice first_key;
+  };
+
+  Status AllocateChunk(const Slice& first_key, Chunk** chunk);
+
+  // Return the chunk holding row 'idx'.
+  const Chunk* chunk_for_row(rowid_t idx) const;
+
+  const Schema* const schema_;
+  const std::shared_ptr<ShardedMemoryTrackingArena> arena_;
+
+  // Serializes appends.
+  simple_spinlock lock_;
+
+  // The encoded key of the most recently appended row.
+  // Protected by 'lock_'.
+  faststring last_key_;
+
+  // Array of all of the chunks, reallocated (with double the capacity) when
+  // it fills up. Old arrays are left in the arena, so readers may keep
+  // using any array they loaded. Loaded and stored with 'Acquire' and
+  // 'Release' semantics.
+  Chunk** chunks_;
+  size_t chunks_capacity_;
+
+  AtomicInt<rowid_t> num_rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnarMemStore);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif
@@ -48,6 +48,7 @@ DEFINE_int32(merge_benchmark_num_rowsets, 3,
 DEFINE_int32(merge_benchmark_num_rows_per_rowset, 500000,
              "Number of rowsets as input to the merge");
 
+DECLARE_int32(compaction_merge_tree_min_inputs);
 DECLARE_string(block_manager);
 
 using std::shared_ptr;
@@ -406,8 +407,10 @@ class TestCompaction : public KuduRowSetTest {
       CHECK(!rowsets.empty()) << "No rowsets found in " << FLAGS_merge_benchmark_input_dir;
     }
     LOG(INFO) << "Beginning compaction";
-    LOG_TIMING(INFO, "compacting " +
-               std::string((OVERLAP_INPUTS ? "with overlap" : "without overlap"))) {
+    LOG_TIMING(INFO, Substitute("compacting $0 inputs $1 (tree merge from $2 inputs)",
+                                rowsets.size(),
+                                OVERLAP_INPUTS ? "with overlap" : "without overlap",
+                                FLAGS_compaction_merge_tree_min_inputs)) {
       MvccSnapshot merge_snap(mvcc_);
       gscoped_ptr<CompactionInput> compact_input;
       ASSERT_OK(BuildCompactionInput(merge_snap, rowsets, schema_, &compact_input));
@@ -422,6 +425,10 @@ class TestCompaction : public KuduRowSetTest {
     }
   }
 
+  // Randomly compact layers of rowsets which share some of their rows, and
+  // verify the final row histories.
+  void DoDuplicatedRowsRandomCompaction();
+
   // Helpers for building an expected row history.
   void AddExpectedDelete(Mutation** current_head, Timestamp ts = Timestamp::kInvalidTimestamp);
   void AddExpectedUpdate(Mutation** current_head, int32_t val);
@@ -675,7 +682,7 @@ void TestCompaction::AddUpdateAndDelete(RowSet* rs, CompactionInputRow* row, int
 //
 // The verification is performed against a vector of expected CompactionInputRow that we build
 // as we insert/update/delete.
-TEST_F(TestCompaction, TestDuplicatedRowsRandomCompaction) {
+void TestCompaction::DoDuplicatedRowsRandomCompaction() {
   const int kBaseNumRowSets = 10;
   const int kNumRowsPerRowSet = 10;
 
@@ -784,6 +791,16 @@ TEST_F(TestCompaction, TestDuplicatedRowsRandomCompaction) {
   }
 }
 
+TEST_F(TestCompaction, TestDuplicatedRowsRandomCompaction) {
+  ASSERT_NO_FATAL_FAILURE(DoDuplicatedRowsRandomCompaction());
+}
+
+// Same as above, but merging with the tournament tree.
+TEST_F(TestCompaction, TestDuplicatedRowsRandomCompactionWithTree) {
+  FLAGS_compaction_merge_tree_min_inputs = 2;
+  ASSERT_NO_FATAL_FAILURE(DoDuplicatedRowsRandomCompaction());
+}
+
 // Test case that inserts and deletes a row in the same transaction and makes sure
 // the row isn't on the compaction input.
 TEST_F(TestCompaction, TestMRSCompactionDoesntOutputUnobservableRows) {
@@ -945,6 +962,13 @@ TEST_F(TestCompaction, TestMerge) {
   DoMerge(schemas.back(), schemas);
 }
 
+// Test compacting many inputs, which are merged with the tournament tree.
+TEST_F(TestCompaction, TestMergeWithTree) {
+  FLAGS_compaction_merge_tree_min_inputs = 2;
+  vector<Schema> schemas(8, schema_);
+  DoMerge(schemas.back(), schemas);
+}
+
 // test compacting when the inputs have different base schemas
 TEST_F(TestCompaction, TestMergeMultipleSchemas) {
   vector<Schema> schemas;
@@ -1018,6 +1042,21 @@ TEST_F(TestCompaction, BenchmarkMergeWithOverlap) {
   }
   ASSERT_NO_FATAL_FAILURE(DoBenchmark<true>());
 }
+
+// Benchmark for merging many fully overlapping inputs, as left behind by bulk
+// loads, with the linear merge and then with the tournament tree.
+TEST_F(TestCompaction, BenchmarkMergeManyInputsWithOverlap) {
+  if (!AllowSlowTests()) {
+    LOG(INFO) << "Skipped: must enable slow tests.";
+    return;
+  }
+  FLAGS_merge_benchmark_num_rowsets = 64;
+  FLAGS_merge_benchmark_num_rows_per_rowset = 20000;
+  FLAGS_compaction_merge_tree_min_inputs = 0;
+  ASSERT_NO_FATAL_FAILURE(DoBenchmark<true>());
+  FLAGS_compaction_merge_tree_min_inputs = 2;
+  ASSERT_NO_FATAL_FAILURE(DoBenchmark<true>());
+}
 #endif
 
 TEST_F(TestCompaction, TestCompactionFreesDiskSpace) {
@@ -18,15 +18,20 @@
 #include "kudu/tablet/compaction.h"
 
 #include <deque>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
+#include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/row_comparator.h"
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -38,6 +43,7 @@
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/flag_tags.h"
 
 using kudu::server::HybridClock;
 using std::shared_ptr;
@@ -45,11 +51,30 @@ using std::unique_ptr;
 using std::unordered_set;
 using strings::Substitute;
 
+DEFINE_int32(compaction_merge_tree_min_inputs, 16,
+             "The number of non-dominated inputs at or above which a merge compaction "
+             "picks its next row with a tournament tree rather than a linear scan of "
+             "its inputs. A value of 0 always uses the linear scan.");
+TAG_FLAG(compaction_merge_tree_min_inputs, advanced);
+TAG_FLAG(compaction_merge_tree_min_inputs, runtime);
+
+DECLARE_bool(tablet_codegen_merge_rows);
+
 namespace kudu {
 namespace tablet {
 
 namespace {
 
+// Compares the keys of 'a' and 'b' with 'comparator' if it isn't null, or
+// with 'schema' otherwise.
+int CompareRows(const Schema& schema, const RowComparator* comparator,
+                const RowBlockRow& a, const RowBlockRow& b) {
+  if (comparator != nullptr) {
+    return comparator->Compare(a, b);
+  }
+  return schema.Compare(a, b);
+}
+
 // Advances to the last mutation in a mutation list.
 void AdvanceToLastInList(const Mutation** m) {
   if (*m == nullptr) return;
@@ -62,17 +87,36 @@ void AdvanceToLastInList(const Mutation** m) {
 // CompactionInput yielding rows and mutations from a MemRowSet.
 class MemRowSetCompactionInput : public CompactionInput {
  public:
+  // Only the rows whose encoded keys are in [lower_bound, upper_bound) are
+  // yielded. An empty bound leaves that end of the range unbounded.
   MemRowSetCompactionInput(const MemRowSet& memrowset,
                            const MvccSnapshot& snap,
-                           const Schema* projection)
+                           const Schema* projection,
+                           const Slice& lower_bound,
+                           const Slice& upper_bound)
     : iter_(memrowset.NewIterator(projection, snap)),
+      key_schema_(memrowset.schema().CreateKeyProjection()),
+      lower_bound_(lower_bound.ToString()),
+      upper_bound_(upper_bound.ToString()),
+      key_arena_(1024, 64*1024),
       arena_(32*1024, 128*1024),
       has_more_blocks_(false) {
   }
 
   Status Init() override {
-    RETURN_NOT_OK(iter_->Init(nullptr));
-    has_more_blocks_ = iter_->HasNext();
+    ScanSpec spec;
+    if (!lower_bound_.empty()) {
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(key_schema_, &key_arena_,
+                                                    lower_bound_, &lower_bound_key_));
+      spec.SetLowerBoundKey(lower_bound_key_.get());
+    }
+    if (!upper_bound_.empty()) {
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(key_schema_, &key_arena_,
+                                                    upper_bound_, &upper_bound_key_));
+      spec.SetExclusiveUpperBoundKey(upper_bound_key_.get());
+    }
+    RETURN_NOT_OK(iter_->Init(&spec));
+    has_more_blocks_ = iter_->HasNext() && !iter_->current_row_out_of_bounds();
     return Status::OK();
   }
 
@@ -93,7 +137,12 @@ class MemRowSetCompactionInput : public CompactionInput {
     arena_.Reset();
     RowChangeListEncoder undo_encoder(&buffer_);
     int next_row_index = 0;
+    bool reached_upper_bound = false;
     for (int i = 0; i < num_in_block; ++i) {
+      if (PREDICT_FALSE(iter_->current_row_out_of_bounds())) {
+        reached_upper_bound = true;
+        break;
+      }
       // TODO(todd): A copy is performed to make all CompactionInputRow have the same schema
       CompactionInputRow& input_row = block->at(next_row_index);
       input_row.row.Reset(row_block_.get(), next_row_index);
@@ -134,7 +183,8 @@ class MemRowSetCompactionInput : public CompactionInput {
       block->resize(next_row_index);
     }
 
-    has_more_blocks_ = iter_->HasNext();
+    has_more_blocks_ = !reached_upper_bound && iter_->HasNext() &&
+                       !iter_->current_row_out_of_bounds();
     return Status::OK();
   }
 
@@ -154,6 +204,15 @@ class MemRowSetCompactionInput : public CompactionInput {
 
   gscoped_ptr<MemRowSet::Iterator> iter_;
 
+  // The encoded key range to yield, and the decoded bounds which are pushed
+  // down into 'iter_'.
+  const Schema key_schema_;
+  const string lower_bound_;
+  const string upper_bound_;
+  Arena key_arena_;
+  gscoped_ptr<EncodedKey> lower_bound_key_;
+  gscoped_ptr<EncodedKey> upper_bound_key_;
+
   // Arena used to store the projected undo/redo mutations of the current block.
   Arena arena_;
 
@@ -167,12 +226,25 @@ class MemRowSetCompactionInput : public CompactionInput {
 // CompactionInput yielding rows and mutations from an on-disk DiskRowSet.
 class DiskRowSetCompactionInput : public CompactionInput {
  public:
+  // Only the rows whose encoded keys are in [lower_bound, upper_bound) are
+  // yielded. An empty bound leaves that end of the range unbounded.
+  // 'base_cfile_iter' is the iterator over the base data wrapped by
+  // 'base_iter', which is used to find the range's first row.
   DiskRowSetCompactionInput(gscoped_ptr<RowwiseIterator> base_iter,
+                            const CFileSet::Iterator* base_cfile_iter,
                             unique_ptr<DeltaIterator> redo_delta_iter,
-                            unique_ptr<DeltaIterator> undo_delta_iter)
+                            unique_ptr<DeltaIterator> undo_delta_iter,
+                            const Schema& key_schema,
+                            const Slice& lower_bound,
+                            const Slice& upper_bound)
       : base_iter_(std::move(base_iter)),
+        base_cfile_iter_(base_cfile_iter),
         redo_delta_iter_(std::move(redo_delta_iter)),
         undo_delta_iter_(std::move(undo_delta_iter)),
+        key_schema_(key_schema),
+        lower_bound_(lower_bound.ToString()),
+        upper_bound_(upper_bound.ToString()),
+        key_arena_(1024, 64 * 1024),
         arena_(32 * 1024, 128 * 1024),
         block_(base_iter_->schema(), kRowsPerBlock, &arena_),
         redo_mutation_block_(kRowsPerBlock, static_cast<Mutation *>(nullptr)),
@@ -182,11 +254,25 @@ class DiskRowSetCompactionInput : public CompactionInput {
   Status Init() override {
     ScanSpec spec;
     spec.set_cache_blocks(false);
+    if (!lower_bound_.empty()) {
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(key_schema_, &key_arena_,
+                                                    lower_bound_, &lower_bound_key_));
+      spec.SetLowerBoundKey(lower_bound_key_.get());
+    }
+    if (!upper_bound_.empty()) {
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(key_schema_, &key_arena_,
+                                                    upper_bound_, &upper_bound_key_));
+      spec.SetExclusiveUpperBoundKey(upper_bound_key_.get());
+    }
     RETURN_NOT_OK(base_iter_->Init(&spec));
+
+    // The deltas are addressed by row ordinal, so start them at the first
+    // row of the key range.
+    first_rowid_in_block_ = base_iter_->HasNext() ? base_cfile_iter_->cur_ordinal_idx() : 0;
     RETURN_NOT_OK(redo_delta_iter_->Init(&spec));
-    RETURN_NOT_OK(redo_delta_iter_->SeekToOrdinal(0));
+    RETURN_NOT_OK(redo_delta_iter_->SeekToOrdinal(first_rowid_in_block_));
     RETURN_NOT_OK(undo_delta_iter_->Init(&spec));
-    RETURN_NOT_OK(undo_delta_iter_->SeekToOrdinal(0));
+    RETURN_NOT_OK(undo_delta_iter_->SeekToOrdinal(first_rowid_in_block_));
     return Status::OK();
   }
 
@@ -234,9 +320,19 @@ class DiskRowSetCompactionInput : public CompactionInput {
  private:
   DISALLOW_COPY_AND_ASSIGN(DiskRowSetCompactionInput);
   gscoped_ptr<RowwiseIterator> base_iter_;
+  const CFileSet::Iterator* const base_cfile_iter_;
   unique_ptr<DeltaIterator> redo_delta_iter_;
   unique_ptr<DeltaIterator> undo_delta_iter_;
 
+  // The encoded key range to yield, and the decoded bounds which are pushed
+  // down into 'base_iter_'.
+  const Schema key_schema_;
+  const string lower_bound_;
+  const string upper_bound_;
+  Arena key_arena_;
+  gscoped_ptr<EncodedKey> lower_bound_key_;
+  gscoped_ptr<EncodedKey> upper_bound_key_;
+
   Arena arena_;
 
   // The current block of data which has come from the input iterator
@@ -337,7 +433,8 @@ class MergeCompactionInput : public CompactionInput {
   // State kept for each of the inputs.
   struct MergeState {
     MergeState() :
-      pending_idx(0)
+      pending_idx(0),
+      key_prefix(0)
     {}
 
     ~MergeState() {
@@ -370,17 +467,23 @@ class MergeCompactionInput : public CompactionInput {
     // row of this block is less than the first row of the other block.
     // In this case, we can remove the other input from the merge until
     // this input's current block has been exhausted.
-    bool Dominates(const MergeState &other, const Schema &schema) const {
+    bool Dominates(const MergeState &other, const Schema &schema,
+                   const RowComparator* comparator) const {
       DCHECK(!empty());
       DCHECK(!other.empty());
 
-      return schema.Compare(pending.back().row, (*other.next()).row) < 0;
+      return CompareRows(schema, comparator, pending.back().row, (*other.next()).row) < 0;
     }
 
     shared_ptr<CompactionInput> input;
     vector<CompactionInputRow> pending;
     int pending_idx;
 
+    // The first eight bytes of the encoded key of next(), zero-padded and
+    // big-endian, so that comparing prefixes orders most rows without a full
+    // key comparison. Only maintained by the tournament-tree merge.
+    uint64_t key_prefix;
+
     vector<MergeState *> dominated;
   };
 
@@ -394,6 +497,9 @@ class MergeCompactionInput : public CompactionInput {
       state->input = input;
       states_.push_back(state.release());
     }
+    if (FLAGS_tablet_codegen_merge_rows) {
+      codegen::CompilationManager::GetSingleton()->RequestRowComparator(schema_, &comparator_);
+    }
   }
 
   virtual ~MergeCompactionInput() {
@@ -428,6 +534,11 @@ class MergeCompactionInput : public CompactionInput {
 
     block->clear();
 
+    if (FLAGS_compaction_merge_tree_min_inputs > 0 &&
+        states_.size() >= FLAGS_compaction_merge_tree_min_inputs) {
+      return PrepareBlockWithTree(block);
+    }
+
     while (true) {
       int smallest_idx = -1;
       CompactionInputRow* smallest;
@@ -453,7 +564,8 @@ class MergeCompactionInput : public CompactionInput {
           smallest = state->next();
           continue;
         }
-        int row_comp = schema_->Compare(state->next()->row, smallest->row);
+        int row_comp = CompareRows(*schema_, comparator_.get(),
+                                   state->next()->row, smallest->row);
         if (row_comp < 0) {
           smallest_idx = i;
           smallest = state->next();
@@ -503,6 +615,128 @@ class MergeCompactionInput : public CompactionInput {
  private:
   DISALLOW_COPY_AND_ASSIGN(MergeCompactionInput);
 
+  // Like the linear merge in PrepareBlock(), but keeps the inputs in a loser
+  // tree so that each row costs O(lg k) comparisons rather than O(k). This
+  // pays off when many overlapping inputs are merged, e.g. after bulk loads.
+  //
+  // As with the linear merge, the block ends as soon as any input runs out
+  // of pending rows.
+  Status PrepareBlockWithTree(vector<CompactionInputRow>* block) {
+    for (MergeState* state : states_) {
+      if (state->empty()) {
+        prepared_block_arena_ = state->input->PreparedBlockArena();
+        return Status::OK();
+      }
+      UpdateKeyPrefix(state);
+    }
+    BuildTree();
+
+    while (true) {
+      int winner = tree_[0];
+      MergeState* state = states_[winner];
+      CompactionInputRow* smallest = state->next();
+      uint64_t smallest_prefix = state->key_prefix;
+      bool input_exhausted = PopAndReplay(winner);
+
+      // Rows with the same key as 'smallest' are the next winners. As in the
+      // linear merge, the newer of each pair keeps the older as its ghost.
+      while (!states_[tree_[0]]->empty() &&
+             states_[tree_[0]]->key_prefix == smallest_prefix &&
+             CompareRows(*schema_, comparator_.get(),
+                         states_[tree_[0]]->next()->row, smallest->row) == 0) {
+        int dup = tree_[0];
+        MergeState* dup_state = states_[dup];
+        int mutation_comp = CompareDuplicatedRows(*dup_state->next(), *smallest);
+        CHECK_NE(mutation_comp, 0);
+        if (mutation_comp > 0) {
+          RETURN_NOT_OK(SetPreviousGhost(dup_state->next(), smallest, true /* clone */,
+                                         dup_state->input->PreparedBlockArena()));
+          smallest = dup_state->next();
+        } else {
+          RETURN_NOT_OK(SetPreviousGhost(smallest, dup_state->next(), true /* clone */,
+                                         smallest->row.row_block()->arena()));
+        }
+        if (PopAndReplay(dup)) {
+          input_exhausted = true;
+          state = dup_state;
+        }
+      }
+
+      block->push_back(*smallest);
+      if (input_exhausted) {
+        prepared_block_arena_ = state->input->PreparedBlockArena();
+        return Status::OK();
+      }
+    }
+  }
+
+  // Return the zero-padded, big-endian first eight bytes of the encoded key
+  // of 'row'.
+  uint64_t KeyPrefix(const CompactionInputRow* row) {
+    Slice key = schema_->EncodeComparableKey(row->row, &encoded_key_buf_);
+    uint64_t prefix = 0;
+    memcpy(&prefix, key.data(), std::min<size_t>(key.size(), sizeof(prefix)));
+    return BigEndian::ToHost64(prefix);
+  }
+
+  void UpdateKeyPrefix(MergeState* state) {
+    if (!state->empty()) {
+      state->key_prefix = KeyPrefix(state->next());
+    }
+  }
+
+  // Return true if the next row of states_[a] sorts before that of
+  // states_[b]. Inputs with no pending rows sort last.
+  bool TreeLess(int a, int b) const {
+    const MergeState* sa = states_[a];
+    const MergeState* sb = states_[b];
+    if (sa->empty() || sb->empty()) {
+      return !sa->empty() && sb->empty();
+    }
+    if (sa->key_prefix != sb->key_prefix) {
+      return sa->key_prefix < sb->key_prefix;
+    }
+    return CompareRows(*schema_, comparator_.get(), sa->next()->row, sb->next()->row) < 0;
+  }
+
+  // Build the loser tree over states_. The leaves are the implicit nodes
+  // k..2k-1 for k inputs; internal node n holds the loser of the match
+  // between its children, and tree_[0] holds the overall winner.
+  void BuildTree() {
+    int k = states_.size();
+    tree_.resize(k);
+    vector<int> winners(2 * k);
+    for (int i = 0; i < k; i++) {
+      winners[k + i] = i;
+    }
+    for (int n = k - 1; n >= 1; n--) {
+      int a = winners[2 * n];
+      int b = winners[2 * n + 1];
+      if (TreeLess(b, a)) {
+        std::swap(a, b);
+      }
+      winners[n] = a;
+      tree_[n] = b;
+    }
+    tree_[0] = winners[1];
+  }
+
+  // Pop the next row of states_[idx], then replay its matches up to the
+  // root. Returns true if the input has no more pending rows.
+  bool PopAndReplay(int idx) {
+    MergeState* state = states_[idx];
+    state->pop_front();
+    UpdateKeyPrefix(state);
+    int winner = idx;
+    for (int n = (idx + states_.size()) / 2; n >= 1; n /= 2) {
+      if (TreeLess(tree_[n], winner)) {
+        std::swap(tree_[n], winner);
+      }
+    }
+    tree_[0] = winner;
+    return state->empty();
+  }
+
   // Look through our current set of inputs. For any that are empty,
   // pull the next block into its pending list. If there is no next
   // block, remove it from our input set.
@@ -578,7 +812,7 @@ class MergeCompactionInput : public CompactionInput {
   }
 
   bool TryInsertIntoDominanceList(MergeState *dominator, MergeState *candidate) {
-    if (dominator->Dominates(*candidate, *schema_)) {
+    if (dominator->Dominates(*candidate, *schema_, comparator_.get())) {
       dominator->dominated.push_back(candidate);
       return true;
     } else {
@@ -660,9 +894,15 @@ class MergeCompactionInput : public CompactionInput {
   }
 
   const Schema* schema_;
+  // If set, compares the rows of the inputs. See --tablet_codegen_merge_rows.
+  gscoped_ptr<codegen::RowComparator> comparator_;
   vector<MergeState *> states_;
   Arena* prepared_block_arena_;
 
+  // The loser tree of PrepareBlockWithTree(), indexing into states_.
+  vector<int> tree_;
+  faststring encoded_key_buf_;
+
   // Vector to keep blocks that store duplicated row data.
   // This needs to be stored internally as row data for ghosts might have been deleted
   // by the the time the most recent version row is processed.
@@ -814,9 +1054,19 @@ Status CompactionInput::Create(const DiskRowSet &rowset,
                                const Schema* projection,
                                const MvccSnapshot &snap,
                                gscoped_ptr<CompactionInput>* out) {
+  return Create(rowset, projection, snap, Slice(), Slice(), out);
+}
+
+Status CompactionInput::Create(const DiskRowSet &rowset,
+                               const Schema* projection,
+                               const MvccSnapshot &snap,
+                               const Slice& lower_bound,
+                               const Slice& exclusive_upper_bound,
+                               gscoped_ptr<CompactionInput>* out) {
   CHECK(projection->has_column_ids());
 
-  shared_ptr<ColumnwiseIterator> base_cwise(rowset.base_data_->NewIterator(projection));
+  CFileSet::Iterator* base_cfile_iter = rowset.base_data_->NewIterator(projection);
+  shared_ptr<ColumnwiseIterator> base_cwise(base_cfile_iter);
   gscoped_ptr<RowwiseIterator> base_iter(new MaterializingIterator(base_cwise));
 
   // Creates a DeltaIteratorMerger that will only include the relevant REDO deltas.
@@ -831,16 +1081,29 @@ Status CompactionInput::Create(const DiskRowSet &rowset,
       DeltaTracker::UNDOS_ONLY, &undo_deltas), "Could not open UNDOs");
 
   out->reset(new DiskRowSetCompactionInput(std::move(base_iter),
+                                           base_cfile_iter,
                                            std::move(redo_deltas),
-                                           std::move(undo_deltas)));
+                                           std::move(undo_deltas),
+                                           rowset.rowset_metadata_->tablet_schema().CreateKeyProjection(),
+                                           lower_bound,
+                                           exclusive_upper_bound));
   return Status::OK();
 }
 
 CompactionInput *CompactionInput::Create(const MemRowSet &memrowset,
                                          const Schema* projection,
                                          const MvccSnapshot &snap) {
+  return Create(memrowset, projection, snap, Slice(), Slice());
+}
+
+CompactionInput *CompactionInput::Create(const MemRowSet &memrowset,
+                                         const Schema* projection,
+                                         const MvccSnapshot &snap,
+                                         const Slice& lower_bound,
+                                         const Slice& exclusive_upper_bound) {
   CHECK(projection->has_column_ids());
-  return new MemRowSetCompactionInput(memrowset, snap, projection);
+  return new MemRowSetCompactionInput(memrowset, snap, projection,
+                                      lower_bound, exclusive_upper_bound);
 }
 
 CompactionInput *CompactionInput::Merge(const vector<shared_ptr<CompactionInput> > &inputs,
@@ -853,14 +1116,25 @@ CompactionInput *CompactionInput::Merge(const vector<shared_ptr<CompactionInput>
 Status RowSetsInCompaction::CreateCompactionInput(const MvccSnapshot &snap,
                                                   const Schema* schema,
                                                   shared_ptr<CompactionInput> *out) const {
+  return CreateCompactionInput(snap, schema, Slice(), Slice(), out);
+}
+
+Status RowSetsInCompaction::CreateCompactionInput(const MvccSnapshot &snap,
+                                                  const Schema* schema,
+                                                  const Slice& lower_bound,
+                                                  const Slice& exclusive_upper_bound,
+                                                  shared_ptr<CompactionInput> *out) const {
   CHECK(schema->has_column_ids());
+  bool bounded = !lower_bound.empty() || !exclusive_upper_bound.empty();
 
   vector<shared_ptr<CompactionInput> > inputs;
   for (const shared_ptr<RowSet> &rs : rowsets_) {
     gscoped_ptr<CompactionInput> input;
-    RETURN_NOT_OK_PREPEND(rs->NewCompactionInput(schema, snap, &input),
-                          Substitute("Could not create compaction input for rowset $0",
-                                     rs->ToString()));
+    Status s = bounded ?
+        rs->NewCompactionInputForRange(schema, snap, lower_bound, exclusive_upper_bound, &input) :
+        rs->NewCompactionInput(schema, snap, &input);
+    RETURN_NOT_OK_PREPEND(s, Substitute("Could not create compaction input for rowset $0",
+                                        rs->ToString()));
     inputs.push_back(shared_ptr<CompactionInput>(input.release()));
   }
 
@@ -92,12 +92,31 @@ class CompactionInput {
                        const MvccSnapshot &snap,
                        gscoped_ptr<CompactionInput>* out);
 
+  // Like the above, but only yields the rows whose encoded keys are in
+  // [lower_bound, exclusive_upper_bound). An empty bound leaves that end of
+  // the range unbounded.
+  static Status Create(const DiskRowSet &rowset,
+                       const Schema* projection,
+                       const MvccSnapshot &snap,
+                       const Slice& lower_bound,
+                       const Slice& exclusive_upper_bound,
+                       gscoped_ptr<CompactionInput>* out);
+
   // Create an input which reads from the given memrowset, yielding base rows and updates
   // prior to the given snapshot.
   static CompactionInput *Create(const MemRowSet &memrowset,
                                  const Schema* projection,
                                  const MvccSnapshot &snap);
 
+  // Like the above, but only yields the rows whose encoded keys are in
+  // [lower_bound, exclusive_upper_bound). An empty bound leaves that end of
+  // the range unbounded.
+  static CompactionInput *Create(const MemRowSet &memrowset,
+                                 const Schema* projection,
+                                 const MvccSnapshot &snap,
+                                 const Slice& lower_bound,
+                                 const Slice& exclusive_upper_bound);
+
   // Create an input which merges several other compaction inputs. The inputs are merged
   // in key-order according to the given schema. All inputs must have matching schemas.
   static CompactionInput *Merge(const vector<std::shared_ptr<CompactionInput> > &inputs,
@@ -139,6 +158,15 @@ class RowSetsInCompaction {
                                const Schema* schema,
                                std::shared_ptr<CompactionInput> *out) const;
 
+  // Like the above, but the input only yields the rows whose encoded keys are
+  // in [lower_bound, exclusive_upper_bound). An empty bound leaves that end
+  // of the range unbounded.
+  Status CreateCompactionInput(const MvccSnapshot &snap,
+                               const Schema* schema,
+                               const Slice& lower_bound,
+                               const Slice& exclusive_upper_bound,
+                               std::shared_ptr<CompactionInput> *out) const;
+
   // Dump a log message indicating the chosen rowsets.
   void DumpToLog() const;
 
@@ -60,6 +60,44 @@ TEST(TestCompactionPolicy, TestBudgetedSelection) {
   ASSERT_GE(quality, 1.0);
 }
 
+// Test that a repeated selection over an unchanged tree returns the cached
+// pick, and that a change to the tree's rowsets causes a fresh selection.
+TEST(TestCompactionPolicy, TestCachedSelection) {
+  RowSetVector vec;
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("C", "c")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("B", "a")));
+
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  const int kBudgetMb = 1000; // enough to select all
+  BudgetedCompactionPolicy policy(kBudgetMb);
+
+  unordered_set<RowSet*> picked;
+  double quality = 0;
+  ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+  ASSERT_EQ(2, picked.size());
+
+  // Picking again, from the cache or not, yields the same result.
+  unordered_set<RowSet*> repicked;
+  double requality = 0;
+  ASSERT_OK(policy.PickRowSets(tree, &repicked, &requality, nullptr));
+  ASSERT_EQ(picked, repicked);
+  ASSERT_EQ(quality, requality);
+  vector<string> log;
+  ASSERT_OK(policy.PickRowSets(tree, &repicked, &requality, &log));
+  ASSERT_EQ(picked, repicked);
+  ASSERT_EQ(quality, requality);
+  ASSERT_FALSE(log.empty());
+
+  // A new tree with another overlapping rowset should include it.
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("A", "b")));
+  RowSetTree new_tree;
+  ASSERT_OK(new_tree.Reset(vec));
+  ASSERT_OK(policy.PickRowSets(new_tree, &repicked, &requality, nullptr));
+  ASSERT_EQ(3, repicked.size());
+}
+
 // Return the directory of the currently-running executable.
 static string GetExecutableDir() {
   string exec;
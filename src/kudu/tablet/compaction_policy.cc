@@ -242,15 +242,40 @@ class BoundCalculator {
 
 } // anonymous namespace
 
+void BudgetedCompactionPolicy::ComputeMaxWindowValues(const vector<RowSetInfo>& asc_min_key,
+                                                      vector<double>* max_window_values) {
+  // A solution with asc_min_key[i] as its left-most rowset may only contain
+  // rowsets whose min key is no less than its own: a suffix of asc_min_key,
+  // including any ties. The fractional solution over that suffix bounds the
+  // value of any such solution, and can be built up incrementally from the
+  // right.
+  max_window_values->assign(asc_min_key.size(), 0);
+  BoundCalculator bound_calc(size_budget_mb_);
+  int i = static_cast<int>(asc_min_key.size()) - 1;
+  while (i >= 0) {
+    int j = i;
+    for (; j >= 0 && asc_min_key[j].cdf_min_key() == asc_min_key[i].cdf_min_key(); j--) {
+      bound_calc.Add(asc_min_key[j]);
+    }
+    double upper = bound_calc.ComputeLowerAndUpperBound().second;
+    for (int k = j + 1; k <= i; k++) {
+      (*max_window_values)[k] = upper;
+    }
+    i = j;
+  }
+}
+
 void BudgetedCompactionPolicy::RunApproximation(
     const vector<RowSetInfo>& asc_min_key,
     const vector<RowSetInfo>& asc_max_key,
+    const vector<double>& max_window_values,
     vector<double>* best_upper_bounds,
     SolutionAndValue* best_solution) {
   best_upper_bounds->clear();
   best_upper_bounds->reserve(asc_min_key.size());
   BoundCalculator bound_calc(size_budget_mb_);
-  for (const RowSetInfo& cc_a : asc_min_key) {
+  for (int i = 0; i < asc_min_key.size(); i++) {
+    const RowSetInfo& cc_a = asc_min_key[i];
     bound_calc.clear();
     double ab_min = cc_a.cdf_min_key();
     double ab_max = cc_a.cdf_max_key();
@@ -261,6 +286,14 @@ void BudgetedCompactionPolicy::RunApproximation(
       }
       ab_max = std::max(cc_b.cdf_max_key(), ab_max);
       double union_width = ab_max - ab_min;
+      // The support only widens from here on, so no later solution for this
+      // 'cc_a' can beat the best one so far. Fold that into the upper bound
+      // so that the second pass skips 'cc_a' unless it found something better.
+      double max_remaining = max_window_values[i] - union_width * kSupportAdjust;
+      if (max_remaining <= best_solution->value) {
+        best_upper = std::max(max_remaining, best_upper);
+        break;
+      }
       bound_calc.Add(cc_b);
       auto bounds = bound_calc.ComputeLowerAndUpperBound();
       double lower = bounds.first - union_width * kSupportAdjust;
@@ -283,6 +316,7 @@ void BudgetedCompactionPolicy::RunApproximation(
 void BudgetedCompactionPolicy::RunExact(
     const vector<RowSetInfo>& asc_min_key,
     const vector<RowSetInfo>& asc_max_key,
+    const vector<double>& max_window_values,
     const vector<double>& best_upper_bounds,
     SolutionAndValue* best_solution) {
 
@@ -314,6 +348,12 @@ void BudgetedCompactionPolicy::RunExact(
         // cc_b with cdf_max_key() > cc_a.cdf_min_key()
         continue;
       }
+      // As in the first pass, stop once the support is too wide for any
+      // further solution to beat the best one.
+      ab_max = std::max(cc_b.cdf_max_key(), ab_max);
+      if (max_window_values[i] - (ab_max - ab_min) * kSupportAdjust <= best_solution->value) {
+        break;
+      }
       inrange_candidates.push_back(&cc_b);
     }
     if (inrange_candidates.empty()) continue;
@@ -347,12 +387,48 @@ void BudgetedCompactionPolicy::RunExact(
   }
 }
 
-// See docs/design-docs/compaction-policy.md for an overview of the compaction
-// policy implemented in this function.
 Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
                                              unordered_set<RowSet*>* picked,
                                              double* quality,
                                              std::vector<std::string>* log) {
+  vector<std::pair<uint64_t, bool> > rowset_states;
+  rowset_states.reserve(tree.all_rowsets().size());
+  for (const auto& rs : tree.all_rowsets()) {
+    rowset_states.emplace_back(rs->EstimateOnDiskSize(), rs->IsAvailableForCompaction());
+  }
+
+  // Reuse the last pick if none of its inputs changed, unless a log of the
+  // selection was asked for.
+  if (log == nullptr &&
+      cached_pick_.valid &&
+      cached_pick_.tree_id == tree.id() &&
+      cached_pick_.approximation_ratio == FLAGS_compaction_approximation_ratio &&
+      cached_pick_.rowset_states == rowset_states) {
+    *picked = cached_pick_.picked;
+    *quality = cached_pick_.quality;
+    return Status::OK();
+  }
+
+  cached_pick_.valid = false;
+  double pick_quality = 0;
+  RETURN_NOT_OK(DoPickRowSets(tree, picked, &pick_quality, log));
+  *quality = pick_quality;
+
+  cached_pick_.valid = true;
+  cached_pick_.tree_id = tree.id();
+  cached_pick_.approximation_ratio = FLAGS_compaction_approximation_ratio;
+  cached_pick_.rowset_states.swap(rowset_states);
+  cached_pick_.picked = *picked;
+  cached_pick_.quality = pick_quality;
+  return Status::OK();
+}
+
+// See docs/design-docs/compaction-policy.md for an overview of the compaction
+// policy implemented in this function.
+Status BudgetedCompactionPolicy::DoPickRowSets(const RowSetTree &tree,
+                                               unordered_set<RowSet*>* picked,
+                                               double* quality,
+                                               std::vector<std::string>* log) {
   vector<RowSetInfo> asc_min_key, asc_max_key;
   SetupKnapsackInput(tree, &asc_min_key, &asc_max_key);
   if (asc_max_key.empty()) {
@@ -410,8 +486,17 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   //     cases where the upper bound is lower than our current best solution.
   // 2) 'best_solution' and 'best_solution->value': the best approximate solution
   //     found.
+  //
+  // Both passes stop widening a solution once its support is so wide that
+  // it can't beat the best solution so far, whatever rowsets it contains.
+  // This keeps the work per left-most rowset proportional to the number of
+  // rowsets it could usefully be compacted with, rather than to the size of
+  // the tablet.
+  vector<double> max_window_values;
+  ComputeMaxWindowValues(asc_min_key, &max_window_values);
   vector<double> best_upper_bounds;
-  RunApproximation(asc_min_key, asc_max_key, &best_upper_bounds, &best_solution);
+  RunApproximation(asc_min_key, asc_max_key, max_window_values, &best_upper_bounds,
+                   &best_solution);
 
   // Pass 2 (precise)
   // ------------------------------------------------------------
@@ -419,7 +504,7 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   // In cases where the upper bound indicates we could do substantially better than
   // our current best solution, we use the exact knapsack solver to find the improved
   // solution.
-  RunExact(asc_min_key, asc_max_key, best_upper_bounds, &best_solution);
+  RunExact(asc_min_key, asc_max_key, max_window_values, best_upper_bounds, &best_solution);
 
   // Log the input and output of the selection.
   if (VLOG_IS_ON(1) || log != nullptr) {
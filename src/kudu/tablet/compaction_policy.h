@@ -17,8 +17,10 @@
 #ifndef KUDU_TABLET_COMPACTION_POLICY_H
 #define KUDU_TABLET_COMPACTION_POLICY_H
 
+#include <cstdint>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
@@ -74,6 +76,11 @@ class CompactionPolicy {
 // future cost of operations on the tablet.
 //
 // See src/kudu/tablet/compaction-policy.txt for details.
+//
+// The last pick is cached, and reused for as long as the tree and the sizes
+// and availability of its rowsets are unchanged, since the maintenance
+// manager asks for the best compaction's quality far more often than the
+// tablet changes.
 class BudgetedCompactionPolicy : public CompactionPolicy {
  public:
   explicit BudgetedCompactionPolicy(int size_budget_mb);
@@ -91,6 +98,30 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
     double value = 0;
   };
 
+  // The inputs and result of the last pick.
+  struct CachedPick {
+    bool valid = false;
+    uint64_t tree_id = 0;
+    double approximation_ratio = 0;
+    // The on-disk size and availability of each rowset of the tree.
+    std::vector<std::pair<uint64_t, bool> > rowset_states;
+    std::unordered_set<RowSet*> picked;
+    double quality = 0;
+  };
+
+  // PickRowSets() without the cache.
+  Status DoPickRowSets(const RowSetTree &tree,
+                       std::unordered_set<RowSet*>* picked,
+                       double* quality,
+                       std::vector<std::string>* log);
+
+  // Sets max_window_values[i] to an upper bound on the knapsack value of
+  // any solution with asc_min_key[i] as its left-most rowset, ignoring the
+  // width of its support. Once the support of a solution is wider than this
+  // bound, there is no point in widening it further.
+  void ComputeMaxWindowValues(const std::vector<RowSetInfo>& asc_min_key,
+                              std::vector<double>* max_window_values);
+
   // Sets up the 'asc_min_key' and 'asc_max_key' vectors necessary
   // for both the approximate and exact solutions below.
   void SetupKnapsackInput(const RowSetTree &tree,
@@ -106,6 +137,7 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
   void RunApproximation(
       const std::vector<RowSetInfo>& asc_min_key,
       const std::vector<RowSetInfo>& asc_max_key,
+      const std::vector<double>& max_window_values,
       std::vector<double>* best_upper_bounds,
       SolutionAndValue* best_solution);
 
@@ -120,10 +152,13 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
   void RunExact(
       const std::vector<RowSetInfo>& asc_min_key,
       const std::vector<RowSetInfo>& asc_max_key,
+      const std::vector<double>& max_window_values,
       const std::vector<double>& best_upper_bounds,
       SolutionAndValue* best_solution);
 
   size_t size_budget_mb_;
+
+  CachedPick cached_pick_;
 };
 
 } // namespace tablet
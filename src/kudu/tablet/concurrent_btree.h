@@ -35,6 +35,10 @@
 // - The leaf nodes are linked together with a "next" pointer. This makes
 //   scanning simpler (the Masstree implementation avoids this because it
 //   complicates the removal operation)
+// - Rather than a trie of 8-byte key slices, each node keeps the first 8 bytes
+//   of each of its keys in an array of integers alongside the keys. Searches
+//   scan that array with SIMD compares, so that only the keys which share the
+//   search key's prefix need a full comparison.
 //
 // NOTE: this code disables TSAN for the most part. This is because it uses
 // some "clever" concurrency mechanisms which are difficult to model in TSAN.
@@ -45,16 +49,23 @@
 
 #include <algorithm>
 #include <boost/smart_ptr/detail/yield_k.hpp>
+#include <cstring>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
 #include <boost/utility/binary.hpp>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/util/debug/sanitizer_scopes.h"
 #include "kudu/util/inline_slice.h"
+#include "kudu/util/key_compare.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/status.h"
@@ -304,41 +315,88 @@ class ValueSlice {
   const uint8_t* ptr_;
 } PACKED;
 
+// Return the first 8 bytes of 'key' (zero-padded if it's shorter) as a
+// big-endian integer.
+//
+// If the prefix of one key is less than that of another, then so is the key
+// itself. Keys with equal prefixes must be compared in full.
+inline uint64_t KeyPrefix(const Slice &key) {
+  uint64_t prefix = 0;
+  memcpy(&prefix, key.data(), std::min<size_t>(key.size(), sizeof(prefix)));
+  return BigEndian::ToHost64(prefix);
+}
+
+// Count the entries of the sorted array 'prefixes' which are less than
+// 'prefix' into 'num_less', and those which are less than or equal to it into
+// 'num_less_or_equal'.
+//
+// Nodes are small, so a linear SIMD scan beats a binary search. If the array
+// is being concurrently modified the counts may be wrong, but they are always
+// consistent with each other and within [0, num_entries].
+inline void CountKeyPrefixes(const uint64_t *prefixes, size_t num_entries,
+                             uint64_t prefix, size_t *num_less,
+                             size_t *num_less_or_equal) {
+  size_t less = 0;
+  size_t greater = 0;
+  size_t i = 0;
+#ifdef __SSE4_2__
+  // SSE only has signed 64-bit comparisons; flipping the sign bits of both
+  // sides turns them into unsigned ones.
+  const __m128i sign = _mm_set1_epi64x(static_cast<int64_t>(1ULL << 63));
+  const __m128i target = _mm_xor_si128(_mm_set1_epi64x(static_cast<int64_t>(prefix)),
+                                       sign);
+  for (; i + 2 <= num_entries; i += 2) {
+    __m128i p = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(prefixes + i)), sign);
+    less += __builtin_popcount(
+        _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(target, p))));
+    greater += __builtin_popcount(
+        _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(p, target))));
+  }
+#endif
+  for (; i < num_entries; i++) {
+    less += prefixes[i] < prefix;
+    greater += prefixes[i] > prefix;
+  }
+  *num_less = less;
+  *num_less_or_equal = num_entries - greater;
+}
+
 // Return the index of the first entry in the array which is
-// >= the given value
+// >= the given value. 'prefixes' holds the KeyPrefix() of each entry.
 template<size_t N>
-size_t FindInSliceArray(const InlineSlice<N, true> *array, ssize_t num_entries,
-                        const Slice &key, bool *exact) {
+size_t FindInSliceArray(const InlineSlice<N, true> *array, const uint64_t *prefixes,
+                        ssize_t num_entries, const Slice &key, bool *exact) {
   DCHECK_GE(num_entries, 0);
 
-  if (PREDICT_FALSE(num_entries == 0)) {
-    *exact = false;
-    return 0;
-  }
-
-  size_t left = 0;
-  size_t right = num_entries - 1;
+  // Only the entries in [left, right) share the key's prefix, so only they
+  // need to be compared in full.
+  size_t left, right;
+  CountKeyPrefixes(prefixes, num_entries, KeyPrefix(key), &left, &right);
 
+  // The length of the common prefix of the key and the last entries found to
+  // be less and greater than it. The entries in between share the shorter of
+  // the two, which needn't be compared again.
+  size_t left_prefix = 0;
+  size_t right_prefix = 0;
   while (left < right) {
-    int mid = (left + right + 1) / 2;
-    // TODO: inline slices with more than 8 bytes will store a prefix of the
-    // slice inline, which we could use to short circuit some of these comparisons.
-    int compare = array[mid].as_slice().compare(key);
+    size_t mid = left + (right - left) / 2;
+    size_t prefix;
+    int compare = CompareKeys(array[mid].as_slice(), key,
+                              std::min(left_prefix, right_prefix), &prefix);
     if (compare < 0) { // mid < key
-      left = mid;
+      left = mid + 1;
+      left_prefix = prefix;
     } else if (compare > 0) { // mid > search
-      right = mid - 1;
+      right = mid;
+      right_prefix = prefix;
     } else { // mid == search
       *exact = true;
       return mid;
     }
   }
 
-  int compare = array[left].as_slice().compare(key);
-  *exact = compare == 0;
-  if (compare < 0) { // key > left
-    left++;
-  }
+  *exact = false;
   return left;
 }
 
@@ -354,6 +412,17 @@ static void InsertInSliceArray(ISlice *array, size_t num_entries,
   array[idx].set(src, arena);
 }
 
+// Insert the prefix of 'key' into the prefix array of a node, to match a
+// call to InsertInSliceArray().
+inline void InsertInPrefixArray(uint64_t *prefixes, size_t num_entries,
+                                const Slice &key, size_t idx) {
+  DCHECK_LT(idx, num_entries);
+  for (size_t i = num_entries - 1; i > idx; i--) {
+    prefixes[i] = prefixes[i - 1];
+  }
+  prefixes[idx] = KeyPrefix(key);
+}
+
 
 template<class Traits>
 class NodeBase {
@@ -528,6 +597,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
     VersionField::SetLockedInsertingNoBarrier(&this->version_);
 
     keys_[0].set(split_key, arena);
+    key_prefixes_[0] = KeyPrefix(split_key);
     DCHECK_GT(split_key.size(), 0);
     child_pointers_[0] = lchild;
     child_pointers_[1] = rchild;
@@ -563,6 +633,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
     // Insert the key and child pointer in the right spot in the list
     int new_num_children = num_children_ + 1;
     InsertInSliceArray(keys_, new_num_children, key, idx, arena);
+    InsertInPrefixArray(key_prefixes_, new_num_children, key, idx);
     for (int i = new_num_children - 1; i > idx + 1; i--) {
       child_pointers_[i] = child_pointers_[i - 1];
     }
@@ -580,7 +651,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
   // For example, if the key is less than the first discriminating
   // node, returns 0. If it is between 0 and 1, returns 1, etc.
   size_t Find(const Slice &key, bool *exact) {
-    return FindInSliceArray(keys_, key_count(), key, exact);
+    return FindInSliceArray(keys_, key_prefixes_, key_count(), key, exact);
   }
 
   // Find the child whose subtree may contain the given key.
@@ -657,12 +728,14 @@ class PACKED InternalNode : public NodeBase<Traits> {
     constant_overhead = sizeof(NodeBase<Traits>) // base class
                       + sizeof(uint32_t), // num_children_
     keyptr_space = Traits::internal_node_size - constant_overhead,
-    kFanout = keyptr_space / (sizeof(KeyInlineSlice) + sizeof(NodePtr<Traits>))
+    kFanout = keyptr_space / (sizeof(KeyInlineSlice) + sizeof(uint64_t) +
+                              sizeof(NodePtr<Traits>))
   };
 
   // This ordering of members ensures KeyInlineSlices are properly aligned
   // for atomic ops
   KeyInlineSlice keys_[kFanout];
+  uint64_t key_prefixes_[kFanout];
   NodePtr<Traits> child_pointers_[kFanout];
   uint32_t num_children_;
 } PACKED;
@@ -724,6 +797,7 @@ class LeafNode : public NodeBase<Traits> {
     // verified that there is space available above.
     num_entries_++;
     InsertInSliceArray(keys_, num_entries_, key, idx, arena);
+    InsertInPrefixArray(key_prefixes_, num_entries_, key, idx);
     DebugRacyPoint<Traits>();
     InsertInSliceArray(vals_, num_entries_, val, idx, arena);
 
@@ -739,7 +813,7 @@ class LeafNode : public NodeBase<Traits> {
   // Note that, if the lock is not held, this may return
   // bogus results, in which case OCC must be used to verify.
   size_t Find(const Slice &key, bool *exact) const {
-    return FindInSliceArray(keys_, num_entries_, key, exact);
+    return FindInSliceArray(keys_, key_prefixes_, num_entries_, key, exact);
   }
 
   // Get the slice corresponding to the nth key.
@@ -810,12 +884,14 @@ class LeafNode : public NodeBase<Traits> {
                         + sizeof(LeafNode<Traits>*) // next_
                         + sizeof(uint8_t), // num_entries_
     kv_space = Traits::leaf_node_size - constant_overhead,
-    kMaxEntries = kv_space / (sizeof(KeyInlineSlice) + sizeof(ValueSlice))
+    kMaxEntries = kv_space / (sizeof(KeyInlineSlice) + sizeof(uint64_t) +
+                              sizeof(ValueSlice))
   };
 
   // This ordering of members keeps KeyInlineSlices so pointers are aligned
   LeafNode<Traits>* next_;
   KeyInlineSlice keys_[kMaxEntries];
+  uint64_t key_prefixes_[kMaxEntries];
   ValueSlice vals_[kMaxEntries];
   uint8_t num_entries_;
 } PACKED;
@@ -1126,6 +1202,53 @@ class CBTree {
     return arena_->memory_footprint();
   }
 
+  // Collect up to 'max_keys' keys which split the tree's key space into
+  // ranges holding roughly equal numbers of entries, in increasing order.
+  // The keys are taken from the separators of the shallowest level of
+  // internal nodes which has enough of them, so fewer keys (possibly none)
+  // are returned if the tree is too small to be split that finely.
+  //
+  // This walks the tree without any concurrency control, so it must not
+  // be called concurrently with inserts.
+  void GetSplitKeys(int max_keys, std::vector<std::string>* keys) const {
+    keys->clear();
+    AtomicVersion v;
+    NodePtr<Traits> root = StableRoot(&v);
+    if (max_keys <= 0 || root.type() != NodePtr<Traits>::INTERNAL_NODE) {
+      return;
+    }
+
+    std::vector<InternalNode<Traits>*> level = { root.internal_node_ptr() };
+    std::vector<Slice> level_keys;
+    while (true) {
+      level_keys.clear();
+      for (const InternalNode<Traits>* node : level) {
+        for (int i = 0; i < node->key_count(); i++) {
+          level_keys.push_back(node->GetKey(i));
+        }
+      }
+      // The tree is balanced, so either all of the nodes at this level have
+      // internal children or none do.
+      if (level_keys.size() >= max_keys ||
+          level[0]->child_pointers_[0].type() != NodePtr<Traits>::INTERNAL_NODE) {
+        break;
+      }
+      std::vector<InternalNode<Traits>*> children;
+      for (InternalNode<Traits>* node : level) {
+        for (int i = 0; i < node->num_children_; i++) {
+          children.push_back(node->child_pointers_[i].internal_node_ptr());
+        }
+      }
+      level.swap(children);
+    }
+
+    // Pick evenly spaced keys out of the level's separators.
+    size_t n = std::min<size_t>(max_keys, level_keys.size());
+    for (size_t i = 1; i <= n; i++) {
+      keys->push_back(level_keys[i * (level_keys.size() + 1) / (n + 1) - 1].ToString());
+    }
+  }
+
   // Mark the tree as frozen.
   // Once frozen, no further mutations may occur without triggering a CHECK
   // violation. But, new iterators created after this point can scan more
@@ -1447,6 +1570,9 @@ class CBTree {
 
     std::copy(node->keys_ + copy_start, node->keys_ + node->num_entries(),
               new_leaf->keys_);
+    std::copy(node->key_prefixes_ + copy_start,
+              node->key_prefixes_ + node->num_entries(),
+              new_leaf->key_prefixes_);
     std::copy(node->vals_ + copy_start, node->vals_ + node->num_entries(),
               new_leaf->vals_);
     new_leaf->num_entries_ = node->num_entries() - copy_start;
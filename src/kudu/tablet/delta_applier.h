@@ -78,6 +78,10 @@ class DeltaApplier : public ColumnwiseIterator {
   std::unique_ptr<DeltaIterator> delta_iter_;
 
   bool first_prepare_;
+
+  // The ordinal following the last prepared batch, where the delta iterator
+  // is positioned.
+  rowid_t next_delta_idx_;
 };
 
 } // namespace tablet
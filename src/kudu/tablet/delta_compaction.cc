@@ -21,7 +21,11 @@
 #include <string>
 #include <vector>
 
+#include <gflags/gflags.h>
+
+#include "kudu/common/column_materialization_context.h"
 #include "kudu/common/generic_iterators.h"
+#include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -34,6 +38,17 @@
 #include "kudu/tablet/deltamemstore.h"
 #include "kudu/tablet/multi_column_writer.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(tablet_delta_compaction_column_reader_threads, 0,
+             "Number of threads, shared by all major delta compactions, on which "
+             "the base data of the columns being compacted is read and decoded in "
+             "parallel, one iterator per column. If 0, each compaction reads its "
+             "columns serially. The REDO deltas are still read in a single pass "
+             "and applied by the compacting thread.");
+TAG_FLAG(tablet_delta_compaction_column_reader_threads, experimental);
 
 using std::shared_ptr;
 
@@ -53,6 +68,158 @@ namespace {
 
 const size_t kRowsPerBlock = 100; // Number of rows per block of columns
 
+// Number of rows per block of columns when the columns are read in parallel,
+// large enough to amortize handing them to the pool.
+const size_t kRowsPerParallelBlock = 1024;
+
+// Process-wide pool on which major delta compactions read their columns.
+class ColumnReaderPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<ColumnReaderPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<ColumnReaderPool>;
+
+  ColumnReaderPool() {
+    CHECK_OK(ThreadPoolBuilder("column-reader")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_tablet_delta_compaction_column_reader_threads)
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnReaderPool);
+};
+
+// Reads the base data of a CFileSet with one iterator per projected column,
+// decoding the columns of each block in parallel on the column reader pool.
+//
+// Each column's indirect data (e.g. strings) is copied into an arena of the
+// column's own rather than the destination block's, so the columns don't
+// contend on it. That data is valid until the next call to NextBlock().
+class ColumnParallelIterator : public RowwiseIterator {
+ public:
+  ColumnParallelIterator(const CFileSet* base_data, const Schema* projection)
+      : base_data_(base_data),
+        projection_(projection) {
+  }
+
+  Status Init(ScanSpec* spec) OVERRIDE {
+    for (int i = 0; i < projection_->num_columns(); i++) {
+      unique_ptr<Column> col(new Column);
+      RETURN_NOT_OK(projection_->CreateProjectionByIdsIgnoreMissing(
+          { projection_->column_id(i) }, &col->schema));
+      col->iter.reset(base_data_->NewIterator(&col->schema));
+      RETURN_NOT_OK(col->iter->Init(spec));
+      cols_.emplace_back(std::move(col));
+    }
+    return Status::OK();
+  }
+
+  bool HasNext() const OVERRIDE {
+    // All of the columns have the same number of rows.
+    return !cols_.empty() && cols_[0]->iter->HasNext();
+  }
+
+  string ToString() const OVERRIDE {
+    return Substitute("ColumnParallel($0 columns)", cols_.size());
+  }
+
+  const Schema& schema() const OVERRIDE {
+    return *projection_;
+  }
+
+  void GetIteratorStats(vector<IteratorStats>* stats) const OVERRIDE {
+    stats->clear();
+    for (const unique_ptr<Column>& col : cols_) {
+      vector<IteratorStats> col_stats;
+      col->iter->GetIteratorStats(&col_stats);
+      stats->insert(stats->end(), col_stats.begin(), col_stats.end());
+    }
+  }
+
+  Status NextBlock(RowBlock* dst) OVERRIDE {
+    // Preparing a batch does no I/O, so do it here for every column and
+    // check that they agree on the number of rows.
+    size_t n = dst->row_capacity();
+    for (int i = 0; i < cols_.size(); i++) {
+      size_t col_n = dst->row_capacity();
+      RETURN_NOT_OK(cols_[i]->iter->PrepareBatch(&col_n));
+      if (i == 0) {
+        n = col_n;
+      } else if (col_n != n) {
+        return Status::Corruption(
+            Substitute("Column $0 has $1 rows left to read but column $2 has $3",
+                       projection_->column(i).name(), col_n,
+                       projection_->column(0).name(), n));
+      }
+    }
+    dst->Resize(n);
+    dst->selection_vector()->SetAllTrue();
+
+    // As in MultiColumnWriter::AppendBlock(), the calling thread takes the
+    // first share of the columns itself.
+    int num_tasks = std::min<int>(cols_.size(),
+                                  FLAGS_tablet_delta_compaction_column_reader_threads + 1);
+    vector<Status> statuses(num_tasks);
+    CountDownLatch latch(num_tasks - 1);
+    for (int t = 1; t < num_tasks; t++) {
+      Status* status = &statuses[t];
+      Status s = ColumnReaderPool::Get()->SubmitFunc([this, dst, &latch, t, num_tasks, status]() {
+          *status = ReadColumns(dst, t, num_tasks);
+          latch.CountDown();
+        });
+      if (PREDICT_FALSE(!s.ok())) {
+        // The pool is shutting down; do the work here instead.
+        statuses[t] = ReadColumns(dst, t, num_tasks);
+        latch.CountDown();
+      }
+    }
+    statuses[0] = ReadColumns(dst, 0, num_tasks);
+    latch.Wait();
+
+    for (const Status& s : statuses) {
+      RETURN_NOT_OK(s);
+    }
+    return Status::OK();
+  }
+
+ private:
+  struct Column {
+    Column() : arena(16 * 1024, 1024 * 1024) {}
+
+    // The single-column projection read by 'iter'.
+    Schema schema;
+    gscoped_ptr<ColumnwiseIterator> iter;
+    Arena arena;
+  };
+
+  // Reads the prepared batch of the columns with indexes 'first_col',
+  // 'first_col + stride', etc. into 'dst'.
+  Status ReadColumns(RowBlock* dst, int first_col, int stride) {
+    for (int i = first_col; i < cols_.size(); i += stride) {
+      Column* col = cols_[i].get();
+      col->arena.Reset();
+      ColumnBlock dst_block(dst->column_block(i));
+      ColumnBlock col_block(projection_->column(i).type_info(), dst_block.null_bitmap(),
+                            dst_block.data(), dst_block.nrows(), &col->arena);
+      ColumnMaterializationContext ctx(0, nullptr, &col_block, dst->selection_vector());
+      RETURN_NOT_OK(col->iter->MaterializeColumn(&ctx));
+      RETURN_NOT_OK(col->iter->FinishBatch());
+    }
+    return Status::OK();
+  }
+
+  const CFileSet* const base_data_;
+  const Schema* const projection_;
+  vector<unique_ptr<Column>> cols_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnParallelIterator);
+};
+
 } // anonymous namespace
 
 // TODO: can you major-delta-compact a new column after an alter table in order
@@ -95,8 +262,17 @@ string MajorDeltaCompaction::ColumnNamesToString() const {
 Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
   CHECK_EQ(state_, kInitialized);
 
-  shared_ptr<ColumnwiseIterator> old_base_data_cwise(base_data_->NewIterator(&partial_schema_));
-  gscoped_ptr<RowwiseIterator> old_base_data_rwise(new MaterializingIterator(old_base_data_cwise));
+  // Unless the columns are read in parallel, they're read from one iterator.
+  gscoped_ptr<RowwiseIterator> old_base_data_rwise;
+  size_t rows_per_block = kRowsPerBlock;
+  if (FLAGS_tablet_delta_compaction_column_reader_threads > 0 &&
+      partial_schema_.num_columns() > 1) {
+    old_base_data_rwise.reset(new ColumnParallelIterator(base_data_, &partial_schema_));
+    rows_per_block = kRowsPerParallelBlock;
+  } else {
+    shared_ptr<ColumnwiseIterator> old_base_data_cwise(base_data_->NewIterator(&partial_schema_));
+    old_base_data_rwise.reset(new MaterializingIterator(old_base_data_cwise));
+  }
 
   ScanSpec spec;
   spec.set_cache_blocks(false);
@@ -108,7 +284,7 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
   RETURN_NOT_OK(delta_iter_->SeekToOrdinal(0));
 
   Arena arena(32 * 1024, 128 * 1024);
-  RowBlock block(partial_schema_, kRowsPerBlock, &arena);
+  RowBlock block(partial_schema_, rows_per_block, &arena);
 
   DVLOG(1) << "Applying deltas and rewriting columns (" << partial_schema_.ToString() << ")";
   DeltaStats redo_stats;
@@ -124,7 +300,7 @@ Status MajorDeltaCompaction::FlushRowSetAndDeltas() {
     size_t n = block.nrows();
 
     // 2) Fetch all the REDO mutations.
-    vector<Mutation *> redo_mutation_block(kRowsPerBlock, static_cast<Mutation *>(nullptr));
+    vector<Mutation *> redo_mutation_block(rows_per_block, static_cast<Mutation *>(nullptr));
     RETURN_NOT_OK(delta_iter_->PrepareBatch(n, DeltaIterator::PREPARE_FOR_COLLECT));
     RETURN_NOT_OK(delta_iter_->CollectMutations(&redo_mutation_block, block.arena()));
 
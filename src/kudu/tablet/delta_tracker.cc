@@ -17,9 +17,12 @@
 
 #include "kudu/tablet/delta_tracker.h"
 
+#include <algorithm>
 #include <mutex>
 #include <set>
 
+#include <gflags/gflags.h>
+
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/strip.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -32,6 +35,8 @@
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/util/status.h"
 
+DECLARE_bool(deltafile_use_deleted_row_bitmap);
+
 namespace kudu {
 namespace tablet {
 
@@ -435,6 +440,9 @@ Status DeltaTracker::FlushDMS(DeltaMemStore* dms,
                                             std::move(options),
                                             dfr));
   LOG(INFO) << "Reopened delta block for read: " << block_id.ToString();
+  if (FLAGS_deltafile_use_deleted_row_bitmap) {
+    (*dfr)->set_deleted_rows(std::make_shared<DeletedRowBitmap>(dfw.deleted_rows()));
+  }
 
   RETURN_NOT_OK(rowset_metadata_->CommitRedoDeltaDataBlock(dms->id(), block_id));
   if (flush_type == FLUSH_METADATA) {
@@ -525,6 +533,63 @@ size_t DeltaTracker::CountRedoDeltaStores() const {
   return redo_delta_stores_.size();
 }
 
+Status DeltaTracker::CountLiveRows(const MvccSnapshot& snap, bool* counted,
+                                   rowid_t* count) const {
+  shared_ptr<DeltaMemStore> dms;
+  SharedDeltaStoreVector redos;
+  SharedDeltaStoreVector undos;
+  {
+    shared_lock<rw_spinlock> lock(component_lock_);
+    dms = dms_;
+    redos = redo_delta_stores_;
+    undos = undo_delta_stores_;
+  }
+  *counted = false;
+  if (dms->HasDeletesOrReinserts()) {
+    return Status::OK();
+  }
+
+  // The UNDOs of the base data (including the DELETE which undoes each row's
+  // insertion) must all be committed in 'snap' for the base data to be the
+  // starting point of the count.
+  for (const shared_ptr<DeltaStore>& ds : undos) {
+    RETURN_NOT_OK(ds->Init());
+    const DeltaStats& stats = ds->delta_stats();
+    if ((stats.delete_count() > 0 || stats.reinsert_count() > 0) &&
+        snap.MayHaveUncommittedTransactionsAtOrBefore(stats.max_timestamp())) {
+      return Status::OK();
+    }
+  }
+
+  int64_t net_deletes = 0;
+  for (const shared_ptr<DeltaStore>& ds : redos) {
+    // A DMS which is being flushed has no stats yet.
+    const DeltaMemStore* flushing_dms = dynamic_cast<const DeltaMemStore*>(ds.get());
+    if (flushing_dms != nullptr) {
+      if (flushing_dms->HasDeletesOrReinserts()) {
+        return Status::OK();
+      }
+      continue;
+    }
+    RETURN_NOT_OK(ds->Init());
+    const DeltaStats& stats = ds->delta_stats();
+    if ((stats.delete_count() == 0 && stats.reinsert_count() == 0) ||
+        !snap.MayHaveCommittedTransactionsAtOrAfter(stats.min_timestamp())) {
+      continue;
+    }
+    if (snap.MayHaveUncommittedTransactionsAtOrBefore(stats.max_timestamp())) {
+      return Status::OK();
+    }
+    net_deletes += stats.delete_count() - stats.reinsert_count();
+  }
+
+  DCHECK_GE(net_deletes, 0);
+  DCHECK_LE(net_deletes, num_rows_);
+  *count = num_rows_ - net_deletes;
+  *counted = true;
+  return Status::OK();
+}
+
 uint64_t DeltaTracker::EstimateOnDiskSize() const {
   shared_lock<rw_spinlock> lock(component_lock_);
   uint64_t size = 0;
@@ -534,6 +599,116 @@ uint64_t DeltaTracker::EstimateOnDiskSize() const {
   return size;
 }
 
+int64_t DeltaTracker::EstimateBytesInPotentiallyAncientUndoDeltas(
+    Timestamp ancient_history_mark) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+  int64_t bytes = 0;
+  for (const shared_ptr<DeltaStore>& ds : undo_delta_stores_) {
+    if (!ds->Initted() || ds->delta_stats().max_timestamp() < ancient_history_mark) {
+      bytes += ds->EstimateSize();
+    }
+  }
+  return bytes;
+}
+
+bool DeltaTracker::MayHaveDeltasBetween(Timestamp start, Timestamp end) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+  if (!dms_->Empty()) {
+    return true;
+  }
+  for (const auto* stores : { &redo_delta_stores_, &undo_delta_stores_ }) {
+    for (const shared_ptr<DeltaStore>& ds : *stores) {
+      if (!ds->Initted() ||
+          (ds->delta_stats().min_timestamp() < end &&
+           ds->delta_stats().max_timestamp() >= start)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool DeltaTracker::MayHaveUpdatesToColumn(ColumnId col_id) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+  if (!dms_->Empty()) {
+    return true;
+  }
+  for (const auto* stores : { &redo_delta_stores_, &undo_delta_stores_ }) {
+    for (const shared_ptr<DeltaStore>& ds : *stores) {
+      if (!ds->Initted() || ds->delta_stats().update_count_for_col_id(col_id) > 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+Status DeltaTracker::InitUndoDeltas(MonoTime deadline, int64_t* stores_initialized) {
+  SharedDeltaStoreVector undos;
+  CollectStores(&undos, UNDOS_ONLY);
+
+  // The UNDO files are in decreasing timestamp order, so start from the back
+  // where the ancient ones are most likely to be.
+  int64_t initialized = 0;
+  for (auto it = undos.rbegin(); it != undos.rend(); ++it) {
+    if (!MonoTime::Now().ComesBefore(deadline)) {
+      break;
+    }
+    if ((*it)->Initted()) {
+      continue;
+    }
+    RETURN_NOT_OK_PREPEND((*it)->Init(),
+                          Substitute("Unable to initialize UNDO delta file $0",
+                                     (*it)->ToString()));
+    initialized++;
+  }
+  *stores_initialized = initialized;
+  return Status::OK();
+}
+
+Status DeltaTracker::DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                             int64_t* blocks_deleted,
+                                             int64_t* bytes_deleted) {
+  // Keep a major delta compaction from adding UNDO files while we remove some.
+  std::lock_guard<Mutex> l(compact_flush_lock_);
+  CHECK(open_);
+
+  vector<BlockId> blocks_to_remove;
+  int64_t bytes = 0;
+  {
+    std::lock_guard<rw_spinlock> lock(component_lock_);
+    auto is_ancient = [&](const shared_ptr<DeltaStore>& ds) {
+      // We won't force open files just to read their stats.
+      return ds->Initted() && ds->delta_stats().max_timestamp() < ancient_history_mark;
+    };
+    for (const shared_ptr<DeltaStore>& ds : undo_delta_stores_) {
+      if (is_ancient(ds)) {
+        blocks_to_remove.push_back(down_cast<DeltaFileReader*>(ds.get())->block_id());
+        bytes += ds->EstimateSize();
+      }
+    }
+    // Iterators which already hold the removed stores may keep reading them.
+    undo_delta_stores_.erase(std::remove_if(undo_delta_stores_.begin(),
+                                            undo_delta_stores_.end(),
+                                            is_ancient),
+                             undo_delta_stores_.end());
+  }
+
+  *blocks_deleted = blocks_to_remove.size();
+  *bytes_deleted = bytes;
+  if (blocks_to_remove.empty()) {
+    return Status::OK();
+  }
+  VLOG(1) << "Removing ancient UNDO delta blocks: " << BlockId::JoinStrings(blocks_to_remove);
+
+  // Once flushed, the metadata no longer references the removed blocks, which
+  // get deleted.
+  RowSetMetadataUpdate update;
+  update.RemoveUndoDeltaBlocks(blocks_to_remove);
+  RETURN_NOT_OK(rowset_metadata_->CommitUpdate(update));
+  return rowset_metadata_->Flush();
+}
+
 void DeltaTracker::GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const {
   shared_lock<rw_spinlock> lock(component_lock_);
 
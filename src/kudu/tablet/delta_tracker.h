@@ -30,6 +30,7 @@
 #include "kudu/tablet/delta_store.h"
 #include "kudu/tablet/tablet_mem_trackers.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -156,12 +157,50 @@ class DeltaTracker {
                             const std::vector<BlockId>& new_delta_blocks,
                             DeltaType type);
 
+  // Returns the number of bytes in UNDO delta files which may hold only
+  // mutations older than 'ancient_history_mark'. Files whose stats haven't
+  // been read yet are counted too, since they may turn out to be ancient.
+  int64_t EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancient_history_mark) const;
+
+  // Reads the stats of the UNDO delta files which haven't been initialized
+  // yet, oldest first, until 'deadline' has passed. The number of files
+  // initialized is stored in '*stores_initialized'.
+  Status InitUndoDeltas(MonoTime deadline, int64_t* stores_initialized);
+
+  // Removes the initialized UNDO delta files holding only mutations older
+  // than 'ancient_history_mark', without rewriting any other data, and flushes
+  // the rowset metadata so that their blocks get deleted. The number of files
+  // removed and their estimated size are stored in '*blocks_deleted' and
+  // '*bytes_deleted'.
+  Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                 int64_t* blocks_deleted,
+                                 int64_t* bytes_deleted);
+
   // Return the number of rows encompassed by this DeltaTracker. Note that
   // this is _not_ the number of updated rows, but rather the number of rows
   // in the associated CFileSet base data. All updates must have a rowid
   // strictly less than num_rows().
   int64_t num_rows() const { return num_rows_; }
 
+  // Computes the number of base data rows which are live in 'snap' from the
+  // DeltaStats of the delta files, without reading any deltas.
+  //
+  // This is possible if every store which deletes or reinserts rows is either
+  // fully committed or fully uncommitted in 'snap'. Otherwise, or if the
+  // DeltaMemStores have deletes or reinserts (which aren't reflected in any
+  // stats), sets '*counted' to false and the rows must be scanned instead.
+  Status CountLiveRows(const MvccSnapshot& snap, bool* counted, rowid_t* count) const;
+
+  // Returns false if no delta of any store can have a timestamp in
+  // [start, end). Stores whose stats haven't been loaded, and a non-empty
+  // DeltaMemStore, are assumed to have such deltas.
+  bool MayHaveDeltasBetween(Timestamp start, Timestamp end) const;
+
+  // Returns false if no store can have an update to the column 'col_id',
+  // in either direction. Like above, stores whose stats haven't been loaded,
+  // and a non-empty DeltaMemStore, are assumed to have updates.
+  bool MayHaveUpdatesToColumn(ColumnId col_id) const;
+
   // Get the delta MemStore's size in bytes, including pre-allocation.
   size_t DeltaMemStoreSize() const;
 
@@ -24,11 +24,13 @@
 #include "kudu/common/schema.h"
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/gutil/strings/strcat.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/delta_store.h"
 #include "kudu/tablet/delta_tracker.h"
 #include "kudu/tablet/deltafile.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(deltafile_use_deleted_row_bitmap);
 DECLARE_int32(deltafile_default_block_size);
 DEFINE_int32(first_row_to_update, 10000, "the first row to update");
 DEFINE_int32(last_row_to_update, 100000, "the last row to update");
@@ -258,6 +260,41 @@ TEST_F(TestDeltaFile, TestRoundTrip) {
   DoTestRoundTrip();
 }
 
+// Test that when a row has several updates in the prepared batch, the last one
+// wins, and that the decoded updates of a batch can be applied more than once.
+TEST_F(TestDeltaFile, TestApplyMultipleUpdatesPerRow) {
+  const int kMaxTimestamp = 2;
+  WriteTestFile(0, kMaxTimestamp);
+
+  gscoped_ptr<DeltaIterator> it;
+  ASSERT_OK(OpenDeltaFileIterator(test_block_, &it));
+  ASSERT_OK(it->Init(nullptr));
+  ASSERT_OK(it->SeekToOrdinal(0));
+
+  RowBlock block(schema_, 100, &arena_);
+  for (int start_row = 0; start_row <= FLAGS_last_row_to_update; start_row += block.nrows()) {
+    ASSERT_OK(it->PrepareBatch(block.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
+    for (int pass = 0; pass < 2; pass++) {
+      block.ZeroMemory();
+      ColumnBlock dst_col = block.column_block(0);
+      ASSERT_OK(it->ApplyUpdates(0, &dst_col));
+
+      for (int i = 0; i < block.nrows(); i++) {
+        uint32_t row = start_row + i;
+        bool should_be_updated = (row >= FLAGS_first_row_to_update) &&
+          (row <= FLAGS_last_row_to_update) &&
+          (row % 2 == 0);
+        uint32_t expected_val = should_be_updated ? row + kMaxTimestamp : 0;
+        uint32_t updated_val = *schema_.ExtractColumnFromRow<UINT32>(block.row(i), 0);
+        if (updated_val != expected_val) {
+          FAIL() << "failed on row " << row << " (pass " << pass << ")"
+                 << ": expected " << expected_val << ", got " << updated_val;
+        }
+      }
+    }
+  }
+}
+
 TEST_F(TestDeltaFile, TestCollectMutations) {
   WriteTestFile();
 
@@ -361,6 +398,90 @@ TEST_F(TestDeltaFile, TestLazyInit) {
   ASSERT_EQ(bytes_read_after_init, bytes_read);
 }
 
+// Test that the rows deleted by a REDO file are gathered into its bitmap, and
+// that existence checks and scans see the same deleted rows with and without
+// consulting it.
+TEST_F(TestDeltaFile, TestDeletedRowBitmap) {
+  const int kNumRows = 20000;
+  const Timestamp kUpdateTs(1);
+  const Timestamp kDeleteTs(5);
+  {
+    gscoped_ptr<WritableBlock> block;
+    ASSERT_OK(fs_manager_->CreateNewBlock(&block));
+    test_block_ = block->id();
+    DeltaFileWriter dfw(std::move(block));
+    ASSERT_OK(dfw.Start());
+
+    // Update every row, then delete every third one.
+    faststring buf;
+    DeltaStats stats;
+    for (int i = 0; i < kNumRows; i++) {
+      buf.clear();
+      RowChangeListEncoder update(&buf);
+      uint32_t new_val = i;
+      update.AddColumnUpdate(schema_.column(0), schema_.column_id(0), &new_val);
+      DeltaKey update_key(i, kUpdateTs);
+      ASSERT_OK_FAST(dfw.AppendDelta<REDO>(update_key, RowChangeList(buf)));
+      ASSERT_OK_FAST(stats.UpdateStats(update_key.timestamp(), RowChangeList(buf)));
+      if (i % 3 == 0) {
+        buf.clear();
+        RowChangeListEncoder(&buf).SetToDelete();
+        DeltaKey delete_key(i, kDeleteTs);
+        ASSERT_OK_FAST(dfw.AppendDelta<REDO>(delete_key, RowChangeList(buf)));
+        ASSERT_OK_FAST(stats.UpdateStats(delete_key.timestamp(), RowChangeList(buf)));
+      }
+    }
+    ASSERT_EQ((kNumRows + 2) / 3, static_cast<int>(dfw.deleted_rows().size()));
+    dfw.WriteDeltaStats(stats);
+    ASSERT_OK(dfw.Finish());
+  }
+
+  shared_ptr<DeltaFileReader> reader;
+  ASSERT_OK(OpenDeltaFileReader(test_block_, &reader));
+  ASSERT_FALSE(reader->deleted_rows());
+
+  // The first existence check gathers the deleted rows.
+  for (int i = 0; i < kNumRows; i += 7) {
+    bool deleted;
+    ASSERT_OK(reader->CheckRowDeleted(i, &deleted));
+    ASSERT_EQ(i % 3 == 0, deleted) << "row " << i;
+  }
+  ASSERT_TRUE(reader->deleted_rows());
+  ASSERT_EQ((kNumRows + 2) / 3, reader->deleted_rows()->deleted_count());
+
+  // Scan at a snapshot which includes the deletes (served by the bitmap), and
+  // at one which doesn't (served by visiting the deltas), both with and
+  // without the bitmap enabled.
+  for (bool use_bitmap : { true, false }) {
+    FLAGS_deltafile_use_deleted_row_bitmap = use_bitmap;
+    for (const Timestamp& snap_ts : { Timestamp(kDeleteTs.value() + 1), kDeleteTs }) {
+      SCOPED_TRACE(strings::Substitute("bitmap: $0, snapshot: $1",
+                                       use_bitmap, snap_ts.ToString()));
+      bool expect_deleted = snap_ts.CompareTo(kDeleteTs) > 0;
+      DeltaIterator* raw_iter;
+      ASSERT_OK(reader->NewDeltaIterator(&schema_, MvccSnapshot(snap_ts), &raw_iter));
+      gscoped_ptr<DeltaIterator> iter(raw_iter);
+      ASSERT_OK(iter->Init(nullptr));
+      ASSERT_OK(iter->SeekToOrdinal(0));
+
+      const int kBatchSize = 1000;
+      SelectionVector sel_vec(kBatchSize);
+      for (int start_row = 0; start_row < kNumRows; start_row += kBatchSize) {
+        ASSERT_OK(iter->PrepareBatch(kBatchSize, DeltaIterator::PREPARE_FOR_APPLY));
+        sel_vec.SetAllTrue();
+        ASSERT_OK(iter->ApplyDeletes(&sel_vec));
+        for (int i = 0; i < kBatchSize; i++) {
+          int row = start_row + i;
+          bool deleted = expect_deleted && row % 3 == 0;
+          if (sel_vec.IsRowSelected(i) == deleted) {
+            FAIL() << "row " << row << ": expected deleted=" << deleted;
+          }
+        }
+      }
+    }
+  }
+}
+
 // Check that, if a delta file is opened but no deltas are written,
 // Finish() will return Status::Aborted().
 TEST_F(TestDeltaFile, TestEmptyFileIsAborted) {
@@ -18,9 +18,13 @@
 #include "kudu/tablet/deltafile.h"
 
 #include <arpa/inet.h>
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include <string>
 
+#include "kudu/common/row.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/block_encodings.h"
@@ -31,6 +35,7 @@
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/tablet/mutation.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/coding-inl.h"
 #include "kudu/util/compression/compression_codec.h"
 #include "kudu/util/flag_tags.h"
@@ -48,6 +53,13 @@ DEFINE_string(deltafile_default_compression_codec, "lz4",
               "The compression codec used when writing deltafiles.");
 TAG_FLAG(deltafile_default_compression_codec, experimental);
 
+DEFINE_bool(deltafile_use_deleted_row_bitmap, true,
+            "Whether to keep a bitmap of the rows deleted by each REDO delta file "
+            "and consult it when checking whether a row is deleted and when "
+            "filtering deleted rows out of scans, instead of visiting the deltas.");
+TAG_FLAG(deltafile_use_deleted_row_bitmap, advanced);
+TAG_FLAG(deltafile_use_deleted_row_bitmap, runtime);
+
 using std::shared_ptr;
 using std::unique_ptr;
 
@@ -134,6 +146,9 @@ Status DeltaFileWriter::AppendDelta<REDO>(
   last_key_ = key;
 #endif
 
+  if (delta.is_delete()) {
+    deleted_rows_.push_back(key.row_idx());
+  }
   return DoAppendDelta(key, delta);
 }
 
@@ -166,6 +181,38 @@ void DeltaFileWriter::WriteDeltaStats(const DeltaStats& stats) {
 }
 
 
+////////////////////////////////////////////////////////////
+// DeletedRowBitmap
+////////////////////////////////////////////////////////////
+
+DeletedRowBitmap::DeletedRowBitmap(const vector<rowid_t>& rows)
+    : num_rows_(rows.empty() ? 0 : rows.back() + 1),
+      deleted_count_(rows.size()) {
+  DCHECK(std::is_sorted(rows.begin(), rows.end()));
+  bitmap_.resize(BitmapSize(num_rows_));
+  memset(bitmap_.data(), 0, bitmap_.size());
+  for (rowid_t row_idx : rows) {
+    BitmapSet(bitmap_.data(), row_idx);
+  }
+}
+
+bool DeletedRowBitmap::IsDeleted(rowid_t row_idx) const {
+  return row_idx < num_rows_ && BitmapTest(bitmap_.data(), row_idx);
+}
+
+void DeletedRowBitmap::ApplyTo(rowid_t start_row, size_t nrows,
+                               SelectionVector* sel_vec) const {
+  if (start_row >= num_rows_) {
+    return;
+  }
+  size_t end_row = std::min<size_t>(start_row + nrows, num_rows_);
+  size_t row_idx = start_row;
+  while (BitmapFindFirstSet(bitmap_.data(), row_idx, end_row, &row_idx)) {
+    sel_vec->SetRowUnselected(row_idx - start_row);
+    row_idx++;
+  }
+}
+
 ////////////////////////////////////////////////////////////
 // Reader
 ////////////////////////////////////////////////////////////
@@ -296,6 +343,54 @@ Status DeltaFileReader::NewDeltaIterator(const Schema *projection,
   }
 }
 
+shared_ptr<const DeletedRowBitmap> DeltaFileReader::deleted_rows() const {
+  std::lock_guard<simple_spinlock> l(deleted_rows_lock_);
+  return deleted_rows_;
+}
+
+void DeltaFileReader::set_deleted_rows(shared_ptr<const DeletedRowBitmap> deleted_rows) {
+  DCHECK_EQ(REDO, delta_type_);
+  std::lock_guard<simple_spinlock> l(deleted_rows_lock_);
+  deleted_rows_ = std::move(deleted_rows);
+}
+
+Status DeltaFileReader::BuildDeletedRows() {
+  MutexLock l(build_deleted_rows_lock_);
+  if (deleted_rows()) {
+    return Status::OK();
+  }
+
+  MvccSnapshot snap_all(MvccSnapshot::CreateSnapshotIncludingAllTransactions());
+  Schema empty_schema;
+  DeltaIterator* raw_iter;
+  RETURN_NOT_OK(NewDeltaIterator(&empty_schema, snap_all, &raw_iter));
+  gscoped_ptr<DeltaIterator> iter(raw_iter);
+
+  // The iterator is created before 'deleted_rows_' is set, so it visits the
+  // deltas rather than consulting the bitmap being built.
+  const size_t kBatchSize = 8192;
+  vector<rowid_t> rows;
+  SelectionVector sel_vec(kBatchSize);
+  ScanSpec spec;
+  RETURN_NOT_OK(iter->Init(&spec));
+  RETURN_NOT_OK(iter->SeekToOrdinal(0));
+  for (rowid_t start_row = 0; iter->HasNext(); start_row += kBatchSize) {
+    RETURN_NOT_OK(iter->PrepareBatch(kBatchSize, DeltaIterator::PREPARE_FOR_APPLY));
+    sel_vec.SetAllTrue();
+    RETURN_NOT_OK(iter->ApplyDeletes(&sel_vec));
+    size_t i = 0;
+    while (BitmapFindFirstZero(sel_vec.bitmap(), i, kBatchSize, &i)) {
+      rows.push_back(start_row + i);
+      i++;
+    }
+  }
+  DCHECK_EQ(delta_stats().delete_count(), static_cast<int64_t>(rows.size()));
+
+  VLOG(1) << "Gathered " << rows.size() << " deleted rows from " << ToString();
+  set_deleted_rows(std::make_shared<DeletedRowBitmap>(rows));
+  return Status::OK();
+}
+
 Status DeltaFileReader::CheckRowDeleted(rowid_t row_idx, bool *deleted) const {
   RETURN_NOT_OK(const_cast<DeltaFileReader*>(this)->Init());
 
@@ -306,6 +401,16 @@ Status DeltaFileReader::CheckRowDeleted(rowid_t row_idx, bool *deleted) const {
     return Status::OK();
   }
 
+  if (delta_type_ == REDO && FLAGS_deltafile_use_deleted_row_bitmap) {
+    shared_ptr<const DeletedRowBitmap> deleted_rows = this->deleted_rows();
+    if (!deleted_rows) {
+      RETURN_NOT_OK(const_cast<DeltaFileReader*>(this)->BuildDeletedRows());
+      deleted_rows = this->deleted_rows();
+    }
+    *deleted = deleted_rows->IsDeleted(row_idx);
+    return Status::OK();
+  }
+
   MvccSnapshot snap_all(MvccSnapshot::CreateSnapshotIncludingAllTransactions());
 
   // TODO: would be nice to avoid allocation here, but we don't want to
@@ -356,6 +461,7 @@ DeltaFileIterator::DeltaFileIterator(shared_ptr<DeltaFileReader> dfr,
       prepared_(false),
       exhausted_(false),
       initted_(false),
+      updates_decoded_(false),
       delta_type_(delta_type),
       cache_blocks_(CFileReader::CACHE_BLOCK) {}
 
@@ -381,16 +487,31 @@ Status DeltaFileIterator::SeekToOrdinal(rowid_t idx) {
   // that we are querying. We did this already before creating the
   // DeltaFileIterator, but due to lazy initialization, it's possible
   // that we weren't able to check at that time.
+  updates_decoded_ = false;
   if (!dfr_->IsRelevantForSnapshot(mvcc_snap_)) {
     exhausted_ = true;
     delta_blocks_.clear();
     return Status::OK();
   }
 
+  // If every delta of the file is committed in our snapshot, so is every
+  // delete, and the deleted rows can be read off the file's bitmap.
+  deleted_rows_.reset();
+  if (delta_type_ == REDO &&
+      FLAGS_deltafile_use_deleted_row_bitmap &&
+      !mvcc_snap_.MayHaveUncommittedTransactionsAtOrBefore(
+          dfr_->delta_stats().max_timestamp())) {
+    deleted_rows_ = dfr_->deleted_rows();
+  }
+
   if (!index_iter_) {
+    const cfile::PinnedIndexBlocks* pinned;
+    RETURN_NOT_OK(dfr_->cfile_reader()->GetPinnedValIdxBlocks(&pinned));
     index_iter_.reset(IndexTreeIterator::Create(
         dfr_->cfile_reader().get(),
-        dfr_->cfile_reader()->validx_root()));
+        dfr_->cfile_reader()->validx_root(),
+        cache_blocks_ == CFileReader::CACHE_BLOCK,
+        pinned));
   }
 
   tmp_buf_.clear();
@@ -528,6 +649,7 @@ Status DeltaFileIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   prepared_idx_ = start_row;
   prepared_count_ = nrows;
   prepared_ = true;
+  updates_decoded_ = false;
   return Status::OK();
 }
 
@@ -625,70 +747,118 @@ inline bool IsUndoRelevant(const MvccSnapshot& snap,
   return true;
 }
 
+// Visitor which decodes each relevant update or reinsert and appends its
+// column updates to the per-column arrays of the iterator. See DecodeUpdates().
 template<DeltaType Type>
-struct ApplyingVisitor {
+struct DecodingVisitor {
 
   Status Visit(const DeltaKey &key, const Slice &deltas, bool* continue_visit);
 
-  inline Status ApplyMutation(const DeltaKey &key, const Slice &deltas) {
+  inline Status DecodeMutation(const DeltaKey &key, const Slice &deltas) {
     int64_t rel_idx = key.row_idx() - dfi->prepared_idx_;
     DCHECK_GE(rel_idx, 0);
 
-    // TODO: this code looks eerily similar to DMSIterator::ApplyUpdates!
-    // I bet it can be combined.
-
     const Schema* schema = dfi->projection_;
     RowChangeListDecoder decoder((RowChangeList(deltas)));
     RETURN_NOT_OK(decoder.Init());
-    if (decoder.is_update() || decoder.is_reinsert()) {
-      return decoder.ApplyToOneColumn(rel_idx, dst, *schema, col_to_apply, dst->arena());
+    if (!decoder.is_update() && !decoder.is_reinsert()) {
+      DCHECK(decoder.is_delete());
+      // If it's a DELETE, then it will be processed by LivenessVisitor.
+      return Status::OK();
     }
 
-    DCHECK(decoder.is_delete());
-    // If it's a DELETE, then it will be processed by LivenessVisitor.
+    while (decoder.HasNext()) {
+      RowChangeListDecoder::DecodedUpdate dec;
+      RETURN_NOT_OK(decoder.DecodeNext(&dec));
+      int col_idx;
+      const void* unused;
+      RETURN_NOT_OK(dec.Validate(*schema, &col_idx, &unused));
+      if (col_idx == Schema::kColumnNotFound) {
+        continue;
+      }
+      dfi->decoded_updates_[col_idx].push_back(
+          { static_cast<rowid_t>(rel_idx), dec.null, dec.raw_value });
+    }
     return Status::OK();
   }
 
   DeltaFileIterator *dfi;
-  size_t col_to_apply;
-  ColumnBlock *dst;
 };
 
 template<>
-inline Status ApplyingVisitor<REDO>::Visit(const DeltaKey& key,
+inline Status DecodingVisitor<REDO>::Visit(const DeltaKey& key,
                                            const Slice& deltas,
                                            bool* continue_visit) {
   if (IsRedoRelevant(dfi->mvcc_snap_, key.timestamp(), continue_visit)) {
-    DVLOG(3) << "Applied redo delta";
-    return ApplyMutation(key, deltas);
+    DVLOG(3) << "Decoded redo delta";
+    return DecodeMutation(key, deltas);
   }
-  DVLOG(3) << "Redo delta uncommitted, skipped applying.";
+  DVLOG(3) << "Redo delta uncommitted, skipped decoding.";
   return Status::OK();
 }
 
 template<>
-inline Status ApplyingVisitor<UNDO>::Visit(const DeltaKey& key,
+inline Status DecodingVisitor<UNDO>::Visit(const DeltaKey& key,
                                            const Slice& deltas,
                                            bool* continue_visit) {
   if (IsUndoRelevant(dfi->mvcc_snap_, key.timestamp(), continue_visit)) {
-    DVLOG(3) << "Applied undo delta";
-    return ApplyMutation(key, deltas);
+    DVLOG(3) << "Decoded undo delta";
+    return DecodeMutation(key, deltas);
+  }
+  DVLOG(3) << "Undo delta committed, skipped decoding.";
+  return Status::OK();
+}
+
+Status DeltaFileIterator::DecodeUpdates() {
+  decoded_updates_.resize(projection_->num_columns());
+  for (auto& updates : decoded_updates_) {
+    updates.clear();
+  }
+
+  if (delta_type_ == REDO) {
+    DecodingVisitor<REDO> visitor = { this };
+    RETURN_NOT_OK(VisitMutations(&visitor));
+  } else {
+    DecodingVisitor<UNDO> visitor = { this };
+    RETURN_NOT_OK(VisitMutations(&visitor));
   }
-  DVLOG(3) << "Undo delta committed, skipped applying.";
+  updates_decoded_ = true;
   return Status::OK();
 }
 
 Status DeltaFileIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
   DCHECK_LE(prepared_count_, dst->nrows());
 
-  if (delta_type_ == REDO) {
-    DVLOG(3) << "Applying REDO mutations to " << col_to_apply;
-    ApplyingVisitor<REDO> visitor = {this, col_to_apply, dst};
-    return VisitMutations(&visitor);
+  if (!updates_decoded_) {
+    RETURN_NOT_OK(DecodeUpdates());
   }
-  DVLOG(3) << "Applying UNDO mutations to " << col_to_apply;
-  ApplyingVisitor<UNDO> visitor = {this, col_to_apply, dst};
-  return VisitMutations(&visitor);
+  const vector<DecodedColumnUpdate>& updates = decoded_updates_[col_to_apply];
+  DVLOG(3) << "Applying " << updates.size() << " "
+           << (delta_type_ == REDO ? "REDO" : "UNDO") << " updates to " << col_to_apply;
+
+  // Updates are applied in mutation order, so the last one to a row wins.
+  const ColumnSchema& col_schema = projection_->column(col_to_apply);
+  if (col_schema.type_info()->physical_type() == BINARY) {
+    for (const DecodedColumnUpdate& u : updates) {
+      SimpleConstCell src(&col_schema, u.null ? nullptr : &u.raw_value);
+      ColumnBlock::Cell dst_cell = dst->cell(u.rel_idx);
+      RETURN_NOT_OK(CopyCell(src, &dst_cell, dst->arena()));
+    }
+    return Status::OK();
+  }
+
+  const bool nullable = dst->is_nullable();
+  for (const DecodedColumnUpdate& u : updates) {
+    if (u.null) {
+      dst->SetCellIsNull(u.rel_idx, true);
+      continue;
+    }
+    dst->SetCellValue(u.rel_idx, u.raw_value.data());
+    if (nullable) {
+      dst->SetCellIsNull(u.rel_idx, false);
+    }
+  }
+  return Status::OK();
 }
 
 // Visitor which establishes the liveness of a row by applying deletes and reinserts.
@@ -752,6 +922,16 @@ inline Status LivenessVisitor<UNDO>::Visit(const DeltaKey& key,
 Status DeltaFileIterator::ApplyDeletes(SelectionVector *sel_vec) {
   DCHECK_LE(prepared_count_, sel_vec->nrows());
   if (delta_type_ == REDO) {
+    // REDO files hold only updates and deletes, so without deletes there's
+    // nothing to unselect.
+    if (dfr_->delta_stats().delete_count() == 0) {
+      return Status::OK();
+    }
+    if (deleted_rows_) {
+      DVLOG(3) << "Applying REDO deletes from bitmap";
+      deleted_rows_->ApplyTo(prepared_idx_, prepared_count_, sel_vec);
+      return Status::OK();
+    }
     DVLOG(3) << "Applying REDO deletes";
     LivenessVisitor<REDO> visitor = { this, sel_vec };
     return VisitMutations(&visitor);
@@ -34,11 +34,15 @@
 #include "kudu/tablet/deltamemstore.h"
 #include "kudu/tablet/delta_key.h"
 #include "kudu/tablet/tablet.pb.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/once.h"
 
 namespace kudu {
 
 class ScanSpec;
+class SelectionVector;
 
 namespace cfile {
 class BinaryPlainBlockDecoder;
@@ -49,7 +53,7 @@ namespace tablet {
 class DeltaFileIterator;
 class DeltaKey;
 template<DeltaType Type>
-struct ApplyingVisitor;
+struct DecodingVisitor;
 template<DeltaType Type>
 struct CollectingVisitor;
 template<DeltaType Type>
@@ -82,6 +86,11 @@ class DeltaFileWriter {
 
   void WriteDeltaStats(const DeltaStats& stats);
 
+  // The rows deleted by the REDO deltas appended so far, in ascending order.
+  const std::vector<rowid_t>& deleted_rows() const {
+    return deleted_rows_;
+  }
+
  private:
   Status DoAppendDelta(const DeltaKey &key, const RowChangeList &delta);
 
@@ -91,6 +100,9 @@ class DeltaFileWriter {
   // of the deltas
   faststring tmp_buf_;
 
+  // See deleted_rows().
+  std::vector<rowid_t> deleted_rows_;
+
   #ifndef NDEBUG
   // The index of the previously written row.
   // This is used in debug mode to make sure that rows are appended
@@ -102,6 +114,35 @@ class DeltaFileWriter {
   DISALLOW_COPY_AND_ASSIGN(DeltaFileWriter);
 };
 
+// The set of rows deleted by the REDO deltas of a delta file.
+//
+// A row of a DiskRowSet which has been deleted is never reinserted into the
+// same rowset (a reinsert goes to the MemRowSet), so once the delete is
+// visible to a snapshot the row stays deleted for any later snapshot.
+class DeletedRowBitmap {
+ public:
+  // 'rows' must be sorted in ascending order.
+  explicit DeletedRowBitmap(const std::vector<rowid_t>& rows);
+
+  bool IsDeleted(rowid_t row_idx) const;
+
+  // Unselect in 'sel_vec' the deleted rows among the 'nrows' rows starting
+  // at 'start_row'.
+  void ApplyTo(rowid_t start_row, size_t nrows, SelectionVector* sel_vec) const;
+
+  int64_t deleted_count() const { return deleted_count_; }
+
+  size_t memory_footprint() const { return bitmap_.capacity(); }
+
+ private:
+  // The number of rows covered by 'bitmap_': one past the last deleted row.
+  rowid_t num_rows_;
+  int64_t deleted_count_;
+  faststring bitmap_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeletedRowBitmap);
+};
+
 class DeltaFileReader : public DeltaStore,
                         public std::enable_shared_from_this<DeltaFileReader> {
  public:
@@ -157,6 +198,14 @@ class DeltaFileReader : public DeltaStore,
   // been fully initialized.
   bool IsRelevantForSnapshot(const MvccSnapshot& snap) const;
 
+  // Returns the rows deleted by this REDO delta file, or null if they have
+  // not been gathered yet. They are gathered by the first CheckRowDeleted()
+  // which needs them, or handed over by set_deleted_rows() when the file is
+  // written from a flushed DeltaMemStore.
+  std::shared_ptr<const DeletedRowBitmap> deleted_rows() const;
+
+  void set_deleted_rows(std::shared_ptr<const DeletedRowBitmap> deleted_rows);
+
  private:
   friend class DeltaFileIterator;
 
@@ -174,6 +223,10 @@ class DeltaFileReader : public DeltaStore,
 
   Status ReadDeltaStats();
 
+  // Read the whole file and gather the rows deleted by its deltas into
+  // 'deleted_rows_', unless another thread already did so.
+  Status BuildDeletedRows();
+
   std::shared_ptr<cfile::CFileReader> reader_;
   gscoped_ptr<DeltaStats> delta_stats_;
 
@@ -181,6 +234,13 @@ class DeltaFileReader : public DeltaStore,
   const DeltaType delta_type_;
 
   KuduOnceDynamic init_once_;
+
+  // Protects 'deleted_rows_'.
+  mutable simple_spinlock deleted_rows_lock_;
+  std::shared_ptr<const DeletedRowBitmap> deleted_rows_;
+
+  // Serializes BuildDeletedRows() so the file is read at most once.
+  Mutex build_deleted_rows_lock_;
 };
 
 // Iterator over the deltas contained in a delta file.
@@ -204,8 +264,8 @@ class DeltaFileIterator : public DeltaIterator {
 
  private:
   friend class DeltaFileReader;
-  friend struct ApplyingVisitor<REDO>;
-  friend struct ApplyingVisitor<UNDO>;
+  friend struct DecodingVisitor<REDO>;
+  friend struct DecodingVisitor<UNDO>;
   friend struct CollectingVisitor<REDO>;
   friend struct CollectingVisitor<UNDO>;
   friend struct LivenessVisitor<REDO>;
@@ -250,6 +310,19 @@ class DeltaFileIterator : public DeltaIterator {
     string ToString() const;
   };
 
+  // A single column update from the prepared batch, decoded by DecodeUpdates().
+  struct DecodedColumnUpdate {
+    // The index of the updated row, relative to prepared_idx_.
+    rowid_t rel_idx;
+
+    // If true, the update sets the cell to NULL.
+    bool null;
+
+    // The new value of the cell, pointing into the pinned delta block data.
+    // Only relevant if 'null' is false.
+    Slice raw_value;
+  };
+
 
   // The passed 'projection' and 'dfr' must remain valid for the lifetime
   // of the iterator.
@@ -274,6 +347,12 @@ class DeltaFileIterator : public DeltaIterator {
   template<class Visitor>
   Status VisitMutations(Visitor *visitor);
 
+  // Decode the relevant updates of the currently prepared row range once,
+  // splitting them into decoded_updates_ by projected column so that
+  // ApplyUpdates() doesn't have to re-decode every RowChangeList for each
+  // column it is called on.
+  Status DecodeUpdates();
+
   // Log a FATAL error message about a bad delta.
   void FatalUnexpectedDelta(const DeltaKey &key, const Slice &deltas, const string &msg);
 
@@ -298,6 +377,18 @@ class DeltaFileIterator : public DeltaIterator {
   // which correspond to prepared_block_.
   std::deque<std::unique_ptr<PreparedDeltaBlock>> delta_blocks_;
 
+  // The rows deleted by the deltas of a REDO file, if they had been gathered
+  // by the time of SeekToOrdinal() and every delta of the file is committed
+  // in 'mvcc_snap_'. In that case ApplyDeletes() consults the bitmap instead
+  // of visiting the prepared deltas.
+  std::shared_ptr<const DeletedRowBitmap> deleted_rows_;
+
+  // The updates of the prepared batch, indexed by projected column and kept in
+  // mutation order. Only valid if 'updates_decoded_' is true; reset by
+  // PrepareBatch() and SeekToOrdinal(). The vectors are reused across batches.
+  std::vector<std::vector<DecodedColumnUpdate>> decoded_updates_;
+  bool updates_decoded_;
+
   // Temporary buffer used in seeking.
   faststring tmp_buf_;
 
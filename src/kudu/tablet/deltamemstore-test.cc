@@ -25,6 +25,7 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/server/logical_clock.h"
 #include "kudu/tablet/deltamemstore.h"
 #include "kudu/tablet/deltafile.h"
@@ -36,8 +37,11 @@
 
 DEFINE_int32(benchmark_num_passes, 100, "Number of passes to apply deltas in the benchmark");
 
+DECLARE_bool(dms_columnar_updates);
+
 using std::shared_ptr;
 using std::unordered_set;
+using strings::Substitute;
 
 namespace kudu {
 namespace tablet {
@@ -505,5 +509,103 @@ TEST_F(TestDeltaMemStore, TestCollectMutations) {
   }
 }
 
+// Test that a DMS which indexes its updates by column applies the same
+// updates and deletes as the tree, and that the tree iterator still
+// collects mutations after batches were prepared from the index.
+TEST_F(TestDeltaMemStore, TestColumnarUpdates) {
+  FLAGS_dms_columnar_updates = true;
+  ASSERT_OK(DeltaMemStore::Create(0, 0, new log::LogAnchorRegistry(),
+                                  MemTracker::GetRootTracker(), &dms_));
+  ASSERT_OK(dms_->Init());
+  ASSERT_TRUE(dms_->columnar());
+
+  // Update the ints of rows 0-19, and then the strings of the even rows.
+  vector<uint32_t> to_update;
+  for (uint32_t i = 0; i < 20; i++) {
+    to_update.push_back(i);
+  }
+  UpdateIntsAtIndexes(to_update);
+  MvccSnapshot snap_after_ints(mvcc_);
+
+  faststring update_buf;
+  RowChangeListEncoder update(&update_buf);
+  for (uint32_t i = 0; i < 20; i += 2) {
+    ScopedTransaction tx(&mvcc_, clock_->Now());
+    tx.StartApplying();
+    update.Reset();
+    string str = Substitute("hello $0", i);
+    Slice s(str);
+    update.AddColumnUpdate(schema_.column(kStringColumn),
+                           schema_.column_id(kStringColumn), &s);
+    ASSERT_OK(dms_->Update(tx.timestamp(), i, RowChangeList(update_buf), op_id_));
+    tx.Commit();
+  }
+
+  // Delete row 7.
+  {
+    ScopedTransaction tx(&mvcc_, clock_->Now());
+    tx.StartApplying();
+    update.Reset();
+    update.SetToDelete();
+    ASSERT_OK(dms_->Update(tx.timestamp(), 7, RowChangeList(update_buf), op_id_));
+    tx.Commit();
+  }
+  MvccSnapshot snap_all(mvcc_);
+  ASSERT_EQ(31, dms_->Count());
+
+  bool deleted;
+  ASSERT_OK(dms_->CheckRowDeleted(7, &deleted));
+  ASSERT_TRUE(deleted);
+  ASSERT_OK(dms_->CheckRowDeleted(8, &deleted));
+  ASSERT_FALSE(deleted);
+
+  // The strings aren't visible in the older snapshot.
+  ScopedColumnBlock<STRING> strings(10);
+  for (int i = 0; i < strings.nrows(); i++) {
+    strings[i] = Slice("original");
+  }
+  ApplyUpdates(snap_after_ints, 5, kStringColumn, &strings);
+  for (int i = 0; i < strings.nrows(); i++) {
+    ASSERT_EQ("original", strings[i].ToString());
+  }
+  ApplyUpdates(snap_all, 5, kStringColumn, &strings);
+  for (int i = 0; i < strings.nrows(); i++) {
+    int row = 5 + i;
+    ASSERT_EQ(row % 2 == 0 ? Substitute("hello $0", row) : "original",
+              strings[i].ToString()) << "at row " << row;
+  }
+
+  DeltaIterator* raw_iter;
+  ASSERT_OK(dms_->NewDeltaIterator(&schema_, snap_all, &raw_iter));
+  gscoped_ptr<DeltaIterator> iter(raw_iter);
+  ASSERT_OK(iter->Init(nullptr));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+
+  ScopedColumnBlock<UINT32> ints(10);
+  SelectionVector sel(10);
+  sel.SetAllTrue();
+  ASSERT_OK(iter->PrepareBatch(10, DeltaIterator::PREPARE_FOR_APPLY));
+  ASSERT_OK(iter->ApplyUpdates(kIntColumn, &ints));
+  ASSERT_OK(iter->ApplyDeletes(&sel));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(i * 10, ints[i]);
+    ASSERT_EQ(i != 7, sel.IsRowSelected(i)) << "at row " << i;
+  }
+
+  // Collect the mutations of the next batch from the tree.
+  Arena arena(1024, 1024);
+  vector<Mutation*> mutations(10);
+  ASSERT_OK(iter->PrepareBatch(10, DeltaIterator::PREPARE_FOR_COLLECT));
+  ASSERT_OK(iter->CollectMutations(&mutations, &arena));
+  for (int i = 0; i < 10; i++) {
+    int row = 10 + i;
+    string str = Mutation::StringifyMutationList(schema_, mutations[i]);
+    ASSERT_STR_CONTAINS(str, Substitute("SET col3=$0", row * 10));
+    if (row % 2 == 0) {
+      ASSERT_STR_CONTAINS(str, Substitute("hello $0", row));
+    }
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -15,24 +15,39 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
+#include <mutex>
 #include <utility>
 
 #include "kudu/consensus/consensus.pb.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/tablet/deltafile.h"
 #include "kudu/tablet/deltamemstore.h"
 #include "kudu/tablet/delta_tracker.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/tablet.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/status.h"
 
+DEFINE_bool(dms_columnar_updates, false,
+            "Whether new delta memstores also index their updates by column, so "
+            "that scans apply the updates of only the projected columns rather "
+            "than decoding every change list. Uses more memory per update.");
+TAG_FLAG(dms_columnar_updates, experimental);
+TAG_FLAG(dms_columnar_updates, runtime);
+
+DECLARE_bool(memstore_per_cpu_arenas);
+
 namespace kudu {
 namespace tablet {
 
 using log::LogAnchorRegistry;
 using std::shared_ptr;
+using std::vector;
 using strings::Substitute;
 
 ////////////////////////////////////////////////////////////
@@ -42,6 +57,10 @@ using strings::Substitute;
 static const int kInitialArenaSize = 16;
 static const int kMaxArenaBufferSize = 5*1024*1024;
 
+// Approximate size of a node of a std::map or std::set, beyond its value:
+// three pointers and the color.
+static const int kTreeNodeOverhead = 4 * sizeof(void*);
+
 Status DeltaMemStore::Create(int64_t id,
                              int64_t rs_id,
                              LogAnchorRegistry* log_anchor_registry,
@@ -62,13 +81,18 @@ DeltaMemStore::DeltaMemStore(int64_t id,
   : id_(id),
     rs_id_(rs_id),
     allocator_(new MemoryTrackingBufferAllocator(
-        HeapBufferAllocator::Get(), std::move(parent_tracker))),
-    arena_(new ThreadSafeMemoryTrackingArena(
-        kInitialArenaSize, kMaxArenaBufferSize, allocator_)),
+        DefaultArenaBufferAllocator(), std::move(parent_tracker))),
+    arena_(new ShardedMemoryTrackingArena(
+        kInitialArenaSize, kMaxArenaBufferSize, allocator_,
+        FLAGS_memstore_per_cpu_arenas ? base::NumCPUs() : 1)),
     tree_(arena_),
     anchorer_(log_anchor_registry,
               Substitute("Rowset-$0/DeltaMemStore-$1", rs_id_, id_)),
-    disambiguator_sequence_number_(0) {
+    disambiguator_sequence_number_(0),
+    has_deletes_or_reinserts_(false),
+    columnar_(FLAGS_dms_columnar_updates),
+    columnar_seq_(0),
+    columnar_bytes_(0) {
 }
 
 Status DeltaMemStore::Init() {
@@ -81,6 +105,22 @@ Status DeltaMemStore::Update(Timestamp timestamp,
                              const consensus::OpId& op_id) {
   DeltaKey key(row_idx, timestamp);
 
+  if (update.is_delete() || update.is_reinsert()) {
+    has_deletes_or_reinserts_.Store(true);
+  }
+
+  // Decode the updates up front, so that a malformed change list fails
+  // before anything has been inserted.
+  vector<RowChangeListDecoder::DecodedUpdate> decoded;
+  if (columnar_ && update.is_update()) {
+    RowChangeListDecoder decoder(update);
+    RETURN_NOT_OK(decoder.Init());
+    while (decoder.HasNext()) {
+      decoded.emplace_back();
+      RETURN_NOT_OK(decoder.DecodeNext(&decoded.back()));
+    }
+  }
+
   faststring buf;
 
   key.EncodeTo(&buf);
@@ -104,11 +144,50 @@ Status DeltaMemStore::Update(Timestamp timestamp,
     return Status::IOError("Unable to insert into tree");
   }
 
+  if (columnar_) {
+    DCHECK(!update.is_reinsert()) << "Reinserts are not supported in the DeltaMemStore.";
+    IndexColumnar(timestamp, row_idx, update.is_delete(), decoded);
+  }
+
   anchorer_.AnchorIfMinimum(op_id.index());
 
   return Status::OK();
 }
 
+void DeltaMemStore::IndexColumnar(Timestamp timestamp, rowid_t row_idx, bool is_delete,
+                                  const vector<RowChangeListDecoder::DecodedUpdate>& updates) {
+  // Copy the values into the arena before taking the lock.
+  vector<Slice> values;
+  values.reserve(updates.size());
+  for (const auto& u : updates) {
+    if (u.null || u.raw_value.empty()) {
+      values.emplace_back();
+    } else {
+      values.emplace_back(arena_->AddSlice(u.raw_value), u.raw_value.size());
+    }
+  }
+
+  int64_t bytes = 0;
+  {
+    std::lock_guard<rw_spinlock> l(columnar_lock_);
+    ColumnarKey key(row_idx, timestamp.ToUint64(), columnar_seq_++);
+    if (is_delete) {
+      deletes_.insert(key);
+      bytes += sizeof(ColumnarKey) + kTreeNodeOverhead;
+    }
+    for (int i = 0; i < updates.size(); i++) {
+      ColumnUpdates& col_updates =
+          LookupOrInsert(&updates_by_col_id_, updates[i].col_id, ColumnUpdates());
+      RowChangeListDecoder::DecodedUpdate& dst = col_updates[key];
+      dst.col_id = updates[i].col_id;
+      dst.null = updates[i].null;
+      dst.raw_value = values[i];
+      bytes += sizeof(ColumnUpdates::value_type) + kTreeNodeOverhead;
+    }
+  }
+  columnar_bytes_.IncrementBy(bytes);
+}
+
 Status DeltaMemStore::FlushToFile(DeltaFileWriter *dfw,
                                   gscoped_ptr<DeltaStats>* stats_ret) {
   gscoped_ptr<DeltaStats> stats(new DeltaStats());
@@ -141,6 +220,14 @@ Status DeltaMemStore::NewDeltaIterator(const Schema *projection,
 Status DeltaMemStore::CheckRowDeleted(rowid_t row_idx, bool *deleted) const {
   *deleted = false;
 
+  if (columnar_) {
+    // The DMS holds no reinserts, so any delete of the row deletes it.
+    shared_lock<rw_spinlock> l(columnar_lock_);
+    auto it = deletes_.lower_bound(ColumnarKey(row_idx, 0, 0));
+    *deleted = it != deletes_.end() && std::get<0>(*it) == row_idx;
+    return Status::OK();
+  }
+
   DeltaKey key(row_idx, Timestamp(0));
   faststring buf;
   key.EncodeTo(&buf);
@@ -192,7 +279,8 @@ DMSIterator::DMSIterator(const shared_ptr<const DeltaMemStore>& dms,
       prepared_count_(0),
       prepared_for_(NOT_PREPARED),
       seeked_(false),
-      projection_(projection) {}
+      projection_(projection),
+      tree_seek_pending_(false) {}
 
 Status DMSIterator::Init(ScanSpec *spec) {
   initted_ = true;
@@ -210,6 +298,7 @@ Status DMSIterator::SeekToOrdinal(rowid_t row_idx) {
   prepared_count_ = 0;
   prepared_for_ = NOT_PREPARED;
   seeked_ = true;
+  tree_seek_pending_ = false;
   return Status::OK();
 }
 
@@ -239,6 +328,23 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   deleted_.clear();
   prepared_deltas_.clear();
 
+  if (flag == PREPARE_FOR_APPLY && dms_->columnar()) {
+    RETURN_NOT_OK(PrepareColumnarBatch(start_row, stop_row));
+    tree_seek_pending_ = true;
+    prepared_idx_ = start_row;
+    prepared_count_ = nrows;
+    prepared_for_ = PREPARED_FOR_APPLY;
+    return Status::OK();
+  }
+
+  if (tree_seek_pending_) {
+    faststring buf;
+    DeltaKey(start_row, Timestamp(0)).EncodeTo(&buf);
+    bool exact; /* unused */
+    iter_->SeekAtOrAfter(Slice(buf), &exact);
+    tree_seek_pending_ = false;
+  }
+
   while (iter_->IsValid()) {
     Slice key_slice, val;
     iter_->GetCurrentEntry(&key_slice, &val);
@@ -272,25 +378,7 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
             // This column isn't being projected.
             continue;
           }
-          int col_size = projection_->column(col_idx).type_info()->size();
-
-          // If we already have an earlier update for the same column, we can
-          // just overwrite that one.
-          if (updates_by_col_[col_idx].empty() ||
-              updates_by_col_[col_idx].back().row_id != key.row_idx()) {
-            updates_by_col_[col_idx].push_back(ColumnUpdate());
-          }
-
-          ColumnUpdate& cu = updates_by_col_[col_idx].back();
-          cu.row_id = key.row_idx();
-          if (col_val == nullptr) {
-            cu.new_val_ptr = nullptr;
-          } else {
-            memcpy(cu.new_val_buf, col_val, col_size);
-            // NOTE: we're constructing a pointer here to an element inside the deque.
-            // This is safe because deques never invalidate pointers to their elements.
-            cu.new_val_ptr = cu.new_val_buf;
-          }
+          AddColumnUpdate(col_idx, key.row_idx(), col_val);
         }
       }
     } else {
@@ -309,6 +397,64 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   return Status::OK();
 }
 
+void DMSIterator::AddColumnUpdate(int col_idx, rowid_t row_idx, const void* col_val) {
+  int col_size = projection_->column(col_idx).type_info()->size();
+
+  // If we already have an earlier update for the same column, we can
+  // just overwrite that one.
+  if (updates_by_col_[col_idx].empty() ||
+      updates_by_col_[col_idx].back().row_id != row_idx) {
+    updates_by_col_[col_idx].push_back(ColumnUpdate());
+  }
+
+  ColumnUpdate& cu = updates_by_col_[col_idx].back();
+  cu.row_id = row_idx;
+  if (col_val == nullptr) {
+    cu.new_val_ptr = nullptr;
+  } else {
+    memcpy(cu.new_val_buf, col_val, col_size);
+    // NOTE: we're constructing a pointer here to an element inside the deque.
+    // This is safe because deques never invalidate pointers to their elements.
+    cu.new_val_ptr = cu.new_val_buf;
+  }
+}
+
+Status DMSIterator::PrepareColumnarBatch(rowid_t start_row, rowid_t stop_row) {
+  const DeltaMemStore::ColumnarKey start_key(start_row, 0, 0);
+  shared_lock<rw_spinlock> l(dms_->columnar_lock_);
+
+  for (int i = 0; i < projection_->num_columns(); i++) {
+    const DeltaMemStore::ColumnUpdates* updates =
+        FindOrNull(dms_->updates_by_col_id_, projection_->column_id(i));
+    if (updates == nullptr) {
+      continue;
+    }
+    // The updates are ordered by row and then timestamp, so later updates
+    // of a row overwrite the earlier ones, as they do in the tree.
+    for (auto it = updates->lower_bound(start_key);
+         it != updates->end() && std::get<0>(it->first) <= stop_row;
+         ++it) {
+      if (!mvcc_snapshot_.IsCommitted(Timestamp(std::get<1>(it->first)))) {
+        continue;
+      }
+      int col_idx;
+      const void* col_val;
+      RETURN_NOT_OK(it->second.Validate(*projection_, &col_idx, &col_val));
+      DCHECK_EQ(i, col_idx);
+      AddColumnUpdate(col_idx, std::get<0>(it->first), col_val);
+    }
+  }
+
+  for (auto it = dms_->deletes_.lower_bound(start_key);
+       it != dms_->deletes_.end() && std::get<0>(*it) <= stop_row;
+       ++it) {
+    if (mvcc_snapshot_.IsCommitted(Timestamp(std::get<1>(*it)))) {
+      deleted_.push_back(std::get<0>(*it));
+    }
+  }
+  return Status::OK();
+}
+
 Status DMSIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
   DCHECK_EQ(prepared_for_, PREPARED_FOR_APPLY);
   DCHECK_EQ(prepared_count_, dst->nrows());
@@ -19,11 +19,15 @@
 
 #include <deque>
 #include <gtest/gtest_prod.h>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include "kudu/common/columnblock.h"
+#include "kudu/common/row_changelist.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/consensus/log_anchor_registry.h"
@@ -36,6 +40,7 @@
 #include "kudu/tablet/delta_stats.h"
 #include "kudu/tablet/mvcc.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/memory/arena.h"
 
 namespace kudu {
@@ -51,7 +56,7 @@ class DMSIterator;
 class Mutation;
 
 struct DMSTreeTraits : public btree::BTreeTraits {
-  typedef ThreadSafeMemoryTrackingArena ArenaType;
+  typedef ShardedMemoryTrackingArena ArenaType;
 };
 
 // In-memory storage for data which has been recently updated.
@@ -87,6 +92,11 @@ class DeltaMemStore : public DeltaStore,
     return tree_.empty();
   }
 
+  // Returns true if any DELETE or REINSERT has been applied to this DMS.
+  bool HasDeletesOrReinserts() const {
+    return has_deletes_or_reinserts_.Load();
+  }
+
   // Dump a debug version of the tree to the logs. This is not thread-safe, so
   // is only really useful in unit tests.
   void DebugPrint() const;
@@ -114,7 +124,13 @@ class DeltaMemStore : public DeltaStore,
   virtual Status CheckRowDeleted(rowid_t row_idx, bool *deleted) const OVERRIDE;
 
   virtual uint64_t EstimateSize() const OVERRIDE {
-    return arena_->memory_footprint();
+    return arena_->memory_footprint() + columnar_bytes_.Load();
+  }
+
+  // Returns true if the updates in this DMS are also indexed by column.
+  // See --dms_columnar_updates.
+  bool columnar() const {
+    return columnar_;
   }
 
   const int64_t id() const { return id_; }
@@ -148,12 +164,26 @@ class DeltaMemStore : public DeltaStore,
     return tree_;
   }
 
+  // The key of the per-column index: (row index, timestamp, sequence number).
+  // The sequence number orders the updates to a row at the same timestamp in
+  // the order they were made, as the disambiguator does in the tree.
+  typedef std::tuple<rowid_t, uint64_t, uint64_t> ColumnarKey;
+
+  // The updates to a single column, whose raw values are copied into the
+  // arena.
+  typedef std::map<ColumnarKey, RowChangeListDecoder::DecodedUpdate> ColumnUpdates;
+
+  // Adds the decoded updates, or the delete, of a mutation which has been
+  // inserted into the tree to the per-column index.
+  void IndexColumnar(Timestamp timestamp, rowid_t row_idx, bool is_delete,
+                     const std::vector<RowChangeListDecoder::DecodedUpdate>& updates);
+
   const int64_t id_;    // DeltaMemStore ID.
   const int64_t rs_id_; // Rowset ID.
 
   std::shared_ptr<MemoryTrackingBufferAllocator> allocator_;
 
-  std::shared_ptr<ThreadSafeMemoryTrackingArena> arena_;
+  std::shared_ptr<ShardedMemoryTrackingArena> arena_;
 
   // Concurrent B-Tree storing <key index> -> RowChangeList
   DMSTree tree_;
@@ -170,6 +200,26 @@ class DeltaMemStore : public DeltaStore,
   // number, and is only used in the case that such a collision occurs.
   AtomicInt<Atomic32> disambiguator_sequence_number_;
 
+  // Set before the first DELETE or REINSERT is inserted into 'tree_', so
+  // that readers which see a committed DELETE also see the flag.
+  AtomicBool has_deletes_or_reinserts_;
+
+  // If true, every mutation is also kept in 'updates_by_col_id_' and
+  // 'deletes_', so that iterators which apply updates can read just the
+  // projected columns instead of decoding every RowChangeList in the tree.
+  // The tree remains the source of truth for flushes and compactions.
+  const bool columnar_;
+
+  // Protects the per-column index below.
+  mutable rw_spinlock columnar_lock_;
+  std::map<ColumnId, ColumnUpdates> updates_by_col_id_;
+  std::set<ColumnarKey> deletes_;
+  uint64_t columnar_seq_;
+
+  // Approximate heap memory used by the per-column index, which isn't
+  // allocated from the arena.
+  AtomicInt<int64_t> columnar_bytes_;
+
   DISALLOW_COPY_AND_ASSIGN(DeltaMemStore);
 };
 
@@ -259,6 +309,18 @@ class DMSIterator : public DeltaIterator {
   std::vector<UpdatesForColumn> updates_by_col_;
   std::deque<rowid_t> deleted_;
 
+  // Records the update of the column at 'col_idx' of the row 'row_idx' to
+  // 'col_val', replacing any earlier update of the same cell in the batch.
+  void AddColumnUpdate(int col_idx, rowid_t row_idx, const void* col_val);
+
+  // Prepares the updates and deletes of rows [start_row, stop_row] for
+  // application from the per-column index of a columnar DMS.
+  Status PrepareColumnarBatch(rowid_t start_row, rowid_t stop_row);
+
+  // True if the tree iterator has fallen behind the prepared batch because
+  // it was prepared from the per-column index.
+  bool tree_seek_pending_;
+
   // State when prepared_for_ == PREPARED_FOR_COLLECT
   // ------------------------------------------------------------
   struct PreparedDelta {
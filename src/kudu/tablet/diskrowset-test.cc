@@ -35,6 +35,7 @@
 
 DEFINE_double(update_fraction, 0.1f, "fraction of rows to update");
 DECLARE_bool(cfile_lazy_open);
+DECLARE_int32(cfile_column_writer_threads);
 DECLARE_int32(cfile_default_block_size);
 DECLARE_double(tablet_delta_store_major_compact_min_ratio);
 DECLARE_int32(tablet_delta_store_minor_compact_max);
@@ -127,6 +128,44 @@ TEST_F(TestRowSet, TestRowSetRoundTrip) {
   }
 }
 
+// Test that a rowset whose columns are written in parallel reads back the
+// same as one written serially.
+TEST_F(TestRowSet, TestRowSetRoundTripParallelColumns) {
+  FLAGS_cfile_column_writer_threads = 4;
+  // Use small blocks so that each column writes many blocks concurrently.
+  FLAGS_cfile_default_block_size = 4096;
+  WriteTestRowSet();
+
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+  IterateProjection(*rs, schema_, n_rows_);
+
+  rowid_t count;
+  ASSERT_OK(rs->CountRows(&count));
+  ASSERT_EQ(n_rows_, count);
+}
+
+// Test that the sampled keys are increasing keys of the rowset, starting
+// with its first row.
+TEST_F(TestRowSet, TestSampleKeys) {
+  WriteTestRowSet();
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+
+  const int kNumSamples = 10;
+  vector<string> keys;
+  ASSERT_OK(rs->SampleKeys(kNumSamples, &keys));
+  ASSERT_EQ(kNumSamples, keys.size());
+
+  string min_key, max_key;
+  ASSERT_OK(rs->GetBounds(&min_key, &max_key));
+  ASSERT_EQ(min_key, keys[0]);
+  for (int i = 1; i < keys.size(); i++) {
+    ASSERT_LT(keys[i - 1], keys[i]);
+    ASSERT_LE(keys[i], max_key);
+  }
+}
+
 // Test writing a rowset, and then updating some rows in it.
 TEST_F(TestRowSet, TestRowSetUpdate) {
   WriteTestRowSet();
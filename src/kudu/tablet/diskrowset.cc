@@ -25,8 +25,11 @@
 #include "kudu/cfile/type_encodings.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/consensus/log_anchor_registry.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/tablet/cfile_set.h"
@@ -55,6 +58,13 @@ DEFINE_int32(default_composite_key_index_block_size_bytes, 4096,
              "Block size used for composite key indexes.");
 TAG_FLAG(default_composite_key_index_block_size_bytes, experimental);
 
+DEFINE_bool(tablet_write_secondary_indexes, false,
+            "Whether flushes and compactions write the secondary indexes of the "
+            "columns marked as indexed in the schema. Rowsets without an index for "
+            "a column are scanned as if the column weren't indexed.");
+TAG_FLAG(tablet_write_secondary_indexes, experimental);
+TAG_FLAG(tablet_write_secondary_indexes, runtime);
+
 namespace kudu {
 namespace tablet {
 
@@ -76,7 +86,9 @@ DiskRowSetWriter::DiskRowSetWriter(RowSetMetadata* rowset_metadata,
       schema_(schema),
       bloom_sizing_(std::move(bloom_sizing)),
       finished_(false),
-      written_count_(0) {
+      written_count_(0),
+      index_arena_(32 * 1024, 4 * 1024 * 1024),
+      index_written_size_(0) {
   CHECK(schema->has_column_ids());
 }
 
@@ -85,6 +97,7 @@ Status DiskRowSetWriter::Open() {
 
   FsManager* fs = rowset_metadata_->fs_manager();
   col_writer_.reset(new MultiColumnWriter(fs, schema_));
+  col_writer_->set_column_block_sizes(column_block_sizes_);
   RETURN_NOT_OK(col_writer_->Open());
 
   // Open bloom filter.
@@ -95,6 +108,14 @@ Status DiskRowSetWriter::Open() {
     RETURN_NOT_OK(InitAdHocIndexWriter());
   }
 
+  if (FLAGS_tablet_write_secondary_indexes) {
+    for (size_t i = schema_->num_key_columns(); i < schema_->num_columns(); i++) {
+      if (schema_->column(i).attributes().indexed) {
+        secondary_indexes_.push_back({ i, {} });
+      }
+    }
+  }
+
   return Status::OK();
 }
 
@@ -151,51 +172,115 @@ Status DiskRowSetWriter::AppendBlock(const RowBlock &block) {
   DCHECK_EQ(block.schema().num_columns(), schema_->num_columns());
   CHECK(!finished_);
 
-  // If this is the very first block, encode the first key and save it as metadata
-  // in the index column.
-  if (written_count_ == 0) {
-    Slice enc_key = schema_->EncodeComparableKey(block.row(0), &last_encoded_key_);
-    key_index_writer()->AddMetadataPair(DiskRowSet::kMinKeyMetaEntryName, enc_key);
-    last_encoded_key_.clear();
-  }
-
   // Write the batch to each of the columns
   RETURN_NOT_OK(col_writer_->AppendBlock(block));
 
-#ifndef NDEBUG
-    faststring prev_key;
-#endif
-
-  // Write the batch to the bloom and optionally the ad-hoc index
+  // Encode the keys of the batch at once, and write them to the bloom and
+  // optionally the ad-hoc index.
+  vector<RowBlockRow> rows;
+  rows.reserve(block.nrows());
   for (size_t i = 0; i < block.nrows(); i++) {
-#ifndef NDEBUG
-    prev_key.assign_copy(last_encoded_key_.data(), last_encoded_key_.size());
-#endif
-
-    // TODO: performance might be better if we actually batch this -
-    // encode a bunch of key slices, then pass them all in one go.
-    RowBlockRow row = block.row(i);
-    // Insert the encoded key into the bloom.
-    Slice enc_key = schema_->EncodeComparableKey(row, &last_encoded_key_);
-    RETURN_NOT_OK(bloom_writer_->AppendKeys(&enc_key, 1));
+    rows.push_back(block.row(i));
+  }
+  vector<Slice> enc_keys(block.nrows());
+  schema_->EncodeComparableKeys(rows.data(), rows.size(), &encoded_keys_buf_, enc_keys.data());
 
-    // Write the batch to the ad hoc index if we're using one
-    if (ad_hoc_index_writer_ != nullptr) {
-      RETURN_NOT_OK(ad_hoc_index_writer_->AppendEntries(&enc_key, 1));
-    }
+  // If this is the very first block, save its first key as metadata in the
+  // index column.
+  if (written_count_ == 0 && !enc_keys.empty()) {
+    key_index_writer()->AddMetadataPair(DiskRowSet::kMinKeyMetaEntryName, enc_keys[0]);
+  }
 
 #ifndef NDEBUG
-    CHECK_LT(Slice(prev_key).compare(enc_key), 0)
-      << KUDU_REDACT(enc_key.ToDebugString()) << " appended to file not > previous key "
-      << KUDU_REDACT(Slice(prev_key).ToDebugString());
+  for (size_t i = 0; i < enc_keys.size(); i++) {
+    Slice prev_key = i == 0 ? Slice(last_encoded_key_) : enc_keys[i - 1];
+    if (written_count_ > 0 || i > 0) {
+      CHECK_LT(prev_key.compare(enc_keys[i]), 0)
+        << KUDU_REDACT(enc_keys[i].ToDebugString()) << " appended to file not > previous key "
+        << KUDU_REDACT(prev_key.ToDebugString());
+    }
+  }
 #endif
+
+  RETURN_NOT_OK(bloom_writer_->AppendKeys(enc_keys.data(), enc_keys.size()));
+  if (ad_hoc_index_writer_ != nullptr) {
+    RETURN_NOT_OK(ad_hoc_index_writer_->AppendEntries(enc_keys.data(), enc_keys.size()));
+  }
+  if (!enc_keys.empty()) {
+    last_encoded_key_.assign_copy(enc_keys.back().data(), enc_keys.back().size());
   }
 
+  AppendSecondaryIndexEntries(block, written_count_);
   written_count_ += block.nrows();
 
   return Status::OK();
 }
 
+void DiskRowSetWriter::AppendSecondaryIndexEntries(const RowBlock& block, rowid_t first_rowid) {
+  faststring buf;
+  for (SecondaryIndex& index : secondary_indexes_) {
+    const ColumnSchema& col = schema_->column(index.col_idx);
+    const KeyEncoder<faststring>& encoder = GetKeyEncoder<faststring>(col.type_info());
+    for (size_t i = 0; i < block.nrows(); i++) {
+      const void* cell = block.row(i).cell_ptr(index.col_idx);
+      if (col.is_nullable() && block.row(i).is_null(index.col_idx)) {
+        continue;
+      }
+      // The entry is the value, encoded so that the entries sort by value,
+      // followed by the row ID, so that equal values sort by row.
+      buf.clear();
+      encoder.Encode(cell, false, &buf);
+      uint8_t rowid_buf[sizeof(rowid_t)];
+      BigEndian::Store32(rowid_buf, first_rowid + i);
+      buf.append(rowid_buf, sizeof(rowid_buf));
+      uint8_t* copy = index_arena_.AddSlice(Slice(buf));
+      CHECK(copy != nullptr) << "out of memory buffering secondary index";
+      index.entries.emplace_back(copy, buf.size());
+      index_written_size_ += buf.size();
+    }
+  }
+}
+
+Status DiskRowSetWriter::FinishSecondaryIndexes(ScopedWritableBlockCloser* closer) {
+  if (secondary_indexes_.empty()) {
+    return Status::OK();
+  }
+  TRACE_EVENT0("tablet", "DiskRowSetWriter::FinishSecondaryIndexes");
+  FsManager* fs = rowset_metadata_->fs_manager();
+  RowSetMetadata::ColumnIdToBlockIdMap index_blocks;
+  for (SecondaryIndex& index : secondary_indexes_) {
+    std::sort(index.entries.begin(), index.entries.end(),
+              [](const Slice& a, const Slice& b) { return a.compare(b) < 0; });
+
+    gscoped_ptr<WritableBlock> block;
+    RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&block),
+                          "Couldn't allocate a block for secondary index");
+    index_blocks[schema_->column_id(index.col_idx)] = block->id();
+
+    // Like the ad-hoc index, the entries are only looked up by value.
+    cfile::WriterOptions opts;
+    opts.write_validx = true;
+    opts.write_posidx = false;
+    opts.storage_attributes.encoding = PREFIX_ENCODING;
+    opts.storage_attributes.compression = LZ4;
+    opts.storage_attributes.cfile_block_size = FLAGS_default_composite_key_index_block_size_bytes;
+    cfile::CFileWriter writer(opts, GetTypeInfo(BINARY), false, std::move(block));
+    RETURN_NOT_OK(writer.Start());
+    // AppendEntries() takes a batch of cells; write in bounded batches.
+    const size_t kBatchSize = 1024;
+    for (size_t i = 0; i < index.entries.size(); i += kBatchSize) {
+      RETURN_NOT_OK(writer.AppendEntries(&index.entries[i],
+                                         std::min(kBatchSize, index.entries.size() - i)));
+    }
+    RETURN_NOT_OK_PREPEND(writer.FinishAndReleaseBlock(closer),
+                          "Unable to finish secondary index writer");
+    index.entries.clear();
+  }
+  rowset_metadata_->SetSecondaryIndexBlocks(index_blocks);
+  index_arena_.Reset();
+  return Status::OK();
+}
+
 Status DiskRowSetWriter::Finish() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::Finish");
   ScopedWritableBlockCloser closer;
@@ -240,6 +325,8 @@ Status DiskRowSetWriter::FinishAndReleaseBlocks(ScopedWritableBlockCloser* close
     }
   }
 
+  RETURN_NOT_OK(FinishSecondaryIndexes(closer));
+
   // Finish bloom.
   Status s = bloom_writer_->FinishAndReleaseBlock(closer);
   if (!s.ok()) {
@@ -270,6 +357,10 @@ size_t DiskRowSetWriter::written_size() const {
     size += ad_hoc_index_writer_->written_size();
   }
 
+  // The secondary indexes are only written at the end; estimate them by
+  // the size of their buffered entries.
+  size += index_written_size_;
+
   return size;
 }
 
@@ -285,6 +376,8 @@ RollingDiskRowSetWriter::RollingDiskRowSetWriter(
       bloom_sizing_(std::move(bloom_sizing)),
       target_rowset_size_(target_rowset_size),
       row_idx_in_cur_drs_(0),
+      cur_rows_with_insert_undo_(0),
+      cur_min_insert_timestamp_(Timestamp::kMax),
       can_roll_(false),
       written_count_(0),
       written_size_(0) {
@@ -308,6 +401,7 @@ Status RollingDiskRowSetWriter::RollWriter() {
   RETURN_NOT_OK(tablet_metadata_->CreateRowSet(&cur_drs_metadata_, schema_));
 
   cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_));
+  cur_writer_->set_column_block_sizes(column_block_sizes_);
   RETURN_NOT_OK(cur_writer_->Open());
 
   FsManager* fs = tablet_metadata_->fs_manager();
@@ -323,6 +417,8 @@ Status RollingDiskRowSetWriter::RollWriter() {
   cur_redo_delta_stats.reset(new DeltaStats());
 
   row_idx_in_cur_drs_ = 0;
+  cur_rows_with_insert_undo_ = 0;
+  cur_min_insert_timestamp_ = Timestamp::kMax;
   can_roll_ = false;
 
   RETURN_NOT_OK(cur_undo_writer_->Start());
@@ -351,6 +447,16 @@ Status RollingDiskRowSetWriter::AppendBlock(const RowBlock &block) {
 Status RollingDiskRowSetWriter::AppendUndoDeltas(rowid_t row_idx_in_block,
                                                  Mutation* undo_delta_head,
                                                  rowid_t* row_idx) {
+  // The UNDOs are in decreasing timestamp order, so the last one is the
+  // oldest. If it's a DELETE, the row didn't exist before it.
+  const Mutation* oldest = undo_delta_head;
+  while (oldest->next() != nullptr) {
+    oldest = oldest->next();
+  }
+  if (oldest->changelist().is_delete()) {
+    cur_rows_with_insert_undo_++;
+    cur_min_insert_timestamp_ = std::min(cur_min_insert_timestamp_, oldest->timestamp());
+  }
   return AppendDeltas<UNDO>(row_idx_in_block, undo_delta_head,
                             row_idx,
                             cur_undo_writer_.get(),
@@ -423,6 +529,10 @@ Status RollingDiskRowSetWriter::FinishCurrentWriter() {
       DCHECK_EQ(cur_redo_delta_stats->min_timestamp(), Timestamp::kMax);
     }
 
+    if (cur_rows_with_insert_undo_ == cur_writer_->written_count()) {
+      cur_drs_metadata_->set_min_insert_timestamp(cur_min_insert_timestamp_);
+    }
+
     written_size_ += cur_writer_->written_size();
 
     written_drs_metas_.push_back(cur_drs_metadata_);
@@ -587,6 +697,18 @@ Status DiskRowSet::NewRowIterator(const Schema *projection,
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
 
   shared_ptr<CFileSet::Iterator> base_iter(base_data_->NewIterator(projection));
+
+  // The secondary indexes only cover the base data, so they may only be used
+  // for the columns which have no updates. Any update visible to the scan is
+  // already in a store by now.
+  vector<ColumnId> indexable_col_ids;
+  for (ColumnId col_id : base_data_->indexed_column_ids()) {
+    if (!delta_tracker_->MayHaveUpdatesToColumn(col_id)) {
+      indexable_col_ids.push_back(col_id);
+    }
+  }
+  base_iter->set_indexable_column_ids(std::move(indexable_col_ids));
+
   gscoped_ptr<ColumnwiseIterator> col_iter;
   RETURN_NOT_OK(delta_tracker_->WrapIterator(base_iter, mvcc_snap, &col_iter));
 
@@ -601,6 +723,21 @@ Status DiskRowSet::NewCompactionInput(const Schema* projection,
   return CompactionInput::Create(*this, projection, snap, out);
 }
 
+Status DiskRowSet::NewCompactionInputForRange(const Schema* projection,
+                                              const MvccSnapshot &snap,
+                                              const Slice& lower_bound,
+                                              const Slice& exclusive_upper_bound,
+                                              gscoped_ptr<CompactionInput>* out) const  {
+  return CompactionInput::Create(*this, projection, snap, lower_bound, exclusive_upper_bound,
+                                 out);
+}
+
+Status DiskRowSet::SampleKeys(int num_samples, vector<string>* encoded_keys) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return base_data_->SampleKeys(num_samples, encoded_keys);
+}
+
 Status DiskRowSet::MutateRow(Timestamp timestamp,
                              const RowSetKeyProbe &probe,
                              const RowChangeList &update,
@@ -646,6 +783,27 @@ Status DiskRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
   return Status::OK();
 }
 
+Status DiskRowSet::CheckRowsPresent(const RowSetKeyProbe* const* probes,
+                                    ProbeStats* const* stats,
+                                    int n, bool* present) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+
+  vector<rowid_t> row_idxs(n);
+  RETURN_NOT_OK(base_data_->CheckRowsPresent(probes, stats, n, present, row_idxs.data()));
+
+  // Rows found in the base data might since have been deleted.
+  for (int i = 0; i < n; i++) {
+    if (!present[i]) {
+      continue;
+    }
+    bool deleted = false;
+    RETURN_NOT_OK(delta_tracker_->CheckRowDeleted(row_idxs[i], &deleted, stats[i]));
+    present[i] = !deleted;
+  }
+  return Status::OK();
+}
+
 Status DiskRowSet::CountRows(rowid_t *count) const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
@@ -653,6 +811,25 @@ Status DiskRowSet::CountRows(rowid_t *count) const {
   return base_data_->CountRows(count);
 }
 
+Status DiskRowSet::CountLiveRows(const MvccSnapshot& snap, bool* counted,
+                                 rowid_t* count) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+
+  return delta_tracker_->CountLiveRows(snap, counted, count);
+}
+
+bool DiskRowSet::MayHaveRowsVisibleIn(const MvccSnapshot& snap) const {
+  const Timestamp min_insert = rowset_metadata_->min_insert_timestamp();
+  return min_insert == Timestamp::kMin || snap.MayHaveCommittedTransactionsAtOrAfter(min_insert);
+}
+
+bool DiskRowSet::MayHaveChangesBetween(Timestamp start, Timestamp end) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return delta_tracker_->MayHaveDeltasBetween(start, end);
+}
+
 Status DiskRowSet::GetBounds(std::string* min_encoded_key,
                              std::string* max_encoded_key) const {
   DCHECK(open_);
@@ -698,6 +875,30 @@ size_t DiskRowSet::CountDeltaStores() const {
   return delta_tracker_->CountRedoDeltaStores();
 }
 
+int64_t DiskRowSet::EstimateBytesInPotentiallyAncientUndoDeltas(
+    Timestamp ancient_history_mark) const {
+  DCHECK(open_);
+  return delta_tracker_->EstimateBytesInPotentiallyAncientUndoDeltas(ancient_history_mark);
+}
+
+Status DiskRowSet::InitUndoDeltas(MonoTime deadline, int64_t* stores_initialized) {
+  DCHECK(open_);
+  return delta_tracker_->InitUndoDeltas(deadline, stores_initialized);
+}
+
+void DiskRowSet::ReleaseCachedBlocks() {
+  DCHECK(open_);
+  base_data_->ReleaseCachedBlocks();
+}
+
+Status DiskRowSet::DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                           int64_t* blocks_deleted,
+                                           int64_t* bytes_deleted) {
+  DCHECK(open_);
+  return delta_tracker_->DeleteAncientUndoDeltas(ancient_history_mark,
+                                                 blocks_deleted, bytes_deleted);
+}
+
 
 
 // In this implementation, the returned improvement score is 0 if there aren't any redo files to
@@ -23,9 +23,11 @@
 #define KUDU_TABLET_DISKROWSET_H_
 
 #include <gtest/gtest_prod.h>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "kudu/common/row.h"
@@ -40,6 +42,7 @@
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/mem_tracker.h"
+#include "kudu/util/memory/arena.h"
 
 namespace kudu {
 
@@ -76,6 +79,13 @@ class DiskRowSetWriter {
 
   ~DiskRowSetWriter();
 
+  // See MultiColumnWriter::set_column_block_sizes().
+  //
+  // REQUIRES: Open() not yet called.
+  void set_column_block_sizes(std::map<ColumnId, int32_t> block_sizes) {
+    column_block_sizes_ = std::move(block_sizes);
+  }
+
   Status Open();
 
   // The block is written to all column writers as well as the bloom filter,
@@ -120,10 +130,19 @@ class DiskRowSetWriter {
   // (the ad-hoc writer for composite keys, otherwise the key column writer)
   cfile::CFileWriter *key_index_writer();
 
+  // Buffers the secondary index entries of the rows of 'block', which
+  // start at row 'first_rowid' of the rowset.
+  void AppendSecondaryIndexEntries(const RowBlock& block, rowid_t first_rowid);
+
+  // Sorts the buffered entries of each secondary index and writes them out,
+  // releasing the blocks to 'closer'.
+  Status FinishSecondaryIndexes(fs::ScopedWritableBlockCloser* closer);
+
   RowSetMetadata *rowset_metadata_;
   const Schema* const schema_;
 
   BloomFilterSizing bloom_sizing_;
+  std::map<ColumnId, int32_t> column_block_sizes_;
 
   bool finished_;
   rowid_t written_count_;
@@ -133,6 +152,20 @@ class DiskRowSetWriter {
 
   // The last encoded key written.
   faststring last_encoded_key_;
+
+  // The encoded keys of the block being appended.
+  faststring encoded_keys_buf_;
+
+  // The secondary indexes being built, one per indexed non-key column. The
+  // entries are only sorted when the rowset is finished, so they are
+  // buffered until then.
+  struct SecondaryIndex {
+    size_t col_idx;
+    std::vector<Slice> entries;
+  };
+  std::vector<SecondaryIndex> secondary_indexes_;
+  Arena index_arena_;
+  size_t index_written_size_;
 };
 
 
@@ -151,6 +184,15 @@ class RollingDiskRowSetWriter {
                           size_t target_rowset_size);
   ~RollingDiskRowSetWriter();
 
+  // Sets the block sizes of the columns of every rowset written. See
+  // MultiColumnWriter::set_column_block_sizes().
+  //
+  // REQUIRES: Open() not yet called.
+  void set_column_block_sizes(std::map<ColumnId, int32_t> block_sizes) {
+    CHECK_EQ(state_, kInitialized);
+    column_block_sizes_ = std::move(block_sizes);
+  }
+
   Status Open();
 
   // The block is written to all column writers as well as the bloom filter,
@@ -224,6 +266,7 @@ class RollingDiskRowSetWriter {
   std::shared_ptr<RowSetMetadata> cur_drs_metadata_;
   const BloomFilterSizing bloom_sizing_;
   const size_t target_rowset_size_;
+  std::map<ColumnId, int32_t> column_block_sizes_;
 
   gscoped_ptr<DiskRowSetWriter> cur_writer_;
 
@@ -238,6 +281,12 @@ class RollingDiskRowSetWriter {
 
   uint64_t row_idx_in_cur_drs_;
 
+  // The number of rows of the current DRS whose oldest UNDO undoes their
+  // insertion, and the earliest of those insertions. If every row of the DRS
+  // has one, no row of it is visible in snapshots before that timestamp.
+  uint64_t cur_rows_with_insert_undo_;
+  Timestamp cur_min_insert_timestamp_;
+
   // True when we are allowed to roll. We can only roll when the delta writers
   // and data writers are aligned (i.e. just after we've appended a new block of data).
   bool can_roll_;
@@ -309,6 +358,10 @@ class DiskRowSet : public RowSet {
                          bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  Status CheckRowsPresent(const RowSetKeyProbe* const* probes,
+                          ProbeStats* const* stats,
+                          int n, bool* present) const OVERRIDE;
+
   ////////////////////
   // Read functions.
   ////////////////////
@@ -321,9 +374,31 @@ class DiskRowSet : public RowSet {
                                     const MvccSnapshot &snap,
                                     gscoped_ptr<CompactionInput>* out) const OVERRIDE;
 
+  virtual Status NewCompactionInputForRange(const Schema* projection,
+                                            const MvccSnapshot &snap,
+                                            const Slice& lower_bound,
+                                            const Slice& exclusive_upper_bound,
+                                            gscoped_ptr<CompactionInput>* out) const OVERRIDE;
+
   // Count the number of rows in this rowset.
   Status CountRows(rowid_t *count) const OVERRIDE;
 
+  // See DeltaTracker::CountLiveRows().
+  Status CountLiveRows(const MvccSnapshot& snap, bool* counted,
+                       rowid_t* count) const OVERRIDE;
+
+  // Uses the earliest insertion timestamp of the rows, if it was recorded
+  // when the rowset was written.
+  bool MayHaveRowsVisibleIn(const MvccSnapshot& snap) const OVERRIDE;
+
+  // See DeltaTracker::MayHaveDeltasBetween(). Rows inserted into the base
+  // data after 'start' have UNDO deletes, so are covered by the deltas too.
+  bool MayHaveChangesBetween(Timestamp start, Timestamp end) const OVERRIDE;
+
+  // Sample the encoded keys of 'num_samples' evenly spaced rows of the base
+  // data, in increasing order. Rows deleted by the deltas are still sampled.
+  Status SampleKeys(int num_samples, std::vector<std::string>* encoded_keys) const;
+
   // See RowSet::GetBounds(...)
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
@@ -351,6 +426,17 @@ class DiskRowSet : public RowSet {
   // Major compacts all the delta files for all the columns.
   Status MajorCompactDeltaStores(HistoryGcOpts history_gc_opts);
 
+  int64_t EstimateBytesInPotentiallyAncientUndoDeltas(
+      Timestamp ancient_history_mark) const OVERRIDE;
+
+  Status InitUndoDeltas(MonoTime deadline, int64_t* stores_initialized) OVERRIDE;
+
+  Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                 int64_t* blocks_deleted,
+                                 int64_t* bytes_deleted) OVERRIDE;
+
+  void ReleaseCachedBlocks() OVERRIDE;
+
   std::mutex *compact_flush_lock() OVERRIDE {
     return &compact_flush_lock_;
   }
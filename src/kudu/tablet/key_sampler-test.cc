@@ -0,0 +1,68 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/tablet/key_sampler.h"
+#include "kudu/util/test_util.h"
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+class KeySamplerTest : public KuduTest {};
+
+TEST_F(KeySamplerTest, TestFewKeys) {
+  KeySampler sampler(10);
+  sampler.Add("a");
+  sampler.Add("b");
+  vector<string> keys;
+  sampler.TakeSamples(&keys);
+  std::sort(keys.begin(), keys.end());
+  ASSERT_EQ((vector<string>{ "a", "b" }), keys);
+
+  // Taking the samples empties the sample.
+  sampler.TakeSamples(&keys);
+  ASSERT_TRUE(keys.empty());
+}
+
+TEST_F(KeySamplerTest, TestSampleIsBoundedAndUniform) {
+  const int kMaxSamples = 100;
+  KeySampler sampler(kMaxSamples);
+  // Keys "00000" to "09999", of which a uniform sample should have about
+  // as many below "05000" as above.
+  for (int i = 0; i < 10000; i++) {
+    sampler.Add(StringPrintf("%05d", i));
+  }
+  vector<string> keys;
+  sampler.TakeSamples(&keys);
+  ASSERT_EQ(kMaxSamples, keys.size());
+  int num_low = std::count_if(keys.begin(), keys.end(),
+                              [](const string& k) { return k < "05000"; });
+  ASSERT_GT(num_low, kMaxSamples / 4);
+  ASSERT_LT(num_low, kMaxSamples * 3 / 4);
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,59 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/key_sampler.h"
+
+#include <mutex>
+
+#include "kudu/util/random_util.h"
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+KeySampler::KeySampler(int max_samples)
+    : max_samples_(max_samples),
+      rng_(GetRandomSeed32()),
+      num_added_(0) {
+}
+
+void KeySampler::Add(const Slice& key) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  num_added_++;
+  if (samples_.size() < max_samples_) {
+    samples_.push_back(key.ToString());
+    return;
+  }
+  // Reservoir sampling: the key replaces a sample with probability
+  // max_samples_ / num_added_.
+  uint64_t idx = rng_.Uniform64(num_added_);
+  if (idx < max_samples_) {
+    samples_[idx] = key.ToString();
+  }
+}
+
+void KeySampler::TakeSamples(vector<string>* keys) {
+  keys->clear();
+  std::lock_guard<simple_spinlock> l(lock_);
+  keys->swap(samples_);
+  num_added_ = 0;
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,64 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_KEY_SAMPLER_H
+#define KUDU_TABLET_KEY_SAMPLER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/random.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+namespace tablet {
+
+// Maintains a uniform random sample of bounded size of the keys added to it
+// since it was last emptied, as a sketch of their distribution.
+//
+// This class is thread-safe.
+class KeySampler {
+ public:
+  explicit KeySampler(int max_samples);
+
+  // Offers 'key' to the sample.
+  void Add(const Slice& key);
+
+  // Moves the sampled keys, in no particular order, to 'keys', leaving the
+  // sample empty.
+  void TakeSamples(std::vector<std::string>* keys);
+
+ private:
+  const int max_samples_;
+
+  simple_spinlock lock_;
+
+  // Protected by 'lock_'.
+  Random rng_;
+  std::vector<std::string> samples_;
+  // The number of keys added since the sample was last emptied.
+  int64_t num_added_;
+
+  DISALLOW_COPY_AND_ASSIGN(KeySampler);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif // KUDU_TABLET_KEY_SAMPLER_H
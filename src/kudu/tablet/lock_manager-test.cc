@@ -20,6 +20,8 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
@@ -29,8 +31,9 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
 
-using std::vector;
 using std::shared_ptr;
+using std::string;
+using std::vector;
 
 DEFINE_int32(num_test_threads, 10, "number of stress test client threads");
 DEFINE_int32(num_iterations, 1000, "number of iterations per client thread");
@@ -104,6 +107,62 @@ TEST_F(LockManagerTest, TestMoveLock) {
   ASSERT_FALSE(row_lock.acquired());
 }
 
+TEST_F(LockManagerTest, TestLockBatch) {
+  vector<string> key_strings;
+  for (int i = 0; i < 100; i++) {
+    key_strings.push_back(StringPrintf("key%d", i));
+  }
+  vector<Slice> keys(key_strings.begin(), key_strings.end());
+  // The same row may appear more than once in a batch.
+  keys.push_back(keys[0]);
+
+  for (int iter = 0; iter < 3; iter++) {
+    vector<ScopedRowLock> locks;
+    ScopedRowLock::LockBatch(&lock_manager_, kFakeTransaction, keys,
+                             LockManager::LOCK_EXCLUSIVE, &locks);
+    ASSERT_EQ(keys.size(), locks.size());
+    for (int i = 0; i < keys.size(); i++) {
+      ASSERT_TRUE(locks[i].acquired());
+      NO_FATALS(VerifyAlreadyLocked(keys[i]));
+    }
+
+    // Releasing the duplicate lock must not release the row.
+    locks.back().Release();
+    NO_FATALS(VerifyAlreadyLocked(keys[0]));
+  }
+
+  // All of the batches' locks should have been released.
+  for (const Slice& key : keys) {
+    ScopedRowLock l(&lock_manager_, kFakeTransaction, key, LockManager::LOCK_EXCLUSIVE);
+    ASSERT_TRUE(l.acquired());
+  }
+}
+
+// Batches lock their rows in key order, so concurrent batches which lock the
+// same rows in different orders can't deadlock.
+TEST_F(LockManagerTest, TestConcurrentLockBatches) {
+  vector<string> key_strings;
+  for (int i = 0; i < 50; i++) {
+    key_strings.push_back(StringPrintf("key%d", i));
+  }
+  vector<Slice> keys(key_strings.begin(), key_strings.end());
+  vector<Slice> reversed_keys(keys.rbegin(), keys.rend());
+
+  const int kNumIterations = 100;
+  auto locker = [&](const vector<Slice>* batch, intptr_t tx_id) {
+    const TransactionState* tx = reinterpret_cast<const TransactionState*>(tx_id);
+    for (int i = 0; i < kNumIterations; i++) {
+      vector<ScopedRowLock> locks;
+      ScopedRowLock::LockBatch(&lock_manager_, tx, *batch,
+                               LockManager::LOCK_EXCLUSIVE, &locks);
+    }
+  };
+  std::thread t1(locker, &keys, 1);
+  std::thread t2(locker, &reversed_keys, 2);
+  t1.join();
+  t2.join();
+}
+
 class LmTestResource {
  public:
   explicit LmTestResource(const Slice* id)
@@ -18,9 +18,12 @@
 #include "kudu/tablet/lock_manager.h"
 
 #include <glog/logging.h>
+#include <algorithm>
 #include <mutex>
+#include <numeric>
 #include <semaphore.h>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -31,11 +34,17 @@
 #include "kudu/util/semaphore.h"
 #include "kudu/util/trace.h"
 
+using std::vector;
+
 namespace kudu {
 namespace tablet {
 
 class TransactionState;
 
+// The maximum number of released LockEntry objects which each LockTable
+// keeps around for reuse.
+static const size_t kMaxPooledLockEntries = 1024;
+
 // ============================================================================
 //  LockTable
 // ============================================================================
@@ -44,12 +53,23 @@ class TransactionState;
 // Callers should generally use ScopedRowLock (see below).
 class LockEntry {
  public:
-  explicit LockEntry(const Slice& key)
+  LockEntry()
   : sem(1),
     recursion_(0) {
-    key_hash_ = util_hash::CityHash64(reinterpret_cast<const char *>(key.data()), key.size());
+  }
+
+  static uint64_t HashKey(const Slice& key) {
+    return util_hash::CityHash64(reinterpret_cast<const char *>(key.data()), key.size());
+  }
+
+  // (Re-)initialize this entry for 'key', whose hash is 'hash'. The entry
+  // must not be locked.
+  void Init(const Slice& key, uint64_t hash) {
+    DCHECK_EQ(0, recursion_);
+    key_hash_ = hash;
     key_ = key;
     refs_ = 1;
+    holder_ = nullptr;
   }
 
   bool Equals(const Slice& key, uint64_t hash) const {
@@ -114,9 +134,19 @@ class LockTable {
         DCHECK(p == nullptr) << "The entry " << p->ToString() << " was not released";
       }
     }
+    while (pool_head_ != nullptr) {
+      LockEntry* next = pool_head_->ht_next_;
+      delete pool_head_;
+      pool_head_ = next;
+    }
   }
 
   LockEntry *GetLockEntry(const Slice &key);
+
+  // Look up (or add) the entries for each of the 'num_keys' keys in 'keys',
+  // taking a reference to each, as if by GetLockEntry().
+  void GetLockEntries(const Slice* keys, size_t num_keys, LockEntry** entries);
+
   void ReleaseLockEntry(LockEntry *entry);
 
  private:
@@ -149,6 +179,20 @@ class LockTable {
 
   void Resize();
 
+  // Resize the table if it's grown past its size, having just added
+  // 'num_added' entries.
+  void MaybeResize(int64_t num_added);
+
+  // Return an unused entry, reusing a pooled one if possible.
+  LockEntry* NewEntry();
+
+  // Move 'num_entries' unused entries from the pool to 'entries', allocating
+  // them if the pool runs out.
+  void NewEntries(size_t num_entries, vector<LockEntry*>* entries);
+
+  // Return unused entries to the pool, deleting those which don't fit.
+  void RecycleEntries(LockEntry* const* entries, size_t num_entries);
+
  private:
   // table rwlock used as write on resize
   percpu_rwlock lock_;
@@ -160,10 +204,71 @@ class LockTable {
   gscoped_array<Bucket> buckets_;
   // number of items in the table
   base::subtle::Atomic64 item_count_;
+
+  // Released entries kept for reuse, chained through 'ht_next_'.
+  simple_spinlock pool_lock_;
+  LockEntry* pool_head_ = nullptr;
+  size_t pool_size_ = 0;
 };
 
+LockEntry* LockTable::NewEntry() {
+  {
+    std::lock_guard<simple_spinlock> l(pool_lock_);
+    if (pool_head_ != nullptr) {
+      LockEntry* entry = pool_head_;
+      pool_head_ = entry->ht_next_;
+      pool_size_--;
+      return entry;
+    }
+  }
+  return new LockEntry();
+}
+
+void LockTable::NewEntries(size_t num_entries, vector<LockEntry*>* entries) {
+  entries->reserve(entries->size() + num_entries);
+  {
+    std::lock_guard<simple_spinlock> l(pool_lock_);
+    while (num_entries > 0 && pool_head_ != nullptr) {
+      entries->push_back(pool_head_);
+      pool_head_ = pool_head_->ht_next_;
+      pool_size_--;
+      num_entries--;
+    }
+  }
+  for (; num_entries > 0; num_entries--) {
+    entries->push_back(new LockEntry());
+  }
+}
+
+void LockTable::RecycleEntries(LockEntry* const* entries, size_t num_entries) {
+  size_t i = 0;
+  {
+    std::lock_guard<simple_spinlock> l(pool_lock_);
+    for (; i < num_entries && pool_size_ < kMaxPooledLockEntries; i++) {
+      entries[i]->ht_next_ = pool_head_;
+      pool_head_ = entries[i];
+      pool_size_++;
+    }
+  }
+  for (; i < num_entries; i++) {
+    delete entries[i];
+  }
+}
+
+void LockTable::MaybeResize(int64_t num_added) {
+  if (base::subtle::NoBarrier_AtomicIncrement(&item_count_, num_added) > size_) {
+    std::unique_lock<percpu_rwlock> table_wrlock(lock_, std::try_to_lock);
+    // if we can't take the lock, means that someone else is resizing.
+    // (The percpu_rwlock try_lock waits for readers to complete)
+    if (table_wrlock.owns_lock()) {
+      Resize();
+    }
+  }
+}
+
 LockEntry *LockTable::GetLockEntry(const Slice& key) {
-  auto new_entry = new LockEntry(key);
+  LockEntry* new_entry = NewEntry();
+  new_entry->Init(key, LockEntry::HashKey(key));
   LockEntry *old_entry;
 
   {
@@ -184,20 +289,60 @@ LockEntry *LockTable::GetLockEntry(const Slice& key) {
   }
 
   if (old_entry != nullptr) {
-    delete new_entry;
+    RecycleEntries(&new_entry, 1);
     return old_entry;
   }
 
-  if (base::subtle::NoBarrier_AtomicIncrement(&item_count_, 1) > size_) {
-    std::unique_lock<percpu_rwlock> table_wrlock(lock_, std::try_to_lock);
-    // if we can't take the lock, means that someone else is resizing.
-    // (The percpu_rwlock try_lock waits for readers to complete)
-    if (table_wrlock.owns_lock()) {
-      Resize();
+  MaybeResize(1);
+  return new_entry;
+}
+
+void LockTable::GetLockEntries(const Slice* keys, size_t num_keys, LockEntry** entries) {
+  vector<uint64_t> hashes(num_keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    hashes[i] = LockEntry::HashKey(keys[i]);
+  }
+
+  // Enough new entries for every key, in case none of them are locked yet.
+  vector<LockEntry*> new_entries;
+  NewEntries(num_keys, &new_entries);
+  size_t num_added = 0;
+
+  {
+    shared_lock<rw_spinlock> l(lock_.get_lock());
+
+    // Visit the keys grouped by bucket, so each bucket is locked only once.
+    vector<size_t> order(num_keys);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return (hashes[a] & mask_) < (hashes[b] & mask_);
+    });
+
+    size_t i = 0;
+    while (i < num_keys) {
+      Bucket* bucket = FindBucket(hashes[order[i]]);
+      std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
+      for (; i < num_keys && FindBucket(hashes[order[i]]) == bucket; i++) {
+        size_t idx = order[i];
+        LockEntry** node = FindSlot(bucket, keys[idx], hashes[idx]);
+        if (*node != nullptr) {
+          (*node)->refs_++;
+        } else {
+          LockEntry* entry = new_entries[num_added++];
+          entry->Init(keys[idx], hashes[idx]);
+          entry->ht_next_ = nullptr;
+          entry->CopyKey();
+          *node = entry;
+        }
+        entries[idx] = *node;
+      }
     }
   }
 
-  return new_entry;
+  RecycleEntries(new_entries.data() + num_added, num_keys - num_added);
+  if (num_added > 0) {
+    MaybeResize(num_added);
+  }
 }
 
 void LockTable::ReleaseLockEntry(LockEntry *entry) {
@@ -222,7 +367,7 @@ void LockTable::ReleaseLockEntry(LockEntry *entry) {
 
   DCHECK(removed) << "Unable to find LockEntry on release";
   base::subtle::NoBarrier_AtomicIncrement(&item_count_, -1);
-  delete entry;
+  RecycleEntries(&entry, 1);
 }
 
 void LockTable::Resize() {
@@ -281,6 +426,26 @@ ScopedRowLock::ScopedRowLock(LockManager *manager,
   }
 }
 
+void ScopedRowLock::LockBatch(LockManager* manager,
+                              const TransactionState* ctx,
+                              const vector<Slice>& keys,
+                              LockManager::LockMode mode,
+                              vector<ScopedRowLock>* locks) {
+  DCHECK_NOTNULL(manager);
+  vector<LockEntry*> entries(keys.size());
+  manager->LockBatch(keys.data(), keys.size(), ctx, mode, entries.data());
+
+  locks->clear();
+  locks->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ScopedRowLock& lock = (*locks)[i];
+    lock.manager_ = manager;
+    lock.acquired_ = true;
+    lock.entry_ = entries[i];
+    lock.ls_ = LockManager::LOCK_ACQUIRED;
+  }
+}
+
 ScopedRowLock::ScopedRowLock(ScopedRowLock&& other) {
   TakeState(&other);
 }
@@ -329,11 +494,33 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
                                           LockManager::LockMode mode,
                                           LockEntry** entry) {
   *entry = locks_->GetLockEntry(key);
+  return AcquireEntry(key, tx, *entry);
+}
 
+void LockManager::LockBatch(const Slice* keys, size_t num_keys,
+                            const TransactionState* tx,
+                            LockManager::LockMode mode,
+                            LockEntry** entries) {
+  locks_->GetLockEntries(keys, num_keys, entries);
+
+  vector<size_t> order(num_keys);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return keys[a].compare(keys[b]) < 0;
+  });
+  for (size_t idx : order) {
+    LockStatus ls = AcquireEntry(keys[idx], tx, entries[idx]);
+    DCHECK_EQ(LOCK_ACQUIRED, ls);
+  }
+}
+
+LockManager::LockStatus LockManager::AcquireEntry(const Slice& key,
+                                                  const TransactionState* tx,
+                                                  LockEntry* entry) {
   // We expect low contention, so just try to try_lock first. This is faster
   // than a timed_lock, since we don't have to do a syscall to get the current
   // time.
-  if (!(*entry)->sem.TryAcquire()) {
+  if (!entry->sem.TryAcquire()) {
     // If the current holder of this lock is the same transaction just return
     // a LOCK_ALREADY_ACQUIRED status without actually acquiring the mutex.
     //
@@ -343,8 +530,8 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     // obtained and released at the same time). If at any time in the future
     // we opt to perform more fine grained locking, possibly letting transactions
     // release a portion of the locks they no longer need, this no longer is OK.
-    if (ANNOTATE_UNPROTECTED_READ((*entry)->holder_) == tx) {
-      (*entry)->recursion_++;
+    if (ANNOTATE_UNPROTECTED_READ(entry->holder_) == tx) {
+      entry->recursion_++;
       return LOCK_ACQUIRED;
     }
 
@@ -355,8 +542,8 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     TRACE_COUNTER_INCREMENT("row_lock_wait_count", 1);
     MicrosecondsInt64 start_wait_us = GetMonoTimeMicros();
     int waited_seconds = 0;
-    while (!(*entry)->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
-      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ((*entry)->holder_);
+    while (!entry->sem.TimedAcquire(MonoDelta::FromSeconds(1))) {
+      const TransactionState* cur_holder = ANNOTATE_UNPROTECTED_READ(entry->holder_);
       LOG(WARNING) << "Waited " << (++waited_seconds) << " seconds to obtain row lock on key "
                    << KUDU_REDACT(key.ToDebugString()) << " cur holder: " << cur_holder;
       // TODO(unknown): would be nice to also include some info about the blocking transaction,
@@ -370,7 +557,7 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     }
   }
 
-  (*entry)->holder_ = tx;
+  entry->holder_ = tx;
   return LOCK_ACQUIRED;
 }
 
@@ -17,6 +17,8 @@
 #ifndef KUDU_TABLET_LOCK_MANAGER_H
 #define KUDU_TABLET_LOCK_MANAGER_H
 
+#include <vector>
+
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/move.h"
 #include "kudu/util/slice.h"
@@ -55,6 +57,20 @@ class LockManager {
 
   LockStatus Lock(const Slice& key, const TransactionState* tx,
                   LockMode mode, LockEntry **entry);
+
+  // Lock each of the 'num_keys' keys in 'keys', as if by Lock(), setting the
+  // corresponding element of 'entries' to the key's lock entry.
+  //
+  // The lock table is only locked once per hash bucket touched, rather than
+  // once per key. The rows themselves are locked in key order, so two
+  // batches never deadlock with each other.
+  void LockBatch(const Slice* keys, size_t num_keys, const TransactionState* tx,
+                 LockMode mode, LockEntry** entries);
+
+  // Acquire the lock on 'entry' (for 'key') on behalf of 'tx', waiting if
+  // need be.
+  LockStatus AcquireEntry(const Slice& key, const TransactionState* tx,
+                          LockEntry* entry);
   LockStatus TryLock(const Slice& key, const TransactionState* tx,
                      LockMode mode, LockEntry **entry);
   void Release(LockEntry *lock, LockStatus ls);
@@ -105,6 +121,15 @@ class ScopedRowLock {
 
   // Move constructor and assignment.
   ScopedRowLock(ScopedRowLock&& other);
+
+  // Lock each of 'keys' in the given LockManager, storing the resulting
+  // locks in 'locks', in the same order. This is equivalent to constructing
+  // a ScopedRowLock for each key, but cheaper for large batches; see
+  // LockManager::LockBatch(). The keys must remain valid and un-changed for
+  // the lifetime of the locks.
+  static void LockBatch(LockManager* manager, const TransactionState* ctx,
+                        const std::vector<Slice>& keys, LockManager::LockMode mode,
+                        std::vector<ScopedRowLock>* locks);
   ScopedRowLock& operator=(ScopedRowLock&& other);
 
   void Release();
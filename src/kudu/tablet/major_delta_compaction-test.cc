@@ -33,6 +33,8 @@
 #include "kudu/tablet/diskrowset-test-base.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(tablet_delta_compaction_column_reader_threads);
+
 using std::shared_ptr;
 using std::unordered_set;
 
@@ -210,6 +212,36 @@ TEST_F(TestMajorDeltaCompaction, TestCompact) {
   }
 }
 
+// Tests a major delta compaction whose columns are read in parallel, over
+// enough rows to span several blocks.
+TEST_F(TestMajorDeltaCompaction, TestCompactParallelColumns) {
+  FLAGS_tablet_delta_compaction_column_reader_threads = 2;
+  const int kNumRows = 3000;
+  ASSERT_NO_FATAL_FAILURE(WriteTestTablet(kNumRows));
+  ASSERT_OK(tablet()->Flush());
+
+  vector<shared_ptr<RowSet> > all_rowsets;
+  tablet()->GetRowSetsForTests(&all_rowsets);
+  shared_ptr<RowSet> rs = all_rowsets.front();
+
+  MvccSnapshot snap(*tablet()->mvcc_manager());
+  vector<ExpectedRow> old_state(expected_state_);
+
+  ASSERT_NO_FATAL_FAILURE(UpdateRows(kNumRows, false));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  ASSERT_NO_FATAL_FAILURE(UpdateRows(kNumRows, true));
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+
+  vector<ColumnId> col_ids_to_compact = { schema_.column_id(1),
+                                          schema_.column_id(3),
+                                          schema_.column_id(4) };
+  ASSERT_OK(tablet()->DoMajorDeltaCompaction(col_ids_to_compact, rs));
+
+  // Both the new data and, through the new UNDOs, the old data are intact.
+  ASSERT_NO_FATAL_FAILURE(VerifyData());
+  ASSERT_NO_FATAL_FAILURE(VerifyDataWithMvccAndExpectedState(snap, old_state));
+}
+
 // Verify that we do issue UNDO files and that we can read them.
 TEST_F(TestMajorDeltaCompaction, TestUndos) {
   const int kNumRows = 100;
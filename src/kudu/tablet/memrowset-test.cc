@@ -15,6 +15,8 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
+
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
@@ -34,6 +36,9 @@ DEFINE_int32(roundtrip_num_rows, 10000,
 DEFINE_int32(num_scan_passes, 1,
              "Number of passes to run the scan portion of the round-trip test");
 
+DECLARE_bool(mrs_columnar_append_store);
+DECLARE_bool(mrs_compact_row_format);
+
 namespace kudu {
 namespace tablet {
 
@@ -534,5 +539,127 @@ TEST_F(TestMemRowSet, TestUpdateMVCC) {
   }
 }
 
+// Test a memrowset whose in-order rows go into a columnar store, with some
+// out-of-order rows mixed in.
+TEST_F(TestMemRowSet, TestColumnarAppendStore) {
+  FLAGS_mrs_columnar_append_store = true;
+  shared_ptr<MemRowSet> mrs;
+  ASSERT_OK(MemRowSet::Create(0, schema_, log_anchor_registry_.get(),
+                              MemTracker::GetRootTracker(), &mrs));
+
+  // Enough rows to span several chunks, every other key inserted in order.
+  const int kNumRows = 3 * ColumnarMemStore::kRowsPerChunk;
+  for (int i = 0; i < kNumRows; i += 2) {
+    ASSERT_OK(InsertRow(mrs.get(), StringPrintf("row %06d", i), i));
+  }
+  // And the rest out of order, which must go into the b-tree.
+  for (int i = 1; i < kNumRows; i += 2) {
+    ASSERT_OK(InsertRow(mrs.get(), StringPrintf("row %06d", i), i));
+  }
+  ASSERT_EQ(kNumRows, mrs->entry_count());
+
+  // Duplicates must be caught in either store.
+  Status s = InsertRow(mrs.get(), "row 000100", 0);
+  ASSERT_TRUE(s.IsAlreadyPresent()) << s.ToString();
+  s = InsertRow(mrs.get(), "row 000101", 0);
+  ASSERT_TRUE(s.IsAlreadyPresent()) << s.ToString();
+
+  // Mutate, delete and reinsert a row from the columnar store.
+  OperationResultPB result;
+  ASSERT_OK(UpdateRow(mrs.get(), "row 001500", 12345, &result));
+  NO_FATALS(CheckValue(mrs, "row 001500", R"((string key="row 001500", uint32 val=12345))"));
+  ASSERT_OK(DeleteRow(mrs.get(), "row 002000", &result));
+  bool present;
+  ASSERT_OK(CheckRowPresent(*mrs, "row 002000", &present));
+  ASSERT_FALSE(present);
+  MvccSnapshot snapshot_after_delete(mvcc_);
+  ASSERT_OK(InsertRow(mrs.get(), "row 002000", 54321));
+  ASSERT_OK(CheckRowPresent(*mrs, "row 002000", &present));
+  ASSERT_TRUE(present);
+
+  // Scans should return the rows of both stores, in key order.
+  vector<string> rows;
+  ASSERT_OK(DumpRowSet(*mrs, schema_, snapshot_after_delete, &rows));
+  ASSERT_EQ(kNumRows - 1, rows.size());
+  ASSERT_OK(DumpRowSet(*mrs, schema_, MvccSnapshot(mvcc_), &rows));
+  ASSERT_EQ(kNumRows, rows.size());
+  for (int i = 0; i < kNumRows; i++) {
+    uint32_t val = i;
+    if (i == 1500) val = 12345;
+    if (i == 2000) val = 54321;
+    ASSERT_EQ(StringPrintf(R"((string key="row %06d", uint32 val=%d))", i, val),
+              rows[i]);
+  }
+}
+
+TEST_F(TestMemRowSet, TestCompactRowFormat) {
+  FLAGS_mrs_compact_row_format = true;
+  SchemaBuilder builder;
+  ASSERT_OK(builder.AddKeyColumn("key", STRING));
+  ASSERT_OK(builder.AddNullableColumn("val", STRING));
+  ASSERT_OK(builder.AddColumn("num", UINT32));
+  Schema schema = builder.Build();
+  shared_ptr<MemRowSet> mrs;
+  ASSERT_OK(MemRowSet::Create(0, schema, log_anchor_registry_.get(),
+                              MemTracker::GetRootTracker(), &mrs));
+
+  // Values which are null, short enough to be inline, just too long to be
+  // inline, and long.
+  auto val = [](int i) -> string {
+    switch (i % 4) {
+      case 0: return "";
+      case 1: return StringPrintf("v%d", i % 1000);
+      case 2: return StringPrintf("v%07d", i);
+      default: return StringPrintf("a long value, %d", i);
+    }
+  };
+  const int kNumRows = 1000;
+  for (int i = 0; i < kNumRows; i++) {
+    ScopedTransaction tx(&mvcc_, clock_->Now());
+    RowBuilder rb(schema);
+    rb.AddString(StringPrintf("k%d", i));
+    if (i % 4 == 0) {
+      rb.AddNull();
+    } else {
+      rb.AddString(val(i));
+    }
+    rb.AddUint32(i);
+    tx.StartApplying();
+    ASSERT_OK(mrs->Insert(tx.timestamp(), rb.row(), op_id_));
+    tx.Commit();
+  }
+
+  // Updates apply to the materialized rows.
+  {
+    ScopedTransaction tx(&mvcc_, clock_->Now());
+    tx.StartApplying();
+    faststring buf;
+    RowChangeListEncoder update(&buf);
+    Slice new_val("updated");
+    update.AddColumnUpdate(schema.column(1), schema.column_id(1), &new_val);
+    RowBuilder rb(schema.CreateKeyProjection());
+    rb.AddString(Slice("k1"));
+    RowSetKeyProbe probe(rb.row());
+    ProbeStats stats;
+    OperationResultPB result;
+    ASSERT_OK(mrs->MutateRow(tx.timestamp(), probe, RowChangeList(buf), op_id_,
+                             &stats, &result));
+    tx.Commit();
+  }
+
+  vector<string> rows;
+  ASSERT_OK(DumpRowSet(*mrs, schema, MvccSnapshot(mvcc_), &rows));
+  ASSERT_EQ(kNumRows, rows.size());
+  std::sort(rows.begin(), rows.end());
+  vector<string> expected;
+  for (int i = 0; i < kNumRows; i++) {
+    string v = i % 4 == 0 ? "NULL" : StringPrintf("\"%s\"", i == 1 ? "updated" : val(i).c_str());
+    expected.push_back(StringPrintf(R"((string key="k%d", string val=%s, uint32 num=%d))",
+                                    i, v.c_str(), i));
+  }
+  std::sort(expected.begin(), expected.end());
+  ASSERT_EQ(expected, rows);
+}
+
 } // namespace tablet
 } // namespace kudu
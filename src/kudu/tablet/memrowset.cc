@@ -17,6 +17,8 @@
 
 #include "kudu/tablet/memrowset.h"
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -25,6 +27,7 @@
 #include <glog/logging.h>
 
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/predicate_evaluator.h"
 #include "kudu/codegen/row_projector.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/generic_iterators.h"
@@ -32,8 +35,11 @@
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/gutil/dynamic_annotations.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/inline_slice.h"
+#include "kudu/util/key_compare.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/overwrite.h"
 
@@ -41,6 +47,34 @@ DEFINE_bool(mrs_use_codegen, true, "whether the memrowset should use code "
             "generation for iteration");
 TAG_FLAG(mrs_use_codegen, hidden);
 
+DEFINE_bool(mrs_codegen_predicates, false,
+            "Whether memrowset iterators should evaluate the column predicates of "
+            "scans using compiled code, once it has been compiled for the shape "
+            "of the predicates. Requires --mrs_use_codegen.");
+TAG_FLAG(mrs_codegen_predicates, experimental);
+
+DEFINE_bool(mrs_columnar_append_store, false,
+            "Whether the memrowset should store rows which are inserted in "
+            "increasing key order (e.g. time series data) in columnar chunks, "
+            "rather than in its b-tree. This uses less memory per row for "
+            "append-mostly workloads.");
+TAG_FLAG(mrs_columnar_append_store, experimental);
+
+DEFINE_bool(mrs_compact_row_format, false,
+            "Whether new memrowsets store their rows in a compact format, in "
+            "which strings of up to 7 bytes are stored inline in the row, and "
+            "each string cell takes 8 rather than 16 bytes. This uses less "
+            "memory per row for tables with many string columns, at the cost of "
+            "materializing each row when it's read.");
+TAG_FLAG(mrs_compact_row_format, experimental);
+
+DEFINE_bool(memstore_per_cpu_arenas, false,
+            "Whether memrowsets and deltamemstores should allocate from one arena "
+            "slab per CPU, rather than from a single arena, so that concurrent "
+            "writers on different CPUs don't contend on the arena. Each slab grows "
+            "separately, so this increases the minimum footprint of a memory store.");
+TAG_FLAG(memstore_per_cpu_arenas, experimental);
+
 using std::pair;
 using std::shared_ptr;
 
@@ -53,15 +87,28 @@ using strings::Substitute;
 static const int kInitialArenaSize = 16;
 static const int kMaxArenaBufferSize = 8*1024*1024;
 
-bool MRSRow::IsGhost() const {
+namespace {
+
+// A BINARY cell of a row in the compact format.
+typedef InlineSlice<sizeof(uint8_t*)> CompactStringCell;
+
+// Returns the size of the cells of 'col' in the compact format.
+size_t CompactCellSize(const ColumnSchema& col) {
+  return col.type_info()->physical_type() == BINARY ? sizeof(CompactStringCell)
+                                                    : col.type_info()->size();
+}
+
+// Return true if the most recent mutation in the list starting at 'redo_head'
+// is a deletion.
+bool IsGhostMutationList(const Schema& schema, const Mutation* redo_head) {
   bool is_ghost = false;
-  for (const Mutation *mut = header_->redo_head;
+  for (const Mutation *mut = redo_head;
        mut != nullptr;
        mut = mut->next()) {
     RowChangeListDecoder decoder(mut->changelist());
     Status s = decoder.Init();
     if (!PREDICT_TRUE(s.ok())) {
-      LOG(FATAL) << "Failed to decode: " << mut->changelist().ToString(*schema())
+      LOG(FATAL) << "Failed to decode: " << mut->changelist().ToString(schema)
                   << " (" << s.ToString() << ")";
     }
     if (decoder.is_delete()) {
@@ -75,6 +122,12 @@ bool MRSRow::IsGhost() const {
   return is_ghost;
 }
 
+} // anonymous namespace
+
+bool MRSRow::IsGhost() const {
+  return IsGhostMutationList(*schema(), header_->redo_head);
+}
+
 namespace {
 
 shared_ptr<MemTracker> CreateMemTrackerForMemRowSet(
@@ -103,15 +156,31 @@ MemRowSet::MemRowSet(int64_t id,
                      shared_ptr<MemTracker> parent_tracker)
   : id_(id),
     schema_(schema),
-    allocator_(new MemoryTrackingBufferAllocator(HeapBufferAllocator::Get(),
+    allocator_(new MemoryTrackingBufferAllocator(DefaultArenaBufferAllocator(),
                                                  CreateMemTrackerForMemRowSet(id, parent_tracker))),
-    arena_(new ThreadSafeMemoryTrackingArena(kInitialArenaSize, kMaxArenaBufferSize,
-                                             allocator_)),
+    arena_(new ShardedMemoryTrackingArena(kInitialArenaSize, kMaxArenaBufferSize,
+                                          allocator_,
+                                          FLAGS_memstore_per_cpu_arenas ? base::NumCPUs() : 1)),
     tree_(arena_),
+    compact_row_size_(0),
     debug_insert_count_(0),
     debug_update_count_(0),
+    max_insertion_timestamp_(Timestamp::kMin.value()),
+    has_deletes_(false),
     anchorer_(log_anchor_registry, Substitute("MemRowSet-$0", id_)) {
   CHECK(schema.has_column_ids());
+  if (FLAGS_mrs_columnar_append_store) {
+    columnar_.reset(new ColumnarMemStore(&schema_, arena_));
+  }
+  if (FLAGS_mrs_compact_row_format) {
+    size_t offset = 0;
+    for (const ColumnSchema& col : schema_.columns()) {
+      compact_offsets_.push_back(offset);
+      offset += CompactCellSize(col);
+    }
+    compact_offsets_.push_back(offset);
+    compact_row_size_ = offset + ContiguousRowHelper::null_bitmap_size(schema_);
+  }
   ANNOTATE_BENIGN_RACE(&debug_insert_count_, "insert count isnt accurate");
   ANNOTATE_BENIGN_RACE(&debug_update_count_, "update count isnt accurate");
 }
@@ -142,11 +211,33 @@ Status MemRowSet::Insert(Timestamp timestamp,
   CHECK(row.schema()->has_column_ids());
   DCHECK_SCHEMA_EQ(schema_, *row.schema());
 
+  max_insertion_timestamp_.StoreMax(timestamp.value(), kMemOrderBarrier);
+
   {
     faststring enc_key_buf;
     schema_.EncodeComparableKey(row, &enc_key_buf);
     Slice enc_key(enc_key_buf);
 
+    // Rows which sort after everything in the columnar store are appended
+    // to it. A row which doesn't may still collide with one of its rows.
+    if (columnar_) {
+      bool appended;
+      RETURN_NOT_OK(columnar_->Append(timestamp, row, enc_key, &appended));
+      if (appended) {
+        anchorer_.AnchorIfMinimum(op_id.index());
+        debug_insert_count_++;
+        return Status::OK();
+      }
+      rowid_t idx;
+      if (columnar_->Find(enc_key, &idx)) {
+        Mutation** redo_head = columnar_->mutable_redo_head(idx);
+        if (!IsGhostMutationList(schema_, *redo_head)) {
+          return Status::AlreadyPresent("key already present");
+        }
+        return Reinsert(timestamp, row, redo_head);
+      }
+    }
+
     btree::PreparedMutation<MSBTreeTraits> mutation(enc_key);
     mutation.Prepare(&tree_);
 
@@ -164,19 +255,31 @@ Status MemRowSet::Insert(Timestamp timestamp,
       }
 
       // Insert a "reinsert" mutation.
-      return Reinsert(timestamp, row, &ms_row);
+      return Reinsert(timestamp, row, &ms_row.header_->redo_head);
     }
 
-    // Copy the non-encoded key onto the stack since we need
-    // to mutate it when we relocate its Slices into our arena.
-    DEFINE_MRSROW_ON_STACK(this, mrsrow, mrsrow_slice);
-    mrsrow.header_->insertion_timestamp = timestamp;
-    mrsrow.header_->redo_head = nullptr;
-    RETURN_NOT_OK(mrsrow.CopyRow(row, arena_.get()));
-
-    CHECK(mutation.Insert(mrsrow_slice))
-    << "Expected to be able to insert, since the prepared mutation "
-    << "succeeded!";
+    if (compact_rows()) {
+      size_t size = sizeof(MRSRow::Header) + compact_row_size_;
+      uint8_t storage[size];
+      auto* header = reinterpret_cast<MRSRow::Header*>(storage);
+      header->insertion_timestamp = timestamp;
+      header->redo_head = nullptr;
+      EncodeCompactRow(row, storage + sizeof(MRSRow::Header));
+      CHECK(mutation.Insert(Slice(storage, size)))
+      << "Expected to be able to insert, since the prepared mutation "
+      << "succeeded!";
+    } else {
+      // Copy the non-encoded key onto the stack since we need
+      // to mutate it when we relocate its Slices into our arena.
+      DEFINE_MRSROW_ON_STACK(this, mrsrow, mrsrow_slice);
+      mrsrow.header_->insertion_timestamp = timestamp;
+      mrsrow.header_->redo_head = nullptr;
+      RETURN_NOT_OK(mrsrow.CopyRow(row, arena_.get()));
+
+      CHECK(mutation.Insert(mrsrow_slice))
+      << "Expected to be able to insert, since the prepared mutation "
+      << "succeeded!";
+    }
   }
 
   anchorer_.AnchorIfMinimum(op_id.index());
@@ -185,7 +288,43 @@ Status MemRowSet::Insert(Timestamp timestamp,
   return Status::OK();
 }
 
-Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row, MRSRow *ms_row) {
+void MemRowSet::EncodeCompactRow(const ConstContiguousRow& row, uint8_t* dst) {
+  for (size_t i = 0; i < schema_.num_columns(); i++) {
+    const ColumnSchema& col = schema_.column(i);
+    uint8_t* cell = dst + compact_offsets_[i];
+    if (col.is_nullable() && row.is_null(i)) {
+      memset(cell, 0, CompactCellSize(col));
+    } else if (col.type_info()->physical_type() == BINARY) {
+      reinterpret_cast<CompactStringCell*>(cell)->set(
+          *reinterpret_cast<const Slice*>(row.cell_ptr(i)), arena_.get());
+    } else {
+      memcpy(cell, row.cell_ptr(i), col.type_info()->size());
+    }
+  }
+  memcpy(dst + compact_offsets_.back(),
+         row.row_data() + schema_.byte_size(),
+         ContiguousRowHelper::null_bitmap_size(schema_));
+}
+
+void MemRowSet::DecodeCompactRow(const uint8_t* src, uint8_t* row_data) const {
+  for (size_t i = 0; i < schema_.num_columns(); i++) {
+    const ColumnSchema& col = schema_.column(i);
+    const uint8_t* cell = src + compact_offsets_[i];
+    uint8_t* dst = row_data + schema_.column_offset(i);
+    if (col.type_info()->physical_type() == BINARY) {
+      Slice s = reinterpret_cast<const CompactStringCell*>(cell)->as_slice();
+      memcpy(dst, &s, sizeof(s));
+    } else {
+      memcpy(dst, cell, col.type_info()->size());
+    }
+  }
+  memcpy(row_data + schema_.byte_size(),
+         src + compact_offsets_.back(),
+         ContiguousRowHelper::null_bitmap_size(schema_));
+}
+
+Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row,
+                           Mutation** redo_head) {
   DCHECK_SCHEMA_EQ(schema_, *row.schema());
 
   // Encode the REINSERT mutation
@@ -200,7 +339,7 @@ Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row, M
   // This function has "release" semantics which ensures that the memory writes
   // for the mutation are fully published before any concurrent reader sees
   // the appended mutation.
-  mut->AppendToListAtomic(&ms_row->header_->redo_head);
+  mut->AppendToListAtomic(redo_head);
   return Status::OK();
 }
 
@@ -212,28 +351,39 @@ Status MemRowSet::MutateRow(Timestamp timestamp,
                             OperationResultPB *result) {
   {
     btree::PreparedMutation<MSBTreeTraits> mutation(probe.encoded_key_slice());
-    mutation.Prepare(&tree_);
+    Mutation** redo_head;
+    rowid_t idx;
+    if (FindInColumnarStore(probe.encoded_key_slice(), &idx)) {
+      redo_head = columnar_->mutable_redo_head(idx);
+    } else {
+      mutation.Prepare(&tree_);
 
-    if (!mutation.exists()) {
-      return Status::NotFound("not in memrowset");
-    }
+      if (!mutation.exists()) {
+        return Status::NotFound("not in memrowset");
+      }
 
-    MRSRow row(this, mutation.current_mutable_value());
+      MRSRow row(this, mutation.current_mutable_value());
+      redo_head = &row.header_->redo_head;
+    }
 
     // If the row exists, it may still be a "ghost" row -- i.e a row
     // that's been deleted. If that's the case, we should treat it as
     // NotFound.
-    if (row.IsGhost()) {
+    if (IsGhostMutationList(schema_, *redo_head)) {
       return Status::NotFound("not in memrowset (ghost)");
     }
 
+    if (delta.is_delete()) {
+      has_deletes_.Store(true);
+    }
+
     // Append to the linked list of mutations for this row.
     Mutation *mut = Mutation::CreateInArena(arena_.get(), timestamp, delta);
 
     // This function has "release" semantics which ensures that the memory writes
     // for the mutation are fully published before any concurrent reader sees
     // the appended mutation.
-    mut->AppendToListAtomic(&row.header_->redo_head);
+    mut->AppendToListAtomic(redo_head);
 
     MemStoreTargetPB* target = result->add_mutated_stores();
     target->set_mrs_id(id_);
@@ -246,6 +396,24 @@ Status MemRowSet::MutateRow(Timestamp timestamp,
   return Status::OK();
 }
 
+Status MemRowSet::CountLiveRows(const MvccSnapshot& snap, bool* counted,
+                                rowid_t* count) const {
+  *counted = false;
+  if (has_deletes_.Load()) {
+    return Status::OK();
+  }
+  // Read the count before the timestamp, so that the timestamp covers every
+  // counted row.
+  uint64_t entries = entry_count();
+  Timestamp max_ts(max_insertion_timestamp_.Load(kMemOrderAcquire));
+  if (snap.MayHaveUncommittedTransactionsAtOrBefore(max_ts)) {
+    return Status::OK();
+  }
+  *count = entries;
+  *counted = true;
+  return Status::OK();
+}
+
 Status MemRowSet::CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                                   ProbeStats* stats) const {
   // Use a PreparedMutation here even though we don't plan to mutate. Even though
@@ -254,6 +422,12 @@ Status MemRowSet::CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
 
   stats->mrs_consulted++;
 
+  rowid_t idx;
+  if (FindInColumnarStore(probe.encoded_key_slice(), &idx)) {
+    *present = !IsGhostMutationList(schema_, columnar_->acquire_redo_head(idx));
+    return Status::OK();
+  }
+
   btree::PreparedMutation<MSBTreeTraits> mutation(probe.encoded_key_slice());
   mutation.Prepare(const_cast<MSBTree *>(&tree_));
 
@@ -301,6 +475,16 @@ Status MemRowSet::NewCompactionInput(const Schema* projection,
   return Status::OK();
 }
 
+Status MemRowSet::NewCompactionInputForRange(const Schema* projection,
+                                             const MvccSnapshot& snap,
+                                             const Slice& lower_bound,
+                                             const Slice& exclusive_upper_bound,
+                                             gscoped_ptr<CompactionInput>* out) const  {
+  out->reset(CompactionInput::Create(*this, projection, snap, lower_bound,
+                                     exclusive_upper_bound));
+  return Status::OK();
+}
+
 Status MemRowSet::GetBounds(string *min_encoded_key,
                             string *max_encoded_key) const {
   return Status::NotSupported("");
@@ -378,6 +562,9 @@ MemRowSet::Iterator::Iterator(const std::shared_ptr<const MemRowSet>& mrs,
                               const Schema* projection, MvccSnapshot mvcc_snap)
     : memrowset_(mrs),
       iter_(iter),
+      columnar_(mrs->columnar_.get()),
+      col_idx_(0),
+      col_end_(columnar_ ? columnar_->num_rows() : 0),
       mvcc_snap_(std::move(mvcc_snap)),
       projection_(projection),
       projector_(
@@ -389,6 +576,7 @@ MemRowSet::Iterator::Iterator(const std::shared_ptr<const MemRowSet>& mrs,
   // seek. Could make this lazy instead, or change the semantics so that
   // a seek is required (probably the latter)
   iter_->SeekToStart();
+  SeekColumnar(0);
 }
 
 MemRowSet::Iterator::~Iterator() {}
@@ -399,10 +587,38 @@ Status MemRowSet::Iterator::Init(ScanSpec *spec) {
   RETURN_NOT_OK(projector_->Init());
   RETURN_NOT_OK(delta_projector_.Init());
 
+  if (spec && FLAGS_mrs_use_codegen && FLAGS_mrs_codegen_predicates) {
+    vector<ColumnPredicate> predicates;
+    for (const auto& entry : spec->predicates()) {
+      if (projection_->find_column(entry.first) != Schema::kColumnNotFound &&
+          codegen::PredicateEvaluatorFunctions::IsSupported(entry.second)) {
+        predicates.push_back(entry.second);
+      }
+    }
+    // Order the predicates by column so that scans with the same predicates
+    // share a compiled function.
+    std::sort(predicates.begin(), predicates.end(),
+              [] (const ColumnPredicate& a, const ColumnPredicate& b) {
+                return a.column().name() < b.column().name();
+              });
+    if (!predicates.empty() &&
+        codegen::CompilationManager::GetSingleton()->RequestPredicateEvaluator(
+            projection_, predicates, &predicate_evaluator_)) {
+      // The remaining predicates, if any, are evaluated by the caller.
+      for (const ColumnPredicate& pred : predicate_evaluator_->predicates()) {
+        spec->RemovePredicate(pred.column().name());
+      }
+    }
+  }
+
   if (spec && spec->lower_bound_key()) {
     bool exact;
     const Slice &lower_bound = spec->lower_bound_key()->encoded_key();
-    if (!iter_->SeekAtOrAfter(lower_bound, &exact)) {
+    iter_->SeekAtOrAfter(lower_bound, &exact);
+    if (columnar_) {
+      SeekColumnar(columnar_->LowerBound(lower_bound));
+    }
+    if (!IsValid()) {
       // Lower bound is after the end of the key range, no rows will
       // pass the predicate so we can stop the scan right away.
       state_ = kFinished;
@@ -430,8 +646,15 @@ Status MemRowSet::Iterator::SeekAtOrAfter(const Slice &key, bool *exact) {
     tmp_buf.resize(0);
   }
 
-  if (iter_->SeekAtOrAfter(Slice(tmp_buf), exact) ||
-      key.size() == 0) {
+  bool tree_valid = iter_->SeekAtOrAfter(Slice(tmp_buf), exact);
+  if (columnar_) {
+    SeekColumnar(columnar_->LowerBound(Slice(tmp_buf)));
+    if (col_idx_ < col_end_ && Slice(col_key_) == Slice(tmp_buf)) {
+      *exact = true;
+    }
+  }
+
+  if (IsValid() || key.size() == 0) {
     return Status::OK();
   } else {
     return Status::NotFound("no match in memrowset");
@@ -443,7 +666,7 @@ Status MemRowSet::Iterator::NextBlock(RowBlock *dst) {
   // also above TODO applies to a lot of other CopyNextRows cases
 
   DCHECK_NE(state_, kUninitialized) << "not initted";
-  if (PREDICT_FALSE(!iter_->IsValid())) {
+  if (PREDICT_FALSE(!IsValid())) {
     dst->Resize(0);
     return Status::NotFound("end of iter");
   }
@@ -472,21 +695,24 @@ Status MemRowSet::Iterator::NextBlock(RowBlock *dst) {
   // Clear unreached bits by resizing
   dst->Resize(fetched);
 
+  if (predicate_evaluator_ && fetched > 0) {
+    predicate_evaluator_->Evaluate(dst);
+  }
+
   return Status::OK();
 }
 
 Status MemRowSet::Iterator::FetchRows(RowBlock* dst, size_t* fetched) {
   *fetched = 0;
   do {
-    Slice k, v;
     RowBlockRow dst_row = dst->row(*fetched);
 
     // Copy the row into the destination, including projection
     // and relocating slices.
     // TODO: can we share some code here with CopyRowToArena() from row.h
     // or otherwise put this elsewhere?
-    iter_->GetCurrentEntry(&k, &v);
-    MRSRow row(memrowset_.get(), v);
+    Slice k = CurrentKey();
+    MRSRow row = GetCurrentRow();
 
     if (mvcc_snap_.IsCommitted(row.insertion_timestamp())) {
       if (has_upper_bound() && out_of_bounds(k)) {
@@ -516,11 +742,92 @@ Status MemRowSet::Iterator::FetchRows(RowBlock* dst, size_t* fetched) {
     }
 
     ++*fetched;
-  } while (iter_->Next() && *fetched < dst->nrows());
+  } while (Next() && *fetched < dst->nrows());
 
   return Status::OK();
 }
 
+bool MemRowSet::Iterator::IsColumnarCurrent() const {
+  if (col_idx_ >= col_end_) {
+    return false;
+  }
+  if (!iter_->IsValid()) {
+    return true;
+  }
+  Slice k, v;
+  iter_->GetCurrentEntry(&k, &v);
+  return CompareKeys(col_key_, k) < 0;
+}
+
+Slice MemRowSet::Iterator::CurrentKey() const {
+  if (IsColumnarCurrent()) {
+    return Slice(col_key_);
+  }
+  Slice k, v;
+  iter_->GetCurrentEntry(&k, &v);
+  return k;
+}
+
+void MemRowSet::Iterator::SeekColumnar(rowid_t idx) {
+  col_idx_ = std::min(idx, col_end_);
+  if (col_idx_ < col_end_) {
+    columnar_->EncodeKey(col_idx_, &col_key_);
+  }
+}
+
+size_t MemRowSet::Iterator::remaining_in_leaf() const {
+  DCHECK_NE(state_, kUninitialized) << "not initted";
+  size_t remaining = std::numeric_limits<size_t>::max();
+  if (iter_->IsValid()) {
+    remaining = iter_->remaining_in_leaf();
+  }
+  if (col_idx_ < col_end_) {
+    remaining = std::min<size_t>(
+        remaining,
+        std::min(columnar_->remaining_in_chunk(col_idx_), col_end_ - col_idx_));
+  }
+  return remaining;
+}
+
+const MRSRow MemRowSet::Iterator::GetCurrentRow() const {
+  DCHECK_NE(state_, kUninitialized) << "not initted";
+  const Schema& schema = memrowset_->schema_nonvirtual();
+  if (!IsColumnarCurrent()) {
+    Slice dummy, mrsrow_data;
+    iter_->GetCurrentEntry(&dummy, &mrsrow_data);
+    if (!memrowset_->compact_rows()) {
+      return MRSRow(memrowset_.get(), mrsrow_data);
+    }
+    // The header stays in the b-tree, so that mutations appended to the row
+    // are seen as before.
+    size_t size = ContiguousRowHelper::row_size(schema);
+    col_row_buf_.resize(size);
+    memrowset_->DecodeCompactRow(mrsrow_data.data() + sizeof(MRSRow::Header),
+                                 col_row_buf_.data());
+    return MRSRow(memrowset_.get(),
+                  reinterpret_cast<MRSRow::Header*>(mrsrow_data.mutable_data()),
+                  Slice(col_row_buf_.data(), size));
+  }
+
+  size_t size = sizeof(MRSRow::Header) + ContiguousRowHelper::row_size(schema);
+  col_row_buf_.resize(size);
+  auto* header = reinterpret_cast<MRSRow::Header*>(col_row_buf_.data());
+  header->insertion_timestamp = columnar_->insertion_timestamp(col_idx_);
+  header->redo_head = columnar_->acquire_redo_head(col_idx_);
+  columnar_->CopyRow(col_idx_, col_row_buf_.data() + sizeof(MRSRow::Header));
+  return MRSRow(memrowset_.get(), Slice(col_row_buf_.data(), size));
+}
+
+bool MemRowSet::Iterator::Next() {
+  DCHECK_NE(state_, kUninitialized) << "not initted";
+  if (IsColumnarCurrent()) {
+    SeekColumnar(col_idx_ + 1);
+  } else {
+    iter_->Next();
+  }
+  return IsValid();
+}
+
 Status MemRowSet::Iterator::ApplyMutationsToProjectedRow(
   const Mutation *mutation_head, RowBlockRow *dst_row, Arena *dst_arena) {
   // Fast short-circuit the likely case of a row which was inserted and never
@@ -28,11 +28,13 @@
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/consensus/log_anchor_registry.h"
+#include "kudu/tablet/columnar_memstore.h"
 #include "kudu/tablet/concurrent_btree.h"
 #include "kudu/tablet/mutation.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/tablet/tablet.pb.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/memory/memory.h"
@@ -42,6 +44,10 @@ namespace kudu {
 
 class MemTracker;
 
+namespace codegen {
+class PredicateEvaluator;
+} // namespace codegen
+
 namespace tablet {
 
 //
@@ -56,6 +62,11 @@ namespace tablet {
 // of the row's primary key, such that the entries sort correctly using the default
 // lexicographic comparator. The value for each row is an instance of MRSRow.
 //
+// If --mrs_columnar_append_store is set, rows which are inserted in increasing
+// key order are instead appended to a ColumnarMemStore, and only out-of-order
+// rows go into the CBTree. Iterators merge the two in key order. A given key
+// is only ever present in one of them.
+//
 // NOTE: all allocations done by the MemRowSet are done inside its associated
 // thread-safe arena, and then freed in bulk when the MemRowSet is destructed.
 
@@ -149,6 +160,15 @@ class MRSRow {
     Mutation* redo_head;
   };
 
+  // Constructs a row whose header is at 'header' and whose data, of the
+  // memrowset's schema, is 'row_slice', e.g. a row materialized from the
+  // compact format.
+  MRSRow(const MemRowSet *memrowset, Header *header, const Slice &row_slice)
+    : header_(header),
+      row_slice_(row_slice),
+      memrowset_(memrowset) {
+  }
+
   Header *header_;
 
   // Actual row data.
@@ -158,7 +178,7 @@ class MRSRow {
 };
 
 struct MSBTreeTraits : public btree::BTreeTraits {
-  typedef ThreadSafeMemoryTrackingArena ArenaType;
+  typedef ShardedMemoryTrackingArena ArenaType;
 };
 
 // Define an MRSRow instance using on-stack storage.
@@ -221,7 +241,7 @@ class MemRowSet : public RowSet,
   // NOTE: this requires iterating all data, and is thus
   // not very fast.
   uint64_t entry_count() const {
-    return tree_.count();
+    return tree_.count() + (columnar_ ? columnar_->num_rows() : 0);
   }
 
   // Conform entry_count to RowSet
@@ -230,6 +250,11 @@ class MemRowSet : public RowSet,
     return Status::OK();
   }
 
+  // The rows can be counted without a scan as long as none were deleted and
+  // every insertion is committed in 'snap'.
+  Status CountLiveRows(const MvccSnapshot& snap, bool* counted,
+                       rowid_t* count) const OVERRIDE;
+
   virtual Status GetBounds(std::string *min_encoded_key,
                            std::string *max_encoded_key) const OVERRIDE;
 
@@ -246,9 +271,18 @@ class MemRowSet : public RowSet,
     return false;
   }
 
+  // Collect up to 'max_keys' encoded keys which split this memrowset's key
+  // space into ranges of roughly equal size, in increasing order. Only the
+  // rows in the CBTree are considered, not those in the columnar store.
+  //
+  // Must not be called concurrently with inserts.
+  void GetSplitKeys(int max_keys, std::vector<std::string>* encoded_keys) const {
+    tree_.GetSplitKeys(max_keys, encoded_keys);
+  }
+
   // Return true if there are no entries in the memrowset.
   bool empty() const {
-    return tree_.empty();
+    return tree_.empty() && (!columnar_ || columnar_->empty());
   }
 
   // TODO: unit test me
@@ -285,6 +319,12 @@ class MemRowSet : public RowSet,
                                     const MvccSnapshot& snap,
                                     gscoped_ptr<CompactionInput>* out) const OVERRIDE;
 
+  virtual Status NewCompactionInputForRange(const Schema* projection,
+                                            const MvccSnapshot& snap,
+                                            const Slice& lower_bound,
+                                            const Slice& exclusive_upper_bound,
+                                            gscoped_ptr<CompactionInput>* out) const OVERRIDE;
+
   // Return the Schema for the rows in this memrowset.
    const Schema &schema() const {
     return schema_;
@@ -351,10 +391,34 @@ class MemRowSet : public RowSet,
             std::shared_ptr<MemTracker> parent_tracker);
 
   // Perform a "Reinsert" -- handle an insertion into a row which was previously
-  // inserted and deleted, but still has an entry in the MemRowSet.
+  // inserted and deleted, but still has an entry in the MemRowSet. 'redo_head'
+  // is the head of the row's mutation list.
   Status Reinsert(Timestamp timestamp,
                   const ConstContiguousRow& row,
-                  MRSRow *ms_row);
+                  Mutation** redo_head);
+
+  // Whether the b-tree stores rows in the compact format, which was chosen
+  // by --mrs_compact_row_format when the memrowset was created.
+  //
+  // In the compact format, each BINARY cell is an 8-byte InlineSlice rather
+  // than a 16-byte Slice: values of up to 7 bytes are stored in the cell
+  // itself, and longer ones are stored in the arena behind a 4-byte length.
+  // The other cells, and the null bitmap, are stored as in a
+  // ContiguousRow. Rows are materialized in the usual format when read.
+  bool compact_rows() const { return !compact_offsets_.empty(); }
+
+  // Encodes 'row' in the compact format at 'dst', which must have room for
+  // compact_row_size_ bytes. Long BINARY values are copied into the arena.
+  void EncodeCompactRow(const ConstContiguousRow& row, uint8_t* dst);
+
+  // Decodes the compact row at 'src' into 'row_data', which must have room
+  // for a row of the schema. The BINARY cells point into 'src' or the arena.
+  void DecodeCompactRow(const uint8_t* src, uint8_t* row_data) const;
+
+  // Look up 'enc_key' in the columnar store, if there is one.
+  bool FindInColumnarStore(const Slice& enc_key, rowid_t* idx) const {
+    return columnar_ && columnar_->Find(enc_key, idx);
+  }
 
   typedef btree::CBTree<MSBTreeTraits> MSBTree;
 
@@ -362,18 +426,35 @@ class MemRowSet : public RowSet,
 
   const Schema schema_;
   std::shared_ptr<MemoryTrackingBufferAllocator> allocator_;
-  std::shared_ptr<ThreadSafeMemoryTrackingArena> arena_;
+  std::shared_ptr<ShardedMemoryTrackingArena> arena_;
 
   typedef btree::CBTreeIterator<MSBTreeTraits> MSBTIter;
 
   MSBTree tree_;
 
+  // Storage for rows inserted in key order, or NULL if
+  // --mrs_columnar_append_store is disabled.
+  gscoped_ptr<ColumnarMemStore> columnar_;
+
+  // The offset of each column's cell in the compact format, followed by
+  // the offset of the null bitmap, and the size of a compact row. Empty
+  // unless the rows are stored in the compact format.
+  std::vector<size_t> compact_offsets_;
+  size_t compact_row_size_;
+
   // Approximate counts of mutations. This variable is updated non-atomically,
   // so it cannot be relied upon to be in any way accurate. It's only used
   // as a sanity check during flush.
   volatile uint64_t debug_insert_count_;
   volatile uint64_t debug_update_count_;
 
+  // The highest timestamp of any insertion, stored before the row becomes
+  // visible in 'tree_' or 'columnar_'.
+  AtomicInt<uint64_t> max_insertion_timestamp_;
+
+  // Whether any row has been deleted.
+  AtomicBool has_deletes_;
+
   std::mutex compact_flush_lock_;
 
   log::MinLogIndexAnchorer anchorer_;
@@ -413,24 +494,27 @@ class MemRowSet::Iterator : public RowwiseIterator {
     return key.compare(*exclusive_upper_bound_) >= 0;
   }
 
-  size_t remaining_in_leaf() const {
-    DCHECK_NE(state_, kUninitialized) << "not initted";
-    return iter_->remaining_in_leaf();
+  // Whether the current row is at or past the pushed down upper bound.
+  // Requires HasNext().
+  bool current_row_out_of_bounds() const {
+    return has_upper_bound() && out_of_bounds(CurrentKey());
   }
 
+  // The number of rows which may be consumed before the iterator moves to
+  // another CBTree leaf or columnar chunk.
+  size_t remaining_in_leaf() const;
+
   virtual bool HasNext() const OVERRIDE {
     DCHECK_NE(state_, kUninitialized) << "not initted";
-    return state_ != kFinished && iter_->IsValid();
+    return state_ != kFinished && IsValid();
   }
 
   // NOTE: This method will return a MRSRow with the MemRowSet schema.
   //       The row is NOT projected using the schema specified to the iterator.
-  const MRSRow GetCurrentRow() const {
-    DCHECK_NE(state_, kUninitialized) << "not initted";
-    Slice dummy, mrsrow_data;
-    iter_->GetCurrentEntry(&dummy, &mrsrow_data);
-    return MRSRow(memrowset_.get(), mrsrow_data);
-  }
+  //
+  // Rows from the columnar store are materialized into a buffer owned by the
+  // iterator, and are only valid until the iterator is advanced.
+  const MRSRow GetCurrentRow() const;
 
   // Copy the current MRSRow to the 'dst_row' provided using the iterator projection schema.
   Status GetCurrentRow(RowBlockRow* dst_row,
@@ -439,10 +523,7 @@ class MemRowSet::Iterator : public RowwiseIterator {
                        Arena* mutation_arena,
                        Timestamp* insertion_timestamp);
 
-  bool Next() {
-    DCHECK_NE(state_, kUninitialized) << "not initted";
-    return iter_->Next();
-  }
+  bool Next();
 
   string ToString() const OVERRIDE {
     return "memrowset iterator";
@@ -478,6 +559,21 @@ class MemRowSet::Iterator : public RowwiseIterator {
            MemRowSet::MSBTIter *iter, const Schema *projection,
            MvccSnapshot mvcc_snap);
 
+  // Whether either of the CBTree or the columnar store has rows left.
+  bool IsValid() const {
+    return iter_->IsValid() || col_idx_ < col_end_;
+  }
+
+  // Whether the current row (the one with the lower key) comes from the
+  // columnar store rather than the CBTree.
+  bool IsColumnarCurrent() const;
+
+  // The encoded key of the current row.
+  Slice CurrentKey() const;
+
+  // Move the columnar cursor to row 'idx', loading its key.
+  void SeekColumnar(rowid_t idx);
+
   // Various helper functions called while getting the next RowBlock
   Status FetchRows(RowBlock* dst, size_t* fetched);
   Status ApplyMutationsToProjectedRow(const Mutation *mutation_head,
@@ -487,6 +583,16 @@ class MemRowSet::Iterator : public RowwiseIterator {
   const std::shared_ptr<const MemRowSet> memrowset_;
   gscoped_ptr<MemRowSet::MSBTIter> iter_;
 
+  // Cursor into the MemRowSet's columnar store, if any: 'col_idx_' is the next
+  // row, whose encoded key is in 'col_key_', and 'col_end_' bounds the rows
+  // visible to this iterator. 'col_row_buf_' holds the most recently
+  // materialized row.
+  const ColumnarMemStore* const columnar_;
+  rowid_t col_idx_;
+  const rowid_t col_end_;
+  faststring col_key_;
+  mutable faststring col_row_buf_;
+
   // The MVCC snapshot which determines which rows and mutations are visible to
   // this iterator.
   const MvccSnapshot mvcc_snap_;
@@ -513,6 +619,10 @@ class MemRowSet::Iterator : public RowwiseIterator {
 
   // Pushed down encoded upper bound key, if any
   boost::optional<const Slice &> exclusive_upper_bound_;
+
+  // Compiled evaluator of the predicates which were pushed down into this
+  // iterator, if any.
+  gscoped_ptr<codegen::PredicateEvaluator> predicate_evaluator_;
 };
 
 inline const Schema* MRSRow::schema() const {
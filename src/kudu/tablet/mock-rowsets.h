@@ -63,6 +63,11 @@ class MockRowSet : public RowSet {
     LOG(FATAL) << "Unimplemented";
     return Status::OK();
   }
+  virtual Status CountLiveRows(const MvccSnapshot& snap, bool* counted,
+                               rowid_t* count) const OVERRIDE {
+    LOG(FATAL) << "Unimplemented";
+    return Status::OK();
+  }
   virtual std::string ToString() const OVERRIDE {
     LOG(FATAL) << "Unimplemented";
     return "";
@@ -17,11 +17,30 @@
 
 #include "kudu/tablet/multi_column_writer.h"
 
+#include <algorithm>
+
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_id.h"
+#include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_bool(cfile_write_zone_maps, true,
+            "Whether to record per-block min/max zone maps in the column files "
+            "of flushed and compacted rowsets, allowing scans to skip blocks "
+            "which cannot match their predicates.");
+TAG_FLAG(cfile_write_zone_maps, experimental);
+
+DEFINE_int32(cfile_column_writer_threads, 0,
+             "Number of threads, shared by all flushes and compactions, on which "
+             "the columns of a rowset being written are encoded and compressed in "
+             "parallel. If 0, each rowset's columns are written serially by the "
+             "flushing or compacting thread.");
+TAG_FLAG(cfile_column_writer_threads, experimental);
 
 namespace kudu {
 namespace tablet {
@@ -30,6 +49,32 @@ using cfile::CFileWriter;
 using fs::ScopedWritableBlockCloser;
 using fs::WritableBlock;
 
+namespace {
+
+// Process-wide pool on which MultiColumnWriters append to their columns.
+class ColumnWriterPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<ColumnWriterPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<ColumnWriterPool>;
+
+  ColumnWriterPool() {
+    CHECK_OK(ThreadPoolBuilder("column-writer")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_cfile_column_writer_threads)
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnWriterPool);
+};
+
+} // anonymous namespace
+
 MultiColumnWriter::MultiColumnWriter(FsManager* fs,
                                      const Schema* schema)
   : fs_(fs),
@@ -58,9 +103,16 @@ Status MultiColumnWriter::Open() {
     // Index all columns by ordinal position, so we can match up
     // the corresponding rows.
     opts.write_posidx = true;
+    opts.write_zone_map = FLAGS_cfile_write_zone_maps;
 
     /// Set the column storage attributes.
     opts.storage_attributes = col.attributes();
+    if (opts.storage_attributes.cfile_block_size <= 0) {
+      const auto it = column_block_sizes_.find(schema_->column_id(i));
+      if (it != column_block_sizes_.end()) {
+        opts.storage_attributes.cfile_block_size = it->second;
+      }
+    }
 
     // If the schema has a single PK and this is the PK col
     if (i == 0 && schema_->num_key_columns() == 1) {
@@ -90,8 +142,8 @@ Status MultiColumnWriter::Open() {
   return Status::OK();
 }
 
-Status MultiColumnWriter::AppendBlock(const RowBlock& block) {
-  for (int i = 0; i < schema_->num_columns(); i++) {
+Status MultiColumnWriter::AppendColumns(const RowBlock& block, int first_col, int stride) {
+  for (int i = first_col; i < schema_->num_columns(); i += stride) {
     ColumnBlock column = block.column_block(i);
     if (column.is_nullable()) {
       RETURN_NOT_OK(cfile_writers_[i]->AppendNullableEntries(column.null_bitmap(),
@@ -103,6 +155,43 @@ Status MultiColumnWriter::AppendBlock(const RowBlock& block) {
   return Status::OK();
 }
 
+Status MultiColumnWriter::AppendBlock(const RowBlock& block) {
+  int num_tasks = std::min<int>(schema_->num_columns(), FLAGS_cfile_column_writer_threads + 1);
+  if (num_tasks <= 1) {
+    return AppendColumns(block, 0, 1);
+  }
+
+  // Split the columns between the tasks, so that each column's writer is
+  // only ever used by one thread at a time, and only while the block is
+  // being appended. Since we wait for all of the tasks before returning,
+  // each column's blocks are written in order, and at most one row block
+  // per column is in flight.
+  //
+  // The calling thread takes the first share of the columns itself.
+  ThreadPool* pool = ColumnWriterPool::Get();
+  vector<Status> statuses(num_tasks);
+  CountDownLatch latch(num_tasks - 1);
+  for (int t = 1; t < num_tasks; t++) {
+    Status* status = &statuses[t];
+    Status s = pool->SubmitFunc([this, &block, &latch, t, num_tasks, status]() {
+        *status = AppendColumns(block, t, num_tasks);
+        latch.CountDown();
+      });
+    if (PREDICT_FALSE(!s.ok())) {
+      // The pool is shutting down; do the work here instead.
+      statuses[t] = AppendColumns(block, t, num_tasks);
+      latch.CountDown();
+    }
+  }
+  statuses[0] = AppendColumns(block, 0, num_tasks);
+  latch.Wait();
+
+  for (const Status& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
+  return Status::OK();
+}
+
 Status MultiColumnWriter::Finish() {
   ScopedWritableBlockCloser closer;
   RETURN_NOT_OK(FinishAndReleaseBlocks(&closer));
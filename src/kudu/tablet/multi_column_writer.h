@@ -19,6 +19,7 @@
 
 #include <glog/logging.h>
 #include <map>
+#include <utility>
 #include <vector>
 
 #include "kudu/common/schema.h"
@@ -49,12 +50,26 @@ class MultiColumnWriter {
 
   virtual ~MultiColumnWriter();
 
+  // Sets the block sizes of the columns whose storage attributes don't
+  // specify one, keyed by column ID. The other columns are written with
+  // --cfile_default_block_size blocks.
+  //
+  // REQUIRES: Open() not yet called.
+  void set_column_block_sizes(std::map<ColumnId, int32_t> block_sizes) {
+    DCHECK(cfile_writers_.empty());
+    column_block_sizes_ = std::move(block_sizes);
+  }
+
   // Open and start writing the columns.
   Status Open();
 
   // Append the given block to the output columns.
   //
   // Note that the selection vector here is ignored.
+  //
+  // If --cfile_column_writer_threads is set, the columns are encoded and
+  // compressed in parallel on a shared thread pool. Either way, this returns
+  // only once all of the columns have consumed the block.
   Status AppendBlock(const RowBlock& block);
 
   // Close the in-progress files.
@@ -80,11 +95,17 @@ class MultiColumnWriter {
   void GetFlushedBlocksByColumnId(std::map<ColumnId, BlockId>* ret) const;
 
  private:
+  // Append the given block to the output columns with indexes 'first_col',
+  // 'first_col + stride', etc.
+  Status AppendColumns(const RowBlock& block, int first_col, int stride);
+
   FsManager* const fs_;
   const Schema* const schema_;
 
   bool finished_;
 
+  std::map<ColumnId, int32_t> column_block_sizes_;
+
   std::vector<cfile::CFileWriter *> cfile_writers_;
   std::vector<BlockId> block_ids_;
 
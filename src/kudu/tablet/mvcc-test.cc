@@ -15,10 +15,13 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
+#include <atomic>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/server/logical_clock.h"
@@ -27,6 +30,7 @@
 #include "kudu/util/test_util.h"
 
 using std::thread;
+using std::vector;
 
 namespace kudu {
 namespace tablet {
@@ -680,5 +684,95 @@ TEST_F(MvccTest, TestWaitUntilCleanDeadline) {
   ASSERT_TRUE(s.IsTimedOut()) << s.ToString();
 }
 
+// Test that snapshots are still correct once more transactions have committed
+// past the clean time than the published snapshot can hold.
+TEST_F(MvccTest, TestPublishedSnapshotOverflow) {
+  MvccManager mgr;
+
+  // Hold back the clean time with a transaction that stays in flight.
+  mgr.StartTransaction(Timestamp(1));
+  const int kNumCommits = MvccManager::PublishedSnapshot::kMaxCommittedTimestamps + 10;
+  for (int i = 0; i < kNumCommits; i++) {
+    Timestamp ts(i + 2);
+    mgr.StartTransaction(ts);
+    mgr.StartApplyingTransaction(ts);
+    mgr.CommitTransaction(ts);
+
+    MvccSnapshot snap;
+    mgr.TakeSnapshot(&snap);
+    ASSERT_EQ(mgr.cur_snap_.ToString(), snap.ToString());
+  }
+  ASSERT_TRUE(mgr.published_snap_.overflowed);
+
+  // Once the clean time moves past the committed set, the snapshot is
+  // published again.
+  mgr.AdjustSafeTime(Timestamp(kNumCommits + 1));
+  mgr.StartApplyingTransaction(Timestamp(1));
+  mgr.CommitTransaction(Timestamp(1));
+  ASSERT_FALSE(mgr.published_snap_.overflowed);
+
+  MvccSnapshot snap;
+  mgr.TakeSnapshot(&snap);
+  ASSERT_EQ(mgr.cur_snap_.ToString(), snap.ToString());
+  ASSERT_TRUE(snap.is_clean());
+  ASSERT_TRUE(snap.IsCommitted(Timestamp(kNumCommits + 1)));
+}
+
+// Test that snapshots taken concurrently with commits are consistent: a
+// transaction committed in one snapshot is committed in every later one.
+TEST_F(MvccTest, TestConcurrentSnapshots) {
+  MvccManager mgr;
+  const int kNumTxns = AllowSlowTests() ? 100000 : 10000;
+  std::atomic<bool> done(false);
+
+  auto reader = [&]() {
+    MvccSnapshot prev;
+    mgr.TakeSnapshot(&prev);
+    while (!done) {
+      MvccSnapshot snap;
+      mgr.TakeSnapshot(&snap);
+      CHECK(!snap.IsCommitted(Timestamp(kNumTxns + 1))) << snap.ToString();
+      for (int i = 1; i <= kNumTxns; i++) {
+        Timestamp ts(i);
+        if (!prev.MayHaveCommittedTransactionsAtOrAfter(ts)) break;
+        if (prev.IsCommitted(ts)) {
+          CHECK(snap.IsCommitted(ts)) << ts.ToString() << " was committed in "
+                                      << prev.ToString() << " but not in "
+                                      << snap.ToString();
+        }
+      }
+      prev = snap;
+    }
+  };
+
+  vector<thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back(reader);
+  }
+
+  // Commit the transactions in batches, out of order within each batch.
+  const int kBatchSize = 8;
+  for (int base = 1; base <= kNumTxns; base += kBatchSize) {
+    int end = std::min(base + kBatchSize, kNumTxns + 1);
+    for (int i = base; i < end; i++) {
+      mgr.StartTransaction(Timestamp(i));
+    }
+    mgr.AdjustSafeTime(Timestamp(end - 1));
+    for (int i = end - 1; i >= base; i--) {
+      mgr.StartApplyingTransaction(Timestamp(i));
+      mgr.CommitTransaction(Timestamp(i));
+    }
+  }
+  done = true;
+  for (auto& t : readers) {
+    t.join();
+  }
+
+  MvccSnapshot snap;
+  mgr.TakeSnapshot(&snap);
+  ASSERT_TRUE(snap.is_clean());
+  ASSERT_TRUE(snap.IsCommitted(Timestamp(kNumTxns)));
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -21,6 +21,7 @@
 #include <glog/logging.h>
 #include <mutex>
 
+#include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/port.h"
@@ -41,6 +42,8 @@ MvccManager::MvccManager()
     earliest_in_flight_(Timestamp::kMax) {
   cur_snap_.all_committed_before_ = Timestamp::kInitialTimestamp;
   cur_snap_.none_committed_at_or_after_ = Timestamp::kInitialTimestamp;
+  published_snap_.seq.store(0, std::memory_order_relaxed);
+  PublishSnapshotUnlocked();
 }
 
 void MvccManager::StartTransaction(Timestamp timestamp) {
@@ -140,6 +143,7 @@ void MvccManager::CommitTransactionUnlocked(Timestamp timestamp,
 
   // Add to snapshot's committed list
   cur_snap_.AddCommittedTimestamp(timestamp);
+  PublishCommitUnlocked(timestamp);
 
   // If we're committing the earliest transaction that was in flight,
   // update our cached value.
@@ -214,6 +218,7 @@ void MvccManager::AdjustCleanTime() {
 
   // Filter out any committed timestamps that now fall below the watermark
   FilterTimestamps(&cur_snap_.committed_timestamps_, cur_snap_.all_committed_before_.value());
+  PublishSnapshotUnlocked();
 
   // it may also have unblocked some waiters.
   // Check if someone is waiting for transactions to be committed.
@@ -296,7 +301,88 @@ bool MvccManager::AnyApplyingAtOrBeforeUnlocked(Timestamp ts) const {
   return false;
 }
 
+void MvccManager::PublishSnapshotUnlocked() {
+  PublishedSnapshot* p = &published_snap_;
+  const std::vector<Timestamp::val_type>& committed = cur_snap_.committed_timestamps_;
+  int num_committed = committed.size();
+
+  uint64_t seq = p->seq.load(std::memory_order_relaxed);
+  p->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  p->all_committed_before.store(cur_snap_.all_committed_before_.value(),
+                                std::memory_order_relaxed);
+  p->none_committed_at_or_after.store(cur_snap_.none_committed_at_or_after_.value(),
+                                      std::memory_order_relaxed);
+  if (num_committed > PublishedSnapshot::kMaxCommittedTimestamps) {
+    p->overflowed.store(true, std::memory_order_relaxed);
+  } else {
+    p->overflowed.store(false, std::memory_order_relaxed);
+    for (int i = 0; i < num_committed; i++) {
+      p->committed[i].store(committed[i], std::memory_order_relaxed);
+    }
+    p->num_committed.store(num_committed, std::memory_order_relaxed);
+  }
+
+  p->seq.store(seq + 2, std::memory_order_release);
+}
+
+void MvccManager::PublishCommitUnlocked(Timestamp timestamp) {
+  DCHECK(lock_.is_locked());
+  PublishedSnapshot* p = &published_snap_;
+  int num_committed = cur_snap_.committed_timestamps_.size();
+  DCHECK_EQ(cur_snap_.committed_timestamps_.back(), timestamp.value());
+
+  uint64_t seq = p->seq.load(std::memory_order_relaxed);
+  p->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  p->none_committed_at_or_after.store(cur_snap_.none_committed_at_or_after_.value(),
+                                      std::memory_order_relaxed);
+  if (num_committed > PublishedSnapshot::kMaxCommittedTimestamps) {
+    p->overflowed.store(true, std::memory_order_relaxed);
+  } else if (!p->overflowed.load(std::memory_order_relaxed)) {
+    p->committed[num_committed - 1].store(timestamp.value(), std::memory_order_relaxed);
+    p->num_committed.store(num_committed, std::memory_order_relaxed);
+  }
+
+  p->seq.store(seq + 2, std::memory_order_release);
+}
+
+bool MvccManager::ReadPublishedSnapshot(MvccSnapshot* snap) const {
+  const PublishedSnapshot& p = published_snap_;
+  while (true) {
+    uint64_t seq = p.seq.load(std::memory_order_acquire);
+    if (PREDICT_FALSE(seq & 1)) {
+      // A writer is in the middle of publishing.
+      base::subtle::PauseCPU();
+      continue;
+    }
+
+    bool overflowed = p.overflowed.load(std::memory_order_relaxed);
+    snap->all_committed_before_ = Timestamp(
+        p.all_committed_before.load(std::memory_order_relaxed));
+    snap->none_committed_at_or_after_ = Timestamp(
+        p.none_committed_at_or_after.load(std::memory_order_relaxed));
+    snap->committed_timestamps_.clear();
+    if (!overflowed) {
+      int num_committed = p.num_committed.load(std::memory_order_relaxed);
+      for (int i = 0; i < num_committed; i++) {
+        snap->committed_timestamps_.push_back(p.committed[i].load(std::memory_order_relaxed));
+      }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (PREDICT_TRUE(p.seq.load(std::memory_order_relaxed) == seq)) {
+      return !overflowed;
+    }
+  }
+}
+
 void MvccManager::TakeSnapshot(MvccSnapshot *snap) const {
+  if (PREDICT_TRUE(ReadPublishedSnapshot(snap))) {
+    return;
+  }
   std::lock_guard<LockType> l(lock_);
   *snap = cur_snap_;
 }
@@ -347,8 +433,7 @@ int MvccManager::CountTransactionsInFlight() const {
 }
 
 Timestamp MvccManager::GetCleanTimestamp() const {
-  std::lock_guard<LockType> l(lock_);
-  return cur_snap_.all_committed_before_;
+  return Timestamp(published_snap_.all_committed_before.load(std::memory_order_acquire));
 }
 
 void MvccManager::GetApplyingTransactionsTimestamps(std::vector<Timestamp>* timestamps) const {
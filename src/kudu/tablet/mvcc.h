@@ -17,6 +17,7 @@
 #ifndef KUDU_TABLET_MVCC_H
 #define KUDU_TABLET_MVCC_H
 
+#include <atomic>
 #include <gtest/gtest_prod.h>
 #include <mutex>
 #include <string>
@@ -226,6 +227,9 @@ class MvccManager {
 
   // Take a snapshot of the current MVCC state, which indicates which
   // transactions have been committed at the time of this call.
+  //
+  // This does not take the manager's lock unless the current snapshot's
+  // committed set is too large to be published (see PublishedSnapshot).
   void TakeSnapshot(MvccSnapshot *snapshot) const;
 
   // Take a snapshot of the MVCC state at 'timestamp' (i.e which includes
@@ -274,6 +278,7 @@ class MvccManager {
   FRIEND_TEST(MvccTest, TestAutomaticCleanTimeMoveToSafeTimeOnCommit);
   FRIEND_TEST(MvccTest, TestWaitForApplyingTransactionsToCommit);
   FRIEND_TEST(MvccTest, TestWaitForCleanSnapshot_SnapAfterSafeTimeWithInFlights);
+  FRIEND_TEST(MvccTest, TestPublishedSnapshotOverflow);
 
   enum TxnState {
     RESERVED,
@@ -333,6 +338,17 @@ class MvccManager {
   // commits or aborts.
   void AdvanceEarliestInFlightTimestamp();
 
+  // Republish all of 'cur_snap_' to 'published_snap_'.
+  void PublishSnapshotUnlocked();
+
+  // Publish the commit of 'timestamp', which has just been added to
+  // 'cur_snap_', by appending it to 'published_snap_'.
+  void PublishCommitUnlocked(Timestamp timestamp);
+
+  // Copy 'published_snap_' into 'snap'. Returns false if the published
+  // snapshot has overflowed, in which case 'snap' must be taken under the lock.
+  bool ReadPublishedSnapshot(MvccSnapshot* snap) const;
+
   int GetNumWaitersForTests() const {
     std::lock_guard<simple_spinlock> l(lock_);
     return waiters_.size();
@@ -343,6 +359,29 @@ class MvccManager {
 
   MvccSnapshot cur_snap_;
 
+  // A copy of 'cur_snap_' which readers may take without 'lock_'.
+  //
+  // This is a sequence lock: writers, which already hold 'lock_', make 'seq'
+  // odd, update the fields they changed, and then make 'seq' even again.
+  // Readers copy the fields and retry if 'seq' was odd or changed during the
+  // copy. Commits only append to the committed set, so they publish just the
+  // new timestamp; the whole snapshot is republished when the clean time
+  // moves and the committed set is trimmed.
+  //
+  // If the committed set grows beyond kMaxCommittedTimestamps, 'overflowed'
+  // is set and readers fall back to copying 'cur_snap_' under 'lock_'.
+  struct PublishedSnapshot {
+    static const int kMaxCommittedTimestamps = 256;
+
+    std::atomic<uint64_t> seq;
+    std::atomic<bool> overflowed;
+    std::atomic<Timestamp::val_type> all_committed_before;
+    std::atomic<Timestamp::val_type> none_committed_at_or_after;
+    std::atomic<int> num_committed;
+    std::atomic<Timestamp::val_type> committed[kMaxCommittedTimestamps];
+  };
+  PublishedSnapshot published_snap_;
+
   // The set of timestamps corresponding to currently in-flight transactions.
   typedef std::unordered_map<Timestamp::val_type, TxnState> InFlightMap;
   InFlightMap timestamps_in_flight_;
@@ -0,0 +1,285 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/parallel_union_iterator.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <glog/logging.h>
+
+#include "kudu/common/generic_iterators.h"
+#include "kudu/common/iterator_stats.h"
+#include "kudu/common/row.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/threadpool.h"
+
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+namespace {
+
+// The number of rows read into each buffered block.
+const size_t kRowsPerBlock = 1024;
+
+} // anonymous namespace
+
+ParallelUnionIterator::BufferedBlock::BufferedBlock(const Schema& schema, size_t nrows)
+    : arena(new Arena(32 * 1024, 1024 * 1024)),
+      block(new RowBlock(schema, nrows, arena.get())),
+      next_row(0),
+      bytes(0) {
+}
+
+ParallelUnionIterator::ParallelUnionIterator(vector<shared_ptr<RowwiseIterator>> iters,
+                                             ThreadPool* pool,
+                                             int max_parallelism,
+                                             int64_t max_buffered_bytes)
+    : iters_(std::move(iters)),
+      pool_(pool),
+      max_parallelism_(max_parallelism),
+      max_buffered_bytes_(max_buffered_bytes),
+      initted_(false),
+      ready_cond_(&lock_),
+      space_cond_(&lock_),
+      next_iter_(0),
+      running_tasks_(0),
+      stopping_(false),
+      queued_bytes_(0),
+      iter_stats_(iters_.size()) {
+  CHECK_GT(iters_.size(), 0);
+  CHECK_GT(max_parallelism_, 0);
+}
+
+ParallelUnionIterator::~ParallelUnionIterator() {
+  {
+    MutexLock l(lock_);
+    stopping_ = true;
+    space_cond_.Broadcast();
+    while (running_tasks_ > 0) {
+      ready_cond_.Wait();
+    }
+  }
+  STLDeleteElements(&queue_);
+  STLDeleteElements(&free_blocks_);
+}
+
+Status ParallelUnionIterator::Init(ScanSpec* spec) {
+  CHECK(!initted_);
+
+  for (shared_ptr<RowwiseIterator>& iter : iters_) {
+    ScanSpec* spec_copy = spec != nullptr ? scan_spec_copies_.Construct(*spec) : nullptr;
+    RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&iter, spec_copy));
+  }
+  // Since we handle predicates in all the wrapped iterators, we can clear
+  // them here.
+  if (spec != nullptr) {
+    spec->RemovePredicates();
+  }
+
+  schema_.reset(new Schema(iters_.front()->schema()));
+  for (const shared_ptr<RowwiseIterator>& iter : iters_) {
+    if (!iter->schema().Equals(*schema_)) {
+      return Status::InvalidArgument(
+          string("Schemas do not match: ") + schema_->ToString()
+          + " vs " + iter->schema().ToString());
+    }
+  }
+  initted_ = true;
+
+  int num_tasks = std::min<int>(max_parallelism_, iters_.size());
+  MutexLock l(lock_);
+  for (int i = 0; i < num_tasks; i++) {
+    Status s = pool_->SubmitFunc(boost::bind(&ParallelUnionIterator::ReadTask, this));
+    if (!s.ok()) {
+      // Make do with the tasks which were started, if any.
+      if (running_tasks_ == 0) {
+        return s.CloneAndPrepend("Unable to start reading the sub-iterators");
+      }
+      LOG(WARNING) << "Unable to start a parallel scan task: " << s.ToString();
+      break;
+    }
+    running_tasks_++;
+  }
+  return Status::OK();
+}
+
+void ParallelUnionIterator::ReadTask() {
+  while (true) {
+    size_t idx;
+    {
+      MutexLock l(lock_);
+      if (stopping_ || !error_.ok() || next_iter_ >= iters_.size()) {
+        break;
+      }
+      idx = next_iter_++;
+    }
+    Status s = ReadIterator(iters_[idx].get(), idx);
+    if (!s.ok()) {
+      MutexLock l(lock_);
+      if (error_.ok()) {
+        error_ = s;
+      }
+      break;
+    }
+  }
+
+  MutexLock l(lock_);
+  running_tasks_--;
+  ready_cond_.Broadcast();
+}
+
+Status ParallelUnionIterator::ReadIterator(RowwiseIterator* iter, int iter_idx) {
+  vector<IteratorStats> stats;
+  while (iter->HasNext()) {
+    unique_ptr<BufferedBlock> b;
+    {
+      MutexLock l(lock_);
+      while (!stopping_ && error_.ok() &&
+             !queue_.empty() && queued_bytes_ >= max_buffered_bytes_) {
+        space_cond_.Wait();
+      }
+      if (stopping_ || !error_.ok()) {
+        return Status::OK();
+      }
+      if (!free_blocks_.empty()) {
+        b.reset(free_blocks_.back());
+        free_blocks_.pop_back();
+      }
+    }
+    if (!b) {
+      b.reset(new BufferedBlock(*schema_, kRowsPerBlock));
+    }
+    b->arena->Reset();
+    b->block->Resize(kRowsPerBlock);
+    b->next_row = 0;
+
+    Status s = iter->NextBlock(b->block.get());
+    stats.clear();
+    iter->GetIteratorStats(&stats);
+
+    MutexLock l(lock_);
+    iter_stats_[iter_idx].swap(stats);
+    if (!s.ok() || !b->block->selection_vector()->AnySelected()) {
+      free_blocks_.push_back(b.release());
+      RETURN_NOT_OK(s);
+      continue;
+    }
+    b->bytes = b->arena->memory_footprint() +
+        b->block->row_capacity() * schema_->byte_size();
+    queued_bytes_ += b->bytes;
+    queue_.push_back(b.release());
+    ready_cond_.Signal();
+  }
+  return Status::OK();
+}
+
+bool ParallelUnionIterator::ReadyUnlocked() const {
+  return !queue_.empty() || !error_.ok() || running_tasks_ == 0;
+}
+
+bool ParallelUnionIterator::HasNext() const {
+  CHECK(initted_);
+  MutexLock l(lock_);
+  while (!ReadyUnlocked()) {
+    ready_cond_.Wait();
+  }
+  return !queue_.empty() || !error_.ok();
+}
+
+Status ParallelUnionIterator::NextBlock(RowBlock* dst) {
+  CHECK(initted_);
+  dst->Resize(dst->row_capacity());
+  size_t n = 0;
+  while (n < dst->row_capacity()) {
+    BufferedBlock* b;
+    {
+      MutexLock l(lock_);
+      // Wait for the first block, but only fill the rest of 'dst' with blocks
+      // which are already queued.
+      while (n == 0 && !ReadyUnlocked()) {
+        ready_cond_.Wait();
+      }
+      RETURN_NOT_OK(error_);
+      if (queue_.empty()) {
+        break;
+      }
+      // Only this thread removes blocks from the queue, so 'b' remains valid
+      // after the lock is released.
+      b = queue_.front();
+    }
+
+    const RowBlock& src = *b->block;
+    const SelectionVector* sel = src.selection_vector();
+    for (; b->next_row < src.nrows() && n < dst->row_capacity(); b->next_row++) {
+      if (!sel->IsRowSelected(b->next_row)) continue;
+      RowBlockRow dst_row = dst->row(n++);
+      RETURN_NOT_OK(CopyRow(src.row(b->next_row), &dst_row, dst->arena()));
+    }
+
+    if (b->next_row == src.nrows()) {
+      MutexLock l(lock_);
+      queue_.pop_front();
+      queued_bytes_ -= b->bytes;
+      free_blocks_.push_back(b);
+      space_cond_.Signal();
+    }
+  }
+  dst->Resize(n);
+  dst->selection_vector()->SetAllTrue();
+  return Status::OK();
+}
+
+string ParallelUnionIterator::ToString() const {
+  string s;
+  s.append("ParallelUnion(");
+  bool first = true;
+  for (const shared_ptr<RowwiseIterator>& iter : iters_) {
+    if (!first) {
+      s.append(", ");
+    }
+    first = false;
+    s.append(iter->ToString());
+  }
+  s.append(")");
+  return s;
+}
+
+void ParallelUnionIterator::GetIteratorStats(vector<IteratorStats>* stats) const {
+  CHECK(initted_);
+  vector<IteratorStats> stats_by_col(schema_->num_columns());
+  {
+    MutexLock l(lock_);
+    for (const vector<IteratorStats>& stats_for_iter : iter_stats_) {
+      // Sub-iterators which have not been read yet have no stats.
+      for (size_t idx = 0; idx < stats_for_iter.size(); ++idx) {
+        stats_by_col[idx].AddStats(stats_for_iter[idx]);
+      }
+    }
+  }
+  stats->insert(stats->end(), stats_by_col.begin(), stats_by_col.end());
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,152 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_PARALLEL_UNION_ITERATOR_H
+#define KUDU_TABLET_PARALLEL_UNION_ITERATOR_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/common/iterator.h"
+#include "kudu/common/scan_spec.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/object_pool.h"
+
+namespace kudu {
+
+class Arena;
+class RowBlock;
+class ThreadPool;
+
+namespace tablet {
+
+// An iterator which, like UnionIterator, yields the rows of its sub-iterators
+// in no particular order, but drains several sub-iterators concurrently on a
+// thread pool.
+//
+// Each sub-iterator is read by one task at a time. The tasks read and decode
+// blocks of rows ahead of the consumer into a queue, which holds at most
+// 'max_buffered_bytes' of row data (but always at least one block). The
+// consumer copies the selected rows of the queued blocks into the blocks
+// passed to NextBlock(), relocating their indirect data into the arenas of
+// those blocks.
+//
+// The sub-iterators must be safe to use from a thread other than the one
+// that created them, one thread at a time.
+class ParallelUnionIterator : public RowwiseIterator {
+ public:
+  // Constructs an iterator over 'iters', reading at most 'max_parallelism'
+  // of them at a time on 'pool'. The passed-in iterators should not yet be
+  // initialized, and must have matching schemas once initialized.
+  ParallelUnionIterator(std::vector<std::shared_ptr<RowwiseIterator>> iters,
+                        ThreadPool* pool,
+                        int max_parallelism,
+                        int64_t max_buffered_bytes);
+
+  // Stops the reading tasks, waiting for them to finish.
+  virtual ~ParallelUnionIterator();
+
+  // Initializes the sub-iterators with copies of 'spec', like UnionIterator,
+  // and starts reading them.
+  Status Init(ScanSpec* spec) OVERRIDE;
+
+  // Waits until a block of rows is available or all sub-iterators are done.
+  bool HasNext() const OVERRIDE;
+
+  std::string ToString() const OVERRIDE;
+
+  const Schema& schema() const OVERRIDE {
+    CHECK(initted_);
+    return *CHECK_NOTNULL(schema_.get());
+  }
+
+  void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
+
+  Status NextBlock(RowBlock* dst) OVERRIDE;
+
+ private:
+  // A block of rows read by a task, along with its own arena.
+  struct BufferedBlock {
+    BufferedBlock(const Schema& schema, size_t nrows);
+
+    gscoped_ptr<Arena> arena;
+    gscoped_ptr<RowBlock> block;
+    // The index of the next row to be copied out of 'block'.
+    size_t next_row;
+    // The memory accounted for the block while it is queued.
+    int64_t bytes;
+  };
+
+  // Reads the sub-iterators until there are none left, the iterator is
+  // being destroyed, or an error occurs.
+  void ReadTask();
+
+  // Reads 'iter' into buffered blocks, blocking while the queue is full.
+  Status ReadIterator(RowwiseIterator* iter, int iter_idx);
+
+  // Returns whether the consumer can make progress: a block is queued, an
+  // error occurred, or all tasks are done.
+  bool ReadyUnlocked() const;
+
+  std::vector<std::shared_ptr<RowwiseIterator>> iters_;
+  ThreadPool* const pool_;
+  const int max_parallelism_;
+  const int64_t max_buffered_bytes_;
+
+  gscoped_ptr<Schema> schema_;
+  bool initted_;
+
+  // Copies of the scan spec for the sub-iterators.
+  ObjectPool<ScanSpec> scan_spec_copies_;
+
+  mutable Mutex lock_;
+  // Signaled when a block is queued or a task finishes.
+  mutable ConditionVariable ready_cond_;
+  // Signaled when a block is dequeued or the iterator is being destroyed.
+  ConditionVariable space_cond_;
+
+  // The index of the next sub-iterator to be read by a task.
+  size_t next_iter_;
+  // The number of tasks which have not yet finished.
+  int running_tasks_;
+  // Set when the iterator is being destroyed.
+  bool stopping_;
+  // The first error encountered by a task.
+  Status error_;
+
+  // Blocks read by the tasks, in the order they were read.
+  std::deque<BufferedBlock*> queue_;
+  int64_t queued_bytes_;
+  // Drained blocks which the tasks may reuse.
+  std::vector<BufferedBlock*> free_blocks_;
+
+  // The last stats reported by each sub-iterator, updated by the tasks after
+  // each block so that GetIteratorStats() need not read the sub-iterators
+  // while they are being used.
+  std::vector<std::vector<IteratorStats>> iter_stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelUnionIterator);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif // KUDU_TABLET_PARALLEL_UNION_ITERATOR_H
@@ -0,0 +1,165 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/tablet/row_cache.h"
+
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+#include "kudu/common/rowblock.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/util/memory/arena.h"
+
+using std::string;
+
+namespace kudu {
+namespace tablet {
+
+RowCache::RowCache(size_t capacity_bytes)
+    : capacity_bytes_(capacity_bytes),
+      usage_bytes_(0),
+      generation_(0) {
+}
+
+uint64_t RowCache::generation() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return generation_;
+}
+
+bool RowCache::Lookup(const Slice& key, const Schema& projection,
+                      RowBlock* dst, size_t row_idx) {
+  const string key_str = key.ToString();
+  std::lock_guard<simple_spinlock> l(lock_);
+  EntryList::iterator* it = FindOrNull(entries_, key_str);
+  if (it == nullptr) {
+    return false;
+  }
+  const Entry& e = **it;
+  if (e.col_ids.size() != projection.num_columns()) {
+    return false;
+  }
+  for (size_t i = 0; i < e.col_ids.size(); i++) {
+    if (e.col_ids[i] != projection.column_id(i)) {
+      return false;
+    }
+  }
+
+  RowBlockRow row = dst->row(row_idx);
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(e.data.data());
+  for (size_t i = 0; i < projection.num_columns(); i++) {
+    const ColumnSchema& col = projection.column(i);
+    if (col.is_nullable()) {
+      const bool is_null = *src++;
+      row.cell(i).set_null(is_null);
+      if (is_null) {
+        continue;
+      }
+    }
+    if (col.type_info()->physical_type() == BINARY) {
+      uint32_t size;
+      memcpy(&size, src, sizeof(size));
+      src += sizeof(size);
+      Slice* cell = reinterpret_cast<Slice*>(row.mutable_cell_ptr(i));
+      if (PREDICT_FALSE(!dst->arena()->RelocateSlice(Slice(src, size), cell))) {
+        return false;
+      }
+      src += size;
+    } else {
+      const size_t size = col.type_info()->size();
+      memcpy(row.mutable_cell_ptr(i), src, size);
+      src += size;
+    }
+  }
+  DCHECK_EQ(src, reinterpret_cast<const uint8_t*>(e.data.data()) + e.data.size());
+
+  // Move the entry to the front, as the most recently used.
+  lru_.splice(lru_.begin(), lru_, *it);
+  return true;
+}
+
+void RowCache::Insert(const Slice& key, const RowBlockRow& row, uint64_t generation) {
+  const Schema& schema = *row.schema();
+  Entry e;
+  e.key = key.ToString();
+  e.col_ids.reserve(schema.num_columns());
+  for (size_t i = 0; i < schema.num_columns(); i++) {
+    const ColumnSchema& col = schema.column(i);
+    e.col_ids.push_back(schema.column_id(i));
+    if (col.is_nullable()) {
+      const char is_null = row.is_null(i);
+      e.data.push_back(is_null);
+      if (is_null) {
+        continue;
+      }
+    }
+    if (col.type_info()->physical_type() == BINARY) {
+      const Slice* cell = reinterpret_cast<const Slice*>(row.cell_ptr(i));
+      const uint32_t size = cell->size();
+      e.data.append(reinterpret_cast<const char*>(&size), sizeof(size));
+      e.data.append(reinterpret_cast<const char*>(cell->data()), size);
+    } else {
+      e.data.append(reinterpret_cast<const char*>(row.cell_ptr(i)), col.type_info()->size());
+    }
+  }
+  const size_t charge = Charge(e);
+  if (charge > capacity_bytes_) {
+    return;
+  }
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (generation != generation_ || ContainsKey(writing_, e.key)) {
+    return;
+  }
+  EraseUnlocked(e.key);
+  lru_.push_front(std::move(e));
+  entries_[lru_.front().key] = lru_.begin();
+  usage_bytes_ += charge;
+  while (usage_bytes_ > capacity_bytes_) {
+    EraseUnlocked(lru_.back().key);
+  }
+}
+
+void RowCache::StartWrite(const Slice& key) {
+  const string key_str = key.ToString();
+  std::lock_guard<simple_spinlock> l(lock_);
+  writing_[key_str]++;
+  EraseUnlocked(key_str);
+}
+
+void RowCache::FinishWrite(const Slice& key) {
+  const string key_str = key.ToString();
+  std::lock_guard<simple_spinlock> l(lock_);
+  auto it = writing_.find(key_str);
+  DCHECK(it != writing_.end());
+  if (it != writing_.end() && --it->second == 0) {
+    writing_.erase(it);
+  }
+  generation_++;
+}
+
+void RowCache::EraseUnlocked(const string& key) {
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return;
+  }
+  usage_bytes_ -= Charge(*it->second);
+  lru_.erase(it->second);
+  entries_.erase(it);
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,113 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_ROW_CACHE_H
+#define KUDU_TABLET_ROW_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+
+class RowBlock;
+class RowBlockRow;
+
+namespace tablet {
+
+// A cache of the latest committed versions of recently read rows, keyed by
+// their encoded primary keys, so that repeated point lookups of the same
+// rows don't have to read the rowsets.
+//
+// A row is cached as read with a particular projection, and is only found
+// by lookups with the same columns.
+//
+// Writers mark the keys of their rows from when their transaction starts
+// applying until it has committed or aborted. Marking a key evicts its row,
+// and a marked key is neither looked up nor cached. Every key released also
+// advances the generation of the cache. A reader which takes the generation
+// before its MVCC snapshot may cache the row it read only if the generation
+// is unchanged, since otherwise a write it didn't see may have committed.
+//
+// This class is thread-safe.
+class RowCache {
+ public:
+  explicit RowCache(size_t capacity_bytes);
+
+  // Returns the current generation. Must be called before taking the MVCC
+  // snapshot of a read whose row may be inserted.
+  uint64_t generation() const;
+
+  // Copies the row of 'key' into row 'row_idx' of 'dst', whose schema must be
+  // 'projection', allocating its indirect data from the block's arena.
+  // Returns false if the row isn't cached with the columns of 'projection'.
+  bool Lookup(const Slice& key, const Schema& projection, RowBlock* dst, size_t row_idx);
+
+  // Caches 'row', of the row of 'key', unless the key is being written or the
+  // generation has advanced past 'generation'.
+  void Insert(const Slice& key, const RowBlockRow& row, uint64_t generation);
+
+  // Marks the key of a row being written.
+  void StartWrite(const Slice& key);
+
+  // Releases a key marked by StartWrite(), once its write has committed or
+  // aborted.
+  void FinishWrite(const Slice& key);
+
+ private:
+  struct Entry {
+    std::string key;
+    std::vector<ColumnId> col_ids;
+    // The cells, in order. Each is preceded by a null byte if the column is
+    // nullable, and BINARY cells are a 32-bit length followed by the data.
+    std::string data;
+  };
+  typedef std::list<Entry> EntryList;
+
+  static size_t Charge(const Entry& e) {
+    return sizeof(Entry) + e.key.size() + e.data.size() + e.col_ids.size() * sizeof(ColumnId);
+  }
+
+  // Removes the entry of 'key', if any.
+  void EraseUnlocked(const std::string& key);
+
+  const size_t capacity_bytes_;
+
+  mutable simple_spinlock lock_;
+
+  // Protected by 'lock_'.
+  // The entries, from the most to the least recently used.
+  EntryList lru_;
+  std::unordered_map<std::string, EntryList::iterator> entries_;
+  size_t usage_bytes_;
+  // The number of writes in progress to each marked key.
+  std::unordered_map<std::string, int> writing_;
+  uint64_t generation_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowCache);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif // KUDU_TABLET_ROW_CACHE_H
@@ -25,7 +25,9 @@ namespace tablet {
 
 RowOp::RowOp(DecodedRowOperation decoded_op)
     : decoded_op(std::move(decoded_op)),
-      orig_result_from_log_(nullptr) {
+      orig_result_from_log_(nullptr),
+      checked_disk_rowsets(false),
+      present_in_rowset(nullptr) {
 }
 
 RowOp::~RowOp() {
@@ -81,6 +81,12 @@ struct RowOp {
   // If this operation is being replayed from the log, set to the original
   // result. Otherwise nullptr.
   const OperationResultPB* orig_result_from_log_;
+
+  // Set if the DiskRowSets which may contain this row's key have already been
+  // probed as part of a batch during "apply". In that case, 'present_in_rowset'
+  // is the DiskRowSet found to contain the key, or nullptr if none does.
+  bool checked_disk_rowsets;
+  RowSet* present_in_rowset;
 };
 
 
@@ -33,6 +33,41 @@ using strings::Substitute;
 
 namespace kudu { namespace tablet {
 
+Status RowSet::NewCompactionInputForRange(const Schema* /* projection */,
+                                          const MvccSnapshot& /* snap */,
+                                          const Slice& /* lower_bound */,
+                                          const Slice& /* exclusive_upper_bound */,
+                                          gscoped_ptr<CompactionInput>* /* out */) const {
+  return Status::NotSupported("key range compaction inputs not supported", ToString());
+}
+
+int64_t RowSet::EstimateBytesInPotentiallyAncientUndoDeltas(
+    Timestamp /* ancient_history_mark */) const {
+  return 0;
+}
+
+Status RowSet::InitUndoDeltas(MonoTime /* deadline */, int64_t* stores_initialized) {
+  *stores_initialized = 0;
+  return Status::OK();
+}
+
+Status RowSet::DeleteAncientUndoDeltas(Timestamp /* ancient_history_mark */,
+                                       int64_t* blocks_deleted,
+                                       int64_t* bytes_deleted) {
+  *blocks_deleted = 0;
+  *bytes_deleted = 0;
+  return Status::OK();
+}
+
+Status RowSet::CheckRowsPresent(const RowSetKeyProbe* const* probes,
+                                ProbeStats* const* stats,
+                                int n, bool* present) const {
+  for (int i = 0; i < n; i++) {
+    RETURN_NOT_OK(CheckRowPresent(*probes[i], &present[i], stats[i]));
+  }
+  return Status::OK();
+}
+
 DuplicatingRowSet::DuplicatingRowSet(RowSetVector old_rowsets,
                                      RowSetVector new_rowsets)
     : old_rowsets_(std::move(old_rowsets)),
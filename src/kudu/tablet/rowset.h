@@ -30,6 +30,7 @@
 #include "kudu/tablet/mvcc.h"
 #include "kudu/util/bloom_filter.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
@@ -67,6 +68,17 @@ class RowSet {
   virtual Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                                  ProbeStats* stats) const = 0;
 
+  // Batch version of CheckRowPresent(): sets present[i] for each of the 'n'
+  // probes, recording the work done for probes[i] in *stats[i].
+  //
+  // The probes must be sorted by encoded key. The default implementation
+  // simply checks each row in turn; rowsets which can amortize work across
+  // sorted keys (e.g. a single pass over the bloom filter and key index)
+  // override it.
+  virtual Status CheckRowsPresent(const RowSetKeyProbe* const* probes,
+                                  ProbeStats* const* stats,
+                                  int n, bool* present) const;
+
   // Update/delete a row in this rowset.
   // The 'update_schema' is the client schema used to encode the 'update' RowChangeList.
   //
@@ -96,9 +108,42 @@ class RowSet {
                                     const MvccSnapshot &snap,
                                     gscoped_ptr<CompactionInput>* out) const = 0;
 
+  // Like NewCompactionInput(), but the input only yields the rows whose
+  // encoded keys are in [lower_bound, exclusive_upper_bound). An empty bound
+  // leaves that end of the range unbounded.
+  //
+  // The default implementation returns NotSupported.
+  virtual Status NewCompactionInputForRange(const Schema* projection,
+                                            const MvccSnapshot &snap,
+                                            const Slice& lower_bound,
+                                            const Slice& exclusive_upper_bound,
+                                            gscoped_ptr<CompactionInput>* out) const;
+
   // Count the number of rows in this rowset.
   virtual Status CountRows(rowid_t *count) const = 0;
 
+  // Count the number of rows in this rowset which are live in 'snap', if
+  // that is possible without reading the rows. If it is not, sets '*counted'
+  // to false, and the rows which are live in 'snap' must be counted by
+  // scanning the rowset instead.
+  virtual Status CountLiveRows(const MvccSnapshot& snap, bool* counted,
+                               rowid_t* count) const = 0;
+
+  // Returns false if no row of this rowset can be visible in 'snap', for
+  // example because all of them were inserted after it. A return value of
+  // true means some rows may be visible.
+  virtual bool MayHaveRowsVisibleIn(const MvccSnapshot& snap) const {
+    return true;
+  }
+
+  // Returns false if no row of this rowset can have been inserted, updated
+  // or deleted by a transaction with a timestamp in [start, end), so that
+  // its rows are the same in snapshots at either timestamp. A return value
+  // of true means some rows may have changed.
+  virtual bool MayHaveChangesBetween(Timestamp start, Timestamp end) const {
+    return true;
+  }
+
   // Return the bounds for this RowSet. 'min_encoded_key' and 'max_encoded_key'
   // are set to the first and last encoded keys for this RowSet.
   //
@@ -143,6 +188,34 @@ class RowSet {
   // Compact delta stores if more than one.
   virtual Status MinorCompactDeltaStores() = 0;
 
+  // Estimate the number of bytes in UNDO delta files which may hold only
+  // mutations older than 'ancient_history_mark'.
+  //
+  // The default implementation, for rowsets without UNDO files, returns 0.
+  virtual int64_t EstimateBytesInPotentiallyAncientUndoDeltas(
+      Timestamp ancient_history_mark) const;
+
+  // Read the stats of the UNDO delta files until 'deadline' has passed, so
+  // that ancient ones can be identified.
+  //
+  // The default implementation does nothing.
+  virtual Status InitUndoDeltas(MonoTime deadline, int64_t* stores_initialized);
+
+  // Remove the UNDO delta files holding only mutations older than
+  // 'ancient_history_mark', without rewriting any other data.
+  //
+  // The default implementation does nothing.
+  virtual Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                         int64_t* blocks_deleted,
+                                         int64_t* bytes_deleted);
+
+  // Releases the blocks which the rowset keeps pinned in the block cache to
+  // speed up later reads, such as the last index blocks read by its bloom
+  // filter probes.
+  //
+  // The default implementation does nothing.
+  virtual void ReleaseCachedBlocks() {}
+
   virtual ~RowSet() {}
 
   // Return true if this RowSet is available for compaction, based on
@@ -181,6 +254,13 @@ class RowSetKeyProbe {
     bloom_probe_ = BloomKeyProbe(encoded_key_slice());
   }
 
+  // Like the above, but with the already encoded key of 'row_key'.
+  RowSetKeyProbe(ConstContiguousRow row_key, gscoped_ptr<EncodedKey> encoded_key)
+      : row_key_(std::move(row_key)),
+        encoded_key_(encoded_key.Pass()) {
+    bloom_probe_ = BloomKeyProbe(encoded_key_slice());
+  }
+
   // RowSetKeyProbes are usually allocated on the stack, which means that we
   // must copy it if we require it later (e.g. Table::Mutate()).
   //
@@ -273,6 +353,13 @@ class DuplicatingRowSet : public RowSet {
 
   Status CountRows(rowid_t *count) const OVERRIDE;
 
+  // The rows being compacted or flushed can't be counted without a scan.
+  Status CountLiveRows(const MvccSnapshot& snap, bool* counted,
+                       rowid_t* count) const OVERRIDE {
+    *counted = false;
+    return Status::OK();
+  }
+
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
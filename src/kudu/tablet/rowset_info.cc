@@ -199,15 +199,17 @@ void RowSetInfo::CollectOrdered(const RowSetTree& tree,
   // We need to filter out the rowsets that aren't available before we process the endpoints,
   // else there's a race since we see endpoints twice and a delta compaction might finish in
   // between.
-  RowSetVector available_rowsets;
-  for (const shared_ptr<RowSet> rs : tree.all_rowsets()) {
-    if (rs->IsAvailableForCompaction()) {
-      available_rowsets.push_back(rs);
+  // The tree of available rowsets is derived from 'tree', so this only costs
+  // in proportion to the number of unavailable rowsets.
+  RowSetVector unavailable_rowsets;
+  for (const shared_ptr<RowSet>& rs : tree.all_rowsets()) {
+    if (!rs->IsAvailableForCompaction()) {
+      unavailable_rowsets.push_back(rs);
     }
   }
 
   RowSetTree available_rs_tree;
-  available_rs_tree.Reset(available_rowsets);
+  CHECK_OK(available_rs_tree.Reset(tree, unavailable_rowsets, {}));
   for (const RowSetTree::RSEndpoint& rse :
                 available_rs_tree.key_endpoints()) {
     RowSet* rs = rse.rowset_;
@@ -74,6 +74,9 @@ Status RowSetMetadata::InitFromPB(const RowSetDataPB& pb) {
     ColumnId col_id = ColumnId(col_pb.column_id());
     blocks_by_col_id_[col_id] = BlockId::FromPB(col_pb.block());
   }
+  for (const ColumnDataPB& index_pb : pb.secondary_indexes()) {
+    index_blocks_by_col_id_[ColumnId(index_pb.column_id())] = BlockId::FromPB(index_pb.block());
+  }
 
   // Load redo delta files
   for (const DeltaDataPB& redo_delta_pb : pb.redo_deltas()) {
@@ -82,6 +85,10 @@ Status RowSetMetadata::InitFromPB(const RowSetDataPB& pb) {
 
   last_durable_redo_dms_id_ = pb.last_durable_dms_id();
 
+  if (pb.has_min_insert_timestamp()) {
+    min_insert_timestamp_ = Timestamp(pb.min_insert_timestamp());
+  }
+
   // Load undo delta files
   for (const DeltaDataPB& undo_delta_pb : pb.undo_deltas()) {
     undo_delta_blocks_.push_back(BlockId::FromPB(undo_delta_pb.block()));
@@ -105,6 +112,11 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
     block_id.CopyToPB(col_data->mutable_block());
     col_data->set_column_id(col_id);
   }
+  for (const ColumnIdToBlockIdMap::value_type& e : index_blocks_by_col_id_) {
+    ColumnDataPB* index_data = pb->add_secondary_indexes();
+    e.second.CopyToPB(index_data->mutable_block());
+    index_data->set_column_id(e.first);
+  }
 
   // Write Delta Files
   pb->set_last_durable_dms_id(last_durable_redo_dms_id_);
@@ -128,6 +140,10 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
   if (!adhoc_index_block_.IsNull()) {
     adhoc_index_block_.CopyToPB(pb->mutable_adhoc_index_block());
   }
+
+  if (min_insert_timestamp_ != Timestamp::kMin) {
+    pb->set_min_insert_timestamp(min_insert_timestamp_.value());
+  }
 }
 
 const string RowSetMetadata::ToString() const {
@@ -139,6 +155,11 @@ void RowSetMetadata::SetColumnDataBlocks(const ColumnIdToBlockIdMap& blocks) {
   blocks_by_col_id_ = blocks;
 }
 
+void RowSetMetadata::SetSecondaryIndexBlocks(const ColumnIdToBlockIdMap& blocks) {
+  std::lock_guard<LockType> l(lock_);
+  index_blocks_by_col_id_ = blocks;
+}
+
 Status RowSetMetadata::CommitRedoDeltaDataBlock(int64_t dms_id,
                                                 const BlockId& block_id) {
   std::lock_guard<LockType> l(lock_);
@@ -186,6 +207,17 @@ Status RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update) {
       redo_delta_blocks_.push_back(b);
     }
 
+    for (const BlockId& b : update.undo_blocks_to_remove_) {
+      auto it = std::find(undo_delta_blocks_.begin(), undo_delta_blocks_.end(), b);
+      if (it == undo_delta_blocks_.end()) {
+        return Status::InvalidArgument(
+            Substitute("Cannot find UNDO delta block $0 in <$1>",
+                       b.ToString(), BlockId::JoinStrings(undo_delta_blocks_)));
+      }
+      removed.push_back(b);
+      undo_delta_blocks_.erase(it);
+    }
+
     if (!update.new_undo_block_.IsNull()) {
       // Front-loading to keep the UNDO files in their natural order.
       undo_delta_blocks_.insert(undo_delta_blocks_.begin(), update.new_undo_block_);
@@ -199,12 +231,21 @@ Status RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update) {
       if (UpdateReturnCopy(&blocks_by_col_id_, e.first, e.second, &old_block_id)) {
         removed.push_back(old_block_id);
       }
+      // The index no longer matches the new base data.
+      if (FindCopy(index_blocks_by_col_id_, e.first, &old_block_id)) {
+        index_blocks_by_col_id_.erase(e.first);
+        removed.push_back(old_block_id);
+      }
     }
 
     for (ColumnId col_id : update.col_ids_to_remove_) {
       BlockId old = FindOrDie(blocks_by_col_id_, col_id);
       CHECK_EQ(1, blocks_by_col_id_.erase(col_id));
       removed.push_back(old);
+      if (FindCopy(index_blocks_by_col_id_, col_id, &old)) {
+        index_blocks_by_col_id_.erase(col_id);
+        removed.push_back(old);
+      }
     }
   }
 
@@ -225,6 +266,7 @@ vector<BlockId> RowSetMetadata::GetAllBlocks() {
     blocks.push_back(bloom_block_);
   }
   AppendValuesFromMap(blocks_by_col_id_, &blocks);
+  AppendValuesFromMap(index_blocks_by_col_id_, &blocks);
 
   blocks.insert(blocks.end(),
                 undo_delta_blocks_.begin(), undo_delta_blocks_.end());
@@ -264,5 +306,12 @@ RowSetMetadataUpdate& RowSetMetadataUpdate::SetNewUndoBlock(const BlockId& undo_
   return *this;
 }
 
+RowSetMetadataUpdate& RowSetMetadataUpdate::RemoveUndoDeltaBlocks(
+    const std::vector<BlockId>& to_remove) {
+  undo_blocks_to_remove_.insert(undo_blocks_to_remove_.end(),
+                                to_remove.begin(), to_remove.end());
+  return *this;
+}
+
 } // namespace tablet
 } // namespace kudu
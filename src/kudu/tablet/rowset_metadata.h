@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "kudu/common/schema.h"
+#include "kudu/common/timestamp.h"
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/macros.h"
@@ -97,8 +98,24 @@ class RowSetMetadata {
     adhoc_index_block_ = block_id;
   }
 
+  // Sets the earliest timestamp at which any row of the rowset was inserted.
+  // Must only be set if the insertion of every row is known.
+  void set_min_insert_timestamp(Timestamp timestamp) {
+    std::lock_guard<LockType> l(lock_);
+    min_insert_timestamp_ = timestamp;
+  }
+
+  // Returns the earliest timestamp at which any row of the rowset was
+  // inserted, or Timestamp::kMin if it isn't known.
+  Timestamp min_insert_timestamp() const {
+    std::lock_guard<LockType> l(lock_);
+    return min_insert_timestamp_;
+  }
+
   void SetColumnDataBlocks(const ColumnIdToBlockIdMap& blocks_by_col_id);
 
+  void SetSecondaryIndexBlocks(const ColumnIdToBlockIdMap& index_blocks_by_col_id);
+
   Status CommitRedoDeltaDataBlock(int64_t dms_id, const BlockId& block_id);
 
   Status CommitUndoDeltaDataBlock(const BlockId& block_id);
@@ -128,6 +145,13 @@ class RowSetMetadata {
     return blocks_by_col_id_;
   }
 
+  // Returns the blocks of the secondary indexes of the columns. The index of
+  // a column is dropped when its base data is replaced.
+  ColumnIdToBlockIdMap GetSecondaryIndexBlocksById() const {
+    std::lock_guard<LockType> l(lock_);
+    return index_blocks_by_col_id_;
+  }
+
   vector<BlockId> redo_delta_blocks() const {
     std::lock_guard<LockType> l(lock_);
     return redo_delta_blocks_;
@@ -181,7 +205,8 @@ class RowSetMetadata {
   explicit RowSetMetadata(TabletMetadata *tablet_metadata)
     : tablet_metadata_(tablet_metadata),
       initted_(false),
-      last_durable_redo_dms_id_(kNoDurableMemStore) {
+      last_durable_redo_dms_id_(kNoDurableMemStore),
+      min_insert_timestamp_(Timestamp::kMin) {
   }
 
   RowSetMetadata(TabletMetadata *tablet_metadata,
@@ -189,7 +214,8 @@ class RowSetMetadata {
     : tablet_metadata_(DCHECK_NOTNULL(tablet_metadata)),
       initted_(true),
       id_(id),
-      last_durable_redo_dms_id_(kNoDurableMemStore) {
+      last_durable_redo_dms_id_(kNoDurableMemStore),
+      min_insert_timestamp_(Timestamp::kMin) {
   }
 
   Status InitFromPB(const RowSetDataPB& pb);
@@ -206,11 +232,14 @@ class RowSetMetadata {
 
   // Map of column ID to block ID.
   ColumnIdToBlockIdMap blocks_by_col_id_;
+  ColumnIdToBlockIdMap index_blocks_by_col_id_;
   std::vector<BlockId> redo_delta_blocks_;
   std::vector<BlockId> undo_delta_blocks_;
 
   int64_t last_durable_redo_dms_id_;
 
+  Timestamp min_insert_timestamp_;
+
   DISALLOW_COPY_AND_ASSIGN(RowSetMetadata);
 };
 
@@ -240,6 +269,10 @@ class RowSetMetadataUpdate {
   // We'll need to replace them instead when we start GCing.
   RowSetMetadataUpdate& SetNewUndoBlock(const BlockId& undo_block);
 
+  // Remove the given UNDO delta blocks, e.g. because they only hold ancient
+  // history. Unlike REDO blocks, they need not be contiguous.
+  RowSetMetadataUpdate& RemoveUndoDeltaBlocks(const std::vector<BlockId>& to_remove);
+
  private:
   friend class RowSetMetadata;
   RowSetMetadata::ColumnIdToBlockIdMap cols_to_replace_;
@@ -252,6 +285,7 @@ class RowSetMetadataUpdate {
   };
   std::vector<ReplaceDeltaBlocks> replace_redo_blocks_;
   BlockId new_undo_block_;
+  std::vector<BlockId> undo_blocks_to_remove_;
 
   DISALLOW_COPY_AND_ASSIGN(RowSetMetadataUpdate);
 };
@@ -17,6 +17,7 @@
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <memory>
 #include <stdio.h>
 #include <unordered_set>
@@ -128,6 +129,48 @@ TEST_F(TestRowSetTree, TestPerformance) {
   }
 }
 
+// Check that a batched lookup of sorted keys finds the same rowsets as
+// looking up each key on its own.
+TEST_F(TestRowSetTree, TestForEachRowSetContainingKeys) {
+  const int kNumRowSets = 100;
+  const int kNumKeys = 1000;
+  SeedRandom();
+
+  RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
+  // Add one-key rowsets and a MemRowSet, which should be returned for every
+  // key.
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("5000", "5000")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("5000", "5000")));
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  // Generate sorted keys, including duplicates and the one-key bound itself.
+  vector<string> key_strs;
+  for (int i = 0; i < kNumKeys; i++) {
+    key_strs.push_back(StringPrintf("%04d", rand() % 10000));
+  }
+  key_strs.push_back("5000");
+  key_strs.push_back("5000");
+  std::sort(key_strs.begin(), key_strs.end());
+  vector<Slice> keys(key_strs.begin(), key_strs.end());
+
+  vector<vector<RowSet*>> batched(keys.size());
+  tree.ForEachRowSetContainingKeys(keys, [&](RowSet* rs, int i) {
+      batched[i].push_back(rs);
+    });
+
+  for (int i = 0; i < keys.size(); i++) {
+    vector<RowSet*> expected;
+    tree.FindRowSetsWithKeyInRange(keys[i], &expected);
+    ASSERT_EQ(vec.back().get(), expected[0]);
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(batched[i].begin(), batched[i].end());
+    ASSERT_EQ(expected, batched[i]) << "key " << key_strs[i];
+  }
+}
+
 TEST_F(TestRowSetTree, TestEndpointsConsistency) {
   const int kNumRowSets = 1000;
   RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
@@ -174,5 +217,119 @@ TEST_F(TestRowSetTree, TestEndpointsConsistency) {
   }
 }
 
+namespace {
+
+// Check that 'a' and 'b' hold the same rowsets and answer queries alike.
+void AssertTreesEquivalent(const RowSetTree& a, const RowSetTree& b) {
+  ASSERT_EQ(a.all_rowsets().size(), b.all_rowsets().size());
+  ASSERT_EQ(a.key_endpoints().size(), b.key_endpoints().size());
+  for (int i = 0; i < a.key_endpoints().size(); i++) {
+    ASSERT_EQ(a.key_endpoints()[i].rowset_, b.key_endpoints()[i].rowset_);
+    ASSERT_EQ(a.key_endpoints()[i].endpoint_, b.key_endpoints()[i].endpoint_);
+  }
+  char lower[32], upper[32];
+  for (int i = 0; i < 100; i++) {
+    int lower_key = rand() % 10000;
+    snprintf(lower, arraysize(lower), "%04d", lower_key);
+    snprintf(upper, arraysize(upper), "%04d", lower_key + rand() % 500);
+    vector<RowSet*> out_a, out_b;
+    a.FindRowSetsWithKeyInRange(Slice(lower, 4), &out_a);
+    b.FindRowSetsWithKeyInRange(Slice(lower, 4), &out_b);
+    std::sort(out_a.begin(), out_a.end());
+    std::sort(out_b.begin(), out_b.end());
+    ASSERT_EQ(out_a, out_b) << "key " << lower;
+
+    out_a.clear();
+    out_b.clear();
+    a.FindRowSetsIntersectingInterval(Slice(lower, 4), Slice(upper, 4), &out_a);
+    b.FindRowSetsIntersectingInterval(Slice(lower, 4), Slice(upper, 4), &out_b);
+    std::sort(out_a.begin(), out_a.end());
+    std::sort(out_b.begin(), out_b.end());
+    ASSERT_EQ(out_a, out_b) << "interval " << lower << "-" << upper;
+  }
+}
+
+} // anonymous namespace
+
+// Test that a tree derived from another by removing and adding rowsets is
+// equivalent to one built from scratch, and that the base tree is unchanged.
+TEST_F(TestRowSetTree, TestIncrementalReset) {
+  SeedRandom();
+  RowSetVector vec = GenerateRandomRowSets(100);
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+  shared_ptr<RowSetTree> tree(new RowSetTree());
+  ASSERT_OK(tree->Reset(vec));
+
+  for (int i = 0; i < 50; i++) {
+    // Remove a few rowsets, sometimes including the MemRowSet, and add some.
+    RowSetVector current = tree->all_rowsets();
+    std::random_shuffle(current.begin(), current.end());
+    RowSetVector to_remove(current.begin(), current.begin() + 3);
+    RowSetVector to_add = GenerateRandomRowSets(2);
+    if (i % 10 == 0) {
+      to_add.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+    }
+
+    shared_ptr<RowSetTree> new_tree(new RowSetTree());
+    ASSERT_OK(new_tree->Reset(*tree, to_remove, to_add));
+
+    RowSetTree expected;
+    ASSERT_OK(expected.Reset(new_tree->all_rowsets()));
+    ASSERT_NO_FATAL_FAILURE(AssertTreesEquivalent(expected, *new_tree));
+
+    RowSetTree expected_base;
+    ASSERT_OK(expected_base.Reset(tree->all_rowsets()));
+    ASSERT_NO_FATAL_FAILURE(AssertTreesEquivalent(expected_base, *tree));
+    tree = new_tree;
+  }
+
+  // Removing a rowset which isn't in the tree fails.
+  RowSetTree bad_tree;
+  ASSERT_TRUE(bad_tree.Reset(*tree, GenerateRandomRowSets(1), {}).IsInvalidArgument());
+}
+
+// Compare rebuilding a tree of many rowsets from scratch with deriving it
+// from the previous tree, for swaps of a few rowsets as done by flushes and
+// compactions.
+TEST_F(TestRowSetTree, TestSwapPerformance) {
+  const int kNumRowSets = 10000;
+  const int kNumSwaps = AllowSlowTests() ? 1000 : 100;
+  SeedRandom();
+  RowSetVector vec = GenerateRandomRowSets(kNumRowSets);
+  shared_ptr<RowSetTree> tree(new RowSetTree());
+  ASSERT_OK(tree->Reset(vec));
+
+  // Each swap replaces three rowsets with two.
+  vector<RowSetVector> to_remove(kNumSwaps);
+  vector<RowSetVector> to_add(kNumSwaps);
+  for (int i = 0; i < kNumSwaps; i++) {
+    to_add[i] = GenerateRandomRowSets(2);
+  }
+
+  LOG_TIMING(INFO, StringPrintf("Rebuilding a tree of %d rowsets %d times",
+                                kNumRowSets, kNumSwaps)) {
+    for (int i = 0; i < kNumSwaps; i++) {
+      RowSetVector post_swap(tree->all_rowsets().begin() + 3, tree->all_rowsets().end());
+      to_remove[i].assign(tree->all_rowsets().begin(), tree->all_rowsets().begin() + 3);
+      post_swap.insert(post_swap.end(), to_add[i].begin(), to_add[i].end());
+      shared_ptr<RowSetTree> new_tree(new RowSetTree());
+      ASSERT_OK(new_tree->Reset(post_swap));
+      tree = new_tree;
+    }
+  }
+
+  tree.reset(new RowSetTree());
+  ASSERT_OK(tree->Reset(vec));
+  LOG_TIMING(INFO, StringPrintf("Deriving a tree of %d rowsets %d times",
+                                kNumRowSets, kNumSwaps)) {
+    for (int i = 0; i < kNumSwaps; i++) {
+      shared_ptr<RowSetTree> new_tree(new RowSetTree());
+      ASSERT_OK(new_tree->Reset(*tree, to_remove[i], to_add[i]));
+      tree = new_tree;
+    }
+  }
+  ASSERT_EQ(kNumRowSets - kNumSwaps, tree->all_rowsets().size());
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -18,30 +18,40 @@
 #include "kudu/tablet/rowset_tree.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
-#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
-#include "kudu/util/interval_tree.h"
-#include "kudu/util/interval_tree-inl.h"
+#include "kudu/util/key_compare.h"
 #include "kudu/util/slice.h"
 
 using std::vector;
 using std::shared_ptr;
+using strings::Substitute;
 
 namespace kudu {
 namespace tablet {
 
+// Entry for use in the treaps.
+struct RowSetWithBounds {
+  RowSet *rowset;
+  string min_key;
+  string max_key;
+};
+
 namespace {
 
 // Lexicographic, first by slice, then by rowset pointer, then by start/stop
 bool RSEndpointBySliceCompare(const RowSetTree::RSEndpoint& a,
                               const RowSetTree::RSEndpoint& b) {
-  int slice_cmp = a.slice_.compare(b.slice_);
+  int slice_cmp = CompareKeys(a.slice_, b.slice_);
   if (slice_cmp) return slice_cmp < 0;
   ptrdiff_t rs_cmp = a.rowset_ - b.rowset_;
   if (rs_cmp) return rs_cmp < 0;
@@ -49,103 +59,212 @@ bool RSEndpointBySliceCompare(const RowSetTree::RSEndpoint& a,
   return false;
 }
 
+RowSetTree::RSEndpoint ToRSEndpoint(const RowSetEndpointTraits::value_type& v) {
+  return v.start ?
+      RowSetTree::RSEndpoint(v.entry->rowset, RowSetTree::START, Slice(v.entry->min_key)) :
+      RowSetTree::RSEndpoint(v.entry->rowset, RowSetTree::STOP, Slice(v.entry->max_key));
+}
+
+// Append the rowsets of the subtree 'node' which contain 'key', in order of
+// their min keys.
+void FindContainingPoint(const PersistentTreap<RowSetIntervalTraits>::Node* node,
+                         const Slice& key,
+                         vector<RowSet*>* rowsets) {
+  // Skip subtrees whose intervals all end before the key.
+  if (node == nullptr || CompareKeys(node->augment, key) < 0) {
+    return;
+  }
+  FindContainingPoint(node->left.get(), key, rowsets);
+  const RowSetWithBounds& rs = *node->value;
+  if (CompareKeys(rs.min_key, key) <= 0) {
+    if (CompareKeys(rs.max_key, key) >= 0) {
+      rowsets->push_back(rs.rowset);
+    }
+    FindContainingPoint(node->right.get(), key, rowsets);
+  }
+}
+
+// Append the rowsets of the subtree 'node' which intersect the closed
+// interval [lower_bound, upper_bound], in order of their min keys.
+void FindIntersectingInterval(const PersistentTreap<RowSetIntervalTraits>::Node* node,
+                              const Slice& lower_bound,
+                              const Slice& upper_bound,
+                              vector<RowSet*>* rowsets) {
+  if (node == nullptr || CompareKeys(node->augment, lower_bound) < 0) {
+    return;
+  }
+  FindIntersectingInterval(node->left.get(), lower_bound, upper_bound, rowsets);
+  const RowSetWithBounds& rs = *node->value;
+  if (CompareKeys(rs.min_key, upper_bound) <= 0) {
+    if (CompareKeys(rs.max_key, lower_bound) >= 0) {
+      rowsets->push_back(rs.rowset);
+    }
+    FindIntersectingInterval(node->right.get(), lower_bound, upper_bound, rowsets);
+  }
+}
+
 } // anonymous namespace
 
-// Entry for use in the interval tree.
-struct RowSetWithBounds {
-  RowSet *rowset;
-  string min_key;
-  string max_key;
-};
+int RowSetIntervalTraits::compare(const value_type& a, const value_type& b) {
+  int cmp = CompareKeys(a->min_key, b->min_key);
+  if (cmp != 0) return cmp;
+  return a->rowset < b->rowset ? -1 : (a->rowset > b->rowset ? 1 : 0);
+}
 
-// Traits struct for IntervalTree.
-struct RowSetIntervalTraits {
-  typedef Slice point_type;
-  typedef RowSetWithBounds *interval_type;
+Slice RowSetIntervalTraits::augment(const value_type& v, const Slice* left, const Slice* right) {
+  Slice max_key(v->max_key);
+  if (left != nullptr && left->compare(max_key) > 0) max_key = *left;
+  if (right != nullptr && right->compare(max_key) > 0) max_key = *right;
+  return max_key;
+}
 
-  static Slice get_left(const RowSetWithBounds *rs) {
-    return Slice(rs->min_key);
-  }
+int RowSetEndpointTraits::compare(const value_type& a, const value_type& b) {
+  RowSetTree::RSEndpoint ea = ToRSEndpoint(a);
+  RowSetTree::RSEndpoint eb = ToRSEndpoint(b);
+  if (RSEndpointBySliceCompare(ea, eb)) return -1;
+  if (RSEndpointBySliceCompare(eb, ea)) return 1;
+  return 0;
+}
 
-  static Slice get_right(const RowSetWithBounds *rs) {
-    return Slice(rs->max_key);
-  }
+namespace {
 
-  static int compare(const Slice &a, const Slice &b) {
-    return a.compare(b);
-  }
-};
+uint64_t NextRowSetTreeId() {
+  static std::atomic<uint64_t> next_id(0);
+  return next_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // anonymous namespace
 
 RowSetTree::RowSetTree()
-  : initted_(false) {
+  : id_(0),
+    initted_(false) {
+}
+
+Status RowSetTree::AddRowSet(const shared_ptr<RowSet>& rs) {
+  string min_key, max_key;
+  Status s = rs->GetBounds(&min_key, &max_key);
+  if (s.IsNotSupported()) {
+    // This rowset is a MemRowSet, for which the bounds change as more
+    // data gets inserted. Therefore we can't put it in the static
+    // interval tree -- instead put it on the list which is consulted
+    // on every access.
+    unbounded_rowsets_.push_back(rs);
+    return Status::OK();
+  } else if (!s.ok()) {
+    LOG(WARNING) << "Unable to construct RowSetTree: "
+                 << rs->ToString() << " unable to determine its bounds: "
+                 << s.ToString();
+    return s;
+  }
+  DCHECK_LE(min_key.compare(max_key), 0)
+    << "Rowset min must be <= max: " << rs->ToString();
+
+  // Load bounds and save entry
+  shared_ptr<RowSetWithBounds> entry(new RowSetWithBounds());
+  entry->rowset = rs.get();
+  entry->min_key = std::move(min_key);
+  entry->max_key = std::move(max_key);
+
+  intervals_ = intervals_.Insert(entry);
+  endpoints_ = endpoints_.Insert({ true, entry });
+  endpoints_ = endpoints_.Insert({ false, entry });
+  if (rs->metadata()) {
+    drs_by_id_ = drs_by_id_.Insert({ rs->metadata()->id(), rs.get() });
+  }
+  return Status::OK();
 }
 
 Status RowSetTree::Reset(const RowSetVector &rowsets) {
   CHECK(!initted_);
-  std::vector<RowSetWithBounds *> entries;
-  RowSetVector unbounded;
-  ElementDeleter deleter(&entries);
-  entries.reserve(rowsets.size());
-  std::vector<RSEndpoint> endpoints;
-  endpoints.reserve(rowsets.size()*2);
 
   // Iterate over each of the provided RowSets, fetching their
-  // bounds and adding them to the local vectors.
+  // bounds and adding them to the treaps.
   for (const shared_ptr<RowSet> &rs : rowsets) {
-    gscoped_ptr<RowSetWithBounds> rsit(new RowSetWithBounds());
-    rsit->rowset = rs.get();
-    string min_key, max_key;
-    Status s = rs->GetBounds(&min_key, &max_key);
-    if (s.IsNotSupported()) {
-      // This rowset is a MemRowSet, for which the bounds change as more
-      // data gets inserted. Therefore we can't put it in the static
-      // interval tree -- instead put it on the list which is consulted
-      // on every access.
-      unbounded.push_back(rs);
-      continue;
-    } else if (!s.ok()) {
-      LOG(WARNING) << "Unable to construct RowSetTree: "
-                   << rs->ToString() << " unable to determine its bounds: "
-                   << s.ToString();
-      return s;
-    }
-    DCHECK_LE(min_key.compare(max_key), 0)
-      << "Rowset min must be <= max: " << rs->ToString();
-
-    // Load bounds and save entry
-    rsit->min_key = std::move(min_key);
-    rsit->max_key = std::move(max_key);
+    RETURN_NOT_OK(AddRowSet(rs));
+  }
+  all_rowsets_.assign(rowsets.begin(), rowsets.end());
 
-    // Load into key endpoints.
-    endpoints.push_back(RSEndpoint(rsit->rowset, START, rsit->min_key));
-    endpoints.push_back(RSEndpoint(rsit->rowset, STOP, rsit->max_key));
+  id_ = NextRowSetTreeId();
+  initted_ = true;
+  return Status::OK();
+}
 
-    entries.push_back(rsit.release());
-  }
+Status RowSetTree::Reset(const RowSetTree& base,
+                         const RowSetVector& rowsets_to_remove,
+                         const RowSetVector& rowsets_to_add) {
+  CHECK(!initted_);
+  DCHECK(base.initted_);
 
-  // Sort endpoints
-  std::sort(endpoints.begin(), endpoints.end(), RSEndpointBySliceCompare);
+  // Start from the structure of 'base', which is shared rather than copied.
+  intervals_ = base.intervals_;
+  endpoints_ = base.endpoints_;
+  drs_by_id_ = base.drs_by_id_;
 
-  // Install the vectors into the object.
-  entries_.swap(entries);
-  unbounded_rowsets_.swap(unbounded);
-  tree_.reset(new IntervalTree<RowSetIntervalTraits>(entries_));
-  key_endpoints_.swap(endpoints);
-  all_rowsets_.assign(rowsets.begin(), rowsets.end());
+  std::unordered_set<RowSet*> to_remove;
+  for (const shared_ptr<RowSet>& rs : rowsets_to_remove) {
+    to_remove.insert(rs.get());
+  }
+  all_rowsets_.reserve(base.all_rowsets_.size() + rowsets_to_add.size());
+  for (const shared_ptr<RowSet>& rs : base.all_rowsets_) {
+    if (!ContainsKey(to_remove, rs.get())) {
+      all_rowsets_.push_back(rs);
+    }
+  }
+  if (all_rowsets_.size() + to_remove.size() != base.all_rowsets_.size()) {
+    return Status::InvalidArgument("rowsets to remove are not all in the base RowSetTree");
+  }
+  for (const shared_ptr<RowSet>& rs : base.unbounded_rowsets_) {
+    if (!ContainsKey(to_remove, rs.get())) {
+      unbounded_rowsets_.push_back(rs);
+    }
+  }
 
-  // Build the mapping from DRS ID to DRS.
-  drs_by_id_.clear();
-  for (auto& rs : all_rowsets_) {
+  for (const shared_ptr<RowSet>& rs : rowsets_to_remove) {
+    if (std::find(base.unbounded_rowsets_.begin(), base.unbounded_rowsets_.end(), rs) !=
+        base.unbounded_rowsets_.end()) {
+      continue;
+    }
+    // The bounds of a rowset in the tree don't change, so they identify
+    // its entries.
+    shared_ptr<RowSetWithBounds> probe(new RowSetWithBounds());
+    probe->rowset = rs.get();
+    RETURN_NOT_OK(rs->GetBounds(&probe->min_key, &probe->max_key));
+    bool found_interval, found_start, found_stop;
+    intervals_ = intervals_.Erase(probe, &found_interval);
+    endpoints_ = endpoints_.Erase({ true, probe }, &found_start);
+    endpoints_ = endpoints_.Erase({ false, probe }, &found_stop);
+    if (!found_interval || !found_start || !found_stop) {
+      return Status::Corruption(Substitute("RowSetTree has no entry for $0 with its bounds",
+                                           rs->ToString()));
+    }
     if (rs->metadata()) {
-      InsertOrDie(&drs_by_id_, rs->metadata()->id(), rs.get());
+      bool found_drs;
+      drs_by_id_ = drs_by_id_.Erase({ rs->metadata()->id(), nullptr }, &found_drs);
+      DCHECK(found_drs);
     }
   }
 
-  initted_ = true;
+  for (const shared_ptr<RowSet>& rs : rowsets_to_add) {
+    RETURN_NOT_OK(AddRowSet(rs));
+    all_rowsets_.push_back(rs);
+  }
 
+  id_ = NextRowSetTreeId();
+  initted_ = true;
   return Status::OK();
 }
 
+const vector<RowSetTree::RSEndpoint>& RowSetTree::key_endpoints() const {
+  DCHECK(initted_);
+  std::call_once(key_endpoints_once_, [this]() {
+    key_endpoints_.reserve(endpoints_.size());
+    endpoints_.ForEach([this](const RowSetEndpointTraits::value_type& v) {
+      key_endpoints_.push_back(ToRSEndpoint(v));
+    });
+  });
+  return key_endpoints_;
+}
+
 void RowSetTree::FindRowSetsIntersectingInterval(const Slice &lower_bound,
                                                  const Slice &upper_bound,
                                                  vector<RowSet *> *rowsets) const {
@@ -156,19 +275,7 @@ void RowSetTree::FindRowSetsIntersectingInterval(const Slice &lower_bound,
     rowsets->push_back(rs.get());
   }
 
-  // perf TODO: make it possible to query using raw Slices
-  // instead of copying to strings here
-  RowSetWithBounds query;
-  query.min_key = lower_bound.ToString();
-  query.max_key = upper_bound.ToString();
-
-  vector<RowSetWithBounds *> from_tree;
-  from_tree.reserve(all_rowsets_.size());
-  tree_->FindIntersectingInterval(&query, &from_tree);
-  rowsets->reserve(rowsets->size() + from_tree.size());
-  for (RowSetWithBounds *rs : from_tree) {
-    rowsets->push_back(rs->rowset);
-  }
+  FindIntersectingInterval(intervals_.root(), lower_bound, upper_bound, rowsets);
 }
 
 void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
@@ -180,19 +287,61 @@ void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
     rowsets->push_back(rs.get());
   }
 
-  // Query the interval tree to efficiently find rowsets with known bounds
-  // whose ranges overlap the probe key.
-  vector<RowSetWithBounds *> from_tree;
-  from_tree.reserve(all_rowsets_.size());
-  tree_->FindContainingPoint(encoded_key, &from_tree);
-  rowsets->reserve(rowsets->size() + from_tree.size());
-  for (RowSetWithBounds *rs : from_tree) {
-    rowsets->push_back(rs->rowset);
+  // Search the treap to efficiently find rowsets with known bounds whose
+  // ranges overlap the probe key.
+  FindContainingPoint(intervals_.root(), encoded_key, rowsets);
+}
+
+void RowSetTree::ForEachRowSetContainingKeys(
+    const vector<Slice>& encoded_keys,
+    const std::function<void(RowSet*, int)>& cb) const {
+  DCHECK(initted_);
+  DCHECK(std::is_sorted(encoded_keys.begin(), encoded_keys.end(),
+                        [](const Slice& a, const Slice& b) { return a.compare(b) < 0; }));
+
+  // The rowsets whose range started strictly before the current key and has
+  // not yet ended.
+  vector<RowSet*> active;
+  vector<RowSet*> starting;
+  const vector<RSEndpoint>& key_endpoints = this->key_endpoints();
+  auto ep = key_endpoints.begin();
+  for (int i = 0; i < encoded_keys.size(); i++) {
+    const Slice& key = encoded_keys[i];
+
+    // Consume all of the endpoints strictly before this key.
+    for (; ep != key_endpoints.end() && CompareKeys(ep->slice_, key) < 0; ++ep) {
+      if (ep->endpoint_ == START) {
+        active.push_back(ep->rowset_);
+      } else {
+        auto it = std::find(active.begin(), active.end(), ep->rowset_);
+        DCHECK(it != active.end());
+        active.erase(it);
+      }
+    }
+
+    // Rowsets which start exactly at this key contain it as well. Rowsets
+    // which stop exactly at this key are still in 'active'. These endpoints
+    // aren't consumed, since the next key may be the same.
+    starting.clear();
+    for (auto it = ep; it != key_endpoints.end() && it->slice_ == key; ++it) {
+      if (it->endpoint_ == START) {
+        starting.push_back(it->rowset_);
+      }
+    }
+
+    for (const shared_ptr<RowSet>& rs : unbounded_rowsets_) {
+      cb(rs.get(), i);
+    }
+    for (RowSet* rs : active) {
+      cb(rs, i);
+    }
+    for (RowSet* rs : starting) {
+      cb(rs, i);
+    }
   }
 }
 
 RowSetTree::~RowSetTree() {
-  STLDeleteElements(&entries_);
 }
 
 } // namespace tablet
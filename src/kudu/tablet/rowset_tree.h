@@ -17,25 +17,65 @@
 #ifndef KUDU_TABLET_ROWSET_MANAGER_H
 #define KUDU_TABLET_ROWSET_MANAGER_H
 
-#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <utility>
 
-#include "kudu/gutil/gscoped_ptr.h"
-#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/persistent_treap.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 #include "kudu/tablet/rowset.h"
 
 namespace kudu {
-
-template<class Traits>
-class IntervalTree;
-
 namespace tablet {
 
-struct RowSetIntervalTraits;
 struct RowSetWithBounds;
 
+// Traits for the treap of the bounded rowsets, ordered by their min keys and
+// augmented with the greatest max key in each subtree.
+struct RowSetIntervalTraits {
+  typedef std::shared_ptr<const RowSetWithBounds> value_type;
+  typedef Slice augment_type;
+
+  static int compare(const value_type& a, const value_type& b);
+  static Slice augment(const value_type& v, const Slice* left, const Slice* right);
+};
+
+// Traits for the treap of the bounded rowsets' key endpoints.
+struct RowSetEndpointTraits {
+  struct value_type {
+    bool start;
+    // Owns the key which the endpoint is at.
+    std::shared_ptr<const RowSetWithBounds> entry;
+  };
+  typedef NoTreapAugment augment_type;
+
+  static int compare(const value_type& a, const value_type& b);
+  static NoTreapAugment augment(const value_type& v,
+                                const NoTreapAugment* left,
+                                const NoTreapAugment* right) {
+    return NoTreapAugment();
+  }
+};
+
+// Traits for the treap of the DiskRowSets, keyed by their ids.
+struct DrsByIdTraits {
+  typedef std::pair<int64_t, RowSet*> value_type;
+  typedef NoTreapAugment augment_type;
+
+  static int compare(const value_type& a, const value_type& b) {
+    return a.first < b.first ? -1 : (a.first > b.first ? 1 : 0);
+  }
+  static NoTreapAugment augment(const value_type& v,
+                                const NoTreapAugment* left,
+                                const NoTreapAugment* right) {
+    return NoTreapAugment();
+  }
+};
+
 // Class which encapsulates the set of rowsets which are active for a given
 // Tablet. This provides efficient lookup by key for RowSets which may overlap
 // that key range.
@@ -44,6 +84,11 @@ struct RowSetWithBounds;
 // intervals generated by the row sets (for instance, if a tablet has
 // rowsets [0, 2] and [1, 3] it has three implicit contiguous intervals:
 // [0, 1], [1, 2], and [2, 3].
+//
+// The rowsets are kept in persistent treaps, so a tree derived from another
+// by adding and removing some rowsets shares most of its structure with the
+// original, and costs O(lg n) per changed rowset to build rather than a
+// full rebuild.
 class RowSetTree {
  public:
   // An RSEndpoint is a POD which associates a rowset, an EndpointType
@@ -64,6 +109,14 @@ class RowSetTree {
 
   RowSetTree();
   Status Reset(const RowSetVector &rowsets);
+
+  // Reset to the rowsets of 'base', less 'rowsets_to_remove', which must
+  // all be in 'base', plus 'rowsets_to_add'. Only the changed rowsets'
+  // bounds are fetched, and the result shares most of its structure with
+  // 'base'.
+  Status Reset(const RowSetTree& base,
+               const RowSetVector& rowsets_to_remove,
+               const RowSetVector& rowsets_to_add);
   ~RowSetTree();
 
   // Return all RowSets whose range may contain the given encoded key.
@@ -73,41 +126,65 @@ class RowSetTree {
   void FindRowSetsWithKeyInRange(const Slice &encoded_key,
                                  std::vector<RowSet *> *rowsets) const;
 
+  // For each of the given encoded keys, which must be sorted, invoke
+  // 'cb(rowset, key_idx)' once for every rowset which may contain
+  // encoded_keys[key_idx]: every rowset with known bounds whose range contains
+  // the key, and every rowset with unknown bounds (e.g. a MemRowSet being
+  // flushed), as with FindRowSetsWithKeyInRange().
+  //
+  // This is a single merge pass over the sorted key endpoints, and so is
+  // cheaper than FindRowSetsWithKeyInRange() for each key when looking up
+  // a large batch of keys.
+  void ForEachRowSetContainingKeys(const std::vector<Slice>& encoded_keys,
+                                   const std::function<void(RowSet*, int)>& cb) const;
+
   void FindRowSetsIntersectingInterval(const Slice &lower_bound,
                                        const Slice &upper_bound,
                                        std::vector<RowSet *> *rowsets) const;
 
   const RowSetVector &all_rowsets() const { return all_rowsets_; }
 
+  // An identifier which is unique to this tree among the trees built by
+  // this process, e.g. for caching computations over a tree's rowsets.
+  uint64_t id() const { return id_; }
+
   RowSet* drs_by_id(int64_t drs_id) const {
-    return FindPtrOrNull(drs_by_id_, drs_id);
+    const DrsByIdTraits::value_type* drs = drs_by_id_.Find({ drs_id, nullptr });
+    return drs != nullptr ? drs->second : nullptr;
   }
 
   // Iterates over RowSetTree::RSEndpoint, guaranteed to be ordered and for
   // any rowset to appear exactly twice, once at its start slice and once at
   // its stop slice, equivalent to its GetBounds() values.
-  const std::vector<RSEndpoint>& key_endpoints() const { return key_endpoints_; }
+  //
+  // The vector is built on the first call.
+  const std::vector<RSEndpoint>& key_endpoints() const;
 
  private:
-  // Interval tree of the rowsets. Used to efficiently find rowsets which might contain
-  // a probe row.
-  gscoped_ptr<IntervalTree<RowSetIntervalTraits> > tree_;
+  DISALLOW_COPY_AND_ASSIGN(RowSetTree);
+
+  // Add 'rs' to the treaps, or to unbounded_rowsets_ if its bounds are
+  // unknown.
+  Status AddRowSet(const std::shared_ptr<RowSet>& rs);
+
+  // The bounded rowsets. Used to efficiently find rowsets which might
+  // contain a probe row.
+  PersistentTreap<RowSetIntervalTraits> intervals_;
 
   // Ordered map of all the interval endpoints, holding the implicit contiguous
   // intervals
   // TODO map to usage statistics as well. See KUDU-???
-  std::vector<RSEndpoint> key_endpoints_;
+  PersistentTreap<RowSetEndpointTraits> endpoints_;
 
-  // Container for all of the entries in tree_. IntervalTree does
-  // not itself manage memory, so this provides a simple way to enumerate
-  // all the entry structs and free them in the destructor.
-  std::vector<RowSetWithBounds *> entries_;
+  // endpoints_ as a vector, built by the first call to key_endpoints().
+  mutable std::once_flag key_endpoints_once_;
+  mutable std::vector<RSEndpoint> key_endpoints_;
 
   // All of the rowsets which were put in this RowSetTree.
   RowSetVector all_rowsets_;
 
   // The DiskRowSets in this RowSetTree, keyed by their id.
-  std::unordered_map<int64_t, RowSet*> drs_by_id_;
+  PersistentTreap<DrsByIdTraits> drs_by_id_;
 
   // Rowsets for which the bounds are unknown -- e.g because they
   // are mutable (MemRowSets).
@@ -116,6 +193,8 @@ class RowSetTree {
   // stored in the interval tree.
   RowSetVector unbounded_rowsets_;
 
+  uint64_t id_;
+
   bool initted_;
 };
 
@@ -16,15 +16,21 @@
 // under the License.
 
 #include <ctime>
+#include <map>
 
 #include <glog/logging.h>
 
 #include "kudu/cfile/cfile_util.h"
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/row.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/common/wire_protocol.pb.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/deltafile.h"
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/tablet.h"
@@ -32,6 +38,17 @@
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
 
+DECLARE_bool(tablet_adaptive_block_size);
+DECLARE_int32(tablet_adaptive_block_size_point_lookup_bytes);
+DECLARE_int32(tablet_adaptive_block_size_point_lookup_rows);
+DECLARE_int32(tablet_compaction_ranges);
+DECLARE_int32(tablet_flush_ranges);
+DECLARE_int32(tablet_row_cache_capacity_mb);
+DECLARE_bool(tablet_prune_rowsets_by_insert_timestamp);
+DECLARE_int64(tablet_scan_max_buffered_mb);
+DECLARE_int32(tablet_scan_parallelism);
+DECLARE_int32(tablet_write_key_sampling_interval);
+
 DEFINE_int32(testflush_num_inserts, 1000,
              "Number of rows inserted in TestFlush");
 DEFINE_int32(testiterator_num_inserts, 1000,
@@ -40,6 +57,7 @@ DEFINE_int32(testcompaction_num_rows, 1000,
              "Number of rows per rowset in TestCompaction");
 
 using std::shared_ptr;
+using std::unique_ptr;
 
 namespace kudu {
 namespace tablet {
@@ -92,8 +110,235 @@ TYPED_TEST(TestTablet, TestFlush) {
   ASSERT_EQ(dfr->delta_stats().delete_count(), max_rows);
 }
 
+// Test a MemRowSet flush which is split into concurrently written key ranges.
+TYPED_TEST(TestTablet, TestFlushInRanges) {
+  FLAGS_tablet_flush_ranges = 4;
+  MvccSnapshot before_inserts(*this->tablet()->mvcc_manager());
+  uint64_t max_rows = this->ClampRowCount(FLAGS_testflush_num_inserts);
+  this->InsertTestRows(0, max_rows, 0);
+
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_EQ(4, this->tablet()->num_rowsets());
+  this->VerifyTestRows(0, max_rows);
+
+  // The rows' insertions were flushed as UNDOs in each range.
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, before_inserts,
+                                           UNORDERED, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  int fetched;
+  ASSERT_OK(SilentIterateToStringList(iter.get(), &fetched));
+  ASSERT_EQ(0, fetched);
+
+  // The output rowsets are disjoint, so they can be compacted together.
+  ASSERT_OK(this->tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  this->VerifyTestRows(0, max_rows);
+}
+
+// Test that flushed rowsets record the earliest insertion of their rows, and
+// that snapshot scans before it skip them without changing their results.
+TYPED_TEST(TestTablet, TestPruneRowSetsByInsertTimestamp) {
+  FLAGS_tablet_prune_rowsets_by_insert_timestamp = true;
+  uint64_t max_rows = this->ClampRowCount(FLAGS_testflush_num_inserts);
+  MvccSnapshot before_inserts(*this->tablet()->mvcc_manager());
+  this->InsertTestRows(0, max_rows, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  MvccSnapshot before_second_inserts(*this->tablet()->mvcc_manager());
+  this->InsertTestRows(max_rows, max_rows, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_EQ(2, this->tablet()->num_rowsets());
+
+  for (const auto& rowset_meta : this->tablet()->metadata()->rowsets()) {
+    ASSERT_NE(Timestamp::kMin, rowset_meta->min_insert_timestamp());
+  }
+
+  auto count_rows = [&](const MvccSnapshot& snap, int* fetched) {
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, snap, UNORDERED, &iter));
+    ASSERT_OK(iter->Init(nullptr));
+    ASSERT_OK(SilentIterateToStringList(iter.get(), fetched));
+  };
+  int fetched;
+  NO_FATALS(count_rows(before_inserts, &fetched));
+  ASSERT_EQ(0, fetched);
+  NO_FATALS(count_rows(before_second_inserts, &fetched));
+  ASSERT_EQ(static_cast<int>(max_rows), fetched);
+  NO_FATALS(count_rows(MvccSnapshot(*this->tablet()->mvcc_manager()), &fetched));
+  ASSERT_EQ(static_cast<int>(max_rows * 2), fetched);
+
+  // Compacting the rowsets keeps the insertions of the rows.
+  ASSERT_OK(this->tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  for (const auto& rowset_meta : this->tablet()->metadata()->rowsets()) {
+    ASSERT_NE(Timestamp::kMin, rowset_meta->min_insert_timestamp());
+  }
+  NO_FATALS(count_rows(before_inserts, &fetched));
+  ASSERT_EQ(0, fetched);
+  NO_FATALS(count_rows(before_second_inserts, &fetched));
+  ASSERT_EQ(static_cast<int>(max_rows), fetched);
+}
+
+TYPED_TEST(TestTablet, TestDiffScan) {
+  const int64_t num_rows = this->ClampRowCount(100);
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  const Timestamp before_inserts = this->clock()->Now();
+  for (int64_t i = 0; i < num_rows; i++) {
+    ASSERT_OK(this->InsertTestRow(&writer, i, 0));
+  }
+  ASSERT_OK(this->tablet()->Flush());
+  const Timestamp before_changes = this->clock()->Now();
+
+  // Change some rows, with the changes split between the DeltaMemStore, a
+  // delta file and the MemRowSet.
+  int expected_inserts = 0;
+  int expected_updates = 0;
+  int expected_deletes = 0;
+  for (int64_t i = 0; i < num_rows; i++) {
+    if (i % 5 == 1) {
+      ASSERT_OK(this->DeleteTestRow(&writer, i));
+      expected_deletes++;
+    } else if (i % 3 == 0) {
+      ASSERT_OK(this->UpdateTestRow(&writer, i, 1));
+      expected_updates++;
+    } else if (i % 7 == 2) {
+      // A row changed and then changed back isn't a change.
+      ASSERT_OK(this->UpdateTestRow(&writer, i, 1));
+      ASSERT_OK(this->UpdateTestRow(&writer, i, 0));
+    }
+  }
+  ASSERT_OK(this->tablet()->FlushBiggestDMS());
+  for (int64_t i = num_rows; i < num_rows + 10; i++) {
+    ASSERT_OK(this->InsertTestRow(&writer, i, 0));
+    expected_inserts++;
+  }
+  const Timestamp after_changes = this->clock()->Now();
+
+  auto count_changes = [&](Timestamp start, Timestamp end,
+                           int* inserts, int* updates, int* deletes) {
+    *inserts = *updates = *deletes = 0;
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(this->tablet()->NewDiffRowIterator(this->client_schema_, start, end, &iter));
+    ASSERT_OK(iter->Init(nullptr));
+    const Schema& schema = iter->schema();
+    const size_t op_col = schema.num_columns() - 1;
+    ASSERT_EQ(Tablet::DiffIterator::kOpTypeColumnName, schema.column(op_col).name());
+    Arena arena(1024, 1024 * 1024);
+    RowBlock block(schema, 100, &arena);
+    while (iter->HasNext()) {
+      ASSERT_OK(iter->NextBlock(&block));
+      for (size_t i = 0; i < block.nrows(); i++) {
+        ASSERT_TRUE(block.selection_vector()->IsRowSelected(i));
+        switch (*schema.ExtractColumnFromRow<INT8>(block.row(i), op_col)) {
+          case RowOperationsPB::INSERT: (*inserts)++; break;
+          case RowOperationsPB::UPDATE: (*updates)++; break;
+          case RowOperationsPB::DELETE: (*deletes)++; break;
+          default: FAIL() << "unexpected op type";
+        }
+      }
+    }
+  };
+
+  int inserts, updates, deletes;
+  NO_FATALS(count_changes(before_changes, after_changes, &inserts, &updates, &deletes));
+  EXPECT_EQ(expected_inserts, inserts);
+  EXPECT_EQ(expected_updates, updates);
+  EXPECT_EQ(expected_deletes, deletes);
+
+  // The interval of the original inserts only has inserts.
+  NO_FATALS(count_changes(before_inserts, before_changes, &inserts, &updates, &deletes));
+  EXPECT_EQ(num_rows, inserts);
+  EXPECT_EQ(0, updates + deletes);
+
+  // An empty interval has no changes, and neither does one after the
+  // changes once they are flushed.
+  NO_FATALS(count_changes(after_changes, after_changes, &inserts, &updates, &deletes));
+  EXPECT_EQ(0, inserts + updates + deletes);
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->tablet()->FlushBiggestDMS());
+  NO_FATALS(count_changes(after_changes, this->clock()->Now(), &inserts, &updates, &deletes));
+  EXPECT_EQ(0, inserts + updates + deletes);
+
+  // The rows are matched by their keys, which must be projected.
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(this->tablet()->NewDiffRowIterator(this->client_schema_.CreateKeyProjection(),
+                                               before_changes, after_changes, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  const Schema& schema = this->client_schema_;
+  Schema no_key_projection({ schema.column(schema.num_columns() - 1) }, 0);
+  ASSERT_OK(this->tablet()->NewDiffRowIterator(no_key_projection, before_changes,
+                                               after_changes, &iter));
+  Status s = iter->Init(nullptr);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
+TYPED_TEST(TestTablet, TestCompactInRanges) {
+  FLAGS_tablet_compaction_ranges = 4;
+  uint64_t max_rows = this->ClampRowCount(FLAGS_testflush_num_inserts);
+  MvccSnapshot before_inserts(*this->tablet()->mvcc_manager());
+
+  // Write overlapping rowsets by interleaving the keys of two flushes.
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int flush = 0; flush < 2; flush++) {
+    for (uint64_t i = flush; i < max_rows; i += 2) {
+      ASSERT_OK(this->InsertTestRow(&writer, i, 0));
+    }
+    ASSERT_OK(this->tablet()->Flush());
+  }
+  ASSERT_EQ(2, this->tablet()->num_rowsets());
+  MvccSnapshot before_updates(*this->tablet()->mvcc_manager());
+  for (uint64_t i = 0; i < max_rows; i += 3) {
+    ASSERT_OK(this->UpdateTestRow(&writer, i, 1));
+  }
+
+  ASSERT_OK(this->tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_GT(this->tablet()->num_rowsets(), 1);
+
+  // The current and historical data survive the compaction.
+  vector<string> rows;
+  ASSERT_OK(this->IterateToStringList(&rows));
+  ASSERT_EQ(max_rows, rows.size());
+
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, before_inserts,
+                                           UNORDERED, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  int fetched;
+  ASSERT_OK(SilentIterateToStringList(iter.get(), &fetched));
+  ASSERT_EQ(0, fetched);
+
+  vector<MvccSnapshot> snaps = { before_updates };
+  vector<vector<string>* > rows_before_updates;
+  CollectRowsForSnapshots(this->tablet().get(), this->client_schema_,
+                          snaps, &rows_before_updates);
+  ASSERT_EQ(max_rows, rows_before_updates[0]->size());
+  for (const string& row : *rows_before_updates[0]) {
+    ASSERT_STR_CONTAINS(row, "int32 val=0)");
+  }
+  STLDeleteElements(&rows_before_updates);
+}
+
 // Test that historical data for a row is maintained even after the row
 // is flushed from the memrowset.
+// Test that a sample of the written keys is kept once enabled.
+TYPED_TEST(TestTablet, TestSampledWriteKeys) {
+  vector<string> keys;
+  this->InsertTestRows(0, 100, 0);
+  this->tablet()->TakeSampledWriteKeys(&keys);
+  ASSERT_TRUE(keys.empty());
+
+  FLAGS_tablet_write_key_sampling_interval = 10;
+  this->InsertTestRows(100, 1000, 0);
+  this->tablet()->TakeSampledWriteKeys(&keys);
+  ASSERT_FALSE(keys.empty());
+  ASSERT_LE(keys.size(), 100);
+  for (const string& key : keys) {
+    ASSERT_FALSE(key.empty());
+  }
+
+  // Taking the sample empties it.
+  this->tablet()->TakeSampledWriteKeys(&keys);
+  ASSERT_TRUE(keys.empty());
+}
+
 TYPED_TEST(TestTablet, TestInsertsAndMutationsAreUndoneWithMVCCAfterFlush) {
   // Insert 5 rows into the memrowset.
   // After the first one, each time we insert a new row we mutate
@@ -219,6 +464,108 @@ TYPED_TEST(TestTablet, TestInsertDuplicateKey) {
   ASSERT_EQ(1, this->TabletCount());
 }
 
+// Test that when the keys of a write batch are checked against the
+// DiskRowSets together, duplicates are still detected and UPSERTs of
+// flushed rows still become updates.
+TYPED_TEST(TestTablet, TestBatchedInsertDuplicateKeys) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+
+  // Create two DiskRowSets with disjoint keys.
+  this->InsertTestRows(0, 10, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  this->InsertTestRows(10, 10, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_EQ(20, this->TabletCount());
+
+  // A batch of unsorted INSERTs, some of which are already in the DRSs,
+  // and one of which is duplicated within the batch itself.
+  vector<int> insert_keys = { 15, 25, 5, 30, 25 };
+  vector<unique_ptr<KuduPartialRow>> rows;
+  vector<LocalTabletWriter::Op> ops;
+  for (int key : insert_keys) {
+    rows.emplace_back(new KuduPartialRow(&this->client_schema_));
+    this->setup_.BuildRow(rows.back().get(), key, 0);
+    ops.emplace_back(RowOperationsPB::INSERT, rows.back().get());
+  }
+  Status s = writer.WriteBatch(ops);
+  ASSERT_STR_CONTAINS(s.ToString(), "key already present");
+  ASSERT_EQ(22, this->TabletCount());
+
+  // A batch of UPSERTs against keys in both DRSs and a new key.
+  rows.clear();
+  ops.clear();
+  vector<int> upsert_keys = { 5, 40, 15 };
+  for (int key : upsert_keys) {
+    rows.emplace_back(new KuduPartialRow(&this->client_schema_));
+    this->setup_.BuildRow(rows.back().get(), key, 7);
+    ops.emplace_back(RowOperationsPB::UPSERT, rows.back().get());
+  }
+  ASSERT_OK(writer.WriteBatch(ops));
+  ASSERT_EQ(23, this->TabletCount());
+
+  vector<string> out_rows;
+  ASSERT_OK(this->IterateToStringList(&out_rows));
+  for (int key : upsert_keys) {
+    string expected = this->setup_.FormatDebugRow(key, 7, false);
+    ASSERT_TRUE(std::find(out_rows.begin(), out_rows.end(), expected) != out_rows.end())
+        << expected;
+  }
+}
+
+// Hook implementation which runs a lambda function once the MemRowSet
+// being flushed has been swapped out for a new one.
+template<class HookFunc>
+class RunAfterSwapNewMemRowSet : public Tablet::FlushFaultHooks {
+ public:
+  explicit RunAfterSwapNewMemRowSet(HookFunc hook)
+      : hook_(std::move(hook)) {}
+
+  Status PostSwapNewMemRowSet() override {
+    hook_();
+    return Status::OK();
+  }
+ private:
+  const HookFunc hook_;
+};
+
+// Test that batched key checks still find the rows of a MemRowSet which is
+// being flushed, and which the RowSetTree holds as an unbounded rowset.
+TYPED_TEST(TestTablet, TestBatchedInsertDuplicateKeysDuringFlush) {
+  this->InsertTestRows(0, 10, 0);
+
+  vector<unique_ptr<KuduPartialRow>> rows;
+  auto write_batch = [&](RowOperationsPB::Type type, const vector<int>& keys, int val) {
+    LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+    vector<LocalTabletWriter::Op> ops;
+    for (int key : keys) {
+      rows.emplace_back(new KuduPartialRow(&this->client_schema_));
+      this->setup_.BuildRow(rows.back().get(), key, val);
+      ops.emplace_back(type, rows.back().get());
+    }
+    return writer.WriteBatch(ops);
+  };
+  auto hook = [&]() {
+    // Key 5 is in the MemRowSet being flushed.
+    Status s = write_batch(RowOperationsPB::INSERT, { 5, 20 }, 0);
+    CHECK(s.IsAlreadyPresent()) << s.ToString();
+    // Key 3 is too, so its UPSERT must update it rather than insert it again.
+    CHECK_OK(write_batch(RowOperationsPB::UPSERT, { 3, 30 }, 7));
+  };
+  shared_ptr<Tablet::FlushFaultHooks> hooks(
+      new RunAfterSwapNewMemRowSet<decltype(hook)>(hook));
+  this->tablet()->SetFlushHooksForTests(hooks);
+  ASSERT_OK(this->tablet()->Flush());
+
+  ASSERT_EQ(12, this->TabletCount());
+  vector<string> out_rows;
+  ASSERT_OK(this->IterateToStringList(&out_rows));
+  for (int key : { 3, 30 }) {
+    string expected = this->setup_.FormatDebugRow(key, 7, false);
+    ASSERT_TRUE(std::find(out_rows.begin(), out_rows.end(), expected) != out_rows.end())
+        << expected;
+  }
+}
+
 // Tests that we are able to handle reinserts properly.
 //
 // Namely tests that:
@@ -647,6 +994,207 @@ TYPED_TEST(TestTablet, TestRowIteratorComplex) {
     << "expected to see all inserted data through iterator.";
 }
 
+// Test an unordered scan which reads several rowsets concurrently.
+TYPED_TEST(TestTablet, TestRowIteratorParallel) {
+  FLAGS_tablet_scan_parallelism = 4;
+  // Buffer a single block at a time, so that the readers wait on the scan.
+  FLAGS_tablet_scan_max_buffered_mb = 0;
+  uint64_t max_rows = this->ClampRowCount(FLAGS_testiterator_num_inserts);
+
+  // Spread the rows over several DiskRowSets and the MemRowSet.
+  int32_t rows_per_rowset = max_rows / 4;
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int32_t i = 0; i < max_rows; i++) {
+    ASSERT_OK_FAST(this->InsertTestRow(&writer, i, 0));
+    if (i % rows_per_rowset == rows_per_rowset - 1) {
+      ASSERT_OK(this->tablet()->Flush());
+    }
+  }
+  for (int32_t i = 0; i < max_rows; i += 7) {
+    ASSERT_OK_FAST(this->UpdateTestRow(&writer, i, i));
+  }
+
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  ASSERT_STR_CONTAINS(iter->ToString(), "ParallelUnion(");
+
+  // Destroy an iterator with rows still buffered.
+  RowBlock block(this->client_schema_, 10, &this->arena_);
+  ASSERT_TRUE(iter->HasNext());
+  ASSERT_OK(iter->NextBlock(&block));
+  ASSERT_EQ(10, block.nrows());
+  iter.reset();
+
+  std::function<bool(int32_t, int32_t)> verifier = [](int32_t key, int32_t val) {
+    return val == (key % 7 == 0 ? key : 0);
+  };
+  this->VerifyTestRowsWithVerifier(0, max_rows, verifier);
+}
+
+// Test that a scan with a limit returns no more live rows than the limit,
+// whether the tablet's rowsets are merged or scanned one after the other.
+TYPED_TEST(TestTablet, TestRowIteratorLimit) {
+  FLAGS_tablet_scan_parallelism = 4;
+  uint64_t max_rows = this->ClampRowCount(FLAGS_testiterator_num_inserts);
+
+  // Spread the rows over several DiskRowSets and the MemRowSet, and delete
+  // every other row so that some rows are not selected.
+  int32_t rows_per_rowset = max_rows / 4;
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int32_t i = 0; i < max_rows; i++) {
+    ASSERT_OK_FAST(this->InsertTestRow(&writer, i, 0));
+    if (i % rows_per_rowset == rows_per_rowset - 1) {
+      ASSERT_OK(this->tablet()->Flush());
+    }
+  }
+  for (int32_t i = 0; i < max_rows; i += 2) {
+    ASSERT_OK_FAST(this->DeleteTestRow(&writer, i));
+  }
+  const int num_live_rows = max_rows / 2;
+
+  for (OrderMode order : { UNORDERED, ORDERED }) {
+    for (int limit : { 0, 1, 7, num_live_rows, num_live_rows + 1 }) {
+      SCOPED_TRACE(strings::Substitute("order: $0, limit: $1", order, limit));
+      MvccSnapshot snap(*this->tablet()->mvcc_manager());
+      gscoped_ptr<RowwiseIterator> iter;
+      ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, snap, order, &iter));
+      ScanSpec spec;
+      spec.set_limit(limit);
+      ASSERT_OK(iter->Init(&spec));
+      ASSERT_STR_NOT_CONTAINS(iter->ToString(), "ParallelUnion(");
+      int fetched;
+      ASSERT_OK(SilentIterateToStringList(iter.get(), &fetched));
+      ASSERT_EQ(std::min(limit, num_live_rows), fetched);
+    }
+  }
+}
+
+// Test that the columns mostly read by point lookups are written with
+// small blocks when --tablet_adaptive_block_size is set.
+TYPED_TEST(TestTablet, TestAdaptiveBlockSizes) {
+  FLAGS_tablet_adaptive_block_size_point_lookup_rows = 1;
+  FLAGS_tablet_adaptive_block_size_point_lookup_bytes = 4096;
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int32_t i = 0; i < 10; i++) {
+    ASSERT_OK_FAST(this->InsertTestRow(&writer, i, 0));
+  }
+
+  auto scan = [&](const Schema& projection, int limit) {
+    MvccSnapshot snap(*this->tablet()->mvcc_manager());
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(this->tablet()->NewRowIterator(projection, snap, UNORDERED, &iter));
+    ScanSpec spec;
+    spec.set_limit(limit);
+    ASSERT_OK(iter->Init(&spec));
+    int fetched;
+    ASSERT_OK(SilentIterateToStringList(iter.get(), &fetched));
+  };
+
+  // Reads aren't recorded unless the flag is set.
+  NO_FATALS(scan(this->client_schema_, 1));
+  FLAGS_tablet_adaptive_block_size = true;
+  ASSERT_TRUE(this->tablet()->AdaptiveColumnBlockSizes().empty());
+
+  // Look up single rows of all of the columns, and scan the key columns, so
+  // that only the non-key columns are mostly read by point lookups.
+  for (int i = 0; i < 5; i++) {
+    NO_FATALS(scan(this->client_schema_, 1));
+    NO_FATALS(scan(this->client_schema_.CreateKeyProjection(), -1));
+  }
+  const Schema& schema = *this->tablet()->schema();
+  std::map<ColumnId, int32_t> block_sizes = this->tablet()->AdaptiveColumnBlockSizes();
+  ASSERT_EQ(schema.num_columns() - schema.num_key_columns(), block_sizes.size());
+  for (size_t i = 0; i < schema.num_columns(); i++) {
+    if (schema.is_key_column(i)) {
+      ASSERT_FALSE(ContainsKey(block_sizes, schema.column_id(i)));
+    } else {
+      ASSERT_EQ(4096, FindOrDie(block_sizes, schema.column_id(i)));
+    }
+  }
+
+  // The rows written with the small blocks read back the same.
+  ASSERT_OK(this->tablet()->Flush());
+  vector<string> rows;
+  ASSERT_OK(this->IterateToStringList(&rows));
+  ASSERT_EQ(10, rows.size());
+}
+
+TYPED_TEST(TestTablet, TestRowCache) {
+  FLAGS_tablet_row_cache_capacity_mb = 1;
+  this->TabletReOpen();
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  for (int32_t i = 0; i < 10; i++) {
+    ASSERT_OK_FAST(this->InsertTestRow(&writer, i, 0));
+  }
+
+  // Look up the row of 'key_idx', and return whether it came from the cache.
+  const Schema& schema = *this->tablet()->schema();
+  Arena arena(1024, 1024 * 1024);
+  auto lookup = [&](const Schema& projection, int64_t key_idx, bool latest,
+                    vector<string>* rows, bool* hit) {
+    KuduPartialRow row(&this->client_schema_);
+    this->setup_.BuildRowKey(&row, key_idx);
+    string encoded;
+    ASSERT_OK(row.EncodeRowKey(&encoded));
+    gscoped_ptr<EncodedKey> lower;
+    gscoped_ptr<EncodedKey> upper;
+    ASSERT_OK(EncodedKey::DecodeEncodedString(schema, &arena, encoded, &lower));
+    ASSERT_OK(EncodedKey::DecodeEncodedString(schema, &arena, encoded, &upper));
+    ASSERT_OK(EncodedKey::IncrementEncodedKey(schema, &upper, &arena));
+    ScanSpec spec;
+    spec.SetLowerBoundKey(lower.get());
+    spec.SetExclusiveUpperBoundKey(upper.get());
+
+    gscoped_ptr<RowwiseIterator> iter;
+    if (latest) {
+      ASSERT_OK(this->tablet()->NewRowIterator(projection, &iter));
+    } else {
+      MvccSnapshot snap(*this->tablet()->mvcc_manager());
+      ASSERT_OK(this->tablet()->NewRowIterator(projection, snap, UNORDERED, &iter));
+    }
+    ASSERT_OK(iter->Init(&spec));
+    *hit = iter->ToString() == "tablet iterator: row cache";
+    rows->clear();
+    ASSERT_OK(IterateToStringList(iter.get(), rows));
+  };
+
+  // The first lookup fills the cache, and the second reads from it.
+  vector<string> rows;
+  vector<string> cached_rows;
+  bool hit;
+  NO_FATALS(lookup(this->client_schema_, 5, true, &rows, &hit));
+  ASSERT_FALSE(hit);
+  ASSERT_EQ(1, rows.size());
+  NO_FATALS(lookup(this->client_schema_, 5, true, &cached_rows, &hit));
+  ASSERT_TRUE(hit);
+  ASSERT_EQ(rows, cached_rows);
+
+  // Snapshot scans and other projections don't use the cached row.
+  NO_FATALS(lookup(this->client_schema_, 5, false, &cached_rows, &hit));
+  ASSERT_FALSE(hit);
+  NO_FATALS(lookup(this->client_schema_.CreateKeyProjection(), 5, true, &cached_rows, &hit));
+  ASSERT_FALSE(hit);
+
+  // Writing the row evicts it, and the next lookup caches the new version.
+  ASSERT_OK(this->UpdateTestRow(&writer, 5, 100));
+  NO_FATALS(lookup(this->client_schema_, 5, true, &rows, &hit));
+  ASSERT_FALSE(hit);
+  ASSERT_EQ(1, rows.size());
+  ASSERT_EQ(this->setup_.FormatDebugRow(5, 100, true), rows[0]);
+  NO_FATALS(lookup(this->client_schema_, 5, true, &cached_rows, &hit));
+  ASSERT_TRUE(hit);
+  ASSERT_EQ(rows, cached_rows);
+
+  // Deleted rows aren't cached.
+  ASSERT_OK(this->DeleteTestRow(&writer, 5));
+  NO_FATALS(lookup(this->client_schema_, 5, true, &rows, &hit));
+  ASSERT_FALSE(hit);
+  ASSERT_TRUE(rows.empty());
+  NO_FATALS(lookup(this->client_schema_, 5, true, &rows, &hit));
+  ASSERT_FALSE(hit);
+}
+
 // Test that, when a tablet has flushed data and is
 // reopened, that the data persists
 TYPED_TEST(TestTablet, TestInsertsPersist) {
@@ -1039,6 +1587,105 @@ TYPED_TEST(TestTablet, TestCompactionWithConcurrentMutation) {
   }
 }
 
+// Test that bulk loaded rows become visible all at once, are hidden from
+// snapshots taken before the load, persist across a restart, and can't
+// duplicate rows which are already in the tablet.
+TYPED_TEST(TestTablet, TestBulkLoad) {
+  uint64_t num_rows = this->ClampRowCount(1000);
+
+  // Stage the rows in a second tablet, whose ordered iterator yields them in
+  // key order.
+  TabletHarness::Options opts(this->GetTestPath("bulk_load_source"));
+  TabletHarness source(this->schema_, opts);
+  ASSERT_OK(source.Create(true));
+  ASSERT_OK(source.Open());
+  {
+    LocalTabletWriter writer(source.tablet().get(), &this->client_schema_);
+    KuduPartialRow row(&this->client_schema_);
+    for (int64_t i = 0; i < num_rows; i++) {
+      this->setup_.BuildRow(&row, i, 0);
+      ASSERT_OK(writer.Insert(row));
+    }
+  }
+  MvccSnapshot source_snap(*source.tablet()->mvcc_manager());
+
+  MvccSnapshot before_load(*this->tablet()->mvcc_manager());
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(source.tablet()->NewRowIterator(this->client_schema_, source_snap, ORDERED, &iter));
+  ASSERT_OK(this->tablet()->BulkLoad(iter.get()));
+  ASSERT_GE(this->tablet()->num_rowsets(), 1);
+  ASSERT_TRUE(this->tablet()->MemRowSetEmpty());
+  this->VerifyTestRows(0, num_rows);
+
+  ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, before_load, UNORDERED, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  int fetched;
+  ASSERT_OK(SilentIterateToStringList(iter.get(), &fetched));
+  ASSERT_EQ(0, fetched);
+
+  // Loading the same keys again must fail without loading anything.
+  ASSERT_OK(source.tablet()->NewRowIterator(this->client_schema_, source_snap, ORDERED, &iter));
+  Status s = this->tablet()->BulkLoad(iter.get());
+  ASSERT_TRUE(s.IsAlreadyPresent()) << s.ToString();
+  this->VerifyTestRows(0, num_rows);
+
+  // The loaded rowsets were recorded in the tablet metadata.
+  ASSERT_NO_FATAL_FAILURE(this->TabletReOpen());
+  this->VerifyTestRows(0, num_rows);
+}
+
+// Test that CountLiveRows() honors snapshots and deletes, and only scans the
+// rowsets whose live rows can't be counted from their metadata.
+TYPED_TEST(TestTablet, TestCountLiveRows) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  this->InsertTestRows(0, 10, 0);
+  MvccSnapshot after_insert(*this->tablet()->mvcc_manager());
+
+  uint64_t count;
+  int rowsets_scanned;
+  ASSERT_OK(this->tablet()->CountLiveRows(after_insert, &count, &rowsets_scanned));
+  ASSERT_EQ(10, count);
+  ASSERT_EQ(0, rowsets_scanned);
+
+  // Deleting from the MRS requires scanning it.
+  ASSERT_OK(this->DeleteTestRow(&writer, 0));
+  MvccSnapshot after_mrs_delete(*this->tablet()->mvcc_manager());
+  ASSERT_OK(this->tablet()->CountLiveRows(after_mrs_delete, &count, &rowsets_scanned));
+  ASSERT_EQ(9, count);
+  ASSERT_EQ(1, rowsets_scanned);
+
+  // Once flushed, the deleted row is accounted for by the REDO stats.
+  ASSERT_OK(this->tablet()->Flush());
+  ASSERT_OK(this->tablet()->CountLiveRows(after_mrs_delete, &count, &rowsets_scanned));
+  ASSERT_EQ(9, count);
+  ASSERT_EQ(0, rowsets_scanned);
+
+  // The REDO deltas are all after a snapshot which precedes the delete.
+  ASSERT_OK(this->tablet()->CountLiveRows(after_insert, &count, &rowsets_scanned));
+  ASSERT_EQ(10, count);
+  ASSERT_EQ(0, rowsets_scanned);
+
+  // Deletes in a DMS are only counted by scanning, until the DMS is flushed.
+  ASSERT_OK(this->DeleteTestRow(&writer, 1));
+  ASSERT_OK(this->UpdateTestRow(&writer, 2, 1));
+  MvccSnapshot after_dms_delete(*this->tablet()->mvcc_manager());
+  ASSERT_OK(this->tablet()->CountLiveRows(after_dms_delete, &count, &rowsets_scanned));
+  ASSERT_EQ(8, count);
+  ASSERT_EQ(1, rowsets_scanned);
+  ASSERT_OK(this->tablet()->FlushBiggestDMS());
+  ASSERT_OK(this->tablet()->CountLiveRows(after_dms_delete, &count, &rowsets_scanned));
+  ASSERT_EQ(8, count);
+  ASSERT_EQ(0, rowsets_scanned);
+
+  // Compacting preserves the counts.
+  ASSERT_OK(this->tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_OK(this->tablet()->CountLiveRows(after_dms_delete, &count, &rowsets_scanned));
+  ASSERT_EQ(8, count);
+  ASSERT_EQ(0, rowsets_scanned);
+  ASSERT_OK(this->tablet()->CountLiveRows(after_insert, &count, &rowsets_scanned));
+  ASSERT_EQ(10, count);
+}
+
 // Test that metrics behave properly during tablet initialization
 TYPED_TEST(TestTablet, TestMetricsInit) {
   // Create a tablet, but do not open it
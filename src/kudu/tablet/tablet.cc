@@ -18,34 +18,53 @@
 #include "kudu/tablet/tablet.h"
 
 #include <algorithm>
+#include <boost/bind.hpp>
 #include <iterator>
 #include <limits>
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/row_comparator.h"
+#include "kudu/common/encoded_key.h"
+#include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
+#include "kudu/common/key_util.h"
+#include "kudu/common/row.h"
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/row_operations.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/tablet/compaction_policy.h"
 #include "kudu/tablet/delta_compaction.h"
 #include "kudu/tablet/diskrowset.h"
+#include "kudu/tablet/memrowset.h"
+#include "kudu/tablet/mutation.h"
+#include "kudu/tablet/parallel_union_iterator.h"
 #include "kudu/tablet/row_op.h"
 #include "kudu/tablet/rowset_info.h"
 #include "kudu/tablet/rowset_tree.h"
@@ -55,6 +74,7 @@
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/util/bloom_filter.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
 #include "kudu/util/fault_injection.h"
@@ -62,9 +82,11 @@
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/maintenance_manager.h"
+#include "kudu/util/memory/arena.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 #include "kudu/util/url-coding.h"
 
@@ -131,6 +153,120 @@ DEFINE_int32(max_encoded_key_size_bytes, 16 * 1024,
              "result in an error.");
 TAG_FLAG(max_encoded_key_size_bytes, unsafe);
 
+DEFINE_bool(tablet_batch_key_probes, true,
+            "Whether to check the DiskRowSets for the keys of a write batch's INSERT "
+            "and UPSERT operations in one sorted pass per rowset, rather than "
+            "separately for each row.");
+TAG_FLAG(tablet_batch_key_probes, advanced);
+TAG_FLAG(tablet_batch_key_probes, runtime);
+
+DEFINE_int32(tablet_flush_ranges, 1,
+             "The number of key ranges into which a large MemRowSet flush is split, "
+             "using the structure of its B-tree. The ranges are written to disjoint "
+             "DiskRowSets concurrently. A value of 1 flushes each MemRowSet serially.");
+TAG_FLAG(tablet_flush_ranges, experimental);
+TAG_FLAG(tablet_flush_ranges, runtime);
+
+DEFINE_int32(tablet_compaction_ranges, 1,
+             "The number of key ranges into which a merge compaction is split, using "
+             "keys sampled from its input rowsets. The ranges are compacted into "
+             "disjoint DiskRowSets concurrently. A value of 1 compacts serially.");
+TAG_FLAG(tablet_compaction_ranges, experimental);
+TAG_FLAG(tablet_compaction_ranges, runtime);
+
+DEFINE_int32(tablet_scan_parallelism, 1,
+             "The maximum number of rowsets which an unordered scan of a tablet reads "
+             "concurrently, on a thread pool shared by all scans. A value of 1 reads "
+             "the rowsets one at a time on the scanning thread.");
+TAG_FLAG(tablet_scan_parallelism, experimental);
+TAG_FLAG(tablet_scan_parallelism, runtime);
+
+DEFINE_int32(tablet_scan_threads, 0,
+             "The number of threads, shared by all tablets, which read rowsets for "
+             "parallel scans. If 0, uses the number of CPUs.");
+TAG_FLAG(tablet_scan_threads, experimental);
+
+DEFINE_int64(tablet_scan_max_buffered_mb, 16,
+             "The maximum amount of row data, in MB, which a parallel scan reads "
+             "ahead of its consumer.");
+TAG_FLAG(tablet_scan_max_buffered_mb, experimental);
+TAG_FLAG(tablet_scan_max_buffered_mb, runtime);
+
+DEFINE_int32(tablet_write_key_sampling_interval, 0,
+             "If positive, one in this many of the keys written to each tablet is "
+             "offered to a sample of its recently written keys, which the tablet "
+             "server reports to the master to locate the hot key ranges of busy "
+             "tablets. If 0, no keys are sampled.");
+TAG_FLAG(tablet_write_key_sampling_interval, experimental);
+TAG_FLAG(tablet_write_key_sampling_interval, runtime);
+
+DEFINE_bool(tablet_codegen_merge_rows, false,
+            "Whether ordered scans and compactions compare and copy the rows they "
+            "merge with code compiled for the schema of the rows, once it is "
+            "available, rather than dispatching on the type of each column.");
+TAG_FLAG(tablet_codegen_merge_rows, experimental);
+TAG_FLAG(tablet_codegen_merge_rows, runtime);
+
+DEFINE_bool(tablet_codegen_compile_on_open, false,
+            "Whether opening a tablet enqueues compilation of the code which "
+            "scans and compactions of its schema use, so that the code is ready, "
+            "or loaded from --codegen_object_cache_dir, by the time it is "
+            "first requested.");
+TAG_FLAG(tablet_codegen_compile_on_open, experimental);
+TAG_FLAG(tablet_codegen_compile_on_open, runtime);
+
+DEFINE_bool(tablet_prune_rowsets_by_insert_timestamp, false,
+            "Whether scans skip the rowsets all of whose rows were inserted "
+            "after the snapshot of the scan, according to the earliest insertion "
+            "timestamp recorded for the rowset when it was written");
+TAG_FLAG(tablet_prune_rowsets_by_insert_timestamp, experimental);
+TAG_FLAG(tablet_prune_rowsets_by_insert_timestamp, runtime);
+
+DEFINE_bool(tablet_adaptive_block_size, false,
+            "Whether each tablet records which of its columns are mostly read by "
+            "point lookups, and flushes and compactions write those columns with "
+            "--tablet_adaptive_block_size_point_lookup_bytes blocks rather than "
+            "--cfile_default_block_size ones. Columns with a block size in their "
+            "storage attributes are always written with it.");
+TAG_FLAG(tablet_adaptive_block_size, experimental);
+TAG_FLAG(tablet_adaptive_block_size, runtime);
+
+DEFINE_int32(tablet_adaptive_block_size_point_lookup_rows, 100,
+             "Scans which return at most this many rows are counted as point "
+             "lookups of their projected columns, and the others as sequential "
+             "scans. See --tablet_adaptive_block_size.");
+TAG_FLAG(tablet_adaptive_block_size_point_lookup_rows, experimental);
+TAG_FLAG(tablet_adaptive_block_size_point_lookup_rows, runtime);
+
+DEFINE_int32(tablet_adaptive_block_size_point_lookup_bytes, 32 * 1024,
+             "The block size, in bytes before compression, of the columns which "
+             "are mostly read by point lookups. See --tablet_adaptive_block_size.");
+TAG_FLAG(tablet_adaptive_block_size_point_lookup_bytes, experimental);
+TAG_FLAG(tablet_adaptive_block_size_point_lookup_bytes, runtime);
+
+DEFINE_double(tablet_adaptive_block_size_min_point_lookup_ratio, 0.8,
+              "The fraction of the recorded reads of a column which must be "
+              "point lookups for it to be written with small blocks. See "
+              "--tablet_adaptive_block_size.");
+TAG_FLAG(tablet_adaptive_block_size_min_point_lookup_ratio, experimental);
+TAG_FLAG(tablet_adaptive_block_size_min_point_lookup_ratio, runtime);
+
+DEFINE_bool(tablet_decode_rows_in_place, false,
+            "Whether write transactions reference the rows and row keys of "
+            "their requests in place when they are already encoded in the "
+            "tablet's row layout, rather than copying each of them into the "
+            "transaction's arena.");
+TAG_FLAG(tablet_decode_rows_in_place, experimental);
+TAG_FLAG(tablet_decode_rows_in_place, runtime);
+
+DEFINE_int32(tablet_row_cache_capacity_mb, 0,
+             "Capacity of each tablet's cache of the rows read by point lookups, "
+             "i.e. scans of the latest rows with an equality predicate on every "
+             "primary key column and no other predicates. Such scans read the "
+             "rows from the cache rather than from the rowsets. 0 disables the "
+             "cache. Only affects tablets opened after it is set.");
+TAG_FLAG(tablet_row_cache_capacity_mb, experimental);
+
 METRIC_DEFINE_entity(tablet);
 METRIC_DEFINE_gauge_size(tablet, memrowset_size, "MemRowSet Memory Usage",
                          kudu::MetricUnit::kBytes,
@@ -145,9 +281,12 @@ using kudu::consensus::OpId;
 using kudu::consensus::MaximumOpId;
 using kudu::log::LogAnchorRegistry;
 using kudu::server::HybridClock;
+using std::map;
+using std::set;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::unordered_map;
 using std::unordered_set;
 using std::vector;
 using strings::Substitute;
@@ -155,6 +294,90 @@ using strings::Substitute;
 namespace kudu {
 namespace tablet {
 
+namespace {
+
+// The threads which write the key ranges of parallel flushes and compactions.
+class KeyRangeWriterPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<KeyRangeWriterPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<KeyRangeWriterPool>;
+
+  KeyRangeWriterPool() {
+    CHECK_OK(ThreadPoolBuilder("key-range-writer")
+             .set_min_threads(0)
+             .set_max_threads(base::NumCPUs())
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(KeyRangeWriterPool);
+};
+
+// The threads which read rowsets for parallel unordered scans.
+class ScanReaderPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<ScanReaderPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<ScanReaderPool>;
+
+  ScanReaderPool() {
+    CHECK_OK(ThreadPoolBuilder("tablet-scan")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_tablet_scan_threads > 0 ?
+                              FLAGS_tablet_scan_threads : base::NumCPUs())
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanReaderPool);
+};
+
+// One key range of a parallel flush or compaction.
+struct KeyRangeOutput {
+  shared_ptr<CompactionInput> input;
+  gscoped_ptr<RollingDiskRowSetWriter> drsw;
+  Status status;
+};
+
+void WriteKeyRangeTask(fs::IOClass io,
+                       const MvccSnapshot* snap,
+                       const HistoryGcOpts* history_gc_opts,
+                       KeyRangeOutput* range,
+                       CountDownLatch* latch) {
+  fs::ScopedIOClass io_class(io);
+  Status s = range->drsw->Open();
+  if (s.ok()) {
+    s = FlushCompactionInput(range->input.get(), *snap, *history_gc_opts, range->drsw.get());
+  }
+  if (s.ok()) {
+    s = range->drsw->Finish();
+  }
+  range->status = s;
+  latch->CountDown();
+}
+
+} // anonymous namespace
+
+// Transactions with at least this many rows acquire their row locks with a
+// single ScopedRowLock::LockBatch() call.
+static const size_t kMinRowLockBatchSize = 16;
+
+// Transactions with at least this many rows encode their row keys with a
+// single Schema::EncodeComparableKeys() call.
+static const size_t kMinKeyEncodingBatchSize = 16;
+
+// The maximum number of recently written keys sampled by each tablet.
+static const int kMaxSampledWriteKeys = 64;
+
 static CompactionPolicy *CreateCompactionPolicy() {
   return new BudgetedCompactionPolicy(FLAGS_tablet_compaction_budget_mb);
 }
@@ -183,9 +406,15 @@ Tablet::Tablet(const scoped_refptr<TabletMetadata>& metadata,
     next_mrs_id_(0),
     clock_(clock),
     rowsets_flush_sem_(1),
+    num_written_keys_(0),
+    write_key_sampler_(kMaxSampledWriteKeys),
+    last_access_micros_(GetMonoTimeMicros()),
     state_(kInitialized) {
       CHECK(schema()->has_column_ids());
   compaction_policy_.reset(CreateCompactionPolicy());
+  if (FLAGS_tablet_row_cache_capacity_mb > 0) {
+    row_cache_.reset(new RowCache(FLAGS_tablet_row_cache_capacity_mb * 1024L * 1024L));
+  }
 
   if (metric_registry) {
     MetricEntity::AttributeMap attrs;
@@ -218,7 +447,7 @@ Tablet::~Tablet() {
 
 Status Tablet::Open() {
   TRACE_EVENT0("tablet", "Tablet::Open");
-  std::lock_guard<rw_spinlock> lock(component_lock_);
+  std::lock_guard<percpu_rwlock> lock(component_lock_);
   CHECK_EQ(state_, kInitialized) << "already open";
   CHECK(schema()->has_column_ids());
 
@@ -252,6 +481,10 @@ Status Tablet::Open() {
                                   &new_mrs));
   components_ = new TabletComponents(new_mrs, new_rowset_tree);
 
+  if (FLAGS_tablet_codegen_compile_on_open) {
+    codegen::CompilationManager::GetSingleton()->Precompile(*schema());
+  }
+
   state_ = kBootstrapping;
   return Status::OK();
 }
@@ -259,12 +492,13 @@ Status Tablet::Open() {
 void Tablet::MarkFinishedBootstrapping() {
   CHECK_EQ(state_, kBootstrapping);
   state_ = kOpen;
+  last_access_micros_ = GetMonoTimeMicros();
 }
 
 void Tablet::Shutdown() {
   UnregisterMaintenanceOps();
 
-  std::lock_guard<rw_spinlock> lock(component_lock_);
+  std::lock_guard<percpu_rwlock> lock(component_lock_);
   components_ = nullptr;
   state_ = kShutdown;
 
@@ -286,11 +520,51 @@ BloomFilterSizing Tablet::bloom_sizing() const {
                                             FLAGS_tablet_bloom_target_fp_rate);
 }
 
+void Tablet::RecordColumnReads(const Schema& projection, bool point_lookup) const {
+  DCHECK(projection.has_column_ids());
+  std::lock_guard<simple_spinlock> l(column_reads_lock_);
+  for (size_t i = 0; i < projection.num_columns(); i++) {
+    ColumnReads& reads = column_reads_[projection.column_id(i)];
+    if (point_lookup) {
+      reads.point_lookups++;
+    } else {
+      reads.scans++;
+    }
+    if (reads.point_lookups + reads.scans >= kMaxColumnReads) {
+      reads.point_lookups /= 2;
+      reads.scans /= 2;
+    }
+  }
+}
+
+map<ColumnId, int32_t> Tablet::AdaptiveColumnBlockSizes() const {
+  map<ColumnId, int32_t> block_sizes;
+  if (!FLAGS_tablet_adaptive_block_size) {
+    return block_sizes;
+  }
+  const double min_ratio = FLAGS_tablet_adaptive_block_size_min_point_lookup_ratio;
+  std::lock_guard<simple_spinlock> l(column_reads_lock_);
+  for (const auto& entry : column_reads_) {
+    const ColumnReads& reads = entry.second;
+    const int64_t total = reads.point_lookups + reads.scans;
+    if (total > 0 && reads.point_lookups >= min_ratio * total) {
+      block_sizes[entry.first] = FLAGS_tablet_adaptive_block_size_point_lookup_bytes;
+    }
+  }
+  return block_sizes;
+}
+
 Status Tablet::NewRowIterator(const Schema &projection,
                               gscoped_ptr<RowwiseIterator> *iter) const {
-  // Yield current rows.
+  // Yield current rows. The generation of the row cache must be read before
+  // the snapshot is taken: see RowCache.
+  const uint64_t row_cache_generation = row_cache_ ? row_cache_->generation() : 0;
   MvccSnapshot snap(mvcc_);
-  return NewRowIterator(projection, snap, UNORDERED, iter);
+  RETURN_NOT_OK(NewRowIterator(projection, snap, UNORDERED, iter));
+  if (row_cache_) {
+    down_cast<Iterator*>(iter->get())->EnableRowCache(row_cache_generation);
+  }
+  return Status::OK();
 }
 
 
@@ -302,11 +576,32 @@ Status Tablet::NewRowIterator(const Schema &projection,
   if (metrics_) {
     metrics_->scans_started->Increment();
   }
+  last_access_micros_.store(GetMonoTimeMicros(), std::memory_order_relaxed);
   VLOG_WITH_PREFIX(2) << "Created new Iterator under snap: " << snap.ToString();
   iter->reset(new Iterator(this, projection, snap, order));
   return Status::OK();
 }
 
+Status Tablet::NewDiffRowIterator(const Schema& projection,
+                                  Timestamp start,
+                                  Timestamp end,
+                                  gscoped_ptr<RowwiseIterator>* iter) const {
+  CHECK_EQ(state_, kOpen);
+  if (end < start) {
+    return Status::InvalidArgument(
+        Substitute("diff scan start timestamp $0 is after its end timestamp $1",
+                   start.ToString(), end.ToString()));
+  }
+  if (metrics_) {
+    metrics_->scans_started->Increment();
+  }
+  last_access_micros_.store(GetMonoTimeMicros(), std::memory_order_relaxed);
+  VLOG_WITH_PREFIX(2) << "Created new DiffIterator between " << start.ToString()
+                      << " and " << end.ToString();
+  iter->reset(new DiffIterator(this, projection, start, end));
+  return Status::OK();
+}
+
 Status Tablet::DecodeWriteOperations(const Schema* client_schema,
                                      WriteTransactionState* tx_state) {
   TRACE_EVENT0("tablet", "Tablet::DecodeWriteOperations");
@@ -316,6 +611,12 @@ Status Tablet::DecodeWriteOperations(const Schema* client_schema,
   // Acquire the schema lock in shared mode, so that the schema doesn't
   // change while this transaction is in-flight.
   tx_state->AcquireSchemaLock(&schema_lock_);
+  return DecodeWriteOperationsUnlocked(client_schema, tx_state);
+}
+
+Status Tablet::DecodeWriteOperationsUnlocked(const Schema* client_schema,
+                                             WriteTransactionState* tx_state) {
+  DCHECK_EQ(tx_state->row_ops().size(), 0);
 
   // The Schema needs to be held constant while any transactions are between
   // PREPARE and APPLY stages
@@ -326,7 +627,10 @@ Status Tablet::DecodeWriteOperations(const Schema* client_schema,
   RowOperationsPBDecoder dec(&tx_state->request()->row_operations(),
                              client_schema,
                              schema(),
-                             tx_state->arena());
+                             tx_state->arena(),
+                             FLAGS_tablet_decode_rows_in_place ?
+                                 RowOperationsPBDecoder::REFERENCE_ROWS_IN_PLACE :
+                                 RowOperationsPBDecoder::COPY_ROWS);
   RETURN_NOT_OK(dec.DecodeOperations(&ops));
   TRACE_COUNTER_INCREMENT("num_ops", ops.size());
 
@@ -345,17 +649,101 @@ Status Tablet::DecodeWriteOperations(const Schema* client_schema,
   return Status::OK();
 }
 
+bool Tablet::LockSchemaForDecodedOperations(WriteTransactionState* tx_state) {
+  tx_state->AcquireSchemaLock(&schema_lock_);
+  if (PREDICT_FALSE(tx_state->schema_at_decode_time() != schema())) {
+    tx_state->ReleaseSchemaLock();
+    return false;
+  }
+  return true;
+}
+
+Status Tablet::DecodeRowKeys(WriteTransactionState* tx_state) {
+  const vector<RowOp*>& row_ops = tx_state->row_ops();
+  if (row_ops.size() < kMinKeyEncodingBatchSize) {
+    for (RowOp* op : row_ops) {
+      RETURN_NOT_OK(DecodeKeyForOp(op));
+    }
+    return Status::OK();
+  }
+
+  // Encode all of the keys at once, then copy them into the transaction's
+  // arena, which the probes refer to them in.
+  vector<ConstContiguousRow> rows;
+  rows.reserve(row_ops.size());
+  for (const RowOp* op : row_ops) {
+    rows.emplace_back(&key_schema_, op->decoded_op.row_data);
+  }
+  faststring buf;
+  vector<Slice> keys(row_ops.size());
+  key_schema_.EncodeComparableKeys(rows.data(), rows.size(), &buf, keys.data());
+  uint8_t* data = static_cast<uint8_t*>(tx_state->arena()->AllocateBytes(buf.size()));
+  if (PREDICT_FALSE(data == nullptr && !buf.empty())) {
+    return Status::RuntimeError("Out of memory encoding row keys");
+  }
+  memcpy(data, buf.data(), buf.size());
+
+  const size_t num_key_cols = key_schema_.num_key_columns();
+  for (size_t i = 0; i < row_ops.size(); i++) {
+    vector<const void*> raw_keys(num_key_cols);
+    for (size_t j = 0; j < num_key_cols; j++) {
+      raw_keys[j] = rows[i].cell_ptr(j);
+    }
+    Slice key(data + (keys[i].data() - buf.data()), keys[i].size());
+    gscoped_ptr<EncodedKey> encoded_key(new EncodedKey(key, &raw_keys, num_key_cols));
+    row_ops[i]->key_probe.reset(new RowSetKeyProbe(rows[i], encoded_key.Pass()));
+    RETURN_NOT_OK(CheckRowInTablet(rows[i]));
+  }
+  return Status::OK();
+}
+
 Status Tablet::AcquireRowLocks(WriteTransactionState* tx_state) {
   TRACE_EVENT1("tablet", "Tablet::AcquireRowLocks",
                "num_locks", tx_state->row_ops().size());
   TRACE("PREPARE: Acquiring locks for $0 operations", tx_state->row_ops().size());
-  for (RowOp* op : tx_state->row_ops()) {
-    RETURN_NOT_OK(AcquireLockForOp(tx_state, op));
+  const vector<RowOp*>& row_ops = tx_state->row_ops();
+  if (row_ops.size() < kMinRowLockBatchSize) {
+    for (RowOp* op : row_ops) {
+      RETURN_NOT_OK(AcquireLockForOp(tx_state, op));
+    }
+  } else {
+    vector<Slice> keys;
+    keys.reserve(row_ops.size());
+    for (RowOp* op : row_ops) {
+      if (!op->key_probe) {
+        RETURN_NOT_OK(DecodeKeyForOp(op));
+      }
+      keys.push_back(op->key_probe->encoded_key_slice());
+    }
+    vector<ScopedRowLock> locks;
+    ScopedRowLock::LockBatch(&lock_manager_, tx_state, keys,
+                             LockManager::LOCK_EXCLUSIVE, &locks);
+    for (size_t i = 0; i < row_ops.size(); i++) {
+      row_ops[i]->row_lock = std::move(locks[i]);
+    }
   }
   TRACE("PREPARE: locks acquired");
+  last_access_micros_.store(GetMonoTimeMicros(), std::memory_order_relaxed);
+  if (FLAGS_tablet_write_key_sampling_interval > 0) {
+    SampleWriteKeys(row_ops);
+  }
   return Status::OK();
 }
 
+void Tablet::SampleWriteKeys(const vector<RowOp*>& row_ops) {
+  const int64_t interval = FLAGS_tablet_write_key_sampling_interval;
+  const int64_t first = num_written_keys_.fetch_add(row_ops.size(), std::memory_order_relaxed);
+  // Offer the keys whose position among all the written keys is a multiple
+  // of the interval.
+  for (int64_t i = (interval - first % interval) % interval; i < row_ops.size(); i += interval) {
+    write_key_sampler_.Add(row_ops[i]->key_probe->encoded_key_slice());
+  }
+}
+
+void Tablet::TakeSampledWriteKeys(vector<string>* keys) {
+  write_key_sampler_.TakeSamples(keys);
+}
+
 Status Tablet::CheckRowInTablet(const ConstContiguousRow& row) const {
   bool contains_row;
   RETURN_NOT_OK(metadata_->partition_schema().PartitionContainsRow(metadata_->partition(),
@@ -372,10 +760,17 @@ Status Tablet::CheckRowInTablet(const ConstContiguousRow& row) const {
   return Status::OK();
 }
 
-Status Tablet::AcquireLockForOp(WriteTransactionState* tx_state, RowOp* op) {
+Status Tablet::DecodeKeyForOp(RowOp* op) {
   ConstContiguousRow row_key(&key_schema_, op->decoded_op.row_data);
   op->key_probe.reset(new tablet::RowSetKeyProbe(row_key));
-  RETURN_NOT_OK(CheckRowInTablet(row_key));
+  return CheckRowInTablet(row_key);
+}
+
+Status Tablet::AcquireLockForOp(WriteTransactionState* tx_state, RowOp* op) {
+  // The key may already have been decoded by DecodeRowKeys().
+  if (!op->key_probe) {
+    RETURN_NOT_OK(DecodeKeyForOp(op));
+  }
 
   op->row_lock = ScopedRowLock(&lock_manager_,
                                tx_state,
@@ -486,22 +881,38 @@ Status Tablet::InsertOrUpsertUnlocked(WriteTransactionState *tx_state,
   const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
 
   // First, ensure that it is a unique key by checking all the open RowSets.
-  vector<RowSet *> to_check = FindRowSetsToCheck(op, comps);
-  for (RowSet *rowset : to_check) {
-    bool present = false;
-    RETURN_NOT_OK(rowset->CheckRowPresent(*op->key_probe, &present, stats));
-    if (present) {
-      if (is_upsert) {
-        return ApplyUpsertAsUpdate(tx_state, op, rowset, stats);
-      }
-      Status s = Status::AlreadyPresent("key already present");
-      if (metrics_) {
-        metrics_->insertions_failed_dup_key->Increment();
+  // If the DiskRowSets were already checked as part of the batch, only the
+  // MemRowSet remains, and the Insert() below checks that.
+  RowSet* present_in = nullptr;
+  if (op->checked_disk_rowsets) {
+    present_in = op->present_in_rowset;
+  } else {
+    vector<RowSet *> to_check = FindRowSetsToCheck(op, comps);
+    if (!to_check.empty()) {
+      MonoTime probe_start = MonoTime::Now();
+      for (RowSet *rowset : to_check) {
+        bool present = false;
+        RETURN_NOT_OK(rowset->CheckRowPresent(*op->key_probe, &present, stats));
+        if (present) {
+          present_in = rowset;
+          break;
+        }
       }
-      op->SetFailed(s);
-      return s;
+      tx_state->mutable_metrics()->key_probe_duration_nanos +=
+          (MonoTime::Now() - probe_start).ToNanoseconds();
     }
   }
+  if (present_in) {
+    if (is_upsert) {
+      return ApplyUpsertAsUpdate(tx_state, op, present_in, stats);
+    }
+    Status s = Status::AlreadyPresent("key already present");
+    if (metrics_) {
+      metrics_->insertions_failed_dup_key->Increment();
+    }
+    op->SetFailed(s);
+    return s;
+  }
 
   Timestamp ts = tx_state->timestamp();
   ConstContiguousRow row(schema(), op->decoded_op.row_data);
@@ -671,7 +1082,7 @@ Status Tablet::MutateRowUnlocked(WriteTransactionState *tx_state,
 }
 
 void Tablet::StartApplying(WriteTransactionState* tx_state) {
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   tx_state->StartApplying();
   tx_state->set_tablet_components(components_);
 }
@@ -684,19 +1095,141 @@ void Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
       tx_state->arena()->AllocateBytesAligned(sizeof(ProbeStats) * num_ops,
                                               alignof(ProbeStats)));
 
+  // Manually run the constructor to clear the stats to 0 before collecting
+  // them.
+  for (int i = 0; i < num_ops; i++) {
+    new (&stats_array[i]) ProbeStats();
+  }
+
+  // Keep the rows being written out of the row cache until the transaction
+  // commits or aborts.
+  if (row_cache_) {
+    for (RowOp* row_op : tx_state->row_ops()) {
+      if (row_op->key_probe) {
+        row_cache_->StartWrite(row_op->key_probe->encoded_key_slice());
+      }
+    }
+    tx_state->set_row_cache(row_cache_.get());
+  }
+
   StartApplying(tx_state);
+  if (FLAGS_tablet_batch_key_probes) {
+    MonoTime probe_start = MonoTime::Now();
+    BatchCheckRowsPresentUnlocked(tx_state, stats_array);
+    tx_state->mutable_metrics()->key_probe_duration_nanos +=
+        (MonoTime::Now() - probe_start).ToNanoseconds();
+  }
   int i = 0;
   for (RowOp* row_op : tx_state->row_ops()) {
-    ProbeStats* stats = &stats_array[i++];
-    // Manually run the constructor to clear the stats to 0 before collecting
-    // them.
-    new (stats) ProbeStats();
-    ApplyRowOperation(tx_state, row_op, stats);
+    ApplyRowOperation(tx_state, row_op, &stats_array[i++]);
   }
 
   if (metrics_) {
     metrics_->AddProbeStats(stats_array, num_ops, tx_state->arena());
   }
+  quota_.ChargeWriteRows(num_ops);
+
+  // Sum up the probes of the write for its trace.
+  if (Trace::CurrentTrace()) {
+    ProbeStats total;
+    for (int i = 0; i < num_ops; i++) {
+      total.blooms_consulted += stats_array[i].blooms_consulted;
+      total.keys_consulted += stats_array[i].keys_consulted;
+      total.deltas_consulted += stats_array[i].deltas_consulted;
+      total.mrs_consulted += stats_array[i].mrs_consulted;
+    }
+    TRACE_COUNTER_INCREMENT("bloom_lookups", total.blooms_consulted);
+    TRACE_COUNTER_INCREMENT("key_file_lookups", total.keys_consulted);
+    TRACE_COUNTER_INCREMENT("delta_file_lookups", total.deltas_consulted);
+    TRACE_COUNTER_INCREMENT("mrs_lookups", total.mrs_consulted);
+  }
+}
+
+void Tablet::BatchCheckRowsPresentUnlocked(WriteTransactionState* tx_state,
+                                           ProbeStats* stats_array) {
+  const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
+
+  // A DELETE in the batch could remove a key from a DiskRowSet before a later
+  // INSERT of the same key is applied, so the presence checked up front would
+  // be stale. Operations replayed during bootstrap already know which store
+  // to apply to. In either case, fall back to checking each row separately.
+  struct ProbeEntry {
+    RowOp* op;
+    ProbeStats* stats;
+  };
+  vector<ProbeEntry> entries;
+  int i = 0;
+  for (RowOp* op : tx_state->row_ops()) {
+    ProbeStats* stats = &stats_array[i++];
+    switch (op->decoded_op.type) {
+      case RowOperationsPB::INSERT:
+      case RowOperationsPB::UPSERT:
+        if (PREDICT_FALSE(op->orig_result_from_log_ != nullptr)) {
+          return;
+        }
+        if (!op->has_result() && op->key_probe) {
+          entries.push_back({ op, stats });
+        }
+        break;
+      case RowOperationsPB::DELETE:
+        return;
+      default:
+        break;
+    }
+  }
+  // A single row gains nothing from batching.
+  if (entries.size() < 2) {
+    return;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const ProbeEntry& a, const ProbeEntry& b) {
+              return a.op->key_probe->encoded_key_slice().compare(
+                  b.op->key_probe->encoded_key_slice()) < 0;
+            });
+  vector<Slice> keys;
+  keys.reserve(entries.size());
+  for (const ProbeEntry& e : entries) {
+    keys.push_back(e.op->key_probe->encoded_key_slice());
+    e.op->checked_disk_rowsets = true;
+  }
+
+  // Group the (sorted) keys by the DiskRowSets which may contain them.
+  unordered_map<RowSet*, vector<int>> keys_by_rowset;
+  comps->rowsets->ForEachRowSetContainingKeys(keys, [&](RowSet* rs, int key_idx) {
+      keys_by_rowset[rs].push_back(key_idx);
+    });
+
+  vector<const RowSetKeyProbe*> probes;
+  vector<ProbeStats*> stats;
+  gscoped_array<bool> present(new bool[entries.size()]);
+  for (const auto& e : keys_by_rowset) {
+    RowSet* rs = e.first;
+    const vector<int>& key_idxs = e.second;
+    probes.clear();
+    stats.clear();
+    for (int idx : key_idxs) {
+      probes.push_back(entries[idx].op->key_probe.get());
+      stats.push_back(entries[idx].stats);
+    }
+    Status s = rs->CheckRowsPresent(probes.data(), stats.data(), key_idxs.size(),
+                                    present.get());
+    if (PREDICT_FALSE(!s.ok())) {
+      // Let these rows find the error (or not) on the per-row path.
+      LOG_WITH_PREFIX(WARNING) << "Unable to check a batch of keys against "
+                               << rs->ToString() << ": " << s.ToString();
+      for (int idx : key_idxs) {
+        entries[idx].op->checked_disk_rowsets = false;
+        entries[idx].op->present_in_rowset = nullptr;
+      }
+      continue;
+    }
+    for (int j = 0; j < key_idxs.size(); j++) {
+      if (present[j]) {
+        entries[key_idxs[j]].op->present_in_rowset = rs;
+      }
+    }
+  }
 }
 
 void Tablet::ApplyRowOperation(WriteTransactionState* tx_state,
@@ -728,40 +1261,14 @@ void Tablet::ModifyRowSetTree(const RowSetTree& old_tree,
                               const RowSetVector& rowsets_to_remove,
                               const RowSetVector& rowsets_to_add,
                               RowSetTree* new_tree) {
-  RowSetVector post_swap;
-
-  // O(n^2) diff algorithm to collect the set of rowsets excluding
-  // the rowsets that were included in the compaction
-  int num_removed = 0;
-
-  for (const shared_ptr<RowSet> &rs : old_tree.all_rowsets()) {
-    // Determine if it should be removed
-    bool should_remove = false;
-    for (const shared_ptr<RowSet> &to_remove : rowsets_to_remove) {
-      if (to_remove == rs) {
-        should_remove = true;
-        num_removed++;
-        break;
-      }
-    }
-    if (!should_remove) {
-      post_swap.push_back(rs);
-    }
-  }
-
-  CHECK_EQ(num_removed, rowsets_to_remove.size());
-
-  // Then push the new rowsets on the end of the new list
-  std::copy(rowsets_to_add.begin(),
-            rowsets_to_add.end(),
-            std::back_inserter(post_swap));
-
-  CHECK_OK(new_tree->Reset(post_swap));
+  // The new tree shares the structure of the old one, so this costs time
+  // proportional to the number of rowsets which changed.
+  CHECK_OK(new_tree->Reset(old_tree, rowsets_to_remove, rowsets_to_add));
 }
 
 void Tablet::AtomicSwapRowSets(const RowSetVector &old_rowsets,
                                const RowSetVector &new_rowsets) {
-  std::lock_guard<rw_spinlock> lock(component_lock_);
+  std::lock_guard<percpu_rwlock> lock(component_lock_);
   AtomicSwapRowSetsUnlocked(old_rowsets, new_rowsets);
 }
 
@@ -821,12 +1328,13 @@ Status Tablet::Flush() {
 }
 
 Status Tablet::FlushUnlocked() {
+  fs::ScopedIOClass io_class(fs::IOClass::FLUSH);
   TRACE_EVENT0("tablet", "Tablet::FlushUnlocked");
   RowSetsInCompaction input;
   shared_ptr<MemRowSet> old_mrs;
   {
     // Create a new MRS with the latest schema.
-    std::lock_guard<rw_spinlock> lock(component_lock_);
+    std::lock_guard<percpu_rwlock> lock(component_lock_);
     RETURN_NOT_OK(ReplaceMemRowSetUnlocked(&input, &old_mrs));
   }
 
@@ -838,6 +1346,156 @@ Status Tablet::FlushUnlocked() {
   return FlushInternal(input, old_mrs);
 }
 
+Status Tablet::BulkLoad(RowwiseIterator* iter) {
+  CHECK_EQ(state_, kOpen);
+  TRACE_EVENT1("tablet", "Tablet::BulkLoad", "id", tablet_id());
+  fs::ScopedIOClass io_class(fs::IOClass::FLUSH);
+
+  // Prevent concurrent flushes and schema changes, so that the schema the
+  // rows are written with stays current until they're swapped in.
+  std::lock_guard<Semaphore> lock(rowsets_flush_sem_);
+  if (!iter->schema().Equals(*schema())) {
+    return Status::InvalidArgument(
+        Substitute("Bulk load schema $0 does not match tablet schema $1",
+                   iter->schema().ToString(), schema()->ToString()));
+  }
+
+  // All of the loaded rows are inserted at the same timestamp. Readers won't
+  // see any of them until the transaction commits below.
+  ScopedTransaction tx(&mvcc_, clock_->Now());
+
+  RollingDiskRowSetWriter drsw(metadata_.get(), *schema(), bloom_sizing(),
+                               compaction_policy_->target_rowset_size());
+  Status s = drsw.Open();
+  if (s.ok()) {
+    s = WriteBulkLoadRows(iter, tx.timestamp(), &drsw);
+  }
+  if (s.ok()) {
+    s = drsw.Finish();
+  }
+  if (!s.ok() || drsw.written_count() == 0) {
+    tx.Abort();
+    return s;
+  }
+
+  RowSetMetadataVector new_drs_metas;
+  drsw.GetWrittenRowSetMetadata(&new_drs_metas);
+  RowSetVector new_disk_rowsets;
+  for (const shared_ptr<RowSetMetadata>& meta : new_drs_metas) {
+    shared_ptr<DiskRowSet> new_rowset;
+    s = DiskRowSet::Open(meta, log_anchor_registry_.get(), mem_trackers_, &new_rowset);
+    if (!s.ok()) {
+      LOG_WITH_PREFIX(WARNING) << "Unable to open bulk loaded rowset "
+                               << meta->ToString() << ": " << s.ToString();
+      tx.Abort();
+      return s;
+    }
+    new_disk_rowsets.push_back(new_rowset);
+  }
+
+  s = FlushMetadata({}, new_drs_metas, TabletMetadata::kNoMrsFlushed);
+  if (!s.ok()) {
+    tx.Abort();
+    return s;
+  }
+
+  tx.StartApplying();
+  AtomicSwapRowSets({}, new_disk_rowsets);
+  tx.Commit();
+
+  if (metrics_.get()) metrics_->bytes_flushed->IncrementBy(drsw.written_size());
+  LOG_WITH_PREFIX(INFO) << "Bulk loaded " << drsw.written_count() << " rows into "
+                        << new_disk_rowsets.size() << " rowsets";
+  return Status::OK();
+}
+
+Status Tablet::WriteBulkLoadRows(RowwiseIterator* iter,
+                                 Timestamp timestamp,
+                                 RollingDiskRowSetWriter* drsw) {
+  static const int kRowsPerBlock = 100;
+
+  ScanSpec spec;
+  spec.set_cache_blocks(false);
+  RETURN_NOT_OK(iter->Init(&spec));
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  Arena arena(32 * 1024, 4 * 1024 * 1024);
+  RowBlock in_block(iter->schema(), kRowsPerBlock, &arena);
+  RowBlock out_block(*schema(), kRowsPerBlock, nullptr);
+  gscoped_ptr<uint8_t[]> row_buf(new uint8_t[schema()->byte_size()]);
+  ContiguousRow row(schema(), row_buf.get());
+
+  faststring undo_buf;
+  RowChangeListEncoder undo_encoder(&undo_buf);
+  undo_encoder.SetToDelete();
+  faststring last_key;
+  bool first_row = true;
+  ProbeStats stats;
+  vector<RowSet*> to_check;
+
+  while (iter->HasNext()) {
+    // Deltas can't be appended before AppendBlock() is given the chance to
+    // roll, so roll now if the previous block filled the current rowset.
+    RETURN_NOT_OK(drsw->RollIfNecessary());
+    arena.Reset();
+    RETURN_NOT_OK(iter->NextBlock(&in_block));
+
+    int n = 0;
+    for (int i = 0; i < in_block.nrows(); i++) {
+      if (!in_block.selection_vector()->IsRowSelected(i)) {
+        continue;
+      }
+      // The indirect data stays in 'arena', which outlives the row.
+      RETURN_NOT_OK(CopyRow(in_block.row(i), &row, static_cast<Arena*>(nullptr)));
+
+      ConstContiguousRow row_key(&key_schema_, row_buf.get());
+      RETURN_NOT_OK(CheckRowInTablet(row_key));
+      RowSetKeyProbe probe(row_key);
+      if (!first_row && probe.encoded_key_slice().compare(Slice(last_key)) <= 0) {
+        return Status::InvalidArgument(
+            Substitute("Bulk loaded rows are not in increasing key order: $0",
+                       key_schema_.DebugRowKey(row_key)));
+      }
+      last_key.assign_copy(probe.encoded_key_slice().data(), probe.encoded_key_slice().size());
+      first_row = false;
+
+      bool present = false;
+      RETURN_NOT_OK(comps->memrowset->CheckRowPresent(probe, &present, &stats));
+      if (!present) {
+        to_check.clear();
+        comps->rowsets->FindRowSetsWithKeyInRange(probe.encoded_key_slice(), &to_check);
+        for (RowSet* rowset : to_check) {
+          RETURN_NOT_OK(rowset->CheckRowPresent(probe, &present, &stats));
+          if (present) break;
+        }
+      }
+      if (present) {
+        return Status::AlreadyPresent("key already present",
+                                      key_schema_.DebugRowKey(row_key));
+      }
+
+      // Record an UNDO deleting the row as of the load, so that snapshots
+      // taken before it don't see the row.
+      Mutation* undo = Mutation::CreateInArena(&arena, timestamp, undo_encoder.as_changelist());
+      rowid_t row_idx_in_drs;
+      RETURN_NOT_OK(drsw->AppendUndoDeltas(n, undo, &row_idx_in_drs));
+
+      RowBlockRow dst_row = out_block.row(n);
+      RETURN_NOT_OK(CopyRow(row, &dst_row, static_cast<Arena*>(nullptr)));
+      n++;
+    }
+
+    if (n > 0) {
+      out_block.Resize(n);
+      RETURN_NOT_OK(drsw->AppendBlock(out_block));
+      out_block.Resize(kRowsPerBlock);
+    }
+  }
+  return Status::OK();
+}
+
 Status Tablet::ReplaceMemRowSetUnlocked(RowSetsInCompaction *compaction,
                                         shared_ptr<MemRowSet> *old_ms) {
   *old_ms = components_->memrowset;
@@ -984,7 +1642,7 @@ Status Tablet::RewindSchemaForBootstrap(const Schema& new_schema,
 
   metadata_->SetSchema(new_schema, schema_version);
   {
-    std::lock_guard<rw_spinlock> lock(component_lock_);
+    std::lock_guard<percpu_rwlock> lock(component_lock_);
 
     shared_ptr<MemRowSet> old_mrs = components_->memrowset;
     shared_ptr<RowSetTree> old_rowsets = components_->rowsets;
@@ -1015,7 +1673,7 @@ void Tablet::SetFlushCompactCommonHooksForTests(
 }
 
 int32_t Tablet::CurrentMrsIdForTests() const {
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   return components_->memrowset->mrs_id();
 }
 
@@ -1034,7 +1692,7 @@ Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
   // in tablet.h for details on why that would be bad.
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
 
@@ -1057,7 +1715,7 @@ Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
     VLOG_WITH_PREFIX(2) << "Compaction quality: " << quality;
   }
 
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   for (const shared_ptr<RowSet>& rs : components_->rowsets->all_rowsets()) {
     if (picked_set.erase(rs.get()) == 0) {
       // Not picked.
@@ -1094,7 +1752,7 @@ Status Tablet::PickRowSetsToCompact(RowSetsInCompaction *picked,
 void Tablet::GetRowSetsForTests(RowSetVector* out) {
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
   for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
@@ -1117,6 +1775,10 @@ void Tablet::RegisterMaintenanceOps(MaintenanceManager* maint_mgr) {
   gscoped_ptr<MaintenanceOp> major_delta_compact_op(new MajorDeltaCompactionOp(this));
   maint_mgr->RegisterOp(major_delta_compact_op.get());
   maintenance_ops_.push_back(major_delta_compact_op.release());
+
+  gscoped_ptr<MaintenanceOp> undo_delta_block_gc_op(new UndoDeltaBlockGCOp(this));
+  maint_mgr->RegisterOp(undo_delta_block_gc_op.get());
+  maintenance_ops_.push_back(undo_delta_block_gc_op.release());
 }
 
 void Tablet::UnregisterMaintenanceOps() {
@@ -1164,17 +1826,45 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
                           "PostTakeMvccSnapshot hook failed");
   }
 
-  shared_ptr<CompactionInput> merge;
-  RETURN_NOT_OK(input.CreateCompactionInput(flush_snap, schema(), &merge));
-
-  RollingDiskRowSetWriter drsw(metadata_.get(), merge->schema(), bloom_sizing(),
-                               compaction_policy_->target_rowset_size());
-  RETURN_NOT_OK_PREPEND(drsw.Open(), "Failed to open DiskRowSet for flush");
+  // The input may be split into key ranges which are written concurrently.
+  vector<string> split_keys;
+  if (mrs_being_flushed != TabletMetadata::kNoMrsFlushed) {
+    if (FLAGS_tablet_flush_ranges > 1 && input.num_rowsets() == 1) {
+      down_cast<MemRowSet*>(input.rowsets()[0].get())->GetSplitKeys(
+          FLAGS_tablet_flush_ranges - 1, &split_keys);
+    }
+  } else if (FLAGS_tablet_compaction_ranges > 1) {
+    RETURN_NOT_OK_PREPEND(PickCompactionSplitKeys(input, FLAGS_tablet_compaction_ranges,
+                                                  &split_keys),
+                          "Failed to pick compaction split keys");
+  }
 
+  shared_ptr<CompactionInput> merge;
   HistoryGcOpts history_gc_opts = GetHistoryGcOpts();
-  RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), flush_snap, history_gc_opts, &drsw),
-                        "Flush to disk failed");
-  RETURN_NOT_OK_PREPEND(drsw.Finish(), "Failed to finish DRS writer");
+  RowSetMetadataVector new_drs_metas;
+  int64_t written_count = 0;
+  size_t written_size = 0;
+  if (split_keys.empty()) {
+    RETURN_NOT_OK(input.CreateCompactionInput(flush_snap, schema(), &merge));
+
+    RollingDiskRowSetWriter drsw(metadata_.get(), merge->schema(), bloom_sizing(),
+                                 compaction_policy_->target_rowset_size());
+    drsw.set_column_block_sizes(AdaptiveColumnBlockSizes());
+    RETURN_NOT_OK_PREPEND(drsw.Open(), "Failed to open DiskRowSet for flush");
+
+    RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), flush_snap, history_gc_opts, &drsw),
+                          "Flush to disk failed");
+    RETURN_NOT_OK_PREPEND(drsw.Finish(), "Failed to finish DRS writer");
+    drsw.GetWrittenRowSetMetadata(&new_drs_metas);
+    written_count = drsw.written_count();
+    written_size = drsw.written_size();
+  } else {
+    LOG_WITH_PREFIX(INFO) << op_name << ": writing " << split_keys.size() + 1
+                          << " key ranges concurrently";
+    RETURN_NOT_OK_PREPEND(WriteKeyRanges(input, split_keys, flush_snap, history_gc_opts,
+                                         &new_drs_metas, &written_count, &written_size),
+                          "Flush to disk failed");
+  }
 
   if (common_hooks_) {
     RETURN_NOT_OK_PREPEND(common_hooks_->PostWriteSnapshot(),
@@ -1183,7 +1873,7 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
 
   // Though unlikely, it's possible that all of the input rows were actually
   // GCed in this compaction. In that case, we don't actually want to reopen.
-  bool gced_all_input = drsw.written_count() == 0;
+  bool gced_all_input = written_count == 0;
   if (gced_all_input) {
     LOG_WITH_PREFIX(INFO) << op_name << " resulted in no output rows (all input rows "
                           << "were GCed!)  Removing all input rowsets.";
@@ -1193,10 +1883,8 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   // The RollingDiskRowSet writer wrote out one or more RowSets as the
   // output. Open these into 'new_rowsets'.
   vector<shared_ptr<RowSet> > new_disk_rowsets;
-  RowSetMetadataVector new_drs_metas;
-  drsw.GetWrittenRowSetMetadata(&new_drs_metas);
 
-  if (metrics_.get()) metrics_->bytes_flushed->IncrementBy(drsw.written_size());
+  if (metrics_.get()) metrics_->bytes_flushed->IncrementBy(written_size);
   CHECK(!new_drs_metas.empty());
   {
     TRACE_EVENT0("tablet", "Opening compaction results");
@@ -1255,7 +1943,7 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
     TRACE_EVENT0("tablet", "Swapping DuplicatingRowSet");
     // Taking component_lock_ in write mode ensures that no new transactions
     // can StartApplying() (or snapshot components_) during this block.
-    std::lock_guard<rw_spinlock> lock(component_lock_);
+    std::lock_guard<percpu_rwlock> lock(component_lock_);
     AtomicSwapRowSetsUnlocked(input.rowsets(), { inprogress_rowset });
 
     // NOTE: transactions may *commit* in between these two lines.
@@ -1340,8 +2028,8 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   // their metadata was written to disk.
   AtomicSwapRowSets({ inprogress_rowset }, new_disk_rowsets);
 
-  LOG_WITH_PREFIX(INFO) << op_name << " successful on " << drsw.written_count()
-                        << " rows " << "(" << drsw.written_size() << " bytes)";
+  LOG_WITH_PREFIX(INFO) << op_name << " successful on " << written_count
+                        << " rows " << "(" << written_size << " bytes)";
 
   if (common_hooks_) {
     RETURN_NOT_OK_PREPEND(common_hooks_->PostSwapNewRowSet(),
@@ -1351,6 +2039,92 @@ Status Tablet::DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
   return Status::OK();
 }
 
+Status Tablet::PickCompactionSplitKeys(const RowSetsInCompaction& input,
+                                      int num_ranges,
+                                      vector<string>* split_keys) const {
+  split_keys->clear();
+
+  // Sample each input rowset's keys, weighting each sample by the number of
+  // rows it stands for, and split where the cumulative weight crosses each
+  // multiple of 1/num_ranges of the total.
+  const int kSamplesPerRange = 4;
+  vector<std::pair<string, double>> samples;
+  double total_rows = 0;
+  for (const shared_ptr<RowSet>& rs : input.rowsets()) {
+    rowid_t num_rows;
+    RETURN_NOT_OK(rs->CountRows(&num_rows));
+    vector<string> keys;
+    RETURN_NOT_OK(down_cast<DiskRowSet*>(rs.get())->SampleKeys(
+        num_ranges * kSamplesPerRange, &keys));
+    for (string& key : keys) {
+      samples.emplace_back(std::move(key), static_cast<double>(num_rows) / keys.size());
+    }
+    total_rows += num_rows;
+  }
+  std::sort(samples.begin(), samples.end());
+
+  double cumulative_rows = 0;
+  for (const auto& sample : samples) {
+    double target = total_rows * (split_keys->size() + 1) / num_ranges;
+    if (cumulative_rows >= target && split_keys->size() < num_ranges - 1 &&
+        (split_keys->empty() || split_keys->back() != sample.first)) {
+      split_keys->push_back(sample.first);
+    }
+    cumulative_rows += sample.second;
+  }
+  return Status::OK();
+}
+
+Status Tablet::WriteKeyRanges(const RowSetsInCompaction& input,
+                              const vector<string>& split_keys,
+                              const MvccSnapshot& snap,
+                              const HistoryGcOpts& history_gc_opts,
+                              RowSetMetadataVector* new_drs_metas,
+                              int64_t* written_count,
+                              size_t* written_size) {
+  // Range i covers [split_keys[i - 1], split_keys[i]), with the first and last
+  // ranges unbounded below and above respectively.
+  vector<KeyRangeOutput> ranges(split_keys.size() + 1);
+  const map<ColumnId, int32_t> block_sizes = AdaptiveColumnBlockSizes();
+  for (int i = 0; i < ranges.size(); i++) {
+    Slice lower = i == 0 ? Slice() : Slice(split_keys[i - 1]);
+    Slice upper = i == split_keys.size() ? Slice() : Slice(split_keys[i]);
+    RETURN_NOT_OK(input.CreateCompactionInput(snap, schema(), lower, upper, &ranges[i].input));
+    ranges[i].drsw.reset(new RollingDiskRowSetWriter(
+        metadata_.get(), *schema(), bloom_sizing(), compaction_policy_->target_rowset_size()));
+    ranges[i].drsw->set_column_block_sizes(block_sizes);
+  }
+
+  // The tasks refer to 'ranges', so wait for all of the submitted ones to
+  // finish even if a later submission fails.
+  CountDownLatch latch(ranges.size());
+  Status s;
+  for (int i = 0; i < ranges.size(); i++) {
+    s = KeyRangeWriterPool::Get()->SubmitFunc(
+        boost::bind(&WriteKeyRangeTask, fs::ScopedIOClass::Current(), &snap, &history_gc_opts,
+                    &ranges[i], &latch));
+    if (!s.ok()) {
+      latch.CountDown(ranges.size() - i);
+      break;
+    }
+  }
+  latch.Wait();
+  RETURN_NOT_OK(s);
+
+  // The ranges are disjoint and in key order, so their rowsets are too.
+  *written_count = 0;
+  *written_size = 0;
+  for (const KeyRangeOutput& range : ranges) {
+    RETURN_NOT_OK(range.status);
+    RowSetMetadataVector metas;
+    range.drsw->GetWrittenRowSetMetadata(&metas);
+    new_drs_metas->insert(new_drs_metas->end(), metas.begin(), metas.end());
+    *written_count += range.drsw->written_count();
+    *written_size += range.drsw->written_size();
+  }
+  return Status::OK();
+}
+
 Status Tablet::HandleEmptyCompactionOrFlush(const RowSetVector& rowsets,
                                             int mrs_being_flushed) {
   // Write out the new Tablet Metadata and remove old rowsets.
@@ -1364,6 +2138,7 @@ Status Tablet::HandleEmptyCompactionOrFlush(const RowSetVector& rowsets,
 }
 
 Status Tablet::Compact(CompactFlags flags) {
+  fs::ScopedIOClass io_class(fs::IOClass::COMPACTION);
   CHECK_EQ(state_, kOpen);
 
   RowSetsInCompaction input;
@@ -1389,17 +2164,17 @@ void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
   // been in the last 5 minutes, and somehow scale the compaction quality
   // based on that, so we favor hot tablets.
   double quality = 0;
-  unordered_set<RowSet*> picked_set_ignored;
+  unordered_set<RowSet*> picked_set;
 
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
 
   {
     std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
-    WARN_NOT_OK(compaction_policy_->PickRowSets(*rowsets_copy, &picked_set_ignored, &quality, NULL),
+    WARN_NOT_OK(compaction_policy_->PickRowSets(*rowsets_copy, &picked_set, &quality, NULL),
                 Substitute("Couldn't determine compaction quality for $0", tablet_id()));
   }
 
@@ -1407,11 +2182,31 @@ void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
 
   stats->set_runnable(quality >= 0);
   stats->set_perf_improvement(quality);
+  stats->set_data_dirs(GetDataDirs(vector<RowSet*>(picked_set.begin(), picked_set.end())));
+}
+
+set<string> Tablet::GetDataDirs(const vector<RowSet*>& rowsets) const {
+  set<string> dirs;
+  fs::BlockManager* bm = metadata_->fs_manager()->block_manager();
+  for (RowSet* rs : rowsets) {
+    shared_ptr<RowSetMetadata> rs_metadata = rs->metadata();
+    if (!rs_metadata) {
+      continue;
+    }
+    for (const BlockId& block_id : rs_metadata->GetAllBlocks()) {
+      // A block that has since been deleted is of no interest.
+      string dir;
+      if (bm->FindBlockDataDir(block_id, &dir).ok()) {
+        dirs.insert(dir);
+      }
+    }
+  }
+  return dirs;
 }
 
 
 Status Tablet::DebugDump(vector<string> *lines) {
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
 
   LOG_STRING(INFO, lines) << "Dumping tablet:";
   LOG_STRING(INFO, lines) << "---------------------------";
@@ -1432,17 +2227,101 @@ Status Tablet::CaptureConsistentIterators(
   const MvccSnapshot &snap,
   const ScanSpec *spec,
   OrderMode order,
-  vector<shared_ptr<RowwiseIterator> > *iters) const {
-  shared_lock<rw_spinlock> l(component_lock_);
+  vector<IterWithBounds> *iters) const {
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
 
   // Construct all the iterators locally first, so that if we fail
   // in the middle, we don't modify the output arguments.
-  vector<shared_ptr<RowwiseIterator> > ret;
+  vector<IterWithBounds> ret;
+
+  // The merge of an ORDERED scan can defer opening the rowsets until it
+  // reaches their key bounds, provided it merges on all of the key columns.
+  bool want_bounds = order == ORDERED &&
+      projection->num_key_columns() == schema()->num_key_columns();
+  const bool prune_by_timestamp = FLAGS_tablet_prune_rowsets_by_insert_timestamp;
+  auto add_iter = [&](const RowSet& rs) -> Status {
+    if (prune_by_timestamp && !rs.MayHaveRowsVisibleIn(snap)) {
+      TRACE_COUNTER_INCREMENT("rowsets_pruned_by_timestamp", 1);
+      return Status::OK();
+    }
+    IterWithBounds iter;
+    gscoped_ptr<RowwiseIterator> row_it;
+    RETURN_NOT_OK_PREPEND(rs.NewRowIterator(projection, snap, order, &row_it),
+                          Substitute("Could not create iterator for rowset $0",
+                                     rs.ToString()));
+    iter.iter.reset(row_it.release());
+    if (want_bounds &&
+        !rs.GetBounds(&iter.encoded_min_key, &iter.encoded_max_key).ok()) {
+      iter.encoded_min_key.clear();
+      iter.encoded_max_key.clear();
+    }
+    ret.push_back(std::move(iter));
+    return Status::OK();
+  };
+
+  vector<const RowSet*> rowsets;
+  GetRowSetsToScanUnlocked(spec, &rowsets);
+  for (const RowSet* rs : rowsets) {
+    RETURN_NOT_OK(add_iter(*rs));
+  }
+
+  // Swap results into the parameters.
+  ret.swap(*iters);
+  return Status::OK();
+}
+
+Status Tablet::CaptureConsistentDiffIterators(const Schema* projection,
+                                              Timestamp start,
+                                              Timestamp end,
+                                              const ScanSpec* spec,
+                                              vector<IterWithBounds>* start_iters,
+                                              vector<IterWithBounds>* end_iters) const {
+  const MvccSnapshot start_snap(start);
+  const MvccSnapshot end_snap(end);
+  // Both sets of iterators must be captured under the same lock: a rowset
+  // skipped in one set must not be compacted into a rowset read by the
+  // other.
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+
+  vector<IterWithBounds> start_ret;
+  vector<IterWithBounds> end_ret;
+  const bool want_bounds = projection->num_key_columns() == schema()->num_key_columns();
+  auto add_iter = [&](const RowSet& rs, const MvccSnapshot& snap,
+                      vector<IterWithBounds>* ret) -> Status {
+    IterWithBounds iter;
+    gscoped_ptr<RowwiseIterator> row_it;
+    RETURN_NOT_OK_PREPEND(rs.NewRowIterator(projection, snap, ORDERED, &row_it),
+                          Substitute("Could not create iterator for rowset $0",
+                                     rs.ToString()));
+    iter.iter.reset(row_it.release());
+    if (want_bounds &&
+        !rs.GetBounds(&iter.encoded_min_key, &iter.encoded_max_key).ok()) {
+      iter.encoded_min_key.clear();
+      iter.encoded_max_key.clear();
+    }
+    ret->push_back(std::move(iter));
+    return Status::OK();
+  };
+
+  vector<const RowSet*> rowsets;
+  GetRowSetsToScanUnlocked(spec, &rowsets);
+  for (const RowSet* rs : rowsets) {
+    if (!rs->MayHaveChangesBetween(start, end)) {
+      TRACE_COUNTER_INCREMENT("rowsets_pruned_by_diff_interval", 1);
+      continue;
+    }
+    RETURN_NOT_OK(add_iter(*rs, start_snap, &start_ret));
+    RETURN_NOT_OK(add_iter(*rs, end_snap, &end_ret));
+  }
+
+  start_ret.swap(*start_iters);
+  end_ret.swap(*end_iters);
+  return Status::OK();
+}
 
-  // Grab the memrowset iterator.
-  gscoped_ptr<RowwiseIterator> ms_iter;
-  RETURN_NOT_OK(components_->memrowset->NewRowIterator(projection, snap, order, &ms_iter));
-  ret.push_back(shared_ptr<RowwiseIterator>(ms_iter.release()));
+void Tablet::GetRowSetsToScanUnlocked(const ScanSpec* spec,
+                                      vector<const RowSet*>* rowsets) const {
+  rowsets->push_back(components_->memrowset.get());
 
   // Cull row-sets in the case of key-range queries.
   if (spec != nullptr && spec->lower_bound_key() && spec->exclusive_upper_bound_key()) {
@@ -1455,30 +2334,26 @@ Status Tablet::CaptureConsistentIterators(
         spec->lower_bound_key()->encoded_key(),
         spec->exclusive_upper_bound_key()->encoded_key(),
         &interval_sets);
-    for (const RowSet *rs : interval_sets) {
-      gscoped_ptr<RowwiseIterator> row_it;
-      RETURN_NOT_OK_PREPEND(rs->NewRowIterator(projection, snap, order, &row_it),
-                            Substitute("Could not create iterator for rowset $0",
-                                       rs->ToString()));
-      ret.push_back(shared_ptr<RowwiseIterator>(row_it.release()));
-    }
-    ret.swap(*iters);
-    return Status::OK();
+    rowsets->insert(rowsets->end(), interval_sets.begin(), interval_sets.end());
+    return;
   }
 
   // If there are no encoded predicates or they represent an open-ended range, then
-  // fall back to grabbing all rowset iterators
+  // fall back to grabbing all rowsets.
   for (const shared_ptr<RowSet> &rs : components_->rowsets->all_rowsets()) {
-    gscoped_ptr<RowwiseIterator> row_it;
-    RETURN_NOT_OK_PREPEND(rs->NewRowIterator(projection, snap, order, &row_it),
-                          Substitute("Could not create iterator for rowset $0",
-                                     rs->ToString()));
-    ret.push_back(shared_ptr<RowwiseIterator>(row_it.release()));
+    rowsets->push_back(rs.get());
   }
+}
 
-  // Swap results into the parameters.
-  ret.swap(*iters);
-  return Status::OK();
+void Tablet::ReleaseCachedBlocks() {
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  if (!comps) {
+    return;
+  }
+  for (const shared_ptr<RowSet>& rs : comps->rowsets->all_rowsets()) {
+    rs->ReleaseCachedBlocks();
+  }
 }
 
 Status Tablet::CountRows(uint64_t *count) const {
@@ -1497,6 +2372,121 @@ Status Tablet::CountRows(uint64_t *count) const {
   return Status::OK();
 }
 
+Status Tablet::CountLiveRows(const MvccSnapshot& snap, uint64_t* count,
+                             int* rowsets_scanned) const {
+  static const int kRowsPerBlock = 1024;
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  vector<shared_ptr<RowSet>> rowsets(comps->rowsets->all_rowsets());
+  rowsets.push_back(comps->memrowset);
+
+  uint64_t total = 0;
+  vector<const RowSet*> to_scan;
+  for (const shared_ptr<RowSet>& rs : rowsets) {
+    bool counted;
+    rowid_t rs_count;
+    RETURN_NOT_OK(rs->CountLiveRows(snap, &counted, &rs_count));
+    if (counted) {
+      total += rs_count;
+    } else {
+      to_scan.push_back(rs.get());
+    }
+  }
+
+  // Scan the remaining rowsets with the key projection, which is the
+  // cheapest projection that still applies the deletes.
+  if (!to_scan.empty()) {
+    Arena arena(1024, 1024 * 1024);
+    RowBlock block(key_schema_, kRowsPerBlock, &arena);
+    for (const RowSet* rs : to_scan) {
+      gscoped_ptr<RowwiseIterator> iter;
+      RETURN_NOT_OK(rs->NewRowIterator(&key_schema_, snap, UNORDERED, &iter));
+      RETURN_NOT_OK(iter->Init(nullptr));
+      while (iter->HasNext()) {
+        arena.Reset();
+        RETURN_NOT_OK(iter->NextBlock(&block));
+        total += block.selection_vector()->CountSelected();
+      }
+    }
+  }
+
+  *count = total;
+  if (rowsets_scanned != nullptr) {
+    *rowsets_scanned = to_scan.size();
+  }
+  return Status::OK();
+}
+
+Status Tablet::SplitKeyRange(const string& start_key,
+                             const string& stop_key,
+                             uint64_t target_chunk_size_bytes,
+                             vector<KeyRange>* ranges) const {
+  CHECK_GT(target_chunk_size_bytes, 0);
+  ranges->clear();
+
+  // Sample the keys of each DiskRowSet overlapping the range, taking a few
+  // samples per chunk that the rowset could fill, and weight each sample by
+  // the share of the rowset's size which it stands for. Only the samples
+  // within the range count towards its size.
+  const int kSamplesPerChunk = 4;
+  const int kMaxSamplesPerRowSet = 1024;
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  vector<std::pair<string, double>> samples;
+  for (const shared_ptr<RowSet>& rs : comps->rowsets->all_rowsets()) {
+    // Skip the DuplicatingRowSets of ongoing compactions: their inputs are
+    // sampled through the rowsets they duplicate.
+    const DiskRowSet* drs = dynamic_cast<const DiskRowSet*>(rs.get());
+    if (drs == nullptr) {
+      continue;
+    }
+    string min_key;
+    string max_key;
+    RETURN_NOT_OK(drs->GetBounds(&min_key, &max_key));
+    if ((!stop_key.empty() && min_key >= stop_key) ||
+        (!start_key.empty() && max_key < start_key)) {
+      continue;
+    }
+
+    uint64_t size = drs->EstimateBaseDataDiskSize();
+    int num_samples = std::min<uint64_t>(
+        kMaxSamplesPerRowSet,
+        std::max<uint64_t>(1, kSamplesPerChunk * size / target_chunk_size_bytes));
+    vector<string> keys;
+    RETURN_NOT_OK(drs->SampleKeys(num_samples, &keys));
+    for (string& key : keys) {
+      if ((start_key.empty() || key >= start_key) &&
+          (stop_key.empty() || key < stop_key)) {
+        samples.emplace_back(std::move(key), static_cast<double>(size) / keys.size());
+      }
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+
+  // Close each range just before the sample at which it has reached the
+  // target size.
+  KeyRange cur = { start_key, "", 0 };
+  double cur_size = 0;
+  for (const auto& sample : samples) {
+    if (cur_size >= target_chunk_size_bytes && sample.first != cur.start_key) {
+      cur.stop_key = sample.first;
+      cur.size_bytes = static_cast<uint64_t>(cur_size);
+      ranges->push_back(cur);
+      cur.start_key = sample.first;
+      cur_size = 0;
+    }
+    cur_size += sample.second;
+  }
+  cur.stop_key = stop_key;
+  cur.size_bytes = static_cast<uint64_t>(cur_size);
+  ranges->push_back(std::move(cur));
+  return Status::OK();
+}
+
 size_t Tablet::MemRowSetSize() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -1575,6 +2565,7 @@ void Tablet::GetInfoForBestDMSToFlush(const ReplaySizeMap& replay_size_map,
 }
 
 Status Tablet::FlushDMSWithHighestRetention(const ReplaySizeMap& replay_size_map) const {
+  fs::ScopedIOClass io_class(fs::IOClass::FLUSH);
   shared_ptr<RowSet> rowset = FindBestDMSToFlush(replay_size_map);
   if (rowset) {
     return rowset->FlushDeltas();
@@ -1621,6 +2612,7 @@ int64_t Tablet::GetReplaySizeForIndex(int64_t min_log_index,
 }
 
 Status Tablet::FlushBiggestDMS() {
+  fs::ScopedIOClass io_class(fs::IOClass::FLUSH);
   CHECK_EQ(state_, kOpen);
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -1638,6 +2630,7 @@ Status Tablet::FlushBiggestDMS() {
 }
 
 Status Tablet::CompactWorstDeltas(RowSet::DeltaCompactionType type) {
+  fs::ScopedIOClass io_class(fs::IOClass::COMPACTION);
   CHECK_EQ(state_, kOpen);
   shared_ptr<RowSet> rs;
 
@@ -1670,6 +2663,81 @@ Status Tablet::CompactWorstDeltas(RowSet::DeltaCompactionType type) {
   return Status::OK();
 }
 
+int64_t Tablet::EstimateBytesInPotentiallyAncientUndoDeltas() {
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return 0;
+  }
+
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
+    rowsets_copy = components_->rowsets;
+  }
+
+  int64_t bytes = 0;
+  for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+    bytes += rs->EstimateBytesInPotentiallyAncientUndoDeltas(ancient_history_mark);
+  }
+  return bytes;
+}
+
+Status Tablet::DeleteAncientUndoDeltas(MonoDelta time_budget,
+                                       int64_t* blocks_deleted,
+                                       int64_t* bytes_deleted) {
+  CHECK_EQ(state_, kOpen);
+  *blocks_deleted = 0;
+  *bytes_deleted = 0;
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return Status::OK();
+  }
+
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
+    rowsets_copy = components_->rowsets;
+  }
+
+  MonoTime deadline = MonoTime::Now() + time_budget;
+  int64_t stores_initialized = 0;
+  for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+    if (rs->EstimateBytesInPotentiallyAncientUndoDeltas(ancient_history_mark) == 0) {
+      continue;
+    }
+
+    // A rowset being compacted is about to be replaced along with all of its
+    // UNDO files, so leave it alone. As in CompactWorstDeltas(), the rowset's
+    // lock must be taken under compact_select_lock_.
+    std::unique_lock<std::mutex> lock;
+    {
+      std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+      lock = std::unique_lock<std::mutex>(*rs->compact_flush_lock(), std::try_to_lock);
+    }
+    if (!lock.owns_lock()) {
+      continue;
+    }
+
+    int64_t rs_stores_initialized;
+    RETURN_NOT_OK(rs->InitUndoDeltas(deadline, &rs_stores_initialized));
+    stores_initialized += rs_stores_initialized;
+
+    int64_t rs_blocks_deleted;
+    int64_t rs_bytes_deleted;
+    RETURN_NOT_OK_PREPEND(rs->DeleteAncientUndoDeltas(ancient_history_mark,
+                                                      &rs_blocks_deleted,
+                                                      &rs_bytes_deleted),
+                          "Failed to delete ancient UNDO deltas of " + rs->ToString());
+    *blocks_deleted += rs_blocks_deleted;
+    *bytes_deleted += rs_bytes_deleted;
+  }
+
+  LOG_WITH_PREFIX(INFO) << Substitute("Read the stats of $0 UNDO delta files and deleted "
+                                      "$1 ancient ones ($2 bytes)",
+                                      stores_initialized, *blocks_deleted, *bytes_deleted);
+  return Status::OK();
+}
+
 double Tablet::GetPerfImprovementForBestDeltaCompact(RowSet::DeltaCompactionType type,
                                                      shared_ptr<RowSet>* rs) const {
   std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
@@ -1701,14 +2769,14 @@ double Tablet::GetPerfImprovementForBestDeltaCompactUnlocked(RowSet::DeltaCompac
 }
 
 size_t Tablet::num_rowsets() const {
-  shared_lock<rw_spinlock> l(component_lock_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
   return components_->rowsets->all_rowsets().size();
 }
 
 void Tablet::PrintRSLayout(ostream* o) {
   shared_ptr<RowSetTree> rowsets_copy;
   {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     rowsets_copy = components_->rowsets;
   }
   std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
@@ -1756,47 +2824,179 @@ Tablet::Iterator::Iterator(const Tablet* tablet, const Schema& projection,
     : tablet_(tablet),
       projection_(projection),
       snap_(std::move(snap)),
-      order_(order) {}
+      order_(order),
+      limit_(-1),
+      rows_returned_(0),
+      record_reads_(false),
+      rows_scanned_(0),
+      row_cache_state_(kRowCacheUnused),
+      row_cache_enabled_(false),
+      row_cache_generation_(0),
+      cached_row_returned_(false) {}
+
+Tablet::Iterator::~Iterator() {
+  if (record_reads_) {
+    tablet_->RecordColumnReads(
+        projection_, rows_scanned_ <= FLAGS_tablet_adaptive_block_size_point_lookup_rows);
+  }
+}
 
-Tablet::Iterator::~Iterator() {}
+void Tablet::Iterator::EnableRowCache(uint64_t generation) {
+  row_cache_enabled_ = true;
+  row_cache_generation_ = generation;
+}
+
+bool Tablet::Iterator::IsPointLookup(const ScanSpec& spec) {
+  const EncodedKey* lower = spec.lower_bound_key();
+  const EncodedKey* upper = spec.exclusive_upper_bound_key();
+  if (lower == nullptr || upper == nullptr || !spec.predicates().empty() ||
+      spec.sample_fraction() < 1) {
+    return false;
+  }
+  // The scan reads a single key if the upper bound is the successor of the
+  // lower bound.
+  const Schema& schema = *tablet_->schema();
+  Arena arena(256, 4096);
+  uint8_t* buf = static_cast<uint8_t*>(arena.AllocateBytes(schema.key_byte_size()));
+  ContiguousRow row(&schema, buf);
+  for (size_t i = 0; i < schema.num_key_columns(); i++) {
+    memcpy(row.mutable_cell_ptr(i), lower->raw_keys()[i], schema.column(i).type_info()->size());
+  }
+  if (!key_util::IncrementPrimaryKey(&row, &arena)) {
+    return false;
+  }
+  faststring successor;
+  schema.EncodeComparableKey(row, &successor);
+  if (Slice(successor) != upper->encoded_key()) {
+    return false;
+  }
+  row_cache_key_ = lower->encoded_key().ToString();
+  return true;
+}
 
 Status Tablet::Iterator::Init(ScanSpec *spec) {
   DCHECK(iter_.get() == nullptr);
 
   RETURN_NOT_OK(tablet_->GetMappedReadProjection(projection_, &projection_));
 
-  vector<shared_ptr<RowwiseIterator>> iters;
+  if (row_cache_enabled_ && spec != nullptr && spec->limit() != 0 && IsPointLookup(*spec)) {
+    cached_row_arena_.reset(new Arena(1024, 1024 * 1024));
+    cached_row_.reset(new RowBlock(projection_, 1, cached_row_arena_.get()));
+    if (tablet_->row_cache_->Lookup(row_cache_key_, projection_, cached_row_.get(), 0)) {
+      TRACE_COUNTER_INCREMENT("row_cache_hits", 1);
+      row_cache_state_ = kRowCacheHit;
+      return Status::OK();
+    }
+    row_cache_state_ = kRowCacheFill;
+  }
+
+  vector<IterWithBounds> iters;
 
   RETURN_NOT_OK(tablet_->CaptureConsistentIterators(&projection_, snap_, spec, order_, &iters));
+  if (spec != nullptr) {
+    limit_ = spec->limit();
+  }
 
   switch (order_) {
-    case ORDERED:
-      iter_.reset(new MergeIterator(projection_, iters));
+    case ORDERED: {
+      unique_ptr<MergeIterator> merge_iter(new MergeIterator(projection_, std::move(iters)));
+      gscoped_ptr<codegen::RowComparator> comparator;
+      if (FLAGS_tablet_codegen_merge_rows &&
+          codegen::CompilationManager::GetSingleton()->RequestRowComparator(&projection_,
+                                                                            &comparator)) {
+        merge_iter->SetRowComparator(unique_ptr<RowComparator>(comparator.release()));
+      }
+      iter_.reset(merge_iter.release());
       break;
+    }
     case UNORDERED:
-    default:
-      iter_.reset(new UnionIterator(iters));
+    default: {
+      vector<shared_ptr<RowwiseIterator>> union_iters;
+      for (IterWithBounds& iter : iters) {
+        union_iters.push_back(std::move(iter.iter));
+      }
+      int parallelism = FLAGS_tablet_scan_parallelism;
+      // A limited scan reads the rowsets one after the other, so that the
+      // rowsets past the limit are not read at all.
+      if (parallelism > 1 && union_iters.size() > 1 && limit_ < 0) {
+        iter_.reset(new ParallelUnionIterator(std::move(union_iters),
+                                              ScanReaderPool::Get(),
+                                              parallelism,
+                                              FLAGS_tablet_scan_max_buffered_mb * 1024 * 1024));
+      } else {
+        iter_.reset(new UnionIterator(union_iters));
+      }
       break;
+    }
   }
 
   RETURN_NOT_OK(iter_->Init(spec));
+  record_reads_ = FLAGS_tablet_adaptive_block_size;
   return Status::OK();
 }
 
 bool Tablet::Iterator::HasNext() const {
+  if (row_cache_state_ == kRowCacheHit) {
+    return !cached_row_returned_;
+  }
   DCHECK(iter_.get() != nullptr) << "Not initialized!";
+  if (limit_ >= 0 && rows_returned_ >= limit_) {
+    return false;
+  }
   return iter_->HasNext();
 }
 
 Status Tablet::Iterator::NextBlock(RowBlock *dst) {
+  if (row_cache_state_ == kRowCacheHit) {
+    DCHECK(!cached_row_returned_);
+    dst->Resize(1);
+    dst->selection_vector()->SetAllTrue();
+    RowBlockRow dst_row = dst->row(0);
+    RETURN_NOT_OK(CopyRow(cached_row_->row(0), &dst_row, dst->arena()));
+    cached_row_returned_ = true;
+    return Status::OK();
+  }
+
   DCHECK(iter_.get() != nullptr) << "Not initialized!";
-  return iter_->NextBlock(dst);
+  RETURN_NOT_OK(iter_->NextBlock(dst));
+  SelectionVector* sel = dst->selection_vector();
+  if (limit_ >= 0) {
+    // Deselect the rows past the limit.
+    int64_t remaining = limit_ - rows_returned_;
+    for (size_t i = 0; i < dst->nrows(); i++) {
+      if (!sel->IsRowSelected(i)) {
+        continue;
+      }
+      if (remaining > 0) {
+        remaining--;
+        rows_returned_++;
+      } else {
+        sel->SetRowUnselected(i);
+      }
+    }
+  }
+  if (record_reads_) {
+    rows_scanned_ += sel->CountSelected();
+  }
+  if (row_cache_state_ == kRowCacheFill) {
+    // A point lookup returns at most one row.
+    for (size_t i = 0; i < dst->nrows(); i++) {
+      if (sel->IsRowSelected(i)) {
+        tablet_->row_cache_->Insert(row_cache_key_, dst->row(i), row_cache_generation_);
+        row_cache_state_ = kRowCacheUnused;
+        break;
+      }
+    }
+  }
+  return Status::OK();
 }
 
 string Tablet::Iterator::ToString() const {
   string s;
   s.append("tablet iterator: ");
-  if (iter_.get() == nullptr) {
+  if (row_cache_state_ == kRowCacheHit) {
+    s.append("row cache");
+  } else if (iter_.get() == nullptr) {
     s.append("NULL");
   } else {
     s.append(iter_->ToString());
@@ -1805,8 +3005,234 @@ string Tablet::Iterator::ToString() const {
 }
 
 void Tablet::Iterator::GetIteratorStats(vector<IteratorStats>* stats) const {
+  if (row_cache_state_ == kRowCacheHit) {
+    stats->assign(projection_.num_columns(), IteratorStats());
+    return;
+  }
   iter_->GetIteratorStats(stats);
 }
 
+// Tablet::DiffIterator
+////////////////////////////////////////////////////////////
+
+const char* const Tablet::DiffIterator::kOpTypeColumnName = "diff_op_type";
+
+// The rows of an ordered scan, one at a time.
+class Tablet::DiffIterator::Cursor {
+ public:
+  Cursor(const Schema& projection, vector<IterWithBounds> iters)
+      : iter_(new MergeIterator(projection, std::move(iters))),
+        arena_(1024, 256 * 1024),
+        block_(projection, 100, &arena_),
+        row_idx_(0) {
+  }
+
+  Status Init(ScanSpec* spec) {
+    RETURN_NOT_OK(iter_->Init(spec));
+    block_.Resize(0);
+    return Advance();
+  }
+
+  // Returns false once the scan is exhausted.
+  bool valid() const {
+    return row_idx_ < block_.nrows();
+  }
+
+  const RowBlockRow& row() const {
+    DCHECK(valid());
+    return row_;
+  }
+
+  // Moves to the next selected row, reading blocks as needed.
+  Status Advance() {
+    const SelectionVector* sel = block_.selection_vector();
+    size_t idx = block_.nrows() == 0 ? 0 : row_idx_ + 1;
+    while (true) {
+      for (; idx < block_.nrows(); idx++) {
+        if (sel->IsRowSelected(idx)) {
+          row_idx_ = idx;
+          row_.Reset(&block_, idx);
+          return Status::OK();
+        }
+      }
+      if (!iter_->HasNext()) {
+        row_idx_ = block_.nrows();
+        return Status::OK();
+      }
+      RETURN_NOT_OK(iter_->NextBlock(&block_));
+      idx = 0;
+    }
+  }
+
+  const RowwiseIterator* iter() const {
+    return iter_.get();
+  }
+
+ private:
+  const unique_ptr<RowwiseIterator> iter_;
+  Arena arena_;
+  RowBlock block_;
+  size_t row_idx_;
+  RowBlockRow row_;
+};
+
+Tablet::DiffIterator::DiffIterator(const Tablet* tablet, const Schema& projection,
+                                   Timestamp start, Timestamp end)
+    : tablet_(tablet),
+      projection_(projection),
+      start_(start),
+      end_(end),
+      next_op_(RowOperationsPB::UNKNOWN) {}
+
+Tablet::DiffIterator::~DiffIterator() {}
+
+Status Tablet::DiffIterator::Init(ScanSpec *spec) {
+  DCHECK(!before_);
+
+  RETURN_NOT_OK(tablet_->GetMappedReadProjection(projection_, &projection_));
+  // The rows of the snapshots are matched by their keys, so the projection
+  // must start with the key columns, in order.
+  const Schema* tablet_schema = tablet_->schema();
+  bool has_key = projection_.num_key_columns() == tablet_schema->num_key_columns();
+  for (size_t i = 0; has_key && i < projection_.num_key_columns(); i++) {
+    has_key = projection_.column_id(i) == tablet_schema->column_id(i);
+  }
+  if (!has_key) {
+    return Status::InvalidArgument("a diff scan must project all of the key columns",
+                                   projection_.ToString());
+  }
+
+  vector<ColumnSchema> cols = projection_.columns();
+  cols.emplace_back(kOpTypeColumnName, INT8);
+  RETURN_NOT_OK(schema_.Reset(cols, projection_.num_key_columns()));
+
+  vector<IterWithBounds> before_iters;
+  vector<IterWithBounds> after_iters;
+  RETURN_NOT_OK(tablet_->CaptureConsistentDiffIterators(&projection_, start_, end_, spec,
+                                                        &before_iters, &after_iters));
+  before_.reset(new Cursor(projection_, std::move(before_iters)));
+  after_.reset(new Cursor(projection_, std::move(after_iters)));
+
+  // Initializing an iterator may remove the predicates it pushes down from
+  // its spec, so each scan gets a spec of its own.
+  unique_ptr<ScanSpec> before_spec;
+  if (spec != nullptr) {
+    before_spec.reset(new ScanSpec(*spec));
+  }
+  RETURN_NOT_OK(before_->Init(before_spec.get()));
+  RETURN_NOT_OK(after_->Init(spec));
+  return FindNextChange();
+}
+
+bool Tablet::DiffIterator::CursorRowsEqual() const {
+  const RowBlockRow& before = before_->row();
+  const RowBlockRow& after = after_->row();
+  for (size_t i = projection_.num_key_columns(); i < projection_.num_columns(); i++) {
+    const ColumnSchema& col = projection_.column(i);
+    if (col.is_nullable()) {
+      const bool before_null = before.is_null(i);
+      if (before_null != after.is_null(i)) {
+        return false;
+      }
+      if (before_null) {
+        continue;
+      }
+    }
+    if (col.type_info()->Compare(before.cell_ptr(i), after.cell_ptr(i)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status Tablet::DiffIterator::FindNextChange() {
+  while (true) {
+    if (!before_->valid()) {
+      next_op_ = after_->valid() ? RowOperationsPB::INSERT : RowOperationsPB::UNKNOWN;
+      return Status::OK();
+    }
+    if (!after_->valid()) {
+      next_op_ = RowOperationsPB::DELETE;
+      return Status::OK();
+    }
+    int cmp = projection_.Compare(before_->row(), after_->row());
+    if (cmp < 0) {
+      next_op_ = RowOperationsPB::DELETE;
+      return Status::OK();
+    }
+    if (cmp > 0) {
+      next_op_ = RowOperationsPB::INSERT;
+      return Status::OK();
+    }
+    if (!CursorRowsEqual()) {
+      next_op_ = RowOperationsPB::UPDATE;
+      return Status::OK();
+    }
+    RETURN_NOT_OK(before_->Advance());
+    RETURN_NOT_OK(after_->Advance());
+  }
+}
+
+bool Tablet::DiffIterator::HasNext() const {
+  DCHECK(before_) << "Not initialized!";
+  return next_op_ != RowOperationsPB::UNKNOWN;
+}
+
+Status Tablet::DiffIterator::NextBlock(RowBlock *dst) {
+  DCHECK(before_) << "Not initialized!";
+  DCHECK_SCHEMA_EQ(dst->schema(), schema_);
+  if (dst->arena()) {
+    dst->arena()->Reset();
+  }
+  dst->Resize(dst->row_capacity());
+  dst->selection_vector()->SetAllTrue();
+
+  const size_t op_col = projection_.num_columns();
+  size_t n = 0;
+  for (; n < dst->nrows() && next_op_ != RowOperationsPB::UNKNOWN; n++) {
+    // A deleted row has its values before the delete.
+    const RowBlockRow& src = next_op_ == RowOperationsPB::DELETE ? before_->row()
+                                                                 : after_->row();
+    RowBlockRow dst_row = dst->row(n);
+    for (size_t i = 0; i < op_col; i++) {
+      RowBlockRow::Cell dst_cell = dst_row.cell(i);
+      RETURN_NOT_OK(CopyCell(src.cell(i), &dst_cell, dst->arena()));
+    }
+    *reinterpret_cast<int8_t*>(dst_row.mutable_cell_ptr(op_col)) = next_op_;
+
+    if (next_op_ != RowOperationsPB::INSERT) {
+      RETURN_NOT_OK(before_->Advance());
+    }
+    if (next_op_ != RowOperationsPB::DELETE) {
+      RETURN_NOT_OK(after_->Advance());
+    }
+    RETURN_NOT_OK(FindNextChange());
+  }
+  dst->Resize(n);
+  return Status::OK();
+}
+
+string Tablet::DiffIterator::ToString() const {
+  string s = Substitute("tablet diff iterator [$0, $1): ", start_.ToString(), end_.ToString());
+  if (!before_) {
+    s.append("NULL");
+  } else {
+    s.append(before_->iter()->ToString());
+    s.append(", ");
+    s.append(after_->iter()->ToString());
+  }
+  return s;
+}
+
+void Tablet::DiffIterator::GetIteratorStats(vector<IteratorStats>* stats) const {
+  vector<IteratorStats> after_stats;
+  before_->iter()->GetIteratorStats(stats);
+  after_->iter()->GetIteratorStats(&after_stats);
+  DCHECK_EQ(stats->size(), after_stats.size());
+  for (size_t i = 0; i < stats->size() && i < after_stats.size(); i++) {
+    (*stats)[i].AddStats(after_stats[i]);
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
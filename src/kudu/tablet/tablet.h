@@ -17,10 +17,12 @@
 #ifndef KUDU_TABLET_TABLET_H
 #define KUDU_TABLET_TABLET_H
 
+#include <atomic>
 #include <iosfwd>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -29,12 +31,15 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/tablet/key_sampler.h"
 #include "kudu/tablet/lock_manager.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/tablet/row_cache.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/tablet/tablet_mem_trackers.h"
 #include "kudu/tablet/tablet_metadata.h"
+#include "kudu/tablet/tablet_quota.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/semaphore.h"
@@ -44,8 +49,11 @@
 
 namespace kudu {
 
+struct IterWithBounds;
+class Arena;
 class MemTracker;
 class MetricEntity;
+class RowBlock;
 class RowChangeList;
 class UnionIterator;
 
@@ -69,12 +77,21 @@ class HistoryGcOpts;
 class MemRowSet;
 class MvccSnapshot;
 struct RowOp;
+class RollingDiskRowSetWriter;
 class RowSetsInCompaction;
 class RowSetTree;
 struct TabletComponents;
 struct TabletMetrics;
 class WriteTransactionState;
 
+// A range of encoded primary keys, along with an estimate of the size of the
+// rows within it. Empty keys are unbounded.
+struct KeyRange {
+  std::string start_key;
+  std::string stop_key;
+  uint64_t size_bytes;
+};
+
 class Tablet {
  public:
   typedef std::map<int64_t, int64_t> ReplaySizeMap;
@@ -85,6 +102,7 @@ class Tablet {
   class FlushCompactCommonHooks;
   class FlushFaultHooks;
   class Iterator;
+  class DiffIterator;
 
   // Create a new tablet.
   //
@@ -113,6 +131,24 @@ class Tablet {
   Status DecodeWriteOperations(const Schema* client_schema,
                                WriteTransactionState* tx_state);
 
+  // Like DecodeWriteOperations(), but without acquiring the schema lock.
+  //
+  // The operations are decoded against the schema which is current at the
+  // time of the call. Unless the caller already holds the schema lock, it
+  // must call LockSchemaForDecodedOperations() before using them.
+  Status DecodeWriteOperationsUnlocked(const Schema* client_schema,
+                                       WriteTransactionState* tx_state);
+
+  // Acquire the schema lock for a transaction whose operations were decoded
+  // by DecodeWriteOperationsUnlocked() without it. Returns true if the schema
+  // is the one the operations were decoded against. Otherwise, releases the
+  // lock and returns false, and the operations must be decoded again.
+  bool LockSchemaForDecodedOperations(WriteTransactionState* tx_state);
+
+  // Encode the row keys of the given txn's decoded operations, checking that
+  // they belong in this tablet, so that AcquireRowLocks() needn't.
+  Status DecodeRowKeys(WriteTransactionState* tx_state);
+
   // Acquire locks for each of the operations in the given txn.
   //
   // Note that, if this fails, it's still possible that the transaction
@@ -173,6 +209,18 @@ class Tablet {
                         const OrderMode order,
                         gscoped_ptr<RowwiseIterator> *iter) const;
 
+  // Create a new iterator which yields only the rows which were inserted,
+  // updated or deleted by the transactions with timestamps in [start, end),
+  // in primary key order. See DiffIterator for the rows it yields.
+  //
+  // All the transactions before 'end' must be committed, as for a scan of
+  // a snapshot at 'end', and 'start' must not be older than the ancient
+  // history mark. The returned iterator is not initialized.
+  Status NewDiffRowIterator(const Schema& projection,
+                            Timestamp start,
+                            Timestamp end,
+                            gscoped_ptr<RowwiseIterator>* iter) const;
+
   // Flush the current MemRowSet for this tablet to disk. This swaps
   // in a new (initially empty) MemRowSet in its place.
   //
@@ -180,6 +228,21 @@ class Tablet {
   // To do that, call FlushBiggestDMS() for example.
   Status Flush();
 
+  // Load the rows yielded by 'iter' directly into new DiskRowSets, bypassing
+  // the MemRowSet and the WAL. The iterator must not yet be initialized, its
+  // schema must equal the tablet's schema, and it must yield rows in strictly
+  // increasing primary key order, all of which belong to this tablet's
+  // partition. Returns AlreadyPresent if any of the keys already exists in the
+  // tablet, in which case nothing is loaded.
+  //
+  // The loaded rows are inserted by a single MVCC transaction which commits
+  // once the new rowsets are durably recorded in the tablet metadata, so they
+  // become visible to readers all at once. Because the rows are not written
+  // through consensus, this is only suitable for tablets which are not
+  // replicated, and the caller must ensure that no concurrent writes touch
+  // the loaded key range.
+  Status BulkLoad(RowwiseIterator* iter);
+
   // Prepares the transaction context for the alter schema operation.
   // An error will be returned if the specified schema is invalid (e.g.
   // key mismatch, or missing IDs)
@@ -220,6 +283,9 @@ class Tablet {
   // Update the statistics for performing a compaction.
   void UpdateCompactionStats(MaintenanceOpStats* stats);
 
+  // Returns the data directories holding the blocks of 'rowsets'.
+  std::set<std::string> GetDataDirs(const std::vector<RowSet*>& rowsets) const;
+
   // Returns the exact current size of the MRS, in bytes. A value greater than 0 doesn't imply
   // that the MRS has data, only that it has allocated that amount of memory.
   // This method takes a read lock on component_lock_ and is thread-safe.
@@ -270,6 +336,18 @@ class Tablet {
   double GetPerfImprovementForBestDeltaCompactUnlocked(RowSet::DeltaCompactionType type,
                                                        std::shared_ptr<RowSet>* rs) const;
 
+  // Returns the number of bytes in UNDO delta files which may hold only
+  // history older than the ancient history mark, or 0 if history GC is
+  // disabled. UNDO files whose stats haven't been read yet are counted too.
+  int64_t EstimateBytesInPotentiallyAncientUndoDeltas();
+
+  // Reads the stats of the tablet's UNDO delta files until 'time_budget' is
+  // spent, then removes those which hold only ancient history, without
+  // rewriting any base data. Rowsets which are being compacted are skipped.
+  Status DeleteAncientUndoDeltas(MonoDelta time_budget,
+                                 int64_t* blocks_deleted,
+                                 int64_t* bytes_deleted);
+
   // Return the current number of rowsets in the tablet.
   size_t num_rowsets() const;
 
@@ -278,6 +356,26 @@ class Tablet {
   // memrowset in the current implementation.
   Status CountRows(uint64_t *count) const;
 
+  // Count the rows which are live in 'snap'. The rowsets which can count
+  // their live rows without reading them (see RowSet::CountLiveRows()) are
+  // not read; the others, typically those with unflushed deletes, are
+  // scanned. If not NULL, the number of rowsets scanned is stored in
+  // 'rowsets_scanned'.
+  Status CountLiveRows(const MvccSnapshot& snap, uint64_t* count,
+                       int* rowsets_scanned = nullptr) const;
+
+  // Split the encoded primary key range [start_key, stop_key) into
+  // contiguous ranges of roughly 'target_chunk_size_bytes' each, in
+  // increasing order. Empty keys are unbounded.
+  //
+  // The sizes are estimated from samples of the keys of the DiskRowSets,
+  // weighted by the on-disk size of their base data; the MemRowSet and the
+  // deltas are not accounted for.
+  Status SplitKeyRange(const std::string& start_key,
+                       const std::string& stop_key,
+                       uint64_t target_chunk_size_bytes,
+                       std::vector<KeyRange>* ranges) const;
+
 
   // Verbosely dump this entire tablet to the logs. This is only
   // really useful when debugging unit tests failures where the tablet
@@ -344,6 +442,26 @@ class Tablet {
   // May be NULL in unit tests, etc.
   TabletMetrics* metrics() { return metrics_.get(); }
 
+  // Moves the encoded keys of a uniform sample of the rows written since the
+  // last call to 'keys'. Keys are only sampled while
+  // --tablet_write_key_sampling_interval is positive.
+  void TakeSampledWriteKeys(std::vector<std::string>* keys);
+
+  // Returns the time at which rows were last written to or scanned from the
+  // tablet, or at which it was opened, in GetMonoTimeMicros() time.
+  int64_t last_access_micros() const {
+    return last_access_micros_.load(std::memory_order_relaxed);
+  }
+
+  // Returns the block sizes which flushes and compactions should write the
+  // columns mostly read by point lookups with, keyed by column ID. Empty
+  // unless --tablet_adaptive_block_size is set.
+  std::map<ColumnId, int32_t> AdaptiveColumnBlockSizes() const;
+
+  // Releases the blocks which the rowsets of the tablet keep pinned in the
+  // block cache. Used when the replica of an idle tablet hibernates.
+  void ReleaseCachedBlocks();
+
   // Return handle to the metric entity of this tablet.
   const scoped_refptr<MetricEntity>& GetMetricEntity() const {
     return metric_entity_;
@@ -358,10 +476,14 @@ class Tablet {
   // Return true if this RPC is allowed.
   bool ShouldThrottleAllow(int64_t bytes);
 
+  // The share of the table's quotas enforced by this tablet.
+  TabletQuota* quota() { return &quota_; }
+
   scoped_refptr<server::Clock> clock() const { return clock_; }
 
  private:
   friend class Iterator;
+  friend class DiffIterator;
   friend class TabletPeerTest;
   FRIEND_TEST(TestTablet, TestGetReplaySizeForIndex);
 
@@ -397,6 +519,14 @@ class Tablet {
                              RowSet* rowset,
                              ProbeStats* stats);
 
+  // Check the DiskRowSets for the keys of all of the INSERT and UPSERT
+  // operations in the transaction at once, recording the results in each
+  // RowOp so that InsertOrUpsertUnlocked() need not probe them again. Does
+  // nothing if the batch contains any operation whose result could depend
+  // on the ones applied before it (e.g. a DELETE).
+  void BatchCheckRowsPresentUnlocked(WriteTransactionState* tx_state,
+                                     ProbeStats* stats_array);
+
   // Return the list of RowSets that need to be consulted when processing the
   // given insertion or mutation.
   static std::vector<RowSet*> FindRowSetsToCheck(RowOp* op,
@@ -409,13 +539,30 @@ class Tablet {
   // concurrent modification. They will include all data that was present at the time
   // of creation, and potentially newer data.
   //
-  // The returned iterators are not Init()ed.
+  // The returned iterators are not Init()ed. For ORDERED scans, each
+  // iterator comes with the key bounds of its rowset, if known.
   // 'projection' must remain valid and unchanged for the lifetime of the returned iterators.
   Status CaptureConsistentIterators(const Schema *projection,
                                     const MvccSnapshot &snap,
                                     const ScanSpec *spec,
                                     OrderMode order,
-                                    vector<std::shared_ptr<RowwiseIterator> > *iters) const;
+                                    vector<IterWithBounds> *iters) const;
+
+  // Like CaptureConsistentIterators(), but captures ORDERED iterators of
+  // the snapshots at both 'start' and 'end', over the same rowsets. The
+  // rowsets whose rows can't have changed between the two snapshots are
+  // skipped, since they would yield the same rows in both.
+  Status CaptureConsistentDiffIterators(const Schema* projection,
+                                        Timestamp start,
+                                        Timestamp end,
+                                        const ScanSpec* spec,
+                                        vector<IterWithBounds>* start_iters,
+                                        vector<IterWithBounds>* end_iters) const;
+
+  // Collects the rowsets a scan of 'spec' must read, starting with the
+  // MemRowSet. The component lock must be held.
+  void GetRowSetsToScanUnlocked(const ScanSpec* spec,
+                                std::vector<const RowSet*>* rowsets) const;
 
   Status PickRowSetsToCompact(RowSetsInCompaction *picked,
                               CompactFlags flags) const;
@@ -424,12 +571,37 @@ class Tablet {
   Status DoMergeCompactionOrFlush(const RowSetsInCompaction &input,
                                   int64_t mrs_being_flushed);
 
+  // Pick up to 'num_ranges' - 1 encoded keys, in increasing order, which
+  // split the rows of the compaction input 'input' into key ranges of
+  // roughly equal size. All of the input rowsets must be DiskRowSets.
+  Status PickCompactionSplitKeys(const RowSetsInCompaction& input,
+                                 int num_ranges,
+                                 std::vector<std::string>* split_keys) const;
+
+  // Write the rows of 'input' visible in 'snap' to new rowsets, splitting
+  // its key space at the sorted 'split_keys' and writing the ranges
+  // concurrently. Sets the metadata of the written rowsets, in key order,
+  // and the total number of rows and bytes written.
+  Status WriteKeyRanges(const RowSetsInCompaction& input,
+                        const std::vector<std::string>& split_keys,
+                        const MvccSnapshot& snap,
+                        const HistoryGcOpts& history_gc_opts,
+                        RowSetMetadataVector* new_drs_metas,
+                        int64_t* written_count,
+                        size_t* written_size);
+
   // Handle the case in which a compaction or flush yielded no output rows.
   // In this case, we just need to remove the rowsets in 'rowsets' from the
   // metadata and flush it.
   Status HandleEmptyCompactionOrFlush(const RowSetVector& rowsets,
                                       int mrs_being_flushed);
 
+  // Write the rows yielded by 'iter' into 'drsw' as rows inserted at
+  // 'timestamp'. Helper for BulkLoad().
+  Status WriteBulkLoadRows(RowwiseIterator* iter,
+                           Timestamp timestamp,
+                           RollingDiskRowSetWriter* drsw);
+
   Status FlushMetadata(const RowSetVector& to_remove,
                        const RowSetMetadataVector& to_add,
                        int64_t mrs_being_flushed);
@@ -450,7 +622,7 @@ class Tablet {
                                  const RowSetVector &to_add);
 
   void GetComponents(scoped_refptr<TabletComponents>* comps) const {
-    shared_lock<rw_spinlock> l(component_lock_);
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
     *comps = components_;
   }
 
@@ -468,6 +640,11 @@ class Tablet {
 
   BloomFilterSizing bloom_sizing() const;
 
+  // Records a scan of the columns of 'projection', which must have column
+  // IDs, as a point lookup or a sequential scan. See
+  // --tablet_adaptive_block_size.
+  void RecordColumnReads(const Schema& projection, bool point_lookup) const;
+
   // Convert the specified read client schema (without IDs) to a server schema (with IDs)
   // This method is used by NewRowIterator().
   Status GetMappedReadProjection(const Schema& projection,
@@ -475,6 +652,14 @@ class Tablet {
 
   Status CheckRowInTablet(const ConstContiguousRow& row) const;
 
+  // Set the RowSetKeyProbe of 'op', checking that its row belongs in this
+  // tablet.
+  Status DecodeKeyForOp(RowOp* op);
+
+  // Offers the keys of some of 'row_ops', whose keys must be decoded, to
+  // the sample of written keys.
+  void SampleWriteKeys(const std::vector<RowOp*>& row_ops);
+
   // Helper method to find the rowset that has the DMS with the highest retention.
   std::shared_ptr<RowSet> FindBestDMSToFlush(const ReplaySizeMap& replay_size_map) const;
 
@@ -524,8 +709,10 @@ class Tablet {
   // NOTE: callers should avoid taking this lock for a long time, even in shared mode.
   // This is because the lock has some concept of fairness -- if, while a long reader
   // is active, a writer comes along, then all future short readers will be blocked.
-  // TODO: now that this is single-threaded again, we should change it to rw_spinlock
-  mutable rw_spinlock component_lock_;
+  //
+  // Every write and scan takes this lock in shared mode, so it is a per-CPU lock:
+  // readers only touch the cache line of their own CPU's lock.
+  mutable percpu_rwlock component_lock_;
 
   // The current components of the tablet. These should always be read
   // or swapped under the component_lock.
@@ -540,6 +727,8 @@ class Tablet {
 
   std::unique_ptr<Throttler> throttler_;
 
+  TabletQuota quota_;
+
   int64_t next_mrs_id_;
 
   // A pointer to the server's clock.
@@ -561,6 +750,29 @@ class Tablet {
   // started earlier completes after the one started later.
   mutable Semaphore rowsets_flush_sem_;
 
+  // The number of keys written to the tablet, and a sample of them. Only
+  // maintained while --tablet_write_key_sampling_interval is positive.
+  std::atomic<int64_t> num_written_keys_;
+  KeySampler write_key_sampler_;
+
+  // The rows of recent point lookups, or NULL unless
+  // --tablet_row_cache_capacity_mb is positive.
+  gscoped_ptr<RowCache> row_cache_;
+
+  // See last_access_micros().
+  mutable std::atomic<int64_t> last_access_micros_;
+
+  // The number of point lookups and sequential scans of each column, while
+  // --tablet_adaptive_block_size is set. Both counts are halved whenever
+  // their sum reaches kMaxColumnReads, so that the recent reads count most.
+  struct ColumnReads {
+    int64_t point_lookups = 0;
+    int64_t scans = 0;
+  };
+  static const int64_t kMaxColumnReads = 1 << 20;
+  mutable simple_spinlock column_reads_lock_;
+  mutable std::map<ColumnId, ColumnReads> column_reads_;
+
   enum State {
     kInitialized,
     kBootstrapping,
@@ -637,6 +849,109 @@ class Tablet::Iterator : public RowwiseIterator {
   const MvccSnapshot snap_;
   const OrderMode order_;
   gscoped_ptr<RowwiseIterator> iter_;
+
+  // The limit of the scan, or -1 if the scan is not limited, and the number
+  // of selected rows returned so far.
+  int64_t limit_;
+  int64_t rows_returned_;
+
+  // Whether the scan is recorded as a read of its columns when the
+  // iterator is destroyed, and the number of selected rows it returned.
+  // See --tablet_adaptive_block_size.
+  bool record_reads_;
+  int64_t rows_scanned_;
+
+  // Lets a point lookup of the latest rows use the tablet's row cache.
+  // 'generation' must be that of the cache before the snapshot was taken.
+  void EnableRowCache(uint64_t generation);
+
+  // Returns true if the scan reads only the row of a single key, with no
+  // other predicates, and sets 'row_cache_key_' to its encoded key.
+  bool IsPointLookup(const ScanSpec& spec);
+
+  // State of the use of the row cache. The row is either found in the
+  // cache when the iterator is initialized, and kept in 'cached_row_', or
+  // read from the rowsets and inserted into the cache.
+  enum RowCacheState {
+    kRowCacheUnused,
+    kRowCacheHit,
+    kRowCacheFill
+  };
+  RowCacheState row_cache_state_;
+  bool row_cache_enabled_;
+  uint64_t row_cache_generation_;
+  std::string row_cache_key_;
+  gscoped_ptr<Arena> cached_row_arena_;
+  gscoped_ptr<RowBlock> cached_row_;
+  bool cached_row_returned_;
+};
+
+// An iterator over the changes to the rows of the tablet between two
+// snapshots, for change data capture. It merges ORDERED scans of both
+// snapshots, and yields the rows whose primary key is only in the later
+// one (inserts), only in the earlier one (deletes), or in both but with
+// different values of the projected columns (updates). Deleted rows have
+// their values in the earlier snapshot.
+//
+// The projection must include all of the key columns. Its schema is the
+// projection, without column IDs, followed by a non-nullable INT8 column
+// named kOpTypeColumnName holding the RowOperationsPB::Type of each change:
+// INSERT, UPDATE or DELETE. A row which is deleted and then inserted again
+// in the interval is an update, or isn't yielded at all if its values are
+// the same.
+//
+// Predicates are evaluated in both snapshots, so a row which stops (or
+// starts) matching them is yielded as deleted (or inserted).
+class Tablet::DiffIterator : public RowwiseIterator {
+ public:
+  static const char* const kOpTypeColumnName;
+
+  virtual ~DiffIterator();
+
+  virtual Status Init(ScanSpec *spec) OVERRIDE;
+
+  virtual bool HasNext() const OVERRIDE;
+
+  virtual Status NextBlock(RowBlock *dst) OVERRIDE;
+
+  std::string ToString() const OVERRIDE;
+
+  const Schema &schema() const OVERRIDE {
+    return schema_;
+  }
+
+  virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
+
+ private:
+  friend class Tablet;
+  class Cursor;
+
+  DISALLOW_COPY_AND_ASSIGN(DiffIterator);
+
+  DiffIterator(const Tablet* tablet, const Schema& projection, Timestamp start,
+               Timestamp end);
+
+  // Advances the cursors past the rows which are the same in both
+  // snapshots, and sets 'next_op_' to the change at the cursors, or to
+  // UNKNOWN if there are no more changes.
+  Status FindNextChange();
+
+  // Returns true if the rows at the cursors, with equal keys, have the same
+  // values in all the projected columns.
+  bool CursorRowsEqual() const;
+
+  const Tablet *tablet_;
+  Schema projection_;
+  Schema schema_;
+  const Timestamp start_;
+  const Timestamp end_;
+
+  // Ordered scans of the snapshots at 'start_' and 'end_'.
+  std::unique_ptr<Cursor> before_;
+  std::unique_ptr<Cursor> after_;
+
+  // The RowOperationsPB::Type of the change at the cursors.
+  int next_op_;
 };
 
 // Structure which represents the components of the tablet's storage.
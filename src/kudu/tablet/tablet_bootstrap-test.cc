@@ -32,6 +32,8 @@
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tablet/tablet_metadata.h"
 
+DECLARE_int32(tablet_bootstrap_read_ahead_segments);
+
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -171,6 +173,52 @@ TEST_F(BootstrapTest, TestBootstrap) {
   ASSERT_EQ(1, results.size());
 }
 
+// Tests that a log of many segments replays the same whether or not the
+// segments are read ahead of the replay.
+TEST_F(BootstrapTest, TestReplayWithReadAhead) {
+  ASSERT_OK(BuildLog());
+
+  const int kNumOps = 30;
+  for (int i = 1; i <= kNumOps; i++) {
+    consensus::ReplicateRefPtr replicate = consensus::make_scoped_refptr_replicate(
+        new consensus::ReplicateMsg());
+    replicate->get()->set_op_type(consensus::WRITE_OP);
+    OpId opid = MakeOpId(1, i);
+    replicate->get()->mutable_id()->CopyFrom(opid);
+    replicate->get()->set_timestamp(clock_->Now().ToUint64());
+    tserver::WriteRequestPB* batch_request = replicate->get()->mutable_write_request();
+    ASSERT_OK(SchemaToPB(schema_, batch_request->mutable_schema()));
+    batch_request->set_tablet_id(log::kTestTablet);
+    AddTestRowToPB(RowOperationsPB::INSERT, schema_, i, 0,
+                   "this is a test insert", batch_request->mutable_row_operations());
+    AppendReplicateBatch(replicate);
+
+    gscoped_ptr<consensus::CommitMsg> commit(new consensus::CommitMsg);
+    commit->set_op_type(consensus::WRITE_OP);
+    commit->mutable_commited_op_id()->CopyFrom(opid);
+    commit->mutable_result()->add_ops()->add_mutated_stores()->set_mrs_id(1);
+    AppendCommit(std::move(commit));
+
+    if (i % 3 == 0) {
+      ASSERT_OK(RollLog());
+    }
+  }
+
+  // The first bootstrap replays the ten segments written above, the second
+  // one the log rewritten by the first.
+  for (int read_ahead : { 4, 0 }) {
+    FLAGS_tablet_bootstrap_read_ahead_segments = read_ahead;
+    shared_ptr<Tablet> tablet;
+    ConsensusBootstrapInfo boot_info;
+    ASSERT_OK(BootstrapTestTablet(-1, -1, &tablet, &boot_info));
+    ASSERT_EQ(0, boot_info.orphaned_replicates.size());
+
+    vector<string> results;
+    IterateTabletRows(tablet.get(), &results);
+    ASSERT_EQ(kNumOps, results.size());
+  }
+}
+
 // Tests attempting a local bootstrap of a tablet that was in the middle of a
 // tablet copy before "crashing".
 TEST_F(BootstrapTest, TestIncompleteTabletCopy) {
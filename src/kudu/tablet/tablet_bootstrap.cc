@@ -18,6 +18,7 @@
 #include "kudu/tablet/tablet_bootstrap.h"
 
 #include <gflags/gflags.h>
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
@@ -36,6 +37,7 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/strcat.h"
@@ -51,6 +53,7 @@
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
@@ -59,6 +62,7 @@
 #include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_bool(skip_remove_old_recovery_dir, false,
             "Skip removing WAL recovery dir after startup. (useful for debugging)");
@@ -70,6 +74,19 @@ DEFINE_double(fault_crash_during_log_replay, 0.0,
               "(For testing only!)");
 TAG_FLAG(fault_crash_during_log_replay, unsafe);
 
+DEFINE_int32(tablet_bootstrap_read_ahead_segments, 2,
+             "Number of log segments which tablet bootstrap reads and decodes ahead "
+             "of the one being replayed. If 0, each segment is read by the replaying "
+             "thread as it is replayed.");
+TAG_FLAG(tablet_bootstrap_read_ahead_segments, advanced);
+TAG_FLAG(tablet_bootstrap_read_ahead_segments, runtime);
+
+DEFINE_int32(tablet_bootstrap_log_reader_threads, 8,
+             "Maximum number of threads, shared by all bootstrapping tablets, which "
+             "read and decode log segments ahead of their replay. See "
+             "--tablet_bootstrap_read_ahead_segments.");
+TAG_FLAG(tablet_bootstrap_log_reader_threads, advanced);
+
 DECLARE_int32(max_clock_sync_error_usec);
 
 namespace kudu {
@@ -98,6 +115,7 @@ using log::Log;
 using log::LogAnchorRegistry;
 using log::LogEntryPB;
 using log::LogOptions;
+using log::LogEntryReader;
 using log::LogReader;
 using log::ReadableLogSegment;
 using rpc::ResultTracker;
@@ -115,6 +133,69 @@ using tserver::WriteResponsePB;
 
 struct ReplayState;
 
+namespace {
+
+// Thread pool shared by all bootstrapping tablets for reading log segments
+// ahead of their replay.
+class LogReadAheadPool {
+ public:
+  static ThreadPool* Get() {
+    return Singleton<LogReadAheadPool>::get()->pool_.get();
+  }
+
+ private:
+  friend class Singleton<LogReadAheadPool>;
+
+  LogReadAheadPool() {
+    CHECK_OK(ThreadPoolBuilder("bootstrap-log-reader")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_tablet_bootstrap_log_reader_threads)
+             .Build(&pool_));
+  }
+
+  gscoped_ptr<ThreadPool> pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogReadAheadPool);
+};
+
+// The entries of a log segment, read and decoded ahead of their replay.
+struct DecodedLogSegment {
+  explicit DecodedLogSegment(scoped_refptr<ReadableLogSegment> segment)
+      : segment(std::move(segment)),
+        done(1) {
+  }
+
+  // Read and decode all of the segment's entries, then count down 'done'.
+  void Read() {
+    LogEntryReader reader(segment.get());
+    while (true) {
+      unique_ptr<LogEntryPB> entry(new LogEntryPB);
+      Status s = reader.ReadNextEntry(entry.get());
+      if (PREDICT_FALSE(!s.ok())) {
+        if (!s.IsEndOfFile()) {
+          status = s;
+        }
+        break;
+      }
+      entries.emplace_back(std::move(entry));
+    }
+    done.CountDown();
+  }
+
+  const scoped_refptr<ReadableLogSegment> segment;
+
+  // The entries which were read successfully, in log order.
+  std::vector<unique_ptr<LogEntryPB>> entries;
+
+  // The error which stopped the read, if any. The entries read before it
+  // are still to be replayed.
+  Status status;
+
+  CountDownLatch done;
+};
+
+} // anonymous namespace
+
 // Information from the tablet metadata which indicates which data was
 // flushed prior to this restart and which memory stores are still active.
 //
@@ -1049,29 +1130,39 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
   const auto kStatusUpdateInterval = MonoDelta::FromSeconds(5);
   int segment_count = 0;
 
-  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
-    log::LogEntryReader reader(segment.get());
+  // Segments are read and decoded on the log read-ahead pool, up to
+  // --tablet_bootstrap_read_ahead_segments ahead of the one being replayed,
+  // so that the replay doesn't wait on IO and protobuf parsing.
+  const int num_segments = segments.size();
+  std::deque<shared_ptr<DecodedLogSegment>> read_ahead;
+  int next_segment_to_read = 0;
+  while (segment_count < num_segments) {
+    while (next_segment_to_read < num_segments &&
+           static_cast<int>(read_ahead.size()) < FLAGS_tablet_bootstrap_read_ahead_segments) {
+      auto decoded = std::make_shared<DecodedLogSegment>(segments[next_segment_to_read]);
+      if (!LogReadAheadPool::Get()->SubmitFunc([decoded]() { decoded->Read(); }).ok()) {
+        break;
+      }
+      read_ahead.emplace_back(std::move(decoded));
+      next_segment_to_read++;
+    }
 
-    int entry_count = 0;
-    while (true) {
-      unique_ptr<LogEntryPB> entry(new LogEntryPB);
+    shared_ptr<DecodedLogSegment> decoded;
+    if (read_ahead.empty()) {
+      decoded = std::make_shared<DecodedLogSegment>(segments[next_segment_to_read++]);
+      decoded->Read();
+    } else {
+      decoded = std::move(read_ahead.front());
+      read_ahead.pop_front();
+      decoded->done.Wait();
+    }
+    const scoped_refptr<ReadableLogSegment>& segment = decoded->segment;
 
-      Status s = reader.ReadNextEntry(entry.get());
-      if (PREDICT_FALSE(!s.ok())) {
-        if (s.IsEndOfFile()) {
-          break;
-        }
-        return Status::Corruption(Substitute("Error reading Log Segment of tablet $0: $1 "
-                                             "(Read up to entry $2 of segment $3, in path $4)",
-                                             tablet_->tablet_id(),
-                                             s.ToString(),
-                                             entry_count,
-                                             segment->header().sequence_number(),
-                                             segment->path()));
-      }
+    int entry_count = 0;
+    for (unique_ptr<LogEntryPB>& entry : decoded->entries) {
       entry_count++;
 
-      s = HandleEntry(&state, entry.get());
+      Status s = HandleEntry(&state, entry.get());
       if (!s.ok()) {
         DumpReplayStateToLog(state);
         RETURN_NOT_OK_PREPEND(s, DebugInfo(tablet_->tablet_id(),
@@ -1086,15 +1177,24 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
       auto now = MonoTime::Now();
       if (now - last_status_update > kStatusUpdateInterval) {
         StatusMessage(Substitute("Bootstrap replaying log segment $0/$1 "
-                                 "($2/$3 this segment, stats: $4)",
+                                 "($2/$3 entries this segment, stats: $4)",
                                  segment_count + 1, log_reader_->num_segments(),
-                                 HumanReadableNumBytes::ToString(reader.offset()),
-                                 HumanReadableNumBytes::ToString(reader.read_up_to_offset()),
+                                 entry_count, decoded->entries.size(),
                                  stats_.ToString()));
         last_status_update = now;
       }
     }
 
+    if (PREDICT_FALSE(!decoded->status.ok())) {
+      return Status::Corruption(Substitute("Error reading Log Segment of tablet $0: $1 "
+                                           "(Read up to entry $2 of segment $3, in path $4)",
+                                           tablet_->tablet_id(),
+                                           decoded->status.ToString(),
+                                           entry_count,
+                                           segment->header().sequence_number(),
+                                           segment->path()));
+    }
+
     StatusMessage(Substitute("Bootstrap replayed $0/$1 log segments. "
                              "Stats: $2. Pending: $3 replicates",
                              segment_count + 1, log_reader_->num_segments(),
@@ -265,6 +265,45 @@ TEST_F(TabletHistoryGcTest, TestUndoGCOnMergeCompaction) {
   ASSERT_DEBUG_DUMP_ROWS_MATCH(R"(int32 val=0\); Undo Mutations: \[\]; Redo Mutations: \[\];$)");
 }
 
+// Test that whole UNDO delta files are deleted, without any compaction, once
+// they only hold history older than the AHM.
+TEST_F(TabletHistoryGcTest, TestUndoDeltaBlockGc) {
+  FLAGS_tablet_history_max_age_sec = 100;
+
+  NO_FATALS(InsertOriginalRows(num_rowsets_, rows_per_rowset_));
+  for (const auto& rsmd : tablet()->metadata()->rowsets()) {
+    ASSERT_EQ(1, rsmd->undo_delta_blocks().size());
+  }
+
+  // The UNDO files haven't been read yet, so they may be ancient, but they
+  // turn out not to be.
+  ASSERT_GT(tablet()->EstimateBytesInPotentiallyAncientUndoDeltas(), 0);
+  int64_t blocks_deleted;
+  int64_t bytes_deleted;
+  ASSERT_OK(tablet()->DeleteAncientUndoDeltas(MonoDelta::FromSeconds(60),
+                                              &blocks_deleted, &bytes_deleted));
+  ASSERT_EQ(0, blocks_deleted);
+  ASSERT_EQ(0, tablet()->EstimateBytesInPotentiallyAncientUndoDeltas());
+
+  // Once the inserts are older than the AHM, their UNDOs are deleted.
+  NO_FATALS(AddTimeToHybridClock(MonoDelta::FromSeconds(200)));
+  int64_t ancient_bytes = tablet()->EstimateBytesInPotentiallyAncientUndoDeltas();
+  ASSERT_GT(ancient_bytes, 0);
+  ASSERT_OK(tablet()->DeleteAncientUndoDeltas(MonoDelta::FromSeconds(60),
+                                              &blocks_deleted, &bytes_deleted));
+  ASSERT_EQ(num_rowsets_, blocks_deleted);
+  ASSERT_EQ(ancient_bytes, bytes_deleted);
+  ASSERT_EQ(0, tablet()->EstimateBytesInPotentiallyAncientUndoDeltas());
+  for (const auto& rsmd : tablet()->metadata()->rowsets()) {
+    ASSERT_EQ(0, rsmd->undo_delta_blocks().size());
+  }
+
+  // The base data is left alone.
+  ASSERT_EQ(num_rowsets_, tablet()->num_rowsets());
+  NO_FATALS(VerifyTestRowsWithVerifier(kStartRow, TotalNumRows(), kRowsEqual0));
+  ASSERT_DEBUG_DUMP_ROWS_MATCH(R"(int32 val=0\); Undo Mutations: \[\]; Redo Mutations: \[\];$)");
+}
+
 // Test that we GC the history and existence of entire deleted rows on a merge compaction.
 TEST_F(TabletHistoryGcTest, TestRowRemovalGCOnMergeCompaction) {
   FLAGS_tablet_history_max_age_sec = 100; // Keep history for 100 seconds.
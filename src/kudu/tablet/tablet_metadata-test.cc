@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include "kudu/common/schema.h"
@@ -25,6 +26,8 @@
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/util/pb_util.h"
 
+DECLARE_int32(tablet_metadata_max_delta_records);
+
 namespace kudu {
 namespace tablet {
 
@@ -94,6 +97,57 @@ TEST_F(TestTabletMetadata, TestLoadFromSuperBlock) {
             << SecureDebugString(superblock_pb_1);
 }
 
+// Test that superblock delta records appended by metadata flushes are applied
+// when the superblock is read back from disk.
+TEST_F(TestTabletMetadata, TestSuperBlockDeltaLog) {
+  FLAGS_tablet_metadata_max_delta_records = 100;
+  TabletMetadata* meta = harness_->tablet()->metadata();
+  std::string delta_log_path = harness_->fs_manager()->GetTabletMetadataDeltaLogPath(
+      meta->tablet_id());
+
+  // The first flush rewrites the superblock and the next one starts the
+  // delta log.
+  ASSERT_OK(meta->Flush());
+  ASSERT_FALSE(env_->FileExists(delta_log_path));
+  ASSERT_OK(meta->Flush());
+  ASSERT_TRUE(env_->FileExists(delta_log_path));
+
+  // Add and remove rowsets. Depending on the size of the delta log, each
+  // metadata flush either appends a record or rewrites the superblock.
+  TabletSuperBlockPB in_memory;
+  TabletSuperBlockPB on_disk;
+  auto check_on_disk = [&]() {
+    ASSERT_OK(meta->ToSuperBlock(&in_memory));
+    ASSERT_OK(meta->ReadSuperBlockFromDisk(&on_disk));
+    ASSERT_TRUE(on_disk.has_delta_log_id());
+    on_disk.clear_delta_log_id();
+    ASSERT_EQ(in_memory.SerializeAsString(), on_disk.SerializeAsString())
+      << SecureDebugString(in_memory)
+      << SecureDebugString(on_disk);
+  };
+  gscoped_ptr<KuduPartialRow> row;
+  for (int i = 0; i < 4; i++) {
+    BuildPartialRow(i, i, "foo", &row);
+    writer_->Insert(*row);
+    ASSERT_OK(harness_->tablet()->Flush());
+    NO_FATALS(check_on_disk());
+  }
+  ASSERT_OK(harness_->tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  NO_FATALS(check_on_disk());
+  BuildPartialRow(10, 10, "bar", &row);
+  writer_->Insert(*row);
+  ASSERT_OK(harness_->tablet()->Flush());
+  NO_FATALS(check_on_disk());
+  ASSERT_EQ(2, in_memory.rowsets_size());
+
+  // Rewriting the superblock with the delta log disabled removes the log.
+  FLAGS_tablet_metadata_max_delta_records = 0;
+  ASSERT_OK(meta->Flush());
+  ASSERT_FALSE(env_->FileExists(delta_log_path));
+  ASSERT_OK(meta->ReadSuperBlockFromDisk(&on_disk));
+  ASSERT_FALSE(on_disk.has_delta_log_id());
+  ASSERT_EQ(in_memory.SerializeAsString(), on_disk.SerializeAsString());
+}
 
 } // namespace tablet
 } // namespace kudu
@@ -22,6 +22,7 @@
 #include <gflags/gflags.h>
 #include <mutex>
 #include <string>
+#include <unordered_set>
 
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/metadata.pb.h"
@@ -36,8 +37,11 @@
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/env.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/trace.h"
 
@@ -48,7 +52,19 @@ TAG_FLAG(enable_tablet_orphaned_block_deletion, advanced);
 TAG_FLAG(enable_tablet_orphaned_block_deletion, hidden);
 TAG_FLAG(enable_tablet_orphaned_block_deletion, runtime);
 
+DEFINE_int32(tablet_metadata_max_delta_records, 0,
+             "Maximum number of records appended to a tablet's superblock delta log "
+             "before the full superblock is rewritten. Each metadata flush which doesn't "
+             "rewrite the superblock appends only the rowsets it changed. The superblock "
+             "is also rewritten once the delta log grows larger than it. If 0, every "
+             "metadata flush rewrites the full superblock. Note that versions which "
+             "don't support superblock delta logs ignore them.");
+TAG_FLAG(tablet_metadata_max_delta_records, experimental);
+TAG_FLAG(tablet_metadata_max_delta_records, runtime);
+
 using std::shared_ptr;
+using std::unique_ptr;
+using std::unordered_map;
 
 using base::subtle::Barrier_AtomicIncrement;
 using strings::Substitute;
@@ -75,6 +91,35 @@ Status TabletMetadata::CreateNew(FsManager* fs_manager,
                                  const Partition& partition,
                                  const TabletDataState& initial_tablet_data_state,
                                  scoped_refptr<TabletMetadata>* metadata) {
+  return CreateNewInternal(fs_manager, tablet_id, table_name, table_id, schema,
+                           partition_schema, partition, initial_tablet_data_state,
+                           true, metadata);
+}
+
+Status TabletMetadata::CreateNewWithoutDirSync(FsManager* fs_manager,
+                                               const string& tablet_id,
+                                               const string& table_name,
+                                               const string& table_id,
+                                               const Schema& schema,
+                                               const PartitionSchema& partition_schema,
+                                               const Partition& partition,
+                                               const TabletDataState& initial_tablet_data_state,
+                                               scoped_refptr<TabletMetadata>* metadata) {
+  return CreateNewInternal(fs_manager, tablet_id, table_name, table_id, schema,
+                           partition_schema, partition, initial_tablet_data_state,
+                           false, metadata);
+}
+
+Status TabletMetadata::CreateNewInternal(FsManager* fs_manager,
+                                         const string& tablet_id,
+                                         const string& table_name,
+                                         const string& table_id,
+                                         const Schema& schema,
+                                         const PartitionSchema& partition_schema,
+                                         const Partition& partition,
+                                         const TabletDataState& initial_tablet_data_state,
+                                         bool sync_dir,
+                                         scoped_refptr<TabletMetadata>* metadata) {
 
   // Verify that no existing tablet exists with the same ID.
   if (fs_manager->env()->FileExists(fs_manager->GetTabletMetadataPath(tablet_id))) {
@@ -89,7 +134,19 @@ Status TabletMetadata::CreateNew(FsManager* fs_manager,
                                                        partition_schema,
                                                        partition,
                                                        initial_tablet_data_state));
-  RETURN_NOT_OK(ret->Flush());
+  if (sync_dir) {
+    RETURN_NOT_OK(ret->Flush());
+  } else {
+    // A new tablet has no rowsets, orphaned blocks or delta log, so writing
+    // its superblock is all a flush would do.
+    MutexLock l_flush(ret->flush_lock_);
+    TabletSuperBlockPB pb;
+    {
+      std::lock_guard<LockType> l(ret->data_lock_);
+      RETURN_NOT_OK(ret->ToSuperBlockUnlocked(&pb, ret->rowsets_));
+    }
+    RETURN_NOT_OK(ret->ReplaceSuperBlockUnlocked(&pb, false));
+  }
   metadata->swap(ret);
   return Status::OK();
 }
@@ -141,6 +198,9 @@ void TabletMetadata::CollectBlockIdPBs(const TabletSuperBlockPB& superblock,
     for (const DeltaDataPB& undo : rowset.undo_deltas()) {
       block_ids->push_back(undo.block());
     }
+    for (const ColumnDataPB& index : rowset.secondary_indexes()) {
+      block_ids->push_back(index.block());
+    }
     if (rowset.has_bloom_block()) {
       block_ids->push_back(rowset.bloom_block());
     }
@@ -170,6 +230,14 @@ Status TabletMetadata::DeleteTabletData(TabletDataState delete_type,
       AddOrphanedBlocksUnlocked(rsmd->GetAllBlocks());
     }
     rowsets_.clear();
+    if (delete_type == TABLET_DATA_DELETED) {
+      vector<BlockId> copied_blocks;
+      for (const auto& block : tablet_copy_progress_.blocks()) {
+        copied_blocks.push_back(BlockId::FromPB(block.block_id()));
+      }
+      AddOrphanedBlocksUnlocked(copied_blocks);
+      tablet_copy_progress_.Clear();
+    }
     tablet_data_state_ = delete_type;
     if (last_logged_opid) {
       tombstone_last_logged_opid_ = *last_logged_opid;
@@ -187,6 +255,11 @@ Status TabletMetadata::DeleteTabletData(TabletDataState delete_type,
   return Flush();
 }
 
+TabletCopyProgressPB TabletMetadata::tablet_copy_progress() const {
+  std::lock_guard<LockType> l(data_lock_);
+  return tablet_copy_progress_;
+}
+
 bool TabletMetadata::IsTombstonedWithNoBlocks() const {
   std::lock_guard<LockType> l(data_lock_);
   return tablet_data_state_ == TABLET_DATA_TOMBSTONED &&
@@ -214,6 +287,11 @@ Status TabletMetadata::DeleteSuperBlock() {
   string path = fs_manager_->GetTabletMetadataPath(tablet_id_);
   RETURN_NOT_OK_PREPEND(fs_manager_->env()->DeleteFile(path),
                         "Unable to delete superblock for tablet " + tablet_id_);
+  Status s = fs_manager_->env()->DeleteFile(
+      fs_manager_->GetTabletMetadataDeltaLogPath(tablet_id_));
+  if (!s.ok() && !s.IsNotFound()) {
+    return s.CloneAndPrepend("Unable to delete superblock delta log for tablet " + tablet_id_);
+  }
   return Status::OK();
 }
 
@@ -237,7 +315,11 @@ TabletMetadata::TabletMetadata(FsManager* fs_manager, string tablet_id,
       tombstone_last_logged_opid_(MinimumOpId()),
       num_flush_pins_(0),
       needs_flush_(false),
-      pre_flush_callback_(Bind(DoNothingStatusClosure)) {
+      pre_flush_callback_(Bind(DoNothingStatusClosure)),
+      delta_log_id_(0),
+      num_delta_records_(0),
+      delta_log_bytes_(0),
+      superblock_bytes_(0) {
   CHECK(schema_->has_column_ids());
   CHECK_GT(schema_->num_key_columns(), 0);
 }
@@ -256,7 +338,11 @@ TabletMetadata::TabletMetadata(FsManager* fs_manager, string tablet_id)
       tombstone_last_logged_opid_(MinimumOpId()),
       num_flush_pins_(0),
       needs_flush_(false),
-      pre_flush_callback_(Bind(DoNothingStatusClosure)) {}
+      pre_flush_callback_(Bind(DoNothingStatusClosure)),
+      delta_log_id_(0),
+      num_delta_records_(0),
+      delta_log_bytes_(0),
+      superblock_bytes_(0) {}
 
 Status TabletMetadata::LoadFromDisk() {
   TRACE_EVENT1("tablet", "TabletMetadata::LoadFromDisk",
@@ -349,6 +435,12 @@ Status TabletMetadata::LoadFromSuperBlock(const TabletSuperBlockPB& superblock)
     } else {
       tombstone_last_logged_opid_ = MinimumOpId();
     }
+
+    if (superblock.has_tablet_copy_progress()) {
+      tablet_copy_progress_ = superblock.tablet_copy_progress();
+    } else {
+      tablet_copy_progress_.Clear();
+    }
   }
 
   // Now is a good time to clean up any orphaned blocks that may have been
@@ -457,7 +549,7 @@ Status TabletMetadata::Flush() {
     orphaned.assign(orphaned_blocks_.begin(), orphaned_blocks_.end());
   }
   pre_flush_callback_.Run();
-  RETURN_NOT_OK(ReplaceSuperBlockUnlocked(pb));
+  RETURN_NOT_OK(WriteSuperBlockUnlocked(&pb));
   TRACE("Metadata flushed");
   l_flush.Unlock();
 
@@ -504,7 +596,8 @@ Status TabletMetadata::UpdateUnlocked(
 Status TabletMetadata::ReplaceSuperBlock(const TabletSuperBlockPB &pb) {
   {
     MutexLock l(flush_lock_);
-    RETURN_NOT_OK_PREPEND(ReplaceSuperBlockUnlocked(pb), "Unable to replace superblock");
+    TabletSuperBlockPB to_write(pb);
+    RETURN_NOT_OK_PREPEND(ReplaceSuperBlockUnlocked(&to_write), "Unable to replace superblock");
   }
 
   RETURN_NOT_OK_PREPEND(LoadFromSuperBlock(pb),
@@ -513,15 +606,118 @@ Status TabletMetadata::ReplaceSuperBlock(const TabletSuperBlockPB &pb) {
   return Status::OK();
 }
 
-Status TabletMetadata::ReplaceSuperBlockUnlocked(const TabletSuperBlockPB &pb) {
+Status TabletMetadata::ReplaceSuperBlockUnlocked(TabletSuperBlockPB* pb, bool sync_dir) {
   flush_lock_.AssertAcquired();
 
+  // Delta log IDs are random so that a stale delta log left behind by a crash
+  // can't be mistaken for the one of the new superblock.
+  uint64_t delta_log_id = 0;
+  if (FLAGS_tablet_metadata_max_delta_records > 0) {
+    Random rng(GetRandomSeed32());
+    do {
+      delta_log_id = rng.Next64();
+    } while (delta_log_id == 0 || delta_log_id == delta_log_id_);
+    pb->set_delta_log_id(delta_log_id);
+  } else {
+    pb->clear_delta_log_id();
+  }
+
   string path = fs_manager_->GetTabletMetadataPath(tablet_id_);
   RETURN_NOT_OK_PREPEND(pb_util::WritePBContainerToPath(
-                            fs_manager_->env(), path, pb,
-                            pb_util::OVERWRITE, pb_util::SYNC),
+                            fs_manager_->env(), path, *pb, pb_util::OVERWRITE,
+                            sync_dir ? pb_util::SYNC : pb_util::SYNC_FILE),
                         Substitute("Failed to write tablet metadata $0", tablet_id_));
 
+  // The records of the previous delta log no longer apply.
+  delta_log_.reset();
+  Status s = fs_manager_->env()->DeleteFile(
+      fs_manager_->GetTabletMetadataDeltaLogPath(tablet_id_));
+  if (!s.ok() && !s.IsNotFound()) {
+    WARN_NOT_OK(s, LogPrefix() + "Unable to delete stale superblock delta log");
+  }
+
+  delta_log_id_ = delta_log_id;
+  num_delta_records_ = 0;
+  delta_log_bytes_ = 0;
+  superblock_bytes_ = pb->ByteSize();
+  flushed_rowsets_.clear();
+  if (delta_log_id_ != 0) {
+    for (const RowSetDataPB& rowset : pb->rowsets()) {
+      rowset.SerializeToString(&flushed_rowsets_[rowset.id()]);
+    }
+  }
+  return Status::OK();
+}
+
+Status TabletMetadata::WriteSuperBlockUnlocked(TabletSuperBlockPB* pb) {
+  flush_lock_.AssertAcquired();
+
+  if (delta_log_id_ != 0 &&
+      num_delta_records_ < FLAGS_tablet_metadata_max_delta_records &&
+      delta_log_bytes_ < superblock_bytes_) {
+    Status s = AppendSuperBlockDeltaUnlocked(pb);
+    if (s.ok()) {
+      return Status::OK();
+    }
+    // The record may have been partially written, so no further records may
+    // follow it. Rewriting the superblock starts a new delta log.
+    WARN_NOT_OK(s, LogPrefix() + "Unable to append to superblock delta log, "
+                "rewriting the superblock");
+  }
+  return ReplaceSuperBlockUnlocked(pb);
+}
+
+Status TabletMetadata::AppendSuperBlockDeltaUnlocked(TabletSuperBlockPB* pb) {
+  flush_lock_.AssertAcquired();
+  DCHECK_NE(0, delta_log_id_);
+
+  TabletSuperBlockDeltaPB delta;
+  delta.set_delta_log_id(delta_log_id_);
+  unordered_map<int64_t, string> rowsets;
+  for (const RowSetDataPB& rowset : pb->rowsets()) {
+    string serialized;
+    rowset.SerializeToString(&serialized);
+    const string* flushed = FindOrNull(flushed_rowsets_, rowset.id());
+    if (flushed == nullptr || *flushed != serialized) {
+      *delta.add_updated_rowsets() = rowset;
+    }
+    rowsets.emplace(rowset.id(), std::move(serialized));
+  }
+  for (const auto& e : flushed_rowsets_) {
+    if (!ContainsKey(rowsets, e.first)) {
+      delta.add_removed_rowset_ids(e.first);
+    }
+  }
+
+  // Copy everything but the rowsets into the record's header.
+  google::protobuf::RepeatedPtrField<RowSetDataPB> pb_rowsets;
+  pb_rowsets.Swap(pb->mutable_rowsets());
+  delta.mutable_header()->CopyFrom(*pb);
+  pb_rowsets.Swap(pb->mutable_rowsets());
+  delta.mutable_header()->clear_delta_log_id();
+
+  if (!delta_log_) {
+    string path = fs_manager_->GetTabletMetadataDeltaLogPath(tablet_id_);
+    RWFileOptions opts;
+    opts.mode = Env::CREATE_IF_NON_EXISTING_TRUNCATE;
+    unique_ptr<RWFile> file;
+    RETURN_NOT_OK(fs_manager_->env()->NewRWFile(opts, path, &file));
+    unique_ptr<pb_util::WritablePBContainerFile> delta_log(
+        new pb_util::WritablePBContainerFile(std::move(file)));
+    RETURN_NOT_OK(delta_log->Init(delta));
+    RETURN_NOT_OK(delta_log->Sync());
+    RETURN_NOT_OK(fs_manager_->env()->SyncDir(fs_manager_->GetTabletMetadataDir()));
+    delta_log_ = std::move(delta_log);
+  }
+  RETURN_NOT_OK(delta_log_->Append(delta));
+  RETURN_NOT_OK(delta_log_->Sync());
+
+  flushed_rowsets_.swap(rowsets);
+  num_delta_records_++;
+  delta_log_bytes_ += delta.ByteSize();
+  VLOG_WITH_PREFIX(2) << "Appended superblock delta record " << num_delta_records_ << ": "
+                      << delta.updated_rowsets_size() << " rowsets updated, "
+                      << delta.removed_rowset_ids_size() << " removed";
   return Status::OK();
 }
 
@@ -530,6 +726,83 @@ Status TabletMetadata::ReadSuperBlockFromDisk(TabletSuperBlockPB* superblock) co
   RETURN_NOT_OK_PREPEND(
       pb_util::ReadPBContainerFromPath(fs_manager_->env(), path, superblock),
       Substitute("Could not load tablet metadata from $0", path));
+  if (superblock->has_delta_log_id()) {
+    RETURN_NOT_OK_PREPEND(ApplySuperBlockDeltas(superblock),
+                          Substitute("Could not load tablet metadata delta log for $0", path));
+  }
+  return Status::OK();
+}
+
+Status TabletMetadata::ApplySuperBlockDeltas(TabletSuperBlockPB* superblock) const {
+  string path = fs_manager_->GetTabletMetadataDeltaLogPath(tablet_id_);
+  unique_ptr<RandomAccessFile> file;
+  Status s = fs_manager_->env()->NewRandomAccessFile(path, &file);
+  if (s.IsNotFound()) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+  pb_util::ReadablePBContainerFile reader(std::move(file));
+  s = reader.Open();
+  if (s.IsIncomplete()) {
+    // The delta log was created but its header never made it to disk.
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+
+  const uint64_t delta_log_id = superblock->delta_log_id();
+  int num_records = 0;
+  while (true) {
+    TabletSuperBlockDeltaPB delta;
+    s = reader.ReadNextPB(&delta);
+    if (s.IsEndOfFile()) {
+      break;
+    }
+    if (s.IsIncomplete()) {
+      // A record torn by a crash was never acknowledged.
+      LOG_WITH_PREFIX(WARNING) << "Ignoring incomplete record at the end of superblock "
+                               << "delta log " << path << ": " << s.ToString();
+      break;
+    }
+    RETURN_NOT_OK(s);
+    if (delta.delta_log_id() != delta_log_id) {
+      // Left behind by a crash while replacing an older superblock.
+      VLOG_WITH_PREFIX(1) << "Ignoring stale superblock delta log " << path;
+      break;
+    }
+
+    unordered_map<int64_t, RowSetDataPB*> updated;
+    for (RowSetDataPB& rowset : *delta.mutable_updated_rowsets()) {
+      updated.emplace(rowset.id(), &rowset);
+    }
+    std::unordered_set<int64_t> removed(delta.removed_rowset_ids().begin(),
+                                        delta.removed_rowset_ids().end());
+
+    // Rowsets keep their order; new ones are appended in the record's order.
+    TabletSuperBlockPB merged;
+    merged.Swap(delta.mutable_header());
+    for (RowSetDataPB& rowset : *superblock->mutable_rowsets()) {
+      if (ContainsKey(removed, rowset.id())) {
+        continue;
+      }
+      RowSetDataPB** update = FindOrNull(updated, rowset.id());
+      if (update) {
+        merged.add_rowsets()->Swap(*update);
+        updated.erase(rowset.id());
+      } else {
+        merged.add_rowsets()->Swap(&rowset);
+      }
+    }
+    for (RowSetDataPB& rowset : *delta.mutable_updated_rowsets()) {
+      if (ContainsKey(updated, rowset.id())) {
+        merged.add_rowsets()->Swap(&rowset);
+      }
+    }
+    merged.set_delta_log_id(delta_log_id);
+    superblock->Swap(&merged);
+    num_records++;
+  }
+  VLOG_WITH_PREFIX(1) << "Applied " << num_records << " superblock delta records from "
+                      << path;
   return Status::OK();
 }
 
@@ -569,6 +842,10 @@ Status TabletMetadata::ToSuperBlockUnlocked(TabletSuperBlockPB* super_block,
     block_id.CopyToPB(pb.mutable_orphaned_blocks()->Add());
   }
 
+  if (tablet_copy_progress_.IsInitialized()) {
+    *pb.mutable_tablet_copy_progress() = tablet_copy_progress_;
+  }
+
   super_block->Swap(&pb);
   return Status::OK();
 }
@@ -20,6 +20,7 @@
 #include <boost/optional/optional_fwd.hpp>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -38,6 +39,11 @@
 #include "kudu/util/status_callback.h"
 
 namespace kudu {
+
+namespace pb_util {
+class WritablePBContainerFile;
+} // namespace pb_util
+
 namespace tablet {
 
 class RowSetMetadata;
@@ -72,6 +78,20 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
                           const TabletDataState& initial_tablet_data_state,
                           scoped_refptr<TabletMetadata>* metadata);
 
+  // Like CreateNew(), but doesn't sync the tablet metadata directory, so that
+  // tablets created together may share a single sync. The creation of the
+  // metadata isn't durable until the caller syncs the directory returned by
+  // FsManager::GetTabletMetadataDir().
+  static Status CreateNewWithoutDirSync(FsManager* fs_manager,
+                                        const std::string& tablet_id,
+                                        const std::string& table_name,
+                                        const std::string& table_id,
+                                        const Schema& schema,
+                                        const PartitionSchema& partition_schema,
+                                        const Partition& partition,
+                                        const TabletDataState& initial_tablet_data_state,
+                                        scoped_refptr<TabletMetadata>* metadata);
+
   // Load existing metadata from disk.
   static Status Load(FsManager* fs_manager,
                      const std::string& tablet_id,
@@ -214,7 +234,13 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
 
   consensus::OpId tombstone_last_logged_opid() const { return tombstone_last_logged_opid_; }
 
-  // Loads the currently-flushed superblock from disk into the given protobuf.
+  // Returns the blocks kept from the last, aborted, copy of the tablet, or an
+  // uninitialized protobuf if there are none. Deleting the tablet data with
+  // TABLET_DATA_DELETED deletes these blocks too; tombstoning keeps them.
+  TabletCopyProgressPB tablet_copy_progress() const;
+
+  // Loads the currently-flushed superblock from disk into the given protobuf,
+  // applying the records of its delta log, if any.
   Status ReadSuperBlockFromDisk(TabletSuperBlockPB* superblock) const;
 
   // Sets *super_block to the serialized form of the current metadata.
@@ -259,9 +285,37 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
 
   Status ReadSuperBlock(TabletSuperBlockPB *pb);
 
-  // Fully replace superblock.
+  // Shared implementation of CreateNew() and CreateNewWithoutDirSync().
+  static Status CreateNewInternal(FsManager* fs_manager,
+                                  const std::string& tablet_id,
+                                  const std::string& table_name,
+                                  const std::string& table_id,
+                                  const Schema& schema,
+                                  const PartitionSchema& partition_schema,
+                                  const Partition& partition,
+                                  const TabletDataState& initial_tablet_data_state,
+                                  bool sync_dir,
+                                  scoped_refptr<TabletMetadata>* metadata);
+
+  // Fully replace superblock, starting a new delta log for it if delta logs
+  // are enabled. Sets the delta log ID of 'pb' accordingly. The tablet
+  // metadata directory is only synced if 'sync_dir' is true.
   // Requires 'flush_lock_'.
-  Status ReplaceSuperBlockUnlocked(const TabletSuperBlockPB &pb);
+  Status ReplaceSuperBlockUnlocked(TabletSuperBlockPB* pb, bool sync_dir = true);
+
+  // Persist 'pb' as the new superblock, by appending its difference from the
+  // last persisted superblock to the delta log if possible, and by replacing
+  // the superblock otherwise.
+  // Requires 'flush_lock_'.
+  Status WriteSuperBlockUnlocked(TabletSuperBlockPB* pb);
+
+  // Append the difference between 'pb' and the last persisted superblock to
+  // the delta log. 'pb' is left unchanged.
+  // Requires 'flush_lock_'.
+  Status AppendSuperBlockDeltaUnlocked(TabletSuperBlockPB* pb);
+
+  // Applies to 'superblock' the records of its delta log, if it has one.
+  Status ApplySuperBlockDeltas(TabletSuperBlockPB* superblock) const;
 
   // Requires 'data_lock_'.
   Status UpdateUnlocked(const RowSetMetadataIds& to_remove,
@@ -337,6 +391,9 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // tombstoned. Has no meaning for non-tombstoned tablets.
   consensus::OpId tombstone_last_logged_opid_;
 
+  // Protected by 'data_lock_'.
+  TabletCopyProgressPB tablet_copy_progress_;
+
   // If this counter is > 0 then Flush() will not write any data to
   // disk.
   int32_t num_flush_pins_;
@@ -350,6 +407,27 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // to disk.
   StatusClosure pre_flush_callback_;
 
+  // State of the superblock delta log, protected by 'flush_lock_'.
+  //
+  // The ID of the delta log extending the last full superblock written by
+  // this instance, or 0 if it hasn't written one with a delta log yet. In
+  // that case, the next flush writes a full superblock.
+  uint64_t delta_log_id_;
+
+  // The open delta log, if a record has been appended to it.
+  std::unique_ptr<pb_util::WritablePBContainerFile> delta_log_;
+
+  // The number of records in the delta log, and their total size.
+  int num_delta_records_;
+  int64_t delta_log_bytes_;
+
+  // The size of the last full superblock written.
+  int64_t superblock_bytes_;
+
+  // The serialized RowSetDataPBs of the last persisted superblock, by rowset
+  // ID, against which the next delta record is computed.
+  std::unordered_map<int64_t, std::string> flushed_rowsets_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletMetadata);
 };
 
@@ -87,6 +87,22 @@ METRIC_DEFINE_counter(tablet, scanner_bytes_scanned_from_disk, "Scanner Bytes Sc
                       "and does not include data read from in-memory stores. However, it"
                       "includes both cache misses and cache hits.");
 
+METRIC_DEFINE_counter(tablet, scanner_cache_hit_bytes, "Scanner Bytes Read From Cache",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of blocks which scan requests found in the block "
+                      "cache. Blocks read ahead of scan requests are not counted.");
+
+METRIC_DEFINE_counter(tablet, scanner_cache_miss_bytes, "Scanner Bytes Read From Disk",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of blocks which scan requests missed in the block "
+                      "cache, and so read from disk. Blocks read ahead of scan requests "
+                      "are not counted.");
+
+METRIC_DEFINE_counter(tablet, scanner_cpu_time, "Scanner CPU Time",
+                      kudu::MetricUnit::kMicroseconds,
+                      "CPU time spent by scan requests reading, filtering and "
+                      "serializing rows of this tablet.");
+
 
 METRIC_DEFINE_counter(tablet, insertions_failed_dup_key, "Duplicate Key Inserts",
                       kudu::MetricUnit::kRows,
@@ -145,6 +161,45 @@ METRIC_DEFINE_histogram(tablet, write_op_duration_commit_wait_consistency,
   "Duration of writes to this tablet with external consistency set to COMMIT_WAIT.",
   60000000LU, 2);
 
+METRIC_DEFINE_histogram(tablet, write_decode_duration,
+  "Write Decode Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent decoding the row operations of writes to this tablet.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_row_lock_duration,
+  "Write Row Lock Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent acquiring the row locks of writes to this tablet, including waiting "
+  "for other writes to the same rows.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_key_probe_duration,
+  "Write Key Probe Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent checking the DiskRowSets of this tablet, with their bloom filters and "
+  "key indexes, for the keys inserted by each write.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_apply_duration,
+  "Write Apply Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent applying the row operations of writes to the MemRowSet and "
+  "DeltaMemStores of this tablet, including the key probes.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_replication_duration,
+  "Write Replication Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time from submitting writes to this tablet for replication, while it was the "
+  "leader, to their being replicated to a majority and durable in the local WAL.",
+  60000000LU, 2);
+
+METRIC_DEFINE_counter(tablet, write_cpu_time, "Write CPU Time",
+                      kudu::MetricUnit::kMicroseconds,
+                      "CPU time spent decoding, preparing and applying the writes to "
+                      "this tablet, not including their replication.");
+
 METRIC_DEFINE_histogram(tablet, commit_wait_duration,
   "Commit-Wait Duration",
   kudu::MetricUnit::kMicroseconds,
@@ -182,6 +237,11 @@ METRIC_DEFINE_gauge_uint32(tablet, delta_major_compact_rs_running,
   kudu::MetricUnit::kMaintenanceOperations,
   "Number of delta major compactions currently running.");
 
+METRIC_DEFINE_gauge_uint32(tablet, undo_delta_block_gc_running,
+  "Undo Delta Block GC Running",
+  kudu::MetricUnit::kMaintenanceOperations,
+  "Number of UNDO delta block GC operations currently running.");
+
 METRIC_DEFINE_histogram(tablet, flush_dms_duration,
   "DeltaMemStore Flush Duration",
   kudu::MetricUnit::kMilliseconds,
@@ -207,6 +267,16 @@ METRIC_DEFINE_histogram(tablet, delta_major_compact_rs_duration,
   kudu::MetricUnit::kSeconds,
   "Seconds spent major delta compacting.", 60000000LU, 2);
 
+METRIC_DEFINE_histogram(tablet, undo_delta_block_gc_duration,
+  "Undo Delta Block GC Duration",
+  kudu::MetricUnit::kMilliseconds,
+  "Time spent deleting ancient UNDO delta blocks.", 60000LU, 1);
+
+METRIC_DEFINE_counter(tablet, undo_delta_block_gc_bytes_deleted,
+  "Undo Delta Block GC Bytes Deleted",
+  kudu::MetricUnit::kBytes,
+  "Number of bytes of ancient UNDO delta blocks deleted by this tablet.");
+
 METRIC_DEFINE_counter(tablet, leader_memory_pressure_rejections,
   "Leader Memory Pressure Rejections",
   kudu::MetricUnit::kRequests,
@@ -233,6 +303,9 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(scanner_rows_scanned),
     MINIT(scanner_cells_scanned_from_disk),
     MINIT(scanner_bytes_scanned_from_disk),
+    MINIT(scanner_cache_hit_bytes),
+    MINIT(scanner_cache_miss_bytes),
+    MINIT(scanner_cpu_time),
     MINIT(scans_started),
     MINIT(bloom_lookups),
     MINIT(key_file_lookups),
@@ -246,16 +319,25 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(snapshot_read_inflight_wait_duration),
     MINIT(write_op_duration_client_propagated_consistency),
     MINIT(write_op_duration_commit_wait_consistency),
+    MINIT(write_decode_duration),
+    MINIT(write_row_lock_duration),
+    MINIT(write_key_probe_duration),
+    MINIT(write_apply_duration),
+    MINIT(write_replication_duration),
+    MINIT(write_cpu_time),
     GINIT(flush_dms_running),
     GINIT(flush_mrs_running),
     GINIT(compact_rs_running),
     GINIT(delta_minor_compact_rs_running),
     GINIT(delta_major_compact_rs_running),
+    GINIT(undo_delta_block_gc_running),
     MINIT(flush_dms_duration),
     MINIT(flush_mrs_duration),
     MINIT(compact_rs_duration),
     MINIT(delta_minor_compact_rs_duration),
     MINIT(delta_major_compact_rs_duration),
+    MINIT(undo_delta_block_gc_duration),
+    MINIT(undo_delta_block_gc_bytes_deleted),
     MINIT(leader_memory_pressure_rejections) {
 }
 #undef MINIT
@@ -57,6 +57,9 @@ struct TabletMetrics {
   scoped_refptr<Counter> scanner_rows_scanned;
   scoped_refptr<Counter> scanner_cells_scanned_from_disk;
   scoped_refptr<Counter> scanner_bytes_scanned_from_disk;
+  scoped_refptr<Counter> scanner_cache_hit_bytes;
+  scoped_refptr<Counter> scanner_cache_miss_bytes;
+  scoped_refptr<Counter> scanner_cpu_time;
   scoped_refptr<Counter> scans_started;
 
   // Probe stats
@@ -75,17 +78,29 @@ struct TabletMetrics {
   scoped_refptr<Histogram> write_op_duration_client_propagated_consistency;
   scoped_refptr<Histogram> write_op_duration_commit_wait_consistency;
 
+  // The stages of writes.
+  scoped_refptr<Histogram> write_decode_duration;
+  scoped_refptr<Histogram> write_row_lock_duration;
+  scoped_refptr<Histogram> write_key_probe_duration;
+  scoped_refptr<Histogram> write_apply_duration;
+  scoped_refptr<Histogram> write_replication_duration;
+  scoped_refptr<Counter> write_cpu_time;
+
   scoped_refptr<AtomicGauge<uint32_t> > flush_dms_running;
   scoped_refptr<AtomicGauge<uint32_t> > flush_mrs_running;
   scoped_refptr<AtomicGauge<uint32_t> > compact_rs_running;
   scoped_refptr<AtomicGauge<uint32_t> > delta_minor_compact_rs_running;
   scoped_refptr<AtomicGauge<uint32_t> > delta_major_compact_rs_running;
+  scoped_refptr<AtomicGauge<uint32_t> > undo_delta_block_gc_running;
 
   scoped_refptr<Histogram> flush_dms_duration;
   scoped_refptr<Histogram> flush_mrs_duration;
   scoped_refptr<Histogram> compact_rs_duration;
   scoped_refptr<Histogram> delta_minor_compact_rs_duration;
   scoped_refptr<Histogram> delta_major_compact_rs_duration;
+  scoped_refptr<Histogram> undo_delta_block_gc_duration;
+
+  scoped_refptr<Counter> undo_delta_block_gc_bytes_deleted;
 
   scoped_refptr<Counter> leader_memory_pressure_rejections;
 };
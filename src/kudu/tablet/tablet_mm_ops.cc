@@ -17,12 +17,39 @@
 
 #include "kudu/tablet/tablet_mm_ops.h"
 
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <string>
 
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_metrics.h"
 
+DEFINE_bool(enable_undo_delta_block_gc, true,
+            "Whether to run the maintenance operation which deletes UNDO delta "
+            "blocks holding only history older than --tablet_history_max_age_sec.");
+TAG_FLAG(enable_undo_delta_block_gc, advanced);
+TAG_FLAG(enable_undo_delta_block_gc, runtime);
+
+DEFINE_int32(undo_delta_block_gc_init_budget_millis, 1000,
+             "The maximum time an UNDO delta block GC operation spends reading "
+             "the stats of UNDO delta blocks to find the ancient ones. Blocks "
+             "which aren't read in time are left for a later operation.");
+TAG_FLAG(undo_delta_block_gc_init_budget_millis, advanced);
+
+DEFINE_int64(undo_delta_block_gc_bytes_for_max_score, 1024 * 1024 * 1024,
+             "The size of the ancient UNDO delta blocks in a tablet at which "
+             "deleting them is considered as worthwhile as the most fruitful "
+             "delta compaction. Smaller sizes are scored proportionally.");
+TAG_FLAG(undo_delta_block_gc_bytes_for_max_score, advanced);
+
+using std::set;
+using std::shared_ptr;
+using std::string;
 using strings::Substitute;
 
 namespace kudu {
@@ -131,10 +158,12 @@ void MinorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
     }
   }
 
+  shared_ptr<RowSet> rs;
   double perf_improv = tablet_->GetPerfImprovementForBestDeltaCompact(
-      RowSet::MINOR_DELTA_COMPACTION, nullptr);
+      RowSet::MINOR_DELTA_COMPACTION, &rs);
   prev_stats_.set_perf_improvement(perf_improv);
   prev_stats_.set_runnable(perf_improv > 0);
+  prev_stats_.set_data_dirs(rs ? tablet_->GetDataDirs({ rs.get() }) : set<string>());
   *stats = prev_stats_;
 }
 
@@ -207,10 +236,12 @@ void MajorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
     }
   }
 
+  shared_ptr<RowSet> rs;
   double perf_improv = tablet_->GetPerfImprovementForBestDeltaCompact(
-      RowSet::MAJOR_DELTA_COMPACTION, nullptr);
+      RowSet::MAJOR_DELTA_COMPACTION, &rs);
   prev_stats_.set_perf_improvement(perf_improv);
   prev_stats_.set_runnable(perf_improv > 0);
+  prev_stats_.set_data_dirs(rs ? tablet_->GetDataDirs({ rs.get() }) : set<string>());
   *stats = prev_stats_;
 }
 
@@ -237,5 +268,54 @@ scoped_refptr<AtomicGauge<uint32_t> > MajorDeltaCompactionOp::RunningGauge() con
   return tablet_->metrics()->delta_major_compact_rs_running;
 }
 
+////////////////////////////////////////////////////////////
+// UndoDeltaBlockGCOp
+////////////////////////////////////////////////////////////
+
+UndoDeltaBlockGCOp::UndoDeltaBlockGCOp(Tablet* tablet)
+  : MaintenanceOp(Substitute("UndoDeltaBlockGCOp($0)", tablet->tablet_id()),
+                  MaintenanceOp::HIGH_IO_USAGE),
+    tablet_(tablet) {
+}
+
+void UndoDeltaBlockGCOp::UpdateStats(MaintenanceOpStats* stats) {
+  // The ancient history mark moves with the clock, so the stats can't be
+  // cached like those of the compaction ops. Computing them needs no I/O.
+  if (!FLAGS_enable_undo_delta_block_gc) {
+    stats->set_runnable(false);
+    return;
+  }
+  int64_t bytes = tablet_->EstimateBytesInPotentiallyAncientUndoDeltas();
+  stats->set_runnable(bytes > 0);
+  stats->set_perf_improvement(std::min(
+      1.0, static_cast<double>(bytes) / FLAGS_undo_delta_block_gc_bytes_for_max_score));
+}
+
+bool UndoDeltaBlockGCOp::Prepare() {
+  return true;
+}
+
+void UndoDeltaBlockGCOp::Perform() {
+  int64_t blocks_deleted;
+  int64_t bytes_deleted;
+  Status s = tablet_->DeleteAncientUndoDeltas(
+      MonoDelta::FromMilliseconds(FLAGS_undo_delta_block_gc_init_budget_millis),
+      &blocks_deleted, &bytes_deleted);
+  WARN_NOT_OK(s, Substitute("UNDO delta block GC failed on $0", tablet_->tablet_id()));
+  // Even on failure, the blocks counted so far were deleted.
+  TabletMetrics* metrics = tablet_->metrics();
+  if (metrics) {
+    metrics->undo_delta_block_gc_bytes_deleted->IncrementBy(bytes_deleted);
+  }
+}
+
+scoped_refptr<Histogram> UndoDeltaBlockGCOp::DurationHistogram() const {
+  return tablet_->metrics()->undo_delta_block_gc_duration;
+}
+
+scoped_refptr<AtomicGauge<uint32_t> > UndoDeltaBlockGCOp::RunningGauge() const {
+  return tablet_->metrics()->undo_delta_block_gc_running;
+}
+
 } // namespace tablet
 } // namespace kudu
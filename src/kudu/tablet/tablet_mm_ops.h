@@ -117,6 +117,31 @@ class MajorDeltaCompactionOp : public MaintenanceOp {
   Tablet* const tablet_;
 };
 
+// MaintenanceOp to delete UNDO delta files holding only ancient history.
+//
+// Unlike a major delta compaction, this doesn't rewrite any data: a whole UNDO
+// file is deleted once all of its mutations are older than the tablet's
+// ancient history mark (see --tablet_history_max_age_sec), as recorded in its
+// DeltaStats. This reclaims disk space in tablets which stopped changing, and
+// saves scans from opening the deleted files.
+class UndoDeltaBlockGCOp : public MaintenanceOp {
+ public:
+  explicit UndoDeltaBlockGCOp(Tablet* tablet);
+
+  virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
+
+  virtual bool Prepare() OVERRIDE;
+
+  virtual void Perform() OVERRIDE;
+
+  virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE;
+
+  virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
+
+ private:
+  Tablet* const tablet_;
+};
+
 } // namespace tablet
 } // namespace kudu
 
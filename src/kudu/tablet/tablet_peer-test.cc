@@ -41,6 +41,7 @@
 #include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/maintenance_manager.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
@@ -49,6 +50,7 @@
 METRIC_DECLARE_entity(tablet);
 
 DECLARE_int32(flush_threshold_mb);
+DECLARE_int32(tablet_prepare_decode_threads);
 
 namespace kudu {
 namespace tablet {
@@ -72,6 +74,7 @@ using server::LogicalClock;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 using tserver::WriteRequestPB;
 using tserver::WriteResponsePB;
@@ -529,6 +532,24 @@ TEST_F(TabletPeerTest, TestGCEmptyLog) {
   ASSERT_OK(tablet_peer_->RunLogGC());
 }
 
+// Test that a replica stays hibernated until its tablet is written to.
+TEST_F(TabletPeerTest, TestHibernate) {
+  ConsensusBootstrapInfo info;
+  ASSERT_OK(StartPeer(info));
+  ASSERT_OK(ExecuteInsertsAndRollLogs(2));
+  ASSERT_FALSE(tablet_peer_->hibernated());
+
+  // Make sure the hibernation happens strictly after the last write.
+  SleepFor(MonoDelta::FromMilliseconds(1));
+  tablet_peer_->Hibernate();
+  ASSERT_TRUE(tablet_peer_->hibernated());
+  ASSERT_EQ("RUNNING (hibernated)", tablet_peer_->HumanReadableState());
+
+  ASSERT_OK(ExecuteInsertsAndRollLogs(1));
+  ASSERT_FALSE(tablet_peer_->hibernated());
+  ASSERT_EQ("RUNNING", tablet_peer_->HumanReadableState());
+}
+
 TEST_F(TabletPeerTest, TestFlushOpsPerfImprovements) {
   FLAGS_flush_threshold_mb = 64;
 
@@ -560,5 +581,55 @@ TEST_F(TabletPeerTest, TestFlushOpsPerfImprovements) {
   stats.Clear();
 }
 
+class TabletPeerParallelDecodeTest : public TabletPeerTest {
+ public:
+  virtual void SetUp() OVERRIDE {
+    FLAGS_tablet_prepare_decode_threads = 4;
+    TabletPeerTest::SetUp();
+  }
+};
+
+// Test that writes submitted back to back, and so decoded concurrently ahead
+// of their prepare phase, are all applied.
+TEST_F(TabletPeerParallelDecodeTest, TestConcurrentlyDecodedWrites) {
+  ConsensusBootstrapInfo info;
+  ASSERT_OK(StartPeer(info));
+
+  const int kNumWrites = 50;
+  const int kRowsPerWrite = 20;
+  Schema schema(GetTestSchema());
+  vector<unique_ptr<WriteRequestPB>> reqs;
+  vector<unique_ptr<WriteResponsePB>> resps;
+  CountDownLatch rpc_latch(kNumWrites);
+  for (int i = 0; i < kNumWrites; i++) {
+    unique_ptr<WriteRequestPB> req(new WriteRequestPB());
+    req->set_tablet_id(tablet()->tablet_id());
+    ASSERT_OK(SchemaToPB(schema, req->mutable_schema()));
+    RowOperationsPBEncoder enc(req->mutable_row_operations());
+    for (int j = 0; j < kRowsPerWrite; j++) {
+      KuduPartialRow row(&schema);
+      ASSERT_OK(row.SetInt32("key", insert_counter_++));
+      enc.Add(RowOperationsPB::INSERT, row);
+    }
+    unique_ptr<WriteResponsePB> resp(new WriteResponsePB());
+    unique_ptr<WriteTransactionState> tx_state(
+        new WriteTransactionState(tablet_peer_.get(), req.get(), nullptr, resp.get()));
+    tx_state->set_completion_callback(gscoped_ptr<TransactionCompletionCallback>(
+        new LatchTransactionCompletionCallback<WriteResponsePB>(&rpc_latch, resp.get())));
+    ASSERT_OK(tablet_peer_->SubmitWrite(std::move(tx_state)));
+    reqs.emplace_back(std::move(req));
+    resps.emplace_back(std::move(resp));
+  }
+  rpc_latch.Wait();
+
+  for (const auto& resp : resps) {
+    ASSERT_FALSE(resp->has_error()) << SecureDebugString(*resp);
+    ASSERT_EQ(0, resp->per_row_errors_size()) << SecureDebugString(*resp);
+  }
+  uint64_t num_rows;
+  ASSERT_OK(tablet()->CountRows(&num_rows));
+  ASSERT_EQ(kNumWrites * kRowsPerWrite, num_rows);
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -37,6 +37,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/sysinfo.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/remote_method.h"
 #include "kudu/rpc/rpc_service.h"
@@ -49,12 +50,20 @@
 #include "kudu/tablet/tablet_peer_mm_ops.h"
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
+DEFINE_int32(tablet_prepare_decode_threads, 0,
+             "Number of threads per tablet which decode write operations ahead of "
+             "their transaction's prepare phase, so that consecutive write batches "
+             "decode concurrently and only row locking and timestamp assignment run "
+             "serially. If 0, write operations are decoded in the prepare phase.");
+TAG_FLAG(tablet_prepare_decode_threads, experimental);
+
 using std::map;
 using std::shared_ptr;
 using std::unique_ptr;
@@ -115,6 +124,7 @@ TabletPeer::TabletPeer(const scoped_refptr<TabletMetadata>& meta,
       local_peer_pb_(local_peer_pb),
       state_(NOT_STARTED),
       last_status_("Tablet initializing..."),
+      hibernated_micros_(0),
       apply_pool_(apply_pool),
       log_anchor_registry_(new LogAnchorRegistry()),
       mark_dirty_clbk_(std::move(mark_dirty_clbk)) {}
@@ -145,6 +155,12 @@ Status TabletPeer::Init(const shared_ptr<Tablet>& tablet,
       METRIC_op_prepare_queue_time.Instantiate(metric_entity));
   prepare_pool_->SetRunTimeMicrosHistogram(
       METRIC_op_prepare_run_time.Instantiate(metric_entity));
+  if (FLAGS_tablet_prepare_decode_threads > 0) {
+    RETURN_NOT_OK(ThreadPoolBuilder("prepare-decode")
+                  .set_max_threads(FLAGS_tablet_prepare_decode_threads)
+                  .Build(&decode_pool_));
+  }
+  apply_pool_token_ = apply_pool_->NewSerialToken();
 
   {
     std::lock_guard<simple_spinlock> lock(lock_);
@@ -250,6 +266,14 @@ void TabletPeer::Shutdown() {
     prepare_pool_->Shutdown();
   }
 
+  if (decode_pool_) {
+    decode_pool_->Shutdown();
+  }
+
+  if (apply_pool_token_) {
+    apply_pool_token_->Shutdown();
+  }
+
   if (log_) {
     WARN_NOT_OK(log_->Close(), "Error closing the Log.");
   }
@@ -413,9 +437,41 @@ string TabletPeer::HumanReadableState() const {
   }
   // Otherwise, the tablet's data is in a "normal" state, so we just display
   // the runtime state (BOOTSTRAPPING, RUNNING, etc).
+  if (state_ == RUNNING && HibernatedUnlocked()) {
+    return "RUNNING (hibernated)";
+  }
   return TabletStatePB_Name(state_);
 }
 
+void TabletPeer::Hibernate() {
+  scoped_refptr<Consensus> consensus;
+  shared_ptr<Tablet> tablet;
+  {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    if (state_ != RUNNING) {
+      return;
+    }
+    consensus = consensus_;
+    tablet = tablet_;
+  }
+  hibernated_micros_.store(GetMonoTimeMicros(), std::memory_order_relaxed);
+  consensus->EvictLogCache();
+  tablet->ReleaseCachedBlocks();
+  VLOG(1) << "Tablet " << tablet_id_ << " hibernated";
+}
+
+bool TabletPeer::hibernated() const {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  return HibernatedUnlocked();
+}
+
+bool TabletPeer::HibernatedUnlocked() const {
+  DCHECK(lock_.is_locked());
+  int64_t hibernated_micros = hibernated_micros_.load(std::memory_order_relaxed);
+  return tablet_ && hibernated_micros > 0 &&
+      tablet_->last_access_micros() < hibernated_micros;
+}
+
 void TabletPeer::GetInFlightTransactions(Transaction::TraceType trace_type,
                                          vector<consensus::TransactionStatusPB>* out) const {
   vector<scoped_refptr<TransactionDriver> > pending_transactions;
@@ -556,7 +612,8 @@ Status TabletPeer::NewLeaderTransactionDriver(gscoped_ptr<Transaction> transacti
     consensus_.get(),
     log_.get(),
     prepare_pool_.get(),
-    apply_pool_,
+    decode_pool_.get(),
+    apply_pool_token_.get(),
     &txn_order_verifier_);
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::LEADER));
   driver->swap(tx_driver);
@@ -571,7 +628,8 @@ Status TabletPeer::NewReplicaTransactionDriver(gscoped_ptr<Transaction> transact
     consensus_.get(),
     log_.get(),
     prepare_pool_.get(),
-    apply_pool_,
+    decode_pool_.get(),
+    apply_pool_token_.get(),
     &txn_order_verifier_);
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::REPLICA));
   driver->swap(tx_driver);
@@ -604,6 +662,10 @@ void TabletPeer::RegisterMaintenanceOps(MaintenanceManager* maint_mgr) {
   maint_mgr->RegisterOp(log_gc.get());
   maintenance_ops_.push_back(log_gc.release());
 
+  gscoped_ptr<MaintenanceOp> hibernate(new HibernateOp(this));
+  maint_mgr->RegisterOp(hibernate.get());
+  maintenance_ops_.push_back(hibernate.release());
+
   tablet_->RegisterMaintenanceOps(maint_mgr);
 }
 
@@ -18,6 +18,7 @@
 #ifndef KUDU_TABLET_TABLET_PEER_H_
 #define KUDU_TABLET_TABLET_PEER_H_
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -52,6 +53,7 @@ class CatchUpServiceTest;
 
 class MaintenanceManager;
 class MaintenanceOp;
+class ThreadPoolToken;
 
 namespace tablet {
 class LeaderTransactionDriver;
@@ -199,6 +201,17 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   // etc. For use in places like the Web UI.
   std::string HumanReadableState() const;
 
+  // Releases the memory which the replica caches to speed up later requests:
+  // the committed operations in the log cache of its consensus queue, and
+  // the blocks which its rowsets keep pinned in the block cache. The caches
+  // fill up again as the replica is read from or written to, at which point
+  // it's no longer hibernated. Does nothing unless the replica is running.
+  void Hibernate();
+
+  // Returns whether the replica hibernated and its tablet hasn't been read
+  // from or written to since.
+  bool hibernated() const;
+
   // Adds list of transactions in-flight at the time of the call to 'out'.
   void GetInFlightTransactions(Transaction::TraceType trace_type,
                                std::vector<consensus::TransactionStatusPB>* out) const;
@@ -277,6 +290,9 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
 
   ~TabletPeer();
 
+  // Same as hibernated(), with 'lock_' held.
+  bool HibernatedUnlocked() const;
+
   // Wait until the TabletPeer is fully in SHUTDOWN state.
   void WaitUntilShutdown();
 
@@ -310,6 +326,10 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   // tools, etc.
   std::string last_status_;
 
+  // The time at which the replica last hibernated, in GetMonoTimeMicros()
+  // time, or 0 if it never did.
+  std::atomic<int64_t> hibernated_micros_;
+
   // Lock taken during Init/Shutdown which ensures that only a single thread
   // attempts to perform major lifecycle operations (Init/Shutdown) at once.
   // This must be acquired before acquiring lock_ if they are acquired together.
@@ -325,11 +345,22 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   // TODO move the prepare pool to TabletServer.
   gscoped_ptr<ThreadPool> prepare_pool_;
 
+  // Pool that decodes write transactions ahead of their PrepareTask, so that
+  // the decoding of consecutive transactions overlaps. NULL unless
+  // --tablet_prepare_decode_threads is set.
+  gscoped_ptr<ThreadPool> decode_pool_;
+
   // Pool that executes apply tasks for transactions. This is a multi-threaded
   // pool, constructor-injected by either the Master (for system tables) or
-  // the Tablet server.
+  // the Tablet server, and shared by all of its tablets.
   ThreadPool* apply_pool_;
 
+  // Token through which this tablet's apply tasks are submitted to
+  // 'apply_pool_'. The tablet's applies run serially, in the order they are
+  // submitted, and the pool's threads are shared fairly between tablets, so a
+  // tablet with a deep backlog of applies doesn't delay the others.
+  gscoped_ptr<ThreadPoolToken> apply_pool_token_;
+
   scoped_refptr<server::Clock> clock_;
 
   scoped_refptr<log::LogAnchorRegistry> log_anchor_registry_;
@@ -23,7 +23,9 @@
 #include <mutex>
 #include <string>
 
+#include "kudu/consensus/consensus.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/tablet/tablet_metrics.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/maintenance_manager.h"
@@ -40,6 +42,21 @@ DEFINE_int32(flush_threshold_secs, 2 * 60,
              "even if it is not large.");
 TAG_FLAG(flush_threshold_secs, experimental);
 
+DEFINE_int32(tablet_hibernation_idle_secs, 0,
+             "Number of seconds after which a replica whose tablet hasn't been read from "
+             "or written to releases the memory it caches to speed up requests, such as "
+             "the operations in its log cache and the index blocks it keeps pinned in the "
+             "block cache. 0 disables hibernation.");
+TAG_FLAG(tablet_hibernation_idle_secs, experimental);
+TAG_FLAG(tablet_hibernation_idle_secs, runtime);
+
+DEFINE_bool(tablet_hibernation_include_leaders, false,
+            "Whether idle leader replicas hibernate too. The log cache of a leader is "
+            "used to catch up its followers, which then have to be sent operations read "
+            "back from the log.");
+TAG_FLAG(tablet_hibernation_include_leaders, experimental);
+TAG_FLAG(tablet_hibernation_include_leaders, runtime);
+
 
 METRIC_DEFINE_gauge_uint32(tablet, log_gc_running,
                            "Log GCs Running",
@@ -50,6 +67,16 @@ METRIC_DEFINE_histogram(tablet, log_gc_duration,
                         kudu::MetricUnit::kMilliseconds,
                         "Time spent garbage collecting the logs.", 60000LU, 1);
 
+METRIC_DEFINE_gauge_uint32(tablet, hibernate_running,
+                           "Hibernations Running",
+                           kudu::MetricUnit::kMaintenanceOperations,
+                           "Number of hibernations of the replica currently running.");
+METRIC_DEFINE_histogram(tablet, hibernate_duration,
+                        "Hibernation Duration",
+                        kudu::MetricUnit::kMilliseconds,
+                        "Time spent releasing the memory cached by the replica when it "
+                        "hibernates.", 60000LU, 1);
+
 namespace kudu {
 namespace tablet {
 
@@ -240,5 +267,60 @@ scoped_refptr<AtomicGauge<uint32_t> > LogGCOp::RunningGauge() const {
   return log_gc_running_;
 }
 
+//
+// HibernateOp.
+//
+
+HibernateOp::HibernateOp(TabletPeer* tablet_peer)
+    : MaintenanceOp(StringPrintf("HibernateOp(%s)", tablet_peer->tablet()->tablet_id().c_str()),
+                    MaintenanceOp::LOW_IO_USAGE),
+      tablet_peer_(tablet_peer),
+      hibernate_duration_(METRIC_hibernate_duration.Instantiate(
+                              tablet_peer->tablet()->GetMetricEntity())),
+      hibernate_running_(METRIC_hibernate_running.Instantiate(
+                             tablet_peer->tablet()->GetMetricEntity(), 0)),
+      sem_(1) {}
+
+void HibernateOp::UpdateStats(MaintenanceOpStats* stats) {
+  const int32_t idle_secs = FLAGS_tablet_hibernation_idle_secs;
+  if (idle_secs <= 0 || tablet_peer_->state() != RUNNING || tablet_peer_->hibernated()) {
+    return;
+  }
+  int64_t idle_micros = GetMonoTimeMicros() - tablet_peer_->tablet()->last_access_micros();
+  if (idle_micros < idle_secs * 1000000LL) {
+    return;
+  }
+  if (!FLAGS_tablet_hibernation_include_leaders) {
+    scoped_refptr<consensus::Consensus> consensus = tablet_peer_->shared_consensus();
+    if (!consensus || consensus->role() == consensus::RaftPeerPB::LEADER) {
+      return;
+    }
+  }
+  // Releasing the caches does no I/O, so any small improvement gets the op
+  // scheduled once there is nothing more useful to do.
+  stats->set_perf_improvement(0.01);
+  stats->set_runnable(sem_.GetValue() == 1);
+}
+
+bool HibernateOp::Prepare() {
+  return sem_.try_lock();
+}
+
+void HibernateOp::Perform() {
+  CHECK(!sem_.try_lock());
+
+  tablet_peer_->Hibernate();
+
+  sem_.unlock();
+}
+
+scoped_refptr<Histogram> HibernateOp::DurationHistogram() const {
+  return hibernate_duration_;
+}
+
+scoped_refptr<AtomicGauge<uint32_t> > HibernateOp::RunningGauge() const {
+  return hibernate_running_;
+}
+
 }  // namespace tablet
 }  // namespace kudu
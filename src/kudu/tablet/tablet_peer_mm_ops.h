@@ -127,6 +127,29 @@ class LogGCOp : public MaintenanceOp {
   mutable Semaphore sem_;
 };
 
+// Maintenance task that hibernates the replica once its tablet has been
+// idle for --tablet_hibernation_idle_secs. See TabletPeer::Hibernate().
+class HibernateOp : public MaintenanceOp {
+ public:
+  explicit HibernateOp(TabletPeer* tablet_peer);
+
+  virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
+
+  virtual bool Prepare() OVERRIDE;
+
+  virtual void Perform() OVERRIDE;
+
+  virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE;
+
+  virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
+
+ private:
+  TabletPeer *const tablet_peer_;
+  scoped_refptr<Histogram> hibernate_duration_;
+  scoped_refptr<AtomicGauge<uint32_t> > hibernate_running_;
+  mutable Semaphore sem_;
+};
+
 } // namespace tablet
 } // namespace kudu
 
@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tablet/tablet_quota.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace kudu {
+namespace tablet {
+
+void TabletQuota::Bucket::SetRate(int64_t new_rate, MonoTime now) {
+  if (new_rate > 0 && rate <= 0) {
+    tokens = new_rate;
+    last_refill = now;
+  }
+  rate = std::max<int64_t>(new_rate, 0);
+}
+
+void TabletQuota::Bucket::Refill(MonoTime now) {
+  double elapsed_sec = (now - last_refill).ToSeconds();
+  last_refill = now;
+  tokens = std::min<double>(tokens + elapsed_sec * rate, rate);
+}
+
+bool TabletQuota::Bucket::InDebt(MonoTime now) {
+  if (rate <= 0) {
+    return false;
+  }
+  Refill(now);
+  return tokens <= 0;
+}
+
+TabletQuota::TabletQuota()
+    : limited_(false) {
+}
+
+void TabletQuota::SetLimits(int64_t write_rows_per_sec, int64_t write_bytes_per_sec,
+                            int64_t scan_rows_per_sec, int64_t scan_bytes_per_sec) {
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  write_rows_.SetRate(write_rows_per_sec, now);
+  write_bytes_.SetRate(write_bytes_per_sec, now);
+  scan_rows_.SetRate(scan_rows_per_sec, now);
+  scan_bytes_.SetRate(scan_bytes_per_sec, now);
+  limited_.Store(write_rows_.rate > 0 || write_bytes_.rate > 0 ||
+                 scan_rows_.rate > 0 || scan_bytes_.rate > 0);
+}
+
+bool TabletQuota::AdmitWrite(int64_t bytes) {
+  if (!limited_.Load()) {
+    return true;
+  }
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (write_rows_.InDebt(now) || write_bytes_.InDebt(now)) {
+    return false;
+  }
+  write_bytes_.Charge(bytes);
+  return true;
+}
+
+void TabletQuota::ChargeWriteRows(int64_t rows) {
+  if (!limited_.Load()) {
+    return;
+  }
+  std::lock_guard<simple_spinlock> l(lock_);
+  write_rows_.Charge(rows);
+}
+
+bool TabletQuota::AdmitScan() {
+  if (!limited_.Load()) {
+    return true;
+  }
+  MonoTime now = MonoTime::Now();
+  std::lock_guard<simple_spinlock> l(lock_);
+  return !scan_rows_.InDebt(now) && !scan_bytes_.InDebt(now);
+}
+
+void TabletQuota::ChargeScan(int64_t rows, int64_t bytes) {
+  if (!limited_.Load()) {
+    return;
+  }
+  std::lock_guard<simple_spinlock> l(lock_);
+  scan_rows_.Charge(rows);
+  scan_bytes_.Charge(bytes);
+}
+
+} // namespace tablet
+} // namespace kudu
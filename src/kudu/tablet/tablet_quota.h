@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TABLET_TABLET_QUOTA_H
+#define KUDU_TABLET_TABLET_QUOTA_H
+
+#include <cstdint>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+
+namespace kudu {
+namespace tablet {
+
+// The share of its table's throughput quotas which a tablet enforces, as
+// distributed by the master.
+//
+// Each limit is a token bucket, refilled at the limit's rate and holding up
+// to a second's worth of tokens. Since the rows and bytes a request uses are
+// often only known once it's done, requests are admitted as long as their
+// buckets aren't in debt, and charged afterwards, which may put the buckets
+// into debt.
+//
+// This class is thread-safe.
+class TabletQuota {
+ public:
+  TabletQuota();
+
+  // Sets the limits, per second. 0 means no limit.
+  void SetLimits(int64_t write_rows_per_sec, int64_t write_bytes_per_sec,
+                 int64_t scan_rows_per_sec, int64_t scan_bytes_per_sec);
+
+  // Returns whether a write of 'bytes' bytes is within the quota, in which
+  // case the bytes are charged.
+  bool AdmitWrite(int64_t bytes);
+
+  // Charges 'rows' rows written.
+  void ChargeWriteRows(int64_t rows);
+
+  // Returns whether scanning is within the quota.
+  bool AdmitScan();
+
+  // Charges 'rows' rows and 'bytes' bytes returned by a scan.
+  void ChargeScan(int64_t rows, int64_t bytes);
+
+ private:
+  struct Bucket {
+    Bucket() : rate(0), tokens(0) {}
+
+    // Sets the rate, starting with a full bucket if it wasn't limited.
+    void SetRate(int64_t new_rate, MonoTime now);
+
+    // Adds the tokens accrued since the last refill.
+    void Refill(MonoTime now);
+
+    // Whether the bucket is limited and in debt.
+    bool InDebt(MonoTime now);
+
+    void Charge(int64_t n) {
+      if (rate > 0) {
+        tokens -= n;
+      }
+    }
+
+    int64_t rate;
+    double tokens;
+    MonoTime last_refill;
+  };
+
+  // Whether any limit is set, so that unlimited tablets don't take the lock.
+  AtomicBool limited_;
+
+  simple_spinlock lock_;
+  Bucket write_rows_;
+  Bucket write_bytes_;
+  Bucket scan_rows_;
+  Bucket scan_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(TabletQuota);
+};
+
+} // namespace tablet
+} // namespace kudu
+
+#endif /* KUDU_TABLET_TABLET_QUOTA_H */
@@ -74,7 +74,13 @@ TransactionMetrics::TransactionMetrics()
     successful_upserts(0),
     successful_updates(0),
     successful_deletes(0),
-    commit_wait_duration_usec(0) {
+    commit_wait_duration_usec(0),
+    decode_duration_usec(0),
+    row_lock_duration_usec(0),
+    replication_duration_usec(0),
+    apply_duration_usec(0),
+    key_probe_duration_nanos(0),
+    cpu_time_usec(0) {
 }
 
 void TransactionMetrics::Reset() {
@@ -82,6 +88,12 @@ void TransactionMetrics::Reset() {
   successful_updates = 0;
   successful_deletes = 0;
   commit_wait_duration_usec = 0;
+  decode_duration_usec = 0;
+  row_lock_duration_usec = 0;
+  replication_duration_usec = 0;
+  apply_duration_usec = 0;
+  key_probe_duration_nanos = 0;
+  cpu_time_usec = 0;
 }
 
 
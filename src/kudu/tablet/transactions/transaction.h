@@ -50,6 +50,17 @@ struct TransactionMetrics {
   int successful_updates;
   int successful_deletes;
   uint64_t commit_wait_duration_usec;
+
+  // The time spent in each stage of a write.
+  uint64_t decode_duration_usec;
+  uint64_t row_lock_duration_usec;
+  uint64_t replication_duration_usec;
+  uint64_t apply_duration_usec;
+  // Accumulated over the rows of a write, so kept at a finer grain.
+  int64_t key_probe_duration_nanos;
+  // The CPU time spent decoding, preparing and applying a write, on
+  // whichever threads did so.
+  int64_t cpu_time_usec;
 };
 
 // Base class for transactions.
@@ -90,6 +101,16 @@ class Transaction {
   // Builds the ReplicateMsg for this transaction.
   virtual void NewReplicateMsg(gscoped_ptr<consensus::ReplicateMsg>* replicate_msg) = 0;
 
+  // Does the parts of the prepare phase which don't depend on the order of
+  // transactions, such as decoding the request, ahead of Prepare().
+  //
+  // Unlike Prepare(), this may run concurrently with the Decode() and
+  // Prepare() of other transactions on the same tablet, so it must not take
+  // locks which order transactions. Its work is speculative: anything it
+  // can't do, or which is invalidated before Prepare() runs, is left to (or
+  // redone by) Prepare(), which reports any errors.
+  virtual void Decode() {}
+
   // Executes the prepare phase of this transaction, the actual actions
   // of this phase depend on the transaction type, but usually are limited
   // to what can be done without actually changing data structures and without
@@ -86,19 +86,24 @@ TransactionDriver::TransactionDriver(TransactionTracker *txn_tracker,
                                      Consensus* consensus,
                                      Log* log,
                                      ThreadPool* prepare_pool,
-                                     ThreadPool* apply_pool,
+                                     ThreadPool* decode_pool,
+                                     ThreadPoolToken* apply_pool_token,
                                      TransactionOrderVerifier* order_verifier)
     : txn_tracker_(txn_tracker),
       consensus_(consensus),
       log_(log),
       prepare_pool_(prepare_pool),
-      apply_pool_(apply_pool),
+      decode_pool_(decode_pool),
+      apply_pool_token_(apply_pool_token),
       order_verifier_(order_verifier),
       trace_(new Trace()),
+      decode_latch_(0),
       start_time_(MonoTime::Now()),
       replication_state_(NOT_REPLICATING),
       prepare_state_(NOT_PREPARED) {
   if (Trace::CurrentTrace()) {
+    // The transaction is traced only if the request which started it is.
+    trace_->set_sampled(Trace::CurrentTrace()->sampled());
     Trace::CurrentTrace()->AddChildTrace("txn", trace_.get());
   }
 }
@@ -192,6 +197,15 @@ Status TransactionDriver::ExecuteAsync() {
     s = consensus_->CheckLeadershipAndBindTerm(mutable_state()->consensus_round());
   }
 
+  if (s.ok() && decode_pool_ && transaction_->tx_type() == Transaction::WRITE_TXN) {
+    decode_latch_.Reset(1);
+    if (!decode_pool_->SubmitClosure(
+            Bind(&TransactionDriver::DecodeTask, Unretained(this))).ok()) {
+      // Prepare() will do all of the work itself.
+      decode_latch_.CountDown();
+    }
+  }
+
   if (s.ok()) {
     s = prepare_pool_->SubmitClosure(
       Bind(&TransactionDriver::PrepareTask, Unretained(this)));
@@ -205,6 +219,12 @@ Status TransactionDriver::ExecuteAsync() {
   return Status::OK();
 }
 
+void TransactionDriver::DecodeTask() {
+  TRACE_EVENT0("txn", "DecodeTask");
+  transaction_->Decode();
+  decode_latch_.CountDown();
+}
+
 void TransactionDriver::PrepareTask() {
   TRACE_EVENT_FLOW_END0("txn", "PrepareTask", this);
   Status prepare_status = Prepare();
@@ -245,6 +265,9 @@ Status TransactionDriver::Prepare() {
   TRACE_EVENT1("txn", "Prepare", "txn", this);
   VLOG_WITH_PREFIX(4) << "Prepare()";
 
+  // Wait for the transaction's Decode(), if it was submitted.
+  decode_latch_.Wait();
+
   // Actually prepare and start the transaction.
   prepare_physical_timestamp_ = GetMonoTimeMicros();
 
@@ -331,6 +354,9 @@ void TransactionDriver::HandleFailure(const Status& s) {
   CHECK(!s.ok());
   TRACE("HandleFailure($0)", s.ToString());
 
+  // Don't tear the transaction down while DecodeTask() may be using it.
+  decode_latch_.Wait();
+
   ReplicationState repl_state_copy;
 
   {
@@ -399,6 +425,8 @@ void TransactionDriver::ReplicationFinished(const Status& status) {
   }
 
   TRACE_COUNTER_INCREMENT("replication_time_us", replication_duration.ToMicroseconds());
+  mutable_state()->mutable_metrics()->replication_duration_usec =
+      replication_duration.ToMicroseconds();
 
   // If we have prepared and replicated, we're ready
   // to move ahead and apply this operation.
@@ -455,7 +483,7 @@ Status TransactionDriver::ApplyAsync() {
   }
 
   TRACE_EVENT_FLOW_BEGIN0("txn", "ApplyTask", this);
-  return apply_pool_->SubmitClosure(Bind(&TransactionDriver::ApplyTask, Unretained(this)));
+  return apply_pool_token_->SubmitClosure(Bind(&TransactionDriver::ApplyTask, Unretained(this)));
 }
 
 void TransactionDriver::ApplyTask() {
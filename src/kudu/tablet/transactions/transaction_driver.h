@@ -26,11 +26,13 @@
 #include "kudu/gutil/walltime.h"
 #include "kudu/server/clock.h"
 #include "kudu/tablet/transactions/transaction.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/status.h"
 #include "kudu/util/trace.h"
 
 namespace kudu {
 class ThreadPool;
+class ThreadPoolToken;
 
 namespace log {
 class Log;
@@ -57,7 +59,11 @@ class TransactionTracker;
 //      been serialized by the leader, so we also call transaction_->Start().
 //
 //  2 - ExecuteAsync() is called. This submits PrepareTask() to prepare_pool_
-//      and returns immediately.
+//      and returns immediately. If there is a decode_pool_, it first submits
+//      DecodeTask() to it, which calls Decode() on the transaction so that the
+//      order-independent part of its preparation can run concurrently with the
+//      preparation of the transactions ahead of it; PrepareTask() waits for
+//      DecodeTask() to finish before calling Prepare().
 //
 //  3 - PrepareTask() calls Prepare() on the transaction.
 //
@@ -79,7 +85,8 @@ class TransactionTracker;
 //
 //      If Prepare() has already completed, then we trigger ApplyAsync().
 //
-//  5 - ApplyAsync() submits ApplyTask() to the apply_pool_.
+//  5 - ApplyAsync() submits ApplyTask() to the apply_pool_token_, which runs
+//      the tablet's apply tasks one at a time, in order, on the shared apply pool.
 //      ApplyTask() calls transaction_->Apply().
 //
 //      When Apply() is called, changes are made to the in-memory data structures. These
@@ -223,7 +230,8 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
                     consensus::Consensus* consensus,
                     log::Log* log,
                     ThreadPool* prepare_pool,
-                    ThreadPool* apply_pool,
+                    ThreadPool* decode_pool,
+                    ThreadPoolToken* apply_pool_token,
                     TransactionOrderVerifier* order_verifier);
 
   // Perform any non-constructor initialization. Sets the transaction
@@ -297,6 +305,9 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
 
   ~TransactionDriver() {}
 
+  // The task submitted to the decode threadpool to call Decode() on the transaction.
+  void DecodeTask();
+
   // The task submitted to the prepare threadpool to prepare the transaction. If Prepare() fails,
   // calls HandleFailure.
   void PrepareTask();
@@ -346,7 +357,8 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   consensus::Consensus* const consensus_;
   log::Log* const log_;
   ThreadPool* const prepare_pool_;
-  ThreadPool* const apply_pool_;
+  ThreadPool* const decode_pool_;
+  ThreadPoolToken* const apply_pool_token_;
   TransactionOrderVerifier* const order_verifier_;
 
   Status transaction_status_;
@@ -372,6 +384,9 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   // Trace object for tracing any transactions started by this driver.
   scoped_refptr<Trace> trace_;
 
+  // Counted down when DecodeTask() finishes, or immediately if there is none.
+  CountDownLatch decode_latch_;
+
   const MonoTime start_time_;
   MonoTime replication_start_time_;
 
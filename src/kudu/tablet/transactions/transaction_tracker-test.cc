@@ -94,6 +94,7 @@ class TransactionTrackerTest : public KuduTest {
                                 nullptr,
                                 nullptr,
                                 nullptr,
+                                nullptr,
                                 nullptr));
       gscoped_ptr<NoOpTransaction> tx(new NoOpTransaction(new NoOpTransactionState));
       RETURN_NOT_OK(driver->Init(tx.PassAs<Transaction>(), consensus::LEADER));
@@ -27,6 +27,7 @@
 #include "kudu/gutil/walltime.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/server/hybrid_clock.h"
+#include "kudu/tablet/row_cache.h"
 #include "kudu/tablet/row_op.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet_peer.h"
@@ -35,6 +36,7 @@
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/trace.h"
 
 DEFINE_int32(tablet_inject_latency_on_apply_write_txn_ms, 0,
@@ -58,7 +60,8 @@ using strings::Substitute;
 
 WriteTransaction::WriteTransaction(unique_ptr<WriteTransactionState> state, DriverType type)
   : Transaction(state.get(), type, Transaction::WRITE_TXN),
-  state_(std::move(state)) {
+  state_(std::move(state)),
+  decoded_(false) {
   start_time_ = MonoTime::Now();
 }
 
@@ -71,9 +74,55 @@ void WriteTransaction::NewReplicateMsg(gscoped_ptr<ReplicateMsg>* replicate_msg)
   }
 }
 
+void WriteTransaction::Decode() {
+  TRACE_EVENT0("txn", "WriteTransaction::Decode");
+  Schema client_schema;
+  if (!SchemaFromPB(state_->request()->schema(), &client_schema).ok() ||
+      client_schema.has_column_ids()) {
+    // Leave it to Prepare() to report the error.
+    return;
+  }
+
+  Tablet* tablet = state()->tablet_peer()->tablet();
+  MonoTime start = MonoTime::Now();
+  MicrosecondsInt64 cpu_start_us = GetThreadCpuTimeMicros();
+  Status s = tablet->DecodeWriteOperationsUnlocked(&client_schema, state());
+  if (s.ok()) {
+    s = tablet->DecodeRowKeys(state());
+  }
+  if (!s.ok()) {
+    state()->ClearRowOps();
+    return;
+  }
+  state()->mutable_metrics()->decode_duration_usec =
+      (MonoTime::Now() - start).ToMicroseconds();
+  state()->mutable_metrics()->cpu_time_usec += GetThreadCpuTimeMicros() - cpu_start_us;
+  decoded_ = true;
+  TRACE("DECODE: finished.");
+}
+
 Status WriteTransaction::Prepare() {
   TRACE_EVENT0("txn", "WriteTransaction::Prepare");
   TRACE("PREPARE: Starting");
+  Tablet* tablet = state()->tablet_peer()->tablet();
+  MicrosecondsInt64 cpu_start_us = GetThreadCpuTimeMicros();
+  auto count_cpu = MakeScopedCleanup([&]() {
+    state()->mutable_metrics()->cpu_time_usec += GetThreadCpuTimeMicros() - cpu_start_us;
+  });
+
+  if (decoded_) {
+    if (tablet->LockSchemaForDecodedOperations(state())) {
+      TRACE("PREPARE: Operations already decoded");
+      RETURN_NOT_OK(AcquireRowLocks(tablet));
+      TRACE("PREPARE: finished.");
+      return Status::OK();
+    }
+    // The schema changed after Decode() ran.
+    TRACE("PREPARE: Schema changed since decoding");
+    state()->ClearRowOps();
+    decoded_ = false;
+  }
+
   // Decode everything first so that we give up if something major is wrong.
   Schema client_schema;
   RETURN_NOT_OK_PREPEND(SchemaFromPB(state_->request()->schema(), &client_schema),
@@ -86,22 +135,31 @@ Status WriteTransaction::Prepare() {
     return s;
   }
 
-  Tablet* tablet = state()->tablet_peer()->tablet();
-
+  MonoTime decode_start = MonoTime::Now();
   Status s = tablet->DecodeWriteOperations(&client_schema, state());
   if (!s.ok()) {
     // TODO: is MISMATCHED_SCHEMA always right here? probably not.
     state()->completion_callback()->set_error(s, TabletServerErrorPB::MISMATCHED_SCHEMA);
     return s;
   }
+  state()->mutable_metrics()->decode_duration_usec =
+      (MonoTime::Now() - decode_start).ToMicroseconds();
 
   // Now acquire row locks and prepare everything for apply
-  RETURN_NOT_OK(tablet->AcquireRowLocks(state()));
+  RETURN_NOT_OK(AcquireRowLocks(tablet));
 
   TRACE("PREPARE: finished.");
   return Status::OK();
 }
 
+Status WriteTransaction::AcquireRowLocks(Tablet* tablet) {
+  MonoTime start = MonoTime::Now();
+  RETURN_NOT_OK(tablet->AcquireRowLocks(state()));
+  state()->mutable_metrics()->row_lock_duration_usec =
+      (MonoTime::Now() - start).ToMicroseconds();
+  return Status::OK();
+}
+
 void WriteTransaction::AbortPrepare() {
   state()->ReleaseMvccTxn(TransactionResult::ABORTED);
 }
@@ -132,7 +190,12 @@ Status WriteTransaction::Apply(gscoped_ptr<CommitMsg>* commit_msg) {
 
   Tablet* tablet = state()->tablet_peer()->tablet();
 
+  MonoTime apply_start = MonoTime::Now();
+  MicrosecondsInt64 cpu_start_us = GetThreadCpuTimeMicros();
   tablet->ApplyRowOperations(state());
+  state()->mutable_metrics()->apply_duration_usec =
+      (MonoTime::Now() - apply_start).ToMicroseconds();
+  state()->mutable_metrics()->cpu_time_usec += GetThreadCpuTimeMicros() - cpu_start_us;
 
   // Add per-row errors to the result, update metrics.
   int i = 0;
@@ -180,7 +243,15 @@ void WriteTransaction::Finish(TransactionResult result) {
     metrics->rows_updated->IncrementBy(state_->metrics().successful_updates);
     metrics->rows_deleted->IncrementBy(state_->metrics().successful_deletes);
 
+    const TransactionMetrics& tx_metrics = state_->metrics();
+    metrics->write_decode_duration->Increment(tx_metrics.decode_duration_usec);
+    metrics->write_row_lock_duration->Increment(tx_metrics.row_lock_duration_usec);
+    metrics->write_key_probe_duration->Increment(tx_metrics.key_probe_duration_nanos / 1000);
+    metrics->write_apply_duration->Increment(tx_metrics.apply_duration_usec);
+    metrics->write_cpu_time->IncrementBy(tx_metrics.cpu_time_usec);
+
     if (type() == consensus::LEADER) {
+      metrics->write_replication_duration->Increment(tx_metrics.replication_duration_usec);
       if (state()->external_consistency_mode() == COMMIT_WAIT) {
         metrics->commit_wait_duration->Increment(state_->metrics().commit_wait_duration_usec);
       }
@@ -218,6 +289,7 @@ WriteTransactionState::WriteTransactionState(TabletPeer* tablet_peer,
     request_(DCHECK_NOTNULL(request)),
     response_(response),
     mvcc_tx_(nullptr),
+    row_cache_(nullptr),
     schema_at_decode_time_(nullptr) {
   external_consistency_mode_ = request_->external_consistency_mode();
   if (!response_) {
@@ -247,6 +319,12 @@ void WriteTransactionState::AcquireSchemaLock(rw_semaphore* schema_lock) {
   TRACE("Acquired schema lock");
 }
 
+void WriteTransactionState::ClearRowOps() {
+  std::lock_guard<simple_spinlock> l(txn_state_lock_);
+  STLDeleteElements(&row_ops_);
+  schema_at_decode_time_ = nullptr;
+}
+
 void WriteTransactionState::ReleaseSchemaLock() {
   shared_lock<rw_semaphore> temp;
   schema_lock_.swap(temp);
@@ -283,6 +361,15 @@ void WriteTransactionState::ReleaseMvccTxn(Transaction::TransactionResult result
     }
   }
   mvcc_tx_.reset();
+
+  if (row_cache_ != nullptr) {
+    for (const RowOp* op : row_ops_) {
+      if (op->key_probe) {
+        row_cache_->FinishWrite(op->key_probe->encoded_key_slice());
+      }
+    }
+    row_cache_ = nullptr;
+  }
 }
 
 void WriteTransactionState::ReleaseTxResultPB(TxResultPB* result) const {
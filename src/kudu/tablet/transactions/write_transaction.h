@@ -45,8 +45,10 @@ class WriteResponsePB;
 }
 
 namespace tablet {
+class RowCache;
 struct RowOp;
 class RowSetKeyProbe;
+class Tablet;
 struct TabletComponents;
 
 // A TransactionState for a batch of inserts/mutates. This class holds and
@@ -119,8 +121,16 @@ class WriteTransactionState : public TransactionState {
   // Release the already-acquired schema lock.
   void ReleaseSchemaLock();
 
+  // Commits or aborts the MVCC transaction, and then releases the keys of
+  // the row operations in the row cache, if they were marked.
   void ReleaseMvccTxn(Transaction::TransactionResult result);
 
+  // Sets the row cache in which the tablet marked the keys of the row
+  // operations before applying them. See RowCache::StartWrite().
+  void set_row_cache(RowCache* row_cache) {
+    row_cache_ = row_cache;
+  }
+
   void set_schema_at_decode_time(const Schema* schema) {
     std::lock_guard<simple_spinlock> l(txn_state_lock_);
     schema_at_decode_time_ = schema;
@@ -163,6 +173,10 @@ class WriteTransactionState : public TransactionState {
     row_ops_.swap(*new_ops);
   }
 
+  // Destroys the decoded row operations, so that the request may be decoded
+  // again. Requires that no row locks have been acquired.
+  void ClearRowOps();
+
   void UpdateMetricsForOp(const RowOp& op);
 
   // Resets this TransactionState, releasing all locks, destroying all prepared
@@ -197,6 +211,9 @@ class WriteTransactionState : public TransactionState {
   // The MVCC transaction, set up during PREPARE phase
   gscoped_ptr<ScopedTransaction> mvcc_tx_;
 
+  // The row cache in which the keys of 'row_ops_' are marked, if any.
+  RowCache* row_cache_;
+
   // The tablet components, acquired at the same time as mvcc_tx_ is set.
   scoped_refptr<const TabletComponents> tablet_components_;
 
@@ -223,11 +240,16 @@ class WriteTransaction : public Transaction {
 
   void NewReplicateMsg(gscoped_ptr<consensus::ReplicateMsg>* replicate_msg) OVERRIDE;
 
+  // Decodes the operations in the request PB and their row keys against the
+  // tablet's current schema, without taking the schema lock.
+  virtual void Decode() OVERRIDE;
+
   // Executes a Prepare for a write transaction
   //
-  // Decodes the operations in the request PB and acquires row locks for each of the
-  // affected rows. This results in adding 'RowOp' objects for each of the operations
-  // into the WriteTransactionState.
+  // Decodes the operations in the request PB, unless Decode() already did so
+  // against the schema which is current once the schema lock is acquired, and
+  // acquires row locks for each of the affected rows. This results in adding
+  // 'RowOp' objects for each of the operations into the WriteTransactionState.
   virtual Status Prepare() OVERRIDE;
 
   virtual void AbortPrepare() OVERRIDE;
@@ -262,11 +284,17 @@ class WriteTransaction : public Transaction {
   virtual std::string ToString() const OVERRIDE;
 
  private:
+  // Acquires the row locks of the operations, timing the wait.
+  Status AcquireRowLocks(Tablet* tablet);
+
   // this transaction's start time
   MonoTime start_time_;
 
   std::unique_ptr<WriteTransactionState> state_;
 
+  // Whether Decode() successfully decoded the row operations.
+  bool decoded_;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(WriteTransaction);
 };
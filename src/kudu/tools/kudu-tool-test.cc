@@ -35,6 +35,7 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/common/wire_protocol-test-util.h"
 #include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/metadata.pb.h"
@@ -54,6 +55,7 @@
 #include "kudu/integration-tests/test_workload.h"
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/tablet-harness.h"
+#include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/tablet.h"
@@ -66,6 +68,7 @@
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/async_util.h"
 #include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/oid_generator.h"
@@ -83,6 +86,7 @@ using cfile::CFileWriter;
 using cfile::StringDataGenerator;
 using cfile::WriterOptions;
 using client::sp::shared_ptr;
+using consensus::ConsensusMetadata;
 using consensus::OpId;
 using consensus::ReplicateRefPtr;
 using consensus::ReplicateMsg;
@@ -298,6 +302,7 @@ TEST_F(ToolTest, TestModeHelp) {
   {
     const vector<string> kLocalReplicaModeRegexes = {
         "cmeta.*Operate on a local tablet replica's consensus",
+        "compact.*Compact the delta stores and merge the rowsets",
         "dump.*Dump a Kudu filesystem",
         "copy_from_remote.*Copy a tablet replica",
         "delete.*Delete a tablet replica from the local filesystem",
@@ -365,8 +370,10 @@ TEST_F(ToolTest, TestModeHelp) {
   }
   {
     const vector<string> kTableModeRegexes = {
+        "copy.*Copy the rows of a table into another table",
         "delete.*Delete a table",
         "list.*List all tables",
+        "scan.*Scan the rows of a table",
     };
     NO_FATALS(RunTestHelp("table", kTableModeRegexes));
   }
@@ -849,6 +856,75 @@ TEST_F(ToolTest, TestLocalReplicaOps) {
   }
 }
 
+TEST_F(ToolTest, TestLocalReplicaCompact) {
+  const string kTestDir = GetTestPath("test");
+  const string kTestTablet = "test-tablet";
+  const int kNumRowSets = 3;
+  const int kRowsPerRowSet = 10;
+  const Schema kSchema(GetSimpleTestSchema());
+  const Schema kSchemaWithIds(SchemaBuilder(kSchema).Build());
+
+  TabletHarness::Options opts(kTestDir);
+  opts.tablet_id = kTestTablet;
+  {
+    TabletHarness harness(kSchemaWithIds, opts);
+    ASSERT_OK(harness.Create(true));
+    ASSERT_OK(harness.Open());
+
+    // The tool bootstraps the tablet, which requires consensus metadata.
+    FsManager* fs = harness.fs_manager();
+    consensus::RaftConfigPB config;
+    config.set_opid_index(consensus::kInvalidOpIdIndex);
+    consensus::RaftPeerPB* peer = config.add_peers();
+    peer->set_permanent_uuid(fs->uuid());
+    peer->set_member_type(consensus::RaftPeerPB::VOTER);
+    unique_ptr<ConsensusMetadata> cmeta;
+    ASSERT_OK(ConsensusMetadata::Create(fs, kTestTablet, fs->uuid(), config,
+                                        consensus::kMinimumTerm, &cmeta));
+
+    // Write overlapping rowsets, and updates to them.
+    LocalTabletWriter writer(harness.tablet().get(), &kSchema);
+    KuduPartialRow row(&kSchemaWithIds);
+    for (int rs = 0; rs < kNumRowSets; rs++) {
+      for (int i = 0; i < kRowsPerRowSet; i++) {
+        ASSERT_OK(row.SetInt32(0, i * kNumRowSets + rs));
+        ASSERT_OK(row.SetInt32(1, i));
+        ASSERT_OK(row.SetStringCopy(2, "HelloWorld"));
+        ASSERT_OK(writer.Insert(row));
+      }
+      ASSERT_OK(harness.tablet()->Flush());
+    }
+    for (int i = 0; i < kRowsPerRowSet * kNumRowSets; i += 2) {
+      ASSERT_OK(row.SetInt32(0, i));
+      ASSERT_OK(row.SetInt32(1, -i));
+      ASSERT_OK(writer.Update(row));
+    }
+    ASSERT_OK(harness.tablet()->FlushBiggestDMS());
+    ASSERT_EQ(kNumRowSets, harness.tablet()->num_rowsets());
+    harness.tablet()->Shutdown();
+  }
+
+  string stdout;
+  NO_FATALS(RunActionStdoutString(
+      Substitute("local_replica compact $0 --fs_wal_dir=$1 --fs_data_dirs=$1 "
+                 "--compact_threads=2", kTestTablet, kTestDir), &stdout));
+  SCOPED_TRACE(stdout);
+  ASSERT_STR_CONTAINS(stdout, Substitute("$0 rowsets before, 1 after", kNumRowSets));
+
+  // All the rows and updates survive in the single merged rowset.
+  TabletHarness harness(kSchemaWithIds, opts);
+  ASSERT_OK(harness.Create(false));
+  ASSERT_OK(harness.Open());
+  ASSERT_EQ(1, harness.tablet()->num_rowsets());
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(harness.tablet()->NewRowIterator(kSchema, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  vector<string> rows;
+  ASSERT_OK(tablet::IterateToStringList(iter.get(), &rows));
+  ASSERT_EQ(kRowsPerRowSet * kNumRowSets, rows.size());
+  ASSERT_STR_CONTAINS(rows[2], "int32 int_val=-2");
+}
+
 // Create and start Kudu mini cluster, optionally creating a table in the DB,
 // and then run 'kudu test loadgen ...' utility against it.
 void ToolTest::RunLoadgen(int num_tservers,
@@ -949,6 +1025,78 @@ TEST_F(ToolTest, TestLoadgenManualFlush) {
       "bench_manual_flush"));
 }
 
+// Run the loadgen benchmark with a mixed workload against the inserted rows,
+// over the table with columns of all types.
+TEST_F(ToolTest, TestLoadgenMixedWorkload) {
+  NO_FATALS(RunLoadgen(3,
+      {
+        "--num_rows_per_thread=1024",
+        "--num_threads=2",
+        "--run_scan",
+        "--show_first_n_errors=3",
+        "--string_len=16",
+        "--workload_key_distribution=zipfian",
+        "--workload_mix=read:40,scan:10,update:25,upsert:15,delete:10",
+        "--workload_ops_per_thread=256",
+        "--workload_scan_length=16",
+      },
+      "bench_mixed_workload"));
+}
+
+// Test 'kudu table copy' into a resharded table, and 'kudu table scan' exporting
+// the copied rows to files.
+TEST_F(ToolTest, TestTableCopyAndScan) {
+  NO_FATALS(StartExternalMiniCluster());
+  TestWorkload workload(cluster_.get());
+  workload.set_num_replicas(1);
+  workload.Setup();
+  workload.Start();
+  while (workload.rows_inserted() < 1000) {
+    SleepFor(MonoDelta::FromMilliseconds(10));
+  }
+  workload.StopAndJoin();
+  const string master_addr = cluster_->master()->bound_rpc_addr().ToString();
+
+  // The output is of the form "Scanned 1 tokens: 1234 rows in ...".
+  string stdout;
+  NO_FATALS(RunActionStdoutString(
+      Substitute("table scan $0 $1", master_addr, TestWorkload::kDefaultTableName),
+      &stdout));
+  vector<string> words = strings::Split(stdout, " ");
+  ASSERT_GE(words.size(), 4);
+  const string num_rows = words[3];
+
+  NO_FATALS(RunActionStdoutString(
+      Substitute("table copy $0 $1 copied_table --dst_table_num_buckets=3 "
+                 "--dst_table_num_replicas=1 --scan_threads=2 --write_threads=2",
+                 master_addr, TestWorkload::kDefaultTableName),
+      &stdout));
+  ASSERT_STR_CONTAINS(stdout, Substitute("Wrote $0 rows", num_rows));
+
+  const string output_dir = GetTestPath("export");
+  NO_FATALS(RunActionStdoutString(
+      Substitute("table scan $0 copied_table --output_dir=$1", master_addr, output_dir),
+      &stdout));
+  ASSERT_STR_CONTAINS(stdout, Substitute("Scanned 3 tokens: $0 rows", num_rows));
+
+  // There is a file per token, with a line per row.
+  vector<string> children;
+  ASSERT_OK(env_->GetChildren(output_dir, &children));
+  int64_t num_lines = 0;
+  int num_files = 0;
+  for (const string& child : children) {
+    if (child == "." || child == "..") {
+      continue;
+    }
+    faststring contents;
+    ASSERT_OK(ReadFileToString(env_, JoinPathSegments(output_dir, child), &contents));
+    num_lines += std::count(contents.data(), contents.data() + contents.size(), '\n');
+    num_files++;
+  }
+  ASSERT_EQ(3, num_files);
+  ASSERT_EQ(num_rows, std::to_string(num_lines));
+}
+
 // Test 'kudu remote_replica copy' tool when the destination tablet server is online.
 // 1. Test the copy tool when the destination replica is healthy
 // 2. Test the copy tool when the destination replica is tombstoned
@@ -20,6 +20,7 @@
 #include <iostream>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 
@@ -33,6 +34,8 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/log.h"
+#include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/log_index.h"
 #include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/log_util.h"
@@ -46,13 +49,18 @@
 #include "kudu/gutil/strings/stringpiece.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/master/sys_catalog.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/rpc/result_tracker.h"
+#include "kudu/server/logical_clock.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/tablet/deltafile.h"
 #include "kudu/tablet/metadata.pb.h"
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_bootstrap.h"
+#include "kudu/tablet/tablet_peer.h"
 #include "kudu/tools/tool_action_common.h"
 #include "kudu/tserver/tablet_copy_client.h"
 #include "kudu/tserver/ts_tablet_manager.h"
@@ -66,6 +74,7 @@
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_bool(dump_data, false,
             "Dump the data for each column in the rowset.");
@@ -82,6 +91,12 @@ DEFINE_bool(clean_unsafe, false,
             "This is not guaranteed to be safe because it also removes the "
             "consensus metadata (including Raft voting record) for the "
             "specified tablet, which violates the Raft vote durability requirements.");
+DEFINE_int32(compact_threads, 0,
+             "Number of threads running delta compactions on the rowsets of the "
+             "replica at once. If 0, the number of cores is used.");
+DEFINE_bool(compact_merge_rowsets, true,
+            "Whether to merge all the rowsets of the replica into new rowsets once "
+            "their delta stores are compacted.");
 
 namespace kudu {
 namespace tools {
@@ -118,9 +133,12 @@ using tablet::DeltaIterator;
 using tablet::DeltaKeyAndUpdate;
 using tablet::DeltaType;
 using tablet::MvccSnapshot;
+using tablet::RowSet;
 using tablet::RowSetMetadata;
+using tablet::Tablet;
 using tablet::TabletMetadata;
 using tablet::TabletDataState;
+using tablet::TabletStatusListener;
 using tserver::TabletCopyClient;
 using tserver::TSTabletManager;
 
@@ -329,6 +347,107 @@ Status DeleteLocalReplica(const RunnerContext& context) {
   return Status::OK();
 }
 
+// Logs the progress of the tablet bootstrap.
+class LoggingStatusListener : public TabletStatusListener {
+ public:
+  void StatusMessage(const string& status) override {
+    LOG(INFO) << status;
+  }
+};
+
+// Runs major delta compactions on the rowsets of 'tablet' until none of
+// them has REDO deltas left to compact. May be called from several threads
+// at once, since each compaction locks the rowset it picks.
+Status CompactAllDeltaStores(Tablet* tablet) {
+  while (tablet->GetPerfImprovementForBestDeltaCompact(RowSet::MAJOR_DELTA_COMPACTION,
+                                                       nullptr) > 0) {
+    RETURN_NOT_OK(tablet->CompactWorstDeltas(RowSet::MAJOR_DELTA_COMPACTION));
+  }
+  return Status::OK();
+}
+
+// Flushes the in-memory stores of 'tablet', compacts the delta stores of its
+// rowsets on --compact_threads threads, then merges its rowsets.
+Status CompactTablet(Tablet* tablet) {
+  const size_t rowsets_before = tablet->num_rowsets();
+
+  LOG_TIMING(INFO, "flushing in-memory stores") {
+    RETURN_NOT_OK(tablet->Flush());
+    while (!tablet->DeltaMemRowSetEmpty()) {
+      RETURN_NOT_OK(tablet->FlushBiggestDMS());
+    }
+  }
+
+  LOG_TIMING(INFO, "compacting delta stores") {
+    int num_threads = FLAGS_compact_threads > 0 ? FLAGS_compact_threads : base::NumCPUs();
+    std::mutex lock;
+    Status first_error;
+    gscoped_ptr<ThreadPool> pool;
+    RETURN_NOT_OK(ThreadPoolBuilder("compact")
+                  .set_max_threads(num_threads)
+                  .Build(&pool));
+    for (int i = 0; i < num_threads; i++) {
+      RETURN_NOT_OK(pool->SubmitFunc([&]() {
+          Status s = CompactAllDeltaStores(tablet);
+          std::lock_guard<std::mutex> l(lock);
+          if (first_error.ok()) {
+            first_error = s;
+          }
+        }));
+    }
+    pool->Wait();
+    RETURN_NOT_OK_PREPEND(first_error, "failed to compact delta stores");
+  }
+
+  if (FLAGS_compact_merge_rowsets) {
+    LOG_TIMING(INFO, "merging rowsets") {
+      RETURN_NOT_OK_PREPEND(tablet->Compact(Tablet::FORCE_COMPACT_ALL),
+                            "failed to merge rowsets");
+    }
+  }
+
+  cout << Substitute("Compacted tablet $0: $1 rowsets before, $2 after",
+                     tablet->tablet_id(), rowsets_before, tablet->num_rowsets()) << endl;
+  return Status::OK();
+}
+
+Status CompactLocalReplica(const RunnerContext& context) {
+  const string& tablet_id = FindOrDie(context.required_args, kTabletIdArg);
+  FsManager fs_manager(Env::Default(), FsManagerOpts());
+  RETURN_NOT_OK(fs_manager.Open());
+  scoped_refptr<TabletMetadata> meta;
+  RETURN_NOT_OK(TabletMetadata::Load(&fs_manager, tablet_id, &meta));
+  if (meta->tablet_data_state() != TabletDataState::TABLET_DATA_READY) {
+    return Status::IllegalState(Substitute("Tablet $0 is in state $1", tablet_id,
+                                           TabletDataState_Name(meta->tablet_data_state())));
+  }
+
+  // Bootstrap the tablet, as the tablet server would, so that the rows and
+  // mutations which are only in the WAL are replayed, and are flushed and
+  // compacted along with the rest. The clock has no physical component, so
+  // the compactions keep all history.
+  scoped_refptr<server::Clock> clock(
+      server::LogicalClock::CreateStartingAt(Timestamp::kInitialTimestamp));
+  RETURN_NOT_OK(clock->Init());
+  MetricRegistry metric_registry;
+  LoggingStatusListener listener;
+  scoped_refptr<log::LogAnchorRegistry> log_anchor_registry(new log::LogAnchorRegistry());
+  shared_ptr<Tablet> tablet;
+  scoped_refptr<log::Log> log;
+  consensus::ConsensusBootstrapInfo consensus_info;
+  RETURN_NOT_OK_PREPEND(tablet::BootstrapTablet(meta, clock, MemTracker::GetRootTracker(),
+                                                scoped_refptr<rpc::ResultTracker>(),
+                                                &metric_registry, &listener, &tablet, &log,
+                                                log_anchor_registry, &consensus_info),
+                        "Failed to bootstrap tablet");
+  tablet->MarkFinishedBootstrapping();
+
+  Status s = CompactTablet(tablet.get());
+  tablet->Shutdown();
+  RETURN_NOT_OK(log->Close());
+  return s;
+}
+
 Status DumpWals(const RunnerContext& context) {
   unique_ptr<FsManager> fs_manager;
   RETURN_NOT_OK(FsInit(&fs_manager));
@@ -766,6 +885,17 @@ unique_ptr<Mode> BuildLocalReplicaMode() {
       .AddAction(std::move(rewrite_raft_config))
       .Build();
 
+  unique_ptr<Action> compact =
+      ActionBuilder("compact", &CompactLocalReplica)
+      .Description("Compact the delta stores and merge the rowsets of a tablet "
+          "replica. The tablet server must not be running.")
+      .AddRequiredParameter({ kTabletIdArg, kTabletIdArgDesc })
+      .AddOptionalParameter("compact_merge_rowsets")
+      .AddOptionalParameter("compact_threads")
+      .AddOptionalParameter("fs_wal_dir")
+      .AddOptionalParameter("fs_data_dirs")
+      .Build();
+
   unique_ptr<Action> copy_from_remote =
       ActionBuilder("copy_from_remote", &CopyFromRemote)
       .Description("Copy a tablet replica from a remote server")
@@ -797,6 +927,7 @@ unique_ptr<Mode> BuildLocalReplicaMode() {
   return ModeBuilder("local_replica")
       .Description("Operate on local tablet replicas via the local filesystem")
       .AddMode(std::move(cmeta))
+      .AddAction(std::move(compact))
       .AddAction(std::move(copy_from_remote))
       .AddAction(std::move(delete_local_replica))
       .AddAction(std::move(list))
@@ -18,39 +18,579 @@
 #include "kudu/tools/tool_action.h"
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include <gflags/gflags.h>
+
 #include "kudu/client/client.h"
+#include "kudu/client/scan_batch.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/escaping.h"
+#include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tools/tool_action_common.h"
+#include "kudu/util/blocking_queue.h"
+#include "kudu/util/env.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
 
 DEFINE_bool(list_tablets, false,
             "Include tablet and replica UUIDs in the output");
+DEFINE_bool(create_table, true,
+            "Whether to create the destination table, with the schema of the "
+            "source table, hash partitioned on its primary key columns. "
+            "If false, the destination table must already exist, with "
+            "columns of the same names and types as the source table.");
+DEFINE_string(dst_master_addresses, "",
+              "Comma-separated list of the master addresses of the cluster "
+              "to copy the table to. If empty, the table is copied within "
+              "the source cluster.");
+DEFINE_int32(dst_table_num_buckets, 0,
+             "Number of hash buckets of the destination table, if it is "
+             "created. 0 means the number of tablets of the source table, "
+             "and at least 2.");
+DEFINE_int32(dst_table_num_replicas, 0,
+             "Number of replicas of the destination table, if it is created. "
+             "0 means the server-side default.");
+DEFINE_string(output_dir, "",
+              "Directory to write the scanned rows to, with a file per scan "
+              "token, in tab-separated text with C-style escapes and '\\N' "
+              "for NULL. If empty, the rows are only counted.");
+DEFINE_int32(scan_threads, 4,
+             "Number of scan tokens to scan concurrently.");
+DEFINE_int64(scan_split_size_bytes, 0,
+             "If positive, ask the tablet servers to split the primary key "
+             "range of each tablet into scan tokens of about this many bytes, "
+             "to scan large tablets with several scanners. 0 means one scan "
+             "token per tablet.");
+DEFINE_int32(write_threads, 4,
+             "Number of sessions writing the copied rows concurrently.");
 
 namespace kudu {
 namespace tools {
 
 using client::KuduClient;
 using client::KuduClientBuilder;
+using client::KuduColumnSchema;
+using client::KuduError;
+using client::KuduInsert;
+using client::KuduScanBatch;
+using client::KuduScanner;
 using client::KuduScanToken;
 using client::KuduScanTokenBuilder;
+using client::KuduSchema;
+using client::KuduSession;
 using client::KuduTable;
+using client::KuduTableCreator;
+using std::atomic;
 using std::cout;
 using std::endl;
 using std::string;
+using std::thread;
 using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 namespace {
 
 const char* const kTableNameArg = "table_name";
+const char* const kDstTableNameArg = "dst_table_name";
+
+Status BuildClient(const string& master_addresses_str,
+                   client::sp::shared_ptr<KuduClient>* client) {
+  vector<string> master_addresses = strings::Split(master_addresses_str, ",");
+  return KuduClientBuilder()
+      .master_server_addrs(master_addresses)
+      .Build(client);
+}
+
+// Consumes the rows of the scan tokens of a table. The rows of a token are
+// all consumed by the same scanner thread, but the rows of different
+// tokens are consumed concurrently.
+class RowSink {
+ public:
+  virtual ~RowSink() {}
+
+  virtual Status StartToken(size_t /* token_idx */) { return Status::OK(); }
+
+  // Consumes a batch of rows of token 'token_idx'. The rows are only valid
+  // until the call returns.
+  virtual Status AddBatch(size_t token_idx, const KuduScanBatch& batch) = 0;
+
+  virtual Status FinishToken(size_t /* token_idx */) { return Status::OK(); }
+};
+
+// Scans 'tokens' with --scan_threads threads, each taking the next token
+// to scan in turn, and hands their rows to 'sink'. Stops at the first error.
+Status ScanTokens(const vector<KuduScanToken*>& tokens, RowSink* sink,
+                  uint64_t* total_rows) {
+  atomic<size_t> next_token(0);
+  atomic<bool> failed(false);
+  atomic<uint64_t> rows(0);
+  const int num_threads = std::max(1, FLAGS_scan_threads);
+  vector<Status> statuses(num_threads);
+  vector<thread> threads;
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&, i]() {
+      auto scan = [&]() -> Status {
+        for (size_t idx = next_token++; idx < tokens.size() && !failed; idx = next_token++) {
+          KuduScanner* scanner_ptr;
+          RETURN_NOT_OK(tokens[idx]->IntoKuduScanner(&scanner_ptr));
+          unique_ptr<KuduScanner> scanner(scanner_ptr);
+          RETURN_NOT_OK(scanner->Open());
+          RETURN_NOT_OK(sink->StartToken(idx));
+          KuduScanBatch batch;
+          while (scanner->HasMoreRows() && !failed) {
+            RETURN_NOT_OK(scanner->NextBatch(&batch));
+            RETURN_NOT_OK(sink->AddBatch(idx, batch));
+            rows += batch.NumRows();
+          }
+          RETURN_NOT_OK(sink->FinishToken(idx));
+        }
+        return Status::OK();
+      };
+      statuses[i] = scan();
+      if (!statuses[i].ok()) {
+        failed = true;
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  *total_rows = rows;
+  for (const auto& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
+  return Status::OK();
+}
+
+// Builds the scan tokens of 'table', for a fault-tolerant snapshot scan of
+// all of its columns.
+Status BuildScanTokens(KuduTable* table, vector<KuduScanToken*>* tokens) {
+  KuduScanTokenBuilder builder(table);
+  RETURN_NOT_OK(builder.SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
+  RETURN_NOT_OK(builder.SetFaultTolerant());
+  RETURN_NOT_OK(builder.SetSelection(KuduClient::LEADER_ONLY));
+  if (FLAGS_scan_split_size_bytes > 0) {
+    RETURN_NOT_OK(builder.SetSplitSizeBytes(FLAGS_scan_split_size_bytes));
+  }
+  return builder.Build(tokens);
+}
+
+void ReportThroughput(const string& what, uint64_t rows, const Stopwatch& sw) {
+  const double seconds = sw.elapsed().wall_seconds();
+  cout << what << " " << rows << " rows in " << seconds << " s ("
+       << (seconds > 0 ? rows / seconds : 0) << " rows/s)" << endl;
+}
+
+// Writes the rows of each token to a file of its own, as tab-separated text.
+class FileRowSink : public RowSink {
+ public:
+  FileRowSink(string dir, string table_name, size_t num_tokens)
+      : dir_(std::move(dir)),
+        table_name_(std::move(table_name)),
+        files_(num_tokens) {
+  }
+
+  Status StartToken(size_t token_idx) override {
+    // Each token is scanned by a single thread, so that its file is only
+    // accessed by that thread.
+    string path = JoinPathSegments(dir_, Substitute("$0-$1.tsv", table_name_, token_idx));
+    return Env::Default()->NewWritableFile(path, &files_[token_idx]);
+  }
+
+  Status AddBatch(size_t token_idx, const KuduScanBatch& batch) override {
+    const KuduSchema* schema = batch.projection_schema();
+    faststring buf;
+    for (const KuduScanBatch::RowPtr& row : batch) {
+      for (size_t col = 0; col < schema->num_columns(); col++) {
+        if (col > 0) {
+          buf.push_back('\t');
+        }
+        RETURN_NOT_OK(AppendCell(row, col, schema->Column(col).type(), &buf));
+      }
+      buf.push_back('\n');
+    }
+    return files_[token_idx]->Append(Slice(buf));
+  }
+
+  Status FinishToken(size_t token_idx) override {
+    Status s = files_[token_idx]->Close();
+    files_[token_idx].reset();
+    return s;
+  }
+
+ private:
+  static Status AppendCell(const KuduScanBatch::RowPtr& row, int col,
+                           KuduColumnSchema::DataType type, faststring* buf) {
+    if (row.IsNull(col)) {
+      buf->append("\\N");
+      return Status::OK();
+    }
+    string str;
+    switch (type) {
+      case KuduColumnSchema::BOOL: {
+        bool v;
+        RETURN_NOT_OK(row.GetBool(col, &v));
+        str = v ? "true" : "false";
+        break;
+      }
+      case KuduColumnSchema::INT8: {
+        int8_t v;
+        RETURN_NOT_OK(row.GetInt8(col, &v));
+        str = SimpleItoa(v);
+        break;
+      }
+      case KuduColumnSchema::INT16: {
+        int16_t v;
+        RETURN_NOT_OK(row.GetInt16(col, &v));
+        str = SimpleItoa(v);
+        break;
+      }
+      case KuduColumnSchema::INT32: {
+        int32_t v;
+        RETURN_NOT_OK(row.GetInt32(col, &v));
+        str = SimpleItoa(v);
+        break;
+      }
+      case KuduColumnSchema::INT64: {
+        int64_t v;
+        RETURN_NOT_OK(row.GetInt64(col, &v));
+        str = SimpleItoa(v);
+        break;
+      }
+      case KuduColumnSchema::UNIXTIME_MICROS: {
+        int64_t v;
+        RETURN_NOT_OK(row.GetUnixTimeMicros(col, &v));
+        str = SimpleItoa(v);
+        break;
+      }
+      case KuduColumnSchema::FLOAT: {
+        float v;
+        RETURN_NOT_OK(row.GetFloat(col, &v));
+        str = SimpleFtoa(v);
+        break;
+      }
+      case KuduColumnSchema::DOUBLE: {
+        double v;
+        RETURN_NOT_OK(row.GetDouble(col, &v));
+        str = SimpleDtoa(v);
+        break;
+      }
+      case KuduColumnSchema::STRING: {
+        Slice v;
+        RETURN_NOT_OK(row.GetString(col, &v));
+        str = strings::CEscape(v.ToString());
+        break;
+      }
+      case KuduColumnSchema::BINARY: {
+        Slice v;
+        RETURN_NOT_OK(row.GetBinary(col, &v));
+        str = strings::CEscape(v.ToString());
+        break;
+      }
+      default:
+        return Status::InvalidArgument("unknown data type");
+    }
+    buf->append(str);
+    return Status::OK();
+  }
+
+  const string dir_;
+  const string table_name_;
+  vector<unique_ptr<WritableFile>> files_;
+};
+
+// A batch of rows to insert into the destination table of a copy.
+typedef vector<KuduInsert*> InsertBatch;
+
+// Converts the scanned rows into inserts into 'table', and queues them to
+// be applied by the writer threads.
+class CopyRowSink : public RowSink {
+ public:
+  CopyRowSink(KuduTable* table, BlockingQueue<InsertBatch*>* queue)
+      : table_(table),
+        queue_(queue) {
+  }
+
+  Status AddBatch(size_t /* token_idx */, const KuduScanBatch& batch) override {
+    const KuduSchema* schema = batch.projection_schema();
+    InsertBatch inserts;
+    ElementDeleter d(&inserts);
+    inserts.reserve(batch.NumRows());
+    vector<int> dst_idxs;
+    for (const KuduScanBatch::RowPtr& row : batch) {
+      unique_ptr<KuduInsert> insert(table_->NewInsert());
+      KuduPartialRow* dst = insert->mutable_row();
+      if (dst_idxs.empty()) {
+        // The destination columns are matched with the source columns by
+        // name.
+        for (size_t col = 0; col < schema->num_columns(); col++) {
+          string name = schema->Column(col).name();
+          int idx = dst->schema()->find_column(name);
+          if (idx == Schema::kColumnNotFound) {
+            return Status::NotFound("column not found in the destination table", name);
+          }
+          dst_idxs.push_back(idx);
+        }
+      }
+      for (size_t col = 0; col < schema->num_columns(); col++) {
+        RETURN_NOT_OK(CopyCell(row, col, schema->Column(col).type(), dst_idxs[col], dst));
+      }
+      inserts.push_back(insert.release());
+    }
+    unique_ptr<InsertBatch> queued(new InsertBatch());
+    queued->swap(inserts);
+    if (!queue_->BlockingPut(queued.get())) {
+      STLDeleteElements(queued.get());
+      return Status::Aborted("writers have stopped");
+    }
+    ignore_result(queued.release());
+    return Status::OK();
+  }
+
+ private:
+  static Status CopyCell(const KuduScanBatch::RowPtr& src, int src_idx,
+                         KuduColumnSchema::DataType type, int dst_idx,
+                         KuduPartialRow* dst) {
+    if (src.IsNull(src_idx)) {
+      return dst->SetNull(dst_idx);
+    }
+    switch (type) {
+      case KuduColumnSchema::BOOL: {
+        bool v;
+        RETURN_NOT_OK(src.GetBool(src_idx, &v));
+        return dst->SetBool(dst_idx, v);
+      }
+      case KuduColumnSchema::INT8: {
+        int8_t v;
+        RETURN_NOT_OK(src.GetInt8(src_idx, &v));
+        return dst->SetInt8(dst_idx, v);
+      }
+      case KuduColumnSchema::INT16: {
+        int16_t v;
+        RETURN_NOT_OK(src.GetInt16(src_idx, &v));
+        return dst->SetInt16(dst_idx, v);
+      }
+      case KuduColumnSchema::INT32: {
+        int32_t v;
+        RETURN_NOT_OK(src.GetInt32(src_idx, &v));
+        return dst->SetInt32(dst_idx, v);
+      }
+      case KuduColumnSchema::INT64: {
+        int64_t v;
+        RETURN_NOT_OK(src.GetInt64(src_idx, &v));
+        return dst->SetInt64(dst_idx, v);
+      }
+      case KuduColumnSchema::UNIXTIME_MICROS: {
+        int64_t v;
+        RETURN_NOT_OK(src.GetUnixTimeMicros(src_idx, &v));
+        return dst->SetUnixTimeMicros(dst_idx, v);
+      }
+      case KuduColumnSchema::FLOAT: {
+        float v;
+        RETURN_NOT_OK(src.GetFloat(src_idx, &v));
+        return dst->SetFloat(dst_idx, v);
+      }
+      case KuduColumnSchema::DOUBLE: {
+        double v;
+        RETURN_NOT_OK(src.GetDouble(src_idx, &v));
+        return dst->SetDouble(dst_idx, v);
+      }
+      case KuduColumnSchema::STRING: {
+        // The scanned data is only valid until the next batch, so the
+        // values are copied.
+        Slice v;
+        RETURN_NOT_OK(src.GetString(src_idx, &v));
+        return dst->SetStringCopy(dst_idx, v);
+      }
+      case KuduColumnSchema::BINARY: {
+        Slice v;
+        RETURN_NOT_OK(src.GetBinary(src_idx, &v));
+        return dst->SetBinaryCopy(dst_idx, v);
+      }
+      default:
+        return Status::InvalidArgument("unknown data type");
+    }
+  }
+
+  KuduTable* const table_;
+  BlockingQueue<InsertBatch*>* const queue_;
+};
+
+// Applies the batches of 'queue' in a session of its own until the queue is
+// shut down and drained. After an error, the remaining batches are dropped,
+// so that the scanners never block on a full queue.
+void WriterThread(const client::sp::shared_ptr<KuduClient>& client,
+                  BlockingQueue<InsertBatch*>* queue,
+                  atomic<uint64_t>* rows_written, Status* status) {
+  client::sp::shared_ptr<KuduSession> session(client->NewSession());
+  *status = session->SetFlushMode(KuduSession::AUTO_FLUSH_BACKGROUND);
+  InsertBatch* batch_ptr;
+  while (queue->BlockingGet(&batch_ptr)) {
+    unique_ptr<InsertBatch> batch(batch_ptr);
+    ElementDeleter d(batch.get());
+    if (!status->ok()) {
+      continue;
+    }
+    for (auto& insert : *batch) {
+      KuduInsert* op = insert;
+      insert = nullptr;
+      *status = session->Apply(op);
+      if (!status->ok()) {
+        break;
+      }
+    }
+    if (status->ok()) {
+      *rows_written += batch->size();
+    }
+  }
+  Status flush_status = session->Flush();
+  vector<KuduError*> errors;
+  ElementDeleter d(&errors);
+  bool overflowed;
+  session->GetPendingErrors(&errors, &overflowed);
+  if (!errors.empty()) {
+    *rows_written -= errors.size();
+    *status = errors[0]->status().CloneAndPrepend(
+        Substitute("$0$1 rows failed to be written; first error",
+                   errors.size(), overflowed ? "+" : ""));
+  } else if (status->ok()) {
+    *status = flush_status;
+  }
+}
+
+Status ScanTable(const RunnerContext& context) {
+  const string& table_name = FindOrDie(context.required_args, kTableNameArg);
+  client::sp::shared_ptr<KuduClient> client;
+  RETURN_NOT_OK(BuildClient(FindOrDie(context.required_args, kMasterAddressesArg),
+                            &client));
+  client::sp::shared_ptr<KuduTable> table;
+  RETURN_NOT_OK(client->OpenTable(table_name, &table));
+  vector<KuduScanToken*> tokens;
+  ElementDeleter deleter(&tokens);
+  RETURN_NOT_OK(BuildScanTokens(table.get(), &tokens));
+
+  class CountingRowSink : public RowSink {
+   public:
+    Status AddBatch(size_t /* token_idx */, const KuduScanBatch& /* batch */) override {
+      return Status::OK();
+    }
+  };
+  unique_ptr<RowSink> sink;
+  if (FLAGS_output_dir.empty()) {
+    sink.reset(new CountingRowSink());
+  } else {
+    RETURN_NOT_OK(env_util::CreateDirsRecursively(Env::Default(), FLAGS_output_dir));
+    sink.reset(new FileRowSink(FLAGS_output_dir, table_name, tokens.size()));
+  }
+
+  Stopwatch sw(Stopwatch::ALL_THREADS);
+  sw.start();
+  uint64_t rows;
+  Status s = ScanTokens(tokens, sink.get(), &rows);
+  sw.stop();
+  ReportThroughput(Substitute("Scanned $0 tokens:", tokens.size()), rows, sw);
+  return s;
+}
+
+Status CreateDestinationTable(KuduClient* client, KuduTable* src_table,
+                              const string& dst_table_name, size_t num_src_tablets) {
+  const KuduSchema& schema = src_table->schema();
+  vector<int> key_idxs;
+  schema.GetPrimaryKeyColumnIndexes(&key_idxs);
+  vector<string> key_columns;
+  for (int idx : key_idxs) {
+    key_columns.push_back(schema.Column(idx).name());
+  }
+  int num_buckets = FLAGS_dst_table_num_buckets;
+  if (num_buckets == 0) {
+    num_buckets = std::max<int>(2, num_src_tablets);
+  }
+  unique_ptr<KuduTableCreator> table_creator(client->NewTableCreator());
+  table_creator->table_name(dst_table_name)
+      .schema(&schema)
+      .add_hash_partitions(key_columns, num_buckets);
+  if (FLAGS_dst_table_num_replicas > 0) {
+    table_creator->num_replicas(FLAGS_dst_table_num_replicas);
+  }
+  return table_creator->Create();
+}
+
+Status CopyTable(const RunnerContext& context) {
+  const string& src_table_name = FindOrDie(context.required_args, kTableNameArg);
+  const string& dst_table_name = FindOrDie(context.required_args, kDstTableNameArg);
+  const string& master_addresses = FindOrDie(context.required_args, kMasterAddressesArg);
+  client::sp::shared_ptr<KuduClient> src_client;
+  RETURN_NOT_OK(BuildClient(master_addresses, &src_client));
+  client::sp::shared_ptr<KuduClient> dst_client = src_client;
+  if (!FLAGS_dst_master_addresses.empty()) {
+    RETURN_NOT_OK(BuildClient(FLAGS_dst_master_addresses, &dst_client));
+  }
+
+  client::sp::shared_ptr<KuduTable> src_table;
+  RETURN_NOT_OK(src_client->OpenTable(src_table_name, &src_table));
+  vector<KuduScanToken*> tokens;
+  ElementDeleter deleter(&tokens);
+  RETURN_NOT_OK(BuildScanTokens(src_table.get(), &tokens));
+
+  if (FLAGS_create_table) {
+    // Split tokens don't tell the number of tablets.
+    vector<string> tablet_ids;
+    for (const auto* token : tokens) {
+      tablet_ids.push_back(token->tablet().id());
+    }
+    std::sort(tablet_ids.begin(), tablet_ids.end());
+    size_t num_tablets = std::unique(tablet_ids.begin(), tablet_ids.end()) - tablet_ids.begin();
+    RETURN_NOT_OK(CreateDestinationTable(dst_client.get(), src_table.get(),
+                                         dst_table_name, num_tablets));
+  }
+  client::sp::shared_ptr<KuduTable> dst_table;
+  RETURN_NOT_OK(dst_client->OpenTable(dst_table_name, &dst_table));
+
+  const int num_writers = std::max(1, FLAGS_write_threads);
+  BlockingQueue<InsertBatch*> queue(2 * num_writers);
+  atomic<uint64_t> rows_written(0);
+  vector<Status> writer_statuses(num_writers);
+  vector<thread> writers;
+  for (int i = 0; i < num_writers; i++) {
+    writers.emplace_back(&WriterThread, dst_client, &queue, &rows_written,
+                         &writer_statuses[i]);
+  }
+
+  Stopwatch sw(Stopwatch::ALL_THREADS);
+  sw.start();
+  CopyRowSink sink(dst_table.get(), &queue);
+  uint64_t rows_scanned;
+  Status scan_status = ScanTokens(tokens, &sink, &rows_scanned);
+  queue.Shutdown();
+  for (auto& t : writers) {
+    t.join();
+  }
+  sw.stop();
+  ReportThroughput(Substitute("Scanned $0 tokens:", tokens.size()), rows_scanned, sw);
+  ReportThroughput("Wrote", rows_written, sw);
+  RETURN_NOT_OK_PREPEND(scan_status, "failed to scan the source table");
+  for (const auto& s : writer_statuses) {
+    RETURN_NOT_OK_PREPEND(s, "failed to write the destination table");
+  }
+  return Status::OK();
+}
 
 Status DeleteTable(const RunnerContext& context) {
   const string& master_addresses_str = FindOrDie(context.required_args,
@@ -106,6 +646,27 @@ Status ListTables(const RunnerContext& context) {
 } // anonymous namespace
 
 unique_ptr<Mode> BuildTableMode() {
+  unique_ptr<Action> copy_table =
+      ActionBuilder("copy", &CopyTable)
+      .Description("Copy the rows of a table into another table")
+      .ExtraDescription(
+          "The source table is scanned with a snapshot scan, in parallel by "
+          "scan token, and the rows are inserted into the destination table "
+          "by a number of concurrent sessions. The destination table may be "
+          "in another cluster, and is created by default, with a different "
+          "number of hash buckets if requested.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddRequiredParameter({ kTableNameArg, "Name of the table to copy" })
+      .AddRequiredParameter({ kDstTableNameArg, "Name of the destination table" })
+      .AddOptionalParameter("create_table")
+      .AddOptionalParameter("dst_master_addresses")
+      .AddOptionalParameter("dst_table_num_buckets")
+      .AddOptionalParameter("dst_table_num_replicas")
+      .AddOptionalParameter("scan_split_size_bytes")
+      .AddOptionalParameter("scan_threads")
+      .AddOptionalParameter("write_threads")
+      .Build();
+
   unique_ptr<Action> delete_table =
       ActionBuilder("delete", &DeleteTable)
       .Description("Delete a table")
@@ -120,10 +681,25 @@ unique_ptr<Mode> BuildTableMode() {
       .AddOptionalParameter("list_tablets")
       .Build();
 
+  unique_ptr<Action> scan_table =
+      ActionBuilder("scan", &ScanTable)
+      .Description("Scan the rows of a table, optionally exporting them to files")
+      .ExtraDescription(
+          "The table is scanned with a snapshot scan, in parallel by scan "
+          "token. Reports the number of rows scanned and the throughput.")
+      .AddRequiredParameter({ kMasterAddressesArg, kMasterAddressesArgDesc })
+      .AddRequiredParameter({ kTableNameArg, "Name of the table to scan" })
+      .AddOptionalParameter("output_dir")
+      .AddOptionalParameter("scan_split_size_bytes")
+      .AddOptionalParameter("scan_threads")
+      .Build();
+
   return ModeBuilder("table")
       .Description("Operate on Kudu tables")
+      .AddAction(std::move(copy_table))
       .AddAction(std::move(delete_table))
       .AddAction(std::move(list_tables))
+      .AddAction(std::move(scan_table))
       .Build();
 }
 
@@ -83,17 +83,34 @@
 //     --run_scan=true \
 //     127.0.0.1
 //
+//
+// Insert 1M rows with 4 threads, then run a read-mostly mix of point reads,
+// range scans and updates against them, choosing the rows to read or update
+// following a zipfian distribution:
+//
+//   kudu test loadgen \
+//     --num_threads=4 \
+//     --num_rows_per_thread=250000 \
+//     --workload_mix=read:80,scan:5,update:15 \
+//     --workload_key_distribution=zipfian \
+//     --workload_ops_per_thread=100000 \
+//     127.0.0.1
+//
 
 #include "kudu/tools/tool_action.h"
 
+#include <cinttypes>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <ctime>
 
 #include <algorithm>
 #include <chrono>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <memory>
 #include <mutex>
@@ -102,13 +119,19 @@
 #include <vector>
 
 #include <gflags/gflags.h>
+#include <glog/logging.h>
 
 #include "kudu/client/client.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/tools/tool_action_common.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/oid_generator.h"
 #include "kudu/util/random.h"
 #include "kudu/util/stopwatch.h"
@@ -120,8 +143,10 @@ using kudu::TypeInfo;
 using kudu::client::KuduClient;
 using kudu::client::KuduClientBuilder;
 using kudu::client::KuduColumnSchema;
+using kudu::client::KuduDelete;
 using kudu::client::KuduError;
 using kudu::client::KuduInsert;
+using kudu::client::KuduPredicate;
 using kudu::client::KuduRowResult;
 using kudu::client::KuduSchema;
 using kudu::client::KuduSchemaBuilder;
@@ -130,6 +155,10 @@ using kudu::client::KuduScanner;
 using kudu::client::KuduSession;
 using kudu::client::KuduTable;
 using kudu::client::KuduTableCreator;
+using kudu::client::KuduUpdate;
+using kudu::client::KuduUpsert;
+using kudu::client::KuduValue;
+using kudu::client::KuduWriteOperation;
 using kudu::client::sp::shared_ptr;
 using std::accumulate;
 using std::cerr;
@@ -214,6 +243,27 @@ DEFINE_bool(use_random, false,
             "Whether to use random numbers instead of sequential ones. "
             "In case of using random numbers collisions are possible over "
             "the data for columns with unique constraint (e.g. primary key).");
+DEFINE_string(workload_key_distribution, "uniform",
+              "Distribution of the rows which the operations of the mixed "
+              "workload act on, among the inserted rows: 'sequential', "
+              "'uniform' or 'zipfian'.");
+DEFINE_string(workload_mix, "",
+              "Mix of operations to run against the inserted rows once the "
+              "generator threads are done, as comma-separated "
+              "'<operation>:<weight>' pairs, e.g. "
+              "'read:50,scan:5,update:30,upsert:10,delete:5'. The operations "
+              "are 'read' (point lookup by primary key), 'scan' (range scan "
+              "with predicates on the first key column), 'update', 'upsert' "
+              "and 'delete'. Each of the '--num_threads' threads runs "
+              "'--workload_ops_per_thread' operations in its own session, and "
+              "latency and throughput are reported per operation type. "
+              "Requires sequential mode and a limited number of rows per thread. "
+              "If left empty, only inserts are run.");
+DEFINE_uint64(workload_ops_per_thread, 1000,
+              "Number of operations each thread runs in the mixed workload.");
+DEFINE_uint64(workload_scan_length, 100,
+              "Number of consecutive inserted rows which each range scan of the "
+              "mixed workload covers.");
 
 namespace kudu {
 namespace tools {
@@ -283,10 +333,13 @@ string Generator::Next() {
   return str;
 }
 
-Status GenerateRowData(Generator* gen, KuduPartialRow* row,
-                       const string& fixed_string) {
+// Sets the columns [begin_idx, end_idx) of 'row' to values drawn from 'gen',
+// in column order.
+Status GenerateColumnData(Generator* gen, KuduPartialRow* row,
+                          const string& fixed_string,
+                          size_t begin_idx, size_t end_idx) {
   const vector<ColumnSchema>& columns(row->schema()->columns());
-  for (size_t idx = 0; idx < columns.size(); ++idx) {
+  for (size_t idx = begin_idx; idx < end_idx; ++idx) {
     const TypeInfo* tinfo = columns[idx].type_info();
     switch (tinfo->type()) {
       case BOOL:
@@ -334,6 +387,11 @@ Status GenerateRowData(Generator* gen, KuduPartialRow* row,
   return Status::OK();
 }
 
+Status GenerateRowData(Generator* gen, KuduPartialRow* row,
+                       const string& fixed_string) {
+  return GenerateColumnData(gen, row, fixed_string, 0, row->schema()->num_columns());
+}
+
 mutex cerr_lock;
 
 void GeneratorThread(
@@ -497,6 +555,453 @@ Status CountTableRows(const shared_ptr<KuduClient>& client,
   return Status::OK();
 }
 
+// The types of operations of the mixed workload.
+enum OpType {
+  OP_READ,
+  OP_SCAN,
+  OP_UPDATE,
+  OP_UPSERT,
+  OP_DELETE,
+};
+const int kNumOpTypes = OP_DELETE + 1;
+const char* const kOpTypeNames[] = { "read", "scan", "update", "upsert", "delete" };
+
+enum KeyDistribution {
+  SEQUENTIAL,
+  UNIFORM,
+  ZIPFIAN,
+};
+
+struct OpStats {
+  OpStats()
+      // Up to a minute, with 3 significant digits.
+      : latency_us(60 * 1000 * 1000, 3),
+        rows(0),
+        not_found(0),
+        errors(0) {
+  }
+
+  HdrHistogram latency_us;
+  // The number of rows returned by reads and scans.
+  AtomicInt<int64_t> rows;
+  // The number of operations on rows which didn't exist, e.g. because they
+  // were deleted by an earlier operation. These are not errors.
+  AtomicInt<int64_t> not_found;
+  AtomicInt<int64_t> errors;
+};
+
+// Parses a workload mix of the form 'read:50,scan:5,update:45' into the
+// weight of each type of operation.
+Status ParseWorkloadMix(const string& mix, vector<uint32_t>* weights) {
+  weights->assign(kNumOpTypes, 0);
+  uint32_t total = 0;
+  vector<string> entries = strings::Split(mix, ",", strings::SkipEmpty());
+  for (const string& entry : entries) {
+    vector<string> name_and_weight = strings::Split(entry, ":");
+    uint32_t weight;
+    if (name_and_weight.size() != 2 || !SimpleAtoi(name_and_weight[1], &weight)) {
+      return Status::InvalidArgument("invalid workload mix entry", entry);
+    }
+    const auto* it = std::find(std::begin(kOpTypeNames), std::end(kOpTypeNames),
+                               name_and_weight[0]);
+    if (it == std::end(kOpTypeNames)) {
+      return Status::InvalidArgument("unknown operation type", name_and_weight[0]);
+    }
+    (*weights)[it - std::begin(kOpTypeNames)] += weight;
+    total += weight;
+  }
+  if (total == 0) {
+    return Status::InvalidArgument("workload mix has no operations", mix);
+  }
+  return Status::OK();
+}
+
+Status ParseKeyDistribution(const string& name, KeyDistribution* dist) {
+  if (name == "sequential") {
+    *dist = SEQUENTIAL;
+  } else if (name == "uniform") {
+    *dist = UNIFORM;
+  } else if (name == "zipfian") {
+    *dist = ZIPFIAN;
+  } else {
+    return Status::InvalidArgument("unknown key distribution", name);
+  }
+  return Status::OK();
+}
+
+// Returns the sum of 1/i^theta for i in [1, n], the zeta constant of a
+// zipfian distribution over n items.
+double ZipfianZeta(uint64_t n, double theta) {
+  double sum = 0;
+  for (uint64_t i = 1; i <= n; i++) {
+    sum += 1.0 / std::pow(i, theta);
+  }
+  return sum;
+}
+
+// Chooses the indexes of the rows, among the 'num_rows' inserted rows,
+// which the operations of a workload thread act on.
+//
+// Zipfian indexes are drawn as by YCSB, following the algorithm of Gray
+// et al., "Quickly Generating Billion-Record Synthetic Databases". Row 0 is
+// the most popular.
+//
+// This class is not thread-safe.
+class KeyChooser {
+ public:
+  static constexpr double kZipfianTheta = 0.99;
+
+  // 'zetan' is the zeta constant of 'num_rows', used only by the zipfian
+  // distribution. Sequential indexes start at 'start', and wrap around.
+  KeyChooser(KeyDistribution dist, uint64_t num_rows, uint64_t start,
+             double zetan, uint32_t seed)
+      : dist_(dist),
+        num_rows_(num_rows),
+        next_(start % num_rows),
+        random_(seed),
+        alpha_(1.0 / (1.0 - kZipfianTheta)),
+        zetan_(zetan),
+        eta_(dist == ZIPFIAN ?
+             (1.0 - std::pow(2.0 / num_rows, 1.0 - kZipfianTheta)) /
+             (1.0 - ZipfianZeta(2, kZipfianTheta) / zetan) : 0) {
+  }
+
+  uint64_t Next() {
+    switch (dist_) {
+      case SEQUENTIAL: {
+        uint64_t idx = next_;
+        next_ = (next_ + 1) % num_rows_;
+        return idx;
+      }
+      case UNIFORM:
+        return random_.Uniform64(num_rows_);
+      case ZIPFIAN:
+        return NextZipfian();
+    }
+    LOG(FATAL) << "unknown key distribution " << dist_;
+    return 0;
+  }
+
+  Random* random() { return &random_; }
+
+ private:
+  uint64_t NextZipfian() {
+    double u = random_.NextDoubleFraction();
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, kZipfianTheta)) {
+      return std::min<uint64_t>(1, num_rows_ - 1);
+    }
+    uint64_t idx = static_cast<uint64_t>(num_rows_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return std::min(idx, num_rows_ - 1);
+  }
+
+  const KeyDistribution dist_;
+  const uint64_t num_rows_;
+  uint64_t next_;
+  Random random_;
+  const double alpha_;
+  const double zetan_;
+  const double eta_;
+};
+
+// Sets the key columns of 'row' to those of the row with index 'row_idx'
+// among the rows inserted in sequential mode. The generator threads insert
+// rows with consecutive indexes from consecutive seeds, each row consuming
+// one value per column.
+Status GenerateKeyData(uint64_t row_idx, KuduPartialRow* row) {
+  const Schema* schema = row->schema();
+  Generator gen(Generator::MODE_SEQ,
+                FLAGS_seq_start + row_idx * schema->num_columns(),
+                FLAGS_string_len);
+  return GenerateColumnData(&gen, row, FLAGS_string_fixed, 0, schema->num_key_columns());
+}
+
+// Returns, in 'value', a new KuduValue holding column 'idx' of 'row'.
+Status NewColumnValue(const KuduPartialRow& row, int idx, KuduValue** value) {
+  switch (row.schema()->column(idx).type_info()->type()) {
+    case BOOL: {
+      bool v;
+      RETURN_NOT_OK(row.GetBool(idx, &v));
+      *value = KuduValue::FromBool(v);
+      break;
+    }
+    case INT8: {
+      int8_t v;
+      RETURN_NOT_OK(row.GetInt8(idx, &v));
+      *value = KuduValue::FromInt(v);
+      break;
+    }
+    case INT16: {
+      int16_t v;
+      RETURN_NOT_OK(row.GetInt16(idx, &v));
+      *value = KuduValue::FromInt(v);
+      break;
+    }
+    case INT32: {
+      int32_t v;
+      RETURN_NOT_OK(row.GetInt32(idx, &v));
+      *value = KuduValue::FromInt(v);
+      break;
+    }
+    case INT64: {
+      int64_t v;
+      RETURN_NOT_OK(row.GetInt64(idx, &v));
+      *value = KuduValue::FromInt(v);
+      break;
+    }
+    case UNIXTIME_MICROS: {
+      int64_t v;
+      RETURN_NOT_OK(row.GetUnixTimeMicros(idx, &v));
+      *value = KuduValue::FromInt(v);
+      break;
+    }
+    case FLOAT: {
+      float v;
+      RETURN_NOT_OK(row.GetFloat(idx, &v));
+      *value = KuduValue::FromFloat(v);
+      break;
+    }
+    case DOUBLE: {
+      double v;
+      RETURN_NOT_OK(row.GetDouble(idx, &v));
+      *value = KuduValue::FromDouble(v);
+      break;
+    }
+    case STRING: {
+      Slice v;
+      RETURN_NOT_OK(row.GetString(idx, &v));
+      *value = KuduValue::CopyString(v);
+      break;
+    }
+    case BINARY: {
+      Slice v;
+      RETURN_NOT_OK(row.GetBinary(idx, &v));
+      *value = KuduValue::CopyString(v);
+      break;
+    }
+    default:
+      return Status::InvalidArgument("unknown data type");
+  }
+  return Status::OK();
+}
+
+// Adds a predicate comparing column 'idx' with its value in 'row' to 'scanner'.
+Status AddColumnPredicate(KuduTable* table, const KuduPartialRow& row, int idx,
+                          KuduPredicate::ComparisonOp op, KuduScanner* scanner) {
+  KuduValue* value;
+  RETURN_NOT_OK(NewColumnValue(row, idx, &value));
+  return scanner->AddConjunctPredicate(table->NewComparisonPredicate(
+      row.schema()->column(idx).name(), op, value));
+}
+
+Status CountScannedRows(KuduScanner* scanner, int64_t* count) {
+  RETURN_NOT_OK(scanner->Open());
+  *count = 0;
+  KuduScanBatch batch;
+  while (scanner->HasMoreRows()) {
+    RETURN_NOT_OK(scanner->NextBatch(&batch));
+    *count += batch.NumRows();
+  }
+  return Status::OK();
+}
+
+// Applies 'op' in a session in AUTO_FLUSH_SYNC mode, returning the status of
+// the operation itself, if it failed.
+Status ApplyWrite(KuduSession* session, KuduWriteOperation* op) {
+  Status s = session->Apply(op);
+  if (s.ok()) {
+    return s;
+  }
+  vector<KuduError*> errors;
+  ElementDeleter d(&errors);
+  session->GetPendingErrors(&errors, nullptr);
+  return errors.empty() ? s : errors[0]->status();
+}
+
+// Runs 'num_ops' operations of the mixed workload, drawn according to
+// 'weights', against the 'num_rows' rows inserted by the generator threads.
+void WorkloadThread(
+    const shared_ptr<KuduClient>& client, const string& table_name,
+    size_t thread_idx, uint64_t num_rows, double zetan,
+    const vector<uint32_t>& weights, KeyDistribution dist,
+    const vector<unique_ptr<OpStats>>* stats, Status* status) {
+
+  auto runner = [&]() -> Status {
+    shared_ptr<KuduTable> table;
+    RETURN_NOT_OK(client->OpenTable(table_name, &table));
+    shared_ptr<KuduSession> session(client->NewSession());
+    RETURN_NOT_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_SYNC));
+    const KuduSchema& schema = table->schema();
+    const size_t num_columns = schema.num_columns();
+    const uint32_t total_weight = accumulate(weights.begin(), weights.end(), 0U);
+
+    // Sequential keys of different threads start apart from each other.
+    KeyChooser keys(dist, num_rows, thread_idx * (num_rows / FLAGS_num_threads),
+                    zetan, FLAGS_seq_start + thread_idx);
+    // The values of updated columns are random, so that updates don't write
+    // the values the rows already have.
+    Generator value_gen(Generator::MODE_RAND, FLAGS_seq_start + thread_idx,
+                        FLAGS_string_len);
+    unique_ptr<KuduPartialRow> key(schema.NewRow());
+    unique_ptr<KuduPartialRow> end_key(schema.NewRow());
+    const size_t num_key_columns = key->schema()->num_key_columns();
+
+    for (uint64_t i = 0; i < FLAGS_workload_ops_per_thread; ++i) {
+      uint32_t draw = keys.random()->Uniform(total_weight);
+      int op_type = 0;
+      while (draw >= weights[op_type]) {
+        draw -= weights[op_type++];
+      }
+      const uint64_t row_idx = keys.Next();
+      OpStats* op_stats = (*stats)[op_type].get();
+
+      MonoTime start = MonoTime::Now();
+      Status s;
+      int64_t rows = 0;
+      switch (op_type) {
+        case OP_READ: {
+          RETURN_NOT_OK(GenerateKeyData(row_idx, key.get()));
+          KuduScanner scanner(table.get());
+          for (size_t idx = 0; idx < num_key_columns; ++idx) {
+            RETURN_NOT_OK(AddColumnPredicate(table.get(), *key, idx,
+                                             KuduPredicate::EQUAL, &scanner));
+          }
+          s = CountScannedRows(&scanner, &rows);
+          if (s.ok() && rows == 0) {
+            s = Status::NotFound("row not found");
+          }
+          break;
+        }
+        case OP_SCAN: {
+          // Scans the rows [row_idx, row_idx + workload_scan_length), by the
+          // range of their first key column. The range only holds that many
+          // rows if the first key column is an integer.
+          RETURN_NOT_OK(GenerateKeyData(row_idx, key.get()));
+          RETURN_NOT_OK(GenerateKeyData(
+              std::min(row_idx + FLAGS_workload_scan_length, num_rows), end_key.get()));
+          KuduScanner scanner(table.get());
+          RETURN_NOT_OK(AddColumnPredicate(table.get(), *key, 0,
+                                           KuduPredicate::GREATER_EQUAL, &scanner));
+          RETURN_NOT_OK(AddColumnPredicate(table.get(), *end_key, 0,
+                                           KuduPredicate::LESS, &scanner));
+          s = CountScannedRows(&scanner, &rows);
+          break;
+        }
+        case OP_UPDATE: {
+          unique_ptr<KuduUpdate> op(table->NewUpdate());
+          RETURN_NOT_OK(GenerateKeyData(row_idx, op->mutable_row()));
+          RETURN_NOT_OK(GenerateColumnData(&value_gen, op->mutable_row(), FLAGS_string_fixed,
+                                           num_key_columns, num_columns));
+          s = ApplyWrite(session.get(), op.release());
+          break;
+        }
+        case OP_UPSERT: {
+          unique_ptr<KuduUpsert> op(table->NewUpsert());
+          RETURN_NOT_OK(GenerateKeyData(row_idx, op->mutable_row()));
+          RETURN_NOT_OK(GenerateColumnData(&value_gen, op->mutable_row(), FLAGS_string_fixed,
+                                           num_key_columns, num_columns));
+          s = ApplyWrite(session.get(), op.release());
+          break;
+        }
+        case OP_DELETE: {
+          unique_ptr<KuduDelete> op(table->NewDelete());
+          RETURN_NOT_OK(GenerateKeyData(row_idx, op->mutable_row()));
+          s = ApplyWrite(session.get(), op.release());
+          break;
+        }
+      }
+      op_stats->latency_us.Increment((MonoTime::Now() - start).ToMicroseconds());
+      op_stats->rows.IncrementBy(rows);
+      if (s.IsNotFound()) {
+        op_stats->not_found.Increment();
+      } else if (!s.ok()) {
+        if (op_stats->errors.Increment() <= FLAGS_show_first_n_errors) {
+          lock_guard<mutex> lock(cerr_lock);
+          cerr << "Error from workload thread " << std::setw(4) << thread_idx << ": "
+               << kOpTypeNames[op_type] << ": " << s.ToString() << endl;
+        }
+      }
+    }
+    return Status::OK();
+  };
+
+  *status = runner();
+}
+
+// Runs the mixed workload of '--workload_mix' against the 'num_rows' rows
+// inserted in sequential mode, and outputs the throughput and latency of
+// each type of operation.
+Status RunMixedWorkload(const shared_ptr<KuduClient>& client,
+                        const string& table_name, uint64_t num_rows) {
+  vector<uint32_t> weights;
+  RETURN_NOT_OK(ParseWorkloadMix(FLAGS_workload_mix, &weights));
+  KeyDistribution dist;
+  RETURN_NOT_OK(ParseKeyDistribution(FLAGS_workload_key_distribution, &dist));
+  if (num_rows == 0) {
+    return Status::InvalidArgument("no rows to run the workload against");
+  }
+  const double zetan =
+      dist == ZIPFIAN ? ZipfianZeta(num_rows, KeyChooser::kZipfianTheta) : 0;
+
+  vector<unique_ptr<OpStats>> stats;
+  for (int i = 0; i < kNumOpTypes; ++i) {
+    stats.emplace_back(new OpStats());
+  }
+  const size_t num_threads = FLAGS_num_threads;
+  vector<Status> status(num_threads);
+  vector<thread> threads;
+  Stopwatch sw(Stopwatch::ALL_THREADS);
+  sw.start();
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back(&WorkloadThread, client, table_name, i, num_rows, zetan,
+                         std::cref(weights), dist, &stats, &status[i]);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  sw.stop();
+
+  const double total_ms = sw.elapsed().wall_millis();
+  cout << endl << "Workload report" << endl
+       << "  time total  : " << total_ms << " ms" << endl;
+  int64_t total_errors = 0;
+  for (int i = 0; i < kNumOpTypes; ++i) {
+    const OpStats& op_stats = *stats[i];
+    const HdrHistogram& hist = op_stats.latency_us;
+    if (hist.TotalCount() == 0) {
+      continue;
+    }
+    total_errors += op_stats.errors.Load();
+    cout << StringPrintf("  %-6s: %" PRIu64 " ops, %.1f ops/s, %" PRId64 " rows, "
+                         "%" PRId64 " not found, %" PRId64 " errors",
+                         kOpTypeNames[i], hist.TotalCount(),
+                         hist.TotalCount() * 1000.0 / total_ms, op_stats.rows.Load(),
+                         op_stats.not_found.Load(), op_stats.errors.Load())
+         << endl;
+    cout << StringPrintf("          latency (us): mean %.1f, p50 %" PRIu64 ", p95 %" PRIu64
+                         ", p99 %" PRIu64 ", p99.9 %" PRIu64 ", max %" PRIu64,
+                         hist.MeanValue(), hist.ValueAtPercentile(50),
+                         hist.ValueAtPercentile(95), hist.ValueAtPercentile(99),
+                         hist.ValueAtPercentile(99.9), hist.MaxValue())
+         << endl;
+  }
+
+  // Return first non-OK error status, if any, as a result.
+  const auto it = find_if(status.begin(), status.end(),
+                          [&](const Status& s) { return !s.ok(); });
+  if (it != status.end()) {
+    return *it;
+  }
+  if (total_errors != 0) {
+    return Status::RuntimeError(
+        Substitute("Encountered $0 workload operation errors", total_errors));
+  }
+  return Status::OK();
+}
+
 Status TestLoadGenerator(const RunnerContext& context) {
   const string& master_addresses_str =
       FindOrDie(context.required_args, kMasterAddressesArg);
@@ -537,6 +1042,12 @@ Status TestLoadGenerator(const RunnerContext& context) {
                   .wait(true)
                   .Create());
   }
+  if (!FLAGS_workload_mix.empty() &&
+      (FLAGS_use_random || FLAGS_num_rows_per_thread == 0)) {
+    return Status::InvalidArgument(
+        "--workload_mix requires sequential mode and a non-zero "
+        "--num_rows_per_thread");
+  }
   cout << "Using " << (is_auto_table ? "auto-created " : "")
        << "table '" << table_name << "'" << endl;
 
@@ -582,6 +1093,10 @@ Status TestLoadGenerator(const RunnerContext& context) {
     }
   }
 
+  if (!FLAGS_workload_mix.empty()) {
+    RETURN_NOT_OK(RunMixedWorkload(client, table_name, total_row_count));
+  }
+
   if (is_auto_table && !FLAGS_keep_auto_table) {
     cout << "Dropping auto-created table '" << table_name << "'" << endl;
     // Drop the table which was automatically created to run the test.
@@ -601,7 +1116,10 @@ unique_ptr<Mode> BuildTestMode() {
           "Run load generation tool which inserts auto-generated data "
           "into already existing or auto-created table as fast as possible. "
           "If requested, also run scan over the inserted rows to check whether "
-          "the actual count or inserted rows matches the expected one.")
+          "the actual count or inserted rows matches the expected one. "
+          "If a workload mix is given, then run a mix of point reads, range "
+          "scans, updates, upserts and deletes against the inserted rows, "
+          "reporting the latency and throughput of each operation type.")
       .AddRequiredParameter({ kMasterAddressesArg,
           "Comma-separated list of master addresses to run against. "
           "Addresses are in 'hostname:port' form where port may be omitted "
@@ -621,6 +1139,10 @@ unique_ptr<Mode> BuildTestMode() {
       .AddOptionalParameter("table_num_buckets")
       .AddOptionalParameter("table_num_replicas")
       .AddOptionalParameter("use_random")
+      .AddOptionalParameter("workload_key_distribution")
+      .AddOptionalParameter("workload_mix")
+      .AddOptionalParameter("workload_ops_per_thread")
+      .AddOptionalParameter("workload_scan_length")
       .Build();
 
   return ModeBuilder("test")
@@ -17,14 +17,19 @@
 
 #include "kudu/tserver/heartbeater.h"
 
+#include <algorithm>
 #include <boost/optional.hpp>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "kudu/common/wire_protocol.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.h"
@@ -32,10 +37,16 @@
 #include "kudu/master/master.proxy.h"
 #include "kudu/security/server_cert_manager.h"
 #include "kudu/server/webserver.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_metrics.h"
+#include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/tablet_server_options.h"
 #include "kudu/tserver/ts_tablet_manager.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/pb_util.h"
@@ -57,6 +68,13 @@ DEFINE_int32(heartbeat_max_failures_before_backoff, 3,
              "rather than retrying.");
 TAG_FLAG(heartbeat_max_failures_before_backoff, advanced);
 
+DEFINE_int32(heartbeat_max_reported_busy_tablets, 0,
+             "The number of tablet replicas with the most writes whose load, including "
+             "the keys sampled per --tablet_write_key_sampling_interval, is reported "
+             "to the master with each heartbeat.");
+TAG_FLAG(heartbeat_max_reported_busy_tablets, experimental);
+TAG_FLAG(heartbeat_max_reported_busy_tablets, runtime);
+
 using google::protobuf::RepeatedPtrField;
 using kudu::HostPortPB;
 using kudu::consensus::RaftPeerPB;
@@ -64,9 +82,12 @@ using kudu::master::GetLeaderMasterRpc;
 using kudu::master::ListMastersResponsePB;
 using kudu::master::Master;
 using kudu::master::MasterServiceProxy;
+using kudu::master::TabletLoadPB;
 using kudu::master::TabletReportPB;
+using kudu::master::TSLoadPB;
 using kudu::rpc::RpcController;
 using std::shared_ptr;
+using std::unordered_map;
 using strings::Substitute;
 
 namespace kudu {
@@ -105,6 +126,7 @@ class Heartbeater::Thread {
   void MarkTabletDirty(const string& tablet_id, const string& reason);
   void GenerateIncrementalTabletReport(TabletReportPB* report);
   void GenerateFullTabletReport(TabletReportPB* report);
+  void GenerateLoadReport(TSLoadPB* load);
 
   // Mark that the master successfully received and processed the given
   // tablet report. This uses the report sequence number to "un-dirty" any
@@ -117,6 +139,9 @@ class Heartbeater::Thread {
   int GetMinimumHeartbeatMillis() const;
   int GetMillisUntilNextHeartbeat() const;
   Status DoHeartbeat();
+  // Sets the quotas of the tablets to their tables' shares, as sent by the
+  // leader master. Tablets of tables without a share are unlimited.
+  void ApplyTabletQuotaShares(const master::TSHeartbeatResponsePB& resp);
   Status SetupRegistration(ServerRegistrationPB* reg);
   void SetupCommonField(master::TSToMasterCommonPB* common);
   bool IsCurrentThread() const;
@@ -179,6 +204,20 @@ class Heartbeater::Thread {
   // the thread detects that the master has been elected leader.
   bool send_full_tablet_report_;
 
+  // The total number of rows written to and scanned from the tablets of the
+  // server, and the time they were counted, as of the last load report.
+  int64_t last_rows_written_;
+  int64_t last_rows_scanned_;
+  MonoTime last_load_report_time_;
+
+  // The number of rows written to and scanned from each tablet as of the
+  // last load report, if --heartbeat_max_reported_busy_tablets is positive.
+  struct TabletRowCounts {
+    int64_t written;
+    int64_t scanned;
+  };
+  std::unordered_map<std::string, TabletRowCounts> last_tablet_rows_;
+
   DISALLOW_COPY_AND_ASSIGN(Thread);
 };
 
@@ -278,7 +317,9 @@ Heartbeater::Thread::Thread(const HostPort& master_address, TabletServer* server
     cond_(&mutex_),
     should_run_(false),
     heartbeat_asap_(true),
-    send_full_tablet_report_(false) {
+    send_full_tablet_report_(false),
+    last_rows_written_(0),
+    last_rows_scanned_(0) {
 }
 
 Status Heartbeater::Thread::ConnectToMaster() {
@@ -394,6 +435,7 @@ Status Heartbeater::Thread::DoHeartbeat() {
     GenerateIncrementalTabletReport(req.mutable_tablet_report());
   }
   req.set_num_live_tablets(server_->tablet_manager()->GetNumLiveTablets());
+  GenerateLoadReport(req.mutable_load());
 
   RpcController rpc;
   rpc.set_timeout(MonoDelta::FromMilliseconds(FLAGS_heartbeat_rpc_timeout_ms));
@@ -419,6 +461,10 @@ Status Heartbeater::Thread::DoHeartbeat() {
 
   last_hb_response_.Swap(&resp);
 
+  if (last_hb_response_.leader_master()) {
+    ApplyTabletQuotaShares(last_hb_response_);
+  }
+
   // If we have a new signed certificate from the master, adopt it.
   if (last_hb_response_.has_signed_cert_der()) {
     RETURN_NOT_OK_PREPEND(
@@ -430,6 +476,29 @@ Status Heartbeater::Thread::DoHeartbeat() {
   return Status::OK();
 }
 
+void Heartbeater::Thread::ApplyTabletQuotaShares(const master::TSHeartbeatResponsePB& resp) {
+  unordered_map<string, const master::TableQuotaPB*> shares;
+  for (const auto& share : resp.tablet_quota_shares()) {
+    shares[share.table_id()] = &share.share();
+  }
+
+  vector<scoped_refptr<tablet::TabletPeer>> peers;
+  server_->tablet_manager()->GetTabletPeers(&peers);
+  for (const auto& peer : peers) {
+    shared_ptr<tablet::Tablet> tablet = peer->shared_tablet();
+    if (!tablet) {
+      continue;
+    }
+    const master::TableQuotaPB* share = FindPtrOrNull(shares, tablet->metadata()->table_id());
+    if (share == nullptr) {
+      tablet->quota()->SetLimits(0, 0, 0, 0);
+    } else {
+      tablet->quota()->SetLimits(share->write_rows_per_sec(), share->write_bytes_per_sec(),
+                                 share->scan_rows_per_sec(), share->scan_bytes_per_sec());
+    }
+  }
+}
+
 void Heartbeater::Thread::RunThread() {
   CHECK(IsCurrentThread());
   VLOG(1) << Substitute("Heartbeat thread (master $0) starting",
@@ -586,5 +655,106 @@ void Heartbeater::Thread::GenerateFullTabletReport(TabletReportPB* report) {
   server_->tablet_manager()->PopulateFullTabletReport(report);
 }
 
+void Heartbeater::Thread::GenerateLoadReport(TSLoadPB* load) {
+  for (const string& dir : server_->fs_manager()->GetDataRootDirs()) {
+    int64_t bytes_free;
+    Status s = server_->fs_manager()->env()->GetBytesFree(dir, &bytes_free);
+    if (!s.ok()) {
+      KLOG_EVERY_N_SECS(WARNING, 60) << "Failed to get the free space of data directory "
+                                     << dir << ": " << s.ToString();
+      continue;
+    }
+    load->add_data_dir_free_bytes(bytes_free);
+  }
+
+  shared_ptr<MemTracker> root_tracker = MemTracker::GetRootTracker();
+  if (root_tracker->has_limit()) {
+    load->set_memory_usage_ratio(static_cast<double>(root_tracker->consumption()) /
+                                 root_tracker->limit());
+  }
+
+  const int max_busy_tablets = FLAGS_heartbeat_max_reported_busy_tablets;
+  int64_t rows_written = 0;
+  int64_t rows_scanned = 0;
+  unordered_map<string, TabletRowCounts> tablet_rows;
+  vector<shared_ptr<tablet::Tablet>> tablets;
+  vector<scoped_refptr<tablet::TabletPeer>> peers;
+  server_->tablet_manager()->GetTabletPeers(&peers);
+  for (const auto& peer : peers) {
+    shared_ptr<tablet::Tablet> tablet = peer->shared_tablet();
+    if (!tablet || !tablet->metrics()) {
+      continue;
+    }
+    const tablet::TabletMetrics* m = tablet->metrics();
+    int64_t written = m->rows_inserted->value() + m->rows_upserted->value() +
+        m->rows_updated->value() + m->rows_deleted->value();
+    int64_t scanned = m->scanner_rows_scanned->value();
+    rows_written += written;
+    rows_scanned += scanned;
+    if (max_busy_tablets > 0) {
+      tablet_rows[tablet->tablet_id()] = { written, scanned };
+      tablets.emplace_back(std::move(tablet));
+    }
+  }
+
+  MonoTime now = MonoTime::Now();
+  double secs = 0;
+  if (last_load_report_time_.Initialized()) {
+    secs = (now - last_load_report_time_).ToSeconds();
+    if (secs > 0) {
+      // The totals drop when tablets are deleted or moved away.
+      load->set_rows_written_per_sec(std::max<int64_t>(rows_written - last_rows_written_, 0) /
+                                     secs);
+      load->set_rows_scanned_per_sec(std::max<int64_t>(rows_scanned - last_rows_scanned_, 0) /
+                                     secs);
+    }
+  }
+
+  if (max_busy_tablets > 0) {
+    // The rates of the tablets which were already there at the last report,
+    // with the tablets which had writes since.
+    vector<std::pair<TabletLoadPB, tablet::Tablet*>> busy;
+    for (const auto& tablet : tablets) {
+      const TabletRowCounts& rows = FindOrDie(tablet_rows, tablet->tablet_id());
+      const TabletRowCounts* last = FindOrNull(last_tablet_rows_, tablet->tablet_id());
+      if (secs <= 0 || last == nullptr || rows.written <= last->written) {
+        continue;
+      }
+      TabletLoadPB tablet_load;
+      tablet_load.set_tablet_id(tablet->tablet_id());
+      tablet_load.set_rows_written_per_sec((rows.written - last->written) / secs);
+      tablet_load.set_rows_scanned_per_sec(std::max<int64_t>(rows.scanned - last->scanned, 0) /
+                                           secs);
+      busy.emplace_back(std::move(tablet_load), tablet.get());
+    }
+    const int num_reported = std::min<int>(max_busy_tablets, busy.size());
+    std::partial_sort(busy.begin(), busy.begin() + num_reported, busy.end(),
+                      [](const std::pair<TabletLoadPB, tablet::Tablet*>& a,
+                         const std::pair<TabletLoadPB, tablet::Tablet*>& b) {
+                        return a.first.rows_written_per_sec() > b.first.rows_written_per_sec();
+                      });
+    for (int i = 0; i < num_reported; i++) {
+      TabletLoadPB* tablet_load = load->add_busiest_tablets();
+      tablet_load->Swap(&busy[i].first);
+      vector<string> keys;
+      busy[i].second->TakeSampledWriteKeys(&keys);
+      for (string& key : keys) {
+        tablet_load->add_sampled_write_keys()->swap(key);
+      }
+    }
+    // The samples of the other tablets are dropped, so that every reported
+    // sample covers the writes since the previous report.
+    vector<string> keys;
+    for (const auto& tablet : tablets) {
+      tablet->TakeSampledWriteKeys(&keys);
+    }
+  }
+
+  last_rows_written_ = rows_written;
+  last_rows_scanned_ = rows_scanned;
+  last_tablet_rows_.swap(tablet_rows);
+  last_load_report_time_ = now;
+}
+
 } // namespace tserver
 } // namespace kudu
@@ -0,0 +1,346 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/scan_aggregator.h"
+
+#include <glog/logging.h>
+
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+using google::protobuf::RepeatedPtrField;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+namespace {
+
+// Rough per-value overhead of a ScanAggregateValuePB in a response.
+const int kValueOverheadBytes = 4;
+
+bool IsSummable(const TypeInfo* type_info) {
+  switch (type_info->type()) {
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+    case UINT8:
+    case UINT16:
+    case UINT32:
+    case UINT64:
+    case FLOAT:
+    case DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Encodes the cell at 'cell' like the values of ColumnPredicatePB.
+void EncodeCell(const TypeInfo* type_info, const void* cell, string* dst) {
+  if (type_info->physical_type() == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    dst->assign(reinterpret_cast<const char*>(s->data()), s->size());
+  } else {
+    dst->assign(reinterpret_cast<const char*>(cell), type_info->size());
+  }
+}
+
+void EncodeInt64(int64_t v, ScanAggregateValuePB* value) {
+  value->set_value(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void EncodeDouble(double v, ScanAggregateValuePB* value) {
+  value->set_value(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+} // anonymous namespace
+
+Status ScanAggregator::Create(const NewScanRequestPB& scan_pb,
+                              const Schema& client_projection,
+                              unique_ptr<ScanAggregator>* aggregator) {
+  vector<Aggregate> aggregates;
+  for (const ScanAggregatePB& agg_pb : scan_pb.aggregates()) {
+    Aggregate agg;
+    agg.function = agg_pb.function();
+    agg.col_idx = -1;
+    agg.type_info = nullptr;
+    agg.nullable = false;
+    switch (agg.function) {
+      case ScanAggregatePB::COUNT:
+      case ScanAggregatePB::SUM:
+      case ScanAggregatePB::MIN:
+      case ScanAggregatePB::MAX:
+        break;
+      default:
+        return Status::InvalidArgument("Unknown aggregate function",
+                                       ScanAggregatePB::Function_Name(agg.function));
+    }
+    if (agg_pb.has_column()) {
+      agg.col_idx = client_projection.find_column(agg_pb.column());
+      if (agg.col_idx == Schema::kColumnNotFound) {
+        return Status::InvalidArgument("Aggregated column is not in the projection",
+                                       agg_pb.column());
+      }
+      const ColumnSchema& col = client_projection.column(agg.col_idx);
+      agg.type_info = col.type_info();
+      agg.nullable = col.is_nullable();
+    } else if (agg.function != ScanAggregatePB::COUNT) {
+      return Status::InvalidArgument(
+          Substitute("$0 requires a column", ScanAggregatePB::Function_Name(agg.function)));
+    }
+    if (agg.function == ScanAggregatePB::SUM && !IsSummable(agg.type_info)) {
+      return Status::InvalidArgument(
+          Substitute("Cannot compute the SUM of column $0 of type $1",
+                     agg_pb.column(), agg.type_info->name()));
+    }
+    aggregates.push_back(agg);
+  }
+
+  vector<GroupByColumn> group_by;
+  for (const string& name : scan_pb.group_by_columns()) {
+    GroupByColumn col;
+    col.col_idx = client_projection.find_column(name);
+    if (col.col_idx == Schema::kColumnNotFound) {
+      return Status::InvalidArgument("GROUP BY column is not in the projection", name);
+    }
+    col.type_info = client_projection.column(col.col_idx).type_info();
+    col.nullable = client_projection.column(col.col_idx).is_nullable();
+    group_by.push_back(col);
+  }
+
+  aggregator->reset(new ScanAggregator(std::move(aggregates), std::move(group_by)));
+  return Status::OK();
+}
+
+ScanAggregator::ScanAggregator(vector<Aggregate> aggregates,
+                               vector<GroupByColumn> group_by)
+    : aggregates_(std::move(aggregates)),
+      group_by_(std::move(group_by)),
+      estimated_size_(0) {
+}
+
+ScanAggregator::~ScanAggregator() {
+}
+
+void ScanAggregator::AddBlock(const RowBlock& block) {
+  const SelectionVector* sel = block.selection_vector();
+  Group* single_group = nullptr;
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (!sel->IsRowSelected(i)) continue;
+
+    Group* group = single_group;
+    if (group == nullptr) {
+      group = FindOrCreateGroup(block, i);
+      if (group_by_.empty()) {
+        single_group = group;
+      }
+    }
+    group->num_rows++;
+
+    for (size_t j = 0; j < aggregates_.size(); j++) {
+      const Aggregate& agg = aggregates_[j];
+      AggregateState* state = &group->states[j];
+      if (agg.col_idx == -1) {
+        state->count++;
+        continue;
+      }
+      ColumnBlock col = block.column_block(agg.col_idx);
+      if (agg.nullable && col.is_null(i)) continue;
+      Update(agg, col.cell_ptr(i), state);
+    }
+  }
+}
+
+ScanAggregator::Group* ScanAggregator::FindOrCreateGroup(const RowBlock& block,
+                                                         size_t row_idx) {
+  key_buf_.clear();
+  for (const GroupByColumn& gcol : group_by_) {
+    ColumnBlock col = block.column_block(gcol.col_idx);
+    if (gcol.nullable && col.is_null(row_idx)) {
+      key_buf_.push_back('\0');
+      continue;
+    }
+    key_buf_.push_back('\1');
+    const uint8_t* cell = col.cell_ptr(row_idx);
+    if (gcol.type_info->physical_type() == BINARY) {
+      // Length-prefix variable length values to keep the keys unambiguous.
+      const Slice* s = reinterpret_cast<const Slice*>(cell);
+      uint32_t size = s->size();
+      key_buf_.append(reinterpret_cast<const char*>(&size), sizeof(size));
+      key_buf_.append(reinterpret_cast<const char*>(s->data()), s->size());
+    } else {
+      key_buf_.append(reinterpret_cast<const char*>(cell), gcol.type_info->size());
+    }
+  }
+
+  auto it = groups_.find(key_buf_);
+  if (PREDICT_TRUE(it != groups_.end())) {
+    return &it->second;
+  }
+
+  Group* group = CreateGroup();
+  for (size_t i = 0; i < group_by_.size(); i++) {
+    const GroupByColumn& gcol = group_by_[i];
+    ColumnBlock col = block.column_block(gcol.col_idx);
+    if (gcol.nullable && col.is_null(row_idx)) continue;
+    EncodeCell(gcol.type_info, col.cell_ptr(row_idx),
+               group->group_values[i].mutable_value());
+  }
+  return group;
+}
+
+ScanAggregator::Group* ScanAggregator::CreateGroup() {
+  Group* group = &groups_[key_buf_];
+  group->num_rows = 0;
+  group->states.resize(aggregates_.size());
+  group->group_values.resize(group_by_.size());
+  estimated_size_ += key_buf_.size() +
+      (group_by_.size() + aggregates_.size() + 1) * kValueOverheadBytes +
+      aggregates_.size() * sizeof(int64_t);
+  return group;
+}
+
+bool ScanAggregator::CountsRowsOnly() const {
+  if (!group_by_.empty()) {
+    return false;
+  }
+  for (const Aggregate& agg : aggregates_) {
+    if (agg.function != ScanAggregatePB::COUNT || agg.col_idx != -1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ScanAggregator::AddRowCount(int64_t num_rows) {
+  DCHECK(CountsRowsOnly());
+  if (num_rows == 0) {
+    // Like AddBlock(), don't create a group for no rows.
+    return;
+  }
+  key_buf_.clear();
+  auto it = groups_.find(key_buf_);
+  Group* group = it != groups_.end() ? &it->second : CreateGroup();
+  group->num_rows += num_rows;
+  for (AggregateState& state : group->states) {
+    state.count += num_rows;
+  }
+}
+
+void ScanAggregator::Update(const Aggregate& agg, const void* cell, AggregateState* state) {
+  switch (agg.function) {
+    case ScanAggregatePB::COUNT:
+      break;
+    case ScanAggregatePB::SUM:
+      switch (agg.type_info->physical_type()) {
+        case INT8: state->int_sum += *reinterpret_cast<const int8_t*>(cell); break;
+        case INT16: state->int_sum += *reinterpret_cast<const int16_t*>(cell); break;
+        case INT32: state->int_sum += *reinterpret_cast<const int32_t*>(cell); break;
+        case INT64: state->int_sum += *reinterpret_cast<const int64_t*>(cell); break;
+        case UINT8: state->int_sum += *reinterpret_cast<const uint8_t*>(cell); break;
+        case UINT16: state->int_sum += *reinterpret_cast<const uint16_t*>(cell); break;
+        case UINT32: state->int_sum += *reinterpret_cast<const uint32_t*>(cell); break;
+        case UINT64: state->int_sum += *reinterpret_cast<const uint64_t*>(cell); break;
+        case FLOAT: state->double_sum += *reinterpret_cast<const float*>(cell); break;
+        case DOUBLE: state->double_sum += *reinterpret_cast<const double*>(cell); break;
+        default: LOG(FATAL) << "Unexpected SUM type: " << agg.type_info->name();
+      }
+      break;
+    case ScanAggregatePB::MIN:
+    case ScanAggregatePB::MAX: {
+      if (state->count > 0) {
+        int cmp;
+        if (agg.type_info->physical_type() == BINARY) {
+          Slice extreme(state->extreme);
+          cmp = agg.type_info->Compare(cell, &extreme);
+        } else {
+          cmp = agg.type_info->Compare(cell, state->extreme.data());
+        }
+        if (agg.function == ScanAggregatePB::MIN ? cmp >= 0 : cmp <= 0) {
+          break;
+        }
+      }
+      EncodeCell(agg.type_info, cell, &state->extreme);
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unexpected aggregate function: " << agg.function;
+  }
+  state->count++;
+}
+
+void ScanAggregator::EncodeResult(const Aggregate& agg, const AggregateState& state,
+                                  ScanAggregateValuePB* value) {
+  if (agg.function == ScanAggregatePB::COUNT) {
+    EncodeInt64(state.count, value);
+    return;
+  }
+  if (state.count == 0) {
+    // Like SQL, the SUM, MIN and MAX of no values are NULL.
+    return;
+  }
+  switch (agg.function) {
+    case ScanAggregatePB::SUM:
+      if (agg.type_info->physical_type() == FLOAT ||
+          agg.type_info->physical_type() == DOUBLE) {
+        EncodeDouble(state.double_sum, value);
+      } else {
+        EncodeInt64(static_cast<int64_t>(state.int_sum), value);
+      }
+      break;
+    case ScanAggregatePB::MIN:
+    case ScanAggregatePB::MAX:
+      value->set_value(state.extreme);
+      break;
+    default:
+      LOG(FATAL) << "Unexpected aggregate function: " << agg.function;
+  }
+}
+
+int64_t ScanAggregator::EstimatedResultSize() const {
+  return estimated_size_;
+}
+
+void ScanAggregator::TakeResults(RepeatedPtrField<ScanAggregateGroupPB>* groups) {
+  groups->Reserve(groups->size() + groups_.size());
+  for (auto& e : groups_) {
+    Group& group = e.second;
+    ScanAggregateGroupPB* group_pb = groups->Add();
+    for (ScanAggregateValuePB& value : group.group_values) {
+      group_pb->add_group_values()->Swap(&value);
+    }
+    group_pb->set_num_rows(group.num_rows);
+    for (size_t i = 0; i < aggregates_.size(); i++) {
+      EncodeResult(aggregates_[i], group.states[i], group_pb->add_aggregate_values());
+    }
+  }
+  groups_.clear();
+  estimated_size_ = 0;
+}
+
+} // namespace tserver
+} // namespace kudu
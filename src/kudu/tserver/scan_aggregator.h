@@ -0,0 +1,147 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_SCAN_AGGREGATOR_H
+#define KUDU_TSERVER_SCAN_AGGREGATOR_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/tserver/tserver.pb.h"
+
+namespace kudu {
+
+class RowBlock;
+class Schema;
+class Status;
+class TypeInfo;
+
+namespace tserver {
+
+// Computes the aggregates of an aggregating scan (see NewScanRequestPB) over
+// the row blocks produced by the scan's iterator.
+//
+// Partial aggregates accumulate until they are moved into a response by
+// TakeResults(), so each response only covers the rows scanned to produce it.
+//
+// Not thread-safe: a scanner serves one request at a time.
+class ScanAggregator {
+ public:
+  // Validates the aggregates and GROUP BY columns of 'scan_pb' against the
+  // client's projection and creates an aggregator for them. The row blocks
+  // passed to AddBlock() must start with the columns of 'client_projection'.
+  static Status Create(const NewScanRequestPB& scan_pb,
+                       const Schema& client_projection,
+                       std::unique_ptr<ScanAggregator>* aggregator);
+
+  // Returns whether 'scan_pb' requests an aggregating scan.
+  static bool IsAggregatingScan(const NewScanRequestPB& scan_pb) {
+    return scan_pb.aggregates_size() > 0 || scan_pb.group_by_columns_size() > 0;
+  }
+
+  ~ScanAggregator();
+
+  // Folds the selected rows of 'block' into the partial aggregates.
+  void AddBlock(const RowBlock& block);
+
+  // Returns whether the only aggregates are COUNT(*) and there are no GROUP
+  // BY columns, so that the results only depend on the number of rows.
+  bool CountsRowsOnly() const;
+
+  // Folds 'num_rows' rows into the partial aggregates without reading them.
+  // Requires CountsRowsOnly().
+  void AddRowCount(int64_t num_rows);
+
+  // Returns an estimate of the size of the partial aggregates.
+  int64_t EstimatedResultSize() const;
+
+  // Moves the partial aggregates into 'groups' and resets them.
+  void TakeResults(google::protobuf::RepeatedPtrField<ScanAggregateGroupPB>* groups);
+
+ private:
+  // An aggregate bound to a column of the row blocks.
+  struct Aggregate {
+    ScanAggregatePB::Function function;
+    // The index of the aggregated column, or -1 for COUNT(*).
+    int col_idx;
+    const TypeInfo* type_info;
+    bool nullable;
+  };
+
+  // A GROUP BY column of the row blocks.
+  struct GroupByColumn {
+    int col_idx;
+    const TypeInfo* type_info;
+    bool nullable;
+  };
+
+  // The running state of one aggregate in one group.
+  struct AggregateState {
+    AggregateState() : count(0), int_sum(0), double_sum(0) {}
+
+    // The number of non-NULL values folded in.
+    int64_t count;
+    // Unsigned so that overflow wraps around.
+    uint64_t int_sum;
+    double double_sum;
+    // The current MIN or MAX, encoded like the cell; valid if count > 0.
+    std::string extreme;
+  };
+
+  struct Group {
+    std::vector<ScanAggregateValuePB> group_values;
+    int64_t num_rows;
+    std::vector<AggregateState> states;
+  };
+
+  ScanAggregator(std::vector<Aggregate> aggregates,
+                 std::vector<GroupByColumn> group_by);
+
+  // Returns the group of row 'row_idx' of 'block', creating it if needed.
+  Group* FindOrCreateGroup(const RowBlock& block, size_t row_idx);
+
+  // Creates the group for the key in 'key_buf_', without its GROUP BY values.
+  Group* CreateGroup();
+
+  // Folds the cell at 'cell' into 'state'.
+  static void Update(const Aggregate& agg, const void* cell, AggregateState* state);
+
+  // Encodes the result of 'agg' in 'state' into 'value'.
+  static void EncodeResult(const Aggregate& agg, const AggregateState& state,
+                           ScanAggregateValuePB* value);
+
+  const std::vector<Aggregate> aggregates_;
+  const std::vector<GroupByColumn> group_by_;
+
+  // Groups keyed by the encoded values of the GROUP BY columns.
+  std::unordered_map<std::string, Group> groups_;
+
+  // Reused to build group keys.
+  std::string key_buf_;
+
+  // Estimated encoded size of 'groups_'.
+  int64_t estimated_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanAggregator);
+};
+
+} // namespace tserver
+} // namespace kudu
+
+#endif // KUDU_TSERVER_SCAN_AGGREGATOR_H
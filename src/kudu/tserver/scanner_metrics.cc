@@ -24,6 +24,18 @@ METRIC_DEFINE_counter(server, scanners_expired,
                       kudu::MetricUnit::kScanners,
                       "Number of scanners that have expired since service start");
 
+METRIC_DEFINE_counter(server, scans_queued,
+                      "Scans Queued",
+                      kudu::MetricUnit::kScanners,
+                      "Number of scans which waited for other scans to finish before "
+                      "starting, because of the limits on concurrent scans or on their memory");
+
+METRIC_DEFINE_counter(server, scans_rejected,
+                      "Scans Rejected",
+                      kudu::MetricUnit::kScanners,
+                      "Number of scans which were rejected after waiting too long for "
+                      "other scans to finish");
+
 METRIC_DEFINE_histogram(server, scanner_duration,
                         "Scanner Duration",
                         kudu::MetricUnit::kMicroseconds,
@@ -37,6 +49,8 @@ namespace tserver {
 ScannerMetrics::ScannerMetrics(const scoped_refptr<MetricEntity>& metric_entity)
     : scanners_expired(
           METRIC_scanners_expired.Instantiate(metric_entity)),
+      scans_queued(METRIC_scans_queued.Instantiate(metric_entity)),
+      scans_rejected(METRIC_scans_rejected.Instantiate(metric_entity)),
       scanner_duration(METRIC_scanner_duration.Instantiate(metric_entity)) {
 }
 
@@ -41,6 +41,11 @@ struct ScannerMetrics {
   // expired since the start of service.
   scoped_refptr<Counter> scanners_expired;
 
+  // Keeps track of the number of scans which had to wait to be admitted,
+  // and of those which gave up waiting.
+  scoped_refptr<Counter> scans_queued;
+  scoped_refptr<Counter> scans_rejected;
+
   // Keeps track of the duration of scanners.
   scoped_refptr<Histogram> scanner_duration;
 };
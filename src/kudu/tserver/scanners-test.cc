@@ -16,14 +16,20 @@
 // under the License.
 #include "kudu/tserver/scanners.h"
 
+#include <memory>
+#include <thread>
 #include <vector>
 
 #include <gtest/gtest.h>
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/scanner_metrics.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(scanner_adaptive_batch_target_ms);
+DECLARE_int32(scanner_max_concurrent_scans);
 DECLARE_int32(scanner_ttl_ms);
 
 namespace kudu {
@@ -32,6 +38,7 @@ using tablet::TabletPeer;
 
 namespace tserver {
 
+using std::unique_ptr;
 using std::vector;
 
 TEST(ScannersTest, TestManager) {
@@ -81,5 +88,69 @@ TEST(ScannerTest, TestExpire) {
   ASSERT_EQ(s2->id(), active_scanners[0]->id());
 }
 
+TEST(ScannerTest, TestScanScheduler) {
+  FLAGS_scanner_max_concurrent_scans = 4;
+  auto scheduler = std::make_shared<ScanScheduler>(
+      MemTracker::CreateTracker(-1, "test-scanners"));
+  const MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(10);
+
+  // A single user may take all the slots.
+  vector<unique_ptr<ScanScheduler::Slot>> slots(4);
+  bool queued;
+  for (auto& slot : slots) {
+    ASSERT_OK(scheduler->Admit("a", MonoTime::Max(), &slot, &queued));
+    ASSERT_FALSE(queued);
+  }
+  unique_ptr<ScanScheduler::Slot> slot;
+  Status s = scheduler->Admit("a", deadline, &slot, &queued);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_TRUE(queued);
+
+  // Once a slot is released, a queued scan of another user takes it, and
+  // the first user is then held to its share of the slots.
+  CountDownLatch admitted(1);
+  unique_ptr<ScanScheduler::Slot> b_slot;
+  std::thread b([&]() {
+    bool b_queued;
+    CHECK_OK(scheduler->Admit("b", MonoTime::Max(), &b_slot, &b_queued));
+    admitted.CountDown();
+  });
+  while (scheduler->num_queued() == 0) {
+    SleepFor(MonoDelta::FromMilliseconds(1));
+  }
+  slots[0].reset();
+  admitted.Wait();
+  b.join();
+  ASSERT_EQ(4, scheduler->num_running());
+  slots[1].reset();
+  s = scheduler->Admit("a", MonoTime::Now() + MonoDelta::FromMilliseconds(10), &slot, &queued);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_OK(scheduler->Admit("b", MonoTime::Max(), &slot, &queued));
+  ASSERT_FALSE(queued);
+}
+
+TEST(ScannerTest, TestAdaptiveBatchSize) {
+  FLAGS_scanner_adaptive_batch_target_ms = 100;
+  scoped_refptr<TabletPeer> null_peer(nullptr);
+  ScannerManager mgr(nullptr);
+  SharedScanner scanner;
+  mgr.NewScanner(null_peer, "", &scanner);
+  const size_t kMaxBytes = 8 * 1024 * 1024;
+
+  // Before anything is recorded, the initial size is used.
+  ASSERT_EQ(1024 * 1024, scanner->AdaptiveBatchSizeBytes(1024 * 1024, kMaxBytes));
+
+  // At 1KB per ms, a response should take 100KB, unless the client is so
+  // quick to continue that a smaller one is cheap.
+  scanner->RecordBatch(10 * 1024, 100, MonoDelta::FromMilliseconds(10), MonoDelta());
+  ASSERT_EQ(100 * 1024, scanner->AdaptiveBatchSizeBytes(1024 * 1024, kMaxBytes));
+  scanner->RecordBatch(10 * 1024, 100, MonoDelta::FromMilliseconds(10),
+                       MonoDelta::FromMilliseconds(5));
+  ASSERT_EQ(50 * 1024, scanner->AdaptiveBatchSizeBytes(1024 * 1024, kMaxBytes));
+
+  // The size is bounded by the client's.
+  ASSERT_EQ(32 * 1024, scanner->AdaptiveBatchSizeBytes(1024 * 1024, 32 * 1024));
+}
+
 } // namespace tserver
 } // namespace kudu
@@ -16,16 +16,25 @@
 // under the License.
 #include "kudu/tserver/scanners.h"
 
+#include <algorithm>
+#include <limits>
+#include <boost/bind.hpp>
 #include <gflags/gflags.h>
 #include <mutex>
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/common/schema.h"
 #include "kudu/gutil/hash/string_hash.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/tserver/scanner_metrics.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/thread.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/metrics.h"
 
 DEFINE_int32(scanner_ttl_ms, 60000,
@@ -35,6 +44,39 @@ TAG_FLAG(scanner_ttl_ms, advanced);
 DEFINE_int32(scanner_gc_check_interval_us, 5 * 1000L *1000L, // 5 seconds
              "Number of microseconds in the interval at which we remove expired scanners");
 TAG_FLAG(scanner_gc_check_interval_us, hidden);
+DEFINE_int32(scanner_prefetch_threads, 0,
+             "The number of threads which prefetch rows for scanners. If 0, uses the "
+             "number of CPUs.");
+TAG_FLAG(scanner_prefetch_threads, experimental);
+
+DEFINE_int32(scanner_max_concurrent_scans, 0,
+             "The maximum number of scans which may run at once on the tablet server. "
+             "Further scans wait for a running scan to finish, and the running scans "
+             "are shared fairly among the users scanning. If 0, the number of scans "
+             "is unlimited.");
+TAG_FLAG(scanner_max_concurrent_scans, experimental);
+TAG_FLAG(scanner_max_concurrent_scans, runtime);
+
+DEFINE_int64(scanner_memory_limit_mb, -1,
+             "The limit on the memory used by scanners for buffered rows. While it is "
+             "exceeded, rows are no longer prefetched and new scans wait for running "
+             "scans to finish. If -1, the memory is unlimited.");
+TAG_FLAG(scanner_memory_limit_mb, experimental);
+
+DEFINE_int32(scanner_admission_max_wait_ms, 5000,
+             "The longest time a new scan waits for other scans to finish before it is "
+             "rejected as throttled, to be retried by the client.");
+TAG_FLAG(scanner_admission_max_wait_ms, experimental);
+TAG_FLAG(scanner_admission_max_wait_ms, runtime);
+
+DEFINE_int32(scanner_adaptive_batch_target_ms, 100,
+             "With --scanner_adaptive_batch_size, the time which each response of a "
+             "scan should take to produce, at most. Responses are kept shorter if the "
+             "client continues the scan quickly.");
+TAG_FLAG(scanner_adaptive_batch_target_ms, experimental);
+TAG_FLAG(scanner_adaptive_batch_target_ms, runtime);
+
+DECLARE_int32(scanner_batch_size_rows);
 
 // TODO: would be better to scope this at a tablet level instead of
 // server level.
@@ -45,13 +87,125 @@ METRIC_DEFINE_gauge_size(server, active_scanners,
 
 namespace kudu {
 
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using strings::Substitute;
 using tablet::TabletPeer;
 
 namespace tserver {
 
-ScannerManager::ScannerManager(const scoped_refptr<MetricEntity>& metric_entity)
+ScanScheduler::Slot::~Slot() {
+  scheduler_->Release(user_);
+}
+
+ScanScheduler::ScanScheduler(shared_ptr<MemTracker> mem_tracker)
+    : mem_tracker_(std::move(mem_tracker)),
+      cond_(&lock_),
+      num_running_(0),
+      num_queued_(0) {
+}
+
+Status ScanScheduler::Admit(const string& user, const MonoTime& deadline,
+                            unique_ptr<Slot>* slot, bool* queued) {
+  // Memory freed by running scans isn't signaled, so queued scans recheck
+  // it periodically.
+  static const MonoDelta kMaxWait = MonoDelta::FromMilliseconds(100);
+
+  MutexLock l(lock_);
+  UserScans& scans = users_[user];
+  scans.queued++;
+  num_queued_++;
+  *queued = false;
+  while (!CanAdmitUnlocked(user)) {
+    *queued = true;
+    MonoTime now = MonoTime::Now();
+    if (now >= deadline) {
+      scans.queued--;
+      num_queued_--;
+      if (scans.running == 0 && scans.queued == 0) {
+        users_.erase(user);
+      }
+      // The fair shares of the other users may have grown.
+      cond_.Broadcast();
+      return Status::ServiceUnavailable(
+          Substitute("Rejecting scan: $0 scans running, $1 queued", num_running_, num_queued_));
+    }
+    cond_.TimedWait(std::min(deadline - now, kMaxWait));
+  }
+  scans.queued--;
+  scans.running++;
+  num_queued_--;
+  num_running_++;
+  slot->reset(new Slot(shared_from_this(), user));
+  return Status::OK();
+}
+
+bool ScanScheduler::CanAdmitUnlocked(const string& user) const {
+  // The memory is only used by running scans, so a scan is admitted if none
+  // are running, whatever the memory.
+  if (num_running_ == 0) {
+    return true;
+  }
+  if (mem_tracker_->LimitExceeded()) {
+    return false;
+  }
+  const int max_scans = FLAGS_scanner_max_concurrent_scans;
+  if (max_scans <= 0) {
+    return true;
+  }
+  if (num_running_ >= max_scans) {
+    return false;
+  }
+  const int running = FindOrDie(users_, user).running;
+  if (running >= std::max<int>(1, max_scans / users_.size())) {
+    return false;
+  }
+  // Let the queued scans of users with fewer running scans go first.
+  for (const auto& e : users_) {
+    if (e.second.queued > 0 && e.second.running < running) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ScanScheduler::Release(const string& user) {
+  MutexLock l(lock_);
+  UserScans& scans = FindOrDie(users_, user);
+  scans.running--;
+  num_running_--;
+  if (scans.running == 0 && scans.queued == 0) {
+    users_.erase(user);
+  }
+  cond_.Broadcast();
+}
+
+int ScanScheduler::num_running() const {
+  MutexLock l(lock_);
+  return num_running_;
+}
+
+int ScanScheduler::num_queued() const {
+  MutexLock l(lock_);
+  return num_queued_;
+}
+
+ScannerManager::ScannerManager(const scoped_refptr<MetricEntity>& metric_entity,
+                               const shared_ptr<MemTracker>& parent_mem_tracker)
     : shutdown_(false),
-      shutdown_cv_(&shutdown_lock_) {
+      shutdown_cv_(&shutdown_lock_),
+      scan_mem_tracker_(MemTracker::CreateTracker(
+          FLAGS_scanner_memory_limit_mb > 0 ? FLAGS_scanner_memory_limit_mb * 1024 * 1024 : -1,
+          "scanners", parent_mem_tracker)),
+      prefetch_mem_tracker_(MemTracker::CreateTracker(-1, "scanner-prefetch",
+                                                      scan_mem_tracker_)),
+      scan_scheduler_(std::make_shared<ScanScheduler>(scan_mem_tracker_)) {
+  CHECK_OK(ThreadPoolBuilder("scanner-prefetch")
+           .set_min_threads(0)
+           .set_max_threads(FLAGS_scanner_prefetch_threads > 0 ?
+                            FLAGS_scanner_prefetch_threads : base::NumCPUs())
+           .Build(&prefetch_pool_));
   if (metric_entity) {
     metrics_.reset(new ScannerMetrics(metric_entity));
     METRIC_active_scanners.InstantiateFunctionGauge(
@@ -73,6 +227,7 @@ ScannerManager::~ScannerManager() {
   if (removal_thread_.get() != nullptr) {
     CHECK_OK(ThreadJoiner(removal_thread_.get()).Join());
   }
+  prefetch_pool_->Shutdown();
   STLDeleteElements(&scanner_maps_);
 }
 
@@ -112,7 +267,8 @@ void ScannerManager::NewScanner(const scoped_refptr<TabletPeer>& tablet_peer,
     // probably generate random numbers instead, since we can safely
     // just retry until we avoid a collision.
     string id = oid_generator_.Next();
-    scanner->reset(new Scanner(id, tablet_peer, requestor_string, metrics_.get()));
+    scanner->reset(new Scanner(id, tablet_peer, requestor_string, metrics_.get(),
+                               prefetch_mem_tracker_));
 
     ScannerMapStripe& stripe = GetStripeByScannerId(id);
     std::lock_guard<RWMutex> l(stripe.lock_);
@@ -120,6 +276,24 @@ void ScannerManager::NewScanner(const scoped_refptr<TabletPeer>& tablet_peer,
   }
 }
 
+Status ScannerManager::AdmitScan(Scanner* scanner, const string& user,
+                                 const MonoTime& deadline) {
+  MonoTime max_deadline = MonoTime::Now() +
+      MonoDelta::FromMilliseconds(FLAGS_scanner_admission_max_wait_ms);
+  bool queued;
+  Status s = scan_scheduler_->Admit(user, std::min(deadline, max_deadline),
+                                    &scanner->scan_slot_, &queued);
+  if (metrics_) {
+    if (queued) {
+      metrics_->scans_queued->Increment();
+    }
+    if (!s.ok()) {
+      metrics_->scans_rejected->Increment();
+    }
+  }
+  return s;
+}
+
 bool ScannerManager::LookupScanner(const string& scanner_id, SharedScanner* scanner) {
   ScannerMapStripe& stripe = GetStripeByScannerId(scanner_id);
   shared_lock<RWMutex> l(stripe.lock_);
@@ -177,14 +351,59 @@ void ScannerManager::RemoveExpiredScanners() {
   }
 }
 
+void ScannerManager::PrefetchAsync(const SharedScanner& scanner,
+                                   size_t rows_per_block,
+                                   int64_t max_bytes) {
+  scanner->StartPrefetch();
+  // The task holds a reference to the scanner until it is done.
+  Status s = prefetch_pool_->SubmitFunc(
+      boost::bind(&Scanner::Prefetch, scanner, rows_per_block, max_bytes));
+  if (PREDICT_FALSE(!s.ok())) {
+    VLOG(1) << "Unable to prefetch rows for scanner " << scanner->id() << ": " << s.ToString();
+    scanner->StopPrefetch();
+  }
+}
+
+Scanner::PrefetchedBlock::PrefetchedBlock(const Schema& schema, size_t nrows,
+                                          shared_ptr<MemTracker> mem_tracker)
+    : arena_(32 * 1024, 1 * 1024 * 1024),
+      block_(new RowBlock(schema, nrows, &arena_)),
+      mem_tracker_(std::move(mem_tracker)),
+      tracked_bytes_(0) {
+}
+
+Scanner::PrefetchedBlock::~PrefetchedBlock() {
+  if (mem_tracker_) {
+    mem_tracker_->Release(tracked_bytes_);
+  }
+}
+
+void Scanner::PrefetchedBlock::TrackMemory() {
+  DCHECK_EQ(0, tracked_bytes_);
+  tracked_bytes_ = arena_.memory_footprint() +
+      block_->row_capacity() * block_->schema().byte_size();
+  mem_tracker_->Consume(tracked_bytes_);
+}
+
 Scanner::Scanner(string id, const scoped_refptr<TabletPeer>& tablet_peer,
-                 string requestor_string, ScannerMetrics* metrics)
+                 string requestor_string, ScannerMetrics* metrics,
+                 shared_ptr<MemTracker> prefetch_mem_tracker)
     : id_(std::move(id)),
       tablet_peer_(tablet_peer),
       requestor_string_(std::move(requestor_string)),
       call_seq_id_(0),
       start_time_(MonoTime::Now()),
       metrics_(metrics),
+      cpu_time_us_(0),
+      row_format_flags_(0),
+      prefetch_mem_tracker_(std::move(prefetch_mem_tracker)),
+      prefetch_cond_(&prefetch_lock_),
+      prefetching_(false),
+      stop_prefetch_(false),
+      prefetched_bytes_(0),
+      bytes_per_us_(0),
+      bytes_per_row_(0),
+      continuation_delay_us_(-1),
       arena_(1024, 1024 * 1024) {
   UpdateAccessTime();
 }
@@ -216,6 +435,131 @@ void Scanner::GetIteratorStats(vector<IteratorStats>* stats) const {
   iter_->GetIteratorStats(stats);
 }
 
+size_t Scanner::AdaptiveBatchSizeBytes(size_t initial_bytes, size_t max_bytes) const {
+  // Responses are no smaller than this, so that very fast scans don't take
+  // many tiny requests.
+  static const size_t kMinBatchBytes = 16 * 1024;
+  // Responses should take this many times as long to produce as the client
+  // takes to continue, which keeps the per-request overhead around 10%.
+  static const double kContinuationFactor = 10;
+
+  if (bytes_per_us_ == 0) {
+    return std::min(initial_bytes, max_bytes);
+  }
+  double target_us = FLAGS_scanner_adaptive_batch_target_ms * 1000;
+  if (continuation_delay_us_ >= 0) {
+    target_us = std::min(target_us, kContinuationFactor * continuation_delay_us_);
+  }
+  double bytes = bytes_per_us_ * target_us;
+  return std::min<size_t>(max_bytes, std::max<double>(kMinBatchBytes, bytes));
+}
+
+size_t Scanner::AdaptiveBlockRows() const {
+  static const size_t kMaxBlockRows = 4096;
+  static const int kBlocksPerBatch = 8;
+
+  const size_t min_rows = FLAGS_scanner_batch_size_rows;
+  if (bytes_per_row_ == 0) {
+    return min_rows;
+  }
+  size_t rows = AdaptiveBatchSizeBytes(0, std::numeric_limits<size_t>::max()) /
+      (kBlocksPerBatch * bytes_per_row_);
+  return std::max(min_rows, std::min(rows, kMaxBlockRows));
+}
+
+void Scanner::RecordBatch(int64_t bytes, int64_t rows, const MonoDelta& elapsed,
+                          const MonoDelta& continuation_delay) {
+  // The weight of the latest response in the averages.
+  static const double kAlpha = 0.5;
+
+  if (bytes <= 0 || rows <= 0) {
+    return;
+  }
+  double bytes_per_us = static_cast<double>(bytes) / std::max<int64_t>(1, elapsed.ToMicroseconds());
+  double bytes_per_row = static_cast<double>(bytes) / rows;
+  if (bytes_per_us_ == 0) {
+    bytes_per_us_ = bytes_per_us;
+    bytes_per_row_ = bytes_per_row;
+  } else {
+    bytes_per_us_ += kAlpha * (bytes_per_us - bytes_per_us_);
+    bytes_per_row_ += kAlpha * (bytes_per_row - bytes_per_row_);
+  }
+  if (continuation_delay.Initialized()) {
+    double delay_us = continuation_delay.ToMicroseconds();
+    continuation_delay_us_ = continuation_delay_us_ < 0 ?
+        delay_us : continuation_delay_us_ + kAlpha * (delay_us - continuation_delay_us_);
+  }
+}
+
+void Scanner::StartPrefetch() {
+  MutexLock l(prefetch_lock_);
+  DCHECK(!prefetching_);
+  prefetching_ = true;
+  stop_prefetch_ = false;
+}
+
+void Scanner::Prefetch(size_t rows_per_block, int64_t max_bytes) {
+  RowwiseIterator* iter = iter_.get();
+  Status s;
+  while (true) {
+    {
+      MutexLock l(prefetch_lock_);
+      if (stop_prefetch_ || prefetched_bytes_ >= max_bytes) {
+        break;
+      }
+    }
+    if (!iter->HasNext()) {
+      break;
+    }
+    unique_ptr<PrefetchedBlock> block(
+        new PrefetchedBlock(iter->schema(), rows_per_block, prefetch_mem_tracker_));
+    s = iter->NextBlock(block->block());
+    if (PREDICT_FALSE(!s.ok())) {
+      break;
+    }
+    block->TrackMemory();
+    MutexLock l(prefetch_lock_);
+    prefetched_bytes_ += block->tracked_bytes();
+    prefetched_blocks_.emplace_back(std::move(block));
+    if (prefetch_mem_tracker_->AnyLimitExceeded()) {
+      break;
+    }
+  }
+
+  MutexLock l(prefetch_lock_);
+  prefetch_status_ = s;
+  prefetching_ = false;
+  prefetch_cond_.Broadcast();
+}
+
+void Scanner::StopPrefetch() {
+  MutexLock l(prefetch_lock_);
+  stop_prefetch_ = true;
+  while (prefetching_) {
+    prefetch_cond_.Wait();
+  }
+}
+
+Status Scanner::TakePrefetchedBlock(unique_ptr<PrefetchedBlock>* block) {
+  MutexLock l(prefetch_lock_);
+  DCHECK(!prefetching_);
+  if (prefetched_blocks_.empty()) {
+    block->reset();
+    Status s = prefetch_status_;
+    prefetch_status_ = Status::OK();
+    return s;
+  }
+  *block = std::move(prefetched_blocks_.front());
+  prefetched_blocks_.pop_front();
+  prefetched_bytes_ -= (*block)->tracked_bytes();
+  return Status::OK();
+}
+
+bool Scanner::HasPrefetchedData() const {
+  MutexLock l(prefetch_lock_);
+  return !prefetched_blocks_.empty() || !prefetch_status_.ok();
+}
+
 
 } // namespace tserver
 } // namespace kudu
@@ -17,6 +17,7 @@
 #ifndef KUDU_TSERVER_SCANNERS_H
 #define KUDU_TSERVER_SCANNERS_H
 
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -29,31 +30,107 @@
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tablet/tablet_peer.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/condition_variable.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/oid_generator.h"
 #include "kudu/util/rw_mutex.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 
+class MemTracker;
 class MetricEntity;
+class RowBlock;
 class RowwiseIterator;
 class ScanSpec;
 class Schema;
-class Status;
 class Thread;
+class ThreadPool;
 
 struct IteratorStats;
 
 namespace tserver {
 
+class ScanAggregator;
+class ScanScheduler;
 class Scanner;
 struct ScannerMetrics;
 typedef std::shared_ptr<Scanner> SharedScanner;
 
+// Limits the scans running at once on a tablet server, so that a spike of
+// scans can't use up the memory which writes need.
+//
+// Each scan holds a slot from the time it starts until its scanner is
+// destroyed. A scan is queued while --scanner_max_concurrent_scans scans are
+// running, or while the memory tracked by the scanners exceeds its limit,
+// until a slot frees up or its deadline passes.
+//
+// The slots are shared fairly among users: each user may hold at most the
+// limit divided by the number of users with running or queued scans, and
+// the queued scans of the users holding the fewest slots are admitted
+// first.
+class ScanScheduler : public std::enable_shared_from_this<ScanScheduler> {
+ public:
+  // A slot held by an admitted scan, which is released when destroyed.
+  class Slot {
+   public:
+    ~Slot();
+
+   private:
+    friend class ScanScheduler;
+    Slot(std::shared_ptr<ScanScheduler> scheduler, std::string user)
+        : scheduler_(std::move(scheduler)),
+          user_(std::move(user)) {
+    }
+
+    const std::shared_ptr<ScanScheduler> scheduler_;
+    const std::string user_;
+
+    DISALLOW_COPY_AND_ASSIGN(Slot);
+  };
+
+  // Scans are not admitted while 'mem_tracker' exceeds its limit.
+  explicit ScanScheduler(std::shared_ptr<MemTracker> mem_tracker);
+
+  // Admits a scan of 'user', waiting until 'deadline' for a slot if
+  // necessary, in which case 'queued' is set. Returns ServiceUnavailable if
+  // no slot freed up in time.
+  Status Admit(const std::string& user, const MonoTime& deadline,
+               std::unique_ptr<Slot>* slot, bool* queued);
+
+  int num_running() const;
+  int num_queued() const;
+
+ private:
+  struct UserScans {
+    int running = 0;
+    int queued = 0;
+  };
+
+  // Returns whether a queued scan of 'user' may run now.
+  bool CanAdmitUnlocked(const std::string& user) const;
+
+  void Release(const std::string& user);
+
+  const std::shared_ptr<MemTracker> mem_tracker_;
+
+  // Protects the state below.
+  mutable Mutex lock_;
+  // Signaled when a slot is released, or a queued scan gives up.
+  ConditionVariable cond_;
+  // The users with running or queued scans.
+  std::unordered_map<std::string, UserScans> users_;
+  int num_running_;
+  int num_queued_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanScheduler);
+};
+
 // Manages the live scanners within a Tablet Server.
 //
 // When a scanner is created by a client, it is assigned a unique scanner ID.
@@ -64,7 +141,12 @@ typedef std::shared_ptr<Scanner> SharedScanner;
 // removes any scanners which have not been accessed since a configurable TTL.
 class ScannerManager {
  public:
-  explicit ScannerManager(const scoped_refptr<MetricEntity>& metric_entity);
+  // If 'parent_mem_tracker' is set, the memory used by the scanners' prefetched
+  // rows is tracked under it. Otherwise, it is tracked under the root tracker.
+  // The scanners' tracker is limited to --scanner_memory_limit_mb.
+  explicit ScannerManager(const scoped_refptr<MetricEntity>& metric_entity,
+                          const std::shared_ptr<MemTracker>& parent_mem_tracker =
+                              std::shared_ptr<MemTracker>());
   ~ScannerManager();
 
   // Starts the expired scanner removal thread.
@@ -75,6 +157,13 @@ class ScannerManager {
                   const std::string& requestor_string,
                   SharedScanner* scanner);
 
+  // Admits the scan of 'scanner', on behalf of 'user', to run, waiting for
+  // a slot until 'deadline' or --scanner_admission_max_wait_ms have passed.
+  // The scanner holds the slot until it is destroyed. See ScanScheduler.
+  Status AdmitScan(Scanner* scanner, const std::string& user, const MonoTime& deadline);
+
+  const std::shared_ptr<ScanScheduler>& scan_scheduler() const { return scan_scheduler_; }
+
   // Lookup the given scanner by its ID.
   // Returns true if the scanner is found successfully.
   bool LookupScanner(const std::string& scanner_id, SharedScanner* scanner);
@@ -96,6 +185,11 @@ class ScannerManager {
   // Iterate through scanners and remove any which are past their TTL.
   void RemoveExpiredScanners();
 
+  // Starts reading blocks of 'rows_per_block' rows from the iterator of
+  // 'scanner' ahead of its next request, until at least 'max_bytes' of rows
+  // are buffered. See Scanner::Prefetch().
+  void PrefetchAsync(const SharedScanner& scanner, size_t rows_per_block, int64_t max_bytes);
+
  private:
   FRIEND_TEST(ScannerTest, TestExpire);
 
@@ -136,6 +230,16 @@ class ScannerManager {
   // Thread to remove expired scanners.
   scoped_refptr<kudu::Thread> removal_thread_;
 
+  // Tracks the memory used by the scanners, and its child the memory used by
+  // their prefetched rows.
+  std::shared_ptr<MemTracker> scan_mem_tracker_;
+  std::shared_ptr<MemTracker> prefetch_mem_tracker_;
+
+  std::shared_ptr<ScanScheduler> scan_scheduler_;
+
+  // Threads which prefetch rows for the scanners.
+  gscoped_ptr<ThreadPool> prefetch_pool_;
+
   FunctionGaugeDetacher metric_detacher_;
 
   DISALLOW_COPY_AND_ASSIGN(ScannerManager);
@@ -167,9 +271,37 @@ class ScopedUnregisterScanner {
 // An open scanner on the server side.
 class Scanner {
  public:
+  // A block of rows read from the iterator ahead of the request which
+  // returns it, or kept until the response referencing it is sent. Its memory
+  // is tracked until it is destroyed, if it has a 'mem_tracker'.
+  class PrefetchedBlock {
+   public:
+    PrefetchedBlock(const Schema& schema, size_t nrows,
+                    std::shared_ptr<MemTracker> mem_tracker);
+    ~PrefetchedBlock();
+
+    RowBlock* block() { return block_.get(); }
+
+    // Starts tracking the memory used by the block's rows.
+    void TrackMemory();
+
+    // Returns the tracked memory of the block.
+    int64_t tracked_bytes() const { return tracked_bytes_; }
+
+   private:
+    Arena arena_;
+    gscoped_ptr<RowBlock> block_;
+    const std::shared_ptr<MemTracker> mem_tracker_;
+    int64_t tracked_bytes_;
+
+    DISALLOW_COPY_AND_ASSIGN(PrefetchedBlock);
+  };
+
+  // The memory of prefetched rows is tracked by 'prefetch_mem_tracker'.
   explicit Scanner(std::string id,
                    const scoped_refptr<tablet::TabletPeer>& tablet_peer,
-                   std::string requestor_string, ScannerMetrics* metrics);
+                   std::string requestor_string, ScannerMetrics* metrics,
+                   std::shared_ptr<MemTracker> prefetch_mem_tracker);
   ~Scanner();
 
   // Attach an actual iterator and a ScanSpec to this Scanner.
@@ -262,9 +394,65 @@ class Scanner {
   // See the note about 'set_client_projection_schema' above.
   const Schema* client_projection_schema() const { return client_projection_schema_.get(); }
 
+  // Sets the aggregator of an aggregating scan.
+  void set_aggregator(std::shared_ptr<ScanAggregator> aggregator) {
+    aggregator_ = std::move(aggregator);
+  }
+
+  // Returns the aggregator of an aggregating scan, or NULL if the scan
+  // returns rows.
+  const std::shared_ptr<ScanAggregator>& aggregator() const { return aggregator_; }
+
+  // Sets the RowFormatFlags of the scan's responses.
+  void set_row_format_flags(uint64_t row_format_flags) {
+    row_format_flags_ = row_format_flags;
+  }
+
+  uint64_t row_format_flags() const { return row_format_flags_; }
+
   // Get per-column stats for each iterator.
   void GetIteratorStats(std::vector<IteratorStats>* stats) const;
 
+  // Marks the scanner as prefetching. Must be followed by a call to Prefetch().
+  void StartPrefetch();
+
+  // Reads blocks of 'rows_per_block' rows from the iterator, ahead of the next
+  // request, until at least 'max_bytes' of rows are buffered, the prefetched
+  // memory exceeds a limit, the iterator is exhausted, or StopPrefetch() is
+  // called. A read error is returned by TakePrefetchedBlock().
+  void Prefetch(size_t rows_per_block, int64_t max_bytes);
+
+  // Asks an in-progress prefetch to stop after its current block and waits
+  // for it. Must be called by a request before it uses the iterator.
+  void StopPrefetch();
+
+  // Moves the oldest prefetched block into 'block', or resets it if no blocks
+  // are left. Returns the error which stopped the prefetch, once its blocks
+  // have been taken.
+  Status TakePrefetchedBlock(std::unique_ptr<PrefetchedBlock>* block);
+
+  // Returns whether there are prefetched blocks, or a prefetch error, left to
+  // be taken.
+  bool HasPrefetchedData() const;
+
+  // Returns the size in bytes to aim for in the next response of the scan,
+  // at most 'max_bytes', sized to take about as long to produce as
+  // --scanner_adaptive_batch_target_ms, or less if the client continues the
+  // scan quickly enough that a smaller response doesn't add much per-request
+  // overhead. Before the first response is recorded, returns 'initial_bytes'.
+  size_t AdaptiveBatchSizeBytes(size_t initial_bytes, size_t max_bytes) const;
+
+  // Returns the number of rows to read from the iterator at a time, so that
+  // a response takes a handful of blocks.
+  size_t AdaptiveBlockRows() const;
+
+  // Records that a response of 'bytes' bytes and 'rows' rows took 'elapsed'
+  // to produce, and that the client continued the scan 'continuation_delay'
+  // after the previous response. The delay is uninitialized for the first
+  // response of a scan.
+  void RecordBatch(int64_t bytes, int64_t rows, const MonoDelta& elapsed,
+                   const MonoDelta& continuation_delay);
+
   const IteratorStats& already_reported_stats() const {
     return already_reported_stats_;
   }
@@ -272,9 +460,17 @@ class Scanner {
     already_reported_stats_ = stats;
   }
 
+  // The CPU time spent by the requests of this scan, in microseconds.
+  int64_t cpu_time_us() const { return cpu_time_us_.Load(); }
+  void AddCpuTime(int64_t cpu_us) { cpu_time_us_.IncrementBy(cpu_us); }
+
  private:
   friend class ScannerManager;
 
+  // The slot the scan was admitted with, if any. Declared first, so that it
+  // is released after the iterator and the buffered rows are destroyed.
+  std::unique_ptr<ScanScheduler::Slot> scan_slot_;
+
   // The unique ID of this scanner.
   const std::string id_;
 
@@ -305,6 +501,8 @@ class Scanner {
   // as the scanner proceeds.
   IteratorStats already_reported_stats_;
 
+  AtomicInt<int64_t> cpu_time_us_;
+
   // The spec used by 'iter_'
   gscoped_ptr<ScanSpec> spec_;
 
@@ -314,6 +512,34 @@ class Scanner {
 
   gscoped_ptr<RowwiseIterator> iter_;
 
+  // Set for aggregating scans.
+  std::shared_ptr<ScanAggregator> aggregator_;
+
+  // A bitset of RowFormatFlags.
+  uint64_t row_format_flags_;
+
+  const std::shared_ptr<MemTracker> prefetch_mem_tracker_;
+
+  // Protects the prefetch state below.
+  mutable Mutex prefetch_lock_;
+  // Signaled when a prefetch finishes.
+  ConditionVariable prefetch_cond_;
+  // Set while rows are being prefetched.
+  bool prefetching_;
+  // Set to ask an in-progress prefetch to stop.
+  bool stop_prefetch_;
+  // The error which stopped the last prefetch.
+  Status prefetch_status_;
+  // Blocks read ahead of the next request, oldest first.
+  std::deque<std::unique_ptr<PrefetchedBlock>> prefetched_blocks_;
+  int64_t prefetched_bytes_;
+
+  // Adaptive batch sizing state, see AdaptiveBatchSizeBytes(). Averages of
+  // the observed rates, or 0 (-1 for the delay) before any are recorded.
+  double bytes_per_us_;
+  double bytes_per_row_;
+  double continuation_delay_us_;
+
   AutoReleasePool autorelease_pool_;
 
   // Arena used for allocations which must last as long as the scanner
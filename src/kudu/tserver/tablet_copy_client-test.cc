@@ -16,12 +16,17 @@
 // under the License.
 #include "kudu/tserver/tablet_copy-test-base.h"
 
+#include <gflags/gflags.h>
+
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/gutil/strings/fastmem.h"
 #include "kudu/tablet/tablet_bootstrap.h"
 #include "kudu/tserver/tablet_copy_client.h"
 #include "kudu/util/env_util.h"
 
+DECLARE_bool(tablet_copy_resume);
+DECLARE_int32(tablet_copy_download_threads);
+
 using std::shared_ptr;
 
 namespace kudu {
@@ -234,6 +239,49 @@ TEST_F(TabletCopyClientTest, TestDownloadAllBlocks) {
   }
 }
 
+// Test that downloading the blocks with several threads rewrites all of
+// them in the new superblock.
+TEST_F(TabletCopyClientTest, TestDownloadAllBlocksInParallel) {
+  FLAGS_tablet_copy_download_threads = 4;
+  ASSERT_OK(client_->DownloadBlocks());
+
+  vector<BlockId> old_data_blocks = GetAllSortedBlocks(*client_->old_superblock_);
+  vector<BlockId> new_data_blocks = GetAllSortedBlocks(*client_->superblock_);
+  ASSERT_EQ(old_data_blocks.size(), new_data_blocks.size());
+  for (const BlockId& block_id : old_data_blocks) {
+    gscoped_ptr<fs::ReadableBlock> block;
+    Status s = fs_manager_->OpenBlock(block_id, &block);
+    ASSERT_TRUE(s.IsNotFound()) << "Expected block not found: " << s.ToString();
+  }
+  for (const BlockId& block_id : new_data_blocks) {
+    gscoped_ptr<fs::ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  }
+}
+
+// Test that a copy of the tablet reuses the blocks downloaded by the previous,
+// aborted, copy from the same source.
+TEST_F(TabletCopyClientTest, TestResumeAbortedCopy) {
+  FLAGS_tablet_copy_resume = true;
+  ASSERT_OK(client_->DownloadBlocks());
+  vector<BlockId> downloaded_blocks = GetAllSortedBlocks(*client_->superblock_);
+  ASSERT_OK(client_->Abort());
+  ASSERT_EQ(tablet::TABLET_DATA_TOMBSTONED, meta_->tablet_data_state());
+  ASSERT_EQ(downloaded_blocks.size(), meta_->tablet_copy_progress().blocks_size());
+  for (const BlockId& block_id : downloaded_blocks) {
+    gscoped_ptr<fs::ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  }
+
+  HostPort host_port;
+  ASSERT_OK(HostPortFromPB(leader_.last_known_addr(), &host_port));
+  TabletCopyClient client(GetTabletId(), fs_manager_.get(), messenger_);
+  ASSERT_OK(client.SetTabletToReplace(meta_, 0));
+  ASSERT_OK(client.Start(host_port, &meta_));
+  ASSERT_OK(client.DownloadBlocks());
+  ASSERT_EQ(downloaded_blocks, GetAllSortedBlocks(*client.superblock_));
+}
+
 enum DeleteTrigger {
   kAbortMethod, // Delete blocks via Abort().
   kDestructor,  // Delete blocks via destructor.
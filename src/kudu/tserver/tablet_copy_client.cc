@@ -17,9 +17,14 @@
 
 #include "kudu/tserver/tablet_copy_client.h"
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
 #include <gflags/gflags.h>
 #include <glog/logging.h>
-#include <memory>
 
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus_meta.h"
@@ -27,7 +32,9 @@
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/gutil/walltime.h"
@@ -44,9 +51,12 @@
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(tablet_copy_begin_session_timeout_ms, 3000,
              "Tablet server RPC client timeout for BeginTabletCopySession calls. "
@@ -65,6 +75,24 @@ DEFINE_int32(tablet_copy_dowload_file_inject_latency_ms, 0,
              "to take much longer. For use in tests only.");
 TAG_FLAG(tablet_copy_dowload_file_inject_latency_ms, hidden);
 
+DEFINE_int32(tablet_copy_download_threads, 1,
+             "Number of blocks downloaded concurrently by each tablet copy session. "
+             "Each of them has one FetchData() request in flight at a time.");
+TAG_FLAG(tablet_copy_download_threads, experimental);
+
+DEFINE_int64(tablet_copy_max_bytes_per_sec, 0,
+             "Maximum rate at which all the tablet copies of this server together "
+             "download data, in bytes per second. 0 disables the limit.");
+TAG_FLAG(tablet_copy_max_bytes_per_sec, experimental);
+TAG_FLAG(tablet_copy_max_bytes_per_sec, runtime);
+
+DEFINE_bool(tablet_copy_resume, false,
+            "Whether an aborted tablet copy keeps the blocks it downloaded, so that "
+            "the next copy of the tablet from the same source reuses them rather than "
+            "downloading them again.");
+TAG_FLAG(tablet_copy_resume, experimental);
+TAG_FLAG(tablet_copy_resume, runtime);
+
 DECLARE_int32(tablet_copy_transfer_chunk_size_bytes);
 
 // RETURN_NOT_OK_PREPEND() with a remote-error unwinding step.
@@ -92,10 +120,54 @@ using tablet::DeltaDataPB;
 using tablet::RowSetDataPB;
 using tablet::TabletDataState;
 using tablet::TabletDataState_Name;
+using tablet::TabletCopyProgressPB;
 using tablet::TabletMetadata;
 using tablet::TabletStatusListener;
 using tablet::TabletSuperBlockPB;
 
+namespace {
+
+// Limits the rate at which the tablet copies of the server download data to
+// --tablet_copy_max_bytes_per_sec. Each downloaded chunk pushes back the time
+// at which the next chunk may be fetched, by any session.
+class DownloadThrottler {
+ public:
+  DownloadThrottler() : next_fetch_(MonoTime::Now()) {}
+
+  // Accounts for 'bytes' downloaded bytes, sleeping as long as the downloads
+  // are ahead of the limit.
+  void Throttle(int64_t bytes) {
+    int64_t bytes_per_sec = FLAGS_tablet_copy_max_bytes_per_sec;
+    if (bytes_per_sec <= 0) {
+      return;
+    }
+    MonoTime now = MonoTime::Now();
+    MonoTime wait_until;
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      // Unused bandwidth isn't carried over.
+      next_fetch_ = std::max(next_fetch_, now);
+      next_fetch_ += MonoDelta::FromMicroseconds(
+          bytes * MonoTime::kMicrosecondsPerSecond / bytes_per_sec);
+      wait_until = next_fetch_;
+    }
+    if (wait_until > now) {
+      SleepFor(wait_until - now);
+    }
+  }
+
+ private:
+  simple_spinlock lock_;
+  MonoTime next_fetch_;
+};
+
+DownloadThrottler* GetDownloadThrottler() {
+  static DownloadThrottler* throttler = new DownloadThrottler();
+  return throttler;
+}
+
+} // anonymous namespace
+
 TabletCopyClient::TabletCopyClient(std::string tablet_id,
                                    FsManager* fs_manager,
                                    shared_ptr<Messenger> messenger)
@@ -129,6 +201,7 @@ Status TabletCopyClient::SetTabletToReplace(const scoped_refptr<TabletMetadata>&
 
   replace_tombstoned_tablet_ = true;
   meta_ = meta;
+  prev_copy_progress_ = meta->tablet_copy_progress();
 
   int64_t last_logged_term = meta->tombstone_last_logged_opid().term();
   if (last_logged_term > caller_term) {
@@ -195,6 +268,20 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
 
   session_id_ = resp.session_id();
   session_idle_timeout_millis_ = resp.session_idle_timeout_millis();
+  source_uuid_ = resp.responder_uuid();
+
+  // The blocks of the previous copy may only be reused if they came from the
+  // same source: block IDs are only unique within a server.
+  if (FLAGS_tablet_copy_resume && !source_uuid_.empty() &&
+      prev_copy_progress_.IsInitialized() &&
+      prev_copy_progress_.source_uuid() == source_uuid_) {
+    for (const auto& block : prev_copy_progress_.blocks()) {
+      resumable_blocks_.emplace(BlockId::FromPB(block.source_block_id()),
+                                BlockId::FromPB(block.block_id()));
+    }
+    LOG_WITH_PREFIX(INFO) << "Resuming the previous copy of the tablet, with "
+                          << resumable_blocks_.size() << " blocks already downloaded";
+  }
 
   // Store a copy of the remote (old) superblock for testing purposes.
   old_superblock_.reset(resp.release_superblock());
@@ -291,6 +378,7 @@ Status TabletCopyClient::Finish() {
   LOG_WITH_PREFIX(INFO) << "Tablet Copy complete. Replacing tablet superblock.";
   UpdateStatusMessage("Replacing tablet superblock");
   superblock_->set_tablet_data_state(tablet::TABLET_DATA_READY);
+  OrphanUnusedCopiedBlocks(superblock_.get());
   RETURN_NOT_OK(meta_->ReplaceSuperBlock(*superblock_));
 
   if (FLAGS_tablet_copy_save_downloaded_metadata) {
@@ -314,6 +402,22 @@ Status TabletCopyClient::Abort() {
   // Write the in-progress superblock to disk so that when we delete the tablet
   // data all the partial blocks we have persisted will be deleted.
   DCHECK_EQ(tablet::TABLET_DATA_COPYING, superblock_->tablet_data_state());
+  OrphanUnusedCopiedBlocks(superblock_.get());
+  if (FLAGS_tablet_copy_resume && !source_uuid_.empty()) {
+    // Keep the downloaded blocks out of the rowsets, which are deleted, and
+    // record them as the progress of the copy instead.
+    superblock_->clear_rowsets();
+    TabletCopyProgressPB* progress = superblock_->mutable_tablet_copy_progress();
+    progress->set_source_uuid(source_uuid_);
+    std::lock_guard<simple_spinlock> l(copied_blocks_lock_);
+    for (const auto& e : copied_blocks_) {
+      TabletCopyProgressPB::CopiedBlockPB* block = progress->add_blocks();
+      e.first.CopyToPB(block->mutable_source_block_id());
+      e.second.CopyToPB(block->mutable_block_id());
+    }
+    LOG_WITH_PREFIX(INFO) << "Keeping " << copied_blocks_.size()
+                          << " downloaded blocks for the next copy of the tablet";
+  }
   RETURN_NOT_OK(meta_->ReplaceSuperBlock(*superblock_));
 
   // Delete all of the tablet data, including blocks and WALs.
@@ -405,6 +509,7 @@ int TabletCopyClient::CountBlocks() const {
     num_blocks += rowset.columns_size();
     num_blocks += rowset.redo_deltas_size();
     num_blocks += rowset.undo_deltas_size();
+    num_blocks += rowset.secondary_indexes_size();
     if (rowset.has_bloom_block()) {
       num_blocks++;
     }
@@ -416,38 +521,69 @@ int TabletCopyClient::CountBlocks() const {
 }
 
 Status TabletCopyClient::DownloadBlocks() {
+  fs::ScopedIOClass io_class(fs::IOClass::TABLET_COPY);
   CHECK_EQ(kStarted, state_);
 
-  // Count up the total number of blocks to download.
-  int num_blocks = CountBlocks();
-
-  // Download each block, writing the new block IDs into the new superblock
-  // as each block downloads.
-  int block_count = 0;
-  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_blocks << " data blocks...";
+  // Collect the blocks to download.
+  vector<BlockIdPB*> block_ids;
+  block_ids.reserve(CountBlocks());
   for (RowSetDataPB& rowset : *superblock_->mutable_rowsets()) {
     for (ColumnDataPB& col : *rowset.mutable_columns()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(col.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(col.mutable_block());
     }
     for (DeltaDataPB& redo : *rowset.mutable_redo_deltas()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(redo.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(redo.mutable_block());
     }
     for (DeltaDataPB& undo : *rowset.mutable_undo_deltas()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(undo.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(undo.mutable_block());
+    }
+    for (ColumnDataPB& index : *rowset.mutable_secondary_indexes()) {
+      block_ids.push_back(index.mutable_block());
     }
     if (rowset.has_bloom_block()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(rowset.mutable_bloom_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(rowset.mutable_bloom_block());
     }
     if (rowset.has_adhoc_index_block()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(rowset.mutable_adhoc_index_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(rowset.mutable_adhoc_index_block());
     }
   }
+  const int num_blocks = block_ids.size();
 
+  // Download each block, writing the new block IDs into the new superblock
+  // as each block downloads.
+  std::atomic<int> block_count(0);
+  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_blocks << " data blocks...";
+  const int num_threads = std::min(FLAGS_tablet_copy_download_threads, num_blocks);
+  if (num_threads <= 1) {
+    for (BlockIdPB* block_id : block_ids) {
+      RETURN_NOT_OK(DownloadAndRewriteBlock(block_id, &block_count, num_blocks));
+    }
+    return Status::OK();
+  }
+
+  // Each block is rewritten by a single thread, and the superblock isn't
+  // otherwise touched until all of them are done.
+  vector<Status> statuses(num_blocks);
+  {
+    gscoped_ptr<ThreadPool> pool;
+    RETURN_NOT_OK(ThreadPoolBuilder("tablet-copy-dl")
+                  .set_max_threads(num_threads)
+                  .Build(&pool));
+    for (int i = 0; i < num_blocks; i++) {
+      Status s = pool->SubmitFunc([this, i, num_blocks, &block_ids, &block_count, &statuses]() {
+          fs::ScopedIOClass io_class(fs::IOClass::TABLET_COPY);
+          statuses[i] = this->DownloadAndRewriteBlock(block_ids[i], &block_count, num_blocks);
+        });
+      if (!s.ok()) {
+        statuses[i] = s;
+        break;
+      }
+    }
+    pool->Wait();
+  }
+  for (const Status& s : statuses) {
+    RETURN_NOT_OK(s);
+  }
   return Status::OK();
 }
 
@@ -496,20 +632,51 @@ Status TabletCopyClient::WriteConsensusMetadata() {
 }
 
 Status TabletCopyClient::DownloadAndRewriteBlock(BlockIdPB* block_id,
-                                                 int* block_count, int num_blocks) {
+                                                 std::atomic<int>* block_count,
+                                                 int num_blocks) {
   BlockId old_block_id(BlockId::FromPB(*block_id));
   UpdateStatusMessage(Substitute("Downloading block $0 ($1/$2)",
                                  old_block_id.ToString(),
-                                 *block_count + 1, num_blocks));
+                                 block_count->load() + 1, num_blocks));
   BlockId new_block_id;
-  RETURN_NOT_OK_PREPEND(DownloadBlock(old_block_id, &new_block_id),
-      "Unable to download block with id " + old_block_id.ToString());
+  const BlockId* copied_block_id = FindOrNull(resumable_blocks_, old_block_id);
+  gscoped_ptr<fs::ReadableBlock> copied_block;
+  if (copied_block_id && fs_manager_->OpenBlock(*copied_block_id, &copied_block).ok()) {
+    VLOG_WITH_PREFIX(1) << "Reusing block " << copied_block_id->ToString()
+                        << ", copied from block " << old_block_id.ToString();
+    new_block_id = *copied_block_id;
+  } else {
+    RETURN_NOT_OK_PREPEND(DownloadBlock(old_block_id, &new_block_id),
+        "Unable to download block with id " + old_block_id.ToString());
+  }
+  {
+    std::lock_guard<simple_spinlock> l(copied_blocks_lock_);
+    copied_blocks_.emplace_back(old_block_id, new_block_id);
+  }
 
   new_block_id.CopyToPB(block_id);
   (*block_count)++;
   return Status::OK();
 }
 
+void TabletCopyClient::OrphanUnusedCopiedBlocks(TabletSuperBlockPB* superblock) {
+  if (!prev_copy_progress_.IsInitialized()) {
+    return;
+  }
+  std::unordered_set<BlockId, BlockIdHash, BlockIdEqual> used_blocks;
+  {
+    std::lock_guard<simple_spinlock> l(copied_blocks_lock_);
+    for (const auto& e : copied_blocks_) {
+      used_blocks.insert(e.second);
+    }
+  }
+  for (const auto& block : prev_copy_progress_.blocks()) {
+    if (!ContainsKey(used_blocks, BlockId::FromPB(block.block_id()))) {
+      *superblock->add_orphaned_blocks() = block.block_id();
+    }
+  }
+}
+
 Status TabletCopyClient::DownloadBlock(const BlockId& old_block_id,
                                        BlockId* new_block_id) {
   VLOG_WITH_PREFIX(1) << "Downloading block with block_id " << old_block_id.ToString();
@@ -558,6 +725,7 @@ Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
 
     // Write the data.
     RETURN_NOT_OK(appendable->Append(resp.chunk().data()));
+    GetDownloadThrottler()->Throttle(resp.chunk().data().size());
 
     if (PREDICT_FALSE(FLAGS_tablet_copy_dowload_file_inject_latency_ms > 0)) {
       LOG_WITH_PREFIX(INFO) << "Injecting latency into file download: " <<
@@ -17,8 +17,11 @@
 #ifndef KUDU_TSERVER_TABLET_COPY_CLIENT_H
 #define KUDU_TSERVER_TABLET_COPY_CLIENT_H
 
+#include <atomic>
 #include <string>
 #include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
@@ -26,6 +29,8 @@
 #include "kudu/fs/block_id.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/tablet/metadata.pb.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -51,7 +56,6 @@ namespace tablet {
 class TabletMetadata;
 class TabletPeer;
 class TabletStatusListener;
-class TabletSuperBlockPB;
 } // namespace tablet
 
 namespace tserver {
@@ -63,7 +67,7 @@ class TabletCopyServiceProxy;
 // This class is not thread-safe.
 //
 // TODO:
-// * Parallelize download of blocks and WAL segments.
+// * Parallelize download of WAL segments.
 //
 class TabletCopyClient {
  public:
@@ -107,6 +111,10 @@ class TabletCopyClient {
 
   // Abort an in-progress transfer and immediately delete the data blocks and
   // WALs downloaded so far. Does nothing if called after Finish().
+  //
+  // With --tablet_copy_resume, the downloaded blocks are kept instead, and
+  // recorded in the tombstoned tablet's metadata so that the next copy of the
+  // tablet from the same source doesn't download them again.
   Status Abort();
 
  private:
@@ -115,6 +123,8 @@ class TabletCopyClient {
   FRIEND_TEST(TabletCopyClientTest, TestVerifyData);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadWalSegment);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadAllBlocks);
+  FRIEND_TEST(TabletCopyClientTest, TestDownloadAllBlocksInParallel);
+  FRIEND_TEST(TabletCopyClientTest, TestResumeAbortedCopy);
   FRIEND_TEST(TabletCopyClientAbortTest, TestAbort);
 
   enum State {
@@ -151,7 +161,8 @@ class TabletCopyClient {
   // Count the number of blocks contained in 'superblock_'.
   int CountBlocks() const;
 
-  // Download all blocks belonging to a tablet sequentially.
+  // Download all blocks belonging to a tablet, up to
+  // --tablet_copy_download_threads of them at a time.
   //
   // Blocks are given new IDs upon creation. On success, 'superblock_'
   // is populated to reflect the new block IDs.
@@ -162,7 +173,14 @@ class TabletCopyClient {
   // On success:
   // - 'block_id' is set to the new ID of the downloaded block.
   // - 'block_count' is incremented.
-  Status DownloadAndRewriteBlock(BlockIdPB* block_id, int* block_count, int num_blocks);
+  //
+  // Thread-safe as long as no other thread accesses 'block_id'.
+  Status DownloadAndRewriteBlock(BlockIdPB* block_id, std::atomic<int>* block_count,
+                                 int num_blocks);
+
+  // Adds the blocks kept from the previous copy of the tablet which were not
+  // reused by this copy to the orphaned blocks of 'superblock'.
+  void OrphanUnusedCopiedBlocks(tablet::TabletSuperBlockPB* superblock);
 
   // Download a single block.
   // Data block is opened with options so that it will fsync() on close.
@@ -213,6 +231,20 @@ class TabletCopyClient {
   std::vector<uint64_t> wal_seqnos_;
   int64_t start_time_micros_;
 
+  // The permanent uuid of the source of the copy.
+  std::string source_uuid_;
+
+  // The blocks kept from the previous, aborted, copy of the tablet.
+  tablet::TabletCopyProgressPB prev_copy_progress_;
+
+  // Maps the source IDs of the blocks of 'prev_copy_progress_' to their local
+  // IDs, if they were copied from the same source as this copy.
+  std::unordered_map<BlockId, BlockId, BlockIdHash, BlockIdEqual> resumable_blocks_;
+
+  // The source and local IDs of the blocks downloaded or reused so far.
+  simple_spinlock copied_blocks_lock_;
+  std::vector<std::pair<BlockId, BlockId>> copied_blocks_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletCopyClient);
 };
 
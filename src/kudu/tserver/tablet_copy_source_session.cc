@@ -18,16 +18,20 @@
 
 #include <algorithm>
 #include <mutex>
+#include <vector>
 
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/log_reader.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/fs/block_manager.h"
+#include "kudu/fs/io_scheduler.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/type_traits.h"
 #include "kudu/rpc/transfer.h"
 #include "kudu/tablet/tablet_peer.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/pb_util.h"
@@ -39,6 +43,14 @@ DEFINE_int32(tablet_copy_transfer_chunk_size_bytes, 4 * 1024 * 1024,
              "tablet servers.");
 TAG_FLAG(tablet_copy_transfer_chunk_size_bytes, hidden);
 
+DEFINE_int32(tablet_copy_async_read_size_bytes, 128 * 1024,
+             "When reading a chunk of a block for a tablet copy with "
+             "asynchronous reads, the size of each read the chunk is split "
+             "into. Only takes effect if asynchronous reads are enabled "
+             "(see --env_use_io_uring).");
+TAG_FLAG(tablet_copy_async_read_size_bytes, experimental);
+TAG_FLAG(tablet_copy_async_read_size_bytes, runtime);
+
 namespace kudu {
 namespace tserver {
 
@@ -47,10 +59,47 @@ using consensus::OpId;
 using fs::ReadableBlock;
 using log::ReadableLogSegment;
 using std::shared_ptr;
+using std::vector;
 using strings::Substitute;
 using tablet::TabletMetadata;
 using tablet::TabletPeer;
 
+Status ImmutableReadableBlockInfo::ReadFully(uint64_t offset, int64_t size,
+                                             Slice* data, uint8_t* scratch) const {
+  fs::ScopedIOClass io_class(fs::IOClass::TABLET_COPY);
+  int64_t read_size = FLAGS_tablet_copy_async_read_size_bytes;
+  if (read_size <= 0 || size <= read_size) {
+    return readable->Read(offset, size, data, scratch);
+  }
+
+  int num_reads = (size + read_size - 1) / read_size;
+  vector<AsyncReadRequest> reads(num_reads);
+  vector<AsyncReadRequest*> requests;
+  requests.reserve(num_reads);
+  CountDownLatch done(num_reads);
+  for (int i = 0; i < num_reads; i++) {
+    AsyncReadRequest* req = &reads[i];
+    int64_t read_offset = i * read_size;
+    req->offset = offset + read_offset;
+    req->length = std::min(read_size, size - read_offset);
+    req->scratch = scratch + read_offset;
+    req->callback = [&done]() { done.CountDown(); };
+    requests.push_back(req);
+  }
+  Status s = readable->SubmitReads(requests);
+  if (s.IsNotSupported()) {
+    return readable->Read(offset, size, data, scratch);
+  }
+  RETURN_NOT_OK(s);
+  done.Wait();
+
+  for (const AsyncReadRequest& req : reads) {
+    RETURN_NOT_OK(req.status);
+  }
+  *data = Slice(scratch, size);
+  return Status::OK();
+}
+
 TabletCopySourceSession::TabletCopySourceSession(
     const scoped_refptr<TabletPeer>& tablet_peer, std::string session_id,
     std::string requestor_uuid, FsManager* fs_manager)
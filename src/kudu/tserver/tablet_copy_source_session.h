@@ -75,9 +75,9 @@ struct ImmutableReadableBlockInfo {
     size(size) {
   }
 
-  Status ReadFully(uint64_t offset, int64_t size, Slice* data, uint8_t* scratch) const {
-    return readable->Read(offset, size, data, scratch);
-  }
+  // Reads large ranges as a batch of asynchronous reads if the block
+  // supports them, so that they are serviced in parallel.
+  Status ReadFully(uint64_t offset, int64_t size, Slice* data, uint8_t* scratch) const;
 };
 
 // A potential Learner must establish a TabletCopySourceSession with the leader in order
@@ -16,12 +16,16 @@
 // under the License.
 #include "kudu/tserver/tablet_server-test-base.h"
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <sstream>
 
 #include <zlib.h>
 
+#include "kudu/consensus/consensus.proxy.h"
 #include "kudu/consensus/log-test-base.h"
+#include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/strings/escaping.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.pb.h"
@@ -29,9 +33,11 @@
 #include "kudu/server/server_base.pb.h"
 #include "kudu/server/server_base.proxy.h"
 #include "kudu/tablet/tablet_bootstrap.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/util/crc.h"
 #include "kudu/util/curl_util.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/url-coding.h"
 #include "kudu/util/zlib.h"
@@ -61,6 +67,7 @@ DEFINE_int32(single_threaded_insert_latency_bench_insert_rows, 1000,
 DECLARE_bool(fail_dns_resolution);
 DECLARE_int32(metrics_retirement_age_ms);
 DECLARE_int32(scanner_batch_size_rows);
+DECLARE_int64(scanner_prefetch_max_bytes);
 DECLARE_string(block_manager);
 
 // Declare these metrics prototypes for simpler unit testing of their behavior.
@@ -183,6 +190,12 @@ TEST_F(TabletServerTest, TestWebPages) {
   ASSERT_STR_CONTAINS(buf.ToString(), "<th>key</th>");
   ASSERT_STR_CONTAINS(buf.ToString(), "<td>string NULLABLE</td>");
 
+  // Top tablets page should list the tablet, and its table.
+  ASSERT_OK(c.FetchURL(Substitute("http://$0/tablets/top?sort=write_cpu&limit=5", addr),
+                       &buf));
+  ASSERT_STR_CONTAINS(buf.ToString(), kTabletId);
+  ASSERT_STR_CONTAINS(buf.ToString(), "<h3>Tables</h3>");
+
   // Test fetching metrics.
   // Fetching metrics has the side effect of retiring metrics, but not in a single pass.
   // So, we check a couple of times in a loop -- thus, if we had a bug where one of these
@@ -261,6 +274,14 @@ TEST_F(TabletServerTest, TestWebPages) {
   // only exists on Linux.
   ASSERT_STR_CONTAINS(buf.ToString(), "tablet_server-test");
 #endif
+
+  // Smoke test the pprof wall-clock profiler handler.
+  ASSERT_OK(c.FetchURL(Substitute("http://$0/pprof/wallclock?seconds=1&interval_ms=100", addr),
+                       &buf));
+  ASSERT_STR_CONTAINS(buf.ToString(), "--- contention");
+#if defined(__linux__)
+  ASSERT_STR_CONTAINS(buf.ToString(), " @ ");
+#endif
 }
 
 TEST_F(TabletServerTest, TestInsert) {
@@ -369,6 +390,60 @@ TEST_F(TabletServerTest, TestInsert) {
   ASSERT_GE(now_after.value(), now_before.value());
 }
 
+// Test that the stages of a write are timed.
+TEST_F(TabletServerTest, TestWriteStageMetrics) {
+  WriteRequestPB req;
+  req.set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToPB(schema_, req.mutable_schema()));
+  AddTestRowToPB(RowOperationsPB::INSERT, schema_, 1, 1, "hello",
+                 req.mutable_row_operations());
+  WriteResponsePB resp;
+  RpcController controller;
+  ASSERT_OK(proxy_->Write(req, &resp, &controller));
+  ASSERT_FALSE(resp.has_error()) << SecureShortDebugString(resp);
+
+  const tablet::TabletMetrics* metrics = tablet_peer_->tablet()->metrics();
+  ASSERT_EQ(1, metrics->write_decode_duration->TotalCount());
+  ASSERT_EQ(1, metrics->write_row_lock_duration->TotalCount());
+  ASSERT_EQ(1, metrics->write_key_probe_duration->TotalCount());
+  ASSERT_EQ(1, metrics->write_apply_duration->TotalCount());
+  ASSERT_EQ(1, metrics->write_replication_duration->TotalCount());
+}
+
+// Test that writes over the tablet's share of the table's write quota are
+// rejected with a retriable error.
+TEST_F(TabletServerTest, TestWriteQuota) {
+  // A byte per second: the first write puts the bucket into debt.
+  tablet_peer_->tablet()->quota()->SetLimits(0, 1, 0, 0);
+
+  WriteRequestPB req;
+  req.set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToPB(schema_, req.mutable_schema()));
+  WriteResponsePB resp;
+  RpcController controller;
+
+  AddTestRowToPB(RowOperationsPB::INSERT, schema_, 1, 1, "admitted",
+                 req.mutable_row_operations());
+  ASSERT_OK(proxy_->Write(req, &resp, &controller));
+  ASSERT_FALSE(resp.has_error()) << SecureShortDebugString(resp);
+
+  controller.Reset();
+  req.clear_row_operations();
+  AddTestRowToPB(RowOperationsPB::INSERT, schema_, 2, 1, "rejected",
+                 req.mutable_row_operations());
+  Status s = proxy_->Write(req, &resp, &controller);
+  ASSERT_TRUE(s.IsRemoteError()) << s.ToString();
+  ASSERT_EQ(rpc::ErrorStatusPB::ERROR_SERVER_TOO_BUSY, controller.error_response()->code());
+  ASSERT_STR_CONTAINS(s.ToString(), "write quota");
+
+  // Once the limit is lifted, the write goes through.
+  tablet_peer_->tablet()->quota()->SetLimits(0, 0, 0, 0);
+  controller.Reset();
+  ASSERT_OK(proxy_->Write(req, &resp, &controller));
+  ASSERT_FALSE(resp.has_error()) << SecureShortDebugString(resp);
+  VerifyRows(schema_, { KeyValue(1, 1), KeyValue(2, 1) });
+}
+
 TEST_F(TabletServerTest, TestExternalConsistencyModes_ClientPropagated) {
   WriteRequestPB req;
   req.set_tablet_id(kTabletId);
@@ -1056,6 +1131,38 @@ TEST_F(TabletServerTest, TestScan) {
   }
 }
 
+// Test a scan whose rows are read ahead of each request.
+TEST_F(TabletServerTest, TestScanWithPrefetch) {
+  FLAGS_scanner_batch_size_rows = 10;
+  FLAGS_scanner_prefetch_max_bytes = 16 * 1024;
+  int num_rows = AllowSlowTests() ? 10000 : 1000;
+  InsertTestRowsDirect(0, num_rows);
+
+  ScanResponsePB resp;
+  ASSERT_NO_FATAL_FAILURE(OpenScannerWithAllColumns(&resp));
+
+  // The rows after the first response are prefetched.
+  shared_ptr<MemTracker> prefetch_tracker;
+  ASSERT_TRUE(MemTracker::FindTracker("scanner-prefetch", &prefetch_tracker,
+                                      mini_server_->server()->mem_tracker()));
+  AssertEventually([&]() {
+    ASSERT_GE(prefetch_tracker->consumption(), FLAGS_scanner_prefetch_max_bytes);
+  });
+
+  vector<string> results;
+  ASSERT_NO_FATAL_FAILURE(
+    DrainScannerToStrings(resp.scanner_id(), schema_, &results));
+  ASSERT_EQ(num_rows, results.size());
+
+  KuduPartialRow row(&schema_);
+  for (int i = 0; i < num_rows; i++) {
+    BuildTestRow(i, &row);
+    string expected = "(" + row.ToString() + ")";
+    ASSERT_EQ(expected, results[i]);
+  }
+  ASSERT_EQ(0, prefetch_tracker->consumption());
+}
+
 TEST_F(TabletServerTest, TestScannerOpenWhenServerShutsDown) {
   InsertTestRowsDirect(0, 1);
 
@@ -1183,6 +1290,35 @@ TEST_F(TabletServerTest, TestSnapshotScan_WithoutSnapshotTimestamp) {
   ASSERT_GT(resp.propagated_timestamp(), resp.snap_timestamp());
 }
 
+// Tests that a bounded-staleness snapshot scan on the leader, whose safe time
+// follows the clock, is served without error at a snapshot which includes the
+// writes it acknowledged.
+TEST_F(TabletServerTest, TestSnapshotScan_BoundedStaleness) {
+  vector<uint64_t> write_timestamps_collector;
+  InsertTestRowsRemote(0, 0, 1, 1, nullptr, kTabletId, &write_timestamps_collector);
+
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+  req.set_batch_size_bytes(0); // so it won't return data right away
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  scan->set_max_staleness_us(0);
+
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+  }
+  ASSERT_GE(resp.snap_timestamp(), write_timestamps_collector[0]);
+  ASSERT_LE(resp.snap_timestamp(), mini_server_->server()->clock()->Now().ToUint64());
+}
+
 // Tests that a snapshot in the future (beyond the current time plus maximum
 // synchronization error) fails as an invalid snapshot.
 TEST_F(TabletServerTest, TestSnapshotScan_SnapshotInTheFutureFails) {
@@ -1571,6 +1707,98 @@ TEST_F(TabletServerTest, TestScanWithEncodedPredicates) {
 
 
 // Test requesting more rows from a scanner which doesn't exist
+// Test that aggregating scans return partial aggregates which add up across
+// responses.
+TEST_F(TabletServerTest, TestScanWithAggregates) {
+  // Scan in several blocks.
+  FLAGS_scanner_batch_size_rows = 10;
+  InsertTestRowsDirect(0, 100);
+
+  ScanRequestPB req;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  scan->add_aggregates()->set_function(ScanAggregatePB::COUNT);
+  ScanAggregatePB* agg = scan->add_aggregates();
+  agg->set_function(ScanAggregatePB::SUM);
+  agg->set_column("int_val");
+  agg = scan->add_aggregates();
+  agg->set_function(ScanAggregatePB::MIN);
+  agg->set_column("key");
+  agg = scan->add_aggregates();
+  agg->set_function(ScanAggregatePB::MAX);
+  agg->set_column("string_val");
+  // Return as few rows' worth of aggregates per response as possible.
+  req.set_batch_size_bytes(1);
+
+  int num_responses = 0;
+  int64_t count = 0;
+  int64_t sum = 0;
+  int32_t min = std::numeric_limits<int32_t>::max();
+  string max;
+  while (true) {
+    ScanResponsePB resp;
+    RpcController rpc;
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_FALSE(resp.has_data());
+    num_responses++;
+    for (const ScanAggregateGroupPB& group : resp.aggregate_groups()) {
+      ASSERT_EQ(0, group.group_values_size());
+      ASSERT_EQ(4, group.aggregate_values_size());
+      int64_t v;
+      ASSERT_EQ(sizeof(v), group.aggregate_values(0).value().size());
+      memcpy(&v, group.aggregate_values(0).value().data(), sizeof(v));
+      ASSERT_EQ(group.num_rows(), v);
+      count += v;
+      memcpy(&v, group.aggregate_values(1).value().data(), sizeof(v));
+      sum += v;
+      int32_t key;
+      ASSERT_EQ(sizeof(key), group.aggregate_values(2).value().size());
+      memcpy(&key, group.aggregate_values(2).value().data(), sizeof(key));
+      min = std::min(min, key);
+      max = std::max(max, group.aggregate_values(3).value());
+    }
+    if (!resp.has_more_results()) break;
+    req.clear_new_scan_request();
+    req.set_scanner_id(resp.scanner_id());
+    req.set_call_seq_id(req.call_seq_id() + 1);
+  }
+  ASSERT_GT(num_responses, 1);
+  ASSERT_EQ(100, count);
+  ASSERT_EQ(9900, sum);
+  ASSERT_EQ(0, min);
+  ASSERT_EQ("hello 99", max);
+}
+
+// Test that invalid aggregates are rejected.
+TEST_F(TabletServerTest, TestInvalidScanRequest_BadAggregates) {
+  const auto check_failure = [&](const ScanAggregatePB& agg, const string& msg) {
+    ScanRequestPB req;
+    ScanResponsePB resp;
+    RpcController rpc;
+    NewScanRequestPB* scan = req.mutable_new_scan_request();
+    scan->set_tablet_id(kTabletId);
+    ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+    *scan->add_aggregates() = agg;
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_TRUE(resp.has_error());
+    ASSERT_EQ(TabletServerErrorPB::INVALID_SCAN_SPEC, resp.error().code());
+    ASSERT_STR_CONTAINS(resp.error().status().message(), msg);
+  };
+  ScanAggregatePB agg;
+  agg.set_function(ScanAggregatePB::SUM);
+  agg.set_column("string_val");
+  NO_FATALS(check_failure(agg, "Cannot compute the SUM of column string_val"));
+  agg.set_column("col_doesnt_exist");
+  NO_FATALS(check_failure(agg, "Aggregated column is not in the projection"));
+  agg.clear_column();
+  NO_FATALS(check_failure(agg, "SUM requires a column"));
+}
+
 TEST_F(TabletServerTest, TestBadScannerID) {
   ScanRequestPB req;
   ScanResponsePB resp;
@@ -1945,6 +2173,41 @@ TEST_F(TabletServerTest, TestCreateTablet_TabletExists) {
   }
 }
 
+TEST_F(TabletServerTest, TestCreateTablets) {
+  CreateTabletsRequestPB req;
+  CreateTabletsResponsePB resp;
+  RpcController rpc;
+
+  req.set_dest_uuid(mini_server_->server()->fs_manager()->uuid());
+  Schema schema = SchemaBuilder(schema_).Build();
+  // The first tablet already exists.
+  for (const string& tablet_id : { string(kTabletId), string("new-tablet-1"),
+                                   string("new-tablet-2") }) {
+    CreateTabletRequestPB* tablet_req = req.add_tablets();
+    tablet_req->set_table_id("testtb");
+    tablet_req->set_tablet_id(tablet_id);
+    tablet_req->set_table_name("testtb");
+    tablet_req->mutable_config()->CopyFrom(mini_server_->CreateLocalConfig());
+    ASSERT_OK(SchemaToPB(schema, tablet_req->mutable_schema()));
+  }
+
+  {
+    SCOPED_TRACE(SecureDebugString(req));
+    ASSERT_OK(admin_proxy_->CreateTablets(req, &resp, &rpc));
+    SCOPED_TRACE(SecureDebugString(resp));
+    ASSERT_FALSE(resp.has_error());
+    ASSERT_EQ(3, resp.tablets_size());
+    ASSERT_TRUE(resp.tablets(0).has_error());
+    ASSERT_EQ(TabletServerErrorPB::TABLET_ALREADY_EXISTS, resp.tablets(0).error().code());
+    ASSERT_FALSE(resp.tablets(1).has_error());
+    ASSERT_FALSE(resp.tablets(2).has_error());
+  }
+
+  for (const char* tablet_id : { "new-tablet-1", "new-tablet-2" }) {
+    ASSERT_OK(WaitForTabletRunning(tablet_id));
+  }
+}
+
 TEST_F(TabletServerTest, TestDeleteTablet) {
   scoped_refptr<TabletPeer> tablet;
 
@@ -2037,6 +2300,41 @@ TEST_F(TabletServerTest, TestDeleteTablet_TabletNotCreated) {
   }
 }
 
+// Test that the updates batched in a MultiRaftUpdateConsensus RPC are each
+// applied to their own tablet, and fail on their own.
+TEST_F(TabletServerTest, TestMultiRaftUpdateConsensus) {
+  const string local_uuid = mini_server_->server()->fs_manager()->uuid();
+  consensus::MultiRaftConsensusRequestPB req;
+  consensus::MultiRaftConsensusResponsePB resp;
+  RpcController rpc;
+
+  // A heartbeat from a deposed leader to the tablet, a heartbeat for a tablet
+  // which does not exist, and one meant for another server.
+  for (const auto& dest : { std::make_pair(local_uuid, string(kTabletId)),
+                            std::make_pair(local_uuid, string("NotPresentTabletId")),
+                            std::make_pair(string("other-uuid"), string(kTabletId)) }) {
+    consensus::ConsensusRequestPB* update = req.add_requests();
+    update->set_dest_uuid(dest.first);
+    update->set_tablet_id(dest.second);
+    update->set_caller_uuid("deposed-leader");
+    update->set_caller_term(0);
+    update->set_committed_index(0);
+    update->set_all_replicated_index(0);
+    *update->mutable_preceding_id() = consensus::MinimumOpId();
+  }
+
+  SCOPED_TRACE(SecureDebugString(req));
+  ASSERT_OK(consensus_proxy_->MultiRaftUpdateConsensus(req, &resp, &rpc));
+  SCOPED_TRACE(SecureDebugString(resp));
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_EQ(3, resp.responses_size());
+  ASSERT_FALSE(resp.responses(0).has_error());
+  ASSERT_EQ(consensus::ConsensusErrorPB::INVALID_TERM,
+            resp.responses(0).status().error().code());
+  ASSERT_EQ(TabletServerErrorPB::TABLET_NOT_FOUND, resp.responses(1).error().code());
+  ASSERT_EQ(TabletServerErrorPB::WRONG_SERVER_UUID, resp.responses(2).error().code());
+}
+
 // Test that with concurrent requests to delete the same tablet, one wins and
 // the other fails, with no assertion failures. Regression test for KUDU-345.
 TEST_F(TabletServerTest, TestConcurrentDeleteTablet) {
@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/block_cache_warmer.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/service_if.h"
@@ -52,7 +53,7 @@ TabletServer::TabletServer(const TabletServerOptions& opts)
     fail_heartbeats_for_tests_(false),
     opts_(opts),
     tablet_manager_(new TSTabletManager(fs_manager_.get(), this, metric_registry())),
-    scanner_manager_(new ScannerManager(metric_entity())),
+    scanner_manager_(new ScannerManager(metric_entity(), mem_tracker())),
     path_handlers_(new TabletServerPathHandlers(this)),
     maintenance_manager_(new MaintenanceManager(MaintenanceManager::DEFAULT_OPTIONS)) {
 }
@@ -91,6 +92,7 @@ Status TabletServer::Init() {
   RETURN_NOT_OK(path_handlers_->Register(web_server_.get()));
 
   heartbeater_.reset(new Heartbeater(opts_, this));
+  block_cache_warmer_.reset(new cfile::BlockCacheWarmer(fs_manager_.get()));
 
   RETURN_NOT_OK_PREPEND(tablet_manager_->Init(),
                         "Could not init Tablet Manager");
@@ -126,6 +128,12 @@ Status TabletServer::Start() {
   RETURN_NOT_OK(heartbeater_->Start());
   RETURN_NOT_OK(maintenance_manager_->Init());
 
+  // Warm up the block cache only once the tablets are open, so that it
+  // doesn't compete with bootstrapping for I/O.
+  RETURN_NOT_OK(block_cache_warmer_->Start([this]() {
+        return tablet_manager_->WaitForAllBootstrapsToFinish();
+      }));
+
   google::FlushLogFiles(google::INFO); // Flush the startup messages.
 
   return Status::OK();
@@ -136,6 +144,7 @@ void TabletServer::Shutdown() {
 
   if (initted_) {
     maintenance_manager_->Shutdown();
+    block_cache_warmer_->Shutdown();
     WARN_NOT_OK(heartbeater_->Stop(), "Failed to stop TS Heartbeat thread");
     ServerBase::Shutdown();
     tablet_manager_->Shutdown();
@@ -37,6 +37,10 @@ namespace kudu {
 
 class MaintenanceManager;
 
+namespace cfile {
+class BlockCacheWarmer;
+} // namespace cfile
+
 namespace tserver {
 
 class Heartbeater;
@@ -117,6 +121,9 @@ class TabletServer : public server::ServerBase {
   // The maintenance manager for this tablet server
   std::shared_ptr<MaintenanceManager> maintenance_manager_;
 
+  // Persists the block cache's hot blocks and reads them back in on startup.
+  gscoped_ptr<cfile::BlockCacheWarmer> block_cache_warmer_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletServer);
 };
 
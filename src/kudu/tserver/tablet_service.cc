@@ -18,7 +18,9 @@
 #include "kudu/tserver/tablet_service.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/optional.hpp>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -34,6 +36,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/escaping.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/server/hybrid_clock.h"
@@ -44,8 +47,9 @@
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
-#include "kudu/tserver/tablet_copy_service.h"
+#include "kudu/tserver/scan_aggregator.h"
 #include "kudu/tserver/scanners.h"
+#include "kudu/tserver/tablet_copy_service.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver.pb.h"
@@ -57,6 +61,7 @@
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/random_util.h"
 #include "kudu/util/status.h"
 #include "kudu/util/status_callback.h"
 #include "kudu/util/trace.h"
@@ -77,6 +82,22 @@ DEFINE_int32(scanner_batch_size_rows, 100,
 TAG_FLAG(scanner_batch_size_rows, advanced);
 TAG_FLAG(scanner_batch_size_rows, runtime);
 
+DEFINE_bool(scanner_adaptive_batch_size, false,
+            "Whether each scanner sizes its responses to take about "
+            "--scanner_adaptive_batch_target_ms to produce, from the observed cost of "
+            "its rows and the delay before the client continues, rather than using "
+            "a fixed size. The size never exceeds the one requested by the client, or "
+            "--scanner_max_batch_size_bytes if it didn't request one.");
+TAG_FLAG(scanner_adaptive_batch_size, experimental);
+TAG_FLAG(scanner_adaptive_batch_size, runtime);
+
+DEFINE_int64(scanner_prefetch_max_bytes, 0,
+             "After responding to a scan request which leaves rows to be scanned, the "
+             "number of bytes of rows which the scanner reads ahead of the client's next "
+             "request on a background thread. If 0, rows are only read when requested.");
+TAG_FLAG(scanner_prefetch_max_bytes, experimental);
+TAG_FLAG(scanner_prefetch_max_bytes, runtime);
+
 DEFINE_bool(scanner_allow_snapshot_scans_with_logical_timestamps, false,
             "If set, the server will support snapshot scans with logical timestamps.");
 TAG_FLAG(scanner_allow_snapshot_scans_with_logical_timestamps, unsafe);
@@ -87,6 +108,27 @@ DEFINE_int32(scanner_max_wait_ms, 1000,
              "longer.");
 TAG_FLAG(scanner_max_wait_ms, advanced);
 
+DEFINE_bool(scanner_count_rows_from_metadata, false,
+            "Whether snapshot scans which only compute COUNT(*), without predicates, "
+            "are answered from the row counts of the tablet's rowsets, only scanning "
+            "the rowsets whose live rows can't be counted without reading them.");
+TAG_FLAG(scanner_count_rows_from_metadata, experimental);
+TAG_FLAG(scanner_count_rows_from_metadata, runtime);
+
+DEFINE_bool(scanner_read_latest_requires_leader_lease, false,
+            "Whether READ_LATEST scans on the leader of a tablet wait until it holds a "
+            "leader lease, which makes them linearizable. Requires --enable_leader_leases.");
+TAG_FLAG(scanner_read_latest_requires_leader_lease, experimental);
+TAG_FLAG(scanner_read_latest_requires_leader_lease, runtime);
+
+DEFINE_bool(scanner_reference_columnar_cells, false,
+            "Whether the responses of columnar scans send the cells of non-nullable "
+            "fixed width columns straight from the scanned row blocks, rather than "
+            "copying them into the response first. The row blocks are then kept "
+            "until the response is sent.");
+TAG_FLAG(scanner_reference_columnar_cells, experimental);
+TAG_FLAG(scanner_reference_columnar_cells, runtime);
+
 // Fault injection flags.
 DEFINE_int32(scanner_inject_latency_on_each_batch_ms, 0,
              "If set, the scanner will pause the specified number of milliesconds "
@@ -94,6 +136,15 @@ DEFINE_int32(scanner_inject_latency_on_each_batch_ms, 0,
              "Used for tests.");
 TAG_FLAG(scanner_inject_latency_on_each_batch_ms, unsafe);
 
+DEFINE_bool(multi_write_inject_failure_after_apply, false,
+            "If set, MultiWrite RPCs fail with a 'server too busy' error once all "
+            "of their writes completed, as if the response had been lost. "
+            "Used for tests.");
+TAG_FLAG(multi_write_inject_failure_after_apply, unsafe);
+TAG_FLAG(multi_write_inject_failure_after_apply, runtime);
+
+DECLARE_bool(enable_leader_leases);
+DECLARE_int32(cfile_max_readahead_blocks);
 DECLARE_int32(memory_limit_warn_threshold_percentage);
 DECLARE_int32(tablet_history_max_age_sec);
 
@@ -111,6 +162,8 @@ using kudu::consensus::GetNodeInstanceRequestPB;
 using kudu::consensus::GetNodeInstanceResponsePB;
 using kudu::consensus::LeaderStepDownRequestPB;
 using kudu::consensus::LeaderStepDownResponsePB;
+using kudu::consensus::MultiRaftConsensusRequestPB;
+using kudu::consensus::MultiRaftConsensusResponsePB;
 using kudu::consensus::RunLeaderElectionRequestPB;
 using kudu::consensus::RunLeaderElectionResponsePB;
 using kudu::consensus::StartTabletCopyRequestPB;
@@ -144,21 +197,14 @@ namespace tserver {
 namespace {
 
 // Lookup the given tablet, ensuring that it both exists and is RUNNING.
-// If it is not, responds to the RPC associated with 'context' after setting
-// resp->mutable_error() to indicate the failure reason.
-//
-// Returns true if successful.
-template<class RespClass>
-bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
-                               const string& tablet_id,
-                               RespClass* resp,
-                               rpc::RpcContext* context,
-                               scoped_refptr<TabletPeer>* peer) {
+// If it is not, returns the failure reason and sets 'error_code'.
+Status LookupTabletPeer(TabletPeerLookupIf* tablet_manager,
+                        const string& tablet_id,
+                        scoped_refptr<TabletPeer>* peer,
+                        TabletServerErrorPB::Code* error_code) {
   if (PREDICT_FALSE(!tablet_manager->GetTabletPeer(tablet_id, peer).ok())) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::NotFound("Tablet not found"),
-                         TabletServerErrorPB::TABLET_NOT_FOUND, context);
-    return false;
+    *error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    return Status::NotFound("Tablet not found");
   }
 
   // Check RUNNING state.
@@ -169,8 +215,27 @@ bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
     if (state == tablet::FAILED) {
       s = s.CloneAndAppend((*peer)->error().ToString());
     }
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::TABLET_NOT_RUNNING, context);
+    *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    return s;
+  }
+  return Status::OK();
+}
+
+// Lookup the given tablet, ensuring that it both exists and is RUNNING.
+// If it is not, responds to the RPC associated with 'context' after setting
+// resp->mutable_error() to indicate the failure reason.
+//
+// Returns true if successful.
+template<class RespClass>
+bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
+                               const string& tablet_id,
+                               RespClass* resp,
+                               rpc::RpcContext* context,
+                               scoped_refptr<TabletPeer>* peer) {
+  TabletServerErrorPB::Code error_code;
+  Status s = LookupTabletPeer(tablet_manager, tablet_id, peer, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
     return false;
   }
   return true;
@@ -317,6 +382,73 @@ class RpcTransactionCompletionCallback : public TransactionCompletionCallback {
   tablet::TransactionState* state_;
 };
 
+// A transaction completion callback for one of the writes of a MultiWrite RPC,
+// which responds to the RPC once all of its writes completed.
+class MultiWriteCompletionCallback : public TransactionCompletionCallback {
+ public:
+  // Tracks the writes of a MultiWrite RPC which have yet to complete.
+  class PendingWrites {
+   public:
+    PendingWrites(rpc::RpcContext* context, int num_pending)
+        : context_(context),
+          num_pending_(num_pending) {
+    }
+
+    // Responds to the RPC once the last pending write is done.
+    void WriteDone() {
+      if (num_pending_.fetch_sub(1) == 1) {
+        if (PREDICT_FALSE(FLAGS_multi_write_inject_failure_after_apply)) {
+          context_->RespondRpcFailure(
+              rpc::ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
+              Status::ServiceUnavailable("Injected failure after applying the writes"));
+        } else {
+          context_->RespondSuccess();
+        }
+        delete this;
+      }
+    }
+
+   private:
+    rpc::RpcContext* const context_;
+    std::atomic<int> num_pending_;
+  };
+
+  // 'request_id' is the id under which the result of the write is tracked
+  // by 'result_tracker', or null if it isn't tracked.
+  MultiWriteCompletionCallback(PendingWrites* pending, WriteResponsePB* response,
+                               const rpc::RequestIdPB* request_id,
+                               scoped_refptr<ResultTracker> result_tracker)
+      : pending_(pending),
+        response_(response),
+        request_id_(request_id),
+        result_tracker_(std::move(result_tracker)) {
+  }
+
+  virtual void TransactionCompleted() OVERRIDE {
+    if (!status_.ok()) {
+      StatusToPB(status_, response_->mutable_error()->mutable_status());
+      response_->mutable_error()->set_code(code_);
+    }
+    // Like RpcContext, only remember the response of a successful write, and
+    // respond to any Write RPC retrying it. This must happen before the
+    // MultiWrite RPC is responded to, which frees 'response_'.
+    if (request_id_) {
+      if (status_.ok()) {
+        result_tracker_->RecordCompletionAndRespond(*request_id_, response_);
+      } else {
+        result_tracker_->FailAndRespond(*request_id_, response_);
+      }
+    }
+    pending_->WriteDone();
+  }
+
+ private:
+  PendingWrites* const pending_;
+  WriteResponsePB* const response_;
+  const rpc::RequestIdPB* const request_id_;
+  const scoped_refptr<ResultTracker> result_tracker_;
+};
+
 // Generic interface to handle scan results.
 class ScanResultCollector {
  public:
@@ -334,6 +466,25 @@ class ScanResultCollector {
 
   // Return the number of rows actually returned to the client.
   virtual int64_t NumRowsReturned() const = 0;
+
+  // Called before the first row block with the scanner serving the request.
+  // By default, aggregating scans are rejected.
+  virtual Status InitForScanner(const Scanner& scanner) {
+    if (scanner.aggregator()) {
+      return Status::NotSupported("Aggregating scans are not supported by this request");
+    }
+    return Status::OK();
+  }
+
+  // Returns whether the result references the memory of the row blocks passed
+  // to HandleRowBlock(). If so, each block must be handed over with
+  // RetainRowBlock() after being handled, rather than reused.
+  virtual bool ReferencesRowBlocks() const { return false; }
+
+  // Takes ownership of a row block passed to HandleRowBlock().
+  virtual void RetainRowBlock(unique_ptr<Scanner::PrefetchedBlock> block) {
+    LOG(FATAL) << "Row blocks are not referenced by this collector";
+  }
 };
 
 namespace {
@@ -367,20 +518,42 @@ void SetLastRow(const RowBlock& row_block, faststring* last_primary_key) {
 // server-side scan and thus never need to return the actual data.)
 class ScanResultCopier : public ScanResultCollector {
  public:
-  ScanResultCopier(RowwiseRowBlockPB* rowblock_pb, faststring* rows_data, faststring* indirect_data)
+  ScanResultCopier(RowwiseRowBlockPB* rowblock_pb, faststring* rows_data, faststring* indirect_data,
+                   ColumnarRowBlockPB* columnar_pb, vector<ColumnarColumnBuffers>* columns)
       : rowblock_pb_(DCHECK_NOTNULL(rowblock_pb)),
         rows_data_(DCHECK_NOTNULL(rows_data)),
         indirect_data_(DCHECK_NOTNULL(indirect_data)),
+        columnar_pb_(DCHECK_NOTNULL(columnar_pb)),
+        columns_(DCHECK_NOTNULL(columns)),
+        columnar_(false),
+        reference_cells_(false),
         blocks_processed_(0),
-        num_rows_returned_(0) {
+        num_rows_returned_(0),
+        columnar_size_(0) {
   }
 
   virtual void HandleRowBlock(const Schema* client_projection_schema,
                               const RowBlock& row_block) OVERRIDE {
+    if (aggregator_) {
+      // Only the aggregates are returned.
+      aggregator_->AddBlock(row_block);
+      return;
+    }
     blocks_processed_++;
     num_rows_returned_ += row_block.selection_vector()->CountSelected();
-    SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
-                      rows_data_, indirect_data_);
+    if (columnar_) {
+      SerializeRowBlockColumnar(row_block, columnar_pb_, client_projection_schema, columns_,
+                                reference_cells_);
+      columnar_size_ = 0;
+      for (const ColumnarColumnBuffers& col : *columns_) {
+        columnar_size_ += col.data_size();
+        if (col.varlen_data) columnar_size_ += col.varlen_data->size();
+        if (col.non_null_bitmap) columnar_size_ += col.non_null_bitmap->size();
+      }
+    } else {
+      SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
+                        rows_data_, indirect_data_);
+    }
     SetLastRow(row_block, &last_primary_key_);
   }
 
@@ -388,9 +561,41 @@ class ScanResultCopier : public ScanResultCollector {
 
   // Returns number of bytes buffered to return.
   virtual int64_t ResponseSize() const OVERRIDE {
+    if (aggregator_) {
+      return aggregator_->EstimatedResultSize();
+    }
+    if (columnar_) {
+      return columnar_size_;
+    }
     return rows_data_->size() + indirect_data_->size();
   }
 
+  virtual Status InitForScanner(const Scanner& scanner) OVERRIDE {
+    aggregator_ = scanner.aggregator();
+    columnar_ = scanner.row_format_flags() & RowFormatFlags::COLUMNAR_LAYOUT;
+    reference_cells_ = columnar_ && !aggregator_ && FLAGS_scanner_reference_columnar_cells;
+    return Status::OK();
+  }
+
+  virtual bool ReferencesRowBlocks() const OVERRIDE { return reference_cells_; }
+
+  virtual void RetainRowBlock(unique_ptr<Scanner::PrefetchedBlock> block) OVERRIDE {
+    if (!retained_blocks_) {
+      retained_blocks_ = std::make_shared<vector<unique_ptr<Scanner::PrefetchedBlock>>>();
+    }
+    retained_blocks_->emplace_back(std::move(block));
+  }
+
+  // Returns the row blocks referenced by the columnar buffers, which must be
+  // kept alive for as long as the buffers are used.
+  shared_ptr<void> retained_blocks() const { return retained_blocks_; }
+
+  // Returns the aggregator of an aggregating scan, or NULL.
+  ScanAggregator* aggregator() const { return aggregator_.get(); }
+
+  // Returns whether the rows were serialized in columnar layout.
+  bool columnar() const { return columnar_; }
+
   virtual const faststring& last_primary_key() const OVERRIDE {
     return last_primary_key_;
   }
@@ -403,9 +608,18 @@ class ScanResultCopier : public ScanResultCollector {
   RowwiseRowBlockPB* const rowblock_pb_;
   faststring* const rows_data_;
   faststring* const indirect_data_;
+  ColumnarRowBlockPB* const columnar_pb_;
+  vector<ColumnarColumnBuffers>* const columns_;
+  bool columnar_;
+  // Whether the cells of the row blocks are referenced rather than copied,
+  // see SerializeRowBlockColumnar().
+  bool reference_cells_;
+  shared_ptr<vector<unique_ptr<Scanner::PrefetchedBlock>>> retained_blocks_;
   int blocks_processed_;
   int64_t num_rows_returned_;
+  int64_t columnar_size_;
   faststring last_primary_key_;
+  std::shared_ptr<ScanAggregator> aggregator_;
 
   DISALLOW_COPY_AND_ASSIGN(ScanResultCopier);
 };
@@ -597,6 +811,45 @@ void TabletServiceAdminImpl::AlterSchema(const AlterSchemaRequestPB* req,
   }
 }
 
+// Parses the tablet to create of 'req' into 'params'. On failure, sets
+// 'error_code' and returns the error.
+static Status NewTabletParamsFromPB(const CreateTabletRequestPB& req,
+                                    TSTabletManager::NewTabletParams* params,
+                                    TabletServerErrorPB::Code* error_code) {
+  Status s = SchemaFromPB(req.schema(), &params->schema);
+  DCHECK(params->schema.has_column_ids());
+  if (!s.ok()) {
+    *error_code = TabletServerErrorPB::INVALID_SCHEMA;
+    return Status::InvalidArgument("Invalid Schema.");
+  }
+
+  s = PartitionSchema::FromPB(req.partition_schema(), params->schema,
+                              &params->partition_schema);
+  if (!s.ok()) {
+    *error_code = TabletServerErrorPB::INVALID_SCHEMA;
+    return Status::InvalidArgument("Invalid PartitionSchema.");
+  }
+
+  Partition::FromPB(req.partition(), &params->partition);
+  params->table_id = req.table_id();
+  params->tablet_id = req.tablet_id();
+  params->table_name = req.table_name();
+  params->config = req.config();
+
+  LOG(INFO) << "Processing CreateTablet for tablet " << req.tablet_id()
+            << " (table=" << req.table_name()
+            << " [id=" << req.table_id() << "]), partition="
+            << params->partition_schema.PartitionDebugString(params->partition,
+                                                             params->schema);
+  VLOG(1) << "Full request: " << SecureDebugString(req);
+  return Status::OK();
+}
+
+static TabletServerErrorPB::Code CreateTabletErrorCode(const Status& s) {
+  return s.IsAlreadyPresent() ? TabletServerErrorPB::TABLET_ALREADY_EXISTS
+                              : TabletServerErrorPB::UNKNOWN_ERROR;
+}
+
 void TabletServiceAdminImpl::CreateTablet(const CreateTabletRequestPB* req,
                                           CreateTabletResponsePB* resp,
                                           rpc::RpcContext* context) {
@@ -606,51 +859,65 @@ void TabletServiceAdminImpl::CreateTablet(const CreateTabletRequestPB* req,
   TRACE_EVENT1("tserver", "CreateTablet",
                "tablet_id", req->tablet_id());
 
-  Schema schema;
-  Status s = SchemaFromPB(req->schema(), &schema);
-  DCHECK(schema.has_column_ids());
+  TSTabletManager::NewTabletParams params;
+  TabletServerErrorPB::Code code;
+  Status s = NewTabletParamsFromPB(*req, &params, &code);
   if (!s.ok()) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::InvalidArgument("Invalid Schema."),
-                         TabletServerErrorPB::INVALID_SCHEMA, context);
+    SetupErrorAndRespond(resp->mutable_error(), s, code, context);
     return;
   }
 
-  PartitionSchema partition_schema;
-  s = PartitionSchema::FromPB(req->partition_schema(), schema, &partition_schema);
-  if (!s.ok()) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::InvalidArgument("Invalid PartitionSchema."),
-                         TabletServerErrorPB::INVALID_SCHEMA, context);
+  s = server_->tablet_manager()->CreateNewTablet(params.table_id,
+                                                 params.tablet_id,
+                                                 params.partition,
+                                                 params.table_name,
+                                                 params.schema,
+                                                 params.partition_schema,
+                                                 params.config,
+                                                 nullptr);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, CreateTabletErrorCode(s), context);
     return;
   }
+  context->RespondSuccess();
+}
 
-  Partition partition;
-  Partition::FromPB(req->partition(), &partition);
-
-  LOG(INFO) << "Processing CreateTablet for tablet " << req->tablet_id()
-            << " (table=" << req->table_name()
-            << " [id=" << req->table_id() << "]), partition="
-            << partition_schema.PartitionDebugString(partition, schema);
-  VLOG(1) << "Full request: " << SecureDebugString(*req);
+void TabletServiceAdminImpl::CreateTablets(const CreateTabletsRequestPB* req,
+                                           CreateTabletsResponsePB* resp,
+                                           rpc::RpcContext* context) {
+  if (!CheckUuidMatchOrRespond(server_->tablet_manager(), "CreateTablets", req, resp, context)) {
+    return;
+  }
+  TRACE_EVENT1("tserver", "CreateTablets",
+               "num_tablets", req->tablets_size());
 
-  s = server_->tablet_manager()->CreateNewTablet(req->table_id(),
-                                                 req->tablet_id(),
-                                                 partition,
-                                                 req->table_name(),
-                                                 schema,
-                                                 partition_schema,
-                                                 req->config(),
-                                                 nullptr);
-  if (PREDICT_FALSE(!s.ok())) {
+  // The tablets which fail to parse get their error right away, and the
+  // others are created together.
+  vector<TSTabletManager::NewTabletParams> tablets;
+  vector<int> tablet_indexes;
+  for (int i = 0; i < req->tablets_size(); i++) {
+    CreateTabletResponsePB* tablet_resp = resp->add_tablets();
+    TSTabletManager::NewTabletParams params;
     TabletServerErrorPB::Code code;
-    if (s.IsAlreadyPresent()) {
-      code = TabletServerErrorPB::TABLET_ALREADY_EXISTS;
-    } else {
-      code = TabletServerErrorPB::UNKNOWN_ERROR;
+    Status s = NewTabletParamsFromPB(req->tablets(i), &params, &code);
+    if (!s.ok()) {
+      tablet_resp->mutable_error()->set_code(code);
+      StatusToPB(s, tablet_resp->mutable_error()->mutable_status());
+      continue;
+    }
+    tablets.emplace_back(std::move(params));
+    tablet_indexes.push_back(i);
+  }
+
+  vector<Status> statuses;
+  server_->tablet_manager()->CreateNewTablets(std::move(tablets), &statuses, nullptr);
+  for (int i = 0; i < statuses.size(); i++) {
+    const Status& s = statuses[i];
+    if (!s.ok()) {
+      TabletServerErrorPB* error = resp->mutable_tablets(tablet_indexes[i])->mutable_error();
+      error->set_code(CreateTabletErrorCode(s));
+      StatusToPB(s, error->mutable_status());
     }
-    SetupErrorAndRespond(resp->mutable_error(), s, code, context);
-    return;
   }
   context->RespondSuccess();
 }
@@ -698,28 +965,113 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
                "tablet_id", req->tablet_id());
   DVLOG(3) << "Received Write RPC: " << SecureDebugString(*req);
 
-  scoped_refptr<TabletPeer> tablet_peer;
-  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
-                                 &tablet_peer)) {
-    return;
-  }
-
-  shared_ptr<Tablet> tablet;
-  TabletServerErrorPB::Code error_code;
-  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+  Status s = SubmitWrite(req, resp,
+                         context->AreResultsTracked() ? context->request_id() : nullptr,
+                         gscoped_ptr<TransactionCompletionCallback>(
+                             new RpcTransactionCompletionCallback<WriteResponsePB>(context,
+                                                                                   resp)),
+                         &error_code);
   if (PREDICT_FALSE(!s.ok())) {
     SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+  }
+}
+
+void TabletServiceImpl::MultiWrite(const MultiWriteRequestPB* req,
+                                   MultiWriteResponsePB* resp,
+                                   rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::MultiWrite",
+               "num_writes", req->requests_size());
+  DVLOG(3) << "Received MultiWrite RPC with " << req->requests_size() << " writes";
+
+  const bool tracked = req->request_ids_size() > 0;
+  if (PREDICT_FALSE(tracked && req->request_ids_size() != req->requests_size())) {
+    context->RespondRpcFailure(
+        rpc::ErrorStatusPB::ERROR_INVALID_REQUEST,
+        Status::InvalidArgument(Substitute("$0 request ids for $1 writes",
+                                           req->request_ids_size(), req->requests_size())));
     return;
   }
+  const scoped_refptr<ResultTracker>& result_tracker = server_->result_tracker();
+
+  // Add all the responses up front so that they are not moved while the
+  // writes complete.
+  for (int i = 0; i < req->requests_size(); i++) {
+    resp->add_responses();
+  }
+  // The extra pending write is only done once all the writes are submitted,
+  // so that the RPC isn't responded to before then.
+  auto* pending = new MultiWriteCompletionCallback::PendingWrites(
+      context, req->requests_size() + 1);
+  for (int i = 0; i < req->requests_size(); i++) {
+    WriteResponsePB* write_resp = resp->mutable_responses(i);
+    const rpc::RequestIdPB* request_id = tracked ? &req->request_ids(i) : nullptr;
+    if (request_id) {
+      // A write which was already applied, or is being applied, by an earlier
+      // attempt must not be applied again.
+      switch (result_tracker->TrackBatchedRpc(*request_id, write_resp)) {
+        case ResultTracker::RpcState::NEW:
+          break;
+        case ResultTracker::RpcState::COMPLETED:
+          pending->WriteDone();
+          continue;
+        case ResultTracker::RpcState::IN_PROGRESS:
+          // The client retries the write, which then waits for the attempt in
+          // progress.
+          StatusToPB(Status::ServiceUnavailable("Write already in progress"),
+                     write_resp->mutable_error()->mutable_status());
+          write_resp->mutable_error()->set_code(TabletServerErrorPB::UNKNOWN_ERROR);
+          pending->WriteDone();
+          continue;
+        case ResultTracker::RpcState::STALE:
+          StatusToPB(Status::Incomplete(Substitute("Request with id { $0 } is stale.",
+                                                   SecureShortDebugString(*request_id))),
+                     write_resp->mutable_error()->mutable_status());
+          write_resp->mutable_error()->set_code(TabletServerErrorPB::UNKNOWN_ERROR);
+          pending->WriteDone();
+          continue;
+      }
+    }
+    TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+    Status s = SubmitWrite(&req->requests(i), write_resp, request_id,
+                           gscoped_ptr<TransactionCompletionCallback>(
+                               new MultiWriteCompletionCallback(pending, write_resp, request_id,
+                                                                result_tracker)),
+                           &error_code);
+    if (PREDICT_FALSE(!s.ok())) {
+      // Each write fails on its own, as if it had been sent in its own RPC.
+      StatusToPB(s, write_resp->mutable_error()->mutable_status());
+      write_resp->mutable_error()->set_code(error_code);
+      if (request_id) {
+        result_tracker->FailAndRespond(*request_id, write_resp);
+      }
+      pending->WriteDone();
+    }
+  }
+  pending->WriteDone();
+}
+
+Status TabletServiceImpl::SubmitWrite(const WriteRequestPB* req,
+                                      WriteResponsePB* resp,
+                                      const rpc::RequestIdPB* request_id,
+                                      gscoped_ptr<TransactionCompletionCallback> completion_cb,
+                                      TabletServerErrorPB::Code* error_code) {
+  scoped_refptr<TabletPeer> tablet_peer;
+  RETURN_NOT_OK(LookupTabletPeer(server_->tablet_manager(), req->tablet_id(), &tablet_peer,
+                                 error_code));
+
+  shared_ptr<Tablet> tablet;
+  RETURN_NOT_OK(GetTabletRef(tablet_peer, &tablet, error_code));
 
   uint64_t bytes = req->row_operations().rows().size() +
       req->row_operations().indirect_data().size();
   if (!tablet->ShouldThrottleAllow(bytes)) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::ServiceUnavailable("Rejecting Write request: throttled"),
-                         TabletServerErrorPB::THROTTLED,
-                         context);
-    return;
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return Status::ServiceUnavailable("Rejecting Write request: throttled");
+  }
+  if (!tablet->quota()->AdmitWrite(bytes)) {
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return Status::ServiceUnavailable("Rejecting Write request: over the table's write quota");
   }
 
   // Check for memory pressure; don't bother doing any additional work if we've
@@ -735,54 +1087,33 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
     } else {
       KLOG_EVERY_N_SECS(INFO, 1) << "Rejecting Write request: " << msg << THROTTLE_MSG;
     }
-    SetupErrorAndRespond(resp->mutable_error(), Status::ServiceUnavailable(msg),
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
+    *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+    return Status::ServiceUnavailable(msg);
   }
 
+  *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
   if (!server_->clock()->SupportsExternalConsistencyMode(req->external_consistency_mode())) {
-    Status s = Status::NotSupported("The configured clock does not support the"
+    return Status::NotSupported("The configured clock does not support the"
         " required consistency mode.");
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
   }
 
   unique_ptr<WriteTransactionState> tx_state(new WriteTransactionState(
       tablet_peer.get(),
       req,
-      context->AreResultsTracked() ? context->request_id() : nullptr,
+      request_id,
       resp));
 
   // If the client sent us a timestamp, decode it and update the clock so that all future
   // timestamps are greater than the passed timestamp.
   if (req->has_propagated_timestamp()) {
     Timestamp ts(req->propagated_timestamp());
-    s = server_->clock()->Update(ts);
-  }
-  if (PREDICT_FALSE(!s.ok())) {
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
+    RETURN_NOT_OK(server_->clock()->Update(ts));
   }
 
-  tx_state->set_completion_callback(gscoped_ptr<TransactionCompletionCallback>(
-      new RpcTransactionCompletionCallback<WriteResponsePB>(context,
-                                                            resp)));
+  tx_state->set_completion_callback(std::move(completion_cb));
 
   // Submit the write. The RPC will be responded to asynchronously.
-  s = tablet_peer->SubmitWrite(std::move(tx_state));
-
-  // Check that we could submit the write
-  if (PREDICT_FALSE(!s.ok())) {
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-  }
-  return;
+  return tablet_peer->SubmitWrite(std::move(tx_state));
 }
 
 ConsensusServiceImpl::ConsensusServiceImpl(const scoped_refptr<MetricEntity>& metric_entity,
@@ -827,6 +1158,47 @@ void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
   context->RespondSuccess();
 }
 
+void ConsensusServiceImpl::MultiRaftUpdateConsensus(const MultiRaftConsensusRequestPB* req,
+                                                    MultiRaftConsensusResponsePB* resp,
+                                                    rpc::RpcContext* context) {
+  DVLOG(3) << "Received Multi-Raft Consensus Update RPC with "
+           << req->requests_size() << " requests";
+  const string& local_uuid = tablet_manager_->NodeInstance().permanent_uuid();
+  for (const ConsensusRequestPB& update : req->requests()) {
+    ConsensusResponsePB* update_resp = resp->add_responses();
+    // Each update fails on its own, as if it had been sent in its own RPC.
+    TabletServerErrorPB::Code code = TabletServerErrorPB::UNKNOWN_ERROR;
+    Status s;
+    scoped_refptr<TabletPeer> tablet_peer;
+    scoped_refptr<Consensus> consensus;
+    if (PREDICT_FALSE(update.has_dest_uuid() && update.dest_uuid() != local_uuid)) {
+      s = Status::InvalidArgument(Substitute("MultiRaftUpdateConsensus: Wrong destination UUID "
+                                             "requested. Local UUID: $0. Requested UUID: $1",
+                                             local_uuid, update.dest_uuid()));
+      code = TabletServerErrorPB::WRONG_SERVER_UUID;
+    } else if (PREDICT_FALSE(!tablet_manager_->GetTabletPeer(update.tablet_id(),
+                                                             &tablet_peer).ok())) {
+      s = Status::NotFound("Tablet not found");
+      code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    } else if (PREDICT_FALSE(tablet_peer->state() != tablet::RUNNING)) {
+      s = Status::IllegalState("Tablet not RUNNING",
+                               tablet::TabletStatePB_Name(tablet_peer->state()));
+      code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    } else if (PREDICT_FALSE(!(consensus = tablet_peer->shared_consensus()))) {
+      s = Status::ServiceUnavailable("Consensus unavailable. Tablet not running");
+      code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    } else {
+      s = consensus->Update(&update, update_resp);
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      update_resp->Clear();
+      StatusToPB(s, update_resp->mutable_error()->mutable_status());
+      update_resp->mutable_error()->set_code(code);
+    }
+  }
+  context->RespondSuccess();
+}
+
 void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
                                                 VoteResponsePB* resp,
                                                 rpc::RpcContext* context) {
@@ -1052,7 +1424,10 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
   gscoped_ptr<faststring> rows_data(new faststring(batch_size_bytes * 11 / 10));
   gscoped_ptr<faststring> indirect_data(new faststring(batch_size_bytes * 11 / 10));
   RowwiseRowBlockPB data;
-  ScanResultCopier collector(&data, rows_data.get(), indirect_data.get());
+  ColumnarRowBlockPB columnar_data;
+  vector<ColumnarColumnBuffers> columns;
+  ScanResultCopier collector(&data, rows_data.get(), indirect_data.get(),
+                             &columnar_data, &columns);
 
   bool has_more_results = false;
   TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
@@ -1093,8 +1468,43 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
   }
   resp->set_has_more_results(has_more_results);
 
+  if (collector.aggregator()) {
+    collector.aggregator()->TakeResults(resp->mutable_aggregate_groups());
+  }
+
   DVLOG(2) << "Blocks processed: " << collector.BlocksProcessed();
-  if (collector.BlocksProcessed() > 0) {
+  if (collector.BlocksProcessed() > 0 && collector.columnar()) {
+    // Each column's buffers are sent in their own sidecars.
+    ColumnarRowBlockPB* columnar_pb = resp->mutable_columnar_data();
+    columnar_pb->set_num_rows(columnar_data.num_rows());
+    for (ColumnarColumnBuffers& col : columns) {
+      ColumnarRowBlockPB::Column* col_pb = columnar_pb->add_columns();
+      int idx;
+      if (!col.data_slices.empty()) {
+        DCHECK_EQ(0, col.data->size());
+        CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+            new rpc::RpcSidecar(std::move(col.data_slices), collector.retained_blocks())), &idx));
+      } else {
+        CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+            new rpc::RpcSidecar(make_gscoped_ptr(col.data.release()))), &idx));
+      }
+      col_pb->set_data_sidecar(idx);
+      if (col.varlen_data) {
+        CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+            new rpc::RpcSidecar(make_gscoped_ptr(col.varlen_data.release()))), &idx));
+        col_pb->set_varlen_data_sidecar(idx);
+      }
+      if (col.non_null_bitmap) {
+        CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+            new rpc::RpcSidecar(make_gscoped_ptr(col.non_null_bitmap.release()))), &idx));
+        col_pb->set_non_null_bitmap_sidecar(idx);
+      }
+    }
+    const faststring& last = collector.last_primary_key();
+    if (last.length() > 0) {
+      resp->set_last_primary_key(last.ToString());
+    }
+  } else if (collector.BlocksProcessed() > 0) {
     resp->mutable_data()->CopyFrom(data);
 
     // Add sidecar data to context and record the returned indices.
@@ -1210,8 +1620,67 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
   context->RespondSuccess();
 }
 
+void TabletServiceImpl::SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                                      SplitKeyRangeResponsePB* resp,
+                                      rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::SplitKeyRange",
+               "tablet_id", req->tablet_id());
+  DVLOG(3) << "Received SplitKeyRange RPC: " << SecureDebugString(*req);
+
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  if (PREDICT_FALSE(req->target_chunk_size_bytes() == 0)) {
+    SetupErrorAndRespond(resp->mutable_error(),
+                         Status::InvalidArgument("Target chunk size must be positive"),
+                         TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  if (PREDICT_FALSE(!req->start_primary_key().empty() &&
+                    !req->stop_primary_key().empty() &&
+                    req->start_primary_key() >= req->stop_primary_key())) {
+    SetupErrorAndRespond(resp->mutable_error(),
+                         Status::InvalidArgument("Start key must precede stop key"),
+                         TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+
+  vector<tablet::KeyRange> ranges;
+  s = tablet->SplitKeyRange(req->start_primary_key(), req->stop_primary_key(),
+                            req->target_chunk_size_bytes(), &ranges);
+  if (PREDICT_FALSE(!s.ok())) {
+    HandleUnknownError(s, resp, context);
+    return;
+  }
+  for (const tablet::KeyRange& range : ranges) {
+    KeyRangePB* range_pb = resp->add_ranges();
+    if (!range.start_key.empty()) {
+      range_pb->set_start_primary_key(range.start_key);
+    }
+    if (!range.stop_key.empty()) {
+      range_pb->set_stop_primary_key(range.stop_key);
+    }
+    range_pb->set_size_bytes_estimate(range.size_bytes);
+  }
+  context->RespondSuccess();
+}
+
 bool TabletServiceImpl::SupportsFeature(uint32_t feature) const {
-  return feature == TabletServerFeatures::COLUMN_PREDICATES;
+  return feature == TabletServerFeatures::COLUMN_PREDICATES ||
+      feature == TabletServerFeatures::SCAN_AGGREGATES ||
+      feature == TabletServerFeatures::COLUMNAR_LAYOUT_FORMAT ||
+      feature == TabletServerFeatures::SPLIT_KEY_RANGE;
 }
 
 void TabletServiceImpl::Shutdown() {
@@ -1301,6 +1770,34 @@ static Status SetupScanSpec(const NewScanRequestPB& scan_pb,
                             const SharedScanner& scanner) {
   gscoped_ptr<ScanSpec> ret(new ScanSpec);
   ret->set_cache_blocks(scan_pb.cache_blocks());
+  if (scan_pb.readahead_blocks() < 0) {
+    return Status::InvalidArgument("readahead_blocks must not be negative",
+                                   std::to_string(scan_pb.readahead_blocks()));
+  }
+  // The readahead of each column is bounded by the server, since every block
+  // read ahead occupies memory and the shared readahead thread pool.
+  ret->set_readahead_blocks(std::min(scan_pb.readahead_blocks(),
+                                     std::max(FLAGS_cfile_max_readahead_blocks, 0)));
+  if (scan_pb.has_limit()) {
+    ret->set_limit(std::min<uint64_t>(scan_pb.limit(), std::numeric_limits<int64_t>::max()));
+  }
+  if (scan_pb.has_sample_fraction() || scan_pb.has_sample_row_budget()) {
+    if (scan_pb.has_sample_fraction() && scan_pb.has_sample_row_budget()) {
+      return Status::InvalidArgument("a scan can't have both a sample fraction and budget");
+    }
+    // The fraction for a row budget is set once the tablet's rows are counted.
+    if (scan_pb.has_sample_fraction()) {
+      if (!(scan_pb.sample_fraction() > 0 && scan_pb.sample_fraction() <= 1)) {
+        return Status::InvalidArgument("sample_fraction must be in (0, 1]",
+                                       std::to_string(scan_pb.sample_fraction()));
+      }
+      ret->set_sample_fraction(scan_pb.sample_fraction());
+    }
+    if (scan_pb.has_sample_row_budget() && scan_pb.sample_row_budget() == 0) {
+      return Status::InvalidArgument("sample_row_budget must be positive");
+    }
+    ret->set_sample_seed(scan_pb.has_sample_seed() ? scan_pb.sample_seed() : GetRandomSeed32());
+  }
 
   unordered_set<string> missing_col_names;
 
@@ -1428,6 +1925,18 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
   // the scanner.
   ScopedUnregisterScanner unreg_scanner(server_->scanner_manager(), scanner->id());
 
+  Status admit_status = server_->scanner_manager()->AdmitScan(
+      scanner.get(), rpc_context->user_credentials().real_user(),
+      rpc_context->GetClientDeadline());
+  if (PREDICT_FALSE(!admit_status.ok())) {
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return admit_status;
+  }
+  if (PREDICT_FALSE(!tablet_peer->tablet()->quota()->AdmitScan())) {
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return Status::ServiceUnavailable("Rejecting Scan request: over the table's scan quota");
+  }
+
   // Create the user's requested projection.
   // TODO: add test cases for bad projections including 0 columns
   Schema projection;
@@ -1451,6 +1960,27 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     }
   }
 
+  if (scan_pb.row_format_flags() & ~static_cast<uint64_t>(RowFormatFlags::COLUMNAR_LAYOUT)) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return Status::InvalidArgument("Unknown row format flags",
+                                   std::to_string(scan_pb.row_format_flags()));
+  }
+  scanner->set_row_format_flags(scan_pb.row_format_flags());
+
+  if (ScanAggregator::IsAggregatingScan(scan_pb)) {
+    if (scan_pb.order_mode() == ORDERED || scan_pb.has_limit()) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return Status::InvalidArgument("Aggregating scans can't be ordered or have a limit");
+    }
+    std::unique_ptr<ScanAggregator> aggregator;
+    s = ScanAggregator::Create(scan_pb, projection, &aggregator);
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return s;
+    }
+    scanner->set_aggregator(std::move(aggregator));
+  }
+
   gscoped_ptr<ScanSpec> spec(new ScanSpec);
 
   // Missing columns will contain the columns that are not mentioned in the client
@@ -1473,6 +2003,17 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     return Status::OK();
   }
 
+  if (FLAGS_scanner_count_rows_from_metadata &&
+      scan_pb.read_mode() == READ_AT_SNAPSHOT &&
+      scanner->aggregator() && scanner->aggregator()->CountsRowsOnly() &&
+      spec->predicates().empty() &&
+      !scan_pb.has_sample_fraction() && !scan_pb.has_sample_row_budget() &&
+      !spec->lower_bound_key() && !spec->exclusive_upper_bound_key()) {
+    *has_more_results = false;
+    return HandleCountScanAtSnapshot(scan_pb, rpc_context, tablet_peer, *scanner,
+                                     result_collector, snap_timestamp, error_code);
+  }
+
   // Store the original projection.
   gscoped_ptr<Schema> orig_projection(new Schema(projection));
   scanner->set_client_projection_schema(std::move(orig_projection));
@@ -1495,6 +2036,21 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
 
   shared_ptr<Tablet> tablet;
   RETURN_NOT_OK(GetTabletRef(tablet_peer, &tablet, error_code));
+
+  if (scan_pb.has_sample_row_budget()) {
+    uint64_t num_rows;
+    s = tablet->CountRows(&num_rows);
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+      return s;
+    }
+    // The count includes deleted rows which are yet to be compacted away,
+    // so the sample may fall short of the budget.
+    if (num_rows > scan_pb.sample_row_budget()) {
+      spec->set_sample_fraction(static_cast<double>(scan_pb.sample_row_budget()) / num_rows);
+    }
+  }
+
   {
     TRACE("Creating iterator");
     TRACE_EVENT0("tserver", "Create iterator");
@@ -1506,6 +2062,11 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
         return s;
       }
       case READ_LATEST: {
+        s = WaitForLeaderLease(rpc_context, tablet_peer);
+        if (s.IsServiceUnavailable()) {
+          *error_code = TabletServerErrorPB::THROTTLED;
+          return s;
+        }
         s = tablet->NewRowIterator(projection, &iter);
         break;
       }
@@ -1518,6 +2079,12 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
           *error_code = TabletServerErrorPB::THROTTLED;
           return s;
         }
+        // A replica too stale for a bounded-staleness scan lets the client
+        // retry on another replica.
+        if (s.IsIncomplete()) {
+          *error_code = TabletServerErrorPB::REPLICA_TOO_STALE;
+          return s;
+        }
 
         if (!s.ok()) {
           tmp_error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
@@ -1640,6 +2207,16 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   // If we early-exit out of this function, automatically unregister the scanner.
   ScopedUnregisterScanner unreg_scanner(server_->scanner_manager(), scanner->id());
 
+  // The time the client took to continue the scan after the last response,
+  // unless this is the first request of the scan.
+  MonoDelta continuation_delay;
+  if (req->call_seq_id() > 0) {
+    continuation_delay = scanner->TimeSinceLastAccess(MonoTime::Now());
+  }
+
+  // Rows may still be being read ahead of this request.
+  scanner->StopPrefetch();
+
   VLOG(2) << "Found existing scanner " << scanner->id() << " for request: "
           << SecureShortDebugString(*req);
   TRACE("Found scanner $0", scanner->id());
@@ -1653,30 +2230,83 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
     *error_code = TabletServerErrorPB::INVALID_SCAN_CALL_SEQ_ID;
     return Status::InvalidArgument("Invalid call sequence ID in scan request");
   }
+  // The scanner is kept, so that the client may retry the same request once
+  // the quota allows.
+  shared_ptr<Tablet> quota_tablet = scanner->tablet_peer()->shared_tablet();
+  if (quota_tablet && PREDICT_FALSE(!quota_tablet->quota()->AdmitScan())) {
+    unreg_scanner.Cancel();
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return Status::ServiceUnavailable("Rejecting Scan request: over the table's scan quota");
+  }
   scanner->IncrementCallSeqId();
   scanner->UpdateAccessTime();
 
+  Status init_status = result_collector->InitForScanner(*scanner);
+  if (PREDICT_FALSE(!init_status.ok())) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return init_status;
+  }
+
   RowwiseIterator* iter = scanner->iter();
 
+  const bool adaptive = FLAGS_scanner_adaptive_batch_size;
+  if (adaptive) {
+    size_t max_bytes = req->has_batch_size_bytes() ? batch_size_bytes :
+        FLAGS_scanner_max_batch_size_bytes;
+    batch_size_bytes = scanner->AdaptiveBatchSizeBytes(batch_size_bytes, max_bytes);
+  }
+  const size_t block_rows = adaptive ? scanner->AdaptiveBlockRows() :
+      FLAGS_scanner_batch_size_rows;
+
   // TODO: could size the RowBlock based on the user's requested batch size?
   // If people had really large indirect objects, we would currently overshoot
   // their requested batch size by a lot.
   Arena arena(32 * 1024, 1 * 1024 * 1024);
-  RowBlock block(scanner->iter()->schema(),
-                 FLAGS_scanner_batch_size_rows, &arena);
+  RowBlock block(scanner->iter()->schema(), block_rows, &arena);
 
   // TODO: in the future, use the client timeout to set a budget. For now,
   // just use a half second, which should be plenty to amortize call overhead.
   int budget_ms = 500;
-  MonoTime deadline = MonoTime::Now() + MonoDelta::FromMilliseconds(budget_ms);
+  const MonoTime start = MonoTime::Now();
+  MonoTime deadline = start + MonoDelta::FromMilliseconds(budget_ms);
+
+  // If the result references the row blocks, each one is read into a new
+  // block which is handed over to the collector.
+  const bool reference_blocks = result_collector->ReferencesRowBlocks();
+
+  // The CPU time and block cache traffic of the request are charged to the
+  // tablet. Blocks read by prefetches aren't traced, so aren't counted.
+  const MicrosecondsInt64 cpu_start_us = GetThreadCpuTimeMicros();
+  Trace* trace = Trace::CurrentTrace();
+  const int64_t cache_hit_start = trace ?
+      trace->metrics()->GetMetric(cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME) : 0;
+  const int64_t cache_miss_start = trace ?
+      trace->metrics()->GetMetric(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME) : 0;
 
   int64_t rows_scanned = 0;
-  while (iter->HasNext()) {
-    if (PREDICT_FALSE(FLAGS_scanner_inject_latency_on_each_batch_ms > 0)) {
-      SleepFor(MonoDelta::FromMilliseconds(FLAGS_scanner_inject_latency_on_each_batch_ms));
+  unique_ptr<Scanner::PrefetchedBlock> prefetched;
+  while (true) {
+    const RowBlock* cur_block = &block;
+    // Return the rows read ahead of this request before reading more.
+    Status s = scanner->TakePrefetchedBlock(&prefetched);
+    if (PREDICT_TRUE(s.ok())) {
+      if (prefetched) {
+        cur_block = prefetched->block();
+      } else if (iter->HasNext()) {
+        if (PREDICT_FALSE(FLAGS_scanner_inject_latency_on_each_batch_ms > 0)) {
+          SleepFor(MonoDelta::FromMilliseconds(FLAGS_scanner_inject_latency_on_each_batch_ms));
+        }
+        RowBlock* next_block = &block;
+        if (reference_blocks) {
+          prefetched.reset(new Scanner::PrefetchedBlock(iter->schema(), block_rows, nullptr));
+          next_block = prefetched->block();
+        }
+        s = iter->NextBlock(next_block);
+        cur_block = next_block;
+      } else {
+        break;
+      }
     }
-
-    Status s = iter->NextBlock(&block);
     if (PREDICT_FALSE(!s.ok())) {
       LOG(WARNING) << "Copying rows from internal iterator for request "
                    << SecureShortDebugString(*req);
@@ -1684,19 +2314,22 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
       return s;
     }
 
-    if (PREDICT_TRUE(block.nrows() > 0)) {
+    if (PREDICT_TRUE(cur_block->nrows() > 0)) {
       // Count the number of rows scanned, regardless of predicates or deletions.
       // The collector will separately count the number of rows actually returned to
       // the client.
-      rows_scanned += block.nrows();
-      result_collector->HandleRowBlock(scanner->client_projection_schema(), block);
+      rows_scanned += cur_block->nrows();
+      result_collector->HandleRowBlock(scanner->client_projection_schema(), *cur_block);
+      if (reference_blocks && prefetched) {
+        result_collector->RetainRowBlock(std::move(prefetched));
+      }
     }
 
     int64_t response_size = result_collector->ResponseSize();
 
     if (VLOG_IS_ON(2)) {
       // This may be fairly expensive if row block size is small
-      TRACE("Copied block (nrows=$0), new size=$1", block.nrows(), response_size);
+      TRACE("Copied block (nrows=$0), new size=$1", cur_block->nrows(), response_size);
     }
 
     // TODO: should check if RPC got cancelled, once we implement RPC cancellation.
@@ -1709,6 +2342,12 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
       break;
     }
   }
+  if (adaptive) {
+    scanner->RecordBatch(result_collector->ResponseSize(), rows_scanned,
+                         MonoTime::Now() - start, continuation_delay);
+  }
+  const int64_t cpu_us = GetThreadCpuTimeMicros() - cpu_start_us;
+  scanner->AddCpuTime(cpu_us);
 
   scoped_refptr<TabletPeer> tablet_peer = scanner->tablet_peer();
   shared_ptr<Tablet> tablet;
@@ -1733,6 +2372,8 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
             scanner->client_projection_schema()->num_columns());
     tablet->metrics()->scanner_bytes_returned->IncrementBy(
         result_collector->ResponseSize());
+    tablet->quota()->ChargeScan(result_collector->NumRowsReturned(),
+                                result_collector->ResponseSize());
   }
 
   // Then the number of rows/cells/bytes actually processed. Here we have to dig
@@ -1755,12 +2396,27 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
         delta_stats.cells_read_from_disk);
     tablet->metrics()->scanner_bytes_scanned_from_disk->IncrementBy(
         delta_stats.bytes_read_from_disk);
+    tablet->metrics()->scanner_cpu_time->IncrementBy(cpu_us);
+    if (trace) {
+      tablet->metrics()->scanner_cache_hit_bytes->IncrementBy(
+          trace->metrics()->GetMetric(cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME) -
+          cache_hit_start);
+      tablet->metrics()->scanner_cache_miss_bytes->IncrementBy(
+          trace->metrics()->GetMetric(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME) -
+          cache_miss_start);
+    }
   }
 
   scanner->UpdateAccessTime();
-  *has_more_results = !req->close_scanner() && iter->HasNext();
+  *has_more_results = !req->close_scanner() &&
+      (scanner->HasPrefetchedData() || iter->HasNext());
   if (*has_more_results) {
     unreg_scanner.Cancel();
+    if (FLAGS_scanner_prefetch_max_bytes > 0) {
+      // Read the next rows while this response is sent and handled.
+      server_->scanner_manager()->PrefetchAsync(scanner, block_rows,
+                                                FLAGS_scanner_prefetch_max_bytes);
+    }
   } else {
     VLOG(2) << "Scanner " << scanner->id() << " complete: removing...";
   }
@@ -1787,6 +2443,105 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
                                                TabletPeer* tablet_peer,
                                                gscoped_ptr<RowwiseIterator>* iter,
                                                Timestamp* snap_timestamp) {
+  tablet::MvccSnapshot snap;
+  Timestamp tmp_snap_timestamp;
+  RETURN_NOT_OK(WaitForScanSnapshot(scan_pb, rpc_context, tablet_peer, &snap,
+                                    &tmp_snap_timestamp));
+
+  if (scan_pb.order_mode() == UNKNOWN_ORDER_MODE) {
+    return Status::InvalidArgument("Unknown order mode specified");
+  }
+  RETURN_NOT_OK(tablet_peer->tablet()->NewRowIterator(projection, snap,
+                                                      scan_pb.order_mode(), iter));
+  *snap_timestamp = tmp_snap_timestamp;
+  return Status::OK();
+}
+
+Status TabletServiceImpl::HandleCountScanAtSnapshot(const NewScanRequestPB& scan_pb,
+                                                    const RpcContext* rpc_context,
+                                                    TabletPeer* tablet_peer,
+                                                    const Scanner& scanner,
+                                                    ScanResultCollector* result_collector,
+                                                    Timestamp* snap_timestamp,
+                                                    TabletServerErrorPB::Code* error_code) {
+  TRACE_EVENT0("tserver", "TabletServiceImpl::HandleCountScanAtSnapshot");
+  Status s = result_collector->InitForScanner(scanner);
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return s;
+  }
+
+  shared_ptr<Tablet> tablet;
+  RETURN_NOT_OK(GetTabletRef(tablet_peer, &tablet, error_code));
+
+  tablet::MvccSnapshot snap;
+  Timestamp tmp_snap_timestamp;
+  s = WaitForScanSnapshot(scan_pb, rpc_context, tablet_peer, &snap, &tmp_snap_timestamp);
+  if (s.IsServiceUnavailable()) {
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return s;
+  }
+  if (s.IsIncomplete()) {
+    *error_code = TabletServerErrorPB::REPLICA_TOO_STALE;
+    return s;
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+    return s;
+  }
+
+  uint64_t count;
+  int rowsets_scanned;
+  s = tablet->CountLiveRows(snap, &count, &rowsets_scanned);
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+    return s;
+  }
+  TRACE("Counted $0 rows, scanning $1 rowsets", count, rowsets_scanned);
+
+  // As for other scans, the snapshot must still be readable once the
+  // rowsets have been read.
+  s = VerifyNotAncientHistory(tablet.get(), READ_AT_SNAPSHOT, tmp_snap_timestamp);
+  if (!s.ok()) {
+    *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+    return s;
+  }
+
+  scanner.aggregator()->AddRowCount(count);
+  *snap_timestamp = tmp_snap_timestamp;
+  return Status::OK();
+}
+
+Status TabletServiceImpl::WaitForLeaderLease(const RpcContext* rpc_context,
+                                             TabletPeer* tablet_peer) {
+  if (!FLAGS_scanner_read_latest_requires_leader_lease || !FLAGS_enable_leader_leases) {
+    return Status::OK();
+  }
+  scoped_refptr<Consensus> consensus = tablet_peer->shared_consensus();
+  if (!consensus || consensus->role() != consensus::RaftPeerPB::LEADER) {
+    return Status::OK();
+  }
+
+  bool was_clamped = false;
+  MonoTime deadline = ClampScanDeadlineForWait(
+      rpc_context->GetClientDeadline() - MonoDelta::FromMilliseconds(10), &was_clamped);
+  TRACE("Waiting for the leader lease");
+  int wait_ms = 1;
+  while (!consensus->HasLeaderLease()) {
+    if (MonoTime::Now() >= deadline) {
+      return Status::ServiceUnavailable("leader does not hold a lease");
+    }
+    SleepFor(MonoDelta::FromMilliseconds(wait_ms));
+    wait_ms = std::min(wait_ms * 2, 16);
+  }
+  return Status::OK();
+}
+
+Status TabletServiceImpl::WaitForScanSnapshot(const NewScanRequestPB& scan_pb,
+                                              const RpcContext* rpc_context,
+                                              TabletPeer* tablet_peer,
+                                              tablet::MvccSnapshot* snap,
+                                              Timestamp* snap_timestamp) {
   // If the client sent a timestamp update our clock with it.
   if (scan_pb.has_propagated_timestamp()) {
     Timestamp propagated_timestamp(scan_pb.propagated_timestamp());
@@ -1804,6 +2559,23 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   // time as the snapshot timestamp.
   if (!scan_pb.has_snap_timestamp()) {
     tmp_snap_timestamp = server_->clock()->Now();
+    // For a bounded-staleness scan, read at the replica's safe time instead of
+    // waiting for it to catch up with the clock, unless it is too far behind.
+    if (scan_pb.has_max_staleness_us() && server_->clock()->HasPhysicalComponent()) {
+      Timestamp safe_time = tablet_peer->time_manager()->GetSafeTime();
+      Timestamp oldest_allowed = HybridClock::AddPhysicalTimeToTimestamp(
+          tmp_snap_timestamp,
+          MonoDelta::FromMicroseconds(-static_cast<int64_t>(scan_pb.max_staleness_us())));
+      if (safe_time < oldest_allowed) {
+        return Status::Incomplete(
+            Substitute("replica safe time $0 is more than $1 us behind the current time $2",
+                       server_->clock()->Stringify(safe_time), scan_pb.max_staleness_us(),
+                       server_->clock()->Stringify(tmp_snap_timestamp)));
+      }
+      if (safe_time < tmp_snap_timestamp) {
+        tmp_snap_timestamp = safe_time;
+      }
+    }
   // ... else we use the client provided one, but make sure it is not too far
   // in the future as to be invalid.
   } else {
@@ -1834,7 +2606,6 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
                                         ReadMode::READ_AT_SNAPSHOT,
                                         tmp_snap_timestamp));
 
-  tablet::MvccSnapshot snap;
   Tablet* tablet = tablet_peer->tablet();
   scoped_refptr<consensus::TimeManager> time_manager = tablet_peer->time_manager();
   tablet::MvccManager* mvcc_manager = tablet->mvcc_manager();
@@ -1862,7 +2633,7 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   if (s.ok()) {
     // Wait for the in-flights in the snapshot to be finished.
     TRACE("Waiting for operations to commit");
-    s = mvcc_manager->WaitForSnapshotWithAllCommitted(tmp_snap_timestamp, &snap, client_deadline);
+    s = mvcc_manager->WaitForSnapshotWithAllCommitted(tmp_snap_timestamp, snap, client_deadline);
   }
 
   // If we got an TimeOut but we had clamped the deadline, return a ServiceUnavailable instead
@@ -1877,10 +2648,6 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   tablet->metrics()->snapshot_read_inflight_wait_duration->Increment(duration_usec);
   TRACE("All operations in snapshot committed. Waited for $0 microseconds", duration_usec);
 
-  if (scan_pb.order_mode() == UNKNOWN_ORDER_MODE) {
-    return Status::InvalidArgument("Unknown order mode specified");
-  }
-  RETURN_NOT_OK(tablet->NewRowIterator(projection, snap, scan_pb.order_mode(), iter));
   *snap_timestamp = tmp_snap_timestamp;
   return Status::OK();
 }
@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "kudu/consensus/consensus.service.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tserver/tserver_admin.service.h"
 #include "kudu/tserver/tserver_service.service.h"
@@ -33,14 +34,21 @@ class Status;
 class Timestamp;
 
 namespace tablet {
+class MvccSnapshot;
 class Tablet;
 class TabletPeer;
+class TransactionCompletionCallback;
 class TransactionState;
 } // namespace tablet
 
+namespace rpc {
+class RequestIdPB;
+} // namespace rpc
+
 namespace tserver {
 
 class ScanResultCollector;
+class Scanner;
 class TabletPeerLookupIf;
 class TabletServer;
 
@@ -55,6 +63,9 @@ class TabletServiceImpl : public TabletServerServiceIf {
   virtual void Write(const WriteRequestPB* req, WriteResponsePB* resp,
                    rpc::RpcContext* context) OVERRIDE;
 
+  virtual void MultiWrite(const MultiWriteRequestPB* req, MultiWriteResponsePB* resp,
+                          rpc::RpcContext* context) OVERRIDE;
+
   virtual void Scan(const ScanRequestPB* req,
                     ScanResponsePB* resp,
                     rpc::RpcContext* context) OVERRIDE;
@@ -71,11 +82,25 @@ class TabletServiceImpl : public TabletServerServiceIf {
                         ChecksumResponsePB* resp,
                         rpc::RpcContext* context) OVERRIDE;
 
+  virtual void SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                             SplitKeyRangeResponsePB* resp,
+                             rpc::RpcContext* context) OVERRIDE;
+
   bool SupportsFeature(uint32_t feature) const override;
 
   virtual void Shutdown() OVERRIDE;
 
  private:
+  // Checks 'req' and submits it as a write transaction of its tablet, whose
+  // outcome is reported to 'completion_cb'. 'request_id' is the id under
+  // which the result of the write is tracked, if any. Returns the reason
+  // why the write couldn't be submitted, and sets 'error_code', otherwise.
+  Status SubmitWrite(const WriteRequestPB* req,
+                     WriteResponsePB* resp,
+                     const rpc::RequestIdPB* request_id,
+                     gscoped_ptr<tablet::TransactionCompletionCallback> completion_cb,
+                     TabletServerErrorPB::Code* error_code);
+
   Status HandleNewScanRequest(tablet::TabletPeer* tablet_peer,
                               const ScanRequestPB* req,
                               const rpc::RpcContext* rpc_context,
@@ -97,6 +122,32 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               gscoped_ptr<RowwiseIterator>* iter,
                               Timestamp* snap_timestamp);
 
+  // If --scanner_read_latest_requires_leader_lease is set and 'tablet_peer'
+  // is the leader of its tablet, waits until it holds a leader lease so that
+  // a READ_LATEST scan on it is linearizable. Returns ServiceUnavailable if
+  // it does not get one in time, e.g. because it was deposed.
+  Status WaitForLeaderLease(const rpc::RpcContext* rpc_context,
+                            tablet::TabletPeer* tablet_peer);
+
+  // Waits until the snapshot requested by 'scan_pb' is consistent and
+  // stores it in 'snap'. Returns Incomplete if 'scan_pb' bounds the staleness
+  // of the snapshot and the replica's safe time lags too far behind.
+  Status WaitForScanSnapshot(const NewScanRequestPB& scan_pb,
+                             const rpc::RpcContext* rpc_context,
+                             tablet::TabletPeer* tablet_peer,
+                             tablet::MvccSnapshot* snap,
+                             Timestamp* snap_timestamp);
+
+  // Answers a COUNT(*) scan at a snapshot, with no predicates, from the
+  // tablet's row counts rather than by scanning it.
+  Status HandleCountScanAtSnapshot(const NewScanRequestPB& scan_pb,
+                                   const rpc::RpcContext* rpc_context,
+                                   tablet::TabletPeer* tablet_peer,
+                                   const Scanner& scanner,
+                                   ScanResultCollector* result_collector,
+                                   Timestamp* snap_timestamp,
+                                   TabletServerErrorPB::Code* error_code);
+
   TabletServer* server_;
 };
 
@@ -107,6 +158,10 @@ class TabletServiceAdminImpl : public TabletServerAdminServiceIf {
                             CreateTabletResponsePB* resp,
                             rpc::RpcContext* context) OVERRIDE;
 
+  virtual void CreateTablets(const CreateTabletsRequestPB* req,
+                             CreateTabletsResponsePB* resp,
+                             rpc::RpcContext* context) OVERRIDE;
+
   virtual void DeleteTablet(const DeleteTabletRequestPB* req,
                             DeleteTabletResponsePB* resp,
                             rpc::RpcContext* context) OVERRIDE;
@@ -131,6 +186,10 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
                                consensus::ConsensusResponsePB *resp,
                                rpc::RpcContext *context) OVERRIDE;
 
+  virtual void MultiRaftUpdateConsensus(const consensus::MultiRaftConsensusRequestPB* req,
+                                        consensus::MultiRaftConsensusResponsePB* resp,
+                                        rpc::RpcContext* context) OVERRIDE;
+
   virtual void RequestConsensusVote(const consensus::VoteRequestPB* req,
                                     consensus::VoteResponsePB* resp,
                                     rpc::RpcContext* context) OVERRIDE;
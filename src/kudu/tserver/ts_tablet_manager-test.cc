@@ -19,17 +19,22 @@
 
 #include <gtest/gtest.h>
 #include <string>
+#include <vector>
 
 #include "kudu/common/partition.h"
 #include "kudu/common/schema.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/master/master.pb.h"
+#include "kudu/tablet/metadata.pb.h"
+#include "kudu/tablet/tablet_metadata.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/mini_tablet_server.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/test_util.h"
 
@@ -39,6 +44,9 @@
 #define ASSERT_MONOTONIC_REPORT_SEQNO(report_seqno, tablet_report) \
   ASSERT_NO_FATAL_FAILURE(AssertMonotonicReportSeqno(report_seqno, tablet_report))
 
+DECLARE_bool(tablet_open_order_by_wal_size);
+DECLARE_string(tablet_open_priority_tables);
+
 namespace kudu {
 namespace tserver {
 
@@ -46,6 +54,8 @@ using consensus::kInvalidOpIdIndex;
 using consensus::RaftConfigPB;
 using master::ReportedTabletPB;
 using master::TabletReportPB;
+using std::vector;
+using tablet::TabletMetadata;
 using tablet::TabletPeer;
 
 static const char* const kTabletId = "my-tablet-id";
@@ -265,5 +275,73 @@ TEST_F(TsTabletManagerTest, TestTabletReports) {
   ASSERT_MONOTONIC_REPORT_SEQNO(&seqno, report);
 }
 
+TEST_F(TsTabletManagerTest, TestSortTabletsByOpenPriority) {
+  Schema full_schema = SchemaBuilder(schema_).Build();
+  std::pair<PartitionSchema, Partition> partition = tablet::CreateDefaultPartition(full_schema);
+
+  // Creates the metadata of a tablet of 'table_name', with a WAL of
+  // 'wal_size' bytes.
+  vector<scoped_refptr<TabletMetadata>> metas;
+  auto add_tablet = [&](const string& tablet_id, const string& table_name, int wal_size) {
+    scoped_refptr<TabletMetadata> meta;
+    ASSERT_OK(TabletMetadata::CreateNew(fs_manager_, tablet_id, table_name, table_name,
+                                        full_schema, partition.first, partition.second,
+                                        tablet::TABLET_DATA_READY, &meta));
+    const string wal_dir = fs_manager_->GetTabletWalDir(tablet_id);
+    ASSERT_OK(env_util::CreateDirIfMissing(env_, wal_dir));
+    ASSERT_OK(WriteStringToFile(
+        env_, string(wal_size, 'x'),
+        JoinPathSegments(wal_dir, string(FsManager::kWalFileNamePrefix) + "-00000001")));
+    metas.push_back(std::move(meta));
+  };
+  // Tablets "a-*" and "c-*" have the same WAL size as another tablet of
+  // their table, to check that ties keep their original order.
+  ASSERT_NO_FATAL_FAILURE(add_tablet("a-small", "a", 10));
+  ASSERT_NO_FATAL_FAILURE(add_tablet("b-small", "b", 20));
+  ASSERT_NO_FATAL_FAILURE(add_tablet("c-large", "c", 300));
+  ASSERT_NO_FATAL_FAILURE(add_tablet("a-large", "a", 100));
+  ASSERT_NO_FATAL_FAILURE(add_tablet("b-large", "b", 200));
+  ASSERT_NO_FATAL_FAILURE(add_tablet("a-small-2", "a", 10));
+  ASSERT_NO_FATAL_FAILURE(add_tablet("c-large-2", "c", 300));
+
+  auto sorted_ids = [&]() {
+    vector<scoped_refptr<TabletMetadata>> sorted = metas;
+    tablet_manager_->SortTabletsByOpenPriority(&sorted);
+    vector<string> ids;
+    for (const scoped_refptr<TabletMetadata>& meta : sorted) {
+      ids.push_back(meta->tablet_id());
+    }
+    return ids;
+  };
+
+  // Without priority tables, tablets are opened by decreasing WAL size.
+  FLAGS_tablet_open_priority_tables = "";
+  FLAGS_tablet_open_order_by_wal_size = true;
+  ASSERT_EQ(vector<string>({ "c-large", "c-large-2", "b-large", "a-large",
+                             "b-small", "a-small", "a-small-2" }),
+            sorted_ids());
+
+  // The tablets of the priority tables come first, in the listed order,
+  // whatever their WAL size. Unknown tables in the list are ignored.
+  FLAGS_tablet_open_priority_tables = "a,no-such-table,b";
+  ASSERT_EQ(vector<string>({ "a-large", "a-small", "a-small-2",
+                             "b-large", "b-small",
+                             "c-large", "c-large-2" }),
+            sorted_ids());
+
+  // Without ordering by WAL size, every tablet of a table ties, so the
+  // tablets of each table keep their original order.
+  FLAGS_tablet_open_order_by_wal_size = false;
+  ASSERT_EQ(vector<string>({ "a-small", "a-large", "a-small-2",
+                             "b-small", "b-large",
+                             "c-large", "c-large-2" }),
+            sorted_ids());
+
+  FLAGS_tablet_open_priority_tables = "";
+  ASSERT_EQ(vector<string>({ "a-small", "b-small", "c-large", "a-large",
+                             "b-large", "a-small-2", "c-large-2" }),
+            sorted_ids());
+}
+
 } // namespace tserver
 } // namespace kudu
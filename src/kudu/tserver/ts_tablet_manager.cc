@@ -24,6 +24,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/common/wire_protocol.h"
@@ -34,6 +35,8 @@
 #include "kudu/consensus/quorum_util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/casts.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/master/master.pb.h"
@@ -55,6 +58,7 @@
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/trace.h"
@@ -71,6 +75,18 @@ DEFINE_int32(num_tablets_to_open_simultaneously, 0,
              "may make sense to manually tune this.");
 TAG_FLAG(num_tablets_to_open_simultaneously, advanced);
 
+DEFINE_string(tablet_open_priority_tables, "",
+              "Comma-separated list of names of tables whose tablets are opened "
+              "first during startup, in the listed order.");
+TAG_FLAG(tablet_open_priority_tables, advanced);
+
+DEFINE_bool(tablet_open_order_by_wal_size, true,
+            "Whether, during startup, tablets which are not part of "
+            "--tablet_open_priority_tables are opened in decreasing order of the "
+            "size of their write-ahead log, as a measure of their recent write "
+            "activity. If false, they are opened in no particular order.");
+TAG_FLAG(tablet_open_order_by_wal_size, advanced);
+
 DEFINE_int32(tablet_start_warn_threshold_ms, 500,
              "If a tablet takes more than this number of millis to start, issue "
              "a warning with a trace.");
@@ -138,6 +154,7 @@ using rpc::ResultTracker;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::unordered_map;
 using std::vector;
 using strings::Substitute;
 using tablet::Tablet;
@@ -217,7 +234,10 @@ Status TSTabletManager::Init() {
     metas.push_back(meta);
   }
 
-  // Now submit the "Open" task for each.
+  // Now submit the "Open" task for each. The pool runs them in submission
+  // order, and each tablet serves as soon as it is open, so submit the most
+  // important tablets first.
+  SortTabletsByOpenPriority(&metas);
   for (const scoped_refptr<TabletMetadata>& meta : metas) {
     scoped_refptr<TransitionInProgressDeleter> deleter;
     {
@@ -238,6 +258,72 @@ Status TSTabletManager::Init() {
   return Status::OK();
 }
 
+namespace {
+
+// Returns the total size of the log segments in 'dir', or 0 if there's no such
+// directory.
+int64_t WalDirSize(Env* env, const string& dir) {
+  vector<string> children;
+  if (!env->GetChildren(dir, &children).ok()) {
+    return 0;
+  }
+  int64_t total = 0;
+  for (const string& child : children) {
+    uint64_t size;
+    if (HasPrefixString(child, FsManager::kWalFileNamePrefix) &&
+        env->GetFileSize(JoinPathSegments(dir, child), &size).ok()) {
+      total += size;
+    }
+  }
+  return total;
+}
+
+} // anonymous namespace
+
+void TSTabletManager::SortTabletsByOpenPriority(vector<scoped_refptr<TabletMetadata>>* metas) {
+  unordered_map<string, int> table_rank;
+  int rank = 0;
+  for (const string& table_name : strings::Split(FLAGS_tablet_open_priority_tables, ",",
+                                                 strings::SkipEmpty())) {
+    InsertIfNotPresent(&table_rank, table_name, rank++);
+  }
+  const int kUnlistedRank = rank;
+
+  struct OpenOrder {
+    int table_rank;
+    int64_t wal_size;
+    scoped_refptr<TabletMetadata> meta;
+  };
+  vector<OpenOrder> order;
+  order.reserve(metas->size());
+  for (scoped_refptr<TabletMetadata>& meta : *metas) {
+    int64_t wal_size = 0;
+    if (FLAGS_tablet_open_order_by_wal_size) {
+      // A bootstrap interrupted by the restart left its segments in the
+      // recovery directory.
+      const string& tablet_id = meta->tablet_id();
+      wal_size = WalDirSize(fs_manager_->env(), fs_manager_->GetTabletWalDir(tablet_id)) +
+          WalDirSize(fs_manager_->env(), fs_manager_->GetTabletWalRecoveryDir(tablet_id));
+    }
+    order.push_back({ FindWithDefault(table_rank, meta->table_name(), kUnlistedRank),
+                      wal_size, std::move(meta) });
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const OpenOrder& a, const OpenOrder& b) {
+                     if (a.table_rank != b.table_rank) {
+                       return a.table_rank < b.table_rank;
+                     }
+                     return a.wal_size > b.wal_size;
+                   });
+
+  metas->clear();
+  for (OpenOrder& o : order) {
+    VLOG(1) << "Opening tablet " << o.meta->tablet_id() << " of table "
+            << o.meta->table_name() << " (WAL size " << o.wal_size << " bytes)";
+    metas->emplace_back(std::move(o.meta));
+  }
+}
+
 Status TSTabletManager::WaitForAllBootstrapsToFinish() {
   CHECK_EQ(state(), MANAGER_RUNNING);
 
@@ -261,60 +347,139 @@ Status TSTabletManager::CreateNewTablet(const string& table_id,
                                         const PartitionSchema& partition_schema,
                                         RaftConfigPB config,
                                         scoped_refptr<TabletPeer>* tablet_peer) {
-  CHECK_EQ(state(), MANAGER_RUNNING);
-  CHECK(IsRaftConfigMember(server_->instance_pb().permanent_uuid(), config));
+  vector<NewTabletParams> tablets(1);
+  NewTabletParams* params = &tablets[0];
+  params->table_id = table_id;
+  params->tablet_id = tablet_id;
+  params->partition = partition;
+  params->table_name = table_name;
+  params->schema = schema;
+  params->partition_schema = partition_schema;
+  params->config = std::move(config);
+
+  vector<Status> statuses;
+  vector<scoped_refptr<TabletPeer>> peers;
+  CreateNewTablets(std::move(tablets), &statuses, &peers);
+  RETURN_NOT_OK(statuses[0]);
+  if (tablet_peer) {
+    *tablet_peer = peers[0];
+  }
+  return Status::OK();
+}
 
-  // Set the initial opid_index for a RaftConfigPB to -1.
-  config.set_opid_index(consensus::kInvalidOpIdIndex);
+void TSTabletManager::CreateNewTablets(vector<NewTabletParams> tablets,
+                                       vector<Status>* statuses,
+                                       vector<scoped_refptr<TabletPeer>>* tablet_peers) {
+  CHECK_EQ(state(), MANAGER_RUNNING);
+  const int num_tablets = tablets.size();
+  statuses->assign(num_tablets, Status::OK());
+  if (tablet_peers) {
+    tablet_peers->assign(num_tablets, nullptr);
+  }
 
-  scoped_refptr<TransitionInProgressDeleter> deleter;
+  vector<scoped_refptr<TransitionInProgressDeleter>> deleters(num_tablets);
   {
-    // acquire the lock in exclusive mode as we'll add a entry to the
-    // transition_in_progress_ set if the lookup fails.
+    // acquire the lock in exclusive mode as we'll add entries to the
+    // transition_in_progress_ set if the lookups fail.
     std::lock_guard<rw_spinlock> lock(lock_);
     TRACE("Acquired tablet manager lock");
 
-    // Sanity check that the tablet isn't already registered.
-    scoped_refptr<TabletPeer> junk;
-    if (LookupTabletUnlocked(tablet_id, &junk)) {
-      return Status::AlreadyPresent("Tablet already registered", tablet_id);
-    }
+    for (int i = 0; i < num_tablets; i++) {
+      const string& tablet_id = tablets[i].tablet_id;
+      CHECK(IsRaftConfigMember(server_->instance_pb().permanent_uuid(), tablets[i].config));
 
-    // Sanity check that the tablet's creation isn't already in progress
-    RETURN_NOT_OK(StartTabletStateTransitionUnlocked(tablet_id, "creating tablet", &deleter));
+      // Sanity check that the tablet isn't already registered.
+      scoped_refptr<TabletPeer> junk;
+      if (LookupTabletUnlocked(tablet_id, &junk)) {
+        (*statuses)[i] = Status::AlreadyPresent("Tablet already registered", tablet_id);
+        continue;
+      }
+
+      // Sanity check that the tablet's creation isn't already in progress
+      (*statuses)[i] = StartTabletStateTransitionUnlocked(tablet_id, "creating tablet",
+                                                          &deleters[i]);
+    }
   }
 
-  // Create the metadata.
+  // Create the metadata. The files are synced as they are written, but
+  // their directories are only synced once all of them are written.
   TRACE("Creating new metadata...");
-  scoped_refptr<TabletMetadata> meta;
-  RETURN_NOT_OK_PREPEND(
-    TabletMetadata::CreateNew(fs_manager_,
-                              tablet_id,
-                              table_name,
-                              table_id,
-                              schema,
-                              partition_schema,
-                              partition,
-                              TABLET_DATA_READY,
-                              &meta),
-    "Couldn't create tablet metadata");
-
-  // We must persist the consensus metadata to disk before starting a new
-  // tablet's TabletPeer and Consensus implementation.
-  unique_ptr<ConsensusMetadata> cmeta;
-  RETURN_NOT_OK_PREPEND(ConsensusMetadata::Create(fs_manager_, tablet_id, fs_manager_->uuid(),
-                                                  config, consensus::kMinimumTerm, &cmeta),
-                        "Unable to create new ConsensusMeta for tablet " + tablet_id);
-  scoped_refptr<TabletPeer> new_peer = CreateAndRegisterTabletPeer(meta, NEW_PEER);
-
-  // We can run this synchronously since there is nothing to bootstrap.
-  RETURN_NOT_OK(open_tablet_pool_->SubmitFunc(boost::bind(&TSTabletManager::OpenTablet,
-                                              this, meta, deleter)));
+  vector<scoped_refptr<TabletMetadata>> metas(num_tablets);
+  bool any_created = false;
+  for (int i = 0; i < num_tablets; i++) {
+    if (!(*statuses)[i].ok()) {
+      continue;
+    }
+    NewTabletParams* t = &tablets[i];
 
-  if (tablet_peer) {
-    *tablet_peer = new_peer;
+    // Set the initial opid_index for a RaftConfigPB to -1.
+    t->config.set_opid_index(consensus::kInvalidOpIdIndex);
+
+    scoped_refptr<TabletMetadata> meta;
+    Status s = TabletMetadata::CreateNewWithoutDirSync(fs_manager_,
+                                                       t->tablet_id,
+                                                       t->table_name,
+                                                       t->table_id,
+                                                       t->schema,
+                                                       t->partition_schema,
+                                                       t->partition,
+                                                       TABLET_DATA_READY,
+                                                       &meta);
+    if (!s.ok()) {
+      (*statuses)[i] = s.CloneAndPrepend("Couldn't create tablet metadata");
+      continue;
+    }
+
+    // We must persist the consensus metadata to disk before starting a new
+    // tablet's TabletPeer and Consensus implementation.
+    unique_ptr<ConsensusMetadata> cmeta;
+    s = ConsensusMetadata::CreateWithoutDirSync(fs_manager_, t->tablet_id, fs_manager_->uuid(),
+                                                t->config, consensus::kMinimumTerm, &cmeta);
+    if (!s.ok()) {
+      (*statuses)[i] = s.CloneAndPrepend(
+          "Unable to create new ConsensusMeta for tablet " + t->tablet_id);
+      continue;
+    }
+    metas[i] = std::move(meta);
+    any_created = true;
+  }
+
+  if (any_created) {
+    const string& meta_dir = fs_manager_->GetTabletMetadataDir();
+    Status s = fs_manager_->env()->SyncDir(meta_dir);
+    if (!s.ok()) {
+      s = s.CloneAndPrepend("Unable to fsync tablet metadata dir " + meta_dir);
+    } else {
+      s = ConsensusMetadata::SyncDir(fs_manager_);
+    }
+    if (!s.ok()) {
+      for (int i = 0; i < num_tablets; i++) {
+        if (metas[i]) {
+          (*statuses)[i] = s;
+          metas[i].reset();
+        }
+      }
+    }
+  }
+  TRACE("Metadata persisted");
+
+  for (int i = 0; i < num_tablets; i++) {
+    if (!metas[i]) {
+      continue;
+    }
+    scoped_refptr<TabletPeer> new_peer = CreateAndRegisterTabletPeer(metas[i], NEW_PEER);
+
+    // We can run this synchronously since there is nothing to bootstrap.
+    Status s = open_tablet_pool_->SubmitFunc(boost::bind(&TSTabletManager::OpenTablet,
+                                                         this, metas[i], deleters[i]));
+    if (!s.ok()) {
+      (*statuses)[i] = s;
+      continue;
+    }
+    if (tablet_peers) {
+      (*tablet_peers)[i] = std::move(new_peer);
+    }
   }
-  return Status::OK();
 }
 
 Status TSTabletManager::CheckLeaderTermNotLower(const string& tablet_id,
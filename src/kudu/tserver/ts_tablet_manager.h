@@ -25,6 +25,9 @@
 #include <unordered_set>
 #include <vector>
 
+#include "kudu/common/partition.h"
+#include "kudu/common/schema.h"
+#include "kudu/consensus/metadata.pb.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tserver/tablet_peer_lookup.h"
@@ -37,15 +40,8 @@
 
 namespace kudu {
 
-class PartitionSchema;
 class FsManager;
 class HostPort;
-class Partition;
-class Schema;
-
-namespace consensus {
-class RaftConfigPB;
-} // namespace consensus
 
 namespace master {
 class ReportedTabletPB;
@@ -116,6 +112,28 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
                          consensus::RaftConfigPB config,
                          scoped_refptr<tablet::TabletPeer>* tablet_peer);
 
+  // The parameters of a tablet created by CreateNewTablets().
+  struct NewTabletParams {
+    std::string table_id;
+    std::string tablet_id;
+    Partition partition;
+    std::string table_name;
+    Schema schema;
+    PartitionSchema partition_schema;
+    consensus::RaftConfigPB config;
+  };
+
+  // Creates and registers several new tablets, as CreateNewTablet() does,
+  // but persists their metadata together: the directories of the tablet and
+  // consensus metadata files are synced once for all the tablets.
+  //
+  // Sets 'statuses' to the outcome of the creation of each tablet. If
+  // 'tablet_peers' is non-NULL, it is set to the new tablets, or to NULL for
+  // the tablets which couldn't be created.
+  void CreateNewTablets(std::vector<NewTabletParams> tablets,
+                        std::vector<Status>* statuses,
+                        std::vector<scoped_refptr<tablet::TabletPeer>>* tablet_peers);
+
   // Delete the specified tablet.
   // 'delete_type' must be one of TABLET_DATA_DELETED or TABLET_DATA_TOMBSTONED
   // or else returns Status::IllegalArgument.
@@ -186,6 +204,7 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
                                  const boost::optional<consensus::OpId>& last_logged_opid);
  private:
   FRIEND_TEST(TsTabletManagerTest, TestPersistBlocks);
+  FRIEND_TEST(TsTabletManagerTest, TestSortTabletsByOpenPriority);
 
   // Flag specified when registering a TabletPeer.
   enum RegisterTabletPeerMode {
@@ -264,6 +283,11 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // TABLET_DATA_READY state. Generally, we tombstone the replica.
   Status HandleNonReadyTabletOnStartup(const scoped_refptr<tablet::TabletMetadata>& meta);
 
+  // Sort 'metas' into the order in which their tablets are opened on startup:
+  // the tablets of the tables in --tablet_open_priority_tables first, in the
+  // listed order, then the rest by decreasing WAL size.
+  void SortTabletsByOpenPriority(std::vector<scoped_refptr<tablet::TabletMetadata>>* metas);
+
   // Return Status::IllegalState if leader_term < last_logged_term.
   // Helper function for use with tablet copy.
   Status CheckLeaderTermNotLower(const std::string& tablet_id,
@@ -18,6 +18,7 @@
 #include "kudu/tserver/tserver-path-handlers.h"
 
 #include <algorithm>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -31,9 +32,11 @@
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/stringprintf.h"
 #include "kudu/server/webui_util.h"
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/tablet/tablet_bootstrap.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_server.h"
@@ -74,6 +77,10 @@ Status TabletServerPathHandlers::Register(Webserver* server) {
     "/tablets", "Tablets",
     boost::bind(&TabletServerPathHandlers::HandleTabletsPage, this, _1, _2),
     true /* styled */, true /* is_on_nav_bar */);
+  server->RegisterPathHandler(
+    "/tablets/top", "",
+    boost::bind(&TabletServerPathHandlers::HandleTopTabletsPage, this, _1, _2),
+    true /* styled */, false /* is_on_nav_bar */);
   server->RegisterPathHandler(
     "/tablet", "",
     boost::bind(&TabletServerPathHandlers::HandleTabletPage, this, _1, _2),
@@ -258,6 +265,142 @@ void TabletServerPathHandlers::HandleTabletsPage(const Webserver::WebRequest& re
 
 namespace {
 
+// The resources used by a tablet, or by all the tablets of a table, since
+// they were opened.
+struct ResourceUsage {
+  string table_name;
+  string tablet_id;
+  int64_t scan_cpu_us = 0;
+  int64_t scan_disk_bytes = 0;
+  int64_t scan_cache_bytes = 0;
+  int64_t rows_scanned = 0;
+  int64_t rows_returned = 0;
+  int64_t write_cpu_us = 0;
+
+  void Add(const ResourceUsage& other) {
+    scan_cpu_us += other.scan_cpu_us;
+    scan_disk_bytes += other.scan_disk_bytes;
+    scan_cache_bytes += other.scan_cache_bytes;
+    rows_scanned += other.rows_scanned;
+    rows_returned += other.rows_returned;
+    write_cpu_us += other.write_cpu_us;
+  }
+};
+
+// The orders of the top tablets page, by the 'sort' argument.
+const struct {
+  const char* arg;
+  const char* title;
+  int64_t ResourceUsage::*field;
+} kUsageOrders[] = {
+  { "scan_cpu", "Scan CPU time", &ResourceUsage::scan_cpu_us },
+  { "scan_disk", "Bytes read from disk", &ResourceUsage::scan_disk_bytes },
+  { "scan_cache", "Bytes read from cache", &ResourceUsage::scan_cache_bytes },
+  { "rows_scanned", "Rows scanned", &ResourceUsage::rows_scanned },
+  { "rows_returned", "Rows returned", &ResourceUsage::rows_returned },
+  { "write_cpu", "Write CPU time", &ResourceUsage::write_cpu_us },
+};
+
+void ResourceUsageToHtml(const string& header, const vector<ResourceUsage>& usages,
+                         bool by_tablet, int limit, std::ostringstream* output) {
+  *output << "<h3>" << header << "</h3>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << "  <tr><th>Table name</th>";
+  if (by_tablet) {
+    *output << "<th>Tablet ID</th>";
+  }
+  for (const auto& order : kUsageOrders) {
+    *output << Substitute("<th><a href=\"/tablets/top?sort=$0\">$1</a></th>",
+                          order.arg, order.title);
+  }
+  *output << "<th>Rows returned per row scanned</th></tr>\n";
+  for (int i = 0; i < std::min<int>(limit, usages.size()); i++) {
+    const ResourceUsage& usage = usages[i];
+    *output << "  <tr><td>" << EscapeForHtmlToString(usage.table_name) << "</td>";
+    if (by_tablet) {
+      *output << "<td>" << TabletLink(usage.tablet_id) << "</td>";
+    }
+    *output << Substitute("<td>$0</td><td>$1</td><td>$2</td><td>$3</td><td>$4</td><td>$5</td>",
+                          HumanReadableElapsedTime::ToShortString(usage.scan_cpu_us / 1e6),
+                          HumanReadableNumBytes::ToString(usage.scan_disk_bytes),
+                          HumanReadableNumBytes::ToString(usage.scan_cache_bytes),
+                          usage.rows_scanned, usage.rows_returned,
+                          HumanReadableElapsedTime::ToShortString(usage.write_cpu_us / 1e6));
+    *output << "<td>" << (usage.rows_scanned > 0 ?
+        StringPrintf("%.3f", static_cast<double>(usage.rows_returned) / usage.rows_scanned) :
+        "") << "</td></tr>\n";
+  }
+  *output << "</table>\n";
+}
+
+} // anonymous namespace
+
+void TabletServerPathHandlers::HandleTopTabletsPage(const Webserver::WebRequest& req,
+                                                    std::ostringstream* output) {
+  string sort = FindWithDefault(req.parsed_args, "sort", kUsageOrders[0].arg);
+  int64_t ResourceUsage::*field = nullptr;
+  for (const auto& order : kUsageOrders) {
+    if (sort == order.arg) {
+      field = order.field;
+    }
+  }
+  if (field == nullptr) {
+    *output << "Unknown sort order " << EscapeForHtmlToString(sort);
+    return;
+  }
+  int32_t limit = 20;
+  string limit_arg;
+  if (FindCopy(req.parsed_args, "limit", &limit_arg) &&
+      (!safe_strto32(limit_arg.c_str(), &limit) || limit < 0)) {
+    *output << "Invalid limit " << EscapeForHtmlToString(limit_arg);
+    return;
+  }
+
+  vector<scoped_refptr<TabletPeer>> peers;
+  tserver_->tablet_manager()->GetTabletPeers(&peers);
+  vector<ResourceUsage> tablet_usages;
+  std::map<string, ResourceUsage> table_usages;
+  for (const scoped_refptr<TabletPeer>& peer : peers) {
+    shared_ptr<Tablet> tablet = peer->shared_tablet();
+    if (!tablet || !tablet->metrics()) {
+      continue;
+    }
+    const tablet::TabletMetrics* metrics = tablet->metrics();
+    ResourceUsage usage;
+    usage.table_name = peer->tablet_metadata()->table_name();
+    usage.tablet_id = peer->tablet_id();
+    usage.scan_cpu_us = metrics->scanner_cpu_time->value();
+    usage.scan_disk_bytes = metrics->scanner_cache_miss_bytes->value();
+    usage.scan_cache_bytes = metrics->scanner_cache_hit_bytes->value();
+    usage.rows_scanned = metrics->scanner_rows_scanned->value();
+    usage.rows_returned = metrics->scanner_rows_returned->value();
+    usage.write_cpu_us = metrics->write_cpu_time->value();
+    ResourceUsage* table_usage = &table_usages[usage.table_name];
+    table_usage->table_name = usage.table_name;
+    table_usage->Add(usage);
+    tablet_usages.push_back(std::move(usage));
+  }
+
+  auto by_field = [field](const ResourceUsage& a, const ResourceUsage& b) {
+    return a.*field > b.*field;
+  };
+  std::sort(tablet_usages.begin(), tablet_usages.end(), by_field);
+  vector<ResourceUsage> sorted_table_usages;
+  for (const auto& entry : table_usages) {
+    sorted_table_usages.push_back(entry.second);
+  }
+  std::sort(sorted_table_usages.begin(), sorted_table_usages.end(), by_field);
+
+  *output << "<h1>Top Tablets</h1>\n";
+  *output << "<p>The resources used by the tablets on this server since they were opened. "
+             "Bytes read by scans are those of the blocks they found in, or missed in, "
+             "the block cache.</p>\n";
+  ResourceUsageToHtml("Tablets", tablet_usages, true, limit, output);
+  ResourceUsageToHtml("Tables", sorted_table_usages, false, limit, output);
+}
+
+namespace {
+
 bool CompareByMemberType(const RaftPeerPB& a, const RaftPeerPB& b) {
   if (!a.has_member_type()) return false;
   if (!b.has_member_type()) return true;
@@ -435,7 +578,7 @@ void TabletServerPathHandlers::HandleScansPage(const Webserver::WebRequest& req,
   *output << "<h1>Scans</h1>\n";
   *output << "<table class='table table-striped'>\n";
   *output << "<tr><th>Tablet id</th><th>Scanner id</th><th>Total time in-flight</th>"
-      "<th>Time since last update</th><th>Requestor</th><th>Iterator Stats</th>"
+      "<th>Time since last update</th><th>CPU time</th><th>Requestor</th><th>Iterator Stats</th>"
       "<th>Pushed down key predicates</th><th>Other predicates</th></tr>\n";
 
   vector<SharedScanner> scanners;
@@ -453,11 +596,13 @@ string TabletServerPathHandlers::ScannerToHtml(const Scanner& scanner) const {
   uint64_t time_since_last_access_us =
       scanner.TimeSinceLastAccess(MonoTime::Now()).ToMicroseconds();
 
-  html << Substitute("<tr><td>$0</td><td>$1</td><td>$2 us.</td><td>$3 us.</td><td>$4</td>",
+  html << Substitute("<tr><td>$0</td><td>$1</td><td>$2 us.</td><td>$3 us.</td><td>$4 us.</td>"
+                     "<td>$5</td>",
                      EscapeForHtmlToString(scanner.tablet_id()), // $0
                      EscapeForHtmlToString(scanner.id()), // $1
                      time_in_flight_us, time_since_last_access_us, // $2, $3
-                     EscapeForHtmlToString(scanner.requestor_string())); // $4
+                     scanner.cpu_time_us(), // $4
+                     EscapeForHtmlToString(scanner.requestor_string())); // $5
 
 
   if (!scanner.IsInitialized()) {
@@ -538,6 +683,8 @@ void TabletServerPathHandlers::HandleDashboardsPage(const Webserver::WebRequest&
   *output << GetDashboardLine("scans", "Scans", "List of scanners that are currently running.");
   *output << GetDashboardLine("transactions", "Transactions", "List of transactions that are "
                                                               "currently running.");
+  *output << GetDashboardLine("tablets/top", "Top Tablets", "Tablets and tables which have "
+                              "used the most CPU, disk reads and block cache.");
   *output << GetDashboardLine("maintenance-manager", "Maintenance Manager",
                               "List of operations that are currently running and those "
                               "that are registered.");
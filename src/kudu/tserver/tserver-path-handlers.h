@@ -53,6 +53,8 @@ class TabletServerPathHandlers {
                        std::ostringstream* output);
   void HandleTabletsPage(const Webserver::WebRequest& req,
                          std::ostringstream* output);
+  void HandleTopTabletsPage(const Webserver::WebRequest& req,
+                            std::ostringstream* output);
   void HandleTabletPage(const Webserver::WebRequest& req,
                         std::ostringstream* output);
   void HandleTransactionsPage(const Webserver::WebRequest& req,
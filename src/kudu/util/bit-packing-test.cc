@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "kudu/util/bit-packing.h"
+#include "kudu/util/bit-stream-utils.inline.h"
+#include "kudu/util/test_util.h"
+
+using std::vector;
+
+namespace kudu {
+namespace bit_packing {
+
+class BitPackingTest : public KuduTest {
+ protected:
+  // Pack 'num_values' random values of 'bit_width' bits into 'buf', and
+  // return them in 'values'.
+  void PackRandomValues(int bit_width, int num_values, faststring* buf,
+                        vector<uint64_t>* values) {
+    const uint64_t max_val = bit_width == 64 ? ~0ULL : (1ULL << bit_width) - 1;
+    BitWriter writer(buf);
+    for (int i = 0; i < num_values; i++) {
+      uint64_t v = (static_cast<uint64_t>(random()) << 32 | random()) & max_val;
+      writer.PutValue(v, bit_width);
+      values->push_back(v);
+    }
+    writer.Flush();
+  }
+
+  template<typename T>
+  void CheckUnpack(int bit_width, int num_values) {
+    faststring buf;
+    vector<uint64_t> expected;
+    PackRandomValues(bit_width, num_values, &buf, &expected);
+
+    // The kernels may unpack fewer values than requested, but those they do
+    // unpack must be correct.
+    vector<T> out(num_values);
+    int64_t n = UnpackValues(bit_width, buf.data(), buf.size(), num_values, out.data());
+    ASSERT_LE(n, num_values);
+    for (int64_t i = 0; i < n; i++) {
+      ASSERT_EQ(expected[i], out[i]) << "width " << bit_width << " index " << i;
+    }
+
+    // BitReader::GetBatch() reads everything, starting from an unaligned
+    // position.
+    BitReader reader(buf.data(), buf.size());
+    T first;
+    ASSERT_TRUE(reader.GetValue(bit_width, &first));
+    ASSERT_EQ(expected[0], first);
+    ASSERT_EQ(num_values - 1, reader.GetBatch(bit_width, out.data(), num_values - 1));
+    for (int i = 1; i < num_values; i++) {
+      ASSERT_EQ(expected[i], out[i - 1]) << "width " << bit_width << " index " << i;
+    }
+  }
+};
+
+TEST_F(BitPackingTest, TestUnpackBitsToBytes) {
+  SeedRandom();
+  for (int rep = 0; rep < 100; rep++) {
+    CheckUnpack<uint8_t>(1, 1 + random() % 1000);
+  }
+}
+
+TEST_F(BitPackingTest, TestUnpackValues32) {
+  SeedRandom();
+  for (int width = 1; width <= 32; width++) {
+    for (int rep = 0; rep < 20; rep++) {
+      CheckUnpack<uint32_t>(width, 1 + random() % 1000);
+    }
+  }
+}
+
+TEST_F(BitPackingTest, TestUnpackValuesScalar) {
+  SeedRandom();
+  for (int width = 1; width <= 32; width++) {
+    for (int rep = 0; rep < 20; rep++) {
+      CheckUnpack<uint64_t>(width, 1 + random() % 1000);
+    }
+  }
+}
+
+// Values wider than 32 bits are read one at a time by GetBatch().
+TEST_F(BitPackingTest, TestWideValues) {
+  SeedRandom();
+  for (int width = 33; width <= 64; width++) {
+    CheckUnpack<uint64_t>(width, 1 + random() % 200);
+  }
+}
+
+} // namespace bit_packing
+} // namespace kudu
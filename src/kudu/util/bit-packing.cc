@@ -0,0 +1,145 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#include "kudu/util/bit-packing.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "kudu/gutil/cpu.h"
+
+using base::CPU;
+
+namespace kudu {
+namespace bit_packing {
+
+namespace {
+
+int64_t UnpackBitsToBytesScalar(const uint8_t* in, int64_t in_bytes, int64_t num_values,
+                                uint8_t* out) {
+  const int64_t num_bytes = std::min(num_values / 8, in_bytes);
+  for (int64_t i = 0; i < num_bytes; i++) {
+    uint8_t byte = in[i];
+    for (int j = 0; j < 8; j++) {
+      out[j] = (byte >> j) & 1;
+    }
+    out += 8;
+  }
+  return num_bytes * 8;
+}
+
+int64_t UnpackValues32Scalar(int bit_width, const uint8_t* in, int64_t in_bytes,
+                             int64_t num_values, uint32_t* out) {
+  return UnpackValuesScalar(bit_width, in, in_bytes, num_values, out);
+}
+
+#if defined(__x86_64__)
+
+// Expands each bit of 32 bits of input into a byte at a time: each byte of
+// the 32-bit word is broadcast to the eight output bytes it covers, and each
+// of those is then tested against its own bit.
+__attribute__((target("avx2")))
+int64_t UnpackBitsToBytesAvx2(const uint8_t* in, int64_t in_bytes, int64_t num_values,
+                              uint8_t* out) {
+  const int64_t num_words = std::min(num_values / 32, in_bytes / 4);
+  const __m256i shuffle = _mm256_setr_epi8(
+      0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+      2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i bits = _mm256_set1_epi64x(0x8040201008040201LL);
+  const __m256i ones = _mm256_set1_epi8(1);
+  for (int64_t i = 0; i < num_words; i++) {
+    __m256i v = _mm256_set1_epi32(static_cast<int32_t>(UNALIGNED_LOAD32(in)));
+    v = _mm256_shuffle_epi8(v, shuffle);
+    v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bits), bits);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_and_si256(v, ones));
+    in += 4;
+    out += 32;
+  }
+  // Finish off any whole bytes which remain.
+  int64_t done = num_words * 32;
+  return done + UnpackBitsToBytesScalar(in, in_bytes - num_words * 4,
+                                        num_values - done, out);
+}
+
+// Unpacks 8 values at a time by gathering the 32-bit word starting at each
+// value's first byte and shifting each lane by that value's offset within
+// the byte. Since a group of 8 values is always a whole number of bytes, the
+// offsets and shifts are the same for every group.
+//
+// A value plus its shift within the byte must fit in the gathered 32 bits,
+// so wider values use the scalar path.
+__attribute__((target("avx2")))
+int64_t UnpackValues32Avx2(int bit_width, const uint8_t* in, int64_t in_bytes,
+                           int64_t num_values, uint32_t* out) {
+  if (bit_width > 25) {
+    return UnpackValues32Scalar(bit_width, in, in_bytes, num_values, out);
+  }
+  // The last gather of a group reads 4 bytes starting within its last byte.
+  if (in_bytes < 4) {
+    return 0;
+  }
+  const int64_t num_groups = std::min(num_values / 8, (in_bytes - 4) / bit_width);
+  const __m256i bit_offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                 _mm256_set1_epi32(bit_width));
+  const __m256i byte_offsets = _mm256_srli_epi32(bit_offsets, 3);
+  const __m256i shifts = _mm256_and_si256(bit_offsets, _mm256_set1_epi32(7));
+  const __m256i mask = _mm256_set1_epi32(static_cast<int32_t>((1U << bit_width) - 1));
+  for (int64_t g = 0; g < num_groups; g++) {
+    __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(in), byte_offsets, 1);
+    __m256i vals = _mm256_and_si256(_mm256_srlv_epi32(words, shifts), mask);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), vals);
+    in += bit_width;
+    out += 8;
+  }
+  return num_groups * 8;
+}
+
+#endif // defined(__x86_64__)
+
+// Function pointers which will be assigned the correct implementation
+// for the runtime architecture.
+decltype(&UnpackBitsToBytesScalar) g_unpack_bits_to_bytes = UnpackBitsToBytesScalar;
+decltype(&UnpackValues32Scalar) g_unpack_values_32 = UnpackValues32Scalar;
+
+} // anonymous namespace
+
+// When this translation unit is initialized, figure out the current CPU and
+// assign the correct function for this architecture.
+//
+// This avoids an expensive 'cpuid' call in the hot path.
+__attribute__((constructor))
+void SelectBitPackingFunctions() {
+#if defined(__x86_64__)
+  if (CPU().has_avx2()) {
+    g_unpack_bits_to_bytes = UnpackBitsToBytesAvx2;
+    g_unpack_values_32 = UnpackValues32Avx2;
+  }
+#endif
+}
+
+int64_t UnpackBitsToBytes(const uint8_t* in, int64_t in_bytes, int64_t num_values,
+                          uint8_t* out) {
+  return g_unpack_bits_to_bytes(in, in_bytes, num_values, out);
+}
+
+int64_t UnpackValues32(int bit_width, const uint8_t* in, int64_t in_bytes,
+                       int64_t num_values, uint32_t* out) {
+  return g_unpack_values_32(bit_width, in, in_bytes, num_values, out);
+}
+
+} // namespace bit_packing
+} // namespace kudu
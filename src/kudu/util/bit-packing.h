@@ -0,0 +1,125 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_BIT_PACKING_H
+#define KUDU_UTIL_BIT_PACKING_H
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "kudu/gutil/port.h"
+
+// Bulk unpacking of bit-packed values, as written by BitWriter::PutValue().
+//
+// Each value of 'bit_width' bits is stored least significant bit first,
+// immediately following the previous value, so a group of 8 values always
+// occupies exactly 'bit_width' bytes. The unpacking functions below process
+// whole groups and return the number of values they unpacked; the caller is
+// responsible for any remaining values (e.g. using BitReader::GetValue()).
+//
+// The 32-bit and 1-bit-to-byte paths use AVX2 kernels when the CPU supports
+// them, selected once at startup.
+namespace kudu {
+namespace bit_packing {
+
+// Unpack up to 'num_values' 1-bit values from 'in' into one byte each
+// (0 or 1) in 'out'. Reads at most 'in_bytes' bytes.
+int64_t UnpackBitsToBytes(const uint8_t* in, int64_t in_bytes, int64_t num_values,
+                          uint8_t* out);
+
+// Unpack up to 'num_values' values of 'bit_width' bits (at most 32) from 'in'
+// into 'out'. Reads at most 'in_bytes' bytes.
+int64_t UnpackValues32(int bit_width, const uint8_t* in, int64_t in_bytes,
+                       int64_t num_values, uint32_t* out);
+
+namespace internal {
+
+// Unpack one group of 32 values of BIT_WIDTH bits each from 'in' into 'out'.
+//
+// Each value is extracted from an unaligned 64-bit load, so this may read up
+// to 8 bytes past the end of the group's 4 * BIT_WIDTH bytes.
+template<typename OutType, int BIT_WIDTH>
+inline void UnpackGroup32(const uint8_t* in, OutType* out) {
+  static_assert(BIT_WIDTH >= 1 && BIT_WIDTH <= 32, "unsupported bit width");
+  const uint64_t mask = (1ULL << BIT_WIDTH) - 1;
+  // Since BIT_WIDTH is a constant, the compiler fully unrolls this loop,
+  // leaving each load offset and shift as an immediate.
+  for (int i = 0; i < 32; i++) {
+    const int bit = i * BIT_WIDTH;
+    uint64_t word = UNALIGNED_LOAD64(in + bit / 8);
+    out[i] = static_cast<OutType>((word >> (bit % 8)) & mask);
+  }
+}
+
+template<typename OutType, int BIT_WIDTH>
+inline void UnpackGroups32(const uint8_t* in, int64_t num_groups, OutType* out) {
+  for (int64_t g = 0; g < num_groups; g++) {
+    UnpackGroup32<OutType, BIT_WIDTH>(in, out);
+    in += BIT_WIDTH * 4;
+    out += 32;
+  }
+}
+
+} // namespace internal
+
+// Portable implementation of UnpackValues(), for any output type.
+template<typename OutType>
+inline int64_t UnpackValuesScalar(int bit_width, const uint8_t* in, int64_t in_bytes,
+                                  int64_t num_values, OutType* out) {
+  if (bit_width < 1 || bit_width > 32 || in_bytes < 8) {
+    return 0;
+  }
+  // Leave 8 bytes of slack after the last group for UnpackGroup32()'s loads.
+  const int64_t group_bytes = bit_width * 4;
+  const int64_t num_groups = std::min(num_values / 32, (in_bytes - 8) / group_bytes);
+
+  switch (bit_width) {
+#define UNPACK_CASE(w) \
+    case w: internal::UnpackGroups32<OutType, w>(in, num_groups, out); break;
+    UNPACK_CASE(1) UNPACK_CASE(2) UNPACK_CASE(3) UNPACK_CASE(4)
+    UNPACK_CASE(5) UNPACK_CASE(6) UNPACK_CASE(7) UNPACK_CASE(8)
+    UNPACK_CASE(9) UNPACK_CASE(10) UNPACK_CASE(11) UNPACK_CASE(12)
+    UNPACK_CASE(13) UNPACK_CASE(14) UNPACK_CASE(15) UNPACK_CASE(16)
+    UNPACK_CASE(17) UNPACK_CASE(18) UNPACK_CASE(19) UNPACK_CASE(20)
+    UNPACK_CASE(21) UNPACK_CASE(22) UNPACK_CASE(23) UNPACK_CASE(24)
+    UNPACK_CASE(25) UNPACK_CASE(26) UNPACK_CASE(27) UNPACK_CASE(28)
+    UNPACK_CASE(29) UNPACK_CASE(30) UNPACK_CASE(31) UNPACK_CASE(32)
+#undef UNPACK_CASE
+  }
+  return num_groups * 32;
+}
+
+// Unpack up to 'num_values' values of 'bit_width' bits from 'in' into 'out',
+// reading at most 'in_bytes' bytes, and return the number unpacked. This
+// picks the fastest available kernel for the output type and bit width.
+template<typename OutType>
+inline int64_t UnpackValues(int bit_width, const uint8_t* in, int64_t in_bytes,
+                            int64_t num_values, OutType* out) {
+  if (sizeof(OutType) == 1 && bit_width == 1) {
+    return UnpackBitsToBytes(in, in_bytes, num_values, reinterpret_cast<uint8_t*>(out));
+  }
+  if (sizeof(OutType) == 4 && bit_width <= 32) {
+    return UnpackValues32(bit_width, in, in_bytes, num_values,
+                          reinterpret_cast<uint32_t*>(out));
+  }
+  return UnpackValuesScalar(bit_width, in, in_bytes, num_values, out);
+}
+
+} // namespace bit_packing
+} // namespace kudu
+
+#endif // KUDU_UTIL_BIT_PACKING_H
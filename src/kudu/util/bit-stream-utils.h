@@ -100,6 +100,14 @@ class BitReader {
   template<typename T>
   bool GetValue(int num_bits, T* v);
 
+  // Gets up to 'batch_size' values of 'num_bits' bits each into 'v', using the
+  // bulk unpacking kernels from bit-packing.h for the byte-aligned middle of
+  // the batch. Returns the number of values read, which is less than
+  // 'batch_size' only if the buffer ran out. Values wider than 32 bits are
+  // read one at a time.
+  template<typename T>
+  int GetBatch(int num_bits, T* v, int batch_size);
+
   // Reads a 'num_bytes'-sized value from the buffer and stores it in 'v'. T needs to be a
   // little-endian native type and big enough to store 'num_bytes'. The value is assumed
   // to be byte-aligned so the stream will be advanced to the start of the next byte
@@ -20,8 +20,9 @@
 #include <algorithm>
 
 #include "glog/logging.h"
-#include "kudu/util/bit-stream-utils.h"
 #include "kudu/util/alignment.h"
+#include "kudu/util/bit-packing.h"
+#include "kudu/util/bit-stream-utils.h"
 
 namespace kudu {
 
@@ -131,6 +132,38 @@ inline bool BitReader::GetValue(int num_bits, T* v) {
   return true;
 }
 
+template<typename T>
+inline int BitReader::GetBatch(int num_bits, T* v, int batch_size) {
+  DCHECK_LE(num_bits, 64);
+  DCHECK_LE(num_bits, sizeof(T) * 8);
+
+  int i = 0;
+  // Read single values until the stream is byte-aligned, so that the
+  // remaining values start on a group boundary.
+  while (i < batch_size && (position() & 7) != 0) {
+    if (PREDICT_FALSE(!GetValue(num_bits, &v[i]))) return i;
+    i++;
+  }
+
+  if (num_bits <= 32 && batch_size - i >= 8) {
+    int byte_pos = position() / 8;
+    int64_t n = bit_packing::UnpackValues(num_bits, buffer_ + byte_pos, max_bytes_ - byte_pos,
+                                          batch_size - i, &v[i]);
+    if (n > 0) {
+      SeekToBit(position() + n * num_bits);
+      i += n;
+    }
+  }
+
+  // Read any remaining values, including those too close to the end of the
+  // buffer for the bulk kernels.
+  while (i < batch_size) {
+    if (PREDICT_FALSE(!GetValue(num_bits, &v[i]))) return i;
+    i++;
+  }
+  return batch_size;
+}
+
 inline void BitReader::Rewind(int num_bits) {
   bit_offset_ -= num_bits;
   if (bit_offset_ >= 0) {
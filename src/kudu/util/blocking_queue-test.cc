@@ -65,6 +65,21 @@ TEST(BlockingQueueTest, TestBlockingDrainTo) {
   ASSERT_EQ(3, out[2]);
 }
 
+TEST(BlockingQueueTest, TestDrainToWithLimit) {
+  BlockingQueue<int32_t> test_queue(3);
+  vector<int32_t> out;
+  ASSERT_FALSE(test_queue.DrainTo(&out, 2));
+  ASSERT_EQ(test_queue.Put(1), QUEUE_SUCCESS);
+  ASSERT_EQ(test_queue.Put(2), QUEUE_SUCCESS);
+  ASSERT_EQ(test_queue.Put(3), QUEUE_SUCCESS);
+  ASSERT_TRUE(test_queue.DrainTo(&out, 2));
+  ASSERT_EQ(vector<int32_t>({ 1, 2 }), out);
+  ASSERT_EQ(test_queue.Put(4), QUEUE_SUCCESS);
+  ASSERT_TRUE(test_queue.DrainTo(&out));
+  ASSERT_EQ(vector<int32_t>({ 1, 2, 3, 4 }), out);
+  ASSERT_TRUE(test_queue.empty());
+}
+
 TEST(BlockingQueueTest, TestTooManyInsertions) {
   BlockingQueue<int32_t> test_queue(2);
   ASSERT_EQ(test_queue.Put(123), QUEUE_SUCCESS);
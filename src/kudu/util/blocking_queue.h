@@ -26,6 +26,7 @@
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 
 namespace kudu {
@@ -121,6 +122,51 @@ class BlockingQueue {
     }
   }
 
+  // Like BlockingDrainTo(), but waits for elements no later than 'deadline'.
+  // Returns false if none arrived by then, or if the queue was shut down
+  // before any did.
+  bool BlockingDrainTo(std::vector<T>* out, const MonoTime& deadline) {
+    MutexLock l(lock_);
+    while (list_.empty()) {
+      MonoTime now = MonoTime::Now();
+      if (shutdown_ || now >= deadline) {
+        return false;
+      }
+      not_empty_.TimedWait(deadline - now);
+    }
+    out->reserve(out->size() + list_.size());
+    for (const T& elt : list_) {
+      out->push_back(elt);
+      decrement_size_unlocked(elt);
+    }
+    list_.clear();
+    not_full_.Signal();
+    return true;
+  }
+
+  // Get all elements from the queue, if any, and append them to a vector
+  // without blocking. If 'max_elements' is positive, gets no more than that
+  // many of the oldest elements. Returns false if the queue was empty.
+  bool DrainTo(std::vector<T>* out, size_t max_elements = 0) {
+    MutexLock l(lock_);
+    if (list_.empty()) {
+      return false;
+    }
+    size_t n = list_.size();
+    if (max_elements > 0 && max_elements < n) {
+      n = max_elements;
+    }
+    out->reserve(out->size() + n);
+    for (size_t i = 0; i < n; i++) {
+      const T& elt = list_.front();
+      out->push_back(elt);
+      decrement_size_unlocked(elt);
+      list_.pop_front();
+    }
+    not_full_.Signal();
+    return true;
+  }
+
   // Attempts to put the given value in the queue.
   // Returns:
   //   QUEUE_SUCCESS: if successfully inserted
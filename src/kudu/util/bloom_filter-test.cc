@@ -84,4 +84,37 @@ TEST(TestBloomFilter, TestInsertAndProbe) {
   ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
 }
 
+TEST(TestBloomFilter, TestBlockedInsertAndProbe) {
+  BloomFilterBuilder bfb(BloomFilterSizing::ByCountAndFPRate(2000, 0.01),
+                         BloomFilterLayout::BLOCKED);
+  ASSERT_EQ(0, bfb.n_bytes() % BloomFilter::kBucketBytes);
+  ASSERT_EQ(BloomFilter::kBucketWords, bfb.n_hashes());
+  int n_keys = bfb.expected_count();
+
+  AddRandomKeys(kRandomSeed, n_keys, &bfb);
+
+  // There are no false negatives, even when the filter's data isn't aligned.
+  BloomFilter bf(bfb.slice(), bfb.n_hashes(), BloomFilterLayout::BLOCKED);
+  CheckRandomKeys(kRandomSeed, n_keys, bf);
+  gscoped_array<uint8_t> unaligned(new uint8_t[bfb.n_bytes() + 1]);
+  memcpy(&unaligned[1], bfb.slice().data(), bfb.n_bytes());
+  CheckRandomKeys(kRandomSeed, n_keys,
+                  BloomFilter(Slice(&unaligned[1], bfb.n_bytes()), bfb.n_hashes(),
+                              BloomFilterLayout::BLOCKED));
+
+  // The false positive rate is about what the filter was sized for.
+  uint32_t num_queries = 100000;
+  uint32_t num_positives = 0;
+  for (int i = 0; i < num_queries; i++) {
+    uint64_t key = random();
+    Slice key_slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key));
+    if (bf.MayContainKey(BloomKeyProbe(key_slice))) {
+      num_positives++;
+    }
+  }
+  double fp_rate = static_cast<double>(num_positives) / static_cast<double>(num_queries);
+  LOG(INFO) << "FP rate: " << fp_rate << " (" << num_positives << "/" << num_queries << ")";
+  ASSERT_LT(fp_rate, 0.01 * 1.2);
+}
+
 } // namespace kudu
@@ -18,6 +18,7 @@
 #include <math.h>
 
 #include "kudu/util/bloom_filter.h"
+#include "kudu/util/alignment.h"
 #include "kudu/util/bitmap.h"
 
 namespace kudu {
@@ -53,11 +54,34 @@ BloomFilterSizing BloomFilterSizing::BySizeAndFPRate(size_t n_bytes, double fp_r
 }
 
 
-BloomFilterBuilder::BloomFilterBuilder(const BloomFilterSizing &sizing)
-  : n_bits_(sizing.n_bytes() * 8),
-    bitmap_(new uint8_t[sizing.n_bytes()]),
-    n_hashes_(ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
-    expected_count_(sizing.expected_count()),
+const uint32_t BloomFilter::kBucketSalts[kBucketWords] = {
+  0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+// With the same number of bits per key, a blocked bloom filter's false
+// positive rate is about 1.5x that of a classic one. Holding 10% fewer
+// keys brings it back to about the rate the filter was sized for.
+static const double kBlockedExpectedCountRatio = 0.9;
+
+static size_t LayoutBytes(size_t n_bytes, BloomFilterLayout layout) {
+  if (layout == BloomFilterLayout::BLOCKED) {
+    return KUDU_ALIGN_UP(n_bytes, BloomFilter::kBucketBytes);
+  }
+  return n_bytes;
+}
+
+BloomFilterBuilder::BloomFilterBuilder(const BloomFilterSizing &sizing,
+                                       BloomFilterLayout layout)
+  : layout_(layout),
+    n_bits_(LayoutBytes(sizing.n_bytes(), layout) * 8),
+    bitmap_(new uint8_t[n_bits_ / 8]),
+    n_hashes_(layout == BloomFilterLayout::BLOCKED ?
+              BloomFilter::kBucketWords :
+              ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
+    expected_count_(layout == BloomFilterLayout::BLOCKED ?
+                    sizing.expected_count() * kBlockedExpectedCountRatio :
+                    sizing.expected_count()),
     n_inserted_(0) {
   Clear();
 }
@@ -75,8 +99,9 @@ double BloomFilterBuilder::false_positive_rate() const {
   return pow(1 - exp(-static_cast<double>(n_hashes_) * expected_count_ / n_bits_), n_hashes_);
 }
 
-BloomFilter::BloomFilter(const Slice &data, size_t n_hashes)
-  : n_bits_(data.size() * 8),
+BloomFilter::BloomFilter(const Slice &data, size_t n_hashes, BloomFilterLayout layout)
+  : layout_(layout),
+    n_bits_(data.size() * 8),
     bitmap_(reinterpret_cast<const uint8_t *>(data.data())),
     n_hashes_(n_hashes)
 {}
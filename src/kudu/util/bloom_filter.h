@@ -17,14 +17,38 @@
 #ifndef KUDU_UTIL_BLOOM_FILTER_H
 #define KUDU_UTIL_BLOOM_FILTER_H
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
 #include "kudu/util/bitmap.h"
 #include "kudu/util/slice.h"
 
 namespace kudu {
 
+// The arrangement of the bits of a bloom filter.
+enum class BloomFilterLayout {
+  // Each of the filter's hash functions picks a bit anywhere in the filter,
+  // so a probe touches one random cache line per hash function.
+  CLASSIC,
+
+  // The filter is divided into 32-byte buckets of eight 32-bit words, and a
+  // key sets one bit in each word of a single bucket. A probe touches only
+  // one cache line, and checks all eight bits with a few SIMD instructions.
+  // For the same number of bits per key, the false positive rate is higher
+  // than with the classic layout, so a builder using this layout expects
+  // about 10% fewer keys for a given sizing.
+  //
+  // See "Cache-, Hash- and Space-Efficient Bloom Filters" (Putze, Sanders
+  // and Singler, WEA 2007) and the split block bloom filters of Impala and
+  // Parquet.
+  BLOCKED
+};
+
 // Probe calculated from a given key. This caches the calculated
 // hash values which are necessary for probing into a Bloom Filter,
 // so that when many bloom filters have to be consulted for a given
@@ -66,6 +90,11 @@ class BloomKeyProbe {
     return h_1_;
   }
 
+  // The second, independent hash value.
+  uint32_t second_hash() const {
+    return h_2_;
+  }
+
   // Mix the given hash function with the second calculated hash
   // value. A sequence of independent hashes can be calculated
   // by repeatedly calling MixHash() on its previous result.
@@ -115,7 +144,11 @@ class BloomFilterBuilder {
  public:
   // Create a bloom filter.
   // See BloomFilterSizing static methods to specify this argument.
-  explicit BloomFilterBuilder(const BloomFilterSizing &sizing);
+  //
+  // With the BLOCKED layout, the size is rounded up to a whole number of
+  // buckets.
+  explicit BloomFilterBuilder(const BloomFilterSizing &sizing,
+                              BloomFilterLayout layout = BloomFilterLayout::CLASSIC);
 
   // Clear all entries, reset insertion count.
   void Clear();
@@ -144,6 +177,8 @@ class BloomFilterBuilder {
   // in the bloom filter.
   size_t n_hashes() const { return n_hashes_; }
 
+  BloomFilterLayout layout() const { return layout_; }
+
   size_t expected_count() const { return expected_count_; }
 
   // Return the number of keys inserted.
@@ -152,6 +187,8 @@ class BloomFilterBuilder {
  private:
   DISALLOW_COPY_AND_ASSIGN(BloomFilterBuilder);
 
+  const BloomFilterLayout layout_;
+
   size_t n_bits_;
   gscoped_array<uint8_t> bitmap_;
 
@@ -169,15 +206,49 @@ class BloomFilterBuilder {
 // Wrapper around a byte array for reading it as a bloom filter.
 class BloomFilter {
  public:
-  BloomFilter(const Slice &data, size_t n_hashes);
+  // 'data' need not be aligned. With the BLOCKED layout, 'n_hashes' is
+  // ignored.
+  BloomFilter(const Slice &data, size_t n_hashes,
+              BloomFilterLayout layout = BloomFilterLayout::CLASSIC);
 
   // Return true if the filter may contain the given key.
   bool MayContainKey(const BloomKeyProbe &probe) const;
 
+  // Return a slice view of the filter's bits.
+  Slice data() const {
+    return Slice(bitmap_, n_bits_ / 8);
+  }
+
+  size_t n_hashes() const { return n_hashes_; }
+
+  BloomFilterLayout layout() const { return layout_; }
+
+  // The size of a bucket of the BLOCKED layout, and the number of 32-bit
+  // words (and hence of bits set per key) in it.
+  static const int kBucketBytes = 32;
+  static const int kBucketWords = kBucketBytes / sizeof(uint32_t);
+
  private:
   friend class BloomFilterBuilder;
   static uint32_t PickBit(uint32_t hash, size_t n_bits);
 
+  // Return the offset of the BLOCKED layout's bucket for 'probe' in a
+  // filter of 'n_bits' bits.
+  static size_t PickBucket(const BloomKeyProbe &probe, size_t n_bits);
+
+  // Return the masks of the bits set for 'probe' in each word of its
+  // BLOCKED layout bucket.
+  static void BucketMasks(const BloomKeyProbe &probe, uint32_t masks[kBucketWords]);
+
+  bool MayContainKeyBlocked(const BloomKeyProbe &probe) const;
+
+  // Odd multipliers used to derive the bit picked in each word of a bucket
+  // from the probe's initial hash. These are the same as in Impala's and
+  // Parquet's split block bloom filters.
+  static const uint32_t kBucketSalts[kBucketWords];
+
+  BloomFilterLayout layout_;
+
   size_t n_bits_;
   const uint8_t *bitmap_;
 
@@ -201,7 +272,56 @@ inline uint32_t BloomFilter::PickBit(uint32_t hash, size_t n_bits) {
   }
 }
 
+inline size_t BloomFilter::PickBucket(const BloomKeyProbe &probe, size_t n_bits) {
+  // Map the hash onto [0, n_buckets) with a multiply and shift, which is
+  // much faster than a modulo.
+  uint64_t n_buckets = n_bits / (kBucketBytes * 8);
+  return ((static_cast<uint64_t>(probe.second_hash()) * n_buckets) >> 32) * kBucketBytes;
+}
+
+inline void BloomFilter::BucketMasks(const BloomKeyProbe &probe,
+                                     uint32_t masks[kBucketWords]) {
+  uint32_t h = probe.initial_hash();
+  for (int i = 0; i < kBucketWords; i++) {
+    masks[i] = 1U << ((h * kBucketSalts[i]) >> 27);
+  }
+}
+
+inline bool BloomFilter::MayContainKeyBlocked(const BloomKeyProbe &probe) const {
+  const uint8_t* bucket = bitmap_ + PickBucket(probe, n_bits_);
+#if defined(__AVX2__)
+  const __m256i salts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kBucketSalts));
+  __m256i shifts = _mm256_srli_epi32(
+      _mm256_mullo_epi32(_mm256_set1_epi32(probe.initial_hash()), salts), 27);
+  __m256i masks = _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+  __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bucket));
+  // testc returns 1 if every bit set in 'masks' is also set in 'words'.
+  return _mm256_testc_si256(words, masks);
+#else
+  uint32_t masks[kBucketWords];
+  BucketMasks(probe, masks);
+  // Accumulate without branching so that the compiler can vectorize.
+  uint32_t missing = 0;
+  for (int i = 0; i < kBucketWords; i++) {
+    missing |= masks[i] & ~UNALIGNED_LOAD32(bucket + i * sizeof(uint32_t));
+  }
+  return missing == 0;
+#endif
+}
+
 inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
+  if (layout_ == BloomFilterLayout::BLOCKED) {
+    uint8_t* bucket = &bitmap_[BloomFilter::PickBucket(probe, n_bits_)];
+    uint32_t masks[BloomFilter::kBucketWords];
+    BloomFilter::BucketMasks(probe, masks);
+    for (int i = 0; i < BloomFilter::kBucketWords; i++) {
+      uint8_t* word = bucket + i * sizeof(uint32_t);
+      UNALIGNED_STORE32(word, UNALIGNED_LOAD32(word) | masks[i]);
+    }
+    n_inserted_++;
+    return;
+  }
+
   uint32_t h = probe.initial_hash();
   for (size_t i = 0; i < n_hashes_; i++) {
     uint32_t bitpos = BloomFilter::PickBit(h, n_bits_);
@@ -212,6 +332,10 @@ inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
 }
 
 inline bool BloomFilter::MayContainKey(const BloomKeyProbe &probe) const {
+  if (layout_ == BloomFilterLayout::BLOCKED) {
+    return MayContainKeyBlocked(probe);
+  }
+
   uint32_t h = probe.initial_hash();
 
   // Basic unrolling by 2s gives a small benefit here since the two bit positions
@@ -5,19 +5,33 @@
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <map>
 #include <memory>
+#include <thread>
 
 #include <vector>
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/cache.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
 #endif // defined(__linux__)
 
+DECLARE_bool(cache_numa_aware);
+DECLARE_bool(cache_use_huge_page_slabs);
+DECLARE_int32(cache_numa_node_for_tests);
+DECLARE_int32(cache_numa_num_nodes_for_tests);
+DECLARE_int32(cache_numa_replicate_remote_hits);
+
+METRIC_DECLARE_counter(block_cache_remote_node_hits);
+METRIC_DECLARE_counter(block_cache_remote_node_replications);
+
 namespace kudu {
 
 // Conversions between numeric keys/values and the types expected by Cache.
@@ -31,8 +45,17 @@ static int DecodeInt(const Slice& k) {
   return DecodeFixed32(k.data());
 }
 
+// The cache implementations exercised by CacheTest.
+enum CacheImpl {
+  LRU_DRAM,
+  LRU_NVM,
+  CLOCK_DRAM,
+  LRU_DRAM_SLAB,
+  LRU_DRAM_NUMA
+};
+
 class CacheTest : public KuduTest,
-                  public ::testing::WithParamInterface<CacheType>,
+                  public ::testing::WithParamInterface<CacheImpl>,
                   public Cache::EvictionCallback {
  public:
 
@@ -58,12 +81,30 @@ class CacheTest : public KuduTest,
     }
 #endif // defined(__linux__)
 
-    cache_.reset(NewLRUCache(GetParam(), kCacheSize, "cache_test"));
+    switch (GetParam()) {
+      case LRU_DRAM:
+        cache_.reset(NewLRUCache(DRAM_CACHE, kCacheSize, "cache_test"));
+        break;
+      case LRU_NVM:
+        cache_.reset(NewLRUCache(NVM_CACHE, kCacheSize, "cache_test"));
+        break;
+      case CLOCK_DRAM:
+        cache_.reset(NewClockCache(kCacheSize, "cache_test"));
+        break;
+      case LRU_DRAM_SLAB:
+        FLAGS_cache_use_huge_page_slabs = true;
+        cache_.reset(NewLRUCache(DRAM_CACHE, kCacheSize, "cache_test"));
+        break;
+      case LRU_DRAM_NUMA:
+        FLAGS_cache_numa_aware = true;
+        cache_.reset(NewLRUCache(DRAM_CACHE, kCacheSize, "cache_test", /* numa_aware= */ true));
+        break;
+    }
 
     MemTracker::FindTracker("cache_test-sharded_lru_cache", &mem_tracker_);
     // Since nvm cache does not have memtracker due to the use of
     // tcmalloc for this we only check for it in the DRAM case.
-    if (GetParam() == DRAM_CACHE) {
+    if (GetParam() != LRU_NVM) {
       ASSERT_TRUE(mem_tracker_.get());
     }
 
@@ -96,9 +137,12 @@ class CacheTest : public KuduTest,
 };
 
 #if defined(__linux__)
-INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest, ::testing::Values(DRAM_CACHE, NVM_CACHE));
+INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest,
+                        ::testing::Values(LRU_DRAM, LRU_NVM, CLOCK_DRAM, LRU_DRAM_SLAB,
+                                          LRU_DRAM_NUMA));
 #else
-INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest, ::testing::Values(DRAM_CACHE));
+INSTANTIATE_TEST_CASE_P(CacheTypes, CacheTest,
+                        ::testing::Values(LRU_DRAM, CLOCK_DRAM, LRU_DRAM_SLAB, LRU_DRAM_NUMA));
 #endif // defined(__linux__)
 
 TEST_P(CacheTest, TrackMemory) {
@@ -231,4 +275,149 @@ TEST_P(CacheTest, NewId) {
   ASSERT_NE(a, b);
 }
 
+// Measures the throughput of concurrent cache hits.
+TEST_P(CacheTest, ConcurrentHitThroughput) {
+  const int kNumKeys = 1000;
+  const int kLookupsPerThread = AllowSlowTests() ? 1000000 : 50000;
+  const int kNumThreads = base::NumCPUs();
+  for (int i = 0; i < kNumKeys; i++) {
+    Insert(i, i);
+  }
+
+  std::atomic<int64_t> hits(0);
+  Stopwatch sw;
+  sw.start();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      int64_t local_hits = 0;
+      for (int i = 0; i < kLookupsPerThread; i++) {
+        local_hits += Lookup((i + t) % kNumKeys) != -1;
+      }
+      hits += local_hits;
+    });
+  }
+  for (std::thread& thr : threads) {
+    thr.join();
+  }
+  sw.stop();
+  ASSERT_EQ(static_cast<int64_t>(kNumThreads) * kLookupsPerThread, hits.load());
+  LOG(INFO) << "Cache implementation " << GetParam() << ": "
+            << (hits.load() / sw.elapsed().wall_seconds()) << " hits/sec with "
+            << kNumThreads << " threads";
+}
+
+// Tests the replication of entries between the shards of different NUMA
+// nodes, on a cache which pretends to span two nodes.
+class NumaCacheTest : public KuduTest {
+ protected:
+  // Deletes the heap-allocated int which a value points to, as caches whose
+  // values own other memory do.
+  class OwningEvictionCallback : public Cache::EvictionCallback {
+   public:
+    void EvictedEntry(Slice /* key */, Slice val) override {
+      int* owned;
+      ASSERT_EQ(sizeof(owned), val.size());
+      memcpy(&owned, val.data(), sizeof(owned));
+      deleted_[*owned]++;
+      delete owned;
+    }
+    std::map<int, int> deleted_;
+  };
+
+  void SetUp() override {
+    KuduTest::SetUp();
+    FLAGS_cache_numa_aware = true;
+    FLAGS_cache_numa_num_nodes_for_tests = 2;
+    FLAGS_cache_numa_node_for_tests = 0;
+    FLAGS_cache_numa_replicate_remote_hits = 1;
+    cache_.reset(NewLRUCache(DRAM_CACHE, 1024 * 1024, "numa_cache_test",
+                             /* numa_aware= */ true));
+    entity_ = METRIC_ENTITY_server.Instantiate(&metric_registry_, "test");
+    cache_->SetMetrics(entity_);
+  }
+
+  void Insert(int key, Cache::EvictionCallback* callback) {
+    int* owned = new int(key);
+    Cache::PendingHandle* handle = CHECK_NOTNULL(
+        cache_->Allocate(EncodeInt(key), sizeof(owned), 1));
+    memcpy(cache_->MutableValue(handle), &owned, sizeof(owned));
+    cache_->Release(cache_->Insert(handle, callback));
+  }
+
+  bool Lookup(int key) {
+    Cache::Handle* handle = cache_->Lookup(EncodeInt(key), Cache::EXPECT_IN_CACHE);
+    if (handle == nullptr) {
+      return false;
+    }
+    cache_->Release(handle);
+    return true;
+  }
+
+  int64_t Replications() {
+    return METRIC_block_cache_remote_node_replications.Instantiate(entity_)->value();
+  }
+
+  MetricRegistry metric_registry_;
+  scoped_refptr<MetricEntity> entity_;
+  gscoped_ptr<Cache> cache_;
+};
+
+// Entries without an eviction callback are copied into the shards of a node
+// which hits them remotely.
+TEST_F(NumaCacheTest, ReplicatesRemoteHits) {
+  const int kNumKeys = 10;
+  for (int i = 0; i < kNumKeys; i++) {
+    string val_str = EncodeInt(i);
+    Cache::PendingHandle* handle = CHECK_NOTNULL(
+        cache_->Allocate(EncodeInt(i), val_str.size(), 1));
+    memcpy(cache_->MutableValue(handle), val_str.data(), val_str.size());
+    cache_->Release(cache_->Insert(handle, nullptr));
+  }
+
+  FLAGS_cache_numa_node_for_tests = 1;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_TRUE(Lookup(i));
+  }
+  ASSERT_EQ(kNumKeys,
+            METRIC_block_cache_remote_node_hits.Instantiate(entity_)->value());
+  ASSERT_EQ(kNumKeys, Replications());
+
+  // The copies are now local to node 1.
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_TRUE(Lookup(i));
+  }
+  ASSERT_EQ(kNumKeys,
+            METRIC_block_cache_remote_node_hits.Instantiate(entity_)->value());
+}
+
+// Entries whose eviction callback owns what the value points to are never
+// copied, or else the callback would free it once per copy.
+TEST_F(NumaCacheTest, NoReplicationWithOwningEvictionCallback) {
+  const int kNumKeys = 10;
+  OwningEvictionCallback callback;
+  for (int i = 0; i < kNumKeys; i++) {
+    Insert(i, &callback);
+  }
+
+  FLAGS_cache_numa_node_for_tests = 1;
+  for (int round = 0; round < 3; round++) {
+    for (int i = 0; i < kNumKeys; i++) {
+      ASSERT_TRUE(Lookup(i));
+    }
+  }
+  ASSERT_EQ(0, Replications());
+
+  // Every value is freed exactly once, whether erased or evicted when the
+  // cache is destroyed.
+  for (int i = 0; i < kNumKeys / 2; i++) {
+    cache_->Erase(EncodeInt(i));
+  }
+  cache_.reset();
+  ASSERT_EQ(kNumKeys, callback.deleted_.size());
+  for (const auto& e : callback.deleted_) {
+    ASSERT_EQ(1, e.second) << "value of key " << e.first;
+  }
+}
+
 }  // namespace kudu
@@ -2,7 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <sched.h>
+
+#include <algorithm>
 #include <cstdlib>
+#include <fstream>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -15,6 +19,9 @@
 #include "kudu/gutil/bits.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/singleton.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/sysinfo.h"
 #include "kudu/util/alignment.h"
@@ -24,6 +31,7 @@
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/mem_tracker.h"
+#include "kudu/util/memory/slab_allocator.h"
 #include "kudu/util/metrics.h"
 
 #if !defined(__APPLE__)
@@ -35,6 +43,45 @@ DEFINE_bool(cache_force_single_shard, false,
             "Override all cache implementations to use just one shard");
 TAG_FLAG(cache_force_single_shard, hidden);
 
+DEFINE_int32(cache_slru_protected_percentage, 80,
+             "For caches using the segmented LRU eviction policy, the percentage of "
+             "the capacity reserved for the protected segment, which holds entries "
+             "that have been looked up at least once since they were inserted.");
+TAG_FLAG(cache_slru_protected_percentage, experimental);
+
+DEFINE_bool(cache_use_huge_page_slabs, false,
+            "Whether the DRAM block cache should allocate its entries from the huge "
+            "page slab allocator instead of the heap, to reduce TLB misses when "
+            "the cache is large.");
+TAG_FLAG(cache_use_huge_page_slabs, experimental);
+
+DEFINE_bool(cache_numa_aware, false,
+            "Whether the block cache should partition its shards by NUMA node. Each "
+            "thread inserts into the shards of the node it runs on, and looks up "
+            "entries in them before those of the other nodes, so that scans mostly "
+            "read cached blocks from node-local memory.");
+TAG_FLAG(cache_numa_aware, experimental);
+
+DEFINE_int32(cache_numa_replicate_remote_hits, 0,
+             "If positive, and --cache_numa_aware is set, an entry which has been "
+             "found in the shards of another NUMA node this many times is copied "
+             "into the shards of the node of the thread which looked it up, so that "
+             "hot entries are eventually cached on every node that reads them.");
+TAG_FLAG(cache_numa_replicate_remote_hits, experimental);
+TAG_FLAG(cache_numa_replicate_remote_hits, runtime);
+
+DEFINE_int32(cache_numa_num_nodes_for_tests, 0,
+             "If positive, the number of NUMA nodes which NUMA-aware caches assume");
+TAG_FLAG(cache_numa_num_nodes_for_tests, hidden);
+TAG_FLAG(cache_numa_num_nodes_for_tests, unsafe);
+
+DEFINE_int32(cache_numa_node_for_tests, -1,
+             "If not negative, the NUMA node which NUMA-aware caches assume every "
+             "thread runs on");
+TAG_FLAG(cache_numa_node_for_tests, hidden);
+TAG_FLAG(cache_numa_node_for_tests, unsafe);
+TAG_FLAG(cache_numa_node_for_tests, runtime);
+
 namespace kudu {
 
 class MetricEntity;
@@ -63,6 +110,11 @@ struct LRUHandle {
   uint32_t val_length;
   Atomic32 refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  bool in_protected;  // Whether the entry is in the protected segment (SLRU only)
+  bool slab_allocated;  // Whether the entry came from the HugePageSlabAllocator
+  Atomic32 referenced;  // Whether the entry was hit since the last sweep (CLOCK only)
+  uint16_t numa_node;   // The NUMA node whose shards hold the entry
+  Atomic32 remote_hits;  // Lookups from threads on other NUMA nodes which hit the entry
 
   // The storage for the key/value pair itself. The data is stored as:
   //   [key bytes ...] [padding up to 8-byte boundary] [value bytes ...]
@@ -86,6 +138,24 @@ struct LRUHandle {
   }
 };
 
+// The number of bytes allocated for an entry with the given key and value
+// lengths.
+size_t HandleAllocationSize(size_t key_len, size_t val_len) {
+  return sizeof(LRUHandle)
+      + KUDU_ALIGN_UP(key_len, sizeof(void*)) + val_len // the kv_data VLA data
+      - 1; // (the VLA has a 1-byte placeholder)
+}
+
+// Release the memory of an entry allocated by ShardedCache::Allocate().
+void DeleteHandle(LRUHandle* e) {
+  if (e->slab_allocated) {
+    HugePageSlabAllocator::Get()->Free(
+        e, HandleAllocationSize(e->key_length, e->val_length));
+  } else {
+    delete [] reinterpret_cast<uint8_t*>(e);
+  }
+}
+
 // We provide our own simple hash table since it removes a whole bunch
 // of porting hacks and is also faster than some of the built-in hash
 // table implementations in some of the compiler/runtime combinations
@@ -173,25 +243,40 @@ class HandleTable {
 };
 
 // A single shard of sharded cache.
+//
+// If 'segmented' is true, the shard uses a segmented LRU (SLRU) policy
+// instead of plain LRU. Newly inserted entries go to a probationary segment
+// and are only promoted to a protected segment when they are looked up
+// again. Eviction takes entries from the probationary segment first, so a
+// large scan which touches each entry once cannot flush the entries which
+// are hit repeatedly. Entries which overflow the protected segment are
+// demoted back to the most recently used end of the probationary segment.
 class LRUCache {
  public:
-  explicit LRUCache(MemTracker* tracker);
+  LRUCache(MemTracker* tracker, bool segmented);
   ~LRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    protected_capacity_ = capacity * FLAGS_cache_slru_protected_percentage / 100;
+  }
 
   void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
 
   Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
-  // Like Cache::Lookup, but with an extra "hash" parameter.
-  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
+  // Like Cache::Lookup, but with an extra "hash" parameter. The lookup is
+  // only recorded in the metrics if 'record' is true.
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching, bool record = true);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
 
  private:
   void LRU_Remove(LRUHandle* e);
-  void LRU_Append(LRUHandle* e);
+  // Make 'e' the newest entry in 'list'.
+  void LRU_Append(LRUHandle* list, LRUHandle* e);
+  // Record a hit on 'e', which is in the cache.
+  void Touch(LRUHandle* e);
   // Just reduce the reference count by 1.
   // Return true if last reference
   bool Unref(LRUHandle* e);
@@ -200,15 +285,22 @@ class LRUCache {
 
   // Initialized before use.
   size_t capacity_;
+  size_t protected_capacity_;
+
+  const bool segmented_;
 
   // mutex_ protects the following state.
   MutexType mutex_;
   size_t usage_;
+  size_t protected_usage_;
 
-  // Dummy head of LRU list.
+  // Dummy head of LRU list. For SLRU, this is the probationary segment.
   // lru.prev is newest entry, lru.next is oldest entry.
   LRUHandle lru_;
 
+  // Dummy head of the protected segment's LRU list. Unused unless segmented_.
+  LRUHandle protected_;
+
   HandleTable table_;
 
   MemTracker* mem_tracker_;
@@ -216,23 +308,29 @@ class LRUCache {
   CacheMetrics* metrics_;
 };
 
-LRUCache::LRUCache(MemTracker* tracker)
- : usage_(0),
+LRUCache::LRUCache(MemTracker* tracker, bool segmented)
+ : segmented_(segmented),
+   usage_(0),
+   protected_usage_(0),
    mem_tracker_(tracker),
    metrics_(nullptr) {
-  // Make empty circular linked list
+  // Make empty circular linked lists
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  protected_.next = &protected_;
+  protected_.prev = &protected_;
 }
 
 LRUCache::~LRUCache() {
-  for (LRUHandle* e = lru_.next; e != &lru_; ) {
-    LRUHandle* next = e->next;
-    DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
-    if (Unref(e)) {
-      FreeEntry(e);
+  for (LRUHandle* list : { &lru_, &protected_ }) {
+    for (LRUHandle* e = list->next; e != list; ) {
+      LRUHandle* next = e->next;
+      DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+      if (Unref(e)) {
+        FreeEntry(e);
+      }
+      e = next;
     }
-    e = next;
   }
 }
 
@@ -241,63 +339,105 @@ bool LRUCache::Unref(LRUHandle* e) {
   return !base::RefCountDec(&e->refs);
 }
 
-void LRUCache::FreeEntry(LRUHandle* e) {
+// Free an entry whose last reference has been dropped, releasing its memory
+// from 'tracker' and updating 'metrics' if not NULL.
+void FreeHandle(LRUHandle* e, MemTracker* tracker, CacheMetrics* metrics) {
   DCHECK_EQ(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
   if (e->eviction_callback) {
     e->eviction_callback->EvictedEntry(e->key(), e->value());
   }
-  mem_tracker_->Release(e->charge);
-  if (PREDICT_TRUE(metrics_)) {
-    metrics_->cache_usage->DecrementBy(e->charge);
-    metrics_->evictions->Increment();
+  tracker->Release(e->charge);
+  if (PREDICT_TRUE(metrics)) {
+    metrics->cache_usage->DecrementBy(e->charge);
+    metrics->evictions->Increment();
   }
-  delete [] e;
+  DeleteHandle(e);
+}
+
+// Update 'metrics', if not NULL, for a lookup which found 'e'.
+void RecordLookup(CacheMetrics* metrics, LRUHandle* e, bool caching) {
+  if (!metrics) {
+    return;
+  }
+  metrics->lookups->Increment();
+  bool was_hit = (e != nullptr);
+  if (was_hit) {
+    if (caching) {
+      metrics->cache_hits_caching->Increment();
+    } else {
+      metrics->cache_hits->Increment();
+    }
+  } else {
+    if (caching) {
+      metrics->cache_misses_caching->Increment();
+    } else {
+      metrics->cache_misses->Increment();
+    }
+  }
+}
+
+void LRUCache::FreeEntry(LRUHandle* e) {
+  FreeHandle(e, mem_tracker_, metrics_);
 }
 
 void LRUCache::LRU_Remove(LRUHandle* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
   usage_ -= e->charge;
+  if (e->in_protected) {
+    protected_usage_ -= e->charge;
+  }
 }
 
-void LRUCache::LRU_Append(LRUHandle* e) {
-  // Make "e" newest entry by inserting just before lru_
-  e->next = &lru_;
-  e->prev = lru_.prev;
+void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
+  // Make "e" newest entry by inserting just before the list head
+  e->next = list;
+  e->prev = list->prev;
   e->prev->next = e;
   e->next->prev = e;
   usage_ += e->charge;
+  e->in_protected = list == &protected_;
+  if (e->in_protected) {
+    protected_usage_ += e->charge;
+  }
 }
 
-Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
+void LRUCache::Touch(LRUHandle* e) {
+  LRU_Remove(e);
+  if (!segmented_) {
+    LRU_Append(&lru_, e);
+    return;
+  }
+  LRU_Append(&protected_, e);
+  // Demote the oldest protected entries if the protected segment overflows.
+  // The entry just promoted is never demoted, even if it alone exceeds the
+  // protected segment's capacity.
+  while (protected_usage_ > protected_capacity_ && protected_.next != e) {
+    LRUHandle* old = protected_.next;
+    LRU_Remove(old);
+    LRU_Append(&lru_, old);
+  }
+}
+
+Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching, bool record) {
   LRUHandle* e;
   {
     std::lock_guard<MutexType> l(mutex_);
     e = table_.Lookup(key, hash);
     if (e != nullptr) {
       base::RefCountInc(&e->refs);
-      LRU_Remove(e);
-      LRU_Append(e);
+      // A segmented cache ignores lookups by callers that don't expect to
+      // find the entry in the cache, such as one-time scans, so that they
+      // neither promote entries nor refresh their recency.
+      if (caching || !segmented_) {
+        Touch(e);
+      }
     }
   }
 
   // Do the metrics outside of the lock.
-  if (metrics_) {
-    metrics_->lookups->Increment();
-    bool was_hit = (e != nullptr);
-    if (was_hit) {
-      if (caching) {
-        metrics_->cache_hits_caching->Increment();
-      } else {
-        metrics_->cache_hits->Increment();
-      }
-    } else {
-      if (caching) {
-        metrics_->cache_misses_caching->Increment();
-      } else {
-        metrics_->cache_misses->Increment();
-      }
-    }
+  if (record) {
+    RecordLookup(metrics_, e, caching);
   }
 
   return reinterpret_cast<Cache::Handle*>(e);
@@ -327,7 +467,7 @@ Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_
   {
     std::lock_guard<MutexType> l(mutex_);
 
-    LRU_Append(e);
+    LRU_Append(&lru_, e);
 
     LRUHandle* old = table_.Insert(e);
     if (old != nullptr) {
@@ -338,8 +478,10 @@ Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_
       }
     }
 
-    while (usage_ > capacity_ && lru_.next != &lru_) {
-      LRUHandle* old = lru_.next;
+    while (usage_ > capacity_ && (lru_.next != &lru_ || protected_.next != &protected_)) {
+      // Evict from the probationary segment first. With plain LRU, the
+      // protected segment is always empty.
+      LRUHandle* old = lru_.next != &lru_ ? lru_.next : protected_.next;
       LRU_Remove(old);
       table_.Remove(old->key(), old->hash);
       if (Unref(old)) {
@@ -378,24 +520,318 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   }
 }
 
+// A single shard of a cache using the CLOCK eviction policy.
+//
+// Unlike LRUCache, a hit doesn't reorder any list: it only bumps the entry's
+// atomic refcount and sets its reference bit. The hash table is guarded by a
+// per-CPU reader-writer lock, so concurrent lookups don't contend on a shared
+// cache line; only inserts and erases take the lock exclusively.
+//
+// Entries are kept on a circular list (the "clock"). When the shard is over
+// capacity, the hand sweeps the clock: an entry whose reference bit is set
+// has it cleared and is skipped, and the first entry found without it is
+// evicted. This approximates LRU, since an entry survives a sweep only if it
+// was hit since the previous one.
+class ClockCache {
+ public:
+  explicit ClockCache(MemTracker* tracker);
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of ClockCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
+
+  Cache::Handle* Insert(LRUHandle* e, Cache::EvictionCallback* eviction_callback);
+  // Like Cache::Lookup, but with an extra "hash" parameter. The lookup is
+  // only recorded in the metrics if 'record' is true.
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching, bool record = true);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+
+ private:
+  // Add 'e' to the clock just behind the hand, so that it's the last entry
+  // to be visited by the next sweep.
+  void Clock_Append(LRUHandle* e);
+  // Remove 'e' from the clock, advancing the hand if it points at 'e'.
+  void Clock_Remove(LRUHandle* e);
+  // Just reduce the reference count by 1.
+  // Return true if last reference
+  bool Unref(LRUHandle* e);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // lock_ protects the following state. Lookups take it in shared mode,
+  // all mutations take it in exclusive mode.
+  percpu_rwlock lock_;
+  size_t usage_;
+
+  // Dummy head of the clock's circular list.
+  LRUHandle clock_;
+
+  // The next entry to be visited by a sweep, or &clock_.
+  LRUHandle* hand_;
+
+  HandleTable table_;
+
+  MemTracker* mem_tracker_;
+
+  CacheMetrics* metrics_;
+};
+
+ClockCache::ClockCache(MemTracker* tracker)
+ : usage_(0),
+   hand_(&clock_),
+   mem_tracker_(tracker),
+   metrics_(nullptr) {
+  // Make empty circular linked list
+  clock_.next = &clock_;
+  clock_.prev = &clock_;
+}
+
+ClockCache::~ClockCache() {
+  for (LRUHandle* e = clock_.next; e != &clock_; ) {
+    LRUHandle* next = e->next;
+    DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+    if (Unref(e)) {
+      FreeHandle(e, mem_tracker_, metrics_);
+    }
+    e = next;
+  }
+}
+
+bool ClockCache::Unref(LRUHandle* e) {
+  DCHECK_GT(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  return !base::RefCountDec(&e->refs);
+}
+
+void ClockCache::Clock_Append(LRUHandle* e) {
+  e->next = hand_;
+  e->prev = hand_->prev;
+  e->prev->next = e;
+  e->next->prev = e;
+  usage_ += e->charge;
+}
+
+void ClockCache::Clock_Remove(LRUHandle* e) {
+  if (hand_ == e) {
+    hand_ = e->next;
+  }
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+  usage_ -= e->charge;
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash, bool caching, bool record) {
+  LRUHandle* e;
+  {
+    shared_lock<rw_spinlock> l(lock_.get_lock());
+    e = table_.Lookup(key, hash);
+    if (e != nullptr) {
+      base::RefCountInc(&e->refs);
+      // Avoid dirtying the entry's cache line if the bit is already set.
+      if (!base::subtle::NoBarrier_Load(&e->referenced)) {
+        base::subtle::NoBarrier_Store(&e->referenced, 1);
+      }
+    }
+  }
+
+  if (record) {
+    RecordLookup(metrics_, e, caching);
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
+  bool last_reference = Unref(e);
+  if (last_reference) {
+    FreeHandle(e, mem_tracker_, metrics_);
+  }
+}
+
+Cache::Handle* ClockCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback) {
+
+  // Set the remaining LRUHandle members which were not already allocated during
+  // Allocate().
+  e->eviction_callback = eviction_callback;
+  e->refs = 2;  // One from ClockCache, one for the returned handle
+  e->referenced = 0;
+  mem_tracker_->Consume(e->charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->IncrementBy(e->charge);
+    metrics_->inserts->Increment();
+  }
+
+  LRUHandle* to_remove_head = nullptr;
+  {
+    std::lock_guard<percpu_rwlock> l(lock_);
+
+    Clock_Append(e);
+
+    LRUHandle* old = table_.Insert(e);
+    if (old != nullptr) {
+      Clock_Remove(old);
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+
+    // No lookups can set reference bits while the lock is held exclusively,
+    // so this terminates within two revolutions of the hand.
+    while (usage_ > capacity_ && clock_.next != &clock_) {
+      if (hand_ == &clock_) {
+        hand_ = clock_.next;
+      }
+      LRUHandle* victim = hand_;
+      if (victim->referenced) {
+        victim->referenced = 0;
+        hand_ = victim->next;
+        continue;
+      }
+      Clock_Remove(victim);
+      table_.Remove(victim->key(), victim->hash);
+      if (Unref(victim)) {
+        victim->next = to_remove_head;
+        to_remove_head = victim;
+      }
+    }
+  }
+
+  // we free the entries here outside of the lock for
+  // performance reasons
+  while (to_remove_head != nullptr) {
+    LRUHandle* next = to_remove_head->next;
+    FreeHandle(to_remove_head, mem_tracker_, metrics_);
+    to_remove_head = next;
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  LRUHandle* e;
+  bool last_reference = false;
+  {
+    std::lock_guard<percpu_rwlock> l(lock_);
+    e = table_.Remove(key, hash);
+    if (e != nullptr) {
+      Clock_Remove(e);
+      last_reference = Unref(e);
+    }
+  }
+  // lock not held here
+  // last_reference will only be true if e != NULL
+  if (last_reference) {
+    FreeHandle(e, mem_tracker_, metrics_);
+  }
+}
+
+// The NUMA nodes of the machine, and the node of each CPU, as listed in
+// sysfs. If the kernel doesn't list the nodes, all CPUs are on node 0.
+class NumaTopology {
+ public:
+  static NumaTopology* Get() {
+    return Singleton<NumaTopology>::get();
+  }
+
+  int num_nodes() const { return num_nodes_; }
+
+  // Returns the node of the CPU which the calling thread runs on.
+  int CurrentNode() const {
+#if defined(__APPLE__)
+    return 0;
+#else
+    int cpu = sched_getcpu();
+    return PREDICT_TRUE(cpu >= 0 && cpu < cpu_nodes_.size()) ? cpu_nodes_[cpu] : 0;
+#endif  // defined(__APPLE__)
+  }
+
+ private:
+  friend class Singleton<NumaTopology>;
+
+  NumaTopology()
+      : num_nodes_(0),
+        cpu_nodes_(base::MaxCPUIndex() + 1, 0) {
+    // Node IDs may have gaps, so they are numbered densely in order.
+    static const int kMaxNodeId = 1024;
+    for (int id = 0; id < kMaxNodeId; id++) {
+      std::ifstream f(strings::Substitute("/sys/devices/system/node/node$0/cpulist", id));
+      string cpulist;
+      if (!f || !std::getline(f, cpulist)) {
+        continue;
+      }
+      // The list is of the form "0-7,16-23".
+      for (const string& range : strings::Split(cpulist, ",", strings::SkipEmpty())) {
+        vector<string> bounds = strings::Split(range, "-");
+        int32_t first;
+        int32_t last;
+        if (!safe_strto32(bounds[0], &first)) continue;
+        if (bounds.size() < 2 || !safe_strto32(bounds[1], &last)) last = first;
+        for (int cpu = first; cpu <= last && cpu < cpu_nodes_.size(); cpu++) {
+          cpu_nodes_[cpu] = num_nodes_;
+        }
+      }
+      num_nodes_++;
+    }
+    num_nodes_ = std::max(num_nodes_, 1);
+    VLOG(1) << "Found " << num_nodes_ << " NUMA nodes";
+  }
+
+  int num_nodes_;
+  vector<int> cpu_nodes_;
+
+  DISALLOW_COPY_AND_ASSIGN(NumaTopology);
+};
+
+// Determine the number of NUMA nodes which the cache shards are partitioned
+// by.
+int DetermineNumNodes(bool numa_aware) {
+  if (!numa_aware || !FLAGS_cache_numa_aware ||
+      PREDICT_FALSE(FLAGS_cache_force_single_shard)) {
+    return 1;
+  }
+  if (PREDICT_FALSE(FLAGS_cache_numa_num_nodes_for_tests > 0)) {
+    return FLAGS_cache_numa_num_nodes_for_tests;
+  }
+  return NumaTopology::Get()->num_nodes();
+}
+
 // Determine the number of bits of the hash that should be used to determine
-// the cache shard. This, in turn, determines the number of shards.
-int DetermineShardBits() {
+// the cache shard among those of a node. This, in turn, determines the
+// number of shards.
+int DetermineShardBits(int num_nodes) {
   int bits = PREDICT_FALSE(FLAGS_cache_force_single_shard) ?
-      0 : Bits::Log2Ceiling(base::NumCPUs());
-  VLOG(1) << "Will use " << (1 << bits) << " shards for LRU cache.";
+      0 : Bits::Log2Ceiling(std::max(1, base::NumCPUs() / num_nodes));
+  VLOG(1) << "Will use " << num_nodes * (1 << bits) << " shards for LRU cache.";
   return bits;
 }
 
-class ShardedLRUCache : public Cache {
+// A cache which partitions its entries across a number of shards of type
+// ShardType (LRUCache or ClockCache) by the hash of their keys.
+//
+// If the cache is created NUMA-aware and --cache_numa_aware is set, there is
+// a group of shards per NUMA node. An
+// entry is inserted into the group of the node of the inserting thread, and
+// is allocated and filled in by that thread, so the kernel places it in
+// that node's memory. Lookups try the group of the looking-up thread's node
+// first, and then those of the other nodes.
+template<class ShardType>
+class ShardedCache : public Cache {
  private:
   shared_ptr<MemTracker> mem_tracker_;
   gscoped_ptr<CacheMetrics> metrics_;
-  vector<LRUCache*> shards_;
+  vector<ShardType*> shards_;
   MutexType id_mutex_;
   uint64_t last_id_;
 
-  // Number of bits of hash used to determine the shard.
+  // Number of NUMA nodes which the shards are partitioned by.
+  const int num_nodes_;
+
+  // Number of bits of hash used to determine the shard among those of a node.
   const int shard_bits_;
 
   static inline uint32_t HashSlice(const Slice& s) {
@@ -409,45 +845,116 @@ class ShardedLRUCache : public Cache {
     return static_cast<uint64_t>(hash) >> (32 - shard_bits_);
   }
 
+  ShardType* NodeShard(int node, uint32_t hash) {
+    return shards_[(node << shard_bits_) + Shard(hash)];
+  }
+
+  int LocalNode() const {
+    if (num_nodes_ == 1) {
+      return 0;
+    }
+    if (PREDICT_FALSE(FLAGS_cache_numa_node_for_tests >= 0)) {
+      return FLAGS_cache_numa_node_for_tests % num_nodes_;
+    }
+    return NumaTopology::Get()->CurrentNode();
+  }
+
+  // Looks up 'key' in the shards of the local node, then in those of the
+  // other nodes.
+  Handle* NumaLookup(const Slice& key, uint32_t hash, bool caching) {
+    const int local = LocalNode();
+    LRUHandle* e = reinterpret_cast<LRUHandle*>(
+        NodeShard(local, hash)->Lookup(key, hash, caching, /* record= */ false));
+    for (int i = 1; e == nullptr && i < num_nodes_; i++) {
+      const int node = (local + i) % num_nodes_;
+      e = reinterpret_cast<LRUHandle*>(
+          NodeShard(node, hash)->Lookup(key, hash, caching, /* record= */ false));
+      if (e != nullptr) {
+        if (metrics_) {
+          metrics_->remote_node_hits->Increment();
+        }
+        e = MaybeReplicate(e, local);
+      }
+    }
+    RecordLookup(metrics_.get(), e, caching);
+    return reinterpret_cast<Handle*>(e);
+  }
+
+  // Copies 'e', found in the shards of another node, into those of 'node' if
+  // it has been hit from other nodes often enough, returning the handle
+  // which the caller should use.
+  //
+  // Entries with an eviction callback are never copied: the callback may own
+  // whatever the value points to, and would then free it once per copy.
+  LRUHandle* MaybeReplicate(LRUHandle* e, int node) {
+    const int threshold = FLAGS_cache_numa_replicate_remote_hits;
+    // Only the lookup which reaches the threshold copies the entry.
+    if (threshold <= 0 || e->eviction_callback != nullptr ||
+        base::subtle::NoBarrier_AtomicIncrement(&e->remote_hits, 1) != threshold) {
+      return e;
+    }
+    LRUHandle* copy = reinterpret_cast<LRUHandle*>(
+        Allocate(e->key(), e->val_length, e->charge));
+    memcpy(copy->mutable_val_ptr(), e->val_ptr(), e->val_length);
+    copy->numa_node = node;
+    Handle* h = NodeShard(node, copy->hash)->Insert(copy, e->eviction_callback);
+    Release(reinterpret_cast<Handle*>(e));
+    if (metrics_) {
+      metrics_->remote_node_replications->Increment();
+    }
+    return reinterpret_cast<LRUHandle*>(h);
+  }
+
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& id)
+  // Each shard is constructed with the cache's MemTracker followed by
+  // 'shard_args'.
+  template<class... ShardArgs>
+  ShardedCache(size_t capacity, const string& id, bool numa_aware, ShardArgs... shard_args)
       : last_id_(0),
-        shard_bits_(DetermineShardBits()) {
+        num_nodes_(DetermineNumNodes(numa_aware)),
+        shard_bits_(DetermineShardBits(num_nodes_)) {
     // A cache is often a singleton, so:
     // 1. We reuse its MemTracker if one already exists, and
     // 2. It is directly parented to the root MemTracker.
     mem_tracker_ = MemTracker::FindOrCreateGlobalTracker(
         -1, strings::Substitute("$0-sharded_lru_cache", id));
 
-    int num_shards = 1 << shard_bits_;
+    int num_shards = num_nodes_ << shard_bits_;
     const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
     for (int s = 0; s < num_shards; s++) {
-      gscoped_ptr<LRUCache> shard(new LRUCache(mem_tracker_.get()));
+      gscoped_ptr<ShardType> shard(new ShardType(mem_tracker_.get(), shard_args...));
       shard->SetCapacity(per_shard);
       shards_.push_back(shard.release());
     }
   }
 
-  virtual ~ShardedLRUCache() {
+  virtual ~ShardedCache() {
     STLDeleteElements(&shards_);
   }
 
   virtual Handle* Insert(PendingHandle* handle,
                          Cache::EvictionCallback* eviction_callback) OVERRIDE {
     LRUHandle* h = reinterpret_cast<LRUHandle*>(DCHECK_NOTNULL(handle));
-    return shards_[Shard(h->hash)]->Insert(h, eviction_callback);
+    h->numa_node = LocalNode();
+    return NodeShard(h->numa_node, h->hash)->Insert(h, eviction_callback);
   }
   virtual Handle* Lookup(const Slice& key, CacheBehavior caching) OVERRIDE {
     const uint32_t hash = HashSlice(key);
-    return shards_[Shard(hash)]->Lookup(key, hash, caching == EXPECT_IN_CACHE);
+    if (num_nodes_ > 1) {
+      return NumaLookup(key, hash, caching == EXPECT_IN_CACHE);
+    }
+    return NodeShard(0, hash)->Lookup(key, hash, caching == EXPECT_IN_CACHE);
   }
   virtual void Release(Handle* handle) OVERRIDE {
     LRUHandle* h = reinterpret_cast<LRUHandle*>(handle);
-    shards_[Shard(h->hash)]->Release(handle);
+    NodeShard(h->numa_node, h->hash)->Release(handle);
   }
   virtual void Erase(const Slice& key) OVERRIDE {
+    // The entry may have been inserted, or replicated, on any node.
     const uint32_t hash = HashSlice(key);
-    shards_[Shard(hash)]->Erase(key, hash);
+    for (int node = 0; node < num_nodes_; node++) {
+      NodeShard(node, hash)->Erase(key, hash);
+    }
   }
   virtual Slice Value(Handle* handle) OVERRIDE {
     return reinterpret_cast<LRUHandle*>(handle)->value();
@@ -459,7 +966,7 @@ class ShardedLRUCache : public Cache {
 
   virtual void SetMetrics(const scoped_refptr<MetricEntity>& entity) OVERRIDE {
     metrics_.reset(new CacheMetrics(entity));
-    for (LRUCache* cache : shards_) {
+    for (ShardType* cache : shards_) {
       cache->SetMetrics(metrics_.get());
     }
   }
@@ -468,24 +975,30 @@ class ShardedLRUCache : public Cache {
     int key_len = key.size();
     DCHECK_GE(key_len, 0);
     DCHECK_GE(val_len, 0);
-    int key_len_padded = KUDU_ALIGN_UP(key_len, sizeof(void*));
-    uint8_t* buf = new uint8_t[sizeof(LRUHandle)
-                               + key_len_padded + val_len // the kv_data VLA data
-                               - 1 // (the VLA has a 1-byte placeholder)
-                               ];
+    size_t size = HandleAllocationSize(key_len, val_len);
+    uint8_t* buf = nullptr;
+    if (FLAGS_cache_use_huge_page_slabs) {
+      buf = static_cast<uint8_t*>(HugePageSlabAllocator::Get()->Allocate(size));
+    }
+    bool slab_allocated = buf != nullptr;
+    if (!slab_allocated) {
+      buf = new uint8_t[size];
+    }
     LRUHandle* handle = reinterpret_cast<LRUHandle*>(buf);
+    handle->slab_allocated = slab_allocated;
     handle->key_length = key_len;
     handle->val_length = val_len;
     handle->charge = charge;
     handle->hash = HashSlice(key);
+    handle->numa_node = 0;
+    handle->remote_hits = 0;
     memcpy(handle->kv_data, key.data(), key_len);
 
     return reinterpret_cast<PendingHandle*>(handle);
   }
 
   virtual void Free(PendingHandle* h) OVERRIDE {
-    uint8_t* data = reinterpret_cast<uint8_t*>(h);
-    delete [] data;
+    DeleteHandle(reinterpret_cast<LRUHandle*>(h));
   }
 
   virtual uint8_t* MutableValue(PendingHandle* h) OVERRIDE {
@@ -496,10 +1009,10 @@ class ShardedLRUCache : public Cache {
 
 }  // end anonymous namespace
 
-Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
+Cache* NewLRUCache(CacheType type, size_t capacity, const string& id, bool numa_aware) {
   switch (type) {
     case DRAM_CACHE:
-      return new ShardedLRUCache(capacity, id);
+      return new ShardedCache<LRUCache>(capacity, id, numa_aware, /* segmented= */ false);
 #if !defined(__APPLE__)
     case NVM_CACHE:
       return NewLRUNvmCache(capacity, id);
@@ -509,4 +1022,12 @@ Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
   }
 }
 
+Cache* NewSLRUCache(size_t capacity, const string& id, bool numa_aware) {
+  return new ShardedCache<LRUCache>(capacity, id, numa_aware, /* segmented= */ true);
+}
+
+Cache* NewClockCache(size_t capacity, const string& id, bool numa_aware) {
+  return new ShardedCache<ClockCache>(capacity, id, numa_aware);
+}
+
 }  // namespace kudu
@@ -39,7 +39,27 @@ enum CacheType {
 
 // Create a new cache with a fixed size capacity.  This implementation
 // of Cache uses a least-recently-used eviction policy.
-Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id);
+//
+// If 'numa_aware' is true and --cache_numa_aware is set, a DRAM cache
+// partitions its shards by NUMA node, and may copy values between nodes.
+// Caches whose eviction callbacks own what their values point to must not
+// be NUMA-aware.
+Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id,
+                   bool numa_aware = false);
+
+// Create a new DRAM cache with a fixed size capacity which uses a
+// scan-resistant segmented LRU eviction policy. Entries must be looked up
+// again after insertion (with EXPECT_IN_CACHE) to be protected from eviction
+// by entries which are only used once.
+// 'numa_aware' is as for NewLRUCache().
+Cache* NewSLRUCache(size_t capacity, const std::string& id, bool numa_aware = false);
+
+// Create a new DRAM cache with a fixed size capacity which uses the CLOCK
+// eviction policy. Cache hits don't take any exclusive lock, so lookup
+// throughput scales better with the number of concurrent readers than with
+// NewLRUCache(), at the cost of a coarser approximation of LRU.
+// 'numa_aware' is as for NewLRUCache().
+Cache* NewClockCache(size_t capacity, const std::string& id, bool numa_aware = false);
 
 class Cache {
  public:
@@ -101,6 +121,8 @@ class Cache {
   // with the basic metrics.
   // Passing NO_EXPECT_IN_CACHE will only increment the basic metrics.
   // This helps in determining if we are effectively caching the blocks that matter the most.
+  // Scan-resistant caches also don't count NO_EXPECT_IN_CACHE lookups as uses of the entry
+  // when deciding what to evict.
   enum CacheBehavior {
     EXPECT_IN_CACHE,
     NO_EXPECT_IN_CACHE
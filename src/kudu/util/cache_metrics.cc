@@ -45,10 +45,46 @@ METRIC_DEFINE_counter(server, block_cache_hits_caching,
                       "Use this number instead of cache_hits when trying to determine how "
                       "efficient the cache is");
 
+METRIC_DEFINE_counter(server, block_cache_remote_node_hits,
+                      "Block Cache Remote NUMA Node Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups that found a block in the shards of another NUMA "
+                      "node than that of the looking-up thread. Only counted with "
+                      "--cache_numa_aware.");
+METRIC_DEFINE_counter(server, block_cache_remote_node_replications,
+                      "Block Cache Remote NUMA Node Replications", kudu::MetricUnit::kBlocks,
+                      "Number of blocks copied into the shards of a NUMA node after being "
+                      "found in those of another node often enough");
+
 METRIC_DEFINE_gauge_uint64(server, block_cache_usage, "Block Cache Memory Usage",
                            kudu::MetricUnit::kBytes,
                            "Memory consumed by the block cache");
 
+METRIC_DEFINE_counter(server, block_cache_compressed_inserts,
+                      "Compressed Block Cache Inserts", kudu::MetricUnit::kBlocks,
+                      "Number of compressed blocks inserted in the compressed tier of "
+                      "the block cache");
+METRIC_DEFINE_counter(server, block_cache_compressed_lookups,
+                      "Compressed Block Cache Lookups", kudu::MetricUnit::kBlocks,
+                      "Number of blocks looked up from the compressed tier of the block "
+                      "cache after missing in the block cache");
+METRIC_DEFINE_counter(server, block_cache_compressed_evictions,
+                      "Compressed Block Cache Evictions", kudu::MetricUnit::kBlocks,
+                      "Number of compressed blocks evicted from the compressed tier of "
+                      "the block cache");
+METRIC_DEFINE_counter(server, block_cache_compressed_hits,
+                      "Compressed Block Cache Hits", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the compressed tier of the block cache that "
+                      "found a block, saving a read from disk");
+METRIC_DEFINE_counter(server, block_cache_compressed_misses,
+                      "Compressed Block Cache Misses", kudu::MetricUnit::kBlocks,
+                      "Number of lookups in the compressed tier of the block cache that "
+                      "didn't yield a block");
+
+METRIC_DEFINE_gauge_uint64(server, block_cache_compressed_usage,
+                           "Compressed Block Cache Memory Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Memory consumed by the compressed tier of the block cache");
+
 namespace kudu {
 
 #define MINIT(member, x) member(METRIC_##x.Instantiate(entity))
@@ -61,8 +97,20 @@ CacheMetrics::CacheMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(cache_hits_caching, block_cache_hits_caching),
     MINIT(cache_misses, block_cache_misses),
     MINIT(cache_misses_caching, block_cache_misses_caching),
+    MINIT(remote_node_hits, block_cache_remote_node_hits),
+    MINIT(remote_node_replications, block_cache_remote_node_replications),
     GINIT(cache_usage, block_cache_usage) {
 }
+
+CompressedBlockCacheMetrics::CompressedBlockCacheMetrics(
+    const scoped_refptr<MetricEntity>& entity)
+  : MINIT(inserts, block_cache_compressed_inserts),
+    MINIT(lookups, block_cache_compressed_lookups),
+    MINIT(evictions, block_cache_compressed_evictions),
+    MINIT(cache_hits, block_cache_compressed_hits),
+    MINIT(cache_misses, block_cache_compressed_misses),
+    GINIT(cache_usage, block_cache_compressed_usage) {
+}
 #undef MINIT
 #undef GINIT
 
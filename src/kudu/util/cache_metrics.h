@@ -39,6 +39,21 @@ struct CacheMetrics {
   scoped_refptr<Counter> cache_hits_caching;
   scoped_refptr<Counter> cache_misses;
   scoped_refptr<Counter> cache_misses_caching;
+  scoped_refptr<Counter> remote_node_hits;
+  scoped_refptr<Counter> remote_node_replications;
+
+  scoped_refptr<AtomicGauge<uint64_t> > cache_usage;
+};
+
+// Metrics for the compressed tier of the block cache.
+struct CompressedBlockCacheMetrics {
+  explicit CompressedBlockCacheMetrics(const scoped_refptr<MetricEntity>& metric_entity);
+
+  scoped_refptr<Counter> inserts;
+  scoped_refptr<Counter> lookups;
+  scoped_refptr<Counter> evictions;
+  scoped_refptr<Counter> cache_hits;
+  scoped_refptr<Counter> cache_misses;
 
   scoped_refptr<AtomicGauge<uint64_t> > cache_usage;
 };
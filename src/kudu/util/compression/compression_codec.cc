@@ -20,17 +20,38 @@
 #include <string>
 #include <vector>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <lz4.h>
 #include <snappy-sinksource.h>
 #include <snappy.h>
 #include <zlib.h>
+#include <zstd.h>
 
 
 #include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/string_case.h"
+#include "kudu/util/threadlocal.h"
+
+DEFINE_int32(zstd_compression_level, 3,
+             "Compression level used by the ZSTD codec, from 1 (fastest) to 22 (smallest). "
+             "Levels above 19 use substantially more memory to compress.");
+TAG_FLAG(zstd_compression_level, experimental);
+TAG_FLAG(zstd_compression_level, runtime);
+
+static bool ValidateZstdCompressionLevel(const char* flagname, int32_t value) {
+  if (value >= 1 && value <= ZSTD_maxCLevel()) {
+    return true;
+  }
+  LOG(ERROR) << flagname << " must be between 1 and " << ZSTD_maxCLevel()
+             << ", value " << value << " is invalid";
+  return false;
+}
+static bool dummy = google::RegisterFlagValidator(
+    &FLAGS_zstd_compression_level, &ValidateZstdCompressionLevel);
 
 namespace kudu {
 
@@ -241,6 +262,78 @@ class ZlibCodec : public CompressionCodec {
   }
 };
 
+class ZstdCodec : public CompressionCodec {
+ public:
+  static ZstdCodec *GetSingleton() {
+    return Singleton<ZstdCodec>::get();
+  }
+
+  Status Compress(const Slice& input,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    BLOCK_STATIC_THREAD_LOCAL(Contexts, contexts);
+    size_t n = ZSTD_compressCCtx(contexts->cctx, compressed, MaxCompressedLength(input.size()),
+                                 input.data(), input.size(), FLAGS_zstd_compression_level);
+    if (ZSTD_isError(n)) {
+      return Status::IOError("unable to compress the buffer", ZSTD_getErrorName(n));
+    }
+    *compressed_length = n;
+    return Status::OK();
+  }
+
+  Status Compress(const vector<Slice>& input_slices,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    if (input_slices.size() == 1) {
+      return Compress(input_slices[0], compressed, compressed_length);
+    }
+
+    SlicesSource source(input_slices);
+    faststring buffer;
+    source.Dump(&buffer);
+    return Compress(Slice(buffer.data(), buffer.size()), compressed, compressed_length);
+  }
+
+  Status Uncompress(const Slice& compressed,
+                    uint8_t *uncompressed, size_t uncompressed_length) const OVERRIDE {
+    BLOCK_STATIC_THREAD_LOCAL(Contexts, contexts);
+    size_t n = ZSTD_decompressDCtx(contexts->dctx, uncompressed, uncompressed_length,
+                                   compressed.data(), compressed.size());
+    if (ZSTD_isError(n)) {
+      return Status::Corruption("unable to uncompress the buffer", ZSTD_getErrorName(n));
+    }
+    if (n != uncompressed_length) {
+      return Status::Corruption(
+          StringPrintf("unable to uncompress the buffer: expected %zu bytes, got %zu",
+                       uncompressed_length, n));
+    }
+    return Status::OK();
+  }
+
+  size_t MaxCompressedLength(size_t source_bytes) const OVERRIDE {
+    return ZSTD_compressBound(source_bytes);
+  }
+
+  CompressionType type() const override {
+    return ZSTD;
+  }
+
+ private:
+  // Per-thread compression and decompression contexts. Reusing the
+  // contexts avoids allocating and initializing the codec's internal state
+  // (several hundred KB at the default level) for every block.
+  struct Contexts {
+    Contexts()
+        : cctx(CHECK_NOTNULL(ZSTD_createCCtx())),
+          dctx(CHECK_NOTNULL(ZSTD_createDCtx())) {
+    }
+    ~Contexts() {
+      ZSTD_freeCCtx(cctx);
+      ZSTD_freeDCtx(dctx);
+    }
+    ZSTD_CCtx* const cctx;
+    ZSTD_DCtx* const dctx;
+  };
+};
+
 Status GetCompressionCodec(CompressionType compression,
                            const CompressionCodec** codec) {
   switch (compression) {
@@ -256,6 +349,9 @@ Status GetCompressionCodec(CompressionType compression,
     case ZLIB:
       *codec = ZlibCodec::GetSingleton();
       break;
+    case ZSTD:
+      *codec = ZstdCodec::GetSingleton();
+      break;
     default:
       return Status::NotFound("bad compression type");
   }
@@ -272,6 +368,8 @@ CompressionType GetCompressionCodecType(const std::string& name) {
     return LZ4;
   if (uname.compare("ZLIB") == 0)
     return ZLIB;
+  if (uname.compare("ZSTD") == 0)
+    return ZSTD;
   if (uname.compare("NONE") == 0)
     return NO_COMPRESSION;
 
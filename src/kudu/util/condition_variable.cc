@@ -4,16 +4,45 @@
 
 #include "kudu/util/condition_variable.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include <errno.h>
 #include <sys/time.h>
 
+#include "kudu/gutil/walltime.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/spinlock_profiling.h"
 #include "kudu/util/thread_restrictions.h"
 
+DEFINE_bool(contention_profile_condition_variable_waits, false,
+            "Whether waits on condition variables are recorded in contention "
+            "profiles, along with the contention on locks. Idle threads "
+            "usually wait on condition variables, so these waits tend to "
+            "dominate the profile.");
+TAG_FLAG(contention_profile_condition_variable_waits, experimental);
+TAG_FLAG(contention_profile_condition_variable_waits, runtime);
+
 namespace kudu {
 
+namespace {
+
+// Returns the cycle count at the start of a wait, or 0 if the wait should not
+// be profiled.
+int64_t StartProfiledWait() {
+  return PREDICT_FALSE(FLAGS_contention_profile_condition_variable_waits) ?
+      CycleClock::Now() : 0;
+}
+
+void EndProfiledWait(const void* cond, int64_t start_cycles) {
+  if (PREDICT_FALSE(start_cycles != 0)) {
+    SubmitBlockingProfileData(cond, CycleClock::Now() - start_cycles);
+  }
+}
+
+} // anonymous namespace
+
 ConditionVariable::ConditionVariable(Mutex* user_lock)
     : user_mutex_(&user_lock->native_handle_)
 #if !defined(NDEBUG)
@@ -63,8 +92,10 @@ void ConditionVariable::Wait() const {
 #if !defined(NDEBUG)
   user_lock_->CheckHeldAndUnmark();
 #endif
+  int64_t start_cycles = StartProfiledWait();
   int rv = pthread_cond_wait(&condition_, user_mutex_);
   DCHECK_EQ(0, rv);
+  EndProfiledWait(this, start_cycles);
 #if !defined(NDEBUG)
   user_lock_->CheckUnheldAndMark();
 #endif
@@ -85,6 +116,7 @@ bool ConditionVariable::TimedWait(const MonoDelta& max_time) const {
 #if !defined(NDEBUG)
   user_lock_->CheckHeldAndUnmark();
 #endif
+  int64_t start_cycles = StartProfiledWait();
 
 #if defined(__APPLE__)
   int rv = pthread_cond_timedwait_relative_np(
@@ -121,6 +153,7 @@ bool ConditionVariable::TimedWait(const MonoDelta& max_time) const {
 
   DCHECK(rv == 0 || rv == ETIMEDOUT)
     << "unexpected pthread_cond_timedwait return value: " << rv;
+  EndProfiledWait(this, start_cycles);
 #if !defined(NDEBUG)
   user_lock_->CheckUnheldAndMark();
 #endif
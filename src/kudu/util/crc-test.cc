@@ -18,6 +18,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/crc.h"
+#include "kudu/util/random.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
@@ -58,6 +59,26 @@ TEST_F(CrcTest, TestCRC32C) {
   ASSERT_EQ(0xa9421b7, data_crc); // Known value from crcutil usage test program.
 }
 
+// Test that Crc32cExtend() matches crcutil on buffers of every length around
+// those computed as interleaved streams.
+TEST_F(CrcTest, TestCrc32cExtend) {
+  Random rng(SeedRandom());
+  const size_t kMaxLength = 7 * kParallelStreamLength;
+  string data;
+  for (int i = 0; i < kMaxLength + 8; i++) {
+    data.push_back(rng.Next32());
+  }
+  Crc* crc32c = GetCrc32cInstance();
+  for (size_t length = 0; length < kMaxLength; length += 1 + rng.Uniform(64)) {
+    const size_t offset = rng.Uniform(8);
+    const uint32_t initial = rng.Next32();
+    uint64_t expected = initial;
+    crc32c->Compute(data.data() + offset, length, &expected);
+    ASSERT_EQ(expected, Crc32cExtend(initial, data.data() + offset, length))
+        << "length " << length << " offset " << offset;
+  }
+}
+
 // Simple benchmark of CRC32C throughput.
 // We should expect about 8 bytes per cycle in throughput on a single core.
 TEST_F(CrcTest, BenchmarkCRC32C) {
@@ -87,5 +108,33 @@ TEST_F(CrcTest, BenchmarkCRC32C) {
                           (kNumBytes / elapsed.wall));
 }
 
+// Same, with Crc32c(), which computes large buffers as interleaved streams.
+TEST_F(CrcTest, BenchmarkParallelCRC32C) {
+  gscoped_ptr<const uint8_t[]> data;
+  const uint8_t* buf;
+  size_t buflen;
+  GenerateBenchmarkData(&buf, &buflen);
+  data.reset(buf);
+  int kNumRuns = 1000;
+  if (AllowSlowTests()) {
+    kNumRuns = 40000;
+  }
+  const uint64_t kNumBytes = kNumRuns * buflen;
+  uint32_t cksum = 0;
+  Stopwatch sw;
+  sw.start();
+  for (int i = 0; i < kNumRuns; i++) {
+    cksum ^= Crc32c(buf, buflen);
+  }
+  sw.stop();
+  CpuTimes elapsed = sw.elapsed();
+  LOG(INFO) << Substitute("$0 runs of parallel CRC32C on $1 bytes of data (total: $2 bytes)"
+                          " in $3 seconds; $4 bytes per millisecond, $5 bytes per nanosecond"
+                          " (checksum $6)",
+                          kNumRuns, buflen, kNumBytes, elapsed.wall_seconds(),
+                          (kNumBytes / elapsed.wall_millis()),
+                          (kNumBytes / elapsed.wall), cksum);
+}
+
 } // namespace crc
 } // namespace kudu
@@ -18,7 +18,12 @@
 
 #include <crcutil/interface.h>
 
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
 #include "kudu/gutil/once.h"
+#include "kudu/gutil/port.h"
 #include "kudu/util/debug/leakcheck_disabler.h"
 
 namespace kudu {
@@ -41,10 +46,109 @@ Crc* GetCrc32cInstance() {
 }
 
 uint32_t Crc32c(const void* data, size_t length) {
-  uint64_t crc32 = 0;
-  GetCrc32cInstance()->Compute(data, length, &crc32);
-  return static_cast<uint32_t>(crc32); // Only uses lower 32 bits.
+  return Crc32cExtend(0, data, length);
+}
+
+#if defined(__x86_64__)
+
+namespace {
+
+// Whether the CPU supports the SSE4.2 crc32 instruction, and the tables which
+// shift a CRC over kParallelStreamLength zero bytes, one per byte of the CRC.
+bool has_sse42 = false;
+uint32_t shift_tables[4][256];
+
+// The functions below work on "raw" CRCs, i.e. without the inversions of the
+// CRC before and after the data.
+
+__attribute__((target("sse4.2")))
+uint32_t Crc32cSse42(uint32_t crc, const uint8_t* p, size_t length) {
+  uint64_t crc64 = crc;
+  for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t)) {
+    crc64 = _mm_crc32_u64(crc64, UNALIGNED_LOAD64(p));
+    p += sizeof(uint64_t);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  for (; length > 0; length--) {
+    crc = _mm_crc32_u8(crc, *p++);
+  }
+  return crc;
+}
+
+// Returns the raw CRC of the data whose raw CRC is 'crc', followed by
+// kParallelStreamLength zero bytes. The CRC is linear, so the result is the
+// XOR of the shifts of each of its bytes.
+uint32_t ShiftCrc(uint32_t crc) {
+  return shift_tables[0][crc & 0xff] ^
+      shift_tables[1][(crc >> 8) & 0xff] ^
+      shift_tables[2][(crc >> 16) & 0xff] ^
+      shift_tables[3][crc >> 24];
+}
+
+__attribute__((target("sse4.2")))
+uint32_t Crc32cSse42Parallel(uint32_t crc, const uint8_t* p, size_t length) {
+  const size_t kWords = kParallelStreamLength / sizeof(uint64_t);
+  while (length >= 3 * kParallelStreamLength) {
+    // The streams are independent, so the crc32 instructions of one stream
+    // execute while those of the others are in flight.
+    uint64_t crc0 = crc;
+    uint64_t crc1 = 0;
+    uint64_t crc2 = 0;
+    const uint8_t* p1 = p + kParallelStreamLength;
+    const uint8_t* p2 = p1 + kParallelStreamLength;
+    for (size_t i = 0; i < kWords; i++) {
+      crc0 = _mm_crc32_u64(crc0, UNALIGNED_LOAD64(p + i * sizeof(uint64_t)));
+      crc1 = _mm_crc32_u64(crc1, UNALIGNED_LOAD64(p1 + i * sizeof(uint64_t)));
+      crc2 = _mm_crc32_u64(crc2, UNALIGNED_LOAD64(p2 + i * sizeof(uint64_t)));
+    }
+    // Combine the CRCs of the streams as if they had been computed in turn.
+    crc = ShiftCrc(static_cast<uint32_t>(crc0)) ^ static_cast<uint32_t>(crc1);
+    crc = ShiftCrc(crc) ^ static_cast<uint32_t>(crc2);
+    p += 3 * kParallelStreamLength;
+    length -= 3 * kParallelStreamLength;
+  }
+  return Crc32cSse42(crc, p, length);
 }
 
+void InitParallelCrc32c() {
+  __builtin_cpu_init();
+  if (!__builtin_cpu_supports("sse4.2")) {
+    return;
+  }
+  const uint8_t zeros[kParallelStreamLength] = { 0 };
+  for (int byte = 0; byte < 4; byte++) {
+    for (uint32_t val = 0; val < 256; val++) {
+      shift_tables[byte][val] = Crc32cSse42(val << (8 * byte), zeros, sizeof(zeros));
+    }
+  }
+  has_sse42 = true;
+}
+
+GoogleOnceType parallel_crc32c_once = GOOGLE_ONCE_INIT;
+
+} // anonymous namespace
+
+uint32_t Crc32cExtend(uint32_t crc, const void* data, size_t length) {
+  if (length >= 3 * kParallelStreamLength) {
+    GoogleOnceInit(&parallel_crc32c_once, &InitParallelCrc32c);
+    if (has_sse42) {
+      return ~Crc32cSse42Parallel(~crc, reinterpret_cast<const uint8_t*>(data), length);
+    }
+  }
+  uint64_t crc64 = crc;
+  GetCrc32cInstance()->Compute(data, length, &crc64);
+  return static_cast<uint32_t>(crc64); // Only uses lower 32 bits.
+}
+
+#else
+
+uint32_t Crc32cExtend(uint32_t crc, const void* data, size_t length) {
+  uint64_t crc64 = crc;
+  GetCrc32cInstance()->Compute(data, length, &crc64);
+  return static_cast<uint32_t>(crc64); // Only uses lower 32 bits.
+}
+
+#endif // defined(__x86_64__)
+
 } // namespace crc
 } // namespace kudu
@@ -33,6 +33,17 @@ Crc* GetCrc32cInstance();
 // Helper function to simply calculate a CRC32C of the given data.
 uint32_t Crc32c(const void* data, size_t length);
 
+// Returns the CRC32C of the concatenation of the data whose CRC32C is 'crc'
+// and of the given data, like Crc::Compute().
+//
+// Buffers of at least kParallelStreamLength * 3 bytes are computed as three
+// interleaved streams with the SSE4.2 crc32 instruction if the CPU supports
+// it, which hides the latency of the instruction.
+uint32_t Crc32cExtend(uint32_t crc, const void* data, size_t length);
+
+// The number of bytes of each of the interleaved streams of Crc32cExtend().
+const size_t kParallelStreamLength = 1024;
+
 } // namespace crc
 } // namespace kudu
 
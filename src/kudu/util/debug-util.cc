@@ -224,14 +224,15 @@ Status SetStackTraceSignal(int signum) {
   return Status::OK();
 }
 
-std::string DumpThreadStack(int64_t tid) {
+Status GetThreadStack(int64_t tid, StackTrace* stack) {
 #if defined(__linux__)
   base::SpinLockHolder h(&g_dumper_thread_lock);
 
   // Ensure that our signal handler is installed. We don't need any fancy GoogleOnce here
   // because of the mutex above.
   if (!InitSignalHandlerUnlocked(g_stack_trace_signum)) {
-    return "<unable to take thread stack: signal handler unavailable>";
+    return Status::ServiceUnavailable("unable to take thread stack",
+                                      "signal handler unavailable");
   }
 
   // Set the target TID in our communication structure, so if we end up with any
@@ -250,41 +251,59 @@ std::string DumpThreadStack(int64_t tid) {
       SignalCommunication::Lock l;
       g_comm.target_tid = 0;
     }
-    return "(unable to deliver signal: process may have exited)";
+    return Status::NotFound("unable to deliver signal", "process may have exited");
   }
 
-  // We give the thread ~1s to respond. In testing, threads typically respond within
-  // a few iterations of the loop, so this timeout is very conservative.
+  // We give the thread ~1s to respond. Threads typically respond within a few
+  // microseconds, so we first yield rather than sleep, which keeps sampling the
+  // stacks of all threads cheap.
   //
   // The main reason that a thread would not respond is that it has blocked signals. For
   // example, glibc's timer_thread doesn't respond to our signal, so we always time out
   // on that one.
-  string ret;
+  MonoTime deadline = MonoTime::Now() + MonoDelta::FromSeconds(1);
   int i = 0;
   while (!base::subtle::Acquire_Load(&g_comm.result_ready) &&
-         i++ < 100) {
-    SleepFor(MonoDelta::FromMilliseconds(10));
+         MonoTime::Now() < deadline) {
+    if (i++ < 100) {
+      sched_yield();
+    } else {
+      SleepFor(MonoDelta::FromMilliseconds(1));
+    }
   }
 
+  Status s;
   {
     SignalCommunication::Lock l;
     CHECK_EQ(tid, g_comm.target_tid);
 
     if (!g_comm.result_ready) {
-      ret = "(thread did not respond: maybe it is blocking signals)";
+      s = Status::TimedOut("thread did not respond", "maybe it is blocking signals");
     } else {
-      ret = g_comm.stack.Symbolize();
+      stack->CopyFrom(g_comm.stack);
     }
 
     g_comm.target_tid = 0;
     g_comm.result_ready = 0;
   }
-  return ret;
+  return s;
 #else // defined(__linux__)
-  return "(unsupported platform)";
+  return Status::NotSupported("unsupported platform");
 #endif
 }
 
+std::string DumpThreadStack(int64_t tid) {
+  StackTrace stack;
+  Status s = GetThreadStack(tid, &stack);
+  if (s.IsServiceUnavailable()) {
+    return "<unable to take thread stack: signal handler unavailable>";
+  }
+  if (!s.ok()) {
+    return "(" + s.message().ToString() + ")";
+  }
+  return stack.Symbolize();
+}
+
 Status ListThreads(vector<pid_t> *tids) {
 #if defined(__linux__)
   DIR *dir = opendir("/proc/self/task/");
@@ -27,6 +27,8 @@
 
 namespace kudu {
 
+class StackTrace;
+
 // Return true if coverage is enabled.
 bool IsCoverageBuild();
 
@@ -57,6 +59,13 @@ Status SetStackTraceSignal(int signum);
 // may be active at a time.
 std::string DumpThreadStack(int64_t tid);
 
+// Collect the stack trace of the given thread into 'stack', without
+// symbolizing it. This has the same requirements as DumpThreadStack().
+//
+// Returns an error if the stack trace signal handler can't be installed, the
+// thread doesn't exist, or it doesn't respond in time.
+Status GetThreadStack(int64_t tid, StackTrace* stack);
+
 // Return the current stack trace, stringified.
 std::string GetStackTrace();
 
@@ -21,6 +21,7 @@
 #include <memory>
 #include <string>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
@@ -32,6 +33,7 @@
 #include "kudu/util/malloc.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/status.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
 
@@ -47,8 +49,11 @@
 #define FALLOC_FL_PUNCH_HOLE  0x02 /* de-allocates range */
 #endif
 
+DECLARE_bool(env_use_io_uring);
+
 namespace kudu {
 
+using std::pair;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -452,6 +457,92 @@ TEST_F(TestEnv, TestReadFully) {
   ASSERT_STR_CONTAINS(status.ToString(), "EOF");
 }
 
+TEST_F(TestEnv, TestSubmitReads) {
+  FLAGS_env_use_io_uring = true;
+  const string kTestPath = GetTestPath("test");
+  const int kFileSize = 64 * 1024;
+  const int kReadLength = 1000;
+  const int kNumReads = 32;
+  NO_FATALS(WriteTestFile(env_, kTestPath, kFileSize));
+
+  shared_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env_util::OpenFileForRandom(env_, kTestPath, &raf));
+
+  // Read a series of ranges, the last of which runs past the end of the file.
+  vector<AsyncReadRequest> reads(kNumReads);
+  vector<AsyncReadRequest*> requests;
+  unique_ptr<uint8_t[]> scratch(new uint8_t[kNumReads * kReadLength]);
+  CountDownLatch done(kNumReads);
+  for (int i = 0; i < kNumReads; i++) {
+    AsyncReadRequest* req = &reads[i];
+    req->offset = i == kNumReads - 1 ? kFileSize - 100 : i * 1999;
+    req->length = kReadLength;
+    req->scratch = scratch.get() + i * kReadLength;
+    req->callback = [&done]() { done.CountDown(); };
+    requests.push_back(req);
+  }
+  Status s = raf->SubmitReads(requests);
+  if (s.IsNotSupported()) {
+    LOG(INFO) << "Skipping test: " << s.ToString();
+    return;
+  }
+  ASSERT_OK(s);
+  done.Wait();
+
+  for (int i = 0; i < kNumReads - 1; i++) {
+    ASSERT_OK(reads[i].status);
+    ASSERT_EQ(kReadLength, reads[i].result.size());
+    VerifyTestData(reads[i].result, reads[i].offset);
+  }
+  ASSERT_TRUE(reads[kNumReads - 1].status.IsIOError())
+      << reads[kNumReads - 1].status.ToString();
+}
+
+TEST_F(TestEnv, TestReadUncached) {
+  const string kTestPath = GetTestPath("test");
+  const int kFileSize = 64 * 1024;
+  NO_FATALS(WriteTestFile(env_, kTestPath, kFileSize));
+
+  shared_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env_util::OpenFileForRandom(env_, kTestPath, &raf));
+  unique_ptr<RWFile> rwf;
+  RWFileOptions opts;
+  opts.mode = Env::OPEN_EXISTING;
+  ASSERT_OK(env_->NewRWFile(opts, kTestPath, &rwf));
+
+  // Aligned, unaligned and end-of-file reads, into a deliberately misaligned
+  // buffer.
+  const vector<pair<uint64_t, size_t>> kRanges = {
+    { 0, 4096 }, { 4096, 8192 }, { 1, 1 }, { 4000, 5000 }, { kFileSize - 10, 10 }
+  };
+  unique_ptr<uint8_t[]> scratch(new uint8_t[8192 + 1]);
+  for (const auto& r : kRanges) {
+    Slice result;
+    Status s = raf->ReadUncached(r.first, r.second, &result, scratch.get() + 1);
+    if (s.IsNotSupported()) {
+      LOG(INFO) << "Skipping test: " << s.ToString();
+      return;
+    }
+    ASSERT_OK(s);
+    ASSERT_EQ(r.second, result.size());
+    VerifyTestData(result, r.first);
+
+    ASSERT_OK(rwf->ReadUncached(r.first, r.second, &result, scratch.get() + 1));
+    ASSERT_EQ(r.second, result.size());
+    VerifyTestData(result, r.first);
+  }
+
+  // Reading past the end of the file is an error.
+  Slice result;
+  Status s = raf->ReadUncached(kFileSize - 10, 11, &result, scratch.get());
+  ASSERT_TRUE(s.IsIOError()) << s.ToString();
+
+  // Writes are visible to uncached reads.
+  ASSERT_OK(rwf->Write(100, "hello"));
+  ASSERT_OK(rwf->ReadUncached(100, 5, &result, scratch.get()));
+  ASSERT_EQ("hello", result.ToString());
+}
+
 TEST_F(TestEnv, TestAppendVector) {
   WritableFileOptions opts;
   LOG(INFO) << "Testing AppendVector() only, NO pre-allocation";
@@ -9,6 +9,7 @@
 #include "kudu/util/faststring.h"
 
 using std::unique_ptr;
+using std::vector;
 
 namespace kudu {
 
@@ -21,12 +22,30 @@ SequentialFile::~SequentialFile() {
 RandomAccessFile::~RandomAccessFile() {
 }
 
+Status RandomAccessFile::SubmitReads(const vector<AsyncReadRequest*>& /* requests */) const {
+  return Status::NotSupported("asynchronous reads are not supported", filename());
+}
+
+Status RandomAccessFile::ReadUncached(uint64_t /* offset */, size_t /* n */,
+                                      Slice* /* result */, uint8_t* /* scratch */) const {
+  return Status::NotSupported("uncached reads are not supported", filename());
+}
+
 WritableFile::~WritableFile() {
 }
 
 RWFile::~RWFile() {
 }
 
+Status RWFile::SubmitReads(const vector<AsyncReadRequest*>& /* requests */) const {
+  return Status::NotSupported("asynchronous reads are not supported", filename());
+}
+
+Status RWFile::ReadUncached(uint64_t /* offset */, size_t /* length */,
+                            Slice* /* result */, uint8_t* /* scratch */) const {
+  return Status::NotSupported("uncached reads are not supported", filename());
+}
+
 FileLock::~FileLock() {
 }
 
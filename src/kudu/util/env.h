@@ -15,11 +15,13 @@
 
 #include <cstdarg>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "kudu/gutil/callback_forward.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -353,6 +355,31 @@ class SequentialFile {
   virtual const std::string& filename() const = 0;
 };
 
+// A read submitted with RandomAccessFile::SubmitReads() or
+// RWFile::SubmitReads().
+struct AsyncReadRequest {
+  AsyncReadRequest()
+      : offset(0),
+        length(0),
+        scratch(nullptr) {
+  }
+
+  // The range to read, and a buffer of at least 'length' bytes to read it
+  // into. 'scratch' must remain live until 'callback' has been invoked.
+  uint64_t offset;
+  size_t length;
+  uint8_t* scratch;
+
+  // Set once the read has completed. If 'status' is OK, 'result' holds
+  // exactly 'length' bytes: a read which runs past the end of the file fails.
+  Slice result;
+  Status status;
+
+  // Invoked on an arbitrary thread once the read has completed. The callback
+  // may destroy the request.
+  std::function<void()> callback;
+};
+
 // A file abstraction for randomly reading the contents of a file.
 class RandomAccessFile {
  public:
@@ -371,6 +398,28 @@ class RandomAccessFile {
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       uint8_t *scratch) const = 0;
 
+  // Submit 'requests' to be read asynchronously, so that many reads can be
+  // in flight without as many blocked threads. Each request's callback is
+  // invoked once its read has completed; the file must outlive the reads.
+  //
+  // Returns NotSupported, without invoking any callbacks, if the file has no
+  // asynchronous read path, in which case the caller should use Read().
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status SubmitReads(const std::vector<AsyncReadRequest*>& requests) const;
+
+  // Reads exactly 'n' bytes starting from 'offset', bypassing the operating
+  // system's page cache (i.e. using O_DIRECT). Any alignment required by the
+  // filesystem is taken care of internally; 'scratch' needn't be aligned.
+  // Unlike Read(), a short read is an IOError.
+  //
+  // Returns NotSupported if the file (or its filesystem) has no uncached
+  // read path, in which case the caller should use Read().
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status ReadUncached(uint64_t offset, size_t n, Slice* result,
+                              uint8_t* scratch) const;
+
   // Returns the size of the file
   virtual Status Size(uint64_t *size) const = 0;
 
@@ -502,6 +551,14 @@ class RWFile {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const = 0;
 
+  // Like RandomAccessFile::SubmitReads().
+  virtual Status SubmitReads(const std::vector<AsyncReadRequest*>& requests) const;
+
+  // Like RandomAccessFile::ReadUncached(). Writes made through this file
+  // are visible to subsequent uncached reads.
+  virtual Status ReadUncached(uint64_t offset, size_t length,
+                              Slice* result, uint8_t* scratch) const;
+
   // Writes 'data' to the file position given by 'offset'.
   virtual Status Write(uint64_t offset, const Slice& data) = 0;
 
@@ -19,13 +19,19 @@
 #include <sys/utsname.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <glog/logging.h>
@@ -33,8 +39,10 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/callback.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/alignment.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
@@ -44,6 +52,7 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/once.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/slice.h"
@@ -58,9 +67,22 @@
 #include <linux/falloc.h>
 #include <linux/magic.h>
 #include <sys/sysinfo.h>
+#include <sys/syscall.h>
 #include <sys/vfs.h>
 #endif  // defined(__APPLE__)
 
+// io_uring is used for asynchronous reads if both the kernel headers and
+// the C library know about it; the kernel's support is checked at runtime.
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#if defined(IORING_OFF_SQ_RING) && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter)
+#define KUDU_HAVE_IO_URING 1
+#endif
+
 // Copied from falloc.h. Useful for older kernels that lack support for
 // hole punching; fallocate(2) will return EOPNOTSUPP.
 #ifndef FALLOC_FL_KEEP_SIZE
@@ -115,6 +137,18 @@ DEFINE_double(env_inject_io_error_on_write_or_preallocate, 0.0,
               "Fraction of the time that write or preallocate operations will fail");
 TAG_FLAG(env_inject_io_error_on_write_or_preallocate, hidden);
 
+DEFINE_bool(env_use_io_uring, false,
+            "Whether to issue asynchronous reads, such as CFile readahead, through "
+            "io_uring when the kernel supports it. If false, or if io_uring is not "
+            "supported, asynchronous readers fall back to blocking reads on thread pools.");
+TAG_FLAG(env_use_io_uring, experimental);
+TAG_FLAG(env_use_io_uring, runtime);
+
+DEFINE_int32(env_io_uring_queue_depth, 256,
+             "The number of entries in the submission queue of the io_uring used for "
+             "asynchronous reads, which bounds the number of reads in flight.");
+TAG_FLAG(env_io_uring_queue_depth, experimental);
+
 using base::subtle::Atomic64;
 using base::subtle::Barrier_AtomicIncrement;
 using std::string;
@@ -247,6 +281,385 @@ static Status DoOpen(const string& filename, Env::CreateMode mode, int* fd) {
   return Status::OK();
 }
 
+// Read exactly 'length' bytes at 'offset' from 'fd' into 'dst'.
+static Status DoPReadFully(int fd, const string& filename, uint64_t offset,
+                           size_t length, uint8_t* dst) {
+  ThreadRestrictions::AssertIOAllowed();
+  size_t rem = length;
+  while (rem > 0) {
+    ssize_t r;
+    RETRY_ON_EINTR(r, pread(fd, dst, rem, offset));
+    if (r < 0) {
+      // An error: return a non-ok status.
+      return IOError(filename, errno);
+    }
+    DCHECK_LE(r, static_cast<ssize_t>(rem));
+    if (r == 0) {
+      // EOF
+      return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
+                                        length, offset));
+    }
+    dst += r;
+    rem -= r;
+    offset += r;
+  }
+  return Status::OK();
+}
+
+// Reads a file with O_DIRECT, through a descriptor of its own which is
+// opened on first use.
+class DirectReader {
+ public:
+  explicit DirectReader(const string* filename)
+      : filename_(filename),
+        fd_(-1) {
+  }
+
+  ~DirectReader() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  // See RandomAccessFile::ReadUncached().
+  Status Read(uint64_t offset, size_t length, Slice* result, uint8_t* scratch) {
+    RETURN_NOT_OK(once_.Init(&DirectReader::Open, this));
+    if (fd_ < 0) {
+      return Status::NotSupported("O_DIRECT is not supported", *filename_);
+    }
+    ThreadRestrictions::AssertIOAllowed();
+
+    // Widen the read to the alignment O_DIRECT requires, reading into an
+    // aligned bounce buffer unless 'scratch' can be used as is.
+    uint64_t aligned_offset = KUDU_ALIGN_DOWN(offset, kAlignment);
+    uint64_t aligned_end = KUDU_ALIGN_UP(offset + length, kAlignment);
+    size_t aligned_length = aligned_end - aligned_offset;
+    uint8_t* buf = scratch;
+    unique_ptr<uint8_t, FreeDeleter> bounce;
+    if (aligned_offset != offset || aligned_length != length ||
+        reinterpret_cast<uintptr_t>(scratch) % kAlignment != 0) {
+      void* p;
+      if (posix_memalign(&p, kAlignment, aligned_length) != 0) {
+        return Status::RuntimeError("could not allocate O_DIRECT buffer",
+                                    std::to_string(aligned_length));
+      }
+      bounce.reset(static_cast<uint8_t*>(p));
+      buf = bounce.get();
+    }
+
+    // The read may come up short at the end of the file, which is fine so
+    // long as the requested range was covered.
+    size_t done = 0;
+    while (done < aligned_length) {
+      ssize_t r;
+      RETRY_ON_EINTR(r, pread(fd_, buf + done, aligned_length - done,
+                              aligned_offset + done));
+      if (r < 0) {
+        return IOError(*filename_, errno);
+      }
+      if (r == 0) {
+        break;
+      }
+      done += r;
+    }
+    if (aligned_offset + done < offset + length) {
+      return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
+                                        length, offset));
+    }
+    if (buf != scratch) {
+      memcpy(scratch, buf + (offset - aligned_offset), length);
+    }
+    *result = Slice(scratch, length);
+    return Status::OK();
+  }
+
+ private:
+  // The alignment of offsets, lengths and buffers used with O_DIRECT. This
+  // is the largest logical block size in common use.
+  static const size_t kAlignment = 4096;
+
+  struct FreeDeleter {
+    void operator()(uint8_t* p) const { free(p); }
+  };
+
+  Status Open() {
+#if defined(O_DIRECT)
+    int fd;
+    RETRY_ON_EINTR(fd, open(filename_->c_str(), O_RDONLY | O_DIRECT));
+    if (fd >= 0) {
+      fd_ = fd;
+    } else if (errno != EINVAL) {
+      // EINVAL means the filesystem doesn't support O_DIRECT (e.g. tmpfs);
+      // the reads are then NotSupported.
+      return IOError(*filename_, errno);
+    }
+#endif
+    return Status::OK();
+  }
+
+  const string* filename_;
+  KuduOnceDynamic once_;
+  int fd_;
+
+  DISALLOW_COPY_AND_ASSIGN(DirectReader);
+};
+
+#if defined(KUDU_HAVE_IO_URING)
+// A process-wide io_uring on which asynchronous reads are submitted. A
+// dedicated thread reaps their completions and invokes the callbacks.
+//
+// At most as many reads as the submission queue has entries are in flight
+// at once, so neither the submission queue nor the completion queue (which
+// the kernel makes twice as large) can overflow.
+class IoUring {
+ public:
+  // Returns the ring, or NULL if the kernel doesn't support io_uring.
+  static IoUring* Get() {
+    static IoUring* ring = Create();
+    return ring;
+  }
+
+  // Only called if Init() fails; the ring is otherwise never destroyed.
+  ~IoUring() {
+    if (sqes_) munmap(sqes_, sqes_size_);
+    if (cq_ring_) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+    if (ring_fd_ >= 0) close(ring_fd_);
+  }
+
+  // Submit reads of 'requests' from 'fd', whose errors are reported against
+  // 'filename'. Both must remain valid until the reads have completed.
+  void SubmitReads(int fd, const string& filename,
+                   const vector<AsyncReadRequest*>& requests) {
+    std::lock_guard<std::mutex> l(submit_lock_);
+    size_t next = 0;
+    while (next < requests.size()) {
+      uint32_t n;
+      {
+        std::unique_lock<std::mutex> il(inflight_lock_);
+        inflight_cond_.wait(il, [this]() { return inflight_ < sq_entries_; });
+        n = std::min<size_t>(requests.size() - next, sq_entries_ - inflight_);
+        inflight_ += n;
+      }
+
+      // Only this thread writes the tail, under 'submit_lock_'.
+      uint32_t tail = *sq_tail_;
+      for (uint32_t i = 0; i < n; i++) {
+        AsyncReadRequest* req = requests[next++];
+        InflightRead* read = new InflightRead();
+        read->request = req;
+        read->fd = fd;
+        read->filename = &filename;
+        read->iov.iov_base = req->scratch;
+        read->iov.iov_len = req->length;
+
+        struct io_uring_sqe* sqe = &sqes_[tail & sq_mask_];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->off = req->offset;
+        sqe->addr = reinterpret_cast<uint64_t>(&read->iov);
+        sqe->len = 1;
+        sqe->user_data = reinterpret_cast<uint64_t>(read);
+        tail++;
+      }
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+      uint32_t submitted = 0;
+      while (submitted < n) {
+        int r = syscall(__NR_io_uring_enter, ring_fd_, n - submitted, 0, 0, nullptr, 0);
+        if (r < 0) {
+          if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+            continue;
+          }
+          PLOG(FATAL) << "io_uring_enter() failed to submit reads";
+        }
+        submitted += r;
+      }
+    }
+  }
+
+ private:
+  // The state of a read submitted to the ring.
+  struct InflightRead {
+    AsyncReadRequest* request;
+    int fd;
+    const string* filename;
+    struct iovec iov;
+  };
+
+  IoUring()
+      : ring_fd_(-1),
+        sq_ring_(nullptr),
+        sq_ring_size_(0),
+        cq_ring_(nullptr),
+        cq_ring_size_(0),
+        sqes_(nullptr),
+        sqes_size_(0),
+        inflight_(0) {
+  }
+
+  static IoUring* Create() {
+    gscoped_ptr<IoUring> ring(new IoUring());
+    Status s = ring->Init();
+    if (!s.ok()) {
+      LOG(WARNING) << "Unable to set up io_uring, asynchronous reads are disabled: "
+                   << s.ToString();
+      return nullptr;
+    }
+    return ring.release();
+  }
+
+  Status Init() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = syscall(__NR_io_uring_setup, FLAGS_env_io_uring_queue_depth, &params);
+    if (ring_fd_ < 0) {
+      return IOError("io_uring_setup", errno);
+    }
+    sq_entries_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    RETURN_NOT_OK(MapRing(IORING_OFF_SQ_RING, sq_ring_size_, &sq_ring_));
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    RETURN_NOT_OK(MapRing(IORING_OFF_CQ_RING, cq_ring_size_, &cq_ring_));
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes;
+    RETURN_NOT_OK(MapRing(IORING_OFF_SQES, sqes_size_, &sqes));
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    uint8_t* sq = static_cast<uint8_t*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    uint8_t* cq = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // Submission queue entry i always lives in slot i of the SQE array.
+    uint32_t* sq_array = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+    for (uint32_t i = 0; i < params.sq_entries; i++) {
+      sq_array[i] = i;
+    }
+
+    std::thread reaper(&IoUring::ReapCompletions, this);
+    reaper.detach();
+    return Status::OK();
+  }
+
+  Status MapRing(off_t offset, size_t size, void** ring) {
+    void* ret = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ring_fd_, offset);
+    if (ret == MAP_FAILED) {
+      return IOError("mmap of io_uring", errno);
+    }
+    *ring = ret;
+    return Status::OK();
+  }
+
+  void ReapCompletions() {
+    vector<std::pair<InflightRead*, int>> completed;
+    while (true) {
+      int r = syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (r < 0 && errno != EINTR) {
+        PLOG(FATAL) << "io_uring_enter() failed to wait for completions";
+      }
+
+      uint32_t head = *cq_head_;
+      uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != tail; head++) {
+        const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        completed.emplace_back(reinterpret_cast<InflightRead*>(cqe.user_data), cqe.res);
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      if (completed.empty()) {
+        continue;
+      }
+
+      // Make room for more reads before running any callbacks, which may
+      // submit reads of their own.
+      {
+        std::lock_guard<std::mutex> l(inflight_lock_);
+        inflight_ -= completed.size();
+      }
+      inflight_cond_.notify_all();
+
+      for (const auto& c : completed) {
+        CompleteRead(c.first, c.second);
+      }
+      completed.clear();
+    }
+  }
+
+  static void CompleteRead(InflightRead* read, int res) {
+    gscoped_ptr<InflightRead> deleter(read);
+    AsyncReadRequest* req = read->request;
+    Status s;
+    size_t done = 0;
+    if (res >= 0) {
+      done = res;
+    } else if (res != -EINTR && res != -EAGAIN) {
+      s = IOError(*read->filename, -res);
+    }
+    if (s.ok() && done < req->length) {
+      // Short reads are rare, so the rest of the range is simply read
+      // synchronously.
+      s = DoPReadFully(read->fd, *read->filename, req->offset + done,
+                       req->length - done, req->scratch + done);
+    }
+    req->status = s;
+    req->result = s.ok() ? Slice(req->scratch, req->length) : Slice();
+
+    // The callback may destroy the request.
+    std::function<void()> callback = std::move(req->callback);
+    callback();
+  }
+
+  int ring_fd_;
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  struct io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  uint32_t sq_entries_;
+  uint32_t* sq_tail_;
+  uint32_t sq_mask_;
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  uint32_t cq_mask_;
+  struct io_uring_cqe* cqes_;
+
+  // Serializes submissions.
+  std::mutex submit_lock_;
+
+  // Protects 'inflight_', the number of reads submitted but not yet reaped.
+  std::mutex inflight_lock_;
+  std::condition_variable inflight_cond_;
+  uint32_t inflight_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoUring);
+};
+#endif // defined(KUDU_HAVE_IO_URING)
+
+// Submit asynchronous reads of 'requests' from 'fd', if supported.
+static Status DoSubmitReads(int fd, const string& filename,
+                            const vector<AsyncReadRequest*>& requests) {
+#if defined(KUDU_HAVE_IO_URING)
+  if (FLAGS_env_use_io_uring) {
+    IoUring* ring = IoUring::Get();
+    if (ring != nullptr) {
+      TRACE_COUNTER_INCREMENT("io_uring_reads", requests.size());
+      ring->SubmitReads(fd, filename, requests);
+      return Status::OK();
+    }
+  }
+#endif
+  return Status::NotSupported("asynchronous reads are not supported", filename);
+}
+
 class PosixSequentialFile: public SequentialFile {
  private:
   std::string filename_;
@@ -291,10 +704,11 @@ class PosixRandomAccessFile: public RandomAccessFile {
  private:
   std::string filename_;
   int fd_;
+  mutable DirectReader direct_reader_;
 
  public:
   PosixRandomAccessFile(std::string fname, int fd)
-      : filename_(std::move(fname)), fd_(fd) {}
+      : filename_(std::move(fname)), fd_(fd), direct_reader_(&filename_) {}
   virtual ~PosixRandomAccessFile() { close(fd_); }
 
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
@@ -311,6 +725,15 @@ class PosixRandomAccessFile: public RandomAccessFile {
     return s;
   }
 
+  virtual Status SubmitReads(const vector<AsyncReadRequest*>& requests) const OVERRIDE {
+    return DoSubmitReads(fd_, filename_, requests);
+  }
+
+  virtual Status ReadUncached(uint64_t offset, size_t n, Slice* result,
+                              uint8_t* scratch) const OVERRIDE {
+    return direct_reader_.Read(offset, n, result, scratch);
+  }
+
   virtual Status Size(uint64_t *size) const OVERRIDE {
     TRACE_EVENT1("io", "PosixRandomAccessFile::Size", "path", filename_);
     ThreadRestrictions::AssertIOAllowed();
@@ -543,7 +966,8 @@ class PosixRWFile : public RWFile {
         fd_(fd),
         sync_on_close_(sync_on_close),
         pending_sync_(false),
-        closed_(false) {}
+        closed_(false),
+        direct_reader_(&filename_) {}
 
   ~PosixRWFile() {
     WARN_NOT_OK(Close(), "Failed to close " + filename_);
@@ -551,32 +975,20 @@ class PosixRWFile : public RWFile {
 
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE {
-    ThreadRestrictions::AssertIOAllowed();
-    int rem = length;
-    uint8_t* dst = scratch;
-    while (rem > 0) {
-      ssize_t r;
-      RETRY_ON_EINTR(r, pread(fd_, dst, rem, offset));
-      if (r < 0) {
-        // An error: return a non-ok status.
-        return IOError(filename_, errno);
-      }
-      Slice this_result(dst, r);
-      DCHECK_LE(this_result.size(), rem);
-      if (this_result.size() == 0) {
-        // EOF
-        return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
-                                          length, offset));
-      }
-      dst += this_result.size();
-      rem -= this_result.size();
-      offset += this_result.size();
-    }
-    DCHECK_EQ(0, rem);
+    RETURN_NOT_OK(DoPReadFully(fd_, filename_, offset, length, scratch));
     *result = Slice(scratch, length);
     return Status::OK();
   }
 
+  virtual Status SubmitReads(const vector<AsyncReadRequest*>& requests) const OVERRIDE {
+    return DoSubmitReads(fd_, filename_, requests);
+  }
+
+  virtual Status ReadUncached(uint64_t offset, size_t length,
+                              Slice* result, uint8_t* scratch) const OVERRIDE {
+    return direct_reader_.Read(offset, length, result, scratch);
+  }
+
   virtual Status Write(uint64_t offset, const Slice& data) OVERRIDE {
     MAYBE_RETURN_FAILURE(FLAGS_env_inject_io_error_on_write_or_preallocate,
                          Status::IOError(Env::kInjectedFailureStatusMsg));
@@ -726,6 +1138,7 @@ class PosixRWFile : public RWFile {
 
   AtomicBool pending_sync_;
   bool closed_;
+  mutable DirectReader direct_reader_;
 };
 
 int LockOrUnlock(int fd, bool lock) {
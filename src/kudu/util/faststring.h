@@ -204,11 +204,11 @@ class faststring {
                        len_);
   }
 
- private:
-  DISALLOW_COPY_AND_ASSIGN(faststring);
-
   // If necessary, expand the buffer to fit at least 'count' more bytes.
   // If the array has to be grown, it is grown by at least 50%.
+  //
+  // Unlike reserve(), this is safe to call before each of many appends
+  // without causing O(n^2) copying.
   void EnsureRoomForAppend(size_t count) {
     if (PREDICT_TRUE(len_ + count <= capacity_)) {
       return;
@@ -219,6 +219,9 @@ class faststring {
     GrowByAtLeast(count);
   }
 
+ private:
+  DISALLOW_COPY_AND_ASSIGN(faststring);
+
   // The slow path of MakeRoomFor. Grows the buffer by either
   // 'count' bytes, or 50%, whichever is more.
   void GrowByAtLeast(size_t count);
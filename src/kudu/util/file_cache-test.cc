@@ -36,6 +36,11 @@
 DECLARE_bool(cache_force_single_shard);
 DECLARE_int32(file_cache_expiry_period_ms);
 
+METRIC_DECLARE_counter(file_cache_evictions);
+METRIC_DECLARE_counter(file_cache_reopens);
+METRIC_DECLARE_histogram(file_cache_open_latency);
+METRIC_DECLARE_entity(server);
+
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
@@ -261,6 +266,73 @@ TYPED_TEST(FileCacheTest, TestHeavyReads) {
   }
 }
 
+TYPED_TEST(FileCacheTest, TestMetrics) {
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(
+      &registry, "test");
+  this->cache_.reset(new FileCache<TypeParam>("test", this->env_, 1, entity));
+  ASSERT_OK(this->cache_->Init());
+
+  const string kFile1 = this->GetTestPath("foo");
+  const string kFile2 = this->GetTestPath("bar");
+  ASSERT_OK(this->WriteTestFile(kFile1, "test data 1"));
+  ASSERT_OK(this->WriteTestFile(kFile2, "test data 2"));
+
+  // With room for only one open file, alternating between the two files
+  // evicts and reopens one of them each time.
+  shared_ptr<TypeParam> f1;
+  shared_ptr<TypeParam> f2;
+  ASSERT_OK(this->cache_->OpenExistingFile(kFile1, &f1));
+  ASSERT_OK(this->cache_->OpenExistingFile(kFile2, &f2));
+  for (int i = 0; i < 5; i++) {
+    uint64_t size;
+    ASSERT_OK(f1->Size(&size));
+    ASSERT_OK(f2->Size(&size));
+  }
+
+  ASSERT_EQ(10, down_cast<Counter*>(
+      entity->FindOrNull(METRIC_file_cache_reopens).get())->value());
+  ASSERT_GE(down_cast<Counter*>(
+      entity->FindOrNull(METRIC_file_cache_evictions).get())->value(), 10);
+  ASSERT_EQ(12, down_cast<Histogram*>(
+      entity->FindOrNull(METRIC_file_cache_open_latency).get())->TotalCount());
+}
+
+TYPED_TEST(FileCacheTest, TestConcurrentOpens) {
+  // Many threads open the same set of files, spread across the descriptor
+  // map's shards, and each must see exactly one descriptor per file.
+  const int kNumFiles = 100;
+  const int kNumThreads = 8;
+  ASSERT_OK(this->ReinitCache(kNumFiles));
+  vector<string> files;
+  for (int i = 0; i < kNumFiles; i++) {
+    files.push_back(this->GetTestPath(Substitute("file$0", i)));
+    ASSERT_OK(this->WriteTestFile(files.back(), Substitute("data $0", i)));
+  }
+
+  vector<vector<shared_ptr<TypeParam>>> opened(kNumThreads);
+  vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (const string& f : files) {
+        shared_ptr<TypeParam> file;
+        CHECK_OK(this->cache_->OpenExistingFile(f, &file));
+        opened[t].push_back(std::move(file));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  ASSERT_EQ(kNumFiles, this->cache_->NumDescriptorsForTests());
+  for (int t = 1; t < kNumThreads; t++) {
+    for (int i = 0; i < kNumFiles; i++) {
+      ASSERT_EQ(opened[0][i].get(), opened[t][i].get());
+    }
+  }
+}
+
 TYPED_TEST(FileCacheTest, TestNoRecursiveDeadlock) {
   // This test triggered a deadlock in a previous implementation, when expired
   // weak_ptrs were removed from the descriptor map in the descriptor's
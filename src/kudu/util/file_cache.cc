@@ -17,9 +17,11 @@
 
 #include "kudu/util/file_cache.h"
 
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <gflags/gflags.h>
 
@@ -42,9 +44,25 @@ DEFINE_int32(file_cache_expiry_period_ms, 60 * 1000,
              "Period of time (in ms) between removing expired file cache descriptors");
 TAG_FLAG(file_cache_expiry_period_ms, advanced);
 
+METRIC_DEFINE_histogram(server, file_cache_open_latency, "File Cache Open Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Time spent opening files through the file cache, whether "
+                        "for the first time or after they were evicted.",
+                        60000000LU, 2);
+METRIC_DEFINE_counter(server, file_cache_reopens, "File Cache Reopens",
+                      kudu::MetricUnit::kEntries,
+                      "Number of files reopened by the file cache after being "
+                      "evicted. A high rate means the cache is too small for "
+                      "the working set of open files.");
+METRIC_DEFINE_counter(server, file_cache_evictions, "File Cache Evictions",
+                      kudu::MetricUnit::kEntries,
+                      "Number of open files closed by the file cache, usually to "
+                      "stay within its capacity.");
+
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -60,14 +78,21 @@ FileType* CacheValueToFileType(Slice s) {
 template <class FileType>
 class EvictionCallback : public Cache::EvictionCallback {
  public:
-  EvictionCallback() {}
+  explicit EvictionCallback(scoped_refptr<Counter> evictions)
+      : evictions_(std::move(evictions)) {}
 
   void EvictedEntry(Slice key, Slice value) override {
     VLOG(2) << "Evicted fd belonging to " << key.ToString();
     delete CacheValueToFileType<FileType>(value);
+    if (evictions_) {
+      evictions_->Increment();
+    }
   }
 
  private:
+  // May be NULL.
+  scoped_refptr<Counter> evictions_;
+
   DISALLOW_COPY_AND_ASSIGN(EvictionCallback);
 };
 
@@ -90,9 +115,9 @@ class BaseDescriptor {
   ~BaseDescriptor() {
     VLOG(2) << "Out of scope descriptor with file name: " << filename();
 
-    // The (now expired) weak_ptr remains in 'descriptors_', to be removed by
-    // the next call to RunDescriptorExpiry(). Removing it here would risk a
-    // deadlock on recursive acquisition of 'lock_'.
+    // The (now expired) weak_ptr remains in the descriptor map, to be removed
+    // by the next call to RunDescriptorExpiry(). Removing it here would risk
+    // a deadlock on recursive acquisition of the map shard's lock.
 
     if (deleted_) {
       cache()->Erase(filename());
@@ -142,6 +167,10 @@ class BaseDescriptor {
 
   Env* env() const { return file_cache_->env_; }
 
+  void RecordOpen(const MonoDelta& latency, bool reopen) const {
+    file_cache_->RecordOpen(latency, reopen);
+  }
+
   const string& filename() const { return file_name_; }
 
   bool deleted() const { return deleted_; }
@@ -187,6 +216,29 @@ class ScopedOpenedDescriptor {
   Cache::UniqueHandle handle_;
 };
 
+// Submit 'requests' to the file held by 'opened', keeping the file open
+// until the last of the reads has completed.
+template <class FileType>
+Status SubmitReadsToOpenedFile(ScopedOpenedDescriptor<FileType> opened,
+                               const vector<AsyncReadRequest*>& requests) {
+  shared_ptr<ScopedOpenedDescriptor<FileType>> holder(
+      new ScopedOpenedDescriptor<FileType>(std::move(opened)));
+  shared_ptr<vector<std::function<void()>>> callbacks(
+      new vector<std::function<void()>>());
+  callbacks->reserve(requests.size());
+  for (int i = 0; i < requests.size(); i++) {
+    callbacks->emplace_back(std::move(requests[i]->callback));
+    requests[i]->callback = [holder, callbacks, i]() { (*callbacks)[i](); };
+  }
+  Status s = holder->file()->SubmitReads(requests);
+  if (!s.ok()) {
+    for (int i = 0; i < requests.size(); i++) {
+      requests[i]->callback = std::move((*callbacks)[i]);
+    }
+  }
+  return s;
+}
+
 // Reference to an on-disk file that may or may not be opened (and thus
 // cached) in the file cache.
 //
@@ -213,6 +265,19 @@ class Descriptor<RWFile> : public RWFile {
     return opened.file()->Read(offset, length, result, scratch);
   }
 
+  Status SubmitReads(const vector<AsyncReadRequest*>& requests) const override {
+    ScopedOpenedDescriptor<RWFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return SubmitReadsToOpenedFile(std::move(opened), requests);
+  }
+
+  Status ReadUncached(uint64_t offset, size_t length,
+                      Slice* result, uint8_t* scratch) const override {
+    ScopedOpenedDescriptor<RWFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->ReadUncached(offset, length, result, scratch);
+  }
+
   Status Write(uint64_t offset, const Slice& data) override {
     ScopedOpenedDescriptor<RWFile> opened(&base_);
     RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
@@ -293,7 +358,9 @@ class Descriptor<RWFile> : public RWFile {
     opts.sync_on_close = true;
     opts.mode = Env::OPEN_EXISTING;
     unique_ptr<RWFile> f;
+    MonoTime start = MonoTime::Now();
     RETURN_NOT_OK(base_.env()->NewRWFile(opts, base_.filename(), &f));
+    base_.RecordOpen(MonoTime::Now() - start, out != nullptr);
 
     // The cache will take ownership of the newly opened file.
     ScopedOpenedDescriptor<RWFile> opened(base_.InsertIntoCache(f.release()));
@@ -326,6 +393,19 @@ class Descriptor<RandomAccessFile> : public RandomAccessFile {
     return opened.file()->Read(offset, n, result, scratch);
   }
 
+  Status SubmitReads(const vector<AsyncReadRequest*>& requests) const override {
+    ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return SubmitReadsToOpenedFile(std::move(opened), requests);
+  }
+
+  Status ReadUncached(uint64_t offset, size_t n,
+                      Slice* result, uint8_t *scratch) const override {
+    ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
+    RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
+    return opened.file()->ReadUncached(offset, n, result, scratch);
+  }
+
   Status Size(uint64_t *size) const override {
     ScopedOpenedDescriptor<RandomAccessFile> opened(&base_);
     RETURN_NOT_OK(ReopenFileIfNecessary(&opened));
@@ -366,7 +446,9 @@ class Descriptor<RandomAccessFile> : public RandomAccessFile {
 
     // The file was evicted, reopen it.
     unique_ptr<RandomAccessFile> f;
+    MonoTime start = MonoTime::Now();
     RETURN_NOT_OK(base_.env()->NewRandomAccessFile(base_.filename(), &f));
+    base_.RecordOpen(MonoTime::Now() - start, out != nullptr);
 
     // The cache will take ownership of the newly opened file.
     ScopedOpenedDescriptor<RandomAccessFile> opened(
@@ -392,12 +474,16 @@ FileCache<FileType>::FileCache(const string& cache_name,
                                const scoped_refptr<MetricEntity>& entity)
     : env_(env),
       cache_name_(cache_name),
-      eviction_cb_(new EvictionCallback<FileType>()),
       cache_(NewLRUCache(DRAM_CACHE, max_open_files, cache_name)),
       running_(1) {
+  scoped_refptr<Counter> evictions;
   if (entity) {
     cache_->SetMetrics(entity);
+    open_latency_ = METRIC_file_cache_open_latency.Instantiate(entity);
+    reopens_ = METRIC_file_cache_reopens.Instantiate(entity);
+    evictions = METRIC_file_cache_evictions.Instantiate(entity);
   }
+  eviction_cb_.reset(new EvictionCallback<FileType>(std::move(evictions)));
   LOG(INFO) << Substitute("Constructed file cache $0 with capacity $1",
                           cache_name, max_open_files);
 }
@@ -420,16 +506,30 @@ Status FileCache<FileType>::Init() {
 template <class FileType>
 Status FileCache<FileType>::OpenExistingFile(const string& file_name,
                                              shared_ptr<FileType>* file) {
+  DescriptorShard* shard = GetShard(file_name);
   shared_ptr<internal::Descriptor<FileType>> desc;
   {
+    // Fast path: the descriptor exists and is still in use.
+    shared_lock<rw_spinlock> l(shard->lock.get_lock());
+    auto it = shard->descriptors.find(file_name);
+    if (it != shard->descriptors.end()) {
+      desc = it->second.lock();
+      if (desc && desc->base_.deleted()) {
+        return Status::NotFound("File already marked for deletion", file_name);
+      }
+    }
+  }
+  if (desc) {
+    VLOG(2) << "Found existing descriptor: " << desc->filename();
+  } else {
     // Find an existing descriptor, or create one if none exists.
-    std::lock_guard<simple_spinlock> l(lock_);
-    RETURN_NOT_OK(FindDescriptorUnlocked(file_name, &desc));
+    std::lock_guard<percpu_rwlock> l(shard->lock);
+    RETURN_NOT_OK(FindDescriptorUnlocked(shard, file_name, &desc));
     if (desc) {
       VLOG(2) << "Found existing descriptor: " << desc->filename();
     } else {
       desc = std::make_shared<internal::Descriptor<FileType>>(this, file_name);
-      InsertOrDie(&descriptors_, file_name, desc);
+      InsertOrDie(&shard->descriptors, file_name, desc);
       VLOG(2) << "Created new descriptor: " << desc->filename();
     }
   }
@@ -444,9 +544,10 @@ Status FileCache<FileType>::OpenExistingFile(const string& file_name,
 template <class FileType>
 Status FileCache<FileType>::DeleteFile(const string& file_name) {
   {
-    std::lock_guard<simple_spinlock> l(lock_);
+    DescriptorShard* shard = GetShard(file_name);
+    std::lock_guard<percpu_rwlock> l(shard->lock);
     shared_ptr<internal::Descriptor<FileType>> desc;
-    RETURN_NOT_OK(FindDescriptorUnlocked(file_name, &desc));
+    RETURN_NOT_OK(FindDescriptorUnlocked(shard, file_name, &desc));
 
     if (desc) {
       VLOG(2) << "Marking file for deletion: " << file_name;
@@ -463,50 +564,72 @@ Status FileCache<FileType>::DeleteFile(const string& file_name) {
   return env_->DeleteFile(file_name);
 }
 
+template <class FileType>
+void FileCache<FileType>::Invalidate(const string& file_name) {
+  cache_->Erase(file_name);
+}
+
 template <class FileType>
 int FileCache<FileType>::NumDescriptorsForTests() const {
-  std::lock_guard<simple_spinlock> l(lock_);
-  return descriptors_.size();
+  int count = 0;
+  for (const DescriptorShard& shard : shards_) {
+    shared_lock<rw_spinlock> l(shard.lock.get_lock());
+    count += shard.descriptors.size();
+  }
+  return count;
 }
 
 template <class FileType>
 string FileCache<FileType>::ToDebugString() const {
-  std::lock_guard<simple_spinlock> l(lock_);
   string ret;
-  for (const auto& e : descriptors_) {
-    bool strong = false;
-    bool deleted = false;
-    bool opened = false;
-    shared_ptr<internal::Descriptor<FileType>> desc = e.second.lock();
-    if (desc) {
-      strong = true;
-      if (desc->base_.deleted()) {
-        deleted = true;
+  for (const DescriptorShard& shard : shards_) {
+    shared_lock<rw_spinlock> l(shard.lock.get_lock());
+    for (const auto& e : shard.descriptors) {
+      bool strong = false;
+      bool deleted = false;
+      bool opened = false;
+      shared_ptr<internal::Descriptor<FileType>> desc = e.second.lock();
+      if (desc) {
+        strong = true;
+        if (desc->base_.deleted()) {
+          deleted = true;
+        }
+        internal::ScopedOpenedDescriptor<FileType> o(
+            desc->base_.LookupFromCache());
+        if (o.opened()) {
+          opened = true;
+        }
       }
-      internal::ScopedOpenedDescriptor<FileType> o(
-          desc->base_.LookupFromCache());
-      if (o.opened()) {
-        opened = true;
+      if (strong) {
+        ret += Substitute("$0 (S$1$2)\n", e.first,
+                          deleted ? "D" : "", opened ? "O" : "");
+      } else {
+        ret += Substitute("$0\n", e.first);
       }
     }
-    if (strong) {
-      ret += Substitute("$0 (S$1$2)\n", e.first,
-                        deleted ? "D" : "", opened ? "O" : "");
-    } else {
-      ret += Substitute("$0\n", e.first);
-    }
   }
   return ret;
 }
 
+template <class FileType>
+typename FileCache<FileType>::DescriptorShard* FileCache<FileType>::GetShard(
+    const string& file_name) {
+  return &shards_[std::hash<string>()(file_name) % kNumDescriptorShards];
+}
+
+template <class FileType>
+const typename FileCache<FileType>::DescriptorShard* FileCache<FileType>::GetShard(
+    const string& file_name) const {
+  return &shards_[std::hash<string>()(file_name) % kNumDescriptorShards];
+}
+
 template <class FileType>
 Status FileCache<FileType>::FindDescriptorUnlocked(
+    DescriptorShard* shard,
     const string& file_name,
     shared_ptr<internal::Descriptor<FileType>>* file) {
-  DCHECK(lock_.is_locked());
-
-  auto it = descriptors_.find(file_name);
-  if (it != descriptors_.end()) {
+  auto it = shard->descriptors.find(file_name);
+  if (it != shard->descriptors.end()) {
     // Found the descriptor. Has it expired?
     shared_ptr<internal::Descriptor<FileType>> desc = it->second.lock();
     if (desc) {
@@ -521,21 +644,33 @@ Status FileCache<FileType>::FindDescriptorUnlocked(
       return Status::OK();
     }
     // Descriptor has expired; erase it and pretend we found nothing.
-    descriptors_.erase(it);
+    shard->descriptors.erase(it);
   }
   return Status::OK();
 }
 
+template <class FileType>
+void FileCache<FileType>::RecordOpen(const MonoDelta& latency, bool reopen) const {
+  if (open_latency_) {
+    open_latency_->Increment(latency.ToMicroseconds());
+  }
+  if (reopen && reopens_) {
+    reopens_->Increment();
+  }
+}
+
 template <class FileType>
 void FileCache<FileType>::RunDescriptorExpiry() {
   while (!running_.WaitFor(MonoDelta::FromMilliseconds(
       FLAGS_file_cache_expiry_period_ms))) {
-    std::lock_guard<simple_spinlock> l(lock_);
-    for (auto it = descriptors_.begin(); it != descriptors_.end();) {
-      if (it->second.expired()) {
-        it = descriptors_.erase(it);
-      } else {
-        it++;
+    for (DescriptorShard& shard : shards_) {
+      std::lock_guard<percpu_rwlock> l(shard.lock);
+      for (auto it = shard.descriptors.begin(); it != shard.descriptors.end();) {
+        if (it->second.expired()) {
+          it = shard.descriptors.erase(it);
+        } else {
+          it++;
+        }
       }
     }
   }
@@ -559,6 +694,8 @@ Status FileCache<RWFile>::OpenExistingFile(
 template
 Status FileCache<RWFile>::DeleteFile(const string& file_name);
 template
+void FileCache<RWFile>::Invalidate(const string& file_name);
+template
 int FileCache<RWFile>::NumDescriptorsForTests() const;
 template
 string FileCache<RWFile>::ToDebugString() const;
@@ -580,6 +717,8 @@ Status FileCache<RandomAccessFile>::OpenExistingFile(
 template
 Status FileCache<RandomAccessFile>::DeleteFile(const string& file_name);
 template
+void FileCache<RandomAccessFile>::Invalidate(const string& file_name);
+template
 int FileCache<RandomAccessFile>::NumDescriptorsForTests() const;
 template
 string FileCache<RandomAccessFile>::ToDebugString() const;
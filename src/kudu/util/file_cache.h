@@ -29,6 +29,7 @@
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/env.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
@@ -44,6 +45,8 @@ class Descriptor;
 
 } // namespace internal
 
+class Counter;
+class Histogram;
 class MetricEntity;
 class Thread;
 
@@ -82,6 +85,14 @@ class Thread;
 // closed, so it is reopened and reinserted (possibly evicting a different open
 // file) before the file access is performed.
 //
+// Concurrency
+// -----------
+// The descriptor map is split into shards by file name, each protected by a
+// per-CPU reader-writer lock. Opening a file whose descriptor already exists
+// (the common case once a server has warmed up) only takes the read side of
+// its shard's lock, which doesn't contend with other readers. Creating or
+// deleting a descriptor takes the write side of just one shard's lock.
+//
 // Other notes
 // -----------
 // In a world where files are opened and closed transparently, file deletion
@@ -130,6 +141,15 @@ class FileCache {
   // deleted immediately.
   Status DeleteFile(const std::string& file_name);
 
+  // Closes the cached open file for 'file_name', if there is one, so that
+  // the next operation on its descriptor reopens the file by name.
+  //
+  // Must be called after the file has been replaced on disk (e.g. by a
+  // rename onto its name) for descriptors to see the new file. The caller is
+  // responsible for ensuring that no operations on the descriptor are in
+  // progress.
+  void Invalidate(const std::string& file_name);
+
   // Returns the number of entries in the descriptor map.
   //
   // Only intended for unit tests.
@@ -144,13 +164,35 @@ class FileCache {
   template<class FileType2>
   FRIEND_TEST(FileCacheTest, TestBasicOperations);
 
-  // Looks up a descriptor by file name.
+  // A shard of the descriptor map.
+  struct DescriptorShard {
+    // Protects 'descriptors'.
+    mutable percpu_rwlock lock;
+
+    // Maps filenames to descriptors.
+    std::unordered_map<std::string,
+                       std::weak_ptr<internal::Descriptor<FileType>>> descriptors;
+  };
+
+  static const int kNumDescriptorShards = 16;
+
+  // Returns the shard holding the descriptor for 'file_name'.
+  DescriptorShard* GetShard(const std::string& file_name);
+  const DescriptorShard* GetShard(const std::string& file_name) const;
+
+  // Looks up a descriptor by file name in 'shard', erasing it if it has
+  // expired.
   //
-  // Must be called with 'lock_' held.
-  Status FindDescriptorUnlocked(
+  // Must be called with the write side of the shard's lock held.
+  static Status FindDescriptorUnlocked(
+      DescriptorShard* shard,
       const std::string& file_name,
       std::shared_ptr<internal::Descriptor<FileType>>* file);
 
+  // Records the outcome of opening a file on behalf of a descriptor. A
+  // reopen is the opening of a file that had been evicted from the cache.
+  void RecordOpen(const MonoDelta& latency, bool reopen) const;
+
   // Periodically removes expired descriptors from 'descriptors_'.
   void RunDescriptorExpiry();
 
@@ -167,12 +209,11 @@ class FileCache {
   // Underlying cache instance. Caches opened files.
   std::unique_ptr<Cache> cache_;
 
-  // Protects the descriptor map.
-  mutable simple_spinlock lock_;
+  DescriptorShard shards_[kNumDescriptorShards];
 
-  // Maps filenames to descriptors.
-  std::unordered_map<std::string,
-                     std::weak_ptr<internal::Descriptor<FileType>>> descriptors_;
+  // Metrics. NULL if the cache was constructed without a metric entity.
+  scoped_refptr<Histogram> open_latency_;
+  scoped_refptr<Counter> reopens_;
 
   // Calls RunDescriptorExpiry() in a loop until 'running_' isn't set.
   scoped_refptr<Thread> descriptor_expiry_thread_;
@@ -184,6 +184,33 @@ void HdrHistogram::IncrementBy(int64_t value, int64_t count) {
   }
 }
 
+void HdrHistogram::MergeFrom(const HdrHistogram& other) {
+  DCHECK_EQ(highest_trackable_value_, other.highest_trackable_value_);
+  DCHECK_EQ(num_significant_digits_, other.num_significant_digits_);
+
+  NoBarrier_AtomicIncrement(&total_sum_, NoBarrier_Load(&other.total_sum_));
+  uint64_t total_merged_count = 0;
+  for (int i = 0; i < counts_array_length_; i++) {
+    uint64_t count = NoBarrier_Load(&other.counts_[i]);
+    if (count > 0) {
+      NoBarrier_AtomicIncrement(&counts_[i], count);
+      total_merged_count += count;
+    }
+  }
+  NoBarrier_AtomicIncrement(&total_count_, total_merged_count);
+
+  Atomic64 other_min = NoBarrier_Load(&other.min_value_);
+  Atomic64 min_val;
+  while (PREDICT_FALSE(other_min < (min_val = NoBarrier_Load(&min_value_)))) {
+    if (NoBarrier_CompareAndSwap(&min_value_, min_val, other_min) == min_val) break;
+  }
+  Atomic64 other_max = NoBarrier_Load(&other.max_value_);
+  Atomic64 max_val;
+  while (PREDICT_FALSE(other_max > (max_val = NoBarrier_Load(&max_value_)))) {
+    if (NoBarrier_CompareAndSwap(&max_value_, max_val, other_max) == max_val) break;
+  }
+}
+
 void HdrHistogram::IncrementWithExpectedInterval(int64_t value,
                                                  int64_t expected_interval_between_samples) {
   Increment(value);
@@ -0,0 +1,68 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/key_compare.h"
+#include "kudu/util/random.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/test_util.h"
+
+using std::string;
+
+namespace kudu {
+
+class KeyCompareTest : public KuduTest {};
+
+static int Sign(int x) {
+  return (x > 0) - (x < 0);
+}
+
+// Compare random keys which share prefixes of random lengths against
+// Slice::compare().
+TEST_F(KeyCompareTest, TestRandomKeys) {
+  Random rng(SeedRandom());
+  for (int i = 0; i < 10000; i++) {
+    string prefix(rng.Uniform(70), 'x');
+    string a = prefix;
+    string b = prefix;
+    for (int j = rng.Uniform(4); j > 0; j--) {
+      a.push_back('a' + rng.Uniform(3));
+    }
+    for (int j = rng.Uniform(4); j > 0; j--) {
+      b.push_back('a' + rng.Uniform(3));
+    }
+    SCOPED_TRACE(a + " vs " + b);
+
+    size_t cpl = prefix.size();
+    while (cpl < a.size() && cpl < b.size() && a[cpl] == b[cpl]) {
+      cpl++;
+    }
+    ASSERT_EQ(cpl, CommonPrefixLength(a, b));
+
+    size_t prefix_len;
+    int expected = Sign(Slice(a).compare(b));
+    ASSERT_EQ(expected, CompareKeys(a, b, 0, &prefix_len));
+    ASSERT_EQ(cpl, prefix_len);
+    ASSERT_EQ(expected, CompareKeys(a, b, rng.Uniform(prefix.size() + 1)));
+    ASSERT_EQ(-expected, CompareKeys(b, a, prefix.size()));
+  }
+}
+
+} // namespace kudu
@@ -0,0 +1,111 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Comparison of memcmp-able keys, such as encoded primary keys.
+//
+// Encoded keys frequently share long prefixes (e.g. a tenant id, or a
+// timestamp bucket), so these routines locate the first mismatching byte
+// 16 or 8 bytes at a time, and let callers which already know that two keys
+// share a prefix skip it.
+#ifndef KUDU_UTIL_KEY_COMPARE_H
+#define KUDU_UTIL_KEY_COMPARE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/slice.h"
+
+namespace kudu {
+
+// Return the length of the common prefix shared by the two strings.
+//
+// The first 'skip' bytes of the strings must be known to be equal, and are
+// not compared again.
+inline size_t CommonPrefixLength(const Slice& slice_a, const Slice& slice_b,
+                                 size_t skip = 0) {
+  const size_t len = std::min(slice_a.size(), slice_b.size());
+  // Never read past the strings, even if a racy reader was wrong about 'skip'.
+  skip = std::min(skip, len);
+  const uint8_t* a = slice_a.data() + skip;
+  const uint8_t* b = slice_b.data() + skip;
+  const uint8_t* a_limit = slice_a.data() + len;
+
+#if defined(__SSE2__)
+  // Compare 16 bytes at a time, and locate the first mismatching byte
+  // from the comparison mask.
+  while (a + sizeof(__m128i) <= a_limit) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+    unsigned int mismatch = ~_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xffff;
+    if (mismatch != 0) {
+      return (a - slice_a.data()) + Bits::FindLSBSetNonZero(mismatch);
+    }
+    a += sizeof(__m128i);
+    b += sizeof(__m128i);
+  }
+#endif
+
+  // Same, 8 bytes at a time. On a little-endian machine, the lowest set bit
+  // of the XOR of the words is in the first mismatching byte.
+  while (a + sizeof(uint64_t) <= a_limit) {
+    uint64_t diff = UNALIGNED_LOAD64(a) ^ UNALIGNED_LOAD64(b);
+    if (diff != 0) {
+#if defined(IS_LITTLE_ENDIAN)
+      return (a - slice_a.data()) + Bits::FindLSBSetNonZero64(diff) / 8;
+#else
+      break;
+#endif
+    }
+    a += sizeof(uint64_t);
+    b += sizeof(uint64_t);
+  }
+
+  while (a < a_limit && *a == *b) {
+    a++;
+    b++;
+  }
+  return a - slice_a.data();
+}
+
+// Compare two memcmp-able keys, returning the same result as
+// Slice::compare().
+//
+// The first 'skip' bytes of the keys must be known to be equal. If not null,
+// 'prefix_len' is set to the length of the common prefix of the keys, which
+// callers searching sorted keys may pass as 'skip' to later comparisons.
+inline int CompareKeys(const Slice& a, const Slice& b,
+                       size_t skip = 0, size_t* prefix_len = nullptr) {
+  size_t cpl = CommonPrefixLength(a, b, skip);
+  if (prefix_len) {
+    *prefix_len = cpl;
+  }
+  if (cpl == a.size() || cpl == b.size()) {
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+  }
+  return a[cpl] < b[cpl] ? -1 : 1;
+}
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_KEY_COMPARE_H
@@ -199,6 +199,16 @@ class percpu_rwlock {
     return false;
   }
 
+  // Return true if this lock is held for write, that is, if the lock of
+  // every CPU is held for write.
+  // See simple_spinlock::is_locked() for details about where this is useful.
+  bool is_write_locked() const {
+    for (int i = 0; i < n_cpus_; i++) {
+      if (!locks_[i].lock.is_write_locked()) return false;
+    }
+    return true;
+  }
+
   void lock() {
     for (int i = 0; i < n_cpus_; i++) {
       locks_[i].lock.lock();
@@ -19,6 +19,8 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <mutex>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "kudu/gutil/strings/substitute.h"
@@ -30,7 +32,9 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
 
+using std::set;
 using std::shared_ptr;
+using std::string;
 using std::vector;
 using strings::Substitute;
 
@@ -44,6 +48,9 @@ METRIC_DEFINE_histogram(test, maintenance_op_duration,
                         kudu::MetricUnit::kSeconds, "", 60000000LU, 2);
 
 DECLARE_int64(log_target_replay_size_mb);
+DECLARE_int32(maintenance_manager_max_ops_per_data_dir);
+DECLARE_int32(maintenance_manager_reserved_threads);
+DECLARE_bool(maintenance_manager_plan_memory_flushes);
 
 namespace kudu {
 
@@ -125,6 +132,7 @@ class TestMaintenanceOp : public MaintenanceOp {
     stats->set_ram_anchored(consumption_.consumption());
     stats->set_logs_retained_bytes(logs_retained_bytes_);
     stats->set_perf_improvement(perf_improvement_);
+    stats->set_data_dirs(data_dirs_);
   }
 
   void set_remaining_runs(int runs) {
@@ -152,6 +160,11 @@ class TestMaintenanceOp : public MaintenanceOp {
     perf_improvement_ = perf_improvement;
   }
 
+  void set_data_dirs(set<string> data_dirs) {
+    std::lock_guard<Mutex> guard(lock_);
+    data_dirs_ = std::move(data_dirs);
+  }
+
   virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE {
     return maintenance_op_duration_;
   }
@@ -166,6 +179,7 @@ class TestMaintenanceOp : public MaintenanceOp {
   ScopedTrackedConsumption consumption_;
   uint64_t logs_retained_bytes_;
   uint64_t perf_improvement_;
+  set<string> data_dirs_;
   MetricRegistry metric_registry_;
   scoped_refptr<MetricEntity> metric_entity_;
   scoped_refptr<Histogram> maintenance_op_duration_;
@@ -249,6 +263,43 @@ TEST_F(MaintenanceManagerTest, TestMemoryPressure) {
   ThreadJoiner(thread.get()).Join();
 }
 
+// Test that, when planning flushes under memory pressure, the memory anchored
+// by running ops counts towards the excess over the soft limit, and the
+// smallest op which frees the rest is picked.
+TEST_F(MaintenanceManagerTest, TestMemoryPressurePlanning) {
+  FLAGS_maintenance_manager_plan_memory_flushes = true;
+  manager_->Shutdown();
+
+  // 1200 bytes are consumed, 600 over the soft limit, which no op covers.
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  op1.set_ram_anchored(500);
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  op2.set_ram_anchored(400);
+  TestMaintenanceOp op3("op3", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  op3.set_ram_anchored(300);
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+  manager_->RegisterOp(&op3);
+
+  // The op anchoring the most memory goes first.
+  ASSERT_EQ(&op1, manager_->FindBestOp());
+
+  // Once it runs, both of the others would free the remaining 100 bytes, so
+  // the smaller one is picked.
+  manager_->launched_this_poll_.insert(&op1);
+  manager_->ram_being_freed_ = 500;
+  ASSERT_EQ(&op3, manager_->FindBestOp());
+
+  // Nothing more is needed once the running ops cover the excess.
+  manager_->ram_being_freed_ = 800;
+  ASSERT_EQ(nullptr, manager_->FindBestOp());
+
+  manager_->ram_being_freed_ = 0;
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+  manager_->UnregisterOp(&op3);
+}
+
 // Test that ops are prioritized correctly when we add log retention.
 TEST_F(MaintenanceManagerTest, TestLogRetentionPrioritization) {
   const int64_t kMB = 1024 * 1024;
@@ -317,4 +368,109 @@ TEST_F(MaintenanceManagerTest, TestCompletedOpsHistory) {
   }
 }
 
+// Test that no more than --maintenance_manager_max_ops_per_data_dir ops which
+// read from the same data dir run at once, while ops on other data dirs can.
+TEST_F(MaintenanceManagerTest, TestPerDataDirLimit) {
+  FLAGS_maintenance_manager_max_ops_per_data_dir = 1;
+
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  TestMaintenanceOp op3("op3", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  op1.set_data_dirs({ "/a" });
+  op2.set_data_dirs({ "/a" });
+  op3.set_data_dirs({ "/b" });
+  for (TestMaintenanceOp* op : { &op1, &op2, &op3 }) {
+    op->set_ram_anchored(0);
+    op->set_perf_improvement(1);
+    op->set_sleep_time(MonoDelta::FromMilliseconds(500));
+  }
+  // Give 'op1' the better score, so that it goes first.
+  op1.set_perf_improvement(2);
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+  manager_->RegisterOp(&op3);
+
+  // 'op3' runs alongside 'op1', but 'op2' must wait for 'op1' to finish.
+  AssertEventually([&]() {
+      ASSERT_EQ(1, op1.RunningGauge()->value());
+      ASSERT_EQ(1, op3.RunningGauge()->value());
+    });
+  ASSERT_EQ(0, op2.RunningGauge()->value());
+
+  MaintenanceManagerStatusPB status_pb;
+  manager_->GetMaintenanceManagerStatusDump(&status_pb);
+  ASSERT_EQ(2, status_pb.data_dirs_size());
+
+  AssertEventually([&]() {
+      ASSERT_EQ(1, op2.DurationHistogram()->TotalCount());
+    });
+  ASSERT_EQ(1, op1.DurationHistogram()->TotalCount());
+  ASSERT_EQ(1, op3.DurationHistogram()->TotalCount());
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+  manager_->UnregisterOp(&op3);
+}
+
+// Test that the reserved threads are only used to relieve memory pressure.
+TEST_F(MaintenanceManagerTest, TestReservedThreads) {
+  FLAGS_maintenance_manager_reserved_threads = 1;
+
+  TestMaintenanceOp perf_op("perf_op", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  perf_op.set_perf_improvement(1);
+  perf_op.set_ram_anchored(0);
+  perf_op.set_remaining_runs(10);
+  perf_op.set_sleep_time(MonoDelta::FromMilliseconds(200));
+  manager_->RegisterOp(&perf_op);
+
+  // Only one of the two threads may run 'perf_op'.
+  AssertEventually([&]() {
+      ASSERT_EQ(1, perf_op.RunningGauge()->value());
+    });
+  SleepFor(MonoDelta::FromMilliseconds(50));
+  ASSERT_LE(perf_op.RunningGauge()->value(), 1);
+
+  // An op which frees memory under memory pressure gets the other one.
+  TestMaintenanceOp mem_op("mem_op", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  mem_op.set_ram_anchored(1100);
+  mem_op.set_sleep_time(MonoDelta::FromMilliseconds(200));
+  manager_->RegisterOp(&mem_op);
+  AssertEventually([&]() {
+      ASSERT_EQ(1, mem_op.DurationHistogram()->TotalCount());
+    });
+
+  manager_->UnregisterOp(&mem_op);
+  manager_->UnregisterOp(&perf_op);
+}
+
+// Test that the ops' scheduling statistics are reported by type.
+TEST_F(MaintenanceManagerTest, TestOpTypeStats) {
+  manager_->Shutdown();
+
+  TestMaintenanceOp op1("TestOp(1)", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  TestMaintenanceOp op2("TestOp(2)", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  TestMaintenanceOp op3("OtherOp(1)", MaintenanceOp::HIGH_IO_USAGE, test_tracker_);
+  for (TestMaintenanceOp* op : { &op1, &op2, &op3 }) {
+    op->set_ram_anchored(0);
+  }
+  op1.set_perf_improvement(1);
+  op2.set_perf_improvement(1);
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+  manager_->RegisterOp(&op3);
+
+  MaintenanceManagerStatusPB status_pb;
+  manager_->GetMaintenanceManagerStatusDump(&status_pb);
+  ASSERT_EQ(2, status_pb.op_types_size());
+  ASSERT_EQ("OtherOp", status_pb.op_types(0).type());
+  ASSERT_EQ(0, status_pb.op_types(0).queued());
+  ASSERT_EQ("TestOp", status_pb.op_types(1).type());
+  ASSERT_EQ(2, status_pb.op_types(1).queued());
+  ASSERT_EQ(0, status_pb.op_types(1).running());
+  ASSERT_EQ(0, status_pb.op_types(1).launched());
+
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+  manager_->UnregisterOp(&op3);
+}
+
 } // namespace kudu
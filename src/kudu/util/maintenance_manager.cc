@@ -18,11 +18,13 @@
 #include "kudu/util/maintenance_manager.h"
 
 #include <gflags/gflags.h>
+#include <algorithm>
 #include <memory>
 #include <stdint.h>
 #include <string>
 #include <utility>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/debug/trace_event.h"
@@ -36,7 +38,9 @@
 #include "kudu/util/trace.h"
 
 using std::pair;
+using std::set;
 using std::shared_ptr;
+using std::string;
 using strings::Substitute;
 
 DEFINE_int32(maintenance_manager_num_threads, 1,
@@ -45,6 +49,30 @@ DEFINE_int32(maintenance_manager_num_threads, 1,
              "not be above the number of devices.");
 TAG_FLAG(maintenance_manager_num_threads, stable);
 
+DEFINE_int32(maintenance_manager_max_ops_per_data_dir, 0,
+             "The maximum number of high-IO maintenance operations which may "
+             "concurrently read from any one data directory, so that a thread "
+             "pool sized for many disks isn't spent on just one of them. "
+             "0 means no limit.");
+TAG_FLAG(maintenance_manager_max_ops_per_data_dir, experimental);
+TAG_FLAG(maintenance_manager_max_ops_per_data_dir, runtime);
+
+DEFINE_int32(maintenance_manager_reserved_threads, 0,
+             "The number of maintenance manager threads reserved for operations "
+             "which free memory while the process is over its soft memory limit. "
+             "At least one thread is always left for other operations.");
+TAG_FLAG(maintenance_manager_reserved_threads, experimental);
+TAG_FLAG(maintenance_manager_reserved_threads, runtime);
+
+DEFINE_bool(maintenance_manager_plan_memory_flushes, false,
+            "Whether, over the soft memory limit, the maintenance manager accounts for "
+            "the memory which the ops it already launched are freeing, and picks the "
+            "smallest op which frees the rest rather than the one anchoring the most "
+            "memory. This launches just enough flushes to get back under the limit, with "
+            "the least I/O.");
+TAG_FLAG(maintenance_manager_plan_memory_flushes, experimental);
+TAG_FLAG(maintenance_manager_plan_memory_flushes, runtime);
+
 DEFINE_int32(maintenance_manager_polling_interval_ms, 250,
        "Polling interval for the maintenance manager scheduler, "
        "in milliseconds.");
@@ -77,6 +105,7 @@ void MaintenanceOpStats::Clear() {
   ram_anchored_ = 0;
   logs_retained_bytes_ = 0;
   perf_improvement_ = 0;
+  data_dirs_.clear();
 }
 
 MaintenanceOp::MaintenanceOp(std::string name, IOUsage io_usage)
@@ -109,6 +138,7 @@ MaintenanceManager::MaintenanceManager(const Options& options)
     cond_(&lock_),
     shutdown_(false),
     running_ops_(0),
+    ram_being_freed_(0),
     polling_interval_ms_(options.polling_interval_ms <= 0 ?
           FLAGS_maintenance_manager_polling_interval_ms :
           options.polling_interval_ms),
@@ -186,6 +216,7 @@ void MaintenanceManager::UnregisterOp(MaintenanceOp* op) {
           << "waiting for it to complete";
     }
     ops_.erase(iter);
+    launched_this_poll_.erase(op);
   }
   LOG(INFO) << "Unregistered op " << op->name();
   op->cond_.reset();
@@ -197,9 +228,16 @@ void MaintenanceManager::RunSchedulerThread() {
   MonoDelta polling_interval = MonoDelta::FromMilliseconds(polling_interval_ms_);
 
   std::unique_lock<Mutex> guard(lock_);
+  bool launched = false;
   while (true) {
-    // Loop until we are shutting down or it is time to run another op.
-    cond_.TimedWait(polling_interval);
+    // Loop until we are shutting down or it is time to run another op. Right
+    // after launching an op, look for another one without waiting, so that
+    // every free thread can be put to work in a single poll.
+    if (!launched) {
+      cond_.TimedWait(polling_interval);
+      launched_this_poll_.clear();
+    }
+    launched = false;
     if (shutdown_) {
       VLOG_AND_TRACE("maintenance", 1) << "Shutting down maintenance manager.";
       return;
@@ -217,9 +255,17 @@ void MaintenanceManager::RunSchedulerThread() {
       continue;
     }
 
-    // Prepare the maintenance operation.
+    // Prepare the maintenance operation, reserving its thread and data dirs.
+    const MaintenanceOpStats& stats = FindOrDie(ops_, op);
+    set<string> data_dirs = stats.data_dirs();
+    int64_t ram_anchored = stats.ram_anchored();
     op->running_++;
     running_ops_++;
+    ram_being_freed_ += ram_anchored;
+    for (const string& dir : data_dirs) {
+      running_ops_by_data_dir_[dir]++;
+    }
+    launched_this_poll_.insert(op);
     guard.unlock();
     bool ready = op->Prepare();
     guard.lock();
@@ -227,21 +273,43 @@ void MaintenanceManager::RunSchedulerThread() {
       LOG(INFO) << "Prepare failed for " << op->name()
                 << ".  Re-running scheduler.";
       op->running_--;
+      running_ops_--;
+      ram_being_freed_ -= ram_anchored;
+      for (const string& dir : data_dirs) {
+        if (--running_ops_by_data_dir_[dir] == 0) {
+          running_ops_by_data_dir_.erase(dir);
+        }
+      }
       op->cond_->Signal();
       continue;
     }
 
+    OpTypeStats& type_stats = op_type_stats_[OpType(op->name())];
+    type_stats.launched++;
+    if (op->queued_since_.Initialized()) {
+      int64_t queue_time_us = MonoTime::Now().GetDeltaSince(op->queued_since_).ToMicroseconds();
+      type_stats.total_queue_time_us += queue_time_us;
+      type_stats.max_queue_time_us = std::max(queue_time_us, type_stats.max_queue_time_us);
+      op->queued_since_ = MonoTime();
+    }
+
     // Run the maintenance operation.
     Status s = thread_pool_->SubmitFunc(boost::bind(
-          &MaintenanceManager::LaunchOp, this, op));
+          &MaintenanceManager::LaunchOp, this, op, data_dirs, ram_anchored));
     CHECK(s.ok());
+    launched = true;
   }
 }
 
 // Finding the best operation goes through four filters:
 // - If there's an Op that we can run quickly that frees log retention, we run it.
 // - If we've hit the overall process memory limit (note: this includes memory that the Ops cannot
-//   free), we run the Op with the highest RAM usage.
+//   free), we run the Op with the highest RAM usage. With --maintenance_manager_plan_memory_flushes,
+//   we instead subtract the memory anchored by the running Ops from the excess over the soft
+//   limit, and run the Op anchoring the least memory which still covers the rest, if any; if the
+//   running Ops cover all of it, we wait for them. Since flushing writes out about as much as it
+//   frees, this gets back under the limit with the least IO, while the parallel threads each
+//   take on the largest Op while no single one suffices.
 // - If there are Ops that are retaining logs past our target replay size, we run the one that has
 //   the highest retention (and if many qualify, then we run the one that also frees up the
 //   most RAM).
@@ -254,6 +322,10 @@ void MaintenanceManager::RunSchedulerThread() {
 //
 // In the third priority we're at a point where nothing's urgent and there's nothing we can run
 // quickly.
+//
+// Only ops which may be launched now are considered; see CanLaunchUnlocked(). The others, like
+// those which lose out to a better op, are queued: the time until they are launched is recorded
+// for each type of op.
 // TODO We currently optimize for freeing log retention but we could consider having some sort of
 // sliding priority between log retention and RAM usage. For example, is an Op that frees
 // 128MB of log retention and 12MB of RAM always better than an op that frees 12MB of log retention
@@ -261,11 +333,9 @@ void MaintenanceManager::RunSchedulerThread() {
 MaintenanceOp* MaintenanceManager::FindBestOp() {
   TRACE_EVENT0("maintenance", "MaintenanceManager::FindBestOp");
 
-  size_t free_threads = num_threads_ - running_ops_;
-  if (free_threads == 0) {
-    VLOG_AND_TRACE("maintenance", 1) << "there are no free threads, so we can't run anything.";
-    return nullptr;
-  }
+  double capacity_pct;
+  bool memory_pressure = parent_mem_tracker_->AnySoftLimitExceeded(&capacity_pct);
+  MonoTime now = MonoTime::Now();
 
   int64_t low_io_most_logs_retained_bytes = 0;
   MaintenanceOp* low_io_most_logs_retained_bytes_op = nullptr;
@@ -273,6 +343,15 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
   uint64_t most_mem_anchored = 0;
   MaintenanceOp* most_mem_anchored_op = nullptr;
 
+  // The memory to free beyond what the running ops are freeing, and the op
+  // anchoring the least memory which frees all of it.
+  int64_t mem_to_free = 0;
+  if (memory_pressure && FLAGS_maintenance_manager_plan_memory_flushes) {
+    mem_to_free = parent_mem_tracker_->SoftLimitExcess() - ram_being_freed_;
+  }
+  int64_t covering_mem_anchored = 0;
+  MaintenanceOp* covering_op = nullptr;
+
   int64_t most_logs_retained_bytes = 0;
   int64_t most_logs_retained_bytes_ram_anchored = 0;
   MaintenanceOp* most_logs_retained_bytes_op = nullptr;
@@ -286,18 +365,44 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
     stats.Clear();
     op->UpdateStats(&stats);
     if (op->cancelled() || !stats.valid() || !stats.runnable()) {
+      op->queued_since_ = MonoTime();
       continue;
     }
+
+    // Queue the op if any of the filters below would pick it.
+    bool wants_to_run =
+        (op->io_usage_ == MaintenanceOp::LOW_IO_USAGE && stats.logs_retained_bytes() > 0) ||
+        (memory_pressure && stats.ram_anchored() > 0) ||
+        stats.logs_retained_bytes() / 1024 / 1024 >= FLAGS_log_target_replay_size_mb ||
+        stats.perf_improvement() > 0;
+    if (!wants_to_run) {
+      op->queued_since_ = MonoTime();
+    } else if (!op->queued_since_.Initialized()) {
+      op->queued_since_ = now;
+    }
+
+    if (memory_pressure && CanLaunchUnlocked(op, stats, true)) {
+      if (stats.ram_anchored() > most_mem_anchored) {
+        most_mem_anchored_op = op;
+        most_mem_anchored = stats.ram_anchored();
+      }
+      int64_t ram_anchored = stats.ram_anchored();
+      if (mem_to_free > 0 && ram_anchored >= mem_to_free &&
+          (!covering_op || ram_anchored < covering_mem_anchored)) {
+        covering_op = op;
+        covering_mem_anchored = ram_anchored;
+      }
+    }
+    if (!CanLaunchUnlocked(op, stats, false)) {
+      continue;
+    }
+
     if (stats.logs_retained_bytes() > low_io_most_logs_retained_bytes &&
         op->io_usage_ == MaintenanceOp::LOW_IO_USAGE) {
       low_io_most_logs_retained_bytes_op = op;
       low_io_most_logs_retained_bytes = stats.logs_retained_bytes();
     }
 
-    if (stats.ram_anchored() > most_mem_anchored) {
-      most_mem_anchored_op = op;
-      most_mem_anchored = stats.ram_anchored();
-    }
     // We prioritize ops that can free more logs, but when it's the same we pick the one that
     // also frees up the most memory.
     if (stats.logs_retained_bytes() > 0 &&
@@ -315,6 +420,13 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
     }
   }
 
+  // The stats are updated even without a free thread, so that ops which want
+  // to run are queued from the start.
+  if (running_ops_ >= num_threads_) {
+    VLOG_AND_TRACE("maintenance", 1) << "there are no free threads, so we can't run anything.";
+    return nullptr;
+  }
+
   // Look at ops that we can run quickly that free up log retention.
   if (low_io_most_logs_retained_bytes_op) {
     if (low_io_most_logs_retained_bytes > 0) {
@@ -329,8 +441,22 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
 
   // Look at free memory. If it is dangerously low, we must select something
   // that frees memory-- the op with the most anchored memory.
-  double capacity_pct;
-  if (parent_mem_tracker_->AnySoftLimitExceeded(&capacity_pct)) {
+  if (memory_pressure) {
+    if (FLAGS_maintenance_manager_plan_memory_flushes) {
+      if (mem_to_free <= 0) {
+        VLOG_AND_TRACE("maintenance", 1) << "we have exceeded our soft memory limit, but "
+                << "the running ops are freeing " << ram_being_freed_ << " bytes, "
+                << "which is enough to get back under it.";
+        return nullptr;
+      }
+      if (covering_op) {
+        VLOG_AND_TRACE("maintenance", 1) << "we have exceeded our soft memory limit "
+                << "(current capacity is " << capacity_pct << "%).  Running the op "
+                << "which anchors the least memory that frees the remaining "
+                << mem_to_free << " bytes: " << covering_op->name();
+        return covering_op;
+      }
+    }
     if (!most_mem_anchored_op) {
       string msg = StringPrintf("we have exceeded our soft memory limit "
           "(current capacity is %.2f%%).  However, there are no ops currently "
@@ -364,7 +490,41 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
   return nullptr;
 }
 
-void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
+bool MaintenanceManager::CanLaunchUnlocked(const MaintenanceOp* op,
+                                           const MaintenanceOpStats& stats,
+                                           bool relieves_memory_pressure) const {
+  if (ContainsKey(launched_this_poll_, op)) {
+    return false;
+  }
+  int free_threads = num_threads_ - static_cast<int>(running_ops_);
+  if (free_threads <= 0) {
+    return false;
+  }
+  if (relieves_memory_pressure) {
+    return true;
+  }
+  int reserved_threads = std::min(FLAGS_maintenance_manager_reserved_threads, num_threads_ - 1);
+  if (free_threads <= reserved_threads) {
+    return false;
+  }
+  if (FLAGS_maintenance_manager_max_ops_per_data_dir > 0 &&
+      op->io_usage() == MaintenanceOp::HIGH_IO_USAGE) {
+    for (const string& dir : stats.data_dirs()) {
+      if (FindWithDefault(running_ops_by_data_dir_, dir, 0) >=
+          FLAGS_maintenance_manager_max_ops_per_data_dir) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+string MaintenanceManager::OpType(const string& name) {
+  return name.substr(0, name.find('('));
+}
+
+void MaintenanceManager::LaunchOp(MaintenanceOp* op, const set<string>& data_dirs,
+                                  int64_t ram_anchored) {
   MonoTime start_time(MonoTime::Now());
   op->RunningGauge()->Increment();
 
@@ -391,6 +551,12 @@ void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
   op->DurationHistogram()->Increment(delta.ToMilliseconds());
 
   running_ops_--;
+  ram_being_freed_ -= ram_anchored;
+  for (const string& dir : data_dirs) {
+    if (--running_ops_by_data_dir_[dir] == 0) {
+      running_ops_by_data_dir_.erase(dir);
+    }
+  }
   op->running_--;
   op->cond_->Signal();
 }
@@ -410,6 +576,9 @@ void MaintenanceManager::GetMaintenanceManagerStatusDump(MaintenanceManagerStatu
       op_pb->set_ram_anchored_bytes(stat.ram_anchored());
       op_pb->set_logs_retained_bytes(stat.logs_retained_bytes());
       op_pb->set_perf_improvement(stat.perf_improvement());
+      for (const string& dir : stat.data_dirs()) {
+        op_pb->add_data_dirs(dir);
+      }
     } else {
       op_pb->set_runnable(false);
       op_pb->set_ram_anchored_bytes(0);
@@ -422,6 +591,29 @@ void MaintenanceManager::GetMaintenanceManagerStatusDump(MaintenanceManagerStatu
     }
   }
 
+  std::map<string, pair<int, int>> running_and_queued_by_type;
+  for (const auto& val : ops_) {
+    auto& running_and_queued = running_and_queued_by_type[OpType(val.first->name())];
+    running_and_queued.first += val.first->running_;
+    running_and_queued.second += val.first->queued_since_.Initialized() ? 1 : 0;
+  }
+  for (const auto& entry : running_and_queued_by_type) {
+    MaintenanceManagerStatusPB_OpTypePB* type_pb = out_pb->add_op_types();
+    const OpTypeStats& type_stats = FindWithDefault(op_type_stats_, entry.first, OpTypeStats());
+    type_pb->set_type(entry.first);
+    type_pb->set_running(entry.second.first);
+    type_pb->set_queued(entry.second.second);
+    type_pb->set_launched(type_stats.launched);
+    type_pb->set_total_queue_time_millis(type_stats.total_queue_time_us / 1000);
+    type_pb->set_max_queue_time_millis(type_stats.max_queue_time_us / 1000);
+  }
+
+  for (const auto& entry : running_ops_by_data_dir_) {
+    MaintenanceManagerStatusPB_DataDirPB* dir_pb = out_pb->add_data_dirs();
+    dir_pb->set_path(entry.first);
+    dir_pb->set_running(entry.second);
+  }
+
   for (int n = 1; n <= completed_ops_.size(); n++) {
     int i = completed_ops_count_ - n;
     if (i < 0) break;
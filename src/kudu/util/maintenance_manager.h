@@ -23,6 +23,8 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
@@ -90,6 +92,16 @@ class MaintenanceOpStats {
     perf_improvement_ = perf_improvement;
   }
 
+  const std::set<std::string>& data_dirs() const {
+    DCHECK(valid_);
+    return data_dirs_;
+  }
+
+  void set_data_dirs(std::set<std::string> data_dirs) {
+    UpdateLastModified();
+    data_dirs_ = std::move(data_dirs);
+  }
+
   const MonoTime& last_modified() const {
     DCHECK(valid_);
     return last_modified_;
@@ -124,6 +136,11 @@ class MaintenanceOpStats {
   // absolute scale (yet TBD).
   double perf_improvement_;
 
+  // The data directories that this op will read from, if known. Ops which
+  // share a data directory may be kept from running concurrently; see
+  // --maintenance_manager_max_ops_per_data_dir.
+  std::set<std::string> data_dirs_;
+
   // The last time that the stats were modified.
   MonoTime last_modified_;
 };
@@ -216,6 +233,10 @@ class MaintenanceOp {
   std::shared_ptr<MaintenanceManager> manager_;
 
   IOUsage io_usage_;
+
+  // The time since which this op has been waiting to be launched, or
+  // uninitialized if it does not want to run.
+  MonoTime queued_since_;
 };
 
 struct MaintenanceOpComparator {
@@ -225,6 +246,20 @@ struct MaintenanceOpComparator {
   }
 };
 
+// Holds the scheduling statistics of all the ops of one type, e.g.
+// "CompactRowSetsOp".
+struct OpTypeStats {
+  OpTypeStats() : launched(0), total_queue_time_us(0), max_queue_time_us(0) {}
+
+  // The number of ops of this type launched so far.
+  int64_t launched;
+
+  // The total and maximum time between an op of this type wanting to run and
+  // being launched.
+  int64_t total_queue_time_us;
+  int64_t max_queue_time_us;
+};
+
 // Holds the information regarding a recently completed operation.
 struct CompletedOp {
   std::string name;
@@ -236,6 +271,12 @@ struct CompletedOp {
 // as flushes or compactions.  It runs these operations in the background, in a
 // thread pool.  It uses information provided in MaintenanceOpStats objects to
 // decide which operations, if any, to run.
+//
+// As many ops as there are free threads are launched on each poll. Ops which
+// report the data directories they read from are spread across them: no more
+// than --maintenance_manager_max_ops_per_data_dir ops touching any one
+// directory run at a time, and --maintenance_manager_reserved_threads threads
+// are kept free for ops which relieve memory pressure.
 class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManager> {
  public:
   struct Options {
@@ -265,6 +306,7 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
 
  private:
   FRIEND_TEST(MaintenanceManagerTest, TestLogRetentionPrioritization);
+  FRIEND_TEST(MaintenanceManagerTest, TestMemoryPressurePlanning);
   typedef std::map<MaintenanceOp*, MaintenanceOpStats,
           MaintenanceOpComparator> OpMapTy;
 
@@ -273,7 +315,19 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   // find the best op, or null if there is nothing we want to run
   MaintenanceOp* FindBestOp();
 
-  void LaunchOp(MaintenanceOp* op);
+  // Returns true if 'op', with stats 'stats', may be launched now. Ops which
+  // relieve memory pressure may use the reserved threads and ignore the
+  // per-data-dir limit.
+  bool CanLaunchUnlocked(const MaintenanceOp* op,
+                         const MaintenanceOpStats& stats,
+                         bool relieves_memory_pressure) const;
+
+  // 'ram_anchored' is the memory the op anchored when it was launched.
+  void LaunchOp(MaintenanceOp* op, const std::set<std::string>& data_dirs,
+                int64_t ram_anchored);
+
+  // Returns the type of the op named 'name': the part before any '('.
+  static std::string OpType(const std::string& name);
 
   const int32_t num_threads_;
   OpMapTy ops_; // registered operations
@@ -283,12 +337,22 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   ConditionVariable cond_;
   bool shutdown_;
   uint64_t running_ops_;
+  // The memory anchored by the running ops when they were launched.
+  int64_t ram_being_freed_;
   int32_t polling_interval_ms_;
   // Vector used as a circular buffer for recently completed ops. Elements need to be added at
   // the completed_ops_count_ % the vector's size and then the count needs to be incremented.
   std::vector<CompletedOp> completed_ops_;
   int64_t completed_ops_count_;
   std::shared_ptr<MemTracker> parent_mem_tracker_;
+  // The number of running ops which read from each data directory.
+  std::map<std::string, int> running_ops_by_data_dir_;
+  // Scheduling statistics, by op type.
+  std::map<std::string, OpTypeStats> op_type_stats_;
+  // The ops launched since the scheduler last waited for the polling
+  // interval. These aren't launched again until the next poll, so that an op
+  // gets a chance to update its stats to reflect the work it has taken on.
+  std::unordered_set<const MaintenanceOp*> launched_this_poll_;
 
   DISALLOW_COPY_AND_ASSIGN(MaintenanceManager);
 };
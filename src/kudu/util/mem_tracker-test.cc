@@ -30,6 +30,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int64(mem_tracker_local_consumption_bytes);
 DECLARE_int32(memory_limit_soft_percentage);
 
 namespace kudu {
@@ -127,6 +128,39 @@ class GcFunctionHelper {
   MemTracker* tracker_;
 };
 
+TEST(MemTrackerTest, LocalConsumption) {
+  FLAGS_mem_tracker_local_consumption_bytes = 1024;
+  shared_ptr<MemTracker> p = MemTracker::CreateTracker(-1, "p");
+  shared_ptr<MemTracker> c = MemTracker::CreateTracker(-1, "c", p);
+
+  // Small amounts stay local to the CPU.
+  c->Consume(100);
+  EXPECT_EQ(0, c->consumption());
+  EXPECT_EQ(0, p->consumption());
+
+  // Exceeding the local limit applies the delta of the CPU, which includes
+  // the earlier amount unless the thread moved to another CPU.
+  c->Consume(2000);
+  EXPECT_GE(c->consumption(), 2000);
+  EXPECT_GE(p->consumption(), 2000);
+
+  MemTracker::FlushLocalConsumption();
+  EXPECT_EQ(2100, c->consumption());
+  EXPECT_EQ(2100, p->consumption());
+
+  c->Release(2100);
+  MemTracker::FlushLocalConsumption();
+  EXPECT_EQ(0, c->consumption());
+  EXPECT_EQ(0, p->consumption());
+
+  // The deltas of a tracker are applied when it's destroyed.
+  c->Consume(10);
+  c->Release(10);
+  c.reset();
+  EXPECT_EQ(0, p->consumption());
+  FLAGS_mem_tracker_local_consumption_bytes = 0;
+}
+
 TEST(MemTrackerTest, GcFunctions) {
   shared_ptr<MemTracker> t = MemTracker::CreateTracker(10, "");
   ASSERT_TRUE(t->has_limit());
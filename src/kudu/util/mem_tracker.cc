@@ -32,6 +32,7 @@
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
@@ -59,6 +60,15 @@ DEFINE_int32(memory_limit_warn_threshold_percentage, 98,
              "consume before WARNING level messages are periodically logged.");
 TAG_FLAG(memory_limit_warn_threshold_percentage, advanced);
 
+DEFINE_int64(mem_tracker_local_consumption_bytes, 0,
+             "If positive, the memory consumed and released through a memory tracker is "
+             "accumulated per CPU, and only applied to the tracker and its ancestors once "
+             "it exceeds this many bytes. This reduces the contention between CPUs on the "
+             "shared trackers, at the cost of consumption and limit checks which lag by up "
+             "to this many bytes per CPU and tracker. Applies to trackers created after "
+             "the flag is set.");
+TAG_FLAG(mem_tracker_local_consumption_bytes, experimental);
+
 #ifdef TCMALLOC_ENABLED
 DEFINE_int32(tcmalloc_max_free_bytes_percentage, 10,
              "Maximum percentage of the RSS that tcmalloc is allowed to use for "
@@ -164,6 +174,8 @@ MemTracker::MemTracker(ConsumptionFunction consumption_func, int64_t byte_limit,
       parent_(std::move(parent)),
       consumption_(0),
       consumption_func_(std::move(consumption_func)),
+      local_consumption_limit_(FLAGS_mem_tracker_local_consumption_bytes),
+      num_local_deltas_(0),
       rand_(GetRandomSeed32()),
       enable_logging_(false),
       log_stack_(false) {
@@ -173,10 +185,18 @@ MemTracker::MemTracker(ConsumptionFunction consumption_func, int64_t byte_limit,
   }
   soft_limit_ = (limit_ == -1)
       ? -1 : (limit_ * FLAGS_memory_limit_soft_percentage) / 100;
+  if (local_consumption_limit_ > 0 && !consumption_func_) {
+    num_local_deltas_ = base::MaxCPUIndex() + 1;
+    local_deltas_.reset(new LocalDelta[num_local_deltas_]);
+    for (int i = 0; i < num_local_deltas_; i++) {
+      local_deltas_[i].bytes = 0;
+    }
+  }
 }
 
 MemTracker::~MemTracker() {
   VLOG(1) << "Destroying tracker " << ToString();
+  FlushLocalDeltas();
   if (parent_) {
     DCHECK(consumption() == 0) << "Memory tracker " << ToString()
         << " has unreleased consumption " << consumption();
@@ -306,14 +326,61 @@ void MemTracker::Consume(int64_t bytes) {
   if (PREDICT_FALSE(enable_logging_)) {
     LogUpdate(true, bytes);
   }
+  if (local_deltas_) {
+    ConsumeLocally(bytes);
+    return;
+  }
+  ConsumeInAncestors(bytes);
+}
+
+void MemTracker::ConsumeInAncestors(int64_t bytes) {
   for (auto& tracker : all_trackers_) {
     tracker->consumption_.IncrementBy(bytes);
+    // If a UDF calls FunctionContext::TrackAllocation() but allocates less than the
+    // reported amount, the subsequent call to FunctionContext::Free() may cause the
+    // process mem tracker to go negative until it is synced back to the tcmalloc
+    // metric. Don't blow up in this case. (Note that this doesn't affect non-process
+    // trackers since we can enforce that the reported memory usage is internally
+    // consistent.)
     if (!tracker->consumption_func_.empty()) {
       DCHECK_GE(tracker->consumption_.current_value(), 0);
     }
   }
 }
 
+void MemTracker::ConsumeLocally(int64_t bytes) {
+  std::atomic<int64_t>* delta =
+      &local_deltas_[base::CurrentCPUIndex() % num_local_deltas_].bytes;
+  int64_t new_delta = delta->fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  if (PREDICT_TRUE(new_delta <= local_consumption_limit_ &&
+                   new_delta >= -local_consumption_limit_)) {
+    return;
+  }
+  // Another thread may have applied the delta in the meantime, after being
+  // rescheduled to this CPU.
+  int64_t to_apply = delta->exchange(0, std::memory_order_relaxed);
+  if (to_apply != 0) {
+    ConsumeInAncestors(to_apply);
+  }
+}
+
+void MemTracker::FlushLocalDeltas() {
+  for (int i = 0; i < num_local_deltas_; i++) {
+    int64_t to_apply = local_deltas_[i].bytes.exchange(0, std::memory_order_relaxed);
+    if (to_apply != 0) {
+      ConsumeInAncestors(to_apply);
+    }
+  }
+}
+
+void MemTracker::FlushLocalConsumption() {
+  vector<shared_ptr<MemTracker>> trackers;
+  ListTrackers(&trackers);
+  for (const auto& tracker : trackers) {
+    tracker->FlushLocalDeltas();
+  }
+}
+
 bool MemTracker::TryConsume(int64_t bytes) {
   if (!consumption_func_.empty()) {
     UpdateConsumption();
@@ -390,19 +457,11 @@ void MemTracker::Release(int64_t bytes) {
   if (PREDICT_FALSE(enable_logging_)) {
     LogUpdate(false, bytes);
   }
-
-  for (auto& tracker : all_trackers_) {
-    tracker->consumption_.IncrementBy(-bytes);
-    // If a UDF calls FunctionContext::TrackAllocation() but allocates less than the
-    // reported amount, the subsequent call to FunctionContext::Free() may cause the
-    // process mem tracker to go negative until it is synced back to the tcmalloc
-    // metric. Don't blow up in this case. (Note that this doesn't affect non-process
-    // trackers since we can enforce that the reported memory usage is internally
-    // consistent.)
-    if (!tracker->consumption_func_.empty()) {
-      DCHECK_GE(tracker->consumption_.current_value(), 0);
-    }
+  if (local_deltas_) {
+    ConsumeLocally(-bytes);
+    return;
   }
+  ConsumeInAncestors(-bytes);
 }
 
 bool MemTracker::AnyLimitExceeded() {
@@ -472,6 +531,14 @@ int64_t MemTracker::SpareCapacity() const {
   return result;
 }
 
+int64_t MemTracker::SoftLimitExcess() const {
+  int64_t result = std::numeric_limits<int64_t>::min();
+  for (const auto& tracker : limit_trackers_) {
+    result = std::max(result, tracker->consumption() - tracker->soft_limit_);
+  }
+  return result;
+}
+
 bool MemTracker::GcMemory(int64_t max_consumption) {
   if (max_consumption < 0) {
     // Impossible to GC enough memory to reach the goal.
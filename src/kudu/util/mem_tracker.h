@@ -17,6 +17,7 @@
 #ifndef KUDU_UTIL_MEM_TRACKER_H
 #define KUDU_UTIL_MEM_TRACKER_H
 
+#include <atomic>
 #include <boost/function.hpp>
 #include <list>
 #include <memory>
@@ -24,6 +25,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/high_water_mark.h"
 #include "kudu/util/locks.h"
@@ -69,6 +71,13 @@ class MemTracker;
 // this will be called before the process limit is reported as exceeded. GcFunctions are
 // called in the order they are added, so expensive functions should be added last.
 //
+// If --mem_tracker_local_consumption_bytes is set, the Consume() and Release() calls on
+// a tracker accumulate in a per-CPU delta, which is only applied to the tracker and its
+// ancestors once it exceeds that many bytes. This keeps threads on different CPUs from
+// contending on the consumption of the shared ancestors. The consumption of a tracker then
+// lags by up to that many bytes per CPU for it and each of its descendants, and so do
+// the limit checks. FlushLocalConsumption() makes the consumption of all trackers exact.
+//
 // This class is thread-safe.
 //
 // NOTE: this class has been partially ported over from Impala with
@@ -133,6 +142,10 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   // Gets a shared_ptr to the "root" tracker, creating it if necessary.
   static std::shared_ptr<MemTracker> GetRootTracker();
 
+  // Applies the per-CPU deltas of all the trackers to their consumption, so that
+  // consumption() is exact for all of them, until the next Consume() or Release().
+  static void FlushLocalConsumption();
+
   // Updates consumption from the consumption function specified in the constructor.
   // NOTE: this method will crash if 'consumption_func_' is not set.
   void UpdateConsumption();
@@ -183,12 +196,18 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   // limits and a negative value if any limit is already exceeded.
   int64_t SpareCapacity() const;
 
+  // Returns the largest amount by which the consumption of this tracker or
+  // any of its parents exceeds its soft limit. Negative if all of them are
+  // below their soft limits, and int64_t::min() if there are no limits.
+  int64_t SoftLimitExcess() const;
+
 
   int64_t limit() const { return limit_; }
   bool has_limit() const { return limit_ >= 0; }
   const std::string& id() const { return id_; }
 
-  // Returns the memory consumed in bytes.
+  // Returns the memory consumed in bytes. May lag behind recent calls to Consume()
+  // and Release(): see FlushLocalConsumption().
   int64_t consumption() const {
     return consumption_.current_value();
   }
@@ -256,6 +275,18 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   // Adds tracker to child_trackers_.
   void AddChildTracker(const std::shared_ptr<MemTracker>& tracker);
 
+  // Increases the consumption of this tracker and its ancestors by 'bytes', which may
+  // be negative.
+  void ConsumeInAncestors(int64_t bytes);
+
+  // Adds 'bytes', which may be negative, to the delta of the current CPU, and applies
+  // the delta to the tracker and its ancestors if it's larger than the local
+  // consumption limit.
+  void ConsumeLocally(int64_t bytes);
+
+  // Applies the per-CPU deltas of this tracker to the tracker and its ancestors.
+  void FlushLocalDeltas();
+
   // Logs the stack of the current consume/release. Used for debugging only.
   void LogUpdate(bool is_consume, int64_t bytes) const;
 
@@ -290,6 +321,20 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
 
   ConsumptionFunction consumption_func_;
 
+  // A delta of consumption, on its own cache line.
+  struct LocalDelta {
+    std::atomic<int64_t> bytes;
+    char padding[CACHELINE_SIZE - sizeof(std::atomic<int64_t>)];
+  };
+
+  // The value of --mem_tracker_local_consumption_bytes when the tracker was created.
+  const int64_t local_consumption_limit_;
+
+  // The consumption not yet applied to the tracker and its ancestors, indexed by CPU.
+  // NULL unless 'local_consumption_limit_' is positive.
+  std::unique_ptr<LocalDelta[]> local_deltas_;
+  int num_local_deltas_;
+
   // this tracker plus all of its ancestors
   std::vector<MemTracker*> all_trackers_;
   // all_trackers_ with valid limits
@@ -27,6 +27,8 @@
 #include "kudu/util/memory/memory.h"
 #include "kudu/util/mem_tracker.h"
 
+DECLARE_int64(arena_component_cache_bytes);
+
 DEFINE_int32(num_threads, 16, "Number of threads to test");
 DEFINE_int32(allocs_per_thread, 10000, "Number of allocations each thread should do");
 DEFINE_int32(alloc_size, 4, "number of bytes in each allocation");
@@ -174,6 +176,36 @@ TEST(TestArena, TestMemoryTrackingEnforced) {
   ASSERT_EQ(256, mem_tracker->consumption());
 }
 
+TEST(TestArena, TestShardedMemoryTrackingArena) {
+  CHECK(FLAGS_num_threads < 256);
+  shared_ptr<MemTracker> mem_tracker = MemTracker::CreateTracker(-1, "arena-test-tracker");
+  shared_ptr<MemoryTrackingBufferAllocator> allocator(
+      new MemoryTrackingBufferAllocator(HeapBufferAllocator::Get(), mem_tracker));
+  {
+    ShardedMemoryTrackingArena arena(256, 1024, allocator, 4);
+    ASSERT_EQ(4, arena.num_slabs());
+    ASSERT_EQ(4 * 256, mem_tracker->consumption());
+
+    vector<thread> threads;
+    for (uint8_t i = 0; i < FLAGS_num_threads; i++) {
+      threads.emplace_back(AllocateThread<ShardedMemoryTrackingArena>, &arena, i);
+    }
+    for (thread& thr : threads) {
+      thr.join();
+    }
+
+    // All of the slabs are charged to the same tracker.
+    ASSERT_EQ(arena.memory_footprint(), mem_tracker->consumption());
+    ASSERT_GE(arena.memory_footprint(),
+              FLAGS_num_threads * FLAGS_allocs_per_thread * FLAGS_alloc_size);
+
+    arena.Reset();
+    ASSERT_EQ(arena.memory_footprint(), mem_tracker->consumption());
+  }
+  // Destroying the arena releases all of its slabs.
+  ASSERT_EQ(0, mem_tracker->consumption());
+}
+
 TEST(TestArena, TestSTLAllocator) {
   Arena a(256, 256 * 1024);
   typedef vector<int, ArenaAllocator<int, false> > ArenaVector;
@@ -187,4 +219,58 @@ TEST(TestArena, TestSTLAllocator) {
   }
 }
 
+TEST(TestArena, TestRetainUntilReset) {
+  Arena a(256, 256 * 1024);
+  shared_ptr<int> ref = std::make_shared<int>(1);
+  a.RetainUntilReset(ref);
+  a.RetainUntilReset(ref);
+  ASSERT_EQ(3, ref.use_count());
+
+  a.Reset();
+  ASSERT_EQ(1, ref.use_count());
+
+  // References are also released when the arena is destroyed.
+  {
+    Arena b(256, 256 * 1024);
+    b.RetainUntilReset(ref);
+    ASSERT_EQ(2, ref.use_count());
+  }
+  ASSERT_EQ(1, ref.use_count());
+}
+
+// Test that the components of arenas freed by a thread are reused by the
+// arenas it creates later, and charged to their MemTracker while cached.
+TEST(TestArena, TestComponentCache) {
+  google::FlagSaver saver;
+  FLAGS_arena_component_cache_bytes = 1024 * 1024;
+  shared_ptr<MemTracker> tracker =
+      MemTracker::FindOrCreateGlobalTracker(-1, "arena_component_cache");
+  CachingArenaBufferAllocator::TrimThreadCache();
+  ASSERT_EQ(0, tracker->consumption());
+
+  const int kComponentSize = 64 * 1024;
+  {
+    Arena a(kComponentSize, 1024 * 1024);
+    a.AllocateBytes(100);
+  }
+  ASSERT_EQ(kComponentSize, tracker->consumption());
+  {
+    Arena b(kComponentSize, 1024 * 1024);
+    ASSERT_EQ(0, tracker->consumption());
+  }
+  ASSERT_EQ(kComponentSize, tracker->consumption());
+
+  // Requests are rounded down to a power of two, so this arena reuses the
+  // cached component too, and its second component gets cached as well.
+  {
+    Arena c(kComponentSize + 1, 1024 * 1024);
+    ASSERT_EQ(0, tracker->consumption());
+    c.AllocateBytes(kComponentSize + 1);
+  }
+  ASSERT_EQ(3 * kComponentSize, tracker->consumption());
+
+  CachingArenaBufferAllocator::TrimThreadCache();
+  ASSERT_EQ(0, tracker->consumption());
+}
+
 } // namespace kudu
@@ -22,13 +22,19 @@
 #include <algorithm>
 #include <mutex>
 
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/memory/slab_allocator.h"
+#include "kudu/util/threadlocal.h"
 
 using std::copy;
 using std::max;
 using std::min;
 using std::reverse;
+using std::shared_ptr;
 using std::sort;
 using std::swap;
 using std::unique_ptr;
@@ -37,8 +43,152 @@ DEFINE_int64(arena_warn_threshold_bytes, 256*1024*1024,
              "Number of bytes beyond which to emit a warning for a large arena");
 TAG_FLAG(arena_warn_threshold_bytes, hidden);
 
+DEFINE_bool(arena_use_huge_page_slabs, false,
+            "Whether arenas created without an explicit allocator should allocate "
+            "their components from the huge page slab allocator instead of the heap.");
+TAG_FLAG(arena_use_huge_page_slabs, experimental);
+
+DEFINE_int64(arena_component_cache_bytes, 0,
+             "Maximum number of bytes of freed arena components which each thread "
+             "keeps to reuse for the arenas it creates later, such as those of scan "
+             "batches and writes. If 0, arena components are not cached. Only applies "
+             "to arenas created without an explicit allocator.");
+TAG_FLAG(arena_component_cache_bytes, experimental);
+TAG_FLAG(arena_component_cache_bytes, runtime);
+
 namespace kudu {
 
+BufferAllocator* DefaultArenaBufferAllocator() {
+  if (FLAGS_arena_use_huge_page_slabs) {
+    return HugePageSlabBufferAllocator::Get();
+  }
+  if (FLAGS_arena_component_cache_bytes > 0) {
+    return CachingArenaBufferAllocator::Get();
+  }
+  return HeapBufferAllocator::Get();
+}
+
+// The cached buffers of a thread, by size. The buffers are allocated by the
+// HeapBufferAllocator, which frees them with free().
+class CachingArenaBufferAllocator::ThreadCache {
+ public:
+  explicit ThreadCache(shared_ptr<MemTracker> tracker)
+      : tracker_(std::move(tracker)),
+        cached_bytes_(0) {
+  }
+
+  ~ThreadCache() {
+    Trim();
+  }
+
+  // Returns a cached buffer of 'size' bytes, or NULL if there is none.
+  void* Take(size_t size) {
+    vector<void*>* buffers = &buffers_[SizeIndex(size)];
+    if (buffers->empty()) {
+      return nullptr;
+    }
+    void* data = buffers->back();
+    buffers->pop_back();
+    cached_bytes_ -= size;
+    tracker_->Release(size);
+    return data;
+  }
+
+  // Caches the buffer 'data' of 'size' bytes. Returns false if the cache is
+  // full, in which case the caller must free the buffer.
+  bool Put(void* data, size_t size) {
+    vector<void*>* buffers = &buffers_[SizeIndex(size)];
+    if (cached_bytes_ + static_cast<int64_t>(size) > FLAGS_arena_component_cache_bytes ||
+        buffers->size() >= kMaxBuffersPerSize) {
+      return false;
+    }
+    buffers->push_back(data);
+    cached_bytes_ += size;
+    tracker_->Consume(size);
+    return true;
+  }
+
+  void Trim() {
+    for (vector<void*>& buffers : buffers_) {
+      for (void* data : buffers) {
+        free(data);
+      }
+      buffers.clear();
+    }
+    tracker_->Release(cached_bytes_);
+    cached_bytes_ = 0;
+  }
+
+ private:
+  static int SizeIndex(size_t size) {
+    DCHECK_EQ(size & (size - 1), 0);
+    return Bits::Log2Floor64(size) - Bits::Log2Floor64(kMinCachedSize);
+  }
+
+  // The number of cached buffers of a given size is bounded too, so that a
+  // burst of buffers of one size doesn't fill the cache for good.
+  static const size_t kMaxBuffersPerSize = 8;
+
+  static const int kNumSizes = 9;
+  static_assert(kMinCachedSize << (kNumSizes - 1) == kMaxCachedSize,
+                "one list of buffers per power of two");
+
+  const shared_ptr<MemTracker> tracker_;
+  vector<void*> buffers_[kNumSizes];
+  int64_t cached_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadCache);
+};
+
+const size_t CachingArenaBufferAllocator::kMinCachedSize;
+const size_t CachingArenaBufferAllocator::kMaxCachedSize;
+
+CachingArenaBufferAllocator::CachingArenaBufferAllocator()
+    : tracker_(MemTracker::FindOrCreateGlobalTracker(-1, "arena_component_cache")) {
+}
+
+CachingArenaBufferAllocator::ThreadCache* CachingArenaBufferAllocator::GetThreadCache() {
+  BLOCK_STATIC_THREAD_LOCAL(ThreadCache, cache, Get()->tracker_);
+  return cache;
+}
+
+void CachingArenaBufferAllocator::TrimThreadCache() {
+  GetThreadCache()->Trim();
+}
+
+Buffer* CachingArenaBufferAllocator::AllocateInternal(size_t requested,
+                                                      size_t minimal,
+                                                      BufferAllocator* originator) {
+  if (requested >= kMinCachedSize) {
+    size_t size = min<size_t>(1ULL << Bits::Log2Floor64(requested), kMaxCachedSize);
+    if (size >= minimal) {
+      void* data = GetThreadCache()->Take(size);
+      if (data != nullptr) {
+        return CreateBuffer(data, size, originator);
+      }
+      return DelegateAllocate(HeapBufferAllocator::Get(), size, size, originator);
+    }
+  }
+  return DelegateAllocate(HeapBufferAllocator::Get(), requested, minimal, originator);
+}
+
+bool CachingArenaBufferAllocator::ReallocateInternal(size_t requested,
+                                                     size_t minimal,
+                                                     Buffer* buffer,
+                                                     BufferAllocator* originator) {
+  return DelegateReallocate(HeapBufferAllocator::Get(), requested, minimal, buffer,
+                            originator);
+}
+
+void CachingArenaBufferAllocator::FreeInternal(Buffer* buffer) {
+  const size_t size = buffer->size();
+  if (size >= kMinCachedSize && size <= kMaxCachedSize && (size & (size - 1)) == 0 &&
+      GetThreadCache()->Put(buffer->data(), size)) {
+    return;
+  }
+  DelegateFree(HeapBufferAllocator::Get(), buffer);
+}
+
 template <bool THREADSAFE>
 const size_t ArenaBase<THREADSAFE>::kMinimumChunkSize = 16;
 
@@ -56,7 +206,7 @@ ArenaBase<THREADSAFE>::ArenaBase(
 
 template <bool THREADSAFE>
 ArenaBase<THREADSAFE>::ArenaBase(size_t initial_buffer_size, size_t max_buffer_size)
-    : buffer_allocator_(HeapBufferAllocator::Get()),
+    : buffer_allocator_(DefaultArenaBufferAllocator()),
       max_buffer_size_(max_buffer_size),
       arena_footprint_(0),
       warned_(false) {
@@ -150,6 +300,7 @@ void ArenaBase<THREADSAFE>::Reset() {
   arena_.back()->Reset();
   arena_footprint_ = arena_.back()->size();
   warned_ = false;
+  retained_.clear();
 
 #ifndef NDEBUG
   // In debug mode release the last component too for (hopefully) better
@@ -161,6 +312,12 @@ void ArenaBase<THREADSAFE>::Reset() {
 #endif
 }
 
+template <bool THREADSAFE>
+void ArenaBase<THREADSAFE>::RetainUntilReset(std::shared_ptr<const void> ref) {
+  std::lock_guard<mutex_type> lock(component_lock_);
+  retained_.emplace_back(std::move(ref));
+}
+
 template <bool THREADSAFE>
 size_t ArenaBase<THREADSAFE>::memory_footprint() const {
   std::lock_guard<mutex_type> lock(component_lock_);
@@ -171,5 +328,38 @@ size_t ArenaBase<THREADSAFE>::memory_footprint() const {
 template class ArenaBase<true>;
 template class ArenaBase<false>;
 
+ShardedMemoryTrackingArena::ShardedMemoryTrackingArena(
+    size_t initial_buffer_size,
+    size_t max_buffer_size,
+    const std::shared_ptr<MemoryTrackingBufferAllocator>& tracking_allocator,
+    int num_slabs) {
+  CHECK_GT(num_slabs, 0);
+  for (int i = 0; i < num_slabs; i++) {
+    slabs_.emplace_back(new ThreadSafeMemoryTrackingArena(
+        initial_buffer_size, max_buffer_size, tracking_allocator));
+  }
+}
+
+ThreadSafeMemoryTrackingArena* ShardedMemoryTrackingArena::slab() {
+  if (slabs_.size() == 1) {
+    return slabs_[0].get();
+  }
+  return slabs_[base::CurrentCPUIndex() % slabs_.size()].get();
+}
+
+void ShardedMemoryTrackingArena::Reset() {
+  for (const auto& slab : slabs_) {
+    slab->Reset();
+  }
+}
+
+size_t ShardedMemoryTrackingArena::memory_footprint() const {
+  size_t footprint = 0;
+  for (const auto& slab : slabs_) {
+    footprint += slab->memory_footprint();
+  }
+  return footprint;
+}
+
 
 }  // namespace kudu
@@ -132,6 +132,13 @@ class ArenaBase {
   // Similar to the above, but for StringPiece.
   bool RelocateStringPiece(const StringPiece& src, StringPiece* sp);
 
+  // Keeps 'ref' alive until the arena is next Reset() or destroyed.
+  //
+  // This allows Slices which would otherwise be relocated into the arena to
+  // instead point at memory owned by 'ref' (e.g. a pinned block cache entry),
+  // with the same lifetime as if they had been copied.
+  void RetainUntilReset(std::shared_ptr<const void> ref);
+
   // Reserves a blob of the specified size in the arena, and returns a pointer
   // to it. The caller can then fill the allocated memory. The pointer is
   // guaranteed to remain valid during the lifetime of the arena.
@@ -146,7 +153,8 @@ class ArenaBase {
   void* AllocateBytesAligned(const size_t size, const size_t alignment);
 
   // Removes all data from the arena. (Invalidates all pointers returned by
-  // AddSlice and AllocateBytes). Does not cause memory allocation.
+  // AddSlice and AllocateBytes, and releases all references passed to
+  // RetainUntilReset). Does not cause memory allocation.
   // May reduce memory footprint, as it discards all allocated buffers but
   // the last one.
   // Unless allocations exceed max_buffer_size, repetitive filling up and
@@ -205,6 +213,9 @@ class ArenaBase {
   // the global warning size threshold.
   bool warned_;
 
+  // References passed to RetainUntilReset().
+  vector<std::shared_ptr<const void>> retained_;
+
   // Lock covering 'slow path' allocation, when new components are
   // allocated and added to the arena's list. Also covers any other
   // mutation of the component data structure (eg Reset).
@@ -272,6 +283,70 @@ template<class T, bool THREADSAFE> class ArenaAllocator {
   ArenaBase<THREADSAFE>* arena_;
 };
 
+// Returns the allocator for arena components when the caller has no
+// particular allocator in mind: the heap, the huge page slab allocator if
+// --arena_use_huge_page_slabs is set, or the CachingArenaBufferAllocator
+// below if --arena_component_cache_bytes is positive.
+BufferAllocator* DefaultArenaBufferAllocator();
+
+class MemTracker;
+
+// A BufferAllocator for arena components which keeps the buffers freed by
+// each thread in a thread-local cache, and hands them out again for the
+// components of the arenas later created by the same thread, e.g. those of
+// the next scan batch or write. Short-lived arenas then don't allocate and
+// free their components from the heap over and over.
+//
+// Only buffers whose size is a power of two between kMinCachedSize and
+// kMaxCachedSize are cached, so allocations in that range are rounded down
+// to a power of two. Each thread caches up to --arena_component_cache_bytes
+// bytes, and the "arena_component_cache" MemTracker is charged with the
+// cached buffers.
+//
+// This class is thread-safe.
+class CachingArenaBufferAllocator : public BufferAllocator {
+ public:
+  virtual ~CachingArenaBufferAllocator() {}
+
+  // Returns a singleton instance of the allocator.
+  static CachingArenaBufferAllocator* Get() {
+    return Singleton<CachingArenaBufferAllocator>::get();
+  }
+
+  virtual size_t Available() const OVERRIDE {
+    return numeric_limits<size_t>::max();
+  }
+
+  // Frees the buffers cached by the calling thread.
+  static void TrimThreadCache();
+
+  static const size_t kMinCachedSize = 4 * 1024;
+  static const size_t kMaxCachedSize = 1024 * 1024;
+
+ private:
+  friend class Singleton<CachingArenaBufferAllocator>;
+  class ThreadCache;
+
+  CachingArenaBufferAllocator();
+
+  // Returns the cache of the calling thread, creating it if needed.
+  static ThreadCache* GetThreadCache();
+
+  virtual Buffer* AllocateInternal(size_t requested,
+                                   size_t minimal,
+                                   BufferAllocator* originator) OVERRIDE;
+
+  virtual bool ReallocateInternal(size_t requested,
+                                  size_t minimal,
+                                  Buffer* buffer,
+                                  BufferAllocator* originator) OVERRIDE;
+
+  virtual void FreeInternal(Buffer* buffer) OVERRIDE;
+
+  std::shared_ptr<MemTracker> tracker_;
+
+  DISALLOW_COPY_AND_ASSIGN(CachingArenaBufferAllocator);
+};
 
 class Arena : public ArenaBase<false> {
  public:
@@ -329,6 +404,58 @@ class ThreadSafeMemoryTrackingArena : public ArenaBase<true> {
   std::shared_ptr<MemoryTrackingBufferAllocator> tracking_allocator_;
 };
 
+// A thread-safe, memory-tracking arena made of several independent slabs,
+// each a ThreadSafeMemoryTrackingArena. Each allocation is served by the slab
+// of the CPU the caller is running on, so that threads on different CPUs
+// don't contend on the same bump pointer or component lock.
+//
+// All of the slabs charge the same MemoryTrackingBufferAllocator, and they
+// are reset or freed together, so the arena can be accounted for and
+// released as a whole. With one slab, this behaves like a single
+// ThreadSafeMemoryTrackingArena.
+//
+// Only the subset of the arena interface used by the in-memory stores is
+// provided.
+class ShardedMemoryTrackingArena {
+ public:
+  ShardedMemoryTrackingArena(
+      size_t initial_buffer_size,
+      size_t max_buffer_size,
+      const std::shared_ptr<MemoryTrackingBufferAllocator>& tracking_allocator,
+      int num_slabs);
+
+  void* AllocateBytes(const size_t size) {
+    return slab()->AllocateBytes(size);
+  }
+
+  void* AllocateBytesAligned(const size_t size, const size_t alignment) {
+    return slab()->AllocateBytesAligned(size, alignment);
+  }
+
+  uint8_t* AddSlice(const Slice& value) {
+    return slab()->AddSlice(value);
+  }
+
+  bool RelocateSlice(const Slice& src, Slice* dst) {
+    return slab()->RelocateSlice(src, dst);
+  }
+
+  // Resets all of the slabs.
+  void Reset();
+
+  // Returns the sum of the slabs' memory footprints.
+  size_t memory_footprint() const;
+
+  int num_slabs() const { return slabs_.size(); }
+
+ private:
+  ThreadSafeMemoryTrackingArena* slab();
+
+  std::vector<std::unique_ptr<ThreadSafeMemoryTrackingArena>> slabs_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedMemoryTrackingArena);
+};
+
 // Implementation of inline and template methods
 
 template<bool THREADSAFE>
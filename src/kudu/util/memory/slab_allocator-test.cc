@@ -0,0 +1,182 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/memory/slab_allocator.h"
+#include "kudu/util/random.h"
+#include "kudu/util/test_util.h"
+
+namespace kudu {
+
+using std::pair;
+using std::shared_ptr;
+using std::thread;
+using std::vector;
+
+class HugePageSlabAllocatorTest : public KuduTest {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    KuduTest::SetUp();
+    slab_ = HugePageSlabAllocator::Get();
+    overhead_tracker_ = MemTracker::FindOrCreateGlobalTracker(-1, "huge_page_slab_overhead");
+  }
+
+  HugePageSlabAllocator* slab_;
+  shared_ptr<MemTracker> overhead_tracker_;
+};
+
+TEST_F(HugePageSlabAllocatorTest, TestAllocationSizes) {
+  ASSERT_EQ(16, HugePageSlabAllocator::AllocationSize(0));
+  ASSERT_EQ(16, HugePageSlabAllocator::AllocationSize(1));
+  ASSERT_EQ(64, HugePageSlabAllocator::AllocationSize(64));
+  ASSERT_EQ(80, HugePageSlabAllocator::AllocationSize(65));
+  ASSERT_EQ(160, HugePageSlabAllocator::AllocationSize(129));
+  ASSERT_EQ(HugePageSlabAllocator::kMaxSizeClassSize,
+            HugePageSlabAllocator::AllocationSize(HugePageSlabAllocator::kMaxSizeClassSize));
+  ASSERT_EQ(HugePageSlabAllocator::kRegionSize,
+            HugePageSlabAllocator::AllocationSize(HugePageSlabAllocator::kMaxSizeClassSize + 1));
+
+  // Size classes never waste more than a fifth of an allocation above 64 bytes.
+  for (size_t size = 1; size <= HugePageSlabAllocator::kMaxSizeClassSize; size += 97) {
+    size_t alloc_size = HugePageSlabAllocator::AllocationSize(size);
+    ASSERT_GE(alloc_size, size);
+    ASSERT_EQ(0, alloc_size % 16);
+    if (size > 64) {
+      ASSERT_LE(alloc_size, size * 5 / 4 + 16) << size;
+    }
+  }
+}
+
+TEST_F(HugePageSlabAllocatorTest, TestAllocateAndFree) {
+  Random r(SeedRandom());
+  vector<pair<uint8_t*, size_t>> allocs;
+  for (int i = 0; i < 1000; i++) {
+    size_t size = r.Uniform(64 * 1024) + 1;
+    uint8_t* p = static_cast<uint8_t*>(slab_->Allocate(size));
+    ASSERT_TRUE(p != nullptr);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(p) % 16);
+    memset(p, i & 0xff, size);
+    allocs.emplace_back(p, size);
+  }
+  for (int i = 0; i < allocs.size(); i++) {
+    uint8_t* p = allocs[i].first;
+    size_t size = allocs[i].second;
+    ASSERT_EQ(i & 0xff, p[0]);
+    ASSERT_EQ(i & 0xff, p[size - 1]);
+    slab_->Free(p, size);
+  }
+}
+
+TEST_F(HugePageSlabAllocatorTest, TestFreedMemoryIsReused) {
+  void* p = slab_->Allocate(1000);
+  ASSERT_TRUE(p != nullptr);
+  slab_->Free(p, 1000);
+  // Sizes in the same size class share the free list.
+  void* q = slab_->Allocate(1010);
+  ASSERT_EQ(p, q);
+  slab_->Free(q, 1010);
+}
+
+TEST_F(HugePageSlabAllocatorTest, TestLargeAllocation) {
+  const size_t kSize = 3 * HugePageSlabAllocator::kRegionSize + 1;
+  int64_t before = overhead_tracker_->consumption();
+  uint8_t* p = static_cast<uint8_t*>(slab_->Allocate(kSize));
+  ASSERT_TRUE(p != nullptr);
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(p) % HugePageSlabAllocator::kRegionSize);
+  memset(p, 0xab, kSize);
+  ASSERT_EQ(before + HugePageSlabAllocator::AllocationSize(kSize) - kSize,
+            overhead_tracker_->consumption());
+  slab_->Free(p, kSize);
+  ASSERT_EQ(before, overhead_tracker_->consumption());
+}
+
+TEST_F(HugePageSlabAllocatorTest, TestOverheadTracking) {
+  // Make sure the size class has a free object, so that the following
+  // allocations don't need to map a new region.
+  slab_->Free(slab_->Allocate(500), 500);
+
+  int64_t before = overhead_tracker_->consumption();
+  void* p = slab_->Allocate(500);
+  ASSERT_EQ(before - 500, overhead_tracker_->consumption());
+  slab_->Free(p, 500);
+  ASSERT_EQ(before, overhead_tracker_->consumption());
+}
+
+TEST_F(HugePageSlabAllocatorTest, TestMultiThreaded) {
+  const int kNumThreads = 8;
+  vector<thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([this, t]() {
+      Random r(t);
+      vector<pair<uint8_t*, size_t>> allocs;
+      for (int i = 0; i < 10000; i++) {
+        if (!allocs.empty() && r.OneIn(2)) {
+          int idx = r.Uniform(allocs.size());
+          CHECK_EQ(t, *allocs[idx].first);
+          slab_->Free(allocs[idx].first, allocs[idx].second);
+          allocs[idx] = allocs.back();
+          allocs.pop_back();
+        } else {
+          size_t size = r.Uniform(4096) + 1;
+          uint8_t* p = static_cast<uint8_t*>(CHECK_NOTNULL(slab_->Allocate(size)));
+          memset(p, t, size);
+          allocs.emplace_back(p, size);
+        }
+      }
+      for (const auto& a : allocs) {
+        slab_->Free(a.first, a.second);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+TEST_F(HugePageSlabAllocatorTest, TestArenaWithSlabBuffers) {
+  shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(-1, "arena");
+  shared_ptr<MemoryTrackingBufferAllocator> allocator(
+      new MemoryTrackingBufferAllocator(HugePageSlabBufferAllocator::Get(), tracker));
+  MemoryTrackingArena arena(256, 64 * 1024, allocator);
+  vector<pair<uint8_t*, int>> allocs;
+  for (int i = 0; i < 10000; i++) {
+    int size = (i % 100) + 1;
+    uint8_t* p = static_cast<uint8_t*>(arena.AllocateBytes(size));
+    ASSERT_TRUE(p != nullptr);
+    memset(p, i & 0xff, size);
+    allocs.emplace_back(p, i);
+  }
+  for (const auto& a : allocs) {
+    ASSERT_EQ(a.second & 0xff, *a.first);
+  }
+  ASSERT_GT(tracker->consumption(), 0);
+  arena.Reset();
+}
+
+} // namespace kudu
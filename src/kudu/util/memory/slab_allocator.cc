@@ -0,0 +1,240 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/memory/slab_allocator.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/basictypes.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/util/alignment.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
+
+DEFINE_bool(huge_page_slab_use_hugetlb, false,
+            "Whether the huge page slab allocator should try to back its regions "
+            "with explicitly reserved huge pages (MAP_HUGETLB) before falling back "
+            "to transparent huge pages. Requires huge pages to be reserved through "
+            "/proc/sys/vm/nr_hugepages.");
+TAG_FLAG(huge_page_slab_use_hugetlb, experimental);
+
+using std::unique_ptr;
+
+namespace kudu {
+
+namespace {
+
+// Size classes are 16, 32, 48 and 64 bytes, followed by four classes per
+// power of two: for 64 < size <= 2^(n+1), the classes are 2^n plus one, two,
+// three or four quarters of 2^n. All of them are multiples of 16.
+const int kNumSmallClasses = 4;
+const int kFirstQuarteredLog = 6;
+
+int SizeClassIndexFor(size_t size) {
+  if (size <= 64) {
+    return (std::max<size_t>(size, 1) + 15) / 16 - 1;
+  }
+  int lg = Bits::Log2FloorNonZero64(size - 1);
+  size_t base = static_cast<size_t>(1) << lg;
+  size_t quarter = base >> 2;
+  int sub = (size - base + quarter - 1) / quarter;
+  return kNumSmallClasses - 1 + (lg - kFirstQuarteredLog) * 4 + sub;
+}
+
+size_t SizeClassSizeFor(int index) {
+  if (index < kNumSmallClasses) {
+    return (index + 1) * 16;
+  }
+  int rel = index - kNumSmallClasses;
+  int lg = kFirstQuarteredLog + rel / 4;
+  size_t base = static_cast<size_t>(1) << lg;
+  return base + (rel % 4 + 1) * (base >> 2);
+}
+
+} // anonymous namespace
+
+HugePageSlabAllocator::HugePageSlabAllocator()
+    : overhead_tracker_(MemTracker::FindOrCreateGlobalTracker(
+          -1, "huge_page_slab_overhead")) {
+  int num_classes = SizeClassIndex(kMaxSizeClassSize) + 1;
+  for (int i = 0; i < num_classes; i++) {
+    size_t size = SizeClassSizeFor(i);
+    DCHECK_EQ(i, SizeClassIndex(size));
+    size_classes_.emplace_back(new SizeClass(size));
+  }
+  DCHECK_EQ(kMaxSizeClassSize, size_classes_.back()->size);
+}
+
+int HugePageSlabAllocator::SizeClassIndex(size_t size) {
+  DCHECK_LE(size, kMaxSizeClassSize);
+  return SizeClassIndexFor(size);
+}
+
+size_t HugePageSlabAllocator::AllocationSize(size_t size) {
+  if (size > kMaxSizeClassSize) {
+    return KUDU_ALIGN_UP(size, kRegionSize);
+  }
+  return SizeClassSizeFor(SizeClassIndex(size));
+}
+
+void* HugePageSlabAllocator::Allocate(size_t size) {
+  if (size > kMaxSizeClassSize) {
+    size_t mapped = KUDU_ALIGN_UP(size, kRegionSize);
+    void* ret = MapHugePages(mapped);
+    if (ret != nullptr) {
+      overhead_tracker_->Consume(mapped - size);
+    }
+    return ret;
+  }
+
+  SizeClass* sc = size_classes_[SizeClassIndex(size)].get();
+  void* ret;
+  {
+    std::lock_guard<simple_spinlock> l(sc->lock);
+    if (sc->free_list != nullptr) {
+      ret = sc->free_list;
+      sc->free_list = *reinterpret_cast<void**>(ret);
+    } else {
+      if (sc->bump_end - sc->bump_ptr < static_cast<ptrdiff_t>(sc->size)) {
+        // The remainder of the old region, if any, is too small to hold an
+        // object and stays unused.
+        uint8_t* region = static_cast<uint8_t*>(MapHugePages(kRegionSize));
+        if (region == nullptr) {
+          return nullptr;
+        }
+        overhead_tracker_->Consume(kRegionSize);
+        sc->bump_ptr = region;
+        sc->bump_end = region + kRegionSize;
+      }
+      ret = sc->bump_ptr;
+      sc->bump_ptr += sc->size;
+    }
+  }
+  overhead_tracker_->Release(size);
+  return ret;
+}
+
+void HugePageSlabAllocator::Free(void* ptr, size_t size) {
+  DCHECK(ptr != nullptr);
+  if (size > kMaxSizeClassSize) {
+    size_t mapped = KUDU_ALIGN_UP(size, kRegionSize);
+    PCHECK(munmap(ptr, mapped) == 0);
+    overhead_tracker_->Release(mapped - size);
+    return;
+  }
+
+  SizeClass* sc = size_classes_[SizeClassIndex(size)].get();
+  {
+    std::lock_guard<simple_spinlock> l(sc->lock);
+    *reinterpret_cast<void**>(ptr) = sc->free_list;
+    sc->free_list = ptr;
+  }
+  overhead_tracker_->Consume(size);
+}
+
+void* HugePageSlabAllocator::MapHugePages(size_t size) {
+  DCHECK_EQ(0, size % kRegionSize);
+#ifdef MAP_HUGETLB
+  if (FLAGS_huge_page_slab_use_hugetlb) {
+    void* ret = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ret != MAP_FAILED) {
+      return ret;
+    }
+    int err = errno;
+    KLOG_FIRST_N(WARNING, 1) << "Unable to map explicit huge pages, falling back to "
+                             << "transparent huge pages: " << ErrnoToString(err);
+  }
+#endif
+
+  // Map an extra region's worth of memory so that a kRegionSize-aligned range
+  // can be cut out of it, which lets the kernel back it with huge pages.
+  size_t len = size + kRegionSize;
+  void* raw = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    return nullptr;
+  }
+  uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+  uintptr_t aligned = KUDU_ALIGN_UP(start, kRegionSize);
+  if (aligned > start) {
+    PCHECK(munmap(raw, aligned - start) == 0);
+  }
+  uintptr_t end = start + len;
+  if (end > aligned + size) {
+    PCHECK(munmap(reinterpret_cast<void*>(aligned + size), end - aligned - size) == 0);
+  }
+#ifdef MADV_HUGEPAGE
+  // Failure only means that transparent huge pages are disabled, in which
+  // case the region is backed by regular pages.
+  ignore_result(madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE));
+#endif
+  return reinterpret_cast<void*>(aligned);
+}
+
+Buffer* HugePageSlabBufferAllocator::AllocateInternal(
+    const size_t requested,
+    const size_t minimal,
+    BufferAllocator* const originator) {
+  DCHECK_LE(minimal, requested);
+  HugePageSlabAllocator* slab = HugePageSlabAllocator::Get();
+  size_t attempted = requested;
+  while (true) {
+    void* data = slab->Allocate(attempted);
+    if (data != nullptr) {
+      return CreateBuffer(data, attempted, originator);
+    }
+    if (attempted == minimal) return nullptr;
+    attempted = minimal + (attempted - minimal - 1) / 2;
+  }
+}
+
+bool HugePageSlabBufferAllocator::ReallocateInternal(
+    const size_t requested,
+    const size_t minimal,
+    Buffer* const buffer,
+    BufferAllocator* const originator) {
+  DCHECK_LE(minimal, requested);
+  HugePageSlabAllocator* slab = HugePageSlabAllocator::Get();
+  size_t attempted = requested;
+  while (true) {
+    void* data = slab->Allocate(attempted);
+    if (data != nullptr) {
+      memcpy(data, buffer->data(), std::min(buffer->size(), attempted));
+      slab->Free(buffer->data(), buffer->size());
+      UpdateBuffer(data, attempted, buffer);
+      return true;
+    }
+    if (attempted == minimal) return false;
+    attempted = minimal + (attempted - minimal - 1) / 2;
+  }
+}
+
+void HugePageSlabBufferAllocator::FreeInternal(Buffer* buffer) {
+  HugePageSlabAllocator::Get()->Free(buffer->data(), buffer->size());
+}
+
+} // namespace kudu
@@ -0,0 +1,155 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_MEMORY_SLAB_ALLOCATOR_H_
+#define KUDU_UTIL_MEMORY_SLAB_ALLOCATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/singleton.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/memory/memory.h"
+
+namespace kudu {
+
+class MemTracker;
+
+// A size-class slab allocator whose memory comes from 2MB regions backed by
+// huge pages, to reduce TLB misses and fragmentation for large pools of
+// long-lived allocations such as block cache entries and arena components.
+//
+// Allocations are rounded up to one of a set of size classes, four per
+// power of two, and each size class carves its objects out of its own
+// regions. Freed objects go back on their size class's free list; regions
+// are never returned to the operating system, so the allocator's footprint
+// stays at its high-water mark. Allocations larger than the biggest size
+// class get their own huge-page-aligned mapping, which is unmapped when the
+// allocation is freed.
+//
+// Regions are backed by explicit huge pages (MAP_HUGETLB) if
+// --huge_page_slab_use_hugetlb is set and the kernel has huge pages
+// reserved, and otherwise by transparent huge pages (MADV_HUGEPAGE).
+//
+// The "huge_page_slab_overhead" MemTracker is charged with the allocator's
+// overhead: the memory it has mapped, less the bytes currently handed out
+// to callers. The callers remain responsible for tracking the memory they
+// allocate.
+//
+// This class is thread-safe.
+class HugePageSlabAllocator {
+ public:
+  static HugePageSlabAllocator* Get() {
+    return Singleton<HugePageSlabAllocator>::get();
+  }
+
+  // Allocate 'size' bytes, aligned to 16 bytes. Returns NULL if no memory
+  // could be mapped.
+  void* Allocate(size_t size);
+
+  // Free 'ptr', which must have been returned by Allocate(size).
+  void Free(void* ptr, size_t size);
+
+  // The number of bytes actually reserved for an allocation of 'size' bytes.
+  static size_t AllocationSize(size_t size);
+
+  // The size of the regions which back the size classes.
+  static const size_t kRegionSize = 2 * 1024 * 1024;
+
+  // The largest allocation which is served from a size class.
+  static const size_t kMaxSizeClassSize = 1024 * 1024;
+
+ private:
+  friend class Singleton<HugePageSlabAllocator>;
+
+  HugePageSlabAllocator();
+
+  struct SizeClass {
+    explicit SizeClass(size_t size)
+        : size(size),
+          free_list(nullptr),
+          bump_ptr(nullptr),
+          bump_end(nullptr) {
+    }
+
+    const size_t size;
+
+    simple_spinlock lock;
+
+    // Singly-linked list of freed objects, linked through their first word.
+    void* free_list;
+
+    // The unused part of the size class's newest region.
+    uint8_t* bump_ptr;
+    uint8_t* bump_end;
+  };
+
+  // Return the index of the smallest size class which fits 'size' bytes.
+  // Requires size <= kMaxSizeClassSize.
+  static int SizeClassIndex(size_t size);
+
+  // Map 'size' bytes (a multiple of kRegionSize) of huge-page-backed memory,
+  // aligned to kRegionSize. Returns NULL on failure.
+  static void* MapHugePages(size_t size);
+
+  std::vector<std::unique_ptr<SizeClass>> size_classes_;
+
+  std::shared_ptr<MemTracker> overhead_tracker_;
+
+  DISALLOW_COPY_AND_ASSIGN(HugePageSlabAllocator);
+};
+
+// A BufferAllocator which allocates its buffers from the
+// HugePageSlabAllocator, for use by arenas.
+class HugePageSlabBufferAllocator : public BufferAllocator {
+ public:
+  virtual ~HugePageSlabBufferAllocator() {}
+
+  // Returns a singleton instance of the allocator.
+  static HugePageSlabBufferAllocator* Get() {
+    return Singleton<HugePageSlabBufferAllocator>::get();
+  }
+
+  virtual size_t Available() const OVERRIDE {
+    return numeric_limits<size_t>::max();
+  }
+
+ private:
+  friend class Singleton<HugePageSlabBufferAllocator>;
+
+  HugePageSlabBufferAllocator() {}
+
+  virtual Buffer* AllocateInternal(size_t requested,
+                                   size_t minimal,
+                                   BufferAllocator* originator) OVERRIDE;
+
+  virtual bool ReallocateInternal(size_t requested,
+                                  size_t minimal,
+                                  Buffer* buffer,
+                                  BufferAllocator* originator) OVERRIDE;
+
+  virtual void FreeInternal(Buffer* buffer) OVERRIDE;
+
+  DISALLOW_COPY_AND_ASSIGN(HugePageSlabBufferAllocator);
+};
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_MEMORY_SLAB_ALLOCATOR_H_
@@ -18,12 +18,14 @@
 #include <gtest/gtest.h>
 #include <rapidjson/document.h>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/util/hdr_histogram.h"
+#include "kudu/util/histogram.pb.h"
 #include "kudu/util/jsonreader.h"
 #include "kudu/util/jsonwriter.h"
 #include "kudu/util/metrics.h"
@@ -33,6 +35,7 @@ using std::string;
 using std::unordered_set;
 using std::vector;
 
+DECLARE_int32(metrics_histogram_stripes);
 DECLARE_int32(metrics_retirement_age_ms);
 
 namespace kudu {
@@ -165,6 +168,37 @@ TEST_F(MetricsTest, SimpleHistogramTest) {
   // TODO: Test coverage needs to be improved a lot.
 }
 
+// Test that the values recorded by different threads to a striped histogram
+// are all merged when it's read.
+TEST_F(MetricsTest, StripedHistogramTest) {
+  FLAGS_metrics_histogram_stripes = 4;
+  scoped_refptr<Histogram> hist = METRIC_test_hist.Instantiate(entity_);
+  FLAGS_metrics_histogram_stripes = 0;
+  ASSERT_EQ(4, hist->num_stripes_);
+
+  const int kNumThreads = 8;
+  vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&hist, i]() {
+        for (int j = 1; j <= 100; j++) {
+          hist->Increment(i * 100 + j);
+        }
+      });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0, hist->histogram_->TotalCount());
+  ASSERT_EQ(kNumThreads * 100, hist->TotalCount());
+  ASSERT_EQ(1, hist->MinValueForTests());
+  ASSERT_EQ(kNumThreads * 100, hist->MaxValueForTests());
+
+  HistogramSnapshotPB snapshot;
+  ASSERT_OK(hist->GetHistogramSnapshotPB(&snapshot, MetricJsonOptions()));
+  ASSERT_EQ(kNumThreads * 100, snapshot.total_count());
+  ASSERT_EQ(kNumThreads * 100 * (kNumThreads * 100 + 1) / 2, snapshot.total_sum());
+}
+
 TEST_F(MetricsTest, JsonPrintTest) {
   scoped_refptr<Counter> bytes_seen = METRIC_reqs_pending.Instantiate(entity_);
   bytes_seen->Increment();
@@ -201,6 +235,56 @@ TEST_F(MetricsTest, JsonPrintTest) {
   ASSERT_EQ("", out.str());
 }
 
+// Test selecting entities by type and attributes, and metrics by epoch.
+TEST_F(MetricsTest, FilterTest) {
+  scoped_refptr<Counter> counter = METRIC_reqs_pending.Instantiate(entity_);
+  entity_->SetAttribute("test_attr", "attr_val");
+  vector<scoped_refptr<Metric>> metrics;
+  MetricEntity::AttributeMap attrs;
+
+  MetricJsonOptions opts;
+  opts.entity_types = { "server" };
+  ASSERT_FALSE(entity_->CollectMetrics({ "*" }, opts, &metrics, &attrs));
+  opts.entity_types = { "server", "test_entity" };
+  ASSERT_TRUE(entity_->CollectMetrics({ "*" }, opts, &metrics, &attrs));
+
+  opts = MetricJsonOptions();
+  opts.entity_attrs = { { "test_attr", "other_val" } };
+  ASSERT_FALSE(entity_->CollectMetrics({ "*" }, opts, &metrics, &attrs));
+  opts.entity_attrs.emplace_back("test_attr", "attr_val");
+  metrics.clear();
+  ASSERT_TRUE(entity_->CollectMetrics({ "*" }, opts, &metrics, &attrs));
+  ASSERT_EQ(1, metrics.size());
+
+  // Only the metrics modified since the epoch are collected, and the entity
+  // is left out if there are none.
+  opts = MetricJsonOptions();
+  opts.only_modified_in_or_after_epoch = Metric::IncrementEpoch();
+  metrics.clear();
+  ASSERT_FALSE(entity_->CollectMetrics({ "*" }, opts, &metrics, &attrs));
+  counter->Increment();
+  ASSERT_TRUE(entity_->CollectMetrics({ "*" }, opts, &metrics, &attrs));
+  ASSERT_EQ(1, metrics.size());
+}
+
+TEST_F(MetricsTest, PrometheusPrintTest) {
+  scoped_refptr<Counter> counter = METRIC_reqs_pending.Instantiate(entity_);
+  counter->IncrementBy(3);
+  scoped_refptr<Histogram> hist = METRIC_test_hist.Instantiate(entity_);
+  hist->Increment(5);
+  entity_->SetAttribute("test_attr", "attr \"val\"");
+
+  std::ostringstream out;
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "*" }, MetricJsonOptions()));
+  const string labels = "entity_id=\"my-test\",test_attr=\"attr \\\"val\\\"\"";
+  ASSERT_STR_CONTAINS(out.str(), "# TYPE kudu_test_entity_reqs_pending counter\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_entity_reqs_pending{" + labels + "} 3\n");
+  ASSERT_STR_CONTAINS(out.str(), "# TYPE kudu_test_entity_test_hist summary\n");
+  ASSERT_STR_CONTAINS(out.str(),
+                      "kudu_test_entity_test_hist{" + labels + ",quantile=\"0.99\"} 5\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_entity_test_hist_count{" + labels + "} 1\n");
+}
+
 // Test that metrics are retired when they are no longer referenced.
 TEST_F(MetricsTest, RetirementTest) {
   FLAGS_metrics_retirement_age_ms = 100;
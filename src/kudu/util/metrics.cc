@@ -16,7 +16,9 @@
 // under the License.
 #include "kudu/util/metrics.h"
 
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <map>
 #include <set>
@@ -42,6 +44,14 @@ DEFINE_int32(metrics_retirement_age_ms, 120 * 1000,
 TAG_FLAG(metrics_retirement_age_ms, runtime);
 TAG_FLAG(metrics_retirement_age_ms, advanced);
 
+DEFINE_int32(metrics_histogram_stripes, 0,
+             "If positive, the values of each histogram metric are recorded to up to "
+             "this many separate histograms, one per group of threads, which are merged "
+             "when the metric is read. This avoids contention between the threads which "
+             "record to the same histogram, at the cost of more memory. Applies to "
+             "histograms created after the flag is set. Rounded down to a power of 2.");
+TAG_FLAG(metrics_histogram_stripes, experimental);
+
 // Process/server-wide metrics should go into the 'server' entity.
 // More complex applications will define other entities.
 METRIC_DEFINE_entity(server);
@@ -190,35 +200,78 @@ bool MatchMetricInList(const string& metric_name,
   return false;
 }
 
-} // anonymous namespace
+bool MatchEntityAttributes(const MetricEntity::AttributeMap& attrs,
+                           const vector<std::pair<string, string>>& match_attrs) {
+  if (match_attrs.empty()) return true;
+  for (const auto& match_attr : match_attrs) {
+    const string* value = FindOrNull(attrs, match_attr.first);
+    if (value != nullptr && *value == match_attr.second) {
+      return true;
+    }
+  }
+  return false;
+}
 
+} // anonymous namespace
 
-Status MetricEntity::WriteAsJson(JsonWriter* writer,
-                                 const vector<string>& requested_metrics,
-                                 const MetricJsonOptions& opts) const {
+bool MetricEntity::CollectMetrics(const vector<string>& requested_metrics,
+                                  const MetricJsonOptions& opts,
+                                  vector<scoped_refptr<Metric>>* metrics,
+                                  AttributeMap* attrs) const {
+  if (!opts.entity_types.empty() &&
+      std::find(opts.entity_types.begin(), opts.entity_types.end(), type()) ==
+          opts.entity_types.end()) {
+    return false;
+  }
   bool select_all = MatchMetricInList(id(), requested_metrics);
 
-  // We want the keys to be in alphabetical order when printing, so we use an ordered map here.
-  typedef std::map<const char*, scoped_refptr<Metric> > OrderedMetricMap;
-  OrderedMetricMap metrics;
-  AttributeMap attrs;
   {
     // Snapshot the metrics in this registry (not guaranteed to be a consistent snapshot)
     std::lock_guard<simple_spinlock> l(lock_);
-    attrs = attributes_;
+    if (!MatchEntityAttributes(attributes_, opts.entity_attrs)) {
+      return false;
+    }
+    *attrs = attributes_;
+    metrics->reserve(metric_map_.size());
     for (const MetricMap::value_type& val : metric_map_) {
-      const MetricPrototype* prototype = val.first;
-      const scoped_refptr<Metric>& metric = val.second;
-
-      if (select_all || MatchMetricInList(prototype->name(), requested_metrics)) {
-        InsertOrDie(&metrics, prototype->name(), metric);
-      }
+      metrics->push_back(val.second);
     }
   }
 
+  // Filter and sort the metrics outside of the lock, which is taken to
+  // create metrics in this entity.
+  const int64_t epoch = opts.only_modified_in_or_after_epoch;
+  metrics->erase(std::remove_if(metrics->begin(), metrics->end(),
+                                [&](const scoped_refptr<Metric>& m) {
+                                  return !(select_all ||
+                                           MatchMetricInList(m->prototype()->name(),
+                                                             requested_metrics)) ||
+                                         !m->ModifiedInOrAfterEpoch(epoch);
+                                }),
+                 metrics->end());
+
   // If we had a filter, and we didn't either match this entity or any metrics inside
-  // it, don't print the entity at all.
-  if (!requested_metrics.empty() && !select_all && metrics.empty()) {
+  // it, don't print the entity at all. Likewise if none of its metrics were
+  // modified since the requested epoch.
+  if (metrics->empty() &&
+      ((!requested_metrics.empty() && !select_all) || epoch > 0)) {
+    return false;
+  }
+
+  // We want the keys to be in alphabetical order when printing.
+  std::sort(metrics->begin(), metrics->end(),
+            [](const scoped_refptr<Metric>& a, const scoped_refptr<Metric>& b) {
+              return strcmp(a->prototype()->name(), b->prototype()->name()) < 0;
+            });
+  return true;
+}
+
+Status MetricEntity::WriteAsJson(JsonWriter* writer,
+                                 const vector<string>& requested_metrics,
+                                 const MetricJsonOptions& opts) const {
+  vector<scoped_refptr<Metric>> metrics;
+  AttributeMap attrs;
+  if (!CollectMetrics(requested_metrics, opts, &metrics, &attrs)) {
     return Status::OK();
   }
 
@@ -240,10 +293,9 @@ Status MetricEntity::WriteAsJson(JsonWriter* writer,
 
   writer->String("metrics");
   writer->StartArray();
-  for (OrderedMetricMap::value_type& val : metrics) {
-    WARN_NOT_OK(val.second->WriteAsJson(writer, opts),
-                strings::Substitute("Failed to write $0 as JSON", val.first));
-
+  for (const scoped_refptr<Metric>& metric : metrics) {
+    WARN_NOT_OK(metric->WriteAsJson(writer, opts),
+                strings::Substitute("Failed to write $0 as JSON", metric->prototype()->name()));
   }
   writer->EndArray();
 
@@ -348,6 +400,93 @@ Status MetricRegistry::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+namespace {
+
+// Escapes 'str' for a Prometheus label value or, if 'is_help', for a HELP
+// line, where quotes aren't escaped.
+string EscapeForPrometheus(const string& str, bool is_help) {
+  string escaped;
+  escaped.reserve(str.size());
+  for (char c : str) {
+    switch (c) {
+      case '\\': escaped += "\\\\"; break;
+      case '\n': escaped += "\\n"; break;
+      case '"': escaped += is_help ? "\"" : "\\\""; break;
+      default: escaped += c; break;
+    }
+  }
+  return escaped;
+}
+
+const char* PrometheusType(MetricType::Type type) {
+  switch (type) {
+    case MetricType::kGauge: return "gauge";
+    case MetricType::kCounter: return "counter";
+    case MetricType::kHistogram: return "summary";
+  }
+  LOG(FATAL) << "Unknown metric type " << type;
+  return nullptr;
+}
+
+} // anonymous namespace
+
+Status MetricRegistry::WriteAsPrometheus(std::ostream* out,
+                                         const vector<string>& requested_metrics,
+                                         const MetricJsonOptions& opts) const {
+  EntityMap entities;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    entities = entities_;
+  }
+
+  // The samples of a metric family must be contiguous, so the metrics of all
+  // the entities are gathered and ordered by family.
+  struct Sample {
+    string family;
+    string labels;
+    scoped_refptr<Metric> metric;
+  };
+  vector<Sample> samples;
+  for (const EntityMap::value_type& e : entities) {
+    const MetricEntity* entity = e.second.get();
+    vector<scoped_refptr<Metric>> metrics;
+    MetricEntity::AttributeMap attrs;
+    if (!entity->CollectMetrics(requested_metrics, opts, &metrics, &attrs)) {
+      continue;
+    }
+    // Order the attributes, so that the labels are the same in each export.
+    std::map<string, string> ordered_attrs(attrs.begin(), attrs.end());
+    string labels = Substitute("entity_id=\"$0\"", EscapeForPrometheus(entity->id(), false));
+    for (const auto& attr : ordered_attrs) {
+      labels += Substitute(",$0=\"$1\"", attr.first, EscapeForPrometheus(attr.second, false));
+    }
+    for (scoped_refptr<Metric>& metric : metrics) {
+      samples.push_back({ Substitute("kudu_$0_$1", entity->type(), metric->prototype()->name()),
+                          labels, std::move(metric) });
+    }
+  }
+  std::stable_sort(samples.begin(), samples.end(),
+                   [](const Sample& a, const Sample& b) { return a.family < b.family; });
+
+  const string* last_family = nullptr;
+  for (const Sample& sample : samples) {
+    if (last_family == nullptr || *last_family != sample.family) {
+      const MetricPrototype* prototype = sample.metric->prototype();
+      *out << "# HELP " << sample.family << " "
+           << EscapeForPrometheus(prototype->description(), true) << "\n";
+      *out << "# TYPE " << sample.family << " " << PrometheusType(prototype->type()) << "\n";
+      last_family = &sample.family;
+    }
+    sample.metric->WriteAsPrometheus(sample.family, sample.labels, out);
+  }
+
+  // See WriteAsJson().
+  samples.clear();
+  entities.clear();
+  const_cast<MetricRegistry*>(this)->RetireOldMetrics();
+  return Status::OK();
+}
+
 void MetricRegistry::RetireOldMetrics() {
   std::lock_guard<simple_spinlock> l(lock_);
   for (auto it = entities_.begin(); it != entities_.end();) {
@@ -480,8 +619,11 @@ scoped_refptr<MetricEntity> MetricRegistry::FindOrCreateEntity(
 //
 // Metric
 //
+std::atomic<int64_t> Metric::g_epoch_(1);
+
 Metric::Metric(const MetricPrototype* prototype)
-  : prototype_(prototype) {
+  : prototype_(prototype),
+    m_epoch_(current_epoch()) {
 }
 
 Metric::~Metric() {
@@ -504,6 +646,14 @@ Status Gauge::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Gauge::WriteAsPrometheus(const string& name, const string& labels,
+                              std::ostream* out) const {
+  std::ostringstream value;
+  if (WritePrometheusValue(&value)) {
+    *out << name << "{" << labels << "} " << value.str() << "\n";
+  }
+}
+
 //
 // StringGauge
 //
@@ -520,6 +670,7 @@ std::string StringGauge::value() const {
 void StringGauge::set_value(const std::string& value) {
   std::lock_guard<simple_spinlock> l(lock_);
   value_ = value;
+  UpdateModificationEpoch();
 }
 
 void StringGauge::WriteValue(JsonWriter* writer) const {
@@ -548,6 +699,7 @@ void Counter::Increment() {
 
 void Counter::IncrementBy(int64_t amount) {
   value_.IncrementBy(amount);
+  UpdateModificationEpoch();
 }
 
 Status Counter::WriteAsJson(JsonWriter* writer,
@@ -563,6 +715,11 @@ Status Counter::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Counter::WriteAsPrometheus(const string& name, const string& labels,
+                                std::ostream* out) const {
+  *out << name << "{" << labels << "} " << value() << "\n";
+}
+
 /////////////////////////////////////////////////
 // HistogramPrototype
 /////////////////////////////////////////////////
@@ -590,17 +747,86 @@ scoped_refptr<Histogram> HistogramPrototype::Instantiate(
 // Histogram
 /////////////////////////////////////////////////
 
+namespace {
+
+// Returns the stripe of the calling thread among 'num_stripes', a power of 2.
+// Threads are assigned stripes round-robin on first use.
+int CurrentThreadStripe(int num_stripes) {
+  static std::atomic<int> next_thread_stripe(0);
+  static __thread int thread_stripe = -1;
+  if (PREDICT_FALSE(thread_stripe < 0)) {
+    thread_stripe = next_thread_stripe++ & std::numeric_limits<int>::max();
+  }
+  return thread_stripe & (num_stripes - 1);
+}
+
+int RoundDownToPowerOf2(int n) {
+  if (n <= 0) {
+    return 0;
+  }
+  int p = 1;
+  while (p <= n / 2) {
+    p *= 2;
+  }
+  return p;
+}
+
+} // anonymous namespace
+
 Histogram::Histogram(const HistogramPrototype* proto)
   : Metric(proto),
-    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())) {
+    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())),
+    num_stripes_(RoundDownToPowerOf2(FLAGS_metrics_histogram_stripes)) {
+  if (num_stripes_ > 0) {
+    stripes_.reset(new std::atomic<HdrHistogram*>[num_stripes_]);
+    for (int i = 0; i < num_stripes_; i++) {
+      stripes_[i] = nullptr;
+    }
+  }
+}
+
+Histogram::~Histogram() {
+  for (int i = 0; i < num_stripes_; i++) {
+    delete stripes_[i].load();
+  }
+}
+
+HdrHistogram* Histogram::HistogramForCurrentThread() {
+  if (num_stripes_ == 0) {
+    return histogram_.get();
+  }
+  std::atomic<HdrHistogram*>* stripe = &stripes_[CurrentThreadStripe(num_stripes_)];
+  HdrHistogram* h = stripe->load(std::memory_order_acquire);
+  if (PREDICT_FALSE(h == nullptr)) {
+    gscoped_ptr<HdrHistogram> new_h(new HdrHistogram(histogram_->highest_trackable_value(),
+                                                     histogram_->num_significant_digits()));
+    if (stripe->compare_exchange_strong(h, new_h.get(), std::memory_order_acq_rel)) {
+      h = new_h.release();
+    }
+    // Otherwise, 'h' is the stripe which another thread created first.
+  }
+  return h;
+}
+
+gscoped_ptr<HdrHistogram> Histogram::MergedSnapshot() const {
+  gscoped_ptr<HdrHistogram> snapshot(new HdrHistogram(*histogram_));
+  for (int i = 0; i < num_stripes_; i++) {
+    const HdrHistogram* h = stripes_[i].load(std::memory_order_acquire);
+    if (h) {
+      snapshot->MergeFrom(*h);
+    }
+  }
+  return snapshot.Pass();
 }
 
 void Histogram::Increment(int64_t value) {
-  histogram_->Increment(value);
+  HistogramForCurrentThread()->Increment(value);
+  UpdateModificationEpoch();
 }
 
 void Histogram::IncrementBy(int64_t value, int64_t amount) {
-  histogram_->IncrementBy(value, amount);
+  HistogramForCurrentThread()->IncrementBy(value, amount);
+  UpdateModificationEpoch();
 }
 
 Status Histogram::WriteAsJson(JsonWriter* writer,
@@ -612,9 +838,21 @@ Status Histogram::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Histogram::WriteAsPrometheus(const string& name, const string& labels,
+                                  std::ostream* out) const {
+  gscoped_ptr<HdrHistogram> snapshot = MergedSnapshot();
+  for (double quantile : { 0.75, 0.95, 0.99, 0.999, 0.9999 }) {
+    *out << name << "{" << labels << ",quantile=\"" << quantile << "\"} "
+         << snapshot->ValueAtPercentile(quantile * 100) << "\n";
+  }
+  *out << name << "_sum{" << labels << "} " << snapshot->TotalSum() << "\n";
+  *out << name << "_count{" << labels << "} " << snapshot->TotalCount() << "\n";
+}
+
 Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
                                          const MetricJsonOptions& opts) const {
-  HdrHistogram snapshot(*histogram_);
+  gscoped_ptr<HdrHistogram> merged = MergedSnapshot();
+  const HdrHistogram& snapshot = *merged;
   snapshot_pb->set_name(prototype_->name());
   if (opts.include_schema_info) {
     snapshot_pb->set_type(MetricType::Name(prototype_->type()));
@@ -648,22 +886,29 @@ Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
 }
 
 uint64_t Histogram::CountInBucketForValueForTests(uint64_t value) const {
-  return histogram_->CountInBucketForValue(value);
+  return MergedSnapshot()->CountInBucketForValue(value);
 }
 
 uint64_t Histogram::TotalCount() const {
-  return histogram_->TotalCount();
+  uint64_t count = histogram_->TotalCount();
+  for (int i = 0; i < num_stripes_; i++) {
+    const HdrHistogram* h = stripes_[i].load(std::memory_order_acquire);
+    if (h) {
+      count += h->TotalCount();
+    }
+  }
+  return count;
 }
 
 uint64_t Histogram::MinValueForTests() const {
-  return histogram_->MinValue();
+  return MergedSnapshot()->MinValue();
 }
 
 uint64_t Histogram::MaxValueForTests() const {
-  return histogram_->MaxValue();
+  return MergedSnapshot()->MaxValue();
 }
 double Histogram::MeanValueForTests() const {
-  return histogram_->MeanValue();
+  return MergedSnapshot()->MeanValue();
 }
 
 ScopedLatencyMetric::ScopedLatencyMetric(Histogram* latency_hist)
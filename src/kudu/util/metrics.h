@@ -224,9 +224,12 @@
 /////////////////////////////////////////////////////
 
 #include <algorithm>
+#include <atomic>
 #include <mutex>
+#include <ostream>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
@@ -394,10 +397,13 @@ class MetricType {
   static const char* const kHistogramType;
 };
 
+// Options for the export of metrics, as JSON or in the Prometheus text
+// format.
 struct MetricJsonOptions {
   MetricJsonOptions() :
     include_raw_histograms(false),
-    include_schema_info(false) {
+    include_schema_info(false),
+    only_modified_in_or_after_epoch(0) {
   }
 
   // Include the raw histogram values and counts in the JSON output.
@@ -410,6 +416,22 @@ struct MetricJsonOptions {
   // unit, etc).
   // Default: false
   bool include_schema_info;
+
+  // If not empty, only the entities of these types (e.g. "tablet") are
+  // exported.
+  // Default: empty
+  std::vector<std::string> entity_types;
+
+  // If not empty, only the entities with at least one of these attributes,
+  // as (key, value) pairs, are exported.
+  // Default: empty
+  std::vector<std::pair<std::string, std::string>> entity_attrs;
+
+  // Only the metrics modified in or after this epoch are exported, and the
+  // entities with none are left out. Function gauges are always exported.
+  // See Metric::IncrementEpoch().
+  // Default: 0, i.e. all metrics
+  int64_t only_modified_in_or_after_epoch;
 };
 
 class MetricEntityPrototype {
@@ -466,6 +488,16 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // Collects the metrics of this entity selected by 'requested_metrics' and
+  // 'opts', ordered by name, and its attributes. Returns false if the entity
+  // shouldn't be exported at all.
+  bool CollectMetrics(const std::vector<std::string>& requested_metrics,
+                      const MetricJsonOptions& opts,
+                      std::vector<scoped_refptr<Metric>>* metrics,
+                      AttributeMap* attrs) const;
+
+  const char* type() const { return prototype_->name(); }
+
   const MetricMap& UnsafeMetricsMapForTests() const { return metric_map_; }
 
   // Mark that the given metric should never be retired until the metric
@@ -528,12 +560,46 @@ class Metric : public RefCountedThreadSafe<Metric> {
   virtual Status WriteAsJson(JsonWriter* writer,
                              const MetricJsonOptions& opts) const = 0;
 
+  // Writes the samples of this metric in the Prometheus text format, as part
+  // of the metric family 'name', each with the labels 'labels'. The family's
+  // HELP and TYPE lines are written by the caller.
+  virtual void WriteAsPrometheus(const std::string& name, const std::string& labels,
+                                 std::ostream* out) const = 0;
+
   const MetricPrototype* prototype() const { return prototype_; }
 
+  // Returns whether the metric was modified in or after 'epoch'.
+  virtual bool ModifiedInOrAfterEpoch(int64_t epoch) const {
+    return m_epoch_.load(std::memory_order_relaxed) >= epoch;
+  }
+
+  // The metrics epoch is advanced by each export of the metrics, so that the
+  // next export may leave out the metrics which weren't modified since. The
+  // first epoch is 1.
+  static int64_t current_epoch() {
+    return g_epoch_.load(std::memory_order_relaxed);
+  }
+
+  // Advances the metrics epoch, returning the new epoch. The metrics which
+  // are modified from then on are exported by an export of the metrics
+  // modified in or after it.
+  static int64_t IncrementEpoch() {
+    return g_epoch_.fetch_add(1) + 1;
+  }
+
  protected:
   explicit Metric(const MetricPrototype* prototype);
   virtual ~Metric();
 
+  // Records that the metric was modified in the current epoch. The epoch
+  // only changes once per export, so this rarely writes.
+  void UpdateModificationEpoch() {
+    const int64_t epoch = g_epoch_.load(std::memory_order_relaxed);
+    if (PREDICT_FALSE(m_epoch_.load(std::memory_order_relaxed) < epoch)) {
+      m_epoch_.store(epoch, std::memory_order_relaxed);
+    }
+  }
+
   const MetricPrototype* const prototype_;
 
  private:
@@ -545,6 +611,11 @@ class Metric : public RefCountedThreadSafe<Metric> {
   // uninitialized.
   MonoTime retire_time_;
 
+  // The last epoch in which the metric was modified.
+  std::atomic<int64_t> m_epoch_;
+
+  static std::atomic<int64_t> g_epoch_;
+
   DISALLOW_COPY_AND_ASSIGN(Metric);
 };
 
@@ -574,6 +645,17 @@ class MetricRegistry {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // Writes metrics in this registry to 'out' in the Prometheus text format.
+  // The metrics are selected as by WriteAsJson(), and the options for
+  // histograms and schema information don't apply.
+  //
+  // Each metric family is named "kudu_<entity type>_<metric name>", and
+  // labeled with the entity's ID and attributes. Histograms are exported as
+  // summaries.
+  Status WriteAsPrometheus(std::ostream* out,
+                           const std::vector<std::string>& requested_metrics,
+                           const MetricJsonOptions& opts) const;
+
   // For each registered entity, retires orphaned metrics. If an entity has no more
   // metrics and there are no external references, entities are removed as well.
   //
@@ -733,8 +815,13 @@ class Gauge : public Metric {
   virtual ~Gauge() {}
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(const std::string& name, const std::string& labels,
+                                 std::ostream* out) const OVERRIDE;
  protected:
   virtual void WriteValue(JsonWriter* writer) const = 0;
+  // Writes the value as a Prometheus sample value. Returns false if the value
+  // isn't numeric, and so the gauge isn't exported.
+  virtual bool WritePrometheusValue(std::ostream* out) const = 0;
  private:
   DISALLOW_COPY_AND_ASSIGN(Gauge);
 };
@@ -748,6 +835,9 @@ class StringGauge : public Gauge {
   void set_value(const std::string& value);
  protected:
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE;
+  virtual bool WritePrometheusValue(std::ostream* out) const OVERRIDE {
+    return false;
+  }
  private:
   std::string value_;
   mutable simple_spinlock lock_;  // Guards value_
@@ -767,12 +857,14 @@ class AtomicGauge : public Gauge {
   }
   virtual void set_value(const T& value) {
     value_.Store(static_cast<int64_t>(value), kMemOrderNoBarrier);
+    UpdateModificationEpoch();
   }
   void Increment() {
-    value_.IncrementBy(1, kMemOrderNoBarrier);
+    IncrementBy(1);
   }
   virtual void IncrementBy(int64_t amount) {
     value_.IncrementBy(amount, kMemOrderNoBarrier);
+    UpdateModificationEpoch();
   }
   void Decrement() {
     IncrementBy(-1);
@@ -785,6 +877,10 @@ class AtomicGauge : public Gauge {
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE {
     writer->Value(value());
   }
+  virtual bool WritePrometheusValue(std::ostream* out) const OVERRIDE {
+    *out << value();
+    return true;
+  }
   AtomicInt<int64_t> value_;
  private:
   DISALLOW_COPY_AND_ASSIGN(AtomicGauge);
@@ -860,6 +956,11 @@ class FunctionGauge : public Gauge {
     writer->Value(value());
   }
 
+  // The value is only known when it is read, so it is always exported.
+  virtual bool ModifiedInOrAfterEpoch(int64_t epoch) const OVERRIDE {
+    return true;
+  }
+
   // Reset this FunctionGauge to return a specific value.
   // This should be used during destruction. If you want a settable
   // Gauge, use a normal Gauge instead of a FunctionGauge.
@@ -906,6 +1007,11 @@ class FunctionGauge : public Gauge {
     return v;
   }
 
+  virtual bool WritePrometheusValue(std::ostream* out) const OVERRIDE {
+    *out << value();
+    return true;
+  }
+
   mutable simple_spinlock lock_;
   Callback<T()> function_;
   DISALLOW_COPY_AND_ASSIGN(FunctionGauge);
@@ -938,6 +1044,8 @@ class Counter : public Metric {
   void IncrementBy(int64_t amount);
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(const std::string& name, const std::string& labels,
+                                 std::ostream* out) const OVERRIDE;
 
  private:
   FRIEND_TEST(MetricsTest, SimpleCounterTest);
@@ -982,6 +1090,8 @@ class Histogram : public Metric {
 
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(const std::string& name, const std::string& labels,
+                                 std::ostream* out) const OVERRIDE;
 
   // Returns a snapshot of this histogram including the bucketed values and counts.
   Status GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot,
@@ -992,12 +1102,30 @@ class Histogram : public Metric {
   uint64_t MaxValueForTests() const;
   double MeanValueForTests() const;
 
+ protected:
+  virtual ~Histogram();
+
  private:
   FRIEND_TEST(MetricsTest, SimpleHistogramTest);
+  FRIEND_TEST(MetricsTest, StripedHistogramTest);
   friend class MetricEntity;
   explicit Histogram(const HistogramPrototype* proto);
 
+  // Returns the histogram which the current thread records values to.
+  HdrHistogram* HistogramForCurrentThread();
+
+  // Returns a snapshot of the values recorded by all threads.
+  gscoped_ptr<HdrHistogram> MergedSnapshot() const;
+
   const gscoped_ptr<HdrHistogram> histogram_;
+
+  // If --metrics_histogram_stripes is set, each thread records values to one
+  // of these histograms instead of 'histogram_', so that threads don't contend
+  // on the same counts. Each stripe is created when it's first recorded to,
+  // and is merged with the others when the histogram is read.
+  const int num_stripes_;
+  gscoped_array<std::atomic<HdrHistogram*>> stripes_;
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
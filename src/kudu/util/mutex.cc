@@ -27,6 +27,7 @@
 #include "kudu/util/debug-util.h"
 #include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/spinlock_profiling.h"
 #include "kudu/util/trace.h"
 
 using std::string;
@@ -95,6 +96,7 @@ void Mutex::Acquire() {
   // If we weren't able to acquire the mutex immediately, then it's
   // worth gathering timing information about the mutex acquisition.
   MicrosecondsInt64 start_time = GetMonoTimeMicros();
+  int64_t start_cycles = CycleClock::Now();
   int rv = pthread_mutex_lock(&native_handle_);
   DCHECK_EQ(0, rv) << ". " << strerror(rv)
 #ifndef NDEBUG
@@ -107,6 +109,7 @@ void Mutex::Acquire() {
   if (wait_time > 0) {
     TRACE_COUNTER_INCREMENT("mutex_wait_us", wait_time);
   }
+  SubmitBlockingProfileData(this, CycleClock::Now() - start_cycles);
 
 #ifndef NDEBUG
   CheckUnheldAndMark();
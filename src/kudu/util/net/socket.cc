@@ -254,6 +254,21 @@ Status Socket::SetReuseAddr(bool flag) {
   return Status::OK();
 }
 
+Status Socket::SetReusePort(bool flag) {
+#if defined(SO_REUSEPORT)
+  int err;
+  int int_flag = flag ? 1 : 0;
+  if (setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &int_flag, sizeof(int_flag)) == -1) {
+    err = errno;
+    return Status::NetworkError(std::string("failed to set SO_REUSEPORT: ") +
+                                ErrnoToString(err), Slice(), err);
+  }
+  return Status::OK();
+#else
+  return Status::NotSupported("SO_REUSEPORT is not supported on this platform");
+#endif
+}
+
 Status Socket::BindAndListen(const Sockaddr &sockaddr,
                              int listenQueueSize) {
   RETURN_NOT_OK(SetReuseAddr(true));
@@ -296,6 +311,16 @@ Status Socket::GetPeerAddress(Sockaddr *cur_addr) const {
   return Status::OK();
 }
 
+bool Socket::IsLoopbackConnection() const {
+  Sockaddr local;
+  Sockaddr peer;
+  if (!GetSocketAddress(&local).ok() || !GetPeerAddress(&peer).ok()) {
+    return false;
+  }
+  return peer.IsAnyLocalAddress() ||
+      local.addr().sin_addr.s_addr == peer.addr().sin_addr.s_addr;
+}
+
 Status Socket::Bind(const Sockaddr& bind_addr) {
   struct sockaddr_in addr = bind_addr.addr();
 
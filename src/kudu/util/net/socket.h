@@ -83,6 +83,11 @@ class Socket {
   // Sets SO_REUSEADDR to 'flag'. Should be used prior to Bind().
   Status SetReuseAddr(bool flag);
 
+  // Sets SO_REUSEPORT to 'flag', which lets several sockets bind to the
+  // same address, with the kernel spreading the incoming connections across
+  // them. Should be set before calling Bind().
+  Status SetReusePort(bool flag);
+
   // Convenience method to invoke the common sequence:
   // 1) SetReuseAddr(true)
   // 2) Bind()
@@ -99,6 +104,11 @@ class Socket {
   // Call getpeername to get the address of the connected peer.
   Status GetPeerAddress(Sockaddr *cur_addr) const;
 
+  // Returns true if the socket is connected to a peer on the same host,
+  // either over a 127.*.*.* address or with the same local and peer address.
+  // Returns false if the addresses can't be determined.
+  bool IsLoopbackConnection() const;
+
   // Call bind() to bind the socket to a given address.
   // If bind() fails and indicates that the requested port is already in use,
   // generates an informative log message by calling 'lsof' if available.
@@ -25,6 +25,9 @@
 #include "kudu/util/os-util.h"
 
 #include <fcntl.h>
+#if defined(__linux__)
+#include <sched.h>
+#endif
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -138,5 +141,21 @@ void DisableCoreDumps() {
   }
 }
 
+Status PinCurrentThreadToCpu(int cpu) {
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    int err = errno;
+    return Status::RuntimeError(strings::Substitute("could not pin thread to CPU $0", cpu),
+                                ErrnoToString(err), err);
+  }
+  return Status::OK();
+#else
+  return Status::NotSupported("pinning threads to CPUs is not supported on this platform");
+#endif
+}
+
 
 } // namespace kudu
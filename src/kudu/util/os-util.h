@@ -60,6 +60,10 @@ Status GetThreadStats(int64_t tid, ThreadStats* stats);
 // want to generate a core dump from an "expected" crash.
 void DisableCoreDumps();
 
+// Restricts the calling thread to run on the CPU numbered 'cpu'.
+// Only supported on Linux.
+Status PinCurrentThreadToCpu(int cpu);
+
 } // namespace kudu
 
 #endif /* KUDU_UTIL_OS_UTIL_H */
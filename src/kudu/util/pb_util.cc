@@ -80,7 +80,6 @@ using google::protobuf::MessageLite;
 using google::protobuf::Reflection;
 using google::protobuf::SimpleDescriptorDatabase;
 using google::protobuf::TextFormat;
-using kudu::crc::Crc;
 using kudu::pb_util::internal::SequentialFileFileInputStream;
 using kudu::pb_util::internal::WritableFileOutputStream;
 using std::deque;
@@ -246,10 +245,9 @@ Status ValidateAndReadData(ReadableFileType* reader, uint64_t file_size,
 Status ParseAndCompareChecksum(const uint8_t* checksum_buf,
                                const initializer_list<Slice>& slices) {
   uint32_t written_checksum = DecodeFixed32(checksum_buf);
-  uint64_t actual_checksum = 0;
-  Crc* crc32c = crc::GetCrc32cInstance();
+  uint32_t actual_checksum = 0;
   for (Slice s : slices) {
-    crc32c->Compute(s.data(), s.size(), &actual_checksum);
+    actual_checksum = crc::Crc32cExtend(actual_checksum, s.data(), s.size());
   }
   if (PREDICT_FALSE(actual_checksum != written_checksum)) {
     return Status::Corruption(Substitute("Checksum does not match. Expected: $0. Actual: $1",
@@ -478,7 +476,7 @@ Status WritePBToPath(Env* env, const std::string& path,
     return Status::IOError("Unable to serialize PB to file");
   }
 
-  if (sync == pb_util::SYNC) {
+  if (sync != pb_util::NO_SYNC) {
     RETURN_NOT_OK_PREPEND(file->Sync(), "Failed to Sync() " + tmp_path);
   }
   RETURN_NOT_OK_PREPEND(file->Close(), "Failed to Close() " + tmp_path);
@@ -943,7 +941,7 @@ Status WritePBContainerToPath(Env* env, const std::string& path,
   WritablePBContainerFile pb_file(std::move(file));
   RETURN_NOT_OK(pb_file.Init(msg));
   RETURN_NOT_OK(pb_file.Append(msg));
-  if (sync == pb_util::SYNC) {
+  if (sync != pb_util::NO_SYNC) {
     RETURN_NOT_OK(pb_file.Sync());
   }
   RETURN_NOT_OK(pb_file.Close());
@@ -54,7 +54,10 @@ using google::protobuf::MessageLite;
 
 enum SyncMode {
   SYNC,
-  NO_SYNC
+  NO_SYNC,
+  // Syncs the file but not its parent directory. The caller is responsible
+  // for syncing the directory to make the file's creation durable.
+  SYNC_FILE
 };
 
 enum CreateMode {
@@ -448,6 +451,7 @@ Status ReadPBContainerFromPath(Env* env, const std::string& path,
 //
 // If create == NO_OVERWRITE and 'path' already exists, the function will fail.
 // If sync == SYNC, the newly created file will be fsynced before returning.
+// If sync == SYNC_FILE, the file is fsynced, but not its parent directory.
 Status WritePBContainerToPath(Env* env, const std::string& path,
                               const google::protobuf::Message& msg,
                               CreateMode create,
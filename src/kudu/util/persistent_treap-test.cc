@@ -0,0 +1,121 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <vector>
+
+#include "kudu/util/persistent_treap.h"
+#include "kudu/util/test_util.h"
+
+using std::set;
+using std::vector;
+
+namespace kudu {
+
+class TestPersistentTreap : public KuduTest {
+};
+
+namespace {
+
+// Traits for a treap of ints, augmented with the sum of each subtree.
+struct IntSumTraits {
+  typedef int value_type;
+  typedef int64_t augment_type;
+
+  static int compare(int a, int b) {
+    return a < b ? -1 : (a > b ? 1 : 0);
+  }
+
+  static int64_t augment(int v, const int64_t* left, const int64_t* right) {
+    return v + (left ? *left : 0) + (right ? *right : 0);
+  }
+};
+
+typedef PersistentTreap<IntSumTraits> IntTreap;
+
+vector<int> Contents(const IntTreap& treap) {
+  vector<int> ret;
+  treap.ForEach([&](int v) { ret.push_back(v); });
+  return ret;
+}
+
+} // anonymous namespace
+
+// Test that random insertions and erasures keep each version of the treap
+// equal to a std::set given the same operations.
+TEST_F(TestPersistentTreap, TestRandomOperations) {
+  SeedRandom();
+  vector<IntTreap> versions(1);
+  vector<set<int>> expected(1);
+  for (int i = 0; i < 2000; i++) {
+    IntTreap treap = versions.back();
+    set<int> s = expected.back();
+    int v = rand() % 500;
+    bool found;
+    if (s.count(v)) {
+      treap = treap.Erase(v, &found);
+      ASSERT_TRUE(found);
+      s.erase(v);
+    } else {
+      treap = treap.Erase(v, &found);
+      ASSERT_FALSE(found);
+      treap = treap.Insert(v);
+      s.insert(v);
+    }
+    versions.push_back(treap);
+    expected.push_back(s);
+  }
+
+  // Every version, old or new, still holds its own elements.
+  for (int i = 0; i < versions.size(); i++) {
+    const IntTreap& treap = versions[i];
+    const set<int>& s = expected[i];
+    ASSERT_EQ(s.size(), treap.size());
+    ASSERT_EQ(vector<int>(s.begin(), s.end()), Contents(treap));
+    int64_t sum = 0;
+    for (int v : s) {
+      sum += v;
+      ASSERT_NE(nullptr, treap.Find(v));
+    }
+    ASSERT_EQ(sum, treap.empty() ? 0 : treap.root()->augment);
+    ASSERT_EQ(nullptr, treap.Find(500));
+  }
+}
+
+// Test that the treap stays balanced when built from sorted insertions.
+TEST_F(TestPersistentTreap, TestBalancedOnSortedInput) {
+  const int kNumElements = 100000;
+  IntTreap treap;
+  for (int i = 0; i < kNumElements; i++) {
+    treap = treap.Insert(i);
+  }
+  ASSERT_EQ(kNumElements, treap.size());
+
+  std::function<int(const IntTreap::Node*)> depth = [&](const IntTreap::Node* node) {
+    return node == nullptr ? 0 : 1 + std::max(depth(node->left.get()),
+                                              depth(node->right.get()));
+  };
+  // The expected depth is about 3 lg n; a degenerate tree would be n deep.
+  ASSERT_LT(depth(treap.root()), 100);
+}
+
+} // namespace kudu
@@ -0,0 +1,201 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Implements a persistent treap. See https://en.wikipedia.org/wiki/Treap and
+// https://en.wikipedia.org/wiki/Persistent_data_structure.
+#ifndef KUDU_UTIL_PERSISTENT_TREAP_H
+#define KUDU_UTIL_PERSISTENT_TREAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace kudu {
+
+// The augment_type for treaps which don't need to summarize their subtrees.
+struct NoTreapAugment {};
+
+// A persistent (that is, immutable) treap: a randomized balanced binary search
+// tree. Inserting or erasing an element returns a new treap in O(lg n)
+// expected time, which shares all but O(lg n) of its nodes with the original.
+// Both remain valid for as long as they are referenced.
+//
+// Since nodes are never modified once built, a treap may be read from any
+// number of threads concurrently, and copying a treap is O(1).
+//
+// Each node carries an augment summarizing its subtree, e.g. the highest
+// endpoint of the intervals in it, which lets searches prune subtrees.
+//
+// The Traits class should have the following members:
+//   Traits::value_type
+//     a typedef for the (copyable) elements.
+//
+//   Traits::augment_type
+//     a typedef for the summary of a subtree, e.g. NoTreapAugment.
+//
+//   static int compare(const value_type &a, const value_type &b)
+//     return < 0 if a < b, 0 if a == b, > 0 if a > b
+//
+//   static augment_type augment(const value_type &v,
+//                               const augment_type *left,
+//                               const augment_type *right)
+//     return the summary of a subtree with 'v' at its root, given the
+//     summaries of its children, which are null for empty children.
+template<class Traits>
+class PersistentTreap {
+ public:
+  typedef typename Traits::value_type value_type;
+  typedef typename Traits::augment_type augment_type;
+
+  struct Node;
+  typedef std::shared_ptr<const Node> NodePtr;
+
+  struct Node {
+    Node(value_type value, uint64_t priority, NodePtr left, NodePtr right)
+        : value(std::move(value)),
+          priority(priority),
+          left(std::move(left)),
+          right(std::move(right)),
+          size(1 + Size(this->left) + Size(this->right)),
+          augment(Traits::augment(this->value,
+                                  this->left ? &this->left->augment : nullptr,
+                                  this->right ? &this->right->augment : nullptr)) {
+    }
+
+    const value_type value;
+    const uint64_t priority;
+    const NodePtr left;
+    const NodePtr right;
+    const size_t size;
+    const augment_type augment;
+  };
+
+  PersistentTreap() {}
+
+  // Return a treap which also holds 'value'. An element equal to 'value'
+  // must not already be present.
+  PersistentTreap Insert(value_type value) const {
+    NodePtr left, right;
+    Split(root_, value, false, &left, &right);
+    NodePtr node = std::make_shared<Node>(std::move(value), NextPriority(), nullptr, nullptr);
+    return PersistentTreap(Merge(Merge(left, node), right));
+  }
+
+  // Return a treap without the element equal to 'value'. Sets 'found' to
+  // whether there was such an element; if not, the returned treap is
+  // equivalent to this one.
+  PersistentTreap Erase(const value_type& value, bool* found) const {
+    NodePtr left, rest, equal, right;
+    Split(root_, value, false, &left, &rest);
+    Split(rest, value, true, &equal, &right);
+    *found = equal != nullptr;
+    if (!*found) {
+      return *this;
+    }
+    return PersistentTreap(Merge(Merge(left, Merge(equal->left, equal->right)), right));
+  }
+
+  // Return the element equal to 'probe', or null if there is none.
+  const value_type* Find(const value_type& probe) const {
+    const Node* node = root_.get();
+    while (node != nullptr) {
+      int cmp = Traits::compare(probe, node->value);
+      if (cmp == 0) {
+        return &node->value;
+      }
+      node = cmp < 0 ? node->left.get() : node->right.get();
+    }
+    return nullptr;
+  }
+
+  // Invoke 'f' on each element, in increasing order.
+  template<class F>
+  void ForEach(const F& f) const {
+    ForEach(root_.get(), f);
+  }
+
+  size_t size() const { return Size(root_); }
+
+  bool empty() const { return root_ == nullptr; }
+
+  // The root of the treap, for searches which use the augments. Null if the
+  // treap is empty.
+  const Node* root() const { return root_.get(); }
+
+ private:
+  explicit PersistentTreap(NodePtr root) : root_(std::move(root)) {}
+
+  static size_t Size(const NodePtr& node) {
+    return node ? node->size : 0;
+  }
+
+  // Split 't' into the elements less than 'value' (or, if 'or_equal', less
+  // than or equal to it) and the rest, copying the nodes along the path.
+  static void Split(const NodePtr& t, const value_type& value, bool or_equal,
+                    NodePtr* left, NodePtr* right) {
+    if (!t) {
+      left->reset();
+      right->reset();
+      return;
+    }
+    int cmp = Traits::compare(t->value, value);
+    if (cmp < 0 || (or_equal && cmp == 0)) {
+      NodePtr split_left;
+      Split(t->right, value, or_equal, &split_left, right);
+      *left = std::make_shared<Node>(t->value, t->priority, t->left, std::move(split_left));
+    } else {
+      NodePtr split_right;
+      Split(t->left, value, or_equal, left, &split_right);
+      *right = std::make_shared<Node>(t->value, t->priority, std::move(split_right), t->right);
+    }
+  }
+
+  // Merge 'a' and 'b', all of whose elements must be less than those of 'b'.
+  static NodePtr Merge(const NodePtr& a, const NodePtr& b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (a->priority > b->priority) {
+      return std::make_shared<Node>(a->value, a->priority, a->left, Merge(a->right, b));
+    }
+    return std::make_shared<Node>(b->value, b->priority, Merge(a, b->left), b->right);
+  }
+
+  template<class F>
+  static void ForEach(const Node* node, const F& f) {
+    if (node == nullptr) return;
+    ForEach(node->left.get(), f);
+    f(node->value);
+    ForEach(node->right.get(), f);
+  }
+
+  // Priorities are a well-mixed sequence, so the tree shape is random
+  // regardless of the order of the insertions.
+  static uint64_t NextPriority() {
+    static std::atomic<uint64_t> seq(0);
+    uint64_t x = seq.fetch_add(1, std::memory_order_relaxed) + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  NodePtr root_;
+};
+
+} // namespace kudu
+
+#endif // KUDU_UTIL_PERSISTENT_TREAP_H
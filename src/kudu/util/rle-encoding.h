@@ -17,6 +17,8 @@
 #ifndef IMPALA_RLE_ENCODING_H
 #define IMPALA_RLE_ENCODING_H
 
+#include <algorithm>
+
 #include <glog/logging.h>
 
 #include "kudu/gutil/port.h"
@@ -102,6 +104,11 @@ class RleDecoder {
   // Gets the next value.  Returns false if there are no more.
   bool Get(T* val);
 
+  // Gets up to 'num' values into 'values', returning the number read, which
+  // is less than 'num' only if there are no more. Literal runs are unpacked
+  // in bulk, so this is much faster than calling Get() in a loop.
+  size_t GetValues(T* values, size_t num);
+
   // Seek to the previous value.
   void RewindOne();
 
@@ -271,6 +278,31 @@ inline bool RleDecoder<T>::Get(T* val) {
   return true;
 }
 
+template<typename T>
+inline size_t RleDecoder<T>::GetValues(T* values, size_t num) {
+  DCHECK(bit_reader_.is_initialized());
+  size_t ret = 0;
+  while (ret < num && ReadHeader()) {
+    size_t rem = num - ret;
+    if (PREDICT_TRUE(repeat_count_ > 0)) {
+      size_t n = std::min<size_t>(repeat_count_, rem);
+      std::fill(values + ret, values + ret + n, static_cast<T>(current_value_));
+      repeat_count_ -= n;
+      ret += n;
+      rewind_state_ = REWIND_RUN;
+    } else {
+      DCHECK(literal_count_ > 0);
+      size_t n = std::min<size_t>(literal_count_, rem);
+      int got = bit_reader_.GetBatch(bit_width_, values + ret, n);
+      DCHECK_EQ(got, n);
+      literal_count_ -= n;
+      ret += n;
+      rewind_state_ = REWIND_LITERAL;
+    }
+  }
+  return ret;
+}
+
 template<typename T>
 inline void RleDecoder<T>::RewindOne() {
   DCHECK(bit_reader_.is_initialized());
@@ -534,4 +534,36 @@ TEST_F(TestRle, TestSkip) {
 
   encoder.Flush();
 }
+// Round-trip random runs and literals of every width through the bulk
+// GetValues() path, reading in randomly-sized chunks.
+TEST_F(TestRle, TestGetValues) {
+  SeedRandom();
+  for (int width = 1; width <= 32; width++) {
+    const uint64_t max_val = (1ULL << width) - 1;
+    faststring buf;
+    RleEncoder<uint32_t> encoder(&buf, width);
+    vector<uint32_t> expected;
+    for (int run = 0; run < 50; run++) {
+      uint32_t val = random() & max_val;
+      int run_length = 1 + random() % 40;
+      bool repeated = random() % 2;
+      for (int i = 0; i < run_length; i++) {
+        uint32_t v = repeated ? val : (random() & max_val);
+        encoder.Put(v);
+        expected.push_back(v);
+      }
+    }
+    encoder.Flush();
+
+    RleDecoder<uint32_t> decoder(buf.data(), encoder.len(), width);
+    vector<uint32_t> decoded(expected.size());
+    size_t pos = 0;
+    while (pos < expected.size()) {
+      size_t to_read = std::min<size_t>(1 + random() % 100, expected.size() - pos);
+      ASSERT_EQ(to_read, decoder.GetValues(&decoded[pos], to_read));
+      pos += to_read;
+    }
+    ASSERT_EQ(expected, decoded) << "width " << width;
+  }
+}
 } // namespace kudu
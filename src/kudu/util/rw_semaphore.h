@@ -23,7 +23,9 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/util/debug-util.h"
+#include "kudu/util/spinlock_profiling.h"
 
 #include "kudu/util/thread.h"
 
@@ -65,6 +67,7 @@ class rw_semaphore {
 
   void lock_shared() {
     int loop_count = 0;
+    int64_t wait_start = 0;
     Atomic32 cur_state = base::subtle::NoBarrier_Load(&state_);
     while (true) {
       Atomic32 expected = cur_state & kNumReadersMask;   // I expect no write lock
@@ -73,8 +76,10 @@ class rw_semaphore {
       if (cur_state == expected)
         break;
       // Either was already locked by someone else, or CAS failed.
+      StartWait(&wait_start);
       boost::detail::yield(loop_count++);
     }
+    EndWait(wait_start);
   }
 
   void unlock_shared() {
@@ -119,6 +124,7 @@ class rw_semaphore {
 
   void lock() {
     int loop_count = 0;
+    int64_t wait_start = 0;
     Atomic32 cur_state = base::subtle::NoBarrier_Load(&state_);
     while (true) {
       Atomic32 expected = cur_state & kNumReadersMask;   // I expect some 0+ readers
@@ -129,10 +135,12 @@ class rw_semaphore {
       if (cur_state == expected)
         break;
       // Either was already locked by someone else, or CAS failed.
+      StartWait(&wait_start);
       boost::detail::yield(loop_count++);
     }
 
-    WaitPendingReaders();
+    WaitPendingReaders(&wait_start);
+    EndWait(wait_start);
 
 #ifndef NDEBUG
     writer_tid_ = Thread::CurrentThreadId();
@@ -185,13 +193,30 @@ class rw_semaphore {
   }
 #endif
 
-  void WaitPendingReaders() {
+  // Waits for the readers to release the lock. If it has to wait, sets
+  // '*wait_start' (if not set yet) as per StartWait().
+  void WaitPendingReaders(int64_t* wait_start = nullptr) {
     int loop_count = 0;
     while ((base::subtle::Acquire_Load(&state_) & kNumReadersMask) > 0) {
+      if (wait_start) StartWait(wait_start);
       boost::detail::yield(loop_count++);
     }
   }
 
+  // Contention profiling: the cycle count at the start of the first wait to
+  // acquire the lock is stored in '*wait_start', and the total wait is
+  // submitted to the contention profile once the lock is acquired.
+  static void StartWait(int64_t* wait_start) {
+    if (*wait_start == 0) {
+      *wait_start = CycleClock::Now();
+    }
+  }
+  void EndWait(int64_t wait_start) const {
+    if (PREDICT_FALSE(wait_start != 0)) {
+      SubmitBlockingProfileData(this, CycleClock::Now() - wait_start);
+    }
+  }
+
  private:
   volatile Atomic32 state_;
 #ifndef NDEBUG
@@ -20,8 +20,12 @@
 #include <strstream>
 
 #include "kudu/gutil/spinlock.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/spinlock_profiling.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
 
 // Can't include gutil/synchronization_profiling.h directly as it'll
@@ -76,6 +80,43 @@ TEST_F(SpinLockProfilingTest, TestStackCollection) {
   ASSERT_EQ(0, dropped);
 }
 
+TEST_F(SpinLockProfilingTest, TestMutexContention) {
+  StartSynchronizationProfiling();
+  Mutex lock;
+  lock.Acquire();
+  scoped_refptr<Thread> t;
+  ASSERT_OK(Thread::Create("test", "waiter", [&]() {
+        lock.Acquire();
+        lock.Release();
+      }, &t));
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  lock.Release();
+  t->Join();
+  StopSynchronizationProfiling();
+
+  std::ostringstream str;
+  int64_t dropped = 0;
+  FlushSynchronizationProfile(&str, &dropped);
+  ASSERT_STR_CONTAINS(str.str(), "\t1 @ ");
+}
+
+#if defined(__linux__)
+TEST_F(SpinLockProfilingTest, TestSampleThreadStacks) {
+  CountDownLatch latch(1);
+  scoped_refptr<Thread> t;
+  ASSERT_OK(Thread::Create("test", "sleeper", &CountDownLatch::Wait, &latch, &t));
+
+  std::ostringstream str;
+  int64_t dropped = 0;
+  SampleThreadStacks(MonoDelta::FromMilliseconds(300), MonoDelta::FromMilliseconds(50),
+                     &str, &dropped);
+  latch.CountDown();
+  t->Join();
+  // At least the sleeping thread was sampled.
+  ASSERT_STR_CONTAINS(str.str(), " @ ");
+}
+#endif
+
 TEST_F(SpinLockProfilingTest, TestTcmallocContention) {
   StartSynchronizationProfiling();
   base::SubmitSpinLockProfileData(nullptr, 12345);
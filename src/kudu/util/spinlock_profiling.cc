@@ -17,7 +17,9 @@
 
 #include "kudu/util/spinlock_profiling.h"
 
+#include <memory>
 #include <sstream>
+#include <vector>
 
 #include <glog/logging.h>
 #include <gflags/gflags.h>
@@ -28,10 +30,13 @@
 #include "kudu/gutil/spinlock.h"
 #include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/sysinfo.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/striped64.h"
+#include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
 
 DEFINE_int32(lock_contention_trace_threshold_cycles,
@@ -57,6 +62,8 @@ METRIC_DEFINE_gauge_uint64(server, tcmalloc_contention_time,
 
 using base::SpinLock;
 using base::SpinLockHolder;
+using std::unique_ptr;
+using std::vector;
 
 namespace kudu {
 
@@ -194,7 +201,7 @@ void ContentionStacks::Flush(std::ostringstream* out, int64_t* dropped) {
   StackTrace t;
   int64_t cycles;
   int64_t count;
-  while (g_contention_stacks->CollectSample(&iterator, &t, &count, &cycles)) {
+  while (CollectSample(&iterator, &t, &count, &cycles)) {
     *out << cycles << "\t" << count
          << " @ " << t.ToHexString(StackTrace::NO_FIX_CALLER_ADDRESSES)
          << std::endl;
@@ -320,6 +327,68 @@ void StopSynchronizationProfiling() {
   CHECK_GE(base::subtle::Barrier_AtomicIncrement(&g_profiling_enabled, -1), 0);
 }
 
+void SubmitBlockingProfileData(const void* lock, int64_t wait_cycles) {
+  if (PREDICT_TRUE(!base::subtle::Acquire_Load(&g_profiling_enabled))) {
+    return;
+  }
+
+  static __thread bool in_func = false;
+  if (in_func) return; // non-re-entrant
+  in_func = true;
+
+  StackTrace stack;
+  stack.Collect();
+  DCHECK_NOTNULL(g_contention_stacks)->AddStack(stack, wait_cycles);
+
+  in_func = false;
+}
+
+void SampleThreadStacks(const MonoDelta& duration, const MonoDelta& interval,
+                        std::ostringstream* out, int64_t* drop_count) {
+  // The table is large, and only used for the duration of the profile.
+  unique_ptr<ContentionStacks> stacks(new ContentionStacks());
+  const int64_t self_tid = Thread::CurrentThreadId();
+  const MonoTime deadline = MonoTime::Now() + duration;
+  MonoTime next_flush = MonoTime::Now() + MonoDelta::FromSeconds(1);
+
+  vector<pid_t> tids;
+  int64_t last_cycles = CycleClock::Now();
+  while (true) {
+    SleepFor(interval);
+    int64_t now_cycles = CycleClock::Now();
+    int64_t weight = now_cycles - last_cycles;
+    last_cycles = now_cycles;
+
+    tids.clear();
+    Status s = ListThreads(&tids);
+    if (!s.ok()) {
+      LOG(WARNING) << "Unable to list threads: " << s.ToString();
+      break;
+    }
+    for (pid_t tid : tids) {
+      if (tid == self_tid) continue;
+      StackTrace stack;
+      if (GetThreadStack(tid, &stack).ok()) {
+        stacks->AddStack(stack, weight);
+      } else {
+        (*drop_count)++;
+      }
+    }
+
+    MonoTime now = MonoTime::Now();
+    if (now >= deadline) {
+      break;
+    }
+    // Flush periodically so that a profile with many distinct stacks doesn't
+    // overflow the table.
+    if (now >= next_flush) {
+      stacks->Flush(out, drop_count);
+      next_flush = now + MonoDelta::FromSeconds(1);
+    }
+  }
+  stacks->Flush(out, drop_count);
+}
+
 } // namespace kudu
 
 // The hook expected by gutil is in the gutil namespace. Simply forward into the
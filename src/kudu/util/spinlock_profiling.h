@@ -25,6 +25,7 @@
 namespace kudu {
 
 class MetricEntity;
+class MonoDelta;
 
 // Enable instrumentation of spinlock contention.
 //
@@ -72,5 +73,27 @@ void FlushSynchronizationProfile(std::ostringstream* out, int64_t* drop_count);
 // Stop collecting contention profiles.
 void StopSynchronizationProfiling();
 
+// Record that the calling thread blocked for 'wait_cycles' on 'lock', which is
+// a blocking primitive such as a Mutex, rw_semaphore or ConditionVariable.
+//
+// While synchronization profiling is enabled, the current stack is recorded in
+// the contention profile along with the spinlock contention. Otherwise, this
+// does nothing.
+void SubmitBlockingProfileData(const void* lock, int64_t wait_cycles);
+
+// Sample the stacks of all of the threads in the process every 'interval'
+// until 'duration' has elapsed, whether they are running on a CPU or blocked
+// (i.e. "wall-clock" or "off-CPU" profiling), and write the samples to 'out'.
+//
+// The output has the same format as FlushSynchronizationProfile(): each
+// sample is weighted by the number of cycles since the previous round of
+// sampling, so the cycles of a stack approximate the wall time that threads
+// spent in it. The calling thread is not sampled.
+//
+// *drop_count is incremented by the number of samples which were dropped,
+// e.g. because the thread exited or did not respond.
+void SampleThreadStacks(const MonoDelta& duration, const MonoDelta& interval,
+                        std::ostringstream* out, int64_t* drop_count);
+
 } // namespace kudu
 #endif /* KUDU_UTIL_SPINLOCK_PROFILING_H */
@@ -19,6 +19,8 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/bind.h"
@@ -31,6 +33,8 @@
 #include "kudu/util/trace.h"
 
 using std::shared_ptr;
+using std::string;
+using std::vector;
 
 namespace kudu {
 
@@ -372,5 +376,150 @@ TEST(TestThreadPool, TestSlowDestructor) {
   ASSERT_LT((MonoTime::Now() - start).ToSeconds(), 5);
 }
 
+// Appends 'value' to 'order', checking that no other task appending to the
+// same vector runs at the same time.
+static void AppendSerially(Atomic32* running, vector<int>* order, int value) {
+  CHECK_EQ(1, base::subtle::NoBarrier_AtomicIncrement(running, 1));
+  order->push_back(value);
+  boost::detail::yield(value);
+  base::subtle::NoBarrier_AtomicIncrement(running, -1);
+}
+
+// Each task submits two more, up to 'depth' levels, until the pool shuts down.
+static void FanOut(ThreadPool* pool, Atomic32* counter, int depth) {
+  base::subtle::NoBarrier_AtomicIncrement(counter, 1);
+  for (int i = 0; i < 2 && depth > 0; i++) {
+    if (!pool->SubmitFunc(boost::bind(&FanOut, pool, counter, depth - 1)).ok()) {
+      return;
+    }
+  }
+}
+
+// Test that tasks submitted by the threads of a work-stealing pool all run,
+// and are tracked by the pool's metrics and Wait().
+TEST(TestThreadPool, TestWorkStealing) {
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_test_entity.Instantiate(
+      &registry, "test entity");
+
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(ThreadPoolBuilder("test")
+            .set_min_threads(1).set_max_threads(4)
+            .set_work_stealing(true)
+            .Build(&thread_pool));
+  scoped_refptr<Histogram> queue_time = METRIC_queue_time.Instantiate(entity);
+  scoped_refptr<Histogram> run_time = METRIC_run_time.Instantiate(entity);
+  thread_pool->SetQueueTimeMicrosHistogram(queue_time);
+  thread_pool->SetRunTimeMicrosHistogram(run_time);
+
+  const int kDepth = 12;
+  const int kNumTasks = (1 << (kDepth + 1)) - 1;
+  Atomic32 counter = 0;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_OK(thread_pool->SubmitFunc(boost::bind(&FanOut, thread_pool.get(), &counter,
+                                                  kDepth)));
+  }
+  thread_pool->Wait();
+  ASSERT_EQ(4 * kNumTasks, base::subtle::NoBarrier_Load(&counter));
+  ASSERT_EQ(0, thread_pool->queue_length());
+  ASSERT_EQ(4 * kNumTasks, queue_time->TotalCount());
+  ASSERT_EQ(4 * kNumTasks, run_time->TotalCount());
+
+  // Tasks which are still queued locally are dropped on shutdown.
+  ASSERT_OK(thread_pool->SubmitFunc(boost::bind(&FanOut, thread_pool.get(), &counter, 30)));
+  thread_pool->Shutdown();
+}
+
+TEST(TestThreadPool, TestSerialToken) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildMinMaxTestPool(4, 4, &thread_pool));
+
+  const int kNumTokens = 4;
+  const int kNumTasks = 1000;
+  vector<std::unique_ptr<ThreadPoolToken>> tokens;
+  vector<vector<int>> orders(kNumTokens);
+  vector<Atomic32> running(kNumTokens, 0);
+  for (int i = 0; i < kNumTokens; i++) {
+    tokens.emplace_back(thread_pool->NewSerialToken().release());
+  }
+  for (int i = 0; i < kNumTasks; i++) {
+    for (int t = 0; t < kNumTokens; t++) {
+      ASSERT_OK(tokens[t]->SubmitFunc(
+          boost::bind(&AppendSerially, &running[t], &orders[t], i)));
+    }
+  }
+  for (int t = 0; t < kNumTokens; t++) {
+    tokens[t]->Wait();
+    ASSERT_EQ(kNumTasks, orders[t].size());
+    for (int i = 0; i < kNumTasks; i++) {
+      ASSERT_EQ(i, orders[t][i]);
+    }
+  }
+}
+
+static void RecordTask(vector<string>* order, string name, CountDownLatch* latch) {
+  if (latch) {
+    latch->Wait();
+  }
+  order->push_back(std::move(name));
+}
+
+// Test that a token with a long queue doesn't hold up other work submitted
+// to the pool after it.
+TEST(TestThreadPool, TestSerialTokenFairness) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildMinMaxTestPool(1, 1, &thread_pool));
+  gscoped_ptr<ThreadPoolToken> busy = thread_pool->NewSerialToken();
+  gscoped_ptr<ThreadPoolToken> other = thread_pool->NewSerialToken();
+
+  vector<string> order;
+  CountDownLatch latch(1);
+  ASSERT_OK(busy->SubmitFunc(boost::bind(&RecordTask, &order, "busy", &latch)));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(busy->SubmitFunc(boost::bind(&RecordTask, &order, "busy", nullptr)));
+  }
+  ASSERT_OK(other->SubmitFunc(boost::bind(&RecordTask, &order, "other", nullptr)));
+  ASSERT_OK(thread_pool->SubmitFunc(boost::bind(&RecordTask, &order, "pool", nullptr)));
+  latch.CountDown();
+  thread_pool->Wait();
+
+  // After its running task, the busy token goes to the back of the queue.
+  ASSERT_EQ(102, order.size());
+  ASSERT_EQ("busy", order[0]);
+  ASSERT_EQ("other", order[1]);
+  ASSERT_EQ("pool", order[2]);
+}
+
+TEST(TestThreadPool, TestSerialTokenShutdown) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildMinMaxTestPool(1, 1, &thread_pool));
+  gscoped_ptr<ThreadPoolToken> token = thread_pool->NewSerialToken();
+
+  vector<string> order;
+  CountDownLatch latch(1);
+  ASSERT_OK(token->SubmitFunc(boost::bind(&RecordTask, &order, "first", &latch)));
+  ASSERT_OK(token->SubmitFunc(boost::bind(&RecordTask, &order, "second", nullptr)));
+  SleepFor(MonoDelta::FromMilliseconds(10));
+  ASSERT_EQ(1, thread_pool->queue_length());
+
+  // Shutting down the token waits for the running task and drops the rest.
+  latch.CountDown();
+  token->Shutdown();
+  ASSERT_EQ(0, thread_pool->queue_length());
+  ASSERT_EQ(vector<string>({ "first" }), order);
+  Status s = token->SubmitFunc(boost::bind(&RecordTask, &order, "third", nullptr));
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+
+  // Tasks queued on a token are dropped when the pool shuts down, and the
+  // token may then outlive the pool.
+  gscoped_ptr<ThreadPoolToken> token2 = thread_pool->NewSerialToken();
+  CountDownLatch latch2(1);
+  ASSERT_OK(token2->SubmitFunc(boost::bind(&RecordTask, &order, "third", &latch2)));
+  ASSERT_OK(token2->SubmitFunc(boost::bind(&RecordTask, &order, "fourth", nullptr)));
+  latch2.CountDown();
+  thread_pool->Shutdown();
+  thread_pool.reset();
+  token2.reset();
+}
 
 } // namespace kudu
@@ -17,12 +17,16 @@
 
 #include "kudu/util/threadpool.h"
 
+#include <algorithm>
 #include <boost/function.hpp>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
 
+#include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/callback.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -36,6 +40,10 @@ namespace kudu {
 
 using strings::Substitute;
 
+// The number of times an idle thread of a work-stealing pool checks for new
+// tasks before going to sleep.
+static const int kIdleSpinIterations = 1000;
+
 ////////////////////////////////////////////////////////
 // FunctionRunnable
 ////////////////////////////////////////////////////////
@@ -61,7 +69,8 @@ ThreadPoolBuilder::ThreadPoolBuilder(std::string name)
       min_threads_(0),
       max_threads_(base::NumCPUs()),
       max_queue_size_(std::numeric_limits<int>::max()),
-      idle_timeout_(MonoDelta::FromMilliseconds(500)) {}
+      idle_timeout_(MonoDelta::FromMilliseconds(500)),
+      work_stealing_(false) {}
 
 ThreadPoolBuilder& ThreadPoolBuilder::set_trace_metric_prefix(
     const std::string& prefix) {
@@ -91,6 +100,11 @@ ThreadPoolBuilder& ThreadPoolBuilder::set_idle_timeout(const MonoDelta& idle_tim
   return *this;
 }
 
+ThreadPoolBuilder& ThreadPoolBuilder::set_work_stealing(bool work_stealing) {
+  work_stealing_ = work_stealing;
+  return *this;
+}
+
 Status ThreadPoolBuilder::Build(gscoped_ptr<ThreadPool>* pool) const {
   pool->reset(new ThreadPool(*this));
   RETURN_NOT_OK((*pool)->Init());
@@ -101,19 +115,25 @@ Status ThreadPoolBuilder::Build(gscoped_ptr<ThreadPool>* pool) const {
 // ThreadPool
 ////////////////////////////////////////////////////////
 
+__thread ThreadPool::WorkerQueue* ThreadPool::tls_worker_queue_ = nullptr;
+
 ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
   : name_(builder.name_),
     min_threads_(builder.min_threads_),
     max_threads_(builder.max_threads_),
     max_queue_size_(builder.max_queue_size_),
     idle_timeout_(builder.idle_timeout_),
+    work_stealing_(builder.work_stealing_),
     pool_status_(Status::Uninitialized("The pool was not initialized.")),
     idle_cond_(&lock_),
     no_threads_cond_(&lock_),
     not_empty_(&lock_),
     num_threads_(0),
     active_threads_(0),
-    queue_size_(0) {
+    queue_size_(0),
+    local_queue_size_(0),
+    num_parked_threads_(0),
+    shutting_down_(false) {
 
   string prefix = !builder.trace_metric_prefix_.empty() ?
       builder.trace_metric_prefix_ : builder.name_;
@@ -151,6 +171,7 @@ void ThreadPool::Shutdown() {
   CheckNotPoolThreadUnlocked();
 
   pool_status_ = Status::ServiceUnavailable("The pool has been shut down.");
+  shutting_down_ = true;
 
   // Clear the queue_ member under the lock, but defer the releasing
   // of the entries outside the lock, in case there are concurrent threads
@@ -158,6 +179,23 @@ void ThreadPool::Shutdown() {
   // locks, etc, so this also prevents lock inversions.
   auto to_release = std::move(queue_);
   queue_.clear();
+  for (ThreadPoolToken* token : tokens_) {
+    token->shutdown_ = true;
+    for (QueueEntry& e : token->entries_) {
+      to_release.emplace_back(std::move(e));
+    }
+    token->entries_.clear();
+    token->idle_cond_.Broadcast();
+  }
+  tokens_.clear();
+  for (WorkerQueue* q : worker_queues_) {
+    std::lock_guard<simple_spinlock> l(q->lock);
+    local_queue_size_ -= q->entries.size();
+    for (QueueEntry& e : q->entries) {
+      to_release.emplace_back(std::move(e));
+    }
+    q->entries.clear();
+  }
   queue_size_ = 0;
   not_empty_.Broadcast();
 
@@ -187,12 +225,42 @@ Status ThreadPool::SubmitFunc(boost::function<void()> func) {
 }
 
 Status ThreadPool::Submit(std::shared_ptr<Runnable> task) {
+  return DoSubmit(std::move(task), nullptr);
+}
+
+gscoped_ptr<ThreadPoolToken> ThreadPool::NewSerialToken() {
+  gscoped_ptr<ThreadPoolToken> token(new ThreadPoolToken(this));
+  MutexLock guard(lock_);
+  if (PREDICT_FALSE(!pool_status_.ok())) {
+    token->shutdown_ = true;
+  } else {
+    InsertOrDie(&tokens_, token.get());
+  }
+  return token.Pass();
+}
+
+Status ThreadPool::DoSubmit(std::shared_ptr<Runnable> task, ThreadPoolToken* token) {
   MonoTime submit_time = MonoTime::Now();
 
+  if (work_stealing_ && token == nullptr && tls_worker_queue_ &&
+      tls_worker_queue_->pool == this) {
+    if (PREDICT_FALSE(shutting_down_)) {
+      return Status::ServiceUnavailable("The pool has been shut down.");
+    }
+    if (SubmitToLocalQueue(&task, submit_time)) {
+      return Status::OK();
+    }
+    // The pool is at capacity: fall back to the shared queue, which returns
+    // the error.
+  }
+
   MutexLock guard(lock_);
   if (PREDICT_FALSE(!pool_status_.ok())) {
     return pool_status_;
   }
+  if (PREDICT_FALSE(token && token->shutdown_)) {
+    return Status::ServiceUnavailable("The token has been shut down.");
+  }
 
   // Size limit check.
   int64_t capacity_remaining = static_cast<int64_t>(max_threads_) - active_threads_ +
@@ -238,7 +306,19 @@ Status ThreadPool::Submit(std::shared_ptr<Runnable> task) {
   }
   e.submit_time = submit_time;
 
-  queue_.emplace_back(std::move(e));
+  if (token == nullptr) {
+    queue_.emplace_back(std::move(e));
+  } else {
+    // Only an idle token needs to be queued on the pool; a busy one already
+    // has its placeholder in queue_ or a task running.
+    bool token_idle = !token->running_ && token->entries_.empty();
+    token->entries_.emplace_back(std::move(e));
+    if (token_idle) {
+      QueueEntry placeholder;
+      placeholder.token = token;
+      queue_.emplace_back(std::move(placeholder));
+    }
+  }
   int length_at_submit = queue_size_++;
 
   guard.Unlock();
@@ -251,6 +331,65 @@ Status ThreadPool::Submit(std::shared_ptr<Runnable> task) {
   return Status::OK();
 }
 
+bool ThreadPool::SubmitToLocalQueue(std::shared_ptr<Runnable>* task,
+                                    const MonoTime& submit_time) {
+  // The submitting thread is active, so it doesn't count against the
+  // capacity of the pool.
+  int64_t capacity_remaining = static_cast<int64_t>(max_threads_) - 1 +
+                               static_cast<int64_t>(max_queue_size_) -
+                               ANNOTATE_UNPROTECTED_READ(queue_size_) - local_queue_size_;
+  if (capacity_remaining < 1) {
+    return false;
+  }
+
+  QueueEntry e;
+  e.runnable = std::move(*task);
+  e.trace = Trace::CurrentTrace();
+  if (e.trace) {
+    e.trace->AddRef();
+  }
+  e.submit_time = submit_time;
+
+  WorkerQueue* q = tls_worker_queue_;
+  int length_at_submit;
+  {
+    std::lock_guard<simple_spinlock> l(q->lock);
+    length_at_submit = q->entries.size();
+    q->entries.emplace_back(std::move(e));
+  }
+
+  // Paired with the check of local_queue_size_ by a thread which is about
+  // to sleep in DispatchThread(): either it sees the task, or we see it's
+  // parked and wake it up to steal the task.
+  local_queue_size_++;
+  if (num_parked_threads_ > 0) {
+    MutexLock guard(lock_);
+    not_empty_.Signal();
+  }
+
+  if (queue_length_histogram_) {
+    queue_length_histogram_->Increment(length_at_submit);
+  }
+  return true;
+}
+
+bool ThreadPool::StealTaskUnlocked(QueueEntry* entry) {
+  lock_.AssertAcquired();
+  if (local_queue_size_ == 0) {
+    return false;
+  }
+  for (WorkerQueue* q : worker_queues_) {
+    std::lock_guard<simple_spinlock> l(q->lock);
+    if (!q->entries.empty()) {
+      *entry = std::move(q->entries.front());
+      q->entries.pop_front();
+      local_queue_size_--;
+      return true;
+    }
+  }
+  return false;
+}
+
 void ThreadPool::Wait() {
   MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
@@ -287,8 +426,57 @@ void ThreadPool::SetRunTimeMicrosHistogram(const scoped_refptr<Histogram>& hist)
   run_time_us_histogram_ = hist;
 }
 
+void ThreadPool::RunTask(QueueEntry* entry) {
+  // Release the reference which was held by the queued item.
+  ADOPT_TRACE(entry->trace);
+  if (entry->trace) {
+    entry->trace->Release();
+  }
+
+  // Update metrics
+  MonoTime now(MonoTime::Now());
+  int64_t queue_time_us = (now - entry->submit_time).ToMicroseconds();
+  TRACE_COUNTER_INCREMENT(queue_time_trace_metric_name_, queue_time_us);
+  if (queue_time_us_histogram_) {
+    queue_time_us_histogram_->Increment(queue_time_us);
+  }
+
+  // Execute the task
+  {
+    MicrosecondsInt64 start_wall_us = GetMonoTimeMicros();
+    MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
+
+    entry->runnable->Run();
+
+    int64_t wall_us = GetMonoTimeMicros() - start_wall_us;
+    int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
+
+    if (run_time_us_histogram_) {
+      run_time_us_histogram_->Increment(wall_us);
+    }
+    TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
+    TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
+  }
+  // Destruct the task while we do not hold the lock.
+  //
+  // The task's destructor may be expensive if it has a lot of bound
+  // objects, and we don't want to block submission of the threadpool.
+  // In the worst case, the destructor might even try to do something
+  // with this threadpool, and produce a deadlock.
+  entry->runnable.reset();
+}
+
 void ThreadPool::DispatchThread(bool permanent) {
+  std::unique_ptr<WorkerQueue> local_queue;
+  if (work_stealing_) {
+    local_queue.reset(new WorkerQueue(this));
+    tls_worker_queue_ = local_queue.get();
+  }
+
   MutexLock unique_lock(lock_);
+  if (local_queue) {
+    worker_queues_.push_back(local_queue.get());
+  }
   while (true) {
     // Note: Status::Aborted() is used to indicate normal shutdown.
     if (!pool_status_.ok()) {
@@ -296,72 +484,97 @@ void ThreadPool::DispatchThread(bool permanent) {
       break;
     }
 
-    if (queue_.empty()) {
+    QueueEntry entry;
+    ThreadPoolToken* token = nullptr;
+    if (!queue_.empty()) {
+      // Fetch a pending task
+      entry = std::move(queue_.front());
+      queue_.pop_front();
+      token = entry.token;
+      if (token) {
+        DCHECK(!token->running_);
+        entry = std::move(token->entries_.front());
+        token->entries_.pop_front();
+        token->running_ = true;
+      }
+      queue_size_--;
+    } else if (!work_stealing_ || !StealTaskUnlocked(&entry)) {
+      if (work_stealing_) {
+        // Spin for a little while before sleeping, in case a task comes in.
+        unique_lock.Unlock();
+        bool found = false;
+        for (int i = 0; i < kIdleSpinIterations && !found; i++) {
+          base::subtle::PauseCPU();
+          found = ANNOTATE_UNPROTECTED_READ(queue_size_) > 0 || local_queue_size_ > 0;
+        }
+        unique_lock.Lock();
+        if (found) {
+          continue;
+        }
+        // Paired with SubmitToLocalQueue().
+        num_parked_threads_++;
+        if (local_queue_size_ > 0) {
+          num_parked_threads_--;
+          continue;
+        }
+      }
+      bool timed_out = false;
       if (permanent) {
         not_empty_.Wait();
       } else {
-        if (!not_empty_.TimedWait(idle_timeout_)) {
-          // After much investigation, it appears that pthread condition variables have
-          // a weird behavior in which they can return ETIMEDOUT from timed_wait even if
-          // another thread did in fact signal. Apparently after a timeout there is some
-          // brief period during which another thread may actually grab the internal mutex
-          // protecting the state, signal, and release again before we get the mutex. So,
-          // we'll recheck the empty queue case regardless.
-          if (queue_.empty()) {
-            VLOG(3) << "Releasing worker thread from pool " << name_ << " after "
-                    << idle_timeout_.ToMilliseconds() << "ms of idle time.";
-            break;
-          }
-        }
+        timed_out = !not_empty_.TimedWait(idle_timeout_);
+      }
+      if (work_stealing_) {
+        num_parked_threads_--;
+      }
+      // After much investigation, it appears that pthread condition variables have
+      // a weird behavior in which they can return ETIMEDOUT from timed_wait even if
+      // another thread did in fact signal. Apparently after a timeout there is some
+      // brief period during which another thread may actually grab the internal mutex
+      // protecting the state, signal, and release again before we get the mutex. So,
+      // we'll recheck the empty queue case regardless.
+      if (timed_out && queue_.empty() && local_queue_size_ == 0) {
+        VLOG(3) << "Releasing worker thread from pool " << name_ << " after "
+                << idle_timeout_.ToMilliseconds() << "ms of idle time.";
+        break;
       }
       continue;
     }
-
-    // Fetch a pending task
-    QueueEntry entry = std::move(queue_.front());
-    queue_.pop_front();
-    queue_size_--;
     ++active_threads_;
 
     unique_lock.Unlock();
-
-    // Release the reference which was held by the queued item.
-    ADOPT_TRACE(entry.trace);
-    if (entry.trace) {
-      entry.trace->Release();
-    }
-
-    // Update metrics
-    MonoTime now(MonoTime::Now());
-    int64_t queue_time_us = (now - entry.submit_time).ToMicroseconds();
-    TRACE_COUNTER_INCREMENT(queue_time_trace_metric_name_, queue_time_us);
-    if (queue_time_us_histogram_) {
-      queue_time_us_histogram_->Increment(queue_time_us);
+    RunTask(&entry);
+
+    if (token) {
+      unique_lock.Lock();
+      token->running_ = false;
+      if (!token->entries_.empty() && !token->shutdown_) {
+        // Requeue the token behind everything that was submitted while its
+        // task ran.
+        QueueEntry placeholder;
+        placeholder.token = token;
+        queue_.emplace_back(std::move(placeholder));
+      } else {
+        token->idle_cond_.Broadcast();
+      }
+      unique_lock.Unlock();
     }
 
-    // Execute the task
-    {
-      MicrosecondsInt64 start_wall_us = GetMonoTimeMicros();
-      MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
-
-      entry.runnable->Run();
-
-      int64_t wall_us = GetMonoTimeMicros() - start_wall_us;
-      int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
-
-      if (run_time_us_histogram_) {
-        run_time_us_histogram_->Increment(wall_us);
+    // Run the tasks which were submitted from this thread, newest first since
+    // their data is the most likely to still be in the CPU caches. Idle
+    // threads steal the oldest ones in the meantime.
+    while (local_queue && !shutting_down_) {
+      {
+        std::lock_guard<simple_spinlock> l(local_queue->lock);
+        if (local_queue->entries.empty()) {
+          break;
+        }
+        entry = std::move(local_queue->entries.back());
+        local_queue->entries.pop_back();
       }
-      TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
-      TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
+      local_queue_size_--;
+      RunTask(&entry);
     }
-    // Destruct the task while we do not hold the lock.
-    //
-    // The task's destructor may be expensive if it has a lot of bound
-    // objects, and we don't want to block submission of the threadpool.
-    // In the worst case, the destructor might even try to do something
-    // with this threadpool, and produce a deadlock.
-    entry.runnable.reset();
     unique_lock.Lock();
 
     if (--active_threads_ == 0) {
@@ -374,6 +587,17 @@ void ThreadPool::DispatchThread(bool permanent) {
   // and add a new task just as the last running thread is about to exit.
   CHECK(unique_lock.OwnsLock());
 
+  // Tasks which were submitted to the local queue during shutdown.
+  std::deque<QueueEntry> to_release;
+  if (local_queue) {
+    worker_queues_.erase(std::find(worker_queues_.begin(), worker_queues_.end(),
+                                   local_queue.get()));
+    std::lock_guard<simple_spinlock> l(local_queue->lock);
+    local_queue_size_ -= local_queue->entries.size();
+    to_release = std::move(local_queue->entries);
+    tls_worker_queue_ = nullptr;
+  }
+
   CHECK_EQ(threads_.erase(Thread::current_thread()), 1);
   if (--num_threads_ == 0) {
     no_threads_cond_.Broadcast();
@@ -383,6 +607,13 @@ void ThreadPool::DispatchThread(bool permanent) {
     CHECK(queue_.empty());
     DCHECK_EQ(0, queue_size_);
   }
+
+  unique_lock.Unlock();
+  for (QueueEntry& e : to_release) {
+    if (e.trace) {
+      e.trace->Release();
+    }
+  }
 }
 
 Status ThreadPool::CreateThreadUnlocked() {
@@ -407,4 +638,74 @@ void ThreadPool::CheckNotPoolThreadUnlocked() {
   }
 }
 
+////////////////////////////////////////////////////////
+// ThreadPoolToken
+////////////////////////////////////////////////////////
+
+ThreadPoolToken::ThreadPoolToken(ThreadPool* pool)
+    : pool_(pool),
+      shutdown_(false),
+      running_(false),
+      idle_cond_(&pool->lock_) {
+}
+
+ThreadPoolToken::~ThreadPoolToken() {
+  // If the token was shut down, the pool may already have been destroyed.
+  if (!ANNOTATE_UNPROTECTED_READ(shutdown_)) {
+    Shutdown();
+  }
+}
+
+Status ThreadPoolToken::SubmitClosure(const Closure& task) {
+  return SubmitFunc(boost::bind(&Closure::Run, task));
+}
+
+Status ThreadPoolToken::SubmitFunc(boost::function<void()> func) {
+  return Submit(std::shared_ptr<Runnable>(new FunctionRunnable(std::move(func))));
+}
+
+Status ThreadPoolToken::Submit(std::shared_ptr<Runnable> task) {
+  return pool_->DoSubmit(std::move(task), this);
+}
+
+void ThreadPoolToken::Wait() {
+  MutexLock unique_lock(pool_->lock_);
+  pool_->CheckNotPoolThreadUnlocked();
+  while (running_ || !entries_.empty()) {
+    idle_cond_.Wait();
+  }
+}
+
+void ThreadPoolToken::Shutdown() {
+  MutexLock unique_lock(pool_->lock_);
+  std::deque<ThreadPool::QueueEntry> to_release;
+  if (!shutdown_) {
+    shutdown_ = true;
+    pool_->tokens_.erase(this);
+
+    // Remove our tasks and our placeholder in the pool's queue, if any.
+    to_release = std::move(entries_);
+    entries_.clear();
+    pool_->queue_size_ -= to_release.size();
+    for (auto it = pool_->queue_.begin(); it != pool_->queue_.end(); ++it) {
+      if (it->token == this) {
+        pool_->queue_.erase(it);
+        break;
+      }
+    }
+  }
+
+  while (running_) {
+    idle_cond_.Wait();
+  }
+
+  // Release the removed tasks outside the lock, as in ThreadPool::Shutdown().
+  unique_lock.Unlock();
+  for (ThreadPool::QueueEntry& e : to_release) {
+    if (e.trace) {
+      e.trace->Release();
+    }
+  }
+}
+
 } // namespace kudu
@@ -17,7 +17,9 @@
 #ifndef KUDU_UTIL_THREAD_POOL_H
 #define KUDU_UTIL_THREAD_POOL_H
 
+#include <atomic>
 #include <boost/function.hpp>
+#include <deque>
 #include <gtest/gtest_prod.h>
 #include <list>
 #include <memory>
@@ -31,6 +33,7 @@
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/condition_variable.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/status.h"
@@ -40,6 +43,7 @@ namespace kudu {
 class Histogram;
 class Thread;
 class ThreadPool;
+class ThreadPoolToken;
 class Trace;
 
 class Runnable {
@@ -90,6 +94,15 @@ class Runnable {
 //    We always keep at least min_threads.
 //    Default: 500 milliseconds.
 //
+// work_stealing: Whether tasks submitted by the pool's own threads, other
+//    than through a token, are queued locally to the submitting thread rather
+//    than on the pool's shared queue. A thread runs its local tasks newest
+//    first once its current task completes, without taking the pool's lock,
+//    and idle threads steal the oldest local tasks of busy ones. Idle
+//    threads also spin briefly before going to sleep. Suited to tasks which
+//    fan out into many short tasks.
+//    Default: false.
+//
 class ThreadPoolBuilder {
  public:
   explicit ThreadPoolBuilder(std::string name);
@@ -101,12 +114,14 @@ class ThreadPoolBuilder {
   ThreadPoolBuilder& set_max_threads(int max_threads);
   ThreadPoolBuilder& set_max_queue_size(int max_queue_size);
   ThreadPoolBuilder& set_idle_timeout(const MonoDelta& idle_timeout);
+  ThreadPoolBuilder& set_work_stealing(bool work_stealing);
 
   const std::string& name() const { return name_; }
   int min_threads() const { return min_threads_; }
   int max_threads() const { return max_threads_; }
   int max_queue_size() const { return max_queue_size_; }
   const MonoDelta& idle_timeout() const { return idle_timeout_; }
+  bool work_stealing() const { return work_stealing_; }
 
   // Instantiate a new ThreadPool with the existing builder arguments.
   Status Build(gscoped_ptr<ThreadPool>* pool) const;
@@ -119,6 +134,7 @@ class ThreadPoolBuilder {
   int max_threads_;
   int max_queue_size_;
   MonoDelta idle_timeout_;
+  bool work_stealing_;
 
   DISALLOW_COPY_AND_ASSIGN(ThreadPoolBuilder);
 };
@@ -141,6 +157,9 @@ class ThreadPoolBuilder {
 //            .Build(&thread_pool));
 //    thread_pool->Submit(shared_ptr<Runnable>(new Task()));
 //    thread_pool->Submit(boost::bind(&Func, 10));
+//
+// Tasks may also be submitted through a ThreadPoolToken (see below), which
+// runs its tasks one at a time and in submission order.
 class ThreadPool {
  public:
   ~ThreadPool();
@@ -162,6 +181,12 @@ class ThreadPool {
   // Submit a Runnable class
   Status Submit(std::shared_ptr<Runnable> task) WARN_UNUSED_RESULT;
 
+  // Create a new token whose tasks run serially on this pool's threads.
+  //
+  // Once the pool is shut down, the token's tasks are removed and it may only
+  // be destroyed. Otherwise, it must be shut down or destroyed before the pool.
+  gscoped_ptr<ThreadPoolToken> NewSerialToken();
+
   // Wait until all the tasks are completed.
   void Wait();
 
@@ -176,7 +201,8 @@ class ThreadPool {
   // Return the current number of tasks waiting in the queue.
   // Typically used for metrics.
   int queue_length() const {
-    return ANNOTATE_UNPROTECTED_READ(queue_size_);
+    return ANNOTATE_UNPROTECTED_READ(queue_size_) +
+        local_queue_size_.load(std::memory_order_relaxed);
   }
 
   // Attach a histogram which measures the queue length seen by tasks when they enter
@@ -192,6 +218,7 @@ class ThreadPool {
 
  private:
   friend class ThreadPoolBuilder;
+  friend class ThreadPoolToken;
 
   // Create a new thread pool using a builder.
   explicit ThreadPool(const ThreadPoolBuilder& builder);
@@ -208,23 +235,63 @@ class ThreadPool {
   // Aborts if the current thread is a member of this thread pool.
   void CheckNotPoolThreadUnlocked();
 
+  // Submit 'task' to the pool, or to 'token' if it is not NULL.
+  Status DoSubmit(std::shared_ptr<Runnable> task, ThreadPoolToken* token);
+
  private:
   FRIEND_TEST(TestThreadPool, TestThreadPoolWithNoMinimum);
   FRIEND_TEST(TestThreadPool, TestVariableSizeThreadPool);
 
   struct QueueEntry {
+    QueueEntry() : trace(nullptr), token(nullptr) {}
+
     std::shared_ptr<Runnable> runnable;
     Trace* trace;
 
     // Time at which the entry was submitted to the pool.
     MonoTime submit_time;
+
+    // If set, this entry is a placeholder for the token, and the task to run
+    // is the first one in the token's own queue. A token has a placeholder in
+    // 'queue_' only while it has queued tasks and none running, and it goes
+    // to the back of 'queue_' after each of its tasks runs, so busy tokens
+    // take turns with each other and with untokenized tasks.
+    ThreadPoolToken* token;
   };
 
+  // The local queue of a thread of a work-stealing pool. The thread pushes
+  // and pops tasks at the back, and other threads steal them from the front.
+  struct WorkerQueue {
+    explicit WorkerQueue(ThreadPool* pool) : pool(pool) {}
+
+    ThreadPool* const pool;
+    simple_spinlock lock;
+    std::deque<QueueEntry> entries;
+  };
+
+  // Queues 'task' on the local queue of the current thread, which belongs to
+  // this pool. Returns false, without queueing the task, if the pool is at
+  // capacity.
+  bool SubmitToLocalQueue(std::shared_ptr<Runnable>* task, const MonoTime& submit_time);
+
+  // Moves the oldest task of the local queue of another thread to 'entry'.
+  // Returns false if all the local queues are empty. Required that lock_ is
+  // held.
+  bool StealTaskUnlocked(QueueEntry* entry);
+
+  // Runs the task of 'entry', updating the metrics, and destroys it.
+  void RunTask(QueueEntry* entry);
+
+  // The local queue of the current thread, if it belongs to a work-stealing
+  // pool.
+  static __thread WorkerQueue* tls_worker_queue_;
+
   const std::string name_;
   const int min_threads_;
   const int max_threads_;
   const int max_queue_size_;
   const MonoDelta idle_timeout_;
+  const bool work_stealing_;
 
   Status pool_status_;
   Mutex lock_;
@@ -242,6 +309,28 @@ class ThreadPool {
   // Protected by lock_.
   std::unordered_set<Thread*> threads_;
 
+  // Tokens which have not yet been shut down.
+  //
+  // Protected by lock_.
+  std::unordered_set<ThreadPoolToken*> tokens_;
+
+  // The local queues of the threads of a work-stealing pool.
+  //
+  // Protected by lock_.
+  std::vector<WorkerQueue*> worker_queues_;
+
+  // The number of tasks in 'worker_queues_'.
+  std::atomic<int> local_queue_size_;
+
+  // The number of threads waiting on 'not_empty_' in a work-stealing pool.
+  // Submitting a task to a local queue only signals 'not_empty_' if there
+  // are any.
+  std::atomic<int> num_parked_threads_;
+
+  // Set when the pool starts to shut down, so that threads stop running the
+  // tasks of their local queues.
+  std::atomic<bool> shutting_down_;
+
   scoped_refptr<Histogram> queue_length_histogram_;
   scoped_refptr<Histogram> queue_time_us_histogram_;
   scoped_refptr<Histogram> run_time_us_histogram_;
@@ -253,5 +342,60 @@ class ThreadPool {
   DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
 
+// A handle for submitting tasks to a ThreadPool which must run serially, in
+// the order they were submitted, without dedicating a thread to them.
+//
+// The token's tasks count against the pool's queue size and are tracked by
+// the pool's metrics. The pool's threads are shared fairly among its tokens:
+// however many tasks a token has queued, it runs one and then goes to the back
+// of the pool's queue.
+//
+// Usage Example:
+//    gscoped_ptr<ThreadPoolToken> token = thread_pool->NewSerialToken();
+//    token->SubmitFunc(boost::bind(&Func, 10));
+//    token->SubmitFunc(boost::bind(&Func, 11)); // runs after Func(10)
+//    token->Wait();
+class ThreadPoolToken {
+ public:
+  // Shuts down the token if it hasn't been already.
+  ~ThreadPoolToken();
+
+  // Submit a task to run after all of the token's previously submitted tasks.
+  Status SubmitClosure(const Closure& task) WARN_UNUSED_RESULT;
+  Status SubmitFunc(boost::function<void()> func) WARN_UNUSED_RESULT;
+  Status Submit(std::shared_ptr<Runnable> task) WARN_UNUSED_RESULT;
+
+  // Wait until all of the token's submitted tasks are completed.
+  void Wait();
+
+  // Remove the token's queued tasks and wait for its running task, if any, to
+  // complete. Subsequent submissions to the token fail.
+  void Shutdown();
+
+ private:
+  friend class ThreadPool;
+
+  explicit ThreadPoolToken(ThreadPool* pool);
+
+  ThreadPool* const pool_;
+
+  // All of the following are protected by the pool's lock_.
+
+  // Whether the token has been shut down, either directly or by the pool.
+  bool shutdown_;
+
+  // Whether one of the token's tasks is running.
+  bool running_;
+
+  // The token's tasks which haven't started to run.
+  std::deque<ThreadPool::QueueEntry> entries_;
+
+  // Signaled when the token has no running task and either no queued ones or
+  // has been shut down.
+  ConditionVariable idle_cond_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPoolToken);
+};
+
 } // namespace kudu
 #endif
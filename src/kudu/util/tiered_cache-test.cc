@@ -0,0 +1,199 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/test_util.h"
+#include "kudu/util/tiered_cache.h"
+
+DECLARE_bool(cache_force_single_shard);
+DECLARE_int32(tiered_cache_promotion_hits);
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+
+static string EncodeInt(int k) {
+  faststring result;
+  PutFixed32(&result, k);
+  return result.ToString();
+}
+
+static int DecodeInt(const Slice& k) {
+  CHECK_EQ(4, k.size());
+  return DecodeFixed32(k.data());
+}
+
+// Both tiers are plain DRAM LRU caches, so that the tiering logic can be
+// tested without persistent memory.
+class TieredCacheTest : public KuduTest,
+                        public Cache::EvictionCallback {
+ public:
+  static const int kHotCapacity = 2;
+  static const int kColdCapacity = 3;
+
+  virtual void SetUp() OVERRIDE {
+    KuduTest::SetUp();
+    FLAGS_cache_force_single_shard = true;
+    hot_ = NewLRUCache(DRAM_CACHE, kHotCapacity, "tiered_cache_test-hot");
+    cold_ = NewLRUCache(DRAM_CACHE, kColdCapacity, "tiered_cache_test-cold");
+    cache_.reset(NewTieredCache(hot_, cold_));
+  }
+
+  virtual void EvictedEntry(Slice key, Slice val) OVERRIDE {
+    evicted_keys_.push_back(DecodeInt(key));
+    evicted_values_.push_back(DecodeInt(val));
+  }
+
+ protected:
+  int Lookup(int key, Cache::CacheBehavior caching = Cache::EXPECT_IN_CACHE) {
+    Cache::Handle* handle = cache_->Lookup(EncodeInt(key), caching);
+    if (handle == nullptr) {
+      return -1;
+    }
+    int r = DecodeInt(cache_->Value(handle));
+    cache_->Release(handle);
+    return r;
+  }
+
+  void Insert(int key, int value) {
+    string key_str = EncodeInt(key);
+    string val_str = EncodeInt(value);
+    Cache::PendingHandle* handle = CHECK_NOTNULL(cache_->Allocate(key_str, val_str.size(), 1));
+    memcpy(cache_->MutableValue(handle), val_str.data(), val_str.size());
+    cache_->Release(cache_->Insert(handle, this));
+  }
+
+  // Whether 'tier' holds an entry for 'key'.
+  static bool InTier(Cache* tier, int key) {
+    Cache::Handle* handle = tier->Lookup(EncodeInt(key), Cache::NO_EXPECT_IN_CACHE);
+    if (handle == nullptr) {
+      return false;
+    }
+    tier->Release(handle);
+    return true;
+  }
+
+  vector<int> evicted_keys_;
+  vector<int> evicted_values_;
+
+  // Owned by 'cache_'.
+  Cache* hot_;
+  Cache* cold_;
+
+  gscoped_ptr<Cache> cache_;
+};
+
+TEST_F(TieredCacheTest, TestDemotionAndPromotion) {
+  Insert(1, 101);
+  Insert(2, 102);
+  Insert(3, 103);
+
+  // Making room for 3 demoted the least recently used entry.
+  ASSERT_FALSE(InTier(hot_, 1));
+  ASSERT_TRUE(InTier(cold_, 1));
+  ASSERT_TRUE(InTier(hot_, 2));
+  ASSERT_TRUE(InTier(hot_, 3));
+  ASSERT_TRUE(evicted_keys_.empty());
+
+  // The first hit is served from the cold tier, as are lookups which don't
+  // expect the entry to be cached.
+  ASSERT_EQ(101, Lookup(1));
+  ASSERT_EQ(101, Lookup(1, Cache::NO_EXPECT_IN_CACHE));
+  ASSERT_TRUE(InTier(cold_, 1));
+
+  // The second hit promotes the entry, demoting 2 in turn.
+  ASSERT_EQ(101, Lookup(1));
+  ASSERT_TRUE(InTier(hot_, 1));
+  ASSERT_FALSE(InTier(cold_, 1));
+  ASSERT_FALSE(InTier(hot_, 2));
+  ASSERT_TRUE(InTier(cold_, 2));
+  ASSERT_EQ(102, Lookup(2));
+  ASSERT_EQ(103, Lookup(3));
+  ASSERT_TRUE(evicted_keys_.empty());
+}
+
+TEST_F(TieredCacheTest, TestEvictionFromBothTiers) {
+  FLAGS_tiered_cache_promotion_hits = 1000;
+  for (int i = 0; i < kHotCapacity + kColdCapacity + 1; i++) {
+    Insert(i, i + 100);
+  }
+  // Only entry 0, which was pushed out of the cold tier, has left the cache.
+  ASSERT_EQ(vector<int>({ 0 }), evicted_keys_);
+  ASSERT_EQ(vector<int>({ 100 }), evicted_values_);
+  ASSERT_EQ(-1, Lookup(0));
+  for (int i = 1; i < kHotCapacity + kColdCapacity + 1; i++) {
+    ASSERT_EQ(i + 100, Lookup(i));
+  }
+}
+
+TEST_F(TieredCacheTest, TestErase) {
+  Insert(1, 101);
+  Insert(2, 102);
+  Insert(3, 103);
+  ASSERT_TRUE(InTier(cold_, 1));
+
+  cache_->Erase(EncodeInt(1));
+  cache_->Erase(EncodeInt(3));
+  ASSERT_EQ(vector<int>({ 1, 3 }), evicted_keys_);
+  ASSERT_EQ(-1, Lookup(1));
+  ASSERT_EQ(-1, Lookup(3));
+  ASSERT_EQ(102, Lookup(2));
+
+  // An erased entry which is still referenced isn't demoted once released.
+  Cache::Handle* h = cache_->Lookup(EncodeInt(2), Cache::EXPECT_IN_CACHE);
+  ASSERT_TRUE(h != nullptr);
+  cache_->Erase(EncodeInt(2));
+  ASSERT_EQ(102, DecodeInt(cache_->Value(h)));
+  cache_->Release(h);
+  ASSERT_EQ(vector<int>({ 1, 3, 2 }), evicted_keys_);
+  ASSERT_FALSE(InTier(cold_, 2));
+  ASSERT_EQ(-1, Lookup(2));
+}
+
+TEST_F(TieredCacheTest, TestReplace) {
+  Insert(1, 101);
+  Insert(1, 102);
+  ASSERT_EQ(vector<int>({ 1 }), evicted_keys_);
+  ASSERT_EQ(vector<int>({ 101 }), evicted_values_);
+  ASSERT_FALSE(InTier(cold_, 1));
+  ASSERT_EQ(102, Lookup(1));
+}
+
+TEST_F(TieredCacheTest, TestDestroy) {
+  for (int i = 0; i < kHotCapacity + kColdCapacity; i++) {
+    Insert(i, i + 100);
+  }
+  ASSERT_TRUE(evicted_keys_.empty());
+  cache_.reset();
+  std::sort(evicted_keys_.begin(), evicted_keys_.end());
+  ASSERT_EQ(vector<int>({ 0, 1, 2, 3, 4 }), evicted_keys_);
+}
+
+} // namespace kudu
@@ -0,0 +1,352 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/tiered_cache.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/cache_metrics.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/metrics.h"
+
+DEFINE_int32(tiered_cache_promotion_hits, 2,
+             "For tiered caches, the number of lookups which must hit an entry in the "
+             "cold tier before it is promoted back into the hot tier.");
+TAG_FLAG(tiered_cache_promotion_hits, experimental);
+TAG_FLAG(tiered_cache_promotion_hits, runtime);
+
+namespace kudu {
+
+namespace {
+
+using base::subtle::Atomic32;
+
+// The value of every entry, in either tier, is prefixed with this header,
+// which carries the entry's state across demotion and promotion.
+struct EntryHeader {
+  // The callback passed to Insert(), invoked once the entry has left both
+  // tiers.
+  Cache::EvictionCallback* eviction_callback;
+  int32_t charge;
+
+  // One of the EntryState values below.
+  Atomic32 state;
+
+  // The number of lookups which have hit this copy in the cold tier.
+  Atomic32 hits;
+};
+
+enum EntryState {
+  // The copy is the current version of the entry.
+  kLive = 0,
+  // The entry was erased. Its hot copy may still be referenced, and must not
+  // be demoted once it's freed.
+  kErased = 1,
+  // The cold copy was promoted into the hot tier, which now owns the entry.
+  kPromoted = 2
+};
+
+EntryHeader* HeaderOf(Slice value) {
+  DCHECK_GE(value.size(), sizeof(EntryHeader));
+  return reinterpret_cast<EntryHeader*>(value.mutable_data());
+}
+
+Slice UserValue(Slice value) {
+  return Slice(value.data() + sizeof(EntryHeader), value.size() - sizeof(EntryHeader));
+}
+
+// Handles of cold-tier entries are told apart by setting their lowest bit,
+// which is always clear since handles point to word-aligned entries.
+const uintptr_t kColdHandleTag = 1;
+
+bool IsColdHandle(Cache::Handle* h) {
+  return reinterpret_cast<uintptr_t>(h) & kColdHandleTag;
+}
+
+Cache::Handle* TagColdHandle(Cache::Handle* h) {
+  DCHECK(!IsColdHandle(h));
+  return reinterpret_cast<Cache::Handle*>(reinterpret_cast<uintptr_t>(h) | kColdHandleTag);
+}
+
+Cache::Handle* UntagColdHandle(Cache::Handle* h) {
+  return reinterpret_cast<Cache::Handle*>(reinterpret_cast<uintptr_t>(h) & ~kColdHandleTag);
+}
+
+class TieredCache : public Cache {
+ public:
+  TieredCache(Cache* hot_tier, Cache* cold_tier)
+      : hot_evictor_(this, &TieredCache::HotEntryEvicted),
+        cold_evictor_(this, &TieredCache::ColdEntryEvicted),
+        shutting_down_(false),
+        hot_(hot_tier),
+        cold_(cold_tier) {
+  }
+
+  virtual ~TieredCache() {
+    // The hot tier's entries are dropped rather than demoted from here on.
+    shutting_down_ = true;
+    hot_.reset();
+    cold_.reset();
+  }
+
+  virtual Handle* Lookup(const Slice& key, CacheBehavior caching) OVERRIDE {
+    Handle* h = hot_->Lookup(key, caching);
+    if (h == nullptr) {
+      h = LookupCold(key, caching);
+    }
+    RecordLookup(h != nullptr, caching == EXPECT_IN_CACHE);
+    return h;
+  }
+
+  virtual void Release(Handle* handle) OVERRIDE {
+    if (IsColdHandle(handle)) {
+      cold_->Release(UntagColdHandle(handle));
+    } else {
+      hot_->Release(handle);
+    }
+  }
+
+  virtual Slice Value(Handle* handle) OVERRIDE {
+    if (IsColdHandle(handle)) {
+      return UserValue(cold_->Value(UntagColdHandle(handle)));
+    }
+    return UserValue(hot_->Value(handle));
+  }
+
+  virtual void Erase(const Slice& key) OVERRIDE {
+    Handle* h = hot_->Lookup(key, NO_EXPECT_IN_CACHE);
+    if (h != nullptr) {
+      base::subtle::NoBarrier_Store(&HeaderOf(hot_->Value(h))->state, kErased);
+      hot_->Release(h);
+    }
+    hot_->Erase(key);
+    cold_->Erase(key);
+  }
+
+  virtual uint64_t NewId() OVERRIDE {
+    return hot_->NewId();
+  }
+
+  virtual void SetMetrics(const scoped_refptr<MetricEntity>& entity) OVERRIDE {
+    metrics_.reset(new CacheMetrics(entity));
+  }
+
+  virtual PendingHandle* Allocate(Slice key, int val_len, int charge) OVERRIDE {
+    PendingHandle* ph = hot_->Allocate(key, val_len + sizeof(EntryHeader), charge);
+    if (ph != nullptr) {
+      EntryHeader* header = reinterpret_cast<EntryHeader*>(hot_->MutableValue(ph));
+      header->eviction_callback = nullptr;
+      header->charge = charge;
+      header->state = kLive;
+      header->hits = 0;
+    }
+    return ph;
+  }
+
+  virtual uint8_t* MutableValue(PendingHandle* handle) OVERRIDE {
+    return hot_->MutableValue(handle) + sizeof(EntryHeader);
+  }
+
+  virtual Handle* Insert(PendingHandle* handle,
+                         EvictionCallback* eviction_callback) OVERRIDE {
+    EntryHeader* header = reinterpret_cast<EntryHeader*>(hot_->MutableValue(handle));
+    header->eviction_callback = eviction_callback;
+    if (PREDICT_TRUE(metrics_)) {
+      metrics_->cache_usage->IncrementBy(header->charge);
+      metrics_->inserts->Increment();
+    }
+    return hot_->Insert(handle, &hot_evictor_);
+  }
+
+  virtual void Free(PendingHandle* handle) OVERRIDE {
+    hot_->Free(handle);
+  }
+
+ private:
+  // Forwards the evictions of one of the tiers to a TieredCache method.
+  class TierEvictionCallback : public EvictionCallback {
+   public:
+    typedef void (TieredCache::*Method)(Slice key, Slice value);
+
+    TierEvictionCallback(TieredCache* cache, Method method)
+        : cache_(cache),
+          method_(method) {
+    }
+
+    virtual void EvictedEntry(Slice key, Slice value) OVERRIDE {
+      (cache_->*method_)(key, value);
+    }
+
+   private:
+    TieredCache* cache_;
+    const Method method_;
+  };
+
+  // Look up 'key' in the cold tier, promoting the entry if it has been hit
+  // often enough.
+  Handle* LookupCold(const Slice& key, CacheBehavior caching) {
+    Handle* cold = cold_->Lookup(key, caching);
+    if (cold == nullptr) {
+      return nullptr;
+    }
+    if (caching == EXPECT_IN_CACHE) {
+      EntryHeader* header = HeaderOf(cold_->Value(cold));
+      if (base::subtle::NoBarrier_AtomicIncrement(&header->hits, 1) >=
+          FLAGS_tiered_cache_promotion_hits) {
+        Handle* promoted = Promote(key, cold);
+        if (promoted != nullptr) {
+          cold_->Release(cold);
+          return promoted;
+        }
+      }
+    }
+    return TagColdHandle(cold);
+  }
+
+  // Copy the cold entry 'cold' into the hot tier and erase it from the cold
+  // tier. Returns a handle to the hot copy, or NULL if the entry is already
+  // being promoted or erased, or the hot tier had no room for it.
+  Handle* Promote(const Slice& key, Handle* cold) {
+    Slice value = cold_->Value(cold);
+    EntryHeader* header = HeaderOf(value);
+    if (base::subtle::NoBarrier_CompareAndSwap(&header->state, kLive, kPromoted) != kLive) {
+      return nullptr;
+    }
+    PendingHandle* ph = hot_->Allocate(key, value.size(), header->charge);
+    if (ph == nullptr) {
+      base::subtle::NoBarrier_Store(&header->state, kLive);
+      return nullptr;
+    }
+    uint8_t* dst = hot_->MutableValue(ph);
+    memcpy(dst, value.data(), value.size());
+    EntryHeader* hot_header = reinterpret_cast<EntryHeader*>(dst);
+    hot_header->state = kLive;
+    hot_header->hits = 0;
+    Handle* h = hot_->Insert(ph, &hot_evictor_);
+    cold_->Erase(key);
+    return h;
+  }
+
+  // Copy an entry which was evicted from the hot tier into the cold tier.
+  // Returns false if the cold tier had no room for it.
+  bool Demote(const Slice& key, const Slice& value) {
+    PendingHandle* ph = cold_->Allocate(key, value.size(), HeaderOf(value)->charge);
+    if (ph == nullptr) {
+      return false;
+    }
+    uint8_t* dst = cold_->MutableValue(ph);
+    memcpy(dst, value.data(), value.size());
+    reinterpret_cast<EntryHeader*>(dst)->hits = 0;
+    cold_->Release(cold_->Insert(ph, &cold_evictor_));
+    return true;
+  }
+
+  // Called when the last reference to an entry of the hot tier is dropped.
+  //
+  // The entry is demoted if it was evicted to make room. If it was erased,
+  // replaced by a newer version, or the cache is shutting down, it leaves the
+  // cache for good.
+  void HotEntryEvicted(Slice key, Slice value) {
+    if (!shutting_down_ &&
+        base::subtle::NoBarrier_Load(&HeaderOf(value)->state) == kLive &&
+        !HasNewerHotVersion(key) &&
+        Demote(key, value)) {
+      return;
+    }
+    EntryLeftCache(key, value);
+  }
+
+  // Called when the last reference to an entry of the cold tier is dropped.
+  void ColdEntryEvicted(Slice key, Slice value) {
+    if (base::subtle::NoBarrier_Load(&HeaderOf(value)->state) != kPromoted) {
+      EntryLeftCache(key, value);
+    }
+  }
+
+  // Whether the hot tier holds an entry for 'key'. Called while an evicted
+  // entry for 'key' is being freed, in which case any entry found must have
+  // replaced it.
+  bool HasNewerHotVersion(const Slice& key) {
+    Handle* h = hot_->Lookup(key, NO_EXPECT_IN_CACHE);
+    if (h == nullptr) {
+      return false;
+    }
+    hot_->Release(h);
+    return true;
+  }
+
+  void EntryLeftCache(Slice key, Slice value) {
+    EntryHeader* header = HeaderOf(value);
+    if (header->eviction_callback) {
+      header->eviction_callback->EvictedEntry(key, UserValue(value));
+    }
+    if (PREDICT_TRUE(metrics_)) {
+      metrics_->cache_usage->DecrementBy(header->charge);
+      metrics_->evictions->Increment();
+    }
+  }
+
+  void RecordLookup(bool was_hit, bool caching) {
+    if (!metrics_) {
+      return;
+    }
+    metrics_->lookups->Increment();
+    if (was_hit) {
+      if (caching) {
+        metrics_->cache_hits_caching->Increment();
+      } else {
+        metrics_->cache_hits->Increment();
+      }
+    } else {
+      if (caching) {
+        metrics_->cache_misses_caching->Increment();
+      } else {
+        metrics_->cache_misses->Increment();
+      }
+    }
+  }
+
+  // Declared before the tiers, which hold pointers to them.
+  TierEvictionCallback hot_evictor_;
+  TierEvictionCallback cold_evictor_;
+
+  gscoped_ptr<CacheMetrics> metrics_;
+
+  bool shutting_down_;
+
+  gscoped_ptr<Cache> hot_;
+  gscoped_ptr<Cache> cold_;
+
+  DISALLOW_COPY_AND_ASSIGN(TieredCache);
+};
+
+} // anonymous namespace
+
+Cache* NewTieredCache(Cache* hot_tier, Cache* cold_tier) {
+  return new TieredCache(hot_tier, cold_tier);
+}
+
+}  // namespace kudu
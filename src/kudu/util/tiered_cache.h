@@ -0,0 +1,43 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_TIERED_CACHE_H_
+#define KUDU_UTIL_TIERED_CACHE_H_
+
+namespace kudu {
+
+class Cache;
+
+// Create a two-tier cache out of a small, fast 'hot_tier' (typically a DRAM
+// LRU cache) and a large, slower 'cold_tier' (typically an NVM cache). The
+// returned cache takes ownership of both tiers.
+//
+// New entries are inserted into the hot tier. Entries evicted from the hot
+// tier to make room are demoted into the cold tier rather than dropped, and
+// cold entries are promoted back into the hot tier once they have been
+// looked up --tiered_cache_promotion_hits times with EXPECT_IN_CACHE.
+// Lookups check the hot tier first, so no latency is added for hot entries.
+//
+// Eviction callbacks passed to Insert() are invoked once an entry has left
+// both tiers. The tiered cache records the metrics passed to SetMetrics()
+// itself, counting an entry once while it's in either tier; the tiers are
+// never given metrics, so demotions and promotions aren't counted as
+// evictions or inserts.
+Cache* NewTieredCache(Cache* hot_tier, Cache* cold_tier);
+
+}  // namespace kudu
+
+#endif
@@ -105,6 +105,23 @@ TEST_F(TraceTest, TestChildTrace) {
             "XXXX XX:XX:XX.XXXXXX trace-test.cc:XXX] hello from traceB\n");
 }
 
+// Test that a trace which isn't sampled drops its messages without evaluating
+// their arguments, but still collects metrics.
+TEST_F(TraceTest, TestNotSampled) {
+  scoped_refptr<Trace> t(new Trace);
+  t->set_sampled(false);
+  int num_evals = 0;
+  auto eval = [&]() { return ++num_evals; };
+  {
+    ADOPT_TRACE(t.get());
+    TRACE("hello $0", eval());
+    TRACE_COUNTER_INCREMENT("test_counter", 1);
+  }
+  TRACE_TO(t, "goodbye $0", eval());
+  ASSERT_EQ(0, num_evals);
+  ASSERT_EQ("Metrics: {\"test_counter\":1}", t->DumpToString(Trace::INCLUDE_METRICS));
+}
+
 static void GenerateTraceEvents(int thread_id,
                                 int num_events) {
   for (int i = 0; i < num_events; i++) {
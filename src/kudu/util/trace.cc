@@ -39,12 +39,28 @@ using strings::internal::SubstituteArg;
 __thread Trace* Trace::threadlocal_trace_;
 
 Trace::Trace()
-  : arena_(new ThreadSafeArena(1024, 128*1024)),
+  : arena_(nullptr),
+    sampled_(true),
     entries_head_(nullptr),
     entries_tail_(nullptr) {
 }
 
 Trace::~Trace() {
+  delete arena_.load(std::memory_order_relaxed);
+}
+
+ThreadSafeArena* Trace::GetArena() {
+  ThreadSafeArena* arena = arena_.load(std::memory_order_acquire);
+  if (PREDICT_TRUE(arena != nullptr)) {
+    return arena;
+  }
+  std::lock_guard<simple_spinlock> l(lock_);
+  arena = arena_.load(std::memory_order_relaxed);
+  if (arena == nullptr) {
+    arena = new ThreadSafeArena(1024, 128*1024);
+    arena_.store(arena, std::memory_order_release);
+  }
+  return arena;
 }
 
 // Struct which precedes each entry in the trace.
@@ -97,7 +113,7 @@ void Trace::SubstituteAndTrace(const char* file_path,
 
 TraceEntry* Trace::NewEntry(int msg_len, const char* file_path, int line_number) {
   int size = sizeof(TraceEntry) + msg_len;
-  uint8_t* dst = reinterpret_cast<uint8_t*>(arena_->AllocateBytes(size));
+  uint8_t* dst = reinterpret_cast<uint8_t*>(GetArena()->AllocateBytes(size));
   TraceEntry* entry = reinterpret_cast<TraceEntry*>(dst);
   entry->timestamp_micros = GetCurrentTimeMicros();
   entry->message_len = msg_len;
@@ -246,7 +262,7 @@ void Trace::DumpCurrentTrace() {
 }
 
 void Trace::AddChildTrace(StringPiece label, Trace* child_trace) {
-  CHECK(arena_->RelocateStringPiece(label, &label));
+  CHECK(GetArena()->RelocateStringPiece(label, &label));
 
   std::lock_guard<simple_spinlock> l(lock_);
   scoped_refptr<Trace> ptr(child_trace);
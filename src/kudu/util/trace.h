@@ -17,6 +17,7 @@
 #ifndef KUDU_UTIL_TRACE_H
 #define KUDU_UTIL_TRACE_H
 
+#include <atomic>
 #include <iosfwd>
 #include <string>
 #include <utility>
@@ -42,10 +43,13 @@
 // See Trace::SubstituteAndTrace for arguments.
 // Example:
 //  TRACE("Acquired timestamp $0", timestamp);
+//
+// If the current trace is not sampled, this does nothing and does not
+// evaluate its parameters.
 #define TRACE(format, substitutions...) \
   do { \
     kudu::Trace* _trace = Trace::CurrentTrace(); \
-    if (_trace) { \
+    if (_trace && _trace->sampled()) { \
       _trace->SubstituteAndTrace(__FILE__, __LINE__, (format),  \
         ##substitutions); \
     } \
@@ -53,7 +57,11 @@
 
 // Like the above, but takes the trace pointer as an explicit argument.
 #define TRACE_TO(trace, format, substitutions...) \
-  (trace)->SubstituteAndTrace(__FILE__, __LINE__, (format), ##substitutions)
+  do { \
+    if ((trace)->sampled()) { \
+      (trace)->SubstituteAndTrace(__FILE__, __LINE__, (format), ##substitutions); \
+    } \
+  } while (0)
 
 // Increment a counter associated with the current trace.
 //
@@ -201,6 +209,20 @@ class Trace : public RefCountedThreadSafe<Trace> {
     return metrics_;
   }
 
+  // Whether messages are recorded into this trace. The messages of a trace
+  // which is not sampled are dropped without being formatted, but its
+  // metrics and child traces are still collected. Traces are sampled by
+  // default.
+  //
+  // set_sampled() must be called before the trace is shared with other
+  // threads.
+  bool sampled() const {
+    return sampled_;
+  }
+  void set_sampled(bool sampled) {
+    sampled_ = sampled;
+  }
+
  private:
   friend class ScopedAdoptTrace;
   friend class RefCountedThreadSafe<Trace>;
@@ -220,7 +242,14 @@ class Trace : public RefCountedThreadSafe<Trace> {
 
   void MetricsToJSON(JsonWriter* jw) const;
 
-  gscoped_ptr<ThreadSafeArena> arena_;
+  // Returns the arena, allocating it on first use so that traces which
+  // never record a message don't pay for it.
+  ThreadSafeArena* GetArena();
+
+  // Allocated by GetArena() and owned by this trace.
+  std::atomic<ThreadSafeArena*> arena_;
+
+  bool sampled_;
 
   // Lock protecting the entries linked list.
   mutable simple_spinlock lock_;
@@ -387,6 +387,20 @@ build_zlib() {
   popd
 }
 
+build_zstd() {
+  ZSTD_BDIR=$TP_BUILD_DIR/$ZSTD_NAME$MODE_SUFFIX
+  mkdir -p $ZSTD_BDIR
+  pushd $ZSTD_BDIR
+
+  # zstd's makefiles don't support out-of-tree builds, so prepopulate the
+  # build directory with the sources.
+  rsync -av --delete $ZSTD_SOURCE/ .
+
+  CFLAGS="$EXTRA_CFLAGS -fPIC" \
+    make -j$PARALLEL $EXTRA_MAKEFLAGS -C lib PREFIX=$PREFIX install
+  popd
+}
+
 build_lz4() {
   LZ4_BDIR=$TP_BUILD_DIR/$LZ4_NAME$MODE_SUFFIX
   mkdir -p $LZ4_BDIR
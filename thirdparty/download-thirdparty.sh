@@ -162,6 +162,10 @@ if [ ! -d $ZLIB_SOURCE ]; then
   fetch_and_expand zlib-${ZLIB_VERSION}.tar.gz
 fi
 
+if [ ! -d $ZSTD_SOURCE ]; then
+  fetch_and_expand zstd-${ZSTD_VERSION}.tar.gz
+fi
+
 if [ ! -d $LIBEV_SOURCE ]; then
   fetch_and_expand libev-${LIBEV_VERSION}.tar.gz
 fi
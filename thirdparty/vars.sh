@@ -76,6 +76,10 @@ ZLIB_VERSION=1.2.8
 ZLIB_NAME=zlib-$ZLIB_VERSION
 ZLIB_SOURCE=$TP_SOURCE_DIR/$ZLIB_NAME
 
+ZSTD_VERSION=1.1.3
+ZSTD_NAME=zstd-$ZSTD_VERSION
+ZSTD_SOURCE=$TP_SOURCE_DIR/$ZSTD_NAME
+
 LIBEV_VERSION=4.20
 LIBEV_NAME=libev-$LIBEV_VERSION
 LIBEV_SOURCE=$TP_SOURCE_DIR/$LIBEV_NAME